@@ -0,0 +1,45 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+#extension GL_GOOGLE_include_directive : require
+#include "half.glsl"
+
+layout (location = 0) in vec3 vertColor;
+layout (location = 1) flat in uint materialIndex;
+layout (location = 2) in vec3 worldPosition;
+
+layout (location = 0) out vec4 outColor;
+
+// every resident texture, indexed through the material; slots past the last registered one are unbound
+layout (set = 1, binding = 0) uniform sampler2D textures[];
+
+// MAX_MATERIALS in vk_engine.h
+const uint MAX_MATERIALS = 256;
+
+// one array per parameter (see MaterialStore.h), so neighbouring fragments of different materials read
+// neighbouring words
+layout (std430, set = 1, binding = 1) readonly buffer MaterialBuffer
+{
+	vec4 baseColors[MAX_MATERIALS];
+	uint textureIndices[MAX_MATERIALS];
+} materialBuffer;
+
+#include "shadow.glsl"
+#include "lights.glsl"
+
+// the lit variant adds the clustered point lights; pipelines without them skip the lookups entirely
+layout (constant_id = 0) const bool LIT = false;
+
+// light left in full shadow
+const float AMBIENT = 0.35f;
+
+void main()
+{
+	// textureIndex isn't sampled yet: the vertex formats carry no UVs
+	vec4 color = vec4(vertColor, 1.0f) * materialBuffer.baseColors[materialIndex];
+	hfvec3 light = hfvec3(mix(AMBIENT * ambient_occlusion(), 1.0f, shadow_factor(worldPosition)));
+	if (LIT)
+	{
+		light += hfvec3(clustered_lighting(worldPosition));
+	}
+	outColor = vec4(color.rgb * vec3(light), color.a);
+}
\ No newline at end of file
@@ -0,0 +1,22 @@
+#version 450
+#extension GL_EXT_multiview : require
+
+// the debug lines DebugDraw batched this frame, already in world space with their color per vertex
+layout (location = 0) in vec3 vPosition;
+layout (location = 1) in vec4 vColor;
+
+layout (location = 0) out vec4 outColor;
+
+layout (set = 0, binding = 0) uniform CameraBuffer
+{
+	mat4 view;
+	mat4 proj;
+	mat4 viewproj;
+	layout (offset = 624) mat4 eyeViewProj[2];
+} cameraData;
+
+void main()
+{
+	gl_Position = cameraData.eyeViewProj[gl_ViewIndex] * vec4(vPosition, 1.0f);
+	outColor = vColor;
+}
@@ -0,0 +1,63 @@
+#version 450
+#extension GL_EXT_multiview : require
+
+// depth-only pre-pass for helloTriangleMesh.vert: just the position attribute, no fragment stage.
+// The color pass then tests with EQUAL, so both shaders must compute gl_Position the same way
+layout (location = 0) in vec3 vPosition;
+
+layout (set = 0, binding = 0) uniform CameraBuffer
+{
+	mat4 view;
+	mat4 proj;
+	mat4 viewproj;
+	layout (offset = 624) mat4 eyeViewProj[2];
+} cameraData;
+
+// same block as helloTriangleMesh.vert; the material index is left unused here
+layout( push_constant ) uniform constants
+{
+	mat4 model;
+	uint materialIndex;
+} PushConstants;
+
+// the per-draw data paths of helloTriangleMesh.vert, specialized the same way by the same pipelines
+layout (constant_id = 0) const uint OBJECT_DATA_PATH = 0;
+
+struct DrawData
+{
+	mat4 model;
+	uint materialIndex;
+};
+
+layout (set = 2, binding = 0) uniform DrawUniform
+{
+	DrawData draw;
+} drawUniform;
+
+layout (std430, set = 2, binding = 1) readonly buffer DrawStorage
+{
+	DrawData draws[];
+} drawStorage;
+
+DrawData draw_data()
+{
+	if (OBJECT_DATA_PATH == 1)
+	{
+		return drawUniform.draw;
+	}
+	if (OBJECT_DATA_PATH == 2)
+	{
+		return drawStorage.draws[gl_InstanceIndex];
+	}
+	DrawData draw;
+	draw.model = PushConstants.model;
+	draw.materialIndex = PushConstants.materialIndex;
+	return draw;
+}
+
+invariant gl_Position;
+
+void main()
+{
+	gl_Position = cameraData.eyeViewProj[gl_ViewIndex] * draw_data().model * vec4(vPosition, 1.0f);
+}
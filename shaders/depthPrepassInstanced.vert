@@ -0,0 +1,21 @@
+#version 450
+#extension GL_EXT_multiview : require
+
+// depth-only pre-pass for instancedMesh.vert: position and the per-instance model matrix only
+layout (location = 0) in vec3 vPosition;
+layout (location = 3) in mat4 instanceModel;
+
+layout (set = 0, binding = 0) uniform CameraBuffer
+{
+	mat4 view;
+	mat4 proj;
+	mat4 viewproj;
+	layout (offset = 624) mat4 eyeViewProj[2];
+} cameraData;
+
+invariant gl_Position;
+
+void main()
+{
+	gl_Position = cameraData.eyeViewProj[gl_ViewIndex] * instanceModel * vec4(vPosition, 1.0f);
+}
@@ -0,0 +1,33 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+// the grass lit like the terrain it grows from, from whichever side the blade is seen
+layout (location = 0) in vec3 worldPosition;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec3 inColor;
+
+layout (location = 0) out vec4 outColor;
+
+#include "shadow.glsl"
+#include "lights.glsl"
+
+// the lit variant adds the clustered point lights, as for the meshes
+layout (constant_id = 0) const bool LIT = false;
+
+// light left in full shadow
+const float AMBIENT = 0.35f;
+
+void main()
+{
+	// the normals lean up, so the back of a blade shades about like its front
+	vec3 normal = normalize(inNormal);
+	normal = gl_FrontFacing ? normal : reflect(-normal, vec3(0.0f, 1.0f, 0.0f));
+
+	float sun = max(dot(normal, -normalize(cameraData.lightDirection.xyz)), 0.0f);
+	vec3 light = vec3(mix(AMBIENT * ambient_occlusion(), 1.0f, shadow_factor(worldPosition) * sun));
+	if (LIT)
+	{
+		light += clustered_lighting(worldPosition);
+	}
+	outColor = vec4(inColor * light, 1.0f);
+}
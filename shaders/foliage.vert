@@ -0,0 +1,42 @@
+#version 450
+#extension GL_EXT_multiview : require
+
+// one tuft of grass per instance (see GpuFoliageInstance), placed by foliage.comp: the level's vertices turned
+// about y, scaled and stood on the ground
+layout (set = 0, binding = 0) uniform CameraBuffer
+{
+	mat4 view;
+	mat4 proj;
+	mat4 viewproj;
+	vec4 frustumPlanes[6];
+	vec4 position;
+	layout (offset = 624) mat4 eyeViewProj[2];
+} cameraData;
+
+layout (location = 0) in vec3 vPosition;
+layout (location = 1) in vec3 vNormal;
+layout (location = 2) in vec3 vColor;
+layout (location = 3) in vec4 positionScale; // xyz the root, w the scale
+layout (location = 4) in vec4 rotationTint; // xy cosine and sine of the yaw, z the tint
+
+layout (location = 0) out vec3 outWorldPosition;
+layout (location = 1) out vec3 outNormal;
+layout (location = 2) out vec3 outColor;
+
+// the same rotation as foliage.comp's impostor transforms
+vec3 turn(vec3 v)
+{
+	float c = rotationTint.x;
+	float s = rotationTint.y;
+	return vec3(c * v.x + s * v.z, v.y, -s * v.x + c * v.z);
+}
+
+void main()
+{
+	vec3 world = positionScale.xyz + turn(vPosition) * positionScale.w;
+	gl_Position = cameraData.eyeViewProj[gl_ViewIndex] * vec4(world, 1.0f);
+	outWorldPosition = world;
+	outNormal = turn(vNormal);
+	// drier or greener by a little either way
+	outColor = vColor * mix(vec3(1.15f, 1.05f, 0.8f), vec3(0.85f, 1.0f, 0.9f), rotationTint.z);
+}
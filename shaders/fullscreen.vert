@@ -0,0 +1,8 @@
+#version 450
+
+// one triangle covering the viewport, from the vertex index alone; draw 3 vertices without vertex input
+void main()
+{
+	vec2 corner = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+	gl_Position = vec4(corner * 2.0f - 1.0f, 0.0f, 1.0f);
+}
@@ -0,0 +1,23 @@
+// included by the shaders with a half-precision build: the build compiles every shader that includes this
+// itself a second time with HALF_PRECISION defined, foo.comp into foo.comp.half.spv next to foo.comp.spv,
+// and the engine loads that one where the device has shaderFloat16. hfloat and the hfvecs are float16_t
+// and f16vecs there and float and vecs otherwise, so one source covers both. Only for values that stay
+// within +-65504 and need no more than about three significant digits: colors, weights and lighting
+// terms, never positions or depths
+#ifndef HALF_GLSL
+#define HALF_GLSL
+
+#ifdef HALF_PRECISION
+#extension GL_EXT_shader_explicit_arithmetic_types_float16 : require
+#define hfloat float16_t
+#define hfvec2 f16vec2
+#define hfvec3 f16vec3
+#define hfvec4 f16vec4
+#else
+#define hfloat float
+#define hfvec2 vec2
+#define hfvec3 vec3
+#define hfvec4 vec4
+#endif
+
+#endif
@@ -2,6 +2,9 @@
 
 layout (location = 0) out vec3 vertColor;
 
+// the alternate triangle is this shader with the constant set, so both share one module
+layout (constant_id = 0) const bool ALT_COLORS = false;
+
 void main()
 {
 	const vec3 positions[3] = vec3[3](
@@ -16,6 +19,13 @@ void main()
 		vec3(0.0f, 0.0f, 1.0f)
 	);
 
-	vertColor = colors[gl_VertexIndex];
+	const vec3 altColors[3] = vec3[3](
+		vec3(1.0f, 0.0f, 1.0f),
+		vec3(0.0f, 1.0f, 1.0f),
+		vec3(0.0f, 0.0f, 1.0f)
+	);
+
+	// folded when the pipeline is compiled; no branch is left in either variant
+	vertColor = ALT_COLORS ? altColors[gl_VertexIndex] : colors[gl_VertexIndex];
 	gl_Position = vec4(positions[gl_VertexIndex], 1.0f);
 }
\ No newline at end of file
@@ -1,12 +1,30 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
+#include "half.glsl"
 
-// inputs
+// mesh materials without bindless: vertex color, darkened where the light's shadow falls and, in the lit
+// variant, brightened by the point lights around it
 layout (location = 0) in vec3 vertColor;
+layout (location = 1) flat in uint materialIndex;
+layout (location = 2) in vec3 worldPosition;
 
-// output
-layout(location = 0) out vec4 outColor;
+layout (location = 0) out vec4 outColor;
+
+#include "shadow.glsl"
+#include "lights.glsl"
+
+// the lit variant adds the clustered point lights; pipelines without them skip the lookups entirely
+layout (constant_id = 0) const bool LIT = false;
+
+// light left in full shadow
+const float AMBIENT = 0.35f;
 
 void main()
 {
-	outColor = vec4(vertColor, 1.0f);
-}
\ No newline at end of file
+	hfvec3 light = hfvec3(mix(AMBIENT * ambient_occlusion(), 1.0f, shadow_factor(worldPosition)));
+	if (LIT)
+	{
+		light += hfvec3(clustered_lighting(worldPosition));
+	}
+	outColor = vec4(vertColor * vec3(light), 1.0f);
+}
@@ -1,20 +1,75 @@
 #version 450
+#extension GL_EXT_multiview : require
 
 layout (location = 0) in vec3 vPosition;
 layout (location = 1) in vec3 vNormal;
 layout (location = 2) in vec3 vColor;
 
 layout (location = 0) out vec3 vertColor;
+layout (location = 1) flat out uint materialIndex;
+layout (location = 2) out vec3 worldPosition;
 
-// push constants block
+// written once per frame, bound with a dynamic offset
+layout (set = 0, binding = 0) uniform CameraBuffer
+{
+	mat4 view;
+	mat4 proj;
+	mat4 viewproj;
+	layout (offset = 624) mat4 eyeViewProj[2];
+} cameraData;
+
+// push constants block; only what changes per object
 layout( push_constant ) uniform constants
 {
-	vec4 data;
-	mat4 render_matrix;
+	mat4 model;
+	uint materialIndex;
 } PushConstants;
 
+// where each draw's model matrix and material index come from, ObjectDataPath on the CPU: 0 the push
+// constants, 1 a uniform buffer bound at a dynamic offset per draw, 2 a storage buffer indexed by
+// gl_InstanceIndex, which the draw's firstInstance points at its slot
+layout (constant_id = 0) const uint OBJECT_DATA_PATH = 0;
+
+struct DrawData
+{
+	mat4 model;
+	uint materialIndex;
+};
+
+layout (set = 2, binding = 0) uniform DrawUniform
+{
+	DrawData draw;
+} drawUniform;
+
+layout (std430, set = 2, binding = 1) readonly buffer DrawStorage
+{
+	DrawData draws[];
+} drawStorage;
+
+DrawData draw_data()
+{
+	if (OBJECT_DATA_PATH == 1)
+	{
+		return drawUniform.draw;
+	}
+	if (OBJECT_DATA_PATH == 2)
+	{
+		return drawStorage.draws[gl_InstanceIndex];
+	}
+	DrawData draw;
+	draw.model = PushConstants.model;
+	draw.materialIndex = PushConstants.materialIndex;
+	return draw;
+}
+
+// must match depthPrepass*.vert bit for bit, or the EQUAL depth test of pre-passed materials fails
+invariant gl_Position;
+
 void main()
 {
+	DrawData draw = draw_data();
 	vertColor = vColor;
-	gl_Position = PushConstants.render_matrix * vec4(vPosition, 1.0f);
+	materialIndex = draw.materialIndex;
+	worldPosition = vec3(draw.model * vec4(vPosition, 1.0f));
+	gl_Position = cameraData.eyeViewProj[gl_ViewIndex] * draw.model * vec4(vPosition, 1.0f);
 }
\ No newline at end of file
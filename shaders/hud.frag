@@ -0,0 +1,14 @@
+#version 450
+
+// every HUD draw samples imgui's font atlas; its solid white texel covers the untextured shapes
+layout (location = 0) in vec2 inUv;
+layout (location = 1) in vec4 inColor;
+
+layout (location = 0) out vec4 outFragColor;
+
+layout (set = 0, binding = 0) uniform sampler2D fontAtlas;
+
+void main()
+{
+	outFragColor = inColor * texture(fontAtlas, inUv);
+}
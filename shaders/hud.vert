@@ -0,0 +1,22 @@
+#version 450
+
+// imgui's vertices as they are, in window pixels, mapped to clip space by the push constants
+layout (location = 0) in vec2 vPosition;
+layout (location = 1) in vec2 vUv;
+layout (location = 2) in vec4 vColor;
+
+layout (location = 0) out vec2 outUv;
+layout (location = 1) out vec4 outColor;
+
+layout (push_constant) uniform constants
+{
+	vec2 scale;
+	vec2 translate;
+} PushConstants;
+
+void main()
+{
+	outUv = vUv;
+	outColor = vColor;
+	gl_Position = vec4(vPosition * PushConstants.scale + PushConstants.translate, 0.0f, 1.0f);
+}
@@ -0,0 +1,35 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+// the impostor's atlas texel, cut out where the mesh didn't cover it and lit like the mesh materials
+layout (location = 0) in vec3 inUv;
+layout (location = 1) in vec3 worldPosition;
+
+layout (location = 0) out vec4 outColor;
+
+#include "shadow.glsl"
+#include "lights.glsl"
+
+layout (set = 1, binding = 0) uniform sampler2DArray atlas;
+
+// the lit variant adds the clustered point lights, as for the meshes
+layout (constant_id = 0) const bool LIT = false;
+
+// light left in full shadow
+const float AMBIENT = 0.35f;
+
+void main()
+{
+	vec4 texel = texture(atlas, inUv);
+	if (texel.a < 0.5f)
+	{
+		discard;
+	}
+
+	vec3 light = vec3(mix(AMBIENT * ambient_occlusion(), 1.0f, shadow_factor(worldPosition)));
+	if (LIT)
+	{
+		light += clustered_lighting(worldPosition);
+	}
+	outColor = vec4(texel.rgb * light, 1.0f);
+}
@@ -0,0 +1,84 @@
+#version 450
+#extension GL_EXT_multiview : require
+
+// one quad per far object standing in for its mesh: the instance is the object (see GpuImpostorInstance),
+// the six vertices its two triangles. The quad lies in the view plane of the atlas frame nearest to the
+// direction the camera sees the object from, over the mesh's bounding sphere, so that frame's picture covers
+// it the way it was baked
+layout (set = 0, binding = 0) uniform CameraBuffer
+{
+	mat4 view;
+	mat4 proj;
+	mat4 viewproj;
+	vec4 frustumPlanes[6];
+	vec4 position;
+	layout (offset = 624) mat4 eyeViewProj[2];
+} cameraData;
+
+layout (location = 0) in vec4 modelRow0;
+layout (location = 1) in vec4 modelRow1;
+layout (location = 2) in vec4 modelRow2;
+layout (location = 3) in vec4 sphere; // mesh space, w the radius
+layout (location = 4) in float layer;
+
+// frames along each side of the atlas's grid (ImpostorBakeSettings::frames)
+layout (constant_id = 0) const uint FRAMES = 8;
+
+layout (location = 0) out vec3 outUv; // xy in the atlas, z its layer
+layout (location = 1) out vec3 outWorldPosition;
+
+const vec2 CORNERS[6] = vec2[6](vec2(-1.0f, -1.0f), vec2(1.0f, -1.0f), vec2(1.0f, 1.0f),
+	vec2(-1.0f, -1.0f), vec2(1.0f, 1.0f), vec2(-1.0f, 1.0f));
+
+float sign_not_zero(float value)
+{
+	return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+// where direction lands on the octahedron folded flat, +y at the center; the inverse of the one below
+vec2 octahedron_uv(vec3 direction)
+{
+	vec3 n = direction / (abs(direction.x) + abs(direction.y) + abs(direction.z));
+	vec2 folded = n.xz;
+	if (n.y < 0.0f)
+	{
+		folded = vec2((1.0f - abs(n.z)) * sign_not_zero(n.x), (1.0f - abs(n.x)) * sign_not_zero(n.z));
+	}
+	return folded * 0.5f + 0.5f;
+}
+
+// the same as the bake's (see Impostors.cpp)
+vec3 octahedron_direction(vec2 uv)
+{
+	vec2 f = uv * 2.0f - 1.0f;
+	vec3 n = vec3(f.x, 1.0f - abs(f.x) - abs(f.y), f.y);
+	if (n.y < 0.0f)
+	{
+		float x = n.x;
+		n.x = (1.0f - abs(n.z)) * sign_not_zero(x);
+		n.z = (1.0f - abs(x)) * sign_not_zero(n.z);
+	}
+	return normalize(n);
+}
+
+void main()
+{
+	mat4 model = transpose(mat4(modelRow0, modelRow1, modelRow2, vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+	vec3 center = (model * vec4(sphere.xyz, 1.0f)).xyz;
+
+	// the camera in mesh space picks the frame, whatever the object's rotation and scale
+	vec3 toCamera = inverse(mat3(model)) * (cameraData.position.xyz - center);
+	vec2 frame = min(floor(octahedron_uv(normalize(toCamera)) * FRAMES), vec2(FRAMES - 1));
+	vec3 direction = octahedron_direction((frame + 0.5f) / FRAMES);
+	vec3 helper = abs(direction.y) > 0.999f ? vec3(0.0f, 0.0f, -1.0f) : vec3(0.0f, 1.0f, 0.0f);
+	vec3 right = normalize(cross(helper, direction));
+	vec3 up = cross(direction, right);
+
+	vec2 corner = CORNERS[gl_VertexIndex];
+	vec4 world = model * vec4(sphere.xyz + (right * corner.x + up * corner.y) * sphere.w, 1.0f);
+	gl_Position = cameraData.eyeViewProj[gl_ViewIndex] * world;
+
+	// the frames' rows run down the atlas, and up is towards the top of each
+	outUv = vec3((frame + vec2(corner.x, -corner.y) * 0.5f + 0.5f) / FRAMES, layer);
+	outWorldPosition = world.xyz;
+}
@@ -0,0 +1,40 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_multiview : require
+
+// instancedMesh.vert with its vertex pulled from the mesh pool; the instance matrix is still fetched, from
+// the only binding these pipelines have, which no vertex format changes
+#include "vertexPull.glsl"
+
+// per-instance model matrix, one vec4 column per location
+layout (location = 3) in mat4 instanceModel;
+
+layout (location = 0) out vec3 vertColor;
+layout (location = 1) flat out uint materialIndex;
+layout (location = 2) out vec3 worldPosition;
+
+// written once per frame, bound with a dynamic offset
+layout (set = 0, binding = 0) uniform CameraBuffer
+{
+	mat4 view;
+	mat4 proj;
+	mat4 viewproj;
+	layout (offset = 624) mat4 eyeViewProj[2];
+} cameraData;
+
+// same block as meshPulled.vert; the model matrix is left unused here
+layout( push_constant ) uniform constants
+{
+	mat4 model;
+	uint materialIndex;
+	uint vertexFormat;
+} PushConstants;
+
+void main()
+{
+	PulledVertex vertex = pull_vertex(PushConstants.vertexFormat, gl_VertexIndex);
+	vertColor = vertex.color;
+	materialIndex = PushConstants.materialIndex;
+	worldPosition = vec3(instanceModel * vec4(vertex.position, 1.0f));
+	gl_Position = cameraData.eyeViewProj[gl_ViewIndex] * instanceModel * vec4(vertex.position, 1.0f);
+}
@@ -0,0 +1,68 @@
+// included by the mesh fragment shaders after shadow.glsl: the point lights of the fragment's cluster (see
+// ClusteredLights.h). Needs the camera block for the cluster parameters
+#include "half.glsl"
+
+// GpuLight in ClusteredLights.h
+struct PointLight
+{
+	vec4 positionRadius; // world space
+	vec4 color; // premultiplied by intensity
+};
+
+layout (std430, set = 0, binding = 2) readonly buffer PointLightBuffer
+{
+	PointLight lights[];
+} pointLights;
+
+// per cluster x the first entry of its list, y how many
+layout (std430, set = 0, binding = 3) readonly buffer ClusterGridBuffer
+{
+	uvec2 clusters[];
+} lightGrid;
+
+layout (std430, set = 0, binding = 4) readonly buffer ClusterIndexBuffer
+{
+	uint indices[];
+} clusterIndices;
+
+uint cluster_index(vec3 worldPosition)
+{
+	uvec3 grid = cameraData.clusterGrid.xyz;
+	float depth = -(cameraData.view * vec4(worldPosition, 1.0f)).z;
+	// slices as lightCluster.comp cut them; anything past the last one shares its list
+	int slice = int(floor(log(max(depth, 1e-4f)) * cameraData.clusterDepth.x + cameraData.clusterDepth.y));
+	uvec2 tile = uvec2(gl_FragCoord.xy / cameraData.clusterDepth.zw * vec2(grid.xy));
+	tile = min(tile, grid.xy - 1);
+	uint z = uint(clamp(slice, 0, int(grid.z) - 1));
+	return (z * grid.y + tile.y) * grid.x + tile.x;
+}
+
+// light the fragment gets from its cluster's point lights, to add to the rest of its lighting.
+// The vertex formats carry no normals, so surfaces are lit as flat facets through the position's derivatives.
+// Distances are float; the terms made of them and the sum are hfloat
+vec3 clustered_lighting(vec3 worldPosition)
+{
+	vec3 normal = normalize(cross(dFdx(worldPosition), dFdy(worldPosition)));
+	if (dot(normal, cameraData.position.xyz - worldPosition) < 0.0f)
+	{
+		normal = -normal;
+	}
+	hfvec3 facing = hfvec3(normal);
+
+	uvec2 cluster = lightGrid.clusters[cluster_index(worldPosition)];
+	hfvec3 light = hfvec3(0.0f);
+	for (uint i = 0; i < cluster.y; i++)
+	{
+		PointLight pointLight = pointLights.lights[clusterIndices.indices[cluster.x + i]];
+		vec3 toLight = pointLight.positionRadius.xyz - worldPosition;
+		float distanceSquared = dot(toLight, toLight);
+		float radius = pointLight.positionRadius.w;
+		// inverse square, windowed so it reaches zero exactly at the radius the clusters were built with
+		float ratio = distanceSquared / (radius * radius);
+		hfloat window = hfloat(clamp(1.0f - ratio * ratio, 0.0f, 1.0f));
+		hfloat attenuation = window * window * hfloat(1.0f / (distanceSquared + 1.0f));
+		hfloat lambert = max(dot(facing, hfvec3(toLight * inversesqrt(max(distanceSquared, 1e-8f)))), hfloat(0.0f));
+		light += hfvec3(pointLight.color.rgb) * (lambert * attenuation);
+	}
+	return vec3(light);
+}
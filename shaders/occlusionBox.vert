@@ -0,0 +1,35 @@
+#version 450
+#extension GL_EXT_multiview : require
+
+// one world-space bounding box as twelve triangles for an occlusion query, no vertex input and no fragment
+// stage: the corners come from the vertex index
+layout (set = 0, binding = 0) uniform CameraBuffer
+{
+	mat4 view;
+	mat4 proj;
+	mat4 viewproj;
+	layout (offset = 624) mat4 eyeViewProj[2];
+} cameraData;
+
+// the box's min and max corners, w unused
+layout( push_constant ) uniform constants
+{
+	vec4 boxMin;
+	vec4 boxMax;
+} PushConstants;
+
+// x, y and z of each triangle corner as bits 0, 1 and 2; the winding doesn't matter, nothing is culled
+const uint CORNERS[36] = uint[](
+	0, 1, 3, 0, 3, 2, // -z
+	4, 6, 7, 4, 7, 5, // +z
+	0, 4, 5, 0, 5, 1, // -y
+	2, 3, 7, 2, 7, 6, // +y
+	0, 2, 6, 0, 6, 4, // -x
+	1, 5, 7, 1, 7, 3); // +x
+
+void main()
+{
+	uint corner = CORNERS[gl_VertexIndex];
+	vec3 select = vec3(corner & 1u, (corner >> 1) & 1u, (corner >> 2) & 1u);
+	gl_Position = cameraData.eyeViewProj[gl_ViewIndex] * vec4(mix(PushConstants.boxMin.xyz, PushConstants.boxMax.xyz, select), 1.0f);
+}
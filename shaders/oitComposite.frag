@@ -0,0 +1,21 @@
+#version 450
+
+// resolves the weighted blended targets over the opaque scene: their average color, blended SRC_ALPHA,
+// ONE_MINUS_SRC_ALPHA with alpha as the coverage, 1 - revealage
+layout (location = 0) out vec4 outColor;
+
+layout (set = 0, binding = 0) uniform sampler2D accumulation;
+layout (set = 0, binding = 1) uniform sampler2D revealage;
+
+void main()
+{
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	float revealed = exp(-texelFetch(revealage, texel, 0).r);
+	// nothing transparent covers the pixel
+	if (revealed > 0.9999f)
+	{
+		discard;
+	}
+	vec4 accumulated = texelFetch(accumulation, texel, 0);
+	outColor = vec4(accumulated.rgb / max(accumulated.a, 1e-5f), 1.0f - revealed);
+}
@@ -0,0 +1,11 @@
+#version 450
+
+// overdraw view: every fragment adds 1 to the count target's red channel, which the pipeline blends ONE,
+// ONE without testing depth, so a pixel ends up with every layer of the scene over it. Green stays empty
+// where the device has no subgroup quad operations; overdrawQuad.frag fills it elsewhere
+layout (location = 0) out vec2 outCount;
+
+void main()
+{
+	outCount = vec2(1.0, 0.0);
+}
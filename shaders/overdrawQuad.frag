@@ -0,0 +1,15 @@
+#version 450
+#extension GL_KHR_shader_subgroup_quad : require
+
+// overdraw.frag plus the quads: each fragment also adds its share of its 2x2 quad, 1 over the quad's lanes
+// that cover a pixel, to green. A shaded quad adds 1 there however little of it the triangle covers, so
+// the frame's green over its red is how many of the invocations the GPU paid for drew something; the rest
+// were helpers, there only for the derivatives
+layout (location = 0) out vec2 outCount;
+
+void main()
+{
+	float covered = gl_HelperInvocation ? 0.0 : 1.0;
+	float lanes = covered + subgroupQuadSwapHorizontal(covered) + subgroupQuadSwapVertical(covered) + subgroupQuadSwapDiagonal(covered);
+	outCount = vec2(1.0, 1.0 / lanes);
+}
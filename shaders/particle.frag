@@ -0,0 +1,13 @@
+#version 450
+
+// a soft round spot, added onto what's behind it
+layout (location = 0) in vec3 inColor;
+layout (location = 1) in vec2 inCorner;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main()
+{
+	float falloff = max(1.0f - dot(inCorner, inCorner), 0.0f);
+	outFragColor = vec4(inColor * falloff * falloff, 1.0f);
+}
@@ -0,0 +1,56 @@
+#version 450
+#extension GL_EXT_multiview : require
+
+// one camera-facing quad per alive particle: the instance indexes the list ParticleSystem::update left,
+// the six vertices are its two triangles. Sparks start white-hot and cool to red as they age
+layout (set = 0, binding = 0) uniform CameraBuffer
+{
+	mat4 view;
+	mat4 proj;
+	mat4 viewproj;
+	layout (offset = 624) mat4 eyeViewProj[2];
+} cameraData;
+
+struct Particle
+{
+	vec4 positionAge;
+	vec4 velocityLifetime;
+};
+
+layout (std430, set = 1, binding = 0) readonly buffer Particles
+{
+	Particle particles[];
+} pool;
+
+layout (std430, set = 1, binding = 1) readonly buffer AliveLists
+{
+	uint alive[];
+} aliveLists;
+
+layout (push_constant) uniform constants
+{
+	uint aliveBase; // first entry of the list being drawn
+	float size; // half size of the quad, world units
+} draw;
+
+layout (location = 0) out vec3 outColor;
+layout (location = 1) out vec2 outCorner;
+
+const vec2 CORNERS[6] = vec2[6](vec2(-1.0f, -1.0f), vec2(1.0f, -1.0f), vec2(1.0f, 1.0f),
+	vec2(-1.0f, -1.0f), vec2(1.0f, 1.0f), vec2(-1.0f, 1.0f));
+
+void main()
+{
+	Particle particle = pool.particles[aliveLists.alive[draw.aliveBase + gl_InstanceIndex]];
+	vec2 corner = CORNERS[gl_VertexIndex];
+
+	// the view matrix's rows are the camera's right and up axes in world space
+	vec3 right = vec3(cameraData.view[0][0], cameraData.view[1][0], cameraData.view[2][0]);
+	vec3 up = vec3(cameraData.view[0][1], cameraData.view[1][1], cameraData.view[2][1]);
+	vec3 position = particle.positionAge.xyz + (right * corner.x + up * corner.y) * draw.size;
+	gl_Position = cameraData.eyeViewProj[gl_ViewIndex] * vec4(position, 1.0f);
+
+	float t = clamp(particle.positionAge.w / particle.velocityLifetime.w, 0.0f, 1.0f);
+	outColor = mix(vec3(1.0f, 0.9f, 0.6f), vec3(0.9f, 0.15f, 0.02f), t) * (1.0f - t);
+	outCorner = corner;
+}
@@ -0,0 +1,71 @@
+// included by the particle compute shaders: the pool, the lists, the counters and the push constants of
+// ParticleSystem (see ParticleSystem.h). Needs GL_GOOGLE_include_directive
+
+struct Particle
+{
+	vec4 positionAge; // w seconds since emission
+	vec4 velocityLifetime; // w seconds it lives
+};
+
+layout (std430, set = 0, binding = 0) buffer Particles
+{
+	Particle particles[];
+} pool;
+
+// two lists of particle indices, capacity entries each
+layout (std430, set = 0, binding = 1) buffer AliveLists
+{
+	uint alive[];
+} aliveLists;
+
+// free particle indices, a stack deadCount deep
+layout (std430, set = 0, binding = 2) buffer DeadList
+{
+	uint dead[];
+} deadList;
+
+// ParticleCounters; the dispatch and draw arguments are read by the indirect commands
+layout (std430, set = 0, binding = 3) buffer Counters
+{
+	uint aliveCount[2];
+	uint deadCount;
+	uint emitCount;
+	uint emitDispatch[3];
+	uint simulateDispatch[3];
+	uint drawVertexCount;
+	uint drawInstanceCount;
+	uint drawFirstVertex;
+	uint drawFirstInstance;
+} counters;
+
+layout (push_constant) uniform constants
+{
+	vec4 emitterPosition; // w radius
+	vec4 emitterDirection; // w cosine of the cone's half angle
+	vec4 gravity; // w drag
+	float speed;
+	float lifetime;
+	float deltaTime;
+	uint emitCount;
+	uint capacity;
+	uint current; // list emitted into and simulated from; survivors go to the other
+	uint seed;
+	uint mode;
+} params;
+
+const uint PARTICLE_GROUP_SIZE = 64;
+
+// PCG hash; a well mixed uint from any input
+uint hash(uint value)
+{
+	uint state = value * 747796405u + 2891336453u;
+	uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+// uniform in [0, 1)
+float random(inout uint state)
+{
+	state = hash(state);
+	return float(state >> 8) / 16777216.0f;
+}
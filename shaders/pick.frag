@@ -0,0 +1,11 @@
+#version 450
+
+// object picking: the nearest fragment's GPU scene slot, offset by one so the cleared 0 means nothing
+layout (location = 0) flat in uint object;
+
+layout (location = 0) out uint outObject;
+
+void main()
+{
+	outObject = object + 1;
+}
@@ -0,0 +1,26 @@
+#version 450
+#extension GL_EXT_multiview : require
+
+// object picking: depthPrepassInstanced.vert, plus the GPU scene slot the cull pass stored next to each
+// surviving instance's transform
+layout (location = 0) in vec3 vPosition;
+layout (location = 3) in mat4 instanceModel;
+layout (location = 7) in uint instanceObject;
+
+layout (location = 0) flat out uint object;
+
+layout (set = 0, binding = 0) uniform CameraBuffer
+{
+	mat4 view;
+	mat4 proj;
+	mat4 viewproj;
+	layout (offset = 624) mat4 eyeViewProj[2];
+} cameraData;
+
+invariant gl_Position;
+
+void main()
+{
+	object = instanceObject;
+	gl_Position = cameraData.eyeViewProj[gl_ViewIndex] * instanceModel * vec4(vPosition, 1.0f);
+}
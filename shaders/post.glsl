@@ -0,0 +1,25 @@
+// included by the post-processing kernels: the bindings and push constants they share (see PostProcess.h).
+// The source is sampled with linear filtering and clamped addressing; images are RGBA16F throughout
+
+layout (set = 0, binding = 0) uniform sampler2D source;
+// the composite's bloom; the other kernels find their source bound here again
+layout (set = 0, binding = 1) uniform sampler2D secondary;
+layout (set = 0, binding = 2, rgba16f) uniform writeonly image2D destination;
+
+layout (push_constant) uniform constants
+{
+	vec4 params; // what each kernel's own header says
+	vec2 sourceTexel; // 1 / size of the source image
+	vec2 secondaryTexel; // 1 / size of the secondary image
+	uvec2 size; // pixels of destination written, from the top-left
+} post;
+
+bool outside(uvec2 pixel)
+{
+	return any(greaterThanEqual(pixel, post.size));
+}
+
+float luma(vec3 color)
+{
+	return dot(color, vec3(0.2126f, 0.7152f, 0.0722f));
+}
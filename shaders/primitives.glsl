@@ -0,0 +1,66 @@
+// included by the prim*.comp kernels of ComputePrimitives (see ComputePrimitives.h): the push constants they
+// all share and a workgroup-wide exclusive sum on subgroup arithmetic. Needs GL_GOOGLE_include_directive and
+// GL_KHR_shader_subgroup_arithmetic; every kernel binds only the buffers it uses, in set 0
+
+// ComputePrimitives::GROUP_SIZE
+#define PRIMITIVE_GROUP_SIZE 256
+// ComputePrimitives::SCAN_BLOCK: 4 elements an invocation
+#define PRIMITIVE_SCAN_BLOCK 1024
+// ComputePrimitives::RADIX_BITS: a digit's bits, and the buckets per pass they make
+#define RADIX_BITS 4
+#define RADIX_BUCKETS 16
+
+layout (local_size_x = PRIMITIVE_GROUP_SIZE) in;
+
+// PrimitivePushConstants
+layout (push_constant) uniform constants
+{
+	uint count; // elements the dispatch covers
+	uint shift; // radix passes: the digit's lowest key bit
+	uint keyWords; // radix passes: 1 for 32-bit keys, 2 for 64-bit ones as low word, high word
+	uint blockCount; // workgroups the dispatch was split into
+} primitive;
+
+// the most a workgroup holds, at the smallest subgroup size Vulkan allows
+const uint MAX_SUBGROUPS = PRIMITIVE_GROUP_SIZE / 4;
+shared uint subgroupSums[MAX_SUBGROUPS];
+shared uint workgroupSum;
+
+// the sum of value over the invocations of the workgroup before this one, and in total over all of them.
+// Subgroups go in subgroup order, which is invocation order for the one-dimensional groups here.
+// Call once, from uniform control flow
+uint workgroup_exclusive_sum(uint value, out uint total)
+{
+	uint inclusive = subgroupInclusiveAdd(value);
+	if (gl_SubgroupInvocationID == gl_SubgroupSize - 1)
+	{
+		subgroupSums[gl_SubgroupID] = inclusive;
+	}
+	barrier();
+
+	// the first subgroup scans the subgroups' sums, its width at a time, which is all of them at once
+	// unless subgroups are narrower than 16
+	if (gl_SubgroupID == 0)
+	{
+		uint carry = 0;
+		for (uint first = 0; first < gl_NumSubgroups; first += gl_SubgroupSize)
+		{
+			uint index = first + gl_SubgroupInvocationID;
+			uint sum = index < gl_NumSubgroups ? subgroupSums[index] : 0;
+			uint exclusive = subgroupExclusiveAdd(sum);
+			if (index < gl_NumSubgroups)
+			{
+				subgroupSums[index] = carry + exclusive;
+			}
+			carry += subgroupAdd(sum);
+		}
+		if (gl_SubgroupInvocationID == 0)
+		{
+			workgroupSum = carry;
+		}
+	}
+	barrier();
+
+	total = workgroupSum;
+	return subgroupSums[gl_SubgroupID] + inclusive - value;
+}
@@ -0,0 +1,72 @@
+// included by the mesh fragment shaders: the full camera block and cascaded shadow lookup.
+// Needs GL_GOOGLE_include_directive; the vertex stages declare only the part of the block they read
+
+layout (set = 0, binding = 0) uniform CameraBuffer
+{
+	mat4 view;
+	mat4 proj;
+	mat4 viewproj;
+	vec4 frustumPlanes[6];
+	vec4 position;
+	mat4 shadowViewProj[4];
+	vec4 shadowSplits; // view-space depth where each cascade ends
+	vec4 lightDirection; // xyz the direction the light travels, w 1 while the shadow map is rendered, 2 while shadows are ray traced
+	vec4 clusterDepth; // slice = log(view depth) * x + y; zw the render extent in pixels
+	uvec4 clusterGrid; // xyz clusters along each axis
+} cameraData;
+
+// one layer per cascade; the comparison sampler returns how lit a position is
+layout (set = 0, binding = 1) uniform sampler2DArrayShadow shadowMap;
+
+// what the ray tracing pass found at each pixel: red the shadow, green the ambient occlusion
+layout (set = 0, binding = 5) uniform sampler2D rayShadowMask;
+
+// 0 in full shadow, 1 lit; beyond the last cascade everything counts as lit
+float shadow_factor(vec3 worldPosition)
+{
+	if (cameraData.lightDirection.w == 0.0f)
+	{
+		return 1.0f;
+	}
+	if (cameraData.lightDirection.w == 2.0f)
+	{
+		return texelFetch(rayShadowMask, ivec2(gl_FragCoord.xy), 0).r;
+	}
+
+	float depth = -(cameraData.view * vec4(worldPosition, 1.0f)).z;
+	int cascade = 0;
+	while (cascade < 4 && depth > cameraData.shadowSplits[cascade])
+	{
+		cascade++;
+	}
+	if (cascade == 4)
+	{
+		return 1.0f;
+	}
+
+	// orthographic, so w stays 1; the shadow passes keep Vulkan's y-down viewport, so no flip
+	vec3 ndc = (cameraData.shadowViewProj[cascade] * vec4(worldPosition, 1.0f)).xyz;
+	vec2 uv = ndc.xy * 0.5f + 0.5f;
+
+	// 3x3 taps soften the edges; with linear filtering each tap is already a 2x2 comparison
+	vec2 texel = 1.0f / vec2(textureSize(shadowMap, 0).xy);
+	float lit = 0.0f;
+	for (int y = -1; y <= 1; y++)
+	{
+		for (int x = -1; x <= 1; x++)
+		{
+			lit += texture(shadowMap, vec4(uv + vec2(x, y) * texel, cascade, ndc.z));
+		}
+	}
+	return lit / 9.0f;
+}
+
+// how much of the sky the fragment's surroundings leave open, 1 without ray tracing
+float ambient_occlusion()
+{
+	if (cameraData.lightDirection.w != 2.0f)
+	{
+		return 1.0f;
+	}
+	return texelFetch(rayShadowMask, ivec2(gl_FragCoord.xy), 0).g;
+}
@@ -0,0 +1,16 @@
+#version 450
+
+// shadow caster: depth only, seen from one cascade of the directional light. Takes the position
+// attribute of any vertex format, like depthPrepass.vert
+layout (location = 0) in vec3 vPosition;
+
+// cascade view-projection * world * dequantize, per object and cascade
+layout( push_constant ) uniform constants
+{
+	mat4 lightMvp;
+} PushConstants;
+
+void main()
+{
+	gl_Position = PushConstants.lightMvp * vec4(vPosition, 1.0f);
+}
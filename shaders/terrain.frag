@@ -0,0 +1,39 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+// the terrain's ground, coloured by height and slope and lit like the mesh materials by the sun as well
+layout (location = 0) in vec3 worldPosition;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in float inHeight;
+
+layout (location = 0) out vec4 outColor;
+
+#include "shadow.glsl"
+#include "lights.glsl"
+
+// the lit variant adds the clustered point lights, as for the meshes
+layout (constant_id = 0) const bool LIT = false;
+
+// light left in full shadow
+const float AMBIENT = 0.35f;
+
+const vec3 GRASS = vec3(0.22f, 0.36f, 0.12f);
+const vec3 ROCK = vec3(0.36f, 0.33f, 0.30f);
+const vec3 SNOW = vec3(0.90f, 0.92f, 0.95f);
+
+void main()
+{
+	vec3 normal = normalize(inNormal);
+	// steep ground is bare rock, and only the flatter parts of the peaks hold snow
+	float flatness = smoothstep(0.65f, 0.85f, normal.y);
+	vec3 albedo = mix(ROCK, GRASS, flatness);
+	albedo = mix(albedo, SNOW, smoothstep(0.7f, 0.8f, inHeight) * flatness);
+
+	float sun = max(dot(normal, -normalize(cameraData.lightDirection.xyz)), 0.0f);
+	vec3 light = vec3(mix(AMBIENT * ambient_occlusion(), 1.0f, shadow_factor(worldPosition) * sun));
+	if (LIT)
+	{
+		light += clustered_lighting(worldPosition);
+	}
+	outColor = vec4(albedo * light, 1.0f);
+}
@@ -0,0 +1,97 @@
+#version 450
+#extension GL_EXT_multiview : require
+
+// one node of the terrain's quadtree per instance (see GpuTerrainNode), the same PATCH x PATCH grid for each:
+// the vertex index is the grid point, its height bilinear from the node's tile. Towards the end of the node's
+// range its odd vertices slide onto their even neighbours, turning the grid into its parent's one
+layout (set = 0, binding = 0) uniform CameraBuffer
+{
+	mat4 view;
+	mat4 proj;
+	mat4 viewproj;
+	vec4 frustumPlanes[6];
+	vec4 position;
+	layout (offset = 624) mat4 eyeViewProj[2];
+} cameraData;
+
+// the tile cache: TILE_SIDE x TILE_SIDE 16-bit heights per slot, two to a word, a border sample round the grid
+layout (set = 1, binding = 0) readonly buffer Tiles
+{
+	uint words[];
+} tiles;
+
+layout (push_constant) uniform Constants
+{
+	vec4 grid; // x world units between samples, y the world x and z of the first, z the last sample's index
+	vec4 height; // x the lowest sample's height, y world units per 16-bit step
+} constants;
+
+layout (location = 0) in vec4 node; // xy the first sample, z the stride, w the level
+layout (location = 1) in vec2 morph; // start, end
+layout (location = 2) in float slot;
+
+layout (location = 0) out vec3 outWorldPosition;
+layout (location = 1) out vec3 outNormal;
+layout (location = 2) out float outHeight; // 0 at the lowest sample, 1 at the highest
+
+const uint PATCH = 32;
+const uint TILE_SIDE = PATCH + 3;
+const uint TILE_WORDS = (TILE_SIDE * TILE_SIDE + 1) / 2;
+
+float tile_sample(uint base, ivec2 texel)
+{
+	texel = clamp(texel, ivec2(0), ivec2(TILE_SIDE - 1));
+	uint index = uint(texel.y) * TILE_SIDE + uint(texel.x);
+	uint word = tiles.words[base + index / 2];
+	return float((word >> ((index & 1) * 16)) & 0xffff);
+}
+
+// bilinear between the samples around grid point g, in 16-bit steps
+float tile_height(uint base, vec2 g)
+{
+	vec2 texel = g + 1.0f;
+	ivec2 corner = ivec2(floor(texel));
+	vec2 t = texel - vec2(corner);
+	float a = mix(tile_sample(base, corner), tile_sample(base, corner + ivec2(1, 0)), t.x);
+	float b = mix(tile_sample(base, corner + ivec2(0, 1)), tile_sample(base, corner + ivec2(1, 1)), t.x);
+	return mix(a, b, t.y);
+}
+
+// grid point g folded onto the field's last sample past its edge, still in grid points
+vec2 fold(vec2 g)
+{
+	return (min(node.xy + g * node.z, vec2(constants.grid.z)) - node.xy) / node.z;
+}
+
+vec3 world_position(vec2 g, float h)
+{
+	vec2 xz = constants.grid.y + (node.xy + g * node.z) * constants.grid.x;
+	return vec3(xz.x, constants.height.x + h * constants.height.y, xz.y);
+}
+
+void main()
+{
+	uint base = uint(slot) * TILE_WORDS;
+	uint vertex = uint(gl_VertexIndex);
+	vec2 g = vec2(vertex % (PATCH + 1), vertex / (PATCH + 1));
+
+	// the unmorphed position decides how far along the morph it is
+	vec2 folded = fold(g);
+	vec3 world = world_position(folded, tile_height(base, folded));
+	float k = clamp((distance(world, cameraData.position.xyz) - morph.x) / (morph.y - morph.x), 0.0f, 1.0f);
+	g -= fract(g * 0.5f) * 2.0f * k;
+
+	folded = fold(g);
+	float h = tile_height(base, folded);
+	world = world_position(folded, h);
+
+	// central differences one stride either side, which the tile's border keeps inside it
+	float span = 2.0f * node.z * constants.grid.x;
+	float dx = (tile_height(base, folded + vec2(1.0f, 0.0f)) - tile_height(base, folded - vec2(1.0f, 0.0f))) * constants.height.y / span;
+	float dz = (tile_height(base, folded + vec2(0.0f, 1.0f)) - tile_height(base, folded - vec2(0.0f, 1.0f))) * constants.height.y / span;
+
+	gl_Position = cameraData.eyeViewProj[gl_ViewIndex] * vec4(world, 1.0f);
+	outWorldPosition = world;
+	outNormal = normalize(vec3(-dx, 1.0f, -dz));
+	outHeight = h / 65535.0f;
+}
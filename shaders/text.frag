@@ -0,0 +1,22 @@
+#version 450
+
+// the glyph's distance thresholded at its outline, 0.5, over the width of a pixel, so any size is as sharp
+// as the screen allows; a dark rim just outside keeps labels readable over whatever is behind them
+layout (location = 0) in vec2 inUv;
+layout (location = 1) in vec4 inColor;
+
+layout (location = 0) out vec4 outFragColor;
+
+layout (set = 0, binding = 0) uniform sampler2D atlas;
+
+// how far out the rim reaches, in the atlas's distance (SdfFontBakeSettings::padding texels make 0.5)
+const float RIM = 0.12f;
+
+void main()
+{
+	float distance = texture(atlas, inUv).r;
+	float edge = max(fwidth(distance), 1e-4f);
+	float fill = smoothstep(0.5f - edge, 0.5f + edge, distance);
+	float rim = smoothstep(0.5f - RIM - edge, 0.5f - RIM + edge, distance);
+	outFragColor = vec4(inColor.rgb * fill, inColor.a * rim);
+}
@@ -0,0 +1,45 @@
+#version 450
+
+// one quad per glyph of the frame's text (see GpuGlyphInstance), the six vertices its two triangles, placed
+// in window pixels: a label's anchor is projected first and the glyph keeps its size in pixels around it
+layout (location = 0) in vec4 anchor; // world position with w 1, window pixels with w 0
+layout (location = 1) in vec4 rect; // top left from the anchor and size, in pixels
+layout (location = 2) in vec4 uvRect; // left, top, right, bottom in the atlas
+layout (location = 3) in vec4 color;
+
+layout (push_constant) uniform constants
+{
+	mat4 viewProjection;
+	vec4 screen; // 2 / width, 2 / height, width, height
+} pushConstants;
+
+layout (location = 0) out vec2 outUv;
+layout (location = 1) out vec4 outColor;
+
+const vec2 CORNERS[6] = vec2[6](vec2(0.0f, 0.0f), vec2(1.0f, 0.0f), vec2(1.0f, 1.0f),
+	vec2(0.0f, 0.0f), vec2(1.0f, 1.0f), vec2(0.0f, 1.0f));
+
+void main()
+{
+	vec2 origin = anchor.xy;
+	if (anchor.w != 0.0f)
+	{
+		vec4 clip = pushConstants.viewProjection * vec4(anchor.xyz, 1.0f);
+		// behind the camera: every corner in the same place, which draws nothing
+		if (clip.w <= 0.0f)
+		{
+			gl_Position = vec4(-2.0f, -2.0f, 0.0f, 1.0f);
+			outUv = vec2(0.0f);
+			outColor = vec4(0.0f);
+			return;
+		}
+		origin = (clip.xy / clip.w * 0.5f + 0.5f) * pushConstants.screen.zw;
+	}
+
+	vec2 corner = CORNERS[gl_VertexIndex];
+	// whole pixels for the anchor, so a label doesn't shimmer as it moves across them
+	vec2 pixel = floor(origin + 0.5f) + rect.xy + corner * rect.zw;
+	gl_Position = vec4(pixel * pushConstants.screen.xy - 1.0f, 0.0f, 1.0f);
+	outUv = mix(uvRect.xy, uvRect.zw, corner);
+	outColor = color;
+}
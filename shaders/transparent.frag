@@ -0,0 +1,13 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+// sorted transparency: premultiplied, blended ONE, ONE_MINUS_SRC_ALPHA over what the farther objects left
+layout (location = 0) out vec4 outColor;
+
+#include "transparent.glsl"
+
+void main()
+{
+	vec4 color = shade_transparent();
+	outColor = vec4(color.rgb * color.a, color.a);
+}
@@ -0,0 +1,33 @@
+// included by the transparent fragment shaders: the object's color, lit like the mesh materials.
+// Needs GL_GOOGLE_include_directive
+
+layout (location = 0) in vec3 worldPosition;
+
+// TransparentPushConstants
+layout( push_constant ) uniform constants
+{
+	mat4 model;
+	vec4 color;
+} PushConstants;
+
+#include "shadow.glsl"
+#include "lights.glsl"
+
+// the clustered point lights too, as in the lit mesh variant
+layout (constant_id = 0) const bool LIT = false;
+
+// light left in full shadow
+const float AMBIENT = 0.35f;
+
+// straight rgb and the object's opacity. The traced mask is of the opaque surface behind, so without the
+// cascades only the sun's direction is left
+vec4 shade_transparent()
+{
+	float shadow = cameraData.lightDirection.w == 2.0f ? 1.0f : shadow_factor(worldPosition);
+	vec3 light = vec3(mix(AMBIENT, 1.0f, shadow));
+	if (LIT)
+	{
+		light += clustered_lighting(worldPosition);
+	}
+	return vec4(PushConstants.color.rgb * light, PushConstants.color.a);
+}
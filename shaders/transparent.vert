@@ -0,0 +1,28 @@
+#version 450
+#extension GL_EXT_multiview : require
+
+// transparent objects: any of the interleaved or split vertex formats, whose positions share location 0
+layout (location = 0) in vec3 vPosition;
+
+layout (location = 0) out vec3 worldPosition;
+
+layout (set = 0, binding = 0) uniform CameraBuffer
+{
+	mat4 view;
+	mat4 proj;
+	mat4 viewproj;
+	layout (offset = 624) mat4 eyeViewProj[2];
+} cameraData;
+
+// TransparentPushConstants; the color is the fragment stages'
+layout( push_constant ) uniform constants
+{
+	mat4 model;
+	vec4 color;
+} PushConstants;
+
+void main()
+{
+	worldPosition = vec3(PushConstants.model * vec4(vPosition, 1.0f));
+	gl_Position = cameraData.eyeViewProj[gl_ViewIndex] * vec4(worldPosition, 1.0f);
+}
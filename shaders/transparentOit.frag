@@ -0,0 +1,25 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+// weighted blended transparency (McGuire and Bavoil 2013), in any order. Both targets only ever add, so one
+// blend state serves both and no independent blending is needed: the first sums the weighted premultiplied
+// colors, the second -log(1 - alpha), whose exp(-sum) is the product of (1 - alpha) the paper's
+// revealage multiplies up
+layout (location = 0) out vec4 outAccumulation;
+layout (location = 1) out float outRevealage;
+
+#include "transparent.glsl"
+
+void main()
+{
+	vec4 color = shade_transparent();
+	// fully opaque would make the log infinite
+	float alpha = min(color.a, 0.999f);
+
+	// the paper's equation 9, from view depth, so reverse z doesn't change it: near layers outweigh far ones
+	float depth = -(cameraData.view * vec4(worldPosition, 1.0f)).z;
+	float weight = clamp(10.0f / (1e-5f + pow(depth / 5.0f, 2.0f) + pow(depth / 200.0f, 6.0f)), 1e-2f, 3e3f);
+
+	outAccumulation = vec4(color.rgb * alpha, alpha) * weight;
+	outRevealage = -log(1.0f - alpha);
+}
@@ -0,0 +1,57 @@
+// programmable vertex pulling: the mesh pool's vertex streams read as storage buffers by gl_VertexIndex,
+// which the draw's vertexOffset has already moved into the mesh's range, so one pipeline with no vertex
+// input state draws every VertexFormat. The layouts are the ones meshlet.mesh reads: Vertex (9 floats),
+// PackedVertex (4 uints) and the two bindings of the Split stream
+layout (std430, set = 3, binding = 0) readonly buffer PulledFullVertices
+{
+	float values[];
+} pulledFull;
+
+layout (std430, set = 3, binding = 1) readonly buffer PulledPackedVertices
+{
+	uint values[];
+} pulledPacked;
+
+layout (std430, set = 3, binding = 2) readonly buffer PulledSplitPositions
+{
+	float values[];
+} pulledSplitPositions;
+
+layout (std430, set = 3, binding = 3) readonly buffer PulledSplitAttributes
+{
+	float values[];
+} pulledSplitAttributes;
+
+// what the mesh vertex shaders read of a vertex; the normal isn't among it
+struct PulledVertex
+{
+	vec3 position;
+	vec3 color;
+};
+
+// vertexFormat as on the CPU: 0 Full, 1 Packed, 2 Split
+PulledVertex pull_vertex(uint vertexFormat, uint index)
+{
+	PulledVertex vertex;
+	if (vertexFormat == 1)
+	{
+		// what the unorm16/unorm8 vertex fetch does; the model matrix carries the dequantize transform
+		uint base = index * 4;
+		vertex.position = vec3(unpackUnorm2x16(pulledPacked.values[base]), unpackUnorm2x16(pulledPacked.values[base + 1]).x);
+		vertex.color = unpackUnorm4x8(pulledPacked.values[base + 3]).rgb;
+	}
+	else if (vertexFormat == 2)
+	{
+		uint base = index * 3;
+		vertex.position = vec3(pulledSplitPositions.values[base], pulledSplitPositions.values[base + 1], pulledSplitPositions.values[base + 2]);
+		base = index * 6;
+		vertex.color = vec3(pulledSplitAttributes.values[base + 3], pulledSplitAttributes.values[base + 4], pulledSplitAttributes.values[base + 5]);
+	}
+	else
+	{
+		uint base = index * 9;
+		vertex.position = vec3(pulledFull.values[base], pulledFull.values[base + 1], pulledFull.values[base + 2]);
+		vertex.color = vec3(pulledFull.values[base + 6], pulledFull.values[base + 7], pulledFull.values[base + 8]);
+	}
+	return vertex;
+}
@@ -0,0 +1,68 @@
+// included by fragment shaders sampling a VirtualTexture (see VirtualTexture.h): the page table lookup into
+// the cache atlas, and the feedback that tells the engine which pages were wanted.
+// The set defaults to 2; define VIRTUAL_TEXTURE_SET before the include to move it
+
+#ifndef VIRTUAL_TEXTURE_SET
+#define VIRTUAL_TEXTURE_SET 2
+#endif
+
+// VirtualTexture::PAGE_SIZE, PAGE_BORDER and SLOT_SIZE
+const float VT_PAGE_SIZE = 128.0f;
+const float VT_PAGE_BORDER = 4.0f;
+const float VT_SLOT_SIZE = 136.0f;
+
+// one texel per page of every level: rg the atlas slot standing in for it, b the level of the page in
+// that slot (the page itself or an ancestor), a 0 while nothing is cached at all
+layout (set = VIRTUAL_TEXTURE_SET, binding = 0) uniform usampler2D vtPageTable;
+layout (set = VIRTUAL_TEXTURE_SET, binding = 1) uniform sampler2D vtAtlas;
+
+// one word per page, nonzero once a pixel wanted it; cleared every frame
+layout (std430, set = VIRTUAL_TEXTURE_SET, binding = 2) writeonly buffer VirtualTextureFeedback
+{
+	uint pages[];
+} vtFeedback;
+
+// pages are numbered like the engine does: level by level, finest first, row by row
+uint vt_page_index(ivec2 page, int level)
+{
+	uint first = 0;
+	for (int i = 0; i < level; i++)
+	{
+		ivec2 pages = textureSize(vtPageTable, i);
+		first += uint(pages.x * pages.y);
+	}
+	return first + uint(page.y * textureSize(vtPageTable, level).x + page.x);
+}
+
+// the texture at uv, repeating, from the finest cached page at or above the level the pixel footprint
+// asks for. Bilinear within that level only: the atlas has no mips to blend with.
+// One pixel in 16 records the page it wanted, which is plenty to find every page on screen
+vec4 sample_virtual_texture(vec2 uv)
+{
+	// derivatives first, while every invocation of the quad is still running
+	vec2 texels = vec2(textureSize(vtPageTable, 0)) * VT_PAGE_SIZE;
+	vec2 dx = dFdx(uv) * texels;
+	vec2 dy = dFdy(uv) * texels;
+	float lod = 0.5f * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8f));
+	int wanted = clamp(int(floor(lod)), 0, textureQueryLevels(vtPageTable) - 1);
+
+	vec2 wrapped = fract(uv);
+	ivec2 levelPages = textureSize(vtPageTable, wanted);
+	ivec2 page = min(ivec2(wrapped * vec2(levelPages)), levelPages - 1);
+	if (((uint(gl_FragCoord.x) | uint(gl_FragCoord.y)) & 3u) == 0u)
+	{
+		vtFeedback.pages[vt_page_index(page, wanted)] = 1u;
+	}
+
+	uvec4 entry = texelFetch(vtPageTable, page, wanted);
+	if (entry.a == 0u)
+	{
+		return vec4(0.5f, 0.5f, 0.5f, 1.0f);
+	}
+
+	// where uv falls in the cached page, which covers more of the texture the coarser its level is
+	vec2 inLevel = wrapped * (texels / exp2(float(entry.b)));
+	vec2 inPage = inLevel - floor(inLevel / VT_PAGE_SIZE) * VT_PAGE_SIZE;
+	vec2 atlasTexel = vec2(entry.rg) * VT_SLOT_SIZE + VT_PAGE_BORDER + inPage;
+	return textureLod(vtAtlas, atlasTexel / vec2(textureSize(vtAtlas, 0)), 0.0f);
+}
@@ -0,0 +1,9 @@
+// VoxelVertex carries the face it belongs to instead of a normal: axis * 2, plus 1 for the - side.
+// Faces are shaded by a fixed light per face, tops brightest, so neighbouring blocks of one type still
+// read apart without lighting a normal
+const float VOXEL_FACE_SHADE[6] = float[6](0.8f, 0.8f, 1.0f, 0.5f, 0.9f, 0.9f);
+
+vec3 voxel_face_color(vec3 color, float face)
+{
+	return color * VOXEL_FACE_SHADE[min(uint(face), 5u)];
+}
@@ -0,0 +1,44 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_multiview : require
+
+// instancedMesh.vert for VoxelVertex chunks, as voxel.vert
+#include "voxel.glsl"
+
+layout (location = 0) in vec4 vPositionFace;
+layout (location = 2) in vec3 vColor;
+
+// per-instance model matrix, one vec4 column per location
+layout (location = 3) in mat4 instanceModel;
+
+layout (location = 0) out vec3 vertColor;
+layout (location = 1) flat out uint materialIndex;
+layout (location = 2) out vec3 worldPosition;
+
+// written once per frame, bound with a dynamic offset
+layout (set = 0, binding = 0) uniform CameraBuffer
+{
+	mat4 view;
+	mat4 proj;
+	mat4 viewproj;
+	layout (offset = 624) mat4 eyeViewProj[2];
+} cameraData;
+
+// same block as helloTriangleMesh.vert; the model matrix is left unused here
+layout( push_constant ) uniform constants
+{
+	mat4 model;
+	uint materialIndex;
+} PushConstants;
+
+// must match depthPrepass*.vert bit for bit, or the EQUAL depth test of pre-passed materials fails
+invariant gl_Position;
+
+void main()
+{
+	vec3 vPosition = vPositionFace.xyz;
+	vertColor = voxel_face_color(vColor, vPositionFace.w);
+	materialIndex = PushConstants.materialIndex;
+	worldPosition = vec3(instanceModel * vec4(vPosition, 1.0f));
+	gl_Position = cameraData.eyeViewProj[gl_ViewIndex] * instanceModel * vec4(vPosition, 1.0f);
+}
@@ -0,0 +1,619 @@
+#include "AccelerationStructures.h"
+
+#include "Log.h"
+#include "vk_initializers.h"
+
+#include <algorithm>
+
+#ifdef VK_KHR_ray_query
+
+namespace {
+	// VkAccelerationStructureInstanceKHR, as tlasInstances.comp writes it
+	constexpr VkDeviceSize INSTANCE_SIZE = 64;
+	static_assert(sizeof(VkAccelerationStructureInstanceKHR) == INSTANCE_SIZE, "tlasInstances.comp writes 64-byte instances");
+
+	VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	uint32_t index_size(VkIndexType indexType)
+	{
+		return indexType == VK_INDEX_TYPE_UINT16 ? 2 : 4;
+	}
+
+	VkAccelerationStructureGeometryKHR instance_geometry(VkDeviceAddress instances)
+	{
+		VkAccelerationStructureGeometryKHR geometry = {};
+		geometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+		geometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+		geometry.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
+		geometry.geometry.instances.arrayOfPointers = VK_FALSE;
+		geometry.geometry.instances.data.deviceAddress = instances;
+		return geometry;
+	}
+
+	VkAccelerationStructureBuildGeometryInfoKHR build_info(VkAccelerationStructureTypeKHR type, VkBuildAccelerationStructureFlagsKHR flags,
+		const VkAccelerationStructureGeometryKHR* geometry)
+	{
+		VkAccelerationStructureBuildGeometryInfoKHR info = {};
+		info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+		info.type = type;
+		info.flags = flags;
+		info.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+		info.geometryCount = 1;
+		info.pGeometries = geometry;
+		return info;
+	}
+
+	VkMemoryBarrier memory_barrier(VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+	{
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+		return barrier;
+	}
+}
+
+bool AccelerationStructures::init(VkDevice device, VkPhysicalDevice physicalDevice, VmaAllocator allocator, DescriptorAllocator& descriptors,
+	const MeshPool& pool, const std::vector<VertexLayout>& layouts, VkBuffer sceneBuffer, uint32_t maxInstances, VkShaderModule instanceShader,
+	VkPipelineCache cache, uint32_t frameCount)
+{
+	_device = device;
+	_allocator = allocator;
+	_pool = &pool;
+	_layouts = layouts;
+	_maxInstances = maxInstances;
+
+	_vkCreateAccelerationStructure = (PFN_vkCreateAccelerationStructureKHR)vkGetDeviceProcAddr(_device, "vkCreateAccelerationStructureKHR");
+	_vkDestroyAccelerationStructure = (PFN_vkDestroyAccelerationStructureKHR)vkGetDeviceProcAddr(_device, "vkDestroyAccelerationStructureKHR");
+	_vkGetAccelerationStructureBuildSizes = (PFN_vkGetAccelerationStructureBuildSizesKHR)vkGetDeviceProcAddr(_device, "vkGetAccelerationStructureBuildSizesKHR");
+	_vkGetAccelerationStructureDeviceAddress = (PFN_vkGetAccelerationStructureDeviceAddressKHR)vkGetDeviceProcAddr(_device, "vkGetAccelerationStructureDeviceAddressKHR");
+	_vkCmdBuildAccelerationStructures = (PFN_vkCmdBuildAccelerationStructuresKHR)vkGetDeviceProcAddr(_device, "vkCmdBuildAccelerationStructuresKHR");
+	_vkCmdCopyAccelerationStructure = (PFN_vkCmdCopyAccelerationStructureKHR)vkGetDeviceProcAddr(_device, "vkCmdCopyAccelerationStructureKHR");
+	_vkCmdWriteAccelerationStructuresProperties = (PFN_vkCmdWriteAccelerationStructuresPropertiesKHR)vkGetDeviceProcAddr(_device, "vkCmdWriteAccelerationStructuresPropertiesKHR");
+	_vkGetBufferDeviceAddress = (PFN_vkGetBufferDeviceAddressKHR)vkGetDeviceProcAddr(_device, "vkGetBufferDeviceAddressKHR");
+	if (_vkCreateAccelerationStructure == nullptr || _vkDestroyAccelerationStructure == nullptr || _vkGetAccelerationStructureBuildSizes == nullptr
+		|| _vkGetAccelerationStructureDeviceAddress == nullptr || _vkCmdBuildAccelerationStructures == nullptr || _vkCmdCopyAccelerationStructure == nullptr
+		|| _vkCmdWriteAccelerationStructuresProperties == nullptr || _vkGetBufferDeviceAddress == nullptr || instanceShader == VK_NULL_HANDLE)
+	{
+		_vkDestroyAccelerationStructure = nullptr;
+		return false;
+	}
+
+	// vertex formats are only required to build from for a few float and snorm layouts; meshes of the
+	// others are refused by add()
+	for (VertexLayout& layout : _layouts)
+	{
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, layout.format, &formatProperties);
+		if ((formatProperties.bufferFeatures & VK_FORMAT_FEATURE_ACCELERATION_STRUCTURE_VERTEX_BUFFER_BIT_KHR) == 0)
+		{
+			layout.format = VK_FORMAT_UNDEFINED;
+		}
+	}
+
+	VkPhysicalDeviceAccelerationStructurePropertiesKHR structureProperties = {};
+	structureProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR;
+	VkPhysicalDeviceProperties2 properties2 = {};
+	properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties2.pNext = &structureProperties;
+	vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+	_scratchAlignment = std::max<VkDeviceSize>(structureProperties.minAccelerationStructureScratchOffsetAlignment, 1);
+
+	VkDescriptorSetLayoutBinding bindings[] = {
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0), // scene
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1), // bottom-level addresses
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2), // instances
+	};
+
+	VkDescriptorSetLayoutCreateInfo setInfo = {};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setInfo.pNext = nullptr;
+	setInfo.bindingCount = 3;
+	setInfo.pBindings = bindings;
+	VK_CHECK(vkCreateDescriptorSetLayout(_device, &setInfo, nullptr, &_setLayout));
+
+	VkPushConstantRange pushConstant;
+	pushConstant.offset = 0;
+	pushConstant.size = sizeof(uint32_t);
+	pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkPipelineLayoutCreateInfo layoutInfo = vkinit::pipeline_layout_create_info();
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &_setLayout;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushConstant;
+	VK_CHECK(vkCreatePipelineLayout(_device, &layoutInfo, nullptr, &_pipelineLayout));
+
+	VkComputePipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.pNext = nullptr;
+	pipelineInfo.layout = _pipelineLayout;
+	pipelineInfo.stage = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, instanceShader);
+	VK_CHECK(vkCreateComputePipelines(_device, cache, 1, &pipelineInfo, nullptr, &_instancePipeline));
+
+	// room for every slot the scene can have, so the structure is never recreated; refits update it in place
+	const VkAccelerationStructureGeometryKHR geometry = instance_geometry(0);
+	VkAccelerationStructureBuildGeometryInfoKHR tlasInfo = build_info(VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR,
+		VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR, &geometry);
+	VkAccelerationStructureBuildSizesInfoKHR tlasSizes = {};
+	tlasSizes.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+	_vkGetAccelerationStructureBuildSizes(_device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &tlasInfo, &_maxInstances, &tlasSizes);
+	const VkDeviceSize tlasScratchSize = std::max(tlasSizes.buildScratchSize, tlasSizes.updateScratchSize);
+	_tlasScratch = create_buffer(tlasScratchSize + _scratchAlignment, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+		VMA_MEMORY_USAGE_GPU_ONLY);
+	if (!create_structure(VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, tlasSizes.accelerationStructureSize, _tlasBuffer, _tlas)
+		|| _tlasScratch._buffer == VK_NULL_HANDLE)
+	{
+		LOG_ERROR("No memory for a top-level acceleration structure of " << _maxInstances << " instances");
+		cleanup();
+		return false;
+	}
+	_tlasScratchAddress = align_up(buffer_address(_tlasScratch._buffer), _scratchAlignment);
+	_memoryBytes = tlasSizes.accelerationStructureSize;
+
+	_frames.assign(frameCount, FrameSlot{});
+	for (FrameSlot& slot : _frames)
+	{
+		VkQueryPoolCreateInfo queryInfo = {};
+		queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryInfo.queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR;
+		queryInfo.queryCount = MAX_BATCH_BUILDS;
+		VK_CHECK(vkCreateQueryPool(_device, &queryInfo, nullptr, &slot.compactedSizes));
+
+		const VkDeviceSize addressesSize = static_cast<VkDeviceSize>(_maxInstances) * sizeof(uint64_t);
+		const VkDeviceSize instancesSize = static_cast<VkDeviceSize>(_maxInstances) * INSTANCE_SIZE;
+		slot.addresses = create_buffer(addressesSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, true);
+		slot.instances = create_buffer(instancesSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+			| VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR, VMA_MEMORY_USAGE_GPU_ONLY);
+		if (slot.addresses._buffer == VK_NULL_HANDLE || slot.instances._buffer == VK_NULL_HANDLE)
+		{
+			LOG_ERROR("No memory for the acceleration structure instances");
+			cleanup();
+			return false;
+		}
+		VmaAllocationInfo addressesInfo;
+		vmaGetAllocationInfo(_allocator, slot.addresses._allocation, &addressesInfo);
+		slot.mappedAddresses = static_cast<uint64_t*>(addressesInfo.pMappedData);
+		slot.instanceAddress = buffer_address(slot.instances._buffer);
+
+		// every buffer the shader touches stays the same, so the sets are written once
+		descriptors.allocate(&slot.set, _setLayout);
+		VkDescriptorBufferInfo sceneInfo = { sceneBuffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo addressesBufferInfo = { slot.addresses._buffer, 0, addressesSize };
+		VkDescriptorBufferInfo instancesInfo = { slot.instances._buffer, 0, instancesSize };
+		VkWriteDescriptorSet writes[] = {
+			vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, slot.set, &sceneInfo, 0),
+			vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, slot.set, &addressesBufferInfo, 1),
+			vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, slot.set, &instancesInfo, 2),
+		};
+		vkUpdateDescriptorSets(_device, 3, writes, 0, nullptr);
+	}
+
+	_ready = true;
+	return true;
+}
+
+void AccelerationStructures::cleanup()
+{
+	if (_vkDestroyAccelerationStructure == nullptr)
+	{
+		return;
+	}
+
+	for (Structure& structure : _structures)
+	{
+		if (structure.structure != VK_NULL_HANDLE)
+		{
+			_vkDestroyAccelerationStructure(_device, structure.structure, nullptr);
+			vmaDestroyBuffer(_allocator, structure.buffer._buffer, structure.buffer._allocation);
+		}
+	}
+	// the sets go with the descriptor allocator's pools
+	for (FrameSlot& slot : _frames)
+	{
+		for (const Retired& retired : slot.retired)
+		{
+			_vkDestroyAccelerationStructure(_device, retired.structure, nullptr);
+			vmaDestroyBuffer(_allocator, retired.buffer._buffer, retired.buffer._allocation);
+		}
+		vkDestroyQueryPool(_device, slot.compactedSizes, nullptr);
+		vmaDestroyBuffer(_allocator, slot.scratch._buffer, slot.scratch._allocation);
+		vmaDestroyBuffer(_allocator, slot.addresses._buffer, slot.addresses._allocation);
+		vmaDestroyBuffer(_allocator, slot.instances._buffer, slot.instances._allocation);
+	}
+	if (_tlas != VK_NULL_HANDLE)
+	{
+		_vkDestroyAccelerationStructure(_device, _tlas, nullptr);
+	}
+	vmaDestroyBuffer(_allocator, _tlasBuffer._buffer, _tlasBuffer._allocation);
+	vmaDestroyBuffer(_allocator, _tlasScratch._buffer, _tlasScratch._allocation);
+	vkDestroyPipeline(_device, _instancePipeline, nullptr);
+	vkDestroyPipelineLayout(_device, _pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(_device, _setLayout, nullptr);
+
+	_structures.clear();
+	_queue.clear();
+	_instances.clear();
+	_frames.clear();
+	_tlas = VK_NULL_HANDLE;
+	_tlasBuffer = {};
+	_tlasScratch = {};
+	_instancePipeline = VK_NULL_HANDLE;
+	_pipelineLayout = VK_NULL_HANDLE;
+	_setLayout = VK_NULL_HANDLE;
+	_memoryBytes = 0;
+	_tlasBuilt = false;
+	_ready = false;
+}
+
+uint32_t AccelerationStructures::add(const MeshAllocation* allocation, uint32_t indexCount)
+{
+	if (!_ready || _layouts[allocation->vertexStream].format == VK_FORMAT_UNDEFINED || indexCount < 3)
+	{
+		return INVALID_HANDLE;
+	}
+
+	Structure structure = {};
+	structure.allocation = allocation;
+	structure.indexCount = indexCount;
+	_structures.push_back(structure);
+	const uint32_t handle = static_cast<uint32_t>(_structures.size() - 1);
+	_queue.push_back(handle);
+	return handle;
+}
+
+void AccelerationStructures::set_instance(uint32_t sceneSlot, uint32_t handle)
+{
+	if (!_ready || sceneSlot >= _maxInstances)
+	{
+		return;
+	}
+	if (sceneSlot >= _instances.size())
+	{
+		_instances.resize(sceneSlot + 1, INVALID_HANDLE);
+	}
+	if (_instances[sceneSlot] != handle)
+	{
+		_instances[sceneSlot] = handle;
+		_instancesChanged = true;
+	}
+}
+
+void AccelerationStructures::record_builds(VkCommandBuffer cmd, uint32_t frame)
+{
+	if (!_ready)
+	{
+		return;
+	}
+
+	// no frame that could have traced against them is still running
+	FrameSlot& slot = _frames[frame];
+	for (const Retired& retired : slot.retired)
+	{
+		_vkDestroyAccelerationStructure(_device, retired.structure, nullptr);
+		vmaDestroyBuffer(_allocator, retired.buffer._buffer, retired.buffer._allocation);
+	}
+	slot.retired.clear();
+	compact(cmd, slot);
+
+	// oldest first, for as long as the budget lasts
+	VkAccelerationStructureGeometryKHR geometries[MAX_BATCH_BUILDS];
+	VkAccelerationStructureBuildGeometryInfoKHR infos[MAX_BATCH_BUILDS];
+	VkAccelerationStructureBuildRangeInfoKHR ranges[MAX_BATCH_BUILDS];
+	const VkAccelerationStructureBuildRangeInfoKHR* rangePointers[MAX_BATCH_BUILDS];
+	VkDeviceSize scratchOffsets[MAX_BATCH_BUILDS];
+	VkDeviceSize scratchSize = 0;
+	uint64_t triangles = 0;
+	uint32_t batchCount = 0;
+	while (!_queue.empty() && batchCount < MAX_BATCH_BUILDS)
+	{
+		const uint32_t handle = _queue.front();
+		Structure& structure = _structures[handle];
+		const MeshAllocation& allocation = *structure.allocation;
+		const uint32_t triangleCount = structure.indexCount / 3;
+		if (batchCount > 0 && triangles + triangleCount > _trianglesPerFrame)
+		{
+			break;
+		}
+		_queue.pop_front();
+
+		// the indices are relative to the mesh's first vertex, like the draws' vertexOffset has them
+		const VertexLayout& layout = _layouts[allocation.vertexStream];
+		VkAccelerationStructureGeometryKHR& geometry = geometries[batchCount];
+		geometry = {};
+		geometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+		geometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+		geometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+		VkAccelerationStructureGeometryTrianglesDataKHR& trianglesData = geometry.geometry.triangles;
+		trianglesData.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
+		trianglesData.vertexFormat = layout.format;
+		trianglesData.vertexData.deviceAddress = buffer_address(_pool->vertex_buffer(allocation.vertexStream)._buffer)
+			+ _pool->vertex_byte_offset(allocation);
+		trianglesData.vertexStride = layout.stride;
+		trianglesData.maxVertex = allocation.vertexCount - 1;
+		trianglesData.indexType = allocation.indexType;
+		trianglesData.indexData.deviceAddress = buffer_address(_pool->index_buffer(allocation.indexType)._buffer)
+			+ _pool->index_byte_offset(allocation);
+
+		infos[batchCount] = build_info(VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR,
+			VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR, &geometry);
+		VkAccelerationStructureBuildSizesInfoKHR sizes = {};
+		sizes.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+		_vkGetAccelerationStructureBuildSizes(_device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &infos[batchCount], &triangleCount, &sizes);
+		if (!create_structure(VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, sizes.accelerationStructureSize, structure.buffer, structure.structure))
+		{
+			// out of memory: the mesh stays without ray-traced shadows
+			LOG_ERROR("No memory for a bottom-level acceleration structure of " << triangleCount << " triangles");
+			continue;
+		}
+		structure.size = sizes.accelerationStructureSize;
+		_memoryBytes += structure.size;
+		infos[batchCount].dstAccelerationStructure = structure.structure;
+
+		scratchOffsets[batchCount] = scratchSize;
+		scratchSize += align_up(sizes.buildScratchSize, _scratchAlignment);
+		ranges[batchCount] = { triangleCount, 0, 0, 0 };
+		rangePointers[batchCount] = &ranges[batchCount];
+		slot.built.push_back(handle);
+		triangles += triangleCount;
+		batchCount++;
+	}
+	if (batchCount == 0)
+	{
+		return;
+	}
+
+	ensure_scratch(slot, scratchSize);
+	const VkDeviceAddress scratchBase = align_up(buffer_address(slot.scratch._buffer), _scratchAlignment);
+	for (uint32_t i = 0; i < batchCount; i++)
+	{
+		infos[i].scratchData.deviceAddress = scratchBase + scratchOffsets[i];
+	}
+
+	// whatever wrote the pool, uploads acquired for vertex input, compaction copies or the index unpack, is
+	// already visible to one of these stages
+	VkMemoryBarrier toBuild = memory_barrier(VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &toBuild, 0, nullptr, 0, nullptr);
+	vkCmdResetQueryPool(cmd, slot.compactedSizes, 0, batchCount);
+	_vkCmdBuildAccelerationStructures(cmd, batchCount, infos, rangePointers);
+
+	// the compacted sizes are only known once the builds are done
+	VkMemoryBarrier toQuery = memory_barrier(VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR, VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+		0, 1, &toQuery, 0, nullptr, 0, nullptr);
+	VkAccelerationStructureKHR built[MAX_BATCH_BUILDS];
+	for (uint32_t i = 0; i < batchCount; i++)
+	{
+		Structure& structure = _structures[slot.built[i]];
+		built[i] = structure.structure;
+
+		VkAccelerationStructureDeviceAddressInfoKHR addressInfo = {};
+		addressInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
+		addressInfo.accelerationStructure = structure.structure;
+		structure.address = _vkGetAccelerationStructureDeviceAddress(_device, &addressInfo);
+	}
+	_vkCmdWriteAccelerationStructuresProperties(cmd, batchCount, built, VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR, slot.compactedSizes, 0);
+	// usable right away, uncompacted
+	_instancesChanged = true;
+}
+
+void AccelerationStructures::record_tlas(VkCommandBuffer cmd, uint32_t frame, uint32_t count, bool sceneChanged)
+{
+	if (!_ready)
+	{
+		return;
+	}
+
+	// a refit keeps the tree the last build chose, which traces slower the further things have moved since
+	count = std::min(count, _maxInstances);
+	const bool rebuild = !_tlasBuilt || _instancesChanged || count != _tlasCount || _framesSinceRebuild + 1 >= _rebuildInterval;
+	if (!rebuild && !sceneChanged)
+	{
+		return;
+	}
+
+	FrameSlot& slot = _frames[frame];
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const uint32_t handle = i < _instances.size() ? _instances[i] : INVALID_HANDLE;
+		slot.mappedAddresses[i] = handle != INVALID_HANDLE ? _structures[handle].address : 0;
+	}
+	vmaFlushAllocation(_allocator, slot.addresses._allocation, 0, static_cast<VkDeviceSize>(count) * sizeof(uint64_t));
+
+	if (count > 0)
+	{
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _instancePipeline);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout, 0, 1, &slot.set, 0, nullptr);
+		vkCmdPushConstants(cmd, _pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &count);
+		vkCmdDispatch(cmd, (count + 63) / 64, 1, 1);
+	}
+
+	// the instances, and this frame's bottom-level builds and compactions, before the build reads them; the
+	// last frame's ray queries and build before this one overwrites the structure and the scratch
+	VkMemoryBarrier toBuild = memory_barrier(VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR,
+		VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+		VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &toBuild, 0, nullptr, 0, nullptr);
+
+	const VkAccelerationStructureGeometryKHR geometry = instance_geometry(slot.instanceAddress);
+	VkAccelerationStructureBuildGeometryInfoKHR info = build_info(VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR,
+		VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR, &geometry);
+	info.mode = rebuild ? VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR : VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR;
+	info.srcAccelerationStructure = rebuild ? VK_NULL_HANDLE : _tlas;
+	info.dstAccelerationStructure = _tlas;
+	info.scratchData.deviceAddress = _tlasScratchAddress;
+	const VkAccelerationStructureBuildRangeInfoKHR range = { count, 0, 0, 0 };
+	const VkAccelerationStructureBuildRangeInfoKHR* rangePointer = &range;
+	_vkCmdBuildAccelerationStructures(cmd, 1, &info, &rangePointer);
+
+	VkMemoryBarrier toTrace = memory_barrier(VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR, VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 1, &toTrace, 0, nullptr, 0, nullptr);
+
+	if (rebuild)
+	{
+		_tlasBuilt = true;
+		_tlasCount = count;
+		_instancesChanged = false;
+		_framesSinceRebuild = 0;
+	}
+	else
+	{
+		_framesSinceRebuild++;
+	}
+}
+
+AllocatedBuffer AccelerationStructures::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, bool mapped) const
+{
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.pNext = nullptr;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.usage = memoryUsage;
+	allocInfo.flags = mapped ? VMA_ALLOCATION_CREATE_MAPPED_BIT : 0;
+
+	AllocatedBuffer buffer = {};
+	if (vmaCreateBuffer(_allocator, &bufferInfo, &allocInfo, &buffer._buffer, &buffer._allocation, nullptr) != VK_SUCCESS)
+	{
+		return {};
+	}
+	return buffer;
+}
+
+VkDeviceAddress AccelerationStructures::buffer_address(VkBuffer buffer) const
+{
+	VkBufferDeviceAddressInfoKHR addressInfo = {};
+	addressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO_KHR;
+	addressInfo.buffer = buffer;
+	return _vkGetBufferDeviceAddress(_device, &addressInfo);
+}
+
+bool AccelerationStructures::create_structure(VkAccelerationStructureTypeKHR type, VkDeviceSize size, AllocatedBuffer& buffer,
+	VkAccelerationStructureKHR& structure) const
+{
+	buffer = create_buffer(size, VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+		VMA_MEMORY_USAGE_GPU_ONLY);
+	structure = VK_NULL_HANDLE;
+	if (buffer._buffer == VK_NULL_HANDLE)
+	{
+		return false;
+	}
+
+	VkAccelerationStructureCreateInfoKHR createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
+	createInfo.buffer = buffer._buffer;
+	createInfo.offset = 0;
+	createInfo.size = size;
+	createInfo.type = type;
+	if (_vkCreateAccelerationStructure(_device, &createInfo, nullptr, &structure) != VK_SUCCESS)
+	{
+		vmaDestroyBuffer(_allocator, buffer._buffer, buffer._allocation);
+		buffer = {};
+		structure = VK_NULL_HANDLE;
+		return false;
+	}
+	return true;
+}
+
+void AccelerationStructures::ensure_scratch(FrameSlot& slot, VkDeviceSize size)
+{
+	// the slot's last frame, the only one that used it, is done
+	if (slot.scratchSize >= size)
+	{
+		return;
+	}
+	vmaDestroyBuffer(_allocator, slot.scratch._buffer, slot.scratch._allocation);
+	// the allocation may start anywhere; the builds start at the first aligned address in it
+	slot.scratch = create_buffer(size + _scratchAlignment, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+		VMA_MEMORY_USAGE_GPU_ONLY);
+	slot.scratchSize = slot.scratch._buffer != VK_NULL_HANDLE ? size : 0;
+}
+
+void AccelerationStructures::compact(VkCommandBuffer cmd, FrameSlot& slot)
+{
+	if (slot.built.empty())
+	{
+		return;
+	}
+
+	// the slot's last frame wrote them and is done
+	VkDeviceSize sizes[MAX_BATCH_BUILDS];
+	const uint32_t count = static_cast<uint32_t>(slot.built.size());
+	const VkResult result = vkGetQueryPoolResults(_device, slot.compactedSizes, 0, count, sizeof(sizes), sizes, sizeof(VkDeviceSize),
+		VK_QUERY_RESULT_64_BIT);
+	for (uint32_t i = 0; i < count && result == VK_SUCCESS; i++)
+	{
+		Structure& structure = _structures[slot.built[i]];
+		if (sizes[i] == 0 || sizes[i] >= structure.size)
+		{
+			continue;
+		}
+
+		AllocatedBuffer buffer;
+		VkAccelerationStructureKHR compacted;
+		if (!create_structure(VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, sizes[i], buffer, compacted))
+		{
+			continue;
+		}
+		VkCopyAccelerationStructureInfoKHR copy = {};
+		copy.sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR;
+		copy.src = structure.structure;
+		copy.dst = compacted;
+		copy.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR;
+		_vkCmdCopyAccelerationStructure(cmd, &copy);
+
+		// the frames in flight still trace against the original through their top-level structures
+		slot.retired.push_back({ structure.buffer, structure.structure });
+		_memoryBytes = _memoryBytes - structure.size + sizes[i];
+		structure.buffer = buffer;
+		structure.structure = compacted;
+		structure.size = sizes[i];
+
+		VkAccelerationStructureDeviceAddressInfoKHR addressInfo = {};
+		addressInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
+		addressInfo.accelerationStructure = compacted;
+		structure.address = _vkGetAccelerationStructureDeviceAddress(_device, &addressInfo);
+		_instancesChanged = true;
+	}
+	slot.built.clear();
+}
+
+#else
+
+// headers without VK_KHR_ray_query: nothing is ever built
+
+bool AccelerationStructures::init(VkDevice, VkPhysicalDevice, VmaAllocator, DescriptorAllocator&, const MeshPool&, const std::vector<VertexLayout>&,
+	VkBuffer, uint32_t, VkShaderModule, VkPipelineCache, uint32_t)
+{
+	return false;
+}
+
+void AccelerationStructures::cleanup()
+{
+}
+
+uint32_t AccelerationStructures::add(const MeshAllocation*, uint32_t)
+{
+	return INVALID_HANDLE;
+}
+
+void AccelerationStructures::set_instance(uint32_t, uint32_t)
+{
+}
+
+void AccelerationStructures::record_builds(VkCommandBuffer, uint32_t)
+{
+}
+
+void AccelerationStructures::record_tlas(VkCommandBuffer, uint32_t, uint32_t, bool)
+{
+}
+
+#endif
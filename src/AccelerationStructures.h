@@ -0,0 +1,148 @@
+#pragma once
+
+#include <vk_types.h>
+#include <DescriptorAllocator.h>
+#include <MeshPool.h>
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// Ray tracing acceleration structures of VK_KHR_acceleration_structure over the shared mesh pool, for ray
+// queries. Every mesh added gets a bottom-level structure of its own, built straight from its range of the
+// pool's vertex and index buffers: add() only queues it, and record_builds() builds the queue in batches
+// of at most _trianglesPerFrame triangles a frame, so a scene streaming in spreads its builds over frames
+// instead of stalling one. Each batch writes its structures' compacted sizes to the frame slot's query
+// pool; when the slot comes around again they are copied into structures that size, usually half of it
+// or less, and the originals retired. A mesh the pool moves later keeps its structure, which holds a copy
+// of the triangles.
+// One top-level structure covers the GPU scene buffer, instance i being scene slot i: a compute shader
+// writes the instances from the slots' transforms and the bottom-level addresses set_instance() assigned,
+// and record_tlas() refits it when only transforms changed, rebuilds it every _rebuildInterval frames, or
+// right away when instances came, went or changed structure, and leaves it alone when nothing moved.
+// Slots without a built structure are inactive and hit nothing.
+// Everything runs on the graphics queue inside the frame's command buffer: the pool's buffers belong to it,
+// and the frames in flight drawing from them couldn't hand ranges over to another queue.
+// Meshes whose vertex format the device can't build from are never added; they don't cast ray-traced shadows.
+class AccelerationStructures
+{
+public:
+	static constexpr uint32_t INVALID_HANDLE = UINT32_MAX;
+	// structures one batch builds at most, the size of each frame slot's query pool
+	static constexpr uint32_t MAX_BATCH_BUILDS = 64;
+
+	// where the positions of one vertex stream of the pool are: format and stride of its first binding
+	struct VertexLayout {
+		VkFormat format;
+		VkDeviceSize stride;
+	};
+
+	// false, with nothing left to clean up, unless the device has VK_KHR_acceleration_structure and buffer
+	// device addresses enabled and the pool's buffers were created with SHADER_DEVICE_ADDRESS and
+	// ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY usage. layouts has one entry per vertex stream of pool.
+	// sceneBuffer is the GPU scene's, which has room for maxInstances objects
+	bool init(VkDevice device, VkPhysicalDevice physicalDevice, VmaAllocator allocator, DescriptorAllocator& descriptors, const MeshPool& pool,
+		const std::vector<VertexLayout>& layouts, VkBuffer sceneBuffer, uint32_t maxInstances, VkShaderModule instanceShader, VkPipelineCache cache,
+		uint32_t frameCount);
+	// the GPU must be done with every structure
+	void cleanup();
+
+	bool ready() const { return _ready; }
+
+	// queues the structure of the first indexCount indices at allocation, a mesh's full detail level, which
+	// must stay at that address for as long as the structure exists. INVALID_HANDLE if the stream's vertex
+	// format can't be built from
+	uint32_t add(const MeshAllocation* allocation, uint32_t indexCount);
+	// scene slot's instance is the structure of handle from now on; INVALID_HANDLE leaves it inactive
+	void set_instance(uint32_t sceneSlot, uint32_t handle);
+
+	// outside any render pass, before record_tlas() and after this frame's writes to the pool: retires
+	// what frame's slot retired last time around, compacts what it built, and builds the next batch. The
+	// writes have to be ordered before vertex input, transfers or compute shaders, which every pool write is
+	void record_builds(VkCommandBuffer cmd, uint32_t frame);
+	// with the scene buffer's count slots up to date on this queue; sceneChanged is whether any moved since
+	// the last call. Leaves the top-level structure ready for the compute shaders' ray queries
+	void record_tlas(VkCommandBuffer cmd, uint32_t frame, uint32_t count, bool sceneChanged);
+
+	uint32_t _trianglesPerFrame{ 1u << 20 }; // bottom-level build budget; a larger mesh is built alone
+	uint32_t _rebuildInterval{ 60 }; // frames of refits before a full rebuild restores the trace quality
+
+	uint32_t pending() const { return static_cast<uint32_t>(_queue.size()); }
+	VkDeviceSize memory_bytes() const { return _memoryBytes; }
+
+#ifdef VK_KHR_ray_query
+	VkAccelerationStructureKHR tlas() const { return _tlas; }
+#endif
+
+private:
+	bool _ready{ false };
+
+#ifdef VK_KHR_ray_query
+	struct Structure {
+		const MeshAllocation* allocation;
+		uint32_t indexCount;
+		AllocatedBuffer buffer;
+		VkAccelerationStructureKHR structure;
+		VkDeviceAddress address; // 0 until built
+		VkDeviceSize size;
+	};
+	struct Retired {
+		AllocatedBuffer buffer;
+		VkAccelerationStructureKHR structure;
+	};
+	struct FrameSlot {
+		VkQueryPool compactedSizes;
+		std::vector<uint32_t> built; // handles the slot's last batch built, in query order
+		std::vector<Retired> retired; // replaced while the slot's last frame was recorded
+		AllocatedBuffer scratch;
+		VkDeviceSize scratchSize;
+		AllocatedBuffer addresses; // host-visible, the bottom-level address of every scene slot
+		uint64_t* mappedAddresses;
+		AllocatedBuffer instances; // written by the instance shader, read by the top-level build
+		VkDeviceAddress instanceAddress;
+		VkDescriptorSet set;
+	};
+
+	AllocatedBuffer create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, bool mapped = false) const;
+	VkDeviceAddress buffer_address(VkBuffer buffer) const;
+	// a structure over buffer, created to fit size
+	bool create_structure(VkAccelerationStructureTypeKHR type, VkDeviceSize size, AllocatedBuffer& buffer, VkAccelerationStructureKHR& structure) const;
+	void ensure_scratch(FrameSlot& slot, VkDeviceSize size);
+	void compact(VkCommandBuffer cmd, FrameSlot& slot);
+
+	VkDevice _device{ VK_NULL_HANDLE };
+	VmaAllocator _allocator{ nullptr };
+	const MeshPool* _pool{ nullptr };
+	std::vector<VertexLayout> _layouts;
+	VkDeviceSize _scratchAlignment{ 256 };
+
+	std::vector<Structure> _structures; // by handle
+	std::deque<uint32_t> _queue; // handles waiting for their build, oldest first
+	std::vector<uint32_t> _instances; // the handle of every scene slot
+	bool _instancesChanged{ true };
+	VkDeviceSize _memoryBytes{ 0 };
+	std::vector<FrameSlot> _frames;
+
+	VkDescriptorSetLayout _setLayout{ VK_NULL_HANDLE };
+	VkPipelineLayout _pipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline _instancePipeline{ VK_NULL_HANDLE };
+
+	AllocatedBuffer _tlasBuffer{};
+	VkAccelerationStructureKHR _tlas{ VK_NULL_HANDLE };
+	AllocatedBuffer _tlasScratch{};
+	VkDeviceAddress _tlasScratchAddress{ 0 };
+	uint32_t _maxInstances{ 0 };
+	uint32_t _tlasCount{ 0 }; // instances of the last full build
+	uint32_t _framesSinceRebuild{ 0 };
+	bool _tlasBuilt{ false };
+
+	PFN_vkCreateAccelerationStructureKHR _vkCreateAccelerationStructure{ nullptr };
+	PFN_vkDestroyAccelerationStructureKHR _vkDestroyAccelerationStructure{ nullptr };
+	PFN_vkGetAccelerationStructureBuildSizesKHR _vkGetAccelerationStructureBuildSizes{ nullptr };
+	PFN_vkGetAccelerationStructureDeviceAddressKHR _vkGetAccelerationStructureDeviceAddress{ nullptr };
+	PFN_vkCmdBuildAccelerationStructuresKHR _vkCmdBuildAccelerationStructures{ nullptr };
+	PFN_vkCmdCopyAccelerationStructureKHR _vkCmdCopyAccelerationStructure{ nullptr };
+	PFN_vkCmdWriteAccelerationStructuresPropertiesKHR _vkCmdWriteAccelerationStructuresProperties{ nullptr };
+	PFN_vkGetBufferDeviceAddressKHR _vkGetBufferDeviceAddress{ nullptr };
+#endif
+};
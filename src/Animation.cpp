@@ -0,0 +1,136 @@
+#include "Animation.h"
+
+#include "JobSystem.h"
+#include "SimdLanes.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <initializer_list>
+
+namespace {
+	// a pose is a few hundred matrix operations; a job takes enough of them to be worth scheduling
+	constexpr size_t POSES_PER_JOB = 16;
+
+	enum Channel : uint32_t {
+		POSITION_X, POSITION_Y, POSITION_Z,
+		ROTATION_X, ROTATION_Y, ROTATION_Z, ROTATION_W,
+		SCALE_X, SCALE_Y, SCALE_Z,
+	};
+}
+
+uint32_t Skeleton::add(const glm::mat4& bindPose, uint32_t parent)
+{
+	const uint32_t index = joint_count();
+	assert(index < MAX_SKIN_JOINTS);
+	parents.push_back(parent < index ? parent : NO_PARENT);
+	inverseBind.push_back(glm::inverse(bindPose));
+	return index;
+}
+
+void AnimationClip::init(uint32_t jointCount, uint32_t keyCount, float keysPerSecond)
+{
+	assert(jointCount <= MAX_SKIN_JOINTS && keyCount > 0);
+	_jointCount = jointCount;
+	_stride = static_cast<uint32_t>((jointCount + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH);
+	_keyCount = keyCount;
+	_keysPerSecond = keysPerSecond;
+
+	// identity everywhere, the padding lanes included, so they blend into valid matrices nobody reads
+	_keys.assign(static_cast<size_t>(keyCount) * CHANNELS * _stride, 0.0f);
+	for (uint32_t key = 0; key < keyCount; key++)
+	{
+		for (uint32_t channel : { ROTATION_W, SCALE_X, SCALE_Y, SCALE_Z })
+		{
+			float* values = &_keys[(static_cast<size_t>(key) * CHANNELS + channel) * _stride];
+			std::fill(values, values + _stride, 1.0f);
+		}
+	}
+}
+
+void AnimationClip::set_key(uint32_t key, uint32_t joint, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+	const float values[CHANNELS] = { position.x, position.y, position.z, rotation.x, rotation.y, rotation.z, rotation.w, scale.x, scale.y, scale.z };
+	for (uint32_t channel = 0; channel < CHANNELS; channel++)
+	{
+		_keys[(static_cast<size_t>(key) * CHANNELS + channel) * _stride + joint] = values[channel];
+	}
+}
+
+namespace animation {
+	void sample_pose(const PoseRequest& request)
+	{
+		const AnimationClip& clip = *request.clip;
+		const Skeleton& skeleton = *request.skeleton;
+		const uint32_t jointCount = clip.joint_count();
+		assert(jointCount == skeleton.joint_count() && jointCount <= MAX_SKIN_JOINTS);
+
+		// where the time falls between two keys, looping; the key after the last is the first again
+		const uint32_t keyCount = clip.key_count();
+		double position = std::fmod(request.time * clip.keys_per_second(), static_cast<double>(keyCount));
+		if (position < 0.0)
+		{
+			position += keyCount;
+		}
+		const uint32_t key0 = std::min(static_cast<uint32_t>(position), keyCount - 1);
+		const uint32_t key1 = (key0 + 1) % keyCount;
+		const Lanes t = lanes_splat(static_cast<float>(position - key0));
+
+		glm::mat4 local[MAX_SKIN_JOINTS];
+		for (uint32_t joint = 0; joint < jointCount; joint += SIMD_WIDTH)
+		{
+			auto load = [&](uint32_t key, uint32_t channel) {
+				return lanes_load(clip.channel(key, channel) + joint);
+			};
+			auto blend = [&](Lanes a, Lanes b) {
+				return lanes_add(a, lanes_mul(lanes_sub(b, a), t));
+			};
+
+			const Lanes ax = load(key0, ROTATION_X), ay = load(key0, ROTATION_Y), az = load(key0, ROTATION_Z), aw = load(key0, ROTATION_W);
+			Lanes bx = load(key1, ROTATION_X), by = load(key1, ROTATION_Y), bz = load(key1, ROTATION_Z), bw = load(key1, ROTATION_W);
+			// q and -q are the same rotation; the one that faces the first key takes the shorter way round
+			const Lanes dot = lanes_add(lanes_add(lanes_mul(ax, bx), lanes_mul(ay, by)), lanes_add(lanes_mul(az, bz), lanes_mul(aw, bw)));
+			bx = lanes_flip_sign(bx, dot);
+			by = lanes_flip_sign(by, dot);
+			bz = lanes_flip_sign(bz, dot);
+			bw = lanes_flip_sign(bw, dot);
+
+			Lanes x = blend(ax, bx), y = blend(ay, by), z = blend(az, bz), w = blend(aw, bw);
+			const Lanes length = lanes_rsqrt(lanes_add(lanes_add(lanes_mul(x, x), lanes_mul(y, y)), lanes_add(lanes_mul(z, z), lanes_mul(w, w))));
+			x = lanes_mul(x, length);
+			y = lanes_mul(y, length);
+			z = lanes_mul(z, length);
+			w = lanes_mul(w, length);
+
+			store_trs(&local[joint],
+				blend(load(key0, POSITION_X), load(key1, POSITION_X)),
+				blend(load(key0, POSITION_Y), load(key1, POSITION_Y)),
+				blend(load(key0, POSITION_Z), load(key1, POSITION_Z)),
+				x, y, z, w,
+				blend(load(key0, SCALE_X), load(key1, SCALE_X)),
+				blend(load(key0, SCALE_Y), load(key1, SCALE_Y)),
+				blend(load(key0, SCALE_Z), load(key1, SCALE_Z)));
+		}
+
+		// parents come first, so each joint's parent is already posed when it's reached
+		glm::mat4 world[MAX_SKIN_JOINTS];
+		for (uint32_t joint = 0; joint < jointCount; joint++)
+		{
+			const uint32_t parent = skeleton.parents[joint];
+			world[joint] = parent == Skeleton::NO_PARENT ? local[joint] : world[parent] * local[joint];
+			request.out[joint] = world[joint] * skeleton.inverseBind[joint];
+		}
+	}
+
+	void sample_poses(const PoseRequest* requests, size_t count)
+	{
+		const size_t jobCount = (count + POSES_PER_JOB - 1) / POSES_PER_JOB;
+		parallel_for(jobCount, [&](size_t job) {
+			const size_t end = std::min(count, (job + 1) * POSES_PER_JOB);
+			for (size_t i = job * POSES_PER_JOB; i < end; i++)
+			{
+				sample_pose(requests[i]);
+			}
+		});
+	}
+}
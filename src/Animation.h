@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// joints one skeleton may have; SkinnedVertex stores joint indices in 8 bits, and the sampler keeps a
+// pose's matrices on the stack
+constexpr uint32_t MAX_SKIN_JOINTS = 64;
+
+// joint hierarchy of a skinned mesh, in topological order like TransformStore's nodes: a parent always
+// comes before its children, so one forward pass poses the whole skeleton
+struct Skeleton
+{
+	static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+	std::vector<uint32_t> parents;
+	// mesh space to each joint's own space in the bind pose
+	std::vector<glm::mat4> inverseBind;
+
+	// returns the joint's index; parent must already be in the skeleton, bindPose is where the joint sits
+	// in mesh space when the mesh is undeformed
+	uint32_t add(const glm::mat4& bindPose, uint32_t parent = NO_PARENT);
+	uint32_t joint_count() const { return static_cast<uint32_t>(parents.size()); }
+};
+
+// Looping clip of parent-relative joint transforms at evenly spaced keys; after the last key it blends
+// back into the first. Keys are stored channel by channel (position xyz, rotation xyzw, scale xyz), each
+// channel holding every joint's value padded to the SIMD width, so the sampler blends four joints a step
+class AnimationClip
+{
+public:
+	static constexpr uint32_t CHANNELS = 10;
+
+	// every key starts out as the identity transform
+	void init(uint32_t jointCount, uint32_t keyCount, float keysPerSecond);
+	void set_key(uint32_t key, uint32_t joint, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+
+	uint32_t joint_count() const { return _jointCount; }
+	uint32_t key_count() const { return _keyCount; }
+	float keys_per_second() const { return _keysPerSecond; }
+	float duration() const { return _keyCount / _keysPerSecond; }
+
+	// channel of key for joints [0, padded joint count)
+	const float* channel(uint32_t key, uint32_t channel) const { return &_keys[(static_cast<size_t>(key) * CHANNELS + channel) * _stride]; }
+
+private:
+	uint32_t _jointCount{ 0 };
+	uint32_t _stride{ 0 }; // joints rounded up to the SIMD width
+	uint32_t _keyCount{ 0 };
+	float _keysPerSecond{ 30.f };
+	std::vector<float> _keys;
+};
+
+// one pose to sample: skeleton posed by clip at time seconds, written to out as skinning matrices
+struct PoseRequest {
+	const AnimationClip* clip;
+	const Skeleton* skeleton;
+	double time;
+	glm::mat4* out; // skeleton->joint_count() matrices
+};
+
+// Turns clips into skinning matrices, the joint's world transform times its inverse bind matrix, which move
+// bind-pose mesh positions to where the pose puts them. The two keys around the time are blended four joints
+// at a time with SSE or NEON (scalar elsewhere): positions and scales linearly, rotations by normalized lerp
+// along the shorter arc, straight into local matrices; the hierarchy is then resolved parents first
+namespace animation {
+	// thread-safe; the clip and skeleton must have the same joint count, at most MAX_SKIN_JOINTS
+	void sample_pose(const PoseRequest& request);
+	// every request, split over the job system when there are enough of them to pay for it
+	void sample_poses(const PoseRequest* requests, size_t count);
+}
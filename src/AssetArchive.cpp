@@ -0,0 +1,167 @@
+#include "AssetArchive.h"
+
+#include "Log.h"
+
+#include <cstring>
+#include <fstream>
+
+namespace {
+	constexpr uint32_t ARCHIVE_MAGIC = 0x52414351; // "QCAR"
+	// bump whenever the layout changes
+	constexpr uint32_t ARCHIVE_VERSION = 1;
+	// every blob starts on this, which covers any alignment a loader reads its data at
+	constexpr uint64_t ARCHIVE_ALIGNMENT = 64;
+
+	// fixed-size fields only, so the header can be written and read as raw bytes
+	struct ArchiveHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t entryCount;
+		uint32_t nameBytes;
+	};
+	static_assert(sizeof(ArchiveHeader) == 16, "archive header must not contain padding");
+
+	// follows the header, entryCount entries; the name table follows them, the blobs the name table
+	struct ArchiveEntry {
+		uint64_t offset; // from the start of the archive
+		uint64_t size;
+		uint32_t nameOffset; // into the name table
+		uint32_t nameLength;
+	};
+	static_assert(sizeof(ArchiveEntry) == 24, "archive entry must not contain padding");
+
+	uint64_t align_up(uint64_t value)
+	{
+		return (value + ARCHIVE_ALIGNMENT - 1) & ~(ARCHIVE_ALIGNMENT - 1);
+	}
+}
+
+bool AssetArchive::open(const char* path)
+{
+	close();
+	if (!_file.open(path) || _file.size() < sizeof(ArchiveHeader))
+	{
+		_file.close();
+		return false;
+	}
+
+	ArchiveHeader header;
+	memcpy(&header, _file.data(), sizeof(ArchiveHeader));
+	const size_t tableBytes = size_t(header.entryCount) * sizeof(ArchiveEntry);
+	if (header.magic != ARCHIVE_MAGIC || header.version != ARCHIVE_VERSION
+		|| _file.size() < sizeof(ArchiveHeader) + tableBytes + header.nameBytes)
+	{
+		_file.close();
+		return false;
+	}
+
+	const uint8_t* table = _file.data() + sizeof(ArchiveHeader);
+	const char* names = reinterpret_cast<const char*>(table + tableBytes);
+	_order.reserve(header.entryCount);
+	for (uint32_t i = 0; i < header.entryCount; i++)
+	{
+		ArchiveEntry entry;
+		memcpy(&entry, table + i * sizeof(ArchiveEntry), sizeof(ArchiveEntry));
+		if (uint64_t(entry.nameOffset) + entry.nameLength > header.nameBytes
+			|| entry.offset > _file.size() || entry.size > _file.size() - entry.offset)
+		{
+			close();
+			return false;
+		}
+
+		std::string name(names + entry.nameOffset, entry.nameLength);
+		_entries[name] = { entry.offset, entry.size };
+		_order.push_back(std::move(name));
+	}
+	_path = path;
+	return true;
+}
+
+void AssetArchive::close()
+{
+	_file.close();
+	_path.clear();
+	_entries.clear();
+	_order.clear();
+}
+
+bool AssetArchive::find(const std::string& name, const uint8_t*& data, size_t& size) const
+{
+	auto entry = _entries.find(name);
+	if (entry == _entries.end())
+	{
+		return false;
+	}
+	data = _file.data() + entry->second.offset;
+	size = static_cast<size_t>(entry->second.size);
+	return true;
+}
+
+std::vector<std::string> AssetArchive::names() const
+{
+	return _order;
+}
+
+bool AssetArchive::locate(const std::string& name, uint64_t& offset, uint64_t& size) const
+{
+	auto entry = _entries.find(name);
+	if (entry == _entries.end())
+	{
+		return false;
+	}
+	offset = entry->second.offset;
+	size = entry->second.size;
+	return true;
+}
+
+bool AssetArchive::pack(const char* path, const std::vector<std::string>& files)
+{
+	ArchiveHeader header = {};
+	header.magic = ARCHIVE_MAGIC;
+	header.version = ARCHIVE_VERSION;
+	header.entryCount = static_cast<uint32_t>(files.size());
+
+	std::vector<ArchiveEntry> entries(files.size());
+	std::string names;
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		entries[i].nameOffset = static_cast<uint32_t>(names.size());
+		entries[i].nameLength = static_cast<uint32_t>(files[i].size());
+		names += files[i];
+	}
+	header.nameBytes = static_cast<uint32_t>(names.size());
+
+	std::ofstream archive(path, std::ios::binary | std::ios::trunc);
+	if (!archive.is_open())
+	{
+		return false;
+	}
+
+	// the table goes first with the offsets still unknown, and is rewritten once the blobs are in
+	archive.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	archive.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(ArchiveEntry));
+	archive.write(names.data(), names.size());
+
+	uint64_t offset = sizeof(ArchiveHeader) + entries.size() * sizeof(ArchiveEntry) + names.size();
+	const char padding[ARCHIVE_ALIGNMENT] = {};
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		MappedFile file;
+		if (!file.open(files[i].c_str()))
+		{
+			LOG_ERROR("Could not read " << files[i] << " into " << path);
+			return false;
+		}
+
+		const uint64_t aligned = align_up(offset);
+		archive.write(padding, static_cast<std::streamsize>(aligned - offset));
+		archive.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size()));
+		entries[i].offset = aligned;
+		entries[i].size = file.size();
+		offset = aligned + file.size();
+	}
+
+	archive.seekp(sizeof(ArchiveHeader));
+	archive.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(ArchiveEntry));
+	return archive.good();
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "MappedFile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// One read-only file holding many assets: a header, a table of contents and a name table, then every
+// blob at a 64-byte aligned offset. The whole archive is memory-mapped once, so find() hands out
+// pointers straight into the mapping: no file is opened per asset and nothing is copied until the
+// loader wants its own copy.
+// Entries are named by the path the asset would otherwise be loaded from, with forward slashes
+// ("../../shaders/cull.comp.spv"), so loaders look a file up under the name they already have.
+// Blobs are stored as they are: the derived caches it holds are already in their GPU formats.
+class AssetArchive
+{
+public:
+	// maps the archive at path; false if it's missing or not an archive of this version
+	bool open(const char* path);
+	void close();
+	bool is_open() const { return _file.is_open(); }
+
+	// the blob stored under name, valid until close(); false if there is none
+	bool find(const std::string& name, const uint8_t*& data, size_t& size) const;
+	// every entry name, in archive order
+	std::vector<std::string> names() const;
+	// where name's blob is in the archive file, for reading it by other means than the mapping
+	bool locate(const std::string& name, uint64_t& offset, uint64_t& size) const;
+	const std::string& path() const { return _path; }
+
+	// writes an archive of files, each stored under its path; false if one can't be read or the
+	// archive can't be written
+	static bool pack(const char* path, const std::vector<std::string>& files);
+
+private:
+	struct Entry {
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	MappedFile _file;
+	std::string _path;
+	std::unordered_map<std::string, Entry> _entries;
+	std::vector<std::string> _order;
+};
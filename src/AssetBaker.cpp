@@ -0,0 +1,155 @@
+#include "AssetBaker.h"
+
+#include "AssetArchive.h"
+#include "AssetCache.h"
+#include "Impostors.h"
+#include "JobSystem.h"
+#include "Log.h"
+#include "Mesh.h"
+#include "PotentiallyVisibleSet.h"
+#include "SdfFont.h"
+#include "Texture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+
+namespace {
+	// every file of folder with one of the extensions, named the way the engine asks for it
+	void list_files(const std::string& folder, std::initializer_list<const char*> extensions, std::vector<std::string>& files)
+	{
+		std::error_code ec;
+		for (const auto& entry : std::filesystem::directory_iterator(folder, ec))
+		{
+			const std::string extension = entry.path().extension().string();
+			for (const char* wanted : extensions)
+			{
+				if (extension == wanted)
+				{
+					files.push_back(folder + "/" + entry.path().filename().string());
+				}
+			}
+		}
+	}
+}
+
+AssetBakeStats bake_assets(const AssetBakeSettings& settings)
+{
+	std::vector<std::string> meshes;
+	std::vector<std::string> images;
+	std::vector<std::string> fonts;
+	list_files(settings.assetDir, { ".obj" }, meshes);
+	list_files(settings.assetDir, { ".png" }, images);
+	list_files(settings.assetDir, { ".ttf" }, fonts);
+
+	// the importers fan out over the shared scheduler themselves, so a job's mesh still uses every core
+	// once the other sources are done
+	JobSystem jobs;
+	jobs.init();
+	JobSystem* previous = JobSystem::shared();
+	JobSystem::set_shared(&jobs);
+
+	AssetBakeStats stats;
+	// the fonts' distance atlases and the built-in font's, for the engine's --text
+	stats.assets = static_cast<uint32_t>(meshes.size() + images.size() + settings.pvsLevels.size() + fonts.size() + 1);
+	std::vector<uint8_t> failed(meshes.size() + images.size(), 0);
+	// the atlases imports packed their parts' maps into (see TextureAtlas.h), by mesh
+	std::vector<std::string> atlases(meshes.size());
+	const auto start = std::chrono::steady_clock::now();
+	jobs.parallel_for(failed.size(), [&](size_t i) {
+		if (i < meshes.size())
+		{
+			std::vector<Mesh> parts;
+			failed[i] = !Mesh::load_parts(meshes[i].c_str(), parts, nullptr, false, settings.compressMeshes, settings.cache);
+			for (uint32_t part = 0; settings.impostors && part < parts.size(); part++)
+			{
+				ImpostorAtlas atlas;
+				const std::string atlasPath = ImpostorAtlas::cache_path(meshes[i], part);
+				if (!atlas.load(atlasPath.c_str(), meshes[i].c_str(), settings.impostor)
+					&& (!atlas.bake(parts[part], settings.impostor) || !atlas.save(atlasPath.c_str(), meshes[i].c_str())))
+				{
+					LOG_ERROR("Could not bake the impostor of " << atlasPath);
+				}
+			}
+			for (const Mesh& part : parts)
+			{
+				const std::string& map = part._material.diffuseTexture;
+				if (map.size() > strlen(TEXTURE_ATLAS_EXTENSION) && map.compare(map.size() - strlen(TEXTURE_ATLAS_EXTENSION), std::string::npos, TEXTURE_ATLAS_EXTENSION) == 0)
+				{
+					atlases[i] = map;
+				}
+			}
+		}
+		else
+		{
+			Texture texture;
+			failed[i] = !texture.load_from_file(images[i - meshes.size()].c_str(), true, nullptr, settings.cache);
+		}
+	});
+	// an atlas only exists once its OBJ is imported, so its BC blocks come after
+	atlases.erase(std::remove(atlases.begin(), atlases.end(), std::string()), atlases.end());
+	jobs.parallel_for(atlases.size(), [&](size_t i) {
+		Texture texture;
+		if (!texture.load_from_file(atlases[i].c_str(), true, nullptr, settings.cache))
+		{
+			LOG_ERROR("Could not convert " << atlases[i]);
+		}
+	});
+	// from the parts just imported, a level at a time: each spreads its cells over every core
+	for (const std::string& level : settings.pvsLevels)
+	{
+		std::vector<Mesh> parts;
+		PotentiallyVisibleSet pvs;
+		const std::string pvsPath = level + PVS_EXTENSION;
+		if (!Mesh::load_parts(level.c_str(), parts, nullptr, false, settings.compressMeshes, settings.cache)
+			|| !pvs.bake(parts, settings.pvs) || !pvs.save(pvsPath.c_str(), level.c_str()))
+		{
+			LOG_ERROR("Could not bake visibility for " << level);
+			stats.failed++;
+			continue;
+		}
+		LOG_INFO(pvsPath << ": " << pvs.cell_count() << " cells over " << pvs.object_count() << " parts");
+	}
+	// a few hundred glyphs each, not worth spreading out
+	fonts.push_back(std::string());
+	for (const std::string& font : fonts)
+	{
+		SdfFont atlas;
+		const std::string cachePath = font.empty() ? settings.assetDir + "/" + BUILTIN_FONT_CACHE : font + SDF_FONT_EXTENSION;
+		if (!load_sdf_font(atlas, font.empty() ? nullptr : font.c_str(), cachePath.c_str()))
+		{
+			stats.failed++;
+		}
+	}
+	stats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	JobSystem::set_shared(previous);
+	jobs.cleanup();
+
+	for (size_t i = 0; i < failed.size(); i++)
+	{
+		if (failed[i])
+		{
+			LOG_ERROR("Could not import " << (i < meshes.size() ? meshes[i] : images[i - meshes.size()]));
+			stats.failed++;
+		}
+	}
+	return stats;
+}
+
+bool pack_baked_assets(const char* archivePath, const AssetBakeSettings& settings)
+{
+	// the OBJs themselves stay out: their caches are what the engine loads. The images go in for devices
+	// without BC support, which decode them instead of the .qctex
+	std::vector<std::string> files;
+	list_files(settings.shaderDir, { ".spv" }, files);
+	list_files(settings.assetDir, { ".qcmesh", ".qctex", ".qcatlas", PVS_EXTENSION, IMPOSTOR_EXTENSION, SDF_FONT_EXTENSION, ".png" }, files);
+	if (!AssetArchive::pack(archivePath, files))
+	{
+		LOG_ERROR("Could not write " << archivePath);
+		return false;
+	}
+	LOG_INFO("Packed " << files.size() << " files into " << archivePath);
+	return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <Impostors.h>
+#include <PotentiallyVisibleSet.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class AssetCache;
+
+// the folders the engine loads from; archive entries are named by these paths, so a packed archive only
+// serves an engine that asks under the same ones
+struct AssetBakeSettings {
+	std::string assetDir{ "../../assets" };
+	std::string shaderDir{ "../../shaders" };
+	bool compressMeshes{ false }; // see Mesh::save_to_cache
+	// static levels to bake visibility for (see PotentiallyVisibleSet), each named the way the engine's --obj
+	// names it; their sets land next to them, whatever cache is
+	std::vector<std::string> pvsLevels;
+	PvsBakeSettings pvs;
+	// also bakes every mesh part's impostor atlas (see Impostors.h) next to its source, for the engine's --impostors
+	bool impostors{ false };
+	ImpostorBakeSettings impostor;
+	// imports are kept here by the contents of their sources; null writes them next to the sources, where
+	// pack_baked_assets finds them
+	AssetCache* cache{ nullptr };
+};
+
+struct AssetBakeStats {
+	uint32_t assets{ 0 };
+	uint32_t failed{ 0 };
+	double ms{ 0.0 };
+};
+
+// Offline import of everything the engine would otherwise derive at load: every OBJ of assetDir through the
+// whole mesh pipeline (welding, vertex cache and fetch order, clusters, LODs, tangents) and every image into
+// BC blocks, one source per job on a job system of its own, then the visibility of the levels asked for and the
+// distance atlas of every TTF and of the built-in font (see SdfFont.h).
+// Sources whose caches are up to date only cost the check. The SPIR-V is the build's.
+AssetBakeStats bake_assets(const AssetBakeSettings& settings);
+
+// writes archivePath as an AssetArchive of the compiled shaders and the caches and images a bake left next to
+// the sources; false if it couldn't
+bool pack_baked_assets(const char* archivePath, const AssetBakeSettings& settings);
@@ -0,0 +1,219 @@
+#include "AssetCache.h"
+
+#include "Log.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace {
+	// one line per entry, the path last so it may hold spaces:
+	//   hash <hash> <size> <timestamp> <path>
+	//   depends <source> \t <dependency>   (one line per dependency, in order)
+	constexpr const char* INDEX_NAME = "index.txt";
+	constexpr const char* INDEX_HEADER = "qcengine asset cache 1";
+
+	uint64_t fnv1a(uint64_t hash, const void* data, size_t size)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
+	}
+}
+
+bool AssetCache::open(const std::string& directory)
+{
+	std::error_code ec;
+	std::filesystem::create_directories(directory, ec);
+	if (ec || !std::filesystem::is_directory(directory, ec))
+	{
+		LOG_ERROR("Could not create the asset cache " << directory);
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	_directory = directory;
+	_hashes.clear();
+	_dependencies.clear();
+	_dirty = false;
+	_hits = 0;
+	_misses = 0;
+	read_index();
+	return true;
+}
+
+void AssetCache::close()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_directory.empty())
+	{
+		return;
+	}
+	if (_dirty)
+	{
+		write_index();
+	}
+	if (_hits + _misses > 0)
+	{
+		LOG_INFO("Asset cache " << _directory << ": " << _hits << " hits, " << _misses << " imports");
+	}
+	_directory.clear();
+}
+
+uint64_t AssetCache::content_hash(const std::string& path)
+{
+	SourceStamp stamp;
+	if (!get_source_stamp(path.c_str(), stamp))
+	{
+		return 0;
+	}
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		auto found = _hashes.find(path);
+		if (found != _hashes.end() && found->second.stamp.size == stamp.size && found->second.stamp.timestamp == stamp.timestamp)
+		{
+			return found->second.hash;
+		}
+	}
+
+	// hashed outside the lock, so workers hashing different files don't wait on each other
+	const uint64_t hash = hash_file(path.c_str());
+	std::lock_guard<std::mutex> lock(_mutex);
+	_hashes[path] = { stamp, hash };
+	_dirty = true;
+	return hash;
+}
+
+uint64_t AssetCache::key(const std::vector<std::string>& sources, const char* importer, uint32_t version, uint64_t options)
+{
+	uint64_t key = fnv1a(0xcbf29ce484222325ull, importer, strlen(importer));
+	key = fnv1a(key, &version, sizeof(version));
+	key = fnv1a(key, &options, sizeof(options));
+	for (const std::string& source : sources)
+	{
+		const uint64_t hash = content_hash(source);
+		if (hash == 0)
+		{
+			return 0;
+		}
+		// the name counts too: the same bytes under another name are another asset to whoever asks
+		key = fnv1a(key, source.data(), source.size());
+		key = fnv1a(key, &hash, sizeof(hash));
+	}
+	return key;
+}
+
+std::string AssetCache::path(uint64_t key, const std::string& suffix) const
+{
+	char name[17];
+	snprintf(name, sizeof(name), "%016" PRIx64, key);
+	return _directory + "/" + name + suffix;
+}
+
+std::vector<std::string> AssetCache::dependencies(const std::string& source)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto found = _dependencies.find(source);
+	return found != _dependencies.end() ? found->second : std::vector<std::string>();
+}
+
+void AssetCache::set_dependencies(const std::string& source, const std::vector<std::string>& dependencies)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::vector<std::string>& recorded = _dependencies[source];
+	if (recorded != dependencies)
+	{
+		recorded = dependencies;
+		_dirty = true;
+	}
+}
+
+void AssetCache::count_lookup(bool hit)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	(hit ? _hits : _misses)++;
+}
+
+void AssetCache::read_index()
+{
+	std::ifstream file(_directory + "/" + INDEX_NAME);
+	std::string line;
+	if (!file.is_open() || !std::getline(file, line) || line != INDEX_HEADER)
+	{
+		// a missing or foreign index only means every source is hashed once more
+		return;
+	}
+
+	while (std::getline(file, line))
+	{
+		std::istringstream fields(line);
+		std::string kind;
+		fields >> kind;
+		if (kind == "hash")
+		{
+			HashedFile hashed;
+			fields >> std::hex >> hashed.hash >> std::dec >> hashed.stamp.size >> hashed.stamp.timestamp;
+			std::string path;
+			std::getline(fields >> std::ws, path);
+			if (fields.fail() || path.empty())
+			{
+				continue;
+			}
+			_hashes[path] = hashed;
+		}
+		else if (kind == "depends")
+		{
+			std::string rest;
+			std::getline(fields >> std::ws, rest);
+			const size_t tab = rest.find('\t');
+			if (tab != std::string::npos)
+			{
+				_dependencies[rest.substr(0, tab)].push_back(rest.substr(tab + 1));
+			}
+		}
+	}
+}
+
+void AssetCache::write_index()
+{
+	// written next to the index and renamed over it, so a crash mid-write leaves the old one
+	const std::string indexPath = _directory + "/" + INDEX_NAME;
+	const std::string partialPath = indexPath + ".partial";
+	{
+		std::ofstream file(partialPath, std::ios::trunc);
+		if (!file.is_open())
+		{
+			LOG_WARN("could not write asset cache index " << indexPath);
+			return;
+		}
+		file << INDEX_HEADER << "\n";
+		for (const auto& entry : _hashes)
+		{
+			file << "hash " << std::hex << entry.second.hash << std::dec << " " << entry.second.stamp.size << " "
+				<< entry.second.stamp.timestamp << " " << entry.first << "\n";
+		}
+		for (const auto& entry : _dependencies)
+		{
+			for (const std::string& dependency : entry.second)
+			{
+				file << "depends " << entry.first << "\t" << dependency << "\n";
+			}
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(partialPath, indexPath, ec);
+	if (ec)
+	{
+		LOG_WARN("could not write asset cache index " << indexPath);
+		return;
+	}
+	_dirty = false;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "MappedFile.h"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Incremental import layer: one directory of derived asset data, every file in it named by a key of what it
+// was made from. A key covers the contents of each source the importer read (an OBJ and its .mtl libraries,
+// say), the importer and its version, and any option that changes the output, so a changed input or a newer
+// importer simply asks for a key nobody has written yet; nothing is invalidated in place, and switching back
+// finds the old data again. Content hashes are remembered in an index file in the directory, by path, size
+// and timestamp, so only sources that changed on disk are read again. Safe to share between threads: the
+// streamer's loader and the bake command's workers use one each.
+class AssetCache
+{
+public:
+	// creates directory if needed and reads its index; false if it can't be created
+	bool open(const std::string& directory);
+	// writes the index back if anything was learned
+	void close();
+	bool is_open() const { return !_directory.empty(); }
+
+	// 64-bit FNV-1a of the file's contents, like hash_file, from the index while the file's size and
+	// timestamp are the ones it was hashed at; 0 if the file can't be read
+	uint64_t content_hash(const std::string& path);
+	// key of what importer, at version and with options, derives from sources; 0 when any of them is missing
+	uint64_t key(const std::vector<std::string>& sources, const char* importer, uint32_t version, uint64_t options = 0);
+	// where the data of key is kept; suffix tells the files of one key apart (".qcmesh", ".1.qcmesh")
+	std::string path(uint64_t key, const std::string& suffix) const;
+
+	// sources an importer found it needed beyond the file itself, as of the last import: what a lookup
+	// puts into the key before anything is parsed. A stale list only costs a miss, since the file that
+	// names its dependencies changed too
+	std::vector<std::string> dependencies(const std::string& source);
+	void set_dependencies(const std::string& source, const std::vector<std::string>& dependencies);
+
+	// for the log: lookups that found their data, and ones that had to import
+	void count_lookup(bool hit);
+	uint32_t hits() const { return _hits; }
+	uint32_t misses() const { return _misses; }
+
+private:
+	struct HashedFile {
+		SourceStamp stamp;
+		uint64_t hash;
+	};
+
+	void read_index();
+	void write_index();
+
+	std::string _directory;
+	std::mutex _mutex;
+	std::unordered_map<std::string, HashedFile> _hashes;
+	std::unordered_map<std::string, std::vector<std::string>> _dependencies;
+	bool _dirty{ false };
+	uint32_t _hits{ 0 };
+	uint32_t _misses{ 0 };
+};
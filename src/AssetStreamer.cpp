@@ -0,0 +1,264 @@
+#include "AssetStreamer.h"
+
+#include "AssetArchive.h"
+#include "CpuProfiler.h"
+#include "JobSystem.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <filesystem>
+
+void AssetStreamer::start(const AssetArchive* archive, bool packedIndices, bool compressMeshCaches, AssetCache* cache, bool readAhead)
+{
+	_archive = archive;
+	_packedIndices = packedIndices;
+	_compressMeshCaches = compressMeshCaches;
+	_cache = cache;
+	_stopping = false;
+	if (readAhead)
+	{
+		// enough chunks in flight to keep an NVMe drive's queues busy from one thread
+		_reader.start(32);
+		LOG_INFO("Asset read-ahead through " << async_file_backend_name(_reader.backend()));
+	}
+	// decoding fans out over the starting thread's scheduler, not whichever one another engine set
+	JobSystem* jobs = JobSystem::shared();
+	_thread = std::thread([this, jobs]() {
+		JobSystem::set_shared(jobs);
+		loader_loop();
+	});
+}
+
+void AssetStreamer::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+		_requests.clear();
+	}
+	_wake.notify_all();
+
+	if (_thread.joinable())
+	{
+		_thread.join();
+	}
+	_reader.stop();
+}
+
+void AssetStreamer::request_mesh(const std::string& name, const std::string& path, VertexFormat format)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_requests.push_back({ AssetType::Mesh, name, path, format, false });
+	}
+	_wake.notify_one();
+}
+
+void AssetStreamer::request_texture(const std::string& name, const std::string& path, bool compress)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_requests.push_back({ AssetType::Texture, name, path, VertexFormat::Full, compress });
+	}
+	_wake.notify_one();
+}
+
+void AssetStreamer::request_impostor(const std::string& name, const std::string& path, const std::string& sourcePath, Mesh geometry)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_requests.push_back({ AssetType::Impostor, name, path, VertexFormat::Full, false, sourcePath, std::move(geometry) });
+	}
+	_wake.notify_one();
+}
+
+std::vector<AssetStreamer::LoadedMesh> AssetStreamer::take_loaded()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::vector<LoadedMesh> loaded;
+	loaded.swap(_loaded);
+	return loaded;
+}
+
+std::vector<AssetStreamer::LoadedTexture> AssetStreamer::take_loaded_textures()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::vector<LoadedTexture> loaded;
+	loaded.swap(_loadedTextures);
+	return loaded;
+}
+
+std::vector<AssetStreamer::LoadedImpostor> AssetStreamer::take_loaded_impostors()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::vector<LoadedImpostor> loaded;
+	loaded.swap(_loadedImpostors);
+	return loaded;
+}
+
+bool AssetStreamer::busy()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return !_requests.empty() || _loading > 0 || !_loaded.empty() || !_loadedTextures.empty() || !_loadedImpostors.empty();
+}
+
+void AssetStreamer::set_throttled(bool throttled)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_throttled == throttled)
+		{
+			return;
+		}
+		_throttled = throttled;
+	}
+	if (!throttled)
+	{
+		_wake.notify_all();
+	}
+}
+
+void AssetStreamer::read_ahead(AssetType type, const std::string& path, bool compress)
+{
+	// with an asset cache the file is under a key only the load itself works out
+	std::string file = path;
+	if (type == AssetType::Mesh && _cache == nullptr)
+	{
+		file = Mesh::cache_path(path);
+	}
+	else if (type == AssetType::Texture && compress && _cache == nullptr)
+	{
+		file = Texture::cache_path(path);
+	}
+	else if (type != AssetType::Impostor && _cache != nullptr)
+	{
+		return;
+	}
+
+	uint64_t offset;
+	uint64_t size;
+	if (_archive != nullptr && _archive->locate(file, offset, size))
+	{
+		_reader.prefetch(_archive->path(), offset, size);
+		return;
+	}
+	// no cache yet: the load parses the source
+	std::error_code ec;
+	_reader.prefetch(std::filesystem::exists(file, ec) ? file : path);
+}
+
+void AssetStreamer::loader_loop()
+{
+	cpu_profiler::set_thread_name("asset loader");
+	struct ReadAhead {
+		AssetType type;
+		std::string path;
+		bool compress;
+	};
+	std::vector<ReadAhead> readAheads;
+	while (true)
+	{
+		Request request;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_wake.wait(lock, [this]() { return _stopping || (!_requests.empty() && !_throttled); });
+			if (_stopping)
+			{
+				return;
+			}
+
+			request = std::move(_requests.front());
+			_requests.pop_front();
+			_loading++;
+
+			// the files are opened after the lock is let go
+			readAheads.clear();
+			if (_reader.backend() != AsyncFileReader::Backend::None)
+			{
+				const size_t count = std::min(_requests.size(), READ_AHEAD_REQUESTS);
+				for (size_t i = 0; i < count; i++)
+				{
+					if (!_requests[i].readAhead)
+					{
+						_requests[i].readAhead = true;
+						readAheads.push_back({ _requests[i].type, _requests[i].path, _requests[i].compress });
+					}
+				}
+			}
+		}
+
+		// the reads go on in the kernel while this thread decodes; whatever they bring in the next loads'
+		// mappings find resident
+		for (const ReadAhead& readAhead : readAheads)
+		{
+			read_ahead(readAhead.type, readAhead.path, readAhead.compress);
+		}
+		_reader.pump();
+
+		if (request.type == AssetType::Texture)
+		{
+			// image decoding (or a cache conversion) is the expensive part
+			LoadedTexture result;
+			result.name = request.name;
+			const uint64_t startNs = cpu_profiler::now_ns();
+			{
+				CPU_PROFILE_SCOPE("load texture");
+				result.loaded = result.texture.load_from_file(request.path.c_str(), request.compress, _archive, _cache);
+			}
+			result.loadMs = static_cast<double>(cpu_profiler::now_ns() - startNs) / 1e6;
+
+			std::lock_guard<std::mutex> lock(_mutex);
+			_loadedTextures.push_back(std::move(result));
+			_loading--;
+			continue;
+		}
+
+		if (request.type == AssetType::Impostor)
+		{
+			// a bake renders every view of the mesh, so a current cache is worth the check
+			LoadedImpostor result;
+			result.name = request.name;
+			const uint64_t startNs = cpu_profiler::now_ns();
+			{
+				CPU_PROFILE_SCOPE("load impostor");
+				result.loaded = result.atlas.load(request.path.c_str(), request.sourcePath.c_str(), {}, _archive);
+				if (!result.loaded)
+				{
+					request.geometry.unpack_indices();
+					result.loaded = result.atlas.bake(request.geometry);
+					if (result.loaded && !result.atlas.save(request.path.c_str(), request.sourcePath.c_str()))
+					{
+						LOG_WARN("could not write " << request.path << ", the impostor is baked again next run");
+					}
+				}
+			}
+			result.loadMs = static_cast<double>(cpu_profiler::now_ns() - startNs) / 1e6;
+
+			std::lock_guard<std::mutex> lock(_mutex);
+			_loadedImpostors.push_back(std::move(result));
+			_loading--;
+			continue;
+		}
+
+		// parsing, optimization and LOD generation all happen here, off the render thread
+		LoadedMesh result;
+		result.name = request.name;
+		result.path = request.path;
+		const uint64_t startNs = cpu_profiler::now_ns();
+		{
+			CPU_PROFILE_SCOPE("load mesh");
+			result.loaded = Mesh::load_parts(request.path.c_str(), result.parts, _archive, _packedIndices, _compressMeshCaches, _cache);
+		}
+		for (Mesh& part : result.parts)
+		{
+			part.set_vertex_format(request.format);
+		}
+		result.loadMs = static_cast<double>(cpu_profiler::now_ns() - startNs) / 1e6;
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_loaded.push_back(std::move(result));
+			_loading--;
+		}
+	}
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "AsyncFileReader.h"
+#include "Impostors.h"
+#include "Mesh.h"
+#include "Texture.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Loads meshes, decodes textures and bakes impostors on a background thread.
+// The render thread queues requests and polls the take_loaded functions once per frame; the loader
+// never touches Vulkan, so uploading and publishing the assets stays with the caller.
+class AssetStreamer
+{
+public:
+	struct LoadedMesh {
+		std::string name;
+		std::string path; // the file it came from
+		// a mesh per material of the file (see Mesh::load_obj_parts); name refers to the first
+		std::vector<Mesh> parts;
+		bool loaded; // false if the file couldn't be read; parts is empty then
+		double loadMs; // on the loader, queueing not included
+	};
+
+	struct LoadedTexture {
+		std::string name;
+		Texture texture; // CPU data only, nothing on the GPU yet
+		bool loaded;
+		double loadMs;
+	};
+
+	struct LoadedImpostor {
+		std::string name;
+		ImpostorAtlas atlas;
+		bool loaded; // false if there was neither a current cache nor anything to bake
+		double loadMs; // a bake included
+	};
+
+	// archive, if given, is searched before the loose files and must stay open until stop()
+	// packedIndices hands cached 32-bit meshes over with their indices still packed (see Mesh::_packedIndices)
+	// compressMeshCaches writes the caches of meshes imported from OBJ compressed (see Mesh::save_to_cache)
+	// cache, if given, holds the derived data instead of the folders next to the sources, and must stay open until stop()
+	// readAhead reads the files of the next few queued requests while the loader works on one (see AsyncFileReader)
+	void start(const AssetArchive* archive = nullptr, bool packedIndices = false, bool compressMeshCaches = false, AssetCache* cache = nullptr,
+		bool readAhead = true);
+	// drops queued requests and joins the loader; a load in progress finishes first
+	void stop();
+
+	void request_mesh(const std::string& name, const std::string& path, VertexFormat format);
+	// compress goes through the BC texture cache (see Texture::load_from_file)
+	void request_texture(const std::string& name, const std::string& path, bool compress);
+	// the atlas at path when it's newer than sourcePath, otherwise one baked from geometry (its vertices, level 0
+	// of its indices, packed or not, its bounds and base color) and saved to path for the next run
+	void request_impostor(const std::string& name, const std::string& path, const std::string& sourcePath, Mesh geometry);
+
+	// meshes finished since the last call, in completion order
+	std::vector<LoadedMesh> take_loaded();
+	// textures decoded since the last call, in completion order
+	std::vector<LoadedTexture> take_loaded_textures();
+	// impostors loaded or baked since the last call, in completion order
+	std::vector<LoadedImpostor> take_loaded_impostors();
+
+	// true while requests are queued, loading, or waiting in take_loaded()
+	bool busy();
+
+	// back-pressure from the uploads: while throttled the loader finishes what it started and takes nothing
+	// new, so decoded assets don't pile up in memory faster than the staging ring drains them
+	void set_throttled(bool throttled);
+
+private:
+	enum class AssetType {
+		Mesh,
+		Texture,
+		Impostor,
+	};
+
+	struct Request {
+		AssetType type;
+		std::string name;
+		std::string path;
+		VertexFormat format; // meshes only
+		bool compress; // textures only
+		std::string sourcePath; // impostors only
+		Mesh geometry; // impostors only
+		bool readAhead{ false }; // its files were queued on _reader
+	};
+
+	void loader_loop();
+	// queues the file the request's load opens first
+	void read_ahead(AssetType type, const std::string& path, bool compress);
+
+	const AssetArchive* _archive{ nullptr };
+	AssetCache* _cache{ nullptr };
+	bool _packedIndices{ false };
+	bool _compressMeshCaches{ false };
+	// the loader's own; requests this many places behind the one loading are read ahead
+	AsyncFileReader _reader;
+	static constexpr size_t READ_AHEAD_REQUESTS = 4;
+	std::thread _thread;
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	std::deque<Request> _requests;
+	std::vector<LoadedMesh> _loaded;
+	std::vector<LoadedTexture> _loadedTextures;
+	std::vector<LoadedImpostor> _loadedImpostors;
+	size_t _loading{ 0 };
+	bool _throttled{ false };
+	bool _stopping{ false };
+};
@@ -0,0 +1,59 @@
+#include "AssetWatcher.h"
+
+#include <filesystem>
+
+namespace {
+	int64_t write_time(const std::string& path)
+	{
+		std::error_code ec;
+		auto writeTime = std::filesystem::last_write_time(path, ec);
+		return ec ? 0 : static_cast<int64_t>(writeTime.time_since_epoch().count());
+	}
+}
+
+void AssetWatcher::watch_mesh(const std::string& name, const std::string& path, VertexFormat format)
+{
+	watch({ name, path, false, format, false });
+}
+
+void AssetWatcher::watch_texture(const std::string& name, const std::string& path, bool compress)
+{
+	watch({ name, path, true, VertexFormat::Full, compress });
+}
+
+void AssetWatcher::watch(Source source)
+{
+	for (const Watched& watched : _watched)
+	{
+		if (watched.source.texture == source.texture && watched.source.name == source.name)
+		{
+			return;
+		}
+	}
+	const int64_t time = write_time(source.path);
+	_watched.push_back({ std::move(source), time });
+}
+
+std::vector<AssetWatcher::Source> AssetWatcher::poll(const std::function<bool(const Source&)>& ready)
+{
+	std::vector<Source> changed;
+	const auto now = std::chrono::steady_clock::now();
+	if (_watched.empty() || now - _lastPoll < pollInterval)
+	{
+		return changed;
+	}
+	_lastPoll = now;
+
+	for (Watched& watched : _watched)
+	{
+		// a file being replaced can be missing for a moment; it counts once it's back
+		const int64_t time = write_time(watched.source.path);
+		if (time == 0 || time == watched.time || !ready(watched.source))
+		{
+			continue;
+		}
+		watched.time = time;
+		changed.push_back(watched.source);
+	}
+	return changed;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <Mesh.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Notices when the files meshes and textures were streamed from change on disk, so the engine can
+// request them again. Sources are noted with the request they were loaded by; poll() checks their write
+// times every pollInterval and hands back the changed ones. Only the source itself is watched: an OBJ's
+// .mtl or a texture's BC cache changing alone reloads nothing.
+class AssetWatcher
+{
+public:
+	struct Source {
+		std::string name;
+		std::string path;
+		bool texture; // a mesh otherwise
+		VertexFormat format; // meshes only
+		bool compress; // textures only
+	};
+
+	// path was, or is being, loaded as name; the time it has now is the one changes are seen against
+	void watch_mesh(const std::string& name, const std::string& path, VertexFormat format);
+	void watch_texture(const std::string& name, const std::string& path, bool compress);
+
+	// once per frame; every pollInterval, the sources written since the last poll that ready accepts. One it
+	// refuses (its asset isn't resident yet, or is reloading already) keeps its old time and comes back next poll
+	std::vector<Source> poll(const std::function<bool(const Source&)>& ready);
+
+	std::chrono::milliseconds pollInterval{ 500 };
+
+private:
+	void watch(Source source);
+
+	struct Watched {
+		Source source;
+		int64_t time; // 0 while the file can't be found
+	};
+	std::vector<Watched> _watched;
+	std::chrono::steady_clock::time_point _lastPoll{};
+};
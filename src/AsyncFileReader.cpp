@@ -0,0 +1,485 @@
+#include "AsyncFileReader.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#define QC_HAVE_IO_URING 1
+#endif
+#endif
+
+const char* async_file_backend_name(AsyncFileReader::Backend backend)
+{
+	switch (backend)
+	{
+	case AsyncFileReader::Backend::IoUring: return "io_uring";
+	case AsyncFileReader::Backend::Overlapped: return "overlapped";
+	case AsyncFileReader::Backend::Advise: return "fadvise";
+	default: return "none";
+	}
+}
+
+#if !defined(_WIN32)
+// the three mappings io_uring_setup hands out; no liburing, the kernel interface is small enough
+struct AsyncFileReader::Ring {
+#ifdef QC_HAVE_IO_URING
+	int fd{ -1 };
+	void* sq{ nullptr };
+	size_t sqSize{ 0 };
+	void* cq{ nullptr };
+	size_t cqSize{ 0 };
+	io_uring_sqe* sqes{ nullptr };
+	size_t sqesSize{ 0 };
+	unsigned* sqTail{ nullptr };
+	unsigned* sqMask{ nullptr };
+	unsigned* sqArray{ nullptr };
+	unsigned* cqHead{ nullptr };
+	unsigned* cqTail{ nullptr };
+	unsigned* cqMask{ nullptr };
+	io_uring_cqe* cqes{ nullptr };
+	unsigned pending{ 0 }; // queued since the last enter
+
+	bool setup(uint32_t entries)
+	{
+		io_uring_params params = {};
+		fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+		if (fd < 0)
+		{
+			return false;
+		}
+		sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		const bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if (single)
+		{
+			sqSize = cqSize = std::max(sqSize, cqSize);
+		}
+		sq = mmap(nullptr, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+		if (sq == MAP_FAILED)
+		{
+			sq = nullptr;
+			teardown();
+			return false;
+		}
+		cq = single ? sq : mmap(nullptr, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (cq == MAP_FAILED)
+		{
+			cq = nullptr;
+			teardown();
+			return false;
+		}
+		sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+		void* entriesMapping = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+		if (entriesMapping == MAP_FAILED)
+		{
+			teardown();
+			return false;
+		}
+		sqes = static_cast<io_uring_sqe*>(entriesMapping);
+
+		uint8_t* sqBytes = static_cast<uint8_t*>(sq);
+		sqTail = reinterpret_cast<unsigned*>(sqBytes + params.sq_off.tail);
+		sqMask = reinterpret_cast<unsigned*>(sqBytes + params.sq_off.ring_mask);
+		sqArray = reinterpret_cast<unsigned*>(sqBytes + params.sq_off.array);
+		uint8_t* cqBytes = static_cast<uint8_t*>(cq);
+		cqHead = reinterpret_cast<unsigned*>(cqBytes + params.cq_off.head);
+		cqTail = reinterpret_cast<unsigned*>(cqBytes + params.cq_off.tail);
+		cqMask = reinterpret_cast<unsigned*>(cqBytes + params.cq_off.ring_mask);
+		cqes = reinterpret_cast<io_uring_cqe*>(cqBytes + params.cq_off.cqes);
+		return true;
+	}
+
+	void teardown()
+	{
+		if (sqes != nullptr)
+		{
+			munmap(sqes, sqesSize);
+		}
+		if (cq != nullptr && cq != sq)
+		{
+			munmap(cq, cqSize);
+		}
+		if (sq != nullptr)
+		{
+			munmap(sq, sqSize);
+		}
+		if (fd >= 0)
+		{
+			::close(fd);
+		}
+		*this = Ring{};
+	}
+
+	// readv rather than read: IORING_OP_READV is in every kernel with io_uring
+	void queue_read(int file, const iovec* iov, uint64_t offset, uint64_t tag)
+	{
+		const unsigned tail = *sqTail;
+		const unsigned index = tail & *sqMask;
+		io_uring_sqe& entry = sqes[index];
+		memset(&entry, 0, sizeof(entry));
+		entry.opcode = IORING_OP_READV;
+		entry.fd = file;
+		entry.addr = reinterpret_cast<uint64_t>(iov);
+		entry.len = 1;
+		entry.off = offset;
+		entry.user_data = tag;
+		sqArray[index] = index;
+		__atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+		pending++;
+	}
+
+	// submits what was queued and, with wait, blocks until at least one read finished
+	void enter(bool wait)
+	{
+		const unsigned flags = wait ? IORING_ENTER_GETEVENTS : 0;
+		if (pending > 0 || wait)
+		{
+			const long submitted = syscall(__NR_io_uring_enter, fd, pending, wait ? 1 : 0, flags, nullptr, 0);
+			if (submitted > 0)
+			{
+				pending -= std::min(pending, static_cast<unsigned>(submitted));
+			}
+		}
+	}
+
+	template<typename F>
+	void drain(F&& completed)
+	{
+		unsigned head = *cqHead;
+		while (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE))
+		{
+			const io_uring_cqe& entry = cqes[head & *cqMask];
+			completed(entry.user_data, static_cast<int64_t>(entry.res));
+			head++;
+		}
+		__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+	}
+#endif
+};
+#endif
+
+AsyncFileReader::~AsyncFileReader()
+{
+	stop();
+}
+
+void AsyncFileReader::start(uint32_t queueDepth)
+{
+	stop();
+	_queueDepth = std::max(queueDepth, 1u);
+	_slots.assign(_queueDepth, Slot{});
+	_freeSlots.clear();
+	for (uint32_t i = _queueDepth; i > 0; i--)
+	{
+		_freeSlots.push_back(i - 1);
+	}
+
+#ifdef _WIN32
+	for (Slot& slot : _slots)
+	{
+		OVERLAPPED* overlapped = new OVERLAPPED();
+		overlapped->hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+		slot.overlapped = overlapped;
+	}
+	_backend = Backend::Overlapped;
+#else
+	_backend = Backend::Advise;
+#ifdef QC_HAVE_IO_URING
+	// seccomp profiles and older kernels refuse it; the hint still helps there
+	Ring* ring = new Ring();
+	if (ring->setup(_queueDepth))
+	{
+		_ring = ring;
+		for (Slot& slot : _slots)
+		{
+			slot.iov = new iovec();
+		}
+		_backend = Backend::IoUring;
+	}
+	else
+	{
+		delete ring;
+	}
+#endif
+#endif
+	if (_backend != Backend::Advise)
+	{
+		_scratch.resize(CHUNK_SIZE);
+	}
+}
+
+void AsyncFileReader::stop()
+{
+	if (_backend == Backend::None)
+	{
+		return;
+	}
+	while (_inFlight > 0)
+	{
+		reap(true);
+	}
+	for (File& file : _queued)
+	{
+		close(file);
+	}
+	_queued.clear();
+
+#ifdef _WIN32
+	for (Slot& slot : _slots)
+	{
+		OVERLAPPED* overlapped = static_cast<OVERLAPPED*>(slot.overlapped);
+		CloseHandle(overlapped->hEvent);
+		delete overlapped;
+	}
+#else
+	for (Slot& slot : _slots)
+	{
+		delete static_cast<iovec*>(slot.iov);
+	}
+#ifdef QC_HAVE_IO_URING
+	if (_ring != nullptr)
+	{
+		_ring->teardown();
+	}
+#endif
+	delete _ring;
+	_ring = nullptr;
+#endif
+	_slots.clear();
+	_freeSlots.clear();
+	_scratch.clear();
+	_scratch.shrink_to_fit();
+	_backend = Backend::None;
+}
+
+void AsyncFileReader::prefetch(const std::string& path, uint64_t offset, uint64_t size)
+{
+	if (_backend == Backend::None)
+	{
+		return;
+	}
+	File file;
+	file.path = path;
+	file.offset = offset;
+	// the end is only known once the file is open, where a whole-file read finds its size
+	file.end = size > 0 ? offset + size : 0;
+	_queued.push_back(std::move(file));
+}
+
+bool AsyncFileReader::open(File& file)
+{
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(file.path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (handle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(handle, &fileSize))
+	{
+		CloseHandle(handle);
+		return false;
+	}
+	const uint64_t size = static_cast<uint64_t>(fileSize.QuadPart);
+	file.handle = reinterpret_cast<intptr_t>(handle);
+#else
+	const int fd = ::open(file.path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0)
+	{
+		::close(fd);
+		return false;
+	}
+	const uint64_t size = static_cast<uint64_t>(fileStat.st_size);
+	file.handle = fd;
+#endif
+	file.end = file.end == 0 ? size : std::min(file.end, size);
+	return true;
+}
+
+void AsyncFileReader::close(File& file)
+{
+	if (file.handle == -1)
+	{
+		return;
+	}
+#ifdef _WIN32
+	CloseHandle(reinterpret_cast<HANDLE>(file.handle));
+#else
+	::close(static_cast<int>(file.handle));
+#endif
+	file.handle = -1;
+}
+
+bool AsyncFileReader::submit(File& file, Slot& slot)
+{
+	slot.file = &file;
+	slot.size = static_cast<size_t>(std::min<uint64_t>(CHUNK_SIZE, file.end - file.offset));
+#ifdef _WIN32
+	OVERLAPPED* overlapped = static_cast<OVERLAPPED*>(slot.overlapped);
+	ResetEvent(overlapped->hEvent);
+	overlapped->Offset = static_cast<DWORD>(file.offset & 0xffffffffu);
+	overlapped->OffsetHigh = static_cast<DWORD>(file.offset >> 32);
+	if (!ReadFile(reinterpret_cast<HANDLE>(file.handle), _scratch.data(), static_cast<DWORD>(slot.size), nullptr, overlapped)
+		&& GetLastError() != ERROR_IO_PENDING)
+	{
+		return false;
+	}
+#elif defined(QC_HAVE_IO_URING)
+	// every chunk lands in the same scratch memory; what it held doesn't matter
+	iovec* iov = static_cast<iovec*>(slot.iov);
+	iov->iov_base = _scratch.data();
+	iov->iov_len = slot.size;
+	_ring->queue_read(static_cast<int>(file.handle), iov, file.offset, static_cast<uint64_t>(&slot - _slots.data()));
+#else
+	return false;
+#endif
+	file.offset += slot.size;
+	file.reading++;
+	_inFlight++;
+	return true;
+}
+
+void AsyncFileReader::finish(Slot& slot, int64_t result)
+{
+	if (result > 0)
+	{
+		_bytesRead += static_cast<uint64_t>(result);
+	}
+	File& file = *slot.file;
+	file.reading--;
+	if (result < 0)
+	{
+		// the rest of a file that failed to read isn't worth trying
+		file.offset = file.end;
+	}
+	if (file.reading == 0 && file.offset >= file.end)
+	{
+		close(file);
+		file.done = true;
+	}
+	slot.file = nullptr;
+	_freeSlots.push_back(static_cast<uint32_t>(&slot - _slots.data()));
+	_inFlight--;
+}
+
+void AsyncFileReader::reap(bool wait)
+{
+#ifdef _WIN32
+	for (Slot& slot : _slots)
+	{
+		if (slot.file == nullptr)
+		{
+			continue;
+		}
+		OVERLAPPED* overlapped = static_cast<OVERLAPPED*>(slot.overlapped);
+		DWORD bytes = 0;
+		if (GetOverlappedResult(reinterpret_cast<HANDLE>(slot.file->handle), overlapped, &bytes, wait ? TRUE : FALSE))
+		{
+			finish(slot, static_cast<int64_t>(bytes));
+		}
+		else if (GetLastError() != ERROR_IO_INCOMPLETE)
+		{
+			finish(slot, -1);
+		}
+	}
+#elif defined(QC_HAVE_IO_URING)
+	if (_ring == nullptr)
+	{
+		return;
+	}
+	_ring->enter(wait && _inFlight > 0);
+	_ring->drain([this](uint64_t tag, int64_t result) { finish(_slots[tag], result); });
+#else
+	(void)wait;
+#endif
+}
+
+void AsyncFileReader::pump()
+{
+	if (_backend == Backend::None)
+	{
+		return;
+	}
+	if (_backend == Backend::Advise)
+	{
+		// the kernel queues the reads itself; nothing stays in flight here
+		for (File& file : _queued)
+		{
+#if !defined(_WIN32)
+			if (open(file))
+			{
+				posix_fadvise(static_cast<int>(file.handle), static_cast<off_t>(file.offset), static_cast<off_t>(file.end - file.offset), POSIX_FADV_WILLNEED);
+				close(file);
+			}
+#endif
+		}
+		_queued.clear();
+		return;
+	}
+
+	reap(false);
+
+	// front to back, so the file the loader wants next is read first
+	for (File& file : _queued)
+	{
+		if (_freeSlots.empty())
+		{
+			break;
+		}
+		if (file.done)
+		{
+			continue;
+		}
+		if (file.handle == -1 && !open(file))
+		{
+			file.done = true;
+			continue;
+		}
+		while (!_freeSlots.empty() && file.handle != -1 && file.offset < file.end)
+		{
+			Slot& slot = _slots[_freeSlots.back()];
+			_freeSlots.pop_back();
+			if (!submit(file, slot))
+			{
+				_freeSlots.push_back(static_cast<uint32_t>(&slot - _slots.data()));
+				file.offset = file.end;
+				break;
+			}
+		}
+		if (file.reading == 0 && file.offset >= file.end)
+		{
+			close(file);
+			file.done = true;
+		}
+	}
+#ifdef QC_HAVE_IO_URING
+	if (_ring != nullptr)
+	{
+		_ring->enter(false);
+	}
+#endif
+
+	// finished files leave from the front; one behind a file still reading waits its turn
+	while (!_queued.empty() && _queued.front().done)
+	{
+		_queued.pop_front();
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+// Reads files ahead of the loader through the page cache, many chunked reads in flight at once, so the
+// memory mapping the loader then opens (MappedFile, AssetArchive) finds its pages resident instead of
+// faulting them in one at a time. What a read brings in is dropped; only the page cache keeps it.
+// Backends: io_uring where the kernel has it, overlapped reads on Windows, and elsewhere (or when
+// io_uring_setup is refused) posix_fadvise WILLNEED, which leaves the queueing to the kernel's read-ahead.
+// Not thread-safe: one thread queues and pumps.
+class AsyncFileReader
+{
+public:
+	enum class Backend : uint32_t {
+		None, // not started
+		IoUring,
+		Overlapped,
+		Advise,
+	};
+
+	AsyncFileReader() = default;
+	~AsyncFileReader();
+
+	AsyncFileReader(const AsyncFileReader&) = delete;
+	AsyncFileReader& operator=(const AsyncFileReader&) = delete;
+
+	// queueDepth reads of CHUNK_SIZE in flight at most
+	void start(uint32_t queueDepth);
+	// waits for the reads in flight and closes every file
+	void stop();
+
+	// queues size bytes of path from offset, the whole file for size 0
+	void prefetch(const std::string& path, uint64_t offset = 0, uint64_t size = 0);
+	// reaps finished reads and submits queued ones up to the queue depth; never blocks
+	void pump();
+
+	bool idle() const { return _queued.empty() && _inFlight == 0; }
+	Backend backend() const { return _backend; }
+	uint64_t bytes_read() const { return _bytesRead; }
+
+	static constexpr size_t CHUNK_SIZE = 1024 * 1024;
+
+private:
+	struct File {
+		std::string path;
+		uint64_t offset{ 0 };
+		uint64_t end{ 0 }; // 0 until opened
+		intptr_t handle{ -1 };
+		uint32_t reading{ 0 }; // chunks in flight
+		bool done{ false }; // read to the end, or failed, and closed
+	};
+
+	// a chunk in flight: which file, and the backend's own state for it
+	struct Slot {
+		File* file{ nullptr };
+		size_t size{ 0 };
+#ifdef _WIN32
+		void* overlapped{ nullptr };
+#else
+		void* iov{ nullptr };
+#endif
+	};
+
+	bool open(File& file);
+	void close(File& file);
+	bool submit(File& file, Slot& slot);
+	void reap(bool wait);
+	void finish(Slot& slot, int64_t result);
+
+	Backend _backend{ Backend::None };
+	uint32_t _queueDepth{ 0 };
+	std::deque<File> _queued; // front first, the front ones possibly being read
+	std::vector<Slot> _slots;
+	std::vector<uint32_t> _freeSlots;
+	uint32_t _inFlight{ 0 };
+	std::vector<uint8_t> _scratch; // every read lands here; nothing reads it
+	uint64_t _bytesRead{ 0 };
+
+#if !defined(_WIN32)
+	struct Ring;
+	Ring* _ring{ nullptr };
+#endif
+};
+
+const char* async_file_backend_name(AsyncFileReader::Backend backend);
@@ -0,0 +1,240 @@
+#include "AutoTune.h"
+
+#include "Log.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace {
+	// how much faster a candidate must be than the best so far to replace it; below that it's noise
+	constexpr double MARGIN = 0.03;
+
+	// what a frame of result costs, whichever side it waits on; p95, since a setting that trades smoothness
+	// for throughput is no win
+	double frame_ms(const BenchmarkResult& result)
+	{
+		return std::max(result.cpu.p95, result.gpu.p95);
+	}
+}
+
+std::string tuning::path(const std::string& directory, const std::string& deviceUuid)
+{
+	return (std::filesystem::path(directory) / (deviceUuid + ".cfg")).string();
+}
+
+bool tuning::load(const std::string& path, TunedSettings& settings)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		return false;
+	}
+	std::string line;
+	while (std::getline(file, line))
+	{
+		const size_t equals = line.find('=');
+		if (line.empty() || line[0] == '#' || equals == std::string::npos)
+		{
+			continue;
+		}
+		const std::string key = line.substr(0, equals);
+		const uint64_t value = strtoull(line.c_str() + equals + 1, nullptr, 10);
+		if (key == "frames_in_flight") settings.frameOverlap = static_cast<uint32_t>(value);
+		else if (key == "job_threads") settings.jobThreads = static_cast<uint32_t>(value);
+		else if (key == "cull_chunk") settings.cullChunkSize = static_cast<uint32_t>(value);
+		else if (key == "upload_budget_bytes") settings.uploadBytesPerFrame = value;
+		else if (key == "msaa" && (value == 1 || value == 2 || value == 4 || value == 8)) settings.msaaSamples = static_cast<VkSampleCountFlagBits>(value);
+	}
+	return true;
+}
+
+bool tuning::save(const std::string& path, const TunedSettings& settings, const std::string& deviceName)
+{
+	std::error_code ec;
+	const std::filesystem::path parent = std::filesystem::path(path).parent_path();
+	if (!parent.empty())
+	{
+		std::filesystem::create_directories(parent, ec);
+	}
+	std::ofstream file(path, std::ios::trunc);
+	if (!file)
+	{
+		LOG_ERROR("Couldn't write the tuning to " << path);
+		return false;
+	}
+	file << "# calibrated on " << deviceName << "; delete the file, or start with --calibrate, to measure again\n"
+		<< "frames_in_flight=" << settings.frameOverlap << "\n"
+		<< "job_threads=" << settings.jobThreads << "\n"
+		<< "cull_chunk=" << settings.cullChunkSize << "\n"
+		<< "upload_budget_bytes=" << settings.uploadBytesPerFrame << "\n"
+		<< "msaa=" << static_cast<uint32_t>(settings.msaaSamples) << "\n";
+	return static_cast<bool>(file);
+}
+
+std::string tuning::describe(const TunedSettings& settings)
+{
+	std::ostringstream text;
+	text << settings.frameOverlap << " frames in flight, " << settings.jobThreads << " job workers, culling chunks of "
+		<< settings.cullChunkSize << ", " << settings.uploadBytesPerFrame / (1024 * 1024) << " MiB of uploads a frame, "
+		<< static_cast<uint32_t>(settings.msaaSamples) << "x MSAA";
+	return text.str();
+}
+
+AutoTuner::AutoTuner(const TunedSettings& start, uint32_t pinned, VkSampleCountFlags msaaCounts, double frameBudgetMs)
+	: _frameBudgetMs(frameBudgetMs), _best(start)
+{
+	const uint32_t cores = std::max(std::thread::hardware_concurrency(), 2u);
+	if (_best.jobThreads == 0)
+	{
+		_best.jobThreads = cores - 1;
+	}
+
+	// the ones that only cost time first, so MSAA is judged on the fastest configuration
+	auto add = [&](TunedParameter parameter, std::vector<uint64_t> values) {
+		if (pinned & parameter)
+		{
+			return;
+		}
+		const uint64_t current = get(_best, parameter);
+		std::vector<uint64_t> candidates;
+		for (uint64_t value : values)
+		{
+			if (value != current && std::find(candidates.begin(), candidates.end(), value) == candidates.end())
+			{
+				candidates.push_back(value);
+			}
+		}
+		_steps.push_back({ parameter, std::move(candidates) });
+	};
+	// leaving cores to the driver's threads and the rest of the machine can beat taking them all
+	std::vector<uint64_t> workers;
+	for (uint32_t count : { cores - 1, cores - 2, cores / 2, cores / 4 })
+	{
+		if (count >= 1)
+		{
+			workers.push_back(count);
+		}
+	}
+	add(TUNE_JOB_THREADS, workers);
+	add(TUNE_CULL_CHUNK, { 4096, 16384, 65536 });
+	// VulkanEngine runs 2 or 3
+	add(TUNE_FRAME_OVERLAP, { 2, 3 });
+	add(TUNE_UPLOAD_BUDGET, { 8ull * 1024 * 1024, 32ull * 1024 * 1024, 128ull * 1024 * 1024 });
+	std::vector<uint64_t> samples;
+	for (uint64_t count : { 2, 4, 8 })
+	{
+		if ((msaaCounts & count) != 0 && count > static_cast<uint64_t>(_best.msaaSamples))
+		{
+			samples.push_back(count);
+		}
+	}
+	add(TUNE_MSAA, samples);
+}
+
+uint64_t AutoTuner::get(const TunedSettings& settings, TunedParameter parameter)
+{
+	switch (parameter)
+	{
+	case TUNE_FRAME_OVERLAP: return settings.frameOverlap;
+	case TUNE_JOB_THREADS: return settings.jobThreads;
+	case TUNE_CULL_CHUNK: return settings.cullChunkSize;
+	case TUNE_UPLOAD_BUDGET: return settings.uploadBytesPerFrame;
+	case TUNE_MSAA: return static_cast<uint64_t>(settings.msaaSamples);
+	default: return 0;
+	}
+}
+
+void AutoTuner::set(TunedSettings& settings, TunedParameter parameter, uint64_t value)
+{
+	switch (parameter)
+	{
+	case TUNE_FRAME_OVERLAP: settings.frameOverlap = static_cast<uint32_t>(value); break;
+	case TUNE_JOB_THREADS: settings.jobThreads = static_cast<uint32_t>(value); break;
+	case TUNE_CULL_CHUNK: settings.cullChunkSize = static_cast<uint32_t>(value); break;
+	case TUNE_UPLOAD_BUDGET: settings.uploadBytesPerFrame = value; break;
+	case TUNE_MSAA: settings.msaaSamples = static_cast<VkSampleCountFlagBits>(value); break;
+	default: break;
+	}
+}
+
+bool AutoTuner::next(TunedSettings& settings)
+{
+	if (_failed)
+	{
+		return false;
+	}
+	if (!_measuredBest)
+	{
+		_pending = _best;
+		settings = _pending;
+		return true;
+	}
+	while (_step < _steps.size())
+	{
+		const Step& step = _steps[_step];
+		if (_candidate < step.candidates.size())
+		{
+			_pending = _best;
+			set(_pending, step.parameter, step.candidates[_candidate++]);
+			settings = _pending;
+			return true;
+		}
+		_step++;
+		_candidate = 0;
+	}
+	_finished = true;
+	return false;
+}
+
+void AutoTuner::report(const BenchmarkResult& result)
+{
+	_runs++;
+	if (!result.completed)
+	{
+		_failed = true;
+		return;
+	}
+	if (!_measuredBest)
+	{
+		_bestResult = result;
+		_measuredBest = true;
+		return;
+	}
+
+	const Step& step = _steps[_step];
+	if (better(step.parameter, result))
+	{
+		_best = _pending;
+		_bestResult = result;
+	}
+	else if (step.parameter == TUNE_MSAA)
+	{
+		// the candidates go up, and more samples won't fit where these didn't
+		_candidate = step.candidates.size();
+	}
+}
+
+bool AutoTuner::better(TunedParameter parameter, const BenchmarkResult& measured) const
+{
+	if (parameter == TUNE_MSAA)
+	{
+		return frame_ms(measured) <= _frameBudgetMs;
+	}
+	if (parameter == TUNE_UPLOAD_BUDGET)
+	{
+		// only the frames that streamed say anything about the budget: the scene should be in sooner, without
+		// those frames missing the refresh where the best didn't; or, where the best does, missing it by less
+		if (measured.streaming.count == 0 || _bestResult.streaming.count == 0)
+		{
+			return false;
+		}
+		const bool sooner = measured.streamingMs < _bestResult.streamingMs * (1.0 - MARGIN)
+			&& measured.streaming.p95 <= std::max(_frameBudgetMs, _bestResult.streaming.p95);
+		const bool smoother = _bestResult.streaming.p95 > _frameBudgetMs && measured.streaming.p95 < _bestResult.streaming.p95 * (1.0 - MARGIN);
+		return sooner || smoother;
+	}
+	return frame_ms(measured) < frame_ms(_bestResult) * (1.0 - MARGIN);
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vk_types.h>
+#include <Benchmark.h>
+#include <SphereCuller.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The settings whose best value depends on the machine more than on the scene. A calibration on the first start
+// on a GPU measures them with short benchmark runs and keeps the result in a file named after the GPU's UUID,
+// which later starts on that GPU read back instead of the defaults.
+struct TunedSettings {
+	uint32_t frameOverlap{ 2 };
+	uint32_t jobThreads{ 0 }; // workers, 0 for JobSystem's one per core but the caller's
+	uint32_t cullChunkSize{ SphereCuller::DEFAULT_CHUNK_SIZE };
+	VkDeviceSize uploadBytesPerFrame{ 32ull * 1024 * 1024 };
+	VkSampleCountFlagBits msaaSamples{ VK_SAMPLE_COUNT_1_BIT };
+};
+
+// one bit per setting, for the ones the command line gave: neither a calibration nor a stored tuning changes those
+enum TunedParameter : uint32_t {
+	TUNE_FRAME_OVERLAP = 1 << 0,
+	TUNE_JOB_THREADS = 1 << 1,
+	TUNE_CULL_CHUNK = 1 << 2,
+	TUNE_UPLOAD_BUDGET = 1 << 3,
+	TUNE_MSAA = 1 << 4,
+	TUNE_ALL = (1 << 5) - 1,
+};
+
+namespace tuning {
+	// directory/<uuid>.cfg
+	std::string path(const std::string& directory, const std::string& deviceUuid);
+	// false when there is none; key=value lines, unknown keys skipped so files from other builds still load
+	bool load(const std::string& path, TunedSettings& settings);
+	bool save(const std::string& path, const TunedSettings& settings, const std::string& deviceName);
+	// one line for the log
+	std::string describe(const TunedSettings& settings);
+}
+
+// Coordinate descent over TunedSettings: one setting at a time, every candidate value one benchmark run with the
+// others at their best so far. The settings that only cost time keep a candidate only when it is clearly faster,
+// so run-to-run noise doesn't pick them; MSAA is quality, and goes as high as still fits the frame budget.
+class AutoTuner
+{
+public:
+	// start is measured first and improved on; pinned holds the TunedParameter bits to leave alone and
+	// msaaCounts the sample counts the device renders; frameBudgetMs is the display's refresh interval
+	AutoTuner(const TunedSettings& start, uint32_t pinned, VkSampleCountFlags msaaCounts, double frameBudgetMs);
+
+	// the settings to measure next; false once every setting is settled, or a run failed
+	bool next(TunedSettings& settings);
+	// what the settings the last next() gave measured
+	void report(const BenchmarkResult& result);
+
+	// false when a run was cut short, in which case best() is only as far as calibration got
+	bool finished() const { return _finished; }
+	const TunedSettings& best() const { return _best; }
+	uint32_t runs() const { return _runs; }
+
+private:
+	struct Step {
+		TunedParameter parameter;
+		std::vector<uint64_t> candidates; // the values to try besides the best one, in order
+	};
+
+	static uint64_t get(const TunedSettings& settings, TunedParameter parameter);
+	static void set(TunedSettings& settings, TunedParameter parameter, uint64_t value);
+	// whether measured beats _bestResult for parameter
+	bool better(TunedParameter parameter, const BenchmarkResult& measured) const;
+
+	std::vector<Step> _steps;
+	size_t _step{ 0 };
+	size_t _candidate{ 0 };
+	double _frameBudgetMs;
+
+	TunedSettings _best;
+	BenchmarkResult _bestResult;
+	bool _measuredBest{ false };
+	TunedSettings _pending;
+	bool _failed{ false };
+	bool _finished{ false };
+	uint32_t _runs{ 0 };
+};
@@ -0,0 +1,35 @@
+#include "BarrierBatch.h"
+
+void BarrierBatch::add(const VkImageMemoryBarrier& barrier, VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages)
+{
+	_images.push_back(barrier);
+	_srcStages |= srcStages;
+	_dstStages |= dstStages;
+}
+
+void BarrierBatch::add(const VkBufferMemoryBarrier& barrier, VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages)
+{
+	_buffers.push_back(barrier);
+	_srcStages |= srcStages;
+	_dstStages |= dstStages;
+}
+
+void BarrierBatch::record(VkCommandBuffer cmd)
+{
+	if (empty())
+	{
+		return;
+	}
+	vkCmdPipelineBarrier(cmd, _srcStages != 0 ? _srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		_dstStages != 0 ? _dstStages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+		static_cast<uint32_t>(_buffers.size()), _buffers.data(), static_cast<uint32_t>(_images.size()), _images.data());
+	clear();
+}
+
+void BarrierBatch::clear()
+{
+	_images.clear();
+	_buffers.clear();
+	_srcStages = 0;
+	_dstStages = 0;
+}
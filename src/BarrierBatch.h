@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vk_types.h>
+#include <cstdint>
+#include <vector>
+
+// Image and buffer barriers collected and recorded together: record() makes one vkCmdPipelineBarrier of
+// everything added since the last one, waiting at the union of their destination stages for the union of
+// their source stages. Fewer, wider barriers cost the GPU less than a drain per resource, as long as they
+// all sit at the same point of the command stream anyway, which is where code using this flushes them:
+// a pass boundary, the end of an upload batch, between two mip levels.
+// The barriers' vectors are kept, so steady-state use doesn't allocate.
+class BarrierBatch
+{
+public:
+	void add(const VkImageMemoryBarrier& barrier, VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages);
+	void add(const VkBufferMemoryBarrier& barrier, VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages);
+
+	bool empty() const { return _images.empty() && _buffers.empty(); }
+	uint32_t size() const { return static_cast<uint32_t>(_images.size() + _buffers.size()); }
+
+	// nothing when empty; no source stages waits on nothing (TOP_OF_PIPE), no destination stages blocks
+	// nothing (BOTTOM_OF_PIPE), as a release to another queue does
+	void record(VkCommandBuffer cmd);
+	// drops what was added without recording it
+	void clear();
+
+private:
+	std::vector<VkImageMemoryBarrier> _images;
+	std::vector<VkBufferMemoryBarrier> _buffers;
+	VkPipelineStageFlags _srcStages{ 0 };
+	VkPipelineStageFlags _dstStages{ 0 };
+};
@@ -0,0 +1,305 @@
+#include "Benchmark.h"
+
+#include "Log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+
+BenchmarkSettings parse_benchmark_args(int argc, char* argv[])
+{
+	BenchmarkSettings settings;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		// every option except the flags takes exactly one value
+		const bool hasValue = i + 1 < argc;
+
+		if (strcmp(arg, "--benchmark") == 0)
+		{
+			settings.enabled = true;
+		}
+		else if (strcmp(arg, "--vsync") == 0)
+		{
+			settings.disableVsync = false;
+		}
+		else if (strcmp(arg, "--frames") == 0 && hasValue)
+		{
+			settings.frameCount = static_cast<uint32_t>(std::max(1, atoi(argv[++i])));
+		}
+		else if (strcmp(arg, "--warmup") == 0 && hasValue)
+		{
+			settings.warmupFrames = static_cast<uint32_t>(std::max(0, atoi(argv[++i])));
+		}
+		else if (strcmp(arg, "--scene") == 0 && hasValue)
+		{
+			settings.scene = argv[++i];
+		}
+		else if (strcmp(arg, "--camera") == 0 && hasValue)
+		{
+			const char* path = argv[++i];
+			if (strcmp(path, "orbit") == 0)
+			{
+				settings.cameraPath = CameraPath::Orbit;
+			}
+			else if (strcmp(path, "static") == 0)
+			{
+				settings.cameraPath = CameraPath::Static;
+			}
+			else
+			{
+				LOG_WARN("Unknown camera path '" << path << "', using static.");
+			}
+		}
+		else if (strcmp(arg, "--output") == 0 && hasValue)
+		{
+			settings.outputPath = argv[++i];
+		}
+		else if (strcmp(arg, "--replay") == 0 && hasValue)
+		{
+			settings.enabled = true;
+			settings.replayPath = argv[++i];
+		}
+		else
+		{
+			LOG_WARN("Ignoring unknown argument '" << arg << "'");
+		}
+	}
+
+	return settings;
+}
+
+void BenchmarkReport::reserve(size_t frames)
+{
+	_samples.reserve(frames);
+}
+
+void BenchmarkReport::add_frame(int frameNumber, double cpuFrameMs, double presentMs, const FrameStats& commands)
+{
+	_samples.push_back({ frameNumber, cpuFrameMs, presentMs, -1.0, commands, -1, -1.0, -1.0, -1 });
+}
+
+void BenchmarkReport::add_gpu_time(int frameNumber, double gpuMs, int64_t gpuTriangles)
+{
+	// GPU results trail the CPU by a few frames, so search from the back
+	for (auto it = _samples.rbegin(); it != _samples.rend(); it++)
+	{
+		if (it->frameNumber == frameNumber)
+		{
+			it->gpuMs = gpuMs;
+			it->gpuTriangles = gpuTriangles;
+			return;
+		}
+		if (it->frameNumber < frameNumber)
+		{
+			return;
+		}
+	}
+}
+
+void BenchmarkReport::add_display_timing(int frameNumber, double intervalMs, uint32_t missedVblanks, double jitterMs)
+{
+	for (auto it = _samples.rbegin(); it != _samples.rend(); it++)
+	{
+		if (it->frameNumber == frameNumber)
+		{
+			it->displayIntervalMs = intervalMs;
+			it->displayJitterMs = jitterMs;
+			it->missedVblanks = static_cast<int32_t>(missedVblanks);
+			return;
+		}
+		if (it->frameNumber < frameNumber)
+		{
+			return;
+		}
+	}
+}
+
+uint64_t BenchmarkReport::missed_vblanks() const
+{
+	uint64_t missed = 0;
+	for (const FrameSample& sample : _samples)
+	{
+		missed += sample.missedVblanks > 0 ? sample.missedVblanks : 0;
+	}
+	return missed;
+}
+
+BenchmarkReport::Summary BenchmarkReport::summarize(std::vector<double> values)
+{
+	values.erase(std::remove_if(values.begin(), values.end(), [](double v) { return v < 0.0; }), values.end());
+
+	Summary summary = {};
+	summary.count = values.size();
+	if (values.empty())
+	{
+		return summary;
+	}
+
+	std::sort(values.begin(), values.end());
+
+	double total = 0.0;
+	for (double v : values)
+	{
+		total += v;
+	}
+	summary.mean = total / values.size();
+
+	// nearest-rank percentiles
+	auto percentile = [&](double p) {
+		size_t rank = static_cast<size_t>(std::ceil(p * values.size()));
+		rank = std::min(std::max<size_t>(rank, 1), values.size());
+		return values[rank - 1];
+	};
+	summary.p50 = percentile(0.50);
+	summary.p95 = percentile(0.95);
+	summary.p99 = percentile(0.99);
+	return summary;
+}
+
+std::vector<double> BenchmarkReport::column(double FrameSample::*member) const
+{
+	std::vector<double> values;
+	values.reserve(_samples.size());
+	for (const FrameSample& sample : _samples)
+	{
+		values.push_back(sample.*member);
+	}
+	return values;
+}
+
+bool BenchmarkReport::write(const std::string& path, const std::vector<std::pair<std::string, std::string>>& header) const
+{
+	std::ofstream out(path, std::ios::trunc);
+	if (!out.is_open())
+	{
+		LOG_ERROR("Could not write benchmark report to " << path);
+		return false;
+	}
+
+	const Summary cpu = summarize(column(&FrameSample::cpuFrameMs));
+	const Summary gpu = summarize(column(&FrameSample::gpuMs));
+	const Summary present = summarize(column(&FrameSample::presentMs));
+	const Summary displayInterval = summarize(column(&FrameSample::displayIntervalMs));
+	const Summary displayJitter = summarize(column(&FrameSample::displayJitterMs));
+
+	out << std::fixed << std::setprecision(4);
+
+	const bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+	if (json)
+	{
+		auto writeSummary = [&](const char* name, const Summary& s, bool last) {
+			out << "  \"" << name << "\": { \"mean\": " << s.mean << ", \"p50\": " << s.p50
+				<< ", \"p95\": " << s.p95 << ", \"p99\": " << s.p99 << ", \"samples\": " << s.count << " }"
+				<< (last ? "\n" : ",\n");
+		};
+
+		out << "{\n";
+		for (const auto& entry : header)
+		{
+			out << "  \"" << entry.first << "\": \"" << entry.second << "\",\n";
+		}
+		writeSummary("cpu_frame_ms", cpu, false);
+		writeSummary("gpu_ms", gpu, false);
+		writeSummary("present_ms", present, false);
+		writeSummary("display_interval_ms", displayInterval, false);
+		writeSummary("display_jitter_ms", displayJitter, false);
+		out << "  \"missed_vblanks\": " << missed_vblanks() << ",\n";
+
+		out << "  \"frame_columns\": [\"frame\", \"cpu_frame_ms\", \"gpu_ms\", \"present_ms\", \"draw_calls\", \"pipeline_binds\", "
+			"\"vertex_buffer_binds\", \"push_constants\", \"triangles_submitted\", \"gpu_triangles\", \"upload_bytes\", "
+			"\"display_interval_ms\", \"display_jitter_ms\", \"missed_vblanks\"],\n";
+		out << "  \"frames\": [\n";
+		for (size_t i = 0; i < _samples.size(); i++)
+		{
+			const FrameSample& s = _samples[i];
+			const FrameStats& c = s.commands;
+			out << "    [" << s.frameNumber << ", " << s.cpuFrameMs << ", " << s.gpuMs << ", " << s.presentMs
+				<< ", " << c.drawCalls << ", " << c.pipelineBinds << ", " << c.vertexBufferBinds << ", " << c.pushConstantUploads
+				<< ", " << c.trianglesSubmitted << ", " << s.gpuTriangles << ", " << c.uploadBytes
+				<< ", " << s.displayIntervalMs << ", " << s.displayJitterMs << ", " << s.missedVblanks << "]"
+				<< (i + 1 < _samples.size() ? ",\n" : "\n");
+		}
+		out << "  ]\n}\n";
+	}
+	else
+	{
+		// summary goes in comment lines so the file still loads as a plain per-frame table
+		for (const auto& entry : header)
+		{
+			out << "# " << entry.first << ": " << entry.second << "\n";
+		}
+		out << "# metric,mean,p50,p95,p99,samples\n";
+		out << "# cpu_frame_ms," << cpu.mean << "," << cpu.p50 << "," << cpu.p95 << "," << cpu.p99 << "," << cpu.count << "\n";
+		out << "# gpu_ms," << gpu.mean << "," << gpu.p50 << "," << gpu.p95 << "," << gpu.p99 << "," << gpu.count << "\n";
+		out << "# present_ms," << present.mean << "," << present.p50 << "," << present.p95 << "," << present.p99 << "," << present.count << "\n";
+		out << "# display_interval_ms," << displayInterval.mean << "," << displayInterval.p50 << "," << displayInterval.p95 << ","
+			<< displayInterval.p99 << "," << displayInterval.count << "\n";
+		out << "# display_jitter_ms," << displayJitter.mean << "," << displayJitter.p50 << "," << displayJitter.p95 << ","
+			<< displayJitter.p99 << "," << displayJitter.count << "\n";
+		out << "# missed_vblanks: " << missed_vblanks() << "\n";
+
+		out << "frame,cpu_frame_ms,gpu_ms,present_ms,draw_calls,pipeline_binds,vertex_buffer_binds,push_constants,"
+			"triangles_submitted,gpu_triangles,upload_bytes,display_interval_ms,display_jitter_ms,missed_vblanks\n";
+		for (const FrameSample& s : _samples)
+		{
+			out << s.frameNumber << "," << s.cpuFrameMs << ",";
+			if (s.gpuMs >= 0.0)
+			{
+				out << s.gpuMs;
+			}
+			const FrameStats& c = s.commands;
+			out << "," << s.presentMs << "," << c.drawCalls << "," << c.pipelineBinds << "," << c.vertexBufferBinds
+				<< "," << c.pushConstantUploads << "," << c.trianglesSubmitted << ",";
+			if (s.gpuTriangles >= 0)
+			{
+				out << s.gpuTriangles;
+			}
+			out << "," << c.uploadBytes << ",";
+			if (s.displayIntervalMs >= 0.0)
+			{
+				out << s.displayIntervalMs;
+			}
+			out << ",";
+			if (s.displayJitterMs >= 0.0)
+			{
+				out << s.displayJitterMs;
+			}
+			out << ",";
+			if (s.missedVblanks >= 0)
+			{
+				out << s.missedVblanks;
+			}
+			out << "\n";
+		}
+	}
+
+	return out.good();
+}
+
+void BenchmarkReport::print_summary() const
+{
+	const Summary cpu = summarize(column(&FrameSample::cpuFrameMs));
+	const Summary gpu = summarize(column(&FrameSample::gpuMs));
+	const Summary present = summarize(column(&FrameSample::presentMs));
+
+	LOG_INFO(std::fixed << std::setprecision(3)
+		<< "Benchmark: " << _samples.size() << " frames\n"
+		<< "  cpu frame  p50 " << cpu.p50 << "ms  p95 " << cpu.p95 << "ms  p99 " << cpu.p99 << "ms\n"
+		<< "  gpu        p50 " << gpu.p50 << "ms  p95 " << gpu.p95 << "ms  p99 " << gpu.p99 << "ms\n"
+		<< "  present    p50 " << present.p50 << "ms  p95 " << present.p95 << "ms  p99 " << present.p99 << "ms");
+
+	// only with the display's present timing
+	const Summary displayInterval = summarize(column(&FrameSample::displayIntervalMs));
+	if (displayInterval.count > 0)
+	{
+		const Summary displayJitter = summarize(column(&FrameSample::displayJitterMs));
+		LOG_INFO(std::fixed << std::setprecision(3)
+			<< "  display    p50 " << displayInterval.p50 << "ms  p95 " << displayInterval.p95 << "ms  p99 " << displayInterval.p99
+			<< "ms between presents, jitter p95 " << displayJitter.p95 << "ms, " << missed_vblanks() << " missed vblanks");
+	}
+}
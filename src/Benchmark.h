@@ -0,0 +1,91 @@
+#pragma once
+
+#include <FrameStats.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class CameraPath {
+	Static, // fixed camera, matches interactive mode
+	Orbit,  // circles the origin once every 600 frames
+};
+
+// settings for a reproducible, fixed-length benchmark run
+struct BenchmarkSettings {
+	bool enabled{ false };
+	uint32_t frameCount{ 1000 };  // measured frames
+	uint32_t warmupFrames{ 60 };  // rendered first, not recorded
+	// "monkey", "crowd" (MAX_INSTANCES instanced monkeys) or "draw_data" (the monkey scene with every object a
+	// separate CPU-recorded draw, timing the per-draw data path)
+	std::string scene{ "monkey" };
+	CameraPath cameraPath{ CameraPath::Static };
+	std::string outputPath{ "benchmark.csv" }; // a .json extension writes JSON instead of CSV, empty for no report
+	bool disableVsync{ true };
+	// an InputRecording to measure instead of frameCount frames of the camera path; its first warmupFrames
+	// frames go unrecorded
+	std::string replayPath;
+};
+
+// parses --benchmark, --frames N, --warmup N, --scene NAME, --camera static|orbit, --output PATH, --vsync,
+// --replay PATH (which implies --benchmark)
+// unknown arguments are reported and ignored
+BenchmarkSettings parse_benchmark_args(int argc, char* argv[]);
+
+// per-frame timings collected during a run; GPU times arrive a few frames late and are matched by frame number
+class BenchmarkReport
+{
+public:
+	struct FrameSample {
+		int frameNumber;
+		double cpuFrameMs; // wall time of one draw() call
+		double presentMs;  // time blocked in acquire + present
+		double gpuMs;      // render pass time from the GPU profiler, negative if it never arrived
+		FrameStats commands;
+		int64_t gpuTriangles; // input assembly primitives from the pipeline statistics, negative if unavailable
+		// from the display's present timing, which arrives later still; negative (and missedVblanks too) without it
+		double displayIntervalMs; // between its present reaching the screen and the previous one's
+		double displayJitterMs; // between its interval and the previous one
+		int32_t missedVblanks;
+	};
+
+	struct Summary {
+		double mean;
+		double p50;
+		double p95;
+		double p99;
+		size_t count;
+	};
+
+	void reserve(size_t frames);
+	void add_frame(int frameNumber, double cpuFrameMs, double presentMs, const FrameStats& commands);
+	void add_gpu_time(int frameNumber, double gpuMs, int64_t gpuTriangles);
+	void add_display_timing(int frameNumber, double intervalMs, uint32_t missedVblanks, double jitterMs);
+
+	// ignores negative values (missing samples)
+	static Summary summarize(std::vector<double> values);
+
+	// header: free-form key/value pairs written at the top of the report (device, present mode...)
+	bool write(const std::string& path, const std::vector<std::pair<std::string, std::string>>& header) const;
+
+	void print_summary() const;
+	Summary cpu_summary() const { return summarize(column(&FrameSample::cpuFrameMs)); }
+	Summary gpu_summary() const { return summarize(column(&FrameSample::gpuMs)); }
+	// over the frames whose present timing arrived
+	uint64_t missed_vblanks() const;
+
+private:
+	std::vector<double> column(double FrameSample::*member) const;
+
+	std::vector<FrameSample> _samples;
+};
+
+// what the last run measured, for a caller comparing runs rather than reading reports
+struct BenchmarkResult {
+	bool completed{ false }; // every frame measured, on a device that wasn't lost
+	BenchmarkReport::Summary cpu{};
+	BenchmarkReport::Summary gpu{};
+	// the unmeasured frames drawn while the scene streamed in, and how long that took
+	BenchmarkReport::Summary streaming{};
+	double streamingMs{ 0.0 };
+};
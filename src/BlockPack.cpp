@@ -0,0 +1,118 @@
+#include "BlockPack.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace {
+	// payload offsets share their word with the 6-bit width
+	constexpr uint32_t WIDTH_BITS = 6;
+	constexpr uint32_t WIDTH_MASK = (1u << WIDTH_BITS) - 1;
+
+	uint32_t bits_needed(uint32_t range)
+	{
+		uint32_t bits = 0;
+		while (bits < 32 && (range >> bits) != 0)
+		{
+			bits++;
+		}
+		return bits;
+	}
+}
+
+namespace blockpack {
+	void encode(const uint32_t* values, size_t count, std::vector<uint32_t>& packed)
+	{
+		const uint32_t blockCount = block_count(count);
+		const size_t headerWords = header_words(blockCount);
+		packed.assign(headerWords, 0);
+		packed[0] = static_cast<uint32_t>(count);
+		packed[1] = blockCount;
+
+		for (uint32_t block = 0; block < blockCount; block++)
+		{
+			const size_t first = size_t(block) * BLOCK_SIZE;
+			const size_t last = std::min(first + BLOCK_SIZE, count);
+			const uint32_t base = *std::min_element(values + first, values + last);
+			const uint32_t top = *std::max_element(values + first, values + last);
+			const uint32_t width = bits_needed(top - base);
+
+			const size_t payloadOffset = packed.size() - headerWords;
+			assert(payloadOffset < (size_t(1) << (32 - WIDTH_BITS)));
+			packed[2 + block * 2] = base;
+			packed[3 + block * 2] = static_cast<uint32_t>(payloadOffset << WIDTH_BITS) | width;
+
+			// the tail of the last block packs as zero offsets, so every block has the same size
+			const size_t start = packed.size();
+			packed.resize(start + size_t(width) * 2, 0);
+			for (size_t i = first; i < last; i++)
+			{
+				const uint64_t offset = values[i] - base;
+				const size_t bit = (i - first) * width;
+				const size_t word = start + bit / 32;
+				const uint32_t shift = bit % 32;
+				packed[word] |= static_cast<uint32_t>(offset << shift);
+				if (shift + width > 32)
+				{
+					packed[word + 1] |= static_cast<uint32_t>(offset >> (32 - shift));
+				}
+			}
+		}
+	}
+
+	bool validate(const uint32_t* packed, size_t packedWords)
+	{
+		if (packedWords < 2 || packed[1] != block_count(packed[0]) || packedWords < header_words(packed[1]))
+		{
+			return false;
+		}
+
+		// blocks must follow each other in order, each inside the stream
+		const size_t payloadWords = packedWords - header_words(packed[1]);
+		size_t expected = 0;
+		for (uint32_t block = 0; block < packed[1]; block++)
+		{
+			const uint32_t layout = packed[3 + block * 2];
+			const uint32_t width = layout & WIDTH_MASK;
+			if (width > 32 || (layout >> WIDTH_BITS) != expected)
+			{
+				return false;
+			}
+			expected += size_t(width) * 2;
+		}
+		return expected == payloadWords;
+	}
+
+	void decode(const uint32_t* packed, uint32_t* values)
+	{
+		const uint32_t count = packed[0];
+		const uint32_t blockCount = packed[1];
+		const uint32_t* payload = packed + header_words(blockCount);
+		for (uint32_t block = 0; block < blockCount; block++)
+		{
+			const uint32_t base = packed[2 + block * 2];
+			const uint32_t layout = packed[3 + block * 2];
+			const uint32_t width = layout & WIDTH_MASK;
+			const uint32_t* words = payload + (layout >> WIDTH_BITS);
+			const uint32_t mask = width == 32 ? ~0u : (1u << width) - 1;
+
+			const uint32_t first = block * BLOCK_SIZE;
+			const uint32_t last = std::min(first + BLOCK_SIZE, count);
+			for (uint32_t i = first; i < last; i++)
+			{
+				if (width == 0)
+				{
+					values[i] = base;
+					continue;
+				}
+				const uint32_t bit = (i - first) * width;
+				const uint32_t shift = bit % 32;
+				uint64_t bits = words[bit / 32] >> shift;
+				if (shift + width > 32)
+				{
+					bits |= uint64_t(words[bit / 32 + 1]) << (32 - shift);
+				}
+				values[i] = base + (static_cast<uint32_t>(bits) & mask);
+			}
+		}
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Lossless packing of uint32 streams into a form a compute shader can expand with one workgroup per
+// block (see blockUnpack.comp). Values go in blocks of BLOCK_SIZE, each stored as its minimum plus the
+// offsets from it in the fewest bits that hold them all; every block takes 2 words per bit, so any
+// block can be found and expanded on its own.
+// Optimized index buffers suit it well: cache-ordered triangles reference vertices that were laid out
+// in order of first use, so a block spans a narrow range of vertices and needs far fewer than 32 bits an index.
+// Stream layout, in words: value count, block count, then per block its minimum and
+// (payload offset << 6 | bit width), then the payload words; offsets count from the first payload word.
+namespace blockpack {
+	constexpr uint32_t BLOCK_SIZE = 64;
+
+	// blocks and total words of the header before the payload
+	inline uint32_t block_count(size_t valueCount) { return static_cast<uint32_t>((valueCount + BLOCK_SIZE - 1) / BLOCK_SIZE); }
+	inline size_t header_words(uint32_t blockCount) { return 2 + size_t(blockCount) * 2; }
+
+	// replaces packed with the stream for values
+	void encode(const uint32_t* values, size_t count, std::vector<uint32_t>& packed);
+
+	// false unless packed holds a whole, consistent stream of packedWords words
+	bool validate(const uint32_t* packed, size_t packedWords);
+	// values counted in the first word
+	inline uint32_t value_count(const uint32_t* packed) { return packed[0]; }
+
+	// CPU fallback of the shader; packed must have passed validate() and values hold value_count() entries
+	void decode(const uint32_t* packed, uint32_t* values);
+}
@@ -0,0 +1,103 @@
+#include "BlockUnpacker.h"
+
+#include "BlockPack.h"
+#include "vk_initializers.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace {
+	// matches the push constants of blockUnpack.comp
+	struct UnpackPushConstants {
+		uint32_t outputOffset;
+		uint32_t firstBlock;
+	};
+
+	static_assert(blockpack::BLOCK_SIZE == 64, "blockUnpack.comp runs one invocation per value of a block");
+	// the smallest maxComputeWorkGroupCount[0] a device may have
+	constexpr uint32_t MAX_DISPATCH_BLOCKS = 65535;
+}
+
+void BlockUnpacker::init(VkDevice device, DescriptorAllocator& descriptors, VkShaderModule unpackShader, VkPipelineCache cache)
+{
+	_device = device;
+	_descriptors = &descriptors;
+
+	VkDescriptorSetLayoutBinding bindings[] = {
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0), // packed stream
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1), // values
+	};
+
+	VkDescriptorSetLayoutCreateInfo setInfo = {};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setInfo.pNext = nullptr;
+	setInfo.bindingCount = 2;
+	setInfo.pBindings = bindings;
+	VK_CHECK(vkCreateDescriptorSetLayout(_device, &setInfo, nullptr, &_setLayout));
+
+	VkPushConstantRange pushConstant;
+	pushConstant.offset = 0;
+	pushConstant.size = sizeof(UnpackPushConstants);
+	pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkPipelineLayoutCreateInfo layoutInfo = vkinit::pipeline_layout_create_info();
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &_setLayout;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushConstant;
+	VK_CHECK(vkCreatePipelineLayout(_device, &layoutInfo, nullptr, &_pipelineLayout));
+
+	if (unpackShader != VK_NULL_HANDLE)
+	{
+		VkComputePipelineCreateInfo pipelineInfo = {};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.pNext = nullptr;
+		pipelineInfo.layout = _pipelineLayout;
+		pipelineInfo.stage = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, unpackShader);
+		VK_CHECK(vkCreateComputePipelines(_device, cache, 1, &pipelineInfo, nullptr, &_pipeline));
+	}
+}
+
+void BlockUnpacker::cleanup()
+{
+	// the sets go with the descriptor allocator's pools
+	if (_pipeline != VK_NULL_HANDLE)
+	{
+		vkDestroyPipeline(_device, _pipeline, nullptr);
+	}
+	vkDestroyPipelineLayout(_device, _pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(_device, _setLayout, nullptr);
+}
+
+void BlockUnpacker::unpack(VkCommandBuffer cmd, VkBuffer packed, uint32_t blockCount, VkBuffer output, uint32_t outputOffset)
+{
+	assert(_pipeline != VK_NULL_HANDLE);
+	if (blockCount == 0)
+	{
+		return;
+	}
+
+	VkDescriptorSet set;
+	if (!_descriptors->allocate(&set, _setLayout))
+	{
+		return;
+	}
+
+	VkDescriptorBufferInfo packedInfo = { packed, 0, VK_WHOLE_SIZE };
+	VkDescriptorBufferInfo outputInfo = { output, 0, VK_WHOLE_SIZE };
+	VkWriteDescriptorSet writes[] = {
+		vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, set, &packedInfo, 0),
+		vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, set, &outputInfo, 1),
+	};
+	vkUpdateDescriptorSets(_device, 2, writes, 0, nullptr);
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout, 0, 1, &set, 0, nullptr);
+	// one workgroup of BLOCK_SIZE invocations per block, split where a stream has more blocks than one dispatch may
+	for (uint32_t first = 0; first < blockCount; first += MAX_DISPATCH_BLOCKS)
+	{
+		const UnpackPushConstants constants = { outputOffset, first };
+		vkCmdPushConstants(cmd, _pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(UnpackPushConstants), &constants);
+		vkCmdDispatch(cmd, std::min(blockCount - first, MAX_DISPATCH_BLOCKS), 1, 1);
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vk_types.h>
+#include <DescriptorAllocator.h>
+
+// Expands blockpack streams (see BlockPack.h) on the GPU with blockUnpack.comp, so packed data can be
+// uploaded as it's stored and the loader threads never decode it.
+// Every stream gets its own descriptor set, which lives as long as the descriptor allocator; streams
+// are whole assets, so there are few of them.
+class BlockUnpacker
+{
+public:
+	// without a shader there is no pipeline and unpack() must not be called
+	void init(VkDevice device, DescriptorAllocator& descriptors, VkShaderModule unpackShader, VkPipelineCache cache);
+	void cleanup();
+
+	bool ready() const { return _pipeline != VK_NULL_HANDLE; }
+
+	// records the expansion of the stream filling packed (as encode() wrote it, blockCount blocks) into
+	// output from word outputOffset on. packed must be readable by compute shaders; making the writes
+	// visible to the readers of output is up to the caller
+	void unpack(VkCommandBuffer cmd, VkBuffer packed, uint32_t blockCount, VkBuffer output, uint32_t outputOffset);
+
+private:
+	VkDevice _device{ VK_NULL_HANDLE };
+	DescriptorAllocator* _descriptors{ nullptr };
+
+	VkDescriptorSetLayout _setLayout{ VK_NULL_HANDLE };
+	VkPipelineLayout _pipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline _pipeline{ VK_NULL_HANDLE };
+};
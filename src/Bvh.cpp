@@ -0,0 +1,359 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+namespace {
+	// leaves are stored this much larger on every side, so objects drifting a little don't touch the tree
+	constexpr float FAT_MARGIN = 0.1f;
+
+	Aabb merge(const Aabb& a, const Aabb& b)
+	{
+		return { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+	}
+
+	// the insertion cost is the surface area heuristic; the constant factor doesn't matter
+	float area(const Aabb& box)
+	{
+		const glm::vec3 d = box.max - box.min;
+		return d.x * d.y + d.y * d.z + d.z * d.x;
+	}
+
+	bool contains(const Aabb& outer, const Aabb& inner)
+	{
+		return glm::all(glm::lessThanEqual(outer.min, inner.min)) && glm::all(glm::greaterThanEqual(outer.max, inner.max));
+	}
+
+	Aabb fatten(const Aabb& box, float margin)
+	{
+		return { box.min - glm::vec3(margin), box.max + glm::vec3(margin) };
+	}
+}
+
+Aabb Aabb::transformed(const Aabb& bounds, const glm::mat4& m)
+{
+	const glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+	const glm::vec3 extent = (bounds.max - bounds.min) * 0.5f;
+
+	const glm::vec3 worldCenter = glm::vec3(m * glm::vec4(center, 1.0f));
+	const glm::vec3 worldExtent = glm::abs(glm::vec3(m[0])) * extent.x + glm::abs(glm::vec3(m[1])) * extent.y + glm::abs(glm::vec3(m[2])) * extent.z;
+	return { worldCenter - worldExtent, worldCenter + worldExtent };
+}
+
+float ray_triangle(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3* corners)
+{
+	// Moller-Trumbore
+	const glm::vec3 e1 = corners[1] - corners[0];
+	const glm::vec3 e2 = corners[2] - corners[0];
+	const glm::vec3 p = glm::cross(direction, e2);
+	const float determinant = glm::dot(e1, p);
+	if (std::fabs(determinant) < 1e-12f)
+	{
+		return -1.0f;
+	}
+	const float inverse = 1.0f / determinant;
+	const glm::vec3 s = origin - corners[0];
+	const float u = glm::dot(s, p) * inverse;
+	if (u < 0.0f || u > 1.0f)
+	{
+		return -1.0f;
+	}
+	const glm::vec3 q = glm::cross(s, e1);
+	const float v = glm::dot(direction, q) * inverse;
+	if (v < 0.0f || u + v > 1.0f)
+	{
+		return -1.0f;
+	}
+	return glm::dot(e2, q) * inverse;
+}
+
+int32_t Bvh::insert(const Aabb& bounds, uint32_t userData)
+{
+	const int32_t proxy = allocate_node();
+	Node& node = _nodes[proxy];
+	node.bounds = fatten(bounds, FAT_MARGIN);
+	node.userData = userData;
+	node.height = 0;
+
+	insert_leaf(proxy);
+	_proxyCount++;
+	return proxy;
+}
+
+void Bvh::remove(int32_t proxy)
+{
+	assert(_nodes[proxy].is_leaf());
+	remove_leaf(proxy);
+	free_node(proxy);
+	_proxyCount--;
+}
+
+bool Bvh::move(int32_t proxy, const Aabb& bounds)
+{
+	// still inside the fat box, and the box hasn't become much bigger than needed (a shrunk mesh)
+	const Aabb& fat = _nodes[proxy].bounds;
+	if (contains(fat, bounds) && contains(fatten(bounds, 4.0f * FAT_MARGIN), fat))
+	{
+		return false;
+	}
+
+	remove_leaf(proxy);
+	_nodes[proxy].bounds = fatten(bounds, FAT_MARGIN);
+	insert_leaf(proxy);
+	return true;
+}
+
+int32_t Bvh::allocate_node()
+{
+	int32_t index;
+	if (_freeList != NULL_NODE)
+	{
+		index = _freeList;
+		_freeList = _nodes[index].parent;
+	}
+	else
+	{
+		index = static_cast<int32_t>(_nodes.size());
+		_nodes.emplace_back();
+	}
+
+	Node& node = _nodes[index];
+	node.parent = NULL_NODE;
+	node.child1 = NULL_NODE;
+	node.child2 = NULL_NODE;
+	node.height = 0;
+	node.userData = 0;
+	return index;
+}
+
+void Bvh::free_node(int32_t node)
+{
+	_nodes[node].parent = _freeList;
+	_nodes[node].height = -1;
+	_freeList = node;
+}
+
+void Bvh::insert_leaf(int32_t leaf)
+{
+	if (_root == NULL_NODE)
+	{
+		_root = leaf;
+		_nodes[leaf].parent = NULL_NODE;
+		return;
+	}
+
+	// walk down towards the cheapest sibling: pairing with a node costs the area of their union,
+	// and every ancestor on the way grows by as much as the leaf enlarges it
+	const Aabb leafBounds = _nodes[leaf].bounds;
+	int32_t index = _root;
+	while (!_nodes[index].is_leaf())
+	{
+		const Node& node = _nodes[index];
+		const float nodeArea = area(node.bounds);
+		const float combinedArea = area(merge(node.bounds, leafBounds));
+
+		const float siblingCost = 2.0f * combinedArea;
+		const float inheritanceCost = 2.0f * (combinedArea - nodeArea);
+
+		auto descend_cost = [&](int32_t child) {
+			const Node& c = _nodes[child];
+			const float merged = area(merge(c.bounds, leafBounds));
+			return (c.is_leaf() ? merged : merged - area(c.bounds)) + inheritanceCost;
+		};
+		const float cost1 = descend_cost(node.child1);
+		const float cost2 = descend_cost(node.child2);
+
+		if (siblingCost < cost1 && siblingCost < cost2)
+		{
+			break;
+		}
+		index = cost1 < cost2 ? node.child1 : node.child2;
+	}
+
+	// new parent for the sibling and the leaf; allocating may move _nodes, so no references across it
+	const int32_t sibling = index;
+	const int32_t oldParent = _nodes[sibling].parent;
+	const int32_t newParent = allocate_node();
+	_nodes[newParent].parent = oldParent;
+	_nodes[newParent].bounds = merge(leafBounds, _nodes[sibling].bounds);
+	_nodes[newParent].height = _nodes[sibling].height + 1;
+	_nodes[newParent].child1 = sibling;
+	_nodes[newParent].child2 = leaf;
+	_nodes[sibling].parent = newParent;
+	_nodes[leaf].parent = newParent;
+
+	if (oldParent == NULL_NODE)
+	{
+		_root = newParent;
+	}
+	else if (_nodes[oldParent].child1 == sibling)
+	{
+		_nodes[oldParent].child1 = newParent;
+	}
+	else
+	{
+		_nodes[oldParent].child2 = newParent;
+	}
+
+	// refit and rebalance the ancestors
+	index = _nodes[leaf].parent;
+	while (index != NULL_NODE)
+	{
+		index = balance(index);
+		Node& node = _nodes[index];
+		node.height = 1 + std::max(_nodes[node.child1].height, _nodes[node.child2].height);
+		node.bounds = merge(_nodes[node.child1].bounds, _nodes[node.child2].bounds);
+		index = node.parent;
+	}
+}
+
+void Bvh::remove_leaf(int32_t leaf)
+{
+	if (leaf == _root)
+	{
+		_root = NULL_NODE;
+		return;
+	}
+
+	// the sibling takes the parent's place
+	const int32_t parent = _nodes[leaf].parent;
+	const int32_t grandParent = _nodes[parent].parent;
+	const int32_t sibling = _nodes[parent].child1 == leaf ? _nodes[parent].child2 : _nodes[parent].child1;
+	free_node(parent);
+
+	if (grandParent == NULL_NODE)
+	{
+		_root = sibling;
+		_nodes[sibling].parent = NULL_NODE;
+		return;
+	}
+
+	if (_nodes[grandParent].child1 == parent)
+	{
+		_nodes[grandParent].child1 = sibling;
+	}
+	else
+	{
+		_nodes[grandParent].child2 = sibling;
+	}
+	_nodes[sibling].parent = grandParent;
+
+	int32_t index = grandParent;
+	while (index != NULL_NODE)
+	{
+		index = balance(index);
+		Node& node = _nodes[index];
+		node.height = 1 + std::max(_nodes[node.child1].height, _nodes[node.child2].height);
+		node.bounds = merge(_nodes[node.child1].bounds, _nodes[node.child2].bounds);
+		index = node.parent;
+	}
+}
+
+int32_t Bvh::balance(int32_t iA)
+{
+	Node& A = _nodes[iA];
+	if (A.is_leaf() || A.height < 2)
+	{
+		return iA;
+	}
+
+	const int32_t iB = A.child1;
+	const int32_t iC = A.child2;
+	Node& B = _nodes[iB];
+	Node& C = _nodes[iC];
+	const int32_t heightDifference = C.height - B.height;
+
+	// the taller child X takes A's place; A keeps its other child plus the shorter of X's children
+	auto rotate_up = [&](int32_t iX, Node& X, bool xIsChild2) {
+		const int32_t iF = X.child1;
+		const int32_t iG = X.child2;
+		Node& F = _nodes[iF];
+		Node& G = _nodes[iG];
+
+		X.child1 = iA;
+		X.parent = A.parent;
+		A.parent = iX;
+
+		if (X.parent == NULL_NODE)
+		{
+			_root = iX;
+		}
+		else if (_nodes[X.parent].child1 == iA)
+		{
+			_nodes[X.parent].child1 = iX;
+		}
+		else
+		{
+			_nodes[X.parent].child2 = iX;
+		}
+
+		const Node& kept = xIsChild2 ? B : C;
+		const bool keepF = F.height > G.height;
+		const int32_t iMoved = keepF ? iG : iF;
+		const int32_t iStays = keepF ? iF : iG;
+		Node& moved = _nodes[iMoved];
+		Node& stays = _nodes[iStays];
+
+		X.child2 = iStays;
+		if (xIsChild2)
+		{
+			A.child2 = iMoved;
+		}
+		else
+		{
+			A.child1 = iMoved;
+		}
+		moved.parent = iA;
+
+		A.bounds = merge(kept.bounds, moved.bounds);
+		X.bounds = merge(A.bounds, stays.bounds);
+		A.height = 1 + std::max(kept.height, moved.height);
+		X.height = 1 + std::max(A.height, stays.height);
+		return iX;
+	};
+
+	if (heightDifference > 1)
+	{
+		return rotate_up(iC, C, true);
+	}
+	if (heightDifference < -1)
+	{
+		return rotate_up(iB, B, false);
+	}
+	return iA;
+}
+
+int Bvh::classify(const Aabb& box, const glm::vec4 planes[6])
+{
+	int result = 1;
+	for (int i = 0; i < 6; i++)
+	{
+		const glm::vec3 normal = glm::vec3(planes[i]);
+		// corners furthest along and against the plane normal
+		const glm::vec3 positive = glm::mix(box.min, box.max, glm::greaterThanEqual(normal, glm::vec3(0.0f)));
+		const glm::vec3 negative = glm::mix(box.max, box.min, glm::greaterThanEqual(normal, glm::vec3(0.0f)));
+		if (glm::dot(normal, positive) + planes[i].w < 0.0f)
+		{
+			return -1;
+		}
+		if (glm::dot(normal, negative) + planes[i].w < 0.0f)
+		{
+			result = 0;
+		}
+	}
+	return result;
+}
+
+float Bvh::ray_distance(const Aabb& box, const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance)
+{
+	const glm::vec3 t1 = (box.min - origin) * inverseDirection;
+	const glm::vec3 t2 = (box.max - origin) * inverseDirection;
+	const glm::vec3 tNear = glm::min(t1, t2);
+	const glm::vec3 tFar = glm::max(t1, t2);
+
+	const float entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+	const float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+	return entry <= exit ? entry : -1.0f;
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+struct Aabb {
+	glm::vec3 min;
+	glm::vec3 max;
+
+	// box around bounds after transforming by m (Arvo's method, exact for the box's corners)
+	static Aabb transformed(const Aabb& bounds, const glm::mat4& m);
+};
+
+// distance along direction to the triangle of corners[0..2], either side facing, or a negative value for a
+// miss; what raycast's hit refines a triangle's box with when the proxies are triangles
+float ray_triangle(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3* corners);
+
+// Dynamic bounding volume hierarchy over axis-aligned boxes, kept balanced with tree rotations.
+// Leaves store a fattened box, so small movements only refit the leaf's own record: move() reinserts
+// just when the new bounds leave the fat box. Queries walk the tree from the root, skipping whole
+// subtrees outside the frustum or ray, which keeps them close to logarithmic in the proxy count.
+class Bvh
+{
+public:
+	static constexpr int32_t NULL_NODE = -1;
+
+	// returns the proxy id; userData is handed back by the queries
+	int32_t insert(const Aabb& bounds, uint32_t userData);
+	void remove(int32_t proxy);
+	// refits proxy to bounds; returns true if it had to be reinserted
+	bool move(int32_t proxy, const Aabb& bounds);
+
+	void set_user_data(int32_t proxy, uint32_t userData) { _nodes[proxy].userData = userData; }
+	uint32_t user_data(int32_t proxy) const { return _nodes[proxy].userData; }
+	// fattened box the proxy is stored with
+	const Aabb& fat_bounds(int32_t proxy) const { return _nodes[proxy].bounds; }
+
+	// calls visit(userData) for every proxy whose box is at least partly inside the six inward-facing planes
+	template<typename Visit>
+	void query_frustum(const glm::vec4 planes[6], Visit&& visit) const;
+
+	// nearest proxy along the ray (direction needn't be normalized; distances are in its units) within
+	// maxDistance. hit(userData, boxDistance) refines the box test and returns the exact distance, or a
+	// negative value for a miss; return boxDistance to accept the box. Returns false if nothing was hit
+	template<typename Hit>
+	bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Hit&& hit, uint32_t& userData, float& distance) const;
+
+	// calls visit(bounds, depth, isLeaf) for every node, the root at depth 0; leaves have their fattened box
+	template<typename Visit>
+	void visit_nodes(Visit&& visit) const;
+
+	size_t proxy_count() const { return _proxyCount; }
+	// 0 for a single leaf
+	int32_t height() const { return _root == NULL_NODE ? 0 : _nodes[_root].height; }
+
+private:
+	struct Node {
+		Aabb bounds;
+		int32_t parent; // next free node while on the free list
+		int32_t child1;
+		int32_t child2;
+		int32_t height; // 0 for leaves, -1 while free
+		uint32_t userData;
+
+		bool is_leaf() const { return child1 == NULL_NODE; }
+	};
+
+	// deep enough for any tree balance() allows
+	static constexpr int STACK_SIZE = 256;
+
+	int32_t allocate_node();
+	void free_node(int32_t node);
+	void insert_leaf(int32_t leaf);
+	void remove_leaf(int32_t leaf);
+	// rotates the subtree at a if its children's heights differ by more than one; returns the new subtree root
+	int32_t balance(int32_t a);
+
+	// -1: outside, 0: intersecting, 1: inside every plane
+	static int classify(const Aabb& box, const glm::vec4 planes[6]);
+	// entry distance of the ray into box, or a negative value when it misses within maxDistance
+	static float ray_distance(const Aabb& box, const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance);
+
+	std::vector<Node> _nodes;
+	int32_t _root{ NULL_NODE };
+	int32_t _freeList{ NULL_NODE };
+	size_t _proxyCount{ 0 };
+};
+
+template<typename Visit>
+void Bvh::query_frustum(const glm::vec4 planes[6], Visit&& visit) const
+{
+	if (_root == NULL_NODE)
+	{
+		return;
+	}
+
+	// second half of each entry: the subtree is known to be inside, so its leaves need no more plane tests
+	struct Entry {
+		int32_t node;
+		bool inside;
+	};
+	Entry stack[STACK_SIZE];
+	int count = 0;
+	stack[count++] = { _root, false };
+
+	while (count > 0)
+	{
+		const Entry entry = stack[--count];
+		const Node& node = _nodes[entry.node];
+
+		bool inside = entry.inside;
+		if (!inside)
+		{
+			const int side = classify(node.bounds, planes);
+			if (side < 0)
+			{
+				continue;
+			}
+			inside = side > 0;
+		}
+
+		if (node.is_leaf())
+		{
+			visit(node.userData);
+			continue;
+		}
+		assert(count + 2 <= STACK_SIZE);
+		stack[count++] = { node.child1, inside };
+		stack[count++] = { node.child2, inside };
+	}
+}
+
+template<typename Visit>
+void Bvh::visit_nodes(Visit&& visit) const
+{
+	if (_root == NULL_NODE)
+	{
+		return;
+	}
+
+	struct Entry {
+		int32_t node;
+		int32_t depth;
+	};
+	Entry stack[STACK_SIZE];
+	int count = 0;
+	stack[count++] = { _root, 0 };
+
+	while (count > 0)
+	{
+		const Entry entry = stack[--count];
+		const Node& node = _nodes[entry.node];
+		visit(node.bounds, entry.depth, node.is_leaf());
+		if (!node.is_leaf())
+		{
+			assert(count + 2 <= STACK_SIZE);
+			stack[count++] = { node.child1, entry.depth + 1 };
+			stack[count++] = { node.child2, entry.depth + 1 };
+		}
+	}
+}
+
+template<typename Hit>
+bool Bvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Hit&& hit, uint32_t& userData, float& distance) const
+{
+	if (_root == NULL_NODE)
+	{
+		return false;
+	}
+
+	// infinities for axis-parallel rays make the slab test work out without special cases
+	const glm::vec3 inverseDirection = 1.0f / direction;
+	float nearest = maxDistance;
+	bool found = false;
+
+	int32_t stack[STACK_SIZE];
+	int count = 0;
+	stack[count++] = _root;
+
+	while (count > 0)
+	{
+		const Node& node = _nodes[stack[--count]];
+		// anything entered past the nearest hit so far can't beat it
+		const float boxDistance = ray_distance(node.bounds, origin, inverseDirection, nearest);
+		if (boxDistance < 0.0f)
+		{
+			continue;
+		}
+
+		if (node.is_leaf())
+		{
+			const float exact = hit(node.userData, boxDistance);
+			if (exact >= 0.0f && exact <= nearest)
+			{
+				nearest = exact;
+				userData = node.userData;
+				found = true;
+			}
+			continue;
+		}
+		assert(count + 2 <= STACK_SIZE);
+		stack[count++] = node.child1;
+		stack[count++] = node.child2;
+	}
+
+	distance = nearest;
+	return found;
+}
@@ -0,0 +1,128 @@
+#include "Camera.h"
+
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+#include <limits>
+
+void Camera::set_reverse_z(bool reverseZ, bool infiniteFar)
+{
+	_reverseZ = reverseZ;
+	_infiniteFar = reverseZ && infiniteFar;
+}
+
+void Camera::set_tile(uint32_t column, uint32_t row, uint32_t columns, uint32_t rows)
+{
+	_tileScale = glm::vec2(static_cast<float>(columns), static_cast<float>(rows));
+	// the tile's center, at -1 + (2 * column + 1) / columns, goes to 0
+	_tileOffset = glm::vec2(static_cast<float>(columns - 2 * column - 1), static_cast<float>(rows - 2 * row - 1));
+}
+
+void Camera::update(const glm::mat4& view, float fovY, float aspect, float nearPlane, float farPlane)
+{
+	// the tiles are as wide for their height as the target, so the view is columns / rows times that
+	aspect *= _tileScale.x / _tileScale.y;
+	_fovY = fovY;
+	_aspect = aspect;
+	_nearPlane = nearPlane;
+	_farPlane = _infiniteFar ? std::numeric_limits<float>::infinity() : farPlane;
+
+	_view = view;
+	// reverse Z is the 0..1 depth range projection with the planes swapped. Without it this stays the
+	// GL-style -1..1 matrix the rest of the engine (and cull.comp's sphere depth) was written against
+	if (_infiniteFar)
+	{
+		// the limit of the reverse matrix as the far plane goes to infinity: depth = near / -z
+		const float focal = 1.0f / std::tan(fovY * 0.5f);
+		_projection = glm::mat4(0.0f);
+		_projection[0][0] = focal / aspect;
+		_projection[1][1] = focal;
+		_projection[2][3] = -1.0f;
+		_projection[3][2] = nearPlane;
+	}
+	else
+	{
+		_projection = _reverseZ
+			? glm::perspectiveRH_ZO(fovY, aspect, farPlane, nearPlane)
+			: glm::perspective(fovY, aspect, nearPlane, farPlane);
+	}
+	_projection[1][1] *= -1;
+	// after the y flip, so row 0 is at the top of the image like the target's
+	if (tiled())
+	{
+		glm::mat4 tile(1.0f);
+		tile[0][0] = _tileScale.x;
+		tile[1][1] = _tileScale.y;
+		tile[3][0] = _tileOffset.x;
+		tile[3][1] = _tileOffset.y;
+		_projection = tile * _projection;
+	}
+	const glm::mat4 unjitteredProjection = _projection;
+	_unjitteredViewProjection = _projection * _view;
+	// a translation after the projection moves every point the same distance in NDC, whatever its depth
+	if (_jitter != glm::vec2(0.0f))
+	{
+		_projection = glm::translate(glm::mat4(1.0f), glm::vec3(_jitter, 0.0f)) * _projection;
+	}
+	_viewProjection = _projection * _view;
+
+	_position = glm::vec3(glm::inverse(_view)[3]);
+	extract_frustum_planes(_unjitteredViewProjection, _frustumPlanes, _reverseZ);
+
+	_eyeViewProjection[0] = _viewProjection;
+	_eyeViewProjection[1] = _viewProjection;
+	if (_eyeSeparation > 0.0f)
+	{
+		for (uint32_t eye = 0; eye < 2; eye++)
+		{
+			// the left eye sits half the separation to the left, which moves what it sees to the right
+			const float offset = (eye == 0 ? 0.5f : -0.5f) * _eyeSeparation;
+			const glm::mat4 eyeView = glm::translate(glm::mat4(1.0f), glm::vec3(offset, 0.0f, 0.0f)) * _view;
+			_eyeViewProjection[eye] = _projection * eyeView;
+
+			// the eyes only move along x, which lies in every other plane, so the union just takes the left
+			// eye's left plane and the right eye's right one
+			glm::vec4 planes[6];
+			extract_frustum_planes(unjitteredProjection * eyeView, planes, _reverseZ);
+			_frustumPlanes[eye] = planes[eye];
+		}
+	}
+}
+
+void Camera::extract_frustum_planes(const glm::mat4& m, glm::vec4 planes[6], bool reverseZ)
+{
+	glm::vec4 row0 = { m[0][0], m[1][0], m[2][0], m[3][0] };
+	glm::vec4 row1 = { m[0][1], m[1][1], m[2][1], m[3][1] };
+	glm::vec4 row2 = { m[0][2], m[1][2], m[2][2], m[3][2] };
+	glm::vec4 row3 = { m[0][3], m[1][3], m[2][3], m[3][3] };
+
+	planes[0] = row3 + row0; // left
+	planes[1] = row3 - row0; // right
+	planes[2] = row3 + row1; // bottom (top after the projection's y flip)
+	planes[3] = row3 - row1;
+	if (reverseZ)
+	{
+		planes[4] = row3 - row2; // near, at depth 1
+		planes[5] = row2; // far, at depth 0
+	}
+	else
+	{
+		planes[4] = row3 + row2; // near; the GL-style -1..1 plane, conservative for Vulkan's 0..1 depth
+		planes[5] = row3 - row2; // far
+	}
+
+	for (int i = 0; i < 6; i++)
+	{
+		const float length = glm::length(glm::vec3(planes[i]));
+		if (length > 0.0f)
+		{
+			planes[i] /= length;
+		}
+		else
+		{
+			planes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		}
+	}
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+// The view a frame is rendered from, worked out once per frame: view and projection, their product, the
+// eye position and the frustum planes. The CPU and GPU culling, LOD selection, the camera data the shaders
+// read and picking all take them from here instead of rebuilding the matrices.
+// With reverse Z the projection maps the near plane to depth 1 and the far plane to 0, which pairs float
+// depth's precision with the perspective divide's and keeps distant surfaces from fighting. The depth
+// buffer is then cleared to far_depth() and tested with GREATER_OR_EQUAL; the depth pyramid keeps the
+// smallest depth as the farthest.
+// Reverse Z can also push the far plane out to infinity: depth becomes near / distance, which float still
+// resolves far beyond any scene, so large views need no far clip. The frustum's far plane then culls nothing.
+// A stereo camera renders two eyes, side by side along the view's x axis and looking the same way, through one
+// projection. view(), position() and the LOD inputs stay those of the point between them; the frustum planes
+// become the union of both eyes' frusta, so one cull serves both.
+class Camera
+{
+public:
+	// before the pipelines are built, which bake the depth test; infiniteFar only applies with reverseZ
+	void set_reverse_z(bool reverseZ, bool infiniteFar = false);
+	bool reverse_z() const { return _reverseZ; }
+	bool infinite_far() const { return _infiniteFar; }
+	// the distance between the eyes, 0 for a single view; takes effect at the next update()
+	void set_stereo(float eyeSeparation) { _eyeSeparation = eyeSeparation; }
+	bool stereo() const { return _eyeSeparation > 0.0f; }
+
+	// fovY in radians, aspect as width over height; recomputes everything else. farPlane is ignored with
+	// an infinite far plane
+	void update(const glm::mat4& view, float fovY, float aspect, float nearPlane, float farPlane);
+
+	const glm::mat4& view() const { return _view; }
+	// with Vulkan's y flip
+	const glm::mat4& projection() const { return _projection; }
+	const glm::mat4& view_projection() const { return _viewProjection; }
+	// temporal upscaling's sub-pixel offset of the projection, in NDC, taking effect at the next update().
+	// projection() and view_projection() include it; the frustum planes and this don't, so culling and the
+	// reprojection between frames stay where the camera really is
+	void set_jitter(const glm::vec2& offset) { _jitter = offset; }
+	const glm::vec2& jitter() const { return _jitter; }
+	const glm::mat4& unjittered_view_projection() const { return _unjitteredViewProjection; }
+	// renders only tile column, row of a grid of columns x rows equal parts of the view, column 0 on the left
+	// and row 0 at the top, stretched over the target: a sub-frustum, whose planes cull to it. The aspect
+	// update() takes is then the tile's, and aspect() the whole view's. Takes effect at the next update();
+	// 1 x 1 is the whole view
+	void set_tile(uint32_t column, uint32_t row, uint32_t columns, uint32_t rows);
+	bool tiled() const { return _tileScale != glm::vec2(1.0f); }
+	// view 0 (the left eye) or 1 of a stereo camera, jitter included; both are view_projection() without stereo
+	const glm::mat4& eye_view_projection(uint32_t eye) const { return _eyeViewProjection[eye]; }
+	// left, right, bottom, top, near, far; they point inwards and are normalized, so distances are in world units.
+	// An infinite far plane is (0, 0, 0, 1), which every point is in front of
+	const glm::vec4* frustum_planes() const { return _frustumPlanes; }
+	const glm::vec3& position() const { return _position; }
+
+	float fov_y() const { return _fovY; }
+	float aspect() const { return _aspect; }
+	float near_plane() const { return _nearPlane; }
+	// infinity with an infinite far plane
+	float far_plane() const { return _farPlane; }
+	// what the depth buffer is cleared to
+	float far_depth() const { return _reverseZ ? 0.0f : 1.0f; }
+
+	// Gribb-Hartmann plane extraction from any view-projection, in the order and form of frustum_planes();
+	// reverseZ for matrices built the way reverse-Z cameras build theirs; a far plane at infinity comes out as
+	// frustum_planes() describes
+	static void extract_frustum_planes(const glm::mat4& m, glm::vec4 planes[6], bool reverseZ = false);
+
+private:
+	bool _reverseZ{ false };
+	bool _infiniteFar{ false };
+	float _eyeSeparation{ 0.0f };
+
+	glm::mat4 _view{ 1.0f };
+	glm::mat4 _projection{ 1.0f };
+	glm::mat4 _viewProjection{ 1.0f };
+	glm::mat4 _unjitteredViewProjection{ 1.0f };
+	glm::mat4 _eyeViewProjection[2]{ glm::mat4(1.0f), glm::mat4(1.0f) };
+	glm::vec2 _jitter{ 0.0f };
+	// the tile's part of NDC is scaled by this and moved by the offset to cover all of it
+	glm::vec2 _tileScale{ 1.0f };
+	glm::vec2 _tileOffset{ 0.0f };
+	glm::vec4 _frustumPlanes[6]{};
+	glm::vec3 _position{ 0.0f };
+
+	float _fovY{ 0.0f };
+	float _aspect{ 1.0f };
+	float _nearPlane{ 0.1f };
+	float _farPlane{ 200.0f };
+};
@@ -0,0 +1,233 @@
+#include "ClusteredLights.h"
+
+#include "vk_initializers.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+	// matches the push constants of lightCluster.comp
+	struct ClusterPushConstants {
+		glm::mat4 view;
+		glm::vec4 projection; // x proj[0][0], y proj[1][1], z near, w far of the clusters
+		uint32_t gridSize[3];
+		uint32_t lightCount;
+		uint32_t lightBase; // first light of the frame's region
+		// where the view axis lands in NDC: off center for the tiles of a tiled render
+		float axisX;
+		float axisY;
+	};
+
+	// lightCluster.comp's local size; each group fills one cluster
+	constexpr uint32_t CLUSTER_GROUP_SIZE = 64;
+
+	float cluster_far(const Camera& camera)
+	{
+		return std::min(camera.far_plane(), ClusteredLights::MAX_DISTANCE);
+	}
+}
+
+void ClusteredLights::init(VkDevice device, VmaAllocator allocator, DescriptorAllocator& descriptors, VkShaderModule clusterShader, VkPipelineCache cache,
+	uint32_t frameCount, bool directWrites)
+{
+	_device = device;
+	_allocator = allocator;
+
+	// mapped for as long as the buffer lives; the frame slot's fence keeps the GPU off the region being written
+	_directWrites = false;
+	if (directWrites)
+	{
+		VkBufferCreateInfo bufferInfo = {};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.pNext = nullptr;
+		bufferInfo.size = VkDeviceSize(frameCount) * MAX_LIGHTS * sizeof(GpuLight);
+		bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		VmaAllocationCreateInfo barAllocInfo = {};
+		barAllocInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+		barAllocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+		VmaAllocationInfo allocationInfo = {};
+		if (vmaCreateBuffer(_allocator, &bufferInfo, &barAllocInfo, &_lightBuffer._buffer, &_lightBuffer._allocation, &allocationInfo) == VK_SUCCESS)
+		{
+			_lightBuffer._mapped = allocationInfo.pMappedData;
+			_directWrites = true;
+		}
+	}
+	_frameCount = _directWrites ? frameCount : 1;
+
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+	auto create = [&](VkDeviceSize size, AllocatedBuffer& buffer) {
+		VkBufferCreateInfo bufferInfo = {};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.pNext = nullptr;
+		bufferInfo.size = size;
+		bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &allocInfo, &buffer._buffer, &buffer._allocation, nullptr));
+	};
+	if (!_directWrites)
+	{
+		create(MAX_LIGHTS * sizeof(GpuLight), _lightBuffer);
+	}
+	create(CLUSTER_COUNT * 2 * sizeof(uint32_t), _gridBuffer);
+	create(MAX_LIGHT_INDICES * sizeof(uint32_t), _indexBuffer);
+	create(sizeof(uint32_t), _counterBuffer);
+
+	VkDescriptorSetLayoutBinding bindings[4];
+	for (uint32_t binding = 0; binding < 4; binding++)
+	{
+		bindings[binding] = vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, binding);
+	}
+
+	VkDescriptorSetLayoutCreateInfo setInfo = {};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setInfo.pNext = nullptr;
+	setInfo.bindingCount = 4;
+	setInfo.pBindings = bindings;
+	VK_CHECK(vkCreateDescriptorSetLayout(_device, &setInfo, nullptr, &_setLayout));
+
+	// lights, grid, indices and the counter, in binding order
+	descriptors.allocate(&_set, _setLayout);
+	VkDescriptorBufferInfo bufferInfos[] = {
+		{ _lightBuffer._buffer, 0, VK_WHOLE_SIZE },
+		{ _gridBuffer._buffer, 0, VK_WHOLE_SIZE },
+		{ _indexBuffer._buffer, 0, VK_WHOLE_SIZE },
+		{ _counterBuffer._buffer, 0, VK_WHOLE_SIZE },
+	};
+	VkWriteDescriptorSet writes[4];
+	for (uint32_t binding = 0; binding < 4; binding++)
+	{
+		writes[binding] = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _set, &bufferInfos[binding], binding);
+	}
+	vkUpdateDescriptorSets(_device, 4, writes, 0, nullptr);
+
+	VkPushConstantRange pushConstant;
+	pushConstant.offset = 0;
+	pushConstant.size = sizeof(ClusterPushConstants);
+	pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkPipelineLayoutCreateInfo layoutInfo = vkinit::pipeline_layout_create_info();
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &_setLayout;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushConstant;
+	VK_CHECK(vkCreatePipelineLayout(_device, &layoutInfo, nullptr, &_pipelineLayout));
+
+	if (clusterShader != VK_NULL_HANDLE)
+	{
+		VkComputePipelineCreateInfo pipelineInfo = {};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.pNext = nullptr;
+		pipelineInfo.layout = _pipelineLayout;
+		pipelineInfo.stage = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, clusterShader);
+		VK_CHECK(vkCreateComputePipelines(_device, cache, 1, &pipelineInfo, nullptr, &_pipeline));
+	}
+}
+
+void ClusteredLights::cleanup()
+{
+	// the set goes with the descriptor allocator's pools
+	vkDestroyPipeline(_device, _pipeline, nullptr);
+	vkDestroyPipelineLayout(_device, _pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(_device, _setLayout, nullptr);
+	for (AllocatedBuffer* buffer : { &_lightBuffer, &_gridBuffer, &_indexBuffer, &_counterBuffer })
+	{
+		vmaDestroyBuffer(_allocator, buffer->_buffer, buffer->_allocation);
+		*buffer = {};
+	}
+}
+
+void ClusteredLights::write_descriptors(VkDescriptorSet set, uint32_t firstBinding) const
+{
+	VkDescriptorBufferInfo bufferInfos[] = {
+		{ _lightBuffer._buffer, 0, VK_WHOLE_SIZE },
+		{ _gridBuffer._buffer, 0, VK_WHOLE_SIZE },
+		{ _indexBuffer._buffer, 0, VK_WHOLE_SIZE },
+	};
+	VkWriteDescriptorSet writes[3];
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		writes[i] = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, set, &bufferInfos[i], firstBinding + i);
+	}
+	vkUpdateDescriptorSets(_device, 3, writes, 0, nullptr);
+}
+
+glm::vec2 ClusteredLights::slice_params(const Camera& camera)
+{
+	const float nearPlane = camera.near_plane();
+	const float scale = GRID_Z / std::log(cluster_far(camera) / nearPlane);
+	return glm::vec2(scale, -std::log(nearPlane) * scale);
+}
+
+void ClusteredLights::record(VkCommandBuffer cmd, uint32_t frame, GpuLinearAllocator& staging, const GpuLight* lights, uint32_t count, const Camera& camera)
+{
+	// the previous frame's fragments may still be reading every buffer written below
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+	_lightCount = std::min(count, MAX_LIGHTS);
+	const uint32_t lightBase = _directWrites ? (frame % _frameCount) * MAX_LIGHTS : 0;
+	GpuAllocation allocation;
+	if (_directWrites)
+	{
+		// visible to the GPU with the submit once flushed
+		const VkDeviceSize offset = VkDeviceSize(lightBase) * sizeof(GpuLight);
+		memcpy(static_cast<uint8_t*>(_lightBuffer._mapped) + offset, lights, _lightCount * sizeof(GpuLight));
+		if (_lightCount > 0)
+		{
+			vmaFlushAllocation(_allocator, _lightBuffer._allocation, offset, _lightCount * sizeof(GpuLight));
+		}
+	}
+	else if (_lightCount > 0 && staging.allocate(_lightCount * sizeof(GpuLight), alignof(GpuLight), &allocation))
+	{
+		memcpy(allocation.data, lights, _lightCount * sizeof(GpuLight));
+		VkBufferCopy region = { allocation.offset, 0, _lightCount * sizeof(GpuLight) };
+		vkCmdCopyBuffer(cmd, staging.buffer(), _lightBuffer._buffer, 1, &region);
+	}
+	else
+	{
+		_lightCount = 0;
+	}
+
+	// without the pass every cluster is simply empty
+	vkCmdFillBuffer(cmd, _counterBuffer._buffer, 0, VK_WHOLE_SIZE, 0);
+	if (!ready())
+	{
+		vkCmdFillBuffer(cmd, _gridBuffer._buffer, 0, VK_WHOLE_SIZE, 0);
+	}
+	// the copied lights first if there was a copy, the grid last if it was cleared
+	VkBufferMemoryBarrier uploaded[] = {
+		vkinit::buffer_barrier(_lightBuffer._buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT),
+		vkinit::buffer_barrier(_counterBuffer._buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT),
+		vkinit::buffer_barrier(_gridBuffer._buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT),
+	};
+	const uint32_t firstBarrier = _directWrites ? 1 : 0;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		0, 0, nullptr, (ready() ? 2 : 3) - firstBarrier, uploaded + firstBarrier, 0, nullptr);
+	if (!ready())
+	{
+		return;
+	}
+
+	ClusterPushConstants constants;
+	constants.view = camera.view();
+	constants.projection = glm::vec4(camera.projection()[0][0], camera.projection()[1][1], camera.near_plane(), cluster_far(camera));
+	constants.gridSize[0] = GRID_X;
+	constants.gridSize[1] = GRID_Y;
+	constants.gridSize[2] = GRID_Z;
+	constants.lightCount = _lightCount;
+	constants.lightBase = lightBase;
+	constants.axisX = -camera.projection()[2][0];
+	constants.axisY = -camera.projection()[2][1];
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout, 0, 1, &_set, 0, nullptr);
+	vkCmdPushConstants(cmd, _pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ClusterPushConstants), &constants);
+	vkCmdDispatch(cmd, GRID_X, GRID_Y, GRID_Z);
+
+	VkBufferMemoryBarrier built[] = {
+		vkinit::buffer_barrier(_gridBuffer._buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT),
+		vkinit::buffer_barrier(_indexBuffer._buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT),
+	};
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 2, built, 0, nullptr);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vk_types.h>
+#include <DescriptorAllocator.h>
+#include <GpuLinearAllocator.h>
+#include <Camera.h>
+
+#include <cstdint>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+// a point light as the shaders read it: world-space position and range, and color already scaled by intensity
+struct GpuLight {
+	glm::vec4 positionRadius;
+	glm::vec4 color; // w unused
+};
+
+// Clustered forward lighting: the view frustum is cut into GRID_X x GRID_Y screen tiles and GRID_Z slices of
+// view depth, spaced logarithmically so clusters stay roughly cubic, and every frame lightCluster.comp lists
+// the lights whose range touches each cluster. A fragment then finds its cluster from its pixel and depth and
+// shades with only that list, so its cost follows the lights near it, not the lights in the scene.
+// The lists are packed back to back in one index buffer, with an offset and count per cluster in the grid
+// buffer; a cluster keeps at most MAX_LIGHTS_PER_CLUSTER and the index buffer drops what doesn't fit.
+// The lighting shaders read lights, grid and indices through the bindings write_descriptors() fills; see
+// shaders/lights.glsl.
+// With direct writes the light buffer holds a region of MAX_LIGHTS per frame slot in DEVICE_LOCAL |
+// HOST_VISIBLE memory, record() writes the frame's lights straight into its slot's region and the lists
+// index the buffer from the region's start, so nothing is staged or copied. Otherwise there is one region,
+// in device-local memory, filled by a copy from the frame's staging ring.
+class ClusteredLights
+{
+public:
+	static constexpr uint32_t GRID_X = 16;
+	static constexpr uint32_t GRID_Y = 9;
+	static constexpr uint32_t GRID_Z = 24;
+	static constexpr uint32_t CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+	static constexpr uint32_t MAX_LIGHTS = 4096;
+	// shared memory of lightCluster.comp
+	static constexpr uint32_t MAX_LIGHTS_PER_CLUSTER = 256;
+	// room for 64 lights in every cluster at once; scenes with more overlap lose the last clusters' lights
+	static constexpr uint32_t MAX_LIGHT_INDICES = CLUSTER_COUNT * 64;
+	// depth the last slice ends at, whatever the camera's far plane, which may be at infinity
+	static constexpr float MAX_DISTANCE = 500.0f;
+
+	// the buffers always exist, so descriptors pointing at them stay valid; without a shader there is no
+	// pipeline and record() leaves every cluster empty. directWrites falls back to staging when the light
+	// buffer doesn't fit into host-visible device-local memory
+	void init(VkDevice device, VmaAllocator allocator, DescriptorAllocator& descriptors, VkShaderModule clusterShader, VkPipelineCache cache,
+		uint32_t frameCount, bool directWrites);
+	void cleanup();
+
+	bool ready() const { return _pipeline != VK_NULL_HANDLE; }
+
+	// lights, grid and index list as storage buffers at firstBinding and the two after it
+	void write_descriptors(VkDescriptorSet set, uint32_t firstBinding) const;
+
+	// slice = log(depth) * x + y for view depth, the way lights.glsl finds its cluster
+	static glm::vec2 slice_params(const Camera& camera);
+
+	// outside a render pass, before anything shades with the clusters: uploads count lights (at most
+	// MAX_LIGHTS) into frame's region or through staging and rebuilds the lists against camera. Waits for
+	// the previous frame's fragment shaders and makes the results visible to this frame's. staging needs
+	// TRANSFER_SRC usage
+	void record(VkCommandBuffer cmd, uint32_t frame, GpuLinearAllocator& staging, const GpuLight* lights, uint32_t count, const Camera& camera);
+
+	// of the last record()
+	uint32_t light_count() const { return _lightCount; }
+	bool direct_writes() const { return _directWrites; }
+
+private:
+	VkDevice _device{ VK_NULL_HANDLE };
+	VmaAllocator _allocator{ nullptr };
+
+	VkDescriptorSetLayout _setLayout{ VK_NULL_HANDLE };
+	VkDescriptorSet _set{ VK_NULL_HANDLE };
+	VkPipelineLayout _pipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline _pipeline{ VK_NULL_HANDLE };
+
+	AllocatedBuffer _lightBuffer{};
+	AllocatedBuffer _gridBuffer{}; // offset and count per cluster
+	AllocatedBuffer _indexBuffer{};
+	AllocatedBuffer _counterBuffer{}; // indices handed out so far this frame
+
+	uint32_t _lightCount{ 0 };
+	bool _directWrites{ false };
+	uint32_t _frameCount{ 1 }; // light regions
+};
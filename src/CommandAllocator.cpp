@@ -0,0 +1,63 @@
+#include "CommandAllocator.h"
+
+#include "vk_initializers.h"
+
+void CommandAllocator::init(VkDevice device, uint32_t queueFamily, uint32_t frameCount, uint32_t threadCount)
+{
+	_device = device;
+	_threadCount = threadCount;
+	_frame = 0;
+	_pools.resize(static_cast<size_t>(frameCount) * threadCount);
+	// transient: everything recorded from them is thrown away with the frame
+	VkCommandPoolCreateInfo poolInfo = vkinit::command_pool_create_info(queueFamily, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+	for (Pool& pool : _pools)
+	{
+		VK_CHECK(vkCreateCommandPool(_device, &poolInfo, nullptr, &pool.pool));
+	}
+}
+
+void CommandAllocator::cleanup()
+{
+	// destroying a pool frees its buffers
+	for (Pool& pool : _pools)
+	{
+		vkDestroyCommandPool(_device, pool.pool, nullptr);
+	}
+	_pools.clear();
+}
+
+void CommandAllocator::begin_frame(uint32_t frameIndex)
+{
+	_frame = frameIndex;
+	for (uint32_t t = 0; t < _threadCount; t++)
+	{
+		Pool& pool = _pools[static_cast<size_t>(_frame) * _threadCount + t];
+		// nothing was allocated from it last time, so there's nothing to reset
+		if (pool.used[0] + pool.used[1] == 0)
+		{
+			continue;
+		}
+		VK_CHECK(vkResetCommandPool(_device, pool.pool, 0));
+		pool.used[0] = 0;
+		pool.used[1] = 0;
+	}
+}
+
+VkCommandBuffer CommandAllocator::allocate(uint32_t thread, VkCommandBufferLevel level, const char* name)
+{
+	Pool& pool = _pools[static_cast<size_t>(_frame) * _threadCount + thread];
+	const uint32_t list = level == VK_COMMAND_BUFFER_LEVEL_SECONDARY ? 1 : 0;
+	std::vector<VkCommandBuffer>& buffers = pool.buffers[list];
+	if (pool.used[list] == buffers.size())
+	{
+		VkCommandBuffer cmd;
+		VkCommandBufferAllocateInfo allocInfo = vkinit::command_buffer_allocate_info(pool.pool, 1, level);
+		VK_CHECK(vkAllocateCommandBuffers(_device, &allocInfo, &cmd));
+		if (_namer && name != nullptr)
+		{
+			_namer(VK_OBJECT_TYPE_COMMAND_BUFFER, (uint64_t)cmd, name);
+		}
+		buffers.push_back(cmd);
+	}
+	return buffers[pool.used[list]++];
+}
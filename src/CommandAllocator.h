@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vk_types.h>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Command buffers that live for one frame, from a transient pool per frame slot and recording thread. Once the
+// slot's fence has signaled, begin_frame() resets its pools whole with vkResetCommandPool instead of resetting
+// buffer by buffer, which lets the driver recycle the memory in one go. Buffers stay allocated across resets
+// and come back in the order they were handed out, so a frame that records as many as the last allocates none.
+class CommandAllocator
+{
+public:
+	// threadCount pools per slot, one for each thread that records at the same time as the others
+	void init(VkDevice device, uint32_t queueFamily, uint32_t frameCount, uint32_t threadCount);
+	// the GPU must be done with every buffer
+	void cleanup();
+
+	// buffers allocated for the first time are named through namer, for the debug utils
+	void set_object_namer(std::function<void(VkObjectType type, uint64_t handle, const char* name)> namer) { _namer = std::move(namer); }
+
+	// resets every pool of frameIndex and makes it the slot buffers come from; its last frame must be finished
+	void begin_frame(uint32_t frameIndex);
+
+	// a buffer from the thread's pool of the current slot, ready to begin. Only one thread at a time may use a
+	// thread index, and buffers from one index may not be recorded at the same time
+	VkCommandBuffer allocate(uint32_t thread, VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY, const char* name = nullptr);
+
+	uint32_t thread_count() const { return _threadCount; }
+
+private:
+	struct Pool {
+		VkCommandPool pool{ VK_NULL_HANDLE };
+		// every buffer ever allocated from it, by level; the first used of them handed out since the reset
+		std::vector<VkCommandBuffer> buffers[2];
+		uint32_t used[2]{ 0, 0 };
+	};
+
+	VkDevice _device{ VK_NULL_HANDLE };
+	uint32_t _threadCount{ 0 };
+	uint32_t _frame{ 0 };
+	// frame * _threadCount + thread
+	std::vector<Pool> _pools;
+	std::function<void(VkObjectType, uint64_t, const char*)> _namer;
+};
@@ -0,0 +1,246 @@
+#include "ComputePrimitives.h"
+
+#include "vk_initializers.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace {
+	// matches the push constants of primitives.glsl
+	struct PrimitivePushConstants {
+		uint32_t count;
+		uint32_t shift;
+		uint32_t keyWords;
+		uint32_t blockCount;
+	};
+
+	constexpr uint32_t RADIX_BUCKETS = 1u << ComputePrimitives::RADIX_BITS;
+	// dispatches stay within the 65535 workgroups every device takes, one element per invocation at most
+	constexpr uint32_t MAX_COUNT = 65535 * ComputePrimitives::GROUP_SIZE;
+
+	uint32_t groups(uint32_t count, uint32_t size)
+	{
+		return std::max(1u, (count + size - 1) / size);
+	}
+
+	// each dispatch reads what the one before wrote, and may overwrite what it read
+	void compute_barrier(VkCommandBuffer cmd)
+	{
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.pNext = nullptr;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	DescriptorWrite storage(uint32_t binding, const StorageRange& range)
+	{
+		return DescriptorWrite::buffer_write(binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, range.buffer, range.offset, range.size);
+	}
+
+	StorageRange whole(const AllocatedBuffer& buffer)
+	{
+		return { buffer._buffer, 0, VK_WHOLE_SIZE };
+	}
+}
+
+bool ComputePrimitives::supported(VkPhysicalDevice gpu)
+{
+	VkPhysicalDeviceSubgroupProperties subgroupProperties = {};
+	subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+
+	VkPhysicalDeviceProperties2 properties2 = {};
+	properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties2.pNext = &subgroupProperties;
+	vkGetPhysicalDeviceProperties2(gpu, &properties2);
+
+	// the shaders size their shared arrays for subgroups of at least 4
+	const VkSubgroupFeatureFlags operations = VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_ARITHMETIC_BIT | VK_SUBGROUP_FEATURE_BALLOT_BIT;
+	return (subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) && (subgroupProperties.supportedOperations & operations) == operations
+		&& subgroupProperties.subgroupSize >= 4;
+}
+
+void ComputePrimitives::init(VkDevice device, VmaAllocator allocator, LayoutCache& layouts, DescriptorSetCache& descriptorSets, const Shaders& shaders,
+	VkPipelineCache cache, uint32_t maxCount, uint32_t frameCount)
+{
+	_device = device;
+	_allocator = allocator;
+	_descriptorSets = &descriptorSets;
+	_maxCount = std::max(1u, std::min(maxCount, MAX_COUNT));
+
+	// every kernel uses some of the same five bindings, so one layout serves them all
+	std::vector<VkDescriptorSetLayoutBinding> bindings;
+	for (uint32_t binding = 0; binding < 5; binding++)
+	{
+		bindings.push_back(vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, binding));
+	}
+	_setLayout = layouts.set_layout(bindings);
+
+	VkPushConstantRange pushConstant;
+	pushConstant.offset = 0;
+	pushConstant.size = sizeof(PrimitivePushConstants);
+	pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	_pipelineLayout = layouts.pipeline_layout({ _setLayout }, { pushConstant });
+
+	VkShaderModule modules[] = { shaders.scan, shaders.scanAdd, shaders.compact, shaders.radixHistogram, shaders.radixScatter };
+	if (std::find(std::begin(modules), std::end(modules), VkShaderModule(VK_NULL_HANDLE)) == std::end(modules))
+	{
+		VkComputePipelineCreateInfo pipelineInfos[5] = {};
+		for (int i = 0; i < 5; i++)
+		{
+			pipelineInfos[i].sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+			pipelineInfos[i].pNext = nullptr;
+			pipelineInfos[i].layout = _pipelineLayout;
+			pipelineInfos[i].stage = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, modules[i]);
+		}
+		VkPipeline pipelines[5];
+		VK_CHECK(vkCreateComputePipelines(_device, cache, 5, pipelineInfos, nullptr, pipelines));
+		_scanPipeline = pipelines[0];
+		_scanAddPipeline = pipelines[1];
+		_compactPipeline = pipelines[2];
+		_histogramPipeline = pipelines[3];
+		_scatterPipeline = pipelines[4];
+	}
+
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+	auto create = [&](uint32_t words, AllocatedBuffer& buffer) {
+		VkBufferCreateInfo bufferInfo = {};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.pNext = nullptr;
+		bufferInfo.size = VkDeviceSize(words) * sizeof(uint32_t);
+		bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &allocInfo, &buffer._buffer, &buffer._allocation, nullptr));
+	};
+
+	// the largest scan is either a compaction's flags or a sort pass's histogram, which outgrows the keys
+	// for small counts; each level holds its blocks' sums and the total after them
+	const uint32_t histogramCount = histogram_count(_maxCount);
+	const uint32_t scanCount = std::max(_maxCount, histogramCount);
+	_slots.resize(frameCount);
+	for (Slot& slot : _slots)
+	{
+		create(_maxCount + 1, slot.offsets);
+		create(histogramCount + 1, slot.histogram);
+		create(_maxCount * 2, slot.keys);
+		create(_maxCount, slot.values);
+		for (uint32_t blocks = groups(scanCount, SCAN_BLOCK);; blocks = groups(blocks, SCAN_BLOCK))
+		{
+			slot.blockSums.emplace_back();
+			create(blocks + 1, slot.blockSums.back());
+			if (blocks == 1)
+			{
+				break;
+			}
+		}
+	}
+}
+
+void ComputePrimitives::cleanup()
+{
+	// the layouts go with the layout cache, the sets with the descriptor set cache
+	for (VkPipeline pipeline : { _scanPipeline, _scanAddPipeline, _compactPipeline, _histogramPipeline, _scatterPipeline })
+	{
+		vkDestroyPipeline(_device, pipeline, nullptr);
+	}
+	_scanPipeline = _scanAddPipeline = _compactPipeline = _histogramPipeline = _scatterPipeline = VK_NULL_HANDLE;
+
+	for (Slot& slot : _slots)
+	{
+		for (AllocatedBuffer* buffer : { &slot.offsets, &slot.histogram, &slot.keys, &slot.values })
+		{
+			vmaDestroyBuffer(_allocator, buffer->_buffer, buffer->_allocation);
+		}
+		for (AllocatedBuffer& buffer : slot.blockSums)
+		{
+			vmaDestroyBuffer(_allocator, buffer._buffer, buffer._allocation);
+		}
+	}
+	_slots.clear();
+}
+
+void ComputePrimitives::exclusive_scan(VkCommandBuffer cmd, uint32_t frame, const StorageRange& input, const StorageRange& output, uint32_t count)
+{
+	assert(ready() && count <= std::max(_maxCount, histogram_count(_maxCount)));
+	scan_level(cmd, frame, input, output, count, 0);
+}
+
+void ComputePrimitives::compact(VkCommandBuffer cmd, uint32_t frame, const StorageRange& values, const StorageRange& flags, const StorageRange& output,
+	const StorageRange& countOut, uint32_t count)
+{
+	assert(ready() && count <= _maxCount);
+	const StorageRange offsets = whole(_slots[frame].offsets);
+	scan_level(cmd, frame, flags, offsets, count, 0);
+
+	const DescriptorWrite writes[] = { storage(0, values), storage(1, offsets), storage(2, flags), storage(3, output), storage(4, countOut) };
+	dispatch(cmd, frame, _compactPipeline, writes, 5, count, 0, 0, groups(count, GROUP_SIZE));
+}
+
+void ComputePrimitives::sort(VkCommandBuffer cmd, uint32_t frame, const StorageRange& keys, const StorageRange& values, uint32_t count, uint32_t keyBits)
+{
+	// an even number of passes ends back in the caller's buffers
+	assert(ready() && count <= _maxCount && keyBits > 0 && keyBits <= 64 && keyBits % (2 * RADIX_BITS) == 0);
+	if (count <= 1)
+	{
+		return;
+	}
+
+	const Slot& slot = _slots[frame];
+	const uint32_t keyWords = keyBits > 32 ? 2 : 1;
+	const uint32_t blocks = groups(count, GROUP_SIZE);
+	const StorageRange histogram = whole(slot.histogram);
+	const StorageRange scratchKeys = whole(slot.keys);
+	const StorageRange scratchValues = whole(slot.values);
+	for (uint32_t shift = 0; shift < keyBits; shift += RADIX_BITS)
+	{
+		const bool fromScratch = (shift / RADIX_BITS) % 2 == 1;
+		const StorageRange& keysIn = fromScratch ? scratchKeys : keys;
+		const StorageRange& keysOut = fromScratch ? keys : scratchKeys;
+		const StorageRange& valuesIn = fromScratch ? scratchValues : values;
+		const StorageRange& valuesOut = fromScratch ? values : scratchValues;
+
+		const DescriptorWrite histogramWrites[] = { storage(0, keysIn), storage(2, histogram) };
+		dispatch(cmd, frame, _histogramPipeline, histogramWrites, 2, count, shift, keyWords, blocks);
+
+		scan_level(cmd, frame, histogram, histogram, blocks * RADIX_BUCKETS, 0);
+
+		const DescriptorWrite scatterWrites[] = { storage(0, keysIn), storage(1, keysOut), storage(2, histogram), storage(3, valuesIn), storage(4, valuesOut) };
+		dispatch(cmd, frame, _scatterPipeline, scatterWrites, 5, count, shift, keyWords, blocks);
+	}
+}
+
+void ComputePrimitives::scan_level(VkCommandBuffer cmd, uint32_t frame, const StorageRange& input, const StorageRange& output, uint32_t count, uint32_t level)
+{
+	const StorageRange blockSums = whole(_slots[frame].blockSums[level]);
+	const uint32_t blocks = groups(count, SCAN_BLOCK);
+	const DescriptorWrite scanWrites[] = { storage(0, input), storage(1, output), storage(2, blockSums) };
+	dispatch(cmd, frame, _scanPipeline, scanWrites, 3, count, 0, 0, blocks);
+	if (blocks == 1)
+	{
+		return;
+	}
+
+	// the blocks' sums scanned in place give every block its offset and, after them, the total
+	scan_level(cmd, frame, blockSums, blockSums, blocks, level + 1);
+	const DescriptorWrite addWrites[] = { storage(1, output), storage(2, blockSums) };
+	dispatch(cmd, frame, _scanAddPipeline, addWrites, 2, count, 0, 0, blocks);
+}
+
+void ComputePrimitives::dispatch(VkCommandBuffer cmd, uint32_t frame, VkPipeline pipeline, const DescriptorWrite* writes, uint32_t writeCount,
+	uint32_t count, uint32_t shift, uint32_t keyWords, uint32_t groupCount)
+{
+	VkDescriptorSet set = _descriptorSets->get(frame, _setLayout, writes, writeCount);
+	const PrimitivePushConstants constants = { count, shift, keyWords, groupCount };
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout, 0, 1, &set, 0, nullptr);
+	vkCmdPushConstants(cmd, _pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PrimitivePushConstants), &constants);
+	vkCmdDispatch(cmd, groupCount, 1, 1);
+	compute_barrier(cmd);
+}
+
+uint32_t ComputePrimitives::histogram_count(uint32_t count) const
+{
+	return RADIX_BUCKETS * groups(count, GROUP_SIZE);
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <vk_types.h>
+#include <DescriptorSetCache.h>
+#include <LayoutCache.h>
+
+#include <cstdint>
+#include <vector>
+
+// part of a storage buffer a primitive reads or writes; offset must meet minStorageBufferOffsetAlignment
+struct StorageRange {
+	VkBuffer buffer{ VK_NULL_HANDLE };
+	VkDeviceSize offset{ 0 };
+	VkDeviceSize size{ VK_WHOLE_SIZE };
+};
+
+// Data-parallel building blocks for compute passes, on arrays of uints in storage buffers: exclusive prefix
+// sum, stream compaction and a stable LSD radix sort of 32 or 64-bit keys with uint values. The scan does a
+// block of 1024 elements per workgroup on subgroup arithmetic, then scans the blocks' sums the same way and
+// adds them back, so a million elements take two levels. The sort makes passes of 4-bit digits: per pass
+// a histogram per workgroup of 256 keys, a scan of all of them, and a scatter ranking keys within subgroups
+// by ballot. Every call only records; the results are visible to compute shaders once it returns, and the
+// inputs may be overwritten by the next dispatch.
+// Scratch for counts up to maxCount is held per frame slot, so the frames in flight never share it; a slot
+// may run any number of primitives in one command buffer, one after the other.
+class ComputePrimitives
+{
+public:
+	// kernel workgroups; primitives.glsl's PRIMITIVE_GROUP_SIZE and PRIMITIVE_SCAN_BLOCK
+	static constexpr uint32_t GROUP_SIZE = 256;
+	static constexpr uint32_t SCAN_BLOCK = 1024;
+	// digit bits per sort pass
+	static constexpr uint32_t RADIX_BITS = 4;
+
+	struct Shaders {
+		VkShaderModule scan{ VK_NULL_HANDLE };
+		VkShaderModule scanAdd{ VK_NULL_HANDLE };
+		VkShaderModule compact{ VK_NULL_HANDLE };
+		VkShaderModule radixHistogram{ VK_NULL_HANDLE };
+		VkShaderModule radixScatter{ VK_NULL_HANDLE };
+	};
+
+	// the kernels need subgroup arithmetic and ballots in compute shaders (Vulkan 1.1)
+	static bool supported(VkPhysicalDevice gpu);
+
+	// without every shader there are no pipelines and ready() is false; descriptorSets hands out the
+	// per-call sets, and must have at least frameCount slots
+	void init(VkDevice device, VmaAllocator allocator, LayoutCache& layouts, DescriptorSetCache& descriptorSets, const Shaders& shaders,
+		VkPipelineCache cache, uint32_t maxCount, uint32_t frameCount);
+	void cleanup();
+
+	bool ready() const { return _scatterPipeline != VK_NULL_HANDLE; }
+	uint32_t max_count() const { return _maxCount; }
+
+	// output[i] = input[0] + ... + input[i - 1] for i up to count, so output holds count + 1 elements, the
+	// last the total. output may be input
+	void exclusive_scan(VkCommandBuffer cmd, uint32_t frame, const StorageRange& input, const StorageRange& output, uint32_t count);
+
+	// the values whose flag is non-zero, in order, to output, and how many there were to countOut's first uint
+	void compact(VkCommandBuffer cmd, uint32_t frame, const StorageRange& values, const StorageRange& flags, const StorageRange& output,
+		const StorageRange& countOut, uint32_t count);
+
+	// sorts keys ascending in place, values along with them, equal keys keeping their order. 64-bit keys are
+	// pairs of uints, low word first; keyBits is 32 or 64, or a smaller multiple of 8 to sort on only the
+	// low bits, since an even number of passes leaves the result where it started
+	void sort(VkCommandBuffer cmd, uint32_t frame, const StorageRange& keys, const StorageRange& values, uint32_t count, uint32_t keyBits = 32);
+
+private:
+	struct Slot {
+		AllocatedBuffer offsets{}; // compaction's scanned flags
+		AllocatedBuffer histogram{}; // a sort pass's digit counts, then their scan
+		AllocatedBuffer keys{}; // the sort's other half of every pass
+		AllocatedBuffer values{};
+		std::vector<AllocatedBuffer> blockSums; // a level per scan recursion
+	};
+
+	void scan_level(VkCommandBuffer cmd, uint32_t frame, const StorageRange& input, const StorageRange& output, uint32_t count, uint32_t level);
+	void dispatch(VkCommandBuffer cmd, uint32_t frame, VkPipeline pipeline, const DescriptorWrite* writes, uint32_t writeCount,
+		uint32_t count, uint32_t shift, uint32_t keyWords, uint32_t groupCount);
+	uint32_t histogram_count(uint32_t count) const;
+
+	VkDevice _device{ VK_NULL_HANDLE };
+	VmaAllocator _allocator{ nullptr };
+	DescriptorSetCache* _descriptorSets{ nullptr };
+	uint32_t _maxCount{ 0 };
+
+	VkDescriptorSetLayout _setLayout{ VK_NULL_HANDLE };
+	VkPipelineLayout _pipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline _scanPipeline{ VK_NULL_HANDLE };
+	VkPipeline _scanAddPipeline{ VK_NULL_HANDLE };
+	VkPipeline _compactPipeline{ VK_NULL_HANDLE };
+	VkPipeline _histogramPipeline{ VK_NULL_HANDLE };
+	VkPipeline _scatterPipeline{ VK_NULL_HANDLE };
+
+	std::vector<Slot> _slots;
+};
@@ -0,0 +1,372 @@
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+namespace {
+	// finished scopes a thread can record between two drains before the oldest are lost
+	constexpr uint64_t RING_SIZE = 4096;
+
+	// written by the owning thread only, read by the drain; atomic so a slot being
+	// overwritten while it's copied is a stale value rather than a data race
+	struct Slot {
+		std::atomic<const char*> name{ nullptr };
+		std::atomic<uint64_t> startNs{ 0 };
+		std::atomic<uint64_t> endNs{ 0 };
+		std::atomic<uint32_t> depth{ 0 };
+	};
+
+	struct ThreadRing {
+		Slot slots[RING_SIZE];
+		// events ever recorded; published with release after the slot is written
+		std::atomic<uint64_t> head{ 0 };
+		// first event not drained yet; drain side only
+		uint64_t tail{ 0 };
+		uint32_t id{ 0 };
+		std::string name;
+	};
+
+	struct HistoryFrame {
+		int64_t frameNumber{ -1 }; // -1 while the slot hasn't been used
+		uint64_t startNs{ 0 };
+		uint64_t endNs{ 0 };
+		std::vector<cpu_profiler::Event> events;
+	};
+
+	struct Profiler {
+		// held by the drain and while a thread registers; never while recording
+		std::mutex mutex;
+		std::vector<std::unique_ptr<ThreadRing>> rings;
+		std::vector<cpu_profiler::Event> frameEvents;
+		std::vector<cpu_profiler::Event> captured;
+		bool capturing{ false };
+		// the last frames drained, oldest at historyNext once every slot has been used
+		std::vector<HistoryFrame> history;
+		size_t historyNext{ 0 };
+		cpu_profiler::FrameTotals latest;
+		uint64_t lastFrameNs{ 0 };
+	};
+
+	Profiler& profiler()
+	{
+		static Profiler instance;
+		return instance;
+	}
+
+	const std::chrono::steady_clock::time_point& epoch()
+	{
+		static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		return start;
+	}
+
+	thread_local ThreadRing* t_ring = nullptr;
+	thread_local uint32_t t_depth = 0;
+
+	ThreadRing& thread_ring()
+	{
+		if (t_ring == nullptr)
+		{
+			// once per thread; the ring lives as long as the profiler, so late drains can still read it
+			auto ring = std::make_unique<ThreadRing>();
+			Profiler& p = profiler();
+			std::lock_guard<std::mutex> lock(p.mutex);
+			ring->id = static_cast<uint32_t>(p.rings.size());
+			ring->name = "thread " + std::to_string(ring->id);
+			t_ring = ring.get();
+			p.rings.push_back(std::move(ring));
+		}
+		return *t_ring;
+	}
+
+	// appends what every ring recorded since the last drain; p.mutex must be held
+	void drain(Profiler& p, std::vector<cpu_profiler::Event>& events)
+	{
+		for (std::unique_ptr<ThreadRing>& ring : p.rings)
+		{
+			const uint64_t head = ring->head.load(std::memory_order_acquire);
+			uint64_t first = ring->tail;
+			if (head - first > RING_SIZE)
+			{
+				p.latest.droppedEvents += head - first - RING_SIZE;
+				first = head - RING_SIZE;
+			}
+
+			const size_t start = events.size();
+			for (uint64_t i = first; i < head; i++)
+			{
+				const Slot& slot = ring->slots[i % RING_SIZE];
+				events.push_back({ slot.name.load(std::memory_order_relaxed), slot.startNs.load(std::memory_order_relaxed),
+					slot.endNs.load(std::memory_order_relaxed), ring->id, slot.depth.load(std::memory_order_relaxed) });
+			}
+
+			// the thread kept recording meanwhile; anything it may have lapped during the copy is dropped
+			std::atomic_thread_fence(std::memory_order_acquire);
+			const uint64_t newHead = ring->head.load(std::memory_order_relaxed);
+			if (newHead > first + RING_SIZE)
+			{
+				const size_t lapped = static_cast<size_t>(std::min(newHead - RING_SIZE - first, head - first));
+				events.erase(events.begin() + start, events.begin() + start + lapped);
+				p.latest.droppedEvents += lapped;
+			}
+			ring->tail = head;
+		}
+	}
+
+	void write_json_string(std::ostream& out, const char* text)
+	{
+		out << '"';
+		for (const char* c = text; *c != '\0'; c++)
+		{
+			if (*c == '"' || *c == '\\')
+			{
+				out << '\\';
+			}
+			out << *c;
+		}
+		out << '"';
+	}
+
+	// Chrome trace JSON: a name for every thread, then complete ("X") events in microseconds that the caller
+	// writes between begin and end; p.mutex must be held
+	void write_trace_begin(std::ostream& out, const Profiler& p)
+	{
+		out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+		out << std::fixed << std::setprecision(3);
+		bool first = true;
+		for (const std::unique_ptr<ThreadRing>& ring : p.rings)
+		{
+			out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->id << ",\"args\":{\"name\":";
+			write_json_string(out, ring->name.c_str());
+			out << "}}";
+			first = false;
+		}
+		// the events that follow each lead with a comma, so something must come first even when no thread recorded
+		if (first)
+		{
+			out << "\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"qcengine\"}}";
+		}
+	}
+
+	void write_trace_event(std::ostream& out, const char* name, uint32_t thread, uint64_t startNs, uint64_t endNs)
+	{
+		out << ",\n{\"name\":";
+		write_json_string(out, name);
+		out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread << ",\"ts\":" << startNs / 1e3 << ",\"dur\":" << (endNs - startNs) / 1e3 << "}";
+	}
+
+	void write_trace_end(std::ostream& out)
+	{
+		out << "\n]}\n";
+	}
+}
+
+namespace cpu_profiler {
+	uint64_t now_ns()
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch()).count());
+	}
+
+	void set_thread_name(const char* name)
+	{
+		ThreadRing& ring = thread_ring();
+		std::lock_guard<std::mutex> lock(profiler().mutex);
+		ring.name = name;
+	}
+
+	uint32_t begin_scope()
+	{
+		return t_depth++;
+	}
+
+	void end_scope(const char* name, uint64_t startNs, uint32_t depth)
+	{
+		t_depth = depth;
+		ThreadRing& ring = thread_ring();
+		const uint64_t index = ring.head.load(std::memory_order_relaxed);
+		Slot& slot = ring.slots[index % RING_SIZE];
+		slot.name.store(name, std::memory_order_relaxed);
+		slot.startNs.store(startNs, std::memory_order_relaxed);
+		slot.endNs.store(now_ns(), std::memory_order_relaxed);
+		slot.depth.store(depth, std::memory_order_relaxed);
+		ring.head.store(index + 1, std::memory_order_release);
+	}
+
+	void end_frame(int64_t frameNumber)
+	{
+		Profiler& p = profiler();
+		std::lock_guard<std::mutex> lock(p.mutex);
+		p.frameEvents.clear();
+		drain(p, p.frameEvents);
+
+		// parents start before their children, so the totals read top-down
+		std::sort(p.frameEvents.begin(), p.frameEvents.end(), [](const Event& a, const Event& b) {
+			return a.startNs < b.startNs;
+		});
+
+		FrameTotals& totals = p.latest;
+		totals.scopes.clear();
+		for (const Event& event : p.frameEvents)
+		{
+			auto found = std::find_if(totals.scopes.begin(), totals.scopes.end(), [&](const ScopeTotal& total) {
+				return total.name == event.name && total.depth == event.depth;
+			});
+			if (found == totals.scopes.end())
+			{
+				totals.scopes.push_back({ event.name, event.depth, 0, 0.0 });
+				found = totals.scopes.end() - 1;
+			}
+			found->calls++;
+			found->milliseconds += static_cast<double>(event.endNs - event.startNs) / 1e6;
+		}
+
+		const uint64_t now = now_ns();
+		totals.frameNumber = frameNumber;
+		totals.milliseconds = p.lastFrameNs != 0 ? static_cast<double>(now - p.lastFrameNs) / 1e6 : 0.0;
+
+		if (!p.history.empty())
+		{
+			// assign keeps the slot's capacity, so this only allocates for a frame busier than the slot has seen
+			HistoryFrame& kept = p.history[p.historyNext];
+			kept.frameNumber = frameNumber;
+			kept.startNs = p.lastFrameNs;
+			kept.endNs = now;
+			kept.events.assign(p.frameEvents.begin(), p.frameEvents.end());
+			p.historyNext = (p.historyNext + 1) % p.history.size();
+		}
+		p.lastFrameNs = now;
+
+		if (p.capturing)
+		{
+			p.captured.insert(p.captured.end(), p.frameEvents.begin(), p.frameEvents.end());
+		}
+	}
+
+	const FrameTotals& latest()
+	{
+		return profiler().latest;
+	}
+
+	std::string format_latest()
+	{
+		const FrameTotals& totals = latest();
+		std::ostringstream out;
+		out << "CPU frame " << totals.frameNumber << ":";
+		out << std::fixed << std::setprecision(3);
+		out << " total=" << totals.milliseconds << "ms";
+		for (const ScopeTotal& scope : totals.scopes)
+		{
+			out << " " << std::string(scope.depth, '>') << scope.name << "=" << scope.milliseconds << "ms";
+			if (scope.calls > 1)
+			{
+				out << "(x" << scope.calls << ")";
+			}
+		}
+		if (totals.droppedEvents != 0)
+		{
+			out << " | dropped=" << totals.droppedEvents;
+		}
+		return out.str();
+	}
+
+	void begin_capture()
+	{
+		Profiler& p = profiler();
+		std::lock_guard<std::mutex> lock(p.mutex);
+		p.captured.clear();
+		p.capturing = true;
+	}
+
+	bool is_capturing()
+	{
+		Profiler& p = profiler();
+		std::lock_guard<std::mutex> lock(p.mutex);
+		return p.capturing;
+	}
+
+	bool end_capture(const std::string& path)
+	{
+		Profiler& p = profiler();
+		std::lock_guard<std::mutex> lock(p.mutex);
+		drain(p, p.captured);
+		p.capturing = false;
+
+		std::ofstream out(path);
+		if (!out)
+		{
+			return false;
+		}
+
+		write_trace_begin(out, p);
+		for (const Event& event : p.captured)
+		{
+			write_trace_event(out, event.name, event.thread, event.startNs, event.endNs);
+		}
+		write_trace_end(out);
+
+		p.captured.clear();
+		p.captured.shrink_to_fit();
+		return out.good();
+	}
+
+	void set_history(uint32_t frames)
+	{
+		Profiler& p = profiler();
+		std::lock_guard<std::mutex> lock(p.mutex);
+		p.history.clear();
+		p.history.resize(frames);
+		p.historyNext = 0;
+	}
+
+	bool write_history(const std::string& path, const std::vector<Counter>& counters)
+	{
+		Profiler& p = profiler();
+		std::lock_guard<std::mutex> lock(p.mutex);
+		std::ofstream out(path);
+		if (!out)
+		{
+			return false;
+		}
+
+		// frame spans go on a track past every thread's
+		const uint32_t framesTrack = static_cast<uint32_t>(p.rings.size());
+		write_trace_begin(out, p);
+		out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << framesTrack << ",\"args\":{\"name\":\"frames\"}}";
+		for (size_t i = 0; i < p.history.size(); i++)
+		{
+			const HistoryFrame& frame = p.history[(p.historyNext + i) % p.history.size()];
+			// the first frame ever has no start
+			if (frame.frameNumber < 0 || frame.startNs == 0)
+			{
+				continue;
+			}
+			const std::string name = "frame " + std::to_string(frame.frameNumber);
+			write_trace_event(out, name.c_str(), framesTrack, frame.startNs, frame.endNs);
+			for (const Event& event : frame.events)
+			{
+				write_trace_event(out, event.name, event.thread, event.startNs, event.endNs);
+			}
+		}
+
+		for (const Counter& counter : counters)
+		{
+			auto frame = std::find_if(p.history.begin(), p.history.end(), [&](const HistoryFrame& kept) {
+				return kept.frameNumber == counter.frameNumber && kept.startNs != 0;
+			});
+			if (frame == p.history.end())
+			{
+				continue;
+			}
+			out << ",\n{\"name\":";
+			write_json_string(out, counter.name);
+			out << ",\"ph\":\"C\",\"pid\":1,\"ts\":" << frame->startNs / 1e3 << ",\"args\":{\"value\":" << counter.value << "}}";
+		}
+		write_trace_end(out);
+		return out.good();
+	}
+}
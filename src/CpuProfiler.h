@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Scoped CPU timing. CPU_PROFILE_SCOPE("name") times the rest of the enclosing block on any thread, and
+// scopes nest. Each thread records finished scopes into a ring of its own with plain atomic stores, so
+// recording never takes a lock; end_frame() drains every ring on the frame thread, keeps the frame's
+// per-scope totals and, while capturing, the events themselves for a Chrome trace (chrome://tracing or
+// Perfetto). Names are kept by pointer: string literals, or anything else that lives as long.
+// The macro compiles to nothing without ENABLE_CPU_PROFILER (the CMake option of the same name).
+namespace cpu_profiler {
+	struct Event {
+		const char* name;
+		uint64_t startNs; // since the profiler's epoch
+		uint64_t endNs;
+		uint32_t thread; // in order of each thread's first scope
+		uint32_t depth; // scopes open around it on its thread
+	};
+
+	struct ScopeTotal {
+		const char* name;
+		uint32_t depth;
+		uint32_t calls;
+		double milliseconds;
+	};
+
+	struct FrameTotals {
+		int64_t frameNumber{ -1 }; // -1 until the first end_frame()
+		double milliseconds{ 0.0 }; // since the end_frame() before
+		// per name and depth, in order of first start
+		std::vector<ScopeTotal> scopes;
+		// events lost to rings that filled up between two drains, over the whole run
+		uint64_t droppedEvents{ 0 };
+	};
+
+	uint64_t now_ns();
+	// shown for the calling thread in traces
+	void set_thread_name(const char* name);
+
+	// used by Scope: begin returns the depth to pass back to end
+	uint32_t begin_scope();
+	void end_scope(const char* name, uint64_t startNs, uint32_t depth);
+
+	class Scope
+	{
+	public:
+		explicit Scope(const char* name) : _name(name), _depth(begin_scope()), _startNs(now_ns()) {}
+		~Scope() { end_scope(_name, _startNs, _depth); }
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		const char* _name;
+		uint32_t _depth;
+		uint64_t _startNs;
+	};
+
+	// frame thread, once a frame: drains the rings into latest(); doesn't allocate once the
+	// buffers have grown, unless capturing
+	void end_frame(int64_t frameNumber);
+	const FrameTotals& latest();
+	// one-line summary of latest(), for logging
+	std::string format_latest();
+
+	// keeps every event drained from now on, including those of scopes already recording
+	void begin_capture();
+	bool is_capturing();
+	// drains the rings once more, writes the capture to path as Chrome trace JSON and stops capturing
+	bool end_capture(const std::string& path);
+
+	// keeps the events of the last frames drained by end_frame() (none by default), so a frame that turned out
+	// slow can still be written once it's over; each kept frame's buffer is reused once it has grown
+	void set_history(uint32_t frames);
+
+	// one frame's value of something the profiler doesn't measure, shown as a counter track in the history's trace
+	struct Counter {
+		const char* name; // lives until write_history() returns
+		int64_t frameNumber;
+		double value;
+	};
+	// writes the kept frames and counters at the start of their frames to path as Chrome trace JSON, with every
+	// frame a span on a track of its own; counters of frames no longer kept are left out
+	bool write_history(const std::string& path, const std::vector<Counter>& counters);
+}
+
+#ifdef ENABLE_CPU_PROFILER
+#define CPU_PROFILE_CONCAT_INNER(a, b) a##b
+#define CPU_PROFILE_CONCAT(a, b) CPU_PROFILE_CONCAT_INNER(a, b)
+#define CPU_PROFILE_SCOPE(name) cpu_profiler::Scope CPU_PROFILE_CONCAT(cpuProfileScope, __LINE__)(name)
+#else
+#define CPU_PROFILE_SCOPE(name) ((void)0)
+#endif
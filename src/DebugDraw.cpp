@@ -0,0 +1,127 @@
+#include "DebugDraw.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <glm/vec4.hpp>
+
+#ifdef ENABLE_DEBUG_DRAW
+
+namespace {
+	// segments of each circle of a sphere
+	constexpr uint32_t SPHERE_SEGMENTS = 16;
+}
+
+bool DebugDraw::reserve(uint32_t count)
+{
+	if (_vertices.size() + count > MAX_VERTICES)
+	{
+		_dropped += count;
+		return false;
+	}
+	return true;
+}
+
+void DebugDraw::line(const glm::vec3& a, const glm::vec3& b, uint32_t color)
+{
+	if (!reserve(2))
+	{
+		return;
+	}
+	_vertices.push_back({ a, color });
+	_vertices.push_back({ b, color });
+}
+
+void DebugDraw::box(const glm::vec3& min, const glm::vec3& max, uint32_t color)
+{
+	if (!reserve(24))
+	{
+		return;
+	}
+	// corner i takes max on each axis whose bit is set
+	glm::vec3 corners[8];
+	for (int i = 0; i < 8; i++)
+	{
+		corners[i] = glm::vec3(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z);
+	}
+	corner_edges(corners, color);
+}
+
+void DebugDraw::sphere(const glm::vec3& center, float radius, uint32_t color)
+{
+	if (!reserve(3 * SPHERE_SEGMENTS * 2))
+	{
+		return;
+	}
+	const float step = 6.28318531f / SPHERE_SEGMENTS;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		glm::vec3 previous = center;
+		for (uint32_t i = 0; i <= SPHERE_SEGMENTS; i++)
+		{
+			const float c = std::cos(i * step) * radius;
+			const float s = std::sin(i * step) * radius;
+			glm::vec3 offset = axis == 0 ? glm::vec3(0.0f, c, s) : axis == 1 ? glm::vec3(c, 0.0f, s) : glm::vec3(c, s, 0.0f);
+			const glm::vec3 point = center + offset;
+			if (i > 0)
+			{
+				_vertices.push_back({ previous, color });
+				_vertices.push_back({ point, color });
+			}
+			previous = point;
+		}
+	}
+}
+
+void DebugDraw::frustum(const glm::mat4& inverseViewProjection, float nearDepth, float farDepth, uint32_t color)
+{
+	// the clip-space box's corners in the same order box() uses, depth along the third bit
+	glm::vec3 corners[8];
+	for (int i = 0; i < 8; i++)
+	{
+		const glm::vec4 clip(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? farDepth : nearDepth, 1.0f);
+		const glm::vec4 world = inverseViewProjection * clip;
+		corners[i] = glm::vec3(world) / world.w;
+	}
+	if (reserve(24))
+	{
+		corner_edges(corners, color);
+	}
+}
+
+void DebugDraw::corner_edges(const glm::vec3 corners[8], uint32_t color)
+{
+	// each corner to the ones differing in a single higher bit
+	for (int i = 0; i < 8; i++)
+	{
+		for (int bit = 1; bit < 8; bit <<= 1)
+		{
+			if ((i & bit) == 0)
+			{
+				_vertices.push_back({ corners[i], color });
+				_vertices.push_back({ corners[i | bit], color });
+			}
+		}
+	}
+}
+
+uint32_t DebugDraw::upload(GpuLinearAllocator& ring, GpuAllocation* allocation)
+{
+	_lastDropped = _dropped;
+	_dropped = 0;
+	uint32_t count = static_cast<uint32_t>(_vertices.size());
+	if (count > 0 && ring.allocate(count * sizeof(DebugVertex), alignof(DebugVertex), allocation))
+	{
+		memcpy(allocation->data, _vertices.data(), count * sizeof(DebugVertex));
+	}
+	else
+	{
+		_lastDropped += count;
+		count = 0;
+	}
+	// the capacity stays, so a steady batch never allocates again
+	_vertices.clear();
+	return count;
+}
+
+#endif
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vk_types.h>
+#include <GpuLinearAllocator.h>
+#include <Mesh.h>
+
+#include <cstdint>
+#include <vector>
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+
+// one end of a debug line; color is RGBA8, red in the lowest byte
+struct DebugVertex {
+	glm::vec3 position;
+	uint32_t color;
+};
+
+// position at location 0, color at location 1 read as 0..1 floats
+constexpr auto DEBUG_VERTEX_LAYOUT = vertex_layout(
+	{ vertex_binding(0, sizeof(DebugVertex)) },
+	{ VERTEX_ATTRIBUTE(DebugVertex, position, 0, 0),
+		vertex_attribute(1, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(DebugVertex, color)) });
+
+// Immediate-mode debug drawing: anything may add lines, boxes, spheres or frusta during the frame, and the
+// frame's batch goes into its GPU ring and draws as a single line list. Nothing is kept between frames.
+// Without ENABLE_DEBUG_DRAW (the CMake option of the same name) every call is an empty inline function and
+// the batch never exists, so call sites needn't be guarded.
+class DebugDraw
+{
+public:
+	// vertices a frame keeps; what is added past it is dropped, and counted
+	static constexpr uint32_t MAX_VERTICES = 1u << 15;
+
+	static constexpr uint32_t rgba(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255)
+	{
+		return uint32_t(r) | uint32_t(g) << 8 | uint32_t(b) << 16 | uint32_t(a) << 24;
+	}
+
+#ifdef ENABLE_DEBUG_DRAW
+	void line(const glm::vec3& a, const glm::vec3& b, uint32_t color);
+	// the twelve edges of an axis-aligned box
+	void box(const glm::vec3& min, const glm::vec3& max, uint32_t color);
+	// three great circles, one around each axis
+	void sphere(const glm::vec3& center, float radius, uint32_t color);
+	// the box that inverseViewProjection maps clip space into, depth between nearDepth and farDepth
+	void frustum(const glm::mat4& inverseViewProjection, float nearDepth, float farDepth, uint32_t color);
+
+	// copies the batch into ring, for a draw with allocation's buffer and offset bound as the vertex buffer,
+	// and starts the next one. Returns the vertex count, 0 when there was nothing or no room
+	uint32_t upload(GpuLinearAllocator& ring, GpuAllocation* allocation);
+
+	size_t vertex_count() const { return _vertices.size(); }
+	// vertices dropped over MAX_VERTICES in the last batch uploaded
+	uint32_t dropped_vertices() const { return _lastDropped; }
+
+private:
+	// whether count more vertices fit; counts them as dropped if not
+	bool reserve(uint32_t count);
+	// the twelve edges between corners whose indices differ in one bit
+	void corner_edges(const glm::vec3 corners[8], uint32_t color);
+
+	std::vector<DebugVertex> _vertices;
+	uint32_t _dropped{ 0 };
+	uint32_t _lastDropped{ 0 };
+#else
+	void line(const glm::vec3&, const glm::vec3&, uint32_t) {}
+	void box(const glm::vec3&, const glm::vec3&, uint32_t) {}
+	void sphere(const glm::vec3&, float, uint32_t) {}
+	void frustum(const glm::mat4&, float, float, uint32_t) {}
+	uint32_t upload(GpuLinearAllocator&, GpuAllocation*) { return 0; }
+	size_t vertex_count() const { return 0; }
+	uint32_t dropped_vertices() const { return 0; }
+#endif
+};
@@ -0,0 +1,61 @@
+#include "DebugUtils.h"
+
+void DebugUtils::init(VkInstance instance, VkDevice device)
+{
+	_device = device;
+	_setObjectName = (PFN_vkSetDebugUtilsObjectNameEXT)vkGetInstanceProcAddr(instance, "vkSetDebugUtilsObjectNameEXT");
+	_beginLabel = (PFN_vkCmdBeginDebugUtilsLabelEXT)vkGetInstanceProcAddr(instance, "vkCmdBeginDebugUtilsLabelEXT");
+	_endLabel = (PFN_vkCmdEndDebugUtilsLabelEXT)vkGetInstanceProcAddr(instance, "vkCmdEndDebugUtilsLabelEXT");
+	// all or nothing, so a label is never left open
+	if (_setObjectName == nullptr || _beginLabel == nullptr || _endLabel == nullptr)
+	{
+		_setObjectName = nullptr;
+		_beginLabel = nullptr;
+		_endLabel = nullptr;
+	}
+}
+
+void DebugUtils::set_name(VkObjectType type, uint64_t handle, const char* name) const
+{
+	VkDebugUtilsObjectNameInfoEXT nameInfo = {};
+	nameInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
+	nameInfo.pNext = nullptr;
+	nameInfo.objectType = type;
+	nameInfo.objectHandle = handle;
+	nameInfo.pObjectName = name;
+	_setObjectName(_device, &nameInfo);
+}
+
+void DebugUtils::begin_label(VkCommandBuffer cmd, const char* name) const
+{
+	if (_beginLabel == nullptr)
+	{
+		return;
+	}
+
+	// FNV-1a of the name, one byte of it per channel
+	uint32_t hash = 2166136261u;
+	for (const char* c = name; *c != '\0'; c++)
+	{
+		hash = (hash ^ static_cast<uint8_t>(*c)) * 16777619u;
+	}
+
+	VkDebugUtilsLabelEXT label = {};
+	label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+	label.pNext = nullptr;
+	label.pLabelName = name;
+	// kept off the dark end, so the labels stay readable
+	label.color[0] = 0.4f + 0.6f * ((hash & 0xff) / 255.f);
+	label.color[1] = 0.4f + 0.6f * (((hash >> 8) & 0xff) / 255.f);
+	label.color[2] = 0.4f + 0.6f * (((hash >> 16) & 0xff) / 255.f);
+	label.color[3] = 1.f;
+	_beginLabel(cmd, &label);
+}
+
+void DebugUtils::end_label(VkCommandBuffer cmd) const
+{
+	if (_endLabel != nullptr)
+	{
+		_endLabel(cmd);
+	}
+}
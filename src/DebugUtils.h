@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vk_types.h>
+
+#include <cstdint>
+
+// Object names and command buffer labels through VK_EXT_debug_utils, so RenderDoc, Nsight and the
+// validation layers show "cull" and "instances 1" instead of a bare handle. Every call is a no-op
+// until init() found the extension's functions, so callers name and label unconditionally.
+// The functions come from the instance, as the extension is an instance one; a session attaching to
+// a shared device loads its own copy of them.
+class DebugUtils
+{
+public:
+	// only with VK_EXT_debug_utils enabled on instance
+	void init(VkInstance instance, VkDevice device);
+
+	bool is_enabled() const { return _setObjectName != nullptr; }
+
+	// handle is any Vulkan handle of type; names are copied, so a temporary will do. An object's name
+	// must not be set from two threads at once
+	template<typename T>
+	void name(VkObjectType type, T handle, const char* name) const
+	{
+		if (_setObjectName != nullptr && handle != T())
+		{
+			set_name(type, (uint64_t)handle, name);
+		}
+	}
+
+	// regions of a command buffer, nestable; the color is picked from the name, so a pass keeps its
+	// color from one capture to the next
+	void begin_label(VkCommandBuffer cmd, const char* name) const;
+	void end_label(VkCommandBuffer cmd) const;
+
+private:
+	void set_name(VkObjectType type, uint64_t handle, const char* name) const;
+
+	VkDevice _device{ VK_NULL_HANDLE };
+	PFN_vkSetDebugUtilsObjectNameEXT _setObjectName{ nullptr };
+	PFN_vkCmdBeginDebugUtilsLabelEXT _beginLabel{ nullptr };
+	PFN_vkCmdEndDebugUtilsLabelEXT _endLabel{ nullptr };
+};
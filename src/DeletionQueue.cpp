@@ -0,0 +1,43 @@
+#include "DeletionQueue.h"
+
+namespace {
+	// newest first, matching the order the old function-only queue used within a type
+	template<typename Handles, typename F>
+	void destroy_all(Handles& handles, F destroy)
+	{
+		for (auto it = handles.rbegin(); it != handles.rend(); it++)
+		{
+			destroy(*it);
+		}
+		handles.clear();
+	}
+}
+
+bool DeletionQueue::empty() const
+{
+	return _deletors.empty() && _buffers.empty() && _images.empty() && _imageViews.empty() && _samplers.empty()
+		&& _framebuffers.empty() && _renderPasses.empty() && _pipelines.empty() && _pipelineLayouts.empty()
+		&& _descriptorSetLayouts.empty() && _descriptorPools.empty() && _commandPools.empty()
+		&& _fences.empty() && _semaphores.empty();
+}
+
+void DeletionQueue::flush(VkDevice device, VmaAllocator allocator)
+{
+	// subsystem teardown may still use the handles below (e.g. saving the pipeline cache)
+	destroy_all(_deletors, [](std::function<void()>& fn) { fn(); });
+
+	destroy_all(_framebuffers, [=](VkFramebuffer framebuffer) { vkDestroyFramebuffer(device, framebuffer, nullptr); });
+	destroy_all(_imageViews, [=](VkImageView view) { vkDestroyImageView(device, view, nullptr); });
+	destroy_all(_pipelines, [=](VkPipeline pipeline) { vkDestroyPipeline(device, pipeline, nullptr); });
+	destroy_all(_pipelineLayouts, [=](VkPipelineLayout layout) { vkDestroyPipelineLayout(device, layout, nullptr); });
+	// destroying a pool frees the sets allocated from it
+	destroy_all(_descriptorPools, [=](VkDescriptorPool pool) { vkDestroyDescriptorPool(device, pool, nullptr); });
+	destroy_all(_descriptorSetLayouts, [=](VkDescriptorSetLayout layout) { vkDestroyDescriptorSetLayout(device, layout, nullptr); });
+	destroy_all(_samplers, [=](VkSampler sampler) { vkDestroySampler(device, sampler, nullptr); });
+	destroy_all(_renderPasses, [=](VkRenderPass renderPass) { vkDestroyRenderPass(device, renderPass, nullptr); });
+	destroy_all(_buffers, [=](const AllocatedBuffer& buffer) { vmaDestroyBuffer(allocator, buffer._buffer, buffer._allocation); });
+	destroy_all(_images, [=](const AllocatedImage& image) { vmaDestroyImage(allocator, image._image, image._allocation); });
+	destroy_all(_commandPools, [=](VkCommandPool pool) { vkDestroyCommandPool(device, pool, nullptr); });
+	destroy_all(_fences, [=](VkFence fence) { vkDestroyFence(device, fence, nullptr); });
+	destroy_all(_semaphores, [=](VkSemaphore semaphore) { vkDestroySemaphore(device, semaphore, nullptr); });
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vk_types.h>
+#include <HeapStats.h>
+#include <vector>
+#include <functional>
+#include <utility>
+
+// Collects Vulkan objects to destroy later and destroys them in bulk on flush().
+// Handles are stored by value in one array per type, so queuing them doesn't allocate once the arrays
+// have grown; push_function() remains for teardown that isn't a single handle.
+// flush() runs the functions first (newest first), then destroys the handles type by type, users
+// before what they use: framebuffers and views before images, pipelines before layouts, and so on.
+// Objects are only destroyed on flush, so the caller is responsible for the GPU being done with them.
+class DeletionQueue
+{
+public:
+	void push_buffer(const AllocatedBuffer& buffer) { _buffers.push_back(buffer); }
+	void push_image(const AllocatedImage& image) { _images.push_back(image); }
+	void push_image_view(VkImageView view) { _imageViews.push_back(view); }
+	void push_sampler(VkSampler sampler) { _samplers.push_back(sampler); }
+	void push_framebuffer(VkFramebuffer framebuffer) { _framebuffers.push_back(framebuffer); }
+	void push_render_pass(VkRenderPass renderPass) { _renderPasses.push_back(renderPass); }
+	void push_pipeline(VkPipeline pipeline) { _pipelines.push_back(pipeline); }
+	void push_pipeline_layout(VkPipelineLayout layout) { _pipelineLayouts.push_back(layout); }
+	void push_descriptor_set_layout(VkDescriptorSetLayout layout) { _descriptorSetLayouts.push_back(layout); }
+	void push_descriptor_pool(VkDescriptorPool pool) { _descriptorPools.push_back(pool); }
+	void push_command_pool(VkCommandPool pool) { _commandPools.push_back(pool); }
+	void push_fence(VkFence fence) { _fences.push_back(fence); }
+	void push_semaphore(VkSemaphore semaphore) { _semaphores.push_back(semaphore); }
+
+	// the function's captures are converted in here, so they count as the queue's
+	template<typename F>
+	void push_function(F&& fn)
+	{
+		heap_stats::Scope heapScope(HeapTag::DeletionQueue);
+		_deletors.emplace_back(std::forward<F>(fn));
+	}
+
+	bool empty() const;
+
+	// the arrays keep their capacity, so a queue flushed every frame settles at no allocations
+	void flush(VkDevice device, VmaAllocator allocator);
+
+private:
+	// counted as the queue's in release builds too, which only count tagged containers
+	template<typename T>
+	using Handles = TaggedVector<T, HeapTag::DeletionQueue>;
+
+	Handles<std::function<void()>> _deletors;
+
+	Handles<AllocatedBuffer> _buffers;
+	Handles<AllocatedImage> _images;
+	Handles<VkImageView> _imageViews;
+	Handles<VkSampler> _samplers;
+	Handles<VkFramebuffer> _framebuffers;
+	Handles<VkRenderPass> _renderPasses;
+	Handles<VkPipeline> _pipelines;
+	Handles<VkPipelineLayout> _pipelineLayouts;
+	Handles<VkDescriptorSetLayout> _descriptorSetLayouts;
+	Handles<VkDescriptorPool> _descriptorPools;
+	Handles<VkCommandPool> _commandPools;
+	Handles<VkFence> _fences;
+	Handles<VkSemaphore> _semaphores;
+};
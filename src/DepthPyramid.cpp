@@ -0,0 +1,191 @@
+#include "DepthPyramid.h"
+
+#include "vk_initializers.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace {
+	// matches the push constants of depthReduce.comp
+	struct ReducePushConstants {
+		uint32_t sourceWidth;
+		uint32_t sourceHeight;
+		uint32_t width;
+		uint32_t height;
+		uint32_t reverseZ; // keep the smallest depth rather than the largest
+	};
+
+	// local_size of depthReduce.comp
+	constexpr uint32_t REDUCE_GROUP_SIZE = 8;
+
+	uint32_t half_rounded_up(uint32_t size)
+	{
+		return std::max(1u, (size + 1) / 2);
+	}
+}
+
+void DepthPyramid::init(VkDevice device, VmaAllocator allocator, DescriptorAllocator& descriptors, LayoutCache& layouts, VkShaderModule reduceShader, VkPipelineCache cache,
+	bool reverseZ)
+{
+	_device = device;
+	_allocator = allocator;
+	_reverseZ = reverseZ;
+
+	VkDescriptorSetLayoutBinding bindings[] = {
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0), // source level
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1), // level being built
+	};
+
+	VkDescriptorSetLayoutCreateInfo setInfo = {};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setInfo.pNext = nullptr;
+	setInfo.bindingCount = 2;
+	setInfo.pBindings = bindings;
+	VK_CHECK(vkCreateDescriptorSetLayout(_device, &setInfo, nullptr, &_setLayout));
+
+	// allocated once for the largest pyramid; resize() only rewrites them
+	for (uint32_t i = 0; i < MAX_LEVELS; i++)
+	{
+		descriptors.allocate(&_levelSets[i], _setLayout);
+	}
+
+	VkPushConstantRange pushConstant;
+	pushConstant.offset = 0;
+	pushConstant.size = sizeof(ReducePushConstants);
+	pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkPipelineLayoutCreateInfo layoutInfo = vkinit::pipeline_layout_create_info();
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &_setLayout;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushConstant;
+	VK_CHECK(vkCreatePipelineLayout(_device, &layoutInfo, nullptr, &_pipelineLayout));
+
+	if (reduceShader != VK_NULL_HANDLE)
+	{
+		VkComputePipelineCreateInfo pipelineInfo = {};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.pNext = nullptr;
+		pipelineInfo.layout = _pipelineLayout;
+		pipelineInfo.stage = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, reduceShader);
+		VK_CHECK(vkCreateComputePipelines(_device, cache, 1, &pipelineInfo, nullptr, &_pipeline));
+	}
+
+	// the shaders only texelFetch, so filtering never applies
+	VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	_sampler = layouts.sampler(samplerInfo);
+}
+
+void DepthPyramid::cleanup()
+{
+	destroy_image();
+	// the sets go with the descriptor allocator's pools, the sampler with the layout cache
+	vkDestroyPipeline(_device, _pipeline, nullptr);
+	vkDestroyPipelineLayout(_device, _pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(_device, _setLayout, nullptr);
+}
+
+void DepthPyramid::resize(VkExtent2D depthExtent, VkImageView depthView)
+{
+	destroy_image();
+	_depthExtent = depthExtent;
+
+	VkExtent3D extent = { half_rounded_up(depthExtent.width), half_rounded_up(depthExtent.height), 1 };
+	_levelCount = 1;
+	for (uint32_t size = std::max(extent.width, extent.height); size > 1 && _levelCount < MAX_LEVELS; size = half_rounded_up(size))
+	{
+		_levelCount++;
+	}
+
+	VkImageCreateInfo imageInfo = vkinit::image_create_info(VK_FORMAT_R32_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, extent);
+	imageInfo.mipLevels = _levelCount;
+
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+	allocInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	VK_CHECK(vmaCreateImage(_allocator, &imageInfo, &allocInfo, &_image._image, &_image._allocation, nullptr));
+
+	VkImageViewCreateInfo viewInfo = vkinit::imageview_create_info(VK_FORMAT_R32_SFLOAT, _image._image, VK_IMAGE_ASPECT_COLOR_BIT);
+	viewInfo.subresourceRange.levelCount = _levelCount;
+	VK_CHECK(vkCreateImageView(_device, &viewInfo, nullptr, &_view));
+
+	viewInfo.subresourceRange.levelCount = 1;
+	for (uint32_t level = 0; level < _levelCount; level++)
+	{
+		viewInfo.subresourceRange.baseMipLevel = level;
+		VK_CHECK(vkCreateImageView(_device, &viewInfo, nullptr, &_levelViews[level]));
+	}
+
+	for (uint32_t level = 0; level < _levelCount; level++)
+	{
+		VkDescriptorImageInfo sourceInfo = {};
+		sourceInfo.sampler = _sampler;
+		sourceInfo.imageView = level == 0 ? depthView : _levelViews[level - 1];
+		sourceInfo.imageLayout = level == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+		VkDescriptorImageInfo destinationInfo = {};
+		destinationInfo.imageView = _levelViews[level];
+		destinationInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		VkWriteDescriptorSet writes[] = {
+			vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, _levelSets[level], &destinationInfo, 1),
+			vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _levelSets[level], &sourceInfo, 0),
+		};
+		// level 0 stays without a source when there's no depth view to read
+		const uint32_t writeCount = sourceInfo.imageView != VK_NULL_HANDLE ? 2 : 1;
+		vkUpdateDescriptorSets(_device, writeCount, writes, 0, nullptr);
+	}
+}
+
+void DepthPyramid::build(VkCommandBuffer cmd) const
+{
+	assert(_pipeline != VK_NULL_HANDLE);
+
+	// every level is overwritten, so the old contents (and whoever read them last frame) can go
+	VkImageMemoryBarrier barrier = vkinit::image_barrier(_image._image, 0, VK_ACCESS_SHADER_WRITE_BIT,
+		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT);
+	barrier.subresourceRange.levelCount = _levelCount;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
+
+	ReducePushConstants constants = { _depthExtent.width, _depthExtent.height, 0, 0, _reverseZ ? 1u : 0u };
+	for (uint32_t level = 0; level < _levelCount; level++)
+	{
+		constants.width = half_rounded_up(constants.sourceWidth);
+		constants.height = half_rounded_up(constants.sourceHeight);
+
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout, 0, 1, &_levelSets[level], 0, nullptr);
+		vkCmdPushConstants(cmd, _pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ReducePushConstants), &constants);
+		vkCmdDispatch(cmd, (constants.width + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE, (constants.height + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE, 1);
+
+		// the next level reads this one; after the last, the cull pass does
+		VkImageMemoryBarrier levelBarrier = vkinit::image_barrier(_image._image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+			VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT);
+		levelBarrier.subresourceRange.baseMipLevel = level;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &levelBarrier);
+
+		constants.sourceWidth = constants.width;
+		constants.sourceHeight = constants.height;
+	}
+}
+
+void DepthPyramid::destroy_image()
+{
+	if (_image._image == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	for (uint32_t level = 0; level < _levelCount; level++)
+	{
+		vkDestroyImageView(_device, _levelViews[level], nullptr);
+		_levelViews[level] = VK_NULL_HANDLE;
+	}
+	vkDestroyImageView(_device, _view, nullptr);
+	vmaDestroyImage(_allocator, _image._image, _image._allocation);
+	_image = {};
+	_view = VK_NULL_HANDLE;
+	_levelCount = 0;
+}
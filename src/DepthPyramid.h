@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vk_types.h>
+#include <DescriptorAllocator.h>
+#include <LayoutCache.h>
+
+// Hierarchical depth (HiZ) for occlusion culling. Level i holds, for every 2^(i+1) square of depth
+// buffer pixels, the farthest depth in it, so a sphere whose nearest point is behind the value of
+// every texel it covers is hidden. Levels are rounded up, which keeps a texel's footprint a power
+// of two at every size; the last row or column of a level may just cover fewer pixels.
+// With reverse Z the farthest depth is the smallest, so the pyramid keeps minimums instead.
+// The image is rebuilt from scratch by build() each time it is used, so it needs no history.
+class DepthPyramid
+{
+public:
+	// enough for a 2^16 pixel wide depth buffer
+	static constexpr uint32_t MAX_LEVELS = 16;
+
+	// reduction pipeline and one descriptor set per level; the image itself comes with resize().
+	// Without a shader there is no pipeline and build() must not be called, but the image still
+	// exists, so descriptor sets pointing at it stay valid
+	void init(VkDevice device, VmaAllocator allocator, DescriptorAllocator& descriptors, LayoutCache& layouts, VkShaderModule reduceShader, VkPipelineCache cache,
+		bool reverseZ = false);
+	void cleanup();
+
+	// (re)creates the pyramid for a depth buffer of this size; nothing may be using the old one.
+	// depthView may be null when the depth buffer can't be sampled, which rules out build()
+	void resize(VkExtent2D depthExtent, VkImageView depthView);
+
+	// depth must be in SHADER_READ_ONLY_OPTIMAL and its writes made visible to compute; leaves
+	// every level in GENERAL, readable by compute shaders
+	void build(VkCommandBuffer cmd) const;
+
+	// all levels, for texelFetch; sampled in GENERAL layout
+	VkImageView view() const { return _view; }
+	VkSampler sampler() const { return _sampler; }
+	uint32_t level_count() const { return _levelCount; }
+
+private:
+	void destroy_image();
+
+	VkDevice _device{ VK_NULL_HANDLE };
+	VmaAllocator _allocator{ nullptr };
+
+	VkDescriptorSetLayout _setLayout{ VK_NULL_HANDLE };
+	VkPipelineLayout _pipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline _pipeline{ VK_NULL_HANDLE };
+	VkSampler _sampler{ VK_NULL_HANDLE };
+	// level i reads level i - 1 (the depth buffer for level 0) and writes level i
+	VkDescriptorSet _levelSets[MAX_LEVELS]{};
+
+	AllocatedImage _image{};
+	VkImageView _view{ VK_NULL_HANDLE };
+	VkImageView _levelViews[MAX_LEVELS]{};
+	uint32_t _levelCount{ 0 };
+	VkExtent2D _depthExtent{ 0, 0 };
+	bool _reverseZ{ false };
+};
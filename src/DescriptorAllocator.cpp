@@ -0,0 +1,111 @@
+#include "DescriptorAllocator.h"
+
+#include <algorithm>
+
+namespace {
+	constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+}
+
+void DescriptorAllocator::init(VkDevice device)
+{
+	_device = device;
+}
+
+void DescriptorAllocator::cleanup()
+{
+	// destroying a pool frees the sets allocated from it
+	for (VkDescriptorPool pool : _freePools)
+	{
+		vkDestroyDescriptorPool(_device, pool, nullptr);
+	}
+	for (VkDescriptorPool pool : _usedPools)
+	{
+		vkDestroyDescriptorPool(_device, pool, nullptr);
+	}
+	_freePools.clear();
+	_usedPools.clear();
+	_currentPool = VK_NULL_HANDLE;
+}
+
+void DescriptorAllocator::reset_pools()
+{
+	for (VkDescriptorPool pool : _usedPools)
+	{
+		vkResetDescriptorPool(_device, pool, 0);
+		_freePools.push_back(pool);
+	}
+	_usedPools.clear();
+	_currentPool = VK_NULL_HANDLE;
+}
+
+bool DescriptorAllocator::allocate(VkDescriptorSet* set, VkDescriptorSetLayout layout)
+{
+	if (_currentPool == VK_NULL_HANDLE)
+	{
+		_currentPool = grab_pool();
+		_usedPools.push_back(_currentPool);
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.pNext = nullptr;
+	allocInfo.descriptorPool = _currentPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &layout;
+
+	VkResult result = vkAllocateDescriptorSets(_device, &allocInfo, set);
+	if (result == VK_SUCCESS)
+	{
+		return true;
+	}
+	if (result != VK_ERROR_FRAGMENTED_POOL && result != VK_ERROR_OUT_OF_POOL_MEMORY)
+	{
+		VK_CHECK(result);
+		return false;
+	}
+
+	// the current pool is full; anything else is a real error
+	_currentPool = grab_pool();
+	_usedPools.push_back(_currentPool);
+	allocInfo.descriptorPool = _currentPool;
+
+	result = vkAllocateDescriptorSets(_device, &allocInfo, set);
+	VK_CHECK(result);
+	return result == VK_SUCCESS;
+}
+
+VkDescriptorPool DescriptorAllocator::grab_pool()
+{
+	if (!_freePools.empty())
+	{
+		VkDescriptorPool pool = _freePools.back();
+		_freePools.pop_back();
+		return pool;
+	}
+
+	VkDescriptorPool pool = create_pool(_setsPerPool);
+	_setsPerPool = std::min(_setsPerPool * 2, MAX_SETS_PER_POOL);
+	return pool;
+}
+
+VkDescriptorPool DescriptorAllocator::create_pool(uint32_t maxSets)
+{
+	std::vector<VkDescriptorPoolSize> sizes;
+	sizes.reserve(_descriptorSizes.sizes.size());
+	for (const auto& size : _descriptorSizes.sizes)
+	{
+		sizes.push_back({ size.first, static_cast<uint32_t>(size.second * maxSets) });
+	}
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.pNext = nullptr;
+	poolInfo.flags = 0;
+	poolInfo.maxSets = maxSets;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(sizes.size());
+	poolInfo.pPoolSizes = sizes.data();
+
+	VkDescriptorPool pool;
+	VK_CHECK(vkCreateDescriptorPool(_device, &poolInfo, nullptr, &pool));
+	return pool;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vk_types.h>
+#include <utility>
+#include <vector>
+
+// Hands out descriptor sets from a list of pools, creating a bigger one whenever the current pool runs out.
+// Sets are never freed one by one; reset_pools() recycles every set allocated so far.
+class DescriptorAllocator
+{
+public:
+	// descriptors of each type per set a pool is sized for
+	struct PoolSizes {
+		std::vector<std::pair<VkDescriptorType, float>> sizes = {
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.f },
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4.f },
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.f },
+		};
+	};
+
+	void init(VkDevice device);
+	void cleanup();
+
+	// returns every pool to the free list; sets allocated from them become invalid
+	void reset_pools();
+
+	// retries once in a fresh pool when the current one is exhausted or fragmented
+	bool allocate(VkDescriptorSet* set, VkDescriptorSetLayout layout);
+
+private:
+	VkDescriptorPool grab_pool();
+	VkDescriptorPool create_pool(uint32_t maxSets);
+
+	VkDevice _device{ VK_NULL_HANDLE };
+	PoolSizes _descriptorSizes;
+	VkDescriptorPool _currentPool{ VK_NULL_HANDLE };
+	std::vector<VkDescriptorPool> _usedPools;
+	std::vector<VkDescriptorPool> _freePools;
+	// sets per newly created pool; doubles each time, so a long-running allocator needs few pools
+	uint32_t _setsPerPool{ 64 };
+};
@@ -0,0 +1,111 @@
+#include "DescriptorSetCache.h"
+
+#include <vk_initializers.h>
+
+namespace {
+	// sets a slot keeps before it starts over; far more than the passes' combinations of views, so only
+	// contents that never repeat (a buffer offset that changes every frame) get there
+	constexpr size_t MAX_SETS_PER_SLOT = 1024;
+
+	bool is_image(VkDescriptorType type)
+	{
+		return type == VK_DESCRIPTOR_TYPE_SAMPLER || type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER || type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE
+			|| type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE || type == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+	}
+}
+
+size_t DescriptorSetCache::KeyHash::operator()(const Key& key) const
+{
+	// FNV-1a over the words
+	uint64_t hash = 14695981039346656037ull;
+	for (uint64_t word : key)
+	{
+		hash ^= word;
+		hash *= 1099511628211ull;
+	}
+	return static_cast<size_t>(hash);
+}
+
+void DescriptorSetCache::init(VkDevice device, uint32_t frameCount)
+{
+	_device = device;
+	_slots.resize(frameCount);
+	for (Slot& slot : _slots)
+	{
+		slot.descriptors.init(device);
+	}
+}
+
+void DescriptorSetCache::cleanup()
+{
+	// the sets go with the pools
+	for (Slot& slot : _slots)
+	{
+		slot.descriptors.cleanup();
+	}
+	_slots.clear();
+}
+
+void DescriptorSetCache::begin_frame(uint32_t frame)
+{
+	Slot& slot = _slots[frame];
+	if (slot.generation == _generation && slot.sets.size() <= MAX_SETS_PER_SLOT)
+	{
+		return;
+	}
+	slot.descriptors.reset_pools();
+	slot.sets.clear();
+	slot.generation = _generation;
+}
+
+VkDescriptorSet DescriptorSetCache::get(uint32_t frame, VkDescriptorSetLayout layout, const DescriptorWrite* writes, uint32_t count)
+{
+	_lookups++;
+	Slot& slot = _slots[frame];
+
+	Key key;
+	key.reserve(1 + size_t(count) * 4);
+	key.push_back(reinterpret_cast<uint64_t>(layout));
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const DescriptorWrite& write = writes[i];
+		key.push_back((uint64_t(write.binding) << 32) | uint64_t(write.type));
+		if (is_image(write.type))
+		{
+			key.push_back(reinterpret_cast<uint64_t>(write.image.sampler));
+			key.push_back(reinterpret_cast<uint64_t>(write.image.imageView));
+			key.push_back(uint64_t(write.image.imageLayout));
+		}
+		else
+		{
+			key.push_back(reinterpret_cast<uint64_t>(write.buffer.buffer));
+			key.push_back(write.buffer.offset);
+			key.push_back(write.buffer.range);
+		}
+	}
+
+	auto cached = slot.sets.find(key);
+	if (cached != slot.sets.end())
+	{
+		return cached->second;
+	}
+
+	VkDescriptorSet set;
+	if (!slot.descriptors.allocate(&set, layout))
+	{
+		return VK_NULL_HANDLE;
+	}
+	// the initializers take the infos by non-const pointer
+	std::vector<DescriptorWrite> infos(writes, writes + count);
+	std::vector<VkWriteDescriptorSet> setWrites(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		DescriptorWrite& write = infos[i];
+		setWrites[i] = is_image(write.type) ? vkinit::write_descriptor_image(write.type, set, &write.image, write.binding)
+											: vkinit::write_descriptor_buffer(write.type, set, &write.buffer, write.binding);
+	}
+	vkUpdateDescriptorSets(_device, count, setWrites.data(), 0, nullptr);
+	_writes++;
+	slot.sets.emplace(std::move(key), set);
+	return set;
+}
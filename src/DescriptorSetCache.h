@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vk_types.h>
+#include <DescriptorAllocator.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// one descriptor of a set; image for image types, buffer for buffer types
+struct DescriptorWrite {
+	uint32_t binding;
+	VkDescriptorType type;
+	VkDescriptorImageInfo image;
+	VkDescriptorBufferInfo buffer;
+
+	static DescriptorWrite image_write(uint32_t binding, VkDescriptorType type, VkSampler sampler, VkImageView view, VkImageLayout layout)
+	{
+		return { binding, type, { sampler, view, layout }, {} };
+	}
+	static DescriptorWrite buffer_write(uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+	{
+		return { binding, type, {}, { buffer, offset, range } };
+	}
+};
+
+// Descriptor sets by contents, for passes that would otherwise rewrite a set of the frame slot they record
+// every frame: get() hands back the set the slot already holds with the same layout and descriptors, and
+// allocates and writes one only for contents it hasn't seen. The render graph's views repeat from frame to
+// frame, so after the first frames every lookup hits and nothing is written. Each slot allocates from a
+// pool of its own, so a set is never touched while another frame in flight reads it.
+// The sets point at views and buffers by handle: invalidate() whenever any of them is destroyed, from where
+// every slot starts over at its next begin_frame().
+class DescriptorSetCache
+{
+public:
+	void init(VkDevice device, uint32_t frameCount);
+	void cleanup();
+
+	// once the slot's last frame finished; recycles its sets if they may be stale or grew past a bound
+	void begin_frame(uint32_t frame);
+	void invalidate() { _generation++; }
+
+	VkDescriptorSet get(uint32_t frame, VkDescriptorSetLayout layout, const DescriptorWrite* writes, uint32_t count);
+
+	// of the lookups so far, for logging
+	uint32_t lookups() const { return _lookups; }
+	uint32_t writes() const { return _writes; }
+
+private:
+	// the layout and the descriptors flattened to words; hashed whole, compared whole on collisions
+	using Key = std::vector<uint64_t>;
+	struct KeyHash {
+		size_t operator()(const Key& key) const;
+	};
+
+	struct Slot {
+		DescriptorAllocator descriptors;
+		std::unordered_map<Key, VkDescriptorSet, KeyHash> sets;
+		uint32_t generation{ 0 };
+	};
+
+	VkDevice _device{ VK_NULL_HANDLE };
+	std::vector<Slot> _slots;
+	uint32_t _generation{ 0 };
+	uint32_t _lookups{ 0 };
+	uint32_t _writes{ 0 };
+};
@@ -0,0 +1,78 @@
+#include "DeviceCapabilities.h"
+
+#include "Log.h"
+
+DeviceTier device_tier(const DeviceCapabilities& capabilities)
+{
+	if (!capabilities.drawIndirectFirstInstance || !capabilities.multiDrawIndirect)
+	{
+		return DeviceTier::Baseline;
+	}
+	if (!capabilities.drawIndirectCount || !capabilities.bindless || !capabilities.timelineSemaphores)
+	{
+		return DeviceTier::Indirect;
+	}
+	return DeviceTier::GpuDriven;
+}
+
+const char* device_tier_name(DeviceTier tier)
+{
+	switch (tier)
+	{
+	case DeviceTier::Baseline: return "baseline";
+	case DeviceTier::Indirect: return "indirect";
+	case DeviceTier::GpuDriven: return "GPU-driven";
+	default: return "unknown";
+	}
+}
+
+RenderPath fastest_render_path(const DeviceCapabilities& capabilities)
+{
+	return device_tier(capabilities) == DeviceTier::Baseline ? RenderPath::Cpu : RenderPath::Indirect;
+}
+
+const char* render_path_name(RenderPath path)
+{
+	switch (path)
+	{
+	case RenderPath::Auto: return "auto";
+	case RenderPath::Cpu: return "cpu";
+	case RenderPath::Indirect: return "indirect";
+	default: return "unknown";
+	}
+}
+
+void log_capabilities(const DeviceCapabilities& capabilities)
+{
+	logging::Line line(logging::Level::Info);
+	line.stream() << "Device capabilities:";
+	const char* separator = " ";
+	auto add = [&](bool supported, const char* name) {
+		if (supported)
+		{
+			line.stream() << separator << name;
+			separator = ", ";
+		}
+	};
+	add(capabilities.multiDrawIndirect, "multi-draw indirect");
+	add(capabilities.drawIndirectFirstInstance, "indirect first instance");
+	add(capabilities.drawIndirectCount, "draw indirect count");
+	add(capabilities.bindless, "bindless textures");
+	add(capabilities.meshShading, "mesh shaders");
+	add(capabilities.dynamicRendering, "dynamic rendering");
+	add(capabilities.timelineSemaphores, "timeline semaphores");
+	add(capabilities.storage16Bit, "16-bit storage");
+	add(capabilities.float16, "half-precision arithmetic");
+	if (capabilities.subgroupSize > 0)
+	{
+		line.stream() << separator << "subgroups of " << capabilities.subgroupSize;
+		separator = ", ";
+		add(capabilities.subgroups(VK_SUBGROUP_FEATURE_ARITHMETIC_BIT | VK_SUBGROUP_FEATURE_BALLOT_BIT, VK_SHADER_STAGE_COMPUTE_BIT),
+			"compute arithmetic and ballots");
+		add(capabilities.subgroups(VK_SUBGROUP_FEATURE_QUAD_BIT, VK_SHADER_STAGE_FRAGMENT_BIT), "fragment quads");
+	}
+	if (*separator == ' ')
+	{
+		line.stream() << " nothing optional";
+	}
+}
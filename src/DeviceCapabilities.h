@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vk_types.h>
+
+#include <cstdint>
+
+// What the chosen device supports of the optional features the renderer's paths depend on, probed once
+// in create_device_context and shared with the sessions attaching to it. Supported, not enabled: a
+// session's own settings decide what it turns on, and the *Supported and _use* flags of the engine say what it did.
+struct DeviceCapabilities {
+	bool multiDrawIndirect{ false };
+	bool drawIndirectFirstInstance{ false };
+	bool drawIndirectCount{ false };
+	bool bindless{ false }; // the descriptor indexing bits the bindless texture array needs
+	bool meshShading{ false }; // task and mesh shaders
+	bool dynamicRendering{ false };
+	bool timelineSemaphores{ false };
+	bool storage16Bit{ false }; // 16-bit types in storage and uniform buffers
+	bool float16{ false }; // float16_t arithmetic in shaders
+	// of VkPhysicalDeviceSubgroupProperties
+	uint32_t subgroupSize{ 0 };
+	VkSubgroupFeatureFlags subgroupOperations{ 0 };
+	VkShaderStageFlags subgroupStages{ 0 };
+
+	bool subgroups(VkSubgroupFeatureFlags operations, VkShaderStageFlags stages) const
+	{
+		return (subgroupOperations & operations) == operations && (subgroupStages & stages) == stages;
+	}
+};
+
+// how much of the GPU-driven renderer a device runs, from what it supports
+enum class DeviceTier : uint32_t {
+	Baseline, // Vulkan 1.1 alone: the render list is culled and recorded on the CPU
+	Indirect, // drawIndirectFirstInstance and multiDrawIndirect: culled on the GPU into indirect draws
+	GpuDriven, // and draw indirect count, bindless and timeline semaphores: compacted draws, async culling
+};
+DeviceTier device_tier(const DeviceCapabilities& capabilities);
+const char* device_tier_name(DeviceTier tier);
+
+// how the render list is drawn; M switches between the two at runtime
+enum class RenderPath : uint32_t {
+	Auto, // fastest_render_path's
+	Cpu, // frustum culled on the CPU, recorded on several threads, mesh shaders for full-detail meshes
+	Indirect, // culled on the GPU into indirect draws
+};
+// indirect from the Indirect tier up; without multiDrawIndirect every record takes a call of its own, which
+// costs the CPU what the direct draws do and adds the cull dispatch
+RenderPath fastest_render_path(const DeviceCapabilities& capabilities);
+const char* render_path_name(RenderPath path);
+
+// one line of everything above that the device has
+void log_capabilities(const DeviceCapabilities& capabilities);
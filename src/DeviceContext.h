@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vk_types.h>
+#include <DeviceCapabilities.h>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// Everything the sessions rendering on one GPU share: the instance, the device and its queues, the allocator
+// and the pipeline cache. The first VulkanEngine to init() without one creates it; an engine handed another's
+// context before its init() skips instance and device creation, and its pipelines compile against the cache
+// the sessions before it already filled. Each session keeps its own swapchain or offscreen targets, frames,
+// meshes and pipelines. The last session to clean up destroys the context.
+struct DeviceContext {
+	VkInstance instance{ VK_NULL_HANDLE };
+	VkDebugUtilsMessengerEXT debugMessenger{ VK_NULL_HANDLE };
+	VkPhysicalDevice physicalDevice{ VK_NULL_HANDLE };
+	VkDevice device{ VK_NULL_HANDLE };
+	VmaAllocator allocator{ nullptr };
+	// made without surface extensions, so every session on it renders headless
+	bool headless{ false };
+
+	VkQueue graphicsQueue{ VK_NULL_HANDLE };
+	uint32_t graphicsQueueFamily{ 0 };
+	uint32_t graphicsQueueTimestampBits{ 0 };
+	VkQueue transferQueue{ VK_NULL_HANDLE };
+	uint32_t transferQueueFamily{ 0 };
+	VkQueue computeQueue{ VK_NULL_HANDLE }; // null without a compute family apart from graphics
+	uint32_t computeQueueFamily{ VK_QUEUE_FAMILY_IGNORED };
+
+	// created by the first session's init_pipeline_cache(), written back to pipelineCachePath by the last cleanup()
+	VkPipelineCache pipelineCache{ VK_NULL_HANDLE };
+	std::string pipelineCachePath;
+
+	// what the device was created with; a session attaching takes these over in place of its own settings,
+	// since pipelines and passes built for anything else wouldn't run on it
+	VkPhysicalDeviceFeatures enabledFeatures{};
+	bool drawIndirectCount{ false };
+	bool timelineSemaphores{ false };
+	bool memoryBudget{ false };
+	bool pageableMemory{ false };
+	bool bindless{ false };
+	bool meshShading{ false };
+	bool dynamicRendering{ false };
+	bool synchronization2{ false };
+	bool presentWait{ false };
+	bool displayTiming{ false };
+	bool bufferMarker{ false };
+	bool debugUtils{ false };
+	bool extendedDynamicState{ false };
+	bool pipelineLibraries{ false };
+	bool videoEncode{ false };
+	bool shadingRate{ false };
+	bool shadingRateAttachment{ false };
+	bool rayQuery{ false }; // and buffer device addresses, which the allocator was created for
+	bool executableProperties{ false };
+	bool halfPrecision{ false };
+	DeviceCapabilities capabilities; // supported, for the render path each session picks
+
+	// the queues are externally synchronized and every session submits to them from its own thread, so each
+	// vkQueueSubmit, vkQueuePresentKHR and vkDeviceWaitIdle holds this
+	std::mutex queueMutex;
+
+	std::mutex lifetimeMutex;
+	uint32_t sessions{ 0 }; // engines initialized on it and not cleaned up yet, guarded by lifetimeMutex
+};
@@ -0,0 +1,239 @@
+#include "DisplayOutput.h"
+
+#include "Log.h"
+
+#include <VkBootstrap.h>
+#include <algorithm>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <vulkan/vulkan_win32.h>
+#include <SDL_syswm.h>
+#endif
+
+bool DirectDisplay::create_surface(VkInstance instance, uint32_t index, VkSurfaceKHR* surface)
+{
+	uint32_t gpuCount = 0;
+	vkEnumeratePhysicalDevices(instance, &gpuCount, nullptr);
+	std::vector<VkPhysicalDevice> gpus(gpuCount);
+	vkEnumeratePhysicalDevices(instance, &gpuCount, gpus.data());
+
+	// numbered across every GPU, in the order the loader lists them
+	uint32_t seen = 0;
+	for (VkPhysicalDevice gpu : gpus)
+	{
+		uint32_t displayCount = 0;
+		vkGetPhysicalDeviceDisplayPropertiesKHR(gpu, &displayCount, nullptr);
+		if (index >= seen + displayCount)
+		{
+			seen += displayCount;
+			continue;
+		}
+		std::vector<VkDisplayPropertiesKHR> displays(displayCount);
+		vkGetPhysicalDeviceDisplayPropertiesKHR(gpu, &displayCount, displays.data());
+		const VkDisplayPropertiesKHR& display = displays[index - seen];
+		_name = display.displayName != nullptr ? display.displayName : "display " + std::to_string(index);
+
+		// the fastest refresh at the native resolution; a mode at another size would have the panel scale
+		uint32_t modeCount = 0;
+		vkGetDisplayModePropertiesKHR(gpu, display.display, &modeCount, nullptr);
+		std::vector<VkDisplayModePropertiesKHR> modes(modeCount);
+		vkGetDisplayModePropertiesKHR(gpu, display.display, &modeCount, modes.data());
+		auto native = [&](const VkDisplayModePropertiesKHR& mode) {
+			return mode.parameters.visibleRegion.width == display.physicalResolution.width
+				&& mode.parameters.visibleRegion.height == display.physicalResolution.height;
+		};
+		const VkDisplayModePropertiesKHR* chosen = nullptr;
+		for (const VkDisplayModePropertiesKHR& mode : modes)
+		{
+			if (chosen == nullptr || native(mode) > native(*chosen)
+				|| (native(mode) == native(*chosen) && mode.parameters.refreshRate > chosen->parameters.refreshRate))
+			{
+				chosen = &mode;
+			}
+		}
+		if (chosen == nullptr)
+		{
+			LOG_ERROR(_name << " has no display modes");
+			return false;
+		}
+
+		// the first plane that can show this display and isn't showing another one
+		uint32_t planeCount = 0;
+		vkGetPhysicalDeviceDisplayPlanePropertiesKHR(gpu, &planeCount, nullptr);
+		std::vector<VkDisplayPlanePropertiesKHR> planes(planeCount);
+		vkGetPhysicalDeviceDisplayPlanePropertiesKHR(gpu, &planeCount, planes.data());
+		for (uint32_t plane = 0; plane < planeCount; plane++)
+		{
+			if (planes[plane].currentDisplay != VK_NULL_HANDLE && planes[plane].currentDisplay != display.display)
+			{
+				continue;
+			}
+			uint32_t supportedCount = 0;
+			vkGetDisplayPlaneSupportedDisplaysKHR(gpu, plane, &supportedCount, nullptr);
+			std::vector<VkDisplayKHR> supported(supportedCount);
+			vkGetDisplayPlaneSupportedDisplaysKHR(gpu, plane, &supportedCount, supported.data());
+			if (std::find(supported.begin(), supported.end(), display.display) == supported.end())
+			{
+				continue;
+			}
+
+			VkDisplayPlaneCapabilitiesKHR capabilities;
+			vkGetDisplayPlaneCapabilitiesKHR(gpu, chosen->displayMode, plane, &capabilities);
+			// opaque if the plane can be, since nothing is under it to blend with
+			VkDisplayPlaneAlphaFlagBitsKHR alpha = VK_DISPLAY_PLANE_ALPHA_OPAQUE_BIT_KHR;
+			for (VkDisplayPlaneAlphaFlagBitsKHR candidate : { VK_DISPLAY_PLANE_ALPHA_OPAQUE_BIT_KHR, VK_DISPLAY_PLANE_ALPHA_GLOBAL_BIT_KHR,
+				VK_DISPLAY_PLANE_ALPHA_PER_PIXEL_BIT_KHR, VK_DISPLAY_PLANE_ALPHA_PER_PIXEL_PREMULTIPLIED_BIT_KHR })
+			{
+				if (capabilities.supportedAlpha & candidate)
+				{
+					alpha = candidate;
+					break;
+				}
+			}
+
+			VkDisplaySurfaceCreateInfoKHR info = {};
+			info.sType = VK_STRUCTURE_TYPE_DISPLAY_SURFACE_CREATE_INFO_KHR;
+			info.pNext = nullptr;
+			info.displayMode = chosen->displayMode;
+			info.planeIndex = plane;
+			info.planeStackIndex = planes[plane].currentStackIndex;
+			info.transform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+			info.globalAlpha = 1.0f;
+			info.alphaMode = alpha;
+			info.imageExtent = chosen->parameters.visibleRegion;
+			const VkResult result = vkCreateDisplayPlaneSurfaceKHR(instance, &info, nullptr, surface);
+			if (result != VK_SUCCESS)
+			{
+				LOG_ERROR("Failed to create a surface on " << _name << " (VkResult " << result << ")");
+				return false;
+			}
+			_physicalDevice = gpu;
+			_extent = chosen->parameters.visibleRegion;
+			_refreshMillihertz = chosen->parameters.refreshRate;
+			LOG_INFO("Presenting straight to " << _name << ", " << _extent.width << "x" << _extent.height << " at "
+				<< _refreshMillihertz / 1000.0f << " Hz, plane " << plane);
+			return true;
+		}
+		LOG_ERROR("No display plane can show " << _name);
+		return false;
+	}
+
+	LOG_ERROR("No display " << index << ": the GPUs have " << seen << " between them, or another process holds them");
+	return false;
+}
+
+#ifdef _WIN32
+
+struct FullScreenExclusive::Platform {
+	PFN_vkAcquireFullScreenExclusiveModeEXT acquireMode{ nullptr };
+	PFN_vkReleaseFullScreenExclusiveModeEXT releaseMode{ nullptr };
+	VkSurfaceFullScreenExclusiveInfoEXT exclusiveInfo{};
+	VkSurfaceFullScreenExclusiveWin32InfoEXT win32Info{};
+};
+
+FullScreenExclusive::FullScreenExclusive() : _platform(std::make_unique<Platform>()) {}
+FullScreenExclusive::~FullScreenExclusive() = default;
+
+bool FullScreenExclusive::compiled()
+{
+	return true;
+}
+
+const char* FullScreenExclusive::instance_extension()
+{
+	return VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME;
+}
+
+const char* FullScreenExclusive::device_extension()
+{
+	return VK_EXT_FULL_SCREEN_EXCLUSIVE_EXTENSION_NAME;
+}
+
+bool FullScreenExclusive::init(VkDevice device, SDL_Window* window)
+{
+	_device = device;
+	_platform->acquireMode = (PFN_vkAcquireFullScreenExclusiveModeEXT)vkGetDeviceProcAddr(device, "vkAcquireFullScreenExclusiveModeEXT");
+	_platform->releaseMode = (PFN_vkReleaseFullScreenExclusiveModeEXT)vkGetDeviceProcAddr(device, "vkReleaseFullScreenExclusiveModeEXT");
+	SDL_SysWMinfo wmInfo;
+	SDL_VERSION(&wmInfo.version);
+	if (_platform->acquireMode == nullptr || _platform->releaseMode == nullptr || !SDL_GetWindowWMInfo(window, &wmInfo))
+	{
+		return false;
+	}
+	// application controlled, so exclusivity is taken when the swapchain is ready for it rather than when the driver guesses
+	_platform->win32Info.sType = VK_STRUCTURE_TYPE_SURFACE_FULL_SCREEN_EXCLUSIVE_WIN32_INFO_EXT;
+	_platform->win32Info.hmonitor = MonitorFromWindow(wmInfo.info.win.window, MONITOR_DEFAULTTOPRIMARY);
+	_platform->exclusiveInfo.sType = VK_STRUCTURE_TYPE_SURFACE_FULL_SCREEN_EXCLUSIVE_INFO_EXT;
+	_platform->exclusiveInfo.fullScreenExclusive = VK_FULL_SCREEN_EXCLUSIVE_APPLICATION_CONTROLLED_EXT;
+	_enabled = true;
+	return true;
+}
+
+void FullScreenExclusive::request(vkb::SwapchainBuilder& builder)
+{
+	if (_enabled)
+	{
+		builder.add_pNext(&_platform->exclusiveInfo);
+		builder.add_pNext(&_platform->win32Info);
+	}
+}
+
+void FullScreenExclusive::acquire(VkSwapchainKHR swapchain)
+{
+	if (!_enabled)
+	{
+		return;
+	}
+	const VkResult result = _platform->acquireMode(_device, swapchain);
+	if (result != VK_SUCCESS)
+	{
+		LOG_WARN("Exclusive fullscreen was refused (VkResult " << result << "), presenting through the compositor");
+	}
+	_acquired = result == VK_SUCCESS;
+}
+
+void FullScreenExclusive::release(VkSwapchainKHR swapchain)
+{
+	if (_acquired)
+	{
+		_platform->releaseMode(_device, swapchain);
+		_acquired = false;
+	}
+}
+
+#else
+
+struct FullScreenExclusive::Platform {};
+
+FullScreenExclusive::FullScreenExclusive() = default;
+FullScreenExclusive::~FullScreenExclusive() = default;
+
+bool FullScreenExclusive::compiled()
+{
+	return false;
+}
+
+const char* FullScreenExclusive::instance_extension()
+{
+	return nullptr;
+}
+
+const char* FullScreenExclusive::device_extension()
+{
+	return nullptr;
+}
+
+bool FullScreenExclusive::init(VkDevice, SDL_Window*)
+{
+	return false;
+}
+
+void FullScreenExclusive::request(vkb::SwapchainBuilder&) {}
+void FullScreenExclusive::acquire(VkSwapchainKHR) {}
+void FullScreenExclusive::release(VkSwapchainKHR) {}
+
+#endif
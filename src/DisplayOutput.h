@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vk_types.h>
+
+#include <memory>
+#include <string>
+
+struct SDL_Window;
+namespace vkb {
+	class SwapchainBuilder;
+}
+
+// A display driven straight through VK_KHR_display, with no window system or compositor in between: the
+// surface is one of the display's planes, at the display's native resolution and the fastest mode it has at
+// it. Meant for kiosks run from a console with no X or Wayland session holding the display; there is no SDL
+// window, so no input either.
+class DirectDisplay
+{
+public:
+	// the surface of the index'th display across the instance's GPUs, which needs VK_KHR_display enabled on it;
+	// false (and logged) when there is no such display or no plane can show it
+	bool create_surface(VkInstance instance, uint32_t index, VkSurfaceKHR* surface);
+
+	VkPhysicalDevice physical_device() const { return _physicalDevice; }
+	VkExtent2D extent() const { return _extent; }
+	uint32_t refresh_millihertz() const { return _refreshMillihertz; }
+	const std::string& name() const { return _name; }
+
+private:
+	VkPhysicalDevice _physicalDevice{ VK_NULL_HANDLE };
+	VkExtent2D _extent{};
+	uint32_t _refreshMillihertz{ 0 };
+	std::string _name;
+};
+
+// VK_EXT_full_screen_exclusive on Windows: the swapchain of a fullscreen window asks for the monitor to itself
+// and takes it once built, so DWM neither composes nor paces its presents. Exclusivity is lost on alt-tab and the
+// like, which presents and acquires report as VK_ERROR_FULL_SCREEN_EXCLUSIVE_MODE_LOST_EXT; the swapchain is
+// rebuilt then and takes it again. A build without the Win32 platform has none of it and every call does nothing.
+class FullScreenExclusive
+{
+public:
+	FullScreenExclusive();
+	~FullScreenExclusive();
+
+	// whether this build can ask for it at all
+	static bool compiled();
+	// the instance extension it depends on, for the instance builder to enable
+	static const char* instance_extension();
+	static const char* device_extension();
+
+	// window's monitor and the device's functions; false when the device lacks the extension
+	bool init(VkDevice device, SDL_Window* window);
+	bool enabled() const { return _enabled; }
+
+	// chains the request for exclusivity into a swapchain about to be built
+	void request(vkb::SwapchainBuilder& builder);
+	// after the swapchain is built; a failure is a warning, and presenting goes through the compositor
+	void acquire(VkSwapchainKHR swapchain);
+	// before the swapchain is destroyed
+	void release(VkSwapchainKHR swapchain);
+
+private:
+	VkDevice _device{ VK_NULL_HANDLE };
+	bool _enabled{ false };
+	bool _acquired{ false };
+	// the monitor, functions and swapchain pNext structs, which only the Win32 headers declare
+	struct Platform;
+	std::unique_ptr<Platform> _platform;
+};
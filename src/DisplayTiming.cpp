@@ -0,0 +1,200 @@
+#include "DisplayTiming.h"
+
+#include <algorithm>
+#include <cmath>
+
+const char* DisplayTiming::device_extension()
+{
+	return VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME;
+}
+
+bool DisplayTiming::init(VkDevice device)
+{
+	_device = device;
+	_getRefreshCycle = (PFN_vkGetRefreshCycleDurationGOOGLE)vkGetDeviceProcAddr(device, "vkGetRefreshCycleDurationGOOGLE");
+	_getPastTiming = (PFN_vkGetPastPresentationTimingGOOGLE)vkGetDeviceProcAddr(device, "vkGetPastPresentationTimingGOOGLE");
+	if (_getRefreshCycle == nullptr || _getPastTiming == nullptr)
+	{
+		_getRefreshCycle = nullptr;
+		_getPastTiming = nullptr;
+		return false;
+	}
+	return true;
+}
+
+void DisplayTiming::reset(VkSwapchainKHR swapchain)
+{
+	_swapchain = swapchain;
+	VkRefreshCycleDurationGOOGLE refresh = {};
+	_refreshNs = _getRefreshCycle(_device, swapchain, &refresh) == VK_SUCCESS ? refresh.refreshDuration : 0;
+
+	std::fill(std::begin(_scheduled), std::end(_scheduled), Scheduled{});
+	_presents.clear();
+	_lastId = 0;
+	_lastActual = 0;
+	_lastIntervalMs = -1.0;
+	_recentCount = 0;
+	_cadence = 1;
+	_startDelayNs = 0;
+}
+
+uint64_t DisplayTiming::desired_time(uint32_t id, bool schedule)
+{
+	Scheduled& entry = _scheduled[id % HISTORY];
+	entry.id = id;
+	entry.cycles = 1;
+	entry.startDelayNs = 0;
+	if (!schedule || _lastId == 0 || _refreshNs == 0 || id <= _lastId)
+	{
+		return 0;
+	}
+	entry.cycles = _cadence;
+	entry.startDelayNs = _startDelayNs;
+	// the presents in flight since the last one reported each take the cadence's cycles. Half a cycle early,
+	// since an image goes up at the first vblank at or after its time, so that one is the vblank aimed for
+	// however far the reported times drift from it
+	const uint64_t target = _lastActual + uint64_t(id - _lastId) * _cadence * _refreshNs;
+	return target - _refreshNs / 2;
+}
+
+void DisplayTiming::chain(VkPresentInfoKHR& presentInfo, VkPresentTimesInfoGOOGLE& times, const VkPresentTimeGOOGLE& time)
+{
+	times.sType = VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE;
+	times.pNext = presentInfo.pNext;
+	times.swapchainCount = 1;
+	times.pTimes = &time;
+	presentInfo.pNext = &times;
+}
+
+const DisplayTiming::Scheduled* DisplayTiming::scheduled(uint32_t id) const
+{
+	const Scheduled& entry = _scheduled[id % HISTORY];
+	return entry.id == id ? &entry : nullptr;
+}
+
+void DisplayTiming::poll()
+{
+	_presents.clear();
+	if (!enabled() || _swapchain == VK_NULL_HANDLE)
+	{
+		return;
+	}
+	uint32_t count = 0;
+	if (_getPastTiming(_device, _swapchain, &count, nullptr) != VK_SUCCESS || count == 0)
+	{
+		return;
+	}
+	_timings.resize(count);
+	const VkResult result = _getPastTiming(_device, _swapchain, &count, _timings.data());
+	if (result != VK_SUCCESS && result != VK_INCOMPLETE)
+	{
+		return;
+	}
+	_timings.resize(count);
+	std::sort(_timings.begin(), _timings.end(), [](const VkPastPresentationTimingGOOGLE& a, const VkPastPresentationTimingGOOGLE& b) {
+		return a.presentID < b.presentID;
+	});
+
+	bool missed = false;
+	for (const VkPastPresentationTimingGOOGLE& timing : _timings)
+	{
+		if (_lastId != 0 && (timing.presentID <= _lastId || timing.actualPresentTime <= _lastActual))
+		{
+			continue;
+		}
+		const Scheduled* entry = scheduled(timing.presentID);
+		const uint32_t cycles = entry != nullptr ? entry->cycles : 1;
+		const uint64_t startDelay = entry != nullptr ? entry->startDelayNs : 0;
+
+		Present present = {};
+		present.id = timing.presentID;
+		present.intervalMs = -1.0;
+		present.jitterMs = -1.0;
+		present.marginMs = timing.presentMargin / 1e6;
+
+		Recent recent = {};
+		recent.cycles = 1;
+		// the margin is against the earliest vblank it could have made; a scheduled present waited past that as well,
+		// and the frame had already slept
+		recent.headroomNs = timing.presentMargin + (timing.actualPresentTime - std::min(timing.earliestPresentTime, timing.actualPresentTime))
+			+ startDelay;
+		if (_lastId != 0 && _refreshNs != 0)
+		{
+			const uint64_t interval = timing.actualPresentTime - _lastActual;
+			present.intervalMs = interval / 1e6;
+			// presents the engine replaced unshown aren't reported, so only the cycles this one stayed up count
+			const uint64_t shown = std::max<uint64_t>((interval + _refreshNs / 2) / _refreshNs, 1);
+			present.missedVblanks = shown > cycles ? static_cast<uint32_t>(shown - cycles) : 0;
+			if (_lastIntervalMs >= 0.0)
+			{
+				present.jitterMs = std::abs(present.intervalMs - _lastIntervalMs);
+			}
+			_lastIntervalMs = present.intervalMs;
+
+			// when it would have been ready had the frame started right away, in cycles after the last present
+			const uint64_t held = timing.presentMargin + startDelay;
+			const uint64_t ready = timing.earliestPresentTime > held ? timing.earliestPresentTime - held : 0;
+			if (ready > _lastActual)
+			{
+				recent.cycles = static_cast<uint32_t>(std::min<uint64_t>((ready - _lastActual + _refreshNs - 1) / _refreshNs, MAX_CADENCE));
+			}
+		}
+		_recent[_recentCount % WINDOW] = recent;
+		_recentCount++;
+		_lastId = timing.presentID;
+		_lastActual = timing.actualPresentTime;
+
+		missed = missed || present.missedVblanks > 0;
+		_totals.presents++;
+		_totals.missedVblanks += present.missedVblanks;
+		if (present.jitterMs >= 0.0)
+		{
+			_totals.jitterMs += present.jitterMs;
+			_totals.jitterSamples++;
+		}
+		_presents.push_back(present);
+	}
+	if (!_presents.empty())
+	{
+		update_schedule(missed);
+	}
+}
+
+void DisplayTiming::update_schedule(bool missed)
+{
+	// the slowest recent frame sets the cadence, so one that needs another cycle raises it straight away and it
+	// only comes down once a whole window of frames has been quicker
+	const uint32_t count = std::min(_recentCount, WINDOW);
+	uint32_t cadence = 1;
+	uint64_t headroom = UINT64_MAX;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		cadence = std::max(cadence, _recent[i].cycles);
+		headroom = std::min(headroom, _recent[i].headroomNs);
+	}
+	_cadence = cadence;
+
+	// enough to ride out a frame a little slower than the ones the headroom was taken from, and the sleep's overshoot
+	const uint64_t slack = std::max<uint64_t>(1000000, _refreshNs / 8);
+	const uint64_t target = headroom > slack ? headroom - slack : 0;
+	if (missed)
+	{
+		_startDelayNs = 0;
+	}
+	else if (target < _startDelayNs)
+	{
+		_startDelayNs = target;
+	}
+	else
+	{
+		// creeps up, since each step only shows in the margins a few frames later
+		_startDelayNs += (target - _startDelayNs) / 8;
+	}
+}
+
+DisplayTiming::Totals DisplayTiming::take_totals()
+{
+	const Totals totals = _totals;
+	_totals = {};
+	return totals;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <vk_types.h>
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// When presents actually reach the screen, through VK_GOOGLE_display_timing. Every present is tagged with an id
+// and, when scheduled, a time it isn't to be shown before; poll() reads back what the presentation engine has
+// reported since, a few frames behind. Each present's interval from the one before counts the refresh cycles
+// it stayed up: the cycles past the one it was meant to take are missed vblanks, and how much it differs from
+// the previous interval is the jitter, the judder a viewer sees.
+// Scheduling holds the presents to a steady number of cycles each, the fewest the recent frames were ready in,
+// so a frame rate just under the refresh rate shows every image for two cycles rather than alternating one and
+// two. The reported margins, how much sooner each image was ready than its vblank needed, say how late a frame
+// could have started; frame_start_delay() is the least of them, less a safety margin, for the pacing to sleep.
+// The times are the presentation engine's clock, CLOCK_MONOTONIC on Linux, which steady_clock reads as well.
+// The functions are externally synchronized with the swapchain's acquires and presents, so the frame thread
+// calls them, and never while the present thread runs.
+class DisplayTiming
+{
+public:
+	struct Present {
+		uint32_t id;
+		double intervalMs; // since the previous present reported, negative for the first after a reset
+		uint32_t missedVblanks;
+		double jitterMs; // between its interval and the previous one, negative without both
+		double marginMs; // how much sooner it was ready than it had to be
+	};
+
+	// since the last take_totals()
+	struct Totals {
+		uint32_t presents{ 0 };
+		uint32_t missedVblanks{ 0 };
+		double jitterMs{ 0.0 }; // summed over jitterSamples
+		uint32_t jitterSamples{ 0 };
+	};
+
+	static const char* device_extension();
+
+	// the device's functions; false without them
+	bool init(VkDevice device);
+	bool enabled() const { return _getPastTiming != nullptr; }
+
+	// after each swapchain is built: its refresh cycle; the last one's presents are forgotten
+	void reset(VkSwapchainKHR swapchain);
+	uint64_t refresh_ns() const { return _refreshNs; }
+
+	// the time present id isn't to be shown before, aimed at the vblank that keeps the cadence; 0, as soon as
+	// possible, unless schedule or before the first presents are reported
+	uint64_t desired_time(uint32_t id, bool schedule);
+	// chains time ahead of whatever presentInfo already points to; times and time must outlive the present
+	static void chain(VkPresentInfoKHR& presentInfo, VkPresentTimesInfoGOOGLE& times, const VkPresentTimeGOOGLE& time);
+
+	// after a present: reads what was reported since the last call into presents()
+	void poll();
+	const std::vector<Present>& presents() const { return _presents; }
+	Totals take_totals();
+
+	// refresh cycles each present is scheduled for
+	uint32_t cadence() const { return _cadence; }
+	// how much later the next frame could start and still make the vblank it's scheduled for
+	std::chrono::nanoseconds frame_start_delay() const { return std::chrono::nanoseconds(_startDelayNs); }
+
+private:
+	// presents whose desired time is remembered, and the window the cadence and delay are taken over
+	static constexpr uint32_t HISTORY = 64;
+	static constexpr uint32_t WINDOW = 16;
+	static constexpr uint32_t MAX_CADENCE = 4;
+
+	struct Scheduled {
+		uint32_t id{ 0 };
+		uint32_t cycles{ 1 }; // it was meant to stay up for
+		uint64_t startDelayNs{ 0 }; // the frame slept before it started
+	};
+	struct Recent {
+		uint32_t cycles; // after the previous present it would have been ready in, without the delay
+		uint64_t headroomNs; // how much later it could have been ready and still shown when it was
+	};
+
+	const Scheduled* scheduled(uint32_t id) const;
+	void update_schedule(bool missed);
+
+	VkDevice _device{ VK_NULL_HANDLE };
+	VkSwapchainKHR _swapchain{ VK_NULL_HANDLE };
+	PFN_vkGetRefreshCycleDurationGOOGLE _getRefreshCycle{ nullptr };
+	PFN_vkGetPastPresentationTimingGOOGLE _getPastTiming{ nullptr };
+	uint64_t _refreshNs{ 0 };
+
+	Scheduled _scheduled[HISTORY];
+	std::vector<VkPastPresentationTimingGOOGLE> _timings;
+	std::vector<Present> _presents;
+	Totals _totals;
+
+	// the last present reported
+	uint32_t _lastId{ 0 };
+	uint64_t _lastActual{ 0 };
+	double _lastIntervalMs{ -1.0 };
+
+	Recent _recent[WINDOW];
+	uint32_t _recentCount{ 0 };
+	uint32_t _cadence{ 1 };
+	uint64_t _startDelayNs{ 0 };
+};
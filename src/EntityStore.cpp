@@ -0,0 +1,227 @@
+#include "EntityStore.h"
+
+#include <mutex>
+#include <new>
+
+namespace {
+	struct ComponentInfo {
+		size_t size;
+		size_t alignment;
+	};
+
+	// shared by every store, since a type's id is a function-local static; ids are handed out as queries
+	// first name the types, possibly from several threads
+	std::mutex s_componentMutex;
+	std::vector<ComponentInfo> s_components;
+
+	size_t align_up(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+uint32_t EntityStore::register_component(size_t size, size_t alignment)
+{
+	std::lock_guard<std::mutex> lock(s_componentMutex);
+	assert(s_components.size() < MAX_COMPONENTS && alignment <= CHUNK_ALIGNMENT);
+	s_components.push_back({ size, alignment });
+	return static_cast<uint32_t>(s_components.size() - 1);
+}
+
+void EntityStore::cleanup()
+{
+	for (Archetype& archetype : _archetypes)
+	{
+		for (Chunk& chunk : archetype.chunks)
+		{
+			::operator delete(chunk.data, std::align_val_t(CHUNK_ALIGNMENT));
+		}
+	}
+	_archetypes.clear();
+	_records.clear();
+	_freeIndices.clear();
+	_count = 0;
+}
+
+uint32_t EntityStore::archetype_for(ComponentMask mask)
+{
+	for (uint32_t i = 0; i < _archetypes.size(); i++)
+	{
+		if (_archetypes[i].mask == mask)
+		{
+			return i;
+		}
+	}
+
+	std::vector<ComponentInfo> components;
+	{
+		std::lock_guard<std::mutex> lock(s_componentMutex);
+		components = s_components;
+	}
+
+	// as many rows as fit once every array is padded to its cache line
+	size_t rowSize = sizeof(Entity);
+	for (uint32_t id = 0; id < components.size(); id++)
+	{
+		if (mask & (ComponentMask(1) << id))
+		{
+			rowSize += components[id].size;
+		}
+	}
+
+	Archetype archetype;
+	archetype.mask = mask;
+	archetype.capacity = static_cast<uint32_t>(CHUNK_SIZE / rowSize);
+	for (;;)
+	{
+		size_t offset = align_up(sizeof(Entity) * archetype.capacity, CHUNK_ALIGNMENT);
+		for (uint32_t id = 0; id < MAX_COMPONENTS; id++)
+		{
+			archetype.columns[id] = NO_COLUMN;
+			archetype.sizes[id] = 0;
+			if (id < components.size() && (mask & (ComponentMask(1) << id)))
+			{
+				archetype.columns[id] = offset;
+				archetype.sizes[id] = components[id].size;
+				offset = align_up(offset + components[id].size * archetype.capacity, CHUNK_ALIGNMENT);
+			}
+		}
+		if (offset <= CHUNK_SIZE || archetype.capacity == 1)
+		{
+			break;
+		}
+		archetype.capacity--;
+	}
+	assert(archetype.capacity > 0);
+
+	_archetypes.push_back(std::move(archetype));
+	return static_cast<uint32_t>(_archetypes.size() - 1);
+}
+
+bool EntityStore::alive(Entity entity) const
+{
+	return entity.index < _records.size() && _records[entity.index].generation == entity.generation
+		&& _records[entity.index].archetype != UINT32_MAX;
+}
+
+Entity EntityStore::allocate(uint32_t archetype)
+{
+	Entity entity;
+	if (!_freeIndices.empty())
+	{
+		entity.index = _freeIndices.back();
+		_freeIndices.pop_back();
+	}
+	else
+	{
+		entity.index = static_cast<uint32_t>(_records.size());
+		_records.push_back({ UINT32_MAX, 0, 0, 0 });
+	}
+	entity.generation = _records[entity.index].generation;
+
+	push_row(archetype, entity);
+	_count++;
+	return entity;
+}
+
+void EntityStore::destroy(Entity entity)
+{
+	if (!alive(entity))
+	{
+		return;
+	}
+
+	Record& record = _records[entity.index];
+	pop_row(record.archetype, record.chunk, record.row);
+	record.archetype = UINT32_MAX;
+	// outstanding handles go stale
+	record.generation++;
+	_freeIndices.push_back(entity.index);
+	_count--;
+}
+
+void EntityStore::push_row(uint32_t archetypeIndex, Entity entity)
+{
+	Archetype& archetype = _archetypes[archetypeIndex];
+	if (archetype.chunks.empty() || archetype.chunks.back().count == archetype.capacity)
+	{
+		Chunk chunk;
+		chunk.data = static_cast<uint8_t*>(::operator new(CHUNK_SIZE, std::align_val_t(CHUNK_ALIGNMENT)));
+		chunk.count = 0;
+		archetype.chunks.push_back(chunk);
+	}
+
+	Chunk& chunk = archetype.chunks.back();
+	const uint32_t row = chunk.count++;
+	reinterpret_cast<Entity*>(chunk.data)[row] = entity;
+
+	Record& record = _records[entity.index];
+	record.archetype = archetypeIndex;
+	record.chunk = static_cast<uint32_t>(archetype.chunks.size() - 1);
+	record.row = row;
+}
+
+void EntityStore::pop_row(uint32_t archetypeIndex, uint32_t chunkIndex, uint32_t row)
+{
+	Archetype& archetype = _archetypes[archetypeIndex];
+	Chunk& last = archetype.chunks.back();
+	const uint32_t lastRow = last.count - 1;
+	Chunk& chunk = archetype.chunks[chunkIndex];
+
+	if (&chunk != &last || row != lastRow)
+	{
+		const Entity moved = reinterpret_cast<Entity*>(last.data)[lastRow];
+		reinterpret_cast<Entity*>(chunk.data)[row] = moved;
+		for (uint32_t id = 0; id < MAX_COMPONENTS; id++)
+		{
+			if (archetype.columns[id] == NO_COLUMN)
+			{
+				continue;
+			}
+			const size_t size = archetype.sizes[id];
+			memcpy(chunk.data + archetype.columns[id] + size * row, last.data + archetype.columns[id] + size * lastRow, size);
+		}
+		_records[moved.index].chunk = chunkIndex;
+		_records[moved.index].row = row;
+	}
+
+	if (--last.count == 0)
+	{
+		::operator delete(last.data, std::align_val_t(CHUNK_ALIGNMENT));
+		archetype.chunks.pop_back();
+	}
+}
+
+void EntityStore::move_entity(Entity entity, ComponentMask mask)
+{
+	const Record from = _records[entity.index];
+	if (_archetypes[from.archetype].mask == mask)
+	{
+		return;
+	}
+
+	// the new row first, since finding the archetype may grow _archetypes
+	const uint32_t to = archetype_for(mask);
+	push_row(to, entity);
+	const Record& record = _records[entity.index];
+
+	const ComponentMask kept = _archetypes[from.archetype].mask & mask;
+	for (uint32_t id = 0; id < MAX_COMPONENTS; id++)
+	{
+		if (kept & (ComponentMask(1) << id))
+		{
+			memcpy(component_data(record, id), component_data(from, id), _archetypes[to].sizes[id]);
+		}
+	}
+	pop_row(from.archetype, from.chunk, from.row);
+}
+
+uint8_t* EntityStore::component_data(const Record& record, uint32_t id) const
+{
+	const Archetype& archetype = _archetypes[record.archetype];
+	if (archetype.columns[id] == NO_COLUMN)
+	{
+		return nullptr;
+	}
+	return archetype.chunks[record.chunk].data + archetype.columns[id] + archetype.sizes[id] * record.row;
+}
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <JobSystem.h>
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+// handle to an entity of an EntityStore; stale once the entity is destroyed, even if its index is reused
+struct Entity {
+	uint32_t index{ UINT32_MAX };
+	uint32_t generation{ 0 };
+
+	bool operator==(const Entity& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const Entity& other) const { return !(*this == other); }
+};
+
+// Entities and their components, grouped by archetype: every entity with exactly the same set of component
+// types lives in the same archetype, whose storage is a list of fixed-size chunks. A chunk holds each
+// component type in its own contiguous array (structure of arrays), so a query touching two components of
+// a hundred thousand entities streams through two dense arrays per chunk and never follows a pointer per
+// entity. Rows stay packed: destroying an entity moves the archetype's last one into its place.
+// Components are plain data, copied with memcpy when entities change archetype; at most MAX_COMPONENTS
+// types exist per process. Creating, destroying or changing an entity's components while a query runs is
+// not allowed, and invalidates the pointers get() returned.
+class EntityStore
+{
+public:
+	static constexpr size_t CHUNK_SIZE = 16 * 1024;
+	static constexpr size_t CHUNK_ALIGNMENT = 64; // each array starts on a cache line
+	static constexpr uint32_t MAX_COMPONENTS = 64;
+
+	void cleanup();
+
+	template<typename... Ts>
+	Entity create(const Ts&... components);
+	void destroy(Entity entity);
+	bool alive(Entity entity) const;
+
+	// null when the entity is dead or has no T
+	template<typename T>
+	T* get(Entity entity);
+	template<typename T>
+	bool has(Entity entity) const;
+	// moves the entity to the archetype with T added (overwriting an existing T) or removed
+	template<typename T>
+	void add(Entity entity, const T& component);
+	template<typename T>
+	void remove(Entity entity);
+
+	// fn(Ts&...) for every entity that has all of Ts, archetype by archetype and chunk by chunk
+	template<typename... Ts, typename Fn>
+	void each(Fn&& fn);
+	// the same, with whole chunks handed to the job system; fn runs concurrently for different entities,
+	// so it must only write to the components it is given
+	template<typename... Ts, typename Fn>
+	void par_each(Fn&& fn);
+
+	size_t size() const { return _count; }
+	size_t archetype_count() const { return _archetypes.size(); }
+
+private:
+	using ComponentMask = uint64_t;
+	static constexpr size_t NO_COLUMN = SIZE_MAX;
+
+	struct Chunk {
+		uint8_t* data;
+		uint32_t count;
+	};
+
+	struct Archetype {
+		ComponentMask mask;
+		uint32_t capacity; // rows per chunk
+		// offset of each component's array in a chunk, NO_COLUMN for the components it doesn't have;
+		// the entities' handles are the first array
+		size_t columns[MAX_COMPONENTS];
+		size_t sizes[MAX_COMPONENTS]; // of each component, 0 for the ones it doesn't have
+		std::vector<Chunk> chunks; // all full but the last
+	};
+
+	struct Record {
+		uint32_t archetype;
+		uint32_t chunk;
+		uint32_t row;
+		uint32_t generation;
+	};
+
+	// the id of T, registering its size the first time
+	template<typename T>
+	static uint32_t component_id();
+	static uint32_t register_component(size_t size, size_t alignment);
+
+	template<typename T>
+	static ComponentMask mask_of() { return ComponentMask(1) << component_id<T>(); }
+	template<typename... Ts>
+	static ComponentMask query_mask() { return (ComponentMask(0) | ... | mask_of<Ts>()); }
+	template<typename T>
+	static T* column(const Archetype& archetype, const Chunk& chunk)
+	{
+		return reinterpret_cast<T*>(chunk.data + archetype.columns[component_id<T>()]);
+	}
+
+	// finds or creates the archetype of exactly these components
+	uint32_t archetype_for(ComponentMask mask);
+	// a new entity with uninitialized components of the archetype
+	Entity allocate(uint32_t archetype);
+	// appends a row for entity to the archetype and points the entity's record at it
+	void push_row(uint32_t archetype, Entity entity);
+	// fills the row with the archetype's last one, which is then dropped
+	void pop_row(uint32_t archetype, uint32_t chunk, uint32_t row);
+	// to the archetype of mask, keeping the components both have
+	void move_entity(Entity entity, ComponentMask mask);
+	uint8_t* component_data(const Record& record, uint32_t id) const;
+
+	std::vector<Archetype> _archetypes;
+	std::vector<Record> _records; // by entity index
+	std::vector<uint32_t> _freeIndices;
+	size_t _count{ 0 };
+};
+
+template<typename T>
+uint32_t EntityStore::component_id()
+{
+	static_assert(std::is_trivially_copyable<T>::value, "components are moved between chunks with memcpy");
+	static const uint32_t id = register_component(sizeof(T), alignof(T));
+	return id;
+}
+
+template<typename... Ts>
+Entity EntityStore::create(const Ts&... components)
+{
+	const ComponentMask mask = query_mask<Ts...>();
+	const Entity entity = allocate(archetype_for(mask));
+	(memcpy(get<Ts>(entity), &components, sizeof(Ts)), ...);
+	return entity;
+}
+
+template<typename T>
+T* EntityStore::get(Entity entity)
+{
+	if (!alive(entity))
+	{
+		return nullptr;
+	}
+	return reinterpret_cast<T*>(component_data(_records[entity.index], component_id<T>()));
+}
+
+template<typename T>
+bool EntityStore::has(Entity entity) const
+{
+	return alive(entity) && (_archetypes[_records[entity.index].archetype].mask & mask_of<T>()) != 0;
+}
+
+template<typename T>
+void EntityStore::add(Entity entity, const T& component)
+{
+	if (!alive(entity))
+	{
+		return;
+	}
+	move_entity(entity, _archetypes[_records[entity.index].archetype].mask | mask_of<T>());
+	memcpy(get<T>(entity), &component, sizeof(T));
+}
+
+template<typename T>
+void EntityStore::remove(Entity entity)
+{
+	if (!alive(entity))
+	{
+		return;
+	}
+	move_entity(entity, _archetypes[_records[entity.index].archetype].mask & ~mask_of<T>());
+}
+
+template<typename... Ts, typename Fn>
+void EntityStore::each(Fn&& fn)
+{
+	const ComponentMask mask = query_mask<Ts...>();
+	for (const Archetype& archetype : _archetypes)
+	{
+		if ((archetype.mask & mask) != mask)
+		{
+			continue;
+		}
+		for (const Chunk& chunk : archetype.chunks)
+		{
+			auto columns = std::make_tuple(column<Ts>(archetype, chunk)...);
+			for (uint32_t row = 0; row < chunk.count; row++)
+			{
+				std::apply([&](Ts*... arrays) { fn(arrays[row]...); }, columns);
+			}
+		}
+	}
+}
+
+template<typename... Ts, typename Fn>
+void EntityStore::par_each(Fn&& fn)
+{
+	const ComponentMask mask = query_mask<Ts...>();
+	struct ChunkRef {
+		const Archetype* archetype;
+		const Chunk* chunk;
+	};
+	std::vector<ChunkRef> chunks;
+	for (const Archetype& archetype : _archetypes)
+	{
+		if ((archetype.mask & mask) != mask)
+		{
+			continue;
+		}
+		for (const Chunk& chunk : archetype.chunks)
+		{
+			chunks.push_back({ &archetype, &chunk });
+		}
+	}
+
+	// a chunk is the unit of work: a few hundred rows that one thread walks front to back
+	parallel_for(chunks.size(), [&](size_t i) {
+		const ChunkRef& ref = chunks[i];
+		auto columns = std::make_tuple(column<Ts>(*ref.archetype, *ref.chunk)...);
+		for (uint32_t row = 0; row < ref.chunk->count; row++)
+		{
+			std::apply([&](Ts*... arrays) { fn(arrays[row]...); }, columns);
+		}
+	});
+}
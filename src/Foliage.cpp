@@ -0,0 +1,457 @@
+#include "Foliage.h"
+
+#include "Camera.h"
+#include "Impostors.h"
+#include "Log.h"
+#include "Terrain.h"
+#include "vk_initializers.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/vector_relational.hpp>
+
+namespace {
+	// matches Patch in foliage.comp
+	struct GpuFoliagePatch {
+		glm::ivec4 cells; // xy the first cell, zw one past the last
+		glm::vec4 node; // the terrain node's, as in GpuTerrainNode
+		glm::uvec4 slot; // x the node's tile
+	};
+
+	// matches Frame in foliage.comp; the patches follow it
+	struct GpuFoliageFrame {
+		glm::mat4 view;
+		glm::vec4 planes[6];
+		glm::vec4 eye; // w world units per cell
+		glm::vec4 projection; // x proj[0][0], y proj[1][1], zw the view axis' offset
+		glm::vec4 depth; // x proj[2][2], y proj[3][2], z the near plane
+		glm::vec4 grid; // as terrain.vert's: x world units between samples, y the first's world x and z, z the last sample
+		glm::vec4 height; // x the lowest sample's height, y world units per 16-bit step, z the field's height
+		glm::vec4 lods; // xyz where each level ends, w where everything does
+		glm::vec4 sphere; // the tuft's bounding sphere at scale 1
+		glm::uvec4 info; // x patches, y FOLIAGE_* flags, zw the pyramid's level 0
+		glm::uvec4 limits; // x instances per level, y impostors, z the impostor layer, w the density map's side
+	};
+
+	const uint32_t FOLIAGE_OCCLUSION = 1;
+	const uint32_t FOLIAGE_REVERSE_Z = 2; // near at depth 1, and the pyramid holds minimums
+	const uint32_t FOLIAGE_IMPOSTORS = 4;
+
+	// foliage.comp scales a tuft by up to this; the CPU's boxes leave room for the largest
+	constexpr float MAX_SCALE = 1.4f;
+	// side of the density map once resampled; finer than the cells is wasted on the GPU's side of the bus
+	constexpr uint32_t MAX_DENSITY_SIDE = 1024;
+
+	// where each level ends, as a fraction of the distance; the impostors take the rest
+	constexpr float LOD_ENDS[Foliage::LOD_COUNT] = { 0.2f, 0.4f, 0.6f };
+
+	// VkDrawIndexedIndirectCommand per level, then VkDrawIndirectCommand for the impostors, as words
+	constexpr uint32_t DRAW_WORDS = Foliage::LOD_COUNT * 5 + 4;
+
+	bool box_outside(const glm::vec3& min, const glm::vec3& max, const glm::vec4 planes[6])
+	{
+		for (int i = 0; i < 6; i++)
+		{
+			const glm::vec3 normal = glm::vec3(planes[i]);
+			const glm::vec3 positive = glm::mix(min, max, glm::greaterThanEqual(normal, glm::vec3(0.0f)));
+			if (glm::dot(normal, positive) + planes[i].w < 0.0f)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	float box_distance(const glm::vec3& point, const glm::vec3& min, const glm::vec3& max)
+	{
+		return glm::length(glm::clamp(point, min, max) - point);
+	}
+
+	void create_buffer(VmaAllocator allocator, VkDeviceSize size, VkBufferUsageFlags usage, bool hostVisible, AllocatedBuffer& buffer)
+	{
+		VkBufferCreateInfo bufferInfo = {};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.pNext = nullptr;
+		bufferInfo.size = size;
+		bufferInfo.usage = usage;
+		VmaAllocationCreateInfo allocInfo = {};
+		allocInfo.usage = hostVisible ? VMA_MEMORY_USAGE_CPU_TO_GPU : VMA_MEMORY_USAGE_GPU_ONLY;
+		allocInfo.flags = hostVisible ? VMA_ALLOCATION_CREATE_MAPPED_BIT : 0;
+		VmaAllocationInfo mappedInfo = {};
+		VK_CHECK(vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &buffer._buffer, &buffer._allocation, &mappedInfo));
+		buffer._mapped = hostVisible ? mappedInfo.pMappedData : nullptr;
+	}
+}
+
+bool Foliage::init(VkDevice device, VmaAllocator allocator, DescriptorAllocator& descriptors, const FoliageSettings& settings, const Terrain& terrain,
+	VkShaderModule scatterShader, VkPipelineCache cache, uint32_t frameCount)
+{
+	_settings = settings;
+	_settings.spacing = std::max(_settings.spacing, 0.05f);
+	_settings.distance = std::max(_settings.distance, _settings.spacing);
+	if (scatterShader == VK_NULL_HANDLE || !terrain.ready() || !load_density(_settings.densityPath))
+	{
+		return false;
+	}
+	_device = device;
+	_allocator = allocator;
+
+	// the same blades at every level, fewer and flatter further out, wider to cover about as much
+	_mesh = Mesh{};
+	add_level(9, 4, 0.0f);
+	add_level(6, 2, 0.05f);
+	add_level(3, 1, 0.15f);
+	_mesh.compute_bounds();
+	_impostorLayer = UINT32_MAX;
+
+	// written once here; small, and read once per vertex or cell
+	create_buffer(_allocator, _mesh._vertices.size() * sizeof(Vertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, true, _vertices);
+	memcpy(_vertices._mapped, _mesh._vertices.data(), _mesh._vertices.size() * sizeof(Vertex));
+	vmaFlushAllocation(_allocator, _vertices._allocation, 0, VK_WHOLE_SIZE);
+	create_buffer(_allocator, _mesh._indices.size() * sizeof(uint16_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, true, _indices);
+	uint16_t* indices = static_cast<uint16_t*>(_indices._mapped);
+	for (size_t i = 0; i < _mesh._indices.size(); i++)
+	{
+		indices[i] = static_cast<uint16_t>(_mesh._indices[i]);
+	}
+	vmaFlushAllocation(_allocator, _indices._allocation, 0, VK_WHOLE_SIZE);
+	create_buffer(_allocator, _density.size() * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, true, _densityBuffer);
+	memcpy(_densityBuffer._mapped, _density.data(), _density.size() * sizeof(uint32_t));
+	vmaFlushAllocation(_allocator, _densityBuffer._allocation, 0, VK_WHOLE_SIZE);
+
+	// any storage buffer offset alignment a device asks for divides 256
+	frameCount = std::max(frameCount, 1u);
+	const VkDeviceSize frameSize = sizeof(GpuFoliageFrame) + VkDeviceSize(MAX_PATCHES) * sizeof(GpuFoliagePatch);
+	_frameStride = (frameSize + 255) & ~VkDeviceSize(255);
+	create_buffer(_allocator, _frameStride * frameCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, true, _frameBuffer);
+
+	// only ever touched by the GPU: one frame's scatter writes them and its draws read them
+	const VkBufferUsageFlags instanceUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+	create_buffer(_allocator, VkDeviceSize(MAX_INSTANCES) * LOD_COUNT * sizeof(GpuFoliageInstance), instanceUsage, false, _instances);
+	create_buffer(_allocator, VkDeviceSize(MAX_IMPOSTORS) * sizeof(GpuImpostorInstance), instanceUsage, false, _impostors);
+	create_buffer(_allocator, DRAW_WORDS * sizeof(uint32_t),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, false, _draws);
+
+	VkDescriptorSetLayoutBinding bindings[] = {
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0), // frame and patches
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1), // terrain tiles
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2), // density map
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3), // instances
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4), // impostors
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 5), // draws
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 6), // depth pyramid
+	};
+	VkDescriptorSetLayoutCreateInfo setInfo = {};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setInfo.pNext = nullptr;
+	setInfo.bindingCount = 7;
+	setInfo.pBindings = bindings;
+	VK_CHECK(vkCreateDescriptorSetLayout(_device, &setInfo, nullptr, &_setLayout));
+
+	// the pyramid comes with set_depth_pyramid, before the first scatter
+	_sets.assign(frameCount, VK_NULL_HANDLE);
+	for (uint32_t frame = 0; frame < frameCount; frame++)
+	{
+		descriptors.allocate(&_sets[frame], _setLayout);
+		VkDescriptorBufferInfo bufferInfos[] = {
+			{ _frameBuffer._buffer, _frameStride * frame, frameSize },
+			{ terrain.tile_buffer(), 0, VK_WHOLE_SIZE },
+			{ _densityBuffer._buffer, 0, VK_WHOLE_SIZE },
+			{ _instances._buffer, 0, VK_WHOLE_SIZE },
+			{ _impostors._buffer, 0, VK_WHOLE_SIZE },
+			{ _draws._buffer, 0, VK_WHOLE_SIZE },
+		};
+		VkWriteDescriptorSet writes[6];
+		for (uint32_t binding = 0; binding < 6; binding++)
+		{
+			writes[binding] = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _sets[frame], &bufferInfos[binding], binding);
+		}
+		vkUpdateDescriptorSets(_device, 6, writes, 0, nullptr);
+	}
+
+	VkPipelineLayoutCreateInfo layoutInfo = vkinit::pipeline_layout_create_info();
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &_setLayout;
+	VK_CHECK(vkCreatePipelineLayout(_device, &layoutInfo, nullptr, &_pipelineLayout));
+
+	VkComputePipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.pNext = nullptr;
+	pipelineInfo.layout = _pipelineLayout;
+	pipelineInfo.stage = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, scatterShader);
+	VK_CHECK(vkCreateComputePipelines(_device, cache, 1, &pipelineInfo, nullptr, &_pipeline));
+
+	_frame = 0;
+	_patchCount = 0;
+	LOG_INFO("Foliage: a candidate every " << _settings.spacing << " units out to " << _settings.distance << ", "
+		<< _mesh._vertices.size() << " vertices over " << LOD_COUNT << " levels, density map " << _densitySide << "x" << _densitySide);
+	return true;
+}
+
+void Foliage::cleanup()
+{
+	// the sets go with the descriptor allocator's pools
+	if (_pipeline != VK_NULL_HANDLE)
+	{
+		vkDestroyPipeline(_device, _pipeline, nullptr);
+		vkDestroyPipelineLayout(_device, _pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(_device, _setLayout, nullptr);
+		_pipeline = VK_NULL_HANDLE;
+		_pipelineLayout = VK_NULL_HANDLE;
+		_setLayout = VK_NULL_HANDLE;
+	}
+	for (AllocatedBuffer* buffer : { &_vertices, &_indices, &_densityBuffer, &_frameBuffer, &_instances, &_impostors, &_draws })
+	{
+		if (buffer->_buffer != VK_NULL_HANDLE)
+		{
+			vmaDestroyBuffer(_allocator, buffer->_buffer, buffer->_allocation);
+			*buffer = {};
+		}
+	}
+	_sets.clear();
+	_patchCount = 0;
+}
+
+void Foliage::add_level(uint32_t blades, uint32_t segments, float error)
+{
+	const uint32_t firstIndex = static_cast<uint32_t>(_mesh._indices.size());
+	const float width = 0.035f * std::sqrt(9.0f / float(blades));
+	const glm::vec3 root = glm::vec3(0.10f, 0.20f, 0.05f);
+	const glm::vec3 tip = glm::vec3(0.45f, 0.60f, 0.20f);
+	for (uint32_t blade = 0; blade < blades; blade++)
+	{
+		// round the root by the golden angle, each leaning out and bending over by a little more or less
+		const float angle = float(blade) * 2.39996f;
+		const glm::vec3 facing = glm::vec3(std::cos(angle), 0.0f, std::sin(angle));
+		const glm::vec3 across = glm::vec3(-facing.z, 0.0f, facing.x);
+		const float lean = 0.12f + 0.08f * float(blade % 3);
+		const float height = 0.40f + 0.05f * float((blade * 7) % 4);
+		// lit mostly from above, like the ground it grows from, so the blades don't flicker as they turn
+		const glm::vec3 normal = glm::normalize(facing + glm::vec3(0.0f, 2.0f, 0.0f));
+
+		const uint32_t first = static_cast<uint32_t>(_mesh._vertices.size());
+		for (uint32_t s = 0; s <= segments; s++)
+		{
+			const float t = float(s) / float(segments);
+			const glm::vec3 spine = facing * (lean * t * t) + glm::vec3(0.0f, height * t, 0.0f);
+			const glm::vec3 color = glm::mix(root, tip, t);
+			if (s == segments)
+			{
+				_mesh._vertices.push_back({ spine, normal, color });
+				break;
+			}
+			const float halfWidth = width * (1.0f - t * 0.8f);
+			_mesh._vertices.push_back({ spine - across * halfWidth, normal, color });
+			_mesh._vertices.push_back({ spine + across * halfWidth, normal, color });
+		}
+		for (uint32_t s = 0; s < segments; s++)
+		{
+			const uint32_t a = first + s * 2;
+			if (s + 1 == segments)
+			{
+				_mesh._indices.insert(_mesh._indices.end(), { a, a + 1, a + 2 });
+			}
+			else
+			{
+				_mesh._indices.insert(_mesh._indices.end(), { a, a + 1, a + 2, a + 2, a + 1, a + 3 });
+			}
+		}
+	}
+	_mesh._lods.push_back({ firstIndex, static_cast<uint32_t>(_mesh._indices.size()) - firstIndex, error });
+}
+
+bool Foliage::load_density(const std::string& path)
+{
+	_density.assign(1, 0xff);
+	_densitySide = 1;
+	if (path.empty())
+	{
+		return true;
+	}
+	Heightfield map;
+	if (!map.load_pgm(path.c_str()))
+	{
+		return false;
+	}
+	// nearest sample, which is as much as the cells can tell apart at this size
+	_densitySide = std::min(map.side(), MAX_DENSITY_SIDE);
+	_density.assign((size_t(_densitySide) * _densitySide + 3) / 4, 0);
+	for (uint32_t y = 0; y < _densitySide; y++)
+	{
+		for (uint32_t x = 0; x < _densitySide; x++)
+		{
+			const uint32_t texel = y * _densitySide + x;
+			const uint16_t value = map.at(int64_t(x) * map.side() / _densitySide, int64_t(y) * map.side() / _densitySide);
+			_density[texel >> 2] |= uint32_t(value >> 8) << ((texel & 3) * 8);
+		}
+	}
+	return true;
+}
+
+void Foliage::set_depth_pyramid(VkImageView view, VkSampler sampler)
+{
+	VkDescriptorImageInfo pyramidInfo = {};
+	pyramidInfo.sampler = sampler;
+	pyramidInfo.imageView = view;
+	pyramidInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+	for (VkDescriptorSet set : _sets)
+	{
+		VkWriteDescriptorSet write = vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, set, &pyramidInfo, 6);
+		vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+	}
+}
+
+void Foliage::prepare(const Terrain& terrain, const Camera& camera, uint32_t frame, bool occlusion, VkExtent2D depthExtent)
+{
+	_frame = frame;
+	_patchCount = 0;
+	if (!ready())
+	{
+		return;
+	}
+
+	const TerrainSettings& terrainSettings = terrain.settings();
+	const float spacing = terrain.spacing();
+	const float corner = -0.5f * terrainSettings.size;
+	const float lastSample = float(terrain.last_sample());
+	const float cell = _settings.spacing;
+	const glm::vec3 eye = camera.position();
+	const glm::vec4* planes = camera.frustum_planes();
+	// the tufts stand above the ground and lean out of their cells
+	const float reach = _mesh._bounds.radius * 2.0f * MAX_SCALE;
+	const float low = terrainSettings.baseHeight;
+	const float high = terrainSettings.baseHeight + terrainSettings.height + reach;
+
+	uint8_t* mapped = static_cast<uint8_t*>(_frameBuffer._mapped) + _frameStride * frame;
+	GpuFoliagePatch* patches = reinterpret_cast<GpuFoliagePatch*>(mapped + sizeof(GpuFoliageFrame));
+	for (const GpuTerrainNode& node : terrain.selected())
+	{
+		const glm::vec2 first = glm::vec2(node.node);
+		const glm::vec2 nodeMin = corner + first * spacing;
+		const glm::vec2 nodeMax = corner + glm::min(first + float(Terrain::PATCH) * node.node.z, glm::vec2(lastSample)) * spacing;
+		if (box_distance(eye, glm::vec3(nodeMin.x, low, nodeMin.y), glm::vec3(nodeMax.x, high, nodeMax.y)) > _settings.distance)
+		{
+			continue;
+		}
+		// a cell's point lands anywhere up to a cell past its corner, so the one before the node's first cell
+		// can land in it as well; foliage.comp keeps only the points inside the node
+		const glm::ivec2 firstCell = glm::ivec2(glm::ceil(nodeMin / cell)) - 1;
+		const glm::ivec2 endCell = glm::ivec2(glm::ceil(nodeMax / cell));
+		for (int32_t py = firstCell.y; py < endCell.y; py += PATCH_CELLS)
+		{
+			for (int32_t px = firstCell.x; px < endCell.x; px += PATCH_CELLS)
+			{
+				const glm::ivec2 patchFirst = glm::ivec2(px, py);
+				const glm::ivec2 patchEnd = glm::min(patchFirst + int32_t(PATCH_CELLS), endCell);
+				// its cells, grown by the tufts' reach
+				const glm::vec2 patchMin = glm::vec2(patchFirst) * cell - reach;
+				const glm::vec2 patchMax = glm::vec2(patchEnd) * cell + reach;
+				const glm::vec3 boxMin = glm::vec3(patchMin.x, low, patchMin.y);
+				const glm::vec3 boxMax = glm::vec3(patchMax.x, high, patchMax.y);
+				if (box_distance(eye, boxMin, boxMax) > _settings.distance || box_outside(boxMin, boxMax, planes))
+				{
+					continue;
+				}
+				if (_patchCount == MAX_PATCHES)
+				{
+					break;
+				}
+				GpuFoliagePatch& patch = patches[_patchCount++];
+				patch.cells = glm::ivec4(patchFirst, patchEnd);
+				patch.node = node.node;
+				patch.slot = glm::uvec4(static_cast<uint32_t>(node.slot), 0, 0, 0);
+			}
+		}
+	}
+
+	GpuFoliageFrame& header = *reinterpret_cast<GpuFoliageFrame*>(mapped);
+	const glm::mat4& proj = camera.projection();
+	header.view = camera.view();
+	memcpy(header.planes, planes, sizeof(header.planes));
+	header.eye = glm::vec4(eye, cell);
+	header.projection = glm::vec4(proj[0][0], proj[1][1], -proj[2][0], -proj[2][1]);
+	header.depth = glm::vec4(proj[2][2], proj[3][2], camera.near_plane(), 0.0f);
+	header.grid = glm::vec4(spacing, corner, lastSample, 0.0f);
+	header.height = glm::vec4(terrainSettings.baseHeight, terrainSettings.height / 65535.0f, terrainSettings.height, 0.0f);
+	// without impostors the last level goes all the way
+	const bool impostors = _impostorLayer != UINT32_MAX;
+	header.lods = glm::vec4(LOD_ENDS[0], LOD_ENDS[1], impostors ? LOD_ENDS[2] : 1.0f, 1.0f) * _settings.distance;
+	header.sphere = glm::vec4(_mesh._bounds.origin, _mesh._bounds.radius);
+	header.info = glm::uvec4(_patchCount, (occlusion ? FOLIAGE_OCCLUSION : 0) | (camera.reverse_z() ? FOLIAGE_REVERSE_Z : 0) | (impostors ? FOLIAGE_IMPOSTORS : 0),
+		depthExtent.width, depthExtent.height);
+	header.limits = glm::uvec4(MAX_INSTANCES, MAX_IMPOSTORS, impostors ? _impostorLayer : 0, _densitySide);
+	vmaFlushAllocation(_allocator, _frameBuffer._allocation, _frameStride * frame, sizeof(GpuFoliageFrame) + _patchCount * sizeof(GpuFoliagePatch));
+}
+
+void Foliage::record(VkCommandBuffer cmd) const
+{
+	if (!ready())
+	{
+		return;
+	}
+
+	// the previous frame's draws read the commands and instances about to be rewritten
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+	// every draw empty, the scatter counts the instances up
+	uint32_t words[DRAW_WORDS] = {};
+	for (uint32_t level = 0; level < LOD_COUNT; level++)
+	{
+		words[level * 5 + 0] = _mesh._lods[level].indexCount;
+		words[level * 5 + 2] = _mesh._lods[level].firstIndex;
+	}
+	words[LOD_COUNT * 5] = 6;
+	vkCmdUpdateBuffer(cmd, _draws._buffer, 0, sizeof(words), words);
+
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.pNext = nullptr;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	if (_patchCount > 0)
+	{
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout, 0, 1, &_sets[_frame], 0, nullptr);
+		vkCmdDispatch(cmd, _patchCount, 1, 1);
+	}
+
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+		0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void Foliage::draw(VkCommandBuffer cmd) const
+{
+	if (_patchCount == 0)
+	{
+		return;
+	}
+	// each level's instances from its own stretch, so the draws need no firstInstance
+	const VkDeviceSize vertexOffset = 0;
+	vkCmdBindVertexBuffers(cmd, 0, 1, &_vertices._buffer, &vertexOffset);
+	vkCmdBindIndexBuffer(cmd, _indices._buffer, 0, VK_INDEX_TYPE_UINT16);
+	for (uint32_t level = 0; level < LOD_COUNT; level++)
+	{
+		const VkDeviceSize instanceOffset = VkDeviceSize(level) * MAX_INSTANCES * sizeof(GpuFoliageInstance);
+		vkCmdBindVertexBuffers(cmd, 1, 1, &_instances._buffer, &instanceOffset);
+		vkCmdDrawIndexedIndirect(cmd, _draws._buffer, level * 5 * sizeof(uint32_t), 1, 0);
+	}
+}
+
+void Foliage::draw_impostors(VkCommandBuffer cmd) const
+{
+	if (!has_impostors())
+	{
+		return;
+	}
+	const VkDeviceSize offset = 0;
+	vkCmdBindVertexBuffers(cmd, 0, 1, &_impostors._buffer, &offset);
+	vkCmdDrawIndirect(cmd, _draws._buffer, LOD_COUNT * 5 * sizeof(uint32_t), 1, 0);
+}
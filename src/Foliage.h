@@ -0,0 +1,124 @@
+#pragma once
+
+#include <vk_types.h>
+#include <DescriptorAllocator.h>
+#include <Mesh.h>
+#include <VertexLayout.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+class Camera;
+class Terrain;
+
+struct FoliageSettings {
+	// a binary PGM stretched over the whole terrain, white full density and black none; empty for slope and height alone
+	std::string densityPath;
+	// world units between the candidate positions, one per cell of a grid over the terrain
+	float spacing{ 0.5f };
+	// nothing is placed past it; the last part of it thins out instead of ending at a line
+	float distance{ 60.0f };
+};
+
+// per instance vertex input of foliage.vert, written by foliage.comp: where the tuft stands, how big it is,
+// which way it faces and how it's tinted
+struct GpuFoliageInstance {
+	glm::vec4 positionScale; // xyz the root, w the scale
+	glm::vec4 rotationTint; // xy cosine and sine of the yaw, z the tint, w unused
+};
+
+// the tuft's vertices at binding 0, as for the meshes, and the instances at binding 1
+constexpr auto FOLIAGE_INSTANCE_LAYOUT = vertex_layout(
+	{ vertex_binding(1, sizeof(GpuFoliageInstance), VK_VERTEX_INPUT_RATE_INSTANCE) },
+	{ VERTEX_ATTRIBUTE(GpuFoliageInstance, positionScale, 3, 1), VERTEX_ATTRIBUTE(GpuFoliageInstance, rotationTint, 4, 1) });
+
+// Grass scattered over the terrain entirely on the GPU. Every frame the CPU cuts the terrain nodes drawn
+// within reach into patches of PATCH_CELLS x PATCH_CELLS cells and culls them coarsely; foliage.comp then
+// takes a workgroup per patch and an invocation per cell. Each cell hashes its own jitter, yaw, scale and
+// tint from its grid coordinates, so a tuft stays where it is whichever node it's placed from, and keeps it
+// from slope, height and the density map. The survivors of the frustum, distance and, with occlusion culling,
+// HiZ tests are appended to the instance list of the level their distance picks, each level's draw count
+// bumped in place, and the farthest go to the impostor list when there is an atlas to draw them from.
+// Nothing is read back: the draws are indirect, four of them whatever the count.
+// A point belongs to the node it lands in, so where nodes of different levels meet each tuft is still placed
+// once, at the height of the grid that's drawn under it.
+class Foliage
+{
+public:
+	static constexpr uint32_t LOD_COUNT = 3;
+	// cells along each side of a patch, the scatter's workgroup
+	static constexpr uint32_t PATCH_CELLS = 16;
+	// patches scattered per frame at most; the terrain's nodes past it get none
+	static constexpr uint32_t MAX_PATCHES = 8192;
+	// instances per level, and beyond the last level as impostors
+	static constexpr uint32_t MAX_INSTANCES = 131072;
+	static constexpr uint32_t MAX_IMPOSTORS = 65536;
+
+	// builds the tuft and its levels, the buffers and the scatter pipeline over terrain's tiles; false, with
+	// nothing created, without the shader or when the density map can't be loaded
+	bool init(VkDevice device, VmaAllocator allocator, DescriptorAllocator& descriptors, const FoliageSettings& settings, const Terrain& terrain,
+		VkShaderModule scatterShader, VkPipelineCache cache, uint32_t frameCount);
+	void cleanup();
+
+	bool ready() const { return _pipeline != VK_NULL_HANDLE; }
+
+	// level 0, for the impostor bake
+	const Mesh& mesh() const { return _mesh; }
+	// the impostor atlas's layer in Impostors; UINT32_MAX keeps the far tufts as the last level
+	void set_impostor_layer(uint32_t layer) { _impostorLayer = layer; }
+	// the depth pyramid the HiZ test reads, sampled in GENERAL
+	void set_depth_pyramid(VkImageView view, VkSampler sampler);
+
+	// after the terrain's select: the patches under its nodes within reach into frame's slot. occlusion tests
+	// against the pyramid, whose level 0 is depthExtent
+	void prepare(const Terrain& terrain, const Camera& camera, uint32_t frame, bool occlusion, VkExtent2D depthExtent);
+	// outside a render pass: resets the draws and scatters the prepared patches into them, ordered after the
+	// previous frame's draws and before this one's
+	void record(VkCommandBuffer cmd) const;
+
+	// inside the render pass with the foliage pipeline and set 0 bound: one indirect draw per level
+	void draw(VkCommandBuffer cmd) const;
+	// ... and with the impostor pipeline and both its sets bound: the far tufts' quads
+	void draw_impostors(VkCommandBuffer cmd) const;
+	bool has_impostors() const { return _impostorLayer != UINT32_MAX && _patchCount > 0; }
+
+	uint32_t patch_count() const { return _patchCount; }
+	// candidates scattered this frame; what survives is only on the GPU
+	uint32_t cell_count() const { return _patchCount * PATCH_CELLS * PATCH_CELLS; }
+
+private:
+	// appends one level's blades, each a strip of segments quads tapering to a point, to _mesh
+	void add_level(uint32_t blades, uint32_t segments, float error);
+	bool load_density(const std::string& path);
+
+	VkDevice _device{ VK_NULL_HANDLE };
+	VmaAllocator _allocator{ nullptr };
+	FoliageSettings _settings;
+	Mesh _mesh; // every level's vertices and indices; _lods says which are whose
+	uint32_t _impostorLayer{ UINT32_MAX };
+
+	// the density map as bytes, four to a word, and its side; a single white texel without one
+	std::vector<uint32_t> _density;
+	uint32_t _densitySide{ 1 };
+
+	AllocatedBuffer _vertices{};
+	AllocatedBuffer _indices{};
+	AllocatedBuffer _densityBuffer{};
+	AllocatedBuffer _frameBuffer{}; // the scatter's inputs per frame slot, host visible
+	VkDeviceSize _frameStride{ 0 };
+	AllocatedBuffer _instances{}; // MAX_INSTANCES per level
+	AllocatedBuffer _impostors{};
+	AllocatedBuffer _draws{}; // the indexed draws, then the impostors' draw
+
+	VkDescriptorSetLayout _setLayout{ VK_NULL_HANDLE };
+	std::vector<VkDescriptorSet> _sets; // per frame slot
+	VkPipelineLayout _pipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline _pipeline{ VK_NULL_HANDLE };
+
+	uint32_t _frame{ 0 };
+	uint32_t _patchCount{ 0 };
+};
@@ -0,0 +1,57 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+void FrameArena::init(size_t capacity)
+{
+	_capacity = capacity;
+	_block = static_cast<uint8_t*>(std::malloc(capacity));
+	_used = 0;
+}
+
+void FrameArena::cleanup()
+{
+	reset();
+	std::free(_block);
+	_block = nullptr;
+	_capacity = 0;
+}
+
+void FrameArena::reset()
+{
+	for (void* allocation : _overflow)
+	{
+		std::free(allocation);
+	}
+	_overflow.clear();
+
+	// a frame that overflowed will likely do so again; grow so the next one fits in the block
+	if (_overflowBytes > 0)
+	{
+		std::free(_block);
+		_capacity = std::max(_capacity * 2, _capacity + _overflowBytes);
+		_block = static_cast<uint8_t*>(std::malloc(_capacity));
+		_overflowBytes = 0;
+	}
+
+	_used = 0;
+}
+
+void* FrameArena::allocate(size_t size, size_t alignment)
+{
+	// alignment is always a power of two
+	size_t offset = (_used + alignment - 1) & ~(alignment - 1);
+	if (offset + size <= _capacity)
+	{
+		_used = offset + size;
+		return _block + offset;
+	}
+
+	// malloc is aligned for any standard type, which covers everything the draw path stores
+	void* allocation = std::malloc(size);
+	_overflow.push_back(allocation);
+	_overflowBytes += size;
+	_overflowCount++;
+	return allocation;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bump allocator for CPU data that only lives for one frame: allocation is a pointer bump, nothing is
+// freed individually, and reset() recycles everything at once when the frame slot comes around again.
+// Requests that don't fit go to the heap and are counted, so the capacity can be tuned until
+// steady-state frames never overflow; reset() folds them into a bigger block for the next frame.
+class FrameArena
+{
+public:
+	void init(size_t capacity);
+	void cleanup();
+
+	// invalidates every allocation made since the last reset
+	void reset();
+
+	void* allocate(size_t size, size_t alignment);
+
+	size_t used() const { return _used; }
+	size_t capacity() const { return _capacity; }
+	// heap allocations made because the block was full, since init
+	uint64_t overflow_count() const { return _overflowCount; }
+
+private:
+	uint8_t* _block{ nullptr };
+	size_t _capacity{ 0 };
+	size_t _used{ 0 };
+
+	// heap fallbacks since the last reset, and their total size
+	std::vector<void*> _overflow;
+	size_t _overflowBytes{ 0 };
+	uint64_t _overflowCount{ 0 };
+};
+
+// STL allocator handing out FrameArena memory; deallocate is a no-op, the arena's reset frees everything
+// containers using it must not outlive the arena's next reset
+template<typename T>
+struct ArenaAllocator
+{
+	using value_type = T;
+
+	FrameArena* arena;
+
+	explicit ArenaAllocator(FrameArena& frameArena) : arena(&frameArena) {}
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+	T* allocate(size_t n) { return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T))); }
+	void deallocate(T*, size_t) {}
+
+	template<typename U>
+	bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+	template<typename U>
+	bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+};
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
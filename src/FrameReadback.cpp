@@ -0,0 +1,185 @@
+#include "FrameReadback.h"
+
+#include "vk_initializers.h"
+
+#include <fstream>
+
+void FrameReadback::init(VkDevice device, VmaAllocator allocator, DescriptorAllocator& descriptors, VkShaderModule nv12Shader,
+	VkPipelineCache cache, uint32_t frameOverlap)
+{
+	_device = device;
+	_allocator = allocator;
+	_slots.assign(frameOverlap, Slot{});
+	if (nv12Shader != VK_NULL_HANDLE)
+	{
+		_nv12.init(_device, descriptors, nv12Shader, cache, frameOverlap);
+	}
+}
+
+void FrameReadback::cleanup()
+{
+	destroy_buffers();
+	_slots.clear();
+	_nv12.cleanup();
+}
+
+VkImageUsageFlags FrameReadback::image_usage(ReadbackFormat format)
+{
+	return VK_IMAGE_USAGE_TRANSFER_SRC_BIT | (format == ReadbackFormat::Nv12 ? VK_IMAGE_USAGE_SAMPLED_BIT : 0);
+}
+
+void FrameReadback::resize(VkExtent2D extent, VkFormat imageFormat, ReadbackFormat requested)
+{
+	destroy_buffers();
+	_extent = extent;
+	_imageFormat = imageFormat;
+
+	_format = requested;
+	if (_format == ReadbackFormat::Nv12 && (!_nv12.valid() || !Nv12Converter::supports(extent)))
+	{
+		_format = ReadbackFormat::Rgba;
+	}
+	_size = _format == ReadbackFormat::Nv12 ? Nv12Converter::buffer_size(extent) : VkDeviceSize(extent.width) * extent.height * 4;
+
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.pNext = nullptr;
+	bufferInfo.size = _size;
+	bufferInfo.usage = _format == ReadbackFormat::Nv12 ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.usage = VMA_MEMORY_USAGE_GPU_TO_CPU;
+
+	for (Slot& slot : _slots)
+	{
+		// mapped for as long as the buffer lives; deliver() invalidates before reading
+		VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &allocInfo, &slot.buffer._buffer, &slot.buffer._allocation, nullptr));
+		VK_CHECK(vmaMapMemory(_allocator, slot.buffer._allocation, &slot.mapped));
+		slot.frame = -1;
+	}
+}
+
+void FrameReadback::destroy_buffers()
+{
+	for (Slot& slot : _slots)
+	{
+		if (slot.buffer._buffer == VK_NULL_HANDLE)
+		{
+			continue;
+		}
+		vmaUnmapMemory(_allocator, slot.buffer._allocation);
+		vmaDestroyBuffer(_allocator, slot.buffer._buffer, slot.buffer._allocation);
+		slot.buffer = {};
+		slot.mapped = nullptr;
+		slot.frame = -1;
+	}
+}
+
+void FrameReadback::record(VkCommandBuffer cmd, uint32_t frameIndex, int frameNumber, VkImage image, VkImageView view, VkImageLayout finalLayout)
+{
+	Slot& slot = _slots[frameIndex];
+	VkImageLayout layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	VkPipelineStageFlags lastStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+	if (_format == ReadbackFormat::Nv12)
+	{
+		// the transfer-stage transition that left the image here made its writes visible; this one only
+		// chains on to the compute shader
+		VkImageMemoryBarrier toSampled = vkinit::image_barrier(image, 0, VK_ACCESS_SHADER_READ_BIT,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toSampled);
+		layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		lastStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+		// the slot's last frame is done with its set, its fence has been waited for
+		_nv12.record(cmd, frameIndex, view, _imageFormat, _extent, slot.buffer._buffer);
+
+		// the fence alone doesn't make device writes visible to the host
+		VkBufferMemoryBarrier toHost = vkinit::buffer_barrier(slot.buffer._buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT);
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &toHost, 0, nullptr);
+	}
+	else
+	{
+		VkBufferImageCopy copy = {};
+		copy.bufferOffset = 0;
+		copy.bufferRowLength = 0;
+		copy.bufferImageHeight = 0;
+		copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copy.imageSubresource.mipLevel = 0;
+		copy.imageSubresource.baseArrayLayer = 0;
+		copy.imageSubresource.layerCount = 1;
+		copy.imageExtent = { _extent.width, _extent.height, 1 };
+		vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer._buffer, 1, &copy);
+
+		VkBufferMemoryBarrier toHost = vkinit::buffer_barrier(slot.buffer._buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT);
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &toHost, 0, nullptr);
+	}
+
+	if (finalLayout != layout)
+	{
+		// whatever writes the image next (the overlay, or the next frame) waits at color output or transfer;
+		// presentation is ordered by the semaphore
+		VkImageMemoryBarrier toFinal = vkinit::image_barrier(image, 0, 0, layout, finalLayout, VK_IMAGE_ASPECT_COLOR_BIT);
+		vkCmdPipelineBarrier(cmd, lastStage, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &toFinal);
+	}
+
+	slot.frame = frameNumber;
+}
+
+void FrameReadback::deliver(uint32_t frameIndex, const Callback& callback)
+{
+	Slot& slot = _slots[frameIndex];
+	if (slot.frame < 0)
+	{
+		return;
+	}
+
+	const int frameNumber = slot.frame;
+	slot.frame = -1;
+	if (!callback)
+	{
+		return;
+	}
+
+	vmaInvalidateAllocation(_allocator, slot.buffer._allocation, 0, VK_WHOLE_SIZE);
+	Result result;
+	result.frameNumber = frameNumber;
+	result.format = _format;
+	result.imageFormat = _imageFormat;
+	result.extent = _extent;
+	result.data = static_cast<const uint8_t*>(slot.mapped);
+	result.size = static_cast<size_t>(_size);
+	callback(result);
+}
+
+bool FrameReadback::write_ppm(const Result& result, const std::string& path)
+{
+	if (result.format != ReadbackFormat::Rgba)
+	{
+		return false;
+	}
+	std::ofstream out(path, std::ios::binary);
+	if (!out)
+	{
+		return false;
+	}
+
+	// PPM wants RGB; the swapchain formats the engine picks are usually BGRA
+	const bool bgra = result.imageFormat == VK_FORMAT_B8G8R8A8_SRGB || result.imageFormat == VK_FORMAT_B8G8R8A8_UNORM;
+	const uint32_t width = result.extent.width;
+	out << "P6\n" << width << " " << result.extent.height << "\n255\n";
+	std::vector<char> row(size_t(width) * 3);
+	for (uint32_t y = 0; y < result.extent.height; y++)
+	{
+		const uint8_t* src = result.data + size_t(y) * width * 4;
+		for (uint32_t x = 0; x < width; x++)
+		{
+			row[x * 3 + 0] = static_cast<char>(src[x * 4 + (bgra ? 2 : 0)]);
+			row[x * 3 + 1] = static_cast<char>(src[x * 4 + 1]);
+			row[x * 3 + 2] = static_cast<char>(src[x * 4 + (bgra ? 0 : 2)]);
+		}
+		out.write(row.data(), static_cast<std::streamsize>(row.size()));
+	}
+	return out.good();
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vk_types.h>
+#include <DescriptorAllocator.h>
+#include <Nv12Converter.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+enum class ReadbackFormat {
+	Rgba, // the image's own 4 bytes per pixel, rows tightly packed
+	Nv12, // converted on the GPU: full size luma plane, then interleaved half size chroma; 1.5 bytes per pixel
+};
+
+// Copies the finished frame into host memory without waiting for it. Each frame slot owns a host-visible
+// buffer the frame writes its copy into; the buffer is handed out once the slot's fence has been waited for
+// anyway, by the next frame that uses the slot, so reading back never stalls the CPU on the GPU or the GPU
+// on the CPU. Nv12 runs a compute conversion first, which shrinks what crosses the bus to less than half.
+class FrameReadback
+{
+public:
+	// one finished readback, valid only while the callback runs
+	struct Result {
+		int frameNumber;
+		ReadbackFormat format;
+		VkFormat imageFormat; // of the image read, which Rgba data is in
+		VkExtent2D extent;
+		const uint8_t* data;
+		size_t size;
+	};
+	using Callback = std::function<void(const Result& result)>;
+
+	// without nv12Shader every readback is Rgba
+	void init(VkDevice device, VmaAllocator allocator, DescriptorAllocator& descriptors, VkShaderModule nv12Shader,
+		VkPipelineCache cache, uint32_t frameOverlap);
+	// the GPU must be done with every frame that read back
+	void cleanup();
+
+	// after every swapchain (re)build, with no frame in flight; pending readbacks are dropped. Nv12 falls back
+	// to Rgba without the shader, or unless the width is a multiple of 4 and the height of 2
+	void resize(VkExtent2D extent, VkFormat imageFormat, ReadbackFormat requested);
+	ReadbackFormat format() const { return _format; }
+	// image usage the images read back from need for format
+	static VkImageUsageFlags image_usage(ReadbackFormat format);
+
+	// after the frame's last write to image, which must have left it in TRANSFER_SRC_OPTIMAL readable by
+	// transfers; leaves it in finalLayout, where color output and transfers may write it next
+	void record(VkCommandBuffer cmd, uint32_t frameIndex, int frameNumber, VkImage image, VkImageView view, VkImageLayout finalLayout);
+	// after frameIndex's fence: hands the readback its frame recorded, if any, to callback
+	void deliver(uint32_t frameIndex, const Callback& callback);
+
+	// binary PPM of an Rgba result, alpha dropped; false for Nv12 or if path couldn't be written
+	static bool write_ppm(const Result& result, const std::string& path);
+
+private:
+	struct Slot {
+		AllocatedBuffer buffer{};
+		void* mapped{ nullptr };
+		int frame{ -1 }; // recorded and not delivered yet, -1 for none
+	};
+
+	void destroy_buffers();
+
+	VkDevice _device{ VK_NULL_HANDLE };
+	VmaAllocator _allocator{ nullptr };
+	Nv12Converter _nv12; // one set per slot
+
+	std::vector<Slot> _slots;
+	VkExtent2D _extent{ 0, 0 };
+	VkFormat _imageFormat{ VK_FORMAT_UNDEFINED };
+	ReadbackFormat _format{ ReadbackFormat::Rgba };
+	VkDeviceSize _size{ 0 };
+};
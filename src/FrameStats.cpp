@@ -0,0 +1,59 @@
+#include "FrameStats.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+	struct Registry {
+		std::mutex mutex;
+		// owned here rather than by the thread, so a thread that has exited still counts until collected
+		std::vector<std::unique_ptr<FrameStats>> threads;
+	};
+
+	Registry& registry()
+	{
+		static Registry instance;
+		return instance;
+	}
+
+	thread_local FrameStats* t_stats = nullptr;
+}
+
+FrameStats& FrameStats::operator+=(const FrameStats& other)
+{
+	drawCalls += other.drawCalls;
+	pipelineBinds += other.pipelineBinds;
+	vertexBufferBinds += other.vertexBufferBinds;
+	pushConstantUploads += other.pushConstantUploads;
+	trianglesSubmitted += other.trianglesSubmitted;
+	uploadBytes += other.uploadBytes;
+	return *this;
+}
+
+FrameStats& frame_stats::local()
+{
+	if (t_stats == nullptr)
+	{
+		// once per thread
+		auto stats = std::make_unique<FrameStats>();
+		Registry& r = registry();
+		std::lock_guard<std::mutex> lock(r.mutex);
+		t_stats = stats.get();
+		r.threads.push_back(std::move(stats));
+	}
+	return *t_stats;
+}
+
+FrameStats frame_stats::collect()
+{
+	Registry& r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	FrameStats total;
+	for (std::unique_ptr<FrameStats>& stats : r.threads)
+	{
+		total += *stats;
+		*stats = {};
+	}
+	return total;
+}
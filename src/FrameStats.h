@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+// Command counts of one frame, for catching CPU overhead regressions that timings are too noisy to show.
+// The draw path and the uploaders count into the calling thread's own FrameStats, so secondary buffers
+// recorded in parallel need no atomics; frame_stats::collect() sums and clears them all once a frame.
+// Triangles after GPU culling aren't known on the CPU; they come from the pipeline statistics.
+struct FrameStats {
+	uint32_t drawCalls{ 0 }; // vkCmdDraw* and mesh task dispatches; an indirect call counts once
+	uint32_t pipelineBinds{ 0 };
+	uint32_t vertexBufferBinds{ 0 }; // vkCmdBindVertexBuffers calls
+	uint32_t pushConstantUploads{ 0 };
+	// in the recorded draws; indirect ones count everything they could draw, before the cull shader
+	uint64_t trianglesSubmitted{ 0 };
+	uint64_t uploadBytes{ 0 }; // staged through the UploadManager
+
+	FrameStats& operator+=(const FrameStats& other);
+};
+
+namespace frame_stats {
+	// the calling thread's counters
+	FrameStats& local();
+	// sums every thread's counters and resets them. Only once the frame's recording jobs have finished,
+	// while no other thread is counting
+	FrameStats collect();
+}
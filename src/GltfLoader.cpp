@@ -0,0 +1,813 @@
+#include "GltfLoader.h"
+
+#include "Log.h"
+
+#include <glm/mat4x4.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtx/matrix_decompose.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <utility>
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	double elapsed_ms(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	constexpr uint32_t GLB_MAGIC = 0x46546C67; // "glTF"
+	constexpr uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+	constexpr uint32_t GLB_CHUNK_BIN = 0x004E4942;
+	constexpr uint32_t GLTF_TRIANGLES = 4;
+	// nesting deeper than any real document; keeps a hostile one from overflowing the stack
+	constexpr int JSON_MAX_DEPTH = 64;
+
+	// just enough of a DOM for glTF: objects keep their members in file order and are searched linearly,
+	// which their handful of keys makes faster than any map
+	struct JsonValue {
+		enum class Type { Null, Bool, Number, String, Array, Object };
+		Type type{ Type::Null };
+		bool boolean{ false };
+		double number{ 0.0 };
+		std::string string;
+		std::vector<JsonValue> items;
+		std::vector<std::pair<std::string, JsonValue>> members;
+
+		const JsonValue* find(const char* key) const
+		{
+			for (const auto& member : members)
+			{
+				if (member.first == key)
+				{
+					return &member.second;
+				}
+			}
+			return nullptr;
+		}
+
+		double number_or(const char* key, double fallback) const
+		{
+			const JsonValue* value = find(key);
+			return value != nullptr && value->type == Type::Number ? value->number : fallback;
+		}
+
+		int64_t index_or(const char* key, int64_t fallback) const
+		{
+			return static_cast<int64_t>(number_or(key, static_cast<double>(fallback)));
+		}
+
+		const std::string& string_or_empty(const char* key) const
+		{
+			static const std::string empty;
+			const JsonValue* value = find(key);
+			return value != nullptr && value->type == Type::String ? value->string : empty;
+		}
+
+		// items of the array at key; empty when it's missing or not an array
+		const std::vector<JsonValue>& array(const char* key) const
+		{
+			static const std::vector<JsonValue> empty;
+			const JsonValue* value = find(key);
+			return value != nullptr && value->type == Type::Array ? value->items : empty;
+		}
+
+		// up to count numbers of the array at key into out; false, leaving out alone, unless there are count
+		bool numbers(const char* key, float* out, size_t count) const
+		{
+			const std::vector<JsonValue>& values = array(key);
+			if (values.size() != count)
+			{
+				return false;
+			}
+			for (size_t i = 0; i < count; i++)
+			{
+				out[i] = static_cast<float>(values[i].number);
+			}
+			return true;
+		}
+	};
+
+	class JsonParser
+	{
+	public:
+		JsonParser(const char* text, size_t size) : _p(text), _end(text + size) {}
+
+		bool parse(JsonValue& out)
+		{
+			if (!value(out, 0))
+			{
+				return false;
+			}
+			skip_space();
+			return _p == _end;
+		}
+
+	private:
+		void skip_space()
+		{
+			while (_p < _end && (*_p == ' ' || *_p == '\t' || *_p == '\n' || *_p == '\r'))
+			{
+				_p++;
+			}
+		}
+
+		bool literal(const char* word)
+		{
+			const size_t length = strlen(word);
+			if (static_cast<size_t>(_end - _p) < length || memcmp(_p, word, length) != 0)
+			{
+				return false;
+			}
+			_p += length;
+			return true;
+		}
+
+		bool value(JsonValue& out, int depth)
+		{
+			skip_space();
+			if (_p == _end || depth > JSON_MAX_DEPTH)
+			{
+				return false;
+			}
+			switch (*_p)
+			{
+			case '{':
+				return object(out, depth);
+			case '[':
+				return array(out, depth);
+			case '"':
+				out.type = JsonValue::Type::String;
+				return string(out.string);
+			case 't':
+				out.type = JsonValue::Type::Bool;
+				out.boolean = true;
+				return literal("true");
+			case 'f':
+				out.type = JsonValue::Type::Bool;
+				return literal("false");
+			case 'n':
+				return literal("null");
+			default:
+				return number(out);
+			}
+		}
+
+		bool object(JsonValue& out, int depth)
+		{
+			out.type = JsonValue::Type::Object;
+			_p++;
+			skip_space();
+			if (_p < _end && *_p == '}')
+			{
+				_p++;
+				return true;
+			}
+			while (true)
+			{
+				skip_space();
+				std::pair<std::string, JsonValue> member;
+				if (_p == _end || *_p != '"' || !string(member.first))
+				{
+					return false;
+				}
+				skip_space();
+				if (_p == _end || *_p++ != ':' || !value(member.second, depth + 1))
+				{
+					return false;
+				}
+				out.members.push_back(std::move(member));
+				skip_space();
+				if (_p == _end)
+				{
+					return false;
+				}
+				const char next = *_p++;
+				if (next == '}')
+				{
+					return true;
+				}
+				if (next != ',')
+				{
+					return false;
+				}
+			}
+		}
+
+		bool array(JsonValue& out, int depth)
+		{
+			out.type = JsonValue::Type::Array;
+			_p++;
+			skip_space();
+			if (_p < _end && *_p == ']')
+			{
+				_p++;
+				return true;
+			}
+			while (true)
+			{
+				out.items.emplace_back();
+				if (!value(out.items.back(), depth + 1))
+				{
+					return false;
+				}
+				skip_space();
+				if (_p == _end)
+				{
+					return false;
+				}
+				const char next = *_p++;
+				if (next == ']')
+				{
+					return true;
+				}
+				if (next != ',')
+				{
+					return false;
+				}
+			}
+		}
+
+		bool hex4(uint32_t& out)
+		{
+			if (_end - _p < 4)
+			{
+				return false;
+			}
+			out = 0;
+			for (int i = 0; i < 4; i++)
+			{
+				const char c = *_p++;
+				out <<= 4;
+				if (c >= '0' && c <= '9') out |= c - '0';
+				else if (c >= 'a' && c <= 'f') out |= c - 'a' + 10;
+				else if (c >= 'A' && c <= 'F') out |= c - 'A' + 10;
+				else return false;
+			}
+			return true;
+		}
+
+		static void append_utf8(std::string& out, uint32_t code)
+		{
+			if (code < 0x80)
+			{
+				out += static_cast<char>(code);
+			}
+			else if (code < 0x800)
+			{
+				out += static_cast<char>(0xC0 | (code >> 6));
+				out += static_cast<char>(0x80 | (code & 0x3F));
+			}
+			else if (code < 0x10000)
+			{
+				out += static_cast<char>(0xE0 | (code >> 12));
+				out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+				out += static_cast<char>(0x80 | (code & 0x3F));
+			}
+			else
+			{
+				out += static_cast<char>(0xF0 | (code >> 18));
+				out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+				out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+				out += static_cast<char>(0x80 | (code & 0x3F));
+			}
+		}
+
+		bool string(std::string& out)
+		{
+			_p++;
+			while (_p < _end && *_p != '"')
+			{
+				if (*_p != '\\')
+				{
+					out += *_p++;
+					continue;
+				}
+				if (++_p == _end)
+				{
+					return false;
+				}
+				const char escaped = *_p++;
+				switch (escaped)
+				{
+				case '"': out += '"'; break;
+				case '\\': out += '\\'; break;
+				case '/': out += '/'; break;
+				case 'b': out += '\b'; break;
+				case 'f': out += '\f'; break;
+				case 'n': out += '\n'; break;
+				case 'r': out += '\r'; break;
+				case 't': out += '\t'; break;
+				case 'u':
+				{
+					uint32_t code;
+					if (!hex4(code))
+					{
+						return false;
+					}
+					// a surrogate pair spells one code point above the basic plane
+					uint32_t low;
+					if (code >= 0xD800 && code < 0xDC00 && _end - _p >= 6 && _p[0] == '\\' && _p[1] == 'u')
+					{
+						_p += 2;
+						if (!hex4(low))
+						{
+							return false;
+						}
+						code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+					}
+					append_utf8(out, code);
+					break;
+				}
+				default:
+					return false;
+				}
+			}
+			if (_p == _end)
+			{
+				return false;
+			}
+			_p++;
+			return true;
+		}
+
+		bool number(JsonValue& out)
+		{
+			// strtod wants a terminated string, and the text is a mapped file
+			char buffer[64];
+			size_t length = 0;
+			while (_p + length < _end && length < sizeof(buffer) - 1 && strchr("+-0123456789.eE", _p[length]) != nullptr)
+			{
+				buffer[length] = _p[length];
+				length++;
+			}
+			if (length == 0)
+			{
+				return false;
+			}
+			buffer[length] = '\0';
+			char* parsedEnd;
+			out.type = JsonValue::Type::Number;
+			out.number = strtod(buffer, &parsedEnd);
+			if (parsedEnd != buffer + length)
+			{
+				return false;
+			}
+			_p += length;
+			return true;
+		}
+
+		const char* _p;
+		const char* _end;
+	};
+
+	bool decode_base64(const char* text, size_t length, std::vector<uint8_t>& out)
+	{
+		uint32_t bits = 0;
+		int bitCount = 0;
+		out.reserve(length / 4 * 3);
+		for (size_t i = 0; i < length; i++)
+		{
+			const char c = text[i];
+			uint32_t value;
+			if (c >= 'A' && c <= 'Z') value = c - 'A';
+			else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+			else if (c >= '0' && c <= '9') value = c - '0' + 52;
+			else if (c == '+') value = 62;
+			else if (c == '/') value = 63;
+			else if (c == '=') break;
+			else return false;
+			bits = (bits << 6) | value;
+			bitCount += 6;
+			if (bitCount >= 8)
+			{
+				bitCount -= 8;
+				out.push_back(static_cast<uint8_t>(bits >> bitCount));
+			}
+		}
+		return true;
+	}
+
+	uint32_t component_size(uint32_t componentType)
+	{
+		switch (componentType)
+		{
+		case GLTF_BYTE:
+		case GLTF_UNSIGNED_BYTE:
+			return 1;
+		case GLTF_SHORT:
+		case GLTF_UNSIGNED_SHORT:
+			return 2;
+		case GLTF_UNSIGNED_INT:
+		case GLTF_FLOAT:
+			return 4;
+		default:
+			return 0;
+		}
+	}
+
+	uint32_t component_count(const std::string& type)
+	{
+		if (type == "SCALAR") return 1;
+		if (type == "VEC2") return 2;
+		if (type == "VEC3") return 3;
+		if (type == "VEC4") return 4;
+		return 0;
+	}
+
+	struct BufferSpan {
+		const uint8_t* data;
+		size_t size;
+	};
+
+	struct BufferView {
+		const uint8_t* data{ nullptr };
+		size_t size{ 0 };
+		uint32_t stride{ 0 };
+	};
+}
+
+void gltf_read_floats(const GltfAccessor& accessor, size_t element, float* out)
+{
+	const uint8_t* source = accessor.data + element * accessor.stride;
+	for (uint32_t c = 0; c < accessor.components; c++)
+	{
+		switch (accessor.componentType)
+		{
+		case GLTF_FLOAT:
+			memcpy(&out[c], source + c * 4, 4);
+			break;
+		case GLTF_BYTE:
+		{
+			const float value = static_cast<float>(static_cast<int8_t>(source[c]));
+			out[c] = accessor.normalized ? std::max(value / 127.f, -1.f) : value;
+			break;
+		}
+		case GLTF_UNSIGNED_BYTE:
+			out[c] = accessor.normalized ? source[c] / 255.f : source[c];
+			break;
+		case GLTF_SHORT:
+		{
+			int16_t value;
+			memcpy(&value, source + c * 2, 2);
+			out[c] = accessor.normalized ? std::max(value / 32767.f, -1.f) : value;
+			break;
+		}
+		case GLTF_UNSIGNED_SHORT:
+		{
+			uint16_t value;
+			memcpy(&value, source + c * 2, 2);
+			out[c] = accessor.normalized ? value / 65535.f : value;
+			break;
+		}
+		case GLTF_UNSIGNED_INT:
+		{
+			uint32_t value;
+			memcpy(&value, source + c * 4, 4);
+			out[c] = static_cast<float>(value);
+			break;
+		}
+		}
+	}
+}
+
+uint32_t gltf_read_index(const GltfAccessor& accessor, size_t element)
+{
+	const uint8_t* source = accessor.data + element * accessor.stride;
+	switch (accessor.componentType)
+	{
+	case GLTF_UNSIGNED_BYTE:
+		return source[0];
+	case GLTF_UNSIGNED_SHORT:
+	{
+		uint16_t value;
+		memcpy(&value, source, 2);
+		return value;
+	}
+	default:
+	{
+		uint32_t value;
+		memcpy(&value, source, 4);
+		return value;
+	}
+	}
+}
+
+bool GltfDocument::load(const char* path, GltfLoadTimings* timings)
+{
+	close();
+	auto start = Clock::now();
+	if (!_file.open(path))
+	{
+		return false;
+	}
+	const double mapMs = elapsed_ms(start);
+
+	start = Clock::now();
+	// a GLB is a header and then chunks: the JSON, then optionally the binary buffer
+	const char* json = reinterpret_cast<const char*>(_file.data());
+	size_t jsonSize = _file.size();
+	BufferSpan binChunk = { nullptr, 0 };
+	uint32_t magic = 0;
+	if (_file.size() >= 4)
+	{
+		memcpy(&magic, _file.data(), 4);
+	}
+	if (magic == GLB_MAGIC)
+	{
+		uint32_t header[3];
+		if (_file.size() < 20)
+		{
+			LOG_WARN(path << ": truncated GLB header");
+			close();
+			return false;
+		}
+		memcpy(header, _file.data(), sizeof(header));
+		const size_t length = std::min<size_t>(header[2], _file.size());
+		json = nullptr;
+		for (size_t offset = 12; offset + 8 <= length;)
+		{
+			uint32_t chunk[2];
+			memcpy(chunk, _file.data() + offset, sizeof(chunk));
+			const uint8_t* data = _file.data() + offset + 8;
+			if (chunk[0] > length - offset - 8)
+			{
+				break;
+			}
+			if (chunk[1] == GLB_CHUNK_JSON && json == nullptr)
+			{
+				json = reinterpret_cast<const char*>(data);
+				jsonSize = chunk[0];
+			}
+			else if (chunk[1] == GLB_CHUNK_BIN && binChunk.data == nullptr)
+			{
+				binChunk = { data, chunk[0] };
+			}
+			// chunks are 4-byte aligned
+			offset += 8 + ((chunk[0] + 3) & ~size_t(3));
+		}
+		if (header[1] != 2 || json == nullptr)
+		{
+			LOG_WARN(path << ": not a glTF 2.0 GLB");
+			close();
+			return false;
+		}
+	}
+
+	JsonValue root;
+	if (!JsonParser(json, jsonSize).parse(root) || root.type != JsonValue::Type::Object)
+	{
+		LOG_WARN(path << ": malformed glTF JSON");
+		close();
+		return false;
+	}
+
+	// external buffers are next to the document
+	std::string folder = path;
+	const size_t slash = folder.find_last_of("/\\");
+	folder = slash == std::string::npos ? std::string() : folder.substr(0, slash + 1);
+
+	std::vector<BufferSpan> buffers;
+	for (const JsonValue& buffer : root.array("buffers"))
+	{
+		const std::string& uri = buffer.string_or_empty("uri");
+		BufferSpan span = { nullptr, 0 };
+		if (uri.empty())
+		{
+			span = binChunk;
+		}
+		else if (uri.compare(0, 5, "data:") == 0)
+		{
+			const size_t comma = uri.find(',');
+			_embeddedBuffers.emplace_back();
+			if (comma != std::string::npos && decode_base64(uri.data() + comma + 1, uri.size() - comma - 1, _embeddedBuffers.back()))
+			{
+				span = { _embeddedBuffers.back().data(), _embeddedBuffers.back().size() };
+			}
+		}
+		else
+		{
+			_externalBuffers.push_back(std::make_unique<MappedFile>());
+			if (_externalBuffers.back()->open((folder + uri).c_str()))
+			{
+				span = { _externalBuffers.back()->data(), _externalBuffers.back()->size() };
+			}
+		}
+		// the file may be padded past the buffer, never cut short of it
+		const size_t byteLength = static_cast<size_t>(buffer.number_or("byteLength", 0.0));
+		if (span.data == nullptr || span.size < byteLength)
+		{
+			LOG_WARN(path << ": buffer " << buffers.size() << " is missing or too short");
+			span = { nullptr, 0 };
+		}
+		buffers.push_back(span);
+	}
+
+	std::vector<BufferView> views;
+	for (const JsonValue& view : root.array("bufferViews"))
+	{
+		BufferView resolved;
+		const int64_t buffer = view.index_or("buffer", -1);
+		const size_t offset = static_cast<size_t>(view.number_or("byteOffset", 0.0));
+		const size_t length = static_cast<size_t>(view.number_or("byteLength", 0.0));
+		if (buffer >= 0 && static_cast<size_t>(buffer) < buffers.size() && buffers[buffer].data != nullptr
+			&& offset <= buffers[buffer].size && length <= buffers[buffer].size - offset)
+		{
+			resolved.data = buffers[buffer].data + offset;
+			resolved.size = length;
+			resolved.stride = static_cast<uint32_t>(view.number_or("byteStride", 0.0));
+		}
+		views.push_back(resolved);
+	}
+
+	// accessors that don't fit their view, or need sparse substitution, resolve to nothing
+	std::vector<GltfAccessor> accessors;
+	for (const JsonValue& accessor : root.array("accessors"))
+	{
+		GltfAccessor resolved;
+		const int64_t view = accessor.index_or("bufferView", -1);
+		const uint32_t componentType = static_cast<uint32_t>(accessor.number_or("componentType", 0.0));
+		const uint32_t components = component_count(accessor.string_or_empty("type"));
+		const uint32_t elementSize = component_size(componentType) * components;
+		const size_t count = static_cast<size_t>(accessor.number_or("count", 0.0));
+		const size_t offset = static_cast<size_t>(accessor.number_or("byteOffset", 0.0));
+		if (view >= 0 && static_cast<size_t>(view) < views.size() && views[view].data != nullptr && elementSize != 0 && count > 0
+			&& accessor.find("sparse") == nullptr)
+		{
+			const BufferView& source = views[view];
+			const uint32_t stride = source.stride != 0 ? source.stride : elementSize;
+			if (offset <= source.size && (count - 1) * stride + elementSize <= source.size - offset)
+			{
+				resolved.data = source.data + offset;
+				resolved.count = count;
+				resolved.stride = stride;
+				resolved.componentType = componentType;
+				resolved.components = components;
+				const JsonValue* normalized = accessor.find("normalized");
+				resolved.normalized = normalized != nullptr && normalized->boolean;
+			}
+		}
+		accessors.push_back(resolved);
+	}
+	auto accessor_at = [&](const JsonValue* index) {
+		if (index == nullptr || index->type != JsonValue::Type::Number || index->number < 0 || index->number >= accessors.size())
+		{
+			return GltfAccessor{};
+		}
+		return accessors[static_cast<size_t>(index->number)];
+	};
+
+	for (const JsonValue& material : root.array("materials"))
+	{
+		GltfMaterial resolved;
+		resolved.name = material.string_or_empty("name");
+		const JsonValue* pbr = material.find("pbrMetallicRoughness");
+		if (pbr != nullptr)
+		{
+			pbr->numbers("baseColorFactor", &resolved.baseColor.x, 4);
+		}
+		_materials.push_back(resolved);
+	}
+
+	for (const JsonValue& mesh : root.array("meshes"))
+	{
+		GltfMesh resolved;
+		resolved.name = mesh.string_or_empty("name");
+		for (const JsonValue& primitive : mesh.array("primitives"))
+		{
+			const JsonValue* attributes = primitive.find("attributes");
+			if (primitive.index_or("mode", GLTF_TRIANGLES) != GLTF_TRIANGLES || attributes == nullptr)
+			{
+				LOG_WARN(path << ": skipping a primitive of mesh " << _meshes.size() << " that isn't a triangle list");
+				continue;
+			}
+			GltfPrimitive geometry;
+			geometry.position = accessor_at(attributes->find("POSITION"));
+			geometry.normal = accessor_at(attributes->find("NORMAL"));
+			geometry.color = accessor_at(attributes->find("COLOR_0"));
+			geometry.texcoord = accessor_at(attributes->find("TEXCOORD_0"));
+			geometry.indices = accessor_at(primitive.find("indices"));
+			const int64_t material = primitive.index_or("material", -1);
+			geometry.material = material >= 0 && static_cast<size_t>(material) < _materials.size() ? static_cast<int32_t>(material) : -1;
+			// attributes only make sense per position; indices must be integers
+			const size_t vertexCount = geometry.position.count;
+			const bool valid = geometry.position.data != nullptr && geometry.position.components == 3
+				&& (geometry.normal.data == nullptr || (geometry.normal.count == vertexCount && geometry.normal.components == 3))
+				&& (geometry.color.data == nullptr || (geometry.color.count == vertexCount && geometry.color.components >= 3))
+				&& (geometry.indices.data == nullptr || (geometry.indices.components == 1 && geometry.indices.componentType != GLTF_FLOAT
+					&& geometry.indices.componentType != GLTF_BYTE && geometry.indices.componentType != GLTF_SHORT));
+			if (!valid)
+			{
+				LOG_WARN(path << ": skipping a primitive of mesh " << _meshes.size() << " with unreadable attributes");
+				continue;
+			}
+			resolved.primitives.push_back(geometry);
+		}
+		_meshes.push_back(std::move(resolved));
+	}
+
+	// the default scene's roots, or every node nobody parents when there is no scene
+	const std::vector<JsonValue>& nodes = root.array("nodes");
+	std::vector<uint32_t> roots;
+	const std::vector<JsonValue>& scenes = root.array("scenes");
+	const int64_t scene = root.index_or("scene", 0);
+	if (scene >= 0 && static_cast<size_t>(scene) < scenes.size())
+	{
+		for (const JsonValue& node : scenes[scene].array("nodes"))
+		{
+			roots.push_back(static_cast<uint32_t>(node.number));
+		}
+	}
+	else
+	{
+		std::vector<bool> parented(nodes.size(), false);
+		for (const JsonValue& node : nodes)
+		{
+			for (const JsonValue& child : node.array("children"))
+			{
+				if (child.number >= 0 && child.number < nodes.size())
+				{
+					parented[static_cast<size_t>(child.number)] = true;
+				}
+			}
+		}
+		for (uint32_t i = 0; i < nodes.size(); i++)
+		{
+			if (!parented[i])
+			{
+				roots.push_back(i);
+			}
+		}
+	}
+
+	// depth first, so every parent is emitted before its children; a node reached twice is kept once
+	std::vector<bool> visited(nodes.size(), false);
+	std::vector<std::pair<uint32_t, int32_t>> stack; // (node, index of its parent in _nodes)
+	for (auto root = roots.rbegin(); root != roots.rend(); ++root)
+	{
+		stack.push_back({ *root, -1 });
+	}
+	while (!stack.empty())
+	{
+		const uint32_t index = stack.back().first;
+		const int32_t parent = stack.back().second;
+		stack.pop_back();
+		if (index >= nodes.size() || visited[index])
+		{
+			continue;
+		}
+		visited[index] = true;
+
+		const JsonValue& node = nodes[index];
+		GltfNode resolved;
+		resolved.name = node.string_or_empty("name");
+		resolved.parent = parent;
+		const int64_t mesh = node.index_or("mesh", -1);
+		resolved.mesh = mesh >= 0 && static_cast<size_t>(mesh) < _meshes.size() ? static_cast<int32_t>(mesh) : -1;
+		float matrix[16];
+		if (node.numbers("matrix", matrix, 16))
+		{
+			glm::vec3 skew;
+			glm::vec4 perspective;
+			glm::decompose(glm::make_mat4(matrix), resolved.scale, resolved.rotation, resolved.translation, skew, perspective);
+		}
+		else
+		{
+			node.numbers("translation", &resolved.translation.x, 3);
+			node.numbers("scale", &resolved.scale.x, 3);
+			float rotation[4];
+			if (node.numbers("rotation", rotation, 4))
+			{
+				resolved.rotation = glm::quat(rotation[3], rotation[0], rotation[1], rotation[2]);
+			}
+		}
+		const int32_t self = static_cast<int32_t>(_nodes.size());
+		_nodes.push_back(resolved);
+
+		const std::vector<JsonValue>& children = node.array("children");
+		for (auto child = children.rbegin(); child != children.rend(); ++child)
+		{
+			stack.push_back({ static_cast<uint32_t>(child->number), self });
+		}
+	}
+
+	if (timings != nullptr)
+	{
+		timings->mapMs = mapMs;
+		timings->parseMs = elapsed_ms(start);
+	}
+	return true;
+}
+
+void GltfDocument::close()
+{
+	_meshes.clear();
+	_materials.clear();
+	_nodes.clear();
+	_embeddedBuffers.clear();
+	_externalBuffers.clear();
+	_file.close();
+}
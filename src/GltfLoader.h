@@ -0,0 +1,97 @@
+#pragma once
+
+#include "MappedFile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// glTF componentType values
+constexpr uint32_t GLTF_BYTE = 5120;
+constexpr uint32_t GLTF_UNSIGNED_BYTE = 5121;
+constexpr uint32_t GLTF_SHORT = 5122;
+constexpr uint32_t GLTF_UNSIGNED_SHORT = 5123;
+constexpr uint32_t GLTF_UNSIGNED_INT = 5125;
+constexpr uint32_t GLTF_FLOAT = 5126;
+
+// one accessor, resolved to where its first element sits in the document's buffers; data is null when
+// the primitive doesn't have the attribute
+struct GltfAccessor {
+	const uint8_t* data{ nullptr };
+	size_t count{ 0 };
+	uint32_t stride{ 0 }; // bytes between elements, the bufferView's byteStride or the element size
+	uint32_t componentType{ 0 };
+	uint32_t components{ 0 }; // 1 for SCALAR up to 4 for VEC4
+	bool normalized{ false };
+};
+
+// reads element of accessor as floats, up to four components; normalized integers map to [0, 1] or [-1, 1]
+void gltf_read_floats(const GltfAccessor& accessor, size_t element, float* out);
+// reads element of a SCALAR integer accessor
+uint32_t gltf_read_index(const GltfAccessor& accessor, size_t element);
+
+// a triangle list with one material; the other primitive modes are skipped at load
+struct GltfPrimitive {
+	GltfAccessor position;
+	GltfAccessor normal;
+	GltfAccessor color; // COLOR_0
+	GltfAccessor texcoord; // TEXCOORD_0
+	GltfAccessor indices; // none for non-indexed primitives, whose vertices are the triangle list
+	int32_t material{ -1 }; // -1 for the default material
+};
+
+struct GltfMesh {
+	std::string name;
+	std::vector<GltfPrimitive> primitives;
+};
+
+// metallic-roughness materials keep only the base color factor; no vertex format carries the UVs for the textures
+struct GltfMaterial {
+	std::string name;
+	glm::vec4 baseColor{ 1.f };
+};
+
+// a node of the default scene with its transform relative to the parent; matrices are decomposed
+struct GltfNode {
+	std::string name;
+	int32_t parent{ -1 }; // index into GltfDocument::nodes(), always lower than the node's own
+	int32_t mesh{ -1 };
+	glm::vec3 translation{ 0.f };
+	glm::quat rotation{ 1.f, 0.f, 0.f, 0.f };
+	glm::vec3 scale{ 1.f };
+};
+
+// milliseconds per stage of GltfDocument::load
+struct GltfLoadTimings {
+	double mapMs{ 0.0 };
+	double parseMs{ 0.0 };
+};
+
+// A .gltf or .glb file, parsed. The buffers are memory-mapped, the GLB binary chunk in place inside the file
+// itself, and accessors point straight into them, so converting to meshes reads the page cache once and
+// copies nothing on the way. Only data: URIs are decoded into memory of the document's own. Everything the
+// accessors point at lives until close().
+class GltfDocument
+{
+public:
+	bool load(const char* path, GltfLoadTimings* timings = nullptr);
+	void close();
+
+	const std::vector<GltfMesh>& meshes() const { return _meshes; }
+	const std::vector<GltfMaterial>& materials() const { return _materials; }
+	// the default scene's nodes, parents before their children, like TransformStore's
+	const std::vector<GltfNode>& nodes() const { return _nodes; }
+
+private:
+	MappedFile _file;
+	std::vector<std::unique_ptr<MappedFile>> _externalBuffers;
+	std::vector<std::vector<uint8_t>> _embeddedBuffers;
+	std::vector<GltfMesh> _meshes;
+	std::vector<GltfMaterial> _materials;
+	std::vector<GltfNode> _nodes;
+};
@@ -0,0 +1,149 @@
+#include "GpuBreadcrumbs.h"
+
+#include "Log.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <sstream>
+
+void GpuBreadcrumbs::init(VmaAllocator allocator, uint32_t frameCount, PFN_vkVoidFunction writeBufferMarker)
+{
+	_allocator = allocator;
+	_writeBufferMarker = writeBufferMarker;
+	_slots.assign(frameCount, FrameSlot{});
+
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.pNext = nullptr;
+	bufferInfo.size = sizeof(Markers) * frameCount;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+	// only ever read by the host, and only once the device is gone
+	VmaAllocationCreateInfo vmaAllocInfo = {};
+	vmaAllocInfo.usage = VMA_MEMORY_USAGE_GPU_TO_CPU;
+	vmaAllocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+	VmaAllocationInfo allocationInfo = {};
+	if (vmaCreateBuffer(_allocator, &bufferInfo, &vmaAllocInfo, &_buffer._buffer, &_buffer._allocation, &allocationInfo) != VK_SUCCESS)
+	{
+		LOG_WARN("GPU breadcrumbs disabled: no host-visible memory for the markers");
+		_buffer = {};
+		return;
+	}
+	// a slot never written reads as never reached
+	memset(allocationInfo.pMappedData, 0, sizeof(Markers) * frameCount);
+	vmaFlushAllocation(_allocator, _buffer._allocation, 0, VK_WHOLE_SIZE);
+	_markers = static_cast<const Markers*>(allocationInfo.pMappedData);
+}
+
+void GpuBreadcrumbs::cleanup()
+{
+	if (_buffer._buffer != VK_NULL_HANDLE)
+	{
+		vmaDestroyBuffer(_allocator, _buffer._buffer, _buffer._allocation);
+	}
+	_buffer = {};
+	_markers = nullptr;
+	_slots.clear();
+}
+
+void GpuBreadcrumbs::begin_frame(uint32_t frameIndex, int frameNumber)
+{
+	if (!is_enabled())
+	{
+		return;
+	}
+	_current = frameIndex;
+	_slots[frameIndex].frameNumber = frameNumber;
+	_slots[frameIndex].passCount = 0;
+	_openCount = 0;
+}
+
+void GpuBreadcrumbs::begin_pass(VkCommandBuffer cmd, const char* name)
+{
+	if (!is_enabled() || _openCount >= MAX_PASSES)
+	{
+		return;
+	}
+
+	FrameSlot& slot = _slots[_current];
+	if (slot.passCount >= MAX_PASSES)
+	{
+		// still pushed, so the end_pass that closes it pops the right entry
+		_open[_openCount++] = UINT32_MAX;
+		return;
+	}
+
+	const uint32_t pass = slot.passCount++;
+	strncpy(slot.names[pass], name, MAX_NAME - 1);
+	slot.names[pass][MAX_NAME - 1] = '\0';
+	slot.depth[pass] = _openCount;
+	_open[_openCount++] = pass;
+
+	write(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, _current * sizeof(Markers) + offsetof(Markers, begun) + pass * sizeof(uint32_t));
+}
+
+void GpuBreadcrumbs::end_pass(VkCommandBuffer cmd)
+{
+	if (!is_enabled() || _openCount == 0)
+	{
+		return;
+	}
+
+	const uint32_t pass = _open[--_openCount];
+	if (pass != UINT32_MAX)
+	{
+		// bottom of pipe: written once everything recorded before it has completed
+		write(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, _current * sizeof(Markers) + offsetof(Markers, ended) + pass * sizeof(uint32_t));
+	}
+}
+
+void GpuBreadcrumbs::write(VkCommandBuffer cmd, VkPipelineStageFlagBits stage, VkDeviceSize offset)
+{
+	// frame numbers start at 0, and 0 is what the buffer starts out as
+	const uint32_t marker = static_cast<uint32_t>(_slots[_current].frameNumber) + 1;
+	if (_writeBufferMarker != nullptr)
+	{
+		reinterpret_cast<PFN_vkCmdWriteBufferMarkerAMD>(_writeBufferMarker)(cmd, stage, _buffer._buffer, offset, marker);
+	}
+	else
+	{
+		vkCmdFillBuffer(cmd, _buffer._buffer, offset, sizeof(uint32_t), marker);
+	}
+}
+
+std::string GpuBreadcrumbs::report() const
+{
+	if (!is_enabled())
+	{
+		return "No GPU breadcrumbs";
+	}
+	vmaInvalidateAllocation(_allocator, _buffer._allocation, 0, VK_WHOLE_SIZE);
+
+	std::vector<uint32_t> order;
+	for (uint32_t i = 0; i < _slots.size(); i++)
+	{
+		if (_slots[i].frameNumber >= 0)
+		{
+			order.push_back(i);
+		}
+	}
+	std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return _slots[a].frameNumber < _slots[b].frameNumber; });
+
+	std::ostringstream out;
+	out << "GPU breadcrumbs (" << (uses_buffer_markers() ? "VK_AMD_buffer_marker" : "vkCmdFillBuffer, finished passes approximate") << "):";
+	for (uint32_t index : order)
+	{
+		const FrameSlot& slot = _slots[index];
+		const Markers& markers = _markers[index];
+		const uint32_t marker = static_cast<uint32_t>(slot.frameNumber) + 1;
+		out << "\n  frame " << slot.frameNumber << ":";
+		for (uint32_t pass = 0; pass < slot.passCount; pass++)
+		{
+			const char* state = markers.ended[pass] == marker ? "done" : (markers.begun[pass] == marker ? "STARTED" : "not reached");
+			out << (pass == 0 ? " " : ", ") << std::string(slot.depth[pass], '>') << slot.names[pass] << " " << state;
+		}
+	}
+	return out.str();
+}
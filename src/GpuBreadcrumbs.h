@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vk_types.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Where the GPU was when it stopped answering. Every pass writes a marker into a host-visible buffer as it
+// starts and another once it has finished, tagged with the frame number; after VK_ERROR_DEVICE_LOST,
+// report() reads them back and names, for each frame in flight, the passes that finished, the ones that
+// started and never finished (where the hang or fault is) and the ones never reached. Two tiny transfer
+// commands per pass and no readback while things work, so it stays on in release builds.
+// With VK_AMD_buffer_marker the markers are written at the top and bottom of the pipe, so a finished
+// marker means the pass's work really completed; vkCmdFillBuffer stands in elsewhere, which the GPU may
+// run ahead of the pass's draws, so there a finished marker only says the pass's commands were reached.
+class GpuBreadcrumbs
+{
+public:
+	static constexpr uint32_t MAX_PASSES = 64; // per frame, nested ones included; the rest go unmarked
+	static constexpr uint32_t MAX_NAME = 32; // characters of a pass name kept
+
+	// writeBufferMarker is vkCmdWriteBufferMarkerAMD, or null to use vkCmdFillBuffer
+	void init(VmaAllocator allocator, uint32_t frameCount, PFN_vkVoidFunction writeBufferMarker);
+	void cleanup();
+
+	bool is_enabled() const { return _buffer._buffer != VK_NULL_HANDLE; }
+	bool uses_buffer_markers() const { return _writeBufferMarker != nullptr; }
+
+	// at the start of the frame's command buffer, once the slot's previous frame is known to have finished
+	void begin_frame(uint32_t frameIndex, int frameNumber);
+	// outside any render pass. Passes nest; end_pass closes the innermost one still open
+	void begin_pass(VkCommandBuffer cmd, const char* name);
+	void end_pass(VkCommandBuffer cmd);
+
+	// after a device loss: what every frame in flight got through, oldest first, one line per frame
+	std::string report() const;
+
+private:
+	// what the GPU writes, per frame slot: each pass's frame number + 1 when it starts and when it ends
+	struct Markers {
+		uint32_t begun[MAX_PASSES];
+		uint32_t ended[MAX_PASSES];
+	};
+
+	struct FrameSlot {
+		int frameNumber{ -1 };
+		uint32_t passCount{ 0 };
+		char names[MAX_PASSES][MAX_NAME];
+		uint32_t depth[MAX_PASSES]; // nesting, for the report
+	};
+
+	void write(VkCommandBuffer cmd, VkPipelineStageFlagBits stage, VkDeviceSize offset);
+
+	VmaAllocator _allocator{ VK_NULL_HANDLE };
+	AllocatedBuffer _buffer{};
+	const Markers* _markers{ nullptr }; // mapped, one per slot
+	PFN_vkVoidFunction _writeBufferMarker{ nullptr };
+
+	std::vector<FrameSlot> _slots;
+	uint32_t _current{ 0 };
+	uint32_t _open[MAX_PASSES]; // stack of the passes begun and not ended yet
+	uint32_t _openCount{ 0 };
+};
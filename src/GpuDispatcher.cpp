@@ -0,0 +1,142 @@
+#include "GpuDispatcher.h"
+
+#include "Log.h"
+
+void GpuDispatcher::start(const std::vector<GpuSelection>& gpus, const Configure& configure)
+{
+	for (uint32_t i = 0; i < gpus.size(); i++)
+	{
+		auto worker = std::make_unique<Worker>();
+		worker->engine = std::make_unique<VulkanEngine>();
+		worker->engine->_gpuSelection = gpus[i];
+		worker->engine->_headless = true;
+		// every device compiles its own pipelines; one shared cache file would be rewritten by each
+		worker->engine->_pipelineCachePath = "pipeline_cache_gpu" + std::to_string(i) + ".bin";
+		for (uint32_t j = 0; j < i; j++)
+		{
+			if (gpus[j].index == gpus[i].index && gpus[j].uuid == gpus[i].uuid && gpus[j].preference == gpus[i].preference)
+			{
+				worker->shareWith = _workers[j]->engine.get();
+				break;
+			}
+		}
+		_workers.push_back(std::move(worker));
+	}
+
+	// an engine sharing a device needs the one that created it initialized first
+	for (uint32_t i = 0; i < _workers.size(); i++)
+	{
+		Worker& worker = *_workers[i];
+		worker.thread = std::thread([this, &worker, i, configure]() { worker_loop(worker, i, configure); });
+
+		std::unique_lock<std::mutex> lock(_mutex);
+		_started.wait(lock, [this, i]() { return _startedCount == i + 1; });
+	}
+}
+
+void GpuDispatcher::submit(Job job)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_jobs.push_back(std::move(job));
+	}
+	_wake.notify_one();
+}
+
+void GpuDispatcher::finish()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_finishing = true;
+	}
+	_wake.notify_all();
+
+	for (uint32_t i = 0; i < _workers.size(); i++)
+	{
+		_workers[i]->thread.join();
+		if (!_workers[i]->started)
+		{
+			LOG_ERROR("GPU " << i << " failed to start");
+			continue;
+		}
+		LOG_INFO("GPU " << i << " (" << _workers[i]->engine->_gpuProperties.deviceName << ") ran "
+			<< _workers[i]->jobsRun << " jobs");
+	}
+	_workers.clear();
+	_jobs.clear();
+	_startedCount = 0;
+	_finishing = false;
+}
+
+void GpuDispatcher::worker_loop(Worker& worker, uint32_t gpu, const Configure& configure)
+{
+	{
+		std::lock_guard<std::mutex> lifetime(_lifetimeMutex);
+		if (configure)
+		{
+			configure(*worker.engine, gpu);
+		}
+		if (worker.shareWith != nullptr)
+		{
+			worker.engine->_deviceContext = worker.shareWith->device_context();
+		}
+		worker.started = worker.engine->init();
+	}
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_startedCount++;
+	}
+	_started.notify_all();
+	// the jobs go to the engines that did start; a failed init() has already undone itself
+	if (!worker.started)
+	{
+		return;
+	}
+
+	while (true)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_wake.wait(lock, [this]() { return _finishing || !_jobs.empty(); });
+			if (_jobs.empty())
+			{
+				break;
+			}
+			job = std::move(_jobs.front());
+			_jobs.pop_front();
+		}
+		job(*worker.engine, gpu);
+		worker.jobsRun++;
+		// the job died with the device; the other engines take what is left
+		if (worker.engine->device_lost())
+		{
+			LOG_ERROR("GPU " << gpu << " lost its device, it takes no more jobs");
+			break;
+		}
+	}
+
+	std::lock_guard<std::mutex> lifetime(_lifetimeMutex);
+	worker.engine->cleanup();
+}
+
+uint32_t GpuDispatcher::physical_device_count()
+{
+	VkApplicationInfo appInfo = {};
+	appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+	appInfo.apiVersion = VK_API_VERSION_1_1;
+
+	VkInstanceCreateInfo instanceInfo = {};
+	instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+	instanceInfo.pApplicationInfo = &appInfo;
+
+	VkInstance instance;
+	if (vkCreateInstance(&instanceInfo, nullptr, &instance) != VK_SUCCESS)
+	{
+		return 0;
+	}
+	uint32_t count = 0;
+	vkEnumeratePhysicalDevices(instance, &count, nullptr);
+	vkDestroyInstance(instance, nullptr);
+	return count;
+}
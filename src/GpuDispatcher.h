@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vk_engine.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs headless render jobs on several GPUs at once: one VulkanEngine per selected device, each pinned to it
+// and driven by its own thread. Jobs wait in one queue and whichever engine finishes first takes the next, so
+// a faster GPU ends up with more of them without any up-front split. A GPU listed more than once gets that
+// many sessions sharing one device, its pipeline cache and its queues.
+class GpuDispatcher
+{
+public:
+	using Job = std::function<void(VulkanEngine& engine, uint32_t gpu)>;
+	// called on an engine before its init(), after the dispatcher set its GPU and made it headless
+	using Configure = std::function<void(VulkanEngine& engine, uint32_t gpu)>;
+
+	// one engine per entry; engines start up one at a time, in order, and the call returns once all of them have
+	void start(const std::vector<GpuSelection>& gpus, const Configure& configure);
+	void submit(Job job);
+	// runs every job still queued, then cleans the engines up on their threads. Engines that failed to start
+	// or lost their device take no jobs, so with none left the rest stay queued and are dropped
+	void finish();
+
+	size_t engine_count() const { return _workers.size(); }
+	// devices the Vulkan loader enumerates, 0 if no instance could be created
+	static uint32_t physical_device_count();
+
+private:
+	struct Worker {
+		std::unique_ptr<VulkanEngine> engine;
+		VulkanEngine* shareWith{ nullptr }; // an earlier engine on the same GPU, whose device this one attaches to
+		std::thread thread;
+		uint32_t jobsRun{ 0 };
+		bool started{ false }; // init() succeeded; the others take no jobs
+	};
+
+	void worker_loop(Worker& worker, uint32_t gpu, const Configure& configure);
+
+	std::vector<std::unique_ptr<Worker>> _workers;
+	std::deque<Job> _jobs;
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	std::condition_variable _started;
+	uint32_t _startedCount{ 0 };
+	bool _finishing{ false };
+	// init() and cleanup() touch process-wide state: vk-bootstrap's loader table, SDL and the asset caches
+	std::mutex _lifetimeMutex;
+};
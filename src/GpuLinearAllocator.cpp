@@ -0,0 +1,88 @@
+#include "GpuLinearAllocator.h"
+
+#include <algorithm>
+
+void GpuLinearAllocator::init(VmaAllocator allocator, VkDeviceSize frameSize, uint32_t frameCount,
+	VkBufferUsageFlags usage, VkDeviceSize minAlignment, uint32_t queueFamilyCount, const uint32_t* queueFamilies, bool deviceLocal)
+{
+	_allocator = allocator;
+	_minAlignment = std::max<VkDeviceSize>(minAlignment, 1);
+	// every region starts aligned, so offsets only need aligning relative to the region
+	_frameSize = (frameSize + _minAlignment - 1) & ~(_minAlignment - 1);
+
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.pNext = nullptr;
+	bufferInfo.size = _frameSize * frameCount;
+	bufferInfo.usage = usage;
+	if (queueFamilyCount > 1)
+	{
+		bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		bufferInfo.queueFamilyIndexCount = queueFamilyCount;
+		bufferInfo.pQueueFamilyIndices = queueFamilies;
+	}
+
+	// mapped once for the allocator's lifetime
+	VmaAllocationCreateInfo vmaAllocInfo = {};
+	vmaAllocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+	vmaAllocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+	VmaAllocationInfo allocationInfo = {};
+	VkResult result = VK_ERROR_OUT_OF_DEVICE_MEMORY;
+	if (deviceLocal)
+	{
+		VmaAllocationCreateInfo barAllocInfo = vmaAllocInfo;
+		barAllocInfo.usage = VMA_MEMORY_USAGE_UNKNOWN;
+		barAllocInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+		result = vmaCreateBuffer(_allocator, &bufferInfo, &barAllocInfo, &_buffer._buffer, &_buffer._allocation, &allocationInfo);
+	}
+	if (result != VK_SUCCESS)
+	{
+		VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &vmaAllocInfo, &_buffer._buffer, &_buffer._allocation, &allocationInfo));
+	}
+	_mapped = static_cast<uint8_t*>(allocationInfo.pMappedData);
+	VkMemoryPropertyFlags memoryFlags = 0;
+	vmaGetMemoryTypeProperties(_allocator, allocationInfo.memoryType, &memoryFlags);
+	_deviceLocal = (memoryFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0;
+
+	_frameStart = 0;
+	_head = 0;
+}
+
+void GpuLinearAllocator::cleanup()
+{
+	vmaDestroyBuffer(_allocator, _buffer._buffer, _buffer._allocation);
+	_buffer = {};
+	_mapped = nullptr;
+}
+
+void GpuLinearAllocator::begin_frame(uint32_t frameIndex)
+{
+	_frameStart = _frameSize * frameIndex;
+	_head = _frameStart;
+}
+
+bool GpuLinearAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment, GpuAllocation* out)
+{
+	// both alignments are powers of two, so the larger one satisfies both
+	alignment = std::max(alignment, _minAlignment);
+	VkDeviceSize offset = (_head + alignment - 1) & ~(alignment - 1);
+	if (offset + size > _frameStart + _frameSize)
+	{
+		return false;
+	}
+
+	_head = offset + size;
+	out->buffer = _buffer._buffer;
+	out->offset = offset;
+	out->data = _mapped + offset;
+	return true;
+}
+
+void GpuLinearAllocator::flush()
+{
+	if (_head > _frameStart)
+	{
+		vmaFlushAllocation(_allocator, _buffer._allocation, _frameStart, _head - _frameStart);
+	}
+}
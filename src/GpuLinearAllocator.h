@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vk_types.h>
+
+// memory handed out by GpuLinearAllocator: bind buffer at offset, write through data
+struct GpuAllocation {
+	VkBuffer buffer{ VK_NULL_HANDLE };
+	VkDeviceSize offset{ 0 };
+	void* data{ nullptr };
+};
+
+// Persistently mapped, host-visible buffer split into one region per frame in flight, handed out with a
+// bump pointer. Streams per-frame data (uniforms, instances, debug geometry) to the GPU without creating
+// buffers or mapping memory in the draw path.
+// Everything allocated during a frame stays valid until that frame slot begins again, which must only
+// happen once its fence has signaled.
+class GpuLinearAllocator
+{
+public:
+	// minAlignment applies to every allocation; pass the device's uniform/storage offset alignment so any
+	// allocation can be bound as a (dynamic) descriptor. With queueFamilyCount families the buffer is shared
+	// concurrently between them. deviceLocal asks for DEVICE_LOCAL | HOST_VISIBLE memory, which only a
+	// resizable BAR has room for; the buffer goes wherever VMA puts host-visible memory if it doesn't fit
+	void init(VmaAllocator allocator, VkDeviceSize frameSize, uint32_t frameCount, VkBufferUsageFlags usage,
+		VkDeviceSize minAlignment, uint32_t queueFamilyCount = 0, const uint32_t* queueFamilies = nullptr, bool deviceLocal = false);
+	void cleanup();
+
+	// resets frameIndex's region and makes it the one allocations come from
+	void begin_frame(uint32_t frameIndex);
+
+	// false, with out untouched, once the current region is full
+	bool allocate(VkDeviceSize size, VkDeviceSize alignment, GpuAllocation* out);
+
+	template<typename T>
+	bool push(const T& value, GpuAllocation* out)
+	{
+		if (!allocate(sizeof(T), alignof(T), out))
+		{
+			return false;
+		}
+		*static_cast<T*>(out->data) = value;
+		return true;
+	}
+
+	// makes the current region's writes visible to the GPU; a no-op on host-coherent memory
+	// call before submitting the frame that reads them
+	void flush();
+
+	VkBuffer buffer() const { return _buffer._buffer; }
+	VkDeviceSize frame_size() const { return _frameSize; }
+	VkDeviceSize used() const { return _head - _frameStart; }
+	// whether the buffer ended up in device-local memory, asked for or not
+	bool device_local() const { return _deviceLocal; }
+
+private:
+	VmaAllocator _allocator{ VK_NULL_HANDLE };
+	AllocatedBuffer _buffer{};
+	uint8_t* _mapped{ nullptr };
+	bool _deviceLocal{ false };
+
+	VkDeviceSize _frameSize{ 0 };
+	VkDeviceSize _minAlignment{ 1 };
+	// absolute offsets into the buffer
+	VkDeviceSize _frameStart{ 0 };
+	VkDeviceSize _head{ 0 };
+};
@@ -0,0 +1,239 @@
+#include "GpuMemory.h"
+
+#include "Log.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+	const char* pool_name(MemoryPoolType type)
+	{
+		switch (type)
+		{
+		case MemoryPoolType::Mesh: return "mesh";
+		case MemoryPoolType::Texture: return "texture";
+		case MemoryPoolType::Staging: return "staging";
+		default: return "?";
+		}
+	}
+
+	VmaPool create_pool(VmaAllocator allocator, uint32_t memoryTypeIndex, MemoryPoolType type)
+	{
+		VmaPoolCreateInfo poolInfo = {};
+		poolInfo.memoryTypeIndex = memoryTypeIndex;
+		// blocks are sized by VMA, which keeps them within the budget when it can
+
+		VmaPool pool = VK_NULL_HANDLE;
+		if (vmaCreatePool(allocator, &poolInfo, &pool) != VK_SUCCESS)
+		{
+			LOG_ERROR("Failed to create the " << pool_name(type) << " memory pool, using the default pools");
+			return VK_NULL_HANDLE;
+		}
+		vmaSetPoolName(allocator, pool, pool_name(type));
+		return pool;
+	}
+
+	double to_mib(VkDeviceSize bytes)
+	{
+		return static_cast<double>(bytes) / (1024.0 * 1024.0);
+	}
+
+	// 0.5 is what memory allocated without a priority gets
+	float priority_value(ResidencyPriority priority)
+	{
+		switch (priority)
+		{
+		case ResidencyPriority::Prefetch: return 0.2f;
+		case ResidencyPriority::Visible: return 0.75f;
+		case ResidencyPriority::RenderTarget: return 1.0f;
+		default: return 0.5f;
+		}
+	}
+}
+
+void GpuMemory::init(VmaAllocator allocator, VmaMemoryUsage meshMemoryUsage)
+{
+	_allocator = allocator;
+
+	// the pools' memory types are picked from example resources with the usage their allocations will have
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = 1024;
+	bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+		| VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.usage = meshMemoryUsage;
+	uint32_t memoryTypeIndex;
+	if (vmaFindMemoryTypeIndexForBufferInfo(_allocator, &bufferInfo, &allocInfo, &memoryTypeIndex) == VK_SUCCESS)
+	{
+		_pools[static_cast<uint32_t>(MemoryPoolType::Mesh)] = create_pool(_allocator, memoryTypeIndex, MemoryPoolType::Mesh);
+	}
+
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	allocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+	if (vmaFindMemoryTypeIndexForBufferInfo(_allocator, &bufferInfo, &allocInfo, &memoryTypeIndex) == VK_SUCCESS)
+	{
+		_pools[static_cast<uint32_t>(MemoryPoolType::Staging)] = create_pool(_allocator, memoryTypeIndex, MemoryPoolType::Staging);
+	}
+
+	// optimal-tiling color images share memory types across formats in practice
+	VkImageCreateInfo imageInfo = {};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+	imageInfo.extent = { 256, 256, 1 };
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+	if (vmaFindMemoryTypeIndexForImageInfo(_allocator, &imageInfo, &allocInfo, &memoryTypeIndex) == VK_SUCCESS)
+	{
+		_pools[static_cast<uint32_t>(MemoryPoolType::Texture)] = create_pool(_allocator, memoryTypeIndex, MemoryPoolType::Texture);
+	}
+
+	const VkPhysicalDeviceMemoryProperties* memoryProperties;
+	vmaGetMemoryProperties(_allocator, &memoryProperties);
+	_heapCount = memoryProperties->memoryHeapCount;
+	for (uint32_t i = 0; i < _heapCount; i++)
+	{
+		_heaps[i].deviceLocal = (memoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+	}
+	// integrated GPUs report all of their memory this way, which is just as good to write directly
+	const VkMemoryPropertyFlags bar = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+	_barSize = 0;
+	for (uint32_t i = 0; i < memoryProperties->memoryTypeCount; i++)
+	{
+		const VkMemoryType& type = memoryProperties->memoryTypes[i];
+		if ((type.propertyFlags & bar) == bar)
+		{
+			_barSize = std::max(_barSize, memoryProperties->memoryHeaps[type.heapIndex].size);
+		}
+	}
+	update(0);
+}
+
+void GpuMemory::cleanup()
+{
+	for (VmaPool& pool : _pools)
+	{
+		if (pool != VK_NULL_HANDLE)
+		{
+			vmaDestroyPool(_allocator, pool);
+			pool = VK_NULL_HANDLE;
+		}
+	}
+}
+
+void GpuMemory::update(uint32_t frameNumber)
+{
+	vmaSetCurrentFrameIndex(_allocator, frameNumber);
+
+	VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+	vmaGetBudget(_allocator, budgets);
+	for (uint32_t i = 0; i < _heapCount; i++)
+	{
+		_heaps[i].usage = budgets[i].usage;
+		_heaps[i].budget = budgets[i].budget;
+		_heaps[i].blockBytes = budgets[i].blockBytes;
+		_heaps[i].allocationBytes = budgets[i].allocationBytes;
+	}
+}
+
+float GpuMemory::device_local_pressure() const
+{
+	float pressure = 0.f;
+	for (uint32_t i = 0; i < _heapCount; i++)
+	{
+		if (_heaps[i].deviceLocal && _heaps[i].budget > 0)
+		{
+			pressure = std::max(pressure, static_cast<float>(_heaps[i].usage) / static_cast<float>(_heaps[i].budget));
+		}
+	}
+	return pressure;
+}
+
+std::string GpuMemory::format() const
+{
+	std::ostringstream out;
+	out << "GPU memory:" << std::fixed << std::setprecision(1);
+	for (uint32_t i = 0; i < _heapCount; i++)
+	{
+		out << " heap" << i << (_heaps[i].deviceLocal ? "(local)" : "") << "="
+			<< to_mib(_heaps[i].usage) << "/" << to_mib(_heaps[i].budget) << "MiB";
+	}
+	out << " |";
+	for (uint32_t type = 0; type < static_cast<uint32_t>(MemoryPoolType::Count); type++)
+	{
+		if (_pools[type] == VK_NULL_HANDLE)
+		{
+			continue;
+		}
+		VmaPoolStats stats;
+		vmaGetPoolStats(_allocator, _pools[type], &stats);
+		out << " " << pool_name(static_cast<MemoryPoolType>(type)) << "=" << to_mib(stats.size - stats.unusedSize)
+			<< "/" << to_mib(stats.size) << "MiB";
+	}
+	return out.str();
+}
+
+void GpuMemory::enable_priorities(VkDevice device)
+{
+	_device = device;
+#ifdef VK_EXT_pageable_device_local_memory
+	_setPriority = vkGetDeviceProcAddr(device, "vkSetDeviceMemoryPriorityEXT");
+#endif
+}
+
+void GpuMemory::tag(VmaAllocation allocation, ResidencyPriority priority)
+{
+	if (_setPriority == nullptr || allocation == VK_NULL_HANDLE)
+	{
+		return;
+	}
+	VmaAllocationInfo info;
+	vmaGetAllocationInfo(_allocator, allocation, &info);
+	if (info.deviceMemory != VK_NULL_HANDLE)
+	{
+		_tagged.push_back({ info.deviceMemory, priority });
+	}
+}
+
+void GpuMemory::apply_priorities()
+{
+	if (_setPriority == nullptr)
+	{
+		return;
+	}
+
+	// the highest tag of each block, first after sorting by memory then priority descending
+	std::sort(_tagged.begin(), _tagged.end(), [](const auto& a, const auto& b) {
+		return a.first != b.first ? a.first < b.first : a.second > b.second;
+	});
+	_tagged.erase(std::unique(_tagged.begin(), _tagged.end(), [](const auto& a, const auto& b) { return a.first == b.first; }), _tagged.end());
+
+	const bool refresh = ++_applyCount % REFRESH_APPLIES == 0;
+	auto applied = _applied.begin();
+	for (const auto& block : _tagged)
+	{
+		while (applied != _applied.end() && applied->first < block.first)
+		{
+			applied++;
+		}
+		const bool unchanged = applied != _applied.end() && applied->first == block.first && applied->second == block.second;
+		if (unchanged && !refresh)
+		{
+			continue;
+		}
+#ifdef VK_EXT_pageable_device_local_memory
+		reinterpret_cast<PFN_vkSetDeviceMemoryPriorityEXT>(_setPriority)(_device, block.first, priority_value(block.second));
+#endif
+	}
+
+	// the capacity stays for the next round's tags
+	std::swap(_applied, _tagged);
+	_tagged.clear();
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vk_types.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+// allocations that get their own VMA pool, so they can be measured (and later limited) separately
+enum class MemoryPoolType : uint32_t {
+	Mesh = 0,    // MeshPool geometry buffers
+	Texture = 1, // sampled images
+	Staging = 2, // UploadManager staging buffers
+	Count = 3,
+};
+
+// how much an allocation's memory matters to the frames being drawn. With VK_EXT_pageable_device_local_memory
+// the driver pages the lowest out to system memory first once the device-local heaps are oversubscribed,
+// rather than whatever it happens to pick. Untagged memory keeps the default priority
+enum class ResidencyPriority : uint32_t {
+	Prefetch = 0,     // streamed in ahead of need, or nothing in view samples it
+	Default = 1,
+	Visible = 2,      // sampled by what's in view
+	RenderTarget = 3, // written and read every frame
+	Count = 4,
+};
+
+// Owns the custom VMA pools and tracks per-heap usage against the budget.
+// With VK_EXT_memory_budget the numbers come from the driver and include memory allocated outside VMA;
+// without it VMA estimates them from its own allocations and the heap sizes.
+class GpuMemory
+{
+public:
+	struct HeapBudget {
+		VkDeviceSize usage;           // estimated bytes the process uses in the heap
+		VkDeviceSize budget;          // bytes it can use before the driver starts paging
+		VkDeviceSize blockBytes;      // VkDeviceMemory VMA allocated in the heap
+		VkDeviceSize allocationBytes; // bytes of that handed out to resources
+		bool deviceLocal;
+	};
+
+	// meshMemoryUsage must match what MeshPool is initialized with, the pools are tied to one memory type
+	void init(VmaAllocator allocator, VmaMemoryUsage meshMemoryUsage);
+	// every allocation from the pools has to be freed first
+	void cleanup();
+
+	// VK_NULL_HANDLE if the pool couldn't be created; allocations then fall back to the default pools
+	VmaPool pool(MemoryPoolType type) const { return _pools[static_cast<uint32_t>(type)]; }
+
+	// call once per frame; advances VMA's frame index, which is when it refreshes the budget
+	void update(uint32_t frameNumber);
+
+	uint32_t heap_count() const { return _heapCount; }
+	const HeapBudget& heap(uint32_t heapIndex) const { return _heaps[heapIndex]; }
+
+	// highest usage / budget among the device-local heaps; streaming should back off as this nears 1
+	float device_local_pressure() const;
+
+	// the largest heap with a DEVICE_LOCAL | HOST_VISIBLE memory type, 0 without one
+	VkDeviceSize bar_size() const { return _barSize; }
+	// the CPU can write all of VRAM, or at least more than the 256 MiB window of the PCIe BAR without it,
+	// so per-frame data can live in device-local memory and be written there directly
+	bool resizable_bar() const { return _barSize > LEGACY_BAR_SIZE; }
+	static constexpr VkDeviceSize LEGACY_BAR_SIZE = 256ull * 1024 * 1024;
+
+	// one line: usage/budget per heap, then bytes in each pool
+	std::string format() const;
+
+	// with VK_EXT_pageable_device_local_memory enabled on device; without it the priorities are ignored
+	void enable_priorities(VkDevice device);
+	bool priorities_enabled() const { return _setPriority != nullptr; }
+	// the tags since the last apply_priorities() call; priorities belong to VkDeviceMemory, so a block VMA
+	// suballocates takes the highest of the allocations tagged in it
+	void tag(VmaAllocation allocation, ResidencyPriority priority);
+	// sets the blocks whose priority changed since the last call. Blocks nothing was tagged in this time are
+	// left as they are, since they may be gone; every REFRESH_APPLIES calls all of them are set again, in case
+	// a block freed in between handed its handle on to a new one
+	void apply_priorities();
+
+private:
+	VmaAllocator _allocator{ VK_NULL_HANDLE };
+	VmaPool _pools[static_cast<uint32_t>(MemoryPoolType::Count)]{};
+
+	uint32_t _heapCount{ 0 };
+	HeapBudget _heaps[VK_MAX_MEMORY_HEAPS]{};
+	VkDeviceSize _barSize{ 0 };
+
+	static constexpr uint32_t REFRESH_APPLIES = 64;
+	VkDevice _device{ VK_NULL_HANDLE };
+	PFN_vkVoidFunction _setPriority{ nullptr };
+	// sorted by memory once applied, at most one entry per block
+	std::vector<std::pair<VkDeviceMemory, ResidencyPriority>> _tagged;
+	std::vector<std::pair<VkDeviceMemory, ResidencyPriority>> _applied;
+	uint32_t _applyCount{ 0 };
+};
@@ -0,0 +1,224 @@
+#include "GpuProfiler.h"
+
+#include "Log.h"
+
+#include <sstream>
+#include <iomanip>
+
+namespace {
+	// results come back in bit order, matching the PipelineStatistics field order
+	constexpr VkQueryPipelineStatisticFlags STATISTICS_FLAGS =
+		VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+}
+
+void GpuProfiler::init(VkDevice device, const VkPhysicalDeviceProperties& properties, uint32_t timestampValidBits,
+	uint32_t frameCount, bool enablePipelineStatistics)
+{
+	_device = device;
+
+	// some queues (and some drivers) simply have no timestamps
+	if (timestampValidBits == 0 || properties.limits.timestampPeriod == 0.0f)
+	{
+		LOG_WARN("GPU profiler disabled: queue does not support timestamps.");
+		_enabled = false;
+		return;
+	}
+
+	_enabled = true;
+	_statisticsEnabled = enablePipelineStatistics;
+	_timestampPeriodNs = properties.limits.timestampPeriod;
+	_timestampMask = timestampValidBits >= 64 ? ~0ull : ((1ull << timestampValidBits) - 1);
+
+	_frames.resize(frameCount);
+	for (FrameQueries& frame : _frames)
+	{
+		// two timestamps per scope: begin and end
+		VkQueryPoolCreateInfo timestampInfo = {};
+		timestampInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		timestampInfo.pNext = nullptr;
+		timestampInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		timestampInfo.queryCount = MAX_SCOPES * 2;
+		VK_CHECK(vkCreateQueryPool(_device, &timestampInfo, nullptr, &frame.timestampPool));
+
+		if (_statisticsEnabled)
+		{
+			VkQueryPoolCreateInfo statisticsInfo = {};
+			statisticsInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			statisticsInfo.pNext = nullptr;
+			statisticsInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+			statisticsInfo.queryCount = 1;
+			statisticsInfo.pipelineStatistics = STATISTICS_FLAGS;
+			VK_CHECK(vkCreateQueryPool(_device, &statisticsInfo, nullptr, &frame.statisticsPool));
+		}
+
+		frame.scopeNames.reserve(MAX_SCOPES);
+	}
+}
+
+void GpuProfiler::cleanup()
+{
+	for (FrameQueries& frame : _frames)
+	{
+		if (frame.timestampPool != VK_NULL_HANDLE)
+		{
+			vkDestroyQueryPool(_device, frame.timestampPool, nullptr);
+		}
+		if (frame.statisticsPool != VK_NULL_HANDLE)
+		{
+			vkDestroyQueryPool(_device, frame.statisticsPool, nullptr);
+		}
+	}
+	_frames.clear();
+	_enabled = false;
+}
+
+void GpuProfiler::begin_frame(VkCommandBuffer cmd, uint32_t frameIndex, int frameNumber)
+{
+	if (!_enabled)
+	{
+		return;
+	}
+
+	_currentFrame = frameIndex;
+	FrameQueries& frame = _frames[frameIndex];
+
+	// the caller has already waited on this slot's fence, so its queries are complete
+	collect(frame);
+
+	vkCmdResetQueryPool(cmd, frame.timestampPool, 0, MAX_SCOPES * 2);
+	if (_statisticsEnabled)
+	{
+		vkCmdResetQueryPool(cmd, frame.statisticsPool, 0, 1);
+	}
+
+	frame.scopeNames.clear();
+	frame.frameNumber = frameNumber;
+	frame.statisticsWritten = false;
+}
+
+uint32_t GpuProfiler::begin_scope(VkCommandBuffer cmd, const char* name)
+{
+	if (!_enabled)
+	{
+		return INVALID_SCOPE;
+	}
+
+	FrameQueries& frame = _frames[_currentFrame];
+	if (frame.scopeNames.size() >= MAX_SCOPES)
+	{
+		return INVALID_SCOPE;
+	}
+
+	uint32_t scope = static_cast<uint32_t>(frame.scopeNames.size());
+	frame.scopeNames.push_back(name);
+
+	vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.timestampPool, scope * 2);
+	return scope;
+}
+
+void GpuProfiler::end_scope(VkCommandBuffer cmd, uint32_t scope)
+{
+	if (!_enabled || scope == INVALID_SCOPE)
+	{
+		return;
+	}
+
+	// bottom of pipe: the timestamp is written once all previous work has fully completed
+	vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, _frames[_currentFrame].timestampPool, scope * 2 + 1);
+}
+
+VkQueryPipelineStatisticFlags GpuProfiler::statistics_flags() const
+{
+	return _enabled && _statisticsEnabled ? STATISTICS_FLAGS : 0;
+}
+
+void GpuProfiler::begin_statistics(VkCommandBuffer cmd)
+{
+	if (!_enabled || !_statisticsEnabled)
+	{
+		return;
+	}
+	vkCmdBeginQuery(cmd, _frames[_currentFrame].statisticsPool, 0, 0);
+}
+
+void GpuProfiler::end_statistics(VkCommandBuffer cmd)
+{
+	if (!_enabled || !_statisticsEnabled)
+	{
+		return;
+	}
+	vkCmdEndQuery(cmd, _frames[_currentFrame].statisticsPool, 0);
+	_frames[_currentFrame].statisticsWritten = true;
+}
+
+void GpuProfiler::collect(FrameQueries& frame)
+{
+	if (frame.frameNumber < 0 || frame.scopeNames.empty())
+	{
+		return;
+	}
+
+	const uint32_t queryCount = static_cast<uint32_t>(frame.scopeNames.size()) * 2;
+	uint64_t timestamps[MAX_SCOPES * 2];
+
+	// no WAIT bit: if the driver somehow isn't done we skip this frame instead of stalling
+	VkResult result = vkGetQueryPoolResults(_device, frame.timestampPool, 0, queryCount,
+		sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+	if (result != VK_SUCCESS)
+	{
+		return;
+	}
+
+	_latest.frameNumber = frame.frameNumber;
+	_latest.scopes.resize(frame.scopeNames.size());
+	for (size_t i = 0; i < frame.scopeNames.size(); i++)
+	{
+		uint64_t begin = timestamps[i * 2] & _timestampMask;
+		uint64_t end = timestamps[i * 2 + 1] & _timestampMask;
+		double ticks = end >= begin ? double(end - begin) : 0.0;
+
+		_latest.scopes[i].name = frame.scopeNames[i];
+		_latest.scopes[i].milliseconds = ticks * _timestampPeriodNs / 1000000.0;
+	}
+
+	_latest.hasStatistics = false;
+	if (_statisticsEnabled && frame.statisticsWritten)
+	{
+		uint64_t values[6];
+		result = vkGetQueryPoolResults(_device, frame.statisticsPool, 0, 1,
+			sizeof(values), values, sizeof(values), VK_QUERY_RESULT_64_BIT);
+		if (result == VK_SUCCESS)
+		{
+			_latest.hasStatistics = true;
+			_latest.statistics.inputAssemblyVertices = values[0];
+			_latest.statistics.inputAssemblyPrimitives = values[1];
+			_latest.statistics.vertexShaderInvocations = values[2];
+			_latest.statistics.clippingInvocations = values[3];
+			_latest.statistics.clippingPrimitives = values[4];
+			_latest.statistics.fragmentShaderInvocations = values[5];
+		}
+	}
+}
+
+std::string GpuProfiler::format_latest() const
+{
+	std::ostringstream out;
+	out << "GPU frame " << _latest.frameNumber << ":";
+	out << std::fixed << std::setprecision(3);
+	for (const ScopeTiming& scope : _latest.scopes)
+	{
+		out << " " << scope.name << "=" << scope.milliseconds << "ms";
+	}
+	if (_latest.hasStatistics)
+	{
+		out << " | vs=" << _latest.statistics.vertexShaderInvocations
+			<< " clip_prims=" << _latest.statistics.clippingPrimitives
+			<< " fs=" << _latest.statistics.fragmentShaderInvocations;
+	}
+	return out.str();
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vk_types.h>
+#include <string>
+#include <vector>
+
+// Query-pool based GPU timing.
+// Each frame slot owns its own pools; results are read back when the slot comes around again,
+// i.e. after that slot's render fence has signaled, so reading never stalls the CPU.
+class GpuProfiler
+{
+public:
+	struct ScopeTiming {
+		std::string name;
+		double milliseconds;
+	};
+
+	// subset of VK_QUERY_TYPE_PIPELINE_STATISTICS we request
+	struct PipelineStatistics {
+		uint64_t inputAssemblyVertices;
+		uint64_t inputAssemblyPrimitives;
+		uint64_t vertexShaderInvocations;
+		uint64_t clippingInvocations;
+		uint64_t clippingPrimitives;
+		uint64_t fragmentShaderInvocations;
+	};
+
+	struct FrameTimings {
+		int frameNumber{ -1 }; // frame the results belong to, -1 until the first readback
+		std::vector<ScopeTiming> scopes;
+		bool hasStatistics{ false };
+		PipelineStatistics statistics{};
+	};
+
+	// timestampValidBits comes from the queue family the profiled commands are submitted to
+	void init(VkDevice device, const VkPhysicalDeviceProperties& properties, uint32_t timestampValidBits,
+		uint32_t frameCount, bool enablePipelineStatistics);
+	void cleanup();
+
+	bool is_enabled() const { return _enabled; }
+
+	// call once per frame right after vkBeginCommandBuffer, outside any render pass
+	// collects the results this slot recorded last time around, then resets its queries
+	void begin_frame(VkCommandBuffer cmd, uint32_t frameIndex, int frameNumber);
+
+	// returns a scope id for end_scope; scopes beyond the per-frame limit are silently dropped
+	uint32_t begin_scope(VkCommandBuffer cmd, const char* name);
+	void end_scope(VkCommandBuffer cmd, uint32_t scope);
+
+	// pipeline statistics must begin and end outside of, or within the same, subpass
+	void begin_statistics(VkCommandBuffer cmd);
+	void end_statistics(VkCommandBuffer cmd);
+	// statistics an active query collects, 0 when none is recorded; secondary command buffers
+	// executed while it's active must inherit exactly these
+	VkQueryPipelineStatisticFlags statistics_flags() const;
+
+	// latest completed results (a few frames old)
+	const FrameTimings& latest() const { return _latest; }
+
+	// one-line summary of latest(), for logging
+	std::string format_latest() const;
+
+	static constexpr uint32_t MAX_SCOPES = 32;
+	static constexpr uint32_t INVALID_SCOPE = 0xFFFFFFFF;
+
+private:
+	struct FrameQueries {
+		VkQueryPool timestampPool{ VK_NULL_HANDLE };
+		VkQueryPool statisticsPool{ VK_NULL_HANDLE };
+		std::vector<std::string> scopeNames;
+		int frameNumber{ -1 };
+		bool statisticsWritten{ false };
+	};
+
+	void collect(FrameQueries& frame);
+
+	VkDevice _device{ VK_NULL_HANDLE };
+	bool _enabled{ false };
+	bool _statisticsEnabled{ false };
+	double _timestampPeriodNs{ 1.0 };
+	uint64_t _timestampMask{ ~0ull };
+
+	std::vector<FrameQueries> _frames;
+	uint32_t _currentFrame{ 0 };
+
+	FrameTimings _latest;
+};
@@ -0,0 +1,165 @@
+#include "GpuScene.h"
+
+#include "vk_initializers.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+	// clean objects between two dirty runs closer than this are copied along; an extra region costs more
+	constexpr uint32_t MERGE_GAP = 4;
+}
+
+void GpuScene::init(VmaAllocator allocator, uint32_t capacity, uint32_t queueFamilyCount, const uint32_t* queueFamilies)
+{
+	_allocator = allocator;
+	_capacity = capacity;
+	_count = 0;
+	_objects.assign(capacity, GpuSceneObject{});
+	_isDirty.assign(capacity, 0);
+	_dirty.clear();
+
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.pNext = nullptr;
+	bufferInfo.size = VkDeviceSize(capacity) * sizeof(GpuSceneObject);
+	bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	if (queueFamilyCount > 1)
+	{
+		bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		bufferInfo.queueFamilyIndexCount = queueFamilyCount;
+		bufferInfo.pQueueFamilyIndices = queueFamilies;
+	}
+
+	// read by every cull dispatch, written a few objects at a time
+	VmaAllocationCreateInfo vmaallocInfo = {};
+	vmaallocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+	VK_CHECK(vmaCreateBuffer(allocator, &bufferInfo, &vmaallocInfo, &_buffer._buffer, &_buffer._allocation, nullptr));
+}
+
+void GpuScene::cleanup()
+{
+	vmaDestroyBuffer(_allocator, _buffer._buffer, _buffer._allocation);
+	_buffer = {};
+}
+
+uint32_t GpuScene::add()
+{
+	if (_count >= _capacity)
+	{
+		return UINT32_MAX;
+	}
+	// the GPU copy is garbage until the first upload, whatever set() is given
+	_isDirty[_count] = 1;
+	_dirty.push_back(_count);
+	return _count++;
+}
+
+void GpuScene::set(uint32_t slot, const GpuSceneObject& object)
+{
+	if (slot >= _count)
+	{
+		return;
+	}
+
+	GpuSceneObject& current = _objects[slot];
+	if (memcmp(&current, &object, sizeof(GpuSceneObject)) == 0)
+	{
+		return;
+	}
+	current = object;
+
+	if (!_isDirty[slot])
+	{
+		_isDirty[slot] = 1;
+		_dirty.push_back(slot);
+	}
+}
+
+void GpuScene::record_updates(VkCommandBuffer cmd, GpuLinearAllocator& staging)
+{
+	_lastUploadBytes = 0;
+	if (_dirty.empty())
+	{
+		return;
+	}
+
+	// dirty slots into runs, each run one region; the runs are packed back to back in one allocation
+	std::sort(_dirty.begin(), _dirty.end());
+	std::vector<std::pair<uint32_t, uint32_t>> runs; // first slot, count
+	for (uint32_t slot : _dirty)
+	{
+		if (!runs.empty() && slot <= runs.back().first + runs.back().second + MERGE_GAP)
+		{
+			runs.back().second = slot - runs.back().first + 1;
+		}
+		else
+		{
+			runs.push_back({ slot, 1 });
+		}
+	}
+
+	// as much as the rest of the frame's ring takes, in slot order, so the slots left over are a tail
+	uint64_t wanted = 0;
+	for (const auto& run : runs)
+	{
+		wanted += run.second;
+	}
+	const VkDeviceSize free = staging.frame_size() - staging.used();
+	const VkDeviceSize alignment = alignof(glm::vec4);
+	const uint64_t fitting = free > alignment ? (free - alignment) / sizeof(GpuSceneObject) : 0;
+	const uint32_t budget = static_cast<uint32_t>(std::min<uint64_t>(wanted, fitting));
+	GpuAllocation allocation;
+	if (budget == 0 || !staging.allocate(VkDeviceSize(budget) * sizeof(GpuSceneObject), alignment, &allocation))
+	{
+		return;
+	}
+
+	std::vector<VkBufferCopy> regions;
+	GpuSceneObject* data = static_cast<GpuSceneObject*>(allocation.data);
+	VkDeviceSize stagingOffset = allocation.offset;
+	uint32_t remaining = budget;
+	uint32_t stagedEnd = 0; // every dirty slot below it is in the copies
+	for (const auto& run : runs)
+	{
+		const uint32_t count = std::min(run.second, remaining);
+		const VkDeviceSize bytes = VkDeviceSize(count) * sizeof(GpuSceneObject);
+		memcpy(data, _objects.data() + run.first, bytes);
+
+		VkBufferCopy region = {};
+		region.srcOffset = stagingOffset;
+		region.dstOffset = VkDeviceSize(run.first) * sizeof(GpuSceneObject);
+		region.size = bytes;
+		regions.push_back(region);
+
+		data += count;
+		stagingOffset += bytes;
+		remaining -= count;
+		stagedEnd = run.first + count;
+		if (remaining == 0)
+		{
+			break;
+		}
+	}
+
+	// the slots are sorted, so what stays dirty is everything from stagedEnd on
+	auto staged = std::lower_bound(_dirty.begin(), _dirty.end(), stagedEnd);
+	for (auto it = _dirty.begin(); it != staged; it++)
+	{
+		_isDirty[*it] = 0;
+	}
+	_dirty.erase(_dirty.begin(), staged);
+
+	// earlier dispatches on this queue only read the buffer, so waiting for them is enough
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+	vkCmdCopyBuffer(cmd, staging.buffer(), _buffer._buffer, static_cast<uint32_t>(regions.size()), regions.data());
+	VkBufferMemoryBarrier written = vkinit::buffer_barrier(_buffer._buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &written, 0, nullptr);
+
+	for (const VkBufferCopy& region : regions)
+	{
+		_lastUploadBytes += region.size;
+	}
+	_totalUploadBytes += _lastUploadBytes;
+}
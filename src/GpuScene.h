@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vk_types.h>
+#include <GpuLinearAllocator.h>
+
+#include <cstdint>
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+// one render object as it stays on the GPU; matches SceneObject in cull.comp
+struct GpuSceneObject {
+	glm::mat4 model; // applies to the stored positions, dequantization included
+	glm::vec4 sphereBounds; // center and radius in the space of the stored positions
+	uint32_t materialIndex; // slot in the bindless material buffer
+	uint32_t meshIndex; // where the mesh's indices start in the mesh pool, which no other mesh shares
+	uint32_t pad[2];
+};
+static_assert(sizeof(GpuSceneObject) == 96, "GpuSceneObject must match the std430 layout in cull.comp");
+
+// Every render object's transform, bounds, material and mesh in one device-local buffer that persists across
+// frames, indexed by a slot the object keeps for its whole life; sorting the render list doesn't move it.
+// The per-frame cull input then only says which slot fills which instance, and the bulk of the data is
+// uploaded when it changes: set() compares against the CPU copy and marks what differs, and
+// record_updates() copies just the dirty runs out of the frame's ring. A scene that doesn't move uploads
+// nothing, however many objects it holds.
+class GpuScene
+{
+public:
+	// with queueFamilyCount families the buffer is shared concurrently between them
+	void init(VmaAllocator allocator, uint32_t capacity, uint32_t queueFamilyCount = 0, const uint32_t* queueFamilies = nullptr);
+	void cleanup();
+
+	// a slot for a new object, zeroed until set(); UINT32_MAX once all capacity slots are taken
+	uint32_t add();
+	// no-op when the slot already holds object
+	void set(uint32_t slot, const GpuSceneObject& object);
+
+	// before the frame's first dispatch that reads the buffer, on the queue that runs it. The copies wait
+	// for the compute shaders submitted before on that queue and finish before the ones after. What doesn't
+	// fit in staging is left dirty for the next call; staging must have been created with TRANSFER_SRC usage
+	void record_updates(VkCommandBuffer cmd, GpuLinearAllocator& staging);
+
+	VkBuffer buffer() const { return _buffer._buffer; }
+	uint32_t size() const { return _count; }
+	bool dirty() const { return !_dirty.empty(); }
+	// bytes record_updates copied into the buffer, last call and since init
+	VkDeviceSize last_upload_bytes() const { return _lastUploadBytes; }
+	uint64_t total_upload_bytes() const { return _totalUploadBytes; }
+
+private:
+	VmaAllocator _allocator{ VK_NULL_HANDLE };
+	AllocatedBuffer _buffer{};
+	uint32_t _capacity{ 0 };
+	uint32_t _count{ 0 };
+
+	std::vector<GpuSceneObject> _objects; // the CPU copy
+	std::vector<uint32_t> _dirty; // slots changed since they were last uploaded, each listed once
+	std::vector<uint8_t> _isDirty;
+
+	VkDeviceSize _lastUploadBytes{ 0 };
+	uint64_t _totalUploadBytes{ 0 };
+};
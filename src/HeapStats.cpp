@@ -0,0 +1,121 @@
+#include "HeapStats.h"
+
+#include <atomic>
+#include <cstdlib>
+
+namespace {
+	constexpr size_t TAG_COUNT = static_cast<size_t>(HeapTag::Count);
+
+	// a cache line each, so threads allocating under different tags don't contend
+	struct alignas(64) TagCounters {
+		std::atomic<uint64_t> allocations{ 0 };
+		std::atomic<uint64_t> bytes{ 0 };
+	};
+	TagCounters counters[TAG_COUNT];
+
+	// constant-initialized, so reading it from operator new never allocates
+	thread_local HeapTag t_tag = HeapTag::Untagged;
+}
+
+heap_stats::TagCounts heap_stats::Snapshot::total() const
+{
+	TagCounts sum;
+	for (const TagCounts& counts : tags)
+	{
+		sum.allocations += counts.allocations;
+		sum.bytes += counts.bytes;
+	}
+	return sum;
+}
+
+heap_stats::Snapshot heap_stats::Snapshot::operator-(const Snapshot& earlier) const
+{
+	Snapshot difference;
+	for (size_t i = 0; i < TAG_COUNT; i++)
+	{
+		difference.tags[i].allocations = tags[i].allocations - earlier.tags[i].allocations;
+		difference.tags[i].bytes = tags[i].bytes - earlier.tags[i].bytes;
+	}
+	return difference;
+}
+
+heap_stats::Snapshot heap_stats::snapshot()
+{
+	Snapshot current;
+	for (size_t i = 0; i < TAG_COUNT; i++)
+	{
+		current.tags[i].allocations = counters[i].allocations.load(std::memory_order_relaxed);
+		current.tags[i].bytes = counters[i].bytes.load(std::memory_order_relaxed);
+	}
+	return current;
+}
+
+uint64_t heap_stats::allocation_count()
+{
+	uint64_t count = 0;
+	for (const TagCounters& tag : counters)
+	{
+		count += tag.allocations.load(std::memory_order_relaxed);
+	}
+	return count;
+}
+
+void heap_stats::record(HeapTag tag, size_t size)
+{
+	TagCounters& tagCounters = counters[static_cast<size_t>(tag)];
+	tagCounters.allocations.fetch_add(1, std::memory_order_relaxed);
+	tagCounters.bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+HeapTag heap_stats::current_tag()
+{
+	return t_tag;
+}
+
+heap_stats::Scope::Scope(HeapTag tag) : _previous(t_tag)
+{
+	t_tag = tag;
+}
+
+heap_stats::Scope::~Scope()
+{
+	t_tag = _previous;
+}
+
+void* heap_stats::allocate(HeapTag tag, size_t size)
+{
+	Scope scope(tag);
+#ifdef NDEBUG
+	// nothing else counts it in release builds
+	record(tag, size);
+#endif
+	return ::operator new(size);
+}
+
+void heap_stats::deallocate(void* allocation)
+{
+	::operator delete(allocation);
+}
+
+#ifndef NDEBUG
+// replacing these two is enough: the default array and nothrow forms forward to them
+void* operator new(size_t size)
+{
+	heap_stats::record(t_tag, size);
+	if (void* allocation = std::malloc(size == 0 ? 1 : size))
+	{
+		return allocation;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* allocation) noexcept
+{
+	std::free(allocation);
+}
+
+void operator delete(void* allocation, size_t) noexcept
+{
+	std::free(allocation);
+}
+#endif
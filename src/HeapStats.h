@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+// What a CPU heap allocation is counted under: the innermost heap_stats::Scope open on the allocating thread,
+// or the tag of the TaggedAllocator it came through. Jobs run under the tag of the thread that queued them.
+enum class HeapTag : uint8_t {
+	Untagged,
+	Meshes, // import, optimization, clusters, LODs and mesh caches
+	ObjImport, // the OBJ parser's chunks, shapes and attribute arrays
+	Textures,
+	Pipelines, // builders, shader modules and their reflection
+	DeletionQueue, // deferred teardown functions and what they capture
+	Scene, // render objects, transforms and snapshots
+	Hud,
+	Count,
+};
+
+constexpr const char* HEAP_TAG_NAMES[] = { "untagged", "meshes", "obj_import", "textures", "pipelines", "deletion_queue", "scene", "hud" };
+static_assert(sizeof(HEAP_TAG_NAMES) / sizeof(HEAP_TAG_NAMES[0]) == static_cast<size_t>(HeapTag::Count), "a name per heap tag");
+
+// Debug builds count every global operator new, by tag, so the draw path can check it stays allocation-free and
+// a subsystem's share shows up. Release builds only count what goes through TaggedAllocator; the untagged
+// totals are 0 there.
+namespace heap_stats {
+	struct TagCounts {
+		uint64_t allocations{ 0 };
+		uint64_t bytes{ 0 }; // requested, not freed: a running total like the count
+	};
+
+	// every tag's totals since startup; subtract two for what happened between them
+	struct Snapshot {
+		TagCounts tags[static_cast<size_t>(HeapTag::Count)];
+
+		const TagCounts& operator[](HeapTag tag) const { return tags[static_cast<size_t>(tag)]; }
+		TagCounts total() const;
+		Snapshot operator-(const Snapshot& earlier) const;
+	};
+
+	Snapshot snapshot();
+	// over every tag
+	uint64_t allocation_count();
+
+	// counts size bytes under tag; made by the global operator new in debug builds
+	void record(HeapTag tag, size_t size);
+	HeapTag current_tag();
+
+	// counts the thread's allocations under tag until it goes out of scope; nests
+	class Scope
+	{
+	public:
+		explicit Scope(HeapTag tag);
+		~Scope();
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		HeapTag _previous;
+	};
+
+	// the global operator new, counted under tag in every build
+	void* allocate(HeapTag tag, size_t size);
+	void deallocate(void* allocation);
+}
+
+// STL allocator whose allocations count under Tag whatever scope the container grows in, for engine containers
+// that live long and grow from many places
+template<typename T, HeapTag Tag>
+struct TaggedAllocator
+{
+	using value_type = T;
+	template<typename U>
+	struct rebind {
+		using other = TaggedAllocator<U, Tag>;
+	};
+
+	TaggedAllocator() = default;
+	template<typename U>
+	TaggedAllocator(const TaggedAllocator<U, Tag>&) {}
+
+	T* allocate(size_t n) { return static_cast<T*>(heap_stats::allocate(Tag, n * sizeof(T))); }
+	void deallocate(T* allocation, size_t) { heap_stats::deallocate(allocation); }
+
+	template<typename U>
+	bool operator==(const TaggedAllocator<U, Tag>&) const { return true; }
+	template<typename U>
+	bool operator!=(const TaggedAllocator<U, Tag>&) const { return false; }
+};
+
+template<typename T, HeapTag Tag>
+using TaggedVector = std::vector<T, TaggedAllocator<T, Tag>>;
@@ -0,0 +1,129 @@
+#include "HitchRecorder.h"
+
+#include "Log.h"
+
+#include <algorithm>
+#include <filesystem>
+
+void HitchRecorder::init(const Settings& settings)
+{
+	_settings = settings;
+	if (!enabled())
+	{
+		return;
+	}
+	const uint32_t frames = _settings.framesBefore + _settings.framesAfter + 1;
+	_records.assign(frames, FrameRecord{});
+	cpu_profiler::set_history(frames);
+}
+
+HitchRecorder::FrameRecord* HitchRecorder::find_record(int64_t frameNumber)
+{
+	if (frameNumber < 0)
+	{
+		return nullptr;
+	}
+	FrameRecord& record = _records[static_cast<size_t>(frameNumber) % _records.size()];
+	return record.frameNumber == frameNumber ? &record : nullptr;
+}
+
+uint32_t HitchRecorder::gpu_scope_index(const std::string& name)
+{
+	for (uint32_t i = 0; i < _gpuScopeNames.size(); i++)
+	{
+		if (_gpuScopeNames[i].compare(4, std::string::npos, name) == 0)
+		{
+			return i;
+		}
+	}
+	_gpuScopeNames.push_back("gpu " + name);
+	return static_cast<uint32_t>(_gpuScopeNames.size() - 1);
+}
+
+void HitchRecorder::end_frame(int64_t frameNumber, double frameMs, uint64_t heapAllocations, const GpuProfiler::FrameTimings& gpu)
+{
+	if (!enabled())
+	{
+		return;
+	}
+
+	FrameRecord& record = _records[static_cast<size_t>(frameNumber) % _records.size()];
+	record.frameNumber = frameNumber;
+	record.frameMs = frameMs;
+	record.heapAllocations = heapAllocations;
+	record.gpuScopeCount = 0;
+	_framesSeen++;
+
+	// GPU results belong to an older frame, filled in if the ring still holds it
+	if (gpu.frameNumber != _lastGpuFrame)
+	{
+		_lastGpuFrame = gpu.frameNumber;
+		if (FrameRecord* timed = find_record(gpu.frameNumber))
+		{
+			timed->gpuScopeCount = std::min(static_cast<uint32_t>(gpu.scopes.size()), GpuProfiler::MAX_SCOPES);
+			for (uint32_t i = 0; i < timed->gpuScopeCount; i++)
+			{
+				timed->gpuScopes[i] = gpu_scope_index(gpu.scopes[i].name);
+				timed->gpuMs[i] = gpu.scopes[i].milliseconds;
+			}
+		}
+	}
+
+	// startup frames build pipelines and upload the scene; only full history is worth a trace
+	const bool skip = _skipNext || _framesSeen <= static_cast<int64_t>(_settings.framesBefore);
+	_skipNext = false;
+	if (!skip && frameMs > _settings.thresholdMs)
+	{
+		if (_hitchFrame < 0 && _written < _settings.maxTraces)
+		{
+			_hitchFrame = frameNumber;
+			_hitchMs = frameMs;
+			_writeFrame = frameNumber + _settings.framesAfter;
+		}
+		else if (_hitchFrame >= 0)
+		{
+			_hitchMs = std::max(_hitchMs, frameMs);
+		}
+	}
+
+	if (_hitchFrame >= 0 && frameNumber >= _writeFrame)
+	{
+		write_trace(frameNumber);
+		_hitchFrame = -1;
+		_skipNext = true;
+	}
+}
+
+void HitchRecorder::write_trace(int64_t frameNumber)
+{
+	// oldest first, as the tracks are drawn
+	_counters.clear();
+	for (size_t i = 1; i <= _records.size(); i++)
+	{
+		const FrameRecord& record = _records[static_cast<size_t>(frameNumber + i) % _records.size()];
+		if (record.frameNumber < 0)
+		{
+			continue;
+		}
+		_counters.push_back({ "frame ms", record.frameNumber, record.frameMs });
+		_counters.push_back({ "heap allocations", record.frameNumber, static_cast<double>(record.heapAllocations) });
+		for (uint32_t i = 0; i < record.gpuScopeCount; i++)
+		{
+			_counters.push_back({ _gpuScopeNames[record.gpuScopes[i]].c_str(), record.frameNumber, record.gpuMs[i] });
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::create_directories(_settings.directory, ec);
+	const std::string path = (std::filesystem::path(_settings.directory) / ("hitch_" + std::to_string(_hitchFrame) + ".json")).string();
+	_written++;
+	if (cpu_profiler::write_history(path, _counters))
+	{
+		LOG_WARN("Frame " << _hitchFrame << " hitched (slowest frame " << _hitchMs << " ms, threshold " << _settings.thresholdMs
+			<< " ms), wrote the frames around it to " << path);
+	}
+	else
+	{
+		LOG_WARN("Frame " << _hitchFrame << " hitched (slowest frame " << _hitchMs << " ms), could not write a trace to " << path);
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <CpuProfiler.h>
+#include <GpuProfiler.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Catches frames slower than a threshold and writes the frames around each to disk as a Chrome trace: every
+// CPU scope the profiler kept of them, a track of frame spans, and counter tracks of each frame's time, CPU heap
+// allocations and GPU scopes. The write waits framesAfter frames past the hitch, for what followed it and for
+// the GPU profiler's results, which arrive a few frames late; hitches meanwhile go in the same file. The frame
+// the file is written in is slowed by it, so it's never taken for a hitch of its own.
+class HitchRecorder
+{
+public:
+	struct Settings {
+		double thresholdMs{ 0.0 }; // 0 disables
+		uint32_t framesBefore{ 60 };
+		uint32_t framesAfter{ 10 };
+		uint32_t maxTraces{ 10 }; // over the run, so a scene that hitches all the time doesn't fill the disk
+		std::string directory{ "hitches" };
+	};
+
+	// sizes the CPU profiler's history to the frames around a hitch
+	void init(const Settings& settings);
+	bool enabled() const { return _settings.thresholdMs > 0.0; }
+	uint32_t traces_written() const { return _written; }
+
+	// frame thread, once a frame after cpu_profiler::end_frame(), with the frame it ended
+	void end_frame(int64_t frameNumber, double frameMs, uint64_t heapAllocations, const GpuProfiler::FrameTimings& gpu);
+
+private:
+	struct FrameRecord {
+		int64_t frameNumber{ -1 };
+		double frameMs{ 0.0 };
+		uint64_t heapAllocations{ 0 };
+		uint32_t gpuScopeCount{ 0 };
+		uint32_t gpuScopes[GpuProfiler::MAX_SCOPES]; // into _gpuScopeNames
+		double gpuMs[GpuProfiler::MAX_SCOPES];
+	};
+
+	// frameNumber's record while the ring still holds it
+	FrameRecord* find_record(int64_t frameNumber);
+	uint32_t gpu_scope_index(const std::string& name);
+	// the frames up to frameNumber, the one just ended
+	void write_trace(int64_t frameNumber);
+
+	Settings _settings;
+	// the last framesBefore + framesAfter + 1 frames, indexed by frame number
+	std::vector<FrameRecord> _records;
+	// "gpu <scope>" per GPU scope name seen, the counter tracks' names
+	std::vector<std::string> _gpuScopeNames;
+	int _lastGpuFrame{ -1 };
+	int64_t _framesSeen{ 0 };
+
+	int64_t _hitchFrame{ -1 }; // the first hitch of the trace waiting to be written
+	double _hitchMs{ 0.0 }; // the slowest frame of it
+	int64_t _writeFrame{ -1 };
+	bool _skipNext{ false };
+	uint32_t _written{ 0 };
+	std::vector<cpu_profiler::Counter> _counters;
+};
@@ -0,0 +1,477 @@
+#include "Impostors.h"
+
+#include "AssetArchive.h"
+#include "JobSystem.h"
+#include "Log.h"
+#include "MappedFile.h"
+#include "vk_initializers.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <glm/geometric.hpp>
+
+namespace {
+	constexpr uint32_t IMPOSTOR_MAGIC = 0x504D4951; // "QIMP"
+	constexpr uint32_t IMPOSTOR_VERSION = 1;
+
+	struct ImpostorHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t frames;
+		uint32_t frameSize;
+		uint64_t sourceSize;
+		int64_t sourceTimestamp;
+		uint64_t sourceHash;
+	};
+	static_assert(sizeof(ImpostorHeader) == 40, "impostor header must not contain padding");
+
+	float sign_not_zero(float value)
+	{
+		return value >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	// unit direction at uv of the octahedron folded flat; impostor.vert has the inverse
+	glm::vec3 octahedron_direction(const glm::vec2& uv)
+	{
+		const glm::vec2 f = uv * 2.0f - 1.0f;
+		glm::vec3 n(f.x, 1.0f - std::fabs(f.x) - std::fabs(f.y), f.y);
+		if (n.y < 0.0f)
+		{
+			const float x = n.x;
+			n.x = (1.0f - std::fabs(n.z)) * sign_not_zero(x);
+			n.z = (1.0f - std::fabs(x)) * sign_not_zero(n.z);
+		}
+		return glm::normalize(n);
+	}
+
+	// twice the signed area of a, b and (x, y) in the view's pixel plane
+	float edge(const glm::vec3& a, const glm::vec3& b, float x, float y)
+	{
+		return (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x);
+	}
+
+	uint32_t pack_rgba8(const glm::vec3& color, bool covered)
+	{
+		const glm::vec3 c = glm::clamp(color, glm::vec3(0.0f), glm::vec3(1.0f)) * 255.0f + 0.5f;
+		return uint32_t(c.r) | (uint32_t(c.g) << 8) | (uint32_t(c.b) << 16) | (covered ? 0xFF000000u : 0u);
+	}
+}
+
+bool ImpostorAtlas::bake(const Mesh& mesh, const ImpostorBakeSettings& settings)
+{
+	clear();
+
+	const MeshLod lod = mesh.get_lod(0);
+	if (lod.indexCount < 3 || mesh._indices.size() < size_t(lod.firstIndex) + lod.indexCount || mesh._bounds.radius <= 0.0f)
+	{
+		return false;
+	}
+
+	_frames = std::max(settings.frames, 1u);
+	_frameSize = std::max(settings.frameSize, 2u);
+	const uint32_t atlasSize = size();
+	_pixels.assign(size_t(atlasSize) * atlasSize, 0);
+
+	const glm::vec3 center = mesh._bounds.origin;
+	const float scale = 0.5f * _frameSize / mesh._bounds.radius;
+	const glm::vec3 tint = glm::vec3(mesh._material.baseColor);
+	const int frameSize = static_cast<int>(_frameSize);
+
+	parallel_for(size_t(_frames) * _frames, [&](size_t frame) {
+		const uint32_t frameX = static_cast<uint32_t>(frame % _frames);
+		const uint32_t frameY = static_cast<uint32_t>(frame / _frames);
+		const glm::vec3 direction = octahedron_direction((glm::vec2(frameX, frameY) + 0.5f) / float(_frames));
+		const glm::vec3 helper = std::fabs(direction.y) > 0.999f ? glm::vec3(0.0f, 0.0f, -1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		const glm::vec3 right = glm::normalize(glm::cross(helper, direction));
+		const glm::vec3 up = glm::cross(direction, right);
+
+		// x right and y down in texels, z the distance towards the viewer; the nearest surface wins
+		auto project = [&](const glm::vec3& position) {
+			const glm::vec3 local = position - center;
+			return glm::vec3(0.5f * _frameSize + glm::dot(local, right) * scale, 0.5f * _frameSize - glm::dot(local, up) * scale,
+				glm::dot(local, direction));
+		};
+
+		std::vector<float> depth(size_t(_frameSize) * _frameSize, -FLT_MAX);
+		std::vector<glm::vec3> color(depth.size(), glm::vec3(0.0f));
+		for (uint32_t i = lod.firstIndex; i + 2 < lod.firstIndex + lod.indexCount; i += 3)
+		{
+			const Vertex& v0 = mesh._vertices[mesh._indices[i]];
+			const Vertex& v1 = mesh._vertices[mesh._indices[i + 1]];
+			const Vertex& v2 = mesh._vertices[mesh._indices[i + 2]];
+			const glm::vec3 p0 = project(v0.position);
+			const glm::vec3 p1 = project(v1.position);
+			const glm::vec3 p2 = project(v2.position);
+			// both windings: whichever side of a face the view sees is the side drawn
+			const float area = edge(p0, p1, p2.x, p2.y);
+			if (std::fabs(area) < 1e-12f)
+			{
+				continue;
+			}
+
+			const int minX = std::max(static_cast<int>(std::floor(std::min({ p0.x, p1.x, p2.x }))), 0);
+			const int maxX = std::min(static_cast<int>(std::ceil(std::max({ p0.x, p1.x, p2.x }))), frameSize - 1);
+			const int minY = std::max(static_cast<int>(std::floor(std::min({ p0.y, p1.y, p2.y }))), 0);
+			const int maxY = std::min(static_cast<int>(std::ceil(std::max({ p0.y, p1.y, p2.y }))), frameSize - 1);
+			for (int y = minY; y <= maxY; y++)
+			{
+				for (int x = minX; x <= maxX; x++)
+				{
+					const float px = x + 0.5f;
+					const float py = y + 0.5f;
+					const float w0 = edge(p1, p2, px, py) / area;
+					const float w1 = edge(p2, p0, px, py) / area;
+					const float w2 = 1.0f - w0 - w1;
+					if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+					{
+						continue;
+					}
+					const size_t texel = size_t(y) * _frameSize + x;
+					const float z = w0 * p0.z + w1 * p1.z + w2 * p2.z;
+					if (z > depth[texel])
+					{
+						depth[texel] = z;
+						color[texel] = (w0 * v0.color + w1 * v1.color + w2 * v2.color) * tint;
+					}
+				}
+			}
+		}
+
+		// two rings of texels outside the silhouette take the average of their filled neighbours
+		std::vector<uint8_t> filled(depth.size());
+		for (size_t texel = 0; texel < depth.size(); texel++)
+		{
+			filled[texel] = depth[texel] > -FLT_MAX;
+		}
+		for (int ring = 0; ring < 2; ring++)
+		{
+			std::vector<uint8_t> next = filled;
+			for (int y = 0; y < frameSize; y++)
+			{
+				for (int x = 0; x < frameSize; x++)
+				{
+					const size_t texel = size_t(y) * _frameSize + x;
+					if (filled[texel])
+					{
+						continue;
+					}
+					glm::vec3 sum(0.0f);
+					int count = 0;
+					const int neighbours[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+					for (const auto& offset : neighbours)
+					{
+						const int nx = x + offset[0];
+						const int ny = y + offset[1];
+						if (nx >= 0 && ny >= 0 && nx < frameSize && ny < frameSize && filled[size_t(ny) * _frameSize + nx])
+						{
+							sum += color[size_t(ny) * _frameSize + nx];
+							count++;
+						}
+					}
+					if (count > 0)
+					{
+						color[texel] = sum / float(count);
+						next[texel] = 1;
+					}
+				}
+			}
+			filled.swap(next);
+		}
+
+		for (uint32_t y = 0; y < _frameSize; y++)
+		{
+			uint32_t* row = &_pixels[(size_t(frameY) * _frameSize + y) * atlasSize + size_t(frameX) * _frameSize];
+			for (uint32_t x = 0; x < _frameSize; x++)
+			{
+				const size_t texel = size_t(y) * _frameSize + x;
+				row[x] = pack_rgba8(color[texel], depth[texel] > -FLT_MAX);
+			}
+		}
+	});
+	return true;
+}
+
+bool ImpostorAtlas::save(const char* path, const char* sourcePath) const
+{
+	SourceStamp stamp;
+	if (empty() || !get_source_stamp(sourcePath, stamp))
+	{
+		return false;
+	}
+
+	ImpostorHeader header = {};
+	header.magic = IMPOSTOR_MAGIC;
+	header.version = IMPOSTOR_VERSION;
+	header.frames = _frames;
+	header.frameSize = _frameSize;
+	header.sourceSize = stamp.size;
+	header.sourceTimestamp = stamp.timestamp;
+	header.sourceHash = hash_file(sourcePath);
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		return false;
+	}
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(_pixels.data()), _pixels.size() * sizeof(uint32_t));
+	return file.good();
+}
+
+bool ImpostorAtlas::load(const char* path, const char* sourcePath, const ImpostorBakeSettings& settings, const AssetArchive* archive)
+{
+	clear();
+
+	MappedFile file;
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+	if (archive == nullptr || !archive->find(path, data, size))
+	{
+		if (!file.open(path))
+		{
+			return false;
+		}
+		data = file.data();
+		size = file.size();
+	}
+
+	ImpostorHeader header;
+	if (size < sizeof(ImpostorHeader))
+	{
+		return false;
+	}
+	memcpy(&header, data, sizeof(ImpostorHeader));
+	const uint64_t atlasSize = uint64_t(header.frames) * header.frameSize;
+	if (header.magic != IMPOSTOR_MAGIC || header.version != IMPOSTOR_VERSION || header.frames != settings.frames
+		|| header.frameSize != settings.frameSize || size < sizeof(ImpostorHeader) + atlasSize * atlasSize * sizeof(uint32_t))
+	{
+		return false;
+	}
+
+	SourceStamp stamp;
+	if (get_source_stamp(sourcePath, stamp))
+	{
+		if (stamp.size != header.sourceSize || (stamp.timestamp != header.sourceTimestamp && hash_file(sourcePath) != header.sourceHash))
+		{
+			LOG_WARN(path << " is older than " << sourcePath << ", ignoring it");
+			return false;
+		}
+	}
+
+	_frames = header.frames;
+	_frameSize = header.frameSize;
+	_pixels.resize(size_t(atlasSize) * atlasSize);
+	memcpy(_pixels.data(), data + sizeof(ImpostorHeader), _pixels.size() * sizeof(uint32_t));
+	return true;
+}
+
+void ImpostorAtlas::clear()
+{
+	_frames = 0;
+	_frameSize = 0;
+	_pixels.clear();
+}
+
+std::string ImpostorAtlas::cache_path(const std::string& sourcePath, uint32_t part)
+{
+	return sourcePath + (part == 0 ? std::string() : "." + std::to_string(part)) + IMPOSTOR_EXTENSION;
+}
+
+void Impostors::init(VkDevice device, VmaAllocator allocator, DescriptorAllocator& descriptors, uint32_t capacity, uint32_t frameCount,
+	const ImpostorBakeSettings& settings)
+{
+	_device = device;
+	_allocator = allocator;
+	_settings = settings;
+	_capacity = std::max(capacity, 1u);
+	_layerCount = 0;
+	_initialized = false;
+
+	const uint32_t atlasSize = _settings.frames * _settings.frameSize;
+	VmaAllocationCreateInfo imageAllocInfo = {};
+	imageAllocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+	VkImageCreateInfo imageInfo = vkinit::image_create_info(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+		{ atlasSize, atlasSize, 1 });
+	imageInfo.arrayLayers = _capacity;
+	VK_CHECK(vmaCreateImage(_allocator, &imageInfo, &imageAllocInfo, &_image._image, &_image._allocation, nullptr));
+
+	VkImageViewCreateInfo viewInfo = vkinit::imageview_create_info(VK_FORMAT_R8G8B8A8_UNORM, _image._image, VK_IMAGE_ASPECT_COLOR_BIT);
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+	viewInfo.subresourceRange.layerCount = _capacity;
+	VK_CHECK(vkCreateImageView(_device, &viewInfo, nullptr, &_view));
+
+	// clamped, so the frames on the atlas's border don't filter in the opposite side
+	VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	VK_CHECK(vkCreateSampler(_device, &samplerInfo, nullptr, &_sampler));
+
+	VkDescriptorSetLayoutBinding binding = vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0);
+	VkDescriptorSetLayoutCreateInfo setInfo = {};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setInfo.pNext = nullptr;
+	setInfo.bindingCount = 1;
+	setInfo.pBindings = &binding;
+	VK_CHECK(vkCreateDescriptorSetLayout(_device, &setInfo, nullptr, &_setLayout));
+
+	descriptors.allocate(&_set, _setLayout);
+	VkDescriptorImageInfo atlasInfo = { _sampler, _view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	VkWriteDescriptorSet write = vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _set, &atlasInfo, 0);
+	vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+
+	// written by the CPU every frame and read once by the vertex fetch
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.pNext = nullptr;
+	bufferInfo.size = VkDeviceSize(MAX_INSTANCES) * std::max(frameCount, 1u) * sizeof(GpuImpostorInstance);
+	bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+	VmaAllocationCreateInfo bufferAllocInfo = {};
+	bufferAllocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+	bufferAllocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+	VmaAllocationInfo mappedInfo;
+	VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &bufferAllocInfo, &_instances._buffer, &_instances._allocation, &mappedInfo));
+	_instances._mapped = mappedInfo.pMappedData;
+	_frame = 0;
+	_instanceCount = 0;
+}
+
+void Impostors::cleanup()
+{
+	for (PendingUpload& upload : _pending)
+	{
+		vmaDestroyBuffer(_allocator, upload.staging._buffer, upload.staging._allocation);
+	}
+	_pending.clear();
+	if (_instances._buffer != VK_NULL_HANDLE)
+	{
+		vmaDestroyBuffer(_allocator, _instances._buffer, _instances._allocation);
+		_instances = {};
+	}
+	if (_image._image != VK_NULL_HANDLE)
+	{
+		vkDestroySampler(_device, _sampler, nullptr);
+		vkDestroyImageView(_device, _view, nullptr);
+		vmaDestroyImage(_allocator, _image._image, _image._allocation);
+		vkDestroyDescriptorSetLayout(_device, _setLayout, nullptr);
+		_image = {};
+		_sampler = VK_NULL_HANDLE;
+		_view = VK_NULL_HANDLE;
+		_setLayout = VK_NULL_HANDLE;
+	}
+	_set = VK_NULL_HANDLE;
+	_layerCount = 0;
+}
+
+uint32_t Impostors::add(const ImpostorAtlas& atlas)
+{
+	if (!ready() || atlas.frames() != _settings.frames || atlas.size() != _settings.frames * _settings.frameSize || _layerCount >= _capacity)
+	{
+		return UINT32_MAX;
+	}
+
+	const size_t byteSize = atlas.pixels().size() * sizeof(uint32_t);
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.pNext = nullptr;
+	bufferInfo.size = byteSize;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+	allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+	VmaAllocationInfo mappedInfo;
+	PendingUpload upload;
+	VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &allocInfo, &upload.staging._buffer, &upload.staging._allocation, &mappedInfo));
+	memcpy(mappedInfo.pMappedData, atlas.pixels().data(), byteSize);
+	vmaFlushAllocation(_allocator, upload.staging._allocation, 0, VK_WHOLE_SIZE);
+	upload.layer = _layerCount++;
+	_pending.push_back(upload);
+	return upload.layer;
+}
+
+void Impostors::begin_frame(VkCommandBuffer cmd, uint32_t frame, DeletionQueue& deletionQueue)
+{
+	_frame = frame;
+	_instanceCount = 0;
+	if (!ready())
+	{
+		return;
+	}
+
+	// the descriptor names every layer, so the ones nothing was copied into yet still need a layout
+	if (!_initialized)
+	{
+		VkImageMemoryBarrier barrier = vkinit::image_barrier(_image._image, 0, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+		barrier.subresourceRange.layerCount = _capacity;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		_initialized = true;
+	}
+	if (_pending.empty())
+	{
+		return;
+	}
+
+	// a new layer was never sampled, but its transition out of the read layout still follows the one into it
+	std::vector<VkImageMemoryBarrier> barriers(_pending.size());
+	for (size_t i = 0; i < _pending.size(); i++)
+	{
+		barriers[i] = vkinit::image_barrier(_image._image, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+		barriers[i].subresourceRange.baseArrayLayer = _pending[i].layer;
+	}
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+		static_cast<uint32_t>(barriers.size()), barriers.data());
+
+	const uint32_t atlasSize = _settings.frames * _settings.frameSize;
+	for (size_t i = 0; i < _pending.size(); i++)
+	{
+		VkBufferImageCopy copy = {};
+		copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copy.imageSubresource.mipLevel = 0;
+		copy.imageSubresource.baseArrayLayer = _pending[i].layer;
+		copy.imageSubresource.layerCount = 1;
+		copy.imageExtent = { atlasSize, atlasSize, 1 };
+		vkCmdCopyBufferToImage(cmd, _pending[i].staging._buffer, _image._image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+		deletionQueue.push_buffer(_pending[i].staging);
+
+		barriers[i].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barriers[i].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barriers[i].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barriers[i].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	}
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr,
+		static_cast<uint32_t>(barriers.size()), barriers.data());
+	_pending.clear();
+}
+
+bool Impostors::push(const glm::mat4& model, const glm::vec4& sphere, uint32_t layer)
+{
+	if (!ready() || _instanceCount >= MAX_INSTANCES)
+	{
+		return false;
+	}
+	GpuImpostorInstance& instance = static_cast<GpuImpostorInstance*>(_instances._mapped)[size_t(_frame) * MAX_INSTANCES + _instanceCount++];
+	instance.modelRow0 = glm::vec4(model[0][0], model[1][0], model[2][0], model[3][0]);
+	instance.modelRow1 = glm::vec4(model[0][1], model[1][1], model[2][1], model[3][1]);
+	instance.modelRow2 = glm::vec4(model[0][2], model[1][2], model[2][2], model[3][2]);
+	instance.sphere = sphere;
+	instance.layer = static_cast<float>(layer);
+	return true;
+}
+
+void Impostors::draw(VkCommandBuffer cmd, VkPipelineLayout layout) const
+{
+	if (_instanceCount == 0)
+	{
+		return;
+	}
+	const VkDeviceSize offset = VkDeviceSize(_frame) * MAX_INSTANCES * sizeof(GpuImpostorInstance);
+	vmaFlushAllocation(_allocator, _instances._allocation, offset, VkDeviceSize(_instanceCount) * sizeof(GpuImpostorInstance));
+
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 1, 1, &_set, 0, nullptr);
+	vkCmdBindVertexBuffers(cmd, 0, 1, &_instances._buffer, &offset);
+	// the six corners of the quad come from gl_VertexIndex
+	vkCmdDraw(cmd, 6, _instanceCount, 0, 0);
+}
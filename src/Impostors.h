@@ -0,0 +1,144 @@
+#pragma once
+
+#include <vk_types.h>
+#include <DeletionQueue.h>
+#include <DescriptorAllocator.h>
+#include <Mesh.h>
+#include <VertexLayout.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+class AssetArchive;
+
+// baked next to the mesh's source: its own name, the part number for parts past the first, then this
+constexpr const char* IMPOSTOR_EXTENSION = ".qcimp";
+
+struct ImpostorBakeSettings {
+	// views along each side of the octahedral grid, and the texels along each side of a view
+	uint32_t frames{ 8 };
+	uint32_t frameSize{ 64 };
+};
+
+// Octahedral impostor of one mesh: the mesh rendered from frames x frames directions spread over the whole
+// sphere, each view an orthographic frameSize square over its bounding sphere, packed into one RGBA8 atlas.
+// Texel (u, v) of the atlas's grid maps to a direction through the octahedron folded flat (+y at the center,
+// -y in the corners), so the views neighbouring a direction are also its neighbours in the atlas. Color is
+// the vertex color times the material's base color, alpha the coverage; texels just outside the silhouette
+// take their neighbours' color, so filtering at the edges doesn't pull in black.
+// A view looks at the mesh from direction d: its right axis is cross(helper, d) and its up cross(d, right),
+// with helper +y unless d is nearly vertical; impostor.vert rebuilds the same axes to place the quad.
+// Baked on the CPU from level 0, one view per worker.
+class ImpostorAtlas
+{
+public:
+	// false when the mesh's CPU indices are gone or it has no triangles
+	bool bake(const Mesh& mesh, const ImpostorBakeSettings& settings = {});
+
+	// stamped with sourcePath, like the mesh caches
+	bool save(const char* path, const char* sourcePath) const;
+	// from archive's copy of path when it has one; false (and empty) when missing, outdated, corrupt or
+	// baked with other settings
+	bool load(const char* path, const char* sourcePath, const ImpostorBakeSettings& settings = {}, const AssetArchive* archive = nullptr);
+	void clear();
+
+	// where part of sourcePath keeps its atlas
+	static std::string cache_path(const std::string& sourcePath, uint32_t part);
+
+	bool empty() const { return _pixels.empty(); }
+	uint32_t frames() const { return _frames; }
+	uint32_t size() const { return _frames * _frameSize; } // texels along each side
+	const std::vector<uint32_t>& pixels() const { return _pixels; }
+
+private:
+	uint32_t _frames{ 0 };
+	uint32_t _frameSize{ 0 };
+	std::vector<uint32_t> _pixels; // RGBA8, row by row
+};
+
+// per instance vertex input of impostor.vert: the object's transform as the rows of its affine part, its
+// mesh's bounding sphere in mesh space, and the atlas layer drawn
+struct GpuImpostorInstance {
+	glm::vec4 modelRow0;
+	glm::vec4 modelRow1;
+	glm::vec4 modelRow2;
+	glm::vec4 sphere;
+	float layer;
+	float pad[3];
+};
+
+constexpr auto IMPOSTOR_INSTANCE_LAYOUT = vertex_layout(
+	{ vertex_binding(0, sizeof(GpuImpostorInstance), VK_VERTEX_INPUT_RATE_INSTANCE) },
+	{ VERTEX_ATTRIBUTE(GpuImpostorInstance, modelRow0, 0, 0), VERTEX_ATTRIBUTE(GpuImpostorInstance, modelRow1, 1, 0),
+		VERTEX_ATTRIBUTE(GpuImpostorInstance, modelRow2, 2, 0), VERTEX_ATTRIBUTE(GpuImpostorInstance, sphere, 3, 0),
+		VERTEX_ATTRIBUTE(GpuImpostorInstance, layer, 4, 0) });
+
+// Every mesh's impostor atlas as a layer of one array image, and the far objects drawn as camera-facing
+// quads, one instanced draw for the frame. An object's quad stands in the view plane of the atlas frame nearest
+// to the direction it's seen from, so its picture stays the mesh's from roughly that side; it pops to the
+// next frame as the camera moves round it rather than blending, which at the sizes impostors are drawn at
+// hardly shows.
+// Atlases are added as they arrive and copied in by the next begin_frame; instances are written straight into
+// the frame slot's mapped buffer between begin_frame and draw.
+class Impostors
+{
+public:
+	// quads per frame slot; objects past it are drawn as meshes
+	static constexpr uint32_t MAX_INSTANCES = 16384;
+
+	// capacity layers of settings' atlas size
+	void init(VkDevice device, VmaAllocator allocator, DescriptorAllocator& descriptors, uint32_t capacity, uint32_t frameCount,
+		const ImpostorBakeSettings& settings = {});
+	void cleanup();
+
+	bool ready() const { return _image._image != VK_NULL_HANDLE; }
+	uint32_t frames() const { return _settings.frames; }
+
+	// the atlas array and its sampler at binding 0; the impostor pipeline binds it as set 1
+	VkDescriptorSetLayout set_layout() const { return _setLayout; }
+	VkDescriptorSet set() const { return _set; }
+
+	// queues atlas for the next begin_frame and returns its layer, UINT32_MAX when it was baked at another
+	// size or every layer is taken
+	uint32_t add(const ImpostorAtlas& atlas);
+
+	// outside a render pass: copies the atlases added since the last call into their layers, their staging
+	// freed with deletionQueue, and starts the frame slot's instance list empty
+	void begin_frame(VkCommandBuffer cmd, uint32_t frame, DeletionQueue& deletionQueue);
+	// one more quad this frame, false once the slot is full
+	bool push(const glm::mat4& model, const glm::vec4& sphere, uint32_t layer);
+	uint32_t instance_count() const { return _instanceCount; }
+
+	// inside the render pass with the impostor pipeline and set 0 bound: binds set 1 and the instances, and
+	// draws them all
+	void draw(VkCommandBuffer cmd, VkPipelineLayout layout) const;
+
+private:
+	VkDevice _device{ VK_NULL_HANDLE };
+	VmaAllocator _allocator{ nullptr };
+	ImpostorBakeSettings _settings;
+	uint32_t _capacity{ 0 };
+	uint32_t _layerCount{ 0 }; // taken
+	bool _initialized{ false }; // every layer transitioned to be sampled
+
+	AllocatedImage _image{};
+	VkImageView _view{ VK_NULL_HANDLE };
+	VkSampler _sampler{ VK_NULL_HANDLE };
+	VkDescriptorSetLayout _setLayout{ VK_NULL_HANDLE };
+	VkDescriptorSet _set{ VK_NULL_HANDLE };
+
+	struct PendingUpload {
+		AllocatedBuffer staging;
+		uint32_t layer;
+	};
+	std::vector<PendingUpload> _pending;
+
+	// MAX_INSTANCES per frame slot, host visible
+	AllocatedBuffer _instances{};
+	uint32_t _frame{ 0 };
+	uint32_t _instanceCount{ 0 };
+};
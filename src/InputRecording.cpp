@@ -0,0 +1,143 @@
+#include "InputRecording.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+namespace {
+	constexpr uint32_t INPUT_RECORDING_MAGIC = 0x52494351; // "QCIR"
+	constexpr uint32_t INPUT_RECORDING_VERSION = 1;
+
+	struct InputRecordingHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t eventSize; // sizeof(SDL_Event) of the build that wrote it
+		uint32_t reserved;
+		uint64_t frameCount;
+		uint64_t eventCount;
+	};
+	static_assert(sizeof(InputRecordingHeader) == 32, "input recording header must not contain padding");
+
+	uint64_t steady_ns()
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+}
+
+void InputRecording::start()
+{
+	clear();
+	// a long session's worth, so recording doesn't reallocate every few seconds
+	_frames.reserve(1 << 16);
+	_events.reserve(1 << 16);
+	_startNs = steady_ns();
+	_recording = true;
+}
+
+void InputRecording::add_event(const SDL_Event& event)
+{
+	if (!_recording)
+	{
+		return;
+	}
+	switch (event.type)
+	{
+	case SDL_KEYDOWN:
+	case SDL_KEYUP:
+	case SDL_MOUSEMOTION:
+	case SDL_MOUSEBUTTONDOWN:
+	case SDL_MOUSEBUTTONUP:
+	case SDL_MOUSEWHEEL:
+		_events.push_back({ steady_ns() - _startNs, event });
+		break;
+	default:
+		// quits end the session rather than being part of it, and a window's size is the replaying run's own
+		break;
+	}
+}
+
+void InputRecording::end_frame(double elapsedSeconds)
+{
+	if (!_recording)
+	{
+		return;
+	}
+	const uint32_t eventCount = static_cast<uint32_t>(_events.size()) - _pendingFirst;
+	_frames.push_back({ elapsedSeconds, _pendingFirst, eventCount });
+	_pendingFirst = static_cast<uint32_t>(_events.size());
+}
+
+bool InputRecording::save(const char* path) const
+{
+	InputRecordingHeader header = {};
+	header.magic = INPUT_RECORDING_MAGIC;
+	header.version = INPUT_RECORDING_VERSION;
+	header.eventSize = sizeof(SDL_Event);
+	header.frameCount = _frames.size();
+	// events polled after the last frame closed belong to no frame
+	header.eventCount = _pendingFirst;
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		return false;
+	}
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(_frames.data()), _frames.size() * sizeof(Frame));
+	file.write(reinterpret_cast<const char*>(_events.data()), header.eventCount * sizeof(Event));
+	return file.good();
+}
+
+bool InputRecording::load(const char* path)
+{
+	clear();
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+	{
+		return false;
+	}
+	const uint64_t size = static_cast<uint64_t>(file.tellg());
+	file.seekg(0);
+	InputRecordingHeader header;
+	if (size < sizeof(header) || !file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+	{
+		return false;
+	}
+	// the counts are checked against the file before anything is sized by them
+	if (header.magic != INPUT_RECORDING_MAGIC || header.version != INPUT_RECORDING_VERSION || header.eventSize != sizeof(SDL_Event)
+		|| header.frameCount > size / sizeof(Frame) || header.eventCount > size / sizeof(Event)
+		|| size < sizeof(header) + header.frameCount * sizeof(Frame) + header.eventCount * sizeof(Event))
+	{
+		return false;
+	}
+
+	_frames.resize(header.frameCount);
+	_events.resize(header.eventCount);
+	file.read(reinterpret_cast<char*>(_frames.data()), _frames.size() * sizeof(Frame));
+	file.read(reinterpret_cast<char*>(_events.data()), _events.size() * sizeof(Event));
+	if (!file)
+	{
+		clear();
+		return false;
+	}
+	// every frame's events must be in the file, so a replay never reads past them
+	for (const Frame& frame : _frames)
+	{
+		if (uint64_t(frame.firstEvent) + frame.eventCount > _events.size())
+		{
+			clear();
+			return false;
+		}
+	}
+	return true;
+}
+
+void InputRecording::clear()
+{
+	_frames.clear();
+	_events.clear();
+	_startNs = 0;
+	_pendingFirst = 0;
+	_recording = false;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <SDL_events.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The input of an interactive session, frame by frame, for replaying the same workload later: every key,
+// mouse button, motion and wheel event run() handled, and the real time each frame handed the fixed-step
+// simulation. Replaying both gives the simulation the same steps and the event handling the same input on
+// the same frames, whatever the frame times of the build doing the replay. Window events aren't kept, so a
+// replay is only the same workload in a window of the same size. Files are raw SDL_Events and only read back
+// by builds against the same SDL.
+class InputRecording
+{
+public:
+	struct Frame {
+		double elapsedSeconds; // what begin_update() was given
+		uint32_t firstEvent;
+		uint32_t eventCount;
+	};
+	struct Event {
+		uint64_t timeNs; // from the first frame's start
+		SDL_Event event;
+	};
+
+	// recording: events polled for the frame being built, then the frame closed with its update time
+	void start();
+	bool recording() const { return _recording; }
+	// ignores event types a replay shouldn't repeat
+	void add_event(const SDL_Event& event);
+	void end_frame(double elapsedSeconds);
+
+	bool save(const char* path) const;
+	// false (and empty) when missing, corrupt or written against another SDL_Event layout
+	bool load(const char* path);
+	void clear();
+
+	size_t frame_count() const { return _frames.size(); }
+	size_t event_count() const { return _events.size(); }
+	const Frame& frame(size_t index) const { return _frames[index]; }
+	const Event& event(size_t index) const { return _events[index]; }
+
+private:
+	std::vector<Frame> _frames;
+	std::vector<Event> _events;
+	uint64_t _startNs{ 0 };
+	uint32_t _pendingFirst{ 0 }; // the open frame's first event
+	bool _recording{ false };
+};
@@ -0,0 +1,291 @@
+#include "JobSystem.h"
+
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+namespace {
+	// which scheduler's worker the current thread is, if any
+	thread_local JobSystem* t_owner = nullptr;
+	thread_local unsigned t_workerIndex = 0;
+	// jobs running on this thread right now, counting the ones started by wait() inside a job
+	thread_local unsigned t_jobDepth = 0;
+	// set_shared() of the current thread
+	thread_local JobSystem* t_shared = nullptr;
+}
+
+JobSystem* JobSystem::shared()
+{
+	return t_owner != nullptr ? t_owner : t_shared;
+}
+
+void JobSystem::set_shared(JobSystem* jobs)
+{
+	t_shared = jobs;
+}
+
+void JobSystem::init(unsigned threadCount)
+{
+	if (threadCount == 0)
+	{
+		threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+	}
+
+	_running = true;
+	_workerCount = threadCount;
+	for (unsigned i = 0; i < threadCount + 1; i++)
+	{
+		_queues.push_back(std::make_unique<WorkerQueue>());
+	}
+	for (unsigned i = 0; i < threadCount; i++)
+	{
+		_workers.emplace_back([this, i]() { worker_loop(i); });
+	}
+}
+
+void JobSystem::cleanup()
+{
+	{
+		std::lock_guard<std::mutex> lock(_sleepMutex);
+		_running = false;
+	}
+	_wake.notify_all();
+	for (std::thread& worker : _workers)
+	{
+		worker.join();
+	}
+	_workers.clear();
+	_queues.clear();
+	_workerCount = 0;
+
+	if (t_shared == this)
+	{
+		t_shared = nullptr;
+	}
+}
+
+void JobSystem::run(std::function<void()> fn, JobCounter* counter)
+{
+	if (counter)
+	{
+		counter->_pending.fetch_add(1, std::memory_order_relaxed);
+	}
+	submit({ std::move(fn), counter, heap_stats::current_tag() });
+}
+
+void JobSystem::run_after(JobCounter& dependency, std::function<void()> fn, JobCounter* counter)
+{
+	if (counter)
+	{
+		counter->_pending.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// finish() takes the same lock before draining, so the job is either seen there or submitted here
+	{
+		std::lock_guard<std::mutex> lock(dependency._mutex);
+		if (!dependency.done())
+		{
+			dependency._continuations.push_back({ std::move(fn), counter, heap_stats::current_tag() });
+			return;
+		}
+	}
+	submit({ std::move(fn), counter, heap_stats::current_tag() });
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+	Job job;
+	while (!counter.done())
+	{
+		if (take_job(job))
+		{
+			execute(job);
+		}
+		else
+		{
+			// whatever is left is running on other threads
+			std::this_thread::yield();
+		}
+	}
+
+	// the last finish() may still hold the counter's lock; the caller is free to destroy it after this
+	std::lock_guard<std::mutex> lock(counter._mutex);
+}
+
+void JobSystem::parallel_for(size_t count, const std::function<void(size_t)>& fn, unsigned maxThreads)
+{
+	const unsigned limit = maxThreads == 0 ? thread_count() : std::min(maxThreads, thread_count());
+	const unsigned threads = static_cast<unsigned>(std::min<size_t>(limit, count));
+	if (threads <= 1)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			fn(i);
+		}
+		return;
+	}
+
+	std::atomic<size_t> next{ 0 };
+	auto worker = [&]() {
+		for (size_t i = next++; i < count; i = next++)
+		{
+			fn(i);
+		}
+	};
+
+	// helpers that start after the items ran out return straight away
+	JobCounter counter;
+	for (unsigned i = 1; i < threads; i++)
+	{
+		run(worker, &counter);
+	}
+	worker();
+	wait(counter);
+}
+
+void JobSystem::worker_loop(unsigned index)
+{
+	t_owner = this;
+	t_workerIndex = index;
+	cpu_profiler::set_thread_name(("job worker " + std::to_string(index)).c_str());
+
+	Job job;
+	while (true)
+	{
+		if (take_job(job))
+		{
+			execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(_sleepMutex);
+		_wake.wait(lock, [this]() { return !_running || _queuedJobs.load() > 0; });
+		if (!_running && _queuedJobs.load() == 0)
+		{
+			break;
+		}
+	}
+
+	t_owner = nullptr;
+}
+
+void JobSystem::submit(Job job)
+{
+	WorkerQueue& queue = t_owner == this ? *_queues[t_workerIndex] : *_queues.back();
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(std::move(job));
+	}
+
+	// counted under the sleep lock so a worker about to sleep can't miss it
+	{
+		std::lock_guard<std::mutex> lock(_sleepMutex);
+		_queuedJobs++;
+	}
+	_wake.notify_one();
+}
+
+bool JobSystem::take_job(Job& job)
+{
+	auto pop = [&](WorkerQueue& queue, bool back) {
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.jobs.empty())
+		{
+			return false;
+		}
+		if (back)
+		{
+			job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+		}
+		else
+		{
+			job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+		}
+		_queuedJobs--;
+		return true;
+	};
+
+	const bool isWorker = t_owner == this;
+	const unsigned workerCount = worker_count();
+	if (isWorker && pop(*_queues[t_workerIndex], true))
+	{
+		return true;
+	}
+	if (pop(*_queues.back(), false))
+	{
+		return true;
+	}
+
+	// start past our own queue so thieves spread over the victims
+	const unsigned start = isWorker ? t_workerIndex + 1 : 0;
+	for (unsigned i = 0; i < workerCount; i++)
+	{
+		const unsigned victim = (start + i) % workerCount;
+		if (isWorker && victim == t_workerIndex)
+		{
+			continue;
+		}
+		if (pop(*_queues[victim], false))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void JobSystem::execute(Job& job)
+{
+	const auto start = std::chrono::steady_clock::now();
+	t_jobDepth++;
+	{
+		CPU_PROFILE_SCOPE("job");
+		heap_stats::Scope heapScope(job.heapTag);
+		job.fn();
+	}
+	if (--t_jobDepth == 0)
+	{
+		const auto busy = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+		_busyNs.fetch_add(static_cast<uint64_t>(busy.count()), std::memory_order_relaxed);
+	}
+	job.fn = nullptr;
+	if (job.counter)
+	{
+		finish(*job.counter);
+	}
+}
+
+void JobSystem::finish(JobCounter& counter)
+{
+	// the counter is only touched under its lock, so wait() can't return while this still uses it
+	std::vector<Job> ready;
+	{
+		std::lock_guard<std::mutex> lock(counter._mutex);
+		if (counter._pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+		{
+			return;
+		}
+		ready.swap(counter._continuations);
+	}
+	for (Job& job : ready)
+	{
+		submit(std::move(job));
+	}
+}
+
+void parallel_for(size_t count, const std::function<void(size_t)>& fn, unsigned threadCount)
+{
+	if (JobSystem* jobs = JobSystem::shared())
+	{
+		jobs->parallel_for(count, fn, threadCount);
+		return;
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		fn(i);
+	}
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <HeapStats.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobCounter;
+
+struct Job {
+	std::function<void()> fn;
+	JobCounter* counter; // decremented once fn returns, may be null
+	HeapTag heapTag{ HeapTag::Untagged }; // the queuing thread's, which fn's allocations count under
+};
+
+// Counts unfinished jobs; anything queued with run_after() on it starts once it drops to zero.
+// Must outlive every job that references it; destroy it only after JobSystem::wait() on it returned.
+class JobCounter
+{
+public:
+	bool done() const { return _pending.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+
+	std::atomic<uint32_t> _pending{ 0 };
+	std::mutex _mutex;
+	std::vector<Job> _continuations;
+};
+
+// Work-stealing scheduler shared by every subsystem. Each worker owns a deque: it pushes and pops
+// its own jobs at the back (newest first, still warm in cache) while idle workers steal from the
+// front. Jobs submitted from outside the pool go to a shared queue that every worker drains.
+// wait() runs other jobs instead of blocking, so jobs may wait on jobs without deadlocking the pool.
+class JobSystem
+{
+public:
+	// starts threadCount workers; 0 uses one per core, leaving one for the calling thread
+	void init(unsigned threadCount = 0);
+	// finishes everything queued, then joins the workers
+	void cleanup();
+
+	// queues fn; counter is incremented now and decremented when fn returns
+	void run(std::function<void()> fn, JobCounter* counter = nullptr);
+	// queues fn once dependency is done (immediately if it already is); counter is incremented now
+	void run_after(JobCounter& dependency, std::function<void()> fn, JobCounter* counter = nullptr);
+	// executes queued jobs on the calling thread until counter is done
+	void wait(JobCounter& counter);
+
+	// runs fn(i) for every i in [0, count) on up to maxThreads threads, the caller included (0 = all);
+	// items are handed out one at a time so uneven items still balance. Blocks until done
+	void parallel_for(size_t count, const std::function<void(size_t)>& fn, unsigned maxThreads = 0);
+
+	unsigned worker_count() const { return _workerCount; }
+	// workers plus the calling thread
+	unsigned thread_count() const { return worker_count() + 1; }
+	// time every thread has spent running jobs since init(), for utilization over some interval.
+	// Jobs run inside another job's wait() count towards the outer job only
+	uint64_t busy_ns() const { return _busyNs.load(std::memory_order_relaxed); }
+
+	// scheduler the free parallel_for below uses on the calling thread: a worker's own pool, else the one
+	// set_shared() gave the thread, null when none. Per thread, so engines on different threads each
+	// keep to their own pool; a thread started on behalf of a pool's owner sets it first
+	static JobSystem* shared();
+	static void set_shared(JobSystem* jobs);
+
+private:
+	struct WorkerQueue {
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	void worker_loop(unsigned index);
+	void submit(Job job);
+	// own queue from the back, then the shared queue, then steal from the other workers
+	bool take_job(Job& job);
+	void execute(Job& job);
+	// the counter's continuations are queued when its last job finishes
+	void finish(JobCounter& counter);
+
+	std::vector<std::thread> _workers;
+	// fixed before the first worker starts, since workers read it while _workers is still filling up
+	unsigned _workerCount{ 0 };
+	// one per worker, plus the shared queue for outside threads last
+	std::vector<std::unique_ptr<WorkerQueue>> _queues;
+
+	std::mutex _sleepMutex;
+	std::condition_variable _wake;
+	std::atomic<size_t> _queuedJobs{ 0 };
+	std::atomic<uint64_t> _busyNs{ 0 };
+	bool _running{ false };
+};
+
+// JobSystem::parallel_for on the shared scheduler; runs inline on the calling thread when there is none
+void parallel_for(size_t count, const std::function<void(size_t)>& fn, unsigned threadCount = 0);
@@ -0,0 +1,144 @@
+#include "LayoutCache.h"
+
+#include <vk_initializers.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+size_t LayoutCache::KeyHash::operator()(const Key& key) const
+{
+	// FNV-1a over the words
+	uint64_t hash = 14695981039346656037ull;
+	for (uint64_t word : key)
+	{
+		hash ^= word;
+		hash *= 1099511628211ull;
+	}
+	return static_cast<size_t>(hash);
+}
+
+void LayoutCache::init(VkDevice device)
+{
+	_device = device;
+}
+
+void LayoutCache::cleanup()
+{
+	for (auto& layout : _pipelineLayouts)
+	{
+		vkDestroyPipelineLayout(_device, layout.second, nullptr);
+	}
+	for (auto& layout : _setLayouts)
+	{
+		vkDestroyDescriptorSetLayout(_device, layout.second, nullptr);
+	}
+	for (auto& sampler : _samplers)
+	{
+		vkDestroySampler(_device, sampler.second, nullptr);
+	}
+	_pipelineLayouts.clear();
+	_setLayouts.clear();
+	_samplers.clear();
+}
+
+VkDescriptorSetLayout LayoutCache::set_layout(std::vector<VkDescriptorSetLayoutBinding> bindings)
+{
+	_requests++;
+	std::sort(bindings.begin(), bindings.end(), [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) {
+		return a.binding < b.binding;
+	});
+
+	Key key;
+	key.reserve(bindings.size() * 2);
+	for (const VkDescriptorSetLayoutBinding& binding : bindings)
+	{
+		key.push_back((uint64_t(binding.binding) << 32) | uint64_t(binding.descriptorType));
+		key.push_back((uint64_t(binding.descriptorCount) << 32) | uint64_t(binding.stageFlags));
+	}
+
+	auto cached = _setLayouts.find(key);
+	if (cached != _setLayouts.end())
+	{
+		return cached->second;
+	}
+
+	VkDescriptorSetLayoutCreateInfo setInfo = {};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setInfo.pNext = nullptr;
+	setInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	setInfo.pBindings = bindings.data();
+
+	VkDescriptorSetLayout layout;
+	VK_CHECK(vkCreateDescriptorSetLayout(_device, &setInfo, nullptr, &layout));
+	_setLayouts.emplace(std::move(key), layout);
+	return layout;
+}
+
+VkPipelineLayout LayoutCache::pipeline_layout(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstants)
+{
+	_requests++;
+
+	// set layouts are compared by handle, the set layouts of this cache being unique by contents already
+	Key key;
+	key.reserve(1 + setLayouts.size() + pushConstants.size() * 2);
+	key.push_back(setLayouts.size());
+	for (VkDescriptorSetLayout setLayout : setLayouts)
+	{
+		key.push_back(reinterpret_cast<uint64_t>(setLayout));
+	}
+	for (const VkPushConstantRange& range : pushConstants)
+	{
+		key.push_back((uint64_t(range.offset) << 32) | uint64_t(range.size));
+		key.push_back(uint64_t(range.stageFlags));
+	}
+
+	auto cached = _pipelineLayouts.find(key);
+	if (cached != _pipelineLayouts.end())
+	{
+		return cached->second;
+	}
+
+	VkPipelineLayoutCreateInfo layoutInfo = vkinit::pipeline_layout_create_info();
+	layoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+	layoutInfo.pSetLayouts = setLayouts.data();
+	layoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstants.size());
+	layoutInfo.pPushConstantRanges = pushConstants.data();
+
+	VkPipelineLayout layout;
+	VK_CHECK(vkCreatePipelineLayout(_device, &layoutInfo, nullptr, &layout));
+	_pipelineLayouts.emplace(std::move(key), layout);
+	return layout;
+}
+
+VkSampler LayoutCache::sampler(const VkSamplerCreateInfo& info)
+{
+	_requests++;
+	assert(info.pNext == nullptr);
+
+	// floats by their bits; samplers differing in -0 and 0 alone are rare enough to create twice
+	auto bits = [](float value) {
+		uint32_t word;
+		memcpy(&word, &value, sizeof(word));
+		return uint64_t(word);
+	};
+	Key key = {
+		(uint64_t(info.flags) << 32) | (uint64_t(info.magFilter) << 16) | (uint64_t(info.minFilter) << 8) | uint64_t(info.mipmapMode),
+		(uint64_t(info.addressModeU) << 32) | (uint64_t(info.addressModeV) << 16) | uint64_t(info.addressModeW),
+		(bits(info.mipLodBias) << 32) | (uint64_t(info.anisotropyEnable) << 1) | uint64_t(info.compareEnable),
+		(bits(info.maxAnisotropy) << 32) | uint64_t(info.compareOp),
+		(bits(info.minLod) << 32) | bits(info.maxLod),
+		(uint64_t(info.borderColor) << 32) | uint64_t(info.unnormalizedCoordinates),
+	};
+
+	auto cached = _samplers.find(key);
+	if (cached != _samplers.end())
+	{
+		return cached->second;
+	}
+
+	VkSampler sampler;
+	VK_CHECK(vkCreateSampler(_device, &info, nullptr, &sampler));
+	_samplers.emplace(std::move(key), sampler);
+	return sampler;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vk_types.h>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Descriptor set and pipeline layouts, and samplers, created once per distinct description and handed
+// out again for every later request with the same contents, so pipelines whose shaders declare the same
+// interface share one layout and stay compatible for set binds across pipeline changes, and the passes
+// that each want a clamped nearest sampler share one.
+// Everything is owned by the cache and lives until cleanup().
+class LayoutCache
+{
+public:
+	void init(VkDevice device);
+	void cleanup();
+
+	// bindings in any order; only plain layouts, without flags or binding flags
+	VkDescriptorSetLayout set_layout(std::vector<VkDescriptorSetLayoutBinding> bindings);
+	VkPipelineLayout pipeline_layout(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstants);
+	// without pNext chains
+	VkSampler sampler(const VkSamplerCreateInfo& info);
+
+	// of the requests so far, for logging
+	uint32_t requests() const { return _requests; }
+	size_t layouts() const { return _setLayouts.size() + _pipelineLayouts.size(); }
+	size_t samplers() const { return _samplers.size(); }
+
+private:
+	// a layout description flattened to words; hashed whole, compared whole on collisions
+	using Key = std::vector<uint64_t>;
+	struct KeyHash {
+		size_t operator()(const Key& key) const;
+	};
+
+	VkDevice _device{ VK_NULL_HANDLE };
+	std::unordered_map<Key, VkDescriptorSetLayout, KeyHash> _setLayouts;
+	std::unordered_map<Key, VkPipelineLayout, KeyHash> _pipelineLayouts;
+	std::unordered_map<Key, VkSampler, KeyHash> _samplers;
+	uint32_t _requests{ 0 };
+};
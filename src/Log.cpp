@@ -0,0 +1,385 @@
+#include "Log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+namespace {
+	// a power of two; 1 MiB of slots
+	constexpr uint64_t QUEUE_SLOTS = 4096;
+	// text a slot holds; longer lines take consecutive slots
+	constexpr size_t SLOT_TEXT = 244;
+	// a line never takes more than this many slots, the rest is cut
+	constexpr uint64_t MAX_LINE_SLOTS = 64;
+	// how long the writer sleeps when no producer wakes it
+	constexpr auto WRITER_IDLE = std::chrono::milliseconds(50);
+
+	// Free for position p while sequence == p, holding p's text once it's p + 1, and free for the next lap
+	// (p + QUEUE_SLOTS) once the writer has written it
+	struct Slot {
+		std::atomic<uint64_t> sequence{ 0 };
+		uint16_t length{ 0 };
+		bool last{ false }; // the line's final slot
+		char text[SLOT_TEXT];
+	};
+
+	struct Queue {
+		Slot slots[QUEUE_SLOTS];
+		// positions claimed by producers
+		std::atomic<uint64_t> enqueue{ 0 };
+		// next position the writer reads; the writer's alone
+		uint64_t dequeue{ 0 };
+		// positions written out and flushed, for flush()
+		std::atomic<uint64_t> written{ 0 };
+		std::atomic<uint64_t> dropped{ 0 };
+		uint64_t droppedReported{ 0 };
+
+		std::atomic<bool> running{ false };
+		std::atomic<bool> sleeping{ false };
+		std::mutex wakeMutex;
+		std::condition_variable wake;
+		std::thread writer;
+		// the direct writes before start() and after stop()
+		std::mutex directMutex;
+
+		Queue()
+		{
+			for (uint64_t i = 0; i < QUEUE_SLOTS; i++)
+			{
+				slots[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+	};
+
+	Queue& queue()
+	{
+		static Queue instance;
+		return instance;
+	}
+
+	void wake_writer(Queue& q)
+	{
+		// pairs with the writer's fence between setting sleeping and checking for work
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (q.sleeping.load(std::memory_order_relaxed) && q.sleeping.exchange(false, std::memory_order_relaxed))
+		{
+			std::lock_guard<std::mutex> lock(q.wakeMutex);
+			q.wake.notify_one();
+		}
+	}
+
+	// false when the line's slots aren't free: the writer hasn't caught up
+	bool push(Queue& q, const char* text, size_t length)
+	{
+		const uint64_t count = std::min<uint64_t>(std::max<uint64_t>((length + SLOT_TEXT - 1) / SLOT_TEXT, 1), MAX_LINE_SLOTS);
+		length = std::min<size_t>(length, count * SLOT_TEXT);
+
+		// the writer frees slots in order, so the range is free once its last slot is
+		uint64_t position = q.enqueue.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			const uint64_t lastPosition = position + count - 1;
+			const uint64_t sequence = q.slots[lastPosition % QUEUE_SLOTS].sequence.load(std::memory_order_acquire);
+			const int64_t difference = static_cast<int64_t>(sequence - lastPosition);
+			if (difference == 0)
+			{
+				if (q.enqueue.compare_exchange_weak(position, position + count, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (difference < 0)
+			{
+				return false;
+			}
+			else
+			{
+				position = q.enqueue.load(std::memory_order_relaxed);
+			}
+		}
+
+		for (uint64_t i = 0; i < count; i++)
+		{
+			Slot& slot = q.slots[(position + i) % QUEUE_SLOTS];
+			const size_t chunk = std::min(length - i * SLOT_TEXT, SLOT_TEXT);
+			std::memcpy(slot.text, text + i * SLOT_TEXT, chunk);
+			slot.length = static_cast<uint16_t>(chunk);
+			slot.last = i + 1 == count;
+			slot.sequence.store(position + i + 1, std::memory_order_release);
+		}
+		return true;
+	}
+
+	// writes every slot published in order from the writer's position and flushes; false when there were none.
+	// One caller at a time: the writer thread, or stop() once it's joined
+	bool drain(Queue& q)
+	{
+		const uint64_t first = q.dequeue;
+		for (;;)
+		{
+			Slot& slot = q.slots[q.dequeue % QUEUE_SLOTS];
+			if (slot.sequence.load(std::memory_order_acquire) != q.dequeue + 1)
+			{
+				break;
+			}
+			std::fwrite(slot.text, 1, slot.length, stdout);
+			if (slot.last)
+			{
+				std::fputc('\n', stdout);
+			}
+			slot.sequence.store(q.dequeue + QUEUE_SLOTS, std::memory_order_release);
+			q.dequeue++;
+		}
+
+		const uint64_t dropped = q.dropped.load(std::memory_order_relaxed);
+		if (dropped != q.droppedReported)
+		{
+			std::fprintf(stdout, "WARN: %llu log lines dropped, the queue was full\n", static_cast<unsigned long long>(dropped - q.droppedReported));
+			q.droppedReported = dropped;
+		}
+
+		if (q.dequeue == first)
+		{
+			return false;
+		}
+		std::fflush(stdout);
+		q.written.store(q.dequeue, std::memory_order_release);
+		return true;
+	}
+
+	void writer_loop(Queue& q)
+	{
+		for (;;)
+		{
+			if (drain(q))
+			{
+				continue;
+			}
+			if (!q.running.load(std::memory_order_acquire))
+			{
+				break;
+			}
+
+			std::unique_lock<std::mutex> lock(q.wakeMutex);
+			q.sleeping.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			// a line published between the drain and here would otherwise wait out the timeout
+			if (q.slots[q.dequeue % QUEUE_SLOTS].sequence.load(std::memory_order_acquire) != q.dequeue + 1 && q.running.load(std::memory_order_acquire))
+			{
+				q.wake.wait_for(lock, WRITER_IDLE);
+			}
+			q.sleeping.store(false, std::memory_order_relaxed);
+		}
+	}
+
+	void write(const char* text, size_t length);
+
+	const char* level_prefix(logging::Level level)
+	{
+		switch (level)
+		{
+		case logging::Level::Debug: return "DEBUG: ";
+		case logging::Level::Warn: return "WARN: ";
+		case logging::Level::Error: return "ERROR: ";
+		default: return "";
+		}
+	}
+
+	// grows instead of cutting a long line; put area over the whole of text
+	class LineBuffer : public std::streambuf
+	{
+	public:
+		LineBuffer() : _text(256) { reset(); }
+
+		void reset() { setp(_text.data(), _text.data() + _text.size()); }
+		const char* data() const { return pbase(); }
+		size_t size() const { return static_cast<size_t>(pptr() - pbase()); }
+
+	protected:
+		int_type overflow(int_type c) override
+		{
+			if (traits_type::eq_int_type(c, traits_type::eof()))
+			{
+				return traits_type::not_eof(c);
+			}
+			const size_t used = size();
+			_text.resize(_text.size() * 2);
+			setp(_text.data(), _text.data() + _text.size());
+			pbump(static_cast<int>(used));
+			*pptr() = traits_type::to_char_type(c);
+			pbump(1);
+			return c;
+		}
+
+	private:
+		std::vector<char> _text;
+	};
+}
+
+namespace logging {
+	namespace detail {
+		std::atomic<uint8_t> minimumLevel{ static_cast<uint8_t>(Level::Info) };
+	}
+
+	struct detail::LineState {
+		LineBuffer text;
+		std::ostream stream{ &text };
+		const std::ios_base::fmtflags flags{ stream.flags() };
+		bool open{ false };
+
+		void begin()
+		{
+			text.reset();
+			stream.clear();
+			stream.flags(flags);
+			stream.precision(6);
+			stream.width(0);
+			stream.fill(' ');
+			open = true;
+		}
+	};
+
+	namespace {
+		thread_local detail::LineState t_state;
+	}
+
+	void set_level(Level level)
+	{
+		detail::minimumLevel.store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+	}
+
+	bool parse_level(const char* name, Level& level)
+	{
+		static const struct { const char* name; Level level; } names[] = {
+			{ "debug", Level::Debug }, { "info", Level::Info }, { "warn", Level::Warn }, { "error", Level::Error }, { "off", Level::Off },
+		};
+		for (const auto& entry : names)
+		{
+			if (std::strcmp(name, entry.name) == 0)
+			{
+				level = entry.level;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void start()
+	{
+		Queue& q = queue();
+		if (q.running.exchange(true, std::memory_order_acq_rel))
+		{
+			return;
+		}
+		q.writer = std::thread([&q]() { writer_loop(q); });
+	}
+
+	void stop()
+	{
+		Queue& q = queue();
+		if (!q.running.exchange(false, std::memory_order_acq_rel))
+		{
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(q.wakeMutex);
+			q.wake.notify_one();
+		}
+		q.writer.join();
+		// lines queued while the writer was on its way out
+		drain(q);
+	}
+
+	void flush()
+	{
+		Queue& q = queue();
+		const uint64_t target = q.enqueue.load(std::memory_order_acquire);
+		while (q.running.load(std::memory_order_acquire) && q.written.load(std::memory_order_acquire) < target)
+		{
+			wake_writer(q);
+			std::this_thread::yield();
+		}
+	}
+
+	bool RateLimit::allow(uint32_t& suppressed)
+	{
+		const uint64_t now = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+		uint64_t windowStart = _windowStartNs.load(std::memory_order_relaxed);
+		// whichever thread moves the window on resets the count; the others' increments may land either side
+		if (now - windowStart >= WINDOW_NS && _windowStartNs.compare_exchange_strong(windowStart, now, std::memory_order_relaxed))
+		{
+			_count.store(0, std::memory_order_relaxed);
+		}
+		if (_count.fetch_add(1, std::memory_order_relaxed) < BURST)
+		{
+			suppressed = _suppressed.exchange(0, std::memory_order_relaxed);
+			return true;
+		}
+		_suppressed.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	Line::Line(Level level, uint32_t suppressed)
+		: _state(&t_state), _owned(false), _suppressed(suppressed)
+	{
+		if (_state->open)
+		{
+			_state = new detail::LineState();
+			_owned = true;
+		}
+		_state->begin();
+		_state->stream << level_prefix(level);
+	}
+
+	Line::~Line()
+	{
+		if (_suppressed > 0)
+		{
+			_state->stream.flags(_state->flags);
+			_state->stream << " (" << _suppressed << " more suppressed)";
+		}
+		write(_state->text.data(), _state->text.size());
+		_state->open = false;
+		if (_owned)
+		{
+			delete _state;
+		}
+	}
+
+	std::ostream& Line::stream()
+	{
+		return _state->stream;
+	}
+}
+
+namespace {
+	void write(const char* text, size_t length)
+	{
+		Queue& q = queue();
+		if (q.running.load(std::memory_order_acquire))
+		{
+			if (push(q, text, length))
+			{
+				wake_writer(q);
+			}
+			else
+			{
+				q.dropped.fetch_add(1, std::memory_order_relaxed);
+			}
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(q.directMutex);
+		std::fwrite(text, 1, length, stdout);
+		std::fputc('\n', stdout);
+		std::fflush(stdout);
+	}
+}
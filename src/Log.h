@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+// Diagnostics for every module, written off the calling thread. LOG_INFO("loaded " << count << " meshes")
+// formats into a buffer the calling thread keeps, then copies the line into a bounded queue whose slots
+// producers claim with a compare-and-swap, so logging never takes a lock, allocates once the buffer has grown,
+// or waits on stdout. A writer thread started by start() drains the queue to stdout and flushes once per
+// batch rather than once per line. Before start() and after stop() lines are written on the spot under a
+// lock, for the tools that never start a writer.
+// Lines past Info carry their level ("WARN: ", "ERROR: "). LOG_WARN and LOG_ERROR let each call site through
+// a few times a second and count the rest, so an error repeating every frame costs a clock read; the next line
+// the site gets through says how many it swallowed. A full queue drops lines rather than block, and the
+// writer says how many.
+namespace logging {
+	enum class Level : uint8_t { Debug, Info, Warn, Error, Off };
+
+	namespace detail {
+		extern std::atomic<uint8_t> minimumLevel;
+		struct LineState;
+	}
+
+	// Info by default; Off silences everything
+	void set_level(Level level);
+	inline Level level() { return static_cast<Level>(detail::minimumLevel.load(std::memory_order_relaxed)); }
+	inline bool enabled(Level level) { return level != Level::Off && level >= logging::level(); }
+	// "debug", "info", "warn", "error" or "off"; false leaves level alone
+	bool parse_level(const char* name, Level& level);
+
+	// starts the writer thread
+	void start();
+	// writes what's queued and joins the writer; lines other threads log meanwhile may be lost
+	void stop();
+	// blocks until every line queued before the call is written and flushed, before an abort or a crash report
+	void flush();
+
+	// one per LOG_WARN and LOG_ERROR call site; constant-initialized, so the function-local static costs no guard
+	class RateLimit
+	{
+	public:
+		// lines a site gets through per window
+		static constexpr uint32_t BURST = 5;
+		static constexpr uint64_t WINDOW_NS = 1000000000;
+
+		// true when the site may log now; suppressed is then how many it was refused since it last could
+		bool allow(uint32_t& suppressed);
+
+	private:
+		std::atomic<uint64_t> _windowStartNs{ 0 };
+		std::atomic<uint32_t> _count{ 0 };
+		std::atomic<uint32_t> _suppressed{ 0 };
+	};
+
+	// A line being built, queued when it goes out of scope. The macros make one per message; code that builds a
+	// line over several statements makes its own. Lines nested on one thread (a << that logs) fall back to a
+	// buffer of their own
+	class Line
+	{
+	public:
+		explicit Line(Level level, uint32_t suppressed = 0);
+		~Line();
+
+		Line(const Line&) = delete;
+		Line& operator=(const Line&) = delete;
+
+		std::ostream& stream();
+
+	private:
+		detail::LineState* _state;
+		bool _owned;
+		uint32_t _suppressed;
+	};
+}
+
+#define LOG_AT(level, ...)														\
+	do																			\
+	{																			\
+		if (logging::enabled(level))											\
+		{																		\
+			logging::Line logLine(level);										\
+			logLine.stream() << __VA_ARGS__;									\
+		}																		\
+	}	while (0)
+
+#define LOG_LIMITED(level, ...)													\
+	do																			\
+	{																			\
+		static logging::RateLimit logLimit;										\
+		uint32_t logSuppressed = 0;												\
+		if (logging::enabled(level) && logLimit.allow(logSuppressed))			\
+		{																		\
+			logging::Line logLine(level, logSuppressed);						\
+			logLine.stream() << __VA_ARGS__;									\
+		}																		\
+	}	while (0)
+
+#define LOG_DEBUG(...) LOG_AT(logging::Level::Debug, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(logging::Level::Info, __VA_ARGS__)
+#define LOG_WARN(...) LOG_LIMITED(logging::Level::Warn, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_LIMITED(logging::Level::Error, __VA_ARGS__)
@@ -0,0 +1,169 @@
+#include "MappedFile.h"
+
+#include <filesystem>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const char* path)
+{
+	close();
+
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	_fileHandle = file;
+	_mappingHandle = mapping;
+	_data = static_cast<const uint8_t*>(view);
+	_size = static_cast<size_t>(fileSize.QuadPart);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (_data)
+	{
+		UnmapViewOfFile(_data);
+	}
+	if (_mappingHandle)
+	{
+		CloseHandle(_mappingHandle);
+	}
+	if (_fileHandle)
+	{
+		CloseHandle(_fileHandle);
+	}
+	_data = nullptr;
+	_size = 0;
+	_fileHandle = nullptr;
+	_mappingHandle = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const char* path)
+{
+	close();
+
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	void* view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	if (view == MAP_FAILED)
+	{
+		::close(fd);
+		return false;
+	}
+
+	// loaders read the mapping front to back
+	madvise(view, static_cast<size_t>(fileStat.st_size), MADV_SEQUENTIAL);
+
+	_fd = fd;
+	_data = static_cast<const uint8_t*>(view);
+	_size = static_cast<size_t>(fileStat.st_size);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (_data)
+	{
+		munmap(const_cast<uint8_t*>(_data), _size);
+	}
+	if (_fd >= 0)
+	{
+		::close(_fd);
+	}
+	_data = nullptr;
+	_size = 0;
+	_fd = -1;
+}
+
+#endif
+
+bool get_source_stamp(const char* path, SourceStamp& stamp)
+{
+	std::error_code ec;
+	uintmax_t size = std::filesystem::file_size(path, ec);
+	if (ec)
+	{
+		return false;
+	}
+	auto writeTime = std::filesystem::last_write_time(path, ec);
+	if (ec)
+	{
+		return false;
+	}
+
+	stamp.size = size;
+	stamp.timestamp = static_cast<int64_t>(writeTime.time_since_epoch().count());
+	return true;
+}
+
+uint64_t hash_file(const char* path)
+{
+	MappedFile file;
+	if (!file.open(path))
+	{
+		return 0;
+	}
+
+	uint64_t hash = 0xcbf29ce484222325ull;
+	const uint8_t* bytes = file.data();
+	for (size_t i = 0; i < file.size(); i++)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
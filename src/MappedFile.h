@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Read-only memory mapping of a whole file.
+// Lets loaders copy straight from the page cache instead of going through stream reads.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// maps the file at path; returns false if it can't be opened or is empty
+	bool open(const char* path);
+	void close();
+
+	const uint8_t* data() const { return _data; }
+	size_t size() const { return _size; }
+	bool is_open() const { return _data != nullptr; }
+
+private:
+	const uint8_t* _data{ nullptr };
+	size_t _size{ 0 };
+
+#ifdef _WIN32
+	void* _fileHandle{ nullptr };
+	void* _mappingHandle{ nullptr };
+#else
+	int _fd{ -1 };
+#endif
+};
+
+// identifies the version of a source asset a derived cache was built from
+struct SourceStamp {
+	uint64_t size;
+	int64_t timestamp;
+};
+
+bool get_source_stamp(const char* path, SourceStamp& stamp);
+
+// 64-bit FNV-1a over the whole file; only worth computing when size matches but the timestamp doesn't
+uint64_t hash_file(const char* path);
@@ -0,0 +1,160 @@
+#include "MaterialStore.h"
+
+#include "vk_initializers.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+	// clean materials between two dirty runs closer than this are copied along; an extra region costs more
+	constexpr uint32_t MERGE_GAP = 4;
+}
+
+void MaterialStore::init(VmaAllocator allocator, uint32_t capacity)
+{
+	_allocator = allocator;
+	_capacity = capacity;
+
+	_baseColors.stride = sizeof(glm::vec4);
+	_textureIndices.stride = sizeof(uint32_t);
+	_baseColors.offset = 0;
+	_textureIndices.offset = VkDeviceSize(capacity) * _baseColors.stride;
+	for (Field* field : { &_baseColors, &_textureIndices })
+	{
+		field->values.assign(size_t(capacity) * field->stride, 0);
+		field->isDirty.assign(capacity, 0);
+		field->dirty.clear();
+	}
+
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.pNext = nullptr;
+	bufferInfo.size = _textureIndices.offset + VkDeviceSize(capacity) * _textureIndices.stride;
+	bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+	// read by every shaded fragment, written a few bytes at a time
+	VmaAllocationCreateInfo vmaallocInfo = {};
+	vmaallocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+	VK_CHECK(vmaCreateBuffer(allocator, &bufferInfo, &vmaallocInfo, &_buffer._buffer, &_buffer._allocation, nullptr));
+}
+
+void MaterialStore::cleanup()
+{
+	vmaDestroyBuffer(_allocator, _buffer._buffer, _buffer._allocation);
+	_buffer = {};
+}
+
+void MaterialStore::set_base_color(uint32_t index, const glm::vec4& baseColor)
+{
+	set(_baseColors, index, &baseColor);
+}
+
+void MaterialStore::set_texture_index(uint32_t index, uint32_t textureIndex)
+{
+	set(_textureIndices, index, &textureIndex);
+}
+
+void MaterialStore::set(Field& field, uint32_t index, const void* value)
+{
+	if (index >= _capacity)
+	{
+		return;
+	}
+
+	uint8_t* current = field.values.data() + size_t(index) * field.stride;
+	if (memcmp(current, value, field.stride) == 0)
+	{
+		return;
+	}
+	memcpy(current, value, field.stride);
+
+	if (!field.isDirty[index])
+	{
+		field.isDirty[index] = 1;
+		field.dirty.push_back(index);
+	}
+}
+
+bool MaterialStore::stage(Field& field, GpuLinearAllocator& staging, std::vector<VkBufferCopy>& regions)
+{
+	if (field.dirty.empty())
+	{
+		return true;
+	}
+
+	// dirty materials into runs, each run one region; the runs are packed back to back in one allocation
+	std::sort(field.dirty.begin(), field.dirty.end());
+	std::vector<std::pair<uint32_t, uint32_t>> runs; // first material, count
+	for (uint32_t index : field.dirty)
+	{
+		if (!runs.empty() && index <= runs.back().first + runs.back().second + MERGE_GAP)
+		{
+			runs.back().second = index - runs.back().first + 1;
+		}
+		else
+		{
+			runs.push_back({ index, 1 });
+		}
+	}
+
+	VkDeviceSize size = 0;
+	for (const auto& run : runs)
+	{
+		size += VkDeviceSize(run.second) * field.stride;
+	}
+	GpuAllocation allocation;
+	if (!staging.allocate(size, field.stride, &allocation))
+	{
+		return false;
+	}
+
+	uint8_t* data = static_cast<uint8_t*>(allocation.data);
+	VkDeviceSize stagingOffset = allocation.offset;
+	for (const auto& run : runs)
+	{
+		const VkDeviceSize bytes = VkDeviceSize(run.second) * field.stride;
+		memcpy(data, field.values.data() + size_t(run.first) * field.stride, bytes);
+
+		VkBufferCopy region = {};
+		region.srcOffset = stagingOffset;
+		region.dstOffset = field.offset + VkDeviceSize(run.first) * field.stride;
+		region.size = bytes;
+		regions.push_back(region);
+
+		data += bytes;
+		stagingOffset += bytes;
+	}
+
+	for (uint32_t index : field.dirty)
+	{
+		field.isDirty[index] = 0;
+	}
+	field.dirty.clear();
+	return true;
+}
+
+void MaterialStore::record_updates(VkCommandBuffer cmd, GpuLinearAllocator& staging)
+{
+	_lastUploadBytes = 0;
+
+	std::vector<VkBufferCopy> regions;
+	stage(_baseColors, staging, regions);
+	stage(_textureIndices, staging, regions);
+	if (regions.empty())
+	{
+		return;
+	}
+
+	// the frames still in flight only read the buffer, so waiting for their fragment shaders is enough
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+	vkCmdCopyBuffer(cmd, staging.buffer(), _buffer._buffer, static_cast<uint32_t>(regions.size()), regions.data());
+	VkBufferMemoryBarrier written = vkinit::buffer_barrier(_buffer._buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 1, &written, 0, nullptr);
+
+	for (const VkBufferCopy& region : regions)
+	{
+		_lastUploadBytes += region.size;
+	}
+	_totalUploadBytes += _lastUploadBytes;
+}
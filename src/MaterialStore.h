@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vk_types.h>
+#include <GpuLinearAllocator.h>
+
+#include <cstdint>
+#include <vector>
+#include <glm/vec4.hpp>
+
+// Every material's parameters in one device-local storage buffer, laid out as a structure of arrays: each
+// field is an array of its own indexed by material, so the invocations of a wave shading different materials
+// read one field from neighbouring addresses rather than striding over whole records, and a field that
+// changes doesn't drag the others along into the upload.
+// Parameters rarely change, so the store keeps the CPU copy and the setters only mark what changed;
+// record_updates() stages the dirty runs of each field in the frame's ring and copies just those. Frames where
+// nothing changed upload nothing, and the GPU never sees a write while an earlier frame still reads.
+class MaterialStore
+{
+public:
+	// the shaders declare the same layout for the same capacity (see MaterialBuffer in bindlessMesh.frag)
+	void init(VmaAllocator allocator, uint32_t capacity);
+	void cleanup();
+
+	// no-ops when the value is already current; indices at or past the capacity are ignored
+	void set_base_color(uint32_t index, const glm::vec4& baseColor);
+	void set_texture_index(uint32_t index, uint32_t textureIndex);
+
+	// before the frame's first draw that reads the buffer; the copies wait for the fragment shaders of the
+	// frames still in flight and finish before this frame's. Runs that don't fit in staging stay dirty
+	// for the next frame. staging must have been created with TRANSFER_SRC usage
+	void record_updates(VkCommandBuffer cmd, GpuLinearAllocator& staging);
+
+	VkBuffer buffer() const { return _buffer._buffer; }
+	// bytes record_updates copied into the buffer, last frame and since init
+	VkDeviceSize last_upload_bytes() const { return _lastUploadBytes; }
+	uint64_t total_upload_bytes() const { return _totalUploadBytes; }
+
+private:
+	// one array of the buffer
+	struct Field {
+		VkDeviceSize offset{ 0 };
+		uint32_t stride{ 0 };
+		std::vector<uint8_t> values; // the CPU copy, stride bytes per material
+		std::vector<uint32_t> dirty; // materials changed since they were last uploaded, each listed once
+		std::vector<uint8_t> isDirty;
+	};
+
+	void set(Field& field, uint32_t index, const void* value);
+	// appends the field's copy regions; false, with the field left dirty, when staging is full
+	bool stage(Field& field, GpuLinearAllocator& staging, std::vector<VkBufferCopy>& regions);
+
+	VmaAllocator _allocator{ VK_NULL_HANDLE };
+	AllocatedBuffer _buffer{};
+	uint32_t _capacity{ 0 };
+
+	Field _baseColors;
+	Field _textureIndices;
+
+	VkDeviceSize _lastUploadBytes{ 0 };
+	uint64_t _totalUploadBytes{ 0 };
+};
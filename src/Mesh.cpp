@@ -1,111 +1,1756 @@
 #include "Mesh.h"
 
-#include <tiny_obj_loader.h>
-#include <iostream>
+#include "JobSystem.h"
+#include "AssetArchive.h"
+#include "AssetCache.h"
+#include "BlockPack.h"
+#include "Log.h"
+#include "MappedFile.h"
+#include "MeshCodec.h"
+#include "MeshOptimizer.h"
+#include "ObjLoader.h"
+#include "GltfLoader.h"
+#include "HeapStats.h"
+#include "SimdLanes.h"
+#include "TextureAtlas.h"
+#include "VertexOcclusion.h"
 
-VertexInputDescription Vertex::get_vertex_description()
-{
-	VertexInputDescription description;
+#include <chrono>
+#include <fstream>
+#include <unordered_map>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <algorithm>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+	constexpr uint32_t MESH_CACHE_MAGIC = 0x534D4351; // "QCMS"
+	// bump whenever Vertex, the cache layout or the import processing changes
+	constexpr uint32_t MESH_CACHE_VERSION = 12;
+	constexpr const char* MESH_CACHE_EXTENSION = ".qcmesh";
+
+	// MeshCacheHeader::flags
+	// the vertex and index blobs are meshcodec streams instead of raw vertices and a blockpack stream
+	constexpr uint32_t MESH_CACHE_COMPRESSED = 1u << 0;
+	// texcoord and tangent blobs follow the material, vertexCount raw entries each
+	constexpr uint32_t MESH_CACHE_TANGENTS = 1u << 1;
+
+	// fixed-size fields only, so the header can be written and read as raw bytes
+	struct MeshCacheHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t vertexStride;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t flags;
+		uint32_t vertexBlobBytes;
+		uint32_t indexBlobBytes; // uncompressed, the index blob is a blockpack stream of indexCount values
+		uint32_t surfaceCount;
+		uint32_t lodCount;
+		uint32_t clusterCount;
+		uint32_t partCount; // caches the source was split into, this one among them
+		uint64_t sourceSize;
+		int64_t sourceTimestamp;
+		uint64_t sourceHash;
+		float boundsMin[3];
+		float boundsMax[3];
+		float boundsOrigin[3];
+		float boundsRadius;
+	};
+	static_assert(sizeof(MeshCacheHeader) == 112, "mesh cache header must not contain padding");
+
+	// follows the index blob, surfaceCount entries
+	struct MeshCacheSurface {
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		float boundsMin[3];
+		float boundsMax[3];
+		float boundsOrigin[3];
+		float boundsRadius;
+	};
+	static_assert(sizeof(MeshCacheSurface) == 48, "mesh cache surface must not contain padding");
+
+	// follows the surfaces, lodCount entries
+	struct MeshCacheLod {
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		float error;
+		uint32_t reserved;
+	};
+	static_assert(sizeof(MeshCacheLod) == 16, "mesh cache LOD must not contain padding");
+
+	// follows the LODs, clusterCount entries
+	struct MeshCacheCluster {
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		float boundsMin[3];
+		float boundsMax[3];
+		float boundsOrigin[3];
+		float boundsRadius;
+		float coneApex[3];
+		float coneAxis[3];
+		float coneCutoff;
+		uint32_t reserved;
+	};
+	static_assert(sizeof(MeshCacheCluster) == 80, "mesh cache cluster must not contain padding");
+
+	// follows the clusters; the strings are null-terminated, longer ones cut short
+	struct MeshCacheMaterial {
+		float baseColor[4];
+		char name[64];
+		char diffuseTexture[192];
+	};
+	static_assert(sizeof(MeshCacheMaterial) == 272, "mesh cache material must not contain padding");
+
+	void write_cache_string(const std::string& text, char* dst, size_t capacity)
+	{
+		const size_t length = std::min(text.size(), capacity - 1);
+		memcpy(dst, text.data(), length);
+		memset(dst + length, 0, capacity - length);
+	}
+
+	std::string read_cache_string(const char* src, size_t capacity)
+	{
+		return std::string(src, strnlen(src, capacity));
+	}
+
+	// surfaces up to this size stay one cluster; splitting them costs more vertex cache than culling saves
+	constexpr uint32_t MIN_CLUSTERED_TRIANGLES = 1024;
+
+	// spreads the low 10 bits of v out to every third bit
+	uint32_t part_by_2(uint32_t v)
+	{
+		v &= 0x3ff;
+		v = (v | (v << 16)) & 0x030000ff;
+		v = (v | (v << 8)) & 0x0300f00f;
+		v = (v | (v << 4)) & 0x030c30c3;
+		v = (v | (v << 2)) & 0x09249249;
+		return v;
+	}
+
+	// 30-bit Z-order code of p inside [min, min + extent]
+	uint32_t morton_code(const glm::vec3& p, const glm::vec3& min, const glm::vec3& inverseExtent)
+	{
+		const glm::vec3 cell = glm::clamp((p - min) * inverseExtent, 0.f, 1.f) * 1023.f;
+		return part_by_2(static_cast<uint32_t>(cell.x)) | (part_by_2(static_cast<uint32_t>(cell.y)) << 1) | (part_by_2(static_cast<uint32_t>(cell.z)) << 2);
+	}
+
+	// bounding sphere plus the normal cone of the cluster's triangles (see MeshCluster)
+	void compute_cluster_cone(MeshCluster& cluster, const std::vector<Vertex>& vertices, const uint32_t* indices)
+	{
+		// clusters with triangles facing more than ~84 degrees apart can't be rejected from anywhere useful
+		constexpr float MIN_CONE_DOT = 0.1f;
+
+		const size_t triangleCount = cluster.indexCount / 3;
+		glm::vec3 normalSum(0.f);
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			const glm::vec3& p0 = vertices[indices[t * 3 + 0]].position;
+			const glm::vec3 n = glm::cross(vertices[indices[t * 3 + 1]].position - p0, vertices[indices[t * 3 + 2]].position - p0);
+			const float length = glm::length(n);
+			if (length > 0.f)
+			{
+				normalSum += n / length;
+			}
+		}
+
+		cluster.coneApex = cluster.bounds.origin;
+		cluster.coneAxis = glm::vec3(0.f, 0.f, 1.f);
+		cluster.coneCutoff = 2.f;
+		const float sumLength = glm::length(normalSum);
+		if (sumLength <= 1e-6f)
+		{
+			return;
+		}
+		const glm::vec3 axis = normalSum / sumLength;
+
+		// narrowest cone around the axis holding every normal, then the apex pushed back along the axis
+		// until it's behind every triangle's plane, so facing away from the apex means facing away from p
+		float minDot = 1.f;
+		float maxShift = 0.f;
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			const glm::vec3& p0 = vertices[indices[t * 3 + 0]].position;
+			glm::vec3 n = glm::cross(vertices[indices[t * 3 + 1]].position - p0, vertices[indices[t * 3 + 2]].position - p0);
+			const float length = glm::length(n);
+			if (length <= 0.f)
+			{
+				continue;
+			}
+			n /= length;
+
+			const float d = glm::dot(axis, n);
+			minDot = std::min(minDot, d);
+			if (d > 0.f)
+			{
+				maxShift = std::max(maxShift, glm::dot(cluster.bounds.origin - p0, n) / d);
+			}
+		}
+		if (minDot <= MIN_CONE_DOT)
+		{
+			return;
+		}
+
+		cluster.coneApex = cluster.bounds.origin - axis * maxShift;
+		cluster.coneAxis = axis;
+		cluster.coneCutoff = sqrtf(1.f - minDot * minDot);
+	}
+
+	// area-weighted normals: every triangle's unnormalized cross product goes to its corners, then the sums
+	// are normalized, four triangles and then four vertices an iteration. Only the vertices flagged in smooth
+	// are written, or all of them without it; their normals must start out zero
+	void smooth_normals(std::vector<Vertex>& vertices, const uint32_t* indices, size_t indexCount, const std::vector<uint8_t>* smooth)
+	{
+		const size_t triangleCount = indexCount / 3;
+		for (size_t t = 0; t < triangleCount; t += SIMD_WIDTH)
+		{
+			// both edges from the first corner, gathered into lanes; lanes past the end stay zero
+			const size_t lanes = std::min(SIMD_WIDTH, triangleCount - t);
+			float edges[6][SIMD_WIDTH] = {};
+			for (size_t l = 0; l < lanes; l++)
+			{
+				const uint32_t* triangle = indices + (t + l) * 3;
+				const glm::vec3 a = vertices[triangle[0]].position;
+				const glm::vec3 ab = vertices[triangle[1]].position - a;
+				const glm::vec3 ac = vertices[triangle[2]].position - a;
+				for (int c = 0; c < 3; c++)
+				{
+					edges[c][l] = ab[c];
+					edges[3 + c][l] = ac[c];
+				}
+			}
+
+			const Lanes abx = lanes_load(edges[0]), aby = lanes_load(edges[1]), abz = lanes_load(edges[2]);
+			const Lanes acx = lanes_load(edges[3]), acy = lanes_load(edges[4]), acz = lanes_load(edges[5]);
+			float face[3][SIMD_WIDTH];
+			lanes_store(face[0], lanes_sub(lanes_mul(aby, acz), lanes_mul(abz, acy)));
+			lanes_store(face[1], lanes_sub(lanes_mul(abz, acx), lanes_mul(abx, acz)));
+			lanes_store(face[2], lanes_sub(lanes_mul(abx, acy), lanes_mul(aby, acx)));
+
+			for (size_t l = 0; l < lanes; l++)
+			{
+				const glm::vec3 normal(face[0][l], face[1][l], face[2][l]);
+				const uint32_t* triangle = indices + (t + l) * 3;
+				for (int c = 0; c < 3; c++)
+				{
+					if (smooth == nullptr || (*smooth)[triangle[c]])
+					{
+						vertices[triangle[c]].normal += normal;
+					}
+				}
+			}
+		}
+
+		for (size_t v = 0; v < vertices.size(); v += SIMD_WIDTH)
+		{
+			const size_t lanes = std::min(SIMD_WIDTH, vertices.size() - v);
+			float normals[3][SIMD_WIDTH] = {};
+			for (size_t l = 0; l < lanes; l++)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					normals[c][l] = vertices[v + l].normal[c];
+				}
+			}
+
+			const Lanes x = lanes_load(normals[0]), y = lanes_load(normals[1]), z = lanes_load(normals[2]);
+			const Lanes lengthSquared = lanes_add(lanes_add(lanes_mul(x, x), lanes_mul(y, y)), lanes_mul(z, z));
+			float squared[SIMD_WIDTH];
+			float scale[SIMD_WIDTH];
+			lanes_store(squared, lengthSquared);
+			lanes_store(scale, lanes_rsqrt(lengthSquared));
+
+			for (size_t l = 0; l < lanes; l++)
+			{
+				if (smooth != nullptr && !(*smooth)[v + l])
+				{
+					continue;
+				}
+				// vertices only degenerate triangles touch have no direction to take; any will do
+				Vertex& vertex = vertices[v + l];
+				vertex.normal = squared[l] > 1e-24f ? vertex.normal * scale[l] : glm::vec3(0.f, 1.f, 0.f);
+			}
+		}
+	}
+
+	// box over the referenced vertices, then a sphere around the box center tightened to the farthest one
+	// vertices referenced more than once are visited more than once, which doesn't change the result
+	template<typename VertexIndexFn>
+	MeshBounds compute_vertex_bounds(const std::vector<Vertex>& vertices, size_t count, VertexIndexFn vertexIndex)
+	{
+		MeshBounds bounds;
+		if (count == 0)
+		{
+			bounds.min = bounds.max = bounds.origin = glm::vec3(0.f);
+			bounds.radius = 0.f;
+			return bounds;
+		}
+
+		glm::vec3 minPos = vertices[vertexIndex(0)].position;
+		glm::vec3 maxPos = minPos;
+		for (size_t i = 0; i < count; i++)
+		{
+			const glm::vec3& p = vertices[vertexIndex(i)].position;
+			minPos = glm::min(minPos, p);
+			maxPos = glm::max(maxPos, p);
+		}
+
+		bounds.min = minPos;
+		bounds.max = maxPos;
+		bounds.origin = (minPos + maxPos) * 0.5f;
 
-	// just 1 vertex buffer binding, with a per-vertex rate
-	VkVertexInputBindingDescription mainBinding = {};
-	mainBinding.binding = 0;
-	mainBinding.stride = sizeof(Vertex);
-	mainBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		float maxDistance2 = 0.f;
+		for (size_t i = 0; i < count; i++)
+		{
+			glm::vec3 d = vertices[vertexIndex(i)].position - bounds.origin;
+			maxDistance2 = glm::max(maxDistance2, glm::dot(d, d));
+		}
+		bounds.radius = sqrtf(maxDistance2);
+		return bounds;
+	}
 
-	description.bindings.push_back(mainBinding);
+	void write_bounds(const MeshBounds& bounds, float min[3], float max[3], float origin[3], float& radius)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			min[i] = bounds.min[i];
+			max[i] = bounds.max[i];
+			origin[i] = bounds.origin[i];
+		}
+		radius = bounds.radius;
+	}
 
-	// position at location(0)
-	VkVertexInputAttributeDescription positionAttribute = {};
-	positionAttribute.binding = 0;
-	positionAttribute.location = 0;
-	positionAttribute.format = VK_FORMAT_R32G32B32_SFLOAT; // glm::vec3 uses 3 32-bit floats
-	positionAttribute.offset = offsetof(Vertex, position);
+	MeshBounds read_bounds(const float min[3], const float max[3], const float origin[3], float radius)
+	{
+		MeshBounds bounds;
+		bounds.min = { min[0], min[1], min[2] };
+		bounds.max = { max[0], max[1], max[2] };
+		bounds.origin = { origin[0], origin[1], origin[2] };
+		bounds.radius = radius;
+		return bounds;
+	}
 
-	// normal at location(1)
-	VkVertexInputAttributeDescription normalAttribute = {};
-	normalAttribute.binding = 0;
-	normalAttribute.location = 1;
-	normalAttribute.format = VK_FORMAT_R32G32B32_SFLOAT;
-	normalAttribute.offset = offsetof(Vertex, normal);
+	// OBJ vertices are unique per (position, normal, texcoord) index triple
+	// since color is derived from the normal, identical triples always produce identical vertices
+	struct ObjIndexHash {
+		size_t operator()(const ObjIndex& idx) const
+		{
+			size_t h = std::hash<int>()(idx.position);
+			h ^= std::hash<int>()(idx.normal) + 0x9e3779b9 + (h << 6) + (h >> 2);
+			h ^= std::hash<int>()(idx.texcoord) + 0x9e3779b9 + (h << 6) + (h >> 2);
+			return h;
+		}
+	};
 
-	// color at location(2)
-	VkVertexInputAttributeDescription colorAttribute = {};
-	colorAttribute.binding = 0;
-	colorAttribute.location = 2;
-	colorAttribute.format = VK_FORMAT_R32G32B32_SFLOAT;
-	colorAttribute.offset = offsetof(Vertex, color);
+	double elapsed_ms(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+void Mesh::build_obj_shape(const ObjData& obj, const ObjShape& shape, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+	std::vector<glm::vec2>* texcoords)
+{
+	// two passes so both arrays are allocated once at their final size: the corners are deduplicated into
+	// indices first, remembering the corner each vertex first shows up at, then the vertices are read from those
+	const size_t cornerCount = shape.triangleCount * 3;
+	indices.resize(cornerCount);
+	std::vector<uint32_t> firstCorners;
+	firstCorners.reserve(cornerCount);
 
-	description.attributes.push_back(positionAttribute);
-	description.attributes.push_back(normalAttribute);
-	description.attributes.push_back(colorAttribute);
+	// maps each distinct OBJ index triple to the vertex we already emitted for it
+	std::unordered_map<ObjIndex, uint32_t, ObjIndexHash> uniqueVertices;
+	uniqueVertices.reserve(cornerCount);
+
+	const ObjIndex* corners = obj.indices.data() + shape.firstTriangle * 3;
+	for (size_t c = 0; c < cornerCount; c++)
+	{
+		auto inserted = uniqueVertices.emplace(corners[c], static_cast<uint32_t>(firstCorners.size()));
+		if (inserted.second)
+		{
+			firstCorners.push_back(static_cast<uint32_t>(c));
+		}
+		indices[c] = inserted.first->second;
+	}
 
-	return description;
+	vertices.resize(firstCorners.size());
+	if (texcoords)
+	{
+		texcoords->assign(vertices.size(), glm::vec2(0.f));
+	}
+	std::vector<uint8_t> missingNormals;
+	for (size_t v = 0; v < vertices.size(); v++)
+	{
+		const ObjIndex& idx = corners[firstCorners[v]];
+		if (texcoords && idx.texcoord >= 0 && size_t(idx.texcoord) * 2 + 1 < obj.texcoords.size())
+		{
+			(*texcoords)[v] = { obj.texcoords[2 * idx.texcoord + 0], obj.texcoords[2 * idx.texcoord + 1] };
+		}
+		Vertex& vertex = vertices[v];
+		vertex.position = glm::vec3(0.f);
+		vertex.normal = glm::vec3(0.f);
+		if (idx.position >= 0 && size_t(idx.position) * 3 + 2 < obj.positions.size())
+		{
+			vertex.position = { obj.positions[3 * idx.position + 0], obj.positions[3 * idx.position + 1], obj.positions[3 * idx.position + 2] };
+		}
+		if (idx.normal >= 0 && size_t(idx.normal) * 3 + 2 < obj.normals.size())
+		{
+			vertex.normal = { obj.normals[3 * idx.normal + 0], obj.normals[3 * idx.normal + 1], obj.normals[3 * idx.normal + 2] };
+		}
+		else
+		{
+			// corners without a (valid) normal are smoothed from the triangles around them below
+			if (missingNormals.empty())
+			{
+				missingNormals.resize(vertices.size(), 0);
+			}
+			missingNormals[v] = 1;
+		}
+	}
+	if (!missingNormals.empty())
+	{
+		smooth_normals(vertices, indices.data(), indices.size(), &missingNormals);
+	}
+
+	// white lets the material's color show through; without one, the normal for debug purposes
+	for (Vertex& vertex : vertices)
+	{
+		vertex.color = shape.material >= 0 ? glm::vec3(1.f) : vertex.normal;
+	}
 }
 
 bool Mesh::load_from_obj(const char* fileName)
 {
-	// contains list of vertex attributes in the file
-	tinyobj::attrib_t attrib;
-	// list of shapes in the file
-	std::vector<tinyobj::shape_t> shapes;
-	// currently unused 
-	std::vector<tinyobj::material_t> materials;
+	// chunked, multithreaded parse of the memory-mapped file
+	ObjData obj;
+	ObjLoadTimings objTimings;
+	if (!load_obj(fileName, obj, &objTimings))
+	{
+		return false;
+	}
 
-	std::string warn;
-	std::string err;
+	auto start = std::chrono::steady_clock::now();
+	std::vector<size_t> shapes(obj.shapes.size());
+	for (size_t s = 0; s < shapes.size(); s++)
+	{
+		shapes[s] = s;
+	}
+	build_from_obj(obj, shapes);
+	const double convertMs = elapsed_ms(start);
+	LOG_INFO(fileName << ": map " << objTimings.mapMs << " ms, parse " << objTimings.parseMs
+		<< " ms, merge " << objTimings.mergeMs << " ms, convert " << convertMs << " ms");
+
+	finish_import(fileName);
+	return true;
+}
+
+bool Mesh::load_obj_parts(const char* fileName, std::vector<Mesh>& parts, std::vector<std::string>* dependencies)
+{
+	ObjData obj;
+	ObjLoadTimings objTimings;
+	if (!load_obj(fileName, obj, &objTimings))
+	{
+		return false;
+	}
+	if (dependencies)
+	{
+		*dependencies = obj.libraries;
+	}
+
+	// shapes grouped by material in order of first use, so part 0 is the one a single-material file always had
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::vector<size_t>> partShapes;
+	std::unordered_map<int, size_t> partOfMaterial;
+	for (size_t s = 0; s < obj.shapes.size(); s++)
+	{
+		auto inserted = partOfMaterial.emplace(obj.shapes[s].material, partShapes.size());
+		if (inserted.second)
+		{
+			partShapes.emplace_back();
+		}
+		partShapes[inserted.first->second].push_back(s);
+	}
+	if (partShapes.empty())
+	{
+		partShapes.emplace_back();
+	}
+
+	parts.clear();
+	parts.resize(partShapes.size());
+	parallel_for(parts.size(), [&](size_t p) {
+		Mesh& part = parts[p];
+		part.build_from_obj(obj, partShapes[p]);
+
+		const int material = partShapes[p].empty() ? -1 : obj.shapes[partShapes[p][0]].material;
+		if (material >= 0)
+		{
+			const ObjMaterial& source = obj.materials[material];
+			part._material.name = source.name;
+			part._material.baseColor = glm::vec4(source.diffuse[0], source.diffuse[1], source.diffuse[2], source.dissolve);
+			part._material.diffuseTexture = source.diffuseMap;
+		}
+	});
+	const double convertMs = elapsed_ms(start);
+	// across every part, so each is darkened by the others too; before finish_import renumbers the vertices
+	start = std::chrono::steady_clock::now();
+	bake_vertex_occlusion(parts);
+	const double occlusionMs = elapsed_ms(start);
+	LOG_INFO(fileName << ": map " << objTimings.mapMs << " ms, parse " << objTimings.parseMs
+		<< " ms, merge " << objTimings.mergeMs << " ms, convert " << convertMs << " ms, occlusion " << occlusionMs << " ms, "
+		<< parts.size() << " materials");
+
+	parallel_for(parts.size(), [&](size_t p) {
+		const std::string name = std::string(fileName) + " (" + (parts[p]._material.name.empty() ? "no material" : parts[p]._material.name) + ")";
+		parts[p].finish_import(name.c_str());
+	});
+	return true;
+}
+
+void Mesh::build_from_obj(const ObjData& obj, const std::vector<size_t>& shapes)
+{
+	// each shape becomes a surface and is converted on its own worker, deduplicating its corners locally
+	// vertices shared between shapes are kept once per shape, which is what lets shapes run in parallel
+	struct ShapeGeometry {
+		std::vector<Vertex> vertices;
+		std::vector<glm::vec2> texcoords;
+		std::vector<uint32_t> indices;
+	};
+	std::vector<ShapeGeometry> shapeGeometry(shapes.size());
 
-	// load the OBJ file
-	tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, fileName, nullptr);
+	// a file without any vt lines gets no UV stream, and so no tangents
+	const bool hasTexcoords = !obj.texcoords.empty();
+	parallel_for(shapes.size(), [&](size_t s) {
+		ShapeGeometry& geometry = shapeGeometry[s];
+		build_obj_shape(obj, obj.shapes[shapes[s]], geometry.vertices, geometry.indices, hasTexcoords ? &geometry.texcoords : nullptr);
+	});
 
-	if (!warn.empty()) {
-		std::cout << "WARN: " << warn << std::endl;
+	// prefix sums give every shape its slice of the final arrays, which are then filled in parallel
+	std::vector<size_t> vertexBase(shapeGeometry.size() + 1, 0);
+	std::vector<size_t> indexBase(shapeGeometry.size() + 1, 0);
+	for (size_t s = 0; s < shapeGeometry.size(); s++)
+	{
+		vertexBase[s + 1] = vertexBase[s] + shapeGeometry[s].vertices.size();
+		indexBase[s + 1] = indexBase[s] + shapeGeometry[s].indices.size();
 	}
 
-	if (!err.empty()) {
-		std::cerr << err << std::endl;
+	_vertices.resize(vertexBase.back());
+	_texcoords.assign(hasTexcoords ? vertexBase.back() : 0, glm::vec2(0.f));
+	_indices.resize(indexBase.back());
+	parallel_for(shapeGeometry.size(), [&](size_t s) {
+		const ShapeGeometry& geometry = shapeGeometry[s];
+		std::copy(geometry.vertices.begin(), geometry.vertices.end(), _vertices.begin() + vertexBase[s]);
+		std::copy(geometry.texcoords.begin(), geometry.texcoords.end(), _texcoords.begin() + vertexBase[s]);
+
+		const uint32_t base = static_cast<uint32_t>(vertexBase[s]);
+		uint32_t* dst = _indices.data() + indexBase[s];
+		for (size_t i = 0; i < geometry.indices.size(); i++)
+		{
+			dst[i] = geometry.indices[i] + base;
+		}
+	});
+
+	_surfaces.clear();
+	for (size_t s = 0; s < shapeGeometry.size(); s++)
+	{
+		MeshSurface surface = {};
+		surface.firstIndex = static_cast<uint32_t>(indexBase[s]);
+		surface.indexCount = static_cast<uint32_t>(indexBase[s + 1] - indexBase[s]);
+		_surfaces.push_back(surface);
+	}
+}
+
+bool Mesh::load_from_gltf(const GltfPrimitive& primitive, const char* name)
+{
+	heap_stats::Scope heapScope(HeapTag::Meshes);
+	const auto start = std::chrono::steady_clock::now();
+	const GltfAccessor& position = primitive.position;
+	const GltfAccessor& normal = primitive.normal;
+	const GltfAccessor& color = primitive.color;
+	const size_t vertexCount = position.count;
+	_vertices.resize(vertexCount);
+
+	// an exporter that wrote Vertex's own layout leaves nothing to convert
+	const bool interleaved = normal.data == position.data + offsetof(Vertex, normal) && color.data == position.data + offsetof(Vertex, color)
+		&& position.stride == sizeof(Vertex) && normal.stride == sizeof(Vertex) && color.stride == sizeof(Vertex)
+		&& position.componentType == GLTF_FLOAT && normal.componentType == GLTF_FLOAT && color.componentType == GLTF_FLOAT
+		&& color.components == 3;
+	if (interleaved)
+	{
+		memcpy(_vertices.data(), position.data, vertexCount * sizeof(Vertex));
+	}
+	else
+	{
+		constexpr size_t VERTICES_PER_JOB = 4096;
+		parallel_for((vertexCount + VERTICES_PER_JOB - 1) / VERTICES_PER_JOB, [&](size_t chunk) {
+			const size_t end = std::min(vertexCount, (chunk + 1) * VERTICES_PER_JOB);
+			for (size_t i = chunk * VERTICES_PER_JOB; i < end; i++)
+			{
+				float values[4];
+				Vertex& vertex = _vertices[i];
+				gltf_read_floats(position, i, values);
+				vertex.position = glm::vec3(values[0], values[1], values[2]);
+				vertex.normal = glm::vec3(0.f);
+				if (normal.data != nullptr)
+				{
+					gltf_read_floats(normal, i, values);
+					vertex.normal = glm::vec3(values[0], values[1], values[2]);
+				}
+				vertex.color = glm::vec3(1.f);
+				if (color.data != nullptr)
+				{
+					gltf_read_floats(color, i, values);
+					vertex.color = glm::vec3(values[0], values[1], values[2]);
+				}
+			}
+		});
+	}
+
+	const GltfAccessor& indices = primitive.indices;
+	if (indices.data == nullptr)
+	{
+		_indices.resize(vertexCount - vertexCount % 3);
+		for (uint32_t i = 0; i < _indices.size(); i++)
+		{
+			_indices[i] = i;
+		}
+	}
+	else
+	{
+		_indices.resize(indices.count - indices.count % 3);
+		if (indices.componentType == GLTF_UNSIGNED_INT && indices.stride == sizeof(uint32_t))
+		{
+			memcpy(_indices.data(), indices.data, _indices.size() * sizeof(uint32_t));
+		}
+		else
+		{
+			for (size_t i = 0; i < _indices.size(); i++)
+			{
+				_indices[i] = gltf_read_index(indices, i);
+			}
+		}
+		for (uint32_t index : _indices)
+		{
+			if (index >= vertexCount)
+			{
+				LOG_WARN(name << ": index " << index << " past the " << vertexCount << " vertices");
+				_vertices.clear();
+				_indices.clear();
+				return false;
+			}
+		}
+	}
+
+	if (_indices.empty())
+	{
+		_vertices.clear();
 		return false;
 	}
 
-	// loop over shapes
-	for (size_t s = 0; s < shapes.size(); s++) {
-		// loop over faces
-		size_t index_offset = 0;
-		for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
+	if (normal.data == nullptr)
+	{
+		smooth_normals(_vertices, _indices.data(), _indices.size(), nullptr);
+	}
+
+	// glTF's UVs are v-down already
+	const GltfAccessor& texcoord = primitive.texcoord;
+	_texcoords.clear();
+	if (texcoord.data != nullptr && texcoord.count == vertexCount)
+	{
+		_texcoords.resize(vertexCount);
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			float values[4];
+			gltf_read_floats(texcoord, i, values);
+			_texcoords[i] = glm::vec2(values[0], values[1]);
+		}
+	}
 
-			// load triangles - note that mesh MUST be triangulated
-			int fv = 3;
+	MeshSurface surface = {};
+	surface.indexCount = static_cast<uint32_t>(_indices.size());
+	_surfaces.push_back(surface);
+	LOG_INFO(name << ": " << (interleaved ? "copied" : "converted") << " in " << elapsed_ms(start) << " ms");
 
-			// loop over vertices
-			for (size_t v = 0; v < fv; v++) {
-				tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
+	finish_import(name);
+	return true;
+}
 
-				tinyobj::real_t vx = attrib.vertices[3 * idx.vertex_index + 0];
-				tinyobj::real_t vy = attrib.vertices[3 * idx.vertex_index + 1];
-				tinyobj::real_t vz = attrib.vertices[3 * idx.vertex_index + 2];
-				
-				tinyobj::real_t nx = attrib.normals[3 * idx.normal_index + 0];
-				tinyobj::real_t ny = attrib.normals[3 * idx.normal_index + 1];
-				tinyobj::real_t nz = attrib.normals[3 * idx.normal_index + 2];
+void Mesh::finish_import(const char* name)
+{
+	auto start = std::chrono::steady_clock::now();
+	// clustering reorders the triangles again, which would undo the overdraw order anyway
+	optimize(name, false);
+	build_clusters(name);
+	const double optimizeMs = elapsed_ms(start);
 
-				// copy into vertex
-				Vertex new_vert;
-				new_vert.position.x = vx;
-				new_vert.position.y = vy;
-				new_vert.position.z = vz;
+	update_index_type();
+	compute_bounds();
 
-				new_vert.normal.x = nx;
-				new_vert.normal.y = ny;
-				new_vert.normal.z = nz;
+	start = std::chrono::steady_clock::now();
+	build_tangents();
+	const double tangentMs = elapsed_ms(start);
 
-				// set vertex color as normal for debug purposes
-				new_vert.color = new_vert.normal;
+	start = std::chrono::steady_clock::now();
+	build_lods(name);
+	const double lodMs = elapsed_ms(start);
 
-				_vertices.push_back(new_vert);
+	LOG_INFO(name << ": " << _indices.size() << " indices, " << _vertices.size() << " unique vertices, optimize "
+		<< optimizeMs << " ms, tangents " << tangentMs << " ms, LODs " << lodMs << " ms");
+}
+
+void Mesh::build_tangents()
+{
+	_tangents.clear();
+	if (_vertices.empty() || _texcoords.size() != _vertices.size())
+	{
+		return;
+	}
+
+	// every triangle's UV-space tangent and bitangent go to its corners weighted by the corner's angle, the
+	// tangent projected into the vertex's plane and normalized first, as MikkTSpace does. Vertices that differ
+	// in UV are distinct already, so UV seams split like Mikk splits them; mirrored halves sharing a vertex don't
+	std::vector<glm::vec3> tangents(_vertices.size(), glm::vec3(0.f));
+	std::vector<glm::vec3> bitangents(_vertices.size(), glm::vec3(0.f));
+	auto accumulate = [&](size_t firstIndex, size_t indexCount) {
+		for (size_t i = firstIndex; i + 3 <= firstIndex + indexCount; i += 3)
+		{
+			const uint32_t corners[3] = { _indices[i], _indices[i + 1], _indices[i + 2] };
+			const glm::vec3 p[3] = { _vertices[corners[0]].position, _vertices[corners[1]].position, _vertices[corners[2]].position };
+			const glm::vec2 uv[3] = { _texcoords[corners[0]], _texcoords[corners[1]], _texcoords[corners[2]] };
+			const glm::vec3 e1 = p[1] - p[0];
+			const glm::vec3 e2 = p[2] - p[0];
+			const glm::vec2 d1 = uv[1] - uv[0];
+			const glm::vec2 d2 = uv[2] - uv[0];
+			const float determinant = d1.x * d2.y - d2.x * d1.y;
+			if (std::fabs(determinant) < 1e-20f)
+			{
+				// no UV area to orient by
+				continue;
+			}
+			const glm::vec3 sDirection = (e1 * d2.y - e2 * d1.y) / determinant;
+			const glm::vec3 tDirection = (e2 * d1.x - e1 * d2.x) / determinant;
+
+			for (int c = 0; c < 3; c++)
+			{
+				const glm::vec3 a = p[(c + 1) % 3] - p[c];
+				const glm::vec3 b = p[(c + 2) % 3] - p[c];
+				const float lengths = glm::length(a) * glm::length(b);
+				const glm::vec3& normal = _vertices[corners[c]].normal;
+				const glm::vec3 projected = sDirection - normal * glm::dot(normal, sDirection);
+				const float projectedLength = glm::length(projected);
+				if (lengths <= 0.f || projectedLength <= 0.f)
+				{
+					continue;
+				}
+				const float angle = std::acos(glm::clamp(glm::dot(a, b) / lengths, -1.f, 1.f));
+				tangents[corners[c]] += projected * (angle / projectedLength);
+				bitangents[corners[c]] += tDirection * angle;
+			}
+		}
+	};
+
+	// surfaces that own their vertices, like an OBJ's shapes, each go to a worker; shared ones would race
+	std::vector<MeshSurface> ranges = _surfaces;
+	if (ranges.empty())
+	{
+		MeshSurface whole = {};
+		whole.indexCount = get_lod(0).indexCount;
+		ranges.push_back(whole);
+	}
+	std::vector<uint32_t> owners(_vertices.size(), UINT32_MAX);
+	bool disjoint = true;
+	for (uint32_t s = 0; s < ranges.size() && disjoint; s++)
+	{
+		for (uint32_t i = ranges[s].firstIndex; i < ranges[s].firstIndex + ranges[s].indexCount; i++)
+		{
+			uint32_t& owner = owners[_indices[i]];
+			disjoint = disjoint && (owner == UINT32_MAX || owner == s);
+			owner = s;
+		}
+	}
+	if (disjoint)
+	{
+		parallel_for(ranges.size(), [&](size_t s) {
+			accumulate(ranges[s].firstIndex, ranges[s].indexCount);
+		});
+	}
+	else
+	{
+		for (const MeshSurface& range : ranges)
+		{
+			accumulate(range.firstIndex, range.indexCount);
+		}
+	}
+
+	_tangents.resize(_vertices.size());
+	constexpr size_t VERTICES_PER_JOB = 4096;
+	parallel_for((_vertices.size() + VERTICES_PER_JOB - 1) / VERTICES_PER_JOB, [&](size_t chunk) {
+		const size_t end = std::min(_vertices.size(), (chunk + 1) * VERTICES_PER_JOB);
+		for (size_t v = chunk * VERTICES_PER_JOB; v < end; v++)
+		{
+			const glm::vec3& normal = _vertices[v].normal;
+			glm::vec3 tangent = tangents[v] - normal * glm::dot(normal, tangents[v]);
+			if (glm::dot(tangent, tangent) <= 1e-24f)
+			{
+				// no UV gradient reached the vertex: any direction in its plane will do
+				tangent = glm::cross(normal, std::fabs(normal.x) < 0.9f ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 1.f, 0.f));
 			}
-			index_offset += fv;
+			const float length = glm::length(tangent);
+			tangent = length > 0.f ? tangent / length : glm::vec3(1.f, 0.f, 0.f);
+			const float sign = glm::dot(glm::cross(normal, tangent), bitangents[v]) < 0.f ? -1.f : 1.f;
+			_tangents[v] = glm::vec4(tangent, sign);
 		}
+	});
+}
+
+std::string Mesh::cache_path(const std::string& fileName)
+{
+	return fileName + MESH_CACHE_EXTENSION;
+}
+
+bool Mesh::load_parts(const char* fileName, std::vector<Mesh>& parts, const AssetArchive* archive, bool keepPackedIndices, bool compressCache,
+	AssetCache* cache)
+{
+	heap_stats::Scope heapScope(HeapTag::Meshes);
+	// in the asset cache, under the key of the OBJ and the libraries it used last time; next to the OBJ otherwise
+	uint64_t key = 0;
+	auto cache_key = [&]() {
+		std::vector<std::string> sources = { fileName };
+		const std::vector<std::string> dependencies = cache->dependencies(fileName);
+		sources.insert(sources.end(), dependencies.begin(), dependencies.end());
+		return cache->key(sources, "obj-parts", MESH_CACHE_VERSION);
+	};
+	if (cache != nullptr)
+	{
+		key = cache_key();
+	}
+	auto cache_path = [&](uint32_t part) {
+		const std::string suffix = (part == 0 ? std::string() : "." + std::to_string(part)) + MESH_CACHE_EXTENSION;
+		return key != 0 ? cache->path(key, suffix) : std::string(fileName) + suffix;
+	};
+
+	// part 0's cache says how many follow; any of them missing, stale or from another import rebuilds them all
+	parts.clear();
+	uint32_t expectedParts = 1;
+	for (uint32_t part = 0; part < expectedParts; part++)
+	{
+		const std::string cachePath = cache_path(part);
+		Mesh mesh;
+		uint32_t partCount = 0;
+
+		// a packed cache is checked against the OBJ like a loose one, so a stale archive falls through to it
+		const uint8_t* packed;
+		size_t packedSize;
+		const bool cached = (archive != nullptr && archive->find(cachePath, packed, packedSize)
+			&& mesh.load_from_cache_data(packed, packedSize, cachePath.c_str(), fileName, keepPackedIndices, &partCount))
+			|| mesh.load_from_cache(cachePath.c_str(), fileName, keepPackedIndices, &partCount);
+		if (!cached || partCount == 0 || (part > 0 && partCount != expectedParts))
+		{
+			parts.clear();
+			break;
+		}
+		expectedParts = partCount;
+		parts.push_back(std::move(mesh));
+	}
+	if (cache != nullptr)
+	{
+		cache->count_lookup(!parts.empty());
+	}
+	if (!parts.empty())
+	{
+		return true;
+	}
+
+	std::vector<std::string> libraries;
+	if (!load_obj_parts(fileName, parts, &libraries))
+	{
+		return false;
+	}
+	if (cache != nullptr)
+	{
+		// the libraries may not be the ones the lookup assumed; a missing one keeps the key from existing
+		cache->set_dependencies(fileName, libraries);
+		key = cache_key();
+	}
+
+	// parts drawing from one atlas share a texture, and so a material, instead of each binding a map of its own
+	const std::string atlasPath = key != 0 ? cache->path(key, TEXTURE_ATLAS_EXTENSION) : std::string(fileName) + TEXTURE_ATLAS_EXTENSION;
+	if (atlasPath.size() < sizeof(MeshCacheMaterial::diffuseTexture))
+	{
+		atlas_part_textures(parts, atlasPath, fileName);
+	}
+
+	const uint32_t partCount = static_cast<uint32_t>(parts.size());
+	for (uint32_t part = 0; part < partCount; part++)
+	{
+		const std::string cachePath = cache_path(part);
+		if (!parts[part].save_to_cache(cachePath.c_str(), fileName, compressCache, partCount))
+		{
+			LOG_WARN("could not write mesh cache " << cachePath);
+		}
+	}
+	return true;
+}
+
+
+bool Mesh::load_from_cache(const char* cachePath, const char* sourcePath, bool keepPackedIndices, uint32_t* partCount)
+{
+	MappedFile file;
+	return file.open(cachePath) && load_from_cache_data(file.data(), file.size(), cachePath, sourcePath, keepPackedIndices, partCount);
+}
+
+bool Mesh::load_from_cache_data(const uint8_t* data, size_t size, const char* cachePath, const char* sourcePath, bool keepPackedIndices,
+	uint32_t* partCount)
+{
+	if (size < sizeof(MeshCacheHeader))
+	{
+		return false;
+	}
+
+	MeshCacheHeader header;
+	memcpy(&header, data, sizeof(MeshCacheHeader));
+
+	if (header.magic != MESH_CACHE_MAGIC || header.version != MESH_CACHE_VERSION || header.vertexStride != sizeof(Vertex))
+	{
+		return false;
+	}
+
+	const bool compressed = (header.flags & MESH_CACHE_COMPRESSED) != 0;
+	const size_t vertexBytes = header.vertexBlobBytes;
+	const size_t indexBytes = header.indexBlobBytes;
+	if (!compressed && (vertexBytes != size_t(header.vertexCount) * sizeof(Vertex) || indexBytes % sizeof(uint32_t) != 0))
+	{
+		return false;
+	}
+	const size_t surfaceBytes = size_t(header.surfaceCount) * sizeof(MeshCacheSurface);
+	const size_t lodBytes = size_t(header.lodCount) * sizeof(MeshCacheLod);
+	const size_t clusterBytes = size_t(header.clusterCount) * sizeof(MeshCacheCluster);
+	const bool hasTangents = (header.flags & MESH_CACHE_TANGENTS) != 0;
+	const size_t texcoordBytes = hasTangents ? size_t(header.vertexCount) * sizeof(glm::vec2) : 0;
+	const size_t tangentBytes = hasTangents ? size_t(header.vertexCount) * sizeof(glm::vec4) : 0;
+	if (size < sizeof(MeshCacheHeader) + vertexBytes + indexBytes + surfaceBytes + lodBytes + clusterBytes + sizeof(MeshCacheMaterial)
+		+ texcoordBytes + tangentBytes)
+	{
+		return false;
+	}
+
+	// the cache invalidates itself when the OBJ changes
+	// a timestamp-only change (fresh checkout, copy) is accepted if the contents still hash the same
+	SourceStamp stamp;
+	if (get_source_stamp(sourcePath, stamp))
+	{
+		if (stamp.size != header.sourceSize)
+		{
+			return false;
+		}
+		if (stamp.timestamp != header.sourceTimestamp && hash_file(sourcePath) != header.sourceHash)
+		{
+			return false;
+		}
+	}
+
+	// checked before anything is replaced, so a corrupt cache still falls through to the OBJ
+	const uint8_t* cursor = data + sizeof(MeshCacheHeader);
+	std::vector<Vertex> vertices(header.vertexCount);
+	std::vector<uint32_t> indices;
+	std::vector<uint32_t> packedIndices;
+	if (compressed)
+	{
+		// decoded straight out of the mapping into the final arrays, which costs no more than the copies it replaces
+		// compressed indices always come out decoded; there's nothing left for the GPU to expand
+		indices.resize(header.indexCount);
+		if (!meshcodec::decode_vertices(vertices.data(), vertices.size(), sizeof(Vertex), cursor, vertexBytes)
+			|| !meshcodec::decode_indices(indices.data(), indices.size(), cursor + vertexBytes, indexBytes))
+		{
+			return false;
+		}
+	}
+	else
+	{
+		packedIndices.resize(indexBytes / sizeof(uint32_t));
+		memcpy(packedIndices.data(), cursor + vertexBytes, indexBytes);
+		if (!blockpack::validate(packedIndices.data(), packedIndices.size()) || blockpack::value_count(packedIndices.data()) != header.indexCount)
+		{
+			return false;
+		}
+
+		// one copy per stream, straight out of the mapping
+		memcpy(vertices.data(), cursor, vertexBytes);
+	}
+	_vertices = std::move(vertices);
+	cursor += vertexBytes + indexBytes;
+
+	_bounds = read_bounds(header.boundsMin, header.boundsMax, header.boundsOrigin, header.boundsRadius);
+
+	_surfaces.resize(header.surfaceCount);
+	for (uint32_t i = 0; i < header.surfaceCount; i++)
+	{
+		MeshCacheSurface cached;
+		memcpy(&cached, cursor + i * sizeof(MeshCacheSurface), sizeof(MeshCacheSurface));
+
+		_surfaces[i].firstIndex = cached.firstIndex;
+		_surfaces[i].indexCount = cached.indexCount;
+		_surfaces[i].bounds = read_bounds(cached.boundsMin, cached.boundsMax, cached.boundsOrigin, cached.boundsRadius);
+	}
+	cursor += surfaceBytes;
+
+	_lods.resize(header.lodCount);
+	for (uint32_t i = 0; i < header.lodCount; i++)
+	{
+		MeshCacheLod cached;
+		memcpy(&cached, cursor + i * sizeof(MeshCacheLod), sizeof(MeshCacheLod));
+
+		_lods[i].firstIndex = cached.firstIndex;
+		_lods[i].indexCount = cached.indexCount;
+		_lods[i].error = cached.error;
+	}
+	cursor += lodBytes;
+
+	_clusters.resize(header.clusterCount);
+	for (uint32_t i = 0; i < header.clusterCount; i++)
+	{
+		MeshCacheCluster cached;
+		memcpy(&cached, cursor + i * sizeof(MeshCacheCluster), sizeof(MeshCacheCluster));
+
+		MeshCluster& cluster = _clusters[i];
+		cluster.firstIndex = cached.firstIndex;
+		cluster.indexCount = cached.indexCount;
+		cluster.bounds = read_bounds(cached.boundsMin, cached.boundsMax, cached.boundsOrigin, cached.boundsRadius);
+		cluster.coneApex = { cached.coneApex[0], cached.coneApex[1], cached.coneApex[2] };
+		cluster.coneAxis = { cached.coneAxis[0], cached.coneAxis[1], cached.coneAxis[2] };
+		cluster.coneCutoff = cached.coneCutoff;
+	}
+	cursor += clusterBytes;
+
+	MeshCacheMaterial material;
+	memcpy(&material, cursor, sizeof(MeshCacheMaterial));
+	_material.name = read_cache_string(material.name, sizeof(material.name));
+	_material.baseColor = glm::vec4(material.baseColor[0], material.baseColor[1], material.baseColor[2], material.baseColor[3]);
+	_material.diffuseTexture = read_cache_string(material.diffuseTexture, sizeof(material.diffuseTexture));
+	cursor += sizeof(MeshCacheMaterial);
+
+	_texcoords.resize(hasTangents ? header.vertexCount : 0);
+	_tangents.resize(hasTangents ? header.vertexCount : 0);
+	memcpy(_texcoords.data(), cursor, texcoordBytes);
+	memcpy(_tangents.data(), cursor + texcoordBytes, tangentBytes);
+	if (partCount)
+	{
+		*partCount = header.partCount;
+	}
+
+	update_index_type();
+
+	// 16-bit meshes are narrowed on the CPU anyway, so only 32-bit ones are left for the GPU to expand
+	if (compressed)
+	{
+		_packedIndices.clear();
+		_indices = std::move(indices);
+	}
+	else if (keepPackedIndices && _indexType == VK_INDEX_TYPE_UINT32)
+	{
+		_indices.clear();
+		_packedIndices = std::move(packedIndices);
+	}
+	else
+	{
+		_packedIndices.clear();
+		_indices.resize(header.indexCount);
+		blockpack::decode(packedIndices.data(), _indices.data());
 	}
 
+	LOG_INFO(cachePath << ": loaded " << header.indexCount << " indices (" << indexBytes << " bytes "
+		<< (compressed ? "compressed" : "packed") << "), " << _vertices.size() << " vertices ("
+		<< vertexBytes << " bytes" << (compressed ? " compressed" : "") << ") from cache");
 	return true;
-}
\ No newline at end of file
+}
+
+bool Mesh::save_to_cache(const char* cachePath, const char* sourcePath, bool compress, uint32_t partCount) const
+{
+	SourceStamp stamp;
+	if (!get_source_stamp(sourcePath, stamp))
+	{
+		return false;
+	}
+
+	// uncompressed vertices are written straight from _vertices
+	std::vector<uint8_t> vertexBlob;
+	std::vector<uint8_t> indexBlob;
+	if (compress)
+	{
+		meshcodec::encode_vertices(_vertices.data(), _vertices.size(), sizeof(Vertex), vertexBlob);
+		meshcodec::encode_indices(_indices.data(), _indices.size(), indexBlob);
+	}
+	else
+	{
+		std::vector<uint32_t> packedIndices;
+		blockpack::encode(_indices.data(), _indices.size(), packedIndices);
+		indexBlob.resize(packedIndices.size() * sizeof(uint32_t));
+		memcpy(indexBlob.data(), packedIndices.data(), indexBlob.size());
+	}
+	const size_t vertexBytes = compress ? vertexBlob.size() : _vertices.size() * sizeof(Vertex);
+
+	MeshCacheHeader header = {};
+	header.magic = MESH_CACHE_MAGIC;
+	header.version = MESH_CACHE_VERSION;
+	header.vertexStride = sizeof(Vertex);
+	header.vertexCount = static_cast<uint32_t>(_vertices.size());
+	header.indexCount = static_cast<uint32_t>(_indices.size());
+	const bool hasTangents = !_vertices.empty() && _texcoords.size() == _vertices.size() && _tangents.size() == _vertices.size();
+	header.flags = (compress ? MESH_CACHE_COMPRESSED : 0) | (hasTangents ? MESH_CACHE_TANGENTS : 0);
+	header.vertexBlobBytes = static_cast<uint32_t>(vertexBytes);
+	header.indexBlobBytes = static_cast<uint32_t>(indexBlob.size());
+	header.surfaceCount = static_cast<uint32_t>(_surfaces.size());
+	header.lodCount = static_cast<uint32_t>(_lods.size());
+	header.clusterCount = static_cast<uint32_t>(_clusters.size());
+	header.partCount = partCount;
+	header.sourceSize = stamp.size;
+	header.sourceTimestamp = stamp.timestamp;
+	header.sourceHash = hash_file(sourcePath);
+	write_bounds(_bounds, header.boundsMin, header.boundsMax, header.boundsOrigin, header.boundsRadius);
+
+	std::vector<MeshCacheSurface> surfaces(_surfaces.size());
+	for (size_t i = 0; i < _surfaces.size(); i++)
+	{
+		surfaces[i].firstIndex = _surfaces[i].firstIndex;
+		surfaces[i].indexCount = _surfaces[i].indexCount;
+		write_bounds(_surfaces[i].bounds, surfaces[i].boundsMin, surfaces[i].boundsMax, surfaces[i].boundsOrigin, surfaces[i].boundsRadius);
+	}
+
+	std::vector<MeshCacheLod> lods(_lods.size());
+	for (size_t i = 0; i < _lods.size(); i++)
+	{
+		lods[i].firstIndex = _lods[i].firstIndex;
+		lods[i].indexCount = _lods[i].indexCount;
+		lods[i].error = _lods[i].error;
+		lods[i].reserved = 0;
+	}
+
+	std::vector<MeshCacheCluster> clusters(_clusters.size());
+	for (size_t i = 0; i < _clusters.size(); i++)
+	{
+		const MeshCluster& cluster = _clusters[i];
+		clusters[i].firstIndex = cluster.firstIndex;
+		clusters[i].indexCount = cluster.indexCount;
+		write_bounds(cluster.bounds, clusters[i].boundsMin, clusters[i].boundsMax, clusters[i].boundsOrigin, clusters[i].boundsRadius);
+		for (int c = 0; c < 3; c++)
+		{
+			clusters[i].coneApex[c] = cluster.coneApex[c];
+			clusters[i].coneAxis[c] = cluster.coneAxis[c];
+		}
+		clusters[i].coneCutoff = cluster.coneCutoff;
+		clusters[i].reserved = 0;
+	}
+
+	MeshCacheMaterial material = {};
+	for (int c = 0; c < 4; c++)
+	{
+		material.baseColor[c] = _material.baseColor[c];
+	}
+	write_cache_string(_material.name, material.name, sizeof(material.name));
+	write_cache_string(_material.diffuseTexture, material.diffuseTexture, sizeof(material.diffuseTexture));
+
+	std::ofstream file(cachePath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(compress ? reinterpret_cast<const char*>(vertexBlob.data()) : reinterpret_cast<const char*>(_vertices.data()), vertexBytes);
+	file.write(reinterpret_cast<const char*>(indexBlob.data()), indexBlob.size());
+	file.write(reinterpret_cast<const char*>(surfaces.data()), surfaces.size() * sizeof(MeshCacheSurface));
+	file.write(reinterpret_cast<const char*>(lods.data()), lods.size() * sizeof(MeshCacheLod));
+	file.write(reinterpret_cast<const char*>(clusters.data()), clusters.size() * sizeof(MeshCacheCluster));
+	file.write(reinterpret_cast<const char*>(&material), sizeof(material));
+	if (hasTangents)
+	{
+		file.write(reinterpret_cast<const char*>(_texcoords.data()), _texcoords.size() * sizeof(glm::vec2));
+		file.write(reinterpret_cast<const char*>(_tangents.data()), _tangents.size() * sizeof(glm::vec4));
+	}
+	return file.good();
+}
+
+void Mesh::compute_bounds()
+{
+	// the whole mesh only needs each vertex once
+	_bounds = compute_vertex_bounds(_vertices, _vertices.size(), [](size_t i) { return i; });
+
+	if (_surfaces.empty() && !_indices.empty())
+	{
+		MeshSurface surface = {};
+		surface.firstIndex = 0;
+		surface.indexCount = get_lod(0).indexCount;
+		_surfaces.push_back(surface);
+	}
+
+	// surfaces go through their index range, since their vertices aren't contiguous
+	for (MeshSurface& surface : _surfaces)
+	{
+		const uint32_t* indices = _indices.data() + surface.firstIndex;
+		surface.bounds = compute_vertex_bounds(_vertices, surface.indexCount, [indices](size_t i) { return indices[i]; });
+	}
+}
+
+void Mesh::optimize(const char* name, bool reduceOverdraw)
+{
+	if (_indices.empty())
+	{
+		return;
+	}
+
+	const float acmrBefore = meshopt::compute_acmr(_indices.data(), _indices.size(), _vertices.size());
+
+	// each surface is reordered on its own so the ranges in _surfaces stay valid
+	std::vector<MeshSurface> ranges = _surfaces;
+	if (ranges.empty())
+	{
+		MeshSurface whole = {};
+		whole.indexCount = static_cast<uint32_t>(_indices.size());
+		ranges.push_back(whole);
+	}
+
+	std::vector<uint32_t> reordered(_indices.size());
+	for (const MeshSurface& surface : ranges)
+	{
+		uint32_t* dst = reordered.data() + surface.firstIndex;
+		meshopt::optimize_vertex_cache(dst, _indices.data() + surface.firstIndex, surface.indexCount, _vertices.size());
+		if (reduceOverdraw)
+		{
+			meshopt::optimize_overdraw(dst, surface.indexCount, _vertices.data(), _vertices.size());
+		}
+	}
+	_indices.swap(reordered);
+
+	meshopt::optimize_vertex_fetch(_vertices, _indices, _texcoords.empty() ? nullptr : &_texcoords);
+
+	const float acmrAfter = meshopt::compute_acmr(_indices.data(), _indices.size(), _vertices.size());
+	LOG_INFO(name << ": ACMR " << acmrBefore << " -> " << acmrAfter << " (32-entry FIFO)");
+}
+
+void Mesh::build_clusters(const char* name)
+{
+	_clusters.clear();
+	if (_indices.empty())
+	{
+		return;
+	}
+
+	std::vector<MeshSurface> ranges = _surfaces;
+	if (ranges.empty())
+	{
+		MeshSurface whole = {};
+		whole.indexCount = static_cast<uint32_t>(_indices.size());
+		ranges.push_back(whole);
+	}
+
+	// surfaces are independent, so each is clustered on its own worker into its own slice of the output
+	std::vector<uint32_t> reordered(_indices.size());
+	std::vector<std::vector<MeshCluster>> surfaceClusters(ranges.size());
+	parallel_for(ranges.size(), [&](size_t s) {
+		const MeshSurface& surface = ranges[s];
+		const uint32_t* indices = _indices.data() + surface.firstIndex;
+		const uint32_t triangleCount = surface.indexCount / 3;
+
+		// a small surface is culled fine as a whole and keeps its vertex cache order
+		if (triangleCount <= MIN_CLUSTERED_TRIANGLES)
+		{
+			MeshCluster cluster;
+			cluster.firstIndex = surface.firstIndex;
+			cluster.indexCount = surface.indexCount;
+			uint32_t* dst = reordered.data() + cluster.firstIndex;
+			std::copy(indices, indices + surface.indexCount, dst);
+			cluster.bounds = compute_vertex_bounds(_vertices, cluster.indexCount, [dst](size_t i) { return dst[i]; });
+			compute_cluster_cone(cluster, _vertices, dst);
+			surfaceClusters[s].push_back(cluster);
+			return;
+		}
+
+		glm::vec3 minCentroid(std::numeric_limits<float>::max());
+		glm::vec3 maxCentroid(-std::numeric_limits<float>::max());
+		std::vector<glm::vec3> centroids(triangleCount);
+		std::vector<uint32_t> facing(triangleCount);
+		for (uint32_t t = 0; t < triangleCount; t++)
+		{
+			const glm::vec3& p0 = _vertices[indices[t * 3]].position;
+			const glm::vec3& p1 = _vertices[indices[t * 3 + 1]].position;
+			const glm::vec3& p2 = _vertices[indices[t * 3 + 2]].position;
+			centroids[t] = (p0 + p1 + p2) / 3.f;
+			minCentroid = glm::min(minCentroid, centroids[t]);
+			maxCentroid = glm::max(maxCentroid, centroids[t]);
+
+			// dominant axis and sign of the normal, one of six buckets
+			const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+			const glm::vec3 a = glm::abs(n);
+			const uint32_t axis = a.x >= a.y && a.x >= a.z ? 0 : (a.y >= a.z ? 1 : 2);
+			facing[t] = axis * 2 + (n[axis] < 0.f ? 1 : 0);
+		}
+
+		// triangles facing the same way go together so clusters get narrow normal cones; within each
+		// direction, Z-order keeps neighbours together, so fixed-size runs of it are compact clusters
+		const glm::vec3 inverseExtent = 1.f / glm::max(maxCentroid - minCentroid, glm::vec3(1e-6f));
+		std::vector<std::pair<uint64_t, uint32_t>> order(triangleCount);
+		for (uint32_t t = 0; t < triangleCount; t++)
+		{
+			order[t] = { (uint64_t(facing[t]) << 32) | morton_code(centroids[t], minCentroid, inverseExtent), t };
+		}
+		std::sort(order.begin(), order.end());
+
+		// clusters are cache-optimized over their own vertices only, renumbered to 0..n
+		std::vector<uint32_t> localVertex(_vertices.size(), UINT32_MAX);
+		std::vector<uint32_t> clusterVertices;
+		std::vector<uint32_t> clusterIndices;
+		std::vector<uint32_t> optimized(MAX_CLUSTER_TRIANGLES * 3);
+		for (uint32_t first = 0; first < triangleCount; first += MAX_CLUSTER_TRIANGLES)
+		{
+			const uint32_t count = std::min(MAX_CLUSTER_TRIANGLES, triangleCount - first);
+			clusterIndices.clear();
+			clusterVertices.clear();
+			for (uint32_t t = first; t < first + count; t++)
+			{
+				const uint32_t triangle = order[t].second;
+				for (uint32_t c = 0; c < 3; c++)
+				{
+					const uint32_t vertex = indices[triangle * 3 + c];
+					if (localVertex[vertex] == UINT32_MAX)
+					{
+						localVertex[vertex] = static_cast<uint32_t>(clusterVertices.size());
+						clusterVertices.push_back(vertex);
+					}
+					clusterIndices.push_back(localVertex[vertex]);
+				}
+			}
+
+			// cache order is only kept within a cluster, which is as far as it helps anyway
+			MeshCluster cluster;
+			cluster.firstIndex = surface.firstIndex + first * 3;
+			cluster.indexCount = count * 3;
+			uint32_t* dst = reordered.data() + cluster.firstIndex;
+			meshopt::optimize_vertex_cache(optimized.data(), clusterIndices.data(), clusterIndices.size(), clusterVertices.size());
+			for (uint32_t i = 0; i < cluster.indexCount; i++)
+			{
+				dst[i] = clusterVertices[optimized[i]];
+			}
+			for (uint32_t vertex : clusterVertices)
+			{
+				localVertex[vertex] = UINT32_MAX;
+			}
+
+			cluster.bounds = compute_vertex_bounds(_vertices, cluster.indexCount, [dst](size_t i) { return dst[i]; });
+			compute_cluster_cone(cluster, _vertices, dst);
+			surfaceClusters[s].push_back(cluster);
+		}
+	});
+	_indices.swap(reordered);
+
+	for (const std::vector<MeshCluster>& clusters : surfaceClusters)
+	{
+		_clusters.insert(_clusters.end(), clusters.begin(), clusters.end());
+	}
+
+	// triangles moved between clusters, so renumber vertices for the new first-use order
+	meshopt::optimize_vertex_fetch(_vertices, _indices, _texcoords.empty() ? nullptr : &_texcoords);
+
+	size_t coneCount = 0;
+	for (const MeshCluster& cluster : _clusters)
+	{
+		coneCount += cluster.coneCutoff <= 1.f ? 1 : 0;
+	}
+	const float acmr = meshopt::compute_acmr(_indices.data(), _indices.size(), _vertices.size());
+	LOG_INFO(name << ": " << _clusters.size() << " clusters, " << coneCount << " with a usable normal cone, ACMR " << acmr);
+}
+
+void Mesh::build_meshlets()
+{
+	// cut on the CPU, so packed indices have to be decoded first
+	unpack_indices();
+	_meshlets.clear();
+	_meshletData.clear();
+
+	// position of each mesh vertex in the meshlet being built, UINT32_MAX when it isn't in it
+	std::vector<uint32_t> localVertex(_vertices.size(), UINT32_MAX);
+	std::vector<uint32_t> meshletVertices;
+	std::vector<uint32_t> meshletTriangles;
+
+	auto flush = [&](uint32_t cluster) {
+		if (meshletTriangles.empty())
+		{
+			return;
+		}
+		Meshlet meshlet;
+		meshlet.vertexOffset = static_cast<uint32_t>(_meshletData.size());
+		meshlet.triangleOffset = meshlet.vertexOffset + static_cast<uint32_t>(meshletVertices.size());
+		meshlet.vertexCount = static_cast<uint32_t>(meshletVertices.size());
+		meshlet.triangleCount = static_cast<uint32_t>(meshletTriangles.size());
+		meshlet.cluster = cluster;
+		_meshlets.push_back(meshlet);
+
+		_meshletData.insert(_meshletData.end(), meshletVertices.begin(), meshletVertices.end());
+		_meshletData.insert(_meshletData.end(), meshletTriangles.begin(), meshletTriangles.end());
+		for (uint32_t vertex : meshletVertices)
+		{
+			localVertex[vertex] = UINT32_MAX;
+		}
+		meshletVertices.clear();
+		meshletTriangles.clear();
+	};
+
+	// clusters are already compact and cache-ordered, so cutting them greedily in index order keeps both
+	for (uint32_t c = 0; c < _clusters.size(); c++)
+	{
+		const MeshCluster& cluster = _clusters[c];
+		for (uint32_t i = cluster.firstIndex; i < cluster.firstIndex + cluster.indexCount; i += 3)
+		{
+			const uint32_t* triangle = &_indices[i];
+			uint32_t newVertices = 0;
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				const bool repeated = (k > 0 && triangle[k] == triangle[0]) || (k > 1 && triangle[k] == triangle[1]);
+				newVertices += localVertex[triangle[k]] == UINT32_MAX && !repeated ? 1 : 0;
+			}
+			if (meshletVertices.size() + newVertices > MESHLET_MAX_VERTICES || meshletTriangles.size() == MESHLET_MAX_TRIANGLES)
+			{
+				flush(c);
+			}
+
+			uint32_t packed = 0;
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				if (localVertex[triangle[k]] == UINT32_MAX)
+				{
+					localVertex[triangle[k]] = static_cast<uint32_t>(meshletVertices.size());
+					meshletVertices.push_back(triangle[k]);
+				}
+				packed |= localVertex[triangle[k]] << (8 * k);
+			}
+			meshletTriangles.push_back(packed);
+		}
+		flush(c);
+	}
+}
+
+bool MeshCluster::faces_away_from(const glm::vec3& p) const
+{
+	const glm::vec3 toApex = coneApex - p;
+	const float distance = glm::length(toApex);
+	// the apex itself is behind every triangle, so being there counts as facing away
+	return distance <= 0.f || glm::dot(toApex, coneAxis) >= coneCutoff * distance;
+}
+
+void Mesh::build_lods(const char* name)
+{
+	_lods.clear();
+	if (_indices.empty())
+	{
+		return;
+	}
+
+	MeshLod full = {};
+	full.indexCount = static_cast<uint32_t>(_indices.size());
+	full.error = 0.f;
+	_lods.push_back(full);
+
+	const glm::vec3 extent = _bounds.max - _bounds.min;
+	const float maxExtent = std::max(extent.x, std::max(extent.y, extent.z));
+	if (maxExtent <= 0.f)
+	{
+		return;
+	}
+
+	// every level is clustered from level 0, so errors don't accumulate
+	// level 1 uses the finest grid that halves the triangle count; each level after doubles the cell,
+	// which roughly quarters the triangles and keeps projected triangle density flat as distance doubles
+	std::vector<uint32_t> simplified;
+	float cellSize = maxExtent / 1024.f;
+	size_t previousCount = full.indexCount;
+	const glm::vec3 gridOrigin = _bounds.min - glm::vec3(cellSize * 0.5f);
+
+	while (_lods.size() < MAX_MESH_LODS && cellSize < maxExtent)
+	{
+		simplified.clear();
+		size_t count = meshopt::simplify_clustered(simplified, _indices.data(), full.indexCount,
+			_vertices.data(), _vertices.size(), gridOrigin, cellSize);
+
+		// not coarse enough to be worth a level yet
+		if (count > previousCount / 2)
+		{
+			cellSize *= 2.f;
+			continue;
+		}
+		// too little geometry left to keep its silhouette
+		if (count < 3 * 32)
+		{
+			break;
+		}
+
+		MeshLod lod = {};
+		lod.firstIndex = static_cast<uint32_t>(_indices.size());
+		lod.indexCount = static_cast<uint32_t>(count);
+		// farthest a vertex can have been snapped
+		lod.error = cellSize * 1.7320508f;
+
+		_indices.resize(_indices.size() + count);
+		meshopt::optimize_vertex_cache(_indices.data() + lod.firstIndex, simplified.data(), count, _vertices.size());
+		_lods.push_back(lod);
+
+		previousCount = count;
+		cellSize *= 2.f;
+	}
+
+	logging::Line line(logging::Level::Info);
+	line.stream() << name << ": " << _lods.size() << " LODs (";
+	for (size_t i = 0; i < _lods.size(); i++)
+	{
+		line.stream() << (i ? ", " : "") << _lods[i].indexCount / 3;
+	}
+	line.stream() << " triangles)";
+}
+
+MeshLod Mesh::get_lod(uint32_t level) const
+{
+	if (_lods.empty())
+	{
+		MeshLod full = {};
+		full.indexCount = index_count();
+		return full;
+	}
+	return _lods[std::min<size_t>(level, _lods.size() - 1)];
+}
+
+uint32_t Mesh::select_lod(float maxError) const
+{
+	// errors grow with the level
+	uint32_t level = 0;
+	while (level + 1 < _lods.size() && _lods[level + 1].error <= maxError)
+	{
+		level++;
+	}
+	return level;
+}
+
+void Mesh::update_index_type()
+{
+	// 0xFFFF is left out since it doubles as the primitive restart value
+	_indexType = _vertices.size() < 0xFFFF ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
+
+void Mesh::release_cpu_geometry()
+{
+	// level 0 is otherwise counted from the indices themselves
+	if (_lods.empty())
+	{
+		_lods.push_back({ 0, index_count(), 0.f });
+	}
+	// swapped with empty vectors, since clear() keeps the capacity that's the point of releasing them
+	std::vector<Vertex>().swap(_vertices);
+	std::vector<glm::vec2>().swap(_texcoords);
+	std::vector<glm::vec4>().swap(_tangents);
+	std::vector<uint32_t>().swap(_indices);
+	std::vector<uint32_t>().swap(_packedIndices);
+	std::vector<Meshlet>().swap(_meshlets);
+	std::vector<uint32_t>().swap(_meshletData);
+	_cpuGeometryReleased = true;
+}
+
+uint32_t Mesh::index_count() const
+{
+	return _packedIndices.empty() ? static_cast<uint32_t>(_indices.size()) : blockpack::value_count(_packedIndices.data());
+}
+
+void Mesh::unpack_indices()
+{
+	if (_packedIndices.empty())
+	{
+		return;
+	}
+	_indices.resize(index_count());
+	blockpack::decode(_packedIndices.data(), _indices.data());
+	_packedIndices.clear();
+	_packedIndices.shrink_to_fit();
+}
+
+size_t Mesh::index_buffer_size() const
+{
+	size_t indexSize = _indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+	return size_t(index_count()) * indexSize;
+}
+
+void Mesh::write_indices(void* dst) const
+{
+	if (!_packedIndices.empty())
+	{
+		// only 32-bit meshes are kept packed
+		blockpack::decode(_packedIndices.data(), static_cast<uint32_t*>(dst));
+	}
+	else if (_indexType == VK_INDEX_TYPE_UINT16)
+	{
+		uint16_t* out = static_cast<uint16_t*>(dst);
+		for (size_t i = 0; i < _indices.size(); i++)
+		{
+			out[i] = static_cast<uint16_t>(_indices[i]);
+		}
+	}
+	else
+	{
+		memcpy(dst, _indices.data(), _indices.size() * sizeof(uint32_t));
+	}
+}
+
+namespace {
+	uint16_t quantize_unorm16(float v)
+	{
+		return static_cast<uint16_t>(std::clamp(v, 0.f, 1.f) * 65535.f + 0.5f);
+	}
+
+	int16_t quantize_snorm16(float v)
+	{
+		return static_cast<int16_t>(std::round(std::clamp(v, -1.f, 1.f) * 32767.f));
+	}
+
+	uint8_t quantize_unorm8(float v)
+	{
+		return static_cast<uint8_t>(std::clamp(v, 0.f, 1.f) * 255.f + 0.5f);
+	}
+
+	// octahedral mapping: project onto the |x|+|y|+|z|=1 octahedron, fold the lower half over the upper
+	glm::vec2 encode_octahedral(glm::vec3 n)
+	{
+		float length = glm::dot(glm::abs(n), glm::vec3(1.f));
+		if (length == 0.f)
+		{
+			return glm::vec2(0.f);
+		}
+		n /= length;
+
+		glm::vec2 e = { n.x, n.y };
+		if (n.z < 0.f)
+		{
+			glm::vec2 signs = { e.x >= 0.f ? 1.f : -1.f, e.y >= 0.f ? 1.f : -1.f };
+			e = (glm::vec2(1.f) - glm::abs(glm::vec2(e.y, e.x))) * signs;
+		}
+		return e;
+	}
+}
+
+void Mesh::set_vertex_format(VertexFormat format)
+{
+	_vertexFormat = format;
+	_dequantize = glm::mat4{ 1.0f };
+
+	if (format == VertexFormat::Packed)
+	{
+		// one scale for all axes: thin axes lose a little precision, but spheres stay spheres
+		glm::vec3 extent = _bounds.max - _bounds.min;
+		float scale = std::max(extent.x, std::max(extent.y, extent.z));
+		if (scale <= 0.f)
+		{
+			scale = 1.f;
+		}
+		_dequantize = glm::translate(glm::mat4{ 1.0f }, _bounds.min) * glm::scale(glm::mat4{ 1.0f }, glm::vec3(scale));
+	}
+}
+
+size_t Mesh::vertex_stride(uint32_t binding) const
+{
+	switch (_vertexFormat)
+	{
+	case VertexFormat::Packed:
+		return sizeof(PackedVertex);
+	case VertexFormat::Split:
+		return binding == 0 ? sizeof(glm::vec3) : sizeof(VertexAttributes);
+	case VertexFormat::Voxel:
+		return sizeof(VoxelVertex);
+	default:
+		return sizeof(Vertex);
+	}
+}
+
+void Mesh::write_vertices(void* dst, uint32_t binding) const
+{
+	if (_vertexFormat == VertexFormat::Full)
+	{
+		memcpy(dst, _vertices.data(), _vertices.size() * sizeof(Vertex));
+		return;
+	}
+
+	if (_vertexFormat == VertexFormat::Split)
+	{
+		if (binding == 0)
+		{
+			glm::vec3* out = static_cast<glm::vec3*>(dst);
+			for (size_t i = 0; i < _vertices.size(); i++)
+			{
+				out[i] = _vertices[i].position;
+			}
+			return;
+		}
+
+		VertexAttributes* out = static_cast<VertexAttributes*>(dst);
+		for (size_t i = 0; i < _vertices.size(); i++)
+		{
+			out[i].normal = _vertices[i].normal;
+			out[i].color = _vertices[i].color;
+		}
+		return;
+	}
+
+	if (_vertexFormat == VertexFormat::Voxel)
+	{
+		VoxelVertex* out = static_cast<VoxelVertex*>(dst);
+		for (size_t i = 0; i < _vertices.size(); i++)
+		{
+			const Vertex& v = _vertices[i];
+			int axis = 0;
+			for (int k = 1; k < 3; k++)
+			{
+				if (std::abs(v.normal[k]) > std::abs(v.normal[axis]))
+				{
+					axis = k;
+				}
+			}
+
+			for (int k = 0; k < 3; k++)
+			{
+				out[i].position[k] = static_cast<uint8_t>(std::clamp(std::round(v.position[k]), 0.f, 255.f));
+			}
+			out[i].position[3] = static_cast<uint8_t>(axis * 2 + (v.normal[axis] < 0.f ? 1 : 0));
+			out[i].color[0] = quantize_unorm8(v.color.r);
+			out[i].color[1] = quantize_unorm8(v.color.g);
+			out[i].color[2] = quantize_unorm8(v.color.b);
+			out[i].color[3] = 255;
+		}
+		return;
+	}
+
+	const glm::vec3 offset = glm::vec3(_dequantize[3]);
+	const float invScale = 1.f / _dequantize[0][0];
+
+	PackedVertex* out = static_cast<PackedVertex*>(dst);
+	for (size_t i = 0; i < _vertices.size(); i++)
+	{
+		const Vertex& v = _vertices[i];
+		glm::vec3 p = (v.position - offset) * invScale;
+		glm::vec2 n = encode_octahedral(v.normal);
+
+		out[i].position[0] = quantize_unorm16(p.x);
+		out[i].position[1] = quantize_unorm16(p.y);
+		out[i].position[2] = quantize_unorm16(p.z);
+		out[i].position[3] = 0;
+		out[i].normal[0] = quantize_snorm16(n.x);
+		out[i].normal[1] = quantize_snorm16(n.y);
+		out[i].color[0] = quantize_unorm8(v.color.r);
+		out[i].color[1] = quantize_unorm8(v.color.g);
+		out[i].color[2] = quantize_unorm8(v.color.b);
+		out[i].color[3] = 255;
+	}
+}
+
+glm::vec4 Mesh::vertex_space_sphere() const
+{
+	// inverse of the uniform _dequantize
+	const glm::vec3 offset = glm::vec3(_dequantize[3]);
+	const float scale = _dequantize[0][0];
+	return glm::vec4((_bounds.origin - offset) / scale, _bounds.radius / scale);
+}
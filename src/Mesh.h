@@ -1,31 +1,343 @@
 #pragma once
 
 #include <vk_types.h>
+#include <MeshPool.h>
+#include <MeshletPool.h>
+#include <VertexLayout.h>
 #include <vector>
+#include <string>
+#include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
 
-struct VertexInputDescription {
-	std::vector<VkVertexInputBindingDescription> bindings;
-	std::vector<VkVertexInputAttributeDescription> attributes;
+class AssetArchive;
+class AssetCache;
+struct ObjData;
+struct ObjShape;
+struct GltfPrimitive;
 
-	VkPipelineVertexInputStateCreateFlags flags = 0;
+struct Vertex
+{
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec3 color;
 };
 
-struct Vertex
+// position at location 0, normal at 1, color at 2, from binding 0
+constexpr auto VERTEX_LAYOUT = vertex_layout(
+	{ vertex_binding(0, sizeof(Vertex)) },
+	{ VERTEX_ATTRIBUTE(Vertex, position, 0, 0), VERTEX_ATTRIBUTE(Vertex, normal, 1, 0), VERTEX_ATTRIBUTE(Vertex, color, 2, 0) });
+
+// binding 1 of VertexFormat::Split: everything of Vertex but the position
+struct VertexAttributes
+{
+	glm::vec3 normal;
+	glm::vec3 color;
+};
+
+// VertexFormat::Split: positions alone in binding 0, the VertexAttributes in binding 1, at Vertex's locations
+constexpr auto SPLIT_VERTEX_LAYOUT = vertex_layout(
+	{ vertex_binding(0, sizeof(glm::vec3)), vertex_binding(1, sizeof(VertexAttributes)) },
+	{ vertex_attribute(0, 0, VertexAttributeFormat<glm::vec3>::value, 0), VERTEX_ATTRIBUTE(VertexAttributes, normal, 1, 1),
+		VERTEX_ATTRIBUTE(VertexAttributes, color, 2, 1) });
+
+// GPU-side vertex layouts; the value doubles as the MeshPool vertex stream index
+enum class VertexFormat : uint32_t {
+	Full = 0, // Vertex, 36 bytes
+	Packed = 1, // PackedVertex, 16 bytes
+	Split = 2, // Vertex as a 12-byte position stream and a 24-byte VertexAttributes stream
+	Voxel = 3, // VoxelVertex, 8 bytes; only for the block-aligned meshes of VoxelWorld
+};
+constexpr uint32_t VERTEX_FORMAT_COUNT = 4;
+
+// vertex buffer bindings the format's vertices are spread over
+inline uint32_t vertex_binding_count(VertexFormat format)
+{
+	return format == VertexFormat::Split ? 2 : 1;
+}
+
+// compact layout built from Vertex at upload time
+// position: unorm16 inside the mesh's quantization cube (see Mesh::_dequantize), w unused
+// normal: octahedral encoding in two snorm16
+// color: rgba8 unorm, clamped to [0, 1]
+struct PackedVertex
+{
+	uint16_t position[4];
+	int16_t normal[2];
+	uint8_t color[4];
+};
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex must stay tightly packed");
+
+// same binding and locations as Vertex, so instancing and the pipelines line up; the fetch turns the
+// quantized members into 0..1 (position, color) and -1..1 (normal) floats
+constexpr auto PACKED_VERTEX_LAYOUT = vertex_layout(
+	{ vertex_binding(0, sizeof(PackedVertex)) },
+	{ VERTEX_ATTRIBUTE(PackedVertex, position, 0, 0), VERTEX_ATTRIBUTE(PackedVertex, normal, 1, 0), VERTEX_ATTRIBUTE(PackedVertex, color, 2, 0) });
+
+// greedy-meshed voxel chunk vertex, built from Vertex at upload time
+// position: xyz whole chunk-local block units (0..32), w the face, axis * 2 + 1 for the - side; the normal
+// follows from the face, so voxel.vert shades by it instead of carrying one
+// color: rgba8 unorm, clamped to [0, 1]
+struct VoxelVertex
+{
+	uint8_t position[4];
+	uint8_t color[4];
+};
+static_assert(sizeof(VoxelVertex) == 8, "VoxelVertex must stay tightly packed");
+
+// position fetched uscaled, so it reads as plain block units and the depth-only and shadow shaders take it as
+// any other vec3 position; no normal at location 1
+constexpr auto VOXEL_VERTEX_LAYOUT = vertex_layout(
+	{ vertex_binding(0, sizeof(VoxelVertex)) },
+	{ vertex_attribute(0, 0, VK_FORMAT_R8G8B8A8_USCALED, offsetof(VoxelVertex, position)), VERTEX_ATTRIBUTE(VoxelVertex, color, 2, 0) });
+
+// bind-pose vertex of a skinned mesh, weighted to up to four joints of its skeleton; only the skinning pass
+// reads it (see Skinning.h), which writes the posed vertex out as a Vertex
+struct SkinnedVertex
 {
 	glm::vec3 position;
 	glm::vec3 normal;
 	glm::vec3 color;
+	uint8_t joints[4];
+	uint8_t weights[4]; // unorm8, summing to 255
+};
+static_assert(sizeof(SkinnedVertex) == 44, "skinning.comp reads SkinnedVertex as 11 tightly packed words");
+
+// per-instance data read through a second vertex binding at instance rate
+struct InstanceData
+{
+	glm::mat4 model;
+};
+
+// binding 2, after the ones of a split vertex layout, advancing once per instance; locations 3-6 (a mat4
+// attribute takes one location per column). Concatenated to a vertex layout for the instanced pipelines
+constexpr auto INSTANCE_LAYOUT = vertex_layout(
+	{ vertex_binding(2, sizeof(InstanceData), VK_VERTEX_INPUT_RATE_INSTANCE) },
+	{
+		vertex_attribute(3, 2, VertexAttributeFormat<glm::vec4>::value, offsetof(InstanceData, model)),
+		vertex_attribute(4, 2, VertexAttributeFormat<glm::vec4>::value, offsetof(InstanceData, model) + sizeof(glm::vec4)),
+		vertex_attribute(5, 2, VertexAttributeFormat<glm::vec4>::value, offsetof(InstanceData, model) + 2 * sizeof(glm::vec4)),
+		vertex_attribute(6, 2, VertexAttributeFormat<glm::vec4>::value, offsetof(InstanceData, model) + 3 * sizeof(glm::vec4)),
+	});
 
-	// map Vertex struct to what Vulkan expects for vertex input
-	static VertexInputDescription get_vertex_description();
+// binding 3, also per instance: the GPU scene slot the cull pass stored with each instance, at location 7.
+// Only the pick pipelines append it to their instanced layout
+constexpr auto INSTANCE_OBJECT_LAYOUT = vertex_layout(
+	{ vertex_binding(3, sizeof(uint32_t), VK_VERTEX_INPUT_RATE_INSTANCE) },
+	{ vertex_attribute(7, 3, VK_FORMAT_R32_UINT, 0) });
+
+// mesh-space extents, used for culling and LOD decisions
+struct MeshBounds {
+	glm::vec3 min;
+	glm::vec3 max;
+	glm::vec3 origin; // bounding sphere center
+	float radius;
+};
+
+// index range of one OBJ shape inside the mesh, with its own extents for finer culling
+struct MeshSurface {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	MeshBounds bounds;
+};
+
+// upper bound on triangles per cluster; small enough to cull tightly, large enough that a draw per run stays cheap
+constexpr uint32_t MAX_CLUSTER_TRIANGLES = 128;
+
+// spatially coherent run of level-0 triangles inside one surface, for culling finer than whole surfaces
+// small surfaces are a single cluster of any size
+struct MeshCluster {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	MeshBounds bounds;
+	// normal cone: seen from p, every triangle faces away when dot(normalize(coneApex - p), coneAxis) >= coneCutoff
+	glm::vec3 coneApex;
+	glm::vec3 coneAxis;
+	float coneCutoff; // above 1 when the triangles face too many ways for the test to pass
+
+	// p in mesh space
+	bool faces_away_from(const glm::vec3& p) const;
+};
+
+// meshlet limits shared with meshlet.task/meshlet.mesh; within the EXT_mesh_shader minimums on every GPU
+constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// piece of a cluster small enough for one mesh shader workgroup, with its own vertex table
+// offsets point into Mesh::_meshletData: vertexCount mesh vertex indices, then a uint per triangle
+// holding three 8-bit positions in that table
+struct Meshlet {
+	uint32_t vertexOffset;
+	uint32_t triangleOffset;
+	uint32_t vertexCount;
+	uint32_t triangleCount;
+	uint32_t cluster; // culling data comes from the cluster the meshlet was cut from
+};
+
+// levels of detail generated per imported mesh, including the full-detail level 0
+constexpr uint32_t MAX_MESH_LODS = 4;
+
+// index range of one detail level; every level indexes the same vertices
+struct MeshLod {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error; // mesh-space distance vertices may have moved from the full-detail surface
+};
+
+// the material an imported mesh was grouped by, for the engine to turn into one of its own
+// an empty name means the source gave none, and the vertex colors carry the shading instead
+struct MeshMaterial {
+	std::string name;
+	glm::vec4 baseColor{ 1.f }; // diffuse color, alpha from the dissolve
+	std::string diffuseTexture; // path of the diffuse map, empty without one
 };
 
 struct Mesh
 {
 	std::vector<Vertex> _vertices;
-	AllocatedBuffer _vertexBuffer;
+	// per vertex when the source had UVs, empty otherwise; as written by the source, v up for OBJ
+	std::vector<glm::vec2> _texcoords;
+	// per vertex alongside _texcoords, for normal mapping: the MikkTSpace convention, xyz the unit tangent
+	// orthogonal to the normal and w the bitangent's sign, bitangent = w * cross(normal, tangent). Neither
+	// stream is uploaded yet; no vertex format carries them
+	std::vector<glm::vec4> _tangents;
+	std::vector<uint32_t> _indices;
+	// _indices as a blockpack stream when the cache was loaded with keepPackedIndices, for the GPU to
+	// expand; _indices stays empty then until unpack_indices()
+	std::vector<uint32_t> _packedIndices;
 
+	// layout the vertices are uploaded in; _vertices always stays full precision
+	VertexFormat _vertexFormat{ VertexFormat::Full };
+	// maps the stored positions back to mesh space; identity unless _vertexFormat is Packed
+	// uniform scale, so bounding spheres survive the mapping (see vertex_space_sphere)
+	glm::mat4 _dequantize{ 1.0f };
+
+	// where the uploaded geometry lives in the engine's MeshPool; draws pass these as vertexOffset/firstIndex
+	MeshAllocation _poolAllocation;
+	// set by the engine once the upload has reached the graphics queue; only resident meshes are drawn
+	bool _resident{ false };
+	// handle of its bottom-level acceleration structure, added the first time an object draws it with ray shadows
+	uint32_t _accelerationStructure{ UINT32_MAX };
+	// layer of its atlas in the engine's Impostors once one has arrived; without one it's a mesh at every distance
+	uint32_t _impostor{ UINT32_MAX };
+	// its vertices are rewritten every frame by the skinning pass, into a range per frame slot that
+	// _poolAllocation is pointed at before each frame; never moved by compaction and never ray traced
+	bool _skinned{ false };
+
+	// 16-bit indices are used whenever every vertex is addressable with them, halving index memory
+	VkIndexType _indexType{ VK_INDEX_TYPE_UINT32 };
+
+	MeshMaterial _material;
+
+	// picks the smallest index type able to address all of _vertices
+	void update_index_type();
+	// of level 0 and every LOD, packed or not
+	uint32_t index_count() const;
+	// decodes _packedIndices into _indices, for the CPU-side passes that need them
+	void unpack_indices();
+	// size in bytes of the index buffer once converted to _indexType
+	size_t index_buffer_size() const;
+	// writes _indices into dst, narrowing to 16 bits if _indexType asks for it; packed indices are decoded into it
+	void write_indices(void* dst) const;
+
+	// picks the upload layout and derives _dequantize from _bounds; call after the bounds are known
+	void set_vertex_format(VertexFormat format);
+	// per vertex buffer binding of _vertexFormat (see vertex_binding_count)
+	size_t vertex_stride(uint32_t binding = 0) const;
+	size_t vertex_buffer_size(uint32_t binding = 0) const { return _vertices.size() * vertex_stride(binding); }
+	// writes the part of _vertices that goes to binding into dst, in _vertexFormat
+	void write_vertices(void* dst, uint32_t binding = 0) const;
+	// bounding sphere (xyz center, w radius) in the space of the uploaded positions
+	glm::vec4 vertex_space_sphere() const;
+
+	MeshBounds _bounds;
+	// one per OBJ shape; meshes built by hand get a single surface covering every index
+	std::vector<MeshSurface> _surfaces;
+	// detail levels, finest first; surfaces index into level 0, the other levels follow it in _indices
+	// empty for meshes built by hand, which then only have level 0 (see get_lod)
+	std::vector<MeshLod> _lods;
+	// level 0 split into clusters, in index order; empty for meshes built by hand
+	std::vector<MeshCluster> _clusters;
+	// level 0 again as meshlets for the mesh shader path; only built by build_meshlets
+	std::vector<Meshlet> _meshlets;
+	std::vector<uint32_t> _meshletData;
+	// where the engine's MeshletPool holds them; meshletCount stays 0 for meshes drawn by the vertex pipeline
+	MeshletAllocation _meshletAllocation;
+	bool _cpuGeometryReleased{ false };
+
+	// the parts of an OBJ (see load_obj_parts) from the binary caches next to fileName when they're up to
+	// date, or from archive's copies of them, otherwise parses the OBJ and writes fresh caches for the next run:
+	// fileName's own name plus .qcmesh for part 0, numbered ones for the others. With cache, the caches are
+	// its files instead, keyed by the OBJ and its material libraries
+	// keepPackedIndices leaves the cached indices of a 32-bit mesh in _packedIndices instead of decoding them
+	// compressCache writes the fresh caches compressed (see save_to_cache)
+	static bool load_parts(const char* fileName, std::vector<Mesh>& parts, const AssetArchive* archive = nullptr, bool keepPackedIndices = false,
+		bool compressCache = false, AssetCache* cache = nullptr);
+	// part 0's cache next to fileName, the first file load_parts opens without an AssetCache
+	static std::string cache_path(const std::string& fileName);
+
+	// the whole OBJ as one mesh, whatever its materials
 	bool load_from_obj(const char* fileName);
+	// the OBJ as a mesh per material, in order of first use, each drawn with one material instead of one
+	// draw per face; shapes without a material share a part of their own. The parts' vertex colors carry the
+	// ambient occlusion of the whole file (see VertexOcclusion.h)
+	// dependencies, if given, receives the material libraries the file named
+	static bool load_obj_parts(const char* fileName, std::vector<Mesh>& parts, std::vector<std::string>* dependencies = nullptr);
+	// one shape's corners with each distinct OBJ index triple turned into a vertex once, and the triangle
+	// list over them; replaces vertices and indices, and texcoords when given
+	static void build_obj_shape(const ObjData& obj, const ObjShape& shape, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+		std::vector<glm::vec2>* texcoords = nullptr);
+	// the given shapes of obj as this mesh's vertices, indices and a surface each; before finish_import
+	void build_from_obj(const ObjData& obj, const std::vector<size_t>& shapes);
+	// one glTF primitive, read out of its document's mapped buffers: a single copy when the accessors are
+	// interleaved exactly like Vertex, attribute by attribute otherwise; missing normals are smoothed from
+	// the triangles, missing colors are white so the material's base color shows through
+	bool load_from_gltf(const GltfPrimitive& primitive, const char* name);
+	// what every imported mesh goes through once its vertices and surfaces are in: reordering, clusters,
+	// index type, bounds, tangents and LODs
+	void finish_import(const char* name);
+	// fills _tangents from the normals and _texcoords, a worker per surface; leaves it empty without UVs.
+	// Call after optimize, which renumbers the vertices
+	void build_tangents();
+
+	// binary cache: header + vertex, index, surface, LOD, cluster, material and UV/tangent blobs, tagged with the source's size,
+	// timestamp and hash, and with how many parts the source was split into (returned in partCount)
+	// the indices are stored block-packed (see BlockPack.h), or vertices and indices both compressed (see MeshCodec.h);
+	// compressed indices are always decoded, whatever keepPackedIndices asks for
+	bool load_from_cache(const char* cachePath, const char* sourcePath, bool keepPackedIndices = false, uint32_t* partCount = nullptr);
+	// the same from a cache already in memory; cachePath only names it in the log
+	bool load_from_cache_data(const uint8_t* data, size_t size, const char* cachePath, const char* sourcePath, bool keepPackedIndices = false,
+		uint32_t* partCount = nullptr);
+	// compress trades the GPU index expansion for a cache several times smaller
+	bool save_to_cache(const char* cachePath, const char* sourcePath, bool compress = false, uint32_t partCount = 1) const;
+
+	// fills _bounds and every surface's bounds from the vertex data
+	void compute_bounds();
+
+	// import-time reordering: triangles for the post-transform cache (and optionally overdraw),
+	// then vertices in order of first use. Surfaces keep their index ranges; logs ACMR before and after
+	void optimize(const char* name, bool reduceOverdraw = true);
+
+	// reorders each surface's triangles into clusters of up to MAX_CLUSTER_TRIANGLES by the Morton order of
+	// their centroids, then fills _clusters; call after optimize and before build_lods
+	void build_clusters(const char* name);
+
+	// cuts every cluster into meshlets of at most MESHLET_MAX_VERTICES and MESHLET_MAX_TRIANGLES, in index order
+	void build_meshlets();
+
+	// appends up to MAX_MESH_LODS - 1 simplified levels to _indices; call after optimize and compute_bounds
+	void build_lods(const char* name);
+	// frees the vertex, UV, tangent, index and meshlet copies once the GPU has its own; what drawing and culling
+	// read stays (counts, bounds, surfaces, LODs, clusters). Nothing can upload, cache or re-import the mesh
+	// afterwards: a new device reloads it from its cache instead
+	void release_cpu_geometry();
+	bool cpu_geometry_released() const { return _cpuGeometryReleased; }
+
+	// level's index range; level 0 covers every index when no LODs were built
+	MeshLod get_lod(uint32_t level) const;
+	uint32_t lod_count() const { return _lods.empty() ? 1 : static_cast<uint32_t>(_lods.size()); }
+	// coarsest level whose error doesn't exceed maxError (mesh space)
+	uint32_t select_lod(float maxError) const;
 };
 
@@ -0,0 +1,380 @@
+#include "MeshCodec.h"
+
+#include <cassert>
+#include <cstring>
+
+namespace {
+	constexpr uint8_t VERTEX_HEADER = 0xa0; // high nibble; the low one is the version
+	constexpr uint8_t INDEX_SEQUENCE_HEADER = 0xd0;
+	constexpr uint8_t INDEX_SEQUENCE_VERSION = 1;
+
+	constexpr size_t BYTE_GROUP_SIZE = 16;
+	// the most a group can take: its fixed part plus a whole byte per value
+	constexpr size_t BYTE_GROUP_DECODE_LIMIT = 24;
+	constexpr size_t VERTEX_BLOCK_SIZE_BYTES = 8192;
+	constexpr size_t VERTEX_BLOCK_MAX_SIZE = 256;
+	// the first vertex closes the stream, padded to this size so a decoder never reads past the end within a group
+	constexpr size_t TAIL_MAX_SIZE = 32;
+
+	// vertices per block: as many as fit 8 KB, in whole byte groups
+	size_t vertex_block_size(size_t vertexSize)
+	{
+		const size_t result = (VERTEX_BLOCK_SIZE_BYTES / vertexSize) & ~(BYTE_GROUP_SIZE - 1);
+		return result < VERTEX_BLOCK_MAX_SIZE ? result : VERTEX_BLOCK_MAX_SIZE;
+	}
+
+	size_t tail_size(size_t vertexSize)
+	{
+		return vertexSize < TAIL_MAX_SIZE ? TAIL_MAX_SIZE : vertexSize;
+	}
+
+	uint8_t zigzag8(uint8_t v)
+	{
+		return static_cast<uint8_t>((static_cast<int8_t>(v) >> 7) ^ (v << 1));
+	}
+
+	uint8_t unzigzag8(uint8_t v)
+	{
+		return static_cast<uint8_t>(-(v & 1) ^ (v >> 1));
+	}
+
+	// bytes a group takes with bits per value; 0 bits only holds a group of zeroes
+	size_t group_size(const uint8_t* group, int bits)
+	{
+		if (bits == 0)
+		{
+			for (size_t i = 0; i < BYTE_GROUP_SIZE; i++)
+			{
+				if (group[i] != 0)
+				{
+					return SIZE_MAX;
+				}
+			}
+			return 0;
+		}
+		if (bits == 8)
+		{
+			return BYTE_GROUP_SIZE;
+		}
+
+		const uint8_t sentinel = static_cast<uint8_t>((1 << bits) - 1);
+		size_t size = BYTE_GROUP_SIZE * bits / 8;
+		for (size_t i = 0; i < BYTE_GROUP_SIZE; i++)
+		{
+			size += group[i] >= sentinel;
+		}
+		return size;
+	}
+
+	// values packed most significant first, all-ones standing for a value that follows as a whole byte
+	uint8_t* encode_group(uint8_t* data, const uint8_t* group, int bitsLog2)
+	{
+		if (bitsLog2 == 0)
+		{
+			return data;
+		}
+		if (bitsLog2 == 3)
+		{
+			memcpy(data, group, BYTE_GROUP_SIZE);
+			return data + BYTE_GROUP_SIZE;
+		}
+
+		const int bits = 1 << bitsLog2;
+		const size_t perByte = 8 / bits;
+		const uint8_t sentinel = static_cast<uint8_t>((1 << bits) - 1);
+		for (size_t i = 0; i < BYTE_GROUP_SIZE; i += perByte)
+		{
+			uint8_t byte = 0;
+			for (size_t k = 0; k < perByte; k++)
+			{
+				byte = static_cast<uint8_t>(byte << bits);
+				byte |= group[i + k] >= sentinel ? sentinel : group[i + k];
+			}
+			*data++ = byte;
+		}
+		for (size_t i = 0; i < BYTE_GROUP_SIZE; i++)
+		{
+			if (group[i] >= sentinel)
+			{
+				*data++ = group[i];
+			}
+		}
+		return data;
+	}
+
+	const uint8_t* decode_group(const uint8_t* data, uint8_t* group, int bitsLog2)
+	{
+		if (bitsLog2 == 0)
+		{
+			memset(group, 0, BYTE_GROUP_SIZE);
+			return data;
+		}
+		if (bitsLog2 == 3)
+		{
+			memcpy(group, data, BYTE_GROUP_SIZE);
+			return data + BYTE_GROUP_SIZE;
+		}
+
+		const int bits = 1 << bitsLog2;
+		const size_t perByte = 8 / bits;
+		const uint8_t sentinel = static_cast<uint8_t>((1 << bits) - 1);
+		// the whole bytes start after the fixed part
+		const uint8_t* extra = data + BYTE_GROUP_SIZE / perByte;
+		for (size_t i = 0; i < BYTE_GROUP_SIZE; i += perByte)
+		{
+			const uint8_t byte = *data++;
+			for (size_t k = 0; k < perByte; k++)
+			{
+				const uint8_t value = static_cast<uint8_t>((byte >> (8 - bits * (k + 1))) & sentinel);
+				group[i + k] = value == sentinel ? *extra++ : value;
+			}
+		}
+		return extra;
+	}
+
+	// a 2-bit header per group, four to a byte, then the groups in the cheapest width each
+	uint8_t* encode_bytes(uint8_t* data, const uint8_t* values, size_t count)
+	{
+		assert(count % BYTE_GROUP_SIZE == 0);
+		uint8_t* header = data;
+		const size_t headerSize = (count / BYTE_GROUP_SIZE + 3) / 4;
+		memset(header, 0, headerSize);
+		data += headerSize;
+
+		for (size_t i = 0; i < count; i += BYTE_GROUP_SIZE)
+		{
+			int bestLog2 = 3;
+			size_t bestSize = group_size(values + i, 8);
+			for (int bitsLog2 = 0; bitsLog2 < 3; bitsLog2++)
+			{
+				const size_t size = group_size(values + i, bitsLog2 == 0 ? 0 : 1 << bitsLog2);
+				if (size < bestSize)
+				{
+					bestLog2 = bitsLog2;
+					bestSize = size;
+				}
+			}
+
+			const size_t group = i / BYTE_GROUP_SIZE;
+			header[group / 4] |= static_cast<uint8_t>(bestLog2 << ((group % 4) * 2));
+			data = encode_group(data, values + i, bestLog2);
+		}
+		return data;
+	}
+
+	const uint8_t* decode_bytes(const uint8_t* data, const uint8_t* end, uint8_t* values, size_t count)
+	{
+		const size_t headerSize = (count / BYTE_GROUP_SIZE + 3) / 4;
+		if (size_t(end - data) < headerSize)
+		{
+			return nullptr;
+		}
+		const uint8_t* header = data;
+		data += headerSize;
+
+		for (size_t i = 0; i < count; i += BYTE_GROUP_SIZE)
+		{
+			// the tail guarantees this much for every well-formed group, so groups need no checks of their own
+			if (size_t(end - data) < BYTE_GROUP_DECODE_LIMIT)
+			{
+				return nullptr;
+			}
+			const size_t group = i / BYTE_GROUP_SIZE;
+			const int bitsLog2 = (header[group / 4] >> ((group % 4) * 2)) & 3;
+			data = decode_group(data, values + i, bitsLog2);
+		}
+		return data;
+	}
+
+	void encode_varint(uint8_t*& data, uint32_t v)
+	{
+		do
+		{
+			*data++ = static_cast<uint8_t>((v & 127) | (v > 127 ? 128 : 0));
+			v >>= 7;
+		} while (v != 0);
+	}
+
+	uint32_t decode_varint(const uint8_t*& data)
+	{
+		const uint8_t lead = *data++;
+		if (lead < 128)
+		{
+			return lead;
+		}
+
+		uint32_t result = lead & 127;
+		uint32_t shift = 7;
+		for (int i = 0; i < 4; i++)
+		{
+			const uint8_t group = *data++;
+			result |= uint32_t(group & 127) << shift;
+			shift += 7;
+			if (group < 128)
+			{
+				break;
+			}
+		}
+		return result;
+	}
+}
+
+namespace meshcodec {
+	void encode_vertices(const void* vertices, size_t vertexCount, size_t vertexSize, std::vector<uint8_t>& encoded)
+	{
+		assert(vertexSize > 0 && vertexSize <= 256 && vertexSize % 4 == 0);
+		const uint8_t* source = static_cast<const uint8_t*>(vertices);
+		const size_t blockSize = vertex_block_size(vertexSize);
+		const size_t blockCount = (vertexCount + blockSize - 1) / blockSize;
+		const size_t blockHeaderSize = (blockSize / BYTE_GROUP_SIZE + 3) / 4;
+
+		// worst case: every group stored as whole bytes
+		encoded.resize(1 + blockCount * vertexSize * (blockHeaderSize + blockSize) + tail_size(vertexSize));
+		uint8_t* data = encoded.data();
+		*data++ = VERTEX_HEADER;
+
+		uint8_t firstVertex[256] = {};
+		if (vertexCount > 0)
+		{
+			memcpy(firstVertex, source, vertexSize);
+		}
+		uint8_t lastVertex[256];
+		memcpy(lastVertex, firstVertex, vertexSize);
+
+		// values past the block's last vertex pad its groups as zeroes
+		uint8_t deltas[VERTEX_BLOCK_MAX_SIZE] = {};
+		for (size_t first = 0; first < vertexCount; first += blockSize)
+		{
+			const size_t count = vertexCount - first < blockSize ? vertexCount - first : blockSize;
+			const uint8_t* block = source + first * vertexSize;
+			for (size_t k = 0; k < vertexSize; k++)
+			{
+				uint8_t previous = lastVertex[k];
+				for (size_t i = 0; i < count; i++)
+				{
+					const uint8_t value = block[i * vertexSize + k];
+					deltas[i] = zigzag8(static_cast<uint8_t>(value - previous));
+					previous = value;
+				}
+				data = encode_bytes(data, deltas, (count + BYTE_GROUP_SIZE - 1) & ~(BYTE_GROUP_SIZE - 1));
+			}
+			memcpy(lastVertex, block + (count - 1) * vertexSize, vertexSize);
+		}
+
+		const size_t padding = tail_size(vertexSize) - vertexSize;
+		memset(data, 0, padding);
+		data += padding;
+		memcpy(data, firstVertex, vertexSize);
+		data += vertexSize;
+
+		encoded.resize(data - encoded.data());
+	}
+
+	bool decode_vertices(void* destination, size_t vertexCount, size_t vertexSize, const uint8_t* encoded, size_t encodedSize)
+	{
+		if (vertexSize == 0 || vertexSize > 256 || vertexSize % 4 != 0 || encodedSize < 1 + tail_size(vertexSize))
+		{
+			return false;
+		}
+		if ((encoded[0] & 0xf0) != VERTEX_HEADER || (encoded[0] & 0x0f) > 0)
+		{
+			return false;
+		}
+
+		const uint8_t* data = encoded + 1;
+		const uint8_t* end = encoded + encodedSize;
+		uint8_t* target = static_cast<uint8_t*>(destination);
+		uint8_t lastVertex[256];
+		memcpy(lastVertex, end - vertexSize, vertexSize);
+
+		const size_t blockSize = vertex_block_size(vertexSize);
+		uint8_t deltas[VERTEX_BLOCK_MAX_SIZE];
+		for (size_t first = 0; first < vertexCount; first += blockSize)
+		{
+			const size_t count = vertexCount - first < blockSize ? vertexCount - first : blockSize;
+			uint8_t* block = target + first * vertexSize;
+			for (size_t k = 0; k < vertexSize; k++)
+			{
+				data = decode_bytes(data, end, deltas, (count + BYTE_GROUP_SIZE - 1) & ~(BYTE_GROUP_SIZE - 1));
+				if (data == nullptr)
+				{
+					return false;
+				}
+
+				// written straight into place, one byte lane of the vertices at a time
+				uint8_t previous = lastVertex[k];
+				for (size_t i = 0; i < count; i++)
+				{
+					previous = static_cast<uint8_t>(previous + unzigzag8(deltas[i]));
+					block[i * vertexSize + k] = previous;
+				}
+			}
+			memcpy(lastVertex, block + (count - 1) * vertexSize, vertexSize);
+		}
+
+		return size_t(end - data) == tail_size(vertexSize);
+	}
+
+	void encode_indices(const uint32_t* indices, size_t count, std::vector<uint8_t>& encoded)
+	{
+		// at most 5 bytes an index, then the 4-byte tail the decoder reads ahead into
+		encoded.resize(1 + count * 5 + 4);
+		uint8_t* data = encoded.data();
+		*data++ = INDEX_SEQUENCE_HEADER | INDEX_SEQUENCE_VERSION;
+
+		uint32_t last[2] = {};
+		uint32_t current = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			const uint32_t index = indices[i];
+
+			// a jump too far for one byte switches to the other baseline, which often still sits nearby
+			const int32_t jump = static_cast<int32_t>(index - last[current]);
+			current ^= (jump < 0 ? -jump : jump) >= 30;
+
+			const uint32_t delta = index - last[current];
+			const uint32_t zigzag = (delta << 1) ^ static_cast<uint32_t>(static_cast<int32_t>(delta) >> 31);
+			// the low bit names the baseline the decoder adds the delta to
+			encode_varint(data, (zigzag << 1) | current);
+			last[current] = index;
+		}
+
+		memset(data, 0, 4);
+		data += 4;
+		encoded.resize(data - encoded.data());
+	}
+
+	bool decode_indices(uint32_t* destination, size_t count, const uint8_t* encoded, size_t encodedSize)
+	{
+		if (encodedSize < 1 + count + 4)
+		{
+			return false;
+		}
+		if ((encoded[0] & 0xf0) != INDEX_SEQUENCE_HEADER || (encoded[0] & 0x0f) > INDEX_SEQUENCE_VERSION)
+		{
+			return false;
+		}
+
+		const uint8_t* data = encoded + 1;
+		// a varint takes at most 5 bytes, so one starting before the tail never reads past the end
+		const uint8_t* safeEnd = encoded + encodedSize - 4;
+		uint32_t last[2] = {};
+		for (size_t i = 0; i < count; i++)
+		{
+			if (data >= safeEnd)
+			{
+				return false;
+			}
+
+			uint32_t v = decode_varint(data);
+			const uint32_t current = v & 1;
+			v >>= 1;
+			const uint32_t delta = (v >> 1) ^ (0u - (v & 1));
+			const uint32_t index = last[current] + delta;
+			last[current] = index;
+			destination[i] = index;
+		}
+
+		return data == safeEnd;
+	}
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Compression of vertex and index streams for the mesh cache, in meshoptimizer's formats, so the streams
+// can be checked or produced with its tools. Both are byte-aligned and decode with a handful of operations per
+// byte, fast enough that reading a compressed cache costs less than reading the raw bytes it replaces.
+// Vertices (meshopt vertex codec, version 0): blocks of up to 256 vertices; each byte of the vertex goes
+// through the block as the zigzagged difference to the same byte of the vertex before, in groups of 16
+// stored with 0, 2, 4 or 8 bits a value, and values that don't fit follow their group as whole bytes. Smooth
+// attributes leave mostly small differences, so most groups need 2 or 4 bits.
+// Indices (meshopt index sequence codec, version 1): each index as the zigzagged difference to one of the
+// two indices that came before it in a 7-bit varint, switching baseline when the difference grows large,
+// which keeps cache-ordered triangle lists at 1-2 bytes an index.
+namespace meshcodec {
+	// replaces encoded with the stream for vertexCount vertices of vertexSize bytes; vertexSize must be a
+	// multiple of 4 and at most 256
+	void encode_vertices(const void* vertices, size_t vertexCount, size_t vertexSize, std::vector<uint8_t>& encoded);
+	// false, with destination partly written, unless encoded holds exactly vertexCount vertices of vertexSize
+	bool decode_vertices(void* destination, size_t vertexCount, size_t vertexSize, const uint8_t* encoded, size_t encodedSize);
+
+	void encode_indices(const uint32_t* indices, size_t count, std::vector<uint8_t>& encoded);
+	// false, with destination partly written, unless encoded holds exactly count indices
+	bool decode_indices(uint32_t* destination, size_t count, const uint8_t* encoded, size_t encodedSize);
+}
@@ -0,0 +1,480 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <unordered_set>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+namespace {
+	// scoring constants from Tom Forsyth, "Linear-Speed Vertex Cache Optimisation"
+	constexpr uint32_t FORSYTH_CACHE_SIZE = 32;
+	constexpr float CACHE_DECAY_POWER = 1.5f;
+	constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+	constexpr float VALENCE_BOOST_SCALE = 2.0f;
+	constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+	constexpr uint32_t INVALID = UINT32_MAX;
+
+	float vertex_score(int cachePosition, uint32_t remainingTriangles)
+	{
+		// nothing left to draw with this vertex
+		if (remainingTriangles == 0)
+		{
+			return -1.f;
+		}
+
+		float score = 0.f;
+		if (cachePosition >= 0)
+		{
+			// the last triangle's vertices get a fixed score so the next triangle doesn't just reuse its edge
+			if (cachePosition < 3)
+			{
+				score = LAST_TRIANGLE_SCORE;
+			}
+			else
+			{
+				const float scaler = 1.f / (FORSYTH_CACHE_SIZE - 3);
+				score = std::pow(1.f - (cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+			}
+		}
+
+		// favour vertices with few triangles left, so they're finished before falling out of the cache
+		score += VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remainingTriangles), -VALENCE_BOOST_POWER);
+		return score;
+	}
+
+	// triangle with its smallest index first; the rotation keeps the winding
+	struct TriangleKey {
+		uint32_t a, b, c;
+
+		bool operator==(const TriangleKey& other) const
+		{
+			return a == other.a && b == other.b && c == other.c;
+		}
+	};
+
+	TriangleKey make_triangle_key(uint32_t a, uint32_t b, uint32_t c)
+	{
+		if (b < a && b < c)
+		{
+			return { b, c, a };
+		}
+		if (c < a && c < b)
+		{
+			return { c, a, b };
+		}
+		return { a, b, c };
+	}
+
+	struct TriangleKeyHash {
+		size_t operator()(const TriangleKey& key) const
+		{
+			size_t h = std::hash<uint32_t>()(key.a);
+			h ^= std::hash<uint32_t>()(key.b) + 0x9e3779b9 + (h << 6) + (h >> 2);
+			h ^= std::hash<uint32_t>()(key.c) + 0x9e3779b9 + (h << 6) + (h >> 2);
+			return h;
+		}
+	};
+
+	// a FIFO miss counter that can be reset, shared by ACMR and the overdraw cluster split
+	struct FifoCache {
+		std::vector<uint32_t> timestamps;
+		uint32_t time;
+		uint32_t size;
+
+		FifoCache(size_t vertexCount, uint32_t cacheSize)
+			: timestamps(vertexCount, 0), time(cacheSize + 1), size(cacheSize) {}
+
+		// true if v had to be transformed
+		bool access(uint32_t v)
+		{
+			if (time - timestamps[v] > size)
+			{
+				timestamps[v] = time++;
+				return true;
+			}
+			return false;
+		}
+	};
+}
+
+float meshopt::compute_acmr(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+{
+	if (indexCount < 3)
+	{
+		return 0.f;
+	}
+
+	FifoCache cache(vertexCount, cacheSize);
+	size_t misses = 0;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		misses += cache.access(indices[i]) ? 1 : 0;
+	}
+
+	return static_cast<float>(misses) / static_cast<float>(indexCount / 3);
+}
+
+void meshopt::optimize_vertex_cache(uint32_t* dst, const uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+	const size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// per-vertex lists of the triangles that still need drawing; the live part of each list
+	// is [adjacencyOffsets[v], adjacencyOffsets[v] + remaining[v])
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		remaining[indices[i]]++;
+	}
+
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remaining[v];
+	}
+
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	{
+		std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < triangleCount * 3; i++)
+		{
+			adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+	}
+
+	std::vector<int> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		vertexScores[v] = vertex_score(-1, remaining[v]);
+	}
+
+	std::vector<float> triangleScores(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+
+	uint32_t bestTriangle = 0;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const uint32_t* tri = &indices[t * 3];
+		triangleScores[t] = vertexScores[tri[0]] + vertexScores[tri[1]] + vertexScores[tri[2]];
+		if (triangleScores[t] > triangleScores[bestTriangle])
+		{
+			bestTriangle = static_cast<uint32_t>(t);
+		}
+	}
+
+	// the cache briefly grows to FORSYTH_CACHE_SIZE + 3 while a triangle is inserted
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> newCache;
+	cache.reserve(FORSYTH_CACHE_SIZE + 3);
+	newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+	size_t scanCursor = 0;
+	size_t written = 0;
+
+	while (bestTriangle != INVALID)
+	{
+		emitted[bestTriangle] = true;
+		const uint32_t* tri = &indices[bestTriangle * 3];
+
+		newCache.clear();
+		for (int k = 0; k < 3; k++)
+		{
+			uint32_t v = tri[k];
+			dst[written++] = v;
+
+			// unlink the triangle from the vertex's live list
+			uint32_t* list = &adjacency[adjacencyOffsets[v]];
+			for (uint32_t i = 0; i < remaining[v]; i++)
+			{
+				if (list[i] == bestTriangle)
+				{
+					list[i] = list[remaining[v] - 1];
+					remaining[v]--;
+					break;
+				}
+			}
+
+			// degenerate triangles repeat a vertex; it only takes one cache slot
+			if (std::find(newCache.begin(), newCache.end(), v) == newCache.end())
+			{
+				newCache.push_back(v);
+			}
+		}
+
+		for (uint32_t v : cache)
+		{
+			if (std::find(newCache.begin(), newCache.end(), v) == newCache.end())
+			{
+				newCache.push_back(v);
+			}
+		}
+
+		// rescore everything that moved, including the vertices that just fell out
+		for (size_t i = 0; i < newCache.size(); i++)
+		{
+			uint32_t v = newCache[i];
+			cachePositions[v] = i < FORSYTH_CACHE_SIZE ? static_cast<int>(i) : -1;
+			vertexScores[v] = vertex_score(cachePositions[v], remaining[v]);
+		}
+
+		// only triangles touching the cache changed score, so the next pick comes from them
+		bestTriangle = INVALID;
+		float bestScore = -1.f;
+		for (uint32_t v : newCache)
+		{
+			const uint32_t* list = &adjacency[adjacencyOffsets[v]];
+			for (uint32_t i = 0; i < remaining[v]; i++)
+			{
+				uint32_t t = list[i];
+				const uint32_t* other = &indices[t * 3];
+				triangleScores[t] = vertexScores[other[0]] + vertexScores[other[1]] + vertexScores[other[2]];
+				if (triangleScores[t] > bestScore)
+				{
+					bestScore = triangleScores[t];
+					bestTriangle = t;
+				}
+			}
+		}
+
+		newCache.resize(std::min<size_t>(newCache.size(), FORSYTH_CACHE_SIZE));
+		cache.swap(newCache);
+
+		// the cache ran dry (a disconnected piece is finished); continue with the next unemitted triangle
+		if (bestTriangle == INVALID)
+		{
+			while (scanCursor < triangleCount && emitted[scanCursor])
+			{
+				scanCursor++;
+			}
+			if (scanCursor < triangleCount)
+			{
+				bestTriangle = static_cast<uint32_t>(scanCursor);
+			}
+		}
+	}
+}
+
+void meshopt::optimize_overdraw(uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, float threshold)
+{
+	const size_t triangleCount = indexCount / 3;
+	if (triangleCount < 2)
+	{
+		return;
+	}
+
+	const float inputAcmr = compute_acmr(indices, indexCount, vertexCount);
+
+	// a cluster ends wherever the cache order starts over: a triangle whose three vertices all miss
+	// (Sander, Nehab and Barczak's hard boundaries). Sorting at those points costs little locality
+	std::vector<uint32_t> clusterStarts;
+	{
+		FifoCache cache(vertexCount, 32);
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			int misses = 0;
+			for (int k = 0; k < 3; k++)
+			{
+				misses += cache.access(indices[t * 3 + k]) ? 1 : 0;
+			}
+			if (t == 0 || misses == 3)
+			{
+				clusterStarts.push_back(static_cast<uint32_t>(t));
+			}
+		}
+	}
+	if (clusterStarts.size() < 2)
+	{
+		return;
+	}
+
+	glm::vec3 meshCentroid{ 0.f };
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		meshCentroid += vertices[indices[i]].position;
+	}
+	meshCentroid /= static_cast<float>(indexCount);
+
+	struct Cluster {
+		uint32_t firstTriangle;
+		uint32_t triangleCount;
+		float sortKey;
+	};
+	std::vector<Cluster> clusters(clusterStarts.size());
+
+	for (size_t c = 0; c < clusterStarts.size(); c++)
+	{
+		Cluster& cluster = clusters[c];
+		cluster.firstTriangle = clusterStarts[c];
+		uint32_t end = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : static_cast<uint32_t>(triangleCount);
+		cluster.triangleCount = end - cluster.firstTriangle;
+
+		// area-weighted centroid and normal of the cluster
+		glm::vec3 centroid{ 0.f };
+		glm::vec3 normal{ 0.f };
+		float area = 0.f;
+		for (uint32_t t = cluster.firstTriangle; t < end; t++)
+		{
+			const glm::vec3& a = vertices[indices[t * 3 + 0]].position;
+			const glm::vec3& b = vertices[indices[t * 3 + 1]].position;
+			const glm::vec3& c2 = vertices[indices[t * 3 + 2]].position;
+			glm::vec3 n = glm::cross(b - a, c2 - a);
+			float triangleArea = glm::length(n);
+
+			centroid += (a + b + c2) * (triangleArea / 3.f);
+			normal += n;
+			area += triangleArea;
+		}
+
+		if (area > 0.f)
+		{
+			centroid /= area;
+		}
+		float normalLength = glm::length(normal);
+		if (normalLength > 0.f)
+		{
+			normal /= normalLength;
+		}
+
+		// how far the cluster faces away from the middle of the mesh
+		cluster.sortKey = glm::dot(centroid - meshCentroid, normal);
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) {
+		return a.sortKey > b.sortKey;
+	});
+
+	std::vector<uint32_t> sorted;
+	sorted.reserve(triangleCount * 3);
+	for (const Cluster& cluster : clusters)
+	{
+		const uint32_t* first = indices + cluster.firstTriangle * 3;
+		sorted.insert(sorted.end(), first, first + cluster.triangleCount * 3);
+	}
+
+	if (compute_acmr(sorted.data(), sorted.size(), vertexCount) <= inputAcmr * threshold)
+	{
+		std::copy(sorted.begin(), sorted.end(), indices);
+	}
+}
+
+size_t meshopt::optimize_vertex_fetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<glm::vec2>* texcoords)
+{
+	std::vector<uint32_t> remap(vertices.size(), INVALID);
+	std::vector<Vertex> reordered;
+	reordered.reserve(vertices.size());
+	std::vector<glm::vec2> reorderedTexcoords;
+	if (texcoords)
+	{
+		reorderedTexcoords.reserve(vertices.size());
+	}
+
+	for (uint32_t& index : indices)
+	{
+		if (remap[index] == INVALID)
+		{
+			remap[index] = static_cast<uint32_t>(reordered.size());
+			reordered.push_back(vertices[index]);
+			if (texcoords)
+			{
+				reorderedTexcoords.push_back((*texcoords)[index]);
+			}
+		}
+		index = remap[index];
+	}
+
+	vertices.swap(reordered);
+	if (texcoords)
+	{
+		texcoords->swap(reorderedTexcoords);
+	}
+	return vertices.size();
+}
+
+size_t meshopt::simplify_clustered(std::vector<uint32_t>& dst, const uint32_t* indices, size_t indexCount,
+	const Vertex* vertices, size_t vertexCount, glm::vec3 gridOrigin, float cellSize)
+{
+	struct Cell {
+		glm::vec3 positionSum{ 0.f };
+		uint32_t vertexCount{ 0 };
+		uint32_t representative{ INVALID };
+		float representativeDistance2{ 0.f };
+	};
+
+	// 21 bits per axis covers any grid the LOD chain asks for
+	auto cell_key = [&](const glm::vec3& position) {
+		glm::vec3 cell = glm::floor((position - gridOrigin) / cellSize);
+		uint64_t x = static_cast<uint64_t>(std::max(cell.x, 0.f)) & 0x1FFFFF;
+		uint64_t y = static_cast<uint64_t>(std::max(cell.y, 0.f)) & 0x1FFFFF;
+		uint64_t z = static_cast<uint64_t>(std::max(cell.z, 0.f)) & 0x1FFFFF;
+		return x | (y << 21) | (z << 42);
+	};
+
+	// only vertices the triangles use take part, so other surfaces or LODs don't pull representatives
+	std::vector<uint32_t> vertexCells(vertexCount, INVALID);
+	std::unordered_map<uint64_t, uint32_t> cellIds;
+	std::vector<Cell> cells;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		uint32_t v = indices[i];
+		if (vertexCells[v] != INVALID)
+		{
+			continue;
+		}
+
+		auto inserted = cellIds.emplace(cell_key(vertices[v].position), static_cast<uint32_t>(cells.size()));
+		if (inserted.second)
+		{
+			cells.emplace_back();
+		}
+		uint32_t cellId = inserted.first->second;
+		vertexCells[v] = cellId;
+		cells[cellId].positionSum += vertices[v].position;
+		cells[cellId].vertexCount++;
+	}
+
+	// the vertex nearest the cell average stands in for the whole cell
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		if (vertexCells[v] == INVALID)
+		{
+			continue;
+		}
+		Cell& cell = cells[vertexCells[v]];
+		glm::vec3 d = vertices[v].position - cell.positionSum / static_cast<float>(cell.vertexCount);
+		float distance2 = glm::dot(d, d);
+		if (cell.representative == INVALID || distance2 < cell.representativeDistance2)
+		{
+			cell.representative = static_cast<uint32_t>(v);
+			cell.representativeDistance2 = distance2;
+		}
+	}
+
+	const size_t start = dst.size();
+	std::unordered_set<TriangleKey, TriangleKeyHash> emitted;
+	for (size_t t = 0; t + 2 < indexCount; t += 3)
+	{
+		uint32_t a = cells[vertexCells[indices[t + 0]]].representative;
+		uint32_t b = cells[vertexCells[indices[t + 1]]].representative;
+		uint32_t c = cells[vertexCells[indices[t + 2]]].representative;
+		if (a == b || b == c || a == c)
+		{
+			continue;
+		}
+		if (!emitted.insert(make_triangle_key(a, b, c)).second)
+		{
+			continue;
+		}
+		dst.push_back(a);
+		dst.push_back(b);
+		dst.push_back(c);
+	}
+
+	return dst.size() - start;
+}
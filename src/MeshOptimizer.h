@@ -0,0 +1,34 @@
+#pragma once
+
+#include "Mesh.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Import-time index and vertex reordering. Everything here works on plain triangle lists and
+// keeps the set of triangles intact, so callers can run it per surface.
+namespace meshopt {
+	// average cache misses per triangle for a FIFO post-transform cache of cacheSize entries
+	// 3.0 is the worst case, ~0.5-0.7 is typical for well-ordered closed meshes
+	float compute_acmr(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = 32);
+
+	// Forsyth's linear-speed vertex cache optimization; dst and indices must not overlap
+	void optimize_vertex_cache(uint32_t* dst, const uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+	// splits cache-ordered triangles into clusters and draws outward-facing clusters first,
+	// so they occlude the rest from more viewpoints. Keeps the input order when the result's ACMR
+	// exceeds threshold times the input's
+	void optimize_overdraw(uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, float threshold = 1.05f);
+
+	// renumbers vertices in order of first use and drops unreferenced ones; returns the new vertex count
+	// texcoords, if given, is a stream parallel to vertices and renumbered with them
+	size_t optimize_vertex_fetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<glm::vec2>* texcoords = nullptr);
+
+	// vertex clustering (Rossignac and Borrel): snaps vertices to a grid of cellSize starting at gridOrigin,
+	// keeping the vertex closest to each cell's average as its representative, and drops triangles that
+	// collapse or duplicate another. Representatives are existing vertices, so the result indexes the
+	// same vertex array. Appends to dst and returns the number of indices written
+	size_t simplify_clustered(std::vector<uint32_t>& dst, const uint32_t* indices, size_t indexCount,
+		const Vertex* vertices, size_t vertexCount, glm::vec3 gridOrigin, float cellSize);
+}
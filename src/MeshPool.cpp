@@ -0,0 +1,309 @@
+#include "MeshPool.h"
+
+#include "Log.h"
+
+#include <algorithm>
+#include <cassert>
+
+void RangeAllocator::init(uint32_t capacity)
+{
+	_capacity = capacity;
+	_used = 0;
+	_freeRanges.clear();
+	if (capacity > 0)
+	{
+		_freeRanges.push_back({ 0, capacity });
+	}
+}
+
+bool RangeAllocator::allocate(uint32_t count, uint32_t& offset)
+{
+	if (count == 0)
+	{
+		offset = 0;
+		return true;
+	}
+
+	for (size_t i = 0; i < _freeRanges.size(); i++)
+	{
+		Range& range = _freeRanges[i];
+		if (range.count < count)
+		{
+			continue;
+		}
+
+		offset = range.offset;
+		range.offset += count;
+		range.count -= count;
+		if (range.count == 0)
+		{
+			_freeRanges.erase(_freeRanges.begin() + i);
+		}
+		_used += count;
+		return true;
+	}
+	return false;
+}
+
+bool RangeAllocator::allocate_below(uint32_t count, uint32_t limit, uint32_t& offset)
+{
+	if (count == 0)
+	{
+		offset = 0;
+		return true;
+	}
+
+	// ranges are sorted, so the first that fits is also the lowest
+	for (size_t i = 0; i < _freeRanges.size() && _freeRanges[i].offset + count <= limit; i++)
+	{
+		Range& range = _freeRanges[i];
+		if (range.count < count)
+		{
+			continue;
+		}
+
+		offset = range.offset;
+		range.offset += count;
+		range.count -= count;
+		if (range.count == 0)
+		{
+			_freeRanges.erase(_freeRanges.begin() + i);
+		}
+		_used += count;
+		return true;
+	}
+	return false;
+}
+
+uint32_t RangeAllocator::largest_free() const
+{
+	uint32_t largest = 0;
+	for (const Range& range : _freeRanges)
+	{
+		largest = std::max(largest, range.count);
+	}
+	return largest;
+}
+
+float RangeAllocator::fragmentation() const
+{
+	uint32_t freeCount = _capacity - _used;
+	if (freeCount == 0)
+	{
+		return 0.f;
+	}
+	return 1.f - static_cast<float>(largest_free()) / static_cast<float>(freeCount);
+}
+
+void RangeAllocator::free(uint32_t offset, uint32_t count)
+{
+	if (count == 0)
+	{
+		return;
+	}
+	_used -= count;
+
+	// first free range starting after the one being returned
+	size_t next = 0;
+	while (next < _freeRanges.size() && _freeRanges[next].offset < offset)
+	{
+		next++;
+	}
+
+	bool mergesPrev = next > 0 && _freeRanges[next - 1].offset + _freeRanges[next - 1].count == offset;
+	bool mergesNext = next < _freeRanges.size() && offset + count == _freeRanges[next].offset;
+
+	if (mergesPrev && mergesNext)
+	{
+		_freeRanges[next - 1].count += count + _freeRanges[next].count;
+		_freeRanges.erase(_freeRanges.begin() + next);
+	}
+	else if (mergesPrev)
+	{
+		_freeRanges[next - 1].count += count;
+	}
+	else if (mergesNext)
+	{
+		_freeRanges[next].offset = offset;
+		_freeRanges[next].count += count;
+	}
+	else
+	{
+		_freeRanges.insert(_freeRanges.begin() + next, { offset, count });
+	}
+}
+
+namespace {
+	AllocatedBuffer create_pool_buffer(VmaAllocator allocator, VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, VmaPool pool)
+	{
+		VkBufferCreateInfo bufferInfo = {};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.pNext = nullptr;
+		bufferInfo.size = size;
+		// transfer dst for staged uploads, transfer src so the pool can be compacted or read back later
+		bufferInfo.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+		VmaAllocationCreateInfo vmaallocInfo = {};
+		vmaallocInfo.usage = memoryUsage;
+		vmaallocInfo.pool = pool;
+		// a host-visible pool is written in place by every upload, so it's mapped once up front
+		const bool hostVisible = memoryUsage != VMA_MEMORY_USAGE_GPU_ONLY;
+		vmaallocInfo.flags = hostVisible ? VMA_ALLOCATION_CREATE_MAPPED_BIT : 0;
+
+		AllocatedBuffer buffer{};
+		VmaAllocationInfo allocationInfo = {};
+		VK_CHECK(vmaCreateBuffer(allocator, &bufferInfo, &vmaallocInfo, &buffer._buffer, &buffer._allocation, &allocationInfo));
+		buffer._mapped = hostVisible ? allocationInfo.pMappedData : nullptr;
+		return buffer;
+	}
+}
+
+void MeshPool::init(VmaAllocator allocator, VmaMemoryUsage memoryUsage, const std::vector<std::vector<uint32_t>>& streamStrides,
+	uint32_t vertexCapacity, uint32_t index16Capacity, uint32_t index32Capacity, VmaPool pool, VkBufferUsageFlags extraUsage)
+{
+	_allocator = allocator;
+
+	_vertexStreams.resize(streamStrides.size());
+	for (size_t i = 0; i < streamStrides.size(); i++)
+	{
+		VertexStream& stream = _vertexStreams[i];
+		assert(!streamStrides[i].empty() && streamStrides[i].size() <= MAX_STREAM_BINDINGS);
+		stream.bindingCount = static_cast<uint32_t>(streamStrides[i].size());
+		for (uint32_t binding = 0; binding < stream.bindingCount; binding++)
+		{
+			stream.strides[binding] = streamStrides[i][binding];
+			// storage too, for the mesh shader path which fetches vertices itself
+			stream.buffers[binding] = create_pool_buffer(allocator, VkDeviceSize(vertexCapacity) * stream.strides[binding],
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | extraUsage, memoryUsage, pool);
+		}
+		stream.ranges.init(vertexCapacity);
+	}
+	_index16Buffer = create_pool_buffer(allocator, VkDeviceSize(index16Capacity) * sizeof(uint16_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | extraUsage,
+		memoryUsage, pool);
+	// 32-bit indices may also be written by the block unpack shader
+	_index32Buffer = create_pool_buffer(allocator, VkDeviceSize(index32Capacity) * sizeof(uint32_t),
+		VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | extraUsage, memoryUsage, pool);
+
+	_index16Ranges.init(index16Capacity);
+	_index32Ranges.init(index32Capacity);
+}
+
+void MeshPool::cleanup()
+{
+	for (VertexStream& stream : _vertexStreams)
+	{
+		for (uint32_t binding = 0; binding < stream.bindingCount; binding++)
+		{
+			vmaDestroyBuffer(_allocator, stream.buffers[binding]._buffer, stream.buffers[binding]._allocation);
+		}
+	}
+	vmaDestroyBuffer(_allocator, _index16Buffer._buffer, _index16Buffer._allocation);
+	vmaDestroyBuffer(_allocator, _index32Buffer._buffer, _index32Buffer._allocation);
+}
+
+bool MeshPool::allocate(uint32_t vertexStream, uint32_t vertexCount, uint32_t indexCount, VkIndexType indexType, MeshAllocation& allocation)
+{
+	RangeAllocator& vertexRanges = _vertexStreams[vertexStream].ranges;
+	RangeAllocator& indexRanges = indexType == VK_INDEX_TYPE_UINT16 ? _index16Ranges : _index32Ranges;
+
+	uint32_t vertexOffset;
+	if (!vertexRanges.allocate(vertexCount, vertexOffset))
+	{
+		LOG_WARN("Mesh pool out of vertex space (" << vertexRanges.used() << "/" << vertexRanges.capacity()
+			<< " used, " << vertexCount << " requested)");
+		return false;
+	}
+
+	uint32_t firstIndex;
+	if (!indexRanges.allocate(indexCount, firstIndex))
+	{
+		LOG_WARN("Mesh pool out of index space (" << indexRanges.used() << "/" << indexRanges.capacity()
+			<< " used, " << indexCount << " requested)");
+		vertexRanges.free(vertexOffset, vertexCount);
+		return false;
+	}
+
+	allocation.vertexStream = vertexStream;
+	allocation.vertexOffset = vertexOffset;
+	allocation.vertexCount = vertexCount;
+	allocation.firstIndex = firstIndex;
+	allocation.indexCount = indexCount;
+	allocation.indexType = indexType;
+	return true;
+}
+
+void MeshPool::free(const MeshAllocation& allocation)
+{
+	RangeAllocator& indexRanges = allocation.indexType == VK_INDEX_TYPE_UINT16 ? _index16Ranges : _index32Ranges;
+	_vertexStreams[allocation.vertexStream].ranges.free(allocation.vertexOffset, allocation.vertexCount);
+	indexRanges.free(allocation.firstIndex, allocation.indexCount);
+}
+
+VkDeviceSize MeshPool::vertex_byte_offset(const MeshAllocation& allocation, uint32_t binding) const
+{
+	return VkDeviceSize(allocation.vertexOffset) * _vertexStreams[allocation.vertexStream].strides[binding];
+}
+
+VkDeviceSize MeshPool::index_byte_offset(const MeshAllocation& allocation) const
+{
+	VkDeviceSize indexSize = allocation.indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+	return VkDeviceSize(allocation.firstIndex) * indexSize;
+}
+
+const AllocatedBuffer& MeshPool::index_buffer(VkIndexType indexType) const
+{
+	return indexType == VK_INDEX_TYPE_UINT16 ? _index16Buffer : _index32Buffer;
+}
+
+uint32_t MeshPool::relocate(MeshAllocation& allocation, MeshAllocation& retired, MeshPoolCopy copies[MAX_RELOCATION_COPIES])
+{
+	retired = allocation;
+	retired.vertexCount = 0;
+	retired.indexCount = 0;
+	uint32_t copyCount = 0;
+
+	VertexStream& stream = _vertexStreams[allocation.vertexStream];
+	uint32_t vertexOffset;
+	if (allocation.vertexCount > 0 && stream.ranges.allocate_below(allocation.vertexCount, allocation.vertexOffset, vertexOffset))
+	{
+		// every binding moves to the same new offset
+		for (uint32_t binding = 0; binding < stream.bindingCount; binding++)
+		{
+			MeshPoolCopy& copy = copies[copyCount++];
+			copy.buffer = stream.buffers[binding]._buffer;
+			copy.region.srcOffset = VkDeviceSize(allocation.vertexOffset) * stream.strides[binding];
+			copy.region.dstOffset = VkDeviceSize(vertexOffset) * stream.strides[binding];
+			copy.region.size = VkDeviceSize(allocation.vertexCount) * stream.strides[binding];
+		}
+
+		retired.vertexCount = allocation.vertexCount;
+		allocation.vertexOffset = vertexOffset;
+	}
+
+	RangeAllocator& indexRanges = allocation.indexType == VK_INDEX_TYPE_UINT16 ? _index16Ranges : _index32Ranges;
+	VkDeviceSize indexSize = allocation.indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+	uint32_t firstIndex;
+	if (allocation.indexCount > 0 && indexRanges.allocate_below(allocation.indexCount, allocation.firstIndex, firstIndex))
+	{
+		MeshPoolCopy& copy = copies[copyCount++];
+		copy.buffer = index_buffer(allocation.indexType)._buffer;
+		copy.region.srcOffset = VkDeviceSize(allocation.firstIndex) * indexSize;
+		copy.region.dstOffset = VkDeviceSize(firstIndex) * indexSize;
+		copy.region.size = VkDeviceSize(allocation.indexCount) * indexSize;
+
+		retired.indexCount = allocation.indexCount;
+		allocation.firstIndex = firstIndex;
+	}
+
+	return copyCount;
+}
+
+float MeshPool::fragmentation() const
+{
+	float worst = std::max(_index16Ranges.fragmentation(), _index32Ranges.fragmentation());
+	for (const VertexStream& stream : _vertexStreams)
+	{
+		worst = std::max(worst, stream.ranges.fragmentation());
+	}
+	return worst;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vk_types.h>
+#include <vector>
+
+// first-fit allocator over [0, capacity) with coalescing on free; units are whatever the caller counts in
+class RangeAllocator
+{
+public:
+	void init(uint32_t capacity);
+
+	// returns false when no free range is large enough
+	bool allocate(uint32_t count, uint32_t& offset);
+	// like allocate, but only succeeds if the whole range ends at or before limit
+	bool allocate_below(uint32_t count, uint32_t limit, uint32_t& offset);
+	void free(uint32_t offset, uint32_t count);
+
+	uint32_t capacity() const { return _capacity; }
+	uint32_t used() const { return _used; }
+	uint32_t largest_free() const;
+	// 0 when all free space is one range, approaching 1 as it splits into many small ones
+	float fragmentation() const;
+
+private:
+	struct Range {
+		uint32_t offset;
+		uint32_t count;
+	};
+
+	// sorted by offset, never adjacent (adjacent ranges are merged)
+	std::vector<Range> _freeRanges;
+	uint32_t _capacity{ 0 };
+	uint32_t _used{ 0 };
+};
+
+// element offsets of one mesh inside the pool, in vertices and indices
+struct MeshAllocation {
+	uint32_t vertexStream{ 0 }; // which vertex layout's buffer the vertices live in
+	uint32_t vertexOffset{ 0 };
+	uint32_t vertexCount{ 0 };
+	uint32_t firstIndex{ 0 };
+	uint32_t indexCount{ 0 };
+	VkIndexType indexType{ VK_INDEX_TYPE_UINT32 };
+};
+
+// one buffer-to-buffer copy a relocation needs; source and destination ranges never overlap
+struct MeshPoolCopy {
+	VkBuffer buffer;
+	VkBufferCopy region;
+};
+
+// One vertex buffer per vertex layout binding and one index buffer per index type, shared by every mesh.
+// Meshes only hold offsets, so a frame binds the pool once and draws everything with firstIndex/vertexOffset.
+// A stream split over several bindings keeps one buffer per binding behind a single range allocator,
+// so a mesh sits at the same vertex offset in all of them
+class MeshPool
+{
+public:
+	// bindings a vertex stream may be split into
+	static constexpr uint32_t MAX_STREAM_BINDINGS = 2;
+	// most copies relocate() can ask for: every binding of the stream plus the indices
+	static constexpr uint32_t MAX_RELOCATION_COPIES = MAX_STREAM_BINDINGS + 1;
+
+	// memoryUsage is GPU_ONLY for transfer uploads, CPU_TO_GPU to write meshes through a mapping instead
+	// streamStrides has one entry per vertex stream, listing the stride of each of its bindings;
+	// each stream holds vertexCapacity vertices. pool, if given, must be of a memory type matching memoryUsage
+	// extraUsage is added to every buffer's usage, e.g. for building acceleration structures from them
+	void init(VmaAllocator allocator, VmaMemoryUsage memoryUsage, const std::vector<std::vector<uint32_t>>& streamStrides,
+		uint32_t vertexCapacity, uint32_t index16Capacity, uint32_t index32Capacity, VmaPool pool = VK_NULL_HANDLE, VkBufferUsageFlags extraUsage = 0);
+	void cleanup();
+
+	// returns false and leaves allocation untouched when the pool is full
+	bool allocate(uint32_t vertexStream, uint32_t vertexCount, uint32_t indexCount, VkIndexType indexType, MeshAllocation& allocation);
+	void free(const MeshAllocation& allocation);
+
+	// compaction: moves allocation's vertices and/or indices into lower free ranges when there are any,
+	// returning the copies to record (0 if nothing moved) and updating allocation in place
+	// retired receives the old ranges (counts are 0 for a part that stayed); free() it once the GPU is
+	// done with both the copies and every draw that used the old location
+	uint32_t relocate(MeshAllocation& allocation, MeshAllocation& retired, MeshPoolCopy copies[MAX_RELOCATION_COPIES]);
+	// worst fragmentation over every vertex stream and index buffer
+	float fragmentation() const;
+
+	// byte offsets of an allocation, for copies and mapped writes
+	VkDeviceSize vertex_byte_offset(const MeshAllocation& allocation, uint32_t binding = 0) const;
+	VkDeviceSize index_byte_offset(const MeshAllocation& allocation) const;
+
+	uint32_t binding_count(uint32_t vertexStream) const { return _vertexStreams[vertexStream].bindingCount; }
+	const AllocatedBuffer& vertex_buffer(uint32_t vertexStream, uint32_t binding = 0) const { return _vertexStreams[vertexStream].buffers[binding]; }
+	const AllocatedBuffer& index_buffer(VkIndexType indexType) const;
+
+private:
+	VmaAllocator _allocator{ nullptr };
+
+	struct VertexStream {
+		uint32_t bindingCount;
+		uint32_t strides[MAX_STREAM_BINDINGS];
+		AllocatedBuffer buffers[MAX_STREAM_BINDINGS];
+		RangeAllocator ranges;
+	};
+	std::vector<VertexStream> _vertexStreams;
+
+	AllocatedBuffer _index16Buffer{};
+	AllocatedBuffer _index32Buffer{};
+
+	RangeAllocator _index16Ranges;
+	RangeAllocator _index32Ranges;
+};
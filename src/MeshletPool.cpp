@@ -0,0 +1,110 @@
+#include "MeshletPool.h"
+
+#include "Log.h"
+#include "Mesh.h"
+
+#include <algorithm>
+
+namespace {
+	AllocatedBuffer create_mapped_buffer(VmaAllocator allocator, VkDeviceSize size, void** mapped)
+	{
+		VkBufferCreateInfo bufferInfo = {};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.pNext = nullptr;
+		bufferInfo.size = size;
+		bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+		// written once per mesh and read by a few task/mesh workgroups per frame, so host-visible is fine
+		VmaAllocationCreateInfo vmaallocInfo = {};
+		vmaallocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+		vmaallocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+		AllocatedBuffer buffer{};
+		VmaAllocationInfo allocationInfo = {};
+		VK_CHECK(vmaCreateBuffer(allocator, &bufferInfo, &vmaallocInfo, &buffer._buffer, &buffer._allocation, &allocationInfo));
+		*mapped = allocationInfo.pMappedData;
+		return buffer;
+	}
+}
+
+void MeshletPool::init(VmaAllocator allocator, uint32_t meshletCapacity, uint32_t dataCapacity)
+{
+	_allocator = allocator;
+
+	void* mapped;
+	_meshletBuffer = create_mapped_buffer(allocator, VkDeviceSize(meshletCapacity) * sizeof(GPUMeshlet), &mapped);
+	_meshlets = static_cast<GPUMeshlet*>(mapped);
+	_dataBuffer = create_mapped_buffer(allocator, VkDeviceSize(dataCapacity) * sizeof(uint32_t), &mapped);
+	_data = static_cast<uint32_t*>(mapped);
+
+	_meshletRanges.init(meshletCapacity);
+	_dataRanges.init(dataCapacity);
+}
+
+void MeshletPool::cleanup()
+{
+	vmaDestroyBuffer(_allocator, _meshletBuffer._buffer, _meshletBuffer._allocation);
+	vmaDestroyBuffer(_allocator, _dataBuffer._buffer, _dataBuffer._allocation);
+	_meshlets = nullptr;
+	_data = nullptr;
+}
+
+bool MeshletPool::add(const Mesh& mesh, MeshletAllocation& allocation)
+{
+	const uint32_t meshletCount = static_cast<uint32_t>(mesh._meshlets.size());
+	const uint32_t dataCount = static_cast<uint32_t>(mesh._meshletData.size());
+	if (meshletCount == 0)
+	{
+		return false;
+	}
+
+	uint32_t firstMeshlet;
+	if (!_meshletRanges.allocate(meshletCount, firstMeshlet))
+	{
+		LOG_WARN("Meshlet pool out of meshlet space (" << _meshletRanges.used() << "/" << _meshletRanges.capacity()
+			<< " used, " << meshletCount << " requested)");
+		return false;
+	}
+
+	uint32_t dataOffset;
+	if (!_dataRanges.allocate(dataCount, dataOffset))
+	{
+		LOG_WARN("Meshlet pool out of data space (" << _dataRanges.used() << "/" << _dataRanges.capacity()
+			<< " used, " << dataCount << " requested)");
+		_meshletRanges.free(firstMeshlet, meshletCount);
+		return false;
+	}
+
+	// the ranges were unused, so no frame in flight reads what's written here
+	for (uint32_t i = 0; i < meshletCount; i++)
+	{
+		const Meshlet& meshlet = mesh._meshlets[i];
+		const MeshCluster& cluster = mesh._clusters[meshlet.cluster];
+
+		GPUMeshlet& gpu = _meshlets[firstMeshlet + i];
+		gpu.sphere = glm::vec4(cluster.bounds.origin, cluster.bounds.radius);
+		gpu.coneApex = glm::vec4(cluster.coneApex, cluster.coneCutoff);
+		gpu.coneAxis = glm::vec4(cluster.coneAxis, 0.f);
+		gpu.vertexOffset = dataOffset + meshlet.vertexOffset;
+		gpu.triangleOffset = dataOffset + meshlet.triangleOffset;
+		gpu.vertexCount = meshlet.vertexCount;
+		gpu.triangleCount = meshlet.triangleCount;
+	}
+	std::copy(mesh._meshletData.begin(), mesh._meshletData.end(), _data + dataOffset);
+
+	// CPU_TO_GPU memory may not be host-coherent
+	vmaFlushAllocation(_allocator, _meshletBuffer._allocation, VkDeviceSize(firstMeshlet) * sizeof(GPUMeshlet), VkDeviceSize(meshletCount) * sizeof(GPUMeshlet));
+	vmaFlushAllocation(_allocator, _dataBuffer._allocation, VkDeviceSize(dataOffset) * sizeof(uint32_t), VkDeviceSize(dataCount) * sizeof(uint32_t));
+
+	allocation.firstMeshlet = firstMeshlet;
+	allocation.meshletCount = meshletCount;
+	allocation.dataOffset = dataOffset;
+	allocation.dataCount = dataCount;
+	return true;
+}
+
+void MeshletPool::free(const MeshletAllocation& allocation)
+{
+	_meshletRanges.free(allocation.firstMeshlet, allocation.meshletCount);
+	_dataRanges.free(allocation.dataOffset, allocation.dataCount);
+}
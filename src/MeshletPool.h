@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vk_types.h>
+#include <MeshPool.h>
+#include <glm/vec4.hpp>
+
+struct Mesh;
+
+// one meshlet as the task and mesh shaders read it; matches Meshlet in meshlet.task/meshlet.mesh
+struct GPUMeshlet {
+	glm::vec4 sphere; // mesh-space bounding sphere of the cluster it was cut from
+	glm::vec4 coneApex; // w: cone cutoff, above 1 when the cone can't reject anything
+	glm::vec4 coneAxis;
+	uint32_t vertexOffset; // into the data buffer, already offset by the mesh's allocation
+	uint32_t triangleOffset;
+	uint32_t vertexCount;
+	uint32_t triangleCount;
+};
+static_assert(sizeof(GPUMeshlet) == 64, "GPUMeshlet must match the std430 layout in the shaders");
+
+// element offsets of one mesh's meshlets and their vertex/triangle tables in the pool
+struct MeshletAllocation {
+	uint32_t firstMeshlet{ 0 };
+	uint32_t meshletCount{ 0 };
+	uint32_t dataOffset{ 0 };
+	uint32_t dataCount{ 0 };
+};
+
+// Meshlet descriptors and tables of every mesh drawn through the mesh shader path, in two persistently
+// mapped storage buffers. Meshes are written straight into their ranges when added; the vertices
+// themselves stay in the MeshPool, which the mesh shader reads as a storage buffer.
+class MeshletPool
+{
+public:
+	void init(VmaAllocator allocator, uint32_t meshletCapacity, uint32_t dataCapacity);
+	void cleanup();
+
+	// copies mesh._meshlets and mesh._meshletData in; returns false and leaves allocation untouched when full
+	bool add(const Mesh& mesh, MeshletAllocation& allocation);
+	// only once no frame in flight draws the mesh any more
+	void free(const MeshletAllocation& allocation);
+
+	const AllocatedBuffer& meshlet_buffer() const { return _meshletBuffer; }
+	const AllocatedBuffer& data_buffer() const { return _dataBuffer; }
+
+private:
+	VmaAllocator _allocator{ nullptr };
+
+	AllocatedBuffer _meshletBuffer{};
+	AllocatedBuffer _dataBuffer{};
+	GPUMeshlet* _meshlets{ nullptr };
+	uint32_t* _data{ nullptr };
+
+	RangeAllocator _meshletRanges;
+	RangeAllocator _dataRanges;
+};
@@ -0,0 +1,373 @@
+#include "Metrics.h"
+
+#include "CpuProfiler.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace {
+#ifdef _WIN32
+	using Socket = SOCKET;
+	const Socket NO_SOCKET = INVALID_SOCKET;
+	void close_socket(Socket socket) { closesocket(socket); }
+	int poll_sockets(WSAPOLLFD* fds, ULONG count, int timeoutMs) { return WSAPoll(fds, count, timeoutMs); }
+	using PollFd = WSAPOLLFD;
+#else
+	using Socket = int;
+	const Socket NO_SOCKET = -1;
+	void close_socket(Socket socket) { close(socket); }
+	int poll_sockets(pollfd* fds, nfds_t count, int timeoutMs) { return poll(fds, count, timeoutMs); }
+	using PollFd = pollfd;
+#endif
+
+	// how often the server looks at _stopping while no one scrapes
+	constexpr int ACCEPT_POLL_MS = 200;
+	// a scraper that sends nothing for this long is dropped
+	constexpr int REQUEST_TIMEOUT_MS = 2000;
+	// request lines and headers past this are ignored
+	constexpr size_t MAX_REQUEST = 4096;
+
+	const char* const ASSET_KIND_NAMES[] = { "mesh", "texture", "impostor" };
+
+	void append_double(std::string& out, double value)
+	{
+		char text[32];
+		std::snprintf(text, sizeof(text), "%.10g", value);
+		out += text;
+	}
+
+	void append_metric(std::string& out, const char* name, const char* type, const char* help)
+	{
+		out += "# HELP ";
+		out += name;
+		out += ' ';
+		out += help;
+		out += "\n# TYPE ";
+		out += name;
+		out += ' ';
+		out += type;
+		out += '\n';
+	}
+
+	void append_sample(std::string& out, const char* name, double value)
+	{
+		out += name;
+		out += ' ';
+		append_double(out, value);
+		out += '\n';
+	}
+
+	// label's value is one of ours, so it needs no escaping
+	void append_labeled_sample(std::string& out, const char* name, const char* label, const char* value, double sample)
+	{
+		out += name;
+		out += '{';
+		out += label;
+		out += "=\"";
+		out += value;
+		out += "\"} ";
+		append_double(out, sample);
+		out += '\n';
+	}
+
+	void append_gauge(std::string& out, const char* name, const char* help, double value)
+	{
+		append_metric(out, name, "gauge", help);
+		append_sample(out, name, value);
+	}
+
+	void append_counter(std::string& out, const char* name, const char* help, double value)
+	{
+		append_metric(out, name, "counter", help);
+		append_sample(out, name, value);
+	}
+
+	// the whole of data, false once the peer is gone
+	bool send_all(Socket socket, const char* data, size_t size)
+	{
+		while (size > 0)
+		{
+#ifdef _WIN32
+			const int sent = send(socket, data, static_cast<int>(std::min<size_t>(size, 1 << 20)), 0);
+#else
+			const ssize_t sent = send(socket, data, size, MSG_NOSIGNAL);
+#endif
+			if (sent <= 0)
+			{
+				return false;
+			}
+			data += sent;
+			size -= static_cast<size_t>(sent);
+		}
+		return true;
+	}
+
+	// the request line and headers, up to the blank line; empty when the scraper timed out or left
+	std::string read_request(Socket socket)
+	{
+		std::string request;
+		char buffer[1024];
+		while (request.size() < MAX_REQUEST && request.find("\r\n\r\n") == std::string::npos)
+		{
+			PollFd fd = {};
+			fd.fd = socket;
+			fd.events = POLLIN;
+			if (poll_sockets(&fd, 1, REQUEST_TIMEOUT_MS) <= 0)
+			{
+				return std::string();
+			}
+			const auto received = recv(socket, buffer, sizeof(buffer), 0);
+			if (received <= 0)
+			{
+				return std::string();
+			}
+			request.append(buffer, static_cast<size_t>(received));
+		}
+		return request;
+	}
+}
+
+MetricsHistogram::MetricsHistogram(std::initializer_list<double> bounds)
+{
+	for (double bound : bounds)
+	{
+		if (_boundCount < MAX_BOUNDS)
+		{
+			_bounds[_boundCount++] = bound;
+		}
+	}
+}
+
+void MetricsHistogram::add(double value)
+{
+	const uint32_t bucket = static_cast<uint32_t>(std::lower_bound(_bounds, _bounds + _boundCount, value) - _bounds);
+	_counts[bucket]++;
+	_sum += value;
+	_count++;
+}
+
+void MetricsHistogram::write(std::string& out, const char* name, const char* labels) const
+{
+	uint64_t cumulative = 0;
+	for (uint32_t i = 0; i <= _boundCount; i++)
+	{
+		cumulative += _counts[i];
+		out += name;
+		out += "_bucket{";
+		if (labels != nullptr)
+		{
+			out += labels;
+			out += ',';
+		}
+		out += "le=\"";
+		if (i < _boundCount)
+		{
+			append_double(out, _bounds[i]);
+		}
+		else
+		{
+			out += "+Inf";
+		}
+		out += "\"} ";
+		out += std::to_string(cumulative);
+		out += '\n';
+	}
+
+	const std::string suffix = labels != nullptr ? std::string("{") + labels + "} " : std::string(" ");
+	out += name;
+	out += "_sum";
+	out += suffix;
+	append_double(out, _sum);
+	out += '\n';
+	out += name;
+	out += "_count";
+	out += suffix;
+	out += std::to_string(_count);
+	out += '\n';
+}
+
+bool MetricsExporter::start(uint16_t port)
+{
+#ifdef _WIN32
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+	{
+		LOG_ERROR("Metrics: no Winsock, not serving");
+		return false;
+	}
+#endif
+	const Socket listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (listenSocket == NO_SOCKET)
+	{
+		LOG_ERROR("Metrics: could not create a socket, not serving");
+		return false;
+	}
+	// a restarted instance gets its port back while the old connections linger
+	const int reuse = 1;
+	setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(port);
+	if (bind(listenSocket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(listenSocket, 4) != 0)
+	{
+		LOG_ERROR("Metrics: could not listen on port " << port << ", not serving");
+		close_socket(listenSocket);
+		return false;
+	}
+
+	_listenSocket = static_cast<intptr_t>(listenSocket);
+	_stopping.store(false, std::memory_order_relaxed);
+	_server = std::thread([this]() { serve(); });
+	LOG_INFO("Metrics served at http://0.0.0.0:" << port << "/metrics");
+	return true;
+}
+
+void MetricsExporter::stop()
+{
+	if (!_server.joinable())
+	{
+		return;
+	}
+	_stopping.store(true, std::memory_order_relaxed);
+	_server.join();
+	close_socket(static_cast<Socket>(_listenSocket));
+	_listenSocket = -1;
+#ifdef _WIN32
+	WSACleanup();
+#endif
+}
+
+void MetricsExporter::record_frame(const FrameMetrics& frame)
+{
+	const auto now = std::chrono::steady_clock::now();
+	if (_hasLastFrame)
+	{
+		_live.frameMs.add(std::chrono::duration<double, std::milli>(now - _lastFrame).count());
+	}
+	_lastFrame = now;
+	_hasLastFrame = true;
+
+	if (frame.gpuMs >= 0.0)
+	{
+		_live.gpuMs.add(frame.gpuMs);
+	}
+	_live.presentMs.add(frame.presentMs);
+	_live.frames++;
+	_live.drawCalls += frame.commands.drawCalls;
+	_live.trianglesSubmitted += frame.commands.trianglesSubmitted;
+	_live.uploadBytes += frame.commands.uploadBytes;
+	_live.last = frame;
+
+	// a scrape holding the lock gets this frame's numbers with the next one's
+	std::unique_lock<std::mutex> lock(_publishedMutex, std::try_to_lock);
+	if (lock.owns_lock())
+	{
+		_published = _live;
+	}
+}
+
+void MetricsExporter::record_asset_load(AssetKind kind, double milliseconds)
+{
+	_live.assetLoadMs[static_cast<uint32_t>(kind)].add(milliseconds);
+}
+
+std::string MetricsExporter::format() const
+{
+	Aggregate published;
+	{
+		std::lock_guard<std::mutex> lock(_publishedMutex);
+		published = _published;
+	}
+
+	std::string out;
+	out.reserve(8192);
+	append_metric(out, "qc_frame_milliseconds", "histogram", "Time between two frames.");
+	published.frameMs.write(out, "qc_frame_milliseconds");
+	append_metric(out, "qc_gpu_frame_milliseconds", "histogram", "GPU time of a frame, from timestamp queries.");
+	published.gpuMs.write(out, "qc_gpu_frame_milliseconds");
+	append_metric(out, "qc_present_milliseconds", "histogram", "Time a frame blocked in acquire and present.");
+	published.presentMs.write(out, "qc_present_milliseconds");
+	append_metric(out, "qc_asset_load_milliseconds", "histogram", "Time the asset streamer took to load an asset.");
+	for (uint32_t kind = 0; kind < static_cast<uint32_t>(AssetKind::Count); kind++)
+	{
+		const std::string labels = std::string("kind=\"") + ASSET_KIND_NAMES[kind] + "\"";
+		published.assetLoadMs[kind].write(out, "qc_asset_load_milliseconds", labels.c_str());
+	}
+
+	append_counter(out, "qc_frames_total", "Frames recorded.", static_cast<double>(published.frames));
+	append_counter(out, "qc_draw_calls_total", "Draw calls and mesh task dispatches recorded.", static_cast<double>(published.drawCalls));
+	append_counter(out, "qc_triangles_submitted_total", "Triangles in the recorded draws, before GPU culling.",
+		static_cast<double>(published.trianglesSubmitted));
+	append_counter(out, "qc_upload_bytes_total", "Bytes staged through the upload manager.", static_cast<double>(published.uploadBytes));
+
+	const FrameMetrics& last = published.last;
+	append_gauge(out, "qc_draw_calls", "Draw calls of the last frame.", last.commands.drawCalls);
+	append_gauge(out, "qc_pipeline_binds", "Pipeline binds of the last frame.", last.commands.pipelineBinds);
+	append_gauge(out, "qc_triangles_submitted", "Triangles submitted by the last frame, before GPU culling.",
+		static_cast<double>(last.commands.trianglesSubmitted));
+	append_gauge(out, "qc_objects", "Render objects the last frame drew or handed to GPU culling.", last.objects);
+	append_gauge(out, "qc_heap_allocations", "CPU heap allocations during the last frame.", static_cast<double>(last.heapAllocations));
+	append_metric(out, "qc_heap_tag_allocations", "gauge", "CPU heap allocations during the last frame, by subsystem.");
+	for (uint32_t tag = 0; tag < static_cast<uint32_t>(HeapTag::Count); tag++)
+	{
+		append_labeled_sample(out, "qc_heap_tag_allocations", "tag", HEAP_TAG_NAMES[tag], static_cast<double>(last.heap.tags[tag].allocations));
+	}
+	append_metric(out, "qc_heap_tag_bytes", "gauge", "Bytes of CPU heap allocated during the last frame, by subsystem.");
+	for (uint32_t tag = 0; tag < static_cast<uint32_t>(HeapTag::Count); tag++)
+	{
+		append_labeled_sample(out, "qc_heap_tag_bytes", "tag", HEAP_TAG_NAMES[tag], static_cast<double>(last.heap.tags[tag].bytes));
+	}
+	append_gauge(out, "qc_vram_usage_bytes", "Bytes used over every device-local heap.", static_cast<double>(last.deviceLocalUsage));
+	append_gauge(out, "qc_vram_budget_bytes", "Bytes the driver budgets over every device-local heap.", static_cast<double>(last.deviceLocalBudget));
+	return out;
+}
+
+void MetricsExporter::serve()
+{
+	cpu_profiler::set_thread_name("metrics server");
+	const Socket listenSocket = static_cast<Socket>(_listenSocket);
+	while (!_stopping.load(std::memory_order_relaxed))
+	{
+		PollFd fd = {};
+		fd.fd = listenSocket;
+		fd.events = POLLIN;
+		if (poll_sockets(&fd, 1, ACCEPT_POLL_MS) <= 0)
+		{
+			continue;
+		}
+		const Socket client = accept(listenSocket, nullptr, nullptr);
+		if (client == NO_SOCKET)
+		{
+			continue;
+		}
+
+		const std::string request = read_request(client);
+		std::string response;
+		if (request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 13, "GET /metrics?") == 0)
+		{
+			const std::string body = format();
+			response = "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " + std::to_string(body.size())
+				+ "\r\nConnection: close\r\n\r\n" + body;
+		}
+		else if (!request.empty())
+		{
+			response = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+		}
+		send_all(client, response.data(), response.size());
+		close_socket(client);
+	}
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <FrameStats.h>
+#include <HeapStats.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Counts of values at or below fixed upper bounds, plus their sum and count, in the shape of a Prometheus
+// histogram; +Inf is implied past the last bound
+class MetricsHistogram
+{
+public:
+	static constexpr uint32_t MAX_BOUNDS = 15;
+
+	// ascending, at most MAX_BOUNDS
+	MetricsHistogram(std::initializer_list<double> bounds);
+
+	void add(double value);
+
+	// appends the text exposition lines of the histogram called name; labels ("kind=\"mesh\"") go on every
+	// sample when given, and the HELP and TYPE lines are left to the caller, as they precede all of a name's series
+	void write(std::string& out, const char* name, const char* labels = nullptr) const;
+
+private:
+	double _bounds[MAX_BOUNDS]{};
+	uint32_t _boundCount{ 0 };
+	uint64_t _counts[MAX_BOUNDS + 1]{}; // per bucket, not cumulative; the last is past every bound
+	double _sum{ 0.0 };
+	uint64_t _count{ 0 };
+};
+
+// What the engine measured of one finished frame
+struct FrameMetrics {
+	double presentMs{ 0.0 }; // blocked in acquire and present
+	double gpuMs{ -1.0 }; // the GPU profiler's frame scope, negative when no new result arrived
+	FrameStats commands;
+	uint32_t objects{ 0 }; // drawn, or handed to GPU culling
+	uint64_t deviceLocalUsage{ 0 }; // bytes over every device-local heap
+	uint64_t deviceLocalBudget{ 0 };
+	uint64_t heapAllocations{ 0 }; // CPU heap allocations during the frame
+	heap_stats::Snapshot heap; // the frame's allocations and bytes by tag
+};
+
+enum class AssetKind : uint32_t {
+	Mesh,
+	Texture,
+	Impostor,
+	Count,
+};
+
+// Frame and asset numbers aggregated into histograms and counters for fleet monitoring, served in the
+// Prometheus text format from GET /metrics on a port of its own. The render thread records into a copy only it
+// touches and publishes it once a frame with a try-lock, so it never waits: when a scrape is reading the
+// published copy, the frame's numbers stay in the private one and go out with the next frame's. The server is a
+// thread of its own that answers one request at a time, which scrapers every few seconds never notice.
+// Frame times are the intervals between record_frame() calls, so they include whatever the loop does besides
+// draw().
+class MetricsExporter
+{
+public:
+	// listens on every interface; false (and nothing served) when the port can't be bound
+	bool start(uint16_t port);
+	// joins the server; a scrape in progress finishes first
+	void stop();
+	bool running() const { return _server.joinable(); }
+
+	// render thread, once a frame after its submit
+	void record_frame(const FrameMetrics& frame);
+	// render thread, as streamed assets arrive
+	void record_asset_load(AssetKind kind, double milliseconds);
+
+private:
+	struct Aggregate {
+		MetricsHistogram frameMs{ 2.0, 4.0, 8.0, 12.0, 16.7, 20.0, 25.0, 33.3, 50.0, 66.7, 100.0, 250.0 };
+		MetricsHistogram gpuMs{ 1.0, 2.0, 4.0, 8.0, 12.0, 16.7, 25.0, 33.3, 50.0, 100.0 };
+		MetricsHistogram presentMs{ 0.1, 0.5, 1.0, 2.0, 4.0, 8.0, 16.7, 33.3 };
+		MetricsHistogram assetLoadMs[static_cast<uint32_t>(AssetKind::Count)]{
+			{ 1.0, 5.0, 10.0, 50.0, 100.0, 500.0, 1000.0, 5000.0, 30000.0 },
+			{ 1.0, 5.0, 10.0, 50.0, 100.0, 500.0, 1000.0, 5000.0, 30000.0 },
+			{ 1.0, 5.0, 10.0, 50.0, 100.0, 500.0, 1000.0, 5000.0, 30000.0 },
+		};
+		uint64_t frames{ 0 };
+		uint64_t drawCalls{ 0 };
+		uint64_t trianglesSubmitted{ 0 };
+		uint64_t uploadBytes{ 0 };
+		// the last frame's
+		FrameMetrics last;
+	};
+
+	// the published copy as exposition text
+	std::string format() const;
+	void serve();
+
+	// the render thread's
+	Aggregate _live;
+	std::chrono::steady_clock::time_point _lastFrame{};
+	bool _hasLastFrame{ false };
+
+	// the server's, under _publishedMutex
+	mutable std::mutex _publishedMutex;
+	Aggregate _published;
+
+	std::thread _server;
+	std::atomic<bool> _stopping{ false };
+	intptr_t _listenSocket{ -1 };
+};
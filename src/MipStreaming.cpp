@@ -0,0 +1,69 @@
+#include "MipStreaming.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace mipstream {
+	uint32_t first_level_within(const std::vector<TextureLevel>& levels, uint32_t maxSize)
+	{
+		for (uint32_t i = 0; i < levels.size(); i++)
+		{
+			if (std::max(levels[i].width, levels[i].height) <= maxSize)
+			{
+				return i;
+			}
+		}
+		return levels.empty() ? 0 : static_cast<uint32_t>(levels.size() - 1);
+	}
+
+	uint32_t level_for_screen_size(uint32_t width, uint32_t height, float screenDiameter)
+	{
+		const float texels = static_cast<float>(std::max(width, height));
+		if (!(screenDiameter < texels))
+		{
+			return 0;
+		}
+		return static_cast<uint32_t>(std::floor(std::log2(texels / std::max(screenDiameter, 1.f))));
+	}
+
+	size_t tail_bytes(const std::vector<TextureLevel>& levels, uint32_t first)
+	{
+		size_t bytes = 0;
+		for (size_t i = first; i < levels.size(); i++)
+		{
+			bytes += levels[i].size;
+		}
+		return bytes;
+	}
+
+	size_t fit_to_budget(std::vector<Demand>& demands, size_t budget)
+	{
+		size_t total = 0;
+		for (Demand& demand : demands)
+		{
+			demand.level = std::min(demand.wantedLevel, demand.tailLevel);
+			total += tail_bytes(*demand.levels, demand.level);
+		}
+
+		// the largest level frees the most and is the one least likely to be needed in full
+		while (total > budget)
+		{
+			Demand* largest = nullptr;
+			for (Demand& demand : demands)
+			{
+				if (demand.level < demand.tailLevel
+					&& (largest == nullptr || (*demand.levels)[demand.level].size > (*largest->levels)[largest->level].size))
+				{
+					largest = &demand;
+				}
+			}
+			if (largest == nullptr)
+			{
+				break;
+			}
+			total -= (*largest->levels)[largest->level].size;
+			largest->level++;
+		}
+		return total;
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <Texture.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Mip residency policy for streamed textures. A streamed texture keeps a contiguous tail of its stored
+// chain on the GPU, from its first resident level down to the last one, so it can always be sampled;
+// streaming levels in or out only moves that first level.
+namespace mipstream {
+	struct Demand {
+		const std::vector<TextureLevel>* levels;
+		uint32_t tailLevel; // coarsest first level allowed; the levels from here on always stay
+		uint32_t wantedLevel; // finest level the feedback asks for, at most tailLevel
+		uint32_t level; // out: the first level to keep
+	};
+
+	// first level no larger than maxSize texels on either side; the last level if none is
+	uint32_t first_level_within(const std::vector<TextureLevel>& levels, uint32_t maxSize);
+
+	// finest level worth having for a texture spread over screenDiameter pixels, taken to map its whole
+	// image across an object once: level 0 when texels don't outnumber pixels, each halving one level more
+	uint32_t level_for_screen_size(uint32_t width, uint32_t height, float screenDiameter);
+
+	// bytes of levels from first on
+	size_t tail_bytes(const std::vector<TextureLevel>& levels, uint32_t first);
+
+	// every texture starts at its wanted level; while the total exceeds budget, the texture whose first
+	// level is the largest drops it. Tails are never dropped, so the result may still exceed budget.
+	// Returns the bytes of the chosen levels
+	size_t fit_to_budget(std::vector<Demand>& demands, size_t budget);
+}
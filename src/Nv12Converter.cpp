@@ -0,0 +1,115 @@
+#include "Nv12Converter.h"
+
+#include "vk_initializers.h"
+
+namespace {
+	// matches the push constants of rgbToNv12.comp
+	struct Nv12PushConstants {
+		uint32_t width;
+		uint32_t height;
+		uint32_t encodeSrgb;
+	};
+
+	// local_size of rgbToNv12.comp, each invocation covering 4x2 pixels
+	constexpr uint32_t NV12_GROUP_SIZE = 8;
+
+	bool is_srgb(VkFormat format)
+	{
+		return format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_A8B8G8R8_SRGB_PACK32;
+	}
+}
+
+void Nv12Converter::init(VkDevice device, DescriptorAllocator& descriptors, VkShaderModule shader, VkPipelineCache cache, uint32_t setCount)
+{
+	_device = device;
+
+	VkDescriptorSetLayoutBinding bindings[] = {
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0), // source image
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1), // NV12 output
+	};
+
+	VkDescriptorSetLayoutCreateInfo setInfo = {};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setInfo.pNext = nullptr;
+	setInfo.bindingCount = 2;
+	setInfo.pBindings = bindings;
+	VK_CHECK(vkCreateDescriptorSetLayout(_device, &setInfo, nullptr, &_setLayout));
+
+	_sets.assign(setCount, VK_NULL_HANDLE);
+	for (VkDescriptorSet& set : _sets)
+	{
+		descriptors.allocate(&set, _setLayout);
+	}
+
+	VkPushConstantRange pushConstant;
+	pushConstant.offset = 0;
+	pushConstant.size = sizeof(Nv12PushConstants);
+	pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkPipelineLayoutCreateInfo layoutInfo = vkinit::pipeline_layout_create_info();
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &_setLayout;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushConstant;
+	VK_CHECK(vkCreatePipelineLayout(_device, &layoutInfo, nullptr, &_pipelineLayout));
+
+	VkComputePipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.pNext = nullptr;
+	pipelineInfo.layout = _pipelineLayout;
+	pipelineInfo.stage = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, shader);
+	VK_CHECK(vkCreateComputePipelines(_device, cache, 1, &pipelineInfo, nullptr, &_pipeline));
+
+	// the shader only texelFetches
+	VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	VK_CHECK(vkCreateSampler(_device, &samplerInfo, nullptr, &_sampler));
+}
+
+void Nv12Converter::cleanup()
+{
+	// the sets go with the descriptor allocator's pools
+	_sets.clear();
+	if (_pipeline == VK_NULL_HANDLE)
+	{
+		return;
+	}
+	vkDestroySampler(_device, _sampler, nullptr);
+	vkDestroyPipeline(_device, _pipeline, nullptr);
+	vkDestroyPipelineLayout(_device, _pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(_device, _setLayout, nullptr);
+	_pipeline = VK_NULL_HANDLE;
+}
+
+VkDeviceSize Nv12Converter::buffer_size(VkExtent2D extent)
+{
+	const VkDeviceSize pixels = VkDeviceSize(extent.width) * extent.height;
+	return pixels + pixels / 2;
+}
+
+void Nv12Converter::record(VkCommandBuffer cmd, uint32_t set, VkImageView view, VkFormat imageFormat, VkExtent2D extent, VkBuffer buffer)
+{
+	VkDescriptorImageInfo sourceInfo = {};
+	sourceInfo.sampler = _sampler;
+	sourceInfo.imageView = view;
+	sourceInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	VkDescriptorBufferInfo bufferInfo = {};
+	bufferInfo.buffer = buffer;
+	bufferInfo.offset = 0;
+	bufferInfo.range = buffer_size(extent);
+
+	VkWriteDescriptorSet writes[] = {
+		vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _sets[set], &sourceInfo, 0),
+		vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _sets[set], &bufferInfo, 1),
+	};
+	vkUpdateDescriptorSets(_device, 2, writes, 0, nullptr);
+
+	Nv12PushConstants constants = { extent.width, extent.height, is_srgb(imageFormat) ? 1u : 0u };
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout, 0, 1, &_sets[set], 0, nullptr);
+	vkCmdPushConstants(cmd, _pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+	const uint32_t blocksX = extent.width / 4;
+	const uint32_t blocksY = extent.height / 2;
+	vkCmdDispatch(cmd, (blocksX + NV12_GROUP_SIZE - 1) / NV12_GROUP_SIZE, (blocksY + NV12_GROUP_SIZE - 1) / NV12_GROUP_SIZE, 1);
+}
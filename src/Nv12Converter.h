@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vk_types.h>
+#include <DescriptorAllocator.h>
+
+#include <cstdint>
+#include <vector>
+
+// rgbToNv12.comp: converts a colour image into NV12 in a storage buffer on the GPU, for the readback and
+// for the video encoder. Each set is rewritten by the record() that uses it, so a caller keeps one per
+// conversion that may be in flight.
+class Nv12Converter
+{
+public:
+	void init(VkDevice device, DescriptorAllocator& descriptors, VkShaderModule shader, VkPipelineCache cache, uint32_t setCount);
+	void cleanup();
+	bool valid() const { return _pipeline != VK_NULL_HANDLE; }
+
+	// the shader works in 4x2 pixel blocks
+	static bool supports(VkExtent2D extent) { return extent.width % 4 == 0 && extent.height % 2 == 0; }
+	// luma plane at offset 0, chroma from width * height
+	static VkDeviceSize buffer_size(VkExtent2D extent);
+
+	// view's image must be in SHADER_READ_ONLY_OPTIMAL, visible to compute shaders, and the set's previous
+	// record must have finished executing. The caller makes the compute writes to buffer visible to whatever
+	// reads them
+	void record(VkCommandBuffer cmd, uint32_t set, VkImageView view, VkFormat imageFormat, VkExtent2D extent, VkBuffer buffer);
+
+private:
+	VkDevice _device{ VK_NULL_HANDLE };
+	VkDescriptorSetLayout _setLayout{ VK_NULL_HANDLE };
+	VkPipelineLayout _pipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline _pipeline{ VK_NULL_HANDLE };
+	VkSampler _sampler{ VK_NULL_HANDLE };
+	std::vector<VkDescriptorSet> _sets;
+};
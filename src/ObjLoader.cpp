@@ -0,0 +1,533 @@
+#include "ObjLoader.h"
+
+#include "HeapStats.h"
+#include "JobSystem.h"
+#include "Log.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	double elapsed_ms(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	unsigned resolve_thread_count(unsigned threadCount)
+	{
+		if (threadCount == 0)
+		{
+			threadCount = std::thread::hardware_concurrency();
+		}
+		return std::max(threadCount, 1u);
+	}
+
+	// an 'o'/'g' line, which renames the shape, or a 'usemtl' line, which changes its material; either
+	// starts a new one at the next triangle
+	struct ObjShapeStart {
+		std::string name;
+		size_t triangle; // first triangle after the line, within its chunk
+		bool material;
+	};
+
+	// what one chunk of lines produced; face indices are final except relative ones (see encode_relative)
+	struct ObjChunk {
+		std::vector<float> positions;
+		std::vector<float> normals;
+		std::vector<float> texcoords;
+		std::vector<ObjIndex> indices;
+		std::vector<ObjShapeStart> shapeStarts;
+		std::vector<std::string> libraries; // mtllib arguments
+		bool hasRelativeIndices{ false };
+	};
+
+	// negative OBJ indices count back from the last element seen so far, which a chunk only knows
+	// locally (and may point into an earlier chunk); they're stored biased far below -1, which stays
+	// "missing", and rebased once every chunk's counts are known
+	constexpr int RELATIVE_INDEX_BIAS = -(1 << 30);
+
+	int encode_relative(int local)
+	{
+		return RELATIVE_INDEX_BIAS + local;
+	}
+
+	int decode_relative(int index, size_t chunkBase)
+	{
+		return index < -1 ? static_cast<int>(chunkBase) + (index - RELATIVE_INDEX_BIAS) : index;
+	}
+
+	bool is_space(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	const char* skip_space(const char* p, const char* end)
+	{
+		while (p < end && is_space(*p))
+		{
+			p++;
+		}
+		return p;
+	}
+
+	// the rest of the line from p, without the surrounding spaces
+	std::string parse_name(const char* p, const char* end)
+	{
+		p = skip_space(p, end);
+		while (end > p && is_space(end[-1]))
+		{
+			end--;
+		}
+		return std::string(p, end);
+	}
+
+	// true if the line at p starts with keyword followed by a space
+	bool is_keyword(const char* p, const char* end, const char* keyword)
+	{
+		const size_t length = strlen(keyword);
+		return static_cast<size_t>(end - p) > length && memcmp(p, keyword, length) == 0 && is_space(p[length]);
+	}
+
+	// the folder part of path, with its trailing separator; empty for a bare file name
+	std::string folder_of(const char* path)
+	{
+		const std::string text = path;
+		const size_t slash = text.find_last_of("/\\");
+		return slash == std::string::npos ? std::string() : text.substr(0, slash + 1);
+	}
+
+	// locale-independent float parser for the plain decimal forms OBJ exporters write
+	const char* parse_float(const char* p, const char* end, float& value)
+	{
+		p = skip_space(p, end);
+
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = *p == '-';
+			p++;
+		}
+
+		double mantissa = 0.0;
+		while (p < end && *p >= '0' && *p <= '9')
+		{
+			mantissa = mantissa * 10.0 + (*p - '0');
+			p++;
+		}
+		if (p < end && *p == '.')
+		{
+			p++;
+			double scale = 0.1;
+			while (p < end && *p >= '0' && *p <= '9')
+			{
+				mantissa += (*p - '0') * scale;
+				scale *= 0.1;
+				p++;
+			}
+		}
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			p++;
+			bool negativeExponent = false;
+			if (p < end && (*p == '-' || *p == '+'))
+			{
+				negativeExponent = *p == '-';
+				p++;
+			}
+			int exponent = 0;
+			while (p < end && *p >= '0' && *p <= '9')
+			{
+				exponent = exponent * 10 + (*p - '0');
+				p++;
+			}
+			mantissa *= std::pow(10.0, negativeExponent ? -exponent : exponent);
+		}
+
+		value = static_cast<float>(negative ? -mantissa : mantissa);
+		return p;
+	}
+
+	const char* parse_int(const char* p, const char* end, int& value, bool& present)
+	{
+		bool negative = false;
+		if (p < end && *p == '-')
+		{
+			negative = true;
+			p++;
+		}
+
+		present = false;
+		int result = 0;
+		while (p < end && *p >= '0' && *p <= '9')
+		{
+			result = result * 10 + (*p - '0');
+			present = true;
+			p++;
+		}
+		value = negative ? -result : result;
+		return p;
+	}
+
+	// 1-based absolute or negative relative index to the chunk encoding; elementCount is the chunk's count so far
+	int resolve_index(int raw, bool present, size_t elementCount, ObjChunk& chunk)
+	{
+		if (!present || raw == 0)
+		{
+			return -1;
+		}
+		if (raw > 0)
+		{
+			return raw - 1;
+		}
+		chunk.hasRelativeIndices = true;
+		return encode_relative(static_cast<int>(elementCount) + raw);
+	}
+
+	void parse_face(const char* p, const char* end, ObjChunk& chunk)
+	{
+		// polygons are triangulated as a fan around their first corner
+		ObjIndex first = {};
+		ObjIndex previous = {};
+		int corner = 0;
+
+		while (true)
+		{
+			p = skip_space(p, end);
+			if (p >= end)
+			{
+				break;
+			}
+
+			ObjIndex index = { -1, -1, -1 };
+			int raw;
+			bool present;
+
+			// v, v/vt, v//vn or v/vt/vn
+			p = parse_int(p, end, raw, present);
+			if (!present)
+			{
+				break;
+			}
+			index.position = resolve_index(raw, present, chunk.positions.size() / 3, chunk);
+			if (p < end && *p == '/')
+			{
+				p = parse_int(p + 1, end, raw, present);
+				index.texcoord = resolve_index(raw, present, chunk.texcoords.size() / 2, chunk);
+				if (p < end && *p == '/')
+				{
+					p = parse_int(p + 1, end, raw, present);
+					index.normal = resolve_index(raw, present, chunk.normals.size() / 3, chunk);
+				}
+			}
+			// skip anything else glued to the corner
+			while (p < end && !is_space(*p))
+			{
+				p++;
+			}
+
+			if (corner == 0)
+			{
+				first = index;
+			}
+			else if (corner >= 2)
+			{
+				chunk.indices.push_back(first);
+				chunk.indices.push_back(previous);
+				chunk.indices.push_back(index);
+			}
+			previous = index;
+			corner++;
+		}
+	}
+
+	void parse_chunk(const char* p, const char* end, ObjChunk& chunk)
+	{
+		// rough guess from typical line lengths, saves most of the regrowth
+		const size_t expectedLines = static_cast<size_t>(end - p) / 32;
+		chunk.positions.reserve(expectedLines * 3 / 2);
+		chunk.indices.reserve(expectedLines * 3 / 2);
+
+		while (p < end)
+		{
+			const char* lineEnd = static_cast<const char*>(memchr(p, '\n', end - p));
+			if (lineEnd == nullptr)
+			{
+				lineEnd = end;
+			}
+
+			const char* q = skip_space(p, lineEnd);
+			if (q + 1 < lineEnd)
+			{
+				if (q[0] == 'v' && is_space(q[1]))
+				{
+					float x, y, z;
+					q = parse_float(q + 1, lineEnd, x);
+					q = parse_float(q, lineEnd, y);
+					parse_float(q, lineEnd, z);
+					chunk.positions.insert(chunk.positions.end(), { x, y, z });
+				}
+				else if (q[0] == 'v' && q[1] == 'n')
+				{
+					float x, y, z;
+					q = parse_float(q + 2, lineEnd, x);
+					q = parse_float(q, lineEnd, y);
+					parse_float(q, lineEnd, z);
+					chunk.normals.insert(chunk.normals.end(), { x, y, z });
+				}
+				else if (q[0] == 'v' && q[1] == 't')
+				{
+					float u, v;
+					q = parse_float(q + 2, lineEnd, u);
+					parse_float(q, lineEnd, v);
+					chunk.texcoords.insert(chunk.texcoords.end(), { u, v });
+				}
+				else if (q[0] == 'f' && is_space(q[1]))
+				{
+					parse_face(q + 1, lineEnd, chunk);
+				}
+				else if ((q[0] == 'o' || q[0] == 'g') && is_space(q[1]))
+				{
+					chunk.shapeStarts.push_back({ parse_name(q + 1, lineEnd), chunk.indices.size() / 3, false });
+				}
+				else if (is_keyword(q, lineEnd, "usemtl"))
+				{
+					chunk.shapeStarts.push_back({ parse_name(q + 6, lineEnd), chunk.indices.size() / 3, true });
+				}
+				else if (is_keyword(q, lineEnd, "mtllib"))
+				{
+					chunk.libraries.push_back(parse_name(q + 6, lineEnd));
+				}
+			}
+
+			p = lineEnd + 1;
+		}
+	}
+}
+
+bool load_obj(const char* path, ObjData& out, ObjLoadTimings* timings, unsigned threadCount)
+{
+	// the chunks parse on the job system, which carries the tag over
+	heap_stats::Scope heapScope(HeapTag::ObjImport);
+	ObjLoadTimings stageTimes;
+	Clock::time_point start = Clock::now();
+
+	MappedFile file;
+	if (!file.open(path))
+	{
+		LOG_ERROR("Failed to open " << path);
+		return false;
+	}
+	const char* data = reinterpret_cast<const char*>(file.data());
+	const char* dataEnd = data + file.size();
+	stageTimes.mapMs = elapsed_ms(start);
+
+	// chunks of at least 1 MiB, split right after a newline so no line straddles two chunks
+	start = Clock::now();
+	const size_t minChunkSize = 1 << 20;
+	const size_t chunkCount = std::max<size_t>(1, std::min<size_t>(resolve_thread_count(threadCount), file.size() / minChunkSize));
+
+	std::vector<const char*> bounds(chunkCount + 1);
+	bounds[0] = data;
+	bounds[chunkCount] = dataEnd;
+	for (size_t i = 1; i < chunkCount; i++)
+	{
+		const char* split = data + file.size() * i / chunkCount;
+		split = std::max(split, bounds[i - 1]);
+		const char* newline = static_cast<const char*>(memchr(split, '\n', dataEnd - split));
+		bounds[i] = newline ? newline + 1 : dataEnd;
+	}
+
+	std::vector<ObjChunk> chunks(chunkCount);
+	parallel_for(chunkCount, [&](size_t i) {
+		parse_chunk(bounds[i], bounds[i + 1], chunks[i]);
+	}, threadCount);
+	stageTimes.parseMs = elapsed_ms(start);
+
+	// element offsets of every chunk in the merged arrays
+	start = Clock::now();
+	std::vector<size_t> positionBase(chunkCount + 1, 0), normalBase(chunkCount + 1, 0), texcoordBase(chunkCount + 1, 0), indexBase(chunkCount + 1, 0);
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		positionBase[i + 1] = positionBase[i] + chunks[i].positions.size();
+		normalBase[i + 1] = normalBase[i] + chunks[i].normals.size();
+		texcoordBase[i + 1] = texcoordBase[i] + chunks[i].texcoords.size();
+		indexBase[i + 1] = indexBase[i] + chunks[i].indices.size();
+	}
+
+	out.positions.resize(positionBase[chunkCount]);
+	out.normals.resize(normalBase[chunkCount]);
+	out.texcoords.resize(texcoordBase[chunkCount]);
+	out.indices.resize(indexBase[chunkCount]);
+
+	parallel_for(chunkCount, [&](size_t i) {
+		ObjChunk& chunk = chunks[i];
+		std::copy(chunk.positions.begin(), chunk.positions.end(), out.positions.begin() + positionBase[i]);
+		std::copy(chunk.normals.begin(), chunk.normals.end(), out.normals.begin() + normalBase[i]);
+		std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), out.texcoords.begin() + texcoordBase[i]);
+
+		ObjIndex* dst = out.indices.data() + indexBase[i];
+		if (!chunk.hasRelativeIndices)
+		{
+			std::copy(chunk.indices.begin(), chunk.indices.end(), dst);
+			return;
+		}
+
+		for (size_t j = 0; j < chunk.indices.size(); j++)
+		{
+			ObjIndex index = chunk.indices[j];
+			index.position = decode_relative(index.position, positionBase[i] / 3);
+			index.normal = decode_relative(index.normal, normalBase[i] / 3);
+			index.texcoord = decode_relative(index.texcoord, texcoordBase[i] / 2);
+			dst[j] = index;
+		}
+	}, threadCount);
+
+	// the libraries come first so usemtl names resolve however the file orders the two
+	out.materials.clear();
+	out.libraries.clear();
+	const std::string folder = folder_of(path);
+	for (const ObjChunk& chunk : chunks)
+	{
+		for (const std::string& library : chunk.libraries)
+		{
+			const std::string libraryPath = folder + library;
+			out.libraries.push_back(libraryPath);
+			if (!load_mtl(libraryPath.c_str(), out.materials))
+			{
+				LOG_ERROR("Failed to open " << libraryPath);
+			}
+		}
+	}
+	std::unordered_map<std::string, int> materialIndices;
+	for (size_t i = 0; i < out.materials.size(); i++)
+	{
+		materialIndices.emplace(out.materials[i].name, static_cast<int>(i));
+	}
+
+	// triangles before the first 'o'/'g' form an unnamed shape; a chunk without one continues the last shape.
+	// the name and the material each carry on across the other's lines
+	const size_t triangleCount = out.indices.size() / 3;
+	out.shapes.clear();
+	ObjShape shape = { std::string(), 0, 0, -1 };
+	auto close_shape = [&](size_t end) {
+		if (end > shape.firstTriangle)
+		{
+			shape.triangleCount = end - shape.firstTriangle;
+			out.shapes.push_back(shape);
+		}
+		shape.firstTriangle = end;
+	};
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		for (const ObjShapeStart& shapeStart : chunks[i].shapeStarts)
+		{
+			close_shape(indexBase[i] / 3 + shapeStart.triangle);
+			if (shapeStart.material)
+			{
+				auto found = materialIndices.find(shapeStart.name);
+				shape.material = found != materialIndices.end() ? found->second : -1;
+			}
+			else
+			{
+				shape.name = shapeStart.name;
+			}
+		}
+	}
+	close_shape(triangleCount);
+	stageTimes.mergeMs = elapsed_ms(start);
+
+	if (timings)
+	{
+		*timings = stageTimes;
+	}
+	return true;
+}
+
+bool load_mtl(const char* path, std::vector<ObjMaterial>& out)
+{
+	heap_stats::Scope heapScope(HeapTag::ObjImport);
+	MappedFile file;
+	if (!file.open(path))
+	{
+		return false;
+	}
+	const char* p = reinterpret_cast<const char*>(file.data());
+	const char* end = p + file.size();
+	const std::string folder = folder_of(path);
+
+	// names already defined, earlier in this library or in one before it
+	std::unordered_map<std::string, size_t> defined;
+	for (size_t i = 0; i < out.size(); i++)
+	{
+		defined.emplace(out[i].name, i);
+	}
+
+	ObjMaterial* material = nullptr;
+	ObjMaterial ignored;
+	while (p < end)
+	{
+		const char* lineEnd = static_cast<const char*>(memchr(p, '\n', end - p));
+		if (lineEnd == nullptr)
+		{
+			lineEnd = end;
+		}
+
+		const char* q = skip_space(p, lineEnd);
+		if (is_keyword(q, lineEnd, "newmtl"))
+		{
+			ObjMaterial next;
+			next.name = parse_name(q + 6, lineEnd);
+			if (defined.emplace(next.name, out.size()).second)
+			{
+				out.push_back(std::move(next));
+				material = &out.back();
+			}
+			else
+			{
+				// a redefinition is read but kept out, like usemtl resolves to the first
+				ignored = std::move(next);
+				material = &ignored;
+			}
+		}
+		else if (material != nullptr)
+		{
+			if (is_keyword(q, lineEnd, "Kd"))
+			{
+				q = parse_float(q + 2, lineEnd, material->diffuse[0]);
+				q = parse_float(q, lineEnd, material->diffuse[1]);
+				parse_float(q, lineEnd, material->diffuse[2]);
+			}
+			else if (q + 1 < lineEnd && q[0] == 'd' && is_space(q[1]))
+			{
+				parse_float(q + 1, lineEnd, material->dissolve);
+			}
+			else if (is_keyword(q, lineEnd, "Tr"))
+			{
+				float transparency;
+				parse_float(q + 2, lineEnd, transparency);
+				material->dissolve = 1.f - transparency;
+			}
+			else if (is_keyword(q, lineEnd, "map_Kd"))
+			{
+				// options such as -bm come before the file name, which is the last word
+				std::string map = parse_name(q + 6, lineEnd);
+				const size_t space = map.find_last_of(" \t");
+				if (space != std::string::npos)
+				{
+					map = map.substr(space + 1);
+				}
+				material->diffuseMap = folder + map;
+			}
+		}
+
+		p = lineEnd + 1;
+	}
+	return true;
+}
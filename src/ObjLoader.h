@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// one corner of a triangle; 0-based indices into ObjData's arrays, -1 when the face leaves that attribute out
+struct ObjIndex {
+	int position;
+	int normal;
+	int texcoord;
+
+	bool operator==(const ObjIndex& other) const
+	{
+		return position == other.position && normal == other.normal && texcoord == other.texcoord;
+	}
+};
+
+// triangles between two 'o', 'g' or 'usemtl' lines
+struct ObjShape {
+	std::string name;
+	size_t firstTriangle;
+	size_t triangleCount;
+	int material; // index into ObjData::materials; -1 before any usemtl, or for a name no library defines
+};
+
+// one newmtl block of an .mtl file, as much of it as the material system shows
+struct ObjMaterial {
+	std::string name;
+	float diffuse[3]{ 1.f, 1.f, 1.f }; // Kd
+	float dissolve{ 1.f }; // d, or 1 - Tr
+	std::string diffuseMap; // map_Kd, resolved against the library's folder; empty without one
+};
+
+// triangulated contents of an OBJ file and its material libraries; colors and free-form geometry are ignored
+struct ObjData {
+	std::vector<float> positions; // xyz
+	std::vector<float> normals; // xyz
+	std::vector<float> texcoords; // uv
+	std::vector<ObjIndex> indices; // three per triangle
+	std::vector<ObjShape> shapes; // non-empty shapes only
+	std::vector<ObjMaterial> materials; // of every mtllib line, in order; a name defined twice keeps the first
+	std::vector<std::string> libraries; // paths of the mtllib lines, resolved like the maps, whether they could be read or not
+};
+
+// milliseconds per stage of load_obj
+struct ObjLoadTimings {
+	double mapMs{ 0.0 };
+	double parseMs{ 0.0 };
+	double mergeMs{ 0.0 };
+};
+
+// Parses the memory-mapped file in newline-aligned chunks, one per worker, then stitches the chunks
+// together (relative indices are resolved against the whole file). threadCount 0 uses every core.
+// Material libraries are looked for next to the file; one that can't be read leaves its shapes at -1
+bool load_obj(const char* path, ObjData& out, ObjLoadTimings* timings = nullptr, unsigned threadCount = 0);
+
+// appends the newmtl blocks of the library at path to out; false if it can't be opened
+bool load_mtl(const char* path, std::vector<ObjMaterial>& out);
@@ -0,0 +1,142 @@
+#include "ObjectPicker.h"
+
+#include "vk_initializers.h"
+
+#include <algorithm>
+
+uint32_t ObjectPicker::Result::nearest_to_center() const
+{
+	const int32_t centerX = static_cast<int32_t>(rect.extent.width / 2);
+	const int32_t centerY = static_cast<int32_t>(rect.extent.height / 2);
+	uint32_t nearest = UINT32_MAX;
+	int32_t nearestDistance = INT32_MAX;
+	for (int32_t y = 0; y < static_cast<int32_t>(rect.extent.height); y++)
+	{
+		for (int32_t x = 0; x < static_cast<int32_t>(rect.extent.width); x++)
+		{
+			const uint32_t id = ids[y * rect.extent.width + x];
+			const int32_t distance = (x - centerX) * (x - centerX) + (y - centerY) * (y - centerY);
+			if (id != 0 && distance < nearestDistance)
+			{
+				nearest = id - 1;
+				nearestDistance = distance;
+			}
+		}
+	}
+	return nearest;
+}
+
+void ObjectPicker::init(VmaAllocator allocator, uint32_t frameOverlap)
+{
+	_allocator = allocator;
+	_slots.assign(frameOverlap, Slot{});
+
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.pNext = nullptr;
+	bufferInfo.size = REGION * REGION * sizeof(uint32_t);
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.usage = VMA_MEMORY_USAGE_GPU_TO_CPU;
+
+	for (Slot& slot : _slots)
+	{
+		// mapped for as long as the buffer lives; deliver() invalidates before reading
+		VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &allocInfo, &slot.buffer._buffer, &slot.buffer._allocation, nullptr));
+		VK_CHECK(vmaMapMemory(_allocator, slot.buffer._allocation, &slot.mapped));
+	}
+}
+
+void ObjectPicker::cleanup()
+{
+	for (Slot& slot : _slots)
+	{
+		vmaUnmapMemory(_allocator, slot.buffer._allocation);
+		vmaDestroyBuffer(_allocator, slot.buffer._buffer, slot.buffer._allocation);
+	}
+	_slots.clear();
+}
+
+void ObjectPicker::request(int32_t x, int32_t y, uint32_t size, VkExtent2D window)
+{
+	size = std::min(std::max(size, 1u), REGION);
+	const int32_t half = static_cast<int32_t>(size / 2);
+	const int32_t left = std::max(x - half, 0);
+	const int32_t top = std::max(y - half, 0);
+	const int32_t right = std::min(x - half + static_cast<int32_t>(size), static_cast<int32_t>(window.width));
+	const int32_t bottom = std::min(y - half + static_cast<int32_t>(size), static_cast<int32_t>(window.height));
+	if (right <= left || bottom <= top)
+	{
+		return;
+	}
+	_request = { { left, top }, { static_cast<uint32_t>(right - left), static_cast<uint32_t>(bottom - top) } };
+	_window = window;
+	_requested = true;
+}
+
+void ObjectPicker::begin_frame()
+{
+	_active = _requested;
+	_rect = _request;
+	_requested = false;
+}
+
+VkViewport ObjectPicker::viewport() const
+{
+	// the whole window's, with the rectangle's corner at the origin; what falls outside the target is clipped
+	VkViewport viewport = {};
+	viewport.x = -static_cast<float>(_rect.offset.x);
+	viewport.y = -static_cast<float>(_rect.offset.y);
+	viewport.width = static_cast<float>(_window.width);
+	viewport.height = static_cast<float>(_window.height);
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	return viewport;
+}
+
+void ObjectPicker::record(VkCommandBuffer cmd, uint32_t frameIndex, int frameNumber, VkImage target)
+{
+	Slot& slot = _slots[frameIndex];
+
+	VkBufferImageCopy copy = {};
+	copy.bufferOffset = 0;
+	copy.bufferRowLength = 0;
+	copy.bufferImageHeight = 0;
+	copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	copy.imageSubresource.mipLevel = 0;
+	copy.imageSubresource.baseArrayLayer = 0;
+	copy.imageSubresource.layerCount = 1;
+	copy.imageExtent = { _rect.extent.width, _rect.extent.height, 1 };
+	vkCmdCopyImageToBuffer(cmd, target, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer._buffer, 1, &copy);
+
+	// the fence alone doesn't make device writes visible to the host
+	VkBufferMemoryBarrier toHost = vkinit::buffer_barrier(slot.buffer._buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &toHost, 0, nullptr);
+
+	slot.rect = _rect;
+	slot.frame = frameNumber;
+}
+
+void ObjectPicker::deliver(uint32_t frameIndex, const Callback& callback)
+{
+	Slot& slot = _slots[frameIndex];
+	if (slot.frame < 0)
+	{
+		return;
+	}
+
+	const int frameNumber = slot.frame;
+	slot.frame = -1;
+	if (!callback)
+	{
+		return;
+	}
+
+	vmaInvalidateAllocation(_allocator, slot.buffer._allocation, 0, VK_WHOLE_SIZE);
+	Result result;
+	result.frameNumber = frameNumber;
+	result.rect = slot.rect;
+	result.ids = static_cast<const uint32_t*>(slot.mapped);
+	callback(result);
+}
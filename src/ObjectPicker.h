@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vk_types.h>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Picks what's under the cursor on the GPU instead of ray casting the scene on the CPU. A request names
+// a small rectangle of the window; the frame that takes it draws the culled opaque objects once more, their
+// GPU scene slots into a REGION x REGION target with a depth buffer of its own, and the viewport shifted so
+// that only the rectangle lands in it. The rectangle is then copied into the frame slot's host-visible
+// buffer, which deliver() hands over once the slot's fence has been waited for anyway, a frame or two
+// later. Nothing on the CPU depends on how much is in the scene, and on the GPU it's the vertex work of
+// one more depth-only pass over a handful of pixels; frames without a request only clear the target.
+class ObjectPicker
+{
+public:
+	static constexpr uint32_t REGION = 16; // largest side of a rectangle
+	static constexpr VkFormat ID_FORMAT = VK_FORMAT_R32_UINT;
+
+	// one finished pick, valid only while the callback runs
+	struct Result {
+		int frameNumber;
+		VkRect2D rect; // in window pixels, clamped to the window
+		// rect.extent.width * rect.extent.height, rows tightly packed: the GPU scene slot plus one drawn
+		// nearest at each pixel, 0 where nothing was
+		const uint32_t* ids;
+
+		// the slot nearest to the rectangle's center, UINT32_MAX if nothing was drawn in it
+		uint32_t nearest_to_center() const;
+	};
+	using Callback = std::function<void(const Result& result)>;
+
+	void init(VmaAllocator allocator, uint32_t frameOverlap);
+	void cleanup();
+
+	// size x size pixels around x, y of a window of the given extent; replaces a request not taken yet
+	void request(int32_t x, int32_t y, uint32_t size, VkExtent2D window);
+	// once per frame before recording: takes the request, if any, for this frame's passes
+	void begin_frame();
+	// whether this frame's passes draw and copy a pick
+	bool active() const { return _active; }
+	// of this frame's pick: the window's viewport moved so the rectangle is the target's top left, and the
+	// part of the target it covers
+	VkViewport viewport() const;
+	VkExtent2D extent() const { return _rect.extent; }
+
+	// after the pick pass, with target in TRANSFER_SRC_OPTIMAL readable by transfers
+	void record(VkCommandBuffer cmd, uint32_t frameIndex, int frameNumber, VkImage target);
+	// after frameIndex's fence: hands the pick its frame recorded, if any, to callback
+	void deliver(uint32_t frameIndex, const Callback& callback);
+
+private:
+	struct Slot {
+		AllocatedBuffer buffer{};
+		void* mapped{ nullptr };
+		VkRect2D rect{};
+		int frame{ -1 }; // recorded and not delivered yet, -1 for none
+	};
+
+	VmaAllocator _allocator{ nullptr };
+	std::vector<Slot> _slots;
+
+	bool _requested{ false };
+	VkRect2D _request{};
+	bool _active{ false };
+	VkRect2D _rect{};
+	VkExtent2D _window{ 0, 0 };
+};
@@ -0,0 +1,142 @@
+#include "OcclusionPredicates.h"
+
+#include "Log.h"
+#include "vk_initializers.h"
+
+void OcclusionPredicates::init(VkDevice device, VmaAllocator allocator, uint32_t objectCount, uint32_t frameCount)
+{
+	_device = device;
+	_allocator = allocator;
+	_cmdBeginConditionalRendering = reinterpret_cast<PFN_vkCmdBeginConditionalRenderingEXT>(
+		vkGetDeviceProcAddr(device, "vkCmdBeginConditionalRenderingEXT"));
+	_cmdEndConditionalRendering = reinterpret_cast<PFN_vkCmdEndConditionalRenderingEXT>(
+		vkGetDeviceProcAddr(device, "vkCmdEndConditionalRenderingEXT"));
+	if (_cmdBeginConditionalRendering == nullptr || _cmdEndConditionalRendering == nullptr)
+	{
+		LOG_WARN("conditional rendering functions missing, occlusion predicates disabled");
+		_cmdBeginConditionalRendering = nullptr;
+		return;
+	}
+
+	// only ever written by the copies and read by the predicate fetch
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.pNext = nullptr;
+	bufferInfo.size = VkDeviceSize(objectCount) * sizeof(uint32_t);
+	bufferInfo.usage = VK_BUFFER_USAGE_CONDITIONAL_RENDERING_BIT_EXT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+	VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &allocInfo, &_predicates._buffer, &_predicates._allocation, nullptr));
+	_predicatesSet = false;
+
+	_pools.resize(frameCount);
+	for (VkQueryPool& pool : _pools)
+	{
+		VkQueryPoolCreateInfo queryInfo = {};
+		queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryInfo.pNext = nullptr;
+		queryInfo.queryType = VK_QUERY_TYPE_OCCLUSION;
+		queryInfo.queryCount = MAX_QUERIES;
+		VK_CHECK(vkCreateQueryPool(_device, &queryInfo, nullptr, &pool));
+	}
+	_queried.reserve(MAX_QUERIES);
+	_queriedFrame.assign(objectCount, 0);
+	_frameNumber = 0;
+}
+
+void OcclusionPredicates::cleanup()
+{
+	for (VkQueryPool pool : _pools)
+	{
+		vkDestroyQueryPool(_device, pool, nullptr);
+	}
+	_pools.clear();
+	_pool = VK_NULL_HANDLE;
+	if (_predicates._buffer != VK_NULL_HANDLE)
+	{
+		vmaDestroyBuffer(_allocator, _predicates._buffer, _predicates._allocation);
+		_predicates = {};
+	}
+	_queried.clear();
+	_queriedFrame.clear();
+	_cmdBeginConditionalRendering = nullptr;
+	_cmdEndConditionalRendering = nullptr;
+}
+
+void OcclusionPredicates::begin_frame(VkCommandBuffer cmd, uint32_t frame, uint64_t frameNumber)
+{
+	if (!ready())
+	{
+		return;
+	}
+
+	_frameNumber = frameNumber + 1;
+	_pool = _pools[frame];
+	_queried.clear();
+	// the slot's last frame has finished, copies and all
+	vkCmdResetQueryPool(cmd, _pool, 0, MAX_QUERIES);
+
+	if (!_predicatesSet)
+	{
+		vkCmdFillBuffer(cmd, _predicates._buffer, 0, VK_WHOLE_SIZE, 1);
+		VkBufferMemoryBarrier filled = vkinit::buffer_barrier(_predicates._buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_CONDITIONAL_RENDERING_READ_BIT_EXT);
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_CONDITIONAL_RENDERING_BIT_EXT, 0, 0, nullptr, 1, &filled, 0, nullptr);
+		_predicatesSet = true;
+	}
+}
+
+void OcclusionPredicates::begin_conditional(VkCommandBuffer cmd, uint32_t object) const
+{
+	VkConditionalRenderingBeginInfoEXT beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_CONDITIONAL_RENDERING_BEGIN_INFO_EXT;
+	beginInfo.pNext = nullptr;
+	beginInfo.buffer = _predicates._buffer;
+	beginInfo.offset = VkDeviceSize(object) * sizeof(uint32_t);
+	beginInfo.flags = 0;
+	_cmdBeginConditionalRendering(cmd, &beginInfo);
+}
+
+void OcclusionPredicates::end_conditional(VkCommandBuffer cmd) const
+{
+	_cmdEndConditionalRendering(cmd);
+}
+
+bool OcclusionPredicates::begin_query(VkCommandBuffer cmd, uint32_t object)
+{
+	if (_queried.size() >= MAX_QUERIES || object >= _queriedFrame.size())
+	{
+		return false;
+	}
+	// any sample counts as visible, so no precise counting
+	vkCmdBeginQuery(cmd, _pool, static_cast<uint32_t>(_queried.size()), 0);
+	_queried.push_back(object);
+	_queriedFrame[object] = _frameNumber + 1;
+	return true;
+}
+
+void OcclusionPredicates::end_query(VkCommandBuffer cmd)
+{
+	vkCmdEndQuery(cmd, _pool, static_cast<uint32_t>(_queried.size()) - 1);
+}
+
+void OcclusionPredicates::resolve(VkCommandBuffer cmd)
+{
+	if (_queried.empty())
+	{
+		return;
+	}
+
+	// this frame's predicated draws, and those of the frames before it on the queue, read the old values
+	VkBufferMemoryBarrier beforeCopy = vkinit::buffer_barrier(_predicates._buffer, 0, VK_ACCESS_TRANSFER_WRITE_BIT);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_CONDITIONAL_RENDERING_BIT_EXT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &beforeCopy, 0, nullptr);
+
+	// a copy per query, since the objects' slots are scattered; 32-bit sample counts, 0 only when hidden
+	for (uint32_t query = 0; query < _queried.size(); query++)
+	{
+		vkCmdCopyQueryPoolResults(cmd, _pool, query, 1, _predicates._buffer, VkDeviceSize(_queried[query]) * sizeof(uint32_t),
+			sizeof(uint32_t), VK_QUERY_RESULT_WAIT_BIT);
+	}
+
+	VkBufferMemoryBarrier afterCopy = vkinit::buffer_barrier(_predicates._buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_CONDITIONAL_RENDERING_READ_BIT_EXT);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_CONDITIONAL_RENDERING_BIT_EXT, 0, 0, nullptr, 1, &afterCopy, 0, nullptr);
+}
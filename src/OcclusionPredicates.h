@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vk_types.h>
+
+#include <cstdint>
+#include <vector>
+
+// GPU occlusion culling without the GPU-driven path: the bounding boxes of a frame's heavy objects are drawn
+// against its finished depth inside occlusion queries, whose results are copied into a buffer of
+// VK_EXT_conditional_rendering predicates, one uint per object. The next frame draws those objects
+// between begin_conditional and end_conditional, and the GPU skips the draws of whatever showed no samples
+// last frame; the CPU never waits for or reads a result.
+// An object only has a predicate worth using when its box was queried the frame before: one that just came
+// into view (or left the camera's box) would otherwise be judged on a stale result, so predicated() keeps
+// those unconditional until their first query is in. Results are a frame late, so an object coming out from
+// behind an occluder shows a frame after it would have; for objects that cost many times their box, that's
+// the trade.
+// Objects are the scene's stable slots (RenderObject::sceneIndex). Queries are per frame slot, predicates
+// shared: the copies into them wait for the frames before to be done reading.
+class OcclusionPredicates
+{
+public:
+	// boxes queried per frame; objects past it are drawn unconditionally the frame after
+	static constexpr uint32_t MAX_QUERIES = 1024;
+
+	// needs VK_EXT_conditional_rendering enabled on device; without its functions ready() stays false
+	void init(VkDevice device, VmaAllocator allocator, uint32_t objectCount, uint32_t frameCount);
+	void cleanup();
+	bool ready() const { return _cmdBeginConditionalRendering != nullptr; }
+
+	// right after vkBeginCommandBuffer, outside any render pass: resets the slot's queries, and on the first
+	// frame sets every predicate so nothing is skipped on results that never existed
+	void begin_frame(VkCommandBuffer cmd, uint32_t frame, uint64_t frameNumber);
+
+	// whether this frame's draws of object can be predicated; callable from the recording threads
+	bool predicated(uint32_t object) const
+	{
+		return object < _queriedFrame.size() && _queriedFrame[object] == _frameNumber;
+	}
+	// the GPU skips the draws in between when object's box showed no samples
+	void begin_conditional(VkCommandBuffer cmd, uint32_t object) const;
+	void end_conditional(VkCommandBuffer cmd) const;
+
+	// inside a render pass over the frame's depth, around one draw of object's box; false when the frame's
+	// queries are used up, and nothing may be drawn for it then
+	bool begin_query(VkCommandBuffer cmd, uint32_t object);
+	void end_query(VkCommandBuffer cmd);
+	// outside the render pass, after the last query: the results into the predicates the next frame reads
+	void resolve(VkCommandBuffer cmd);
+
+	uint32_t query_count() const { return static_cast<uint32_t>(_queried.size()); }
+
+private:
+	VkDevice _device{ VK_NULL_HANDLE };
+	VmaAllocator _allocator{ nullptr };
+	PFN_vkCmdBeginConditionalRenderingEXT _cmdBeginConditionalRendering{ nullptr };
+	PFN_vkCmdEndConditionalRenderingEXT _cmdEndConditionalRendering{ nullptr };
+
+	AllocatedBuffer _predicates{};
+	bool _predicatesSet{ false };
+	std::vector<VkQueryPool> _pools; // per frame slot
+	VkQueryPool _pool{ VK_NULL_HANDLE }; // this frame's
+	std::vector<uint32_t> _queried; // the object of every query this frame, in query order
+	// the frame each object's predicate was last written for, in _frameNumber's terms; 0 for none
+	std::vector<uint64_t> _queriedFrame;
+	uint64_t _frameNumber{ 0 }; // the frame being recorded, plus one
+};
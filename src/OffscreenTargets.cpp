@@ -0,0 +1,45 @@
+#include "OffscreenTargets.h"
+
+#include <vk_initializers.h>
+
+void OffscreenTargets::init(VkDevice device, VmaAllocator allocator, VkFormat format, VkExtent2D extent, uint32_t imageCount, VkImageUsageFlags usage)
+{
+	_device = device;
+	_allocator = allocator;
+	_format = format;
+	_extent = extent;
+
+	// the frame graph may blit the scene into it at a lower resolution, like into the swapchain
+	VkExtent3D imageExtent = { extent.width, extent.height, 1 };
+	VkImageCreateInfo imageInfo = vkinit::image_create_info(format,
+		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | usage, imageExtent);
+	VmaAllocationCreateInfo imageAlloc = {};
+	imageAlloc.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+	imageAlloc.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	_targets.assign(imageCount, AllocatedImage{});
+	_images.clear();
+	_views.clear();
+	for (AllocatedImage& target : _targets)
+	{
+		VK_CHECK(vmaCreateImage(_allocator, &imageInfo, &imageAlloc, &target._image, &target._allocation, nullptr));
+		VkImageViewCreateInfo viewInfo = vkinit::imageview_create_info(format, target._image, VK_IMAGE_ASPECT_COLOR_BIT);
+		VkImageView view;
+		VK_CHECK(vkCreateImageView(_device, &viewInfo, nullptr, &view));
+
+		_images.push_back(target._image);
+		_views.push_back(view);
+	}
+}
+
+void OffscreenTargets::cleanup()
+{
+	for (size_t i = 0; i < _targets.size(); i++)
+	{
+		vkDestroyImageView(_device, _views[i], nullptr);
+		vmaDestroyImage(_allocator, _targets[i]._image, _targets[i]._allocation);
+	}
+	_targets.clear();
+	_images.clear();
+	_views.clear();
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vk_types.h>
+
+#include <cstdint>
+#include <vector>
+
+// Render targets for running without a window: a ring of colour images standing in for the swapchain.
+// The engine renders into them through the same frame graph it uses for the swapchain, so headless jobs
+// and benchmarks run the real renderer, and FrameReadback gets their pixels back on the CPU instead of
+// on screen.
+class OffscreenTargets
+{
+public:
+	// ring images need not outnumber the frames in flight; the engine reuses one only after the fence of the
+	// frame that last rendered into it. usage is added to what rendering and blits into them need
+	void init(VkDevice device, VmaAllocator allocator, VkFormat format, VkExtent2D extent, uint32_t imageCount, VkImageUsageFlags usage);
+	// the GPU must be done with every frame that used them
+	void cleanup();
+
+	// the ring, in the order the engine hands it out
+	const std::vector<VkImage>& images() const { return _images; }
+	const std::vector<VkImageView>& views() const { return _views; }
+	uint32_t image_for(uint64_t frameNumber) const { return static_cast<uint32_t>(frameNumber % _targets.size()); }
+	VkFormat format() const { return _format; }
+	VkExtent2D extent() const { return _extent; }
+
+private:
+	VkDevice _device{ VK_NULL_HANDLE };
+	VmaAllocator _allocator{ VK_NULL_HANDLE };
+	VkFormat _format{ VK_FORMAT_UNDEFINED };
+	VkExtent2D _extent{};
+	std::vector<AllocatedImage> _targets;
+	std::vector<VkImage> _images;
+	std::vector<VkImageView> _views;
+};
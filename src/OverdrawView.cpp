@@ -0,0 +1,184 @@
+#include "OverdrawView.h"
+
+#include "vk_initializers.h"
+
+#include <cassert>
+
+namespace {
+	// matches the push constants of overdraw.comp
+	struct HeatPushConstants {
+		uint32_t size[2];
+	};
+
+	// matches Totals in overdraw.comp
+	struct Totals {
+		uint32_t fragments;
+		uint32_t quadTwelfths;
+		uint32_t coveredPixels;
+	};
+
+	uint32_t divide_rounded_up(uint32_t value, uint32_t divisor)
+	{
+		return (value + divisor - 1) / divisor;
+	}
+}
+
+VkFormat OverdrawView::count_format(VkPhysicalDevice physicalDevice)
+{
+	const VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BLEND_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+	VkFormatProperties properties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_R32G32_SFLOAT, &properties);
+	return (properties.optimalTilingFeatures & needed) == needed ? VK_FORMAT_R32G32_SFLOAT : VK_FORMAT_R16G16_SFLOAT;
+}
+
+bool OverdrawView::quad_counts(VkPhysicalDevice physicalDevice)
+{
+	VkPhysicalDeviceSubgroupProperties subgroup = {};
+	subgroup.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+	VkPhysicalDeviceProperties2 properties = {};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties.pNext = &subgroup;
+	vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+	return (subgroup.supportedOperations & VK_SUBGROUP_FEATURE_QUAD_BIT) != 0 && (subgroup.supportedStages & VK_SHADER_STAGE_FRAGMENT_BIT) != 0;
+}
+
+void OverdrawView::init(VkDevice device, VmaAllocator allocator, DescriptorAllocator& descriptors, LayoutCache& layouts, VkShaderModule heatShader, VkPipelineCache cache,
+	uint32_t frameCount, bool quadCounts)
+{
+	_device = device;
+	_allocator = allocator;
+	_quadCounts = quadCounts;
+
+	VkDescriptorSetLayoutBinding bindings[] = {
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0), // counts
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1), // heat map
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2), // totals
+	};
+
+	VkDescriptorSetLayoutCreateInfo setInfo = {};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setInfo.pNext = nullptr;
+	setInfo.bindingCount = 3;
+	setInfo.pBindings = bindings;
+	VK_CHECK(vkCreateDescriptorSetLayout(_device, &setInfo, nullptr, &_setLayout));
+
+	VkPushConstantRange pushConstant;
+	pushConstant.offset = 0;
+	pushConstant.size = sizeof(HeatPushConstants);
+	pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkPipelineLayoutCreateInfo layoutInfo = vkinit::pipeline_layout_create_info();
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &_setLayout;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushConstant;
+	VK_CHECK(vkCreatePipelineLayout(_device, &layoutInfo, nullptr, &_pipelineLayout));
+
+	if (heatShader != VK_NULL_HANDLE)
+	{
+		VkComputePipelineCreateInfo pipelineInfo = {};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.pNext = nullptr;
+		pipelineInfo.layout = _pipelineLayout;
+		pipelineInfo.stage = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, heatShader);
+		VK_CHECK(vkCreateComputePipelines(_device, cache, 1, &pipelineInfo, nullptr, &_pipeline));
+	}
+
+	// the shader only texelFetches
+	VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	_sampler = layouts.sampler(samplerInfo);
+
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.pNext = nullptr;
+	bufferInfo.size = sizeof(Totals);
+	bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.usage = VMA_MEMORY_USAGE_GPU_TO_CPU;
+
+	_slots.resize(frameCount);
+	for (Slot& slot : _slots)
+	{
+		descriptors.allocate(&slot.set, _setLayout);
+		// mapped for as long as the buffer lives; deliver() invalidates before reading
+		VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &allocInfo, &slot.totals._buffer, &slot.totals._allocation, nullptr));
+		VK_CHECK(vmaMapMemory(_allocator, slot.totals._allocation, &slot.totals._mapped));
+	}
+}
+
+void OverdrawView::cleanup()
+{
+	// the sets go with the descriptor allocator's pools, the sampler with the layout cache
+	for (Slot& slot : _slots)
+	{
+		vmaUnmapMemory(_allocator, slot.totals._allocation);
+		vmaDestroyBuffer(_allocator, slot.totals._buffer, slot.totals._allocation);
+	}
+	_slots.clear();
+	vkDestroyPipeline(_device, _pipeline, nullptr);
+	vkDestroyPipelineLayout(_device, _pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(_device, _setLayout, nullptr);
+}
+
+void OverdrawView::record(VkCommandBuffer cmd, uint32_t frame, int frameNumber, VkImageView counts, VkImageView heat, VkExtent2D region)
+{
+	assert(_pipeline != VK_NULL_HANDLE);
+	Slot& slot = _slots[frame];
+
+	// the last use of the buffer was read on the host after the slot's fence, so only the fill needs ordering
+	vkCmdFillBuffer(cmd, slot.totals._buffer, 0, sizeof(Totals), 0);
+	VkBufferMemoryBarrier cleared = vkinit::buffer_barrier(slot.totals._buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &cleared, 0, nullptr);
+
+	VkDescriptorImageInfo countInfo = { _sampler, counts, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	VkDescriptorImageInfo heatInfo = { VK_NULL_HANDLE, heat, VK_IMAGE_LAYOUT_GENERAL };
+	VkDescriptorBufferInfo totalsInfo = { slot.totals._buffer, 0, sizeof(Totals) };
+	VkWriteDescriptorSet writes[] = {
+		vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, slot.set, &countInfo, 0),
+		vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, slot.set, &heatInfo, 1),
+		vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, slot.set, &totalsInfo, 2),
+	};
+	vkUpdateDescriptorSets(_device, 3, writes, 0, nullptr);
+
+	HeatPushConstants constants = {};
+	constants.size[0] = region.width;
+	constants.size[1] = region.height;
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout, 0, 1, &slot.set, 0, nullptr);
+	vkCmdPushConstants(cmd, _pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(HeatPushConstants), &constants);
+	vkCmdDispatch(cmd, divide_rounded_up(region.width, 8), divide_rounded_up(region.height, 8), 1);
+
+	VkBufferMemoryBarrier toHost = vkinit::buffer_barrier(slot.totals._buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &toHost, 0, nullptr);
+
+	slot.region = region;
+	slot.frame = frameNumber;
+}
+
+void OverdrawView::deliver(uint32_t frame)
+{
+	if (frame >= _slots.size())
+	{
+		return;
+	}
+	Slot& slot = _slots[frame];
+	if (slot.frame < 0)
+	{
+		return;
+	}
+	VK_CHECK(vmaInvalidateAllocation(_allocator, slot.totals._allocation, 0, VK_WHOLE_SIZE));
+	const Totals& totals = *static_cast<const Totals*>(slot.totals._mapped);
+
+	const float pixels = static_cast<float>(slot.region.width) * static_cast<float>(slot.region.height);
+	const float fragments = static_cast<float>(totals.fragments);
+	_latest.frameNumber = slot.frame;
+	_latest.fragmentsPerPixel = pixels > 0.f ? fragments / pixels : 0.f;
+	_latest.fragmentsPerCoveredPixel = totals.coveredPixels > 0 ? fragments / static_cast<float>(totals.coveredPixels) : 0.f;
+	// four invocations per quad; a frame that drew nothing wasted nothing
+	const float quads = static_cast<float>(totals.quadTwelfths) / 12.f;
+	_latest.quadEfficiency = !_quadCounts ? -1.f : quads > 0.f ? fragments / (4.f * quads) : 1.f;
+	slot.frame = -1;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vk_types.h>
+#include <DescriptorAllocator.h>
+#include <LayoutCache.h>
+
+#include <vector>
+
+// The overdraw debug view's side of the frame: the engine draws every opaque mesh into a two-channel count
+// target with additive blending and no depth test, red adding 1 per fragment and green each fragment's
+// share of its 2x2 quad (see overdrawQuad.frag), and record() turns the counts into a heat map and sums
+// them. What comes out after the slot's fence is the frame's fragments per pixel, over the whole render
+// area and over just the pixels something covered, and its quad efficiency: the fraction of the shaded
+// quads' invocations that covered a pixel rather than running as helpers. The counts are every layer a
+// pixel has, not just what the depth test lets through, so they are the depth complexity the pre-pass and
+// front-to-back sorting save the shading of.
+// R32G32_SFLOAT counts where the device blends it, R16G16_SFLOAT otherwise, which every device blends and
+// which still counts whole layers exactly up to 2048.
+class OverdrawView
+{
+public:
+	static constexpr VkFormat HEAT_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+	struct Averages {
+		int frameNumber{ -1 }; // -1 until a frame was delivered
+		float fragmentsPerPixel{ 0.f }; // over the render area
+		float fragmentsPerCoveredPixel{ 0.f };
+		float quadEfficiency{ -1.f }; // -1 without quad counts
+	};
+
+	// the count target's format on this device
+	static VkFormat count_format(VkPhysicalDevice physicalDevice);
+	// whether overdrawQuad.frag can run: quad operations in fragment shaders
+	static bool quad_counts(VkPhysicalDevice physicalDevice);
+
+	// without a shader there is no pipeline and record() must not be called
+	void init(VkDevice device, VmaAllocator allocator, DescriptorAllocator& descriptors, LayoutCache& layouts, VkShaderModule heatShader, VkPipelineCache cache,
+		uint32_t frameCount, bool quadCounts);
+	void cleanup();
+
+	bool ready() const { return _pipeline != VK_NULL_HANDLE; }
+
+	// inside a compute pass: the top-left region of counts, in SHADER_READ_ONLY_OPTIMAL, into heat, in
+	// GENERAL, and their sums into the frame slot's buffer. Rewrites the slot's set
+	void record(VkCommandBuffer cmd, uint32_t frame, int frameNumber, VkImageView counts, VkImageView heat, VkExtent2D region);
+	// after frame's fence: the sums it recorded, if any, become latest()
+	void deliver(uint32_t frame);
+
+	const Averages& latest() const { return _latest; }
+
+private:
+	struct Slot {
+		AllocatedBuffer totals{};
+		VkDescriptorSet set{ VK_NULL_HANDLE };
+		VkExtent2D region{ 0, 0 };
+		int frame{ -1 }; // recorded and not delivered yet, -1 for none
+	};
+
+	VkDevice _device{ VK_NULL_HANDLE };
+	VmaAllocator _allocator{ nullptr };
+	bool _quadCounts{ false };
+
+	VkDescriptorSetLayout _setLayout{ VK_NULL_HANDLE };
+	VkPipelineLayout _pipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline _pipeline{ VK_NULL_HANDLE };
+	VkSampler _sampler{ VK_NULL_HANDLE };
+	std::vector<Slot> _slots;
+
+	Averages _latest;
+};
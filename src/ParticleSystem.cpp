@@ -0,0 +1,235 @@
+#include "ParticleSystem.h"
+
+#include "vk_initializers.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+namespace {
+	// what the shaders read and write through the Particles binding (see particles.glsl)
+	struct GpuParticle {
+		glm::vec4 positionAge; // w seconds since emission
+		glm::vec4 velocityLifetime; // w seconds it lives
+	};
+
+	// matches the Counters binding of particles.glsl
+	struct ParticleCounters {
+		uint32_t aliveCount[2];
+		uint32_t deadCount;
+		uint32_t emitCount; // this frame's emission, clamped to the free slots
+		VkDispatchIndirectCommand emitDispatch;
+		VkDispatchIndirectCommand simulateDispatch;
+		VkDrawIndirectCommand draw;
+	};
+
+	// particle.vert's push constants
+	struct ParticleDrawConstants {
+		uint32_t aliveBase; // first entry of the list being drawn
+		float size;
+	};
+
+	// local_size of the particle compute shaders
+	constexpr uint32_t PARTICLE_GROUP_SIZE = 64;
+
+	void memory_barrier(VkCommandBuffer cmd, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess)
+	{
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.pNext = nullptr;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+		vkCmdPipelineBarrier(cmd, srcStages, dstStages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+}
+
+void ParticleSystem::init(VkDevice device, VmaAllocator allocator, DescriptorAllocator& descriptors, uint32_t capacity,
+	VkShaderModule argsShader, VkShaderModule emitShader, VkShaderModule simulateShader, VkPipelineCache cache)
+{
+	_device = device;
+	_allocator = allocator;
+	_capacity = std::max(1u, std::min(capacity, MAX_CAPACITY));
+
+	const VkShaderStageFlags stages = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+	VkDescriptorSetLayoutBinding bindings[] = {
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stages, 0), // particles
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stages, 1), // alive lists
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stages, 2), // dead list
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stages, 3), // counters
+	};
+
+	VkDescriptorSetLayoutCreateInfo setInfo = {};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setInfo.pNext = nullptr;
+	setInfo.bindingCount = 4;
+	setInfo.pBindings = bindings;
+	VK_CHECK(vkCreateDescriptorSetLayout(_device, &setInfo, nullptr, &_setLayout));
+
+	// all of it is only ever touched by the GPU
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+	auto create = [&](VkDeviceSize size, VkBufferUsageFlags usage, AllocatedBuffer& buffer) {
+		VkBufferCreateInfo bufferInfo = {};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.pNext = nullptr;
+		bufferInfo.size = size;
+		bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | usage;
+		VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &allocInfo, &buffer._buffer, &buffer._allocation, nullptr));
+	};
+	create(VkDeviceSize(_capacity) * sizeof(GpuParticle), 0, _particleBuffer);
+	create(VkDeviceSize(_capacity) * 2 * sizeof(uint32_t), 0, _aliveBuffer);
+	create(VkDeviceSize(_capacity) * sizeof(uint32_t), 0, _deadBuffer);
+	create(sizeof(ParticleCounters), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, _counterBuffer);
+
+	descriptors.allocate(&_set, _setLayout);
+	VkDescriptorBufferInfo bufferInfos[] = {
+		{ _particleBuffer._buffer, 0, VK_WHOLE_SIZE },
+		{ _aliveBuffer._buffer, 0, VK_WHOLE_SIZE },
+		{ _deadBuffer._buffer, 0, VK_WHOLE_SIZE },
+		{ _counterBuffer._buffer, 0, VK_WHOLE_SIZE },
+	};
+	VkWriteDescriptorSet writes[4];
+	for (uint32_t binding = 0; binding < 4; binding++)
+	{
+		writes[binding] = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _set, &bufferInfos[binding], binding);
+	}
+	vkUpdateDescriptorSets(_device, 4, writes, 0, nullptr);
+
+	VkPushConstantRange pushConstant;
+	pushConstant.offset = 0;
+	pushConstant.size = sizeof(PushConstants);
+	pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkPipelineLayoutCreateInfo layoutInfo = vkinit::pipeline_layout_create_info();
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &_setLayout;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushConstant;
+	VK_CHECK(vkCreatePipelineLayout(_device, &layoutInfo, nullptr, &_pipelineLayout));
+
+	if (argsShader != VK_NULL_HANDLE && emitShader != VK_NULL_HANDLE && simulateShader != VK_NULL_HANDLE)
+	{
+		VkComputePipelineCreateInfo pipelineInfos[3] = {};
+		VkShaderModule shaders[] = { argsShader, emitShader, simulateShader };
+		for (int i = 0; i < 3; i++)
+		{
+			pipelineInfos[i].sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+			pipelineInfos[i].pNext = nullptr;
+			pipelineInfos[i].layout = _pipelineLayout;
+			pipelineInfos[i].stage = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, shaders[i]);
+		}
+		VkPipeline pipelines[3];
+		VK_CHECK(vkCreateComputePipelines(_device, cache, 3, pipelineInfos, nullptr, pipelines));
+		_argsPipeline = pipelines[0];
+		_emitPipeline = pipelines[1];
+		_simulatePipeline = pipelines[2];
+	}
+
+	_needsReset = true;
+	_emitCarry = 0.0f;
+}
+
+void ParticleSystem::cleanup()
+{
+	// the set goes with the descriptor allocator's pools
+	vkDestroyPipeline(_device, _argsPipeline, nullptr);
+	vkDestroyPipeline(_device, _emitPipeline, nullptr);
+	vkDestroyPipeline(_device, _simulatePipeline, nullptr);
+	vkDestroyPipelineLayout(_device, _pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(_device, _setLayout, nullptr);
+	for (AllocatedBuffer* buffer : { &_particleBuffer, &_aliveBuffer, &_deadBuffer, &_counterBuffer })
+	{
+		vmaDestroyBuffer(_allocator, buffer->_buffer, buffer->_allocation);
+		*buffer = {};
+	}
+}
+
+void ParticleSystem::dispatch(VkCommandBuffer cmd, VkPipeline pipeline, uint32_t mode, uint32_t groupCount)
+{
+	_constants.mode = mode;
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdPushConstants(cmd, _pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &_constants);
+	vkCmdDispatch(cmd, groupCount, 1, 1);
+}
+
+void ParticleSystem::dispatch_indirect(VkCommandBuffer cmd, VkPipeline pipeline, VkDeviceSize argumentOffset)
+{
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdPushConstants(cmd, _pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &_constants);
+	vkCmdDispatchIndirect(cmd, _counterBuffer._buffer, argumentOffset);
+}
+
+void ParticleSystem::update(VkCommandBuffer cmd, const ParticleEmitter& emitter, float deltaTime)
+{
+	if (!ready())
+	{
+		return;
+	}
+
+	// the previous update's writes are read again here, and the particles and list the previous draw read
+	// are about to be overwritten
+	memory_barrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+		VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout, 0, 1, &_set, 0, nullptr);
+
+	_constants.capacity = _capacity;
+	if (_needsReset)
+	{
+		// every slot free, both lists empty
+		_constants.current = 0;
+		dispatch(cmd, _argsPipeline, 0, (_capacity + PARTICLE_GROUP_SIZE - 1) / PARTICLE_GROUP_SIZE);
+		memory_barrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+		_needsReset = false;
+	}
+
+	// the fraction carried over keeps low rates emitting at all; a long frame can't ask for more than the pool
+	const float lifetime = std::max(emitter.lifetime, 0.001f);
+	const float rate = emitter.rate > 0.0f ? emitter.rate : _capacity / lifetime;
+	const float emission = rate * std::max(deltaTime, 0.0f) + _emitCarry;
+	const float emitCount = std::min(std::floor(emission), float(_capacity));
+	_emitCarry = emission - std::floor(emission);
+
+	_constants.emitterPosition = glm::vec4(emitter.position, emitter.radius);
+	_constants.emitterDirection = glm::vec4(emitter.direction, std::cos(emitter.spread));
+	_constants.gravity = glm::vec4(emitter.gravity, emitter.drag);
+	_constants.speed = emitter.speed;
+	_constants.lifetime = lifetime;
+	_constants.deltaTime = deltaTime;
+	_constants.emitCount = static_cast<uint32_t>(emitCount);
+	_constants.seed++;
+
+	// emission and simulation sizes, from counts only the GPU knows
+	dispatch(cmd, _argsPipeline, 1, 1);
+	memory_barrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+	dispatch_indirect(cmd, _emitPipeline, offsetof(ParticleCounters, emitDispatch));
+	memory_barrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+	dispatch_indirect(cmd, _simulatePipeline, offsetof(ParticleCounters, simulateDispatch));
+	memory_barrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+	// the survivors' count into the draw
+	dispatch(cmd, _argsPipeline, 2, 1);
+	memory_barrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+
+	// the survivors' list is drawn, and next frame emits into it
+	_constants.current ^= 1;
+}
+
+void ParticleSystem::draw(VkCommandBuffer cmd, VkPipelineLayout layout, float size) const
+{
+	if (!ready())
+	{
+		return;
+	}
+
+	ParticleDrawConstants constants = { _constants.current * _capacity, size };
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 1, 1, &_set, 0, nullptr);
+	vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(ParticleDrawConstants), &constants);
+	vkCmdDrawIndirect(cmd, _counterBuffer._buffer, offsetof(ParticleCounters, draw), 1, sizeof(VkDrawIndirectCommand));
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vk_types.h>
+#include <DescriptorAllocator.h>
+
+#include <cstdint>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+// one point emitter shooting particles into a cone; the simulation integrates them under gravity and drag
+struct ParticleEmitter {
+	glm::vec3 position{ 0.0f };
+	float radius{ 0.1f }; // particles start anywhere within this of position
+	glm::vec3 direction{ 0.0f, 1.0f, 0.0f };
+	float spread{ 0.35f }; // half angle of the cone, radians
+	float speed{ 6.0f };
+	float lifetime{ 2.0f }; // seconds; each particle lives between half and all of it
+	float rate{ 0.0f }; // particles a second; 0 emits as fast as the pool refills, capacity / lifetime
+	glm::vec3 gravity{ 0.0f, -9.81f, 0.0f };
+	float drag{ 0.2f };
+	float size{ 0.02f }; // billboard half size, world units
+};
+
+// Particles simulated and drawn entirely on the GPU; the CPU only records a fixed handful of dispatches a
+// frame, whatever the particle count.
+// The pool holds capacity particles. Free slots are a stack (the dead list), live ones an alive list, and
+// the alive list is double-buffered: each frame emission pops slots off the dead list and appends them to
+// the current list, then the simulation walks the current list, pushes the particles that expired back on
+// the dead list and compacts the survivors into the other list, which is what gets drawn and what the next
+// frame starts from. A one-invocation pass between the steps turns the counts into the indirect dispatch
+// and draw arguments, so nothing is ever read back.
+// Particles draw as camera-facing quads, six vertices per alive particle instanced through draw(); see
+// particle.vert for the reading side of set_layout().
+class ParticleSystem
+{
+public:
+	// dispatches are 64 invocations wide and at most 65535 groups, which caps the pool at about 4M
+	static constexpr uint32_t MAX_CAPACITY = 65535 * 64;
+
+	// without all three shaders there are no pipelines and update() and draw() do nothing
+	void init(VkDevice device, VmaAllocator allocator, DescriptorAllocator& descriptors, uint32_t capacity,
+		VkShaderModule argsShader, VkShaderModule emitShader, VkShaderModule simulateShader, VkPipelineCache cache);
+	void cleanup();
+
+	bool ready() const { return _simulatePipeline != VK_NULL_HANDLE; }
+	uint32_t capacity() const { return _capacity; }
+
+	// the pool, both alive lists, the dead list and the counters, visible to compute and vertex shaders;
+	// the particle pipelines bind it as their set 1
+	VkDescriptorSetLayout set_layout() const { return _setLayout; }
+
+	// outside a render pass: advances every particle by deltaTime seconds and emits the emitter's share of
+	// them; the first call also fills the dead list. Makes the results visible to draw()'s indirect draw and
+	// vertex shader, and waits for the previous frame's draw before overwriting what it reads
+	void update(VkCommandBuffer cmd, const ParticleEmitter& emitter, float deltaTime);
+
+	// inside the render pass with a pipeline made from set_layout() as set 1 bound, set 0 already bound to
+	// layout: one indirect draw of the list the last update() left. Pushes the vertex shader's constants
+	void draw(VkCommandBuffer cmd, VkPipelineLayout layout, float size) const;
+
+private:
+	void dispatch(VkCommandBuffer cmd, VkPipeline pipeline, uint32_t mode, uint32_t groupCount);
+	void dispatch_indirect(VkCommandBuffer cmd, VkPipeline pipeline, VkDeviceSize argumentOffset);
+
+	VkDevice _device{ VK_NULL_HANDLE };
+	VmaAllocator _allocator{ nullptr };
+	uint32_t _capacity{ 0 };
+
+	VkDescriptorSetLayout _setLayout{ VK_NULL_HANDLE };
+	VkDescriptorSet _set{ VK_NULL_HANDLE };
+	VkPipelineLayout _pipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline _argsPipeline{ VK_NULL_HANDLE };
+	VkPipeline _emitPipeline{ VK_NULL_HANDLE };
+	VkPipeline _simulatePipeline{ VK_NULL_HANDLE };
+
+	AllocatedBuffer _particleBuffer{};
+	AllocatedBuffer _aliveBuffer{}; // both lists, capacity entries each
+	AllocatedBuffer _deadBuffer{};
+	AllocatedBuffer _counterBuffer{}; // counts and the indirect arguments, see ParticleCounters
+
+	// push constants of the next dispatch; update() fills in the emitter
+	struct PushConstants {
+		glm::vec4 emitterPosition; // w radius
+		glm::vec4 emitterDirection; // w cosine of the spread
+		glm::vec4 gravity; // w drag
+		float speed;
+		float lifetime;
+		float deltaTime;
+		uint32_t emitCount;
+		uint32_t capacity;
+		uint32_t current; // alive list emitted into and simulated from; the other receives the survivors
+		uint32_t seed;
+		uint32_t mode; // particleArgs.comp: 0 reset, 1 before emission, 2 after simulation
+	} _constants{};
+
+	bool _needsReset{ true };
+	float _emitCarry{ 0.0f }; // fraction of a particle the emission rate left over from the last update
+};
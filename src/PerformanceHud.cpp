@@ -0,0 +1,425 @@
+#include "PerformanceHud.h"
+
+#include "CpuProfiler.h"
+#include "vk_initializers.h"
+
+#include <imgui.h>
+#include <imgui_impl_sdl.h>
+
+#include <SDL.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+	uint64_t steady_ns()
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	float megabytes(VkDeviceSize bytes)
+	{
+		return static_cast<float>(bytes) / (1024.0f * 1024.0f);
+	}
+
+	static_assert(sizeof(ImDrawVert) == 20 && offsetof(ImDrawVert, uv) == 8 && offsetof(ImDrawVert, col) == 16,
+		"HUD_VERTEX_LAYOUT must match ImDrawVert");
+	constexpr VkIndexType HUD_INDEX_TYPE = sizeof(ImDrawIdx) == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
+
+void PerformanceHud::init(VkDevice device, VmaAllocator allocator, SDL_Window* window)
+{
+	_device = device;
+	_allocator = allocator;
+	_window = window;
+
+	IMGUI_CHECKVERSION();
+	ImGui::CreateContext();
+	ImGuiIO& io = ImGui::GetIO();
+	// nothing to remember between runs
+	io.IniFilename = nullptr;
+	// draws are recorded with vkCmdDrawIndexed's vertex offset, so lists past 64k vertices keep 16 bit indices
+	io.BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset;
+	ImGui::StyleColorsDark();
+	// the SDL backend only for input; the drawing is ours
+	ImGui_ImplSDL2_InitForVulkan(_window);
+
+	unsigned char* pixels = nullptr;
+	int width = 0, height = 0;
+	io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+	const VkExtent3D extent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1 };
+
+	VmaAllocationCreateInfo imageAllocInfo = {};
+	imageAllocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+	VkImageCreateInfo imageInfo = vkinit::image_create_info(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, extent);
+	VK_CHECK(vmaCreateImage(_allocator, &imageInfo, &imageAllocInfo, &_fontImage._image, &_fontImage._allocation, nullptr));
+
+	VkImageViewCreateInfo viewInfo = vkinit::imageview_create_info(VK_FORMAT_R8G8B8A8_UNORM, _fontImage._image, VK_IMAGE_ASPECT_COLOR_BIT);
+	VK_CHECK(vkCreateImageView(_device, &viewInfo, nullptr, &_fontView));
+
+	VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	VK_CHECK(vkCreateSampler(_device, &samplerInfo, nullptr, &_fontSampler));
+
+	VkDescriptorSetLayoutBinding binding = vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0);
+	VkDescriptorSetLayoutCreateInfo setInfo = {};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setInfo.pNext = nullptr;
+	setInfo.bindingCount = 1;
+	setInfo.pBindings = &binding;
+	VK_CHECK(vkCreateDescriptorSetLayout(_device, &setInfo, nullptr, &_setLayout));
+
+	// the font atlas is the only set the overlay ever binds
+	VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 };
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	VK_CHECK(vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_descriptorPool));
+
+	VkDescriptorSetAllocateInfo allocateInfo = {};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocateInfo.descriptorPool = _descriptorPool;
+	allocateInfo.descriptorSetCount = 1;
+	allocateInfo.pSetLayouts = &_setLayout;
+	VK_CHECK(vkAllocateDescriptorSets(_device, &allocateInfo, &_fontSet));
+	VkDescriptorImageInfo fontInfo = { _fontSampler, _fontView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	VkWriteDescriptorSet write = vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _fontSet, &fontInfo, 0);
+	vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+
+	const size_t byteSize = size_t(width) * height * 4;
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.pNext = nullptr;
+	bufferInfo.size = byteSize;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+	allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+	VmaAllocationInfo mappedInfo;
+	VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &allocInfo, &_fontStaging._buffer, &_fontStaging._allocation, &mappedInfo));
+	memcpy(mappedInfo.pMappedData, pixels, byteSize);
+	vmaFlushAllocation(_allocator, _fontStaging._allocation, 0, VK_WHOLE_SIZE);
+}
+
+void PerformanceHud::cleanup()
+{
+	if (!ready())
+	{
+		return;
+	}
+
+	ImGui_ImplSDL2_Shutdown();
+	ImGui::DestroyContext();
+
+	release_font_upload();
+	vkDestroyDescriptorPool(_device, _descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(_device, _setLayout, nullptr);
+	vkDestroySampler(_device, _fontSampler, nullptr);
+	vkDestroyImageView(_device, _fontView, nullptr);
+	vmaDestroyImage(_allocator, _fontImage._image, _fontImage._allocation);
+	_descriptorPool = VK_NULL_HANDLE;
+	_setLayout = VK_NULL_HANDLE;
+	_fontSet = VK_NULL_HANDLE;
+	_fontSampler = VK_NULL_HANDLE;
+	_fontView = VK_NULL_HANDLE;
+	_fontImage = {};
+}
+
+void PerformanceHud::upload_fonts(VkCommandBuffer cmd)
+{
+	int width = 0, height = 0;
+	unsigned char* pixels = nullptr;
+	ImGui::GetIO().Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+
+	VkImageMemoryBarrier barrier = vkinit::image_barrier(_fontImage._image, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	VkBufferImageCopy copy = {};
+	copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	copy.imageSubresource.mipLevel = 0;
+	copy.imageSubresource.baseArrayLayer = 0;
+	copy.imageSubresource.layerCount = 1;
+	copy.imageExtent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1 };
+	vkCmdCopyBufferToImage(cmd, _fontStaging._buffer, _fontImage._image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void PerformanceHud::release_font_upload()
+{
+	if (_fontStaging._buffer != VK_NULL_HANDLE)
+	{
+		vmaDestroyBuffer(_allocator, _fontStaging._buffer, _fontStaging._allocation);
+		_fontStaging = {};
+	}
+}
+
+bool PerformanceHud::process_event(const SDL_Event& event)
+{
+	if (!_visible)
+	{
+		return false;
+	}
+
+	ImGui_ImplSDL2_ProcessEvent(&event);
+	const ImGuiIO& io = ImGui::GetIO();
+	switch (event.type)
+	{
+	case SDL_MOUSEBUTTONDOWN:
+	case SDL_MOUSEBUTTONUP:
+	case SDL_MOUSEWHEEL:
+		return io.WantCaptureMouse;
+	case SDL_KEYDOWN:
+	case SDL_KEYUP:
+		return io.WantCaptureKeyboard;
+	default:
+		return false;
+	}
+}
+
+void PerformanceHud::prepare(const Stats& stats)
+{
+	heap_stats::Scope heapScope(HeapTag::Hud);
+	_prepared = false;
+	// frame times keep being sampled while hidden, so the graph has history the moment it's shown
+	const cpu_profiler::FrameTotals& cpu = cpu_profiler::latest();
+	if (cpu.frameNumber != _lastCpuFrame && cpu.frameNumber >= 0)
+	{
+		_lastCpuFrame = cpu.frameNumber;
+		_frameTimes[_frameTimeCursor] = static_cast<float>(cpu.milliseconds);
+		_frameTimeCursor = (_frameTimeCursor + 1) % HISTORY_SIZE;
+	}
+
+	const uint64_t now = steady_ns();
+	if (_jobWindowStartNs == 0)
+	{
+		_jobWindowStartNs = now;
+		_jobWindowBusyNs = stats.jobBusyNs;
+	}
+	else if (now - _jobWindowStartNs >= 500000000ull)
+	{
+		const double capacity = static_cast<double>(now - _jobWindowStartNs) * std::max(stats.jobThreads, 1u);
+		_jobUtilization = static_cast<float>(static_cast<double>(stats.jobBusyNs - _jobWindowBusyNs) / capacity);
+		_jobWindowStartNs = now;
+		_jobWindowBusyNs = stats.jobBusyNs;
+	}
+
+	if (!_visible || !ready())
+	{
+		return;
+	}
+
+	ImGui_ImplSDL2_NewFrame(_window);
+	ImGui::NewFrame();
+	build_windows(stats);
+	ImGui::Render();
+	_prepared = true;
+}
+
+void PerformanceHud::draw(VkCommandBuffer cmd, VkPipelineLayout layout, GpuLinearAllocator& ring, VkExtent2D extent)
+{
+	const ImDrawData* drawData = ImGui::GetDrawData();
+	if (!_prepared || drawData == nullptr || drawData->TotalVtxCount == 0)
+	{
+		return;
+	}
+	_prepared = false;
+
+	// every list into one vertex and one index allocation; a frame too big for the ring goes without the overlay
+	const VkDeviceSize vertexBytes = VkDeviceSize(drawData->TotalVtxCount) * sizeof(ImDrawVert);
+	const VkDeviceSize indexBytes = VkDeviceSize(drawData->TotalIdxCount) * sizeof(ImDrawIdx);
+	GpuAllocation vertices, indices;
+	if (!ring.allocate(vertexBytes, alignof(ImDrawVert), &vertices) || !ring.allocate(indexBytes, sizeof(uint32_t), &indices))
+	{
+		return;
+	}
+	uint8_t* vertexData = static_cast<uint8_t*>(vertices.data);
+	uint8_t* indexData = static_cast<uint8_t*>(indices.data);
+	for (int i = 0; i < drawData->CmdListsCount; i++)
+	{
+		const ImDrawList* list = drawData->CmdLists[i];
+		memcpy(vertexData, list->VtxBuffer.Data, list->VtxBuffer.Size * sizeof(ImDrawVert));
+		memcpy(indexData, list->IdxBuffer.Data, list->IdxBuffer.Size * sizeof(ImDrawIdx));
+		vertexData += list->VtxBuffer.Size * sizeof(ImDrawVert);
+		indexData += list->IdxBuffer.Size * sizeof(ImDrawIdx);
+	}
+
+	vkCmdBindVertexBuffers(cmd, 0, 1, &vertices.buffer, &vertices.offset);
+	vkCmdBindIndexBuffer(cmd, indices.buffer, indices.offset, HUD_INDEX_TYPE);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1, &_fontSet, 0, nullptr);
+
+	VkViewport viewport = { 0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f };
+	vkCmdSetViewport(cmd, 0, 1, &viewport);
+	HudPushConstants constants;
+	constants.scale = glm::vec2(2.0f / drawData->DisplaySize.x, 2.0f / drawData->DisplaySize.y);
+	constants.translate = glm::vec2(-1.0f - drawData->DisplayPos.x * constants.scale.x, -1.0f - drawData->DisplayPos.y * constants.scale.y);
+	vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(HudPushConstants), &constants);
+
+	// window coordinates to the image's pixels, for the scissors
+	const ImVec2 clipOffset = drawData->DisplayPos;
+	const ImVec2 clipScale = drawData->FramebufferScale;
+	uint32_t vertexOffset = 0;
+	uint32_t indexOffset = 0;
+	for (int i = 0; i < drawData->CmdListsCount; i++)
+	{
+		const ImDrawList* list = drawData->CmdLists[i];
+		for (int c = 0; c < list->CmdBuffer.Size; c++)
+		{
+			const ImDrawCmd& command = list->CmdBuffer[c];
+			// the HUD's windows add no callbacks, and every command samples the font atlas
+			if (command.UserCallback != nullptr)
+			{
+				continue;
+			}
+			const float left = std::max((command.ClipRect.x - clipOffset.x) * clipScale.x, 0.0f);
+			const float top = std::max((command.ClipRect.y - clipOffset.y) * clipScale.y, 0.0f);
+			const float right = std::min((command.ClipRect.z - clipOffset.x) * clipScale.x, static_cast<float>(extent.width));
+			const float bottom = std::min((command.ClipRect.w - clipOffset.y) * clipScale.y, static_cast<float>(extent.height));
+			if (right <= left || bottom <= top)
+			{
+				continue;
+			}
+			VkRect2D scissor;
+			scissor.offset = { static_cast<int32_t>(left), static_cast<int32_t>(top) };
+			scissor.extent = { static_cast<uint32_t>(right - left), static_cast<uint32_t>(bottom - top) };
+			vkCmdSetScissor(cmd, 0, 1, &scissor);
+			vkCmdDrawIndexed(cmd, command.ElemCount, 1, indexOffset + command.IdxOffset, static_cast<int32_t>(vertexOffset + command.VtxOffset), 0);
+		}
+		vertexOffset += list->VtxBuffer.Size;
+		indexOffset += list->IdxBuffer.Size;
+	}
+}
+
+void PerformanceHud::build_windows(const Stats& stats)
+{
+	ImGui::SetNextWindowPos(ImVec2(10.0f, 10.0f), ImGuiCond_FirstUseEver);
+	ImGui::SetNextWindowBgAlpha(0.75f);
+	if (!ImGui::Begin("Performance", nullptr, ImGuiWindowFlags_AlwaysAutoResize))
+	{
+		ImGui::End();
+		return;
+	}
+
+	// oldest first, so the graph scrolls right to left
+	float history[HISTORY_SIZE];
+	float worst = 0.0f;
+	float total = 0.0f;
+	for (uint32_t i = 0; i < HISTORY_SIZE; i++)
+	{
+		history[i] = _frameTimes[(_frameTimeCursor + i) % HISTORY_SIZE];
+		worst = std::max(worst, history[i]);
+		total += history[i];
+	}
+	const float average = total / HISTORY_SIZE;
+	ImGui::Text("CPU frame %.2f ms (avg %.2f, max %.2f)", _frameTimes[(_frameTimeCursor + HISTORY_SIZE - 1) % HISTORY_SIZE], average, worst);
+	ImGui::PlotLines("##cpu", history, HISTORY_SIZE, 0, nullptr, 0.0f, std::max(worst * 1.1f, 1.0f), ImVec2(320.0f, 60.0f));
+
+	ImGui::Text("Present mode %s, %ux%u rendered", stats.presentMode, stats.renderExtent.width, stats.renderExtent.height);
+	if (stats.instances > 1)
+	{
+		ImGui::Text("Crowd of %u instances", stats.instances);
+	}
+	else
+	{
+		ImGui::Text(stats.gpuCulled ? "%u objects sent to GPU culling" : "%u objects drawn", stats.objects);
+	}
+
+	const FrameStats& commands = *stats.commands;
+	ImGui::Text("%u draws, %u pipeline binds, %u vertex buffer binds, %u push constants", commands.drawCalls,
+		commands.pipelineBinds, commands.vertexBufferBinds, commands.pushConstantUploads);
+	ImGui::Text("%.1f KB uploaded", static_cast<float>(commands.uploadBytes) / 1024.0f);
+
+	// shadow cascades included. Submitted counts indirect draws before the cull shader; input assembly is
+	// what survived it, clipping what was left of that in view
+	const GpuProfiler::FrameTimings& gpu = *stats.gpu;
+	ImGui::Text("Triangles %llu submitted", static_cast<unsigned long long>(commands.trianglesSubmitted));
+	if (gpu.hasStatistics)
+	{
+		ImGui::Text("Triangles %llu drawn, %llu after clipping",
+			static_cast<unsigned long long>(gpu.statistics.inputAssemblyPrimitives),
+			static_cast<unsigned long long>(gpu.statistics.clippingPrimitives));
+	}
+
+	// a few frames old, like the GPU timings
+	if (stats.overdraw != nullptr && stats.overdraw->frameNumber >= 0)
+	{
+		const OverdrawView::Averages& overdraw = *stats.overdraw;
+		ImGui::Text("Overdraw %.2f fragments per pixel, %.2f where covered", overdraw.fragmentsPerPixel, overdraw.fragmentsPerCoveredPixel);
+		if (overdraw.quadEfficiency >= 0.f)
+		{
+			ImGui::Text("Quad efficiency %.0f%%", overdraw.quadEfficiency * 100.0f);
+		}
+	}
+
+	if (ImGui::CollapsingHeader("GPU passes", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		if (gpu.frameNumber < 0)
+		{
+			ImGui::TextUnformatted("no timings yet");
+		}
+		for (const GpuProfiler::ScopeTiming& scope : gpu.scopes)
+		{
+			ImGui::Text("%-20s %7.3f ms", scope.name.c_str(), scope.milliseconds);
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Memory", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		for (uint32_t i = 0; i < stats.memory->heap_count(); i++)
+		{
+			const GpuMemory::HeapBudget& heap = stats.memory->heap(i);
+			if (heap.budget == 0)
+			{
+				continue;
+			}
+			const float fraction = static_cast<float>(heap.usage) / static_cast<float>(heap.budget);
+			char overlay[64];
+			snprintf(overlay, sizeof(overlay), "%.0f / %.0f MB", megabytes(heap.usage), megabytes(heap.budget));
+			ImGui::Text("Heap %u%s", i, heap.deviceLocal ? " (device local)" : "");
+			ImGui::ProgressBar(std::min(fraction, 1.0f), ImVec2(320.0f, 0.0f), overlay);
+		}
+	}
+
+	// the goal is a steady state of nothing here; the overlay's own count under hud
+	if (ImGui::CollapsingHeader("CPU heap", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		const heap_stats::TagCounts total = stats.heap->total();
+		ImGui::Text("%llu allocations, %.1f KB last frame", static_cast<unsigned long long>(total.allocations), total.bytes / 1024.0);
+		for (uint32_t tag = 0; tag < static_cast<uint32_t>(HeapTag::Count); tag++)
+		{
+			const heap_stats::TagCounts& counts = stats.heap->tags[tag];
+			if (counts.allocations > 0)
+			{
+				ImGui::Text("  %-16s %6llu %9.1f KB", HEAP_TAG_NAMES[tag], static_cast<unsigned long long>(counts.allocations), counts.bytes / 1024.0);
+			}
+		}
+	}
+
+	// starts closed, being long; what a pipeline's driver doesn't report shows as -1
+	if (stats.shaders != nullptr && ImGui::CollapsingHeader("Shaders"))
+	{
+		for (const ShaderStatistics::Pipeline& pipeline : *stats.shaders)
+		{
+			for (const ShaderStatistics::Executable& executable : pipeline.executables)
+			{
+				const ImVec4 color = executable.spills > 0 ? ImVec4(1.0f, 0.4f, 0.3f, 1.0f) : ImGui::GetStyleColorVec4(ImGuiCol_Text);
+				ImGui::TextColored(color, "%-24s %-10s %4lld regs %4lld spills %6lld instr", pipeline.name, executable.stages.c_str(),
+					static_cast<long long>(executable.registers), static_cast<long long>(executable.spills),
+					static_cast<long long>(executable.instructions));
+			}
+		}
+	}
+
+	ImGui::Text("Jobs: %.0f%% of %u threads busy", _jobUtilization * 100.0f, stats.jobThreads);
+	ImGui::End();
+}
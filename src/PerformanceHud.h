@@ -0,0 +1,113 @@
+#pragma once
+
+#include <vk_types.h>
+#include <DeletionQueue.h>
+#include <GpuLinearAllocator.h>
+#include <GpuMemory.h>
+#include <GpuProfiler.h>
+#include <HeapStats.h>
+#include <FrameStats.h>
+#include <ShaderStatistics.h>
+#include <OverdrawView.h>
+#include <VertexLayout.h>
+
+#include <cstdint>
+#include <vector>
+#include <glm/vec2.hpp>
+
+union SDL_Event;
+struct SDL_Window;
+
+// imgui's ImDrawVert as hud.vert reads it: position and uv, the color read as 0..1 floats
+constexpr auto HUD_VERTEX_LAYOUT = vertex_layout(
+	{ vertex_binding(0, 20) },
+	{ vertex_attribute(0, 0, VK_FORMAT_R32G32_SFLOAT, 0), vertex_attribute(1, 0, VK_FORMAT_R32G32_SFLOAT, 8),
+		vertex_attribute(2, 0, VK_FORMAT_R8G8B8A8_UNORM, 16) });
+
+// hud.vert's push constants: window pixels to clip space
+struct HudPushConstants {
+	glm::vec2 scale;
+	glm::vec2 translate;
+};
+
+// On-screen overlay of the numbers the profilers otherwise only log: CPU frame time history, GPU pass
+// timings, draw and triangle counts, present mode, heap budgets and job system load. Built with imgui and
+// drawn by a renderer of its own rather than imgui's Vulkan backend, whose vertex buffers are recreated as
+// the UI grows: the frame's vertices and indices go into the engine's per-frame ring, and the draws are
+// recorded by a pass of the frame graph over the swapchain image, so the overlay never allocates a buffer or
+// needs a render pass or submission of its own, and costs nothing but a few draws when shown.
+class PerformanceHud
+{
+public:
+	// what the engine measured for the frame being recorded
+	struct Stats {
+		const char* presentMode;
+		const GpuProfiler::FrameTimings* gpu; // a few frames old
+		const GpuMemory* memory;
+		const FrameStats* commands; // of the last finished frame
+		uint32_t objects;   // render objects drawn, or handed to GPU culling when gpuCulled
+		bool gpuCulled;
+		uint32_t instances; // crowd instances, drawn instead of the render list when more than 1
+		VkExtent2D renderExtent;
+		uint64_t jobBusyNs; // JobSystem::busy_ns()
+		unsigned jobThreads;
+		const std::vector<ShaderStatistics::Pipeline>* shaders; // null unless statistics were captured
+		const OverdrawView::Averages* overdraw; // null unless the frame drew the overdraw view
+		const heap_stats::Snapshot* heap; // the last draw()'s CPU heap allocations by tag
+	};
+
+	// the font atlas is uploaded separately
+	void init(VkDevice device, VmaAllocator allocator, SDL_Window* window);
+	// the GPU must be done with every frame that drew the overlay
+	void cleanup();
+
+	bool ready() const { return _fontImage._image != VK_NULL_HANDLE; }
+
+	// the font atlas and its sampler at binding 0; the overlay pipeline binds it as set 0
+	VkDescriptorSetLayout set_layout() const { return _setLayout; }
+
+	// records the font atlas upload; release_font_upload() once it has executed
+	void upload_fonts(VkCommandBuffer cmd);
+	void release_font_upload();
+
+	// mouse and keyboard for the overlay's windows; true if imgui wants the event for itself
+	bool process_event(const SDL_Event& event);
+
+	void set_visible(bool visible) { _visible = visible; }
+	bool visible() const { return _visible; }
+
+	// every frame before the graph executes, so the frame time history keeps filling while hidden; builds
+	// the windows when shown
+	void prepare(const Stats& stats);
+	// inside a pass over the swapchain image with the overlay pipeline bound: copies what prepare() built
+	// into ring and draws it, a draw per imgui command clipped to its rectangle
+	void draw(VkCommandBuffer cmd, VkPipelineLayout layout, GpuLinearAllocator& ring, VkExtent2D extent);
+
+private:
+	// CPU frame times kept for the graph
+	static constexpr uint32_t HISTORY_SIZE = 240;
+
+	void build_windows(const Stats& stats);
+
+	VkDevice _device{ VK_NULL_HANDLE };
+	VmaAllocator _allocator{ nullptr };
+	SDL_Window* _window{ nullptr };
+	AllocatedImage _fontImage{};
+	VkImageView _fontView{ VK_NULL_HANDLE };
+	VkSampler _fontSampler{ VK_NULL_HANDLE };
+	AllocatedBuffer _fontStaging{}; // until release_font_upload
+	VkDescriptorPool _descriptorPool{ VK_NULL_HANDLE };
+	VkDescriptorSetLayout _setLayout{ VK_NULL_HANDLE };
+	VkDescriptorSet _fontSet{ VK_NULL_HANDLE };
+	bool _visible{ false };
+	bool _prepared{ false }; // prepare() built draw data this frame
+
+	float _frameTimes[HISTORY_SIZE]{};
+	uint32_t _frameTimeCursor{ 0 };
+	int64_t _lastCpuFrame{ -1 };
+
+	// job load averaged over windows of about half a second
+	uint64_t _jobWindowStartNs{ 0 };
+	uint64_t _jobWindowBusyNs{ 0 };
+	float _jobUtilization{ 0.0f };
+};
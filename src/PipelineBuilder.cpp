@@ -1,6 +1,10 @@
 #include "PipelineBuilder.h"
 
-#include <iostream>
+#include "HeapStats.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cstring>
 #include <vector>
 #include <fstream>
 
@@ -14,18 +18,121 @@
 
 #include "VkBootstrap.h"
 
-VkPipeline PipelineBuilder::build_pipeline(VkDevice device, VkRenderPass pass)
+PipelineDescription PipelineBuilder::describe(VkRenderPass pass, uint32_t subpass) const
+{
+	PipelineDescription description;
+
+	description.shaderStages = _shaderStages;
+	description.specializations.assign(_specializations.begin(),
+		_specializations.begin() + std::min(_specializations.size(), _shaderStages.size()));
+
+	// the builder's vertex input info usually points at a VertexInputDescription owned by the caller
+	// copy the arrays so the description stays valid after that goes out of scope
+	description.vertexInputInfo = _vertexInputInfo;
+	if (_vertexInputInfo.vertexBindingDescriptionCount > 0)
+	{
+		description.vertexBindings.assign(
+			_vertexInputInfo.pVertexBindingDescriptions,
+			_vertexInputInfo.pVertexBindingDescriptions + _vertexInputInfo.vertexBindingDescriptionCount);
+	}
+	if (_vertexInputInfo.vertexAttributeDescriptionCount > 0)
+	{
+		description.vertexAttributes.assign(
+			_vertexInputInfo.pVertexAttributeDescriptions,
+			_vertexInputInfo.pVertexAttributeDescriptions + _vertexInputInfo.vertexAttributeDescriptionCount);
+	}
+
+	description.inputAssembly = _inputAssembly;
+	description.viewport = _viewport;
+	description.scissor = _scissor;
+	description.rasterizer = _rasterizer;
+	description.colorBlendAttachment = _colorBlendAttachment;
+	description.colorAttachmentCount = _colorAttachmentCount;
+	description.multisampling = _multisampling;
+	description.depthStencil = _depthStencil;
+	description.pipelineLayout = _pipelineLayout;
+	description.renderPass = pass;
+	description.subpass = subpass;
+	description.depthFormat = VK_FORMAT_UNDEFINED;
+	description.viewMask = 0;
+	description.dynamicDrawState = _dynamicDrawState;
+	description.shadingRate = _shadingRate;
+	description.shadingRateAttachment = _shadingRateAttachment;
+	description.captureStatistics = _captureStatistics;
+
+	return description;
+}
+
+PipelineDescription PipelineBuilder::describe_dynamic(const VkFormat* colorFormats, VkFormat depthFormat) const
+{
+	PipelineDescription description = describe(VK_NULL_HANDLE);
+	description.colorFormats.assign(colorFormats, colorFormats + _colorAttachmentCount);
+	description.depthFormat = depthFormat;
+	return description;
+}
+
+VkPipeline PipelineBuilder::build_pipeline(VkDevice device, VkRenderPass pass, VkPipelineCache cache)
+{
+	return describe(pass).compile(device, cache);
+}
+
+std::future<VkPipeline> PipelineBuilder::build_pipeline_async(VkDevice device, PipelineDescription description, VkPipelineCache cache)
+{
+	return std::async(std::launch::async, [device, cache, description = std::move(description)]() {
+		return description.compile(device, cache);
+	});
+}
+
+VkPipeline PipelineDescription::compile(VkDevice device, VkPipelineCache cache) const
+{
+	return create(device, cache, AllParts);
+}
+
+bool PipelineDescription::linkable() const
+{
+	for (const VkPipelineShaderStageCreateInfo& stage : shaderStages)
+	{
+		if (stage.stage != VK_SHADER_STAGE_VERTEX_BIT && stage.stage != VK_SHADER_STAGE_FRAGMENT_BIT)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+VkPipeline PipelineDescription::compile_library(VkDevice device, VkPipelineCache cache, uint32_t part) const
+{
+	return create(device, cache, part);
+}
+
+// the part a stage's create info belongs to
+static uint32_t stage_part(VkShaderStageFlagBits stage)
+{
+	return stage == VK_SHADER_STAGE_FRAGMENT_BIT ? PipelineDescription::FragmentShaderPart : PipelineDescription::PreRasterizationPart;
+}
+
+VkPipeline PipelineDescription::create(VkDevice device, VkPipelineCache cache, uint32_t parts) const
 {
-	// make viewport state from our stored viewport and scissor
+	// on std::async's threads as often as not, which start untagged
+	heap_stats::Scope heapScope(HeapTag::Pipelines);
+	// point the vertex input state at our own copies of the arrays
+	VkPipelineVertexInputStateCreateInfo vertexInput = vertexInputInfo;
+	vertexInput.vertexBindingDescriptionCount = static_cast<uint32_t>(vertexBindings.size());
+	vertexInput.pVertexBindingDescriptions = vertexBindings.data();
+	vertexInput.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexAttributes.size());
+	vertexInput.pVertexAttributeDescriptions = vertexAttributes.data();
+
+	// viewport and scissor are dynamic so pipelines survive swapchain resizes;
+	// the stored values are ignored by the driver, only the counts matter
 	// only supports 1 of each for now
 	VkPipelineViewportStateCreateInfo viewportState = {};
 	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 	viewportState.pNext = nullptr;
 
 	viewportState.viewportCount = 1;
-	viewportState.pViewports = &_viewport;
+	viewportState.pViewports = &viewport;
 	viewportState.scissorCount = 1;
-	viewportState.pScissors = &_scissor;
+	viewportState.pScissors = &scissor;
 
 	// setup color blending 
 	// just overwriting for now 
@@ -35,39 +142,403 @@ VkPipeline PipelineBuilder::build_pipeline(VkDevice device, VkRenderPass pass)
 
 	colorBlending.logicOpEnable = VK_FALSE;
 	colorBlending.logicOp = VK_LOGIC_OP_COPY;
-	// attachments must match fragment shader outputs
-	colorBlending.attachmentCount = 1;
-	colorBlending.pAttachments = &_colorBlendAttachment;
+	// attachments must match fragment shader outputs; every one blends the same way, so no pass needs the
+	// independentBlend feature
+	const std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments(colorAttachmentCount, colorBlendAttachment);
+	colorBlending.attachmentCount = colorAttachmentCount;
+	colorBlending.pAttachments = colorBlendAttachments.data();
+
+	// libraries get the whole list too; the driver ignores what isn't part of their state
+	std::vector<VkDynamicState> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+#ifdef VK_EXT_extended_dynamic_state
+	if (dynamicDrawState)
+	{
+		dynamicStates.insert(dynamicStates.end(), {
+			VK_DYNAMIC_STATE_CULL_MODE_EXT,
+			VK_DYNAMIC_STATE_FRONT_FACE_EXT,
+			VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT,
+			VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT,
+			VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT,
+			VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT,
+		});
+	}
+#endif
+#ifdef VK_KHR_fragment_shading_rate
+	if (shadingRate)
+	{
+		dynamicStates.push_back(VK_DYNAMIC_STATE_FRAGMENT_SHADING_RATE_KHR);
+	}
+#endif
+	VkPipelineDynamicStateCreateInfo dynamicState = {};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.pNext = nullptr;
+	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+	dynamicState.pDynamicStates = dynamicStates.data();
+
+	// point the stages at our own specialization data
+	std::vector<VkPipelineShaderStageCreateInfo> stages = shaderStages;
+	std::vector<VkSpecializationInfo> specializationInfos(specializations.size());
+	for (size_t i = 0; i < stages.size(); i++)
+	{
+		stages[i].pSpecializationInfo = nullptr;
+		if (i < specializations.size() && !specializations[i].empty())
+		{
+			specializationInfos[i].mapEntryCount = static_cast<uint32_t>(specializations[i].entries.size());
+			specializationInfos[i].pMapEntries = specializations[i].entries.data();
+			specializationInfos[i].dataSize = specializations[i].data.size();
+			specializationInfos[i].pData = specializations[i].data.data();
+			stages[i].pSpecializationInfo = &specializationInfos[i];
+		}
+	}
+	// a library only compiles the stages of its own part
+	stages.erase(std::remove_if(stages.begin(), stages.end(), [parts](const VkPipelineShaderStageCreateInfo& stage) {
+		return (stage_part(stage.stage) & parts) == 0;
+	}), stages.end());
 
 	// build actual pipeline
 	VkGraphicsPipelineCreateInfo pipelineInfo = {};
 	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
 	pipelineInfo.pNext = nullptr;
 
-	pipelineInfo.stageCount = _shaderStages.size();
-	pipelineInfo.pStages = _shaderStages.data();
-	pipelineInfo.pVertexInputState = &_vertexInputInfo;
-	pipelineInfo.pInputAssemblyState = &_inputAssembly;
+#ifdef VK_KHR_dynamic_rendering
+	// without a render pass the attachment formats come from here
+	VkPipelineRenderingCreateInfoKHR renderingInfo = {};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+	renderingInfo.pNext = nullptr;
+	renderingInfo.colorAttachmentCount = static_cast<uint32_t>(colorFormats.size());
+	renderingInfo.pColorAttachmentFormats = colorFormats.data();
+	renderingInfo.depthAttachmentFormat = depthFormat;
+	renderingInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+	renderingInfo.viewMask = viewMask;
+	if (renderPass == VK_NULL_HANDLE)
+	{
+		pipelineInfo.pNext = &renderingInfo;
+	}
+#endif
+
+	pipelineInfo.stageCount = static_cast<uint32_t>(stages.size());
+	pipelineInfo.pStages = stages.data();
+	pipelineInfo.pVertexInputState = &vertexInput;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
 	pipelineInfo.pViewportState = &viewportState;
-	pipelineInfo.pRasterizationState = &_rasterizer;
-	pipelineInfo.pMultisampleState = &_multisampling;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState = &multisampling;
 	pipelineInfo.pColorBlendState = &colorBlending;
-	pipelineInfo.layout = _pipelineLayout;
-	pipelineInfo.renderPass = pass;
-	pipelineInfo.subpass = 0; // might want to make this a parameter in the future for shaders w multiple passes
+	pipelineInfo.layout = pipelineLayout;
+	pipelineInfo.renderPass = renderPass;
+	pipelineInfo.subpass = subpass;
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-	pipelineInfo.pDepthStencilState = &_depthStencil;
+	pipelineInfo.pDepthStencilState = &depthStencil;
+	pipelineInfo.pDynamicState = &dynamicState;
+#if defined(VK_KHR_fragment_shading_rate) && defined(VK_KHR_dynamic_rendering)
+	if (shadingRateAttachment && renderPass == VK_NULL_HANDLE)
+	{
+		pipelineInfo.flags |= VK_PIPELINE_CREATE_RENDERING_FRAGMENT_SHADING_RATE_ATTACHMENT_BIT_KHR;
+	}
+#endif
+#ifdef VK_KHR_pipeline_executable_properties
+	if (captureStatistics)
+	{
+		pipelineInfo.flags |= VK_PIPELINE_CREATE_CAPTURE_STATISTICS_BIT_KHR;
+	}
+#endif
+
+#ifdef VK_EXT_graphics_pipeline_library
+	VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo = {};
+	if (parts != AllParts)
+	{
+		libraryInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+		libraryInfo.pNext = pipelineInfo.pNext;
+		libraryInfo.flags = parts;
+		pipelineInfo.pNext = &libraryInfo;
+		pipelineInfo.flags |= VK_PIPELINE_CREATE_LIBRARY_BIT_KHR;
+
+		// state outside the library's parts is ignored; leave it out so a library never depends on it
+		if ((parts & VertexInputPart) == 0)
+		{
+			pipelineInfo.pVertexInputState = nullptr;
+			pipelineInfo.pInputAssemblyState = nullptr;
+		}
+		if ((parts & PreRasterizationPart) == 0)
+		{
+			pipelineInfo.pViewportState = nullptr;
+			pipelineInfo.pRasterizationState = nullptr;
+		}
+		if ((parts & FragmentShaderPart) == 0)
+		{
+			pipelineInfo.pDepthStencilState = nullptr;
+		}
+		if ((parts & (FragmentShaderPart | FragmentOutputPart)) == 0)
+		{
+			pipelineInfo.pMultisampleState = nullptr;
+		}
+		if ((parts & FragmentOutputPart) == 0)
+		{
+			pipelineInfo.pColorBlendState = nullptr;
+		}
+		if ((parts & (PreRasterizationPart | FragmentShaderPart)) == 0)
+		{
+			pipelineInfo.layout = VK_NULL_HANDLE;
+		}
+	}
+#else
+	if (parts != AllParts)
+	{
+		return VK_NULL_HANDLE;
+	}
+#endif
 
 	// use VK_CHECK a little more sophisticated..ly... here 
 	VkPipeline newPipeline;
 	if (vkCreateGraphicsPipelines(
-		device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &newPipeline) != VK_SUCCESS
+		device, cache, 1, &pipelineInfo, nullptr, &newPipeline) != VK_SUCCESS
 	) {
-		std::cout << "failed to create pipeline\n";
+		LOG_ERROR("failed to create pipeline");
 		return VK_NULL_HANDLE;
 	}
 	else
 	{
 		return newPipeline;
 	}
-}
\ No newline at end of file
+}
+
+VkPipeline PipelineDescription::link(VkDevice device, VkPipelineCache cache, VkPipelineLayout layout, const VkPipeline* libraries, uint32_t libraryCount)
+{
+#ifdef VK_EXT_graphics_pipeline_library
+	VkPipelineLibraryCreateInfoKHR libraryInfo = {};
+	libraryInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+	libraryInfo.pNext = nullptr;
+	libraryInfo.libraryCount = libraryCount;
+	libraryInfo.pLibraries = libraries;
+
+	// everything else comes from the libraries
+	VkGraphicsPipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.pNext = &libraryInfo;
+	pipelineInfo.layout = layout;
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+	VkPipeline newPipeline;
+	if (vkCreateGraphicsPipelines(device, cache, 1, &pipelineInfo, nullptr, &newPipeline) != VK_SUCCESS)
+	{
+		LOG_ERROR("failed to link pipeline");
+		return VK_NULL_HANDLE;
+	}
+	return newPipeline;
+#else
+	return VK_NULL_HANDLE;
+#endif
+}
+
+static uint32_t topology_class(VkPrimitiveTopology topology)
+{
+	switch (topology)
+	{
+	case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+		return 0;
+	case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+	case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+	case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+	case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+		return 1;
+	case VK_PRIMITIVE_TOPOLOGY_PATCH_LIST:
+		return 3;
+	default:
+		return 2;
+	}
+}
+
+std::vector<uint32_t> PipelineDescription::key() const
+{
+	std::vector<uint32_t> key;
+	key.reserve(128);
+	append_key(key, AllParts);
+	return key;
+}
+
+PipelineDescription PipelineDescription::unspecialized(VkShaderStageFlags stages) const
+{
+	PipelineDescription generic = *this;
+	for (size_t i = 0; i < generic.specializations.size(); i++)
+	{
+		if ((generic.shaderStages[i].stage & stages) != 0)
+		{
+			generic.specializations[i] = ShaderSpecialization();
+		}
+	}
+	return generic;
+}
+
+std::vector<uint32_t> PipelineDescription::library_key(uint32_t part) const
+{
+	std::vector<uint32_t> key;
+	key.reserve(64);
+	append_key(key, part);
+	return key;
+}
+
+void PipelineDescription::append_key(std::vector<uint32_t>& key, uint32_t parts) const
+{
+	auto add = [&](uint32_t value) { key.push_back(value); };
+	auto add_float = [&](float value) {
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		key.push_back(bits);
+	};
+	auto add_handle = [&](auto handle) {
+		const uint64_t value = reinterpret_cast<uint64_t>(handle);
+		key.push_back(static_cast<uint32_t>(value));
+		key.push_back(static_cast<uint32_t>(value >> 32));
+	};
+	auto add_stencil = [&](const VkStencilOpState& state) {
+		add(state.failOp);
+		add(state.passOp);
+		add(state.depthFailOp);
+		add(state.compareOp);
+		add(state.compareMask);
+		add(state.writeMask);
+		add(state.reference);
+	};
+
+	add(parts);
+	add(dynamicDrawState);
+	add(shadingRate);
+	add(shadingRateAttachment && renderPass == VK_NULL_HANDLE);
+	add(captureStatistics);
+
+	// counts first, so arrays of different lengths can't flatten to the same words
+	uint32_t stageCount = 0;
+	for (const VkPipelineShaderStageCreateInfo& stage : shaderStages)
+	{
+		stageCount += (stage_part(stage.stage) & parts) != 0 ? 1 : 0;
+	}
+	add(stageCount);
+	for (size_t i = 0; i < shaderStages.size(); i++)
+	{
+		const VkPipelineShaderStageCreateInfo& stage = shaderStages[i];
+		if ((stage_part(stage.stage) & parts) == 0)
+		{
+			continue;
+		}
+		add(stage.stage);
+		add_handle(stage.module);
+		for (const char* name = stage.pName; *name != '\0'; name++)
+		{
+			add(static_cast<uint32_t>(*name));
+		}
+		add(0);
+
+		// no specialization and an empty one compile the same
+		const ShaderSpecialization empty;
+		const ShaderSpecialization& specialization = i < specializations.size() ? specializations[i] : empty;
+		add(static_cast<uint32_t>(specialization.entries.size()));
+		for (const VkSpecializationMapEntry& entry : specialization.entries)
+		{
+			add(entry.constantID);
+			add(entry.offset);
+			add(static_cast<uint32_t>(entry.size));
+		}
+		add(static_cast<uint32_t>(specialization.data.size()));
+		for (uint8_t byte : specialization.data)
+		{
+			add(byte);
+		}
+	}
+
+	if ((parts & VertexInputPart) != 0)
+	{
+		add(static_cast<uint32_t>(vertexBindings.size()));
+		for (const VkVertexInputBindingDescription& binding : vertexBindings)
+		{
+			add(binding.binding);
+			add(binding.stride);
+			add(binding.inputRate);
+		}
+		add(static_cast<uint32_t>(vertexAttributes.size()));
+		for (const VkVertexInputAttributeDescription& attribute : vertexAttributes)
+		{
+			add(attribute.location);
+			add(attribute.binding);
+			add(attribute.format);
+			add(attribute.offset);
+		}
+		add(vertexInputInfo.flags);
+
+		// dynamic draw state still bakes the topology class: points, lines, triangles or patches
+		add(dynamicDrawState ? topology_class(inputAssembly.topology) : inputAssembly.topology);
+		add(inputAssembly.primitiveRestartEnable);
+	}
+
+	if ((parts & PreRasterizationPart) != 0)
+	{
+		add(rasterizer.depthClampEnable);
+		add(rasterizer.rasterizerDiscardEnable);
+		add(rasterizer.polygonMode);
+		if (!dynamicDrawState)
+		{
+			add(rasterizer.cullMode);
+			add(rasterizer.frontFace);
+		}
+		add(rasterizer.depthBiasEnable);
+		add_float(rasterizer.depthBiasConstantFactor);
+		add_float(rasterizer.depthBiasClamp);
+		add_float(rasterizer.depthBiasSlopeFactor);
+		add_float(rasterizer.lineWidth);
+	}
+
+	if ((parts & FragmentOutputPart) != 0)
+	{
+		add(colorAttachmentCount);
+		add(colorBlendAttachment.blendEnable);
+		add(colorBlendAttachment.srcColorBlendFactor);
+		add(colorBlendAttachment.dstColorBlendFactor);
+		add(colorBlendAttachment.colorBlendOp);
+		add(colorBlendAttachment.srcAlphaBlendFactor);
+		add(colorBlendAttachment.dstAlphaBlendFactor);
+		add(colorBlendAttachment.alphaBlendOp);
+		add(colorBlendAttachment.colorWriteMask);
+	}
+
+	if ((parts & (FragmentShaderPart | FragmentOutputPart)) != 0)
+	{
+		add(multisampling.rasterizationSamples);
+		add(multisampling.sampleShadingEnable);
+		add_float(multisampling.minSampleShading);
+		add(multisampling.alphaToCoverageEnable);
+		add(multisampling.alphaToOneEnable);
+	}
+
+	if ((parts & FragmentShaderPart) != 0)
+	{
+		if (!dynamicDrawState)
+		{
+			add(depthStencil.depthTestEnable);
+			add(depthStencil.depthWriteEnable);
+			add(depthStencil.depthCompareOp);
+		}
+		add(depthStencil.depthBoundsTestEnable);
+		add(depthStencil.stencilTestEnable);
+		add_stencil(depthStencil.front);
+		add_stencil(depthStencil.back);
+		add_float(depthStencil.minDepthBounds);
+		add_float(depthStencil.maxDepthBounds);
+	}
+
+	if ((parts & (PreRasterizationPart | FragmentShaderPart)) != 0)
+	{
+		add_handle(pipelineLayout);
+	}
+	// the vertex input part is the only one independent of the pass
+	if ((parts & ~VertexInputPart) != 0)
+	{
+		add_handle(renderPass);
+		add(subpass);
+		add(static_cast<uint32_t>(colorFormats.size()));
+		for (VkFormat format : colorFormats)
+		{
+			add(format);
+		}
+		add(depthFormat);
+		add(viewMask);
+	}
+}
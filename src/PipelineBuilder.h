@@ -1,21 +1,147 @@
 #pragma once
 
 #include <vk_types.h>
+#include <cstdint>
 #include <vector>
+#include <future>
+
+// Specialization constants of one shader stage, with their values owned, so variants of a shader
+// compile from one module with the constants folded in by the driver.
+struct ShaderSpecialization
+{
+	std::vector<VkSpecializationMapEntry> entries;
+	std::vector<uint8_t> data;
+
+	// constantId is the shader's constant_id; T must be what the constant is declared as, with
+	// VkBool32 for bool
+	template<typename T>
+	ShaderSpecialization& set(uint32_t constantId, const T& value)
+	{
+		VkSpecializationMapEntry entry;
+		entry.constantID = constantId;
+		entry.offset = static_cast<uint32_t>(data.size());
+		entry.size = sizeof(T);
+		entries.push_back(entry);
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+		data.insert(data.end(), bytes, bytes + sizeof(T));
+		return *this;
+	}
+
+	bool empty() const { return entries.empty(); }
+};
+
+// Immutable snapshot of everything vkCreateGraphicsPipelines needs.
+// Owns copies of all arrays the create-info structs point to, so it can be compiled on any thread.
+struct PipelineDescription
+{
+	// the state subsets a pipeline is split into for VK_EXT_graphics_pipeline_library, with the same values
+	// as its VkGraphicsPipelineLibraryFlagBitsEXT
+	static constexpr uint32_t VertexInputPart = 0x1;
+	static constexpr uint32_t PreRasterizationPart = 0x2; // every stage but the fragment shader
+	static constexpr uint32_t FragmentShaderPart = 0x4;
+	static constexpr uint32_t FragmentOutputPart = 0x8;
+	static constexpr uint32_t AllParts = 0xf;
+
+	std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
+	// parallel to shaderStages, or shorter; the stages' own pSpecializationInfo is ignored
+	std::vector<ShaderSpecialization> specializations;
+	std::vector<VkVertexInputBindingDescription> vertexBindings;
+	std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo;
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly;
+	VkViewport viewport;
+	VkRect2D scissor;
+	VkPipelineRasterizationStateCreateInfo rasterizer;
+	VkPipelineColorBlendAttachmentState colorBlendAttachment;
+	uint32_t colorAttachmentCount;
+	VkPipelineMultisampleStateCreateInfo multisampling;
+	VkPipelineDepthStencilStateCreateInfo depthStencil;
+	VkPipelineLayout pipelineLayout;
+	// null for dynamic rendering, which takes the attachment formats instead
+	VkRenderPass renderPass;
+	uint32_t subpass;
+	std::vector<VkFormat> colorFormats;
+	VkFormat depthFormat;
+	// the views of the multiview pass drawn in, for dynamic rendering; a render pass object carries its own
+	uint32_t viewMask;
+	// see PipelineBuilder::_dynamicDrawState
+	bool dynamicDrawState;
+	// see PipelineBuilder::_shadingRate and _shadingRateAttachment
+	bool shadingRate;
+	bool shadingRateAttachment;
+	// see PipelineBuilder::_captureStatistics
+	bool captureStatistics;
+
+	// creates the pipeline; returns VK_NULL_HANDLE on failure
+	VkPipeline compile(VkDevice device, VkPipelineCache cache) const;
+	// every value compile() passes on, flattened; descriptions with equal keys build identical pipelines.
+	// Viewport and scissor are left out, being dynamic, and so is the draw state when dynamicDrawState is
+	std::vector<uint32_t> key() const;
+	// a copy whose stages of the given kind keep their constants at the defaults the shader declares: the
+	// generic build a specialized pipeline can be stood in for with while it compiles
+	PipelineDescription unspecialized(VkShaderStageFlags stages) const;
+
+	// whether the pipeline can be linked from libraries: not for task and mesh shaders, which have no
+	// vertex input to split off
+	bool linkable() const;
+	// just the state of one of the parts above, as a pipeline library; VK_NULL_HANDLE on failure.
+	// Needs VK_EXT_graphics_pipeline_library; the fragment shader part of a depth-only pipeline has no stage
+	VkPipeline compile_library(VkDevice device, VkPipelineCache cache, uint32_t part) const;
+	// the values compile_library(part) passes on; equal keys build interchangeable libraries
+	std::vector<uint32_t> library_key(uint32_t part) const;
+	// an executable pipeline from one library of each part, without link-time optimization, which is fast;
+	// layout must be the one the libraries were built with
+	static VkPipeline link(VkDevice device, VkPipelineCache cache, VkPipelineLayout layout, const VkPipeline* libraries, uint32_t libraryCount);
+
+private:
+	// the whole pipeline for AllParts, a library of the given parts otherwise
+	VkPipeline create(VkDevice device, VkPipelineCache cache, uint32_t parts) const;
+	void append_key(std::vector<uint32_t>& key, uint32_t parts) const;
+};
 
 class PipelineBuilder
 {
 public:
 	std::vector<VkPipelineShaderStageCreateInfo> _shaderStages;
+	// constants of _shaderStages[i]; stages past the end, or with an empty entry, aren't specialized.
+	// Not cleared with the stages
+	std::vector<ShaderSpecialization> _specializations;
 	VkPipelineVertexInputStateCreateInfo _vertexInputInfo;
 	VkPipelineInputAssemblyStateCreateInfo _inputAssembly;
 	VkViewport _viewport;
 	VkRect2D _scissor;
 	VkPipelineRasterizationStateCreateInfo _rasterizer;
 	VkPipelineColorBlendAttachmentState _colorBlendAttachment;
+	// 0 for passes without color attachments, such as depth-only shadow passes; each of them blends as
+	// _colorBlendAttachment
+	uint32_t _colorAttachmentCount{ 1 };
 	VkPipelineMultisampleStateCreateInfo _multisampling;
 	VkPipelineLayout _pipelineLayout;
 	VkPipelineDepthStencilStateCreateInfo _depthStencil;
+	// cull mode, front face, depth test, write and compare op come from the command buffer through
+	// VK_EXT_extended_dynamic_state, and the topology too within its class; the builder's values for
+	// them are only placeholders then. Needs the extension's feature enabled on the device
+	bool _dynamicDrawState{ false };
+	// the fragment shading rate is set per draw with vkCmdSetFragmentShadingRateKHR; needs
+	// VK_KHR_fragment_shading_rate's pipelineFragmentShadingRate feature
+	bool _shadingRate{ false };
+	// drawn in a dynamic rendering pass with a shading rate attachment, which every pipeline of such a pass
+	// must be, whether or not it lets the attachment coarsen its rate; ignored with a render pass object
+	bool _shadingRateAttachment{ false };
+	// the driver keeps the per-stage statistics of the compile for VK_KHR_pipeline_executable_properties
+	// (see ShaderStatistics.h); needs its pipelineExecutableInfo feature. Libraries and the pipelines linked
+	// from them would all have to be built with it
+	bool _captureStatistics{ false };
+
+	// copies the current builder state, including the vertex input arrays it points to
+	PipelineDescription describe(VkRenderPass pass, uint32_t subpass = 0) const;
+	// for VK_KHR_dynamic_rendering: no render pass, just _colorAttachmentCount entries of colorFormats
+	// and the depth format, VK_FORMAT_UNDEFINED without depth
+	PipelineDescription describe_dynamic(const VkFormat* colorFormats, VkFormat depthFormat) const;
+
+	// cache may be VK_NULL_HANDLE; passing the engine's shared cache lets drivers skip recompiling known pipelines
+	VkPipeline build_pipeline(VkDevice device, VkRenderPass pass, VkPipelineCache cache = VK_NULL_HANDLE);
 
-	VkPipeline build_pipeline(VkDevice device, VkRenderPass pass);
-};
\ No newline at end of file
+	// compiles a description on a worker thread; the pipeline cache is internally synchronized so it can be shared
+	static std::future<VkPipeline> build_pipeline_async(VkDevice device, PipelineDescription description, VkPipelineCache cache = VK_NULL_HANDLE);
+};
@@ -0,0 +1,112 @@
+#include "PipelineManifest.h"
+
+#include <fstream>
+#include <iomanip>
+
+namespace {
+	const char* const MANIFEST_HEADER = "qcengine pipeline manifest 1";
+
+	// FNV-1a
+	uint64_t hash_words(const std::vector<uint32_t>& words, uint64_t hash = 14695981039346656037ull)
+	{
+		for (uint32_t word : words)
+		{
+			hash ^= word;
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+}
+
+uint64_t PipelineManifest::hash(const PipelineDescription& description, const char* name, const std::function<uint64_t(VkShaderModule)>& moduleHash)
+{
+	PipelineDescription stable = description;
+	for (VkPipelineShaderStageCreateInfo& stage : stable.shaderStages)
+	{
+		stage.module = reinterpret_cast<VkShaderModule>(moduleHash(stage.module));
+	}
+	// whether there is one still changes the key
+	stable.pipelineLayout = description.pipelineLayout != VK_NULL_HANDLE ? reinterpret_cast<VkPipelineLayout>(uint64_t(1)) : VK_NULL_HANDLE;
+	stable.renderPass = description.renderPass != VK_NULL_HANDLE ? reinterpret_cast<VkRenderPass>(uint64_t(1)) : VK_NULL_HANDLE;
+
+	std::vector<uint32_t> words = stable.key();
+	for (const char* c = name; *c != '\0'; c++)
+	{
+		words.push_back(static_cast<uint32_t>(*c));
+	}
+	return hash_words(words);
+}
+
+bool PipelineManifest::load(const std::string& path)
+{
+	_hashes.clear();
+	std::ifstream in(path);
+	std::string line;
+	if (!in || !std::getline(in, line) || line != MANIFEST_HEADER)
+	{
+		return false;
+	}
+	uint64_t hash;
+	while (in >> std::hex >> hash)
+	{
+		_hashes.insert(hash);
+	}
+	return true;
+}
+
+bool PipelineManifest::save(const std::string& path)
+{
+	for (const Tracked& tracked : _tracked)
+	{
+		if (tracked.bound.load(std::memory_order_relaxed))
+		{
+			_hashes.insert(tracked.hash);
+		}
+	}
+
+	std::ofstream out(path, std::ios::trunc);
+	out << MANIFEST_HEADER << '\n';
+	out << std::hex << std::setfill('0');
+	for (uint64_t hash : _hashes)
+	{
+		out << std::setw(16) << hash << '\n';
+	}
+	return out.good();
+}
+
+void PipelineManifest::track(VkPipeline pipeline, uint64_t hash)
+{
+	if (pipeline == VK_NULL_HANDLE)
+	{
+		return;
+	}
+	// slots sharing a pipeline share its description, so the first hash stands for all of them
+	if (_byPipeline.count(pipeline) != 0)
+	{
+		return;
+	}
+	_tracked.emplace_back();
+	_tracked.back().hash = hash;
+	_byPipeline.emplace(pipeline, &_tracked.back());
+}
+
+void PipelineManifest::retrack(VkPipeline previous, VkPipeline pipeline)
+{
+	auto found = _byPipeline.find(previous);
+	if (found == _byPipeline.end())
+	{
+		return;
+	}
+	Tracked* tracked = found->second;
+	_byPipeline.erase(found);
+	_byPipeline.emplace(pipeline, tracked);
+}
+
+void PipelineManifest::note_bound(VkPipeline pipeline) const
+{
+	auto found = _byPipeline.find(pipeline);
+	if (found != _byPipeline.end() && !found->second->bound.load(std::memory_order_relaxed))
+	{
+		found->second->bound.store(true, std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vk_types.h>
+#include <PipelineBuilder.h>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+// The graphics pipelines sessions actually drew with, by a hash that stays the same from run to run: the
+// description's state with every shader module standing in as a hash of its SPIR-V, and the pipeline's name for
+// its layout and render pass, whose handles change every run. Loaded at startup, it tells the registry which
+// optimized compiles to start right away instead of after the linked pipelines; the pipelines this session
+// binds are added, and it's written back at shutdown, so it follows what the engine is run with rather than
+// everything it could build.
+class PipelineManifest
+{
+public:
+	// moduleHash tells what SPIR-V a stage's module was created from
+	static uint64_t hash(const PipelineDescription& description, const char* name, const std::function<uint64_t(VkShaderModule)>& moduleHash);
+
+	// replaces what's known; false (and nothing known) when the file is missing or isn't a manifest
+	bool load(const std::string& path);
+	// what was loaded plus every pipeline bound since
+	bool save(const std::string& path);
+	bool contains(uint64_t hash) const { return _hashes.count(hash) != 0; }
+	size_t size() const { return _hashes.size(); }
+
+	// between frames: pipeline has hash, and note_bound() of it counts
+	void track(VkPipeline pipeline, uint64_t hash);
+	// between frames: pipeline took the place of previous, which draws no more
+	void retrack(VkPipeline previous, VkPipeline pipeline);
+	// any recording thread: a lookup and at most one relaxed store
+	void note_bound(VkPipeline pipeline) const;
+
+private:
+	struct Tracked {
+		uint64_t hash;
+		std::atomic<bool> bound{ false };
+	};
+
+	std::unordered_set<uint64_t> _hashes;
+	// a deque, whose elements stay in place as it grows, since atomics can't move
+	std::deque<Tracked> _tracked;
+	std::unordered_map<VkPipeline, Tracked*> _byPipeline;
+};
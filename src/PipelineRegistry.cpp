@@ -0,0 +1,230 @@
+#include "PipelineRegistry.h"
+
+#include "HeapStats.h"
+
+#include <chrono>
+
+size_t PipelineRegistry::KeyHash::operator()(const Key& key) const
+{
+	// FNV-1a over the words
+	uint64_t hash = 14695981039346656037ull;
+	for (uint32_t word : key)
+	{
+		hash ^= word;
+		hash *= 1099511628211ull;
+	}
+	return static_cast<size_t>(hash);
+}
+
+void PipelineRegistry::init(VkDevice device, VkPipelineCache cache, bool pipelineLibraries)
+{
+	_device = device;
+	_cache = cache;
+	_pipelineLibraries = pipelineLibraries;
+}
+
+void PipelineRegistry::cleanup()
+{
+	for (auto& pipeline : _pipelines)
+	{
+		Entry& entry = pipeline.second;
+		const VkPipeline handle = entry.pipeline.get();
+		if (handle != VK_NULL_HANDLE)
+		{
+			vkDestroyPipeline(_device, handle, nullptr);
+		}
+		if (entry.optimized.valid())
+		{
+			const VkPipeline optimized = entry.optimized.get();
+			if (optimized != VK_NULL_HANDLE)
+			{
+				vkDestroyPipeline(_device, optimized, nullptr);
+			}
+		}
+	}
+	// after the pipelines linked from them
+	for (auto& library : _libraries)
+	{
+		const VkPipeline handle = library.second.get();
+		if (handle != VK_NULL_HANDLE)
+		{
+			vkDestroyPipeline(_device, handle, nullptr);
+		}
+	}
+	// after the pipelines, whose compiles may still have been reading them
+	for (auto& module : _modules)
+	{
+		vkDestroyShaderModule(_device, module.second, nullptr);
+	}
+	_pipelines.clear();
+	_libraries.clear();
+	_modules.clear();
+	_moduleHashes.clear();
+}
+
+bool PipelineRegistry::shader_module(const std::vector<uint32_t>& code, VkShaderModule* module)
+{
+	heap_stats::Scope heapScope(HeapTag::Pipelines);
+	{
+		std::lock_guard<std::mutex> lock(_moduleMutex);
+		_moduleRequests++;
+		auto cached = _modules.find(code);
+		if (cached != _modules.end())
+		{
+			*module = cached->second;
+			return true;
+		}
+	}
+
+	VkShaderModuleCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	createInfo.pNext = nullptr;
+	createInfo.codeSize = code.size() * sizeof(uint32_t);
+	createInfo.pCode = code.data();
+
+	// created outside the lock, so threads loading different shaders don't wait on each other
+	VkShaderModule shaderModule;
+	if (vkCreateShaderModule(_device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
+	{
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(_moduleMutex);
+	auto inserted = _modules.emplace(code, shaderModule);
+	if (!inserted.second)
+	{
+		// another thread created the same code meanwhile; keep the one everyone else got
+		vkDestroyShaderModule(_device, shaderModule, nullptr);
+	}
+	else
+	{
+		_moduleHashes.emplace(shaderModule, static_cast<uint64_t>(KeyHash()(code)));
+	}
+	*module = inserted.first->second;
+	return true;
+}
+
+uint64_t PipelineRegistry::module_hash(VkShaderModule module)
+{
+	std::lock_guard<std::mutex> lock(_moduleMutex);
+	auto found = _moduleHashes.find(module);
+	return found != _moduleHashes.end() ? found->second : 0;
+}
+
+std::shared_future<VkPipeline> PipelineRegistry::pipeline(const PipelineDescription& description, bool drawnBefore)
+{
+	heap_stats::Scope heapScope(HeapTag::Pipelines);
+	_pipelineRequests++;
+	Key key = description.key();
+	auto cached = _pipelines.find(key);
+	if (cached != _pipelines.end())
+	{
+		return cached->second.pipeline;
+	}
+
+	Entry entry;
+	if (_pipelineLibraries && description.linkable())
+	{
+		std::shared_future<VkPipeline> parts[] = {
+			library(description, PipelineDescription::VertexInputPart),
+			library(description, PipelineDescription::PreRasterizationPart),
+			library(description, PipelineDescription::FragmentShaderPart),
+			library(description, PipelineDescription::FragmentOutputPart),
+		};
+		VkDevice device = _device;
+		VkPipelineCache cache = _cache;
+		VkPipelineLayout layout = description.pipelineLayout;
+		entry.pipeline = std::async(std::launch::async, [device, cache, layout, parts]() {
+			VkPipeline libraries[4];
+			for (uint32_t i = 0; i < 4; i++)
+			{
+				libraries[i] = parts[i].get();
+				if (libraries[i] == VK_NULL_HANDLE)
+				{
+					return VkPipeline(VK_NULL_HANDLE);
+				}
+			}
+			return PipelineDescription::link(device, cache, layout, libraries, 4);
+		}).share();
+		entry.description = description;
+		entry.linked = true;
+		// alongside the libraries, so it's swapped in as soon as update() finds both done
+		if (drawnBefore)
+		{
+			entry.optimized = PipelineBuilder::build_pipeline_async(_device, description, _cache);
+		}
+	}
+	else
+	{
+		entry.pipeline = PipelineBuilder::build_pipeline_async(_device, description, _cache).share();
+	}
+
+	std::shared_future<VkPipeline> compile = entry.pipeline;
+	_pipelines.emplace(std::move(key), std::move(entry));
+	return compile;
+}
+
+std::shared_future<VkPipeline> PipelineRegistry::library(const PipelineDescription& description, uint32_t part)
+{
+	heap_stats::Scope heapScope(HeapTag::Pipelines);
+	Key key = description.library_key(part);
+	auto cached = _libraries.find(key);
+	if (cached != _libraries.end())
+	{
+		return cached->second;
+	}
+
+	VkDevice device = _device;
+	VkPipelineCache cache = _cache;
+	std::shared_future<VkPipeline> compile = std::async(std::launch::async, [device, cache, description, part]() {
+		return description.compile_library(device, cache, part);
+	}).share();
+	_libraries.emplace(std::move(key), compile);
+	return compile;
+}
+
+void PipelineRegistry::update(DeletionQueue& retired, const std::function<void(VkPipeline previous, VkPipeline pipeline)>& replaced)
+{
+	if (!_pipelineLibraries)
+	{
+		return;
+	}
+
+	for (auto& pipeline : _pipelines)
+	{
+		Entry& entry = pipeline.second;
+		if (!entry.linked || entry.pipeline.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		{
+			continue;
+		}
+
+		// the linked pipeline is drawing by now, so the full compile doesn't hold up the first frames
+		if (!entry.optimized.valid())
+		{
+			entry.optimized = PipelineBuilder::build_pipeline_async(_device, entry.description, _cache);
+			continue;
+		}
+		if (entry.optimized.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		{
+			continue;
+		}
+
+		const VkPipeline previous = entry.pipeline.get();
+		const VkPipeline optimized = entry.optimized.get();
+		entry.linked = false;
+		if (optimized == VK_NULL_HANDLE)
+		{
+			// the linked one keeps drawing
+			continue;
+		}
+
+		std::promise<VkPipeline> swapped;
+		swapped.set_value(optimized);
+		entry.pipeline = swapped.get_future().share();
+		if (previous != VK_NULL_HANDLE)
+		{
+			retired.push_pipeline(previous);
+			replaced(previous, optimized);
+		}
+	}
+}
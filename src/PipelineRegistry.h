@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vk_types.h>
+#include <DeletionQueue.h>
+#include <PipelineBuilder.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Shader modules and graphics pipelines, one per distinct content: modules keyed by their SPIR-V,
+// pipelines by PipelineDescription::key(). A request for something asked for before returns the
+// existing object, so the many materials sharing a handful of shader and state combinations share
+// their pipelines too, and a module loaded twice is created once.
+// With pipeline libraries, a new pipeline is linked from four libraries, one per state part, that are
+// themselves shared between every pipeline with equal state in that part; linking without optimization
+// is quick, so first use doesn't stall on a full compile. update() then compiles the optimized pipeline
+// in the background and swaps it in.
+// Everything is owned by the registry until cleanup(). Modules can be asked for from any thread; pipelines
+// only from the thread that builds them, the compiles themselves run on workers.
+class PipelineRegistry
+{
+public:
+	// pipelineLibraries needs VK_EXT_graphics_pipeline_library with fast linking on the device
+	void init(VkDevice device, VkPipelineCache cache, bool pipelineLibraries = false);
+	// waits for compiles in flight, then destroys every pipeline, library and module; the GPU must be done with them
+	void cleanup();
+
+	// false if the device rejects code; thread-safe
+	bool shader_module(const std::vector<uint32_t>& code, VkShaderModule* module);
+	// the hash of the SPIR-V module was created from, 0 for modules that didn't come from here; thread-safe
+	uint64_t module_hash(VkShaderModule module);
+	// started on a worker the first time description is asked for; VK_NULL_HANDLE if it failed to compile.
+	// With libraries this is the linked pipeline, until update() replaces it. A pipeline known to be drawn
+	// with (see PipelineManifest) has its optimized compile started right away too, rather than once the
+	// linked one is ready
+	std::shared_future<VkPipeline> pipeline(const PipelineDescription& description, bool drawnBefore = false);
+
+	// once per frame, between frames: starts the optimized compile of every linked pipeline ready by now
+	// and swaps in the ones that are done. The linked pipelines go to retired, and replaced is called for
+	// each, so the handles handed out can be pointed at the optimized one
+	void update(DeletionQueue& retired, const std::function<void(VkPipeline previous, VkPipeline pipeline)>& replaced);
+
+	// for logging: requests so far, against what they created
+	uint32_t module_requests() const { return _moduleRequests; }
+	uint32_t pipeline_requests() const { return _pipelineRequests; }
+	size_t module_count() const { return _modules.size(); }
+	size_t pipeline_count() const { return _pipelines.size(); }
+	size_t library_count() const { return _libraries.size(); }
+
+private:
+	using Key = std::vector<uint32_t>;
+	struct KeyHash {
+		size_t operator()(const Key& key) const;
+	};
+
+	struct Entry {
+		std::shared_future<VkPipeline> pipeline;
+		// linked pipelines only: the description to compile whole, and that compile once it's started
+		PipelineDescription description;
+		bool linked{ false };
+		std::future<VkPipeline> optimized;
+	};
+
+	// the library of part for description, compiling on a worker unless an equal one was asked for before
+	std::shared_future<VkPipeline> library(const PipelineDescription& description, uint32_t part);
+
+	VkDevice _device{ VK_NULL_HANDLE };
+	VkPipelineCache _cache{ VK_NULL_HANDLE };
+	bool _pipelineLibraries{ false };
+
+	// hashed whole and compared whole, so colliding hashes can't hand out the wrong object
+	std::unordered_map<Key, VkShaderModule, KeyHash> _modules;
+	std::unordered_map<VkShaderModule, uint64_t> _moduleHashes; // under _moduleMutex
+	std::mutex _moduleMutex;
+	std::unordered_map<Key, Entry, KeyHash> _pipelines;
+	std::unordered_map<Key, std::shared_future<VkPipeline>, KeyHash> _libraries;
+	uint32_t _moduleRequests{ 0 }; // under _moduleMutex
+	uint32_t _pipelineRequests{ 0 };
+};
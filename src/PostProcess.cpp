@@ -0,0 +1,207 @@
+#include "PostProcess.h"
+
+#include "PipelineBuilder.h"
+#include "vk_initializers.h"
+
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+namespace {
+	// matches the push constants of post.glsl
+	struct PostPushConstants {
+		glm::vec4 params;
+		glm::vec2 sourceTexel;
+		glm::vec2 secondaryTexel;
+		uint32_t size[2];
+	};
+
+	// local sizes of the kernels: 8x8 tiles, the blurs 64 texels of a row or column
+	constexpr uint32_t POST_TILE_SIZE = 8;
+	constexpr uint32_t POST_BLUR_RUN = 64;
+
+	// FXAA's quality preset 12 thresholds and its default subpixel blending
+	constexpr float FXAA_EDGE_THRESHOLD = 0.166f;
+	constexpr float FXAA_EDGE_THRESHOLD_MIN = 0.0833f;
+	constexpr float FXAA_SUBPIXEL = 0.75f;
+
+	glm::vec2 texel_size(VkExtent2D extent)
+	{
+		return glm::vec2(1.0f / extent.width, 1.0f / extent.height);
+	}
+
+	uint32_t group_count(uint32_t size, uint32_t groupSize)
+	{
+		return (size + groupSize - 1) / groupSize;
+	}
+}
+
+void PostProcess::init(VkDevice device, LayoutCache& layouts, DescriptorSetCache& sets, const PostProcessShaders& shaders, const PostProcessSettings& settings,
+	VkPipelineCache cache)
+{
+	_device = device;
+	_sets = &sets;
+	_settings = settings;
+	_settings.bloom = settings.bloom && shaders.downsample != VK_NULL_HANDLE && shaders.blur != VK_NULL_HANDLE;
+	_settings.fxaa = settings.fxaa && shaders.fxaa != VK_NULL_HANDLE;
+
+	_setLayout = layouts.set_layout({
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0), // source
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1), // secondary
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 2), // destination
+	});
+
+	VkPushConstantRange pushConstant;
+	pushConstant.offset = 0;
+	pushConstant.size = sizeof(PostPushConstants);
+	pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkPipelineLayoutCreateInfo layoutInfo = vkinit::pipeline_layout_create_info();
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &_setLayout;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushConstant;
+	VK_CHECK(vkCreatePipelineLayout(_device, &layoutInfo, nullptr, &_pipelineLayout));
+
+	// bilinear taps for the downsample, the bloom's upsampling and FXAA's edge walk; clamped, so nothing
+	// outside the image bleeds in at the borders
+	VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.maxLod = 0.0f;
+	_sampler = layouts.sampler(samplerInfo);
+
+	if (shaders.composite == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	// the kernels the settings need, the composite compiled with just the steps that are enabled
+	ShaderSpecialization specializations[KERNEL_COUNT];
+	VkShaderModule modules[KERNEL_COUNT] = {};
+	if (_settings.bloom)
+	{
+		modules[BloomDownsample] = shaders.downsample;
+		modules[BloomBlurX] = shaders.blur;
+		modules[BloomBlurY] = shaders.blur;
+		specializations[BloomBlurX].set<int32_t>(0, 0);
+		specializations[BloomBlurY].set<int32_t>(0, 1);
+	}
+	modules[Composite] = shaders.composite;
+	specializations[Composite].set<VkBool32>(0, _settings.bloom).set<VkBool32>(1, _settings.tonemap).set<VkBool32>(2, _settings.vignette > 0.0f);
+	if (_settings.fxaa)
+	{
+		modules[Fxaa] = shaders.fxaa;
+	}
+
+	VkComputePipelineCreateInfo pipelineInfos[KERNEL_COUNT] = {};
+	VkSpecializationInfo specializationInfos[KERNEL_COUNT] = {};
+	Kernel kernels[KERNEL_COUNT];
+	uint32_t pipelineCount = 0;
+	for (uint32_t i = 0; i < KERNEL_COUNT; i++)
+	{
+		if (modules[i] == VK_NULL_HANDLE)
+		{
+			continue;
+		}
+		VkComputePipelineCreateInfo& pipelineInfo = pipelineInfos[pipelineCount];
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.pNext = nullptr;
+		pipelineInfo.layout = _pipelineLayout;
+		pipelineInfo.stage = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, modules[i]);
+		if (!specializations[i].empty())
+		{
+			VkSpecializationInfo& specializationInfo = specializationInfos[pipelineCount];
+			specializationInfo.mapEntryCount = static_cast<uint32_t>(specializations[i].entries.size());
+			specializationInfo.pMapEntries = specializations[i].entries.data();
+			specializationInfo.dataSize = specializations[i].data.size();
+			specializationInfo.pData = specializations[i].data.data();
+			pipelineInfo.stage.pSpecializationInfo = &specializationInfo;
+		}
+		kernels[pipelineCount] = static_cast<Kernel>(i);
+		pipelineCount++;
+	}
+
+	VkPipeline pipelines[KERNEL_COUNT];
+	VK_CHECK(vkCreateComputePipelines(_device, cache, pipelineCount, pipelineInfos, nullptr, pipelines));
+	for (uint32_t i = 0; i < pipelineCount; i++)
+	{
+		_pipelines[kernels[i]] = pipelines[i];
+	}
+}
+
+void PostProcess::cleanup()
+{
+	// the sets go with the set cache, the set layout and the sampler with the layout cache
+	for (VkPipeline& pipeline : _pipelines)
+	{
+		vkDestroyPipeline(_device, pipeline, nullptr);
+		pipeline = VK_NULL_HANDLE;
+	}
+	vkDestroyPipelineLayout(_device, _pipelineLayout, nullptr);
+}
+
+void PostProcess::set_settings(const PostProcessSettings& settings)
+{
+	const bool bloom = _settings.bloom;
+	const bool tonemap = _settings.tonemap;
+	const bool vignette = _settings.vignette > 0.0f;
+	const bool fxaa = _settings.fxaa;
+	_settings = settings;
+	_settings.bloom = bloom;
+	_settings.tonemap = tonemap;
+	_settings.vignette = vignette ? settings.vignette : 0.0f;
+	_settings.fxaa = fxaa;
+}
+
+void PostProcess::record(VkCommandBuffer cmd, Kernel kernel, uint32_t frame, VkImageView source, VkExtent2D sourceExtent,
+	VkImageView secondary, VkExtent2D secondaryExtent, VkImageView output, VkExtent2D region)
+{
+	VkPipeline pipeline = _pipelines[kernel];
+	if (pipeline == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	const DescriptorWrite writes[] = {
+		DescriptorWrite::image_write(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _sampler, source, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+		DescriptorWrite::image_write(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _sampler, secondary != VK_NULL_HANDLE ? secondary : source,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+		DescriptorWrite::image_write(2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_NULL_HANDLE, output, VK_IMAGE_LAYOUT_GENERAL),
+	};
+	VkDescriptorSet set = _sets->get(frame, _setLayout, writes, 3);
+
+	PostPushConstants constants = {};
+	constants.sourceTexel = texel_size(sourceExtent);
+	constants.secondaryTexel = secondary != VK_NULL_HANDLE ? texel_size(secondaryExtent) : constants.sourceTexel;
+	constants.size[0] = region.width;
+	constants.size[1] = region.height;
+	switch (kernel)
+	{
+	case BloomDownsample:
+		constants.params = glm::vec4(_settings.bloomThreshold, _settings.bloomKnee, 0.0f, 0.0f);
+		break;
+	case Composite:
+		constants.params = glm::vec4(_settings.exposure, _settings.bloomIntensity, _settings.vignette, 0.0f);
+		break;
+	case Fxaa:
+		constants.params = glm::vec4(FXAA_EDGE_THRESHOLD, FXAA_EDGE_THRESHOLD_MIN, FXAA_SUBPIXEL, 0.0f);
+		break;
+	default:
+		break;
+	}
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout, 0, 1, &set, 0, nullptr);
+	vkCmdPushConstants(cmd, _pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+	if (kernel == BloomBlurX)
+	{
+		vkCmdDispatch(cmd, group_count(region.width, POST_BLUR_RUN), region.height, 1);
+	}
+	else if (kernel == BloomBlurY)
+	{
+		vkCmdDispatch(cmd, group_count(region.height, POST_BLUR_RUN), region.width, 1);
+	}
+	else
+	{
+		vkCmdDispatch(cmd, group_count(region.width, POST_TILE_SIZE), group_count(region.height, POST_TILE_SIZE), 1);
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vk_types.h>
+#include <DescriptorSetCache.h>
+#include <LayoutCache.h>
+
+#include <cstdint>
+#include <vector>
+
+// what the chain does; which steps run is fixed at init, the numbers may change every frame
+struct PostProcessSettings {
+	float exposure{ 1.0f };
+	bool bloom{ true };
+	float bloomThreshold{ 1.0f }; // scene brightness where the bloom starts
+	float bloomKnee{ 0.5f }; // how far below the threshold it fades in
+	float bloomIntensity{ 0.25f };
+	bool tonemap{ true }; // the ACES fit; without it colors are clamped
+	float vignette{ 0.0f }; // how much darker the corners get, 0 to 1; 0 compiles it out
+	bool fxaa{ true };
+};
+
+// the compute shaders of the chain; the composite is the only one it can't do without
+struct PostProcessShaders {
+	VkShaderModule downsample{ VK_NULL_HANDLE };
+	VkShaderModule blur{ VK_NULL_HANDLE };
+	VkShaderModule composite{ VK_NULL_HANDLE };
+	VkShaderModule fxaa{ VK_NULL_HANDLE };
+};
+
+// The post-processing kernels, each a compute dispatch over RGBA16F images, for the frame graph's passes
+// to record between the scene and the swapchain. The scene renders into an HDR target of HDR_FORMAT and
+// the chain runs:
+// - bloom: the bright parts downsampled to half size, then blurred along x and along y, each blur pass
+//   working from a shared memory tile of its row or column
+// - composite: every per-pixel step fused into one dispatch, bloom added back, exposure, tonemapping and
+//   vignette, with the disabled ones compiled out through specialization constants
+// - FXAA, over a shared memory tile of the composite's luma
+// The graph owns the images and the barriers between the kernels. record() takes its set from the set cache's
+// frame slot it is given, which writes one only for images it hasn't seen the kernel use there.
+class PostProcess
+{
+public:
+	static constexpr VkFormat HDR_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+	enum Kernel : uint32_t { BloomDownsample, BloomBlurX, BloomBlurY, Composite, Fxaa, KERNEL_COUNT };
+
+	// bloom needs the downsample and blur shaders and FXAA its own; settings() drops what is missing
+	void init(VkDevice device, LayoutCache& layouts, DescriptorSetCache& sets, const PostProcessShaders& shaders, const PostProcessSettings& settings,
+		VkPipelineCache cache);
+	void cleanup();
+
+	bool ready() const { return _pipelines[Composite] != VK_NULL_HANDLE; }
+	const PostProcessSettings& settings() const { return _settings; }
+	// the numbers only; steps disabled at init stay disabled
+	void set_settings(const PostProcessSettings& settings);
+
+	// the bloom images' size for a scene of extent
+	static VkExtent2D bloom_extent(VkExtent2D extent) { return { (extent.width + 1) / 2, (extent.height + 1) / 2 }; }
+
+	// inside a compute pass: one dispatch of kernel writing the top-left region of output, which is in
+	// GENERAL layout, from source (and, for the composite, the bloom as secondary) in SHADER_READ_ONLY_OPTIMAL.
+	// The extents are of the whole images; the region is the scene's rendered part, halved for the bloom
+	// kernels' outputs
+	void record(VkCommandBuffer cmd, Kernel kernel, uint32_t frame, VkImageView source, VkExtent2D sourceExtent,
+		VkImageView secondary, VkExtent2D secondaryExtent, VkImageView output, VkExtent2D region);
+
+private:
+	VkDevice _device{ VK_NULL_HANDLE };
+	PostProcessSettings _settings;
+
+	DescriptorSetCache* _sets{ nullptr };
+	VkDescriptorSetLayout _setLayout{ VK_NULL_HANDLE }; // the layout cache's
+	VkPipelineLayout _pipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline _pipelines[KERNEL_COUNT]{};
+	VkSampler _sampler{ VK_NULL_HANDLE }; // the layout cache's
+};
@@ -0,0 +1,282 @@
+#include "PotentiallyVisibleSet.h"
+
+#include "AssetArchive.h"
+#include "Bvh.h"
+#include "JobSystem.h"
+#include "Log.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+namespace {
+	constexpr uint32_t PVS_MAGIC = 0x53565051; // "QPVS"
+	constexpr uint32_t PVS_VERSION = 1;
+
+	struct PvsHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t cells[3];
+		uint32_t objectCount;
+		uint32_t words;
+		uint32_t reserved;
+		float origin[3];
+		float cellSize[3];
+		uint64_t sourceSize;
+		int64_t sourceTimestamp;
+		uint64_t sourceHash;
+	};
+	static_assert(sizeof(PvsHeader) == 80, "pvs header must not contain padding");
+
+	// radical inverse in base; spreads a cell's interior samples without clumping
+	float halton(uint32_t index, uint32_t base)
+	{
+		float result = 0.0f;
+		float fraction = 1.0f / base;
+		while (index > 0)
+		{
+			result += fraction * (index % base);
+			index /= base;
+			fraction /= base;
+		}
+		return result;
+	}
+}
+
+bool PotentiallyVisibleSet::bake(const std::vector<Mesh>& parts, const PvsBakeSettings& settings)
+{
+	clear();
+
+	std::vector<glm::vec3> corners;
+	std::vector<uint32_t> owners;
+	Aabb bounds = { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+	for (uint32_t part = 0; part < parts.size(); part++)
+	{
+		const Mesh& mesh = parts[part];
+		const MeshLod lod = mesh.get_lod(0);
+		if (mesh._indices.size() < size_t(lod.firstIndex) + lod.indexCount)
+		{
+			return false;
+		}
+		for (uint32_t i = lod.firstIndex; i + 2 < lod.firstIndex + lod.indexCount; i += 3)
+		{
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				const glm::vec3& position = mesh._vertices[mesh._indices[i + corner]].position;
+				corners.push_back(position);
+				bounds.min = glm::min(bounds.min, position);
+				bounds.max = glm::max(bounds.max, position);
+			}
+			owners.push_back(part);
+		}
+	}
+	if (owners.empty())
+	{
+		return false;
+	}
+
+	Bvh triangles;
+	for (uint32_t triangle = 0; triangle < owners.size(); triangle++)
+	{
+		const glm::vec3* t = &corners[size_t(triangle) * 3];
+		triangles.insert({ glm::min(t[0], glm::min(t[1], t[2])), glm::max(t[0], glm::max(t[1], t[2])) }, triangle);
+	}
+
+	// the grid covers the bounds exactly, its cells stretched a little when the extent isn't a multiple
+	const glm::vec3 extent = glm::max(bounds.max - bounds.min, glm::vec3(1e-3f));
+	float cellSize = std::max(settings.cellSize, 1e-3f);
+	glm::uvec3 cells;
+	for (;;)
+	{
+		cells = glm::max(glm::uvec3(glm::ceil(extent / cellSize)), glm::uvec3(1));
+		if (uint64_t(cells.x) * cells.y * cells.z <= std::max(settings.maxCells, 1u))
+		{
+			break;
+		}
+		cellSize *= 1.25f;
+	}
+	_origin = bounds.min;
+	_cellSize = extent / glm::vec3(cells);
+	_cells = cells;
+	_objectCount = static_cast<uint32_t>(parts.size());
+	_words = (_objectCount + 31) / 32;
+	_bits.assign(size_t(cell_count()) * _words, 0);
+
+	// evenly over the sphere (a Fibonacci spiral), each sample's set turned by its own offset so the
+	// samples of a cell fill in each other's gaps
+	const uint32_t rayCount = std::max(settings.raysPerSample, 1u);
+	const float golden = 3.14159265f * (3.0f - std::sqrt(5.0f));
+	const float maxDistance = glm::length(extent) * 1.01f;
+
+	parallel_for(cell_count(), [&](size_t cell) {
+		const glm::uvec3 coord(cell % _cells.x, (cell / _cells.x) % _cells.y, cell / (size_t(_cells.x) * _cells.y));
+		const glm::vec3 cellMin = _origin + glm::vec3(coord) * _cellSize;
+		uint32_t* bits = &_bits[cell * _words];
+
+		const uint32_t sampleCount = 8 + settings.interiorSamples;
+		for (uint32_t sample = 0; sample < sampleCount; sample++)
+		{
+			const glm::vec3 offset = sample < 8
+				? glm::vec3(float(sample & 1), float((sample >> 1) & 1), float((sample >> 2) & 1))
+				: glm::vec3(halton(sample - 7, 2), halton(sample - 7, 3), halton(sample - 7, 5));
+			const glm::vec3 origin = cellMin + offset * _cellSize;
+			const float turn = halton(uint32_t(cell) * sampleCount + sample + 1, 7) * 6.2831853f;
+
+			for (uint32_t ray = 0; ray < rayCount; ray++)
+			{
+				const float y = 1.0f - 2.0f * (ray + 0.5f) / rayCount;
+				const float ring = std::sqrt(std::max(1.0f - y * y, 0.0f));
+				const float angle = golden * ray + turn;
+				const glm::vec3 direction(std::cos(angle) * ring, y, std::sin(angle) * ring);
+
+				// both sides: a sample inside a wall still sees the wall's own faces, and marking them only
+				// costs a part that would have been drawn anyway
+				auto hit = [&](uint32_t triangle, float) {
+					return ray_triangle(origin, direction, &corners[size_t(triangle) * 3]);
+				};
+				uint32_t triangle;
+				float distance;
+				if (triangles.raycast(origin, direction, maxDistance, hit, triangle, distance))
+				{
+					const uint32_t object = owners[triangle];
+					bits[object / 32] |= 1u << (object % 32);
+				}
+			}
+		}
+	});
+	return true;
+}
+
+bool PotentiallyVisibleSet::save(const char* path, const char* sourcePath) const
+{
+	SourceStamp stamp;
+	if (empty() || !get_source_stamp(sourcePath, stamp))
+	{
+		return false;
+	}
+
+	PvsHeader header = {};
+	header.magic = PVS_MAGIC;
+	header.version = PVS_VERSION;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		header.cells[axis] = _cells[axis];
+		header.origin[axis] = _origin[axis];
+		header.cellSize[axis] = _cellSize[axis];
+	}
+	header.objectCount = _objectCount;
+	header.words = _words;
+	header.sourceSize = stamp.size;
+	header.sourceTimestamp = stamp.timestamp;
+	header.sourceHash = hash_file(sourcePath);
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		return false;
+	}
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(_bits.data()), _bits.size() * sizeof(uint32_t));
+	return file.good();
+}
+
+bool PotentiallyVisibleSet::load(const char* path, const char* sourcePath, const AssetArchive* archive)
+{
+	clear();
+
+	MappedFile file;
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+	if (archive == nullptr || !archive->find(path, data, size))
+	{
+		if (!file.open(path))
+		{
+			return false;
+		}
+		data = file.data();
+		size = file.size();
+	}
+
+	PvsHeader header;
+	if (size < sizeof(PvsHeader))
+	{
+		return false;
+	}
+	memcpy(&header, data, sizeof(PvsHeader));
+	const uint64_t cellCount = uint64_t(header.cells[0]) * header.cells[1] * header.cells[2];
+	if (header.magic != PVS_MAGIC || header.version != PVS_VERSION || header.words != (header.objectCount + 31) / 32
+		|| size < sizeof(PvsHeader) + cellCount * header.words * sizeof(uint32_t))
+	{
+		return false;
+	}
+
+	// outdated once the level changes; a timestamp-only change is accepted if the contents still hash the same
+	SourceStamp stamp;
+	if (get_source_stamp(sourcePath, stamp))
+	{
+		if (stamp.size != header.sourceSize || (stamp.timestamp != header.sourceTimestamp && hash_file(sourcePath) != header.sourceHash))
+		{
+			LOG_WARN(path << " is older than " << sourcePath << ", ignoring it");
+			return false;
+		}
+	}
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		_cells[axis] = header.cells[axis];
+		_origin[axis] = header.origin[axis];
+		_cellSize[axis] = header.cellSize[axis];
+	}
+	_objectCount = header.objectCount;
+	_words = header.words;
+	_bits.resize(size_t(cellCount) * _words);
+	memcpy(_bits.data(), data + sizeof(PvsHeader), _bits.size() * sizeof(uint32_t));
+	return true;
+}
+
+void PotentiallyVisibleSet::clear()
+{
+	_cells = glm::uvec3(0);
+	_objectCount = 0;
+	_words = 0;
+	_bits.clear();
+}
+
+uint32_t PotentiallyVisibleSet::find_cell(const glm::vec3& position) const
+{
+	if (empty())
+	{
+		return UINT32_MAX;
+	}
+	const glm::vec3 local = (position - _origin) / _cellSize;
+	if (glm::any(glm::lessThan(local, glm::vec3(0.0f))) || glm::any(glm::greaterThan(local, glm::vec3(_cells))))
+	{
+		return UINT32_MAX;
+	}
+	// the far faces belong to the last cells, so a camera on the bounds still finds one
+	const glm::uvec3 coord = glm::min(glm::uvec3(local), _cells - glm::uvec3(1));
+	return (coord.z * _cells.y + coord.y) * _cells.x + coord.x;
+}
+
+uint32_t PotentiallyVisibleSet::visible_count(uint32_t cell) const
+{
+	if (cell == UINT32_MAX)
+	{
+		return _objectCount;
+	}
+	uint32_t count = 0;
+	for (uint32_t word = 0; word < _words; word++)
+	{
+		uint32_t bits = _bits[size_t(cell) * _words + word];
+		for (; bits != 0; bits &= bits - 1)
+		{
+			count++;
+		}
+	}
+	return count;
+}
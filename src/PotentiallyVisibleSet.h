@@ -0,0 +1,63 @@
+#pragma once
+
+#include <Mesh.h>
+
+#include <cstdint>
+#include <vector>
+#include <glm/vec3.hpp>
+
+class AssetArchive;
+
+// baked next to the level's OBJ: its own name plus this
+constexpr const char* PVS_EXTENSION = ".qcpvs";
+
+struct PvsBakeSettings {
+	// edge of a cell; grows when the level would need more than maxCells of them
+	float cellSize{ 8.0f };
+	uint32_t maxCells{ 16384 };
+	// points a cell looks from besides its eight corners, and rays cast from each
+	uint32_t interiorSamples{ 8 };
+	uint32_t raysPerSample{ 256 };
+};
+
+// Precomputed visibility for a static level: its bounds are split into a grid of cells, and every cell holds
+// a bitset of the level's parts (the meshes load_parts gives, by index) seen from somewhere inside it. The
+// bake casts rays in every direction from the cell's corners and a few points within, against the full
+// detail triangles of all the parts, and marks whichever part each ray hits first. The corners are shared
+// with the neighbouring cells, so a camera crossing a boundary sees the same parts on either side.
+// Sampled rather than exact: a part visible only through a gap narrower than the rays' spacing can be
+// missed, which a cell size near the level's rooms and corridors keeps rare. At runtime the lookup is the
+// camera's cell and a bit per part, so the level's hidden rooms cost nothing before any other culling.
+// Only valid for the level drawn where it was baked, at the identity transform.
+class PotentiallyVisibleSet
+{
+public:
+	// bakes the sets of parts, whose CPU indices must be decoded; false when they have no triangles
+	bool bake(const std::vector<Mesh>& parts, const PvsBakeSettings& settings = {});
+
+	// stamped with sourcePath, the level's OBJ, like the mesh caches
+	bool save(const char* path, const char* sourcePath) const;
+	// from archive's copy of path when it has one; false (and empty) when missing, outdated or corrupt
+	bool load(const char* path, const char* sourcePath, const AssetArchive* archive = nullptr);
+	void clear();
+
+	bool empty() const { return _bits.empty(); }
+	uint32_t object_count() const { return _objectCount; }
+	uint32_t cell_count() const { return _cells.x * _cells.y * _cells.z; }
+
+	// cell holding position, UINT32_MAX outside the grid, where every part counts as visible
+	uint32_t find_cell(const glm::vec3& position) const;
+	bool visible(uint32_t cell, uint32_t object) const
+	{
+		return cell == UINT32_MAX || object >= _objectCount || (_bits[size_t(cell) * _words + object / 32] >> (object % 32)) & 1u;
+	}
+	uint32_t visible_count(uint32_t cell) const;
+
+private:
+	glm::vec3 _origin{ 0.0f };
+	glm::vec3 _cellSize{ 1.0f };
+	glm::uvec3 _cells{ 0 };
+	uint32_t _objectCount{ 0 };
+	uint32_t _words{ 0 }; // per cell
+	std::vector<uint32_t> _bits;
+};
@@ -0,0 +1,209 @@
+#include "PresentThread.h"
+
+#include "CpuProfiler.h"
+
+#include <chrono>
+
+namespace {
+	// as long as the inline acquire waited; VK_TIMEOUT reaches the frame thread like any other failed acquire
+	constexpr uint64_t ACQUIRE_TIMEOUT_NS = 1000000000;
+}
+
+void PresentThread::init(VkDevice device, VkQueue queue, std::mutex& queueMutex, uint32_t frameOverlap)
+{
+	_device = device;
+	_queue = queue;
+	_queueMutex = &queueMutex;
+
+	VkSemaphoreCreateInfo semaphoreInfo = {};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	_semaphores.resize(frameOverlap + 1);
+	for (VkSemaphore& semaphore : _semaphores)
+	{
+		VK_CHECK(vkCreateSemaphore(_device, &semaphoreInfo, nullptr, &semaphore));
+	}
+	_freeSemaphores = _semaphores;
+}
+
+void PresentThread::cleanup()
+{
+	for (VkSemaphore semaphore : _semaphores)
+	{
+		vkDestroySemaphore(_device, semaphore, nullptr);
+	}
+	_semaphores.clear();
+	_freeSemaphores.clear();
+}
+
+void PresentThread::start(VkSwapchainKHR swapchain)
+{
+	_swapchain = swapchain;
+	_presents.clear();
+	_hasAcquired = false;
+	_acquireWanted = true;
+	_presentResult = VK_SUCCESS;
+	_stopping = false;
+	_thread = std::thread([this]() { loop(); });
+}
+
+void PresentThread::stop()
+{
+	if (!_thread.joinable())
+	{
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_wake.notify_one();
+	_thread.join();
+
+	// the image stays with the old swapchain, which may be destroyed holding it; its semaphore must be waited on
+	// before anything signals it again
+	if (_hasAcquired && _acquired.semaphore != VK_NULL_HANDLE)
+	{
+		const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		VkSubmitInfo submit = {};
+		submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit.waitSemaphoreCount = 1;
+		submit.pWaitSemaphores = &_acquired.semaphore;
+		submit.pWaitDstStageMask = &waitStage;
+		{
+			std::lock_guard<std::mutex> lock(*_queueMutex);
+			VK_CHECK(vkQueueSubmit(_queue, 1, &submit, VK_NULL_HANDLE));
+		}
+		_freeSemaphores.push_back(_acquired.semaphore);
+	}
+	_hasAcquired = false;
+}
+
+PresentThread::Acquired PresentThread::acquire(uint64_t timeoutNs)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	if (!_thread.joinable())
+	{
+		return Acquired{};
+	}
+	if (!_acquiredReady.wait_for(lock, std::chrono::nanoseconds(timeoutNs), [this]() { return _hasAcquired; }))
+	{
+		Acquired timedOut;
+		timedOut.result = VK_TIMEOUT;
+		return timedOut;
+	}
+	_hasAcquired = false;
+	// a failed acquire leaves nothing to present, so the next one can't wait on a present
+	if (_acquired.semaphore == VK_NULL_HANDLE)
+	{
+		_acquireWanted = true;
+		_wake.notify_one();
+	}
+	return _acquired;
+}
+
+void PresentThread::present(uint32_t imageIndex, VkSemaphore waitSemaphore, uint64_t presentId)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_presents.push_back({ imageIndex, waitSemaphore, presentId });
+		_acquireWanted = true;
+	}
+	_wake.notify_one();
+}
+
+void PresentThread::release(VkSemaphore semaphore)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_freeSemaphores.push_back(semaphore);
+	}
+	_wake.notify_one();
+}
+
+VkResult PresentThread::take_present_result()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	const VkResult result = _presentResult;
+	_presentResult = VK_SUCCESS;
+	return result;
+}
+
+void PresentThread::loop()
+{
+	cpu_profiler::set_thread_name("present");
+	std::unique_lock<std::mutex> lock(_mutex);
+	for (;;)
+	{
+		_wake.wait(lock, [this]() {
+			return _stopping || !_presents.empty() || (_acquireWanted && !_hasAcquired && !_freeSemaphores.empty());
+		});
+
+		// presents first: the image the next acquire waits for may be freed by one of them
+		if (!_presents.empty())
+		{
+			const Present present = _presents.front();
+			_presents.pop_front();
+			lock.unlock();
+
+			VkPresentInfoKHR presentInfo = {};
+			presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+			presentInfo.swapchainCount = 1;
+			presentInfo.pSwapchains = &_swapchain;
+			presentInfo.waitSemaphoreCount = 1;
+			presentInfo.pWaitSemaphores = &present.waitSemaphore;
+			presentInfo.pImageIndices = &present.imageIndex;
+#ifdef VK_KHR_present_wait
+			VkPresentIdKHR presentId = {};
+			if (present.presentId != 0)
+			{
+				presentId.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+				presentId.swapchainCount = 1;
+				presentId.pPresentIds = &present.presentId;
+				presentInfo.pNext = &presentId;
+			}
+#endif
+			VkResult result;
+			{
+				CPU_PROFILE_SCOPE("present");
+				std::lock_guard<std::mutex> queueLock(*_queueMutex);
+				result = vkQueuePresentKHR(_queue, &presentInfo);
+			}
+
+			lock.lock();
+			if (result != VK_SUCCESS && _presentResult == VK_SUCCESS)
+			{
+				_presentResult = result;
+			}
+			continue;
+		}
+		if (_stopping)
+		{
+			break;
+		}
+
+		VkSemaphore semaphore = _freeSemaphores.back();
+		_freeSemaphores.pop_back();
+		_acquireWanted = false;
+		lock.unlock();
+
+		Acquired acquired;
+		{
+			CPU_PROFILE_SCOPE("acquire");
+			acquired.result = vkAcquireNextImageKHR(_device, _swapchain, ACQUIRE_TIMEOUT_NS, semaphore, VK_NULL_HANDLE, &acquired.imageIndex);
+		}
+
+		lock.lock();
+		if (acquired.result == VK_SUCCESS || acquired.result == VK_SUBOPTIMAL_KHR)
+		{
+			acquired.semaphore = semaphore;
+		}
+		else
+		{
+			// nothing signals it
+			_freeSemaphores.push_back(semaphore);
+		}
+		_acquired = acquired;
+		_hasAcquired = true;
+		_acquiredReady.notify_one();
+	}
+}
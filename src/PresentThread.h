@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vk_types.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// vkQueuePresentKHR and vkAcquireNextImageKHR on a thread of their own, so the vblank either of them may block
+// for holds up that thread rather than the frame loop. A frame hands its finished image over with present();
+// right after presenting it the thread acquires the image for the next frame, which acquire() then hands out
+// without waiting unless the thread hasn't got it yet. Never acquiring before the last frame is presented keeps
+// a two-image swapchain from waiting on an image only a queued present would free.
+// Acquires signal semaphores of the thread's own, one more than there are frames in flight: each goes back with
+// release() once the fence of the frame that waited on it has signaled, the earliest it may be signaled again.
+class PresentThread
+{
+public:
+	struct Acquired {
+		VkResult result{ VK_NOT_READY };
+		uint32_t imageIndex{ 0 };
+		// signaled when the image is ready; null unless result is VK_SUCCESS or VK_SUBOPTIMAL_KHR
+		VkSemaphore semaphore{ VK_NULL_HANDLE };
+	};
+
+	// queueMutex is held around every present, for a queue other threads and sessions submit to as well
+	void init(VkDevice device, VkQueue queue, std::mutex& queueMutex, uint32_t frameOverlap);
+	// stopped, with the device idle
+	void cleanup();
+
+	// starts the thread acquiring from swapchain; the device must be idle since the last stop()
+	void start(VkSwapchainKHR swapchain);
+	// presents everything handed over and joins the thread. An image it acquired ahead is given up by a submit
+	// that waits on its semaphore, so wait for the device before start() reuses it
+	void stop();
+	bool running() const { return _thread.joinable(); }
+
+	// frame thread: the next image, once the thread has acquired it; VK_TIMEOUT after timeoutNs, and VK_NOT_READY
+	// while stopped
+	Acquired acquire(uint64_t timeoutNs);
+	// frame thread: queues imageIndex for presenting once waitSemaphore signals; presentId is 0 without present wait
+	void present(uint32_t imageIndex, VkSemaphore waitSemaphore, uint64_t presentId);
+	// frame thread: a semaphore acquire() handed out whose waiting submit has finished
+	void release(VkSemaphore semaphore);
+	// the first result of the presents since the last call that wasn't VK_SUCCESS, VK_SUCCESS if there was none
+	VkResult take_present_result();
+
+private:
+	struct Present {
+		uint32_t imageIndex;
+		VkSemaphore waitSemaphore;
+		uint64_t presentId;
+	};
+
+	void loop();
+
+	VkDevice _device{ VK_NULL_HANDLE };
+	VkQueue _queue{ VK_NULL_HANDLE };
+	std::mutex* _queueMutex{ nullptr };
+	VkSwapchainKHR _swapchain{ VK_NULL_HANDLE };
+	std::vector<VkSemaphore> _semaphores;
+
+	// everything below is under _mutex
+	std::mutex _mutex;
+	std::condition_variable _wake; // the thread: a present, a free semaphore or stop
+	std::condition_variable _acquiredReady; // the frame thread: _acquired is filled
+	std::deque<Present> _presents;
+	std::vector<VkSemaphore> _freeSemaphores;
+	bool _acquireWanted{ false };
+	bool _hasAcquired{ false };
+	Acquired _acquired;
+	VkResult _presentResult{ VK_SUCCESS };
+	bool _stopping{ false };
+
+	std::thread _thread;
+};
@@ -0,0 +1,194 @@
+#include "RayShadows.h"
+
+#include "vk_initializers.h"
+
+#include <cassert>
+
+namespace {
+	// matches the push constants of rayShadows.comp
+	struct TracePushConstants {
+		glm::mat4 inverseViewProjection;
+		glm::vec4 lightDirection; // w is the occlusion radius
+		uint32_t region[2];
+		float farDepth;
+		uint32_t aoRays;
+	};
+}
+
+void RayShadows::init(VkDevice device, VmaAllocator allocator, LayoutCache& layouts, VkShaderModule traceShader, VkPipelineCache cache, uint32_t frameCount)
+{
+	_device = device;
+	_allocator = allocator;
+
+	// the shader only texelFetches
+	VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	_sampler = layouts.sampler(samplerInfo);
+
+#ifdef VK_KHR_ray_query
+	if (traceShader == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	VkDescriptorPoolSize poolSizes[] = {
+		{ VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, frameCount },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, frameCount },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, frameCount },
+	};
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = frameCount;
+	poolInfo.poolSizeCount = 3;
+	poolInfo.pPoolSizes = poolSizes;
+	VK_CHECK(vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_descriptorPool));
+
+	VkDescriptorSetLayoutBinding bindings[] = {
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, VK_SHADER_STAGE_COMPUTE_BIT, 0), // scene
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1), // depth
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 2), // mask
+	};
+
+	VkDescriptorSetLayoutCreateInfo setInfo = {};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setInfo.pNext = nullptr;
+	setInfo.bindingCount = 3;
+	setInfo.pBindings = bindings;
+	VK_CHECK(vkCreateDescriptorSetLayout(_device, &setInfo, nullptr, &_setLayout));
+
+	_sets.resize(frameCount);
+	std::vector<VkDescriptorSetLayout> layouts(frameCount, _setLayout);
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = _descriptorPool;
+	allocInfo.descriptorSetCount = frameCount;
+	allocInfo.pSetLayouts = layouts.data();
+	VK_CHECK(vkAllocateDescriptorSets(_device, &allocInfo, _sets.data()));
+
+	VkPushConstantRange pushConstant;
+	pushConstant.offset = 0;
+	pushConstant.size = sizeof(TracePushConstants);
+	pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkPipelineLayoutCreateInfo layoutInfo = vkinit::pipeline_layout_create_info();
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &_setLayout;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushConstant;
+	VK_CHECK(vkCreatePipelineLayout(_device, &layoutInfo, nullptr, &_pipelineLayout));
+
+	VkComputePipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.pNext = nullptr;
+	pipelineInfo.layout = _pipelineLayout;
+	pipelineInfo.stage = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, traceShader);
+	VK_CHECK(vkCreateComputePipelines(_device, cache, 1, &pipelineInfo, nullptr, &_pipeline));
+#endif
+}
+
+void RayShadows::cleanup()
+{
+	destroy_image();
+	// the sampler goes with the layout cache
+	vkDestroyPipeline(_device, _pipeline, nullptr);
+	vkDestroyPipelineLayout(_device, _pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(_device, _setLayout, nullptr);
+	// frees the sets with it
+	vkDestroyDescriptorPool(_device, _descriptorPool, nullptr);
+}
+
+void RayShadows::resize(VkExtent2D extent)
+{
+	destroy_image();
+
+	_extent = ready() ? extent : VkExtent2D{ 1, 1 };
+	const VkImageUsageFlags usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	VkImageCreateInfo imageInfo = vkinit::image_create_info(FORMAT, usage, { _extent.width, _extent.height, 1 });
+
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+	allocInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	VK_CHECK(vmaCreateImage(_allocator, &imageInfo, &allocInfo, &_image._image, &_image._allocation, nullptr));
+
+	VkImageViewCreateInfo viewInfo = vkinit::imageview_create_info(FORMAT, _image._image, VK_IMAGE_ASPECT_COLOR_BIT);
+	VK_CHECK(vkCreateImageView(_device, &viewInfo, nullptr, &_view));
+}
+
+void RayShadows::clear(VkCommandBuffer cmd) const
+{
+	VkImageMemoryBarrier toTransfer = vkinit::image_barrier(_image._image, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+	VkClearColorValue open = { { 1.0f, 1.0f, 0.0f, 0.0f } };
+	VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	vkCmdClearColorImage(cmd, _image._image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &open, 1, &range);
+
+	VkImageMemoryBarrier toRead = vkinit::image_barrier(_image._image, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 0, nullptr, 0, nullptr, 1, &toRead);
+}
+
+#ifdef VK_KHR_ray_query
+void RayShadows::record(VkCommandBuffer cmd, uint32_t frame, const AccelerationStructures& structures, VkImageView depth, VkExtent2D region,
+	const glm::mat4& inverseViewProjection, glm::vec3 lightDirection, float farDepth) const
+{
+	assert(_pipeline != VK_NULL_HANDLE);
+
+	VkDescriptorSet set = _sets[frame];
+	VkAccelerationStructureKHR tlas = structures.tlas();
+	VkWriteDescriptorSetAccelerationStructureKHR structureInfo = {};
+	structureInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR;
+	structureInfo.accelerationStructureCount = 1;
+	structureInfo.pAccelerationStructures = &tlas;
+	VkWriteDescriptorSet structureWrite = {};
+	structureWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	structureWrite.pNext = &structureInfo;
+	structureWrite.dstSet = set;
+	structureWrite.dstBinding = 0;
+	structureWrite.descriptorCount = 1;
+	structureWrite.descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+
+	VkDescriptorImageInfo depthInfo = { _sampler, depth, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	VkDescriptorImageInfo maskInfo = { VK_NULL_HANDLE, _view, VK_IMAGE_LAYOUT_GENERAL };
+	VkWriteDescriptorSet writes[] = {
+		structureWrite,
+		vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, set, &depthInfo, 1),
+		vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, set, &maskInfo, 2),
+	};
+	vkUpdateDescriptorSets(_device, 3, writes, 0, nullptr);
+
+	TracePushConstants constants = {};
+	constants.inverseViewProjection = inverseViewProjection;
+	constants.lightDirection = glm::vec4(lightDirection, _aoRadius);
+	constants.region[0] = region.width;
+	constants.region[1] = region.height;
+	constants.farDepth = farDepth;
+	constants.aoRays = _aoRays;
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout, 0, 1, &set, 0, nullptr);
+	vkCmdPushConstants(cmd, _pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(TracePushConstants), &constants);
+	vkCmdDispatch(cmd, (region.width + 7) / 8, (region.height + 7) / 8, 1);
+}
+#else
+// never called: without ray queries there is no pipeline
+void RayShadows::record(VkCommandBuffer, uint32_t, const AccelerationStructures&, VkImageView, VkExtent2D, const glm::mat4&, glm::vec3, float) const
+{
+}
+#endif
+
+void RayShadows::destroy_image()
+{
+	if (_image._image == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	vkDestroyImageView(_device, _view, nullptr);
+	vmaDestroyImage(_allocator, _image._image, _image._allocation);
+	_image = {};
+	_view = VK_NULL_HANDLE;
+	_extent = { 0, 0 };
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vk_types.h>
+#include <AccelerationStructures.h>
+#include <LayoutCache.h>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include <vector>
+
+// Sun shadows and ambient occlusion traced with VK_KHR_ray_query against AccelerationStructures, into a
+// screen-space mask the mesh fragment shaders fetch at their pixel: red is how much sunlight reaches the
+// pixel, green how much of the sky its surroundings leave open. record() rebuilds each pixel's surface from
+// the depth of a depth-only prepass, one shadow ray toward the sun from it and _aoRays short rays over
+// the hemisphere of the normal the depth slopes give, rotated per pixel so the noise doesn't line up.
+// The mask always exists, so the global set always has something to point at: one texel of (1, 1) without
+// ray tracing, window-sized with it. It is in SHADER_READ_ONLY_OPTIMAL between frames.
+class RayShadows
+{
+public:
+	// two channels would do, but rgba8 is the narrowest format every device can store to without
+	// shaderStorageImageExtendedFormats
+	static constexpr VkFormat FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+
+	// without a shader, or without ray query support in the headers, there is no pipeline and record()
+	// must not be called
+	void init(VkDevice device, VmaAllocator allocator, LayoutCache& layouts, VkShaderModule traceShader, VkPipelineCache cache, uint32_t frameCount);
+	void cleanup();
+
+	bool ready() const { return _pipeline != VK_NULL_HANDLE; }
+
+	// (re)creates the mask, 1x1 whenever there is no pipeline; nothing may be using the old one. Its
+	// contents are undefined until clear()
+	void resize(VkExtent2D extent);
+	// every texel to fully lit and open, leaving the mask in SHADER_READ_ONLY_OPTIMAL visible to fragment
+	// and compute shaders
+	void clear(VkCommandBuffer cmd) const;
+
+	// inside a compute pass, after the top-level build: the top-left region of the mask, which is in GENERAL,
+	// from depth, in SHADER_READ_ONLY_OPTIMAL and rendered with viewProjection, whose inverse is given.
+	// lightDirection points from the sun. Rewrites the set of the frame slot it is given
+	void record(VkCommandBuffer cmd, uint32_t frame, const AccelerationStructures& structures, VkImageView depth, VkExtent2D region,
+		const glm::mat4& inverseViewProjection, glm::vec3 lightDirection, float farDepth) const;
+
+	uint32_t _aoRays{ 4 }; // occlusion rays per pixel; 0 leaves every pixel open
+	float _aoRadius{ 1.0f }; // world units an occluder counts within
+
+	VkImage image() const { return _image._image; }
+	VkImageView view() const { return _view; }
+	VkSampler sampler() const { return _sampler; }
+	VkExtent2D extent() const { return _extent; }
+
+private:
+	void destroy_image();
+
+	VkDevice _device{ VK_NULL_HANDLE };
+	VmaAllocator _allocator{ nullptr };
+
+	// the acceleration structure descriptor is one the shared allocator's pools don't have
+	VkDescriptorPool _descriptorPool{ VK_NULL_HANDLE };
+	VkDescriptorSetLayout _setLayout{ VK_NULL_HANDLE };
+	VkPipelineLayout _pipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline _pipeline{ VK_NULL_HANDLE };
+	VkSampler _sampler{ VK_NULL_HANDLE }; // depth and the mask are both only fetched
+	std::vector<VkDescriptorSet> _sets; // per frame slot
+
+	AllocatedImage _image{};
+	VkImageView _view{ VK_NULL_HANDLE };
+	VkExtent2D _extent{ 0, 0 };
+};
@@ -0,0 +1,566 @@
+#include "RenderCluster.h"
+
+#include "CpuProfiler.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace {
+#ifdef _WIN32
+	using Socket = SOCKET;
+	const Socket NO_SOCKET = INVALID_SOCKET;
+	void close_socket(Socket socket) { closesocket(socket); }
+#else
+	using Socket = int;
+	const Socket NO_SOCKET = -1;
+	void close_socket(Socket socket) { close(socket); }
+#endif
+
+	// every message: magic, version, type and payload size, then the payload
+	constexpr uint32_t MESSAGE_MAGIC = 0x4e524351; // "QCRN"
+	constexpr uint32_t PROTOCOL_VERSION = 1;
+	constexpr size_t HEADER_SIZE = 20;
+	// a header claiming more is garbage, not a result to allocate for
+	constexpr uint64_t MAX_PAYLOAD = 8ull << 30;
+
+	enum MessageType : uint32_t {
+		MESSAGE_JOB = 1,
+		MESSAGE_RESULT = 2,
+		MESSAGE_STOP = 3,
+	};
+
+	bool start_sockets()
+	{
+#ifdef _WIN32
+		WSADATA wsaData;
+		return WSAStartup(MAKEWORD(2, 2), &wsaData) == 0;
+#else
+		return true;
+#endif
+	}
+
+	void stop_sockets()
+	{
+#ifdef _WIN32
+		WSACleanup();
+#endif
+	}
+
+	// the whole of data, false once the peer is gone
+	bool send_all(Socket socket, const uint8_t* data, size_t size)
+	{
+		while (size > 0)
+		{
+#ifdef _WIN32
+			const int sent = send(socket, reinterpret_cast<const char*>(data), static_cast<int>(std::min<size_t>(size, 1 << 20)), 0);
+#else
+			const ssize_t sent = send(socket, data, size, MSG_NOSIGNAL);
+#endif
+			if (sent <= 0)
+			{
+				return false;
+			}
+			data += sent;
+			size -= static_cast<size_t>(sent);
+		}
+		return true;
+	}
+
+	// blocks until size bytes are in, however long a render takes; false once the peer is gone
+	bool receive_all(Socket socket, uint8_t* data, size_t size)
+	{
+		while (size > 0)
+		{
+#ifdef _WIN32
+			const int received = recv(socket, reinterpret_cast<char*>(data), static_cast<int>(std::min<size_t>(size, 1 << 20)), 0);
+#else
+			const ssize_t received = recv(socket, data, size, 0);
+#endif
+			if (received <= 0)
+			{
+				return false;
+			}
+			data += received;
+			size -= static_cast<size_t>(received);
+		}
+		return true;
+	}
+
+	// little-endian whatever the machines are, so mixed clusters agree
+	class Writer
+	{
+	public:
+		void u32(uint32_t value)
+		{
+			for (uint32_t i = 0; i < 4; i++) _bytes.push_back(static_cast<uint8_t>(value >> (i * 8)));
+		}
+		void u64(uint64_t value)
+		{
+			u32(static_cast<uint32_t>(value));
+			u32(static_cast<uint32_t>(value >> 32));
+		}
+		void bytes(const uint8_t* data, size_t size)
+		{
+			u64(size);
+			_bytes.insert(_bytes.end(), data, data + size);
+		}
+		void string(const std::string& text) { bytes(reinterpret_cast<const uint8_t*>(text.data()), text.size()); }
+
+		std::vector<uint8_t>& data() { return _bytes; }
+
+	private:
+		std::vector<uint8_t> _bytes;
+	};
+
+	// reads past the end fail, and every read after
+	class Reader
+	{
+	public:
+		Reader(const std::vector<uint8_t>& bytes) : _bytes(bytes) {}
+
+		uint32_t u32()
+		{
+			if (!_ok || _bytes.size() - _offset < 4)
+			{
+				_ok = false;
+				return 0;
+			}
+			uint32_t value = 0;
+			for (uint32_t i = 0; i < 4; i++) value |= static_cast<uint32_t>(_bytes[_offset + i]) << (i * 8);
+			_offset += 4;
+			return value;
+		}
+		uint64_t u64()
+		{
+			const uint64_t low = u32();
+			return low | static_cast<uint64_t>(u32()) << 32;
+		}
+		bool bytes(std::vector<uint8_t>& out)
+		{
+			const uint64_t size = u64();
+			if (!_ok || _bytes.size() - _offset < size)
+			{
+				_ok = false;
+				return false;
+			}
+			out.assign(_bytes.begin() + _offset, _bytes.begin() + _offset + size);
+			_offset += static_cast<size_t>(size);
+			return true;
+		}
+		std::string string()
+		{
+			std::vector<uint8_t> text;
+			bytes(text);
+			return std::string(text.begin(), text.end());
+		}
+
+		bool ok() const { return _ok; }
+
+	private:
+		const std::vector<uint8_t>& _bytes;
+		size_t _offset{ 0 };
+		bool _ok{ true };
+	};
+
+	bool send_message(Socket socket, MessageType type, const std::vector<uint8_t>& payload)
+	{
+		Writer header;
+		header.u32(MESSAGE_MAGIC);
+		header.u32(PROTOCOL_VERSION);
+		header.u32(type);
+		header.u64(payload.size());
+		return send_all(socket, header.data().data(), header.data().size()) && send_all(socket, payload.data(), payload.size());
+	}
+
+	// false when the peer left, or sent something that isn't a message of this version
+	bool receive_message(Socket socket, uint32_t& type, std::vector<uint8_t>& payload)
+	{
+		std::vector<uint8_t> header(HEADER_SIZE);
+		if (!receive_all(socket, header.data(), header.size()))
+		{
+			return false;
+		}
+		Reader reader(header);
+		const uint32_t magic = reader.u32();
+		const uint32_t version = reader.u32();
+		type = reader.u32();
+		const uint64_t size = reader.u64();
+		if (magic != MESSAGE_MAGIC || version != PROTOCOL_VERSION || size > MAX_PAYLOAD)
+		{
+			LOG_WARN("Render cluster: a message of another protocol or version, disconnecting");
+			return false;
+		}
+		payload.resize(static_cast<size_t>(size));
+		return receive_all(socket, payload.data(), payload.size());
+	}
+
+	std::vector<uint8_t> encode_job(const RenderJob& job)
+	{
+		Writer writer;
+		writer.u32(job.id);
+		writer.u32(static_cast<uint32_t>(job.kind));
+		writer.string(job.scene);
+		writer.u32(static_cast<uint32_t>(job.camera));
+		writer.u64(job.tick);
+		writer.u32(job.width);
+		writer.u32(job.height);
+		writer.u32(job.tileSize);
+		writer.u32(job.first);
+		writer.u32(job.count);
+		return std::move(writer.data());
+	}
+
+	bool decode_job(const std::vector<uint8_t>& payload, RenderJob& job)
+	{
+		Reader reader(payload);
+		job.id = reader.u32();
+		const uint32_t kind = reader.u32();
+		job.scene = reader.string();
+		const uint32_t camera = reader.u32();
+		job.tick = reader.u64();
+		job.width = reader.u32();
+		job.height = reader.u32();
+		job.tileSize = reader.u32();
+		job.first = reader.u32();
+		job.count = reader.u32();
+		job.kind = static_cast<RenderJobKind>(kind);
+		job.camera = static_cast<CameraPath>(camera);
+		return reader.ok() && kind <= static_cast<uint32_t>(RenderJobKind::Frames) && camera <= static_cast<uint32_t>(CameraPath::Orbit);
+	}
+
+	std::vector<uint8_t> encode_result(const RenderJobResult& result)
+	{
+		size_t size = 64 + result.error.size();
+		for (const RenderPart& part : result.parts)
+		{
+			size += 32 + part.data.size();
+		}
+		Writer writer;
+		writer.data().reserve(size);
+		writer.u32(result.id);
+		writer.u32(result.ok ? 1 : 0);
+		writer.string(result.error);
+		writer.u32(static_cast<uint32_t>(result.parts.size()));
+		for (const RenderPart& part : result.parts)
+		{
+			writer.u32(part.index);
+			writer.u32(part.imageFormat);
+			writer.u32(part.width);
+			writer.u32(part.height);
+			writer.u32(part.keyFrame ? 1 : 0);
+			writer.bytes(part.data.data(), part.data.size());
+		}
+		return std::move(writer.data());
+	}
+
+	bool decode_result(const std::vector<uint8_t>& payload, RenderJobResult& result)
+	{
+		Reader reader(payload);
+		result.id = reader.u32();
+		result.ok = reader.u32() != 0;
+		result.error = reader.string();
+		const uint32_t count = reader.u32();
+		result.parts.clear();
+		for (uint32_t i = 0; i < count && reader.ok(); i++)
+		{
+			RenderPart part;
+			part.index = reader.u32();
+			part.imageFormat = reader.u32();
+			part.width = reader.u32();
+			part.height = reader.u32();
+			part.keyFrame = reader.u32() != 0;
+			reader.bytes(part.data);
+			result.parts.push_back(std::move(part));
+		}
+		return reader.ok();
+	}
+
+	// host:port to a connected socket, NO_SOCKET when it doesn't answer
+	Socket connect_to(const std::string& address)
+	{
+		const size_t colon = address.rfind(':');
+		if (colon == std::string::npos)
+		{
+			LOG_ERROR("Render cluster: " << address << " isn't host:port");
+			return NO_SOCKET;
+		}
+		const std::string host = address.substr(0, colon);
+		const std::string port = address.substr(colon + 1);
+
+		addrinfo hints = {};
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_protocol = IPPROTO_TCP;
+		addrinfo* addresses = nullptr;
+		if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0)
+		{
+			LOG_ERROR("Render cluster: could not resolve " << host);
+			return NO_SOCKET;
+		}
+		Socket connected = NO_SOCKET;
+		for (addrinfo* candidate = addresses; candidate != nullptr && connected == NO_SOCKET; candidate = candidate->ai_next)
+		{
+			const Socket attempt = socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+			if (attempt == NO_SOCKET)
+			{
+				continue;
+			}
+			if (connect(attempt, candidate->ai_addr, static_cast<int>(candidate->ai_addrlen)) == 0)
+			{
+				connected = attempt;
+			}
+			else
+			{
+				close_socket(attempt);
+			}
+		}
+		freeaddrinfo(addresses);
+		return connected;
+	}
+}
+
+bool RenderNode::listen(uint16_t port)
+{
+	if (!start_sockets())
+	{
+		LOG_ERROR("Render node: no Winsock");
+		return false;
+	}
+	const Socket listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (listenSocket == NO_SOCKET)
+	{
+		LOG_ERROR("Render node: could not create a socket");
+		stop_sockets();
+		return false;
+	}
+	// a restarted node gets its port back while the old connection lingers
+	const int reuse = 1;
+	setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(port);
+	if (bind(listenSocket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listenSocket, 1) != 0)
+	{
+		LOG_ERROR("Render node: could not listen on port " << port);
+		close_socket(listenSocket);
+		stop_sockets();
+		return false;
+	}
+	_listenSocket = static_cast<intptr_t>(listenSocket);
+	LOG_INFO("Render node listening on port " << port);
+	return true;
+}
+
+void RenderNode::serve(const Handler& handler)
+{
+	cpu_profiler::set_thread_name("render node");
+	const Socket listenSocket = static_cast<Socket>(_listenSocket);
+	for (;;)
+	{
+		const Socket coordinator = accept(listenSocket, nullptr, nullptr);
+		if (coordinator == NO_SOCKET)
+		{
+			continue;
+		}
+		LOG_INFO("Render node: a coordinator connected");
+
+		uint32_t jobs = 0;
+		bool stopped = false;
+		uint32_t type = 0;
+		std::vector<uint8_t> payload;
+		while (receive_message(coordinator, type, payload))
+		{
+			if (type == MESSAGE_STOP)
+			{
+				stopped = true;
+				break;
+			}
+			RenderJob job;
+			if (type != MESSAGE_JOB || !decode_job(payload, job))
+			{
+				LOG_WARN("Render node: not a job, disconnecting");
+				break;
+			}
+			RenderJobResult result = handler(job);
+			result.id = job.id;
+			jobs++;
+			if (!send_message(coordinator, MESSAGE_RESULT, encode_result(result)))
+			{
+				break;
+			}
+		}
+		close_socket(coordinator);
+		LOG_INFO("Render node: the coordinator left after " << jobs << " jobs");
+		if (stopped)
+		{
+			return;
+		}
+	}
+}
+
+void RenderNode::close()
+{
+	if (_listenSocket == -1)
+	{
+		return;
+	}
+	close_socket(static_cast<Socket>(_listenSocket));
+	_listenSocket = -1;
+	stop_sockets();
+}
+
+bool RenderCoordinator::connect(const std::vector<std::string>& nodes)
+{
+	if (!start_sockets())
+	{
+		LOG_ERROR("Render coordinator: no Winsock");
+		return false;
+	}
+	for (const std::string& address : nodes)
+	{
+		const Socket socket = connect_to(address);
+		if (socket == NO_SOCKET)
+		{
+			LOG_WARN("Render node " << address << " didn't answer, going without it");
+			continue;
+		}
+		auto node = std::make_unique<Node>();
+		node->address = address;
+		node->socket = static_cast<intptr_t>(socket);
+		_nodes.push_back(std::move(node));
+	}
+	if (_nodes.empty())
+	{
+		stop_sockets();
+		return false;
+	}
+	LOG_INFO("Render coordinator connected to " << _nodes.size() << " of " << nodes.size() << " nodes");
+	return true;
+}
+
+void RenderCoordinator::submit(RenderJob job)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_jobs.push_back(std::move(job));
+}
+
+bool RenderCoordinator::run(const ResultHandler& handler)
+{
+	std::vector<std::thread> threads;
+	for (auto& node : _nodes)
+	{
+		if (node->live)
+		{
+			threads.emplace_back([this, &node, &handler]() { node_loop(*node, handler); });
+		}
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	for (const auto& node : _nodes)
+	{
+		LOG_INFO("Render node " << node->address << ": " << node->jobsRun << " jobs");
+	}
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (!_jobs.empty())
+	{
+		LOG_ERROR("Render coordinator: no node left for the last " << _jobs.size() << " jobs");
+		_jobs.clear();
+		return false;
+	}
+	return true;
+}
+
+void RenderCoordinator::node_loop(Node& node, const ResultHandler& handler)
+{
+	cpu_profiler::set_thread_name("render coordinator");
+	const Socket socket = static_cast<Socket>(node.socket);
+	std::unique_lock<std::mutex> lock(_mutex);
+	for (;;)
+	{
+		// a job in flight elsewhere may yet come back to the queue
+		_wake.wait(lock, [this]() { return !_jobs.empty() || _inFlight == 0; });
+		if (_jobs.empty())
+		{
+			return;
+		}
+		RenderJob job = std::move(_jobs.front());
+		_jobs.pop_front();
+		_inFlight++;
+		lock.unlock();
+
+		RenderJobResult result;
+		uint32_t type = 0;
+		std::vector<uint8_t> payload;
+		bool answered = send_message(socket, MESSAGE_JOB, encode_job(job)) && receive_message(socket, type, payload)
+			&& type == MESSAGE_RESULT && decode_result(payload, result) && result.id == job.id;
+		if (answered && !result.ok)
+		{
+			LOG_ERROR("Render node " << node.address << " failed job " << job.id << ": " << result.error);
+		}
+		else if (!answered)
+		{
+			LOG_ERROR("Render node " << node.address << " dropped job " << job.id);
+		}
+		if (answered && result.ok)
+		{
+			handler(job, result);
+			if (!result.ok)
+			{
+				LOG_ERROR("Render node " << node.address << " sent an unusable result for job " << job.id << ": " << result.error);
+			}
+		}
+
+		lock.lock();
+		_inFlight--;
+		if (!answered || !result.ok)
+		{
+			// given to the others, and this node takes no more
+			node.live = false;
+			_jobs.push_front(std::move(job));
+			_wake.notify_all();
+			return;
+		}
+		node.jobsRun++;
+		_wake.notify_all();
+	}
+}
+
+void RenderCoordinator::stop_nodes()
+{
+	// the ones that failed a job too; a dropped connection just doesn't take it
+	for (const auto& node : _nodes)
+	{
+		send_message(static_cast<Socket>(node->socket), MESSAGE_STOP, std::vector<uint8_t>());
+	}
+	close();
+}
+
+void RenderCoordinator::close()
+{
+	if (_nodes.empty())
+	{
+		return;
+	}
+	for (const auto& node : _nodes)
+	{
+		close_socket(static_cast<Socket>(node->socket));
+	}
+	_nodes.clear();
+	stop_sockets();
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <Benchmark.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class RenderJobKind : uint32_t {
+	Tiles, // tiles of a still, read back
+	Frames, // a run of frames along a camera path, encoded to H.264
+};
+
+// One piece of an offline batch as the coordinator ships it to a node: which scene, where the camera is and
+// what to render of it, never the scene itself. scene is the path of a scene snapshot (--scene-snapshot) as
+// the nodes find it, made of the sources their own command lines load; empty for the level those build
+struct RenderJob {
+	uint32_t id{ 0 };
+	RenderJobKind kind{ RenderJobKind::Tiles };
+	std::string scene;
+	CameraPath camera{ CameraPath::Static };
+	uint64_t tick{ 0 }; // the simulation step the view is at; of the first frame for Frames
+	// Tiles: the size of the still and its largest tile, which make its TileGrid; Frames: the frames' size
+	uint32_t width{ 0 };
+	uint32_t height{ 0 };
+	uint32_t tileSize{ 0 };
+	// Tiles: the grid's tiles from first, in row order; Frames: count frames from tick on, first unused
+	uint32_t first{ 0 };
+	uint32_t count{ 0 };
+};
+
+// a tile's readback, or a frame's packet of Annex B stream
+struct RenderPart {
+	uint32_t index{ 0 }; // the tile, or the frame from the job's first
+	uint32_t imageFormat{ 0 }; // Tiles: the VkFormat the Rgba pixels are in
+	uint32_t width{ 0 };
+	uint32_t height{ 0 };
+	bool keyFrame{ false };
+	std::vector<uint8_t> data;
+};
+
+struct RenderJobResult {
+	uint32_t id{ 0 };
+	bool ok{ false };
+	std::string error; // why not, for the coordinator's log
+	std::vector<RenderPart> parts; // every tile or frame of the job, in order
+};
+
+// The node's side: a headless engine process on a machine of the cluster, listening for one coordinator at a
+// time and rendering its jobs in the order they come. Jobs are rendered on the thread calling serve(), which
+// owns the engine
+class RenderNode
+{
+public:
+	// renders job on the calling thread; a result that isn't ok retires the node for that coordinator's batch
+	using Handler = std::function<RenderJobResult(const RenderJob& job)>;
+
+	// listens on every interface; false when the port can't be bound
+	bool listen(uint16_t port);
+	// answers coordinators one after another until one of them stops the node
+	void serve(const Handler& handler);
+	void close();
+
+private:
+	intptr_t _listenSocket{ -1 };
+};
+
+// The coordinator's side: connects to every node, keeps one job in flight on each and hands the next to
+// whichever answers first, so faster machines end up with more of the batch. A node that drops its
+// connection or fails a job takes no more; that job goes back to the queue for the others
+class RenderCoordinator
+{
+public:
+	// on the thread of the node that rendered job; may be called for several nodes at once. A handler that
+	// can't use the result clears its ok, with an error, and the job is rendered again elsewhere
+	using ResultHandler = std::function<void(const RenderJob& job, RenderJobResult& result)>;
+
+	// "host:port" each; false when none of them answered
+	bool connect(const std::vector<std::string>& nodes);
+	void submit(RenderJob job);
+	// runs every job queued, then returns; false when jobs were left over with no node to take them
+	bool run(const ResultHandler& handler);
+	// tells every node to exit, then disconnects
+	void stop_nodes();
+	void close();
+
+	size_t node_count() const { return _nodes.size(); }
+
+private:
+	struct Node {
+		std::string address;
+		intptr_t socket{ -1 };
+		uint32_t jobsRun{ 0 };
+		bool live{ true };
+	};
+
+	void node_loop(Node& node, const ResultHandler& handler);
+
+	std::vector<std::unique_ptr<Node>> _nodes;
+	std::deque<RenderJob> _jobs;
+	uint32_t _inFlight{ 0 };
+	std::mutex _mutex;
+	std::condition_variable _wake;
+};
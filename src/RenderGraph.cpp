@@ -0,0 +1,1080 @@
+#include "RenderGraph.h"
+
+#include "Log.h"
+#include "vk_initializers.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace {
+	// accesses that make memory dirty; the rest only need the writes before them made visible
+	constexpr VkAccessFlags WRITE_ACCESS = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+		| VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+	constexpr uint32_t NOT_USED = UINT32_MAX;
+	constexpr uint32_t MAX_ATTACHMENTS = 8;
+
+	// what TRANSIENT_ATTACHMENT may be combined with
+	constexpr VkImageUsageFlags ATTACHMENT_USAGE = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
+		| VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+
+	VkImageUsageFlags usage_for(RenderGraphAccess access)
+	{
+		switch (access)
+		{
+		case RenderGraphAccess::ColorAttachment: return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		case RenderGraphAccess::DepthAttachment:
+		case RenderGraphAccess::DepthRead: return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		case RenderGraphAccess::SampledFragment:
+		case RenderGraphAccess::SampledCompute: return VK_IMAGE_USAGE_SAMPLED_BIT;
+		case RenderGraphAccess::StorageCompute: return VK_IMAGE_USAGE_STORAGE_BIT;
+		case RenderGraphAccess::TransferSrc: return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		case RenderGraphAccess::TransferDst: return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+#ifdef VK_KHR_fragment_shading_rate
+		case RenderGraphAccess::ShadingRateRead: return VK_IMAGE_USAGE_FRAGMENT_SHADING_RATE_ATTACHMENT_BIT_KHR;
+#endif
+		default: return 0;
+		}
+	}
+
+	// where a resource stands while the barriers are worked out
+	struct TrackedState {
+		VkImageLayout layout;
+		// the last writes (or layout transition) and who has to wait for them
+		VkPipelineStageFlags writeStages;
+		VkAccessFlags writeAccess;
+		// readers since then, which a later write or transition must wait for
+		VkPipelineStageFlags readStages;
+		// stages and accesses the last write has already been made visible to
+		VkPipelineStageFlags visibleStages;
+		VkAccessFlags visibleAccess;
+	};
+
+	TrackedState tracked_from(const RenderGraphState& state)
+	{
+		TrackedState tracked = {};
+		tracked.layout = state.layout;
+		if (state.access & WRITE_ACCESS)
+		{
+			tracked.writeStages = state.stages;
+			tracked.writeAccess = state.access & WRITE_ACCESS;
+		}
+		else
+		{
+			tracked.readStages = state.stages;
+		}
+		return tracked;
+	}
+}
+
+RenderGraphState RenderGraphState::of(RenderGraphAccess access)
+{
+	switch (access)
+	{
+	case RenderGraphAccess::ColorAttachment:
+		return { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT };
+	case RenderGraphAccess::DepthAttachment:
+		return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT };
+	case RenderGraphAccess::DepthRead:
+		return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT };
+	case RenderGraphAccess::SampledFragment:
+		return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT };
+	case RenderGraphAccess::SampledCompute:
+		return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT };
+	case RenderGraphAccess::StorageCompute:
+		return { VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT };
+	case RenderGraphAccess::TransferSrc:
+		return { VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT };
+	case RenderGraphAccess::TransferDst:
+		return { VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT };
+	case RenderGraphAccess::IndirectRead:
+		return { VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT };
+	case RenderGraphAccess::VertexRead:
+		return { VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+			VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT };
+#ifdef VK_KHR_fragment_shading_rate
+	case RenderGraphAccess::ShadingRateRead:
+		return { VK_IMAGE_LAYOUT_FRAGMENT_SHADING_RATE_ATTACHMENT_OPTIMAL_KHR, VK_PIPELINE_STAGE_FRAGMENT_SHADING_RATE_ATTACHMENT_BIT_KHR,
+			VK_ACCESS_FRAGMENT_SHADING_RATE_ATTACHMENT_READ_BIT_KHR };
+#endif
+	case RenderGraphAccess::Present:
+		// presentation is ordered by the semaphore, so the transition only waits
+		return { VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0 };
+	case RenderGraphAccess::Undefined:
+	default:
+		return { VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0 };
+	}
+}
+
+void RenderGraph::init(VkDevice device, VmaAllocator allocator)
+{
+	_device = device;
+	_allocator = allocator;
+}
+
+void RenderGraph::cleanup()
+{
+	release_framebuffers();
+	for (VkRenderPass renderPass : _renderPasses)
+	{
+		vkDestroyRenderPass(_device, renderPass, nullptr);
+	}
+	for (VkImageView view : _transientViews)
+	{
+		vkDestroyImageView(_device, view, nullptr);
+	}
+	for (VkImage image : _transientImages)
+	{
+		vkDestroyImage(_device, image, nullptr);
+	}
+	for (VmaAllocation block : _transientMemoryBlocks)
+	{
+		vmaFreeMemory(_allocator, block);
+	}
+	_renderPasses.clear();
+	_transientViews.clear();
+	_transientImages.clear();
+	_transientMemoryBlocks.clear();
+	reset();
+}
+
+void RenderGraph::reset()
+{
+	_resources.clear();
+	_passes.clear();
+	_finalBarriers.clear();
+	_compiled = false;
+}
+
+RenderGraphResource RenderGraph::import_image(const char* name, VkFormat format, VkExtent2D extent, VkImageAspectFlags aspect,
+	RenderGraphState initial, RenderGraphAccess finalAccess)
+{
+	Resource resource = {};
+	resource.name = name;
+	resource.isImage = true;
+	resource.imported = true;
+	resource.desc = { format, extent, aspect };
+	resource.initial = initial;
+	resource.finalAccess = finalAccess;
+	_resources.push_back(resource);
+	_compiled = false;
+	return static_cast<RenderGraphResource>(_resources.size() - 1);
+}
+
+RenderGraphResource RenderGraph::import_buffer(const char* name, RenderGraphState initial)
+{
+	Resource resource = {};
+	resource.name = name;
+	resource.isImage = false;
+	resource.imported = true;
+	resource.initial = initial;
+	resource.finalAccess = RenderGraphAccess::Undefined;
+	_resources.push_back(resource);
+	_compiled = false;
+	return static_cast<RenderGraphResource>(_resources.size() - 1);
+}
+
+RenderGraphResource RenderGraph::create_image(const char* name, const RenderGraphImageDesc& desc)
+{
+	Resource resource = {};
+	resource.name = name;
+	resource.isImage = true;
+	resource.imported = false;
+	resource.desc = desc;
+	resource.initial = RenderGraphState::of(RenderGraphAccess::Undefined);
+	resource.finalAccess = RenderGraphAccess::Undefined;
+	_resources.push_back(resource);
+	_compiled = false;
+	return static_cast<RenderGraphResource>(_resources.size() - 1);
+}
+
+uint32_t RenderGraph::add_pass(const char* name, ExecuteFunction execute)
+{
+	Pass pass;
+	pass.name = name;
+	pass.execute = std::move(execute);
+	_passes.push_back(std::move(pass));
+	_compiled = false;
+	return static_cast<uint32_t>(_passes.size() - 1);
+}
+
+void RenderGraph::read(uint32_t pass, RenderGraphResource resource, RenderGraphAccess access)
+{
+	_passes[pass].uses.push_back({ resource, access, true, false, false });
+	_compiled = false;
+}
+
+void RenderGraph::write(uint32_t pass, RenderGraphResource resource, RenderGraphAccess access)
+{
+	// storage access is read-modify-write as far as the graph can tell
+	const bool reads = access == RenderGraphAccess::StorageCompute;
+	_passes[pass].uses.push_back({ resource, access, reads, true, false });
+	_compiled = false;
+}
+
+void RenderGraph::color_attachment(uint32_t pass, RenderGraphResource image, VkAttachmentLoadOp loadOp, VkClearValue clear)
+{
+	const bool load = loadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+	_passes[pass].uses.push_back({ image, RenderGraphAccess::ColorAttachment, load, true, !load });
+	_passes[pass].attachments.push_back({ image, loadOp, RenderGraphState::of(RenderGraphAccess::ColorAttachment).layout, false, false, NO_RESOLVE });
+	_passes[pass].clearValues.push_back(clear);
+	_compiled = false;
+}
+
+void RenderGraph::depth_attachment(uint32_t pass, RenderGraphResource image, VkAttachmentLoadOp loadOp, VkClearValue clear, bool readOnly)
+{
+	const bool load = loadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+	if (readOnly)
+	{
+		_passes[pass].uses.push_back({ image, RenderGraphAccess::DepthRead, true, false, false });
+	}
+	else
+	{
+		_passes[pass].uses.push_back({ image, RenderGraphAccess::DepthAttachment, load, true, !load });
+	}
+	const RenderGraphAccess access = readOnly ? RenderGraphAccess::DepthRead : RenderGraphAccess::DepthAttachment;
+	_passes[pass].attachments.push_back({ image, loadOp, RenderGraphState::of(access).layout, true, readOnly, NO_RESOLVE });
+	_passes[pass].clearValues.push_back(clear);
+	_compiled = false;
+}
+
+void RenderGraph::resolve_attachment(uint32_t pass, RenderGraphResource color, RenderGraphResource target)
+{
+	// color attachments bind in declaration order, so the source's binding is the colors before it
+	uint32_t colorIndex = 0;
+	bool found = false;
+	for (const Attachment& attachment : _passes[pass].attachments)
+	{
+		if (attachment.image == color)
+		{
+			found = true;
+			break;
+		}
+		if (!attachment.depth && attachment.resolveSource == NO_RESOLVE)
+		{
+			colorIndex++;
+		}
+	}
+	assert(found);
+	(void)found;
+
+	// every sample is averaged into it, so nothing of its previous contents survives
+	_passes[pass].uses.push_back({ target, RenderGraphAccess::ColorAttachment, false, true, true });
+	_passes[pass].attachments.push_back({ target, VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+		RenderGraphState::of(RenderGraphAccess::ColorAttachment).layout, false, false, colorIndex });
+	_passes[pass].clearValues.push_back({});
+	_compiled = false;
+}
+
+void RenderGraph::shading_rate_attachment(uint32_t pass, RenderGraphResource image, VkExtent2D texelSize)
+{
+	_passes[pass].uses.push_back({ image, RenderGraphAccess::ShadingRateRead, true, false, false });
+	_passes[pass].shadingRate = image;
+	_passes[pass].shadingRateTexelSize = texelSize;
+	_compiled = false;
+}
+
+void RenderGraph::keep(uint32_t pass)
+{
+	_passes[pass].keep = true;
+	_compiled = false;
+}
+
+void RenderGraph::set_view_mask(uint32_t pass, uint32_t viewMask)
+{
+	_passes[pass].viewMask = viewMask;
+	_compiled = false;
+}
+
+void RenderGraph::compile(DeletionQueue& retired)
+{
+	retire(retired);
+
+	cull_passes();
+	allocate_transients();
+	build_barriers();
+	for (Pass& pass : _passes)
+	{
+		if (pass.live && !pass.attachments.empty())
+		{
+			resolve_attachments(pass);
+			if (!_dynamicRendering)
+			{
+				build_render_pass(pass);
+			}
+		}
+	}
+
+	_compiled = true;
+	LOG_INFO("Render graph: " << (_passes.size() - _culledPassCount) << " passes (" << _culledPassCount << " culled), "
+		<< _barrierCount << " barriers, " << _transientMemory / 1024 << " KiB of transient memory, "
+		<< _lazyMemory / 1024 << " KiB lazily allocated");
+}
+
+void RenderGraph::retire(DeletionQueue& retired)
+{
+	for (const Framebuffer& framebuffer : _framebuffers)
+	{
+		retired.push_framebuffer(framebuffer.framebuffer);
+	}
+	for (VkRenderPass renderPass : _renderPasses)
+	{
+		retired.push_render_pass(renderPass);
+	}
+	_framebuffers.clear();
+	_renderPasses.clear();
+
+	if (!_transientImages.empty() || !_transientMemoryBlocks.empty())
+	{
+		// the images alias the blocks, so everything goes in one go: views, then images, then their memory
+		retired.push_function([device = _device, allocator = _allocator, views = std::move(_transientViews),
+			images = std::move(_transientImages), blocks = std::move(_transientMemoryBlocks)]() {
+			for (VkImageView view : views)
+			{
+				vkDestroyImageView(device, view, nullptr);
+			}
+			for (VkImage image : images)
+			{
+				vkDestroyImage(device, image, nullptr);
+			}
+			for (VmaAllocation block : blocks)
+			{
+				vmaFreeMemory(allocator, block);
+			}
+		});
+	}
+	_transientViews.clear();
+	_transientImages.clear();
+	_transientMemoryBlocks.clear();
+}
+
+void RenderGraph::cull_passes()
+{
+	// walking back from the end, a pass is needed when it's kept, writes something the graph hands
+	// back to the outside, or writes what a later needed pass reads
+	std::vector<bool> needed(_resources.size(), false);
+	_culledPassCount = 0;
+	for (size_t p = _passes.size(); p-- > 0;)
+	{
+		Pass& pass = _passes[p];
+		pass.live = pass.keep;
+		for (const Use& use : pass.uses)
+		{
+			if (use.writes && (_resources[use.resource].imported || needed[use.resource]))
+			{
+				pass.live = true;
+			}
+		}
+
+		if (!pass.live)
+		{
+			_culledPassCount++;
+			continue;
+		}
+
+		// an overwrite ends the previous contents' lifetime; what this pass reads, earlier passes must produce
+		for (const Use& use : pass.uses)
+		{
+			if (use.overwrites)
+			{
+				needed[use.resource] = false;
+			}
+		}
+		for (const Use& use : pass.uses)
+		{
+			if (use.reads)
+			{
+				needed[use.resource] = true;
+			}
+		}
+	}
+
+	for (Resource& resource : _resources)
+	{
+		resource.usage = resource.desc.usage;
+		resource.firstUse = NOT_USED;
+		resource.lastUse = NOT_USED;
+		resource.block = NOT_USED;
+		resource.lazy = !resource.imported && (resource.desc.usage & ~ATTACHMENT_USAGE) == 0;
+	}
+	for (uint32_t p = 0; p < _passes.size(); p++)
+	{
+		if (!_passes[p].live)
+		{
+			continue;
+		}
+		for (const Use& use : _passes[p].uses)
+		{
+			Resource& resource = _resources[use.resource];
+			resource.usage |= usage_for(use.access);
+			// an attachment that every pass clears or discards never has to leave on-chip memory
+			const bool attachment = use.access == RenderGraphAccess::ColorAttachment || use.access == RenderGraphAccess::DepthAttachment;
+			resource.lazy &= attachment && use.overwrites;
+			if (resource.firstUse == NOT_USED)
+			{
+				resource.firstUse = p;
+			}
+			resource.lastUse = p;
+		}
+	}
+}
+
+void RenderGraph::allocate_transients()
+{
+	struct Block {
+		VkMemoryRequirements requirements;
+		bool lazy;
+		std::vector<RenderGraphResource> occupants;
+	};
+	std::vector<Block> blocks;
+
+	struct Placement {
+		VkMemoryRequirements requirements;
+		RenderGraphResource resource;
+	};
+	VmaAllocationCreateInfo lazyInfo = {};
+	lazyInfo.usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
+
+	// biggest first, so the first occupant of a block decides its size and the rest fit
+	std::vector<Placement> bySize;
+	for (RenderGraphResource r = 0; r < _resources.size(); r++)
+	{
+		Resource& resource = _resources[r];
+		if (resource.imported || resource.firstUse == NOT_USED)
+		{
+			continue;
+		}
+
+		VkExtent3D extent = { resource.desc.extent.width, resource.desc.extent.height, 1 };
+		const VkImageUsageFlags usage = resource.usage | (resource.lazy ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : 0);
+		VkImageCreateInfo imageInfo = vkinit::image_create_info(resource.desc.format, usage, extent);
+		imageInfo.samples = resource.desc.samples;
+		imageInfo.arrayLayers = resource.desc.layers;
+		VK_CHECK(vkCreateImage(_device, &imageInfo, nullptr, &resource.image));
+		_transientImages.push_back(resource.image);
+		if (_namer)
+		{
+			_namer(VK_OBJECT_TYPE_IMAGE, (uint64_t)resource.image, resource.name.c_str());
+		}
+
+		Placement placement = {};
+		placement.resource = r;
+		vkGetImageMemoryRequirements(_device, resource.image, &placement.requirements);
+		bySize.push_back(placement);
+
+		// tile-based GPUs back lazily allocated memory only when a tile has to spill, which these never
+		// do; desktop GPUs have no such memory type and take the image in an ordinary block
+		if (resource.lazy)
+		{
+			uint32_t typeIndex;
+			resource.lazy = vmaFindMemoryTypeIndex(_allocator, placement.requirements.memoryTypeBits, &lazyInfo, &typeIndex) == VK_SUCCESS;
+		}
+	}
+	std::sort(bySize.begin(), bySize.end(), [](const Placement& a, const Placement& b) { return a.requirements.size > b.requirements.size; });
+
+	for (const Placement& placement : bySize)
+	{
+		Resource& resource = _resources[placement.resource];
+		const VkMemoryRequirements& requirements = placement.requirements;
+
+		// every image sits at the start of its block, so only size and memory type have to agree
+		for (uint32_t b = 0; b < blocks.size() && resource.block == NOT_USED; b++)
+		{
+			Block& block = blocks[b];
+			if (block.lazy != resource.lazy || (block.requirements.memoryTypeBits & requirements.memoryTypeBits) == 0
+				|| block.requirements.size < requirements.size)
+			{
+				continue;
+			}
+			bool overlaps = false;
+			for (RenderGraphResource other : block.occupants)
+			{
+				const Resource& occupant = _resources[other];
+				overlaps |= resource.firstUse <= occupant.lastUse && occupant.firstUse <= resource.lastUse;
+			}
+			if (!overlaps)
+			{
+				block.requirements.memoryTypeBits &= requirements.memoryTypeBits;
+				block.requirements.alignment = std::max(block.requirements.alignment, requirements.alignment);
+				block.occupants.push_back(placement.resource);
+				resource.block = b;
+			}
+		}
+		if (resource.block == NOT_USED)
+		{
+			resource.block = static_cast<uint32_t>(blocks.size());
+			blocks.push_back({ requirements, resource.lazy, { placement.resource } });
+		}
+	}
+
+	_transientMemory = 0;
+	_lazyMemory = 0;
+	for (const Block& block : blocks)
+	{
+		VmaAllocationCreateInfo allocInfo = {};
+		allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+		allocInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VmaAllocation allocation;
+		VK_CHECK(vmaAllocateMemory(_allocator, &block.requirements, block.lazy ? &lazyInfo : &allocInfo, &allocation, nullptr));
+		_transientMemoryBlocks.push_back(allocation);
+		(block.lazy ? _lazyMemory : _transientMemory) += block.requirements.size;
+
+		for (RenderGraphResource r : block.occupants)
+		{
+			Resource& resource = _resources[r];
+			VK_CHECK(vmaBindImageMemory2(_allocator, allocation, 0, resource.image, nullptr));
+
+			VkImageViewCreateInfo viewInfo = vkinit::imageview_create_info(resource.desc.format, resource.image, resource.desc.aspect);
+			if (resource.desc.layers > 1)
+			{
+				viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+				viewInfo.subresourceRange.layerCount = resource.desc.layers;
+			}
+			VK_CHECK(vkCreateImageView(_device, &viewInfo, nullptr, &resource.view));
+			_transientViews.push_back(resource.view);
+			if (_namer)
+			{
+				_namer(VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t)resource.view, resource.name.c_str());
+			}
+		}
+	}
+}
+
+void RenderGraph::build_barriers()
+{
+	std::vector<TrackedState> states(_resources.size());
+	for (RenderGraphResource r = 0; r < _resources.size(); r++)
+	{
+		const Resource& resource = _resources[r];
+		if (resource.imported || resource.block == NOT_USED)
+		{
+			states[r] = tracked_from(resource.initial);
+			continue;
+		}
+
+		// a transient starts out discarded, but its memory was last used by whichever image of its block
+		// ran last, this frame or the one before; waiting for all of the block's stages covers both
+		TrackedState& state = states[r];
+		state = {};
+		state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		for (uint32_t p = 0; p < _passes.size(); p++)
+		{
+			if (!_passes[p].live)
+			{
+				continue;
+			}
+			for (const Use& use : _passes[p].uses)
+			{
+				if (_resources[use.resource].block == resource.block && !_resources[use.resource].imported)
+				{
+					const RenderGraphState used = RenderGraphState::of(use.access);
+					state.writeStages |= used.stages;
+					state.writeAccess |= used.access & WRITE_ACCESS;
+				}
+			}
+		}
+	}
+
+	auto transition = [&](RenderGraphResource r, const RenderGraphState& dst, bool writes, std::vector<Barrier>& barriers) {
+		TrackedState& state = states[r];
+		const bool layoutChange = _resources[r].isImage && dst.layout != state.layout;
+		if (writes || layoutChange)
+		{
+			// writes and transitions wait for everything since the last write; the reads only need ordering
+			const VkPipelineStageFlags srcStages = state.writeStages | state.readStages;
+			if (layoutChange || srcStages != 0)
+			{
+				barriers.push_back({ r, { state.layout, srcStages, state.writeAccess }, dst });
+			}
+			state.layout = _resources[r].isImage ? dst.layout : state.layout;
+			state.writeStages = writes ? dst.stages : (state.writeStages | dst.stages);
+			state.writeAccess = writes ? (dst.access & WRITE_ACCESS) : state.writeAccess;
+			state.readStages = writes ? 0 : dst.stages;
+			state.visibleStages = dst.stages;
+			state.visibleAccess = dst.access;
+		}
+		else
+		{
+			// read after read needs nothing; a new kind of reader needs the last write made visible to it
+			const bool visible = (dst.stages & ~state.visibleStages) == 0 && (dst.access & ~state.visibleAccess) == 0;
+			if (!visible && state.writeStages != 0)
+			{
+				barriers.push_back({ r, { state.layout, state.writeStages, state.writeAccess }, dst });
+				state.visibleStages |= dst.stages;
+				state.visibleAccess |= dst.access;
+			}
+			state.readStages |= dst.stages;
+		}
+	};
+
+	_barrierCount = 0;
+	for (Pass& pass : _passes)
+	{
+		pass.barriers.clear();
+		if (!pass.live)
+		{
+			continue;
+		}
+
+		for (const Use& use : pass.uses)
+		{
+			transition(use.resource, RenderGraphState::of(use.access), use.writes, pass.barriers);
+		}
+		_barrierCount += static_cast<uint32_t>(pass.barriers.size());
+	}
+
+	_finalBarriers.clear();
+	for (RenderGraphResource r = 0; r < _resources.size(); r++)
+	{
+		const Resource& resource = _resources[r];
+		if (resource.imported && resource.finalAccess != RenderGraphAccess::Undefined && resource.firstUse != NOT_USED)
+		{
+			transition(r, RenderGraphState::of(resource.finalAccess), false, _finalBarriers);
+		}
+	}
+	_barrierCount += static_cast<uint32_t>(_finalBarriers.size());
+}
+
+void RenderGraph::resolve_attachments(Pass& pass)
+{
+	assert(pass.attachments.size() <= MAX_ATTACHMENTS);
+	const uint32_t passIndex = static_cast<uint32_t>(&pass - _passes.data());
+
+	pass.storeOps.clear();
+	pass.colorFormats.clear();
+	pass.depthFormat = VK_FORMAT_UNDEFINED;
+	for (const Attachment& attachment : pass.attachments)
+	{
+		const Resource& resource = _resources[attachment.image];
+
+		// nobody reading it after this pass, and it isn't handed back outside the graph: no write back
+		bool store = resource.imported && resource.finalAccess != RenderGraphAccess::Undefined;
+		for (uint32_t p = passIndex + 1; p < _passes.size() && !store; p++)
+		{
+			if (!_passes[p].live)
+			{
+				continue;
+			}
+			bool overwritten = false;
+			for (const Use& use : _passes[p].uses)
+			{
+				if (use.resource == attachment.image)
+				{
+					store = use.reads || !use.overwrites;
+					overwritten = use.overwrites;
+				}
+			}
+			if (overwritten)
+			{
+				break;
+			}
+		}
+		pass.storeOps.push_back(store ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE);
+
+		if (attachment.depth)
+		{
+			pass.depthFormat = resource.desc.format;
+		}
+		else if (attachment.resolveSource == NO_RESOLVE)
+		{
+			pass.colorFormats.push_back(resource.desc.format);
+		}
+	}
+	pass.extent = _resources[pass.attachments[0].image].desc.extent;
+	pass.samples = _resources[pass.attachments[0].image].desc.samples;
+}
+
+void RenderGraph::build_render_pass(Pass& pass)
+{
+	VkAttachmentDescription descriptions[MAX_ATTACHMENTS];
+	VkAttachmentReference colorReferences[MAX_ATTACHMENTS];
+	VkAttachmentReference resolveReferences[MAX_ATTACHMENTS];
+	VkAttachmentReference depthReference = {};
+	uint32_t colorCount = 0;
+	bool hasDepth = false;
+	bool hasResolve = false;
+	for (VkAttachmentReference& reference : resolveReferences)
+	{
+		reference = { VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED };
+	}
+
+	for (uint32_t a = 0; a < pass.attachments.size(); a++)
+	{
+		const Attachment& attachment = pass.attachments[a];
+
+		// the graph's barriers already moved the image into the attachment layout, and it stays in it
+		VkAttachmentDescription& description = descriptions[a];
+		description = {};
+		description.format = _resources[attachment.image].desc.format;
+		description.samples = _resources[attachment.image].desc.samples;
+		description.loadOp = attachment.loadOp;
+		description.storeOp = pass.storeOps[a];
+		description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		description.initialLayout = attachment.layout;
+		description.finalLayout = attachment.layout;
+
+		if (attachment.depth)
+		{
+			depthReference = { a, attachment.layout };
+			hasDepth = true;
+		}
+		else if (attachment.resolveSource != NO_RESOLVE)
+		{
+			// resolved at the end of the subpass, so on tilers the samples never leave tile memory
+			resolveReferences[attachment.resolveSource] = { a, attachment.layout };
+			hasResolve = true;
+		}
+		else
+		{
+			colorReferences[colorCount++] = { a, attachment.layout };
+		}
+	}
+
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = colorCount;
+	subpass.pColorAttachments = colorReferences;
+	subpass.pResolveAttachments = hasResolve ? resolveReferences : nullptr;
+	subpass.pDepthStencilAttachment = hasDepth ? &depthReference : nullptr;
+
+	// no dependencies: everything around the pass is synchronized by the graph's barriers
+	VkRenderPassCreateInfo renderPassInfo = {};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassInfo.attachmentCount = static_cast<uint32_t>(pass.attachments.size());
+	renderPassInfo.pAttachments = descriptions;
+	renderPassInfo.subpassCount = 1;
+	renderPassInfo.pSubpasses = &subpass;
+
+	// the views are rendered together, so the driver may share work between them
+	VkRenderPassMultiviewCreateInfo multiviewInfo = {};
+	multiviewInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO;
+	multiviewInfo.pNext = nullptr;
+	multiviewInfo.subpassCount = 1;
+	multiviewInfo.pViewMasks = &pass.viewMask;
+	multiviewInfo.correlationMaskCount = 1;
+	multiviewInfo.pCorrelationMasks = &pass.viewMask;
+	if (pass.viewMask != 0)
+	{
+		renderPassInfo.pNext = &multiviewInfo;
+	}
+
+	VK_CHECK(vkCreateRenderPass(_device, &renderPassInfo, nullptr, &pass.renderPass));
+	_renderPasses.push_back(pass.renderPass);
+}
+
+void RenderGraph::bind_image(RenderGraphResource resource, VkImage image, VkImageView view)
+{
+	assert(_resources[resource].imported && _resources[resource].isImage);
+	_resources[resource].image = image;
+	_resources[resource].view = view;
+}
+
+void RenderGraph::bind_buffer(RenderGraphResource resource, VkBuffer buffer)
+{
+	assert(_resources[resource].imported && !_resources[resource].isImage);
+	_resources[resource].buffer = buffer;
+}
+
+void RenderGraph::set_secondary_contents(uint32_t pass, bool secondary)
+{
+	_passes[pass].secondary = secondary;
+}
+
+void RenderGraph::set_render_area(uint32_t pass, VkExtent2D extent)
+{
+	assert(extent.width <= _passes[pass].extent.width && extent.height <= _passes[pass].extent.height);
+	_passes[pass].renderArea = extent;
+}
+
+void RenderGraph::set_clear_value(uint32_t pass, uint32_t attachment, VkClearValue clear)
+{
+	_passes[pass].clearValues[attachment] = clear;
+}
+
+void RenderGraph::set_pass_hooks(std::function<uint32_t(VkCommandBuffer cmd, const char* name)> begin,
+	std::function<void(VkCommandBuffer cmd, uint32_t token)> end)
+{
+	_beginHook = std::move(begin);
+	_endHook = std::move(end);
+}
+
+void RenderGraph::set_object_namer(std::function<void(VkObjectType type, uint64_t handle, const char* name)> namer)
+{
+	_namer = std::move(namer);
+}
+
+void RenderGraph::execute(VkCommandBuffer cmd)
+{
+	assert(_compiled);
+
+	for (const Pass& pass : _passes)
+	{
+		if (!pass.live)
+		{
+			continue;
+		}
+
+		const uint32_t token = _beginHook ? _beginHook(cmd, pass.name.c_str()) : 0;
+		record_barriers(cmd, pass.barriers);
+
+		PassContext context = { cmd, pass.renderPass, VK_NULL_HANDLE, render_area(pass),
+			pass.colorFormats.data(), static_cast<uint32_t>(pass.colorFormats.size()), pass.depthFormat, pass.samples, pass.viewMask };
+		if (_dynamicRendering && !pass.attachments.empty())
+		{
+			begin_rendering(cmd, pass);
+			pass.execute(context);
+#ifdef VK_KHR_dynamic_rendering
+			reinterpret_cast<PFN_vkCmdEndRenderingKHR>(_endRendering)(cmd);
+#endif
+		}
+		else if (pass.renderPass != VK_NULL_HANDLE)
+		{
+			context.framebuffer = framebuffer_for(pass);
+
+			VkRenderPassBeginInfo rpInfo = vkinit::renderpass_begin_info(pass.renderPass, context.extent, context.framebuffer);
+			rpInfo.clearValueCount = static_cast<uint32_t>(pass.clearValues.size());
+			rpInfo.pClearValues = pass.clearValues.data();
+			vkCmdBeginRenderPass(cmd, &rpInfo, pass.secondary ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+			pass.execute(context);
+			vkCmdEndRenderPass(cmd);
+		}
+		else
+		{
+			pass.execute(context);
+		}
+
+		if (_endHook)
+		{
+			_endHook(cmd, token);
+		}
+	}
+
+	record_barriers(cmd, _finalBarriers);
+}
+
+void RenderGraph::begin_rendering(VkCommandBuffer cmd, const Pass& pass)
+{
+#ifdef VK_KHR_dynamic_rendering
+	VkRenderingAttachmentInfoKHR colorAttachments[MAX_ATTACHMENTS];
+	VkRenderingAttachmentInfoKHR depthAttachment = {};
+	uint32_t colorCount = 0;
+	bool hasDepth = false;
+	for (uint32_t a = 0; a < pass.attachments.size(); a++)
+	{
+		const Attachment& attachment = pass.attachments[a];
+		if (attachment.resolveSource != NO_RESOLVE)
+		{
+			continue;
+		}
+		VkRenderingAttachmentInfoKHR& info = attachment.depth ? depthAttachment : colorAttachments[colorCount++];
+		info = {};
+		info.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+		info.pNext = nullptr;
+		info.imageView = _resources[attachment.image].view;
+		info.imageLayout = attachment.layout;
+		info.resolveMode = VK_RESOLVE_MODE_NONE;
+		info.loadOp = attachment.loadOp;
+		info.storeOp = pass.storeOps[a];
+		info.clearValue = pass.clearValues[a];
+		hasDepth |= attachment.depth;
+	}
+	// resolves follow their sources, which are all filled in by now
+	for (const Attachment& attachment : pass.attachments)
+	{
+		if (attachment.resolveSource != NO_RESOLVE)
+		{
+			VkRenderingAttachmentInfoKHR& source = colorAttachments[attachment.resolveSource];
+			source.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT_KHR;
+			source.resolveImageView = _resources[attachment.image].view;
+			source.resolveImageLayout = attachment.layout;
+		}
+	}
+
+	VkRenderingInfoKHR renderingInfo = {};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+	renderingInfo.pNext = nullptr;
+	renderingInfo.flags = pass.secondary ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR : 0;
+	renderingInfo.renderArea = { { 0, 0 }, render_area(pass) };
+	renderingInfo.layerCount = 1;
+	renderingInfo.viewMask = pass.viewMask;
+	renderingInfo.colorAttachmentCount = colorCount;
+	renderingInfo.pColorAttachments = colorAttachments;
+	renderingInfo.pDepthAttachment = hasDepth ? &depthAttachment : nullptr;
+#ifdef VK_KHR_fragment_shading_rate
+	VkRenderingFragmentShadingRateAttachmentInfoKHR shadingRateInfo = {};
+	if (pass.shadingRate != INVALID_GRAPH_RESOURCE)
+	{
+		shadingRateInfo.sType = VK_STRUCTURE_TYPE_RENDERING_FRAGMENT_SHADING_RATE_ATTACHMENT_INFO_KHR;
+		shadingRateInfo.pNext = nullptr;
+		shadingRateInfo.imageView = _resources[pass.shadingRate].view;
+		shadingRateInfo.imageLayout = RenderGraphState::of(RenderGraphAccess::ShadingRateRead).layout;
+		shadingRateInfo.shadingRateAttachmentTexelSize = pass.shadingRateTexelSize;
+		renderingInfo.pNext = &shadingRateInfo;
+	}
+#endif
+	reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(_beginRendering)(cmd, &renderingInfo);
+#endif
+}
+
+void RenderGraph::set_dynamic_rendering(PFN_vkVoidFunction beginRendering, PFN_vkVoidFunction endRendering)
+{
+	_dynamicRendering = beginRendering != nullptr && endRendering != nullptr;
+	_beginRendering = beginRendering;
+	_endRendering = endRendering;
+	_compiled = false;
+}
+
+void RenderGraph::record_barriers(VkCommandBuffer cmd, const std::vector<Barrier>& barriers)
+{
+	if (barriers.empty())
+	{
+		return;
+	}
+
+#ifdef VK_KHR_synchronization2
+	if (_pipelineBarrier2 != nullptr)
+	{
+		record_barriers2(cmd, barriers);
+		return;
+	}
+#endif
+
+	// one call per pass: the stages of every barrier are merged
+	for (const Barrier& barrier : barriers)
+	{
+		const Resource& resource = _resources[barrier.resource];
+		if (resource.isImage)
+		{
+			VkImageMemoryBarrier imageBarrier = vkinit::image_barrier(resource.image, barrier.src.access, barrier.dst.access,
+				barrier.src.layout, barrier.dst.layout, resource.desc.aspect);
+			imageBarrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+			imageBarrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+			_barriers.add(imageBarrier, barrier.src.stages, barrier.dst.stages);
+		}
+		else
+		{
+			_barriers.add(vkinit::buffer_barrier(resource.buffer, barrier.src.access, barrier.dst.access), barrier.src.stages, barrier.dst.stages);
+		}
+	}
+	_barriers.record(cmd);
+}
+
+#ifdef VK_KHR_synchronization2
+void RenderGraph::record_barriers2(VkCommandBuffer cmd, const std::vector<Barrier>& barriers)
+{
+	// still one call per pass, but every barrier keeps its own stages: the pass waits for exactly what
+	// produced each resource, not for the union of all of them. The 32-bit stage and access bits are
+	// the same in the 64-bit masks
+	_imageBarriers2.clear();
+	_bufferBarriers2.clear();
+	for (const Barrier& barrier : barriers)
+	{
+		const Resource& resource = _resources[barrier.resource];
+		if (resource.isImage)
+		{
+			VkImageMemoryBarrier2KHR imageBarrier = {};
+			imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+			imageBarrier.pNext = nullptr;
+			imageBarrier.srcStageMask = barrier.src.stages;
+			imageBarrier.srcAccessMask = barrier.src.access;
+			imageBarrier.dstStageMask = barrier.dst.stages;
+			imageBarrier.dstAccessMask = barrier.dst.access;
+			imageBarrier.oldLayout = barrier.src.layout;
+			imageBarrier.newLayout = barrier.dst.layout;
+			imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.image = resource.image;
+			imageBarrier.subresourceRange = { resource.desc.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+			_imageBarriers2.push_back(imageBarrier);
+		}
+		else
+		{
+			VkBufferMemoryBarrier2KHR bufferBarrier = {};
+			bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR;
+			bufferBarrier.pNext = nullptr;
+			bufferBarrier.srcStageMask = barrier.src.stages;
+			bufferBarrier.srcAccessMask = barrier.src.access;
+			bufferBarrier.dstStageMask = barrier.dst.stages;
+			bufferBarrier.dstAccessMask = barrier.dst.access;
+			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.buffer = resource.buffer;
+			bufferBarrier.offset = 0;
+			bufferBarrier.size = VK_WHOLE_SIZE;
+			_bufferBarriers2.push_back(bufferBarrier);
+		}
+	}
+
+	VkDependencyInfoKHR dependency = {};
+	dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+	dependency.pNext = nullptr;
+	dependency.bufferMemoryBarrierCount = static_cast<uint32_t>(_bufferBarriers2.size());
+	dependency.pBufferMemoryBarriers = _bufferBarriers2.data();
+	dependency.imageMemoryBarrierCount = static_cast<uint32_t>(_imageBarriers2.size());
+	dependency.pImageMemoryBarriers = _imageBarriers2.data();
+	reinterpret_cast<PFN_vkCmdPipelineBarrier2KHR>(_pipelineBarrier2)(cmd, &dependency);
+}
+#endif
+
+void RenderGraph::set_synchronization2(PFN_vkVoidFunction pipelineBarrier2)
+{
+	_pipelineBarrier2 = pipelineBarrier2;
+}
+
+VkFramebuffer RenderGraph::framebuffer_for(const Pass& pass)
+{
+	const uint32_t viewCount = static_cast<uint32_t>(pass.attachments.size());
+	for (const Framebuffer& framebuffer : _framebuffers)
+	{
+		if (framebuffer.renderPass != pass.renderPass || framebuffer.viewCount != viewCount)
+		{
+			continue;
+		}
+		bool same = true;
+		for (uint32_t a = 0; a < viewCount; a++)
+		{
+			same &= framebuffer.views[a] == _resources[pass.attachments[a].image].view;
+		}
+		if (same)
+		{
+			return framebuffer.framebuffer;
+		}
+	}
+
+	// one per combination of views; the swapchain has a few images, so a handful per pass
+	Framebuffer framebuffer = {};
+	framebuffer.renderPass = pass.renderPass;
+	framebuffer.viewCount = viewCount;
+	for (uint32_t a = 0; a < viewCount; a++)
+	{
+		framebuffer.views[a] = _resources[pass.attachments[a].image].view;
+	}
+
+	VkFramebufferCreateInfo fbInfo = {};
+	fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	fbInfo.pNext = nullptr;
+	fbInfo.renderPass = pass.renderPass;
+	fbInfo.attachmentCount = viewCount;
+	fbInfo.pAttachments = framebuffer.views;
+	fbInfo.width = pass.extent.width;
+	fbInfo.height = pass.extent.height;
+	// a multiview pass's views pick their layers themselves
+	fbInfo.layers = 1;
+	VK_CHECK(vkCreateFramebuffer(_device, &fbInfo, nullptr, &framebuffer.framebuffer));
+
+	_framebuffers.push_back(framebuffer);
+	return framebuffer.framebuffer;
+}
+
+void RenderGraph::release_framebuffers()
+{
+	for (const Framebuffer& framebuffer : _framebuffers)
+	{
+		vkDestroyFramebuffer(_device, framebuffer.framebuffer, nullptr);
+	}
+	_framebuffers.clear();
+}
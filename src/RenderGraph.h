@@ -0,0 +1,290 @@
+#pragma once
+
+#include <vk_types.h>
+#include <BarrierBatch.h>
+#include <DeletionQueue.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// how a pass uses an image or buffer; decides the layout, stages and access it is synchronized to
+enum class RenderGraphAccess : uint32_t {
+	Undefined, // only as an import's initial state: the contents are discarded
+	ColorAttachment,
+	DepthAttachment, // depth tested and written
+	DepthRead, // depth tested without writes
+	SampledFragment,
+	SampledCompute,
+	StorageCompute, // read and written by compute shaders
+	TransferSrc,
+	TransferDst,
+	IndirectRead, // buffers only: draw parameters
+	VertexRead, // buffers only: vertex and index fetch, vertex shader reads
+	ShadingRateRead, // the fragment shading rate attachment of a raster pass
+	Present, // only as an import's final state
+};
+
+// what an access amounts to for a barrier; layout is ignored for buffers
+struct RenderGraphState {
+	VkImageLayout layout;
+	VkPipelineStageFlags stages;
+	VkAccessFlags access;
+
+	static RenderGraphState of(RenderGraphAccess access);
+};
+
+using RenderGraphResource = uint32_t;
+constexpr RenderGraphResource INVALID_GRAPH_RESOURCE = UINT32_MAX;
+
+// images the graph creates itself; usage is added to whatever the passes' accesses need
+struct RenderGraphImageDesc {
+	VkFormat format;
+	VkExtent2D extent;
+	VkImageAspectFlags aspect;
+	VkImageUsageFlags usage{ 0 };
+	VkSampleCountFlagBits samples{ VK_SAMPLE_COUNT_1_BIT };
+	// past 1 the image and its view are arrays, which a multiview pass renders a layer per view into
+	uint32_t layers{ 1 };
+};
+
+// Frame render graph. Passes declare which images and buffers they read and write, in the order they
+// run; compile() then culls passes nothing reads from, places the graph's own (transient) images in
+// memory with the ones whose lifetimes don't overlap sharing it, creates the render passes of raster
+// passes and works out every barrier and layout transition between passes. execute() only replays that,
+// so the graph is built once and recompiled when its structure changes, not every frame.
+// Resources from outside (swapchain image, depth buffer, ...) are imported with the state they are in
+// before the graph runs and the access they are handed back for; their images are bound each frame,
+// since the swapchain image changes. An import handed back as Undefined is, like a transient, not
+// stored after its last pass unless a later pass reads it.
+// Passes that synchronize their resources themselves (the cull dispatches, the shadow cascades) just
+// don't declare them, and are kept with keep().
+class RenderGraph
+{
+public:
+	// what a pass's callback records into; render pass and framebuffer are null outside raster passes,
+	// and with dynamic rendering, where secondaries inherit the attachment formats instead
+	struct PassContext {
+		VkCommandBuffer cmd;
+		VkRenderPass renderPass;
+		VkFramebuffer framebuffer;
+		VkExtent2D extent;
+		const VkFormat* colorFormats;
+		uint32_t colorFormatCount;
+		VkFormat depthFormat; // VK_FORMAT_UNDEFINED without depth
+		VkSampleCountFlagBits samples;
+		uint32_t viewMask; // see set_view_mask
+	};
+	using ExecuteFunction = std::function<void(const PassContext& context)>;
+
+	void init(VkDevice device, VmaAllocator allocator);
+	// destroys everything, so the GPU must be done with it
+	void cleanup();
+
+	// declaration, in execution order; any of these drops the compiled graph until the next compile().
+	// reset() forgets every pass and resource; the GPU objects of the last compile stay alive until
+	// compile() retires them. A pass may use each resource only once
+	void reset();
+	RenderGraphResource import_image(const char* name, VkFormat format, VkExtent2D extent, VkImageAspectFlags aspect,
+		RenderGraphState initial, RenderGraphAccess finalAccess);
+	RenderGraphResource import_buffer(const char* name, RenderGraphState initial);
+	RenderGraphResource create_image(const char* name, const RenderGraphImageDesc& desc);
+	uint32_t add_pass(const char* name, ExecuteFunction execute);
+	void read(uint32_t pass, RenderGraphResource resource, RenderGraphAccess access);
+	void write(uint32_t pass, RenderGraphResource resource, RenderGraphAccess access);
+	// attachments make the pass a raster pass, which runs inside a render pass the graph begins. Color
+	// attachments bind in declaration order; a CLEAR attachment is cleared to clear
+	void color_attachment(uint32_t pass, RenderGraphResource image, VkAttachmentLoadOp loadOp, VkClearValue clear = {});
+	void depth_attachment(uint32_t pass, RenderGraphResource image, VkAttachmentLoadOp loadOp, VkClearValue clear = {}, bool readOnly = false);
+	// averages the multisampled color attachment color, declared before, into the single-sampled target at
+	// the end of the pass. Counts as an attachment for set_clear_value, but not as a color binding
+	void resolve_attachment(uint32_t pass, RenderGraphResource color, RenderGraphResource target);
+	// VK_KHR_fragment_shading_rate: each texel of image sets the shading rate of texelSize pixels of the pass.
+	// Dynamic rendering only; with render pass objects the image is just transitioned for nothing
+	void shading_rate_attachment(uint32_t pass, RenderGraphResource image, VkExtent2D texelSize);
+	// the pass has effects outside the graph and must not be culled
+	void keep(uint32_t pass);
+	// VK_KHR_multiview: the raster pass draws once for each bit of viewMask, view i into layer i of every
+	// attachment, which must have that many layers; gl_ViewIndex tells the shaders which. Its pipelines have
+	// to be built for the same mask. 0 (the default) renders a single view, into layer 0
+	void set_view_mask(uint32_t pass, uint32_t viewMask);
+
+	// raster passes through vkCmdBeginRenderingKHR/vkCmdEndRenderingKHR instead of render pass and
+	// framebuffer objects; the functions of VK_KHR_dynamic_rendering, or null to go back to render passes.
+	// Takes effect at the next compile()
+	void set_dynamic_rendering(PFN_vkVoidFunction beginRendering, PFN_vkVoidFunction endRendering);
+
+	// barriers through vkCmdPipelineBarrier2KHR of VK_KHR_synchronization2, each with its own stage
+	// masks instead of one merged pair per pass; null goes back to vkCmdPipelineBarrier
+	void set_synchronization2(PFN_vkVoidFunction pipelineBarrier2);
+
+	// retired holds the previous compile's GPU objects until the frames using them are done
+	void compile(DeletionQueue& retired);
+	bool compiled() const { return _compiled; }
+
+	// per frame, after compile(): imported resources must be bound before every execute()
+	void bind_image(RenderGraphResource resource, VkImage image, VkImageView view);
+	void bind_buffer(RenderGraphResource resource, VkBuffer buffer);
+	// raster passes recorded through secondary command buffers; may change every frame
+	void set_secondary_contents(uint32_t pass, bool secondary);
+	// the raster pass only covers the top-left extent of its attachments, which it must fit in; 0x0 (the
+	// default) covers all of them. May change every frame, and is the context's extent
+	void set_render_area(uint32_t pass, VkExtent2D extent);
+	// replaces what a CLEAR attachment is cleared to, attachment counting in declaration order; may change every frame
+	void set_clear_value(uint32_t pass, uint32_t attachment, VkClearValue clear);
+
+	// optional callbacks around every executed pass, outside its render pass; begin's result goes to end
+	void set_pass_hooks(std::function<uint32_t(VkCommandBuffer cmd, const char* name)> begin,
+		std::function<void(VkCommandBuffer cmd, uint32_t token)> end);
+	// optional, called with every image and view the graph creates, and the name of its resource
+	void set_object_namer(std::function<void(VkObjectType type, uint64_t handle, const char* name)> namer);
+
+	void execute(VkCommandBuffer cmd);
+
+	VkImage image(RenderGraphResource resource) const { return _resources[resource].image; }
+	VkImageView view(RenderGraphResource resource) const { return _resources[resource].view; }
+	// whether the last compile kept pass
+	bool is_live(uint32_t pass) const { return _passes[pass].live; }
+
+	// framebuffers point at image views; call when imported views are destroyed, with the GPU idle
+	void release_framebuffers();
+
+	// of the last compile, for logging
+	uint32_t culled_pass_count() const { return _culledPassCount; }
+	uint32_t barrier_count() const { return _barrierCount; }
+	VkDeviceSize transient_memory() const { return _transientMemory; }
+	// the memory of the graph's own images, aliased as compile() placed them
+	const std::vector<VmaAllocation>& transient_allocations() const { return _transientMemoryBlocks; }
+	// reserved for TRANSIENT_ATTACHMENT images, committed only if a tile spills
+	VkDeviceSize lazy_memory() const { return _lazyMemory; }
+
+private:
+	struct Resource {
+		std::string name;
+		bool isImage;
+		bool imported;
+		RenderGraphImageDesc desc;
+		RenderGraphState initial;
+		RenderGraphAccess finalAccess;
+		VkImageUsageFlags usage; // transients: what the passes need
+		// transients: only ever a cleared or discarded attachment, so TRANSIENT_ATTACHMENT in lazily
+		// allocated memory when the device has it
+		bool lazy;
+		VkImage image;
+		VkImageView view;
+		VkBuffer buffer;
+		// transients: live passes using it, in execution order, and the memory block it shares
+		uint32_t firstUse;
+		uint32_t lastUse;
+		uint32_t block;
+	};
+
+	struct Use {
+		RenderGraphResource resource;
+		RenderGraphAccess access;
+		bool reads; // depends on the previous contents
+		bool writes;
+		bool overwrites; // replaces all of them, so earlier writers aren't needed for this one
+	};
+
+	struct Attachment {
+		RenderGraphResource image;
+		VkAttachmentLoadOp loadOp;
+		VkImageLayout layout;
+		bool depth;
+		bool readOnly;
+		// resolve targets: the color binding resolved into them
+		uint32_t resolveSource;
+	};
+	static constexpr uint32_t NO_RESOLVE = UINT32_MAX;
+
+	// resolved at compile; execute() fills in the current handles
+	struct Barrier {
+		RenderGraphResource resource;
+		RenderGraphState src;
+		RenderGraphState dst;
+	};
+
+	struct Pass {
+		std::string name;
+		ExecuteFunction execute;
+		std::vector<Use> uses;
+		std::vector<Attachment> attachments;
+		bool keep{ false };
+		bool secondary{ false };
+		bool live{ false };
+		std::vector<Barrier> barriers;
+		VkRenderPass renderPass{ VK_NULL_HANDLE };
+		VkExtent2D extent{ 0, 0 };
+		// one per attachment
+		std::vector<VkClearValue> clearValues;
+		std::vector<VkAttachmentStoreOp> storeOps;
+		std::vector<VkFormat> colorFormats;
+		VkFormat depthFormat{ VK_FORMAT_UNDEFINED };
+		VkSampleCountFlagBits samples{ VK_SAMPLE_COUNT_1_BIT };
+		VkExtent2D renderArea{ 0, 0 };
+		RenderGraphResource shadingRate{ INVALID_GRAPH_RESOURCE };
+		VkExtent2D shadingRateTexelSize{ 0, 0 };
+		uint32_t viewMask{ 0 };
+	};
+
+	struct Framebuffer {
+		VkRenderPass renderPass;
+		VkImageView views[8];
+		uint32_t viewCount;
+		VkFramebuffer framebuffer;
+	};
+
+	void cull_passes();
+	void retire(DeletionQueue& retired);
+	void allocate_transients();
+	void build_barriers();
+	// store ops, formats and extent of a raster pass
+	void resolve_attachments(Pass& pass);
+	void build_render_pass(Pass& pass);
+	void begin_rendering(VkCommandBuffer cmd, const Pass& pass);
+	VkFramebuffer framebuffer_for(const Pass& pass);
+	static VkExtent2D render_area(const Pass& pass) { return pass.renderArea.width != 0 ? pass.renderArea : pass.extent; }
+	void record_barriers(VkCommandBuffer cmd, const std::vector<Barrier>& barriers);
+#ifdef VK_KHR_synchronization2
+	void record_barriers2(VkCommandBuffer cmd, const std::vector<Barrier>& barriers);
+#endif
+
+	VkDevice _device{ VK_NULL_HANDLE };
+	VmaAllocator _allocator{ nullptr };
+
+	std::vector<Resource> _resources;
+	std::vector<Pass> _passes;
+	// transitions of imported resources to their final state, after the last pass
+	std::vector<Barrier> _finalBarriers;
+	bool _compiled{ false };
+
+	// transient images and their memory, owned until the next compile retires them
+	// the images share allocations, so they are plain handles and the memory is freed per block
+	std::vector<VkImage> _transientImages;
+	std::vector<VkImageView> _transientViews;
+	std::vector<VmaAllocation> _transientMemoryBlocks;
+	std::vector<VkRenderPass> _renderPasses;
+	std::vector<Framebuffer> _framebuffers;
+
+	bool _dynamicRendering{ false };
+	PFN_vkVoidFunction _beginRendering{ nullptr };
+	PFN_vkVoidFunction _endRendering{ nullptr };
+	PFN_vkVoidFunction _pipelineBarrier2{ nullptr };
+
+	std::function<uint32_t(VkCommandBuffer, const char*)> _beginHook;
+	std::function<void(VkCommandBuffer, uint32_t)> _endHook;
+	std::function<void(VkObjectType, uint64_t, const char*)> _namer;
+
+	// scratch for execute(), kept so steady-state frames don't allocate
+	BarrierBatch _barriers;
+#ifdef VK_KHR_synchronization2
+	std::vector<VkImageMemoryBarrier2KHR> _imageBarriers2;
+	std::vector<VkBufferMemoryBarrier2KHR> _bufferBarriers2;
+#endif
+
+	uint32_t _culledPassCount{ 0 };
+	uint32_t _barrierCount{ 0 };
+	VkDeviceSize _transientMemory{ 0 };
+	VkDeviceSize _lazyMemory{ 0 };
+};
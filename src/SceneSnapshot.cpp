@@ -0,0 +1,237 @@
+#include "SceneSnapshot.h"
+
+#include "Log.h"
+
+#include <cstring>
+#include <fstream>
+
+namespace {
+	constexpr uint32_t SNAPSHOT_MAGIC = 0x4e534351; // "QCSN"
+	constexpr uint32_t SNAPSHOT_VERSION = 1;
+	// every section starts on this, so the mapping's arrays are read in place
+	constexpr uint64_t SECTION_ALIGNMENT = 16;
+
+	struct SnapshotHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t sourceCount;
+		uint32_t nameCount;
+		uint32_t materialCount;
+		uint32_t objectCount;
+		uint32_t nodeCount;
+		uint32_t reserved;
+		uint64_t nameBytes;
+	};
+	static_assert(sizeof(SnapshotHeader) == 40, "snapshot header must not contain padding");
+
+	// a file the level was built from, stamped like the caches are
+	struct SnapshotSource {
+		uint64_t size;
+		int64_t timestamp;
+		uint64_t hash;
+		uint32_t name;
+		uint32_t reserved;
+	};
+	static_assert(sizeof(SnapshotSource) == 32, "snapshot source must not contain padding");
+	static_assert(sizeof(SnapshotObject) == 24 && sizeof(SnapshotMaterial) == 24, "snapshot records must not contain padding");
+
+	uint64_t aligned(uint64_t offset)
+	{
+		return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+	}
+
+	// where each section starts, from the header's counts
+	struct Layout {
+		uint64_t sources;
+		uint64_t nameOffsets;
+		uint64_t nameChars;
+		uint64_t materials;
+		uint64_t objects;
+		uint64_t parents;
+		uint64_t nodeArrays;
+		uint64_t end;
+
+		explicit Layout(const SnapshotHeader& header)
+		{
+			sources = aligned(sizeof(SnapshotHeader));
+			nameOffsets = aligned(sources + uint64_t(header.sourceCount) * sizeof(SnapshotSource));
+			nameChars = aligned(nameOffsets + uint64_t(header.nameCount) * sizeof(uint32_t));
+			materials = aligned(nameChars + header.nameBytes);
+			objects = aligned(materials + uint64_t(header.materialCount) * sizeof(SnapshotMaterial));
+			parents = aligned(objects + uint64_t(header.objectCount) * sizeof(SnapshotObject));
+			nodeArrays = aligned(parents + uint64_t(header.nodeCount) * sizeof(uint32_t));
+			end = nodeArrays + uint64_t(TransformStore::NODE_ARRAYS) * aligned(uint64_t(header.nodeCount) * sizeof(float));
+		}
+
+		uint64_t node_array(uint32_t array, uint32_t nodeCount) const
+		{
+			return nodeArrays + array * aligned(uint64_t(nodeCount) * sizeof(float));
+		}
+	};
+
+	void write_at(std::ofstream& file, uint64_t offset, const void* data, size_t size)
+	{
+		// the gap up to a section's start is zeros
+		static const char zeros[SECTION_ALIGNMENT] = {};
+		const uint64_t position = static_cast<uint64_t>(file.tellp());
+		if (offset > position)
+		{
+			file.write(zeros, static_cast<std::streamsize>(offset - position));
+		}
+		if (size > 0)
+		{
+			file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+		}
+	}
+}
+
+bool SceneSnapshot::save(const char* path, const std::vector<std::string>& sources, const Contents& contents, const TransformStore& transforms)
+{
+	// the sources' paths go in the name table after the objects' names
+	std::vector<std::string> names = contents.names;
+	std::vector<SnapshotSource> stamps(sources.size());
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		SourceStamp stamp;
+		if (!get_source_stamp(sources[i].c_str(), stamp))
+		{
+			return false;
+		}
+		stamps[i] = { stamp.size, stamp.timestamp, hash_file(sources[i].c_str()), static_cast<uint32_t>(names.size()), 0 };
+		names.push_back(sources[i]);
+	}
+
+	std::vector<uint32_t> nameOffsets;
+	std::string nameChars;
+	for (const std::string& name : names)
+	{
+		nameOffsets.push_back(static_cast<uint32_t>(nameChars.size()));
+		nameChars += name;
+		nameChars += '\0';
+	}
+
+	SnapshotHeader header = {};
+	header.magic = SNAPSHOT_MAGIC;
+	header.version = SNAPSHOT_VERSION;
+	header.sourceCount = static_cast<uint32_t>(stamps.size());
+	header.nameCount = static_cast<uint32_t>(names.size());
+	header.materialCount = static_cast<uint32_t>(contents.materials.size());
+	header.objectCount = static_cast<uint32_t>(contents.objects.size());
+	header.nodeCount = static_cast<uint32_t>(transforms.size());
+	header.nameBytes = nameChars.size();
+	const Layout layout(header);
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		return false;
+	}
+	write_at(file, 0, &header, sizeof(header));
+	write_at(file, layout.sources, stamps.data(), stamps.size() * sizeof(SnapshotSource));
+	write_at(file, layout.nameOffsets, nameOffsets.data(), nameOffsets.size() * sizeof(uint32_t));
+	write_at(file, layout.nameChars, nameChars.data(), nameChars.size());
+	write_at(file, layout.materials, contents.materials.data(), contents.materials.size() * sizeof(SnapshotMaterial));
+	write_at(file, layout.objects, contents.objects.data(), contents.objects.size() * sizeof(SnapshotObject));
+	write_at(file, layout.parents, transforms.parents(), transforms.size() * sizeof(uint32_t));
+	for (uint32_t array = 0; array < TransformStore::NODE_ARRAYS; array++)
+	{
+		write_at(file, layout.node_array(array, header.nodeCount), transforms.node_array(array), transforms.size() * sizeof(float));
+	}
+	write_at(file, layout.end, nullptr, 0);
+	return file.good();
+}
+
+bool SceneSnapshot::open(const char* path, const std::vector<std::string>& sources)
+{
+	close();
+	if (!_file.open(path) || _file.size() < sizeof(SnapshotHeader))
+	{
+		close();
+		return false;
+	}
+
+	const uint8_t* data = _file.data();
+	SnapshotHeader header;
+	memcpy(&header, data, sizeof(header));
+	if (header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION || header.sourceCount != sources.size())
+	{
+		close();
+		return false;
+	}
+	const Layout layout(header);
+	if (_file.size() < layout.end)
+	{
+		close();
+		return false;
+	}
+
+	_nameOffsets = reinterpret_cast<const uint32_t*>(data + layout.nameOffsets);
+	_nameChars = reinterpret_cast<const char*>(data + layout.nameChars);
+	_nameBytes = header.nameBytes;
+	_nameCount = header.nameCount;
+	// every name must end inside the table, so name() never runs off it
+	if (_nameBytes == 0 ? _nameCount > 0 : _nameChars[_nameBytes - 1] != '\0')
+	{
+		close();
+		return false;
+	}
+	for (uint32_t i = 0; i < _nameCount; i++)
+	{
+		if (_nameOffsets[i] >= _nameBytes)
+		{
+			close();
+			return false;
+		}
+	}
+
+	// outdated once a source changes; a timestamp-only change is accepted if the contents still hash the same
+	const SnapshotSource* stamps = reinterpret_cast<const SnapshotSource*>(data + layout.sources);
+	for (uint32_t i = 0; i < header.sourceCount; i++)
+	{
+		SourceStamp stamp;
+		if (stamps[i].name >= _nameCount || sources[i] != name(stamps[i].name) || !get_source_stamp(sources[i].c_str(), stamp)
+			|| stamp.size != stamps[i].size || (stamp.timestamp != stamps[i].timestamp && hash_file(sources[i].c_str()) != stamps[i].hash))
+		{
+			LOG_INFO(path << " isn't of " << sources[i] << " as it is now, building the scene again");
+			close();
+			return false;
+		}
+	}
+
+	_materials = reinterpret_cast<const SnapshotMaterial*>(data + layout.materials);
+	_materialCount = header.materialCount;
+	_objects = reinterpret_cast<const SnapshotObject*>(data + layout.objects);
+	_objectCount = header.objectCount;
+	_parents = reinterpret_cast<const uint32_t*>(data + layout.parents);
+	_nodeCount = header.nodeCount;
+	for (uint32_t array = 0; array < TransformStore::NODE_ARRAYS; array++)
+	{
+		_nodeArrays[array] = reinterpret_cast<const float*>(data + layout.node_array(array, header.nodeCount));
+	}
+	return true;
+}
+
+void SceneSnapshot::close()
+{
+	_file.close();
+	_nameOffsets = nullptr;
+	_nameChars = nullptr;
+	_nameBytes = 0;
+	_nameCount = 0;
+	_materials = nullptr;
+	_materialCount = 0;
+	_objects = nullptr;
+	_objectCount = 0;
+	_parents = nullptr;
+	_nodeCount = 0;
+}
+
+const char* SceneSnapshot::name(uint32_t index) const
+{
+	return index < _nameCount ? _nameChars + _nameOffsets[index] : nullptr;
+}
+
+void SceneSnapshot::restore(TransformStore& transforms) const
+{
+	transforms.assign(_nodeCount, _parents, _nodeArrays);
+}
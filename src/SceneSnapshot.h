@@ -0,0 +1,77 @@
+#pragma once
+
+#include <MappedFile.h>
+#include <TransformStore.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// a snapshot's render object: what RenderObject holds, with the engine's pointers as name indices
+struct SnapshotObject {
+	uint32_t mesh;
+	uint32_t streamingMesh; // SceneSnapshot::NO_NAME for none
+	uint32_t material; // into the materials
+	uint32_t transform;
+	uint32_t pvsObject;
+	uint32_t flags; // SNAPSHOT_STATIC
+};
+constexpr uint32_t SNAPSHOT_STATIC = 1u << 0;
+
+// a material the objects draw with; one made from a template is recorded by its base name (the variant
+// for VertexFormat::Full), and created again from templateName when it doesn't exist yet
+struct SnapshotMaterial {
+	uint32_t name;
+	uint32_t templateName; // SceneSnapshot::NO_NAME for a material without one
+	float baseColor[4];
+};
+
+// A level as it is in memory once built: the scene graph's arrays exactly as TransformStore keeps them,
+// the render objects and the materials they use, and one table of the mesh and material names the
+// objects refer to. open() maps the file and checks it; everything after is pointers into the mapping, so
+// a load is a copy of the node arrays and one fix-up per object, turning name indices into the engine's
+// pointers through a table resolved once per name. Nothing is parsed per object.
+// Stamped with the files the level was built from; a snapshot of other files, of an older version of
+// them or of another format version is refused, and the level is built from its sources again.
+class SceneSnapshot
+{
+public:
+	static constexpr uint32_t NO_NAME = UINT32_MAX;
+
+	struct Contents {
+		std::vector<std::string> names;
+		std::vector<SnapshotMaterial> materials;
+		std::vector<SnapshotObject> objects;
+	};
+
+	static bool save(const char* path, const std::vector<std::string>& sources, const Contents& contents, const TransformStore& transforms);
+
+	// false, and closed, when missing, corrupt, of another version or not of sources as they are now
+	bool open(const char* path, const std::vector<std::string>& sources);
+	void close();
+
+	uint32_t name_count() const { return _nameCount; }
+	const char* name(uint32_t index) const;
+	const SnapshotMaterial* materials() const { return _materials; }
+	uint32_t material_count() const { return _materialCount; }
+	const SnapshotObject* objects() const { return _objects; }
+	uint32_t object_count() const { return _objectCount; }
+	uint32_t node_count() const { return _nodeCount; }
+
+	// replaces transforms' nodes with the snapshot's
+	void restore(TransformStore& transforms) const;
+
+private:
+	MappedFile _file;
+	const uint32_t* _nameOffsets{ nullptr };
+	const char* _nameChars{ nullptr };
+	uint64_t _nameBytes{ 0 };
+	uint32_t _nameCount{ 0 };
+	const SnapshotMaterial* _materials{ nullptr };
+	uint32_t _materialCount{ 0 };
+	const SnapshotObject* _objects{ nullptr };
+	uint32_t _objectCount{ 0 };
+	const uint32_t* _parents{ nullptr };
+	const float* _nodeArrays[TransformStore::NODE_ARRAYS]{};
+	uint32_t _nodeCount{ 0 };
+};
@@ -0,0 +1,95 @@
+#include "SceneViews.h"
+
+#include "vk_initializers.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+
+static_assert(sizeof(GpuCullViews) == 16 + MAX_SCENE_VIEWS * 6 * 16, "GpuCullViews must match CullViews in cull.comp");
+
+void SceneViews::init(VkDevice device, VmaAllocator allocator, uint32_t count, VkFormat format, VkExtent2D extent, float distance)
+{
+	_device = device;
+	_allocator = allocator;
+	_format = format;
+	_extent = extent;
+
+	// rendered into, blitted into the window, and left for whatever else wants to sample them
+	VkImageCreateInfo imageInfo = vkinit::image_create_info(format,
+		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, { extent.width, extent.height, 1 });
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+	allocInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	_views.resize(std::min(count, MAX_SCENE_VIEWS));
+	for (uint32_t i = 0; i < _views.size(); i++)
+	{
+		View& view = _views[i];
+		VK_CHECK(vmaCreateImage(_allocator, &imageInfo, &allocInfo, &view.target._image, &view.target._allocation, nullptr));
+		VkImageViewCreateInfo viewInfo = vkinit::imageview_create_info(format, view.target._image, VK_IMAGE_ASPECT_COLOR_BIT);
+		VK_CHECK(vkCreateImageView(_device, &viewInfo, nullptr, &view.imageView));
+
+		// straight down needs an up other than y
+		glm::mat4 look;
+		if (i == 0)
+		{
+			look = glm::lookAt(glm::vec3(0.0f, distance, 0.0f), glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f));
+		}
+		else
+		{
+			const float angle = 6.2831853f * (i - 1) / (_views.size() - 1) + 0.7853982f;
+			const glm::vec3 eye = glm::vec3(std::sin(angle), 0.5f, std::cos(angle)) * distance;
+			look = glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		}
+		set_camera(i, look, glm::radians(60.0f));
+	}
+}
+
+void SceneViews::cleanup()
+{
+	for (View& view : _views)
+	{
+		vkDestroyImageView(_device, view.imageView, nullptr);
+		vmaDestroyImage(_allocator, view.target._image, view.target._allocation);
+	}
+	_views.clear();
+}
+
+void SceneViews::set_camera(uint32_t view, const glm::mat4& viewMatrix, float fovY)
+{
+	_views[view].viewMatrix = viewMatrix;
+	_views[view].fovY = fovY;
+}
+
+void SceneViews::update(const Camera& main)
+{
+	const float aspect = static_cast<float>(_extent.width) / static_cast<float>(_extent.height);
+	for (View& view : _views)
+	{
+		// no jitter and no stereo: the views are never upscaled, and they're off with stereo
+		view.camera.set_reverse_z(main.reverse_z(), main.infinite_far());
+		view.camera.update(view.viewMatrix, view.fovY, aspect, main.near_plane(), main.far_plane());
+	}
+}
+
+GpuCullViews SceneViews::cull_views(uint32_t instanceStride) const
+{
+	GpuCullViews views = {};
+	views.info = glm::uvec4(count(), instanceStride, 0, 0);
+	for (uint32_t i = 0; i < _views.size(); i++)
+	{
+		std::copy(_views[i].camera.frustum_planes(), _views[i].camera.frustum_planes() + 6, views.frustumPlanes + i * 6);
+	}
+	return views;
+}
+
+VkRect2D SceneViews::window_rect(uint32_t view, VkExtent2D window) const
+{
+	const uint32_t height = std::max(window.height / 4, 1u);
+	const uint32_t width = std::max(height * _extent.width / _extent.height, 1u);
+	VkRect2D rect;
+	rect.offset = { static_cast<int32_t>(window.width) - static_cast<int32_t>(width), static_cast<int32_t>(view * height) };
+	rect.extent = { width, height };
+	return rect;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vk_types.h>
+#include <Camera.h>
+
+#include <cstdint>
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+// views past the main one; cull.comp's CullViews block holds this many
+constexpr uint32_t MAX_SCENE_VIEWS = 4;
+
+// what cull.comp reads of the extra views at set 0, binding 9; see SceneViews
+struct GpuCullViews {
+	glm::uvec4 info; // x the views, y instance slots between two views' stretches of the instance buffer
+	glm::vec4 frustumPlanes[MAX_SCENE_VIEWS * 6]; // each view's in Camera::frustum_planes() order
+};
+
+// Cameras rendered alongside the main one every frame (a minimap, security monitors), each into a color target
+// of its own that stays sampleable after the frame; the engine shows them down the right edge of the window.
+// They ride on the GPU-driven path: the cull dispatch that fills the main view's indirect draws also tests
+// every object against each view's frustum, one row of workgroups per view, and appends the survivors to the
+// view's own slice of the draw, count and instance buffers. The scene buffer, the object slots, the LODs and
+// the batches are shared, so another view costs the CPU a camera block and a pass of indirect draws, never a
+// cull or a sort of its own.
+// Views draw the opaque meshes only, lit by the main camera's shadow cascades and light clusters, so what
+// those don't cover is unshadowed or without point lights.
+class SceneViews
+{
+public:
+	// count targets of format and extent, at most MAX_SCENE_VIEWS; the cameras start out looking at the origin
+	// from distance away, the first straight down like a minimap, the rest from evenly around it
+	void init(VkDevice device, VmaAllocator allocator, uint32_t count, VkFormat format, VkExtent2D extent, float distance);
+	// the GPU must be done with every frame that rendered them
+	void cleanup();
+
+	uint32_t count() const { return static_cast<uint32_t>(_views.size()); }
+	VkFormat format() const { return _format; }
+	VkExtent2D extent() const { return _extent; }
+	VkImage image(uint32_t view) const { return _views[view].target._image; }
+	VkImageView image_view(uint32_t view) const { return _views[view].imageView; }
+
+	// fovY in radians; the aspect is the target's. Takes effect at the next update()
+	void set_camera(uint32_t view, const glm::mat4& viewMatrix, float fovY);
+	// once a frame before the cull, with the main camera for the depth convention and the clip planes
+	void update(const Camera& main);
+	const Camera& camera(uint32_t view) const { return _views[view].camera; }
+
+	// every view's frustum and the instance stride, for the cull dispatch
+	GpuCullViews cull_views(uint32_t instanceStride) const;
+	// where view is shown in a window of that size: stacked from the top of its right edge, each a quarter of its
+	// height, at the target's aspect
+	VkRect2D window_rect(uint32_t view, VkExtent2D window) const;
+
+private:
+	struct View {
+		AllocatedImage target{};
+		VkImageView imageView{ VK_NULL_HANDLE };
+		glm::mat4 viewMatrix{ 1.0f };
+		float fovY{ 1.0f };
+		Camera camera;
+	};
+
+	VkDevice _device{ VK_NULL_HANDLE };
+	VmaAllocator _allocator{ nullptr };
+	VkFormat _format{ VK_FORMAT_UNDEFINED };
+	VkExtent2D _extent{ 0, 0 };
+	std::vector<View> _views;
+};
@@ -0,0 +1,261 @@
+#include "SdfFont.h"
+
+#include "AssetArchive.h"
+#include "Log.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <imgui.h>
+
+// a copy of imgui's stb_truetype of our own: imgui_draw.cpp compiles its one static too
+#define STBTT_STATIC
+#define STB_TRUETYPE_IMPLEMENTATION
+#include <imstb_truetype.h>
+
+namespace {
+	constexpr uint32_t SDF_FONT_MAGIC = 0x544E4651; // "QFNT"
+	constexpr uint32_t SDF_FONT_VERSION = 1;
+
+	struct SdfFontHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t pixelHeight;
+		uint32_t padding;
+		uint32_t width;
+		uint32_t height;
+		float lineHeight;
+		float ascent;
+		uint32_t glyphCount;
+		uint32_t reserved;
+		uint64_t sourceSize; // 0 with the timestamp and hash for the built-in font
+		int64_t sourceTimestamp;
+		uint64_t sourceHash;
+	};
+	static_assert(sizeof(SdfFontHeader) == 64, "font header must not contain padding");
+	static_assert(sizeof(SdfGlyph) == 28, "glyph must not contain padding");
+
+	uint16_t unorm16(uint32_t texel, uint32_t size)
+	{
+		return static_cast<uint16_t>(std::min(uint64_t(texel) * 65535 / size, uint64_t(65535)));
+	}
+}
+
+bool SdfFont::bake(const uint8_t* ttf, size_t size, const SdfFontBakeSettings& settings)
+{
+	clear();
+	stbtt_fontinfo info;
+	const int fontOffset = size > 0 ? stbtt_GetFontOffsetForIndex(ttf, 0) : -1;
+	if (fontOffset < 0 || !stbtt_InitFont(&info, ttf, fontOffset))
+	{
+		return false;
+	}
+
+	const float scale = stbtt_ScaleForPixelHeight(&info, static_cast<float>(settings.pixelHeight));
+	const float em = static_cast<float>(settings.pixelHeight);
+	int ascent = 0, descent = 0, lineGap = 0;
+	stbtt_GetFontVMetrics(&info, &ascent, &descent, &lineGap);
+
+	// rasterized first, then shelf packed by the height they came out at
+	struct Bitmap {
+		unsigned char* distances;
+		int width, height, x, y;
+	};
+	Bitmap bitmaps[GLYPH_COUNT] = {};
+	const float pixelDistance = 128.0f / std::max(settings.padding, 1u);
+	uint32_t shelfX = 0, shelfY = 0, shelfHeight = 0;
+	for (uint32_t i = 0; i < GLYPH_COUNT; i++)
+	{
+		const int code = static_cast<int>(FIRST_CHAR + i);
+		int advance = 0, bearing = 0;
+		stbtt_GetCodepointHMetrics(&info, code, &advance, &bearing);
+		_glyphs[i].advance = advance * scale / em;
+
+		// nothing for a space, whose glyph has no outline
+		Bitmap& bitmap = bitmaps[i];
+		int xOffset = 0, yOffset = 0;
+		bitmap.distances = stbtt_GetCodepointSDF(&info, scale, code, static_cast<int>(settings.padding), 128, pixelDistance,
+			&bitmap.width, &bitmap.height, &xOffset, &yOffset);
+		if (bitmap.distances == nullptr)
+		{
+			continue;
+		}
+		if (shelfX + bitmap.width > settings.atlasWidth)
+		{
+			shelfX = 0;
+			shelfY += shelfHeight;
+			shelfHeight = 0;
+		}
+		bitmap.x = static_cast<int>(shelfX);
+		bitmap.y = static_cast<int>(shelfY);
+		shelfX += bitmap.width;
+		shelfHeight = std::max(shelfHeight, static_cast<uint32_t>(bitmap.height));
+		_glyphs[i].offset[0] = xOffset / em;
+		_glyphs[i].offset[1] = yOffset / em;
+		_glyphs[i].size[0] = bitmap.width / em;
+		_glyphs[i].size[1] = bitmap.height / em;
+	}
+
+	_pixelHeight = settings.pixelHeight;
+	_padding = settings.padding;
+	_width = settings.atlasWidth;
+	_height = std::max(shelfY + shelfHeight, 1u);
+	_lineHeight = (ascent - descent + lineGap) * scale / em;
+	_ascent = ascent * scale / em;
+	_pixels.assign(size_t(_width) * _height, 0);
+	for (uint32_t i = 0; i < GLYPH_COUNT; i++)
+	{
+		const Bitmap& bitmap = bitmaps[i];
+		if (bitmap.distances == nullptr)
+		{
+			continue;
+		}
+		for (int row = 0; row < bitmap.height; row++)
+		{
+			memcpy(&_pixels[size_t(bitmap.y + row) * _width + bitmap.x], bitmap.distances + size_t(row) * bitmap.width, bitmap.width);
+		}
+		_glyphs[i].uv[0] = unorm16(bitmap.x, _width);
+		_glyphs[i].uv[1] = unorm16(bitmap.y, _height);
+		_glyphs[i].uv[2] = unorm16(bitmap.x + bitmap.width, _width);
+		_glyphs[i].uv[3] = unorm16(bitmap.y + bitmap.height, _height);
+		stbtt_FreeSDF(bitmap.distances, nullptr);
+	}
+	return true;
+}
+
+bool SdfFont::bake_builtin(const SdfFontBakeSettings& settings)
+{
+	// the atlas decompresses the embedded TTF and keeps it with the font's config
+	ImFontAtlas atlas;
+	atlas.AddFontDefault();
+	const ImFontConfig& config = atlas.ConfigData[0];
+	return bake(static_cast<const uint8_t*>(config.FontData), static_cast<size_t>(config.FontDataSize), settings);
+}
+
+bool SdfFont::save(const char* path, const char* sourcePath) const
+{
+	SourceStamp stamp = {};
+	if (empty() || (sourcePath != nullptr && !get_source_stamp(sourcePath, stamp)))
+	{
+		return false;
+	}
+
+	SdfFontHeader header = {};
+	header.magic = SDF_FONT_MAGIC;
+	header.version = SDF_FONT_VERSION;
+	header.pixelHeight = _pixelHeight;
+	header.padding = _padding;
+	header.width = _width;
+	header.height = _height;
+	header.lineHeight = _lineHeight;
+	header.ascent = _ascent;
+	header.glyphCount = GLYPH_COUNT;
+	header.sourceSize = stamp.size;
+	header.sourceTimestamp = stamp.timestamp;
+	header.sourceHash = sourcePath != nullptr ? hash_file(sourcePath) : 0;
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		return false;
+	}
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(_glyphs), sizeof(_glyphs));
+	file.write(reinterpret_cast<const char*>(_pixels.data()), _pixels.size());
+	return file.good();
+}
+
+bool SdfFont::load(const char* path, const char* sourcePath, const SdfFontBakeSettings& settings, const AssetArchive* archive)
+{
+	clear();
+
+	MappedFile file;
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+	if (archive == nullptr || !archive->find(path, data, size))
+	{
+		if (!file.open(path))
+		{
+			return false;
+		}
+		data = file.data();
+		size = file.size();
+	}
+
+	SdfFontHeader header;
+	if (size < sizeof(SdfFontHeader))
+	{
+		return false;
+	}
+	memcpy(&header, data, sizeof(SdfFontHeader));
+	if (header.magic != SDF_FONT_MAGIC || header.version != SDF_FONT_VERSION || header.glyphCount != GLYPH_COUNT
+		|| header.pixelHeight != settings.pixelHeight || header.padding != settings.padding || header.width != settings.atlasWidth
+		|| size < sizeof(SdfFontHeader) + sizeof(_glyphs) + uint64_t(header.width) * header.height)
+	{
+		return false;
+	}
+
+	SourceStamp stamp;
+	if (sourcePath != nullptr && get_source_stamp(sourcePath, stamp))
+	{
+		if (stamp.size != header.sourceSize || (stamp.timestamp != header.sourceTimestamp && hash_file(sourcePath) != header.sourceHash))
+		{
+			LOG_WARN(path << " is older than " << sourcePath << ", ignoring it");
+			return false;
+		}
+	}
+
+	_pixelHeight = header.pixelHeight;
+	_padding = header.padding;
+	_width = header.width;
+	_height = header.height;
+	_lineHeight = header.lineHeight;
+	_ascent = header.ascent;
+	memcpy(_glyphs, data + sizeof(SdfFontHeader), sizeof(_glyphs));
+	_pixels.resize(size_t(_width) * _height);
+	memcpy(_pixels.data(), data + sizeof(SdfFontHeader) + sizeof(_glyphs), _pixels.size());
+	return true;
+}
+
+void SdfFont::clear()
+{
+	_pixelHeight = 0;
+	_padding = 0;
+	_width = 0;
+	_height = 0;
+	_lineHeight = 0.0f;
+	_ascent = 0.0f;
+	memset(_glyphs, 0, sizeof(_glyphs));
+	_pixels.clear();
+}
+
+bool load_sdf_font(SdfFont& font, const char* sourcePath, const char* cachePath, const SdfFontBakeSettings& settings, const AssetArchive* archive)
+{
+	if (font.load(cachePath, sourcePath, settings, archive))
+	{
+		return true;
+	}
+
+	bool baked = false;
+	if (sourcePath == nullptr)
+	{
+		baked = font.bake_builtin(settings);
+	}
+	else
+	{
+		MappedFile source;
+		baked = source.open(sourcePath) && font.bake(source.data(), source.size(), settings);
+	}
+	if (!baked)
+	{
+		LOG_ERROR("Could not bake a distance atlas of " << (sourcePath != nullptr ? sourcePath : "the built-in font"));
+		return false;
+	}
+	if (!font.save(cachePath, sourcePath))
+	{
+		LOG_WARN("Could not write " << cachePath);
+	}
+	LOG_INFO("Baked " << cachePath << ": " << font.width() << "x" << font.height() << " texels");
+	return true;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class AssetArchive;
+
+// baked next to the font's source, its own name then this; the built-in font's goes in the assets folder
+constexpr const char* SDF_FONT_EXTENSION = ".qcfont";
+constexpr const char* BUILTIN_FONT_CACHE = "builtin.qcfont";
+
+struct SdfFontBakeSettings {
+	uint32_t pixelHeight{ 48 }; // texels to the em the glyphs are rasterized at
+	uint32_t padding{ 6 }; // texels of distance around each glyph, and the distance 0 and 255 stand for
+	uint32_t atlasWidth{ 512 }; // the height is whatever the glyphs take
+};
+
+// one printable ASCII character of an SdfFont; everything but uv is in ems, y down from the baseline, so
+// text of any size is a scale of the same numbers
+struct SdfGlyph {
+	uint16_t uv[4]; // the atlas rectangle as unorm16: left, top, right, bottom
+	float offset[2]; // the rectangle's top left from the pen
+	float size[2];
+	float advance;
+};
+
+// Signed distance atlas of a TrueType font's printable ASCII characters, baked offline by asset_baker (or
+// by the first run that finds no bake, like the other caches): one R8 texel per atlas texel, 128 on the
+// outline and padding texels of distance either side of it spread over 0..255, so any size drawn from it
+// stays sharp by thresholding at the middle. Glyphs are shelf packed in code order.
+class SdfFont
+{
+public:
+	static constexpr uint32_t FIRST_CHAR = 32;
+	static constexpr uint32_t LAST_CHAR = 126;
+	static constexpr uint32_t GLYPH_COUNT = LAST_CHAR - FIRST_CHAR + 1;
+
+	// from a TrueType file's bytes; false when they aren't one
+	bool bake(const uint8_t* ttf, size_t size, const SdfFontBakeSettings& settings = {});
+	// from the pixel font imgui embeds, for when the assets have no TTF
+	bool bake_builtin(const SdfFontBakeSettings& settings = {});
+
+	// stamped with sourcePath like the mesh caches, unstamped for the built-in font (sourcePath null)
+	bool save(const char* path, const char* sourcePath) const;
+	// from archive's copy of path when it has one; false (and empty) when missing, outdated, corrupt or
+	// baked with other settings
+	bool load(const char* path, const char* sourcePath, const SdfFontBakeSettings& settings = {}, const AssetArchive* archive = nullptr);
+	void clear();
+
+	bool empty() const { return _pixels.empty(); }
+	uint32_t width() const { return _width; }
+	uint32_t height() const { return _height; }
+	const std::vector<uint8_t>& pixels() const { return _pixels; }
+	// the baseline-to-baseline distance, in ems
+	float line_height() const { return _lineHeight; }
+	// from the top of a line to its baseline, in ems
+	float ascent() const { return _ascent; }
+
+	// nullptr for characters outside printable ASCII
+	const SdfGlyph* glyph(char c) const
+	{
+		const uint32_t code = static_cast<unsigned char>(c);
+		return code >= FIRST_CHAR && code <= LAST_CHAR && !empty() ? &_glyphs[code - FIRST_CHAR] : nullptr;
+	}
+
+private:
+	uint32_t _pixelHeight{ 0 };
+	uint32_t _padding{ 0 };
+	uint32_t _width{ 0 };
+	uint32_t _height{ 0 };
+	float _lineHeight{ 0.0f };
+	float _ascent{ 0.0f };
+	SdfGlyph _glyphs[GLYPH_COUNT]{};
+	std::vector<uint8_t> _pixels;
+};
+
+// cachePath's bake of sourcePath (the built-in font when null), baked and saved there when it's missing or
+// out of date; false when neither worked
+bool load_sdf_font(SdfFont& font, const char* sourcePath, const char* cachePath, const SdfFontBakeSettings& settings = {},
+	const AssetArchive* archive = nullptr);
@@ -0,0 +1,349 @@
+#include "ShaderHotReload.h"
+
+#include "Log.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+	bool ends_with(const std::string& text, const std::string& suffix)
+	{
+		return text.size() > suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+	}
+
+	// a build with HALF_PRECISION defined (see shaders/half.glsl)
+	bool half_precision(const std::string& spvPath)
+	{
+		return ends_with(spvPath, ".half.spv");
+	}
+
+	// the source a .spv was built from: foo.frag for foo.frag.spv and foo.frag.half.spv
+	std::string source_of(const std::string& spvPath)
+	{
+		const std::string suffix = half_precision(spvPath) ? ".half.spv" : ".spv";
+		if (ends_with(spvPath, suffix))
+		{
+			return spvPath.substr(0, spvPath.size() - suffix.size());
+		}
+		return std::string();
+	}
+
+	bool write_time(const std::filesystem::path& path, int64_t& time)
+	{
+		std::error_code ec;
+		auto writeTime = std::filesystem::last_write_time(path, ec);
+		if (ec)
+		{
+			return false;
+		}
+		time = static_cast<int64_t>(writeTime.time_since_epoch().count());
+		return true;
+	}
+
+	bool load_module(VkDevice device, const std::string& path, VkShaderModule* outModule)
+	{
+		std::ifstream file(path, std::ios::ate | std::ios::binary);
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		size_t fileSize = (size_t)file.tellg();
+		std::vector<uint32_t> buffer(fileSize / sizeof(uint32_t));
+		file.seekg(0);
+		file.read((char*)buffer.data(), fileSize);
+		file.close();
+
+		VkShaderModuleCreateInfo createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		createInfo.pNext = nullptr;
+		createInfo.codeSize = buffer.size() * sizeof(uint32_t);
+		createInfo.pCode = buffer.data();
+		return vkCreateShaderModule(device, &createInfo, nullptr, outModule) == VK_SUCCESS;
+	}
+}
+
+void ShaderHotReload::init(VkDevice device, VkPipelineCache cache, std::string compiler)
+{
+	_device = device;
+	_cache = cache;
+	_compiler = std::move(compiler);
+}
+
+void ShaderHotReload::cleanup()
+{
+	if (_rebuild.valid())
+	{
+		for (const Rebuilt& rebuilt : _rebuild.get())
+		{
+			if (rebuilt.pipeline != VK_NULL_HANDLE)
+			{
+				vkDestroyPipeline(_device, rebuilt.pipeline, nullptr);
+			}
+		}
+	}
+	for (Tracked& tracked : _tracked)
+	{
+		if (tracked.owned)
+		{
+			vkDestroyPipeline(_device, *tracked.target, nullptr);
+			*tracked.target = VK_NULL_HANDLE;
+		}
+	}
+	_tracked.clear();
+	_modulePaths.clear();
+	_sourceTimes.clear();
+	_includeFolders.clear();
+}
+
+void ShaderHotReload::note_module(VkShaderModule module, const std::string& spvPath)
+{
+	_modulePaths[module] = spvPath;
+}
+
+void ShaderHotReload::track(const PipelineDescription& description, VkPipeline* target)
+{
+	Tracked tracked{ description, {}, target, false };
+	for (const VkPipelineShaderStageCreateInfo& stage : description.shaderStages)
+	{
+		auto path = _modulePaths.find(stage.module);
+		if (path == _modulePaths.end() || source_of(path->second).empty())
+		{
+			// not loaded from a file we can rebuild, so neither is the pipeline
+			return;
+		}
+		tracked.stagePaths.push_back(path->second);
+
+		const std::string folder = std::filesystem::path(path->second).parent_path().string();
+		if (std::find(_includeFolders.begin(), _includeFolders.end(), folder) == _includeFolders.end())
+		{
+			_includeFolders.push_back(folder);
+		}
+	}
+	_tracked.push_back(std::move(tracked));
+}
+
+void ShaderHotReload::update(DeletionQueue& retired, const std::function<void(VkPipeline previous, VkPipeline pipeline)>& replaced)
+{
+	if (_rebuild.valid())
+	{
+		if (_rebuild.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		{
+			return;
+		}
+
+		uint32_t swapped = 0;
+		for (const Rebuilt& rebuilt : _rebuild.get())
+		{
+			Tracked& tracked = _tracked[rebuilt.tracked];
+			const VkPipeline previous = *tracked.target;
+			*tracked.target = rebuilt.pipeline;
+			if (previous != VK_NULL_HANDLE)
+			{
+				replaced(previous, rebuilt.pipeline);
+			}
+			// frames still in flight may be using it
+			if (tracked.owned && previous != VK_NULL_HANDLE)
+			{
+				retired.push_pipeline(previous);
+			}
+			tracked.owned = true;
+			swapped++;
+		}
+		if (swapped > 0)
+		{
+			LOG_INFO("Shader hot reload: swapped in " << swapped << " rebuilt pipelines");
+		}
+	}
+
+	const auto now = std::chrono::steady_clock::now();
+	if (_tracked.empty() || now - _lastScan < pollInterval)
+	{
+		return;
+	}
+	_lastScan = now;
+	scan_sources();
+}
+
+void ShaderHotReload::scan_sources()
+{
+	// a path seen for the first time is only recorded, so the first scan rebuilds nothing
+	auto changed = [this](const std::string& path) {
+		int64_t time;
+		if (!write_time(path, time))
+		{
+			return false;
+		}
+		auto known = _sourceTimes.find(path);
+		if (known == _sourceTimes.end())
+		{
+			_sourceTimes[path] = time;
+			return false;
+		}
+		const bool modified = known->second != time;
+		known->second = time;
+		return modified;
+	};
+
+	bool includeChanged = false;
+	for (const std::string& folder : _includeFolders)
+	{
+		std::error_code ec;
+		for (const auto& entry : std::filesystem::directory_iterator(folder, ec))
+		{
+			if (entry.path().extension() == ".glsl" && changed(entry.path().string()))
+			{
+				includeChanged = true;
+			}
+		}
+	}
+
+	std::vector<std::string> sources;
+	std::vector<std::string> spvPaths;
+	for (const Tracked& tracked : _tracked)
+	{
+		for (const std::string& spvPath : tracked.stagePaths)
+		{
+			const std::string source = source_of(spvPath);
+			if (std::find(sources.begin(), sources.end(), source) == sources.end())
+			{
+				sources.push_back(source);
+			}
+			if (std::find(spvPaths.begin(), spvPaths.end(), spvPath) == spvPaths.end())
+			{
+				spvPaths.push_back(spvPath);
+			}
+		}
+	}
+
+	// every source is checked, so their times stay current even when an include rebuilds them all
+	std::vector<std::string> modifiedSources;
+	for (const std::string& source : sources)
+	{
+		if (changed(source) || includeChanged)
+		{
+			modifiedSources.push_back(source);
+		}
+	}
+	// and every build of them in use is recompiled
+	std::vector<std::string> modified;
+	for (const std::string& spvPath : spvPaths)
+	{
+		if (std::find(modifiedSources.begin(), modifiedSources.end(), source_of(spvPath)) != modifiedSources.end())
+		{
+			modified.push_back(spvPath);
+		}
+	}
+
+	if (!modified.empty())
+	{
+		_rebuild = std::async(std::launch::async, [this, modified = std::move(modified)]() {
+			return rebuild(modified);
+		});
+	}
+}
+
+std::vector<ShaderHotReload::Rebuilt> ShaderHotReload::rebuild(const std::vector<std::string>& spvPaths) const
+{
+	// the same command line as the build's shader rules
+	std::vector<std::string> compiled;
+	for (const std::string& spvPath : spvPaths)
+	{
+		const std::string source = source_of(spvPath);
+		const std::string extension = std::filesystem::path(source).extension().string();
+		std::string command = "\"" + _compiler + "\" -V ";
+		const std::string filename = std::filesystem::path(source).filename().string();
+		if (extension == ".task" || extension == ".mesh" || filename.rfind("ray", 0) == 0)
+		{
+			command += "--target-env spirv1.4 ";
+		}
+		else if (filename.rfind("prim", 0) == 0 || filename.rfind("overdrawQuad", 0) == 0)
+		{
+			command += "--target-env spirv1.3 ";
+		}
+		if (half_precision(spvPath))
+		{
+			command += "-DHALF_PRECISION ";
+		}
+		command += "\"" + source + "\" -o \"" + spvPath + "\"";
+#ifdef _WIN32
+		// cmd.exe strips the outermost quotes
+		command = "\"" + command + "\"";
+#endif
+		LOG_INFO("Shader hot reload: compiling " << source);
+		if (std::system(command.c_str()) != 0)
+		{
+			LOG_ERROR("Shader hot reload: " << source << " failed to compile, keeping its pipelines");
+			continue;
+		}
+		compiled.push_back(spvPath);
+	}
+
+	// every stage of an affected pipeline is loaded again, the unchanged ones too, so no module has to
+	// stay alive between rebuilds
+	std::unordered_map<std::string, VkShaderModule> modules;
+	std::vector<size_t> rebuilding;
+	std::vector<std::future<VkPipeline>> pending;
+	for (size_t i = 0; i < _tracked.size(); i++)
+	{
+		const Tracked& tracked = _tracked[i];
+		const bool affected = std::any_of(tracked.stagePaths.begin(), tracked.stagePaths.end(), [&](const std::string& path) {
+			return std::find(compiled.begin(), compiled.end(), path) != compiled.end();
+		});
+		if (!affected)
+		{
+			continue;
+		}
+
+		PipelineDescription description = tracked.description;
+		bool loaded = true;
+		for (size_t stage = 0; stage < description.shaderStages.size(); stage++)
+		{
+			const std::string& path = tracked.stagePaths[stage];
+			auto module = modules.find(path);
+			if (module == modules.end())
+			{
+				VkShaderModule shaderModule = VK_NULL_HANDLE;
+				if (!load_module(_device, path, &shaderModule))
+				{
+					LOG_ERROR("Shader hot reload: could not load " << path);
+				}
+				module = modules.emplace(path, shaderModule).first;
+			}
+			loaded = loaded && module->second != VK_NULL_HANDLE;
+			description.shaderStages[stage].module = module->second;
+		}
+		if (!loaded)
+		{
+			continue;
+		}
+
+		rebuilding.push_back(i);
+		pending.push_back(PipelineBuilder::build_pipeline_async(_device, std::move(description), _cache));
+	}
+
+	std::vector<Rebuilt> rebuilt;
+	for (size_t i = 0; i < pending.size(); i++)
+	{
+		VkPipeline pipeline = pending[i].get();
+		if (pipeline == VK_NULL_HANDLE)
+		{
+			LOG_ERROR("Shader hot reload: a pipeline failed to build, keeping the old one");
+			continue;
+		}
+		rebuilt.push_back({ rebuilding[i], pipeline });
+	}
+
+	// modules can go once the pipelines using them are created
+	for (const auto& module : modules)
+	{
+		if (module.second != VK_NULL_HANDLE)
+		{
+			vkDestroyShaderModule(_device, module.second, nullptr);
+		}
+	}
+	return rebuilt;
+}
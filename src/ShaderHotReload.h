@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vk_types.h>
+#include <DeletionQueue.h>
+#include <PipelineBuilder.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Rebuilds graphics pipelines when the GLSL they were compiled from changes on disk.
+// Shader modules are noted with the .spv they were loaded from and pipelines tracked with their
+// description; update() polls the sources next to the .spv files (foo.frag for foo.frag.spv and
+// foo.frag.half.spv, and every .glsl include in the same folders), recompiles the changed ones with glslangValidator and rebuilds
+// the pipelines using them through the pipeline cache, all on a background thread. The next update()
+// after that swaps the new handles into the tracked variables. A shader that fails to compile keeps
+// its old pipelines, so a typo doesn't take the frame down.
+class ShaderHotReload
+{
+public:
+	// compiler is the glslangValidator executable, with the flags the build uses added per stage
+	void init(VkDevice device, VkPipelineCache cache, std::string compiler);
+	// waits for a rebuild in flight and destroys the pipelines it created, so the GPU must be done with them
+	void cleanup();
+
+	// module was just loaded from spvPath
+	void note_module(VkShaderModule module, const std::string& spvPath);
+	// target was, or is being, built from description, whose stages' modules must have been noted.
+	// Everything is tracked before the first update()
+	void track(const PipelineDescription& description, VkPipeline* target);
+
+	// once per frame, between frames: finishes a rebuild that is done, then checks the sources every
+	// pollInterval and starts the next one. Replaced pipelines go to retired, and replaced is called
+	// for each, so copies of the old handle (materials) can be pointed at the new one
+	void update(DeletionQueue& retired, const std::function<void(VkPipeline previous, VkPipeline pipeline)>& replaced);
+
+	std::chrono::milliseconds pollInterval{ 500 };
+
+private:
+	struct Tracked {
+		PipelineDescription description;
+		// .spv of every stage, parallel to the description's stages
+		std::vector<std::string> stagePaths;
+		VkPipeline* target;
+		// the first pipeline is destroyed by whoever built it; the ones swapped in after it are ours
+		bool owned;
+	};
+
+	struct Rebuilt {
+		size_t tracked;
+		VkPipeline pipeline;
+	};
+
+	void scan_sources();
+	// runs on the rebuild thread, so _tracked must not change meanwhile; spvPaths are the builds to recompile
+	std::vector<Rebuilt> rebuild(const std::vector<std::string>& spvPaths) const;
+
+	VkDevice _device{ VK_NULL_HANDLE };
+	VkPipelineCache _cache{ VK_NULL_HANDLE };
+	std::string _compiler;
+
+	std::unordered_map<VkShaderModule, std::string> _modulePaths;
+	std::vector<Tracked> _tracked;
+	// last write time of every source and include, as seen by the last scan
+	std::unordered_map<std::string, int64_t> _sourceTimes;
+	std::vector<std::string> _includeFolders;
+
+	std::chrono::steady_clock::time_point _lastScan{};
+	std::future<std::vector<Rebuilt>> _rebuild;
+};
@@ -0,0 +1,489 @@
+#include "ShaderReflection.h"
+
+#include <algorithm>
+
+namespace {
+
+	// the subset of the SPIR-V spec the reflection reads
+	constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+
+	enum Op : uint32_t {
+		OpEntryPoint = 15,
+		OpTypeInt = 21,
+		OpTypeFloat = 22,
+		OpTypeVector = 23,
+		OpTypeMatrix = 24,
+		OpTypeImage = 25,
+		OpTypeSampler = 26,
+		OpTypeSampledImage = 27,
+		OpTypeArray = 28,
+		OpTypeRuntimeArray = 29,
+		OpTypeStruct = 30,
+		OpTypePointer = 32,
+		OpConstant = 43,
+		OpVariable = 59,
+		OpDecorate = 71,
+		OpMemberDecorate = 72,
+		OpTypeAccelerationStructureKHR = 5341,
+	};
+
+	enum Decoration : uint32_t {
+		DecorationBufferBlock = 3,
+		DecorationArrayStride = 6,
+		DecorationMatrixStride = 7,
+		DecorationBuiltIn = 11,
+		DecorationLocation = 30,
+		DecorationBinding = 33,
+		DecorationDescriptorSet = 34,
+		DecorationOffset = 35,
+	};
+
+	enum StorageClass : uint32_t {
+		StorageClassUniformConstant = 0,
+		StorageClassInput = 1,
+		StorageClassUniform = 2,
+		StorageClassPushConstant = 9,
+		StorageClassStorageBuffer = 12,
+	};
+
+	constexpr uint32_t DIM_BUFFER = 5;
+	constexpr uint32_t DIM_SUBPASS_DATA = 6;
+
+	// everything known about one result id
+	struct Id {
+		uint32_t opcode{ 0 };
+		// pointee, element, component, column or result type, depending on opcode
+		uint32_t type{ 0 };
+		// vector components, matrix columns, scalar width, or the array length's constant id
+		uint32_t count{ 0 };
+		// constants; images: dim
+		uint32_t value{ 0 };
+		// images: 1 sampled, 2 storage
+		uint32_t sampled{ 0 };
+		uint32_t storageClass{ 0 };
+		uint32_t arrayStride{ 0 };
+		uint32_t set{ 0 };
+		uint32_t binding{ 0 };
+		uint32_t location{ 0 };
+		bool hasSet{ false };
+		bool hasBinding{ false };
+		bool hasLocation{ false };
+		bool builtIn{ false };
+		bool bufferBlock{ false };
+		// structs
+		std::vector<uint32_t> members;
+		std::vector<uint32_t> memberOffsets;
+		std::vector<uint32_t> memberMatrixStrides;
+	};
+
+	VkShaderStageFlags stage_of(uint32_t executionModel)
+	{
+		switch (executionModel)
+		{
+		case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+		case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+		case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+		case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+		case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+		case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+#ifdef VK_EXT_mesh_shader
+		case 5364: return VK_SHADER_STAGE_TASK_BIT_EXT;
+		case 5365: return VK_SHADER_STAGE_MESH_BIT_EXT;
+#endif
+		default: return 0;
+		}
+	}
+
+	uint32_t array_length(const std::vector<Id>& ids, const Id& array)
+	{
+		return array.count < ids.size() ? ids[array.count].value : 0;
+	}
+
+	// bytes the type takes in a block, with the strides the block's layout decorated it with
+	uint32_t type_size(const std::vector<Id>& ids, uint32_t typeId, uint32_t matrixStride = 0)
+	{
+		const Id& type = ids[typeId];
+		switch (type.opcode)
+		{
+		case OpTypeInt:
+		case OpTypeFloat:
+			return type.count / 8;
+		case OpTypeVector:
+			return type.count * type_size(ids, type.type);
+		case OpTypeMatrix:
+			return type.count * (matrixStride != 0 ? matrixStride : type_size(ids, type.type));
+		case OpTypeArray:
+			return array_length(ids, type) * (type.arrayStride != 0 ? type.arrayStride : type_size(ids, type.type));
+		case OpTypeStruct:
+		{
+			uint32_t size = 0;
+			for (size_t i = 0; i < type.members.size(); i++)
+			{
+				const uint32_t offset = i < type.memberOffsets.size() ? type.memberOffsets[i] : 0;
+				const uint32_t stride = i < type.memberMatrixStrides.size() ? type.memberMatrixStrides[i] : 0;
+				size = std::max(size, offset + type_size(ids, type.members[i], stride));
+			}
+			return size;
+		}
+		default:
+			return 0;
+		}
+	}
+
+	uint32_t location_count(const std::vector<Id>& ids, uint32_t typeId)
+	{
+		const Id& type = ids[typeId];
+		switch (type.opcode)
+		{
+		case OpTypeMatrix:
+			return type.count;
+		case OpTypeArray:
+			return array_length(ids, type) * location_count(ids, type.type);
+		default:
+			return 1;
+		}
+	}
+
+	// false for resources no descriptor type fits
+	bool descriptor_type(const std::vector<Id>& ids, uint32_t storageClass, uint32_t typeId, VkDescriptorType& descriptorType)
+	{
+		const Id& type = ids[typeId];
+		if (storageClass == StorageClassStorageBuffer)
+		{
+			descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			return true;
+		}
+		if (storageClass == StorageClassUniform)
+		{
+			// before SPIR-V 1.3 storage buffers were uniform blocks decorated BufferBlock
+			descriptorType = type.bufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			return true;
+		}
+
+		switch (type.opcode)
+		{
+		case OpTypeSampler:
+			descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+			return true;
+		case OpTypeSampledImage:
+			descriptorType = ids[type.type].value == DIM_BUFFER ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			return true;
+		case OpTypeImage:
+			if (type.value == DIM_BUFFER)
+			{
+				descriptorType = type.sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+			}
+			else if (type.value == DIM_SUBPASS_DATA)
+			{
+				descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+			}
+			else
+			{
+				descriptorType = type.sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+			}
+			return true;
+#ifdef VK_KHR_acceleration_structure
+		case OpTypeAccelerationStructureKHR:
+			descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+			return true;
+#endif
+		default:
+			return false;
+		}
+	}
+}
+
+bool reflect_spirv(const uint32_t* code, size_t wordCount, ShaderReflection& reflection)
+{
+	if (wordCount < 5 || code[0] != SPIRV_MAGIC)
+	{
+		return false;
+	}
+
+	std::vector<Id> ids(code[3]);
+	std::vector<uint32_t> variables;
+	uint32_t executionModel = UINT32_MAX;
+
+	// declarations only reference ids declared before them, decorations aside, so one pass resolves everything
+	for (size_t word = 5; word < wordCount;)
+	{
+		const uint32_t opcode = code[word] & 0xFFFF;
+		const uint32_t length = code[word] >> 16;
+		if (length == 0 || word + length > wordCount)
+		{
+			return false;
+		}
+		const uint32_t* operands = code + word + 1;
+		const uint32_t operandCount = length - 1;
+
+		// every id operand read below must be in range
+		auto valid = [&](uint32_t id) { return id < ids.size(); };
+
+		switch (opcode)
+		{
+		case OpEntryPoint:
+			if (executionModel == UINT32_MAX && operandCount >= 1)
+			{
+				executionModel = operands[0];
+			}
+			break;
+		case OpDecorate:
+			if (operandCount >= 2 && valid(operands[0]))
+			{
+				Id& target = ids[operands[0]];
+				const uint32_t value = operandCount >= 3 ? operands[2] : 0;
+				switch (operands[1])
+				{
+				case DecorationBufferBlock: target.bufferBlock = true; break;
+				case DecorationArrayStride: target.arrayStride = value; break;
+				case DecorationBuiltIn: target.builtIn = true; break;
+				case DecorationLocation: target.location = value; target.hasLocation = true; break;
+				case DecorationBinding: target.binding = value; target.hasBinding = true; break;
+				case DecorationDescriptorSet: target.set = value; target.hasSet = true; break;
+				default: break;
+				}
+			}
+			break;
+		case OpMemberDecorate:
+			if (operandCount >= 4 && valid(operands[0]))
+			{
+				Id& target = ids[operands[0]];
+				const uint32_t member = operands[1];
+				if (operands[2] == DecorationOffset)
+				{
+					target.memberOffsets.resize(std::max<size_t>(target.memberOffsets.size(), member + 1));
+					target.memberOffsets[member] = operands[3];
+				}
+				else if (operands[2] == DecorationMatrixStride)
+				{
+					target.memberMatrixStrides.resize(std::max<size_t>(target.memberMatrixStrides.size(), member + 1));
+					target.memberMatrixStrides[member] = operands[3];
+				}
+				else if (operands[2] == DecorationBuiltIn)
+				{
+					target.builtIn = true;
+				}
+			}
+			break;
+		case OpTypeInt:
+		case OpTypeFloat:
+			if (operandCount >= 2 && valid(operands[0]))
+			{
+				ids[operands[0]].opcode = opcode;
+				ids[operands[0]].count = operands[1];
+			}
+			break;
+		case OpTypeVector:
+		case OpTypeMatrix:
+		case OpTypeArray:
+			if (operandCount >= 3 && valid(operands[0]) && valid(operands[1]))
+			{
+				ids[operands[0]].opcode = opcode;
+				ids[operands[0]].type = operands[1];
+				ids[operands[0]].count = operands[2];
+			}
+			break;
+		case OpTypeRuntimeArray:
+		case OpTypeSampledImage:
+			if (operandCount >= 2 && valid(operands[0]) && valid(operands[1]))
+			{
+				ids[operands[0]].opcode = opcode;
+				ids[operands[0]].type = operands[1];
+			}
+			break;
+		case OpTypeImage:
+			if (operandCount >= 7 && valid(operands[0]))
+			{
+				ids[operands[0]].opcode = opcode;
+				ids[operands[0]].value = operands[2];
+				ids[operands[0]].sampled = operands[6];
+			}
+			break;
+		case OpTypeSampler:
+		case OpTypeAccelerationStructureKHR:
+			if (operandCount >= 1 && valid(operands[0]))
+			{
+				ids[operands[0]].opcode = opcode;
+			}
+			break;
+		case OpTypeStruct:
+			if (operandCount >= 1 && valid(operands[0]))
+			{
+				Id& type = ids[operands[0]];
+				type.opcode = opcode;
+				for (uint32_t i = 1; i < operandCount; i++)
+				{
+					if (!valid(operands[i]))
+					{
+						return false;
+					}
+					type.members.push_back(operands[i]);
+				}
+			}
+			break;
+		case OpTypePointer:
+			if (operandCount >= 3 && valid(operands[0]) && valid(operands[2]))
+			{
+				ids[operands[0]].opcode = opcode;
+				ids[operands[0]].storageClass = operands[1];
+				ids[operands[0]].type = operands[2];
+			}
+			break;
+		case OpConstant:
+			if (operandCount >= 3 && valid(operands[1]))
+			{
+				ids[operands[1]].opcode = opcode;
+				ids[operands[1]].type = operands[0];
+				ids[operands[1]].value = operands[2];
+			}
+			break;
+		case OpVariable:
+			if (operandCount >= 3 && valid(operands[0]) && valid(operands[1]))
+			{
+				ids[operands[1]].opcode = opcode;
+				ids[operands[1]].type = operands[0];
+				ids[operands[1]].storageClass = operands[2];
+				variables.push_back(operands[1]);
+			}
+			break;
+		default:
+			break;
+		}
+		word += length;
+	}
+
+	const VkShaderStageFlags stage = stage_of(executionModel);
+	if (stage == 0)
+	{
+		return false;
+	}
+	reflection = ShaderReflection{};
+	reflection.stages = stage;
+
+	for (uint32_t variableId : variables)
+	{
+		const Id& variable = ids[variableId];
+		const Id& pointer = ids[variable.type];
+		if (pointer.opcode != OpTypePointer)
+		{
+			return false;
+		}
+
+		switch (variable.storageClass)
+		{
+		case StorageClassPushConstant:
+			reflection.pushConstantSize = std::max(reflection.pushConstantSize, type_size(ids, pointer.type));
+			reflection.pushConstantStages = stage;
+			break;
+		case StorageClassInput:
+			if (stage == VK_SHADER_STAGE_VERTEX_BIT && variable.hasLocation && !variable.builtIn && !ids[pointer.type].builtIn)
+			{
+				const uint32_t count = location_count(ids, pointer.type);
+				for (uint32_t location = variable.location; location < variable.location + count && location < 64; location++)
+				{
+					reflection.inputLocations |= 1ull << location;
+				}
+			}
+			break;
+		case StorageClassUniformConstant:
+		case StorageClassUniform:
+		case StorageClassStorageBuffer:
+		{
+			if (!variable.hasSet || !variable.hasBinding)
+			{
+				break;
+			}
+			ShaderReflection::Binding binding{ variable.set, variable.binding, VK_DESCRIPTOR_TYPE_MAX_ENUM, 1, stage };
+			uint32_t typeId = pointer.type;
+			if (ids[typeId].opcode == OpTypeArray)
+			{
+				binding.count = array_length(ids, ids[typeId]);
+				typeId = ids[typeId].type;
+			}
+			else if (ids[typeId].opcode == OpTypeRuntimeArray)
+			{
+				binding.count = 0;
+				typeId = ids[typeId].type;
+			}
+			if (!descriptor_type(ids, variable.storageClass, typeId, binding.type))
+			{
+				return false;
+			}
+			reflection.bindings.push_back(binding);
+			break;
+		}
+		default:
+			break;
+		}
+	}
+	return true;
+}
+
+void ShaderReflection::merge(const ShaderReflection& other)
+{
+	stages |= other.stages;
+	for (const Binding& binding : other.bindings)
+	{
+		auto existing = std::find_if(bindings.begin(), bindings.end(), [&](const Binding& b) {
+			return b.set == binding.set && b.binding == binding.binding;
+		});
+		if (existing != bindings.end())
+		{
+			existing->stages |= binding.stages;
+		}
+		else
+		{
+			bindings.push_back(binding);
+		}
+	}
+	pushConstantSize = std::max(pushConstantSize, other.pushConstantSize);
+	pushConstantStages |= other.pushConstantStages;
+	inputLocations |= other.inputLocations;
+}
+
+uint32_t ShaderReflection::set_count() const
+{
+	uint32_t count = 0;
+	for (const Binding& binding : bindings)
+	{
+		count = std::max(count, binding.set + 1);
+	}
+	return count;
+}
+
+std::vector<VkDescriptorSetLayoutBinding> ShaderReflection::set_bindings(uint32_t set, bool dynamicUniforms) const
+{
+	std::vector<VkDescriptorSetLayoutBinding> result;
+	for (const Binding& binding : bindings)
+	{
+		if (binding.set != set)
+		{
+			continue;
+		}
+		VkDescriptorSetLayoutBinding layoutBinding = {};
+		layoutBinding.binding = binding.binding;
+		layoutBinding.descriptorType = dynamicUniforms && binding.type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : binding.type;
+		layoutBinding.descriptorCount = binding.count;
+		layoutBinding.stageFlags = binding.stages;
+		layoutBinding.pImmutableSamplers = nullptr;
+		result.push_back(layoutBinding);
+	}
+	std::sort(result.begin(), result.end(), [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) {
+		return a.binding < b.binding;
+	});
+	return result;
+}
+
+VertexInputDescription ShaderReflection::consumed_inputs(VertexInputDescription description) const
+{
+	description.attributes.erase(std::remove_if(description.attributes.begin(), description.attributes.end(),
+		[&](const VkVertexInputAttributeDescription& attribute) {
+			return attribute.location >= 64 || (inputLocations & (1ull << attribute.location)) == 0;
+		}), description.attributes.end());
+	description.bindings.erase(std::remove_if(description.bindings.begin(), description.bindings.end(),
+		[&](const VkVertexInputBindingDescription& binding) {
+			return std::none_of(description.attributes.begin(), description.attributes.end(),
+				[&](const VkVertexInputAttributeDescription& attribute) { return attribute.binding == binding.binding; });
+		}), description.bindings.end());
+	return description;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vk_types.h>
+#include <VertexLayout.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// What a shader, or a set of stages merged together, expects from its pipeline layout and vertex input,
+// read from the SPIR-V itself so the C++ side doesn't restate what the GLSL already declares.
+struct ShaderReflection {
+	struct Binding {
+		uint32_t set;
+		uint32_t binding;
+		VkDescriptorType type;
+		// 0 for unsized (bindless) arrays
+		uint32_t count;
+		VkShaderStageFlags stages;
+	};
+
+	VkShaderStageFlags stages{ 0 };
+	std::vector<Binding> bindings;
+	// one range from offset 0; 0 without a push constant block
+	uint32_t pushConstantSize{ 0 };
+	VkShaderStageFlags pushConstantStages{ 0 };
+	// vertex stage inputs, one bit per location; matrices take one location per column
+	uint64_t inputLocations{ 0 };
+
+	// adds another stage of the same pipeline; bindings both use are merged, with both stages
+	void merge(const ShaderReflection& other);
+
+	// sets up to the highest one any stage uses
+	uint32_t set_count() const;
+	// set's bindings, sorted by binding. Uniform buffers come out as UNIFORM_BUFFER_DYNAMIC when
+	// dynamicUniforms is set, since SPIR-V doesn't tell the two apart
+	std::vector<VkDescriptorSetLayoutBinding> set_bindings(uint32_t set, bool dynamicUniforms) const;
+	// vertex attributes of description the vertex stage reads, and the bindings they come from
+	VertexInputDescription consumed_inputs(VertexInputDescription description) const;
+};
+
+// parses module's code; false if it isn't valid SPIR-V or uses something the reflection doesn't know
+bool reflect_spirv(const uint32_t* code, size_t wordCount, ShaderReflection& reflection);
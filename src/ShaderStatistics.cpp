@@ -0,0 +1,245 @@
+#include "ShaderStatistics.h"
+
+#include "Log.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace {
+#ifdef VK_KHR_pipeline_executable_properties
+	std::string stage_names(VkShaderStageFlags stages)
+	{
+		static const struct { VkShaderStageFlags stage; const char* name; } names[] = {
+			{ VK_SHADER_STAGE_VERTEX_BIT, "vertex" },
+			{ VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT, "tess control" },
+			{ VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT, "tess evaluation" },
+			{ VK_SHADER_STAGE_GEOMETRY_BIT, "geometry" },
+#ifdef VK_EXT_mesh_shader
+			{ VK_SHADER_STAGE_TASK_BIT_EXT, "task" },
+			{ VK_SHADER_STAGE_MESH_BIT_EXT, "mesh" },
+#endif
+			{ VK_SHADER_STAGE_FRAGMENT_BIT, "fragment" },
+			{ VK_SHADER_STAGE_COMPUTE_BIT, "compute" },
+		};
+		std::string text;
+		for (const auto& entry : names)
+		{
+			if ((stages & entry.stage) != 0)
+			{
+				text += text.empty() ? "" : "+";
+				text += entry.name;
+			}
+		}
+		return text.empty() ? std::string("other") : text;
+	}
+
+	int64_t statistic_value(const VkPipelineExecutableStatisticKHR& statistic)
+	{
+		switch (statistic.format)
+		{
+		case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_BOOL32_KHR: return statistic.value.b32 == VK_TRUE ? 1 : 0;
+		case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_INT64_KHR: return statistic.value.i64;
+		case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_UINT64_KHR: return static_cast<int64_t>(statistic.value.u64);
+		case VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_FLOAT64_KHR: return static_cast<int64_t>(statistic.value.f64);
+		default: return -1;
+		}
+	}
+
+	std::string lowercase(const char* text)
+	{
+		std::string lower(text);
+		std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		return lower;
+	}
+
+	bool contains(const std::string& text, const char* part)
+	{
+		return text.find(part) != std::string::npos;
+	}
+#endif
+
+	void append_count(logging::Line& line, const char* label, int64_t value)
+	{
+		line.stream() << ", " << label << ' ';
+		if (value < 0)
+		{
+			line.stream() << '-';
+		}
+		else
+		{
+			line.stream() << value;
+		}
+	}
+}
+
+void ShaderStatistics::init(VkDevice device, PFN_vkVoidFunction getProperties, PFN_vkVoidFunction getStatistics)
+{
+	_device = device;
+	_getProperties = getProperties;
+	_getStatistics = getStatistics;
+	_pipelines.clear();
+}
+
+void ShaderStatistics::capture(VkPipeline pipeline, const char* name)
+{
+	if (!enabled() || pipeline == VK_NULL_HANDLE)
+	{
+		return;
+	}
+	for (const Pipeline& entry : _pipelines)
+	{
+		if (entry.pipeline == pipeline)
+		{
+			return;
+		}
+	}
+	Pipeline entry;
+	entry.pipeline = pipeline;
+	entry.name = name;
+	query(entry);
+	_pipelines.push_back(std::move(entry));
+}
+
+void ShaderStatistics::recapture(VkPipeline previous, VkPipeline pipeline)
+{
+	for (Pipeline& entry : _pipelines)
+	{
+		if (entry.pipeline == previous)
+		{
+			entry.pipeline = pipeline;
+			query(entry);
+			log(entry);
+			return;
+		}
+	}
+}
+
+void ShaderStatistics::log() const
+{
+	for (const Pipeline& entry : _pipelines)
+	{
+		log(entry);
+	}
+}
+
+void ShaderStatistics::log(const Pipeline& entry)
+{
+	if (entry.executables.empty())
+	{
+		LOG_INFO("Shaders of " << entry.name << ": no statistics");
+		return;
+	}
+	for (const Executable& executable : entry.executables)
+	{
+		{
+			logging::Line line(logging::Level::Info);
+			line.stream() << "Shaders of " << entry.name << ", " << executable.stages << " (" << executable.name << ")";
+			if (executable.subgroupSize > 0)
+			{
+				line.stream() << ", subgroups of " << executable.subgroupSize;
+			}
+			append_count(line, "registers", executable.registers);
+			append_count(line, "spills", executable.spills);
+			append_count(line, "instructions", executable.instructions);
+		}
+		if (executable.spills > 0)
+		{
+			LOG_WARN("The " << executable.stages << " shader of " << entry.name << " has " << executable.spills << " register spills");
+		}
+	}
+}
+
+void ShaderStatistics::query(Pipeline& entry) const
+{
+	entry.executables.clear();
+#ifdef VK_KHR_pipeline_executable_properties
+	const auto getProperties = reinterpret_cast<PFN_vkGetPipelineExecutablePropertiesKHR>(_getProperties);
+	const auto getStatistics = reinterpret_cast<PFN_vkGetPipelineExecutableStatisticsKHR>(_getStatistics);
+
+	VkPipelineInfoKHR pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INFO_KHR;
+	pipelineInfo.pipeline = entry.pipeline;
+	uint32_t executableCount = 0;
+	if (getProperties(_device, &pipelineInfo, &executableCount, nullptr) != VK_SUCCESS)
+	{
+		return;
+	}
+	std::vector<VkPipelineExecutablePropertiesKHR> properties(executableCount);
+	for (VkPipelineExecutablePropertiesKHR& executable : properties)
+	{
+		executable = {};
+		executable.sType = VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_PROPERTIES_KHR;
+	}
+	if (getProperties(_device, &pipelineInfo, &executableCount, properties.data()) < VK_SUCCESS)
+	{
+		return;
+	}
+	properties.resize(executableCount);
+
+	std::vector<VkPipelineExecutableStatisticKHR> statistics;
+	for (uint32_t i = 0; i < executableCount; i++)
+	{
+		Executable executable;
+		executable.stages = stage_names(properties[i].stages);
+		executable.name = properties[i].name;
+		executable.subgroupSize = properties[i].subgroupSize;
+
+		VkPipelineExecutableInfoKHR executableInfo = {};
+		executableInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_INFO_KHR;
+		executableInfo.pipeline = entry.pipeline;
+		executableInfo.executableIndex = i;
+		uint32_t statisticCount = 0;
+		if (getStatistics(_device, &executableInfo, &statisticCount, nullptr) == VK_SUCCESS)
+		{
+			statistics.resize(statisticCount);
+			for (VkPipelineExecutableStatisticKHR& statistic : statistics)
+			{
+				statistic = {};
+				statistic.sType = VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_STATISTIC_KHR;
+			}
+			if (getStatistics(_device, &executableInfo, &statisticCount, statistics.data()) < VK_SUCCESS)
+			{
+				statisticCount = 0;
+			}
+			statistics.resize(statisticCount);
+		}
+		else
+		{
+			statistics.clear();
+		}
+
+		// a driver naming vector registers apart from scalar ones gets those; any register count otherwise
+		int64_t anyRegisters = -1;
+		for (const VkPipelineExecutableStatisticKHR& statistic : statistics)
+		{
+			const std::string name = lowercase(statistic.name);
+			const int64_t value = statistic_value(statistic);
+			if (value < 0)
+			{
+				continue;
+			}
+			if (contains(name, "spill") || contains(name, "fill count"))
+			{
+				executable.spills = std::max<int64_t>(executable.spills, 0) + value;
+			}
+			else if (contains(name, "vgpr"))
+			{
+				executable.registers = value;
+			}
+			else if (contains(name, "register") || contains(name, "gpr"))
+			{
+				anyRegisters = std::max(anyRegisters, value);
+			}
+			else if (contains(name, "instruction") && executable.instructions < 0)
+			{
+				executable.instructions = value;
+			}
+		}
+		if (executable.registers < 0)
+		{
+			executable.registers = anyRegisters;
+		}
+		entry.executables.push_back(std::move(executable));
+	}
+#endif
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vk_types.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// What the driver says its compiles of the graphics pipelines came to, through
+// VK_KHR_pipeline_executable_properties: per executable (usually one per stage, sometimes several stages
+// merged into one) the registers it takes, what it spills and how many instructions it is. Registers bound
+// how many waves a shader core keeps in flight, so a shader edit that adds a few is an occupancy drop the
+// frame time shows only once it's the bottleneck. Pipelines must have been built with
+// VK_PIPELINE_CREATE_CAPTURE_STATISTICS_BIT_KHR (PipelineBuilder::_captureStatistics).
+// Drivers name their statistics as they like; registers are the vector registers where a driver reports
+// those apart from the scalar ones, spills are the sum of every spill and fill count, and whatever a driver
+// doesn't report stays -1.
+class ShaderStatistics
+{
+public:
+	struct Executable {
+		std::string stages; // "vertex", "fragment", "task+mesh"
+		std::string name; // the driver's
+		uint32_t subgroupSize{ 0 };
+		int64_t registers{ -1 };
+		int64_t spills{ -1 };
+		int64_t instructions{ -1 };
+	};
+
+	struct Pipeline {
+		VkPipeline pipeline{ VK_NULL_HANDLE };
+		const char* name{ nullptr };
+		std::vector<Executable> executables;
+	};
+
+	// the two entry points as vkGetDeviceProcAddr returned them; enabled() is false when either is missing
+	void init(VkDevice device, PFN_vkVoidFunction getProperties, PFN_vkVoidFunction getStatistics);
+	bool enabled() const { return _getProperties != nullptr && _getStatistics != nullptr; }
+
+	// queries pipeline once; a pipeline already captured keeps its first name
+	void capture(VkPipeline pipeline, const char* name);
+	// queries the pipeline replacing previous, under previous's name, and logs it; nothing if previous wasn't captured
+	void recapture(VkPipeline previous, VkPipeline pipeline);
+
+	// a line per executable, warning about every one that spills
+	void log() const;
+
+	const std::vector<Pipeline>& pipelines() const { return _pipelines; }
+
+private:
+	void query(Pipeline& entry) const;
+	static void log(const Pipeline& entry);
+
+	VkDevice _device{ VK_NULL_HANDLE };
+	PFN_vkVoidFunction _getProperties{ nullptr };
+	PFN_vkVoidFunction _getStatistics{ nullptr };
+	std::vector<Pipeline> _pipelines;
+};
@@ -0,0 +1,171 @@
+#include "ShadingRateImage.h"
+
+#include "vk_initializers.h"
+
+#include <cassert>
+
+namespace {
+	// matches the push constants of shadingRate.comp
+	struct RatePushConstants {
+		uint32_t size[2];
+		uint32_t texelSize[2];
+		float threshold;
+		float motion;
+		float motionThreshold;
+		uint32_t maxLevel;
+	};
+
+	uint32_t divide_rounded_up(uint32_t value, uint32_t divisor)
+	{
+		return (value + divisor - 1) / divisor;
+	}
+}
+
+void ShadingRateImage::init(VkDevice device, VmaAllocator allocator, DescriptorAllocator& descriptors, LayoutCache& layouts, VkShaderModule rateShader, VkPipelineCache cache,
+	VkExtent2D texelSize, uint32_t frameCount)
+{
+	_device = device;
+	_allocator = allocator;
+	_texelSize = texelSize;
+
+	VkDescriptorSetLayoutBinding bindings[] = {
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0), // scene color
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1), // rates
+	};
+
+	VkDescriptorSetLayoutCreateInfo setInfo = {};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setInfo.pNext = nullptr;
+	setInfo.bindingCount = 2;
+	setInfo.pBindings = bindings;
+	VK_CHECK(vkCreateDescriptorSetLayout(_device, &setInfo, nullptr, &_setLayout));
+
+	_sets.resize(frameCount);
+	for (VkDescriptorSet& set : _sets)
+	{
+		descriptors.allocate(&set, _setLayout);
+	}
+
+	VkPushConstantRange pushConstant;
+	pushConstant.offset = 0;
+	pushConstant.size = sizeof(RatePushConstants);
+	pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkPipelineLayoutCreateInfo layoutInfo = vkinit::pipeline_layout_create_info();
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &_setLayout;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushConstant;
+	VK_CHECK(vkCreatePipelineLayout(_device, &layoutInfo, nullptr, &_pipelineLayout));
+
+	if (rateShader != VK_NULL_HANDLE)
+	{
+		VkComputePipelineCreateInfo pipelineInfo = {};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.pNext = nullptr;
+		pipelineInfo.layout = _pipelineLayout;
+		pipelineInfo.stage = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, rateShader);
+		VK_CHECK(vkCreateComputePipelines(_device, cache, 1, &pipelineInfo, nullptr, &_pipeline));
+	}
+
+	// the shader only texelFetches
+	VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	_sampler = layouts.sampler(samplerInfo);
+}
+
+void ShadingRateImage::cleanup()
+{
+	destroy_image();
+	// the sets go with the descriptor allocator's pools, the sampler with the layout cache
+	vkDestroyPipeline(_device, _pipeline, nullptr);
+	vkDestroyPipelineLayout(_device, _pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(_device, _setLayout, nullptr);
+}
+
+void ShadingRateImage::resize(VkExtent2D framebufferExtent)
+{
+	destroy_image();
+
+	// a partial tile at the right or bottom edge still gets its texel
+	_extent = { divide_rounded_up(framebufferExtent.width, _texelSize.width), divide_rounded_up(framebufferExtent.height, _texelSize.height) };
+	VkImageUsageFlags usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+#ifdef VK_KHR_fragment_shading_rate
+	usage |= VK_IMAGE_USAGE_FRAGMENT_SHADING_RATE_ATTACHMENT_BIT_KHR;
+#endif
+	VkImageCreateInfo imageInfo = vkinit::image_create_info(FORMAT, usage, { _extent.width, _extent.height, 1 });
+
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+	allocInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	VK_CHECK(vmaCreateImage(_allocator, &imageInfo, &allocInfo, &_image._image, &_image._allocation, nullptr));
+
+	VkImageViewCreateInfo viewInfo = vkinit::imageview_create_info(FORMAT, _image._image, VK_IMAGE_ASPECT_COLOR_BIT);
+	VK_CHECK(vkCreateImageView(_device, &viewInfo, nullptr, &_view));
+}
+
+void ShadingRateImage::clear(VkCommandBuffer cmd) const
+{
+	VkImageMemoryBarrier toTransfer = vkinit::image_barrier(_image._image, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+	// 0 is 1x1
+	VkClearColorValue fullRate = {};
+	VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	vkCmdClearColorImage(cmd, _image._image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &fullRate, 1, &range);
+
+	VkPipelineStageFlags dstStages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	VkAccessFlags dstAccess = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+#ifdef VK_KHR_fragment_shading_rate
+	dstStages |= VK_PIPELINE_STAGE_FRAGMENT_SHADING_RATE_ATTACHMENT_BIT_KHR;
+	dstAccess |= VK_ACCESS_FRAGMENT_SHADING_RATE_ATTACHMENT_READ_BIT_KHR;
+#endif
+	VkImageMemoryBarrier toGeneral = vkinit::image_barrier(_image._image, VK_ACCESS_TRANSFER_WRITE_BIT, dstAccess,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStages, 0, 0, nullptr, 0, nullptr, 1, &toGeneral);
+}
+
+void ShadingRateImage::record(VkCommandBuffer cmd, uint32_t frame, VkImageView scene, VkExtent2D region, float motion) const
+{
+	assert(_pipeline != VK_NULL_HANDLE);
+
+	VkDescriptorSet set = _sets[frame];
+	VkDescriptorImageInfo sceneInfo = { _sampler, scene, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	VkDescriptorImageInfo rateInfo = { VK_NULL_HANDLE, _view, VK_IMAGE_LAYOUT_GENERAL };
+	VkWriteDescriptorSet writes[] = {
+		vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, set, &sceneInfo, 0),
+		vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, set, &rateInfo, 1),
+	};
+	vkUpdateDescriptorSets(_device, 2, writes, 0, nullptr);
+
+	RatePushConstants constants = {};
+	constants.size[0] = region.width;
+	constants.size[1] = region.height;
+	constants.texelSize[0] = _texelSize.width;
+	constants.texelSize[1] = _texelSize.height;
+	constants.threshold = _threshold;
+	constants.motion = motion;
+	constants.motionThreshold = _motionThreshold;
+	constants.maxLevel = _maxLevel;
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout, 0, 1, &set, 0, nullptr);
+	vkCmdPushConstants(cmd, _pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(RatePushConstants), &constants);
+	// a workgroup per texel of the region; the ones outside it keep their rates, and nothing renders there
+	vkCmdDispatch(cmd, divide_rounded_up(region.width, _texelSize.width), divide_rounded_up(region.height, _texelSize.height), 1);
+}
+
+void ShadingRateImage::destroy_image()
+{
+	if (_image._image == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	vkDestroyImageView(_device, _view, nullptr);
+	vmaDestroyImage(_allocator, _image._image, _image._allocation);
+	_image = {};
+	_view = VK_NULL_HANDLE;
+	_extent = { 0, 0 };
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vk_types.h>
+#include <DescriptorAllocator.h>
+#include <LayoutCache.h>
+
+#include <vector>
+
+// The fragment shading rate attachment of VK_KHR_fragment_shading_rate, made from the scene color. Each
+// texel of the R8_UINT image covers texelSize pixels and holds the rate its tile shades at, log2 of the
+// width in bits 2-3 and of the height in bits 0-1. Tiles whose luminance is flat for their brightness (the
+// sky, a smoothly lit floor) get 2x2 or 4x4, anything with edges or texture detail keeps 1x1, and camera
+// rotation coarsens every tile one more step, since the frame smears across the screen anyway.
+// record() writes the rates from one frame's scene for the next frame's passes, so they lag by a frame,
+// which only shows where something just moved into view, and the image persists across frames.
+// Rates the device can't shade at are clamped by the implementation to one it can.
+class ShadingRateImage
+{
+public:
+	static constexpr VkFormat FORMAT = VK_FORMAT_R8_UINT;
+
+	// without a shader there is no pipeline and record() must not be called
+	void init(VkDevice device, VmaAllocator allocator, DescriptorAllocator& descriptors, LayoutCache& layouts, VkShaderModule rateShader, VkPipelineCache cache,
+		VkExtent2D texelSize, uint32_t frameCount);
+	void cleanup();
+
+	bool ready() const { return _pipeline != VK_NULL_HANDLE; }
+
+	// (re)creates the image for a framebuffer of this size; nothing may be using the old one. Its contents
+	// are undefined until clear()
+	void resize(VkExtent2D framebufferExtent);
+	// every tile to 1x1, leaving the image in GENERAL with the writes visible to compute and to rasterization
+	void clear(VkCommandBuffer cmd) const;
+
+	// inside a compute pass: the rates of the top-left region of scene, which is in SHADER_READ_ONLY_OPTIMAL,
+	// into the image, which is in GENERAL. Rewrites the set of the frame slot it is given. motion is how far
+	// the camera turned since the last frame, in pixels
+	void record(VkCommandBuffer cmd, uint32_t frame, VkImageView scene, VkExtent2D region, float motion) const;
+
+	float _threshold{ 0.1f }; // relative luminance contrast below which tiles go 2x2, 4x4 below half of it
+	float _motionThreshold{ 24.0f }; // pixels of camera motion a frame beyond which every tile goes coarser
+	uint32_t _maxLevel{ 2 }; // 4x4 at the coarsest
+
+	VkImage image() const { return _image._image; }
+	VkImageView view() const { return _view; }
+	VkExtent2D extent() const { return _extent; }
+	VkExtent2D texel_size() const { return _texelSize; }
+
+private:
+	void destroy_image();
+
+	VkDevice _device{ VK_NULL_HANDLE };
+	VmaAllocator _allocator{ nullptr };
+	VkExtent2D _texelSize{ 16, 16 };
+
+	VkDescriptorSetLayout _setLayout{ VK_NULL_HANDLE };
+	VkPipelineLayout _pipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline _pipeline{ VK_NULL_HANDLE };
+	VkSampler _sampler{ VK_NULL_HANDLE };
+	std::vector<VkDescriptorSet> _sets; // per frame slot
+
+	AllocatedImage _image{};
+	VkImageView _view{ VK_NULL_HANDLE };
+	VkExtent2D _extent{ 0, 0 };
+};
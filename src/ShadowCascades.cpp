@@ -0,0 +1,283 @@
+#include "ShadowCascades.h"
+
+#include "vk_initializers.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+
+namespace {
+	// mix of logarithmic and uniform split distances; more logarithmic keeps near cascades sharper
+	constexpr float SPLIT_LAMBDA = 0.75f;
+	// cascades move in steps of this fraction of their radius, so the cache survives small camera moves
+	constexpr float GRID_FRACTION = 0.125f;
+	// casters this far beyond a cascade's sphere, towards the light, still land in it
+	constexpr float CASTER_DISTANCE = 50.f;
+
+	VkRenderPass create_depth_pass(VkDevice device, VkFormat format, VkAttachmentLoadOp loadOp)
+	{
+		// layouts are handled by record()'s barriers, so the pass stays in the attachment layout
+		VkAttachmentDescription depthAttachment = {};
+		depthAttachment.format = format;
+		depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		depthAttachment.loadOp = loadOp;
+		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference depthRef = {};
+		depthRef.attachment = 0;
+		depthRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 0;
+		subpass.pDepthStencilAttachment = &depthRef;
+
+		VkRenderPassCreateInfo passInfo = {};
+		passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		passInfo.attachmentCount = 1;
+		passInfo.pAttachments = &depthAttachment;
+		passInfo.subpassCount = 1;
+		passInfo.pSubpasses = &subpass;
+
+		VkRenderPass pass;
+		VK_CHECK(vkCreateRenderPass(device, &passInfo, nullptr, &pass));
+		return pass;
+	}
+
+	VkImageMemoryBarrier layers_barrier(VkImage image, VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkImageLayout oldLayout, VkImageLayout newLayout)
+	{
+		VkImageMemoryBarrier barrier = vkinit::image_barrier(image, srcAccess, dstAccess, oldLayout, newLayout, VK_IMAGE_ASPECT_DEPTH_BIT);
+		barrier.subresourceRange.layerCount = ShadowCascades::CASCADE_COUNT;
+		return barrier;
+	}
+}
+
+void ShadowCascades::init(VkDevice device, VmaAllocator allocator, VkFormat format, uint32_t resolution, bool linearFilter)
+{
+	_device = device;
+	_allocator = allocator;
+	_format = format;
+	_resolution = resolution;
+
+	_staticPass = create_depth_pass(_device, _format, VK_ATTACHMENT_LOAD_OP_CLEAR);
+	_dynamicPass = create_depth_pass(_device, _format, VK_ATTACHMENT_LOAD_OP_LOAD);
+
+	VkExtent3D extent = { resolution, resolution, 1 };
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+	allocInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	VkImageCreateInfo cacheInfo = vkinit::image_create_info(_format, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, extent);
+	cacheInfo.arrayLayers = CASCADE_COUNT;
+	VK_CHECK(vmaCreateImage(_allocator, &cacheInfo, &allocInfo, &_cacheImage._image, &_cacheImage._allocation, nullptr));
+
+	VkImageCreateInfo mapInfo = vkinit::image_create_info(_format,
+		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, extent);
+	mapInfo.arrayLayers = CASCADE_COUNT;
+	VK_CHECK(vmaCreateImage(_allocator, &mapInfo, &allocInfo, &_mapImage._image, &_mapImage._allocation, nullptr));
+
+	VkImageViewCreateInfo viewInfo = vkinit::imageview_create_info(_format, _mapImage._image, VK_IMAGE_ASPECT_DEPTH_BIT);
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+	viewInfo.subresourceRange.layerCount = CASCADE_COUNT;
+	VK_CHECK(vkCreateImageView(_device, &viewInfo, nullptr, &_mapView));
+
+	VkFramebufferCreateInfo framebufferInfo = {};
+	framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	framebufferInfo.pNext = nullptr;
+	framebufferInfo.attachmentCount = 1;
+	framebufferInfo.width = resolution;
+	framebufferInfo.height = resolution;
+	framebufferInfo.layers = 1;
+
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.subresourceRange.layerCount = 1;
+	for (uint32_t i = 0; i < CASCADE_COUNT; i++)
+	{
+		viewInfo.subresourceRange.baseArrayLayer = i;
+
+		viewInfo.image = _cacheImage._image;
+		VK_CHECK(vkCreateImageView(_device, &viewInfo, nullptr, &_cacheLayerViews[i]));
+		framebufferInfo.renderPass = _staticPass;
+		framebufferInfo.pAttachments = &_cacheLayerViews[i];
+		VK_CHECK(vkCreateFramebuffer(_device, &framebufferInfo, nullptr, &_cacheFramebuffers[i]));
+
+		viewInfo.image = _mapImage._image;
+		VK_CHECK(vkCreateImageView(_device, &viewInfo, nullptr, &_mapLayerViews[i]));
+		framebufferInfo.renderPass = _dynamicPass;
+		framebufferInfo.pAttachments = &_mapLayerViews[i];
+		VK_CHECK(vkCreateFramebuffer(_device, &framebufferInfo, nullptr, &_mapFramebuffers[i]));
+	}
+
+	// outside the cascade counts as lit: the white border compares as farther than anything
+	const VkFilter filter = linearFilter ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+	VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(filter, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER);
+	samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+	samplerInfo.compareEnable = VK_TRUE;
+	samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	VK_CHECK(vkCreateSampler(_device, &samplerInfo, nullptr, &_sampler));
+
+	_staticValid = 0;
+}
+
+void ShadowCascades::cleanup()
+{
+	for (uint32_t i = 0; i < CASCADE_COUNT; i++)
+	{
+		vkDestroyFramebuffer(_device, _cacheFramebuffers[i], nullptr);
+		vkDestroyFramebuffer(_device, _mapFramebuffers[i], nullptr);
+		vkDestroyImageView(_device, _cacheLayerViews[i], nullptr);
+		vkDestroyImageView(_device, _mapLayerViews[i], nullptr);
+	}
+	vkDestroyImageView(_device, _mapView, nullptr);
+	vkDestroySampler(_device, _sampler, nullptr);
+	vmaDestroyImage(_allocator, _cacheImage._image, _cacheImage._allocation);
+	vmaDestroyImage(_allocator, _mapImage._image, _mapImage._allocation);
+	vkDestroyRenderPass(_device, _staticPass, nullptr);
+	vkDestroyRenderPass(_device, _dynamicPass, nullptr);
+}
+
+void ShadowCascades::update(const glm::mat4& view, float fovY, float aspect, float nearPlane, float shadowDistance, const glm::vec3& lightDirection)
+{
+	const glm::mat4 cameraToWorld = glm::inverse(view);
+	const float tanY = std::tan(fovY * 0.5f);
+	const float tanX = tanY * aspect;
+	// squared distance of a slice corner from the view axis, per unit of depth squared
+	const float cornerSlope = tanX * tanX + tanY * tanY;
+
+	// the light's rotation only; cascades pick their own origin on the grid
+	const glm::vec3 up = std::abs(lightDirection.y) > 0.99f ? glm::vec3(0.f, 0.f, 1.f) : glm::vec3(0.f, 1.f, 0.f);
+	const glm::mat4 lightView = glm::lookAt(glm::vec3(0.f), lightDirection, up);
+
+	float sliceNear = nearPlane;
+	for (uint32_t i = 0; i < CASCADE_COUNT; i++)
+	{
+		const float t = static_cast<float>(i + 1) / CASCADE_COUNT;
+		const float logSplit = nearPlane * std::pow(shadowDistance / nearPlane, t);
+		const float uniformSplit = nearPlane + (shadowDistance - nearPlane) * t;
+		const float sliceFar = SPLIT_LAMBDA * logSplit + (1.f - SPLIT_LAMBDA) * uniformSplit;
+		_splits[i] = sliceFar;
+
+		// smallest sphere around the slice's corners with its center on the view axis; it depends only
+		// on the projection, so turning the camera doesn't resize the cascade
+		float centerDepth = 0.5f * (sliceNear + sliceFar) * (1.f + cornerSlope);
+		centerDepth = std::min(centerDepth, sliceFar);
+		const float radius = std::sqrt(std::max((sliceFar - centerDepth) * (sliceFar - centerDepth) + sliceFar * sliceFar * cornerSlope,
+			(centerDepth - sliceNear) * (centerDepth - sliceNear) + sliceNear * sliceNear * cornerSlope));
+
+		// the grid step is a whole number of texels, so a step moves every texel onto another one exactly
+		const float halfExtent = radius * (1.f + 2.f * GRID_FRACTION);
+		const float texel = 2.f * halfExtent / _resolution;
+		const float step = std::max(texel, texel * std::round(radius * GRID_FRACTION / texel));
+
+		glm::vec3 center = glm::vec3(lightView * cameraToWorld * glm::vec4(0.f, 0.f, -centerDepth, 1.f));
+		center = glm::round(center / step) * step;
+
+		// light space looks down -z; the depth range reaches back towards the light for casters outside the sphere
+		const glm::mat4 projection = glm::orthoRH_ZO(center.x - halfExtent, center.x + halfExtent, center.y - halfExtent, center.y + halfExtent,
+			-(center.z + halfExtent + CASTER_DISTANCE), -(center.z - halfExtent));
+		const glm::mat4 viewProjection = projection * lightView;
+
+		if (viewProjection != _viewProjection[i])
+		{
+			_viewProjection[i] = viewProjection;
+			_staticValid &= ~(1u << i);
+		}
+		sliceNear = sliceFar;
+	}
+}
+
+void ShadowCascades::clear(VkCommandBuffer cmd)
+{
+	VkImageMemoryBarrier toTransfer = layers_barrier(_mapImage._image, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+	VkClearDepthStencilValue far = { 1.0f, 0 };
+	VkImageSubresourceRange range = toTransfer.subresourceRange;
+	vkCmdClearDepthStencilImage(cmd, _mapImage._image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &far, 1, &range);
+
+	VkImageMemoryBarrier toSampled = layers_barrier(_mapImage._image, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toSampled);
+}
+
+void ShadowCascades::record(VkCommandBuffer cmd, const DrawCasters& draw)
+{
+	VkViewport viewport = { 0.f, 0.f, static_cast<float>(_resolution), static_cast<float>(_resolution), 0.f, 1.f };
+	VkRect2D scissor = { { 0, 0 }, { _resolution, _resolution } };
+	VkClearValue depthClear;
+	depthClear.depthStencil.depth = 1.0f;
+
+	const uint32_t stale = stale_mask();
+	for (uint32_t i = 0; i < CASCADE_COUNT; i++)
+	{
+		if ((stale & (1u << i)) == 0)
+		{
+			continue;
+		}
+
+		// last frame's copy may still be reading the cache; it's redrawn from scratch
+		VkImageMemoryBarrier toAttachment = vkinit::image_barrier(_cacheImage._image, 0, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT);
+		toAttachment.subresourceRange.baseArrayLayer = i;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &toAttachment);
+
+		VkRenderPassBeginInfo passInfo = vkinit::renderpass_begin_info(_staticPass, { _resolution, _resolution }, _cacheFramebuffers[i]);
+		passInfo.clearValueCount = 1;
+		passInfo.pClearValues = &depthClear;
+		vkCmdBeginRenderPass(cmd, &passInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdSetViewport(cmd, 0, 1, &viewport);
+		vkCmdSetScissor(cmd, 0, 1, &scissor);
+		draw(cmd, i, true);
+		vkCmdEndRenderPass(cmd);
+
+		VkImageMemoryBarrier toCopy = vkinit::image_barrier(_cacheImage._image, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT);
+		toCopy.subresourceRange.baseArrayLayer = i;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toCopy);
+		}
+	}
+	_staticValid |= stale;
+
+	// last frame's fragment shaders may still be sampling the map; all of it is overwritten
+	VkImageMemoryBarrier toTransfer = layers_barrier(_mapImage._image, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+	VkImageCopy copy = {};
+	copy.srcSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, CASCADE_COUNT };
+	copy.dstSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, CASCADE_COUNT };
+	copy.extent = { _resolution, _resolution, 1 };
+	vkCmdCopyImage(cmd, _cacheImage._image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, _mapImage._image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+
+	VkImageMemoryBarrier toDynamic = layers_barrier(_mapImage._image, VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+		0, 0, nullptr, 0, nullptr, 1, &toDynamic);
+
+	for (uint32_t i = 0; i < CASCADE_COUNT; i++)
+	{
+		VkRenderPassBeginInfo passInfo = vkinit::renderpass_begin_info(_dynamicPass, { _resolution, _resolution }, _mapFramebuffers[i]);
+		passInfo.clearValueCount = 0;
+		vkCmdBeginRenderPass(cmd, &passInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdSetViewport(cmd, 0, 1, &viewport);
+		vkCmdSetScissor(cmd, 0, 1, &scissor);
+		draw(cmd, i, false);
+		vkCmdEndRenderPass(cmd);
+	}
+
+	VkImageMemoryBarrier toSampled = layers_barrier(_mapImage._image, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+		VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toSampled);
+}
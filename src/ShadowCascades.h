@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vk_types.h>
+#include <functional>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+// Cascaded shadow map for one directional light, with the static casters cached per cascade.
+// Every cascade has two depth layers: the cache holds only what never moves and is re-rendered when
+// its cascade's light matrix changes or invalidate_static() is called; the shadow map the shaders
+// sample starts each frame as a copy of the cache, with the dynamic casters drawn on top.
+// Cascades are fitted to a bounding sphere of their slice of the view frustum, whose size doesn't
+// change as the camera turns, and placed on a light-space grid, so a moving camera only re-renders
+// a cascade's static casters once it has crossed a grid cell.
+class ShadowCascades
+{
+public:
+	static constexpr uint32_t CASCADE_COUNT = 4;
+
+	// casters for one pass: the cascade being drawn, and whether this is its static cache
+	using DrawCasters = std::function<void(VkCommandBuffer cmd, uint32_t cascade, bool staticCasters)>;
+
+	// format must allow depth attachment and sampled use; resolution is the size of every layer.
+	// linearFilter enables 2x2 hardware PCF, which needs SAMPLED_IMAGE_FILTER_LINEAR on format
+	void init(VkDevice device, VmaAllocator allocator, VkFormat format, uint32_t resolution, bool linearFilter);
+	void cleanup();
+
+	// fits the cascades to a camera looking down -z of view with a symmetric perspective projection,
+	// up to shadowDistance; lightDirection is the direction the light travels. Marks the static
+	// layers of cascades that moved as stale
+	void update(const glm::mat4& view, float fovY, float aspect, float nearPlane, float shadowDistance, const glm::vec3& lightDirection);
+	// the static casters changed; every cache is re-rendered on the next record()
+	void invalidate_static() { _staticValid = 0; }
+
+	// outside a render pass: re-renders the stale caches, copies them into the shadow map and draws
+	// the dynamic casters over it. Leaves the map in SHADER_READ_ONLY_OPTIMAL for fragment shaders.
+	// draw is called inside each pass with viewport and scissor set
+	void record(VkCommandBuffer cmd, const DrawCasters& draw);
+
+	// outside a render pass: fills the shadow map with the far plane, so everything samples as lit, and
+	// leaves it in SHADER_READ_ONLY_OPTIMAL; descriptors may point at it before the first record()
+	void clear(VkCommandBuffer cmd);
+
+	// depth-only passes the caster pipelines are built for; both passes are compatible
+	VkRenderPass render_pass() const { return _staticPass; }
+	// every cascade as one array layer; sample with a comparison (sampler2DArrayShadow)
+	VkImageView view() const { return _mapView; }
+	VkSampler sampler() const { return _sampler; }
+
+	// valid after update()
+	const glm::mat4& view_projection(uint32_t cascade) const { return _viewProjection[cascade]; }
+	// view-space distance where each cascade ends
+	glm::vec4 split_distances() const { return _splits; }
+	// cascades whose static layer record() will re-render, one bit each
+	uint32_t stale_mask() const { return ~_staticValid & ((1u << CASCADE_COUNT) - 1); }
+
+private:
+	VkDevice _device{ VK_NULL_HANDLE };
+	VmaAllocator _allocator{ nullptr };
+	VkFormat _format{ VK_FORMAT_UNDEFINED };
+	uint32_t _resolution{ 0 };
+
+	// CLEAR for the caches, LOAD for drawing over the copy in the shadow map
+	VkRenderPass _staticPass{ VK_NULL_HANDLE };
+	VkRenderPass _dynamicPass{ VK_NULL_HANDLE };
+
+	AllocatedImage _cacheImage{};
+	AllocatedImage _mapImage{};
+	VkImageView _cacheLayerViews[CASCADE_COUNT]{};
+	VkImageView _mapLayerViews[CASCADE_COUNT]{};
+	VkImageView _mapView{ VK_NULL_HANDLE };
+	VkFramebuffer _cacheFramebuffers[CASCADE_COUNT]{};
+	VkFramebuffer _mapFramebuffers[CASCADE_COUNT]{};
+	VkSampler _sampler{ VK_NULL_HANDLE };
+
+	glm::mat4 _viewProjection[CASCADE_COUNT]{};
+	glm::vec4 _splits{ 0.f };
+	// one bit per cascade whose cache matches _viewProjection
+	uint32_t _staticValid{ 0 };
+};
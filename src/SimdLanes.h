@@ -0,0 +1,178 @@
+#pragma once
+
+#include <cstddef>
+#include <glm/mat4x4.hpp>
+
+// Four floats at a time over SSE2 or NEON, scalar elsewhere, for kernels that work on structure-of-arrays
+// data four items per iteration: TransformStore's local matrices, AnimationSampler's joint blends, the
+// normals imported meshes are missing, SphereCuller's frustum tests and SoftwareOcclusion's rasterizer
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIMD_LANES_SSE 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define SIMD_LANES_NEON 1
+#endif
+
+// items per kernel iteration; every platform path works on four lanes
+constexpr size_t SIMD_WIDTH = 4;
+
+#if SIMD_LANES_SSE
+using Lanes = __m128;
+
+inline Lanes lanes_load(const float* p) { return _mm_loadu_ps(p); }
+inline void lanes_store(float* p, Lanes a) { _mm_storeu_ps(p, a); }
+inline Lanes lanes_splat(float v) { return _mm_set1_ps(v); }
+inline Lanes lanes_add(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+inline Lanes lanes_sub(Lanes a, Lanes b) { return _mm_sub_ps(a, b); }
+inline Lanes lanes_mul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+inline Lanes lanes_max(Lanes a, Lanes b) { return _mm_max_ps(a, b); }
+// a with the sign of each lane flipped where s is negative
+inline Lanes lanes_flip_sign(Lanes a, Lanes s) { return _mm_xor_ps(a, _mm_and_ps(s, _mm_set1_ps(-0.0f))); }
+// comparisons give every lane all ones where they hold and zero elsewhere, which lanes_and combines and
+// lanes_mask turns into bit i per lane i
+inline Lanes lanes_ge(Lanes a, Lanes b) { return _mm_cmpge_ps(a, b); }
+inline Lanes lanes_and(Lanes a, Lanes b) { return _mm_and_ps(a, b); }
+inline int lanes_mask(Lanes m) { return _mm_movemask_ps(m); }
+// 1 / sqrt(a): the estimate refined by one Newton step, to about 22 bits
+inline Lanes lanes_rsqrt(Lanes a)
+{
+	const Lanes e = _mm_rsqrt_ps(a);
+	return _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), e), _mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(_mm_mul_ps(a, e), e)));
+}
+
+// x, y, z, w hold one column of four matrices; transposed into column `column` of each
+inline void store_column(glm::mat4* out, int column, Lanes x, Lanes y, Lanes z, Lanes w)
+{
+	_MM_TRANSPOSE4_PS(x, y, z, w);
+	_mm_storeu_ps(&out[0][column][0], x);
+	_mm_storeu_ps(&out[1][column][0], y);
+	_mm_storeu_ps(&out[2][column][0], z);
+	_mm_storeu_ps(&out[3][column][0], w);
+}
+#elif SIMD_LANES_NEON
+using Lanes = float32x4_t;
+
+inline Lanes lanes_load(const float* p) { return vld1q_f32(p); }
+inline void lanes_store(float* p, Lanes a) { vst1q_f32(p, a); }
+inline Lanes lanes_splat(float v) { return vdupq_n_f32(v); }
+inline Lanes lanes_add(Lanes a, Lanes b) { return vaddq_f32(a, b); }
+inline Lanes lanes_sub(Lanes a, Lanes b) { return vsubq_f32(a, b); }
+inline Lanes lanes_mul(Lanes a, Lanes b) { return vmulq_f32(a, b); }
+inline Lanes lanes_max(Lanes a, Lanes b) { return vmaxq_f32(a, b); }
+inline Lanes lanes_flip_sign(Lanes a, Lanes s)
+{
+	const uint32x4_t sign = vandq_u32(vreinterpretq_u32_f32(s), vdupq_n_u32(0x80000000u));
+	return vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(a), sign));
+}
+inline Lanes lanes_ge(Lanes a, Lanes b) { return vreinterpretq_f32_u32(vcgeq_f32(a, b)); }
+inline Lanes lanes_and(Lanes a, Lanes b) { return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b))); }
+inline int lanes_mask(Lanes m)
+{
+	const uint32x4_t bits = vshrq_n_u32(vreinterpretq_u32_f32(m), 31);
+	return int(vgetq_lane_u32(bits, 0) | vgetq_lane_u32(bits, 1) << 1 | vgetq_lane_u32(bits, 2) << 2 | vgetq_lane_u32(bits, 3) << 3);
+}
+// the estimate is only good to 8 bits on its own; two steps bring it to about 23
+inline Lanes lanes_rsqrt(Lanes a)
+{
+	Lanes e = vrsqrteq_f32(a);
+	e = vmulq_f32(e, vrsqrtsq_f32(vmulq_f32(a, e), e));
+	return vmulq_f32(e, vrsqrtsq_f32(vmulq_f32(a, e), e));
+}
+
+inline void store_column(glm::mat4* out, int column, Lanes x, Lanes y, Lanes z, Lanes w)
+{
+	float32x4x2_t xy = vtrnq_f32(x, y);
+	float32x4x2_t zw = vtrnq_f32(z, w);
+	vst1q_f32(&out[0][column][0], vcombine_f32(vget_low_f32(xy.val[0]), vget_low_f32(zw.val[0])));
+	vst1q_f32(&out[1][column][0], vcombine_f32(vget_low_f32(xy.val[1]), vget_low_f32(zw.val[1])));
+	vst1q_f32(&out[2][column][0], vcombine_f32(vget_high_f32(xy.val[0]), vget_high_f32(zw.val[0])));
+	vst1q_f32(&out[3][column][0], vcombine_f32(vget_high_f32(xy.val[1]), vget_high_f32(zw.val[1])));
+}
+#else
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+struct Lanes {
+	float v[SIMD_WIDTH];
+};
+
+inline Lanes lanes_load(const float* p) { return { { p[0], p[1], p[2], p[3] } }; }
+inline void lanes_store(float* p, Lanes a) { for (size_t i = 0; i < SIMD_WIDTH; i++) p[i] = a.v[i]; }
+inline Lanes lanes_splat(float v) { return { { v, v, v, v } }; }
+inline Lanes lanes_add(Lanes a, Lanes b) { for (size_t i = 0; i < SIMD_WIDTH; i++) a.v[i] += b.v[i]; return a; }
+inline Lanes lanes_sub(Lanes a, Lanes b) { for (size_t i = 0; i < SIMD_WIDTH; i++) a.v[i] -= b.v[i]; return a; }
+inline Lanes lanes_mul(Lanes a, Lanes b) { for (size_t i = 0; i < SIMD_WIDTH; i++) a.v[i] *= b.v[i]; return a; }
+inline Lanes lanes_max(Lanes a, Lanes b) { for (size_t i = 0; i < SIMD_WIDTH; i++) a.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]; return a; }
+inline Lanes lanes_flip_sign(Lanes a, Lanes s) { for (size_t i = 0; i < SIMD_WIDTH; i++) a.v[i] = std::signbit(s.v[i]) ? -a.v[i] : a.v[i]; return a; }
+// masks keep the all-ones pattern in the float bits, as the vector paths do
+inline Lanes lanes_ge(Lanes a, Lanes b)
+{
+	const uint32_t ones = UINT32_MAX;
+	for (size_t i = 0; i < SIMD_WIDTH; i++)
+	{
+		if (a.v[i] >= b.v[i]) memcpy(&a.v[i], &ones, sizeof(ones));
+		else a.v[i] = 0.0f;
+	}
+	return a;
+}
+inline Lanes lanes_and(Lanes a, Lanes b)
+{
+	for (size_t i = 0; i < SIMD_WIDTH; i++)
+	{
+		uint32_t x, y;
+		memcpy(&x, &a.v[i], sizeof(x));
+		memcpy(&y, &b.v[i], sizeof(y));
+		x &= y;
+		memcpy(&a.v[i], &x, sizeof(x));
+	}
+	return a;
+}
+inline int lanes_mask(Lanes m)
+{
+	int mask = 0;
+	for (size_t i = 0; i < SIMD_WIDTH; i++) mask |= (std::signbit(m.v[i]) ? 1 : 0) << i;
+	return mask;
+}
+inline Lanes lanes_rsqrt(Lanes a) { for (size_t i = 0; i < SIMD_WIDTH; i++) a.v[i] = 1.0f / std::sqrt(a.v[i]); return a; }
+
+inline void store_column(glm::mat4* out, int column, Lanes x, Lanes y, Lanes z, Lanes w)
+{
+	for (size_t i = 0; i < SIMD_WIDTH; i++)
+	{
+		out[i][column] = glm::vec4(x.v[i], y.v[i], z.v[i], w.v[i]);
+	}
+}
+#endif
+
+// four T * R * S matrices into out[0..3] from positions, unit quaternions and per-axis scales;
+// column-major like glm::mat3_cast, each rotation column scaled by its axis
+inline void store_trs(glm::mat4* out, Lanes px, Lanes py, Lanes pz, Lanes x, Lanes y, Lanes z, Lanes w, Lanes sx, Lanes sy, Lanes sz)
+{
+	const Lanes one = lanes_splat(1.0f);
+	const Lanes two = lanes_splat(2.0f);
+	const Lanes zero = lanes_splat(0.0f);
+
+	const Lanes xx = lanes_mul(x, x), yy = lanes_mul(y, y), zz = lanes_mul(z, z);
+	const Lanes xy = lanes_mul(x, y), xz = lanes_mul(x, z), yz = lanes_mul(y, z);
+	const Lanes wx = lanes_mul(w, x), wy = lanes_mul(w, y), wz = lanes_mul(w, z);
+
+	store_column(out, 0,
+		lanes_mul(lanes_sub(one, lanes_mul(two, lanes_add(yy, zz))), sx),
+		lanes_mul(lanes_mul(two, lanes_add(xy, wz)), sx),
+		lanes_mul(lanes_mul(two, lanes_sub(xz, wy)), sx),
+		zero);
+	store_column(out, 1,
+		lanes_mul(lanes_mul(two, lanes_sub(xy, wz)), sy),
+		lanes_mul(lanes_sub(one, lanes_mul(two, lanes_add(xx, zz))), sy),
+		lanes_mul(lanes_mul(two, lanes_add(yz, wx)), sy),
+		zero);
+	store_column(out, 2,
+		lanes_mul(lanes_mul(two, lanes_add(xz, wy)), sz),
+		lanes_mul(lanes_mul(two, lanes_sub(yz, wx)), sz),
+		lanes_mul(lanes_sub(one, lanes_mul(two, lanes_add(xx, yy))), sz),
+		zero);
+	store_column(out, 3, px, py, pz, one);
+}
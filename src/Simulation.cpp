@@ -0,0 +1,85 @@
+#include "Simulation.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	// rates the animations used to have per frame at 60 fps
+	constexpr double MODEL_DEGREES_PER_SECOND = 24.0;
+	constexpr double ORBIT_DEGREES_PER_SECOND = 36.0;
+	constexpr double FLASH_RADIANS_PER_SECOND = 0.5;
+
+	// after a stall (breakpoint, window drag) simulated time falls behind instead of catching up in one burst
+	constexpr int MAX_STEPS_PER_ADVANCE = 8;
+
+	float wrap_degrees(double degrees)
+	{
+		return static_cast<float>(std::fmod(degrees, 360.0));
+	}
+
+	// blends across the 360 -> 0 wrap the short way round
+	float lerp_degrees(float from, float to, float t)
+	{
+		float delta = to - from;
+		if (delta > 180.0f) delta -= 360.0f;
+		if (delta < -180.0f) delta += 360.0f;
+		return from + delta * t;
+	}
+}
+
+void Simulation::init(double stepSeconds)
+{
+	_stepSeconds = stepSeconds;
+	_accumulator = 0.0;
+	_previous = SimulationState{};
+	_current = SimulationState{};
+	_snapshot = SimulationState{};
+}
+
+void Simulation::advance(double elapsedSeconds)
+{
+	_accumulator += std::max(elapsedSeconds, 0.0);
+
+	int steps = 0;
+	while (_accumulator >= _stepSeconds && steps < MAX_STEPS_PER_ADVANCE)
+	{
+		_previous = _current;
+		step(_current);
+		_accumulator -= _stepSeconds;
+		steps++;
+	}
+	if (steps == MAX_STEPS_PER_ADVANCE)
+	{
+		_accumulator = std::min(_accumulator, _stepSeconds);
+	}
+
+	const float alpha = static_cast<float>(std::min(_accumulator / _stepSeconds, 1.0));
+	_snapshot.tick = _current.tick;
+	_snapshot.time = _previous.time + (_current.time - _previous.time) * alpha;
+	_snapshot.modelAngle = lerp_degrees(_previous.modelAngle, _current.modelAngle, alpha);
+	_snapshot.cameraOrbitAngle = lerp_degrees(_previous.cameraOrbitAngle, _current.cameraOrbitAngle, alpha);
+	_snapshot.clearFlash = _previous.clearFlash + (_current.clearFlash - _previous.clearFlash) * alpha;
+}
+
+void Simulation::seek(uint64_t tick)
+{
+	_accumulator = 0.0;
+	_current = SimulationState{};
+	if (tick > 0)
+	{
+		_current.tick = tick - 1;
+		step(_current);
+	}
+	_previous = _current;
+	_snapshot = _current;
+}
+
+void Simulation::step(SimulationState& state) const
+{
+	state.tick++;
+	state.time = state.tick * _stepSeconds;
+	// derived from the tick rather than accumulated, so long runs don't drift
+	state.modelAngle = wrap_degrees(state.time * MODEL_DEGREES_PER_SECOND);
+	state.cameraOrbitAngle = wrap_degrees(state.time * ORBIT_DEGREES_PER_SECOND);
+	state.clearFlash = static_cast<float>(std::abs(std::sin(state.time * FLASH_RADIANS_PER_SECOND)));
+}
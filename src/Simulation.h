@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+
+// everything the renderer reads from the simulation; copied out as a snapshot, never shared while stepping
+struct SimulationState {
+	uint64_t tick{ 0 };
+	double time{ 0.0 }; // simulated seconds
+	float modelAngle{ 0.0f }; // degrees, spin of the instanced monkeys
+	float cameraOrbitAngle{ 0.0f }; // degrees, position on the benchmark orbit path
+	float clearFlash{ 0.0f }; // blue channel of the clear color, [0, 1]
+};
+
+// Fixed-timestep update: advance() consumes real time in whole steps of step_seconds(), so behavior
+// doesn't depend on the frame rate, and blends the last two steps by the leftover fraction so
+// rendering faster than the step rate still moves smoothly. Not thread-safe; the engine runs
+// advance() as a job and only reads snapshot() after waiting for it.
+class Simulation
+{
+public:
+	void init(double stepSeconds);
+
+	// runs as many steps as elapsedSeconds covers, carrying the remainder over to the next call
+	void advance(double elapsedSeconds);
+	// jumps to the state after tick steps, with no remainder; a render of part of a run starts where it does
+	void seek(uint64_t tick);
+
+	// state between the previous and the latest step, as of the last advance()
+	const SimulationState& snapshot() const { return _snapshot; }
+
+	double step_seconds() const { return _stepSeconds; }
+
+private:
+	void step(SimulationState& state) const;
+
+	double _stepSeconds{ 1.0 / 60.0 };
+	double _accumulator{ 0.0 };
+
+	SimulationState _previous;
+	SimulationState _current;
+	SimulationState _snapshot;
+};
@@ -0,0 +1,195 @@
+#include "Skinning.h"
+
+#include "Log.h"
+#include "Mesh.h"
+#include "vk_initializers.h"
+
+#include <cassert>
+
+namespace {
+	// local_size_x of skinning.comp
+	constexpr uint32_t SKIN_GROUP_SIZE = 64;
+}
+
+bool Skinning::init(VkDevice device, VmaAllocator allocator, DescriptorAllocator& descriptors, VkBuffer output, VkShaderModule skinShader,
+	VkPipelineCache cache, uint32_t frameCount, uint32_t sourceCapacity, uint32_t jointCapacity)
+{
+	_device = device;
+	_allocator = allocator;
+	if (skinShader == VK_NULL_HANDLE)
+	{
+		return false;
+	}
+
+	_sourceCapacity = sourceCapacity;
+	_jointCapacity = jointCapacity;
+	const VkDeviceSize sourceSize = static_cast<VkDeviceSize>(sourceCapacity) * sizeof(SkinnedVertex);
+	const VkDeviceSize jointsSize = static_cast<VkDeviceSize>(jointCapacity) * sizeof(glm::mat4);
+	_source = create_buffer(sourceSize, VMA_MEMORY_USAGE_GPU_ONLY, false);
+	_frames.assign(frameCount, FrameSlot{});
+	bool allocated = _source._buffer != VK_NULL_HANDLE;
+	for (FrameSlot& slot : _frames)
+	{
+		slot.joints = create_buffer(jointsSize, VMA_MEMORY_USAGE_CPU_TO_GPU, true);
+		allocated = allocated && slot.joints._buffer != VK_NULL_HANDLE;
+	}
+	if (!allocated)
+	{
+		LOG_ERROR("No memory for the skinning buffers");
+		cleanup();
+		return false;
+	}
+
+	VkDescriptorSetLayoutBinding bindings[] = {
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0), // bind-pose vertices
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1), // joint matrices
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2), // posed vertices
+	};
+
+	VkDescriptorSetLayoutCreateInfo setInfo = {};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setInfo.pNext = nullptr;
+	setInfo.bindingCount = 3;
+	setInfo.pBindings = bindings;
+	VK_CHECK(vkCreateDescriptorSetLayout(_device, &setInfo, nullptr, &_setLayout));
+
+	VkPushConstantRange pushConstant;
+	pushConstant.offset = 0;
+	pushConstant.size = sizeof(Dispatch);
+	pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkPipelineLayoutCreateInfo layoutInfo = vkinit::pipeline_layout_create_info();
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &_setLayout;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushConstant;
+	VK_CHECK(vkCreatePipelineLayout(_device, &layoutInfo, nullptr, &_pipelineLayout));
+
+	VkComputePipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.pNext = nullptr;
+	pipelineInfo.layout = _pipelineLayout;
+	pipelineInfo.stage = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, skinShader);
+	VK_CHECK(vkCreateComputePipelines(_device, cache, 1, &pipelineInfo, nullptr, &_pipeline));
+
+	for (FrameSlot& slot : _frames)
+	{
+		VmaAllocationInfo jointsInfo;
+		vmaGetAllocationInfo(_allocator, slot.joints._allocation, &jointsInfo);
+		slot.mappedJoints = static_cast<glm::mat4*>(jointsInfo.pMappedData);
+
+		// every buffer stays the same, so the sets are written once
+		descriptors.allocate(&slot.set, _setLayout);
+		VkDescriptorBufferInfo sourceInfo = { _source._buffer, 0, sourceSize };
+		VkDescriptorBufferInfo jointsBufferInfo = { slot.joints._buffer, 0, jointsSize };
+		VkDescriptorBufferInfo outputInfo = { output, 0, VK_WHOLE_SIZE };
+		VkWriteDescriptorSet writes[] = {
+			vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, slot.set, &sourceInfo, 0),
+			vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, slot.set, &jointsBufferInfo, 1),
+			vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, slot.set, &outputInfo, 2),
+		};
+		vkUpdateDescriptorSets(_device, 3, writes, 0, nullptr);
+	}
+	return true;
+}
+
+void Skinning::cleanup()
+{
+	// the sets go with the descriptor allocator's pools
+	if (_pipeline != VK_NULL_HANDLE)
+	{
+		vkDestroyPipeline(_device, _pipeline, nullptr);
+		vkDestroyPipelineLayout(_device, _pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(_device, _setLayout, nullptr);
+	}
+	for (FrameSlot& slot : _frames)
+	{
+		if (slot.joints._buffer != VK_NULL_HANDLE)
+		{
+			vmaDestroyBuffer(_allocator, slot.joints._buffer, slot.joints._allocation);
+		}
+	}
+	if (_source._buffer != VK_NULL_HANDLE)
+	{
+		vmaDestroyBuffer(_allocator, _source._buffer, _source._allocation);
+	}
+	_frames.clear();
+	_source = {};
+	_pipeline = VK_NULL_HANDLE;
+	_pipelineLayout = VK_NULL_HANDLE;
+	_setLayout = VK_NULL_HANDLE;
+	_sourceUsed = 0;
+	_jointsUsed = 0;
+}
+
+bool Skinning::allocate_source(uint32_t vertexCount, uint32_t& offset)
+{
+	if (vertexCount > _sourceCapacity - _sourceUsed)
+	{
+		return false;
+	}
+	offset = _sourceUsed;
+	_sourceUsed += vertexCount;
+	return true;
+}
+
+bool Skinning::allocate_joints(uint32_t jointCount, uint32_t& first)
+{
+	if (jointCount > _jointCapacity - _jointsUsed)
+	{
+		return false;
+	}
+	first = _jointsUsed;
+	_jointsUsed += jointCount;
+	return true;
+}
+
+void Skinning::record(VkCommandBuffer cmd, uint32_t frame, const Dispatch* dispatches, uint32_t count, VkPipelineStageFlags dstStages,
+	VkAccessFlags dstAccess) const
+{
+	assert(_pipeline != VK_NULL_HANDLE);
+	if (count == 0)
+	{
+		return;
+	}
+
+	// host writes are visible to the queue once submitted, but only if they reached device memory
+	const FrameSlot& slot = _frames[frame];
+	vmaFlushAllocation(_allocator, slot.joints._allocation, 0, static_cast<VkDeviceSize>(_jointsUsed) * sizeof(glm::mat4));
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout, 0, 1, &slot.set, 0, nullptr);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		vkCmdPushConstants(cmd, _pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Dispatch), &dispatches[i]);
+		vkCmdDispatch(cmd, (dispatches[i].vertexCount + SKIN_GROUP_SIZE - 1) / SKIN_GROUP_SIZE, 1, 1);
+	}
+
+	// the ranges were last drawn by the slot's previous frame, which the frame's fence wait already retired
+	VkMemoryBarrier toDraw = {};
+	toDraw.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	toDraw.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	toDraw.dstAccessMask = dstAccess;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dstStages, 0, 1, &toDraw, 0, nullptr, 0, nullptr);
+}
+
+AllocatedBuffer Skinning::create_buffer(VkDeviceSize size, VmaMemoryUsage memoryUsage, bool mapped) const
+{
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.pNext = nullptr;
+	bufferInfo.size = size;
+	// the bind-pose vertices are uploaded by the transfer queue
+	bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | (mapped ? 0 : VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.usage = memoryUsage;
+	allocInfo.flags = mapped ? VMA_ALLOCATION_CREATE_MAPPED_BIT : 0;
+
+	AllocatedBuffer buffer = {};
+	if (vmaCreateBuffer(_allocator, &bufferInfo, &allocInfo, &buffer._buffer, &buffer._allocation, nullptr) != VK_SUCCESS)
+	{
+		return {};
+	}
+	return buffer;
+}
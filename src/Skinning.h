@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vk_types.h>
+#include <DescriptorAllocator.h>
+
+#include <glm/mat4x4.hpp>
+
+#include <vector>
+
+// Compute pre-pass that poses skinned meshes once a frame. skinning.comp blends every SkinnedVertex by the
+// matrices of its joints and writes the result as a plain Vertex into a range of the mesh pool's Vertex
+// stream, which the depth, shadow and color passes then draw like any other mesh: the skinning is paid
+// once a frame however many passes draw the mesh. The bind-pose vertices sit in a device-local buffer of
+// the pass's own; the joint matrices, which the CPU samples every frame (see Animation.h), in a mapped
+// buffer per frame slot. Callers give every instance an output range per frame slot too, so no frame ever
+// overwrites vertices a frame still in flight draws from.
+class Skinning
+{
+public:
+	// one skinned instance to pose; matches the push constants of skinning.comp
+	struct Dispatch {
+		uint32_t sourceOffset; // first of its bind-pose vertices in the source buffer
+		uint32_t vertexCount;
+		uint32_t outputOffset; // first vertex of its range of the output buffer
+		uint32_t firstJoint; // first of its matrices in the frame slot's joint buffer
+	};
+
+	// false, with nothing left to clean up, without a shader or without memory for the buffers. output is
+	// the mesh pool's Vertex stream; the source buffer holds sourceCapacity vertices, every frame slot's
+	// joint buffer jointCapacity matrices
+	bool init(VkDevice device, VmaAllocator allocator, DescriptorAllocator& descriptors, VkBuffer output, VkShaderModule skinShader,
+		VkPipelineCache cache, uint32_t frameCount, uint32_t sourceCapacity, uint32_t jointCapacity);
+	// the GPU must be done with the buffers
+	void cleanup();
+
+	bool ready() const { return _pipeline != VK_NULL_HANDLE; }
+
+	// room for vertexCount SkinnedVertex, which the caller uploads to source_buffer() from offset on (in
+	// vertices), for compute shaders to read; false once the buffer is full
+	bool allocate_source(uint32_t vertexCount, uint32_t& offset);
+	// jointCount consecutive matrices of every frame slot's joint buffer; false once they are full
+	bool allocate_joints(uint32_t jointCount, uint32_t& first);
+	VkBuffer source_buffer() const { return _source._buffer; }
+
+	// the frame slot's joint matrices, to write before record()
+	glm::mat4* joints(uint32_t frame) const { return _frames[frame].mappedJoints; }
+
+	// outside any render pass: flushes the slot's joint matrices and poses every dispatch, then makes the
+	// vertices visible to dstStages and dstAccess, the draws that read them
+	void record(VkCommandBuffer cmd, uint32_t frame, const Dispatch* dispatches, uint32_t count, VkPipelineStageFlags dstStages,
+		VkAccessFlags dstAccess) const;
+
+private:
+	struct FrameSlot {
+		AllocatedBuffer joints{};
+		glm::mat4* mappedJoints{ nullptr };
+		VkDescriptorSet set{ VK_NULL_HANDLE };
+	};
+
+	AllocatedBuffer create_buffer(VkDeviceSize size, VmaMemoryUsage memoryUsage, bool mapped) const;
+
+	VkDevice _device{ VK_NULL_HANDLE };
+	VmaAllocator _allocator{ nullptr };
+
+	VkDescriptorSetLayout _setLayout{ VK_NULL_HANDLE };
+	VkPipelineLayout _pipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline _pipeline{ VK_NULL_HANDLE };
+
+	AllocatedBuffer _source{};
+	uint32_t _sourceCapacity{ 0 };
+	uint32_t _sourceUsed{ 0 };
+	uint32_t _jointCapacity{ 0 };
+	uint32_t _jointsUsed{ 0 };
+	std::vector<FrameSlot> _frames;
+};
@@ -0,0 +1,285 @@
+#include "SoftwareOcclusion.h"
+
+#include "JobSystem.h"
+#include "SimdLanes.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	// triangles set up per job, objects tested per job
+	constexpr uint32_t SETUP_CHUNK = 1024;
+	constexpr uint32_t TEST_CHUNK = 256;
+	// an occluder must be this much nearer than a box to hide it, so a box never hides behind its own surface
+	constexpr float OCCLUSION_MARGIN = 1.0001f;
+
+	static_assert(SoftwareOcclusion::WIDTH % SIMD_WIDTH == 0, "rows are whole lane groups");
+	static_assert(SoftwareOcclusion::HEIGHT % SoftwareOcclusion::BAND_HEIGHT == 0, "bands cover the buffer");
+
+	// pixel centres of a lane group, from its first pixel
+	const float LANE_CENTERS[SIMD_WIDTH] = { 0.5f, 1.5f, 2.5f, 3.5f };
+}
+
+bool make_occluder_mesh(const Mesh& mesh, OccluderMesh& occluder, float maxErrorFraction)
+{
+	const float maxError = glm::length(mesh._bounds.max - mesh._bounds.min) * maxErrorFraction;
+	uint32_t level = 0;
+	for (uint32_t candidate = 1; candidate < mesh.lod_count(); candidate++)
+	{
+		if (mesh.get_lod(candidate).error <= maxError)
+		{
+			level = candidate;
+		}
+	}
+
+	// packed caches keep no indices on the CPU until something unpacks them
+	const MeshLod lod = mesh.get_lod(level);
+	if (lod.indexCount == 0 || mesh._indices.size() < size_t(lod.firstIndex) + lod.indexCount)
+	{
+		return false;
+	}
+
+	occluder.positions.clear();
+	occluder.indices.clear();
+	std::vector<uint32_t> remap(mesh._vertices.size(), UINT32_MAX);
+	for (uint32_t i = lod.firstIndex; i < lod.firstIndex + lod.indexCount; i++)
+	{
+		const uint32_t vertex = mesh._indices[i];
+		if (remap[vertex] == UINT32_MAX)
+		{
+			remap[vertex] = static_cast<uint32_t>(occluder.positions.size());
+			occluder.positions.push_back(mesh._vertices[vertex].position);
+		}
+		occluder.indices.push_back(remap[vertex]);
+	}
+	return true;
+}
+
+void SoftwareOcclusion::clear_occluders()
+{
+	_triangles.clear();
+}
+
+void SoftwareOcclusion::add_occluder(const OccluderMesh& mesh, const glm::mat4& transform)
+{
+	for (uint32_t index : mesh.indices)
+	{
+		_triangles.push_back(glm::vec3(transform * glm::vec4(mesh.positions[index], 1.0f)));
+	}
+}
+
+void SoftwareOcclusion::render(const Camera& camera)
+{
+	_viewProjection = camera.unjittered_view_projection();
+	_nearPlane = camera.near_plane();
+	_depth.assign(size_t(WIDTH) * HEIGHT, 0.0f);
+
+	const uint32_t triangleCount = static_cast<uint32_t>(occluder_triangle_count());
+	_setups.resize(triangleCount);
+	parallel_for((triangleCount + SETUP_CHUNK - 1) / SETUP_CHUNK, [&](size_t chunk) {
+		const uint32_t first = static_cast<uint32_t>(chunk) * SETUP_CHUNK;
+		for (uint32_t triangle = first; triangle < std::min(first + SETUP_CHUNK, triangleCount); triangle++)
+		{
+			setup_triangle(triangle, _setups[triangle]);
+		}
+	});
+	parallel_for(HEIGHT / BAND_HEIGHT, [&](size_t band) {
+		rasterize_band(static_cast<uint32_t>(band));
+	});
+
+	// the farthest of every 3x3 neighbourhood, a row pass then a column pass; the edges clamp
+	_conservative.resize(_depth.size());
+	std::vector<float> rows(_depth.size());
+	for (uint32_t y = 0; y < HEIGHT; y++)
+	{
+		const float* in = &_depth[size_t(y) * WIDTH];
+		float* out = &rows[size_t(y) * WIDTH];
+		for (uint32_t x = 0; x < WIDTH; x++)
+		{
+			out[x] = std::min({ in[x == 0 ? 0 : x - 1], in[x], in[std::min(x + 1, WIDTH - 1)] });
+		}
+	}
+	for (uint32_t y = 0; y < HEIGHT; y++)
+	{
+		const float* above = &rows[size_t(y == 0 ? 0 : y - 1) * WIDTH];
+		const float* row = &rows[size_t(y) * WIDTH];
+		const float* below = &rows[size_t(std::min(y + 1, HEIGHT - 1)) * WIDTH];
+		float* out = &_conservative[size_t(y) * WIDTH];
+		for (uint32_t x = 0; x < WIDTH; x++)
+		{
+			out[x] = std::min({ above[x], row[x], below[x] });
+		}
+	}
+}
+
+bool SoftwareOcclusion::occluded(const Aabb& box) const
+{
+	if (_conservative.empty())
+	{
+		return false;
+	}
+
+	float minX = float(WIDTH);
+	float minY = float(HEIGHT);
+	float maxX = 0.0f;
+	float maxY = 0.0f;
+	float nearest = 0.0f;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		const glm::vec3 position((corner & 1) ? box.max.x : box.min.x, (corner & 2) ? box.max.y : box.min.y, (corner & 4) ? box.max.z : box.min.z);
+		const glm::vec4 clip = _viewProjection * glm::vec4(position, 1.0f);
+		if (clip.w < _nearPlane)
+		{
+			return false;
+		}
+		const float invW = 1.0f / clip.w;
+		const float x = (clip.x * invW * 0.5f + 0.5f) * WIDTH;
+		const float y = (clip.y * invW * 0.5f + 0.5f) * HEIGHT;
+		minX = std::min(minX, x);
+		minY = std::min(minY, y);
+		maxX = std::max(maxX, x);
+		maxY = std::max(maxY, y);
+		nearest = std::max(nearest, invW);
+	}
+	if (minX < 0.0f || minY < 0.0f || maxX > float(WIDTH) || maxY > float(HEIGHT))
+	{
+		return false;
+	}
+
+	const int32_t x0 = static_cast<int32_t>(minX);
+	const int32_t y0 = static_cast<int32_t>(minY);
+	const int32_t x1 = std::min(static_cast<int32_t>(maxX), int32_t(WIDTH) - 1);
+	const int32_t y1 = std::min(static_cast<int32_t>(maxY), int32_t(HEIGHT) - 1);
+	const Lanes threshold = lanes_splat(nearest * OCCLUSION_MARGIN);
+	for (int32_t y = y0; y <= y1; y++)
+	{
+		const float* row = &_conservative[size_t(y) * WIDTH];
+		for (int32_t x = x0 & ~int32_t(SIMD_WIDTH - 1); x <= x1; x += SIMD_WIDTH)
+		{
+			// lanes of the group outside the rectangle don't count
+			int wanted = (1 << SIMD_WIDTH) - 1;
+			if (x < x0)
+			{
+				wanted &= ~((1 << (x0 - x)) - 1);
+			}
+			if (x + int32_t(SIMD_WIDTH) - 1 > x1)
+			{
+				wanted &= (1 << (x1 - x + 1)) - 1;
+			}
+			if ((lanes_mask(lanes_ge(lanes_load(row + x), threshold)) & wanted) != wanted)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+uint32_t SoftwareOcclusion::remove_occluded(uint32_t* indices, uint32_t count, const std::function<Aabb(uint32_t)>& bounds) const
+{
+	std::vector<uint8_t> hidden(count);
+	parallel_for((count + TEST_CHUNK - 1) / TEST_CHUNK, [&](size_t chunk) {
+		const uint32_t first = static_cast<uint32_t>(chunk) * TEST_CHUNK;
+		for (uint32_t i = first; i < std::min(first + TEST_CHUNK, count); i++)
+		{
+			hidden[i] = occluded(bounds(indices[i]));
+		}
+	});
+
+	uint32_t kept = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (!hidden[i])
+		{
+			indices[kept++] = indices[i];
+		}
+	}
+	return kept;
+}
+
+void SoftwareOcclusion::setup_triangle(uint32_t triangle, TriangleSetup& setup) const
+{
+	setup.minX = 1;
+	setup.maxX = 0;
+
+	glm::vec3 screen[3]; // pixels, and 1 / w
+	for (int i = 0; i < 3; i++)
+	{
+		const glm::vec4 clip = _viewProjection * glm::vec4(_triangles[size_t(triangle) * 3 + i], 1.0f);
+		if (clip.w < _nearPlane)
+		{
+			return;
+		}
+		const float invW = 1.0f / clip.w;
+		screen[i] = glm::vec3((clip.x * invW * 0.5f + 0.5f) * WIDTH, (clip.y * invW * 0.5f + 0.5f) * HEIGHT, invW);
+	}
+
+	// either winding: dividing by the signed area makes every edge function a vertex's weight
+	const float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[1].y - screen[0].y) * (screen[2].x - screen[0].x);
+	if (std::abs(area) < 1e-6f)
+	{
+		return;
+	}
+	setup.depth = glm::vec3(0.0f);
+	for (int i = 0; i < 3; i++)
+	{
+		const glm::vec3& a = screen[(i + 1) % 3];
+		const glm::vec3& b = screen[(i + 2) % 3];
+		setup.edges[i] = glm::vec3(a.y - b.y, b.x - a.x, a.x * b.y - b.x * a.y) / area;
+		setup.depth += setup.edges[i] * screen[i].z;
+	}
+
+	const float minX = std::min({ screen[0].x, screen[1].x, screen[2].x });
+	const float minY = std::min({ screen[0].y, screen[1].y, screen[2].y });
+	const float maxX = std::max({ screen[0].x, screen[1].x, screen[2].x });
+	const float maxY = std::max({ screen[0].y, screen[1].y, screen[2].y });
+	if (maxX < 0.0f || maxY < 0.0f || minX >= float(WIDTH) || minY >= float(HEIGHT))
+	{
+		return;
+	}
+	setup.minX = std::max(0, static_cast<int32_t>(std::floor(minX)));
+	setup.minY = std::max(0, static_cast<int32_t>(std::floor(minY)));
+	setup.maxX = std::min(int32_t(WIDTH) - 1, static_cast<int32_t>(std::floor(maxX)));
+	setup.maxY = std::min(int32_t(HEIGHT) - 1, static_cast<int32_t>(std::floor(maxY)));
+}
+
+void SoftwareOcclusion::rasterize_band(uint32_t band)
+{
+	const int32_t bandFirst = static_cast<int32_t>(band * BAND_HEIGHT);
+	const int32_t bandLast = bandFirst + static_cast<int32_t>(BAND_HEIGHT) - 1;
+	const Lanes centers = lanes_load(LANE_CENTERS);
+	const Lanes zero = lanes_splat(0.0f);
+
+	for (const TriangleSetup& setup : _setups)
+	{
+		if (setup.minX > setup.maxX || setup.maxY < bandFirst || setup.minY > bandLast)
+		{
+			continue;
+		}
+
+		const Lanes stepX[3] = { lanes_splat(setup.edges[0].x), lanes_splat(setup.edges[1].x), lanes_splat(setup.edges[2].x) };
+		const Lanes depthX = lanes_splat(setup.depth.x);
+		for (int32_t y = std::max(setup.minY, bandFirst); y <= std::min(setup.maxY, bandLast); y++)
+		{
+			const float centerY = y + 0.5f;
+			const Lanes rowEdges[3] = {
+				lanes_splat(setup.edges[0].y * centerY + setup.edges[0].z),
+				lanes_splat(setup.edges[1].y * centerY + setup.edges[1].z),
+				lanes_splat(setup.edges[2].y * centerY + setup.edges[2].z),
+			};
+			const Lanes rowDepth = lanes_splat(setup.depth.y * centerY + setup.depth.z);
+
+			float* row = &_depth[size_t(y) * WIDTH];
+			for (int32_t x = setup.minX & ~int32_t(SIMD_WIDTH - 1); x <= setup.maxX; x += SIMD_WIDTH)
+			{
+				// covered where no vertex weight is negative; uncovered lanes keep what the row had
+				const Lanes px = lanes_add(lanes_splat(float(x)), centers);
+				Lanes covered = lanes_ge(lanes_add(lanes_mul(stepX[0], px), rowEdges[0]), zero);
+				covered = lanes_and(covered, lanes_ge(lanes_add(lanes_mul(stepX[1], px), rowEdges[1]), zero));
+				covered = lanes_and(covered, lanes_ge(lanes_add(lanes_mul(stepX[2], px), rowEdges[2]), zero));
+				const Lanes depth = lanes_add(lanes_mul(depthX, px), rowDepth);
+				lanes_store(row + x, lanes_max(lanes_load(row + x), lanes_and(covered, depth)));
+			}
+		}
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <Bvh.h>
+#include <Camera.h>
+#include <Mesh.h>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+// an occluder's triangles in its mesh's space, compacted to the vertices they use
+struct OccluderMesh {
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> indices;
+};
+
+// the coarsest detail level of mesh whose error stays within maxErrorFraction of its bounds' diagonal, so the
+// silhouette barely moves at a fraction of the triangles; false when the mesh has no CPU indices to take it from
+bool make_occluder_mesh(const Mesh& mesh, OccluderMesh& occluder, float maxErrorFraction = 0.005f);
+
+// CPU occlusion culling for when the GPU path (and its depth pyramid) isn't in use: a few large occluders
+// are rasterized into a small depth buffer, and objects whose screen rectangle lies wholly behind it are
+// dropped before their draws are recorded.
+// The buffer holds 1 / w of the nearest occluder per pixel, which interpolates linearly across the screen
+// and doesn't care which depth convention the camera uses. Rows are split into bands rasterized on the job
+// system, four pixels per SIMD step. Coverage is sampled at pixel centres, so before testing every pixel
+// takes the farthest depth of its 3x3 neighbourhood: a pixel an occluder edge only partly covers then
+// counts as open, which keeps the test conservative for occluders larger than a few pixels.
+// Occluder triangles crossing the near plane are left out rather than clipped, which only loses occlusion.
+class SoftwareOcclusion
+{
+public:
+	// 2:1 suits a widescreen view; a pixel covers about 8x8 of a 1080p frame
+	static constexpr uint32_t WIDTH = 256;
+	static constexpr uint32_t HEIGHT = 128;
+	// rows rasterized per job
+	static constexpr uint32_t BAND_HEIGHT = 16;
+
+	void clear_occluders();
+	// occluder under transform, kept as world-space triangles until cleared
+	void add_occluder(const OccluderMesh& mesh, const glm::mat4& transform);
+	size_t occluder_triangle_count() const { return _triangles.size() / 3; }
+
+	// redraws the buffer from every occluder as camera sees them; the tests below use this view until the next
+	void render(const Camera& camera);
+
+	// whether box is behind the occluders everywhere it covers the screen; boxes reaching off screen or
+	// through the near plane never are, the frustum test has the last word on those
+	bool occluded(const Aabb& box) const;
+	// keeps the indices whose bounds aren't occluded, in order; returns how many. bounds may be called from
+	// several threads at once
+	uint32_t remove_occluded(uint32_t* indices, uint32_t count, const std::function<Aabb(uint32_t)>& bounds) const;
+
+private:
+	// barycentric planes of one triangle across the screen, and its 1 / w plane, in pixels
+	struct TriangleSetup {
+		glm::vec3 edges[3]; // x * edge.x + y * edge.y + edge.z, each vertex's weight
+		glm::vec3 depth; // 1 / w the same way
+		int32_t minX, minY, maxX, maxY; // inclusive pixel bounds, clamped to the buffer; minX > maxX when skipped
+	};
+
+	void setup_triangle(uint32_t triangle, TriangleSetup& setup) const;
+	void rasterize_band(uint32_t band);
+
+	std::vector<glm::vec3> _triangles; // three corners each
+	std::vector<TriangleSetup> _setups;
+	glm::mat4 _viewProjection{ 1.0f };
+	float _nearPlane{ 0.1f };
+	// nearest occluder's 1 / w per pixel, 0 where there is none
+	std::vector<float> _depth;
+	// _depth after taking the farthest of every 3x3 neighbourhood, which is what the tests read
+	std::vector<float> _conservative;
+};
@@ -0,0 +1,288 @@
+#include "SphereCuller.h"
+
+#include "JobSystem.h"
+#include "SimdLanes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <glm/geometric.hpp>
+
+namespace {
+	// spheres per kernel iteration: two lane groups, so their plane tests overlap
+	constexpr uint32_t BATCH = 2 * SIMD_WIDTH;
+	static_assert(SphereCuller::DEFAULT_CHUNK_SIZE % BATCH == 0, "chunks start on whole iterations");
+}
+
+void SphereCuller::set_chunk_size(uint32_t spheres)
+{
+	_chunkSize = std::max((spheres + BATCH - 1) / BATCH, 1u) * BATCH;
+}
+
+void SphereCuller::resize(uint32_t count)
+{
+	// a list of another length is another list, which the last sweep's indices say nothing about
+	if (count != _count)
+	{
+		_coherent = false;
+	}
+	_count = count;
+	_movedFlags.resize(count, 0);
+	const size_t padded = (size_t(count) + BATCH - 1) / BATCH * BATCH;
+	_x.resize(padded, 0.0f);
+	_y.resize(padded, 0.0f);
+	_z.resize(padded, 0.0f);
+	_radius.resize(padded, 0.0f);
+}
+
+void SphereCuller::set(uint32_t index, const glm::vec3& center, float radius)
+{
+	if (_coherent && _movedFlags[index] == 0
+		&& (_x[index] != center.x || _y[index] != center.y || _z[index] != center.z || _radius[index] != radius))
+	{
+		_movedFlags[index] = 1;
+		_moved.push_back(index);
+	}
+	_x[index] = center.x;
+	_y[index] = center.y;
+	_z[index] = center.z;
+	_radius[index] = radius;
+}
+
+void SphereCuller::set_coherence(float distance)
+{
+	_coherence = std::max(distance, 0.0f);
+	_coherent = false;
+}
+
+uint32_t SphereCuller::cull(const glm::vec4 planes[6], uint32_t* visible) const
+{
+	return sweep(planes, 0.0f, visible);
+}
+
+uint32_t SphereCuller::cull_coherent(const glm::vec4 planes[6], uint32_t* visible)
+{
+	_coherentTests = _count;
+	if (_coherence <= 0.0f)
+	{
+		return cull(planes, visible);
+	}
+
+	// while the planes move further than the distance every frame, a sweep's results would go stale by the
+	// next, so there are only sweeps until they settle
+	const bool settled = _hasLastPlanes && motion(_lastPlanes, planes) < _coherence;
+	std::copy(planes, planes + 6, _lastPlanes);
+	_hasLastPlanes = true;
+	// a lot of moved spheres costs more one by one than a sweep
+	const bool current = _coherent && motion(_referencePlanes, planes) < _coherence && _moved.size() <= _count / 8;
+	if (!current)
+	{
+		if (!settled)
+		{
+			_coherent = false;
+			for (uint32_t index : _moved)
+			{
+				_movedFlags[index] = 0;
+			}
+			_moved.clear();
+			return cull(planes, visible);
+		}
+		rebuild(planes);
+	}
+
+	// the ones near a plane at the sweep and the moved ones are tested; the stable ones are visible still
+	_retested.clear();
+	for (uint32_t index : _boundary)
+	{
+		if (_movedFlags[index] == 0 && inside(planes, index))
+		{
+			_retested.push_back(index);
+		}
+	}
+	for (uint32_t index : _moved)
+	{
+		if (inside(planes, index))
+		{
+			_retested.push_back(index);
+		}
+	}
+	std::sort(_retested.begin(), _retested.end());
+	_coherentTests = static_cast<uint32_t>(_boundary.size() + _moved.size()) + (current ? 0 : _count);
+
+	uint32_t count = 0;
+	size_t r = 0;
+	for (uint32_t index : _stable)
+	{
+		if (_movedFlags[index] != 0)
+		{
+			continue;
+		}
+		while (r < _retested.size() && _retested[r] < index)
+		{
+			visible[count++] = _retested[r++];
+		}
+		visible[count++] = index;
+	}
+	while (r < _retested.size())
+	{
+		visible[count++] = _retested[r++];
+	}
+	return count;
+}
+
+void SphereCuller::rebuild(const glm::vec4 planes[6])
+{
+	// any point of a sphere is within this of the center of their common box
+	glm::vec3 low(std::numeric_limits<float>::max());
+	glm::vec3 high(-std::numeric_limits<float>::max());
+	for (uint32_t i = 0; i < _count; i++)
+	{
+		low = glm::min(low, glm::vec3(_x[i], _y[i], _z[i]) - _radius[i]);
+		high = glm::max(high, glm::vec3(_x[i], _y[i], _z[i]) + _radius[i]);
+	}
+	_sweptCenter = _count > 0 ? (low + high) * 0.5f : glm::vec3(0.0f);
+	_sweptRadius = _count > 0 ? glm::length(high - low) * 0.5f : 0.0f;
+
+	// visible with the spheres shrunk by the distance: visible whatever planes within it of these see.
+	// Visible grown by it: either way, so tested each time; the rest stays hidden
+	_stable.resize(_count);
+	_boundary.resize(_count);
+	_stable.resize(sweep(planes, -_coherence, _stable.data()));
+	const uint32_t nearCount = sweep(planes, _coherence, _boundary.data());
+	// the stable spheres are among the near ones; what's left of those is the boundary, compacted in place
+	uint32_t kept = 0;
+	size_t s = 0;
+	for (uint32_t i = 0; i < nearCount; i++)
+	{
+		const uint32_t index = _boundary[i];
+		while (s < _stable.size() && _stable[s] < index)
+		{
+			s++;
+		}
+		if (s < _stable.size() && _stable[s] == index)
+		{
+			continue;
+		}
+		_boundary[kept++] = index;
+	}
+	_boundary.resize(kept);
+
+	std::copy(planes, planes + 6, _referencePlanes);
+	for (uint32_t index : _moved)
+	{
+		_movedFlags[index] = 0;
+	}
+	_moved.clear();
+	_coherent = true;
+}
+
+float SphereCuller::motion(const glm::vec4 from[6], const glm::vec4 to[6]) const
+{
+	// a point's distance to a plane changes by the normal's change dotted with it, plus the offset's
+	float largest = 0.0f;
+	for (int p = 0; p < 6; p++)
+	{
+		const glm::vec3 normal = glm::vec3(to[p]) - glm::vec3(from[p]);
+		const float offset = to[p].w - from[p].w;
+		largest = std::max(largest, std::abs(glm::dot(normal, _sweptCenter) + offset) + glm::length(normal) * _sweptRadius);
+	}
+	return largest;
+}
+
+bool SphereCuller::inside(const glm::vec4 planes[6], uint32_t index) const
+{
+	for (int p = 0; p < 6; p++)
+	{
+		// summed as the kernel sums, so a sphere it would keep is kept here too
+		const float distance = (planes[p].x * _x[index] + planes[p].y * _y[index]) + (planes[p].z * _z[index] + planes[p].w);
+		if (distance < -_radius[index])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+uint32_t SphereCuller::sweep(const glm::vec4 planes[6], float radiusOffset, uint32_t* visible) const
+{
+	const uint32_t chunkCount = (_count + _chunkSize - 1) / _chunkSize;
+	if (chunkCount <= 1)
+	{
+		return cull_range(planes, radiusOffset, 0, _count, visible);
+	}
+
+	// each chunk fills the start of its own part of visible, then the parts close up in order
+	std::vector<uint32_t> chunkVisible(chunkCount);
+	parallel_for(chunkCount, [&](size_t chunk) {
+		const uint32_t first = static_cast<uint32_t>(chunk) * _chunkSize;
+		chunkVisible[chunk] = cull_range(planes, radiusOffset, first, std::min(first + _chunkSize, _count), visible + first);
+	});
+
+	uint32_t count = chunkVisible[0];
+	for (uint32_t chunk = 1; chunk < chunkCount; chunk++)
+	{
+		memmove(visible + count, visible + chunk * _chunkSize, chunkVisible[chunk] * sizeof(uint32_t));
+		count += chunkVisible[chunk];
+	}
+	return count;
+}
+
+uint32_t SphereCuller::cull_range(const glm::vec4 planes[6], float radiusOffset, uint32_t first, uint32_t last, uint32_t* visible) const
+{
+	Lanes planeLanes[6][4];
+	for (int p = 0; p < 6; p++)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			planeLanes[p][c] = lanes_splat(planes[p][c]);
+		}
+	}
+	const Lanes negativeOffset = lanes_splat(-radiusOffset);
+
+	uint32_t count = 0;
+	for (uint32_t base = first; base < last; base += BATCH)
+	{
+		// a sphere is out once its center is farther than its radius behind any plane
+		int mask = 0;
+		for (uint32_t group = 0; group < BATCH; group += SIMD_WIDTH)
+		{
+			const uint32_t i = base + group;
+			const Lanes x = lanes_load(&_x[i]);
+			const Lanes y = lanes_load(&_y[i]);
+			const Lanes z = lanes_load(&_z[i]);
+			const Lanes negativeRadius = lanes_sub(negativeOffset, lanes_load(&_radius[i]));
+			Lanes inside;
+			for (int p = 0; p < 6; p++)
+			{
+				const Lanes distance = lanes_add(lanes_add(lanes_mul(planeLanes[p][0], x), lanes_mul(planeLanes[p][1], y)),
+					lanes_add(lanes_mul(planeLanes[p][2], z), planeLanes[p][3]));
+				const Lanes front = lanes_ge(distance, negativeRadius);
+				inside = p == 0 ? front : lanes_and(inside, front);
+			}
+			mask |= lanes_mask(inside) << group;
+		}
+
+		// every index is written and the count only moves past the visible ones; the last iteration may
+		// run past the end of the range, where writing would too
+		if (base + BATCH <= last)
+		{
+			for (uint32_t lane = 0; lane < BATCH; lane++)
+			{
+				visible[count] = base + lane;
+				count += (mask >> lane) & 1;
+			}
+		}
+		else
+		{
+			for (uint32_t lane = 0; base + lane < last; lane++)
+			{
+				if ((mask >> lane) & 1)
+				{
+					visible[count++] = base + lane;
+				}
+			}
+		}
+	}
+	return count;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+// Frustum culling of bounding spheres in one linear sweep, for the CPU path: the spheres sit as structure
+// of arrays, so the kernel tests SIMD_WIDTH of them per lane group against each plane with a few multiply-
+// adds and two groups per iteration, and writes the indices of the visible ones without branching. Chunks
+// of the array go to the job system and their lists are joined in order, so the result comes out sorted,
+// which is the render list order the draws want. Unlike a tree query it visits every sphere, but touches
+// each once and never sorts, which wins once much of a large scene is in view.
+// With coherence, cull_coherent() sweeps only when the planes have moved a distance further than that since
+// the last sweep; in between it reuses that sweep's results and tests just the spheres that were near a
+// plane then, and those set since.
+class SphereCuller
+{
+public:
+	// spheres per culling job: enough work to be worth a job, small enough to spread a million over the workers
+	static constexpr uint32_t DEFAULT_CHUNK_SIZE = 16384;
+
+	// rounded up to whole kernel iterations; the best size depends on the cores and their caches
+	void set_chunk_size(uint32_t spheres);
+	uint32_t chunk_size() const { return _chunkSize; }
+
+	// new spheres are empty until set
+	void resize(uint32_t count);
+	uint32_t size() const { return _count; }
+	void set(uint32_t index, const glm::vec3& center, float radius);
+
+	// how far, in world units, any point's distance to a plane may change before cull_coherent() sweeps
+	// again; 0, the default, sweeps every time. Larger keeps results longer but tests more spheres each time
+	void set_coherence(float distance);
+	float coherence() const { return _coherence; }
+
+	// the indices of the spheres at least partly inside every plane, ascending, into visible, which holds
+	// size() entries; returns how many. Planes point inwards and are normalized, as Camera::frustum_planes()
+	uint32_t cull(const glm::vec4 planes[6], uint32_t* visible) const;
+	// the same result, from the last sweep where coherence allows
+	uint32_t cull_coherent(const glm::vec4 planes[6], uint32_t* visible);
+	// spheres cull_coherent() tested one by one last time, or size() when it swept
+	uint32_t coherent_tests() const { return _coherentTests; }
+
+private:
+	// radiusOffset grows every sphere for the test, or shrinks it when negative
+	uint32_t cull_range(const glm::vec4 planes[6], float radiusOffset, uint32_t first, uint32_t last, uint32_t* visible) const;
+	uint32_t sweep(const glm::vec4 planes[6], float radiusOffset, uint32_t* visible) const;
+	bool inside(const glm::vec4 planes[6], uint32_t index) const;
+	// the most any point of the spheres swept last changes its distance to a plane between from and to
+	float motion(const glm::vec4 from[6], const glm::vec4 to[6]) const;
+	// sweeps for _stable and _boundary with planes as the new reference
+	void rebuild(const glm::vec4 planes[6]);
+
+	uint32_t _count{ 0 };
+	uint32_t _chunkSize{ DEFAULT_CHUNK_SIZE };
+	// padded to whole iterations; the extra lanes are tested but never reported
+	std::vector<float> _x;
+	std::vector<float> _y;
+	std::vector<float> _z;
+	std::vector<float> _radius;
+
+	float _coherence{ 0.0f };
+	// what the last sweep found: spheres visible however the planes move within _coherence, and the ones
+	// that might be visible but aren't that far inside, both ascending; the rest stay invisible
+	bool _coherent{ false };
+	glm::vec4 _referencePlanes[6];
+	glm::vec4 _lastPlanes[6];
+	bool _hasLastPlanes{ false };
+	std::vector<uint32_t> _stable;
+	std::vector<uint32_t> _boundary;
+	// the sphere around every sphere of the sweep, which bounds how far a plane's move shifts them
+	glm::vec3 _sweptCenter{ 0.0f };
+	float _sweptRadius{ 0.0f };
+	// spheres set since the sweep, flagged so the lists skip them; tested on their own
+	std::vector<uint8_t> _movedFlags;
+	std::vector<uint32_t> _moved;
+	// the boundary and moved spheres found visible, for merging into the stable ones
+	std::vector<uint32_t> _retested;
+	uint32_t _coherentTests{ 0 };
+};
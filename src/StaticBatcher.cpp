@@ -0,0 +1,122 @@
+#include "StaticBatcher.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <tuple>
+#include <glm/mat3x3.hpp>
+
+namespace {
+	// what a batch is keyed by: the sources' key and the grid cell their bounding sphere's center falls in
+	using BatchKey = std::tuple<uint32_t, int32_t, int32_t, int32_t>;
+
+	// voxel chunks are in chunk-local block units, and remeshed under edits
+	bool batchable(const Mesh& mesh, uint32_t maxVertices)
+	{
+		return !mesh._skinned && mesh._vertexFormat != VertexFormat::Voxel && !mesh.cpu_geometry_released() && !mesh._vertices.empty() && !mesh._indices.empty()
+			&& mesh._vertices.size() <= maxVertices;
+	}
+
+	// appends source's level 0 to batch as a surface and cluster of its own
+	void append_source(Mesh& batch, const StaticBatchSource& source)
+	{
+		const Mesh& mesh = *source.mesh;
+		const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(source.world)));
+		const uint32_t firstVertex = static_cast<uint32_t>(batch._vertices.size());
+		batch._vertices.reserve(batch._vertices.size() + mesh._vertices.size());
+		for (const Vertex& vertex : mesh._vertices)
+		{
+			Vertex transformed = vertex;
+			transformed.position = glm::vec3(source.world * glm::vec4(vertex.position, 1.f));
+			const glm::vec3 normal = normalMatrix * vertex.normal;
+			const float length = glm::length(normal);
+			transformed.normal = length > 0.f ? normal / length : normal;
+			batch._vertices.push_back(transformed);
+		}
+
+		const MeshLod level = mesh.get_lod(0);
+		MeshSurface surface = {};
+		surface.firstIndex = static_cast<uint32_t>(batch._indices.size());
+		surface.indexCount = level.indexCount;
+		batch._indices.reserve(batch._indices.size() + level.indexCount);
+		for (uint32_t i = 0; i < level.indexCount; i++)
+		{
+			batch._indices.push_back(firstVertex + mesh._indices[level.firstIndex + i]);
+		}
+		batch._surfaces.push_back(surface);
+	}
+
+	void finish_batch(StaticBatch& batch)
+	{
+		Mesh& mesh = batch.mesh;
+		mesh.update_index_type();
+		mesh.compute_bounds();
+		// a cluster per source, bounded by its surface; sources may face every way, so no cone test
+		mesh._clusters.reserve(mesh._surfaces.size());
+		for (const MeshSurface& surface : mesh._surfaces)
+		{
+			MeshCluster cluster = {};
+			cluster.firstIndex = surface.firstIndex;
+			cluster.indexCount = surface.indexCount;
+			cluster.bounds = surface.bounds;
+			cluster.coneCutoff = 2.f;
+			mesh._clusters.push_back(cluster);
+		}
+	}
+}
+
+std::vector<StaticBatch> build_static_batches(const std::vector<StaticBatchSource>& sources, const StaticBatchSettings& settings)
+{
+	// an ordered map, so the batches come out the same from run to run
+	std::map<BatchKey, std::vector<uint32_t>> cells;
+	for (uint32_t i = 0; i < sources.size(); i++)
+	{
+		const StaticBatchSource& source = sources[i];
+		if (!batchable(*source.mesh, settings.maxVertices))
+		{
+			continue;
+		}
+		const glm::vec3 center = glm::vec3(source.world * glm::vec4(source.mesh->_bounds.origin, 1.f)) / settings.cellSize;
+		cells[BatchKey(source.key, static_cast<int32_t>(std::floor(center.x)), static_cast<int32_t>(std::floor(center.y)),
+			static_cast<int32_t>(std::floor(center.z)))].push_back(i);
+	}
+
+	std::vector<StaticBatch> batches;
+	for (const auto& cell : cells)
+	{
+		const std::vector<uint32_t>& members = cell.second;
+		if (members.size() < settings.minSources)
+		{
+			continue;
+		}
+
+		// the cell's sources in order, a new batch whenever the next one would pass maxVertices
+		size_t first = 0;
+		while (first < members.size())
+		{
+			size_t end = first;
+			size_t vertices = 0;
+			while (end < members.size() && vertices + sources[members[end]].mesh->_vertices.size() <= settings.maxVertices)
+			{
+				vertices += sources[members[end]].mesh->_vertices.size();
+				end++;
+			}
+			if (end - first >= settings.minSources)
+			{
+				StaticBatch batch;
+				batch.key = std::get<0>(cell.first);
+				batch.mesh._material = sources[members[first]].mesh->_material;
+				for (size_t m = first; m < end; m++)
+				{
+					append_source(batch.mesh, sources[members[m]]);
+					batch.sources.push_back(members[m]);
+				}
+				finish_batch(batch);
+				batch.mesh.set_vertex_format(sources[members[first]].mesh->_vertexFormat);
+				batches.push_back(std::move(batch));
+			}
+			first = end;
+		}
+	}
+	return batches;
+}
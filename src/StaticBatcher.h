@@ -0,0 +1,40 @@
+#pragma once
+
+#include <Mesh.h>
+
+#include <cstdint>
+#include <vector>
+#include <glm/mat4x4.hpp>
+
+// one static object as the batcher sees it: its mesh's full-detail level under world, and what it must
+// share with the others of a batch (the engine passes its material)
+struct StaticBatchSource {
+	const Mesh* mesh;
+	glm::mat4 world;
+	uint32_t key;
+};
+
+struct StaticBatchSettings {
+	// sources are batched with the others of their key inside the same cube of the world grid, so batches
+	// stay small enough for their bounds to cull
+	float cellSize{ 32.f };
+	// a batch closes at this many vertices; 65536 keeps every batch on 16-bit indices
+	uint32_t maxVertices{ 65536 };
+	// fewer sources than this in a cell aren't worth a mesh of their own and stay as they are
+	uint32_t minSources{ 2 };
+};
+
+// a merged mesh in world space, with one surface and one cluster per source in the order of sources, so
+// culling still sees each source's own bounds; no LODs, only the sources' level 0
+struct StaticBatch {
+	Mesh mesh;
+	uint32_t key;
+	std::vector<uint32_t> sources; // indices into the sources given to build_static_batches
+};
+
+// Load-time merge of immutable geometry: sources sharing a key and a grid cell become one mesh with their
+// vertices pre-transformed to world space (normals by the inverse transpose) and their indices rebased, drawn
+// with an identity transform. The meshes come out in the vertex format of their first source, with index type
+// and bounds set and ready to upload. Sources need their CPU-side vertices and indices; ones without them,
+// skinned ones and ones that would overflow a batch alone are left out of every batch.
+std::vector<StaticBatch> build_static_batches(const std::vector<StaticBatchSource>& sources, const StaticBatchSettings& settings = {});
@@ -0,0 +1,176 @@
+#include "TemporalUpscaler.h"
+
+#include "vk_initializers.h"
+
+#include <cassert>
+
+namespace {
+	// matches the push constants of taaResolve.comp
+	struct ResolvePushConstants {
+		glm::mat4 reprojection;
+		float jitter[2];
+		uint32_t region[2];
+		uint32_t outputSize[2];
+		float blend;
+		uint32_t historyValid;
+	};
+
+	// index's digits in base mirrored around the point, in 0..1
+	float radical_inverse(uint32_t index, uint32_t base)
+	{
+		float result = 0.0f;
+		float digit = 1.0f / base;
+		for (; index > 0; index /= base)
+		{
+			result += (index % base) * digit;
+			digit /= base;
+		}
+		return result;
+	}
+}
+
+void TemporalUpscaler::init(VkDevice device, VmaAllocator allocator, LayoutCache& layouts, DescriptorSetCache& sets, VkShaderModule resolveShader,
+	VkPipelineCache cache)
+{
+	_device = device;
+	_allocator = allocator;
+	_sets = &sets;
+
+	_setLayout = layouts.set_layout({
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0), // scene color
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 1), // depth
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 2), // history
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 3), // output
+	});
+
+	VkPushConstantRange pushConstant;
+	pushConstant.offset = 0;
+	pushConstant.size = sizeof(ResolvePushConstants);
+	pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkPipelineLayoutCreateInfo layoutInfo = vkinit::pipeline_layout_create_info();
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &_setLayout;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushConstant;
+	VK_CHECK(vkCreatePipelineLayout(_device, &layoutInfo, nullptr, &_pipelineLayout));
+
+	if (resolveShader != VK_NULL_HANDLE)
+	{
+		VkComputePipelineCreateInfo pipelineInfo = {};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.pNext = nullptr;
+		pipelineInfo.layout = _pipelineLayout;
+		pipelineInfo.stage = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, resolveShader);
+		VK_CHECK(vkCreateComputePipelines(_device, cache, 1, &pipelineInfo, nullptr, &_pipeline));
+	}
+
+	VkSamplerCreateInfo pointInfo = vkinit::sampler_create_info(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+	pointInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	_pointSampler = layouts.sampler(pointInfo);
+	VkSamplerCreateInfo linearInfo = vkinit::sampler_create_info(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+	linearInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	_linearSampler = layouts.sampler(linearInfo);
+}
+
+void TemporalUpscaler::cleanup()
+{
+	destroy_images();
+	// the sets go with the set cache, the set layout and the samplers with the layout cache
+	vkDestroyPipeline(_device, _pipeline, nullptr);
+	vkDestroyPipelineLayout(_device, _pipelineLayout, nullptr);
+}
+
+void TemporalUpscaler::resize(VkExtent2D outputExtent)
+{
+	destroy_images();
+
+	_extent = outputExtent;
+	// sampled as the history and by the post chain, blitted to the swapchain without it
+	const VkImageUsageFlags usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	VkImageCreateInfo imageInfo = vkinit::image_create_info(FORMAT, usage, { _extent.width, _extent.height, 1 });
+
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+	allocInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		VK_CHECK(vmaCreateImage(_allocator, &imageInfo, &allocInfo, &_images[i]._image, &_images[i]._allocation, nullptr));
+		VkImageViewCreateInfo viewInfo = vkinit::imageview_create_info(FORMAT, _images[i]._image, VK_IMAGE_ASPECT_COLOR_BIT);
+		VK_CHECK(vkCreateImageView(_device, &viewInfo, nullptr, &_views[i]));
+	}
+	_historyValid = false;
+}
+
+void TemporalUpscaler::clear(VkCommandBuffer cmd) const
+{
+	// the contents don't matter until a record() wrote them
+	VkImageMemoryBarrier barriers[2];
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		barriers[i] = vkinit::image_barrier(_images[i]._image, 0, VK_ACCESS_SHADER_READ_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+	}
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 2, barriers);
+}
+
+glm::vec2 TemporalUpscaler::jitter(uint64_t frame)
+{
+	// Halton starts at index 1; index 0 would be the pixel's corner every cycle
+	const uint32_t index = static_cast<uint32_t>(frame % JITTER_PHASES) + 1;
+	return glm::vec2(radical_inverse(index, 2), radical_inverse(index, 3)) - 0.5f;
+}
+
+void TemporalUpscaler::record(VkCommandBuffer cmd, uint32_t frame, VkImageView scene, VkImageView depth, VkExtent2D region, glm::vec2 jitter,
+	const glm::mat4& reprojection) const
+{
+	assert(_pipeline != VK_NULL_HANDLE);
+
+	const DescriptorWrite writes[] = {
+		DescriptorWrite::image_write(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _pointSampler, scene, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+		DescriptorWrite::image_write(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _pointSampler, depth, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+		DescriptorWrite::image_write(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _linearSampler, history_view(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+		DescriptorWrite::image_write(3, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_NULL_HANDLE, output_view(), VK_IMAGE_LAYOUT_GENERAL),
+	};
+	VkDescriptorSet set = _sets->get(frame, _setLayout, writes, 4);
+
+	ResolvePushConstants constants = {};
+	constants.reprojection = reprojection;
+	constants.jitter[0] = jitter.x;
+	constants.jitter[1] = jitter.y;
+	constants.region[0] = region.width;
+	constants.region[1] = region.height;
+	constants.outputSize[0] = _extent.width;
+	constants.outputSize[1] = _extent.height;
+	constants.blend = _blend;
+	constants.historyValid = _historyValid ? 1 : 0;
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout, 0, 1, &set, 0, nullptr);
+	vkCmdPushConstants(cmd, _pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ResolvePushConstants), &constants);
+	vkCmdDispatch(cmd, (_extent.width + 7) / 8, (_extent.height + 7) / 8, 1);
+}
+
+void TemporalUpscaler::advance()
+{
+	_current = 1 - _current;
+	_historyValid = true;
+}
+
+void TemporalUpscaler::destroy_images()
+{
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		if (_images[i]._image == VK_NULL_HANDLE)
+		{
+			continue;
+		}
+		vkDestroyImageView(_device, _views[i], nullptr);
+		vmaDestroyImage(_allocator, _images[i]._image, _images[i]._allocation);
+		_images[i] = {};
+		_views[i] = VK_NULL_HANDLE;
+	}
+	_extent = { 0, 0 };
+	// the cached sets name the views; a new one may come back with an old handle
+	_sets->invalidate();
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vk_types.h>
+#include <DescriptorSetCache.h>
+#include <LayoutCache.h>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+
+#include <vector>
+
+// Temporal upscaling for dynamic resolution. The scene renders into part of its target with the camera's
+// projection offset by a different sub-pixel jitter() every frame, and record() accumulates those samples
+// at the output resolution into a history that persists across frames: each output pixel finds where it
+// was the frame before through the depth buffer and the two frames' unjittered view-projections, fetches
+// the history there, clamps it to the colors of this frame's samples around it, which rejects whatever was
+// uncovered or changed, and blends this frame's samples in. Still parts of the image converge on the output
+// resolution within a few frames; anything new starts at the render resolution.
+// The reprojection only knows the camera's motion, since the scene's objects don't move between frames;
+// anything that does is kept from smearing by the clamp alone.
+// Two images take turns: the one the last frame wrote is read as the history while the other is written.
+// Both are in SHADER_READ_ONLY_OPTIMAL between frames.
+class TemporalUpscaler
+{
+public:
+	static constexpr VkFormat FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+	static constexpr uint32_t JITTER_PHASES = 8;
+
+	// without a shader there is no pipeline and record() must not be called
+	void init(VkDevice device, VmaAllocator allocator, LayoutCache& layouts, DescriptorSetCache& sets, VkShaderModule resolveShader,
+		VkPipelineCache cache);
+	void cleanup();
+
+	bool ready() const { return _pipeline != VK_NULL_HANDLE; }
+
+	// (re)creates both images at the output size; nothing may be using the old ones. The next record()
+	// ignores the history
+	void resize(VkExtent2D outputExtent);
+	// both images into SHADER_READ_ONLY_OPTIMAL, visible to compute; needed once after resize()
+	void clear(VkCommandBuffer cmd) const;
+	// the next record() starts over from its own frame, for when the last one has nothing to do with it
+	void reset() { _historyValid = false; }
+
+	// the sub-pixel offset of frame's samples, in render pixels, each component within -0.5..0.5: the
+	// Halton (2, 3) sequence, repeating every JITTER_PHASES frames
+	static glm::vec2 jitter(uint64_t frame);
+
+	// inside a compute pass: region of scene and of depth, both SHADER_READ_ONLY_OPTIMAL and rendered
+	// with jitter, over the history into output(), which is in GENERAL. reprojection takes this frame's
+	// unjittered clip space to the last frame's. Takes its set from the set cache's frame slot it is given,
+	// which holds one for each of the two images as the history
+	void record(VkCommandBuffer cmd, uint32_t frame, VkImageView scene, VkImageView depth, VkExtent2D region, glm::vec2 jitter,
+		const glm::mat4& reprojection) const;
+	// after the frame's record(): what it wrote becomes the next frame's history
+	void advance();
+
+	float _blend{ 0.1f }; // how much of each pixel this frame's samples make up once the history is valid
+
+	VkImage history_image() const { return _images[1 - _current]._image; }
+	VkImageView history_view() const { return _views[1 - _current]; }
+	VkImage output_image() const { return _images[_current]._image; }
+	VkImageView output_view() const { return _views[_current]; }
+	VkExtent2D extent() const { return _extent; }
+
+private:
+	void destroy_images();
+
+	VkDevice _device{ VK_NULL_HANDLE };
+	VmaAllocator _allocator{ nullptr };
+
+	DescriptorSetCache* _sets{ nullptr };
+	VkDescriptorSetLayout _setLayout{ VK_NULL_HANDLE }; // the layout cache's, like the samplers
+	VkPipelineLayout _pipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline _pipeline{ VK_NULL_HANDLE };
+	VkSampler _pointSampler{ VK_NULL_HANDLE }; // this frame's samples, fetched one by one
+	VkSampler _linearSampler{ VK_NULL_HANDLE }; // the history, between whose texels the reprojection lands
+
+	AllocatedImage _images[2]{};
+	VkImageView _views[2]{ VK_NULL_HANDLE, VK_NULL_HANDLE };
+	VkExtent2D _extent{ 0, 0 };
+	uint32_t _current{ 0 }; // the image the next record() writes
+	bool _historyValid{ false };
+};
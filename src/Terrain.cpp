@@ -0,0 +1,631 @@
+#include "Terrain.h"
+
+#include "JobSystem.h"
+#include "Log.h"
+#include "MappedFile.h"
+#include "vk_initializers.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/vector_relational.hpp>
+
+namespace {
+	// terrain.vert's push constants
+	struct TerrainDrawConstants {
+		glm::vec4 grid; // x world units between samples, y the world x and z of the first, z the last sample's index
+		glm::vec4 height; // x the lowest sample's height, y world units per 16-bit step
+	};
+
+	// of the last part of a level's range, over which its grid morphs into the parent's
+	constexpr float MORPH_START = 0.7f;
+
+	// skips whitespace and '#' comments in a PGM header, then reads a decimal number; 0 once the header runs out
+	uint32_t pgm_number(const uint8_t* data, size_t size, size_t& at)
+	{
+		while (at < size && (std::isspace(data[at]) || data[at] == '#'))
+		{
+			if (data[at] == '#')
+			{
+				while (at < size && data[at] != '\n')
+				{
+					at++;
+				}
+			}
+			else
+			{
+				at++;
+			}
+		}
+		uint32_t value = 0;
+		while (at < size && std::isdigit(data[at]) && value < 1000000)
+		{
+			value = value * 10 + (data[at++] - '0');
+		}
+		return value;
+	}
+
+	float lattice(int32_t x, int32_t y, uint32_t seed)
+	{
+		uint32_t h = static_cast<uint32_t>(x) * 0x8da6b343u ^ static_cast<uint32_t>(y) * 0xd8163841u ^ seed * 0xcb1ab31fu;
+		h ^= h >> 15;
+		h *= 0x2c1b3c6du;
+		h ^= h >> 12;
+		return static_cast<float>(h & 0xffffff) / float(0xffffff);
+	}
+
+	// smoothly interpolated lattice noise in [0, 1]
+	float value_noise(float x, float y, uint32_t seed)
+	{
+		const float fx = std::floor(x);
+		const float fy = std::floor(y);
+		const int32_t ix = static_cast<int32_t>(fx);
+		const int32_t iy = static_cast<int32_t>(fy);
+		const float tx = x - fx;
+		const float ty = y - fy;
+		const float sx = tx * tx * (3.0f - 2.0f * tx);
+		const float sy = ty * ty * (3.0f - 2.0f * ty);
+		const float a = glm::mix(lattice(ix, iy, seed), lattice(ix + 1, iy, seed), sx);
+		const float b = glm::mix(lattice(ix, iy + 1, seed), lattice(ix + 1, iy + 1, seed), sx);
+		return glm::mix(a, b, sy);
+	}
+
+	// -1: outside, 0: intersecting, 1: inside every plane; Bvh's test, which is private to its tree
+	int classify(const glm::vec3& min, const glm::vec3& max, const glm::vec4 planes[6])
+	{
+		int result = 1;
+		for (int i = 0; i < 6; i++)
+		{
+			const glm::vec3 normal = glm::vec3(planes[i]);
+			const glm::vec3 positive = glm::mix(min, max, glm::greaterThanEqual(normal, glm::vec3(0.0f)));
+			const glm::vec3 negative = glm::mix(max, min, glm::greaterThanEqual(normal, glm::vec3(0.0f)));
+			if (glm::dot(normal, positive) + planes[i].w < 0.0f)
+			{
+				return -1;
+			}
+			if (glm::dot(normal, negative) + planes[i].w < 0.0f)
+			{
+				result = 0;
+			}
+		}
+		return result;
+	}
+
+	float box_distance(const glm::vec3& point, const glm::vec3& min, const glm::vec3& max)
+	{
+		return glm::length(glm::clamp(point, min, max) - point);
+	}
+}
+
+bool Heightfield::load_pgm(const char* path)
+{
+	_side = 0;
+	_heights.clear();
+
+	MappedFile file;
+	if (!file.open(path))
+	{
+		LOG_ERROR("Couldn't open heightfield " << path);
+		return false;
+	}
+	const uint8_t* data = file.data();
+	const size_t size = file.size();
+	if (size < 2 || data[0] != 'P' || data[1] != '5')
+	{
+		LOG_ERROR(path << " isn't a binary PGM");
+		return false;
+	}
+	size_t at = 2;
+	const uint32_t width = pgm_number(data, size, at);
+	const uint32_t height = pgm_number(data, size, at);
+	const uint32_t maxValue = pgm_number(data, size, at);
+	// a single whitespace character ends the header
+	at++;
+	const size_t sampleBytes = maxValue > 255 ? 2 : 1;
+	if (width < 2 || width != height || maxValue == 0 || maxValue > 65535 || at + size_t(width) * height * sampleBytes > size)
+	{
+		LOG_ERROR(path << " isn't a square heightfield of at least 2x2 samples");
+		return false;
+	}
+
+	_side = width;
+	_heights.resize(size_t(width) * height);
+	const uint8_t* samples = data + at;
+	parallel_for(height, [&](size_t y) {
+		for (size_t x = 0; x < width; x++)
+		{
+			const size_t i = y * width + x;
+			// big-endian, as the format stores them
+			const uint32_t value = sampleBytes == 2 ? (uint32_t(samples[i * 2]) << 8) | samples[i * 2 + 1] : samples[i];
+			_heights[i] = static_cast<uint16_t>(std::min(value, maxValue) * 65535u / maxValue);
+		}
+	});
+	return true;
+}
+
+void Heightfield::generate(uint32_t side, uint32_t seed)
+{
+	_side = std::max(side, 2u);
+	std::vector<float> heights(size_t(_side) * _side);
+	parallel_for(_side, [&](size_t y) {
+		for (size_t x = 0; x < _side; x++)
+		{
+			// a few hills across the whole field, each octave half the size and a little less than half the height
+			float frequency = 6.0f / float(_side - 1);
+			float amplitude = 1.0f;
+			float sum = 0.0f;
+			for (uint32_t octave = 0; octave < 8; octave++)
+			{
+				sum += value_noise(x * frequency, y * frequency, seed + octave) * amplitude;
+				frequency *= 2.0f;
+				amplitude *= 0.45f;
+			}
+			heights[y * _side + x] = sum;
+		}
+	});
+
+	const auto range = std::minmax_element(heights.begin(), heights.end());
+	const float low = *range.first;
+	const float scale = *range.second > low ? 1.0f / (*range.second - low) : 0.0f;
+	_heights.resize(heights.size());
+	for (size_t i = 0; i < heights.size(); i++)
+	{
+		// flattened valleys and steeper peaks, as eroded ground has
+		const float h = std::pow((heights[i] - low) * scale, 1.6f);
+		_heights[i] = static_cast<uint16_t>(h * 65535.0f + 0.5f);
+	}
+}
+
+uint16_t Heightfield::at(int64_t x, int64_t y) const
+{
+	const int64_t last = int64_t(_side) - 1;
+	return _heights[size_t(std::clamp<int64_t>(y, 0, last)) * _side + size_t(std::clamp<int64_t>(x, 0, last))];
+}
+
+bool Terrain::init(VkDevice device, VmaAllocator allocator, DescriptorAllocator& descriptors, const TerrainSettings& settings, uint32_t frameCount)
+{
+	_settings = settings;
+	if (_settings.path.empty())
+	{
+		_heightfield.generate(_settings.samples);
+	}
+	else if (!_heightfield.load_pgm(_settings.path.c_str()))
+	{
+		return false;
+	}
+	_device = device;
+	_allocator = allocator;
+
+	const uint32_t quads = _heightfield.side() - 1;
+	_spacing = _settings.size / float(quads);
+	const float leafSize = PATCH * _spacing;
+	const float lodDistance = _settings.lodDistance > 0.0f ? _settings.lodDistance : 3.0f * leafSize;
+
+	// levels up to the first with a single node over the whole field
+	const uint32_t leaves = (quads + PATCH - 1) / PATCH;
+	_levels.clear();
+	uint32_t nodeCount = 0;
+	for (uint32_t level = 0; level == 0 || _levels.back().nodesPerSide > 1; level++)
+	{
+		const uint32_t nodesPerSide = (leaves + (1u << level) - 1) >> level;
+		_levels.push_back({ nodesPerSide, nodeCount, lodDistance * float(1u << level) });
+		nodeCount += nodesPerSide * nodesPerSide;
+	}
+	_nodeSlots.assign(nodeCount, NO_SLOT);
+	compute_bounds();
+
+	// every level's nodes around the camera and some to spare; fewer would have the coarsest levels fight over them
+	_slots.assign(std::max(_settings.cacheTiles, level_count() * 8), Slot{});
+	_wanted.clear();
+	_staged.clear();
+	_newestUpload = 0;
+	_acquiredValue = 0;
+
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.pNext = nullptr;
+	bufferInfo.size = memory_bytes();
+	bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	VmaAllocationCreateInfo deviceAllocInfo = {};
+	deviceAllocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+	VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &deviceAllocInfo, &_tiles._buffer, &_tiles._allocation, nullptr));
+
+	// written once here and by the CPU every frame; both are small and read once by the vertex fetch
+	VmaAllocationCreateInfo hostAllocInfo = {};
+	hostAllocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+	hostAllocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+	VmaAllocationInfo mappedInfo;
+
+	// two triangles per quad, wound counter-clockwise seen from above; vertex i is at (i % (PATCH + 1), i / (PATCH + 1))
+	bufferInfo.size = VkDeviceSize(PATCH) * PATCH * 6 * sizeof(uint16_t);
+	bufferInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+	VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &hostAllocInfo, &_grid._buffer, &_grid._allocation, &mappedInfo));
+	uint16_t* indices = static_cast<uint16_t*>(mappedInfo.pMappedData);
+	for (uint32_t y = 0; y < PATCH; y++)
+	{
+		for (uint32_t x = 0; x < PATCH; x++)
+		{
+			const uint16_t corner = static_cast<uint16_t>(y * (PATCH + 1) + x);
+			const uint16_t below = static_cast<uint16_t>(corner + PATCH + 1);
+			const uint16_t quad[6] = { corner, below, uint16_t(corner + 1), uint16_t(corner + 1), below, uint16_t(below + 1) };
+			memcpy(indices + (y * PATCH + x) * 6, quad, sizeof(quad));
+		}
+	}
+	vmaFlushAllocation(_allocator, _grid._allocation, 0, VK_WHOLE_SIZE);
+
+	bufferInfo.size = VkDeviceSize(MAX_NODES) * std::max(frameCount, 1u) * sizeof(GpuTerrainNode);
+	bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+	VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &hostAllocInfo, &_instances._buffer, &_instances._allocation, &mappedInfo));
+	_instances._mapped = mappedInfo.pMappedData;
+	_frame = 0;
+	_nodeCount = 0;
+
+	VkDescriptorSetLayoutBinding binding = vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0);
+	VkDescriptorSetLayoutCreateInfo setInfo = {};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setInfo.pNext = nullptr;
+	setInfo.bindingCount = 1;
+	setInfo.pBindings = &binding;
+	VK_CHECK(vkCreateDescriptorSetLayout(_device, &setInfo, nullptr, &_setLayout));
+
+	descriptors.allocate(&_set, _setLayout);
+	VkDescriptorBufferInfo tilesInfo = { _tiles._buffer, 0, VK_WHOLE_SIZE };
+	VkWriteDescriptorSet write = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _set, &tilesInfo, 0);
+	vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+
+	LOG_INFO("Terrain: " << _heightfield.side() << "x" << _heightfield.side() << " samples in " << level_count() << " levels, "
+		<< _slots.size() << " tiles cached (" << memory_bytes() / 1024 << " KiB)");
+	return true;
+}
+
+void Terrain::cleanup()
+{
+	for (AllocatedBuffer* buffer : { &_tiles, &_grid, &_instances })
+	{
+		if (buffer->_buffer != VK_NULL_HANDLE)
+		{
+			vmaDestroyBuffer(_allocator, buffer->_buffer, buffer->_allocation);
+			*buffer = {};
+		}
+	}
+	if (_setLayout != VK_NULL_HANDLE)
+	{
+		vkDestroyDescriptorSetLayout(_device, _setLayout, nullptr);
+		_setLayout = VK_NULL_HANDLE;
+	}
+	_set = VK_NULL_HANDLE;
+	_slots.clear();
+	_nodeSlots.clear();
+	_selected.clear();
+	_nodeCount = 0;
+}
+
+bool Terrain::node_exists(uint32_t level, uint32_t x, uint32_t y) const
+{
+	const uint32_t quads = _heightfield.side() - 1;
+	return x < _levels[level].nodesPerSide && y < _levels[level].nodesPerSide && node_origin(level, x) < quads && node_origin(level, y) < quads;
+}
+
+void Terrain::node_box(uint32_t level, uint32_t x, uint32_t y, glm::vec3& min, glm::vec3& max) const
+{
+	// the grid stops at the field's last sample; terrain.vert folds the rest of it onto the edge
+	const uint32_t quads = _heightfield.side() - 1;
+	const float corner = -0.5f * _settings.size;
+	const uint32_t node = node_index(level, x, y);
+	const float heightScale = _settings.height / 65535.0f;
+	min = glm::vec3(corner + node_origin(level, x) * _spacing, _settings.baseHeight + _bounds[node * 2] * heightScale,
+		corner + node_origin(level, y) * _spacing);
+	max = glm::vec3(corner + std::min(node_origin(level, x + 1), quads) * _spacing, _settings.baseHeight + _bounds[node * 2 + 1] * heightScale,
+		corner + std::min(node_origin(level, y + 1), quads) * _spacing);
+}
+
+bool Terrain::resident(uint32_t node) const
+{
+	const uint32_t slot = _nodeSlots[node];
+	return slot != NO_SLOT && _slots[slot].uploadValue != 0 && _slots[slot].uploadValue <= _acquiredValue;
+}
+
+void Terrain::compute_bounds()
+{
+	_bounds.assign(_nodeSlots.size() * 2, 0);
+	const Level& leaves = _levels[0];
+	const uint32_t last = _heightfield.side() - 1;
+	parallel_for(leaves.nodesPerSide, [&](size_t row) {
+		const uint32_t y = static_cast<uint32_t>(row);
+		for (uint32_t x = 0; x < leaves.nodesPerSide; x++)
+		{
+			uint16_t low = UINT16_MAX;
+			uint16_t high = 0;
+			for (uint32_t sy = node_origin(0, y); sy <= std::min(node_origin(0, y + 1), last); sy++)
+			{
+				for (uint32_t sx = node_origin(0, x); sx <= std::min(node_origin(0, x + 1), last); sx++)
+				{
+					const uint16_t h = _heightfield.at(sx, sy);
+					low = std::min(low, h);
+					high = std::max(high, h);
+				}
+			}
+			const uint32_t node = node_index(0, x, y);
+			_bounds[node * 2] = low;
+			_bounds[node * 2 + 1] = high;
+		}
+	});
+
+	// a coarser grid only samples what's under it, so its children's bounds hold it too
+	for (uint32_t level = 1; level < level_count(); level++)
+	{
+		for (uint32_t y = 0; y < _levels[level].nodesPerSide; y++)
+		{
+			for (uint32_t x = 0; x < _levels[level].nodesPerSide; x++)
+			{
+				uint16_t low = UINT16_MAX;
+				uint16_t high = 0;
+				for (uint32_t child = 0; child < 4; child++)
+				{
+					const uint32_t cx = x * 2 + (child & 1);
+					const uint32_t cy = y * 2 + (child >> 1);
+					if (node_exists(level - 1, cx, cy))
+					{
+						const uint32_t node = node_index(level - 1, cx, cy);
+						low = std::min(low, _bounds[node * 2]);
+						high = std::max(high, _bounds[node * 2 + 1]);
+					}
+				}
+				const uint32_t node = node_index(level, x, y);
+				_bounds[node * 2] = low;
+				_bounds[node * 2 + 1] = high;
+			}
+		}
+	}
+}
+
+void Terrain::select(const glm::vec3& eye, const glm::vec4 planes[6], uint32_t frame, uint64_t frameNumber, uint64_t acquiredValue)
+{
+	_frame = frame;
+	_nodeCount = 0;
+	_selected.clear();
+	_eye = eye;
+	_planes = planes;
+	_frameNumber = frameNumber;
+	_acquiredValue = acquiredValue;
+	_wanted.clear();
+	if (!ready())
+	{
+		return;
+	}
+
+	const uint32_t top = level_count() - 1;
+	const uint32_t root = node_index(top, 0, 0);
+	if (!resident(root))
+	{
+		want(top, 0, 0);
+		return;
+	}
+	// the root stands in for everything, so it never leaves the cache
+	_slots[_nodeSlots[root]].lastUsed = frameNumber;
+	// past even the coarsest level's range it's still the root that's drawn
+	if (!select_node(top, 0, 0, false))
+	{
+		push_node(top, 0, 0);
+	}
+}
+
+bool Terrain::select_node(uint32_t level, uint32_t x, uint32_t y, bool inside)
+{
+	glm::vec3 min;
+	glm::vec3 max;
+	node_box(level, x, y, min, max);
+	if (!inside)
+	{
+		const int side = classify(min, max, _planes);
+		if (side < 0)
+		{
+			return true;
+		}
+		inside = side > 0;
+	}
+	if (box_distance(_eye, min, max) > _levels[level].range)
+	{
+		return false;
+	}
+
+	_slots[_nodeSlots[node_index(level, x, y)]].lastUsed = _frameNumber;
+	if (level == 0 || box_distance(_eye, min, max) > _levels[level - 1].range)
+	{
+		push_node(level, x, y);
+		return true;
+	}
+
+	// part of it is in the finer level's range: the children draw it once all the visible ones have their tiles
+	bool childrenResident = true;
+	for (uint32_t child = 0; child < 4; child++)
+	{
+		const uint32_t cx = x * 2 + (child & 1);
+		const uint32_t cy = y * 2 + (child >> 1);
+		if (!node_exists(level - 1, cx, cy) || resident(node_index(level - 1, cx, cy)))
+		{
+			continue;
+		}
+		glm::vec3 childMin;
+		glm::vec3 childMax;
+		node_box(level - 1, cx, cy, childMin, childMax);
+		if (inside || classify(childMin, childMax, _planes) >= 0)
+		{
+			want(level - 1, cx, cy);
+			childrenResident = false;
+		}
+	}
+	if (!childrenResident)
+	{
+		push_node(level, x, y);
+		return true;
+	}
+
+	for (uint32_t child = 0; child < 4; child++)
+	{
+		const uint32_t cx = x * 2 + (child & 1);
+		const uint32_t cy = y * 2 + (child >> 1);
+		// a child out of its own range is this node's grid over that quarter, which its fully morphed grid is
+		if (node_exists(level - 1, cx, cy) && !select_node(level - 1, cx, cy, inside))
+		{
+			_slots[_nodeSlots[node_index(level - 1, cx, cy)]].lastUsed = _frameNumber;
+			push_node(level - 1, cx, cy);
+		}
+	}
+	return true;
+}
+
+void Terrain::push_node(uint32_t level, uint32_t x, uint32_t y)
+{
+	if (_nodeCount >= MAX_NODES)
+	{
+		return;
+	}
+	const float end = _levels[level].range;
+	const float previous = level > 0 ? _levels[level - 1].range : 0.0f;
+	GpuTerrainNode& instance = static_cast<GpuTerrainNode*>(_instances._mapped)[size_t(_frame) * MAX_NODES + _nodeCount++];
+	instance.node = glm::vec4(float(node_origin(level, x)), float(node_origin(level, y)), float(1u << level), float(level));
+	instance.morph = glm::vec2(glm::mix(previous, end, MORPH_START), end);
+	instance.slot = static_cast<float>(_nodeSlots[node_index(level, x, y)]);
+	instance.pad = 0.0f;
+	_selected.push_back(instance);
+}
+
+void Terrain::want(uint32_t level, uint32_t x, uint32_t y)
+{
+	const uint32_t node = node_index(level, x, y);
+	// staged already, on its way
+	if (_nodeSlots[node] != NO_SLOT)
+	{
+		return;
+	}
+	glm::vec3 min;
+	glm::vec3 max;
+	node_box(level, x, y, min, max);
+	_wanted.push_back({ node, level, box_distance(_eye, min, max) });
+}
+
+bool Terrain::request_tiles(UploadManager& uploads, uint64_t frameNumber, uint32_t frameOverlap)
+{
+	if (_wanted.empty())
+	{
+		return false;
+	}
+
+	// each level is the fallback of everything finer under it; within one, nearest first
+	std::sort(_wanted.begin(), _wanted.end(), [](const WantedTile& a, const WantedTile& b) {
+		return a.level != b.level ? a.level > b.level : a.distance < b.distance;
+	});
+
+	const VkDeviceSize tileBytes = VkDeviceSize(TILE_WORDS) * sizeof(uint32_t);
+	size_t staged = 0;
+	while (staged < _wanted.size() && staged < MAX_TILE_UPLOADS)
+	{
+		// an empty slot, or the least recently drawn whose last frame is finished and whose tile is in
+		uint32_t slot = NO_SLOT;
+		for (uint32_t i = 0; i < _slots.size(); i++)
+		{
+			const Slot& candidate = _slots[i];
+			if (candidate.node == NO_SLOT)
+			{
+				slot = i;
+				break;
+			}
+			if (candidate.lastUsed + frameOverlap <= frameNumber && candidate.uploadValue != 0 && candidate.uploadValue <= _acquiredValue
+				&& (slot == NO_SLOT || candidate.lastUsed < _slots[slot].lastUsed))
+			{
+				slot = i;
+			}
+		}
+		const WantedTile tile = _wanted[staged];
+		const UploadPriority priority = tile.level + 1 == level_count() ? UploadPriority::Visible : UploadPriority::Prefetch;
+		if (slot == NO_SLOT || !uploads.admit(tileBytes, priority))
+		{
+			break;
+		}
+
+		Slot& entry = _slots[slot];
+		if (entry.node != NO_SLOT)
+		{
+			_nodeSlots[entry.node] = NO_SLOT;
+		}
+		entry.node = tile.node;
+		entry.lastUsed = frameNumber;
+		entry.uploadValue = 0;
+		_nodeSlots[tile.node] = slot;
+		_staged.push_back(slot);
+		const uint32_t node = tile.node;
+		uploads.upload_buffer(_tiles._buffer, slot * tileBytes, tileBytes,
+			[this, node](void* data) { write_tile(node, static_cast<uint32_t*>(data)); },
+			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		staged++;
+	}
+
+	// the rest stay requested and wait for the next frame
+	_wanted.erase(_wanted.begin(), _wanted.begin() + staged);
+	return staged > 0;
+}
+
+void Terrain::set_upload_value(uint64_t value)
+{
+	for (uint32_t slot : _staged)
+	{
+		_slots[slot].uploadValue = value;
+	}
+	if (!_staged.empty())
+	{
+		_newestUpload = value;
+	}
+	_staged.clear();
+}
+
+bool Terrain::streaming() const
+{
+	return !_wanted.empty() || !_staged.empty() || _newestUpload > _acquiredValue;
+}
+
+void Terrain::write_tile(uint32_t node, uint32_t* words) const
+{
+	uint32_t level = 0;
+	while (level + 1 < level_count() && _levels[level + 1].firstNode <= node)
+	{
+		level++;
+	}
+	const uint32_t index = node - _levels[level].firstNode;
+	const int64_t stride = int64_t(1) << level;
+	const int64_t originX = node_origin(level, index % _levels[level].nodesPerSide);
+	const int64_t originY = node_origin(level, index / _levels[level].nodesPerSide);
+
+	memset(words, 0, TILE_WORDS * sizeof(uint32_t));
+	for (uint32_t ty = 0; ty < TILE_SIDE; ty++)
+	{
+		for (uint32_t tx = 0; tx < TILE_SIDE; tx++)
+		{
+			// the border sample sits one stride outside the grid
+			const uint32_t sample = ty * TILE_SIDE + tx;
+			const uint16_t h = _heightfield.at(originX + (int64_t(tx) - 1) * stride, originY + (int64_t(ty) - 1) * stride);
+			words[sample >> 1] |= uint32_t(h) << ((sample & 1) * 16);
+		}
+	}
+}
+
+void Terrain::draw(VkCommandBuffer cmd, VkPipelineLayout layout) const
+{
+	if (_nodeCount == 0)
+	{
+		return;
+	}
+	TerrainDrawConstants constants;
+	constants.grid = glm::vec4(_spacing, -0.5f * _settings.size, float(_heightfield.side() - 1), 0.0f);
+	constants.height = glm::vec4(_settings.baseHeight, _settings.height / 65535.0f, 0.0f, 0.0f);
+	const VkDeviceSize offset = VkDeviceSize(_frame) * MAX_NODES * sizeof(GpuTerrainNode);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 1, 1, &_set, 0, nullptr);
+	vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(TerrainDrawConstants), &constants);
+	vkCmdBindVertexBuffers(cmd, 0, 1, &_instances._buffer, &offset);
+	vkCmdBindIndexBuffer(cmd, _grid._buffer, 0, VK_INDEX_TYPE_UINT16);
+	vkCmdDrawIndexed(cmd, PATCH * PATCH * 6, _nodeCount, 0, 0, 0);
+}
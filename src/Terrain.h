@@ -0,0 +1,194 @@
+#pragma once
+
+#include <vk_types.h>
+#include <DescriptorAllocator.h>
+#include <UploadManager.h>
+#include <VertexLayout.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+struct TerrainSettings {
+	// a square 16-bit (or 8-bit) binary PGM, one sample per grid point; empty for a procedural heightfield
+	std::string path;
+	// samples along each side of the procedural one
+	uint32_t samples{ 1025 };
+	// world units along each side, centred on the origin in xz, and between the lowest and highest sample
+	float size{ 256.0f };
+	float height{ 8.0f };
+	// where the lowest sample sits, below the scene in front of the camera
+	float baseHeight{ -10.0f };
+	// height tiles kept on the GPU, whatever the heightfield's size
+	uint32_t cacheTiles{ 512 };
+	// distance up to which the finest level is drawn, doubling with each level after it; 0 for three leaf nodes
+	float lodDistance{ 0.0f };
+};
+
+// The heights as they were loaded, normalized to 16 bits; only the CPU reads them, to cut tiles and bounds from
+class Heightfield
+{
+public:
+	// false, and empty, when the file is missing or not a square binary PGM
+	bool load_pgm(const char* path);
+	// fractal value noise, the same for every seed
+	void generate(uint32_t side, uint32_t seed = 1);
+
+	uint32_t side() const { return _side; }
+	bool empty() const { return _heights.empty(); }
+	// clamped to the edges
+	uint16_t at(int64_t x, int64_t y) const;
+
+private:
+	uint32_t _side{ 0 };
+	std::vector<uint16_t> _heights; // row by row, rows along z
+};
+
+// per node vertex input of terrain.vert: where its grid starts in heightfield samples and how many samples
+// apart its vertices are, the distances over which it morphs into its parent's grid, and its tile's slot
+struct GpuTerrainNode {
+	glm::vec4 node; // xy the first sample, z the stride, w the level
+	glm::vec2 morph; // start, end
+	float slot;
+	float pad;
+};
+
+constexpr auto TERRAIN_NODE_LAYOUT = vertex_layout(
+	{ vertex_binding(0, sizeof(GpuTerrainNode), VK_VERTEX_INPUT_RATE_INSTANCE) },
+	{ VERTEX_ATTRIBUTE(GpuTerrainNode, node, 0, 0), VERTEX_ATTRIBUTE(GpuTerrainNode, morph, 1, 0), VERTEX_ATTRIBUTE(GpuTerrainNode, slot, 2, 0) });
+
+// Heightfield terrain drawn with continuous distance-dependent LOD (CDLOD): a quadtree over the heightfield
+// whose nodes all draw the same PATCH x PATCH grid, a leaf one sample per quad and each level up twice as
+// coarse. The camera's distance picks each node's level; within the last part of a level's range the odd
+// vertices of its grid slide onto their even neighbours, so by the range's end it is its parent's grid and
+// the switch doesn't pop. The whole terrain is one instanced draw of the selected nodes.
+// A node's heights are a tile of TILE_SIDE x TILE_SIDE samples at its stride, a border sample round the grid
+// for the normals, which terrain.vert works out from the heights instead of having them streamed as well.
+// Tiles go through the upload manager into a fixed number of slots of one storage buffer, so the memory held
+// doesn't grow with the heightfield: the nodes near the camera get their tiles, the least recently drawn
+// ones give theirs up, and a node whose children's tiles haven't arrived yet is drawn in their place.
+class Terrain
+{
+public:
+	// quads along each side of a node's grid
+	static constexpr uint32_t PATCH = 32;
+	static constexpr uint32_t TILE_SIDE = PATCH + 3;
+	// two 16-bit samples per word
+	static constexpr uint32_t TILE_WORDS = (TILE_SIDE * TILE_SIDE + 1) / 2;
+	// nodes drawn per frame at most; past it the coarser ones stand in for the rest
+	static constexpr uint32_t MAX_NODES = 4096;
+	// tiles staged per frame at most
+	static constexpr uint32_t MAX_TILE_UPLOADS = 32;
+
+	// loads or generates the heightfield and creates the tile cache; false, with nothing created, when the
+	// heightfield can't be loaded
+	bool init(VkDevice device, VmaAllocator allocator, DescriptorAllocator& descriptors, const TerrainSettings& settings, uint32_t frameCount);
+	// the GPU must be done with every frame that drew it
+	void cleanup();
+
+	bool ready() const { return _tiles._buffer != VK_NULL_HANDLE; }
+
+	// the tiles at binding 0; the terrain pipeline binds it as set 1
+	VkDescriptorSetLayout set_layout() const { return _setLayout; }
+
+	// after the frame's acquires: picks the nodes drawn from eye and the frustum into frame's slot of instances,
+	// only those whose tiles were acquired by acquiredValue; the ones missing are requested
+	void select(const glm::vec3& eye, const glm::vec4 planes[6], uint32_t frame, uint64_t frameNumber, uint64_t acquiredValue);
+	// before the upload flush: stages up to MAX_TILE_UPLOADS requested tiles, coarsest first, into slots no
+	// frame still in flight draws from. True if any tile was staged
+	bool request_tiles(UploadManager& uploads, uint64_t frameNumber, uint32_t frameOverlap);
+	// the tiles staged since the last call travel with the batch that signals value
+	void set_upload_value(uint64_t value);
+	// tiles still wanted or on their way
+	bool streaming() const;
+
+	// inside the render pass with the terrain pipeline and set 0 bound: binds set 1, the grid and the
+	// selected nodes, and draws them
+	void draw(VkCommandBuffer cmd, VkPipelineLayout layout) const;
+
+	// the nodes select() picked, as drawn, for what's placed on them
+	const std::vector<GpuTerrainNode>& selected() const { return _selected; }
+	// GpuTerrainNode::slot times TILE_WORDS is where a node's tile starts in it
+	VkBuffer tile_buffer() const { return _tiles._buffer; }
+	const TerrainSettings& settings() const { return _settings; }
+	float spacing() const { return _spacing; }
+	uint32_t last_sample() const { return _heightfield.side() - 1; }
+
+	uint32_t node_count() const { return _nodeCount; }
+	uint64_t triangle_count() const { return uint64_t(_nodeCount) * PATCH * PATCH * 2; }
+	// what the heightfield costs as a mesh at full detail
+	uint64_t full_triangle_count() const { return uint64_t(_heightfield.side() - 1) * (_heightfield.side() - 1) * 2; }
+	uint32_t level_count() const { return static_cast<uint32_t>(_levels.size()); }
+	// device memory of the tile cache
+	VkDeviceSize memory_bytes() const { return VkDeviceSize(_slots.size()) * TILE_WORDS * sizeof(uint32_t); }
+
+private:
+	static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+	struct Level {
+		uint32_t nodesPerSide;
+		uint32_t firstNode;
+		float range; // the distance it's drawn to
+	};
+
+	struct Slot {
+		uint32_t node{ NO_SLOT };
+		uint64_t lastUsed{ 0 }; // the frame that last drew it or one of its descendants
+		uint64_t uploadValue{ 0 }; // 0 while staged in a batch not flushed yet
+	};
+
+	struct WantedTile {
+		uint32_t node;
+		uint32_t level;
+		float distance;
+	};
+
+	uint32_t node_index(uint32_t level, uint32_t x, uint32_t y) const { return _levels[level].firstNode + y * _levels[level].nodesPerSide + x; }
+	// the node's first sample along x or y
+	uint32_t node_origin(uint32_t level, uint32_t coordinate) const { return (coordinate * PATCH) << level; }
+	bool node_exists(uint32_t level, uint32_t x, uint32_t y) const;
+	void node_box(uint32_t level, uint32_t x, uint32_t y, glm::vec3& min, glm::vec3& max) const;
+	bool resident(uint32_t node) const;
+
+	// true once it's drawn or culled; false when it's outside its level's range and the parent has to cover it
+	bool select_node(uint32_t level, uint32_t x, uint32_t y, bool inside);
+	void push_node(uint32_t level, uint32_t x, uint32_t y);
+	void want(uint32_t level, uint32_t x, uint32_t y);
+	void compute_bounds();
+	void write_tile(uint32_t node, uint32_t* words) const;
+
+	VkDevice _device{ VK_NULL_HANDLE };
+	VmaAllocator _allocator{ nullptr };
+	TerrainSettings _settings;
+	Heightfield _heightfield;
+	float _spacing{ 1.0f }; // world units between samples
+	std::vector<Level> _levels; // finest first
+	std::vector<uint16_t> _bounds; // lowest and highest sample under each node
+	std::vector<uint32_t> _nodeSlots;
+	std::vector<Slot> _slots;
+
+	AllocatedBuffer _tiles{};
+	AllocatedBuffer _grid{}; // indices of a node's grid; the shader makes the vertices from them
+	VkDescriptorSetLayout _setLayout{ VK_NULL_HANDLE };
+	VkDescriptorSet _set{ VK_NULL_HANDLE };
+
+	// MAX_NODES per frame slot, host visible
+	AllocatedBuffer _instances{};
+	uint32_t _frame{ 0 };
+	uint32_t _nodeCount{ 0 };
+	std::vector<GpuTerrainNode> _selected; // a copy of the frame slot's nodes the CPU can read back cheaply
+
+	// this selection's inputs
+	glm::vec3 _eye{ 0.0f };
+	const glm::vec4* _planes{ nullptr };
+	uint64_t _frameNumber{ 0 };
+	uint64_t _acquiredValue{ 0 };
+
+	std::vector<WantedTile> _wanted;
+	std::vector<uint32_t> _staged; // slots in the batch not flushed yet
+	uint64_t _newestUpload{ 0 };
+};
@@ -0,0 +1,200 @@
+#include "TextRenderer.h"
+
+#include "vk_initializers.h"
+
+#include <algorithm>
+#include <cstring>
+
+void TextRenderer::init(VkDevice device, VmaAllocator allocator, DescriptorAllocator& descriptors, const SdfFont& font)
+{
+	_device = device;
+	_allocator = allocator;
+	_font = font;
+
+	VmaAllocationCreateInfo imageAllocInfo = {};
+	imageAllocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+	VkImageCreateInfo imageInfo = vkinit::image_create_info(VK_FORMAT_R8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+		{ font.width(), font.height(), 1 });
+	VK_CHECK(vmaCreateImage(_allocator, &imageInfo, &imageAllocInfo, &_image._image, &_image._allocation, nullptr));
+
+	VkImageViewCreateInfo viewInfo = vkinit::imageview_create_info(VK_FORMAT_R8_UNORM, _image._image, VK_IMAGE_ASPECT_COLOR_BIT);
+	VK_CHECK(vkCreateImageView(_device, &viewInfo, nullptr, &_view));
+
+	// bilinear, which is what makes the distances resolve to a smooth edge; clamped so the glyphs on the
+	// atlas's border don't filter in the opposite side
+	VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	VK_CHECK(vkCreateSampler(_device, &samplerInfo, nullptr, &_sampler));
+
+	VkDescriptorSetLayoutBinding binding = vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0);
+	VkDescriptorSetLayoutCreateInfo setInfo = {};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setInfo.pNext = nullptr;
+	setInfo.bindingCount = 1;
+	setInfo.pBindings = &binding;
+	VK_CHECK(vkCreateDescriptorSetLayout(_device, &setInfo, nullptr, &_setLayout));
+
+	descriptors.allocate(&_set, _setLayout);
+	VkDescriptorImageInfo atlasInfo = { _sampler, _view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	VkWriteDescriptorSet write = vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _set, &atlasInfo, 0);
+	vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+
+	const size_t byteSize = font.pixels().size();
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.pNext = nullptr;
+	bufferInfo.size = byteSize;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+	allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+	VmaAllocationInfo mappedInfo;
+	VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &allocInfo, &_staging._buffer, &_staging._allocation, &mappedInfo));
+	memcpy(mappedInfo.pMappedData, font.pixels().data(), byteSize);
+	vmaFlushAllocation(_allocator, _staging._allocation, 0, VK_WHOLE_SIZE);
+
+	// the whole capacity up front, so a frame's text never grows the batch
+	_glyphs.reserve(MAX_GLYPHS);
+	_dropped = 0;
+	_lastDropped = 0;
+}
+
+void TextRenderer::cleanup()
+{
+	if (_staging._buffer != VK_NULL_HANDLE)
+	{
+		vmaDestroyBuffer(_allocator, _staging._buffer, _staging._allocation);
+		_staging = {};
+	}
+	if (_image._image != VK_NULL_HANDLE)
+	{
+		vkDestroySampler(_device, _sampler, nullptr);
+		vkDestroyImageView(_device, _view, nullptr);
+		vmaDestroyImage(_allocator, _image._image, _image._allocation);
+		vkDestroyDescriptorSetLayout(_device, _setLayout, nullptr);
+		_image = {};
+		_sampler = VK_NULL_HANDLE;
+		_view = VK_NULL_HANDLE;
+		_setLayout = VK_NULL_HANDLE;
+	}
+	_set = VK_NULL_HANDLE;
+	_glyphs.clear();
+}
+
+void TextRenderer::begin_frame(VkCommandBuffer cmd, DeletionQueue& deletionQueue)
+{
+	if (!ready() || _staging._buffer == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	VkImageMemoryBarrier barrier = vkinit::image_barrier(_image._image, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	VkBufferImageCopy copy = {};
+	copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	copy.imageSubresource.mipLevel = 0;
+	copy.imageSubresource.baseArrayLayer = 0;
+	copy.imageSubresource.layerCount = 1;
+	copy.imageExtent = { _font.width(), _font.height(), 1 };
+	vkCmdCopyBufferToImage(cmd, _staging._buffer, _image._image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+	deletionQueue.push_buffer(_staging);
+	_staging = {};
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void TextRenderer::append(const glm::vec4& anchor, glm::vec2 pen, const char* string, float size, uint32_t color)
+{
+	const float lineStart = pen.x;
+	for (const char* c = string; *c != '\0'; c++)
+	{
+		if (*c == '\n')
+		{
+			pen = glm::vec2(lineStart, pen.y + _font.line_height() * size);
+			continue;
+		}
+		const SdfGlyph* glyph = _font.glyph(*c);
+		if (glyph == nullptr)
+		{
+			continue;
+		}
+		// a space moves the pen and draws nothing
+		if (glyph->size[0] > 0.0f)
+		{
+			if (_glyphs.size() >= MAX_GLYPHS)
+			{
+				_dropped++;
+			}
+			else
+			{
+				GpuGlyphInstance instance;
+				instance.anchor = anchor;
+				instance.rect = glm::vec4(pen.x + glyph->offset[0] * size, pen.y + glyph->offset[1] * size, glyph->size[0] * size, glyph->size[1] * size);
+				memcpy(instance.uv, glyph->uv, sizeof(instance.uv));
+				instance.color = color;
+				instance.pad = 0;
+				_glyphs.push_back(instance);
+			}
+		}
+		pen.x += glyph->advance * size;
+	}
+}
+
+void TextRenderer::text(const glm::vec2& pixel, const char* string, float size, uint32_t color)
+{
+	if (ready())
+	{
+		append(glm::vec4(pixel, 0.0f, 0.0f), glm::vec2(0.0f, _font.ascent() * size), string, size, color);
+	}
+}
+
+void TextRenderer::label(const glm::vec3& position, const char* string, float size, uint32_t color)
+{
+	if (ready())
+	{
+		append(glm::vec4(position, 1.0f), glm::vec2(-0.5f * width(string, size), 0.0f), string, size, color);
+	}
+}
+
+float TextRenderer::width(const char* string, float size) const
+{
+	float widest = 0.0f;
+	float line = 0.0f;
+	for (const char* c = string; *c != '\0'; c++)
+	{
+		if (*c == '\n')
+		{
+			line = 0.0f;
+			continue;
+		}
+		const SdfGlyph* glyph = _font.glyph(*c);
+		line += glyph != nullptr ? glyph->advance * size : 0.0f;
+		widest = std::max(widest, line);
+	}
+	return widest;
+}
+
+uint32_t TextRenderer::upload(GpuLinearAllocator& ring, GpuAllocation* allocation)
+{
+	_lastDropped = _dropped;
+	_dropped = 0;
+	uint32_t count = static_cast<uint32_t>(_glyphs.size());
+	if (count > 0 && ring.allocate(count * sizeof(GpuGlyphInstance), alignof(GpuGlyphInstance), allocation))
+	{
+		memcpy(allocation->data, _glyphs.data(), count * sizeof(GpuGlyphInstance));
+	}
+	else
+	{
+		_lastDropped += count;
+		count = 0;
+	}
+	// the capacity stays, so the batch never allocates
+	_glyphs.clear();
+	return count;
+}
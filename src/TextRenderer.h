@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vk_types.h>
+#include <DeletionQueue.h>
+#include <DescriptorAllocator.h>
+#include <GpuLinearAllocator.h>
+#include <SdfFont.h>
+#include <VertexLayout.h>
+
+#include <cstdint>
+#include <vector>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+// per instance vertex input of text.vert: where the glyph's quad goes and what of the atlas it shows
+struct GpuGlyphInstance {
+	glm::vec4 anchor; // a world position with w 1, projected by the shader; x, y in window pixels with w 0
+	glm::vec4 rect; // the quad's top left from the anchor and its size, in pixels
+	uint16_t uv[4]; // SdfGlyph::uv
+	uint32_t color; // RGBA8, red in the lowest byte
+	uint32_t pad;
+};
+
+constexpr auto GLYPH_INSTANCE_LAYOUT = vertex_layout(
+	{ vertex_binding(0, sizeof(GpuGlyphInstance), VK_VERTEX_INPUT_RATE_INSTANCE) },
+	{ VERTEX_ATTRIBUTE(GpuGlyphInstance, anchor, 0, 0), VERTEX_ATTRIBUTE(GpuGlyphInstance, rect, 1, 0),
+		vertex_attribute(2, 0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(GpuGlyphInstance, uv)),
+		vertex_attribute(3, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(GpuGlyphInstance, color)) });
+
+// text.vert's push constants
+struct TextPushConstants {
+	glm::mat4 viewProjection; // what labels are projected with, unjittered
+	glm::vec4 screen; // 2 / width, 2 / height of the window, then width and height
+};
+
+// Immediate-mode text over the finished frame, like DebugDraw's lines: anything may add screen text or
+// labels anchored in the world during the frame, a glyph instance each in a batch whose capacity is taken
+// once, and the batch goes into the frame's GPU ring and draws as one instanced quad list from an SdfFont's
+// atlas. A label is projected by the vertex shader and keeps its size in pixels however far it is; one
+// behind the camera collapses to nothing. Nothing is kept between frames, and adding text never allocates.
+class TextRenderer
+{
+public:
+	// glyphs a frame keeps; what is added past it is dropped, and counted
+	static constexpr uint32_t MAX_GLYPHS = 1u << 16;
+
+	// takes a copy of font's metrics, and its atlas for the first begin_frame to copy in
+	void init(VkDevice device, VmaAllocator allocator, DescriptorAllocator& descriptors, const SdfFont& font);
+	void cleanup();
+
+	bool ready() const { return _image._image != VK_NULL_HANDLE; }
+
+	// the atlas and its sampler at binding 0; the text pipeline binds it as set 0
+	VkDescriptorSetLayout set_layout() const { return _setLayout; }
+	VkDescriptorSet set() const { return _set; }
+
+	// outside a render pass: copies the atlas in the first time, its staging freed with deletionQueue
+	void begin_frame(VkCommandBuffer cmd, DeletionQueue& deletionQueue);
+
+	// string's top left at pixel of the window, size pixels to the font's height; '\n' starts a line below
+	void text(const glm::vec2& pixel, const char* string, float size, uint32_t color);
+	// string centered over position, its baseline there
+	void label(const glm::vec3& position, const char* string, float size, uint32_t color);
+	// of string's longest line at size, in pixels
+	float width(const char* string, float size) const;
+	float line_height(float size) const { return _font.line_height() * size; }
+
+	// copies the batch into ring, for a draw with allocation's buffer and offset bound as the instance buffer,
+	// and starts the next one. Returns the glyph count, 0 when there was nothing or no room
+	uint32_t upload(GpuLinearAllocator& ring, GpuAllocation* allocation);
+
+	size_t glyph_count() const { return _glyphs.size(); }
+	// glyphs dropped over MAX_GLYPHS in the last batch uploaded
+	uint32_t dropped_glyphs() const { return _lastDropped; }
+
+private:
+	// string's glyphs from pen, relative to anchor
+	void append(const glm::vec4& anchor, glm::vec2 pen, const char* string, float size, uint32_t color);
+
+	VkDevice _device{ VK_NULL_HANDLE };
+	VmaAllocator _allocator{ nullptr };
+	SdfFont _font; // for its metrics
+	AllocatedImage _image{};
+	VkImageView _view{ VK_NULL_HANDLE };
+	VkSampler _sampler{ VK_NULL_HANDLE };
+	VkDescriptorSetLayout _setLayout{ VK_NULL_HANDLE };
+	VkDescriptorSet _set{ VK_NULL_HANDLE };
+	AllocatedBuffer _staging{}; // until begin_frame copies it in
+
+	std::vector<GpuGlyphInstance> _glyphs;
+	uint32_t _dropped{ 0 };
+	uint32_t _lastDropped{ 0 };
+};
@@ -0,0 +1,362 @@
+#include "Texture.h"
+
+#include "AssetArchive.h"
+#include "AssetCache.h"
+#include "BarrierBatch.h"
+#include "HeapStats.h"
+#include "Log.h"
+#include "MappedFile.h"
+#include "TextureCompressor.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+namespace {
+	constexpr uint32_t TEXTURE_CACHE_MAGIC = 0x58544351; // "QCTX"
+	// bump whenever the cache layout or the conversion changes
+	constexpr uint32_t TEXTURE_CACHE_VERSION = 1;
+	constexpr const char* TEXTURE_CACHE_EXTENSION = ".qctex";
+
+	// fixed-size fields only, so the header can be written and read as raw bytes
+	struct TextureCacheHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t format; // VkFormat
+		uint32_t width;
+		uint32_t height;
+		uint32_t levelCount;
+		uint64_t sourceSize;
+		int64_t sourceTimestamp;
+		uint64_t sourceHash;
+	};
+	static_assert(sizeof(TextureCacheHeader) == 48, "texture cache header must not contain padding");
+
+	// follows the header, levelCount entries; level data follows the table in the same order
+	struct TextureCacheLevel {
+		uint32_t width;
+		uint32_t height;
+		uint64_t size;
+	};
+	static_assert(sizeof(TextureCacheLevel) == 16, "texture cache level must not contain padding");
+}
+
+std::string Texture::cache_path(const std::string& fileName)
+{
+	return fileName + TEXTURE_CACHE_EXTENSION;
+}
+
+bool Texture::load_from_file(const char* fileName, bool compress, const AssetArchive* archive, AssetCache* cache)
+{
+	heap_stats::Scope heapScope(HeapTag::Textures);
+	if (!compress)
+	{
+		return load_from_image(fileName, archive);
+	}
+
+	const uint64_t key = cache != nullptr ? cache->key({ fileName }, "bc-texture", TEXTURE_CACHE_VERSION) : 0;
+	std::string cachePath = key != 0 ? cache->path(key, TEXTURE_CACHE_EXTENSION) : std::string(fileName) + TEXTURE_CACHE_EXTENSION;
+
+	// a packed cache is checked against the image like a loose one, so a stale archive falls through to it
+	const uint8_t* packed;
+	size_t packedSize;
+	const bool cached = (archive != nullptr && archive->find(cachePath, packed, packedSize)
+		&& load_from_cache_data(packed, packedSize, cachePath.c_str(), fileName))
+		|| load_from_cache(cachePath.c_str(), fileName);
+	if (cache != nullptr)
+	{
+		cache->count_lookup(cached);
+	}
+	if (cached)
+	{
+		return true;
+	}
+
+	if (!load_from_image(fileName))
+	{
+		return false;
+	}
+	compress_levels(fileName);
+
+	if (!save_to_cache(cachePath.c_str(), fileName))
+	{
+		LOG_WARN("could not write texture cache " << cachePath);
+	}
+	return true;
+}
+
+bool Texture::load_from_image(const char* fileName, const AssetArchive* archive)
+{
+	const uint8_t* packed;
+	size_t packedSize;
+	// the mesh cache naming the atlas is what goes stale with the OBJ, and its import rewrites the atlas
+	const size_t length = strlen(fileName);
+	const size_t extensionLength = strlen(TEXTURE_ATLAS_EXTENSION);
+	if (length > extensionLength && strcmp(fileName + length - extensionLength, TEXTURE_ATLAS_EXTENSION) == 0)
+	{
+		return archive != nullptr && archive->find(fileName, packed, packedSize)
+			? load_from_cache_data(packed, packedSize, fileName, nullptr)
+			: load_from_cache(fileName, nullptr);
+	}
+
+	int width, height, channels;
+	stbi_uc* pixels = archive != nullptr && archive->find(fileName, packed, packedSize)
+		? stbi_load_from_memory(packed, static_cast<int>(packedSize), &width, &height, &channels, STBI_rgb_alpha)
+		: stbi_load(fileName, &width, &height, &channels, STBI_rgb_alpha);
+	if (!pixels)
+	{
+		LOG_ERROR("Failed to load texture file " << fileName << ": " << stbi_failure_reason());
+		return false;
+	}
+
+	_width = static_cast<uint32_t>(width);
+	_height = static_cast<uint32_t>(height);
+	_format = VK_FORMAT_R8G8B8A8_SRGB;
+	_pixels.resize(static_cast<size_t>(_width) * _height * 4);
+	memcpy(_pixels.data(), pixels, _pixels.size());
+	stbi_image_free(pixels);
+	_levels = { { _width, _height, 0, _pixels.size() } };
+
+	LOG_INFO("Loaded texture " << fileName << " (" << _width << "x" << _height << ")");
+	return true;
+}
+
+bool Texture::load_from_cache(const char* cachePath, const char* sourcePath)
+{
+	MappedFile file;
+	return file.open(cachePath) && load_from_cache_data(file.data(), file.size(), cachePath, sourcePath);
+}
+
+bool Texture::load_from_cache_data(const uint8_t* data, size_t size, const char* cachePath, const char* sourcePath)
+{
+	heap_stats::Scope heapScope(HeapTag::Textures);
+	if (size < sizeof(TextureCacheHeader))
+	{
+		return false;
+	}
+
+	TextureCacheHeader header;
+	memcpy(&header, data, sizeof(TextureCacheHeader));
+
+	if (header.magic != TEXTURE_CACHE_MAGIC || header.version != TEXTURE_CACHE_VERSION || header.levelCount == 0)
+	{
+		return false;
+	}
+
+	const size_t tableBytes = size_t(header.levelCount) * sizeof(TextureCacheLevel);
+	if (size < sizeof(TextureCacheHeader) + tableBytes)
+	{
+		return false;
+	}
+
+	// the cache invalidates itself when the image changes
+	// a timestamp-only change (fresh checkout, copy) is accepted if the contents still hash the same
+	SourceStamp stamp;
+	if (sourcePath != nullptr && get_source_stamp(sourcePath, stamp))
+	{
+		if (stamp.size != header.sourceSize)
+		{
+			return false;
+		}
+		if (stamp.timestamp != header.sourceTimestamp && hash_file(sourcePath) != header.sourceHash)
+		{
+			return false;
+		}
+	}
+
+	const uint8_t* cursor = data + sizeof(TextureCacheHeader);
+	std::vector<TextureLevel> levels(header.levelCount);
+	size_t dataBytes = 0;
+	for (uint32_t i = 0; i < header.levelCount; i++)
+	{
+		TextureCacheLevel cached;
+		memcpy(&cached, cursor + i * sizeof(TextureCacheLevel), sizeof(TextureCacheLevel));
+
+		levels[i] = { cached.width, cached.height, dataBytes, static_cast<size_t>(cached.size) };
+		dataBytes += levels[i].size;
+	}
+	cursor += tableBytes;
+
+	if (size < sizeof(TextureCacheHeader) + tableBytes + dataBytes)
+	{
+		return false;
+	}
+
+	// compressed levels go to the GPU as they are, no decode
+	_pixels.resize(dataBytes);
+	memcpy(_pixels.data(), cursor, dataBytes);
+	_levels = std::move(levels);
+	_format = static_cast<VkFormat>(header.format);
+	_width = header.width;
+	_height = header.height;
+
+	LOG_INFO(cachePath << ": loaded " << _width << "x" << _height << ", " << _levels.size() << " levels, "
+		<< _pixels.size() / 1024 << " KiB from cache");
+	return true;
+}
+
+bool Texture::save_to_cache(const char* cachePath, const char* sourcePath) const
+{
+	SourceStamp stamp;
+	if (!get_source_stamp(sourcePath, stamp))
+	{
+		return false;
+	}
+
+	TextureCacheHeader header = {};
+	header.magic = TEXTURE_CACHE_MAGIC;
+	header.version = TEXTURE_CACHE_VERSION;
+	header.format = static_cast<uint32_t>(_format);
+	header.width = _width;
+	header.height = _height;
+	header.levelCount = static_cast<uint32_t>(_levels.size());
+	header.sourceSize = stamp.size;
+	header.sourceTimestamp = stamp.timestamp;
+	header.sourceHash = hash_file(sourcePath);
+
+	std::vector<TextureCacheLevel> levels(_levels.size());
+	for (size_t i = 0; i < _levels.size(); i++)
+	{
+		levels[i].width = _levels[i].width;
+		levels[i].height = _levels[i].height;
+		levels[i].size = _levels[i].size;
+	}
+
+	std::ofstream file(cachePath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(levels.data()), levels.size() * sizeof(TextureCacheLevel));
+	file.write(reinterpret_cast<const char*>(_pixels.data()), _pixels.size());
+	return file.good();
+}
+
+void Texture::compress_levels(const char* name)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// alpha-tested atlases need BC3; BC1 halves the size again for everything opaque
+	const bool opaque = texcomp::is_opaque(_pixels.data(), size_t(_width) * _height);
+	const texcomp::BlockFormat blockFormat = opaque ? texcomp::BlockFormat::BC1 : texcomp::BlockFormat::BC3;
+
+	const uint32_t levelCount = full_mip_count();
+	std::vector<TextureLevel> levels;
+	size_t dataBytes = 0;
+	uint32_t width = _width, height = _height;
+	for (uint32_t i = 0; i < levelCount; i++)
+	{
+		levels.push_back({ width, height, dataBytes, texcomp::compressed_size(blockFormat, width, height) });
+		dataBytes += levels.back().size;
+		width = std::max(width / 2, 1u);
+		height = std::max(height / 2, 1u);
+	}
+
+	// each level is filtered from the uncompressed one above, never from decoded blocks
+	std::vector<uint8_t> compressed(dataBytes);
+	std::vector<uint8_t> level = std::move(_pixels);
+	std::vector<uint8_t> next;
+	for (uint32_t i = 0; i < levelCount; i++)
+	{
+		texcomp::compress(blockFormat, level.data(), levels[i].width, levels[i].height, compressed.data() + levels[i].offset);
+		if (i + 1 < levelCount)
+		{
+			texcomp::downsample(level.data(), levels[i].width, levels[i].height, next);
+			level.swap(next);
+		}
+	}
+
+	_pixels = std::move(compressed);
+	_levels = std::move(levels);
+	_format = opaque ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC3_SRGB_BLOCK;
+
+	auto end = std::chrono::high_resolution_clock::now();
+	LOG_INFO(name << ": compressed " << levelCount << " levels to " << (opaque ? "BC1" : "BC3") << ", "
+		<< _pixels.size() / 1024 << " KiB, " << std::chrono::duration<double, std::milli>(end - start).count() << " ms");
+}
+
+uint32_t Texture::full_mip_count() const
+{
+	uint32_t levels = 1;
+	for (uint32_t size = std::max(_width, _height); size > 1; size /= 2)
+	{
+		levels++;
+	}
+	return levels;
+}
+
+void Texture::generate_mipmaps(VkCommandBuffer cmd) const
+{
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = _image._image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+
+	// each level's hand-off to the shaders waits for the next blit's barrier, so a chain takes one barrier
+	// per level instead of two
+	BarrierBatch barriers;
+	auto to_shaders = [&](uint32_t level, VkAccessFlags srcAccess, VkImageLayout oldLayout) {
+		barrier.subresourceRange.baseMipLevel = level;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barriers.add(barrier, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	};
+
+	int32_t width = static_cast<int32_t>(_width);
+	int32_t height = static_cast<int32_t>(_height);
+	for (uint32_t level = 1; level < _mipLevels; level++)
+	{
+		// the previous level is complete; read it as the blit source. The one before it is done as a source
+		barrier.subresourceRange.baseMipLevel = level - 1;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barriers.add(barrier, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		if (level >= 2)
+		{
+			to_shaders(level - 2, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+		}
+		barriers.record(cmd);
+
+		const int32_t nextWidth = std::max(width / 2, 1);
+		const int32_t nextHeight = std::max(height / 2, 1);
+
+		VkImageBlit blit = {};
+		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.srcSubresource.mipLevel = level - 1;
+		blit.srcSubresource.baseArrayLayer = 0;
+		blit.srcSubresource.layerCount = 1;
+		blit.srcOffsets[1] = { width, height, 1 };
+		blit.dstSubresource = blit.srcSubresource;
+		blit.dstSubresource.mipLevel = level;
+		blit.dstOffsets[1] = { nextWidth, nextHeight, 1 };
+		vkCmdBlitImage(cmd, _image._image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, _image._image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1, &blit, VK_FILTER_LINEAR);
+
+		width = nextWidth;
+		height = nextHeight;
+	}
+
+	// the last source, and the last level, which was only ever written
+	if (_mipLevels >= 2)
+	{
+		to_shaders(_mipLevels - 2, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+	}
+	to_shaders(_mipLevels - 1, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	barriers.record(cmd);
+}
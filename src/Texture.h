@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vk_types.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class AssetArchive;
+class AssetCache;
+
+// an atlas of an OBJ's diffuse maps (see TextureAtlas.h): a texture cache that is its own source, which
+// load_from_image reads in place of an image
+constexpr const char* TEXTURE_ATLAS_EXTENSION = ".qcatlas";
+
+// where one stored mip level sits in Texture::_pixels
+struct TextureLevel {
+	uint32_t width;
+	uint32_t height;
+	size_t offset;
+	size_t size;
+};
+
+// sampled 2D image with its full mip chain
+// load_from_file only fills _pixels and is safe to call off the render thread; the engine creates the image,
+// uploads the stored levels and, for uncompressed textures, has the graphics queue blit the remaining ones
+struct Texture
+{
+	// stored levels in _format, finest first, tightly packed; released once copied into staging memory
+	// unless _streamed. Decoded images only store level 0, block-compressed caches store the whole chain
+	std::vector<uint8_t> _pixels;
+	std::vector<TextureLevel> _levels;
+	uint32_t _width{ 0 };
+	uint32_t _height{ 0 };
+
+	AllocatedImage _image;
+	VkImageView _imageView{ VK_NULL_HANDLE };
+	// color textures are stored as sRGB so sampling and filtering happen in linear space
+	VkFormat _format{ VK_FORMAT_R8G8B8A8_SRGB };
+	// levels in the image; it starts at _levels[_firstResidentLevel]
+	uint32_t _mipLevels{ 1 };
+	uint32_t _firstResidentLevel{ 0 };
+	// the engine moves _firstResidentLevel by what's on screen and the memory budget; the stored chain
+	// stays in _pixels, so finer levels can be uploaded again after being dropped
+	bool _streamed{ false };
+
+	// set by the engine once every level is written and the image is in SHADER_READ_ONLY_OPTIMAL
+	bool _resident{ false };
+	// slot in the engine's bindless texture array once resident, UINT32_MAX before (or without bindless)
+	uint32_t _bindlessIndex{ UINT32_MAX };
+
+	// with compress, goes through the BC texture cache next to fileName, or in cache under the image's key,
+	// converting and writing it when it's missing or stale; otherwise decodes with stb_image into rgba8
+	// level 0. archive, if given, is searched for the cache or the image before the loose files
+	bool load_from_file(const char* fileName, bool compress, const AssetArchive* archive = nullptr, AssetCache* cache = nullptr);
+	// the BC cache next to fileName, which load_from_file reads with compress and no AssetCache
+	static std::string cache_path(const std::string& fileName);
+
+	// stb_image decode, expanded to 4 channels; atlases are read as they were written, rgba8 level 0
+	bool load_from_image(const char* fileName, const AssetArchive* archive = nullptr);
+
+	// binary cache: header + level table + level blobs, tagged with the source's size, timestamp and hash;
+	// a null sourcePath skips the check
+	bool load_from_cache(const char* cachePath, const char* sourcePath);
+	// the same from a cache already in memory; cachePath only names it in the log
+	bool load_from_cache_data(const uint8_t* data, size_t size, const char* cachePath, const char* sourcePath);
+	bool save_to_cache(const char* cachePath, const char* sourcePath) const;
+
+	// replaces the decoded level 0 with a CPU-built mip chain in BC1 (opaque) or BC3
+	void compress_levels(const char* name);
+
+	bool is_block_compressed() const { return _format != VK_FORMAT_R8G8B8A8_SRGB; }
+
+	// levels down to 1x1 for the current size
+	uint32_t full_mip_count() const;
+
+	// true when the image has more levels than _pixels stores; generate_mipmaps fills them
+	bool needs_mip_generation() const { return _levels.size() - _firstResidentLevel < _mipLevels; }
+
+	// graphics queue, outside a render pass: expects every level in TRANSFER_DST_OPTIMAL with level 0 written,
+	// blits each level from the previous one and leaves all of them SHADER_READ_ONLY_OPTIMAL for fragment shaders
+	void generate_mipmaps(VkCommandBuffer cmd) const;
+};
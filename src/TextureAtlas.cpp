@@ -0,0 +1,223 @@
+#include "TextureAtlas.h"
+
+#include "JobSystem.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+namespace {
+	struct Placement {
+		uint32_t x;
+		uint32_t y;
+	};
+
+	// shelf-packs the padded sources into a size x size square; false if they don't fit
+	bool place(const std::vector<const Texture*>& sources, const std::vector<uint32_t>& order, uint32_t size, uint32_t padding,
+		std::vector<Placement>& placements)
+	{
+		uint32_t x = 0;
+		uint32_t y = 0;
+		uint32_t shelfHeight = 0;
+		for (uint32_t index : order)
+		{
+			const uint32_t width = sources[index]->_width + 2 * padding;
+			const uint32_t height = sources[index]->_height + 2 * padding;
+			if (x + width > size)
+			{
+				x = 0;
+				y += shelfHeight;
+				shelfHeight = 0;
+			}
+			if (width > size || y + height > size)
+			{
+				return false;
+			}
+			placements[index] = { x + padding, y + padding };
+			x += width;
+			shelfHeight = std::max(shelfHeight, height);
+		}
+		return true;
+	}
+
+	// copies source into the atlas at placement, its border rows and columns repeated over the padding
+	void blit(const Texture& source, const Placement& placement, uint32_t padding, uint32_t atlasWidth, uint8_t* atlas)
+	{
+		const uint32_t width = source._width;
+		const uint32_t height = source._height;
+		for (uint32_t row = 0; row < height + 2 * padding; row++)
+		{
+			const uint32_t sourceRow = std::min(row > padding ? row - padding : 0u, height - 1);
+			const uint8_t* src = source._pixels.data() + size_t(sourceRow) * width * 4;
+			uint8_t* dst = atlas + (size_t(placement.y - padding + row) * atlasWidth + placement.x - padding) * 4;
+			for (uint32_t column = 0; column < padding; column++)
+			{
+				memcpy(dst + column * 4, src, 4);
+				memcpy(dst + (padding + width + column) * 4, src + (width - 1) * 4, 4);
+			}
+			memcpy(dst + padding * 4, src, size_t(width) * 4);
+		}
+	}
+
+	bool in_unit_square(const Mesh& mesh)
+	{
+		// a little slack for exporters that round the edges of the square
+		const float epsilon = 1e-3f;
+		for (const glm::vec2& uv : mesh._texcoords)
+		{
+			if (uv.x < -epsilon || uv.y < -epsilon || uv.x > 1.f + epsilon || uv.y > 1.f + epsilon)
+			{
+				return false;
+			}
+		}
+		return !mesh._texcoords.empty();
+	}
+}
+
+bool pack_texture_atlas(const std::vector<const Texture*>& sources, Texture& atlas, std::vector<AtlasRegion>& regions,
+	const TextureAtlasSettings& settings)
+{
+	uint64_t area = 0;
+	for (const Texture* source : sources)
+	{
+		if (source->is_block_compressed() || source->_levels.size() != 1 || source->_width == 0 || source->_height == 0)
+		{
+			return false;
+		}
+		area += uint64_t(source->_width + 2 * settings.padding) * (source->_height + 2 * settings.padding);
+	}
+
+	// tallest first, so each shelf wastes little above its shorter members
+	std::vector<uint32_t> order(sources.size());
+	std::iota(order.begin(), order.end(), 0u);
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		return sources[a]->_height != sources[b]->_height ? sources[a]->_height > sources[b]->_height : a < b;
+	});
+
+	// the smallest power of two holding the area, doubled until the shelves fit
+	uint32_t size = 1;
+	while (uint64_t(size) * size < area)
+	{
+		size *= 2;
+	}
+	std::vector<Placement> placements(sources.size());
+	while (size <= settings.maxSize && !place(sources, order, size, settings.padding, placements))
+	{
+		size *= 2;
+	}
+	if (size > settings.maxSize)
+	{
+		return false;
+	}
+
+	atlas = Texture();
+	atlas._width = size;
+	atlas._height = size;
+	atlas._format = VK_FORMAT_R8G8B8A8_SRGB;
+	atlas._pixels.assign(size_t(size) * size * 4, 0);
+	atlas._levels = { { size, size, 0, atlas._pixels.size() } };
+	parallel_for(sources.size(), [&](size_t i) {
+		blit(*sources[i], placements[i], settings.padding, size, atlas._pixels.data());
+	});
+
+	// rows run top-down in the image while v runs up, so a source's bottom edge sets its v offset
+	regions.resize(sources.size());
+	const float invSize = 1.f / size;
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		const Texture& source = *sources[i];
+		regions[i].offset = glm::vec2(placements[i].x, size - placements[i].y - source._height) * invSize;
+		regions[i].scale = glm::vec2(source._width, source._height) * invSize;
+	}
+	return true;
+}
+
+uint32_t atlas_part_textures(std::vector<Mesh>& parts, const std::string& atlasPath, const char* sourcePath,
+	const TextureAtlasSettings& settings)
+{
+	// each map once, however many parts use it; a map one tiling part uses stays out for all of them,
+	// since it must stay a texture of its own for that part anyway
+	std::vector<std::string> maps;
+	std::vector<std::vector<size_t>> users;
+	std::vector<uint8_t> excluded;
+	for (size_t p = 0; p < parts.size(); p++)
+	{
+		const std::string& map = parts[p]._material.diffuseTexture;
+		if (map.empty())
+		{
+			continue;
+		}
+		auto found = std::find(maps.begin(), maps.end(), map);
+		if (found == maps.end())
+		{
+			found = maps.insert(maps.end(), map);
+			users.emplace_back();
+			excluded.push_back(0);
+		}
+		const size_t m = found - maps.begin();
+		users[m].push_back(p);
+		excluded[m] |= !in_unit_square(parts[p]);
+	}
+
+	std::vector<size_t> candidates;
+	for (size_t m = 0; m < maps.size(); m++)
+	{
+		if (!excluded[m])
+		{
+			candidates.push_back(m);
+		}
+	}
+	if (candidates.size() < settings.minSources)
+	{
+		return 0;
+	}
+
+	std::vector<Texture> textures(candidates.size());
+	std::vector<uint8_t> loaded(candidates.size(), 0);
+	parallel_for(candidates.size(), [&](size_t i) {
+		loaded[i] = textures[i].load_from_image(maps[candidates[i]].c_str());
+	});
+	std::vector<const Texture*> sources;
+	std::vector<size_t> packed;
+	for (size_t i = 0; i < candidates.size(); i++)
+	{
+		if (loaded[i] && textures[i]._width + 2 * settings.padding <= settings.maxSize && textures[i]._height + 2 * settings.padding <= settings.maxSize)
+		{
+			sources.push_back(&textures[i]);
+			packed.push_back(candidates[i]);
+		}
+	}
+	if (sources.size() < settings.minSources)
+	{
+		return 0;
+	}
+
+	Texture atlas;
+	std::vector<AtlasRegion> regions;
+	if (!pack_texture_atlas(sources, atlas, regions, settings))
+	{
+		LOG_WARN(sourcePath << ": " << sources.size() << " diffuse maps don't fit a " << settings.maxSize << " atlas");
+		return 0;
+	}
+	if (!atlas.save_to_cache(atlasPath.c_str(), sourcePath))
+	{
+		LOG_WARN("could not write texture atlas " << atlasPath);
+		return 0;
+	}
+
+	for (size_t i = 0; i < packed.size(); i++)
+	{
+		for (size_t p : users[packed[i]])
+		{
+			Mesh& part = parts[p];
+			for (glm::vec2& uv : part._texcoords)
+			{
+				uv = regions[i].offset + glm::clamp(uv, 0.f, 1.f) * regions[i].scale;
+			}
+			part._material.diffuseTexture = atlasPath;
+		}
+	}
+	LOG_INFO(sourcePath << ": " << packed.size() << " diffuse maps packed into a " << atlas._width << "x" << atlas._height << " atlas");
+	return static_cast<uint32_t>(packed.size());
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <Mesh.h>
+#include <Texture.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/vec2.hpp>
+
+// where a source landed in its atlas, as the transform taking the source's UVs to the atlas's:
+// uv' = offset + uv * scale, v up as OBJ writes it
+struct AtlasRegion {
+	glm::vec2 offset;
+	glm::vec2 scale;
+};
+
+struct TextureAtlasSettings {
+	// the atlas stays square-ish and at most this many texels a side; sources that don't fit stay on their own
+	uint32_t maxSize{ 4096 };
+	// texels of each source's border repeated around it, so filtering and the first few mips don't bleed
+	// the neighbours in
+	uint32_t padding{ 4 };
+	// fewer maps than this aren't worth an atlas
+	uint32_t minSources{ 2 };
+};
+
+// Shelf packing of decoded rgba8 images (level 0, as load_from_image leaves them) into one texture of the
+// same format: sources sorted by height fill rows left to right, at the smallest power-of-two size they fit
+// in. regions receives one entry per source, in order. False, with atlas and regions untouched, when the
+// sources don't fit in settings.maxSize or one of them isn't a decoded image.
+bool pack_texture_atlas(const std::vector<const Texture*>& sources, Texture& atlas, std::vector<AtlasRegion>& regions,
+	const TextureAtlasSettings& settings = {});
+
+// Import-time counterpart for an OBJ's parts: the diffuse maps of every part whose UVs stay inside the unit
+// square go into one atlas written to atlasPath (TEXTURE_ATLAS_EXTENSION, stamped with sourcePath), and those
+// parts get their UVs remapped into it and atlasPath as their diffuse map. Parts differing only in their
+// map then share one texture, and so one material. Tiling UVs would wrap into the neighbours, so their
+// parts keep their own. Returns the number of maps packed, 0 when there was no atlas to make.
+uint32_t atlas_part_textures(std::vector<Mesh>& parts, const std::string& atlasPath, const char* sourcePath,
+	const TextureAtlasSettings& settings = {});
@@ -0,0 +1,315 @@
+#include "TextureCompressor.h"
+
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+	float srgb_to_linear(float c)
+	{
+		return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+	}
+
+	float linear_to_srgb(float c)
+	{
+		return c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.f / 2.4f) - 0.055f;
+	}
+
+	// powf per texel dominates downsampling otherwise; 4096 linear steps keep the round trip exact for 8 bits
+	constexpr int LINEAR_STEPS = 4096;
+
+	struct SrgbTable {
+		float toLinear[256];
+		uint8_t toSrgb[LINEAR_STEPS + 1];
+
+		SrgbTable()
+		{
+			for (int i = 0; i < 256; i++)
+			{
+				toLinear[i] = srgb_to_linear(i / 255.f);
+			}
+			for (int i = 0; i <= LINEAR_STEPS; i++)
+			{
+				toSrgb[i] = static_cast<uint8_t>(linear_to_srgb(float(i) / LINEAR_STEPS) * 255.f + 0.5f);
+			}
+		}
+
+		uint8_t encode(float linear) const
+		{
+			return toSrgb[static_cast<int>(std::min(std::max(linear, 0.f), 1.f) * LINEAR_STEPS + 0.5f)];
+		}
+	};
+
+	// 4x4 texels, clamped at the image edge
+	void load_block(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t bx, uint32_t by, uint8_t block[16][4])
+	{
+		for (uint32_t y = 0; y < 4; y++)
+		{
+			uint32_t sy = std::min(by * 4 + y, height - 1);
+			for (uint32_t x = 0; x < 4; x++)
+			{
+				uint32_t sx = std::min(bx * 4 + x, width - 1);
+				memcpy(block[y * 4 + x], rgba + (size_t(sy) * width + sx) * 4, 4);
+			}
+		}
+	}
+
+	uint16_t pack_565(const float c[3])
+	{
+		uint32_t r = static_cast<uint32_t>(std::min(std::max(c[0], 0.f), 255.f) * 31.f / 255.f + 0.5f);
+		uint32_t g = static_cast<uint32_t>(std::min(std::max(c[1], 0.f), 255.f) * 63.f / 255.f + 0.5f);
+		uint32_t b = static_cast<uint32_t>(std::min(std::max(c[2], 0.f), 255.f) * 31.f / 255.f + 0.5f);
+		return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+	}
+
+	void unpack_565(uint16_t c, int out[3])
+	{
+		int r = (c >> 11) & 31;
+		int g = (c >> 5) & 63;
+		int b = c & 31;
+		out[0] = (r << 3) | (r >> 2);
+		out[1] = (g << 2) | (g >> 4);
+		out[2] = (b << 3) | (b >> 2);
+	}
+
+	// BC1 color block in four-color mode
+	void compress_color_block(const uint8_t block[16][4], uint8_t* dst)
+	{
+		float mean[3] = { 0.f, 0.f, 0.f };
+		float minColor[3] = { 255.f, 255.f, 255.f };
+		float maxColor[3] = { 0.f, 0.f, 0.f };
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				mean[c] += block[i][c];
+				minColor[c] = std::min(minColor[c], float(block[i][c]));
+				maxColor[c] = std::max(maxColor[c], float(block[i][c]));
+			}
+		}
+		for (int c = 0; c < 3; c++)
+		{
+			mean[c] /= 16.f;
+		}
+
+		float cov[6] = { 0.f, 0.f, 0.f, 0.f, 0.f, 0.f };
+		for (int i = 0; i < 16; i++)
+		{
+			float r = block[i][0] - mean[0];
+			float g = block[i][1] - mean[1];
+			float b = block[i][2] - mean[2];
+			cov[0] += r * r;
+			cov[1] += r * g;
+			cov[2] += r * b;
+			cov[3] += g * g;
+			cov[4] += g * b;
+			cov[5] += b * b;
+		}
+
+		// principal axis by power iteration, starting from the bounding box diagonal
+		float axis[3] = { maxColor[0] - minColor[0], maxColor[1] - minColor[1], maxColor[2] - minColor[2] };
+		for (int iteration = 0; iteration < 4; iteration++)
+		{
+			float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+			float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+			float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+			float length = std::max(std::max(fabsf(x), fabsf(y)), fabsf(z));
+			if (length < 1e-6f)
+			{
+				break;
+			}
+			axis[0] = x / length;
+			axis[1] = y / length;
+			axis[2] = z / length;
+		}
+		float axisLength2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+
+		float minT = 0.f, maxT = 0.f;
+		if (axisLength2 > 1e-12f)
+		{
+			for (int i = 0; i < 16; i++)
+			{
+				float t = ((block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1] + (block[i][2] - mean[2]) * axis[2]) / axisLength2;
+				minT = std::min(minT, t);
+				maxT = std::max(maxT, t);
+			}
+		}
+
+		float end0[3], end1[3];
+		for (int c = 0; c < 3; c++)
+		{
+			end0[c] = mean[c] + axis[c] * maxT;
+			end1[c] = mean[c] + axis[c] * minT;
+		}
+
+		uint16_t c0 = pack_565(end0);
+		uint16_t c1 = pack_565(end1);
+		// c0 > c1 selects four-color mode; equal endpoints leave every texel on c0
+		if (c0 < c1)
+		{
+			std::swap(c0, c1);
+		}
+
+		uint32_t indices = 0;
+		if (c0 != c1)
+		{
+			int palette[4][3];
+			unpack_565(c0, palette[0]);
+			unpack_565(c1, palette[1]);
+			for (int c = 0; c < 3; c++)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+
+			for (int i = 0; i < 16; i++)
+			{
+				int best = 0;
+				int bestDistance = INT32_MAX;
+				for (int p = 0; p < 4; p++)
+				{
+					int dr = block[i][0] - palette[p][0];
+					int dg = block[i][1] - palette[p][1];
+					int db = block[i][2] - palette[p][2];
+					int distance = dr * dr + dg * dg + db * db;
+					if (distance < bestDistance)
+					{
+						bestDistance = distance;
+						best = p;
+					}
+				}
+				indices |= uint32_t(best) << (i * 2);
+			}
+		}
+
+		memcpy(dst, &c0, 2);
+		memcpy(dst + 2, &c1, 2);
+		memcpy(dst + 4, &indices, 4);
+	}
+
+	// BC4-style alpha block in eight-value mode
+	void compress_alpha_block(const uint8_t block[16][4], uint8_t* dst)
+	{
+		int a0 = 0, a1 = 255;
+		for (int i = 0; i < 16; i++)
+		{
+			a0 = std::max(a0, int(block[i][3]));
+			a1 = std::min(a1, int(block[i][3]));
+		}
+
+		uint64_t indices = 0;
+		if (a0 != a1)
+		{
+			int palette[8];
+			palette[0] = a0;
+			palette[1] = a1;
+			for (int p = 1; p < 7; p++)
+			{
+				palette[p + 1] = ((7 - p) * a0 + p * a1) / 7;
+			}
+
+			for (int i = 0; i < 16; i++)
+			{
+				int best = 0;
+				int bestDistance = INT32_MAX;
+				for (int p = 0; p < 8; p++)
+				{
+					int distance = std::abs(int(block[i][3]) - palette[p]);
+					if (distance < bestDistance)
+					{
+						bestDistance = distance;
+						best = p;
+					}
+				}
+				indices |= uint64_t(best) << (i * 3);
+			}
+		}
+
+		dst[0] = static_cast<uint8_t>(a0);
+		dst[1] = static_cast<uint8_t>(a1);
+		for (int i = 0; i < 6; i++)
+		{
+			dst[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+		}
+	}
+}
+
+size_t texcomp::compressed_size(BlockFormat format, uint32_t width, uint32_t height)
+{
+	const size_t blocks = size_t((width + 3) / 4) * ((height + 3) / 4);
+	return blocks * (format == BlockFormat::BC1 ? 8 : 16);
+}
+
+bool texcomp::is_opaque(const uint8_t* rgba, size_t pixelCount)
+{
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		if (rgba[i * 4 + 3] != 255)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void texcomp::downsample(const uint8_t* src, uint32_t width, uint32_t height, std::vector<uint8_t>& dst)
+{
+	static const SrgbTable table;
+
+	const uint32_t dstWidth = std::max(width / 2, 1u);
+	const uint32_t dstHeight = std::max(height / 2, 1u);
+	dst.resize(size_t(dstWidth) * dstHeight * 4);
+
+	parallel_for(dstHeight, [&](size_t y) {
+		// odd sizes drop the last row/column, like the GPU blit path; 1-texel sides reuse the same texel
+		const uint32_t y0 = std::min(uint32_t(y) * 2, height - 1);
+		const uint32_t y1 = std::min(y0 + 1, height - 1);
+		for (uint32_t x = 0; x < dstWidth; x++)
+		{
+			const uint32_t x0 = std::min(x * 2, width - 1);
+			const uint32_t x1 = std::min(x0 + 1, width - 1);
+			const uint8_t* texels[4] = {
+				src + (size_t(y0) * width + x0) * 4, src + (size_t(y0) * width + x1) * 4,
+				src + (size_t(y1) * width + x0) * 4, src + (size_t(y1) * width + x1) * 4,
+			};
+
+			uint8_t* out = dst.data() + (y * dstWidth + x) * 4;
+			for (int c = 0; c < 3; c++)
+			{
+				float sum = 0.f;
+				for (const uint8_t* texel : texels)
+				{
+					sum += table.toLinear[texel[c]];
+				}
+				out[c] = table.encode(sum * 0.25f);
+			}
+			// alpha is stored linearly
+			out[3] = static_cast<uint8_t>((texels[0][3] + texels[1][3] + texels[2][3] + texels[3][3] + 2) / 4);
+		}
+	});
+}
+
+void texcomp::compress(BlockFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* dst)
+{
+	const uint32_t blocksX = (width + 3) / 4;
+	const uint32_t blocksY = (height + 3) / 4;
+	const size_t blockBytes = format == BlockFormat::BC1 ? 8 : 16;
+
+	parallel_for(blocksY, [&](size_t by) {
+		uint8_t block[16][4];
+		uint8_t* out = dst + by * blocksX * blockBytes;
+		for (uint32_t bx = 0; bx < blocksX; bx++)
+		{
+			load_block(rgba, width, height, bx, uint32_t(by), block);
+			if (format == BlockFormat::BC3)
+			{
+				compress_alpha_block(block, out);
+				out += 8;
+			}
+			compress_color_block(block, out);
+			out += 8;
+		}
+	});
+}
@@ -0,0 +1,97 @@
+#include "TiledRender.h"
+
+#include "Log.h"
+
+#include <algorithm>
+
+TileGrid TileGrid::cover(uint32_t width, uint32_t height, uint32_t maxTile)
+{
+	TileGrid grid;
+	grid.width = width;
+	grid.height = height;
+	maxTile = std::max(maxTile, 1u);
+	grid.columns = std::max((width + maxTile - 1) / maxTile, 1u);
+	grid.rows = std::max((height + maxTile - 1) / maxTile, 1u);
+	// as even as they can be, so the grid passes the image by less than a pixel per tile
+	grid.tileWidth = (width + grid.columns - 1) / grid.columns;
+	grid.tileHeight = (height + grid.rows - 1) / grid.rows;
+	return grid;
+}
+
+bool TiledImageWriter::open(const std::string& path, const TileGrid& grid)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_grid = grid;
+	_path = path;
+	_file.open(path, std::ios::binary | std::ios::trunc);
+	if (!_file)
+	{
+		return false;
+	}
+	_file << "P6\n" << grid.width << " " << grid.height << "\n255\n";
+	_headerSize = _file.tellp();
+	// the last byte sizes the file; the tiles fill in the rest
+	_file.seekp(_headerSize + static_cast<std::streamoff>(grid.width) * grid.height * 3 - 1);
+	_file.put(0);
+	_written.assign(grid.count(), 0);
+	_writtenCount = 0;
+	_row.resize(static_cast<size_t>(grid.tileWidth) * 3);
+	return _file.good();
+}
+
+bool TiledImageWriter::write_tile(const FrameReadback::Result& result, uint32_t column, uint32_t row)
+{
+	if (result.format != ReadbackFormat::Rgba || column >= _grid.columns || row >= _grid.rows
+		|| result.extent.width < _grid.tileWidth || result.extent.height < _grid.tileHeight)
+	{
+		return false;
+	}
+
+	// the grid's last column and row may pass the image's edges
+	const uint32_t left = column * _grid.tileWidth;
+	const uint32_t top = row * _grid.tileHeight;
+	const uint32_t width = std::min(_grid.tileWidth, _grid.width - left);
+	const uint32_t height = std::min(_grid.tileHeight, _grid.height - top);
+	// PPM wants RGB; the formats the engine renders to are usually BGRA
+	const bool bgra = result.imageFormat == VK_FORMAT_B8G8R8A8_SRGB || result.imageFormat == VK_FORMAT_B8G8R8A8_UNORM;
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	for (uint32_t y = 0; y < height; y++)
+	{
+		const uint8_t* src = result.data + static_cast<size_t>(y) * result.extent.width * 4;
+		for (uint32_t x = 0; x < width; x++)
+		{
+			_row[x * 3 + 0] = static_cast<char>(src[x * 4 + (bgra ? 2 : 0)]);
+			_row[x * 3 + 1] = static_cast<char>(src[x * 4 + 1]);
+			_row[x * 3 + 2] = static_cast<char>(src[x * 4 + (bgra ? 0 : 2)]);
+		}
+		_file.seekp(_headerSize + (static_cast<std::streamoff>(top + y) * _grid.width + left) * 3);
+		_file.write(_row.data(), static_cast<std::streamsize>(width) * 3);
+	}
+	if (!_file.good())
+	{
+		return false;
+	}
+	const uint32_t tile = row * _grid.columns + column;
+	_writtenCount += _written[tile] == 0 ? 1 : 0;
+	_written[tile] = 1;
+	return true;
+}
+
+bool TiledImageWriter::close()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_file.close();
+	const bool complete = _writtenCount == _grid.count() && !_file.fail();
+	if (!complete)
+	{
+		LOG_ERROR(_path << ": " << _writtenCount << " of " << _grid.count() << " tiles written");
+	}
+	return complete;
+}
+
+uint32_t TiledImageWriter::tiles_written() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _writtenCount;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vk_types.h>
+#include <FrameReadback.h>
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// A still too large for any framebuffer, as a grid of equal tiles: each is rendered at the engine's extent
+// through its own sub-frustum of the camera (Camera::set_tile), read back, and written into the image file
+// where it belongs, so the whole image is never in memory.
+struct TileGrid {
+	uint32_t width{ 0 }; // of the whole image
+	uint32_t height{ 0 };
+	uint32_t tileWidth{ 0 };
+	uint32_t tileHeight{ 0 };
+	uint32_t columns{ 0 };
+	uint32_t rows{ 0 };
+
+	// the fewest tiles of at most maxTile pixels a side covering width x height, all of one size. The view
+	// spans the whole grid, which may pass the image's right and bottom edges by a few pixels; those are cropped
+	static TileGrid cover(uint32_t width, uint32_t height, uint32_t maxTile);
+	uint32_t count() const { return columns * rows; }
+	VkExtent2D tile_extent() const { return { tileWidth, tileHeight }; }
+};
+
+// A binary PPM of the whole image, created at its full size and filled a tile at a time: each row of a tile is
+// written at its place in the file, so only the tiles being delivered are in memory. Any thread may write a
+// tile, and several engines one image
+class TiledImageWriter
+{
+public:
+	bool open(const std::string& path, const TileGrid& grid);
+	// an Rgba readback of the grid's tile column, row; false if it isn't one or couldn't be written
+	bool write_tile(const FrameReadback::Result& result, uint32_t column, uint32_t row);
+	// false unless every tile was written
+	bool close();
+
+	uint32_t tiles_written() const;
+
+private:
+	TileGrid _grid;
+	std::string _path;
+	std::ofstream _file;
+	std::streamoff _headerSize{ 0 };
+	std::vector<uint8_t> _written; // by tile
+	uint32_t _writtenCount{ 0 };
+	std::vector<char> _row; // one tile row converted to RGB
+	mutable std::mutex _mutex;
+};
@@ -0,0 +1,153 @@
+#include "TransformStore.h"
+
+#include "JobSystem.h"
+#include "SimdLanes.h"
+
+#include <algorithm>
+#include <initializer_list>
+
+namespace {
+	// below this many dirty groups the job system costs more than it saves
+	constexpr size_t GROUPS_PER_JOB = 1024;
+}
+
+uint32_t TransformStore::add(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale, uint32_t parent)
+{
+	// grow a whole SIMD group at a time; the padding lanes hold identity transforms
+	if (_count % SIMD_WIDTH == 0)
+	{
+		for (std::vector<float>* zeros : { &_positionX, &_positionY, &_positionZ, &_rotationX, &_rotationY, &_rotationZ })
+		{
+			zeros->resize(_count + SIMD_WIDTH, 0.0f);
+		}
+		for (std::vector<float>* ones : { &_rotationW, &_scaleX, &_scaleY, &_scaleZ })
+		{
+			ones->resize(_count + SIMD_WIDTH, 1.0f);
+		}
+		_parent.resize(_count + SIMD_WIDTH, NO_PARENT);
+		_nodeDirty.resize(_count + SIMD_WIDTH, 0);
+		_local.resize(_count + SIMD_WIDTH, glm::mat4{ 1.0f });
+		_world.resize(_count + SIMD_WIDTH, glm::mat4{ 1.0f });
+	}
+
+	const uint32_t index = static_cast<uint32_t>(_count++);
+	_parent[index] = parent < index ? parent : NO_PARENT;
+	set(index, position, rotation, scale);
+	return index;
+}
+
+std::vector<float>& TransformStore::node_vector(uint32_t array)
+{
+	switch (array)
+	{
+	case 0: return _positionX;
+	case 1: return _positionY;
+	case 2: return _positionZ;
+	case 3: return _rotationX;
+	case 4: return _rotationY;
+	case 5: return _rotationZ;
+	case 6: return _rotationW;
+	case 7: return _scaleX;
+	case 8: return _scaleY;
+	default: return _scaleZ;
+	}
+}
+
+void TransformStore::assign(size_t count, const uint32_t* parents, const float* const arrays[NODE_ARRAYS])
+{
+	const size_t padded = (count + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+	for (uint32_t array = 0; array < NODE_ARRAYS; array++)
+	{
+		// the padding lanes hold identity transforms, as add() leaves them
+		std::vector<float>& target = node_vector(array);
+		target.assign(padded, array >= 6 ? 1.0f : 0.0f);
+		std::copy(arrays[array], arrays[array] + count, target.begin());
+	}
+	_parent.assign(padded, NO_PARENT);
+	for (size_t i = 0; i < count; i++)
+	{
+		_parent[i] = parents[i] < i ? parents[i] : NO_PARENT;
+	}
+	_nodeDirty.assign(padded, 0);
+	std::fill(_nodeDirty.begin(), _nodeDirty.begin() + count, uint8_t(1));
+	_local.assign(padded, glm::mat4{ 1.0f });
+	_world.assign(padded, glm::mat4{ 1.0f });
+
+	_count = count;
+	_firstDirty = 0;
+	_dirty = count > 0;
+}
+
+void TransformStore::set(uint32_t index, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+	_positionX[index] = position.x;
+	_positionY[index] = position.y;
+	_positionZ[index] = position.z;
+	_rotationX[index] = rotation.x;
+	_rotationY[index] = rotation.y;
+	_rotationZ[index] = rotation.z;
+	_rotationW[index] = rotation.w;
+	_scaleX[index] = scale.x;
+	_scaleY[index] = scale.y;
+	_scaleZ[index] = scale.z;
+
+	_firstDirty = _dirty ? std::min<size_t>(_firstDirty, index) : index;
+	_nodeDirty[index] = 1;
+	_dirty = true;
+}
+
+void TransformStore::update()
+{
+	if (!_dirty)
+	{
+		return;
+	}
+	_dirty = false;
+
+	// local matrices: whole SIMD groups around every dirty node
+	_dirtyGroups.clear();
+	for (size_t group = _firstDirty / SIMD_WIDTH; group * SIMD_WIDTH < _count; group++)
+	{
+		const uint8_t* flags = &_nodeDirty[group * SIMD_WIDTH];
+		if (flags[0] | flags[1] | flags[2] | flags[3])
+		{
+			_dirtyGroups.push_back(static_cast<uint32_t>(group));
+		}
+	}
+
+	const size_t jobCount = (_dirtyGroups.size() + GROUPS_PER_JOB - 1) / GROUPS_PER_JOB;
+	parallel_for(jobCount, [&](size_t job) {
+		const size_t end = std::min(_dirtyGroups.size(), (job + 1) * GROUPS_PER_JOB);
+		for (size_t i = job * GROUPS_PER_JOB; i < end; i++)
+		{
+			build_range(_dirtyGroups[i] * SIMD_WIDTH, SIMD_WIDTH);
+		}
+	});
+
+	// world matrices: parents come first, so a node's parent is final by the time it's reached,
+	// and a dirty parent marks the node dirty so whole subtrees follow
+	for (size_t i = _firstDirty; i < _count; i++)
+	{
+		const uint32_t parent = _parent[i];
+		if (parent != NO_PARENT && _nodeDirty[parent])
+		{
+			_nodeDirty[i] = 1;
+		}
+		if (_nodeDirty[i])
+		{
+			_world[i] = parent == NO_PARENT ? _local[i] : _world[parent] * _local[i];
+		}
+	}
+	std::fill(_nodeDirty.begin() + _firstDirty, _nodeDirty.end(), 0);
+}
+
+void TransformStore::build_range(size_t first, size_t count)
+{
+	for (size_t i = first; i < first + count; i += SIMD_WIDTH)
+	{
+		store_trs(&_local[i],
+			lanes_load(&_positionX[i]), lanes_load(&_positionY[i]), lanes_load(&_positionZ[i]),
+			lanes_load(&_rotationX[i]), lanes_load(&_rotationY[i]), lanes_load(&_rotationZ[i]), lanes_load(&_rotationW[i]),
+			lanes_load(&_scaleX[i]), lanes_load(&_scaleY[i]), lanes_load(&_scaleZ[i]));
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Scene graph of parent-relative transforms: translation, rotation and scale of every node in
+// structure-of-arrays form, plus the world matrices built from them. Nodes are stored in topological
+// order (a parent always comes before its children), so one forward pass resolves the hierarchy.
+// update() only touches what changed: local matrices of dirty nodes are rebuilt four at a time with
+// SSE or NEON (scalar elsewhere), split over the job system when there are many, then world matrices
+// are recomputed for the dirty nodes and everything below them. Render objects refer to their node
+// by index, so sorting the render list doesn't move any transform data.
+class TransformStore
+{
+public:
+	static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+	// returns the node's index; parent must already be in the store, which keeps the order topological
+	uint32_t add(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale, uint32_t parent = NO_PARENT);
+	// moves the node relative to its parent; its whole subtree follows on the next update()
+	void set(uint32_t index, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+
+	// brings the world matrices of changed subtrees up to date; free when nothing changed
+	void update();
+
+	// valid after update()
+	const glm::mat4& world(uint32_t index) const { return _world[index]; }
+	uint32_t parent(uint32_t index) const { return _parent[index]; }
+	size_t size() const { return _count; }
+
+	// the nodes as stored, for snapshots (see SceneSnapshot.h): NODE_ARRAYS arrays of size() floats, position
+	// xyz, rotation xyzw and scale xyz, and the parents
+	static constexpr uint32_t NODE_ARRAYS = 10;
+	const float* node_array(uint32_t array) const { return const_cast<TransformStore*>(this)->node_vector(array).data(); }
+	const uint32_t* parents() const { return _parent.data(); }
+	// replaces every node with count of them, copied from arrays laid out as node_array's; a parent that
+	// doesn't come before its child becomes NO_PARENT. The next update() rebuilds them all
+	void assign(size_t count, const uint32_t* parents, const float* const arrays[NODE_ARRAYS]);
+
+private:
+	std::vector<float>& node_vector(uint32_t array);
+
+	// local matrices for [first, first + count); first must be a multiple of SIMD_WIDTH
+	void build_range(size_t first, size_t count);
+
+	size_t _count{ 0 };
+	bool _dirty{ false };
+	// nodes before this one are unaffected by the pending changes, since parents precede children
+	size_t _firstDirty{ 0 };
+
+	std::vector<uint32_t> _parent;
+	// set by set() and add(); during update() also marks nodes below a dirty one
+	std::vector<uint8_t> _nodeDirty;
+
+	// padded to a multiple of the SIMD width so kernels never need a scalar tail
+	std::vector<float> _positionX, _positionY, _positionZ;
+	std::vector<float> _rotationX, _rotationY, _rotationZ, _rotationW;
+	std::vector<float> _scaleX, _scaleY, _scaleZ;
+
+	std::vector<glm::mat4> _local;
+	std::vector<glm::mat4> _world;
+
+	// SIMD groups holding a dirty node; kept as a member so steady-state updates don't allocate
+	std::vector<uint32_t> _dirtyGroups;
+};
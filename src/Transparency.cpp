@@ -0,0 +1,67 @@
+#include "Transparency.h"
+
+#include <cstring>
+#include <numeric>
+
+namespace {
+	// unsigned order of the result is the float order, negatives included: negatives flip every bit, so
+	// larger magnitudes come first, and positives only the sign, which puts them above every negative
+	uint32_t ascending_key(float depth)
+	{
+		uint32_t bits;
+		memcpy(&bits, &depth, sizeof(bits));
+		return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+	}
+}
+
+const std::vector<uint32_t>& DepthSorter::sort_back_to_front(const float* depths, uint32_t count)
+{
+	_keys.resize(count);
+	_keysScratch.resize(count);
+	_order.resize(count);
+	_orderScratch.resize(count);
+	std::iota(_order.begin(), _order.end(), 0u);
+
+	// every pass's histogram in one read of the keys; inverting makes the farthest the smallest key
+	uint32_t histograms[4][256] = {};
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const uint32_t key = ~ascending_key(depths[i]);
+		_keys[i] = key;
+		for (uint32_t pass = 0; pass < 4; pass++)
+		{
+			histograms[pass][(key >> (pass * 8)) & 0xff]++;
+		}
+	}
+
+	_lastPassCount = 0;
+	for (uint32_t pass = 0; pass < 4; pass++)
+	{
+		uint32_t* histogram = histograms[pass];
+		const uint32_t shift = pass * 8;
+		// one bucket holding everything would only copy the arrays over
+		if (count == 0 || histogram[(_keys[0] >> shift) & 0xff] == count)
+		{
+			continue;
+		}
+
+		// bucket starts, then a stable scatter in input order
+		uint32_t offset = 0;
+		for (uint32_t bucket = 0; bucket < 256; bucket++)
+		{
+			const uint32_t size = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += size;
+		}
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const uint32_t slot = histogram[(_keys[i] >> shift) & 0xff]++;
+			_keysScratch[slot] = _keys[i];
+			_orderScratch[slot] = _order[i];
+		}
+		_keys.swap(_keysScratch);
+		_order.swap(_orderScratch);
+		_lastPassCount++;
+	}
+	return _order;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <Mesh.h>
+
+#include <cstdint>
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+// how the transparent pass blends its objects over the opaque scene
+enum class TransparencyMode : uint32_t {
+	Sorted, // back to front by view depth, each over what's behind it; exact, but the order costs a sort
+	WeightedBlended, // any order into accumulation targets composited after (McGuire and Bavoil); no sort, approximate
+};
+
+// an object drawn blended over the scene, after every opaque pass; not in the render list, since none of
+// the opaque paths (indirect, meshlets, static caches) may draw it
+struct TransparentObject {
+	Mesh* mesh;
+	glm::mat4 transform;
+	glm::vec4 color; // linear rgb, alpha its opacity
+};
+
+// what the transparent pipelines push per draw: the vertex stage reads the model, the fragment stages the color
+struct TransparentPushConstants {
+	glm::mat4 model;
+	glm::vec4 color;
+};
+
+// Back-to-front draw order by LSD radix sort of view depths: each float becomes a 32-bit key that orders
+// as unsigned, inverted so the farthest comes first, and four 8-bit counting passes sort the keys with
+// their indices. Linear in the count, so thousands of objects cost a few passes over two arrays rather
+// than a comparison sort's n log n branches, and a pass whose byte is the same for every key (the sign
+// and exponent bits of a scene at similar distances) is skipped. Equal depths keep their input order,
+// so objects at one depth don't flicker between frames. The scratch arrays are kept between sorts.
+class DepthSorter
+{
+public:
+	// depths are view-space distances, larger being farther, any order and any finite value; the result
+	// holds the indices 0..count-1 farthest first and stays valid until the next sort
+	const std::vector<uint32_t>& sort_back_to_front(const float* depths, uint32_t count);
+
+	// counting passes the last sort needed, 0 to 4
+	uint32_t last_pass_count() const { return _lastPassCount; }
+
+private:
+	std::vector<uint32_t> _keys;
+	std::vector<uint32_t> _keysScratch;
+	std::vector<uint32_t> _order;
+	std::vector<uint32_t> _orderScratch;
+	uint32_t _lastPassCount{ 0 };
+};
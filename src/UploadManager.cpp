@@ -0,0 +1,463 @@
+#include "UploadManager.h"
+
+#include <vk_initializers.h>
+#include <FrameStats.h>
+#include <vk_mem_alloc.h>
+
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+	// covers the texel blocks of every format uploaded, and the 4 bytes buffer copies need
+	constexpr VkDeviceSize RING_ALIGNMENT = 16;
+}
+
+void UploadManager::init(VkDevice device, VmaAllocator allocator, VkQueue transferQueue, uint32_t transferFamily,
+	uint32_t graphicsFamily, bool timelineSemaphores, std::mutex& queueMutex, VmaPool stagingPool, VkDeviceSize ringSize)
+{
+	_device = device;
+	_allocator = allocator;
+	_stagingPool = stagingPool;
+	_transferQueue = transferQueue;
+	_queueMutex = &queueMutex;
+	_transferFamily = transferFamily;
+	_graphicsFamily = graphicsFamily;
+
+	// command buffers are reset one by one as their batches retire
+	VkCommandPoolCreateInfo poolInfo = vkinit::command_pool_create_info(_transferFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+	VK_CHECK(vkCreateCommandPool(_device, &poolInfo, nullptr, &_commandPool));
+
+	if (ringSize > 0)
+	{
+		VkBufferCreateInfo bufferInfo = {};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = ringSize;
+		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+		// outside the staging pool: one allocation of its own for the engine's lifetime, mapped throughout
+		VmaAllocationCreateInfo allocInfo = {};
+		allocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+		allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+
+		VmaAllocationInfo allocationInfo = {};
+		if (vmaCreateBuffer(_allocator, &bufferInfo, &allocInfo, &_ring._buffer, &_ring._allocation, &allocationInfo) == VK_SUCCESS)
+		{
+			_ring._mapped = allocationInfo.pMappedData;
+			_ringSize = ringSize;
+		}
+	}
+
+	if (timelineSemaphores)
+	{
+		_vkGetSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(_device, "vkGetSemaphoreCounterValueKHR");
+		_vkWaitSemaphores = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(_device, "vkWaitSemaphoresKHR");
+		timelineSemaphores = _vkGetSemaphoreCounterValue != nullptr && _vkWaitSemaphores != nullptr;
+	}
+	_timelineSemaphores = timelineSemaphores;
+
+	if (_timelineSemaphores)
+	{
+		VkSemaphoreTypeCreateInfoKHR typeInfo = {};
+		typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+		typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+		typeInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo semaphoreInfo = vkinit::semaphore_create_info();
+		semaphoreInfo.pNext = &typeInfo;
+		VK_CHECK(vkCreateSemaphore(_device, &semaphoreInfo, nullptr, &_timeline));
+	}
+	else
+	{
+		VkFenceCreateInfo fenceInfo = vkinit::fence_create_info();
+		VK_CHECK(vkCreateFence(_device, &fenceInfo, nullptr, &_fence));
+	}
+}
+
+void UploadManager::cleanup()
+{
+	if (_device == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	flush();
+	wait(_nextValue - 1);
+	collect();
+
+	if (_timeline != VK_NULL_HANDLE)
+	{
+		vkDestroySemaphore(_device, _timeline, nullptr);
+	}
+	if (_fence != VK_NULL_HANDLE)
+	{
+		vkDestroyFence(_device, _fence, nullptr);
+	}
+	if (_ringSize > 0)
+	{
+		vmaDestroyBuffer(_allocator, _ring._buffer, _ring._allocation);
+		_ring = AllocatedBuffer{};
+		_ringSize = 0;
+	}
+	// destroying the pool frees every command buffer allocated from it
+	vkDestroyCommandPool(_device, _commandPool, nullptr);
+	_device = VK_NULL_HANDLE;
+}
+
+UploadManager::Batch& UploadManager::open_batch()
+{
+	if (_batchOpen)
+	{
+		return _openBatch;
+	}
+
+	_openBatch = Batch{};
+	if (!_freeCommandBuffers.empty())
+	{
+		_openBatch.cmd = _freeCommandBuffers.back();
+		_freeCommandBuffers.pop_back();
+	}
+	else
+	{
+		VkCommandBufferAllocateInfo allocInfo = vkinit::command_buffer_allocate_info(_commandPool, 1);
+		VK_CHECK(vkAllocateCommandBuffers(_device, &allocInfo, &_openBatch.cmd));
+	}
+
+	VkCommandBufferBeginInfo beginInfo = vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	VK_CHECK(vkBeginCommandBuffer(_openBatch.cmd, &beginInfo));
+
+	_batchOpen = true;
+	return _openBatch;
+}
+
+bool UploadManager::ring_allocate(VkDeviceSize size, VkDeviceSize& offset)
+{
+	if (size > _ringSize)
+	{
+		return false;
+	}
+	uint64_t start = (_ringHead + RING_ALIGNMENT - 1) / RING_ALIGNMENT * RING_ALIGNMENT;
+	// an upload is copied from one contiguous range, so one that would straddle the end starts over at 0
+	const VkDeviceSize position = start % _ringSize;
+	if (position + size > _ringSize)
+	{
+		start += _ringSize - position;
+	}
+	if (start + size - _ringTail > _ringSize)
+	{
+		return false;
+	}
+	_ringHead = start + size;
+	offset = start % _ringSize;
+	return true;
+}
+
+UploadManager::Staging UploadManager::stage(Batch& batch, VkDeviceSize size, const std::function<void(void*)>& write)
+{
+	frame_stats::local().uploadBytes += size;
+
+	Staging staging;
+	if (ring_allocate(size, staging.offset))
+	{
+		write(static_cast<uint8_t*>(_ring._mapped) + staging.offset);
+		vmaFlushAllocation(_allocator, _ring._allocation, staging.offset, size);
+		staging.buffer = _ring._buffer;
+		batch.ringEnd = _ringHead;
+		return staging;
+	}
+
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+	// created mapped: VMA keeps each block of the pool mapped once, so a staging buffer costs no map call
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+	allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+	allocInfo.pool = _stagingPool;
+
+	AllocatedBuffer buffer;
+	VmaAllocationInfo allocationInfo = {};
+	VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &allocInfo, &buffer._buffer, &buffer._allocation, &allocationInfo));
+	buffer._mapped = allocationInfo.pMappedData;
+
+	write(buffer._mapped);
+	vmaFlushAllocation(_allocator, buffer._allocation, 0, size);
+	batch.stagingBuffers.push_back(buffer);
+	staging.buffer = buffer._buffer;
+	return staging;
+}
+
+bool UploadManager::admit(VkDeviceSize size, UploadPriority priority)
+{
+	const bool withinBudget = _frameBudget == 0 || _frameBytes + size <= _frameBudget;
+	bool admitted = withinBudget || (priority == UploadPriority::Visible && _frameBytes == 0);
+	if (admitted && priority == UploadPriority::Prefetch && _ringSize > 0)
+	{
+		admitted = ring_used() + size + _ringSize / 4 <= _ringSize;
+	}
+	if (!admitted)
+	{
+		// prefetches are refused as a matter of course once the budget is spent
+		_refused = _refused || priority == UploadPriority::Visible;
+		return false;
+	}
+	_frameBytes += size;
+	return true;
+}
+
+bool UploadManager::backlogged() const
+{
+	return _refused || (_ringSize > 0 && ring_used() > _ringSize / 4 * 3);
+}
+
+void UploadManager::upload_buffer(VkBuffer dst, VkDeviceSize dstOffset, VkDeviceSize size, const std::function<void(void*)>& write,
+	VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+{
+	if (size == 0)
+	{
+		return;
+	}
+
+	Batch& batch = open_batch();
+	const Staging staging = stage(batch, size, write);
+
+	VkBufferCopy copy = {};
+	copy.srcOffset = staging.offset;
+	copy.dstOffset = dstOffset;
+	copy.size = size;
+	vkCmdCopyBuffer(batch.cmd, staging.buffer, dst, 1, &copy);
+
+	if (!transfers_ownership())
+	{
+		// same family: the semaphore wait alone makes the copy visible
+		_openAcquires.stages |= dstStage;
+		return;
+	}
+
+	// release on the transfer queue; the matching acquire is recorded on the graphics queue
+	VkBufferMemoryBarrier release = vkinit::buffer_barrier(dst, VK_ACCESS_TRANSFER_WRITE_BIT, 0);
+	release.srcQueueFamilyIndex = _transferFamily;
+	release.dstQueueFamilyIndex = _graphicsFamily;
+	release.offset = dstOffset;
+	release.size = size;
+	_releases.add(release, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
+	VkBufferMemoryBarrier acquire = release;
+	acquire.srcAccessMask = 0;
+	acquire.dstAccessMask = dstAccess;
+	_openAcquires.buffers.push_back(acquire);
+	_openAcquires.stages |= dstStage;
+}
+
+void UploadManager::upload_image(VkImage image, uint32_t mipLevels, const std::vector<VkBufferImageCopy>& regions,
+	VkDeviceSize size, const std::function<void(void*)>& write, VkImageLayout finalLayout,
+	VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+{
+	Batch& batch = open_batch();
+	const Staging staging = stage(batch, size, write);
+
+	VkImageSubresourceRange range = {};
+	range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	range.baseMipLevel = 0;
+	range.levelCount = mipLevels;
+	range.baseArrayLayer = 0;
+	range.layerCount = 1;
+
+	VkImageMemoryBarrier toTransfer = {};
+	toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	toTransfer.srcAccessMask = 0;
+	toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	toTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	toTransfer.image = image;
+	toTransfer.subresourceRange = range;
+	vkCmdPipelineBarrier(batch.cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+	// the regions are relative to the upload, which starts wherever the ring had room
+	std::vector<VkBufferImageCopy> copies = regions;
+	for (VkBufferImageCopy& copy : copies)
+	{
+		copy.bufferOffset += staging.offset;
+	}
+	vkCmdCopyBufferToImage(batch.cmd, staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		static_cast<uint32_t>(copies.size()), copies.data());
+
+	// the layout change happens in the release and is repeated, identically, in the acquire
+	VkImageMemoryBarrier release = toTransfer;
+	release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	release.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	release.newLayout = finalLayout;
+
+	if (!transfers_ownership())
+	{
+		release.dstAccessMask = dstAccess;
+		_releases.add(release, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+		_openAcquires.stages |= dstStage;
+		return;
+	}
+
+	release.dstAccessMask = 0;
+	release.srcQueueFamilyIndex = _transferFamily;
+	release.dstQueueFamilyIndex = _graphicsFamily;
+	_releases.add(release, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
+	VkImageMemoryBarrier acquire = release;
+	acquire.srcAccessMask = 0;
+	acquire.dstAccessMask = dstAccess;
+	_openAcquires.images.push_back(acquire);
+	_openAcquires.stages |= dstStage;
+}
+
+uint64_t UploadManager::flush()
+{
+	if (!_batchOpen)
+	{
+		return 0;
+	}
+
+	// after the last copy, so one barrier releases (or, within the family, transitions) everything
+	_releases.record(_openBatch.cmd);
+	Batch batch = _openBatch;
+	_batchOpen = false;
+	batch.value = _nextValue++;
+	VK_CHECK(vkEndCommandBuffer(batch.cmd));
+
+	VkSubmitInfo submit = vkinit::submit_info(&batch.cmd);
+
+	VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+	if (_timelineSemaphores)
+	{
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+		timelineInfo.signalSemaphoreValueCount = 1;
+		timelineInfo.pSignalSemaphoreValues = &batch.value;
+
+		submit.pNext = &timelineInfo;
+		submit.signalSemaphoreCount = 1;
+		submit.pSignalSemaphores = &_timeline;
+		std::lock_guard<std::mutex> lock(*_queueMutex);
+		VK_CHECK(vkQueueSubmit(_transferQueue, 1, &submit, VK_NULL_HANDLE));
+	}
+	else
+	{
+		// nothing for the graphics queue to wait on, so the copies have to be finished before it runs
+		{
+			std::lock_guard<std::mutex> lock(*_queueMutex);
+			VK_CHECK(vkQueueSubmit(_transferQueue, 1, &submit, _fence));
+		}
+		vkWaitForFences(_device, 1, &_fence, true, UINT64_MAX);
+		vkResetFences(_device, 1, &_fence);
+		_completedValue = batch.value;
+	}
+
+	// hand the batch's ranges to the graphics side
+	_openAcquires.value = batch.value;
+	_flushedAcquires.push_back(std::move(_openAcquires));
+	_openAcquires = PendingAcquires{};
+
+	_inFlight.push_back(std::move(batch));
+	return _inFlight.back().value;
+}
+
+void UploadManager::record_acquires(VkCommandBuffer cmd, bool waitForAll)
+{
+	_graphicsWaitValue = 0;
+	_graphicsWaitStages = 0;
+
+	// batches finish in order, so the ready ones are a prefix
+	PendingAcquires ready;
+	while (!_flushedAcquires.empty() && (waitForAll || is_complete(_flushedAcquires.front().value)))
+	{
+		PendingAcquires& batch = _flushedAcquires.front();
+		ready.value = batch.value;
+		ready.buffers.insert(ready.buffers.end(), batch.buffers.begin(), batch.buffers.end());
+		ready.images.insert(ready.images.end(), batch.images.begin(), batch.images.end());
+		ready.stages |= batch.stages;
+		_flushedAcquires.pop_front();
+	}
+
+	if (ready.value == 0)
+	{
+		return;
+	}
+
+	if (!ready.buffers.empty() || !ready.images.empty())
+	{
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, ready.stages, 0, 0, nullptr,
+			static_cast<uint32_t>(ready.buffers.size()), ready.buffers.data(),
+			static_cast<uint32_t>(ready.images.size()), ready.images.data());
+	}
+
+	// the host has seen the value signal, but only a semaphore wait orders the copies before this queue's reads
+	if (_timelineSemaphores)
+	{
+		_graphicsWaitValue = ready.value;
+		_graphicsWaitStages = ready.stages;
+	}
+	_acquiredValue = ready.value;
+}
+
+bool UploadManager::graphics_wait(VkSemaphore& semaphore, uint64_t& value, VkPipelineStageFlags& stages)
+{
+	if (_graphicsWaitValue == 0)
+	{
+		return false;
+	}
+
+	semaphore = _timeline;
+	value = _graphicsWaitValue;
+	stages = _graphicsWaitStages ? _graphicsWaitStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	return true;
+}
+
+bool UploadManager::is_complete(uint64_t value)
+{
+	if (value <= _completedValue)
+	{
+		return true;
+	}
+	if (_timelineSemaphores)
+	{
+		VK_CHECK(_vkGetSemaphoreCounterValue(_device, _timeline, &_completedValue));
+	}
+	return value <= _completedValue;
+}
+
+void UploadManager::wait(uint64_t value)
+{
+	if (value == 0 || is_complete(value))
+	{
+		return;
+	}
+
+	VkSemaphoreWaitInfoKHR waitInfo = {};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &_timeline;
+	waitInfo.pValues = &value;
+	VK_CHECK(_vkWaitSemaphores(_device, &waitInfo, UINT64_MAX));
+	_completedValue = std::max(_completedValue, value);
+}
+
+void UploadManager::collect()
+{
+	// batches complete in submission order
+	size_t retired = 0;
+	while (retired < _inFlight.size() && is_complete(_inFlight[retired].value))
+	{
+		Batch& batch = _inFlight[retired];
+		for (AllocatedBuffer& staging : batch.stagingBuffers)
+		{
+			vmaDestroyBuffer(_allocator, staging._buffer, staging._allocation);
+		}
+		// everything the batch staged in the ring was before its end, and everything before that belongs to
+		// batches that retired first
+		_ringTail = std::max<uint64_t>(_ringTail, batch.ringEnd);
+		vkResetCommandBuffer(batch.cmd, 0);
+		_freeCommandBuffers.push_back(batch.cmd);
+		retired++;
+	}
+	_inFlight.erase(_inFlight.begin(), _inFlight.begin() + retired);
+}
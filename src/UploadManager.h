@@ -0,0 +1,160 @@
+#pragma once
+
+#include <vk_types.h>
+#include <BarrierBatch.h>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// which uploads give way first when a frame's upload budget or the staging ring runs short
+enum class UploadPriority : uint32_t {
+	Visible, // something on screen is waiting for it: a streamed mesh or texture
+	Prefetch, // nothing looks worse without it yet: finer mips, pages ahead of need
+};
+
+// Batches staging copies onto the transfer queue.
+// Staging memory comes from one persistently mapped ring that batches release in order as they retire; an
+// upload the ring has no room for gets a staging buffer of its own, so nothing ever waits on the ring.
+// Streaming callers pace themselves with admit(), which keeps each frame's bytes within a budget.
+// Each flushed batch signals a timeline semaphore value; the graphics queue waits on it and takes
+// ownership of the written ranges with acquire barriers recorded by record_acquires().
+// Without VK_KHR_timeline_semaphore, flush() blocks until the copies are done instead.
+class UploadManager
+{
+public:
+	// transferFamily may equal graphicsFamily (no dedicated transfer queue), which skips the ownership transfers
+	// staging buffers come from stagingPool when one is given; queueMutex is held around every submit, for
+	// a queue other sessions on the device submit to as well; ringSize 0 gives every upload its own buffer
+	void init(VkDevice device, VmaAllocator allocator, VkQueue transferQueue, uint32_t transferFamily,
+		uint32_t graphicsFamily, bool timelineSemaphores, std::mutex& queueMutex, VmaPool stagingPool = VK_NULL_HANDLE,
+		VkDeviceSize ringSize = 0);
+	void cleanup();
+
+	// the ranges of one batch mustn't overlap: every copy of a batch is recorded before all of its releases,
+	// which go out as one barrier at flush()
+
+	// write fills size bytes of staging memory; the copy lands in dst at dstOffset
+	// dstStage/dstAccess describe the graphics queue's first use of the range
+	void upload_buffer(VkBuffer dst, VkDeviceSize dstOffset, VkDeviceSize size, const std::function<void(void*)>& write,
+		VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+
+	// copies regions (bufferOffset relative to the start of the upload) into mip levels [0, mipLevels) of a
+	// single-layer color image, which ends up in finalLayout
+	void upload_image(VkImage image, uint32_t mipLevels, const std::vector<VkBufferImageCopy>& regions,
+		VkDeviceSize size, const std::function<void(void*)>& write, VkImageLayout finalLayout,
+		VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+
+	// submits everything recorded since the last flush and returns the value that signals its completion
+	// (0 when nothing was pending)
+	uint64_t flush();
+
+	// graphics side, outside a render pass: acquires the ranges of every flushed batch the GPU has already
+	// finished, so a frame never stalls on a copy still in flight (or of every flushed batch with waitForAll)
+	// the submit containing cmd must then wait on the values returned by graphics_wait()
+	void record_acquires(VkCommandBuffer cmd, bool waitForAll = false);
+
+	// highest batch value whose ranges have been acquired; anything uploaded up to it is usable by
+	// commands recorded after record_acquires()
+	uint64_t acquired_value() const { return _acquiredValue; }
+
+	// semaphore and value the next graphics submit has to wait on, and at which stages
+	// returns false when the recorded acquires need no wait
+	bool graphics_wait(VkSemaphore& semaphore, uint64_t& value, VkPipelineStageFlags& stages);
+
+	bool is_complete(uint64_t value);
+	// blocks until value has signaled
+	void wait(uint64_t value);
+
+	// recycles command buffers and frees staging memory of finished batches
+	void collect();
+
+	bool uses_timeline() const { return _timelineSemaphores; }
+
+	// starts a frame's budget; 0 bytes for no limit
+	void begin_frame() { _frameBytes = 0; _refused = false; }
+	void set_frame_budget(VkDeviceSize bytes) { _frameBudget = bytes; }
+	// whether an upload of size bytes may go out this frame, counting it against the budget if so. The first
+	// visible upload of a frame always may, however big, so nothing starves behind one; prefetches also leave
+	// a quarter of the ring to what's visible. A refusal is meant to be asked again next frame
+	bool admit(VkDeviceSize size, UploadPriority priority);
+	// the ring is filling up faster than batches retire, or a visible upload was refused this frame: the
+	// time to stop loading more
+	bool backlogged() const;
+
+	VkDeviceSize frame_bytes() const { return _frameBytes; }
+	VkDeviceSize ring_used() const { return _ringHead - _ringTail; }
+	VkDeviceSize ring_size() const { return _ringSize; }
+
+private:
+	struct Batch {
+		VkCommandBuffer cmd{ VK_NULL_HANDLE };
+		uint64_t value{ 0 };
+		std::vector<AllocatedBuffer> stagingBuffers; // the uploads the ring had no room for
+		uint64_t ringEnd{ 0 }; // _ringHead after the batch's last ring allocation, 0 for none
+	};
+
+	// where an upload's bytes went
+	struct Staging {
+		VkBuffer buffer{ VK_NULL_HANDLE };
+		VkDeviceSize offset{ 0 };
+	};
+
+	// ranges waiting for the graphics queue to take ownership
+	struct PendingAcquires {
+		uint64_t value{ 0 };
+		std::vector<VkBufferMemoryBarrier> buffers;
+		std::vector<VkImageMemoryBarrier> images;
+		VkPipelineStageFlags stages{ 0 };
+	};
+
+	Batch& open_batch();
+	Staging stage(Batch& batch, VkDeviceSize size, const std::function<void(void*)>& write);
+	bool ring_allocate(VkDeviceSize size, VkDeviceSize& offset);
+	bool transfers_ownership() const { return _transferFamily != _graphicsFamily; }
+
+	VkDevice _device{ VK_NULL_HANDLE };
+	VmaAllocator _allocator{ nullptr };
+	VmaPool _stagingPool{ VK_NULL_HANDLE };
+	VkQueue _transferQueue{ VK_NULL_HANDLE };
+	std::mutex* _queueMutex{ nullptr };
+	uint32_t _transferFamily{ 0 };
+	uint32_t _graphicsFamily{ 0 };
+
+	// the ring's positions only grow; an offset into it is a position modulo _ringSize
+	AllocatedBuffer _ring;
+	VkDeviceSize _ringSize{ 0 };
+	uint64_t _ringHead{ 0 };
+	uint64_t _ringTail{ 0 };
+
+	VkDeviceSize _frameBudget{ 0 };
+	VkDeviceSize _frameBytes{ 0 };
+	bool _refused{ false };
+
+	VkCommandPool _commandPool{ VK_NULL_HANDLE };
+	std::vector<VkCommandBuffer> _freeCommandBuffers;
+
+	bool _timelineSemaphores{ false };
+	VkSemaphore _timeline{ VK_NULL_HANDLE };
+	PFN_vkGetSemaphoreCounterValueKHR _vkGetSemaphoreCounterValue{ nullptr };
+	PFN_vkWaitSemaphoresKHR _vkWaitSemaphores{ nullptr };
+	// fallback sync for drivers without timeline semaphores
+	VkFence _fence{ VK_NULL_HANDLE };
+
+	uint64_t _nextValue{ 1 };
+	uint64_t _completedValue{ 0 };
+
+	bool _batchOpen{ false };
+	Batch _openBatch;
+	std::vector<Batch> _inFlight;
+
+	// the open batch's releases, recorded at the end of it
+	BarrierBatch _releases;
+	// acquires for the open batch, and per flushed batch the graphics queue hasn't picked up yet
+	PendingAcquires _openAcquires;
+	std::deque<PendingAcquires> _flushedAcquires;
+	uint64_t _acquiredValue{ 0 };
+	// what the last record_acquires() call requires of the next graphics submit
+	uint64_t _graphicsWaitValue{ 0 };
+	VkPipelineStageFlags _graphicsWaitStages{ 0 };
+};
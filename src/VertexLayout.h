@@ -0,0 +1,120 @@
+#pragma once
+
+#include <vk_types.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+// Vertex input state worked out at compile time from the vertex structs themselves: each format declares its
+// bindings and attributes once as a constexpr VertexLayout, the attribute formats deduced from the member
+// types, and pipelines point their vertex input straight at the layout's arrays. Instanced variants are two
+// layouts concatenated, also at compile time, so a new vertex format costs one declaration and building its
+// pipelines allocates nothing.
+
+// runtime form of a layout, for code that edits the lists (ShaderReflection::consumed_inputs)
+struct VertexInputDescription {
+	std::vector<VkVertexInputBindingDescription> bindings;
+	std::vector<VkVertexInputAttributeDescription> attributes;
+
+	VkPipelineVertexInputStateCreateFlags flags = 0;
+};
+
+// the format a member of type T is fetched as. Floats are read as they are; integer arrays are the
+// quantized attributes of the compact layouts, so unsigned ones read as unorm and signed ones as snorm.
+// Anything else (a packed uint32_t color, say) names its format explicitly
+template<typename T>
+struct VertexAttributeFormat;
+template<> struct VertexAttributeFormat<float> { static constexpr VkFormat value = VK_FORMAT_R32_SFLOAT; };
+template<> struct VertexAttributeFormat<glm::vec2> { static constexpr VkFormat value = VK_FORMAT_R32G32_SFLOAT; };
+template<> struct VertexAttributeFormat<glm::vec3> { static constexpr VkFormat value = VK_FORMAT_R32G32B32_SFLOAT; };
+template<> struct VertexAttributeFormat<glm::vec4> { static constexpr VkFormat value = VK_FORMAT_R32G32B32A32_SFLOAT; };
+template<> struct VertexAttributeFormat<uint16_t[2]> { static constexpr VkFormat value = VK_FORMAT_R16G16_UNORM; };
+template<> struct VertexAttributeFormat<uint16_t[4]> { static constexpr VkFormat value = VK_FORMAT_R16G16B16A16_UNORM; };
+template<> struct VertexAttributeFormat<int16_t[2]> { static constexpr VkFormat value = VK_FORMAT_R16G16_SNORM; };
+template<> struct VertexAttributeFormat<int16_t[4]> { static constexpr VkFormat value = VK_FORMAT_R16G16B16A16_SNORM; };
+template<> struct VertexAttributeFormat<uint8_t[4]> { static constexpr VkFormat value = VK_FORMAT_R8G8B8A8_UNORM; };
+template<> struct VertexAttributeFormat<int8_t[4]> { static constexpr VkFormat value = VK_FORMAT_R8G8B8A8_SNORM; };
+
+constexpr VkVertexInputBindingDescription vertex_binding(uint32_t binding, uint32_t stride,
+	VkVertexInputRate inputRate = VK_VERTEX_INPUT_RATE_VERTEX)
+{
+	return { binding, stride, inputRate };
+}
+
+constexpr VkVertexInputAttributeDescription vertex_attribute(uint32_t location, uint32_t binding, VkFormat format, uint32_t offset)
+{
+	return { location, binding, format, offset };
+}
+
+// member of Struct at location, fetched from binding in the format its type deduces to
+#define VERTEX_ATTRIBUTE(Struct, member, location, binding) \
+	vertex_attribute(location, binding, VertexAttributeFormat<decltype(Struct::member)>::value, static_cast<uint32_t>(offsetof(Struct, member)))
+
+template<size_t BindingCount, size_t AttributeCount>
+struct VertexLayout {
+	std::array<VkVertexInputBindingDescription, BindingCount> bindings;
+	std::array<VkVertexInputAttributeDescription, AttributeCount> attributes;
+
+	// points info at the layout's arrays, which must outlive it; constexpr layouts always do
+	void apply(VkPipelineVertexInputStateCreateInfo& info) const
+	{
+		info.pVertexBindingDescriptions = bindings.data();
+		info.vertexBindingDescriptionCount = static_cast<uint32_t>(BindingCount);
+		info.pVertexAttributeDescriptions = attributes.data();
+		info.vertexAttributeDescriptionCount = static_cast<uint32_t>(AttributeCount);
+	}
+
+	VertexInputDescription description() const
+	{
+		VertexInputDescription description;
+		description.bindings.assign(bindings.begin(), bindings.end());
+		description.attributes.assign(attributes.begin(), attributes.end());
+		return description;
+	}
+};
+
+template<size_t BindingCount, size_t AttributeCount>
+constexpr VertexLayout<BindingCount, AttributeCount> vertex_layout(const VkVertexInputBindingDescription (&bindings)[BindingCount],
+	const VkVertexInputAttributeDescription (&attributes)[AttributeCount])
+{
+	VertexLayout<BindingCount, AttributeCount> layout{};
+	for (size_t i = 0; i < BindingCount; i++)
+	{
+		layout.bindings[i] = bindings[i];
+	}
+	for (size_t i = 0; i < AttributeCount; i++)
+	{
+		layout.attributes[i] = attributes[i];
+	}
+	return layout;
+}
+
+// a's bindings and attributes followed by b's; the caller keeps bindings and locations apart
+template<size_t BindingsA, size_t AttributesA, size_t BindingsB, size_t AttributesB>
+constexpr VertexLayout<BindingsA + BindingsB, AttributesA + AttributesB> concat_vertex_layouts(const VertexLayout<BindingsA, AttributesA>& a,
+	const VertexLayout<BindingsB, AttributesB>& b)
+{
+	VertexLayout<BindingsA + BindingsB, AttributesA + AttributesB> layout{};
+	for (size_t i = 0; i < BindingsA; i++)
+	{
+		layout.bindings[i] = a.bindings[i];
+	}
+	for (size_t i = 0; i < BindingsB; i++)
+	{
+		layout.bindings[BindingsA + i] = b.bindings[i];
+	}
+	for (size_t i = 0; i < AttributesA; i++)
+	{
+		layout.attributes[i] = a.attributes[i];
+	}
+	for (size_t i = 0; i < AttributesB; i++)
+	{
+		layout.attributes[AttributesA + i] = b.attributes[i];
+	}
+	return layout;
+}
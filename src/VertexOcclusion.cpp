@@ -0,0 +1,97 @@
+#include "VertexOcclusion.h"
+
+#include "Bvh.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+void bake_vertex_occlusion(std::vector<Mesh>& meshes, const VertexOcclusionSettings& settings)
+{
+	std::vector<glm::vec3> corners;
+	Aabb bounds = { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+	for (const Mesh& mesh : meshes)
+	{
+		const MeshLod lod = mesh.get_lod(0);
+		if (mesh._indices.size() < size_t(lod.firstIndex) + lod.indexCount)
+		{
+			return;
+		}
+		for (uint32_t i = lod.firstIndex; i + 2 < lod.firstIndex + lod.indexCount; i += 3)
+		{
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				const glm::vec3& position = mesh._vertices[mesh._indices[i + corner]].position;
+				corners.push_back(position);
+				bounds.min = glm::min(bounds.min, position);
+				bounds.max = glm::max(bounds.max, position);
+			}
+		}
+	}
+	if (corners.empty())
+	{
+		return;
+	}
+
+	Bvh triangles;
+	for (uint32_t triangle = 0; triangle < corners.size() / 3; triangle++)
+	{
+		const glm::vec3* t = &corners[size_t(triangle) * 3];
+		triangles.insert({ glm::min(t[0], glm::min(t[1], t[2])), glm::max(t[0], glm::max(t[1], t[2])) }, triangle);
+	}
+
+	const float diagonal = std::max(glm::length(bounds.max - bounds.min), 1e-3f);
+	const float maxDistance = settings.distance > 0.0f ? settings.distance : diagonal * settings.distanceFraction;
+	// off the surface, so the rays don't hit the triangles they start on
+	const float bias = diagonal * 1e-4f;
+	const uint32_t rayCount = std::max(settings.rays, 1u);
+	const float golden = 3.14159265f * (3.0f - std::sqrt(5.0f));
+
+	constexpr size_t VERTICES_PER_JOB = 1024;
+	for (Mesh& mesh : meshes)
+	{
+		parallel_for((mesh._vertices.size() + VERTICES_PER_JOB - 1) / VERTICES_PER_JOB, [&](size_t chunk) {
+			const size_t end = std::min(mesh._vertices.size(), (chunk + 1) * VERTICES_PER_JOB);
+			for (size_t v = chunk * VERTICES_PER_JOB; v < end; v++)
+			{
+				Vertex& vertex = mesh._vertices[v];
+				const float normalLength = glm::length(vertex.normal);
+				if (normalLength <= 0.0f)
+				{
+					continue;
+				}
+				const glm::vec3 normal = vertex.normal / normalLength;
+				const glm::vec3 tangent = glm::normalize(glm::cross(normal, std::fabs(normal.x) < 0.9f ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 1.f, 0.f)));
+				const glm::vec3 bitangent = glm::cross(normal, tangent);
+				const glm::vec3 origin = vertex.position + normal * bias;
+				// neighbouring vertices turn their spirals apart, so the banding of a few rays doesn't line up
+				const float turn = std::fmod(v * 0.61803399f, 1.0f) * 6.2831853f;
+
+				// a Fibonacci spiral over the disk projected up onto the hemisphere: cosine weighted
+				float occlusion = 0.0f;
+				for (uint32_t ray = 0; ray < rayCount; ray++)
+				{
+					const float radius = std::sqrt((ray + 0.5f) / rayCount);
+					const float angle = golden * ray + turn;
+					const glm::vec3 direction = tangent * (std::cos(angle) * radius) + bitangent * (std::sin(angle) * radius)
+						+ normal * std::sqrt(std::max(1.0f - radius * radius, 0.0f));
+
+					auto hit = [&](uint32_t triangle, float) {
+						const float distance = ray_triangle(origin, direction, &corners[size_t(triangle) * 3]);
+						return distance > bias ? distance : -1.0f;
+					};
+					uint32_t triangle;
+					float distance;
+					if (triangles.raycast(origin, direction, maxDistance, hit, triangle, distance))
+					{
+						occlusion += 1.0f - distance / maxDistance;
+					}
+				}
+				vertex.color *= glm::clamp(1.0f - settings.strength * occlusion / rayCount, 0.0f, 1.0f);
+			}
+		});
+	}
+}
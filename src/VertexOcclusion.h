@@ -0,0 +1,22 @@
+#pragma once
+
+#include <Mesh.h>
+
+#include <cstdint>
+#include <vector>
+
+struct VertexOcclusionSettings {
+	uint32_t rays{ 64 }; // per vertex, over the hemisphere around its normal
+	// how far an occluder still darkens, in mesh units; 0 takes distanceFraction of the meshes' diagonal
+	float distance{ 0.0f };
+	float distanceFraction{ 0.05f };
+	float strength{ 1.0f }; // 1 leaves a vertex whose every ray hits right away black
+};
+
+// Ambient occlusion baked into the vertex colors at import, so the lit shaders, which multiply their light by
+// the color, get contact darkening without an occlusion pass at runtime. Every vertex casts cosine weighted
+// rays around its normal against the full detail triangles of all the meshes, through a Bvh like
+// PotentiallyVisibleSet's, and each hit darkens by how close it is; the color is scaled by what's left.
+// Vertices go to the workers in chunks. The meshes must share a space, like the parts of one OBJ, and their
+// CPU indices must be decoded; nothing is done when they have no triangles.
+void bake_vertex_occlusion(std::vector<Mesh>& meshes, const VertexOcclusionSettings& settings = {});
@@ -0,0 +1,793 @@
+#include "VideoEncoder.h"
+
+#include "Log.h"
+#include "vk_initializers.h"
+
+#include <algorithm>
+#include <cstring>
+
+VkImageUsageFlags VideoEncoder::image_usage()
+{
+	// sampled by the NV12 conversion, which starts from the transfer layout the readback also takes it in
+	return VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+}
+
+#ifdef VK_KHR_video_encode_h264
+
+namespace {
+	// two DPB slots: the last frame, which the next one is predicted from, and the one being encoded
+	constexpr uint32_t DPB_SLOTS = 2;
+
+	uint32_t align_up(uint32_t value, uint32_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+bool VideoEncoder::init(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device, VmaAllocator allocator, DescriptorAllocator& descriptors,
+	VkShaderModule nv12Shader, VkPipelineCache cache, uint32_t graphicsQueueFamily, VkSemaphore graphicsTimeline, std::mutex& queueMutex,
+	uint32_t frameOverlap, const Settings& settings)
+{
+	_physicalDevice = physicalDevice;
+	_device = device;
+	_allocator = allocator;
+	_graphicsQueueFamily = graphicsQueueFamily;
+	_graphicsTimeline = graphicsTimeline;
+	_queueMutex = &queueMutex;
+	_settings = settings;
+	_settings.gopLength = std::min(std::max(_settings.gopLength, 1u), 256u);
+
+	_vkGetPhysicalDeviceVideoCapabilities = (PFN_vkGetPhysicalDeviceVideoCapabilitiesKHR)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceVideoCapabilitiesKHR");
+	_vkGetPhysicalDeviceVideoFormatProperties = (PFN_vkGetPhysicalDeviceVideoFormatPropertiesKHR)vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceVideoFormatPropertiesKHR");
+	_vkCreateVideoSession = (PFN_vkCreateVideoSessionKHR)vkGetDeviceProcAddr(_device, "vkCreateVideoSessionKHR");
+	_vkDestroyVideoSession = (PFN_vkDestroyVideoSessionKHR)vkGetDeviceProcAddr(_device, "vkDestroyVideoSessionKHR");
+	_vkGetVideoSessionMemoryRequirements = (PFN_vkGetVideoSessionMemoryRequirementsKHR)vkGetDeviceProcAddr(_device, "vkGetVideoSessionMemoryRequirementsKHR");
+	_vkBindVideoSessionMemory = (PFN_vkBindVideoSessionMemoryKHR)vkGetDeviceProcAddr(_device, "vkBindVideoSessionMemoryKHR");
+	_vkCreateVideoSessionParameters = (PFN_vkCreateVideoSessionParametersKHR)vkGetDeviceProcAddr(_device, "vkCreateVideoSessionParametersKHR");
+	_vkDestroyVideoSessionParameters = (PFN_vkDestroyVideoSessionParametersKHR)vkGetDeviceProcAddr(_device, "vkDestroyVideoSessionParametersKHR");
+	_vkGetEncodedVideoSessionParameters = (PFN_vkGetEncodedVideoSessionParametersKHR)vkGetDeviceProcAddr(_device, "vkGetEncodedVideoSessionParametersKHR");
+	_vkCmdBeginVideoCoding = (PFN_vkCmdBeginVideoCodingKHR)vkGetDeviceProcAddr(_device, "vkCmdBeginVideoCodingKHR");
+	_vkCmdControlVideoCoding = (PFN_vkCmdControlVideoCodingKHR)vkGetDeviceProcAddr(_device, "vkCmdControlVideoCodingKHR");
+	_vkCmdEncodeVideo = (PFN_vkCmdEncodeVideoKHR)vkGetDeviceProcAddr(_device, "vkCmdEncodeVideoKHR");
+	_vkCmdEndVideoCoding = (PFN_vkCmdEndVideoCodingKHR)vkGetDeviceProcAddr(_device, "vkCmdEndVideoCodingKHR");
+	_vkCmdPipelineBarrier2 = (PFN_vkCmdPipelineBarrier2KHR)vkGetDeviceProcAddr(_device, "vkCmdPipelineBarrier2KHR");
+	if (_vkGetPhysicalDeviceVideoCapabilities == nullptr || _vkGetPhysicalDeviceVideoFormatProperties == nullptr || _vkCreateVideoSession == nullptr
+		|| _vkDestroyVideoSession == nullptr || _vkGetVideoSessionMemoryRequirements == nullptr || _vkBindVideoSessionMemory == nullptr
+		|| _vkCreateVideoSessionParameters == nullptr || _vkDestroyVideoSessionParameters == nullptr || _vkGetEncodedVideoSessionParameters == nullptr
+		|| _vkCmdBeginVideoCoding == nullptr || _vkCmdControlVideoCoding == nullptr || _vkCmdEncodeVideo == nullptr || _vkCmdEndVideoCoding == nullptr
+		|| _vkCmdPipelineBarrier2 == nullptr)
+	{
+		return false;
+	}
+
+	// the first family whose encode engine does H.264; the graphics family itself on the rare GPU where it does
+	uint32_t familyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties2(_physicalDevice, &familyCount, nullptr);
+	std::vector<VkQueueFamilyProperties2> families(familyCount);
+	std::vector<VkQueueFamilyVideoPropertiesKHR> videoProperties(familyCount);
+	for (uint32_t i = 0; i < familyCount; i++)
+	{
+		videoProperties[i] = {};
+		videoProperties[i].sType = VK_STRUCTURE_TYPE_QUEUE_FAMILY_VIDEO_PROPERTIES_KHR;
+		families[i] = {};
+		families[i].sType = VK_STRUCTURE_TYPE_QUEUE_FAMILY_PROPERTIES_2;
+		families[i].pNext = &videoProperties[i];
+	}
+	vkGetPhysicalDeviceQueueFamilyProperties2(_physicalDevice, &familyCount, families.data());
+	_encodeQueueFamily = VK_QUEUE_FAMILY_IGNORED;
+	for (uint32_t i = 0; i < familyCount; i++)
+	{
+		if ((families[i].queueFamilyProperties.queueFlags & VK_QUEUE_VIDEO_ENCODE_BIT_KHR) != 0
+			&& (videoProperties[i].videoCodecOperations & VK_VIDEO_CODEC_OPERATION_ENCODE_H264_BIT_KHR) != 0)
+		{
+			_encodeQueueFamily = i;
+			break;
+		}
+	}
+	if (_encodeQueueFamily == VK_QUEUE_FAMILY_IGNORED)
+	{
+		return false;
+	}
+
+	// 8-bit 4:2:0 main profile, which every H.264 encoder takes and every decoder plays
+	_h264Profile = {};
+	_h264Profile.sType = VK_STRUCTURE_TYPE_VIDEO_ENCODE_H264_PROFILE_INFO_KHR;
+	_h264Profile.stdProfileIdc = STD_VIDEO_H264_PROFILE_IDC_MAIN;
+	_profile = {};
+	_profile.sType = VK_STRUCTURE_TYPE_VIDEO_PROFILE_INFO_KHR;
+	_profile.pNext = &_h264Profile;
+	_profile.videoCodecOperation = VK_VIDEO_CODEC_OPERATION_ENCODE_H264_BIT_KHR;
+	_profile.chromaSubsampling = VK_VIDEO_CHROMA_SUBSAMPLING_420_BIT_KHR;
+	_profile.lumaBitDepth = VK_VIDEO_COMPONENT_BIT_DEPTH_8_BIT_KHR;
+	_profile.chromaBitDepth = VK_VIDEO_COMPONENT_BIT_DEPTH_8_BIT_KHR;
+	_profileList = {};
+	_profileList.sType = VK_STRUCTURE_TYPE_VIDEO_PROFILE_LIST_INFO_KHR;
+	_profileList.profileCount = 1;
+	_profileList.pProfiles = &_profile;
+
+	_h264Capabilities = {};
+	_h264Capabilities.sType = VK_STRUCTURE_TYPE_VIDEO_ENCODE_H264_CAPABILITIES_KHR;
+	_encodeCapabilities = {};
+	_encodeCapabilities.sType = VK_STRUCTURE_TYPE_VIDEO_ENCODE_CAPABILITIES_KHR;
+	_encodeCapabilities.pNext = &_h264Capabilities;
+	_capabilities = {};
+	_capabilities.sType = VK_STRUCTURE_TYPE_VIDEO_CAPABILITIES_KHR;
+	_capabilities.pNext = &_encodeCapabilities;
+	if (_vkGetPhysicalDeviceVideoCapabilities(_physicalDevice, &_profile, &_capabilities) != VK_SUCCESS)
+	{
+		return false;
+	}
+	_encodeCapabilities.pNext = nullptr;
+	_capabilities.pNext = nullptr;
+
+	// packets are cut out of the bitstream buffer by the feedback query, and P frames need a reference
+	const VkVideoEncodeFeedbackFlagsKHR feedback = VK_VIDEO_ENCODE_FEEDBACK_BITSTREAM_BUFFER_OFFSET_BIT_KHR | VK_VIDEO_ENCODE_FEEDBACK_BITSTREAM_BYTES_WRITTEN_BIT_KHR;
+	if ((_encodeCapabilities.supportedEncodeFeedbackFlags & feedback) != feedback || _capabilities.maxDpbSlots < DPB_SLOTS
+		|| _capabilities.maxActiveReferencePictures < 1 || _h264Capabilities.maxPPictureL0ReferenceCount < 1)
+	{
+		return false;
+	}
+	_constantQp = (_encodeCapabilities.rateControlModes & VK_VIDEO_ENCODE_RATE_CONTROL_MODE_DISABLED_BIT_KHR) != 0;
+	_settings.qp = std::min(std::max(_settings.qp, _h264Capabilities.minQp), _h264Capabilities.maxQp);
+	_cabac = (_h264Capabilities.stdSyntaxFlags & VK_VIDEO_ENCODE_H264_STD_ENTROPY_CODING_MODE_FLAG_SET_BIT_KHR) != 0;
+
+	// the source picture is written by copies; NV12 is what the conversion produces
+	auto find_format = [&](VkImageUsageFlags usage, VkImageUsageFlags extraUsage, VkFormat wanted) {
+		VkPhysicalDeviceVideoFormatInfoKHR formatInfo = {};
+		formatInfo.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VIDEO_FORMAT_INFO_KHR;
+		formatInfo.pNext = &_profileList;
+		formatInfo.imageUsage = usage;
+		uint32_t formatCount = 0;
+		_vkGetPhysicalDeviceVideoFormatProperties(_physicalDevice, &formatInfo, &formatCount, nullptr);
+		std::vector<VkVideoFormatPropertiesKHR> formats(formatCount);
+		for (VkVideoFormatPropertiesKHR& format : formats)
+		{
+			format = {};
+			format.sType = VK_STRUCTURE_TYPE_VIDEO_FORMAT_PROPERTIES_KHR;
+		}
+		_vkGetPhysicalDeviceVideoFormatProperties(_physicalDevice, &formatInfo, &formatCount, formats.data());
+		for (const VkVideoFormatPropertiesKHR& format : formats)
+		{
+			if ((wanted == VK_FORMAT_UNDEFINED || format.format == wanted) && format.imageTiling == VK_IMAGE_TILING_OPTIMAL
+				&& (format.imageUsageFlags & extraUsage) == extraUsage)
+			{
+				return format.format;
+			}
+		}
+		return VK_FORMAT_UNDEFINED;
+	};
+	_pictureFormat = find_format(VK_IMAGE_USAGE_VIDEO_ENCODE_SRC_BIT_KHR, VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_FORMAT_G8_B8R8_2PLANE_420_UNORM);
+	_dpbFormat = find_format(VK_IMAGE_USAGE_VIDEO_ENCODE_DPB_BIT_KHR, 0, VK_FORMAT_UNDEFINED);
+	if (_pictureFormat == VK_FORMAT_UNDEFINED || _dpbFormat == VK_FORMAT_UNDEFINED)
+	{
+		return false;
+	}
+
+	vkGetDeviceQueue(_device, _encodeQueueFamily, 0, &_encodeQueue);
+
+	VkCommandPoolCreateInfo poolInfo = vkinit::command_pool_create_info(_encodeQueueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+	VK_CHECK(vkCreateCommandPool(_device, &poolInfo, nullptr, &_commandPool));
+
+	VkQueryPoolVideoEncodeFeedbackCreateInfoKHR feedbackInfo = {};
+	feedbackInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_VIDEO_ENCODE_FEEDBACK_CREATE_INFO_KHR;
+	feedbackInfo.pNext = &_profile;
+	feedbackInfo.encodeFeedbackFlags = feedback;
+	VkQueryPoolCreateInfo queryInfo = {};
+	queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryInfo.pNext = &feedbackInfo;
+	queryInfo.queryType = VK_QUERY_TYPE_VIDEO_ENCODE_FEEDBACK_KHR;
+	queryInfo.queryCount = frameOverlap;
+	VK_CHECK(vkCreateQueryPool(_device, &queryInfo, nullptr, &_feedbackPool));
+
+	_slots.assign(frameOverlap, Slot{});
+	for (Slot& slot : _slots)
+	{
+		VkCommandBufferAllocateInfo cmdInfo = vkinit::command_buffer_allocate_info(_commandPool, 1);
+		VK_CHECK(vkAllocateCommandBuffers(_device, &cmdInfo, &slot.cmd));
+		VkFenceCreateInfo fenceInfo = vkinit::fence_create_info(0);
+		VK_CHECK(vkCreateFence(_device, &fenceInfo, nullptr, &slot.fence));
+	}
+
+	_nv12.init(_device, descriptors, nv12Shader, cache, frameOverlap);
+	return true;
+}
+
+void VideoEncoder::cleanup()
+{
+	if (_commandPool == VK_NULL_HANDLE)
+	{
+		return;
+	}
+	destroy_session();
+	for (Slot& slot : _slots)
+	{
+		vkDestroyFence(_device, slot.fence, nullptr);
+	}
+	_slots.clear();
+	_nv12.cleanup();
+	vkDestroyQueryPool(_device, _feedbackPool, nullptr);
+	// frees the slots' command buffers with it
+	vkDestroyCommandPool(_device, _commandPool, nullptr);
+	_commandPool = VK_NULL_HANDLE;
+}
+
+bool VideoEncoder::resize(VkExtent2D extent, VkFormat imageFormat)
+{
+	destroy_session();
+	_extent = extent;
+	_imageFormat = imageFormat;
+
+	// whole macroblocks, and whatever granularity the encoder reads its pictures in
+	const uint32_t alignWidth = std::max(16u, _encodeCapabilities.encodeInputPictureGranularity.width);
+	const uint32_t alignHeight = std::max(16u, _encodeCapabilities.encodeInputPictureGranularity.height);
+	_codedExtent = { align_up(extent.width, alignWidth), align_up(extent.height, alignHeight) };
+	if (!Nv12Converter::supports(extent) || _codedExtent.width < _capabilities.minCodedExtent.width || _codedExtent.height < _capabilities.minCodedExtent.height
+		|| _codedExtent.width > _capabilities.maxCodedExtent.width || _codedExtent.height > _capabilities.maxCodedExtent.height)
+	{
+		return false;
+	}
+
+	VkVideoSessionCreateInfoKHR sessionInfo = {};
+	sessionInfo.sType = VK_STRUCTURE_TYPE_VIDEO_SESSION_CREATE_INFO_KHR;
+	sessionInfo.queueFamilyIndex = _encodeQueueFamily;
+	sessionInfo.pVideoProfile = &_profile;
+	sessionInfo.pictureFormat = _pictureFormat;
+	sessionInfo.maxCodedExtent = _codedExtent;
+	sessionInfo.referencePictureFormat = _dpbFormat;
+	sessionInfo.maxDpbSlots = DPB_SLOTS;
+	sessionInfo.maxActiveReferencePictures = 1;
+	sessionInfo.pStdHeaderVersion = &_capabilities.stdHeaderVersion;
+	if (_vkCreateVideoSession(_device, &sessionInfo, nullptr, &_session) != VK_SUCCESS)
+	{
+		_session = VK_NULL_HANDLE;
+		return false;
+	}
+
+	// the session's own memory, in whatever types and pieces the driver asks for
+	uint32_t requirementCount = 0;
+	_vkGetVideoSessionMemoryRequirements(_device, _session, &requirementCount, nullptr);
+	std::vector<VkVideoSessionMemoryRequirementsKHR> requirements(requirementCount);
+	for (VkVideoSessionMemoryRequirementsKHR& requirement : requirements)
+	{
+		requirement = {};
+		requirement.sType = VK_STRUCTURE_TYPE_VIDEO_SESSION_MEMORY_REQUIREMENTS_KHR;
+	}
+	_vkGetVideoSessionMemoryRequirements(_device, _session, &requirementCount, requirements.data());
+	std::vector<VkBindVideoSessionMemoryInfoKHR> binds;
+	for (const VkVideoSessionMemoryRequirementsKHR& requirement : requirements)
+	{
+		VmaAllocationCreateInfo memoryInfo = {};
+		memoryInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+		VmaAllocation allocation;
+		VmaAllocationInfo allocationInfo;
+		VK_CHECK(vmaAllocateMemory(_allocator, &requirement.memoryRequirements, &memoryInfo, &allocation, &allocationInfo));
+		_sessionMemory.push_back(allocation);
+
+		VkBindVideoSessionMemoryInfoKHR bind = {};
+		bind.sType = VK_STRUCTURE_TYPE_BIND_VIDEO_SESSION_MEMORY_INFO_KHR;
+		bind.memoryBindIndex = requirement.memoryBindIndex;
+		bind.memory = allocationInfo.deviceMemory;
+		bind.memoryOffset = allocationInfo.offset;
+		bind.memorySize = requirement.memoryRequirements.size;
+		binds.push_back(bind);
+	}
+	VK_CHECK(_vkBindVideoSessionMemory(_device, _session, static_cast<uint32_t>(binds.size()), binds.data()));
+
+	// progressive frames, one reference, picture order from frame_num alone; the SPS crops the coded size
+	// back to the frame's
+	StdVideoH264SequenceParameterSet sps = {};
+	sps.flags.frame_mbs_only_flag = 1;
+	sps.flags.direct_8x8_inference_flag = 1;
+	sps.flags.frame_cropping_flag = _codedExtent.width != extent.width || _codedExtent.height != extent.height;
+	sps.profile_idc = STD_VIDEO_H264_PROFILE_IDC_MAIN;
+	sps.level_idc = _h264Capabilities.maxLevelIdc;
+	sps.chroma_format_idc = STD_VIDEO_H264_CHROMA_FORMAT_IDC_420;
+	sps.seq_parameter_set_id = 0;
+	sps.log2_max_frame_num_minus4 = 4; // frame_num restarts at every IDR, so a GOP of 256 fits
+	sps.pic_order_cnt_type = STD_VIDEO_H264_POC_TYPE_2;
+	sps.max_num_ref_frames = 1;
+	sps.pic_width_in_mbs_minus1 = _codedExtent.width / 16 - 1;
+	sps.pic_height_in_map_units_minus1 = _codedExtent.height / 16 - 1;
+	// in 4:2:0, crop offsets count pairs of pixels
+	sps.frame_crop_right_offset = (_codedExtent.width - extent.width) / 2;
+	sps.frame_crop_bottom_offset = (_codedExtent.height - extent.height) / 2;
+
+	StdVideoH264PictureParameterSet pps = {};
+	pps.flags.entropy_coding_mode_flag = _cabac ? 1 : 0;
+	pps.flags.deblocking_filter_control_present_flag = 1;
+	pps.seq_parameter_set_id = 0;
+	pps.pic_parameter_set_id = 0;
+	pps.num_ref_idx_l0_default_active_minus1 = 0;
+
+	VkVideoEncodeH264SessionParametersAddInfoKHR addInfo = {};
+	addInfo.sType = VK_STRUCTURE_TYPE_VIDEO_ENCODE_H264_SESSION_PARAMETERS_ADD_INFO_KHR;
+	addInfo.stdSPSCount = 1;
+	addInfo.pStdSPSs = &sps;
+	addInfo.stdPPSCount = 1;
+	addInfo.pStdPPSs = &pps;
+	VkVideoEncodeH264SessionParametersCreateInfoKHR h264ParametersInfo = {};
+	h264ParametersInfo.sType = VK_STRUCTURE_TYPE_VIDEO_ENCODE_H264_SESSION_PARAMETERS_CREATE_INFO_KHR;
+	h264ParametersInfo.maxStdSPSCount = 1;
+	h264ParametersInfo.maxStdPPSCount = 1;
+	h264ParametersInfo.pParametersAddInfo = &addInfo;
+	VkVideoSessionParametersCreateInfoKHR parametersInfo = {};
+	parametersInfo.sType = VK_STRUCTURE_TYPE_VIDEO_SESSION_PARAMETERS_CREATE_INFO_KHR;
+	parametersInfo.pNext = &h264ParametersInfo;
+	parametersInfo.videoSession = _session;
+	VK_CHECK(_vkCreateVideoSessionParameters(_device, &parametersInfo, nullptr, &_sessionParameters));
+
+	// the driver may override parts of them, so the stream carries the ones it actually encodes with
+	VkVideoEncodeH264SessionParametersGetInfoKHR h264GetInfo = {};
+	h264GetInfo.sType = VK_STRUCTURE_TYPE_VIDEO_ENCODE_H264_SESSION_PARAMETERS_GET_INFO_KHR;
+	h264GetInfo.writeStdSPS = VK_TRUE;
+	h264GetInfo.writeStdPPS = VK_TRUE;
+	VkVideoEncodeSessionParametersGetInfoKHR getInfo = {};
+	getInfo.sType = VK_STRUCTURE_TYPE_VIDEO_ENCODE_SESSION_PARAMETERS_GET_INFO_KHR;
+	getInfo.pNext = &h264GetInfo;
+	getInfo.videoSessionParameters = _sessionParameters;
+	size_t headerSize = 0;
+	VK_CHECK(_vkGetEncodedVideoSessionParameters(_device, &getInfo, nullptr, &headerSize, nullptr));
+	_parameterSets.resize(headerSize);
+	VK_CHECK(_vkGetEncodedVideoSessionParameters(_device, &getInfo, nullptr, &headerSize, _parameterSets.data()));
+	_parameterSets.resize(headerSize);
+
+	VmaAllocationCreateInfo deviceAlloc = {};
+	deviceAlloc.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+	// the reference pictures never leave the encode queue
+	VkImageCreateInfo dpbInfo = vkinit::image_create_info(_dpbFormat, VK_IMAGE_USAGE_VIDEO_ENCODE_DPB_BIT_KHR, { _codedExtent.width, _codedExtent.height, 1 });
+	dpbInfo.pNext = &_profileList;
+	dpbInfo.arrayLayers = DPB_SLOTS;
+	VK_CHECK(vmaCreateImage(_allocator, &dpbInfo, &deviceAlloc, &_dpb._image, &_dpb._allocation, nullptr));
+	VkImageViewCreateInfo dpbViewInfo = vkinit::imageview_create_info(_dpbFormat, _dpb._image, VK_IMAGE_ASPECT_COLOR_BIT);
+	dpbViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+	dpbViewInfo.subresourceRange.layerCount = DPB_SLOTS;
+	VK_CHECK(vkCreateImageView(_device, &dpbViewInfo, nullptr, &_dpbView));
+
+	// a whole raw NV12 frame is far more than any encoded one
+	_bitstreamSize = align_up(Nv12Converter::buffer_size(extent), std::max<VkDeviceSize>(_capabilities.minBitstreamBufferSizeAlignment, 1));
+
+	for (Slot& slot : _slots)
+	{
+		VkBufferCreateInfo nv12Info = {};
+		nv12Info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		nv12Info.size = Nv12Converter::buffer_size(extent);
+		nv12Info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		VK_CHECK(vmaCreateBuffer(_allocator, &nv12Info, &deviceAlloc, &slot.nv12._buffer, &slot.nv12._allocation, nullptr));
+
+		VkImageCreateInfo sourceInfo = vkinit::image_create_info(_pictureFormat,
+			VK_IMAGE_USAGE_VIDEO_ENCODE_SRC_BIT_KHR | VK_IMAGE_USAGE_TRANSFER_DST_BIT, { _codedExtent.width, _codedExtent.height, 1 });
+		sourceInfo.pNext = &_profileList;
+		VK_CHECK(vmaCreateImage(_allocator, &sourceInfo, &deviceAlloc, &slot.source._image, &slot.source._allocation, nullptr));
+		VkImageViewCreateInfo sourceViewInfo = vkinit::imageview_create_info(_pictureFormat, slot.source._image, VK_IMAGE_ASPECT_COLOR_BIT);
+		VK_CHECK(vkCreateImageView(_device, &sourceViewInfo, nullptr, &slot.sourceView));
+
+		// mapped for as long as the buffer lives; deliver() invalidates before reading
+		VkBufferCreateInfo bitstreamInfo = {};
+		bitstreamInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bitstreamInfo.pNext = &_profileList;
+		bitstreamInfo.size = _bitstreamSize;
+		bitstreamInfo.usage = VK_BUFFER_USAGE_VIDEO_ENCODE_DST_BIT_KHR;
+		VmaAllocationCreateInfo hostAlloc = {};
+		hostAlloc.usage = VMA_MEMORY_USAGE_GPU_TO_CPU;
+		VK_CHECK(vmaCreateBuffer(_allocator, &bitstreamInfo, &hostAlloc, &slot.bitstream._buffer, &slot.bitstream._allocation, nullptr));
+		VK_CHECK(vmaMapMemory(_allocator, slot.bitstream._allocation, &slot.mapped));
+		slot.frame = -1;
+		slot.submitted = false;
+	}
+
+	_gopFrame = 0;
+	_lastDpbSlot = DPB_SLOTS - 1;
+	_sessionReset = false;
+	_ready = true;
+	return true;
+}
+
+void VideoEncoder::destroy_session()
+{
+	_ready = false;
+	for (Slot& slot : _slots)
+	{
+		if (slot.nv12._buffer == VK_NULL_HANDLE)
+		{
+			continue;
+		}
+		vmaDestroyBuffer(_allocator, slot.nv12._buffer, slot.nv12._allocation);
+		vkDestroyImageView(_device, slot.sourceView, nullptr);
+		vmaDestroyImage(_allocator, slot.source._image, slot.source._allocation);
+		vmaUnmapMemory(_allocator, slot.bitstream._allocation);
+		vmaDestroyBuffer(_allocator, slot.bitstream._buffer, slot.bitstream._allocation);
+		slot.nv12 = {};
+		slot.source = {};
+		slot.sourceView = VK_NULL_HANDLE;
+		slot.bitstream = {};
+		slot.mapped = nullptr;
+		slot.frame = -1;
+		slot.submitted = false;
+	}
+	if (_dpbView != VK_NULL_HANDLE)
+	{
+		vkDestroyImageView(_device, _dpbView, nullptr);
+		vmaDestroyImage(_allocator, _dpb._image, _dpb._allocation);
+		_dpbView = VK_NULL_HANDLE;
+		_dpb = {};
+	}
+	if (_sessionParameters != VK_NULL_HANDLE)
+	{
+		_vkDestroyVideoSessionParameters(_device, _sessionParameters, nullptr);
+		_sessionParameters = VK_NULL_HANDLE;
+	}
+	if (_session != VK_NULL_HANDLE)
+	{
+		_vkDestroyVideoSession(_device, _session, nullptr);
+		_session = VK_NULL_HANDLE;
+	}
+	for (VmaAllocation allocation : _sessionMemory)
+	{
+		vmaFreeMemory(_allocator, allocation);
+	}
+	_sessionMemory.clear();
+}
+
+void VideoEncoder::record(VkCommandBuffer cmd, uint32_t frameIndex, int frameNumber, VkImage image, VkImageView view, VkImageLayout finalLayout)
+{
+	Slot& slot = _slots[frameIndex];
+	const bool transferOwnership = _encodeQueueFamily != _graphicsQueueFamily;
+
+	// the transfer-stage transition that left the image here made its writes visible
+	VkImageMemoryBarrier toSampled = vkinit::image_barrier(image, 0, VK_ACCESS_SHADER_READ_BIT,
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toSampled);
+
+	// the slot's last encode has been delivered, so its set, buffer and source picture are free
+	_nv12.record(cmd, frameIndex, view, _imageFormat, _extent, slot.nv12._buffer);
+
+	// the source picture's old contents go, so it needs no ownership back from the encode queue
+	VkBufferMemoryBarrier nv12ToCopy = vkinit::buffer_barrier(slot.nv12._buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+	VkImageMemoryBarrier sourceToCopy = vkinit::image_barrier(slot.source._image, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &nv12ToCopy, 1, &sourceToCopy);
+
+	// luma, then interleaved chroma at half the size; the coded area past the frame is cropped by the SPS
+	VkBufferImageCopy planes[2] = {};
+	planes[0].bufferOffset = 0;
+	planes[0].bufferRowLength = _extent.width;
+	planes[0].imageSubresource = { VK_IMAGE_ASPECT_PLANE_0_BIT, 0, 0, 1 };
+	planes[0].imageExtent = { _extent.width, _extent.height, 1 };
+	planes[1].bufferOffset = VkDeviceSize(_extent.width) * _extent.height;
+	planes[1].bufferRowLength = _extent.width / 2;
+	planes[1].imageSubresource = { VK_IMAGE_ASPECT_PLANE_1_BIT, 0, 0, 1 };
+	planes[1].imageExtent = { _extent.width / 2, _extent.height / 2, 1 };
+	vkCmdCopyBufferToImage(cmd, slot.nv12._buffer, slot.source._image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 2, planes);
+
+	if (transferOwnership)
+	{
+		// released here and acquired by the encode submit, with the same layout change
+		VkImageMemoryBarrier release = vkinit::image_barrier(slot.source._image, VK_ACCESS_TRANSFER_WRITE_BIT, 0,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_VIDEO_ENCODE_SRC_KHR, VK_IMAGE_ASPECT_COLOR_BIT);
+		release.srcQueueFamilyIndex = _graphicsQueueFamily;
+		release.dstQueueFamilyIndex = _encodeQueueFamily;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &release);
+	}
+
+	if (finalLayout != VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+	{
+		// whatever comes next (the readback, the overlay, or the next frame) waits at transfer or color output
+		VkImageMemoryBarrier toFinal = vkinit::image_barrier(image, 0, 0, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, finalLayout, VK_IMAGE_ASPECT_COLOR_BIT);
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &toFinal);
+	}
+
+	slot.frame = frameNumber;
+	slot.keyFrame = _gopFrame == 0;
+	record_encode(slot, frameIndex);
+}
+
+void VideoEncoder::record_encode(Slot& slot, uint32_t frameIndex)
+{
+	const bool idr = _gopFrame == 0;
+	const uint32_t setupSlot = (_lastDpbSlot + 1) % DPB_SLOTS;
+	const uint32_t referenceSlot = _lastDpbSlot;
+	const bool transferOwnership = _encodeQueueFamily != _graphicsQueueFamily;
+
+	VkCommandBuffer cmd = slot.cmd;
+	VK_CHECK(vkResetCommandBuffer(cmd, 0));
+	VkCommandBufferBeginInfo beginInfo = vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	VK_CHECK(vkBeginCommandBuffer(cmd, &beginInfo));
+	vkCmdResetQueryPool(cmd, _feedbackPool, frameIndex, 1);
+
+	// the source picture from the graphics queue, the reference the last encode wrote, and on a new session
+	// the reference pictures out of UNDEFINED
+	VkImageMemoryBarrier2KHR imageBarriers[2] = {};
+	imageBarriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+	imageBarriers[0].srcStageMask = transferOwnership ? VK_PIPELINE_STAGE_2_NONE_KHR : VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR;
+	imageBarriers[0].srcAccessMask = transferOwnership ? VK_ACCESS_2_NONE_KHR : VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR;
+	imageBarriers[0].dstStageMask = VK_PIPELINE_STAGE_2_VIDEO_ENCODE_BIT_KHR;
+	imageBarriers[0].dstAccessMask = VK_ACCESS_2_VIDEO_ENCODE_READ_BIT_KHR;
+	imageBarriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	imageBarriers[0].newLayout = VK_IMAGE_LAYOUT_VIDEO_ENCODE_SRC_KHR;
+	imageBarriers[0].srcQueueFamilyIndex = transferOwnership ? _graphicsQueueFamily : VK_QUEUE_FAMILY_IGNORED;
+	imageBarriers[0].dstQueueFamilyIndex = transferOwnership ? _encodeQueueFamily : VK_QUEUE_FAMILY_IGNORED;
+	imageBarriers[0].image = slot.source._image;
+	imageBarriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	imageBarriers[1] = imageBarriers[0];
+	imageBarriers[1].srcStageMask = VK_PIPELINE_STAGE_2_NONE_KHR;
+	imageBarriers[1].srcAccessMask = VK_ACCESS_2_NONE_KHR;
+	imageBarriers[1].dstAccessMask = VK_ACCESS_2_VIDEO_ENCODE_READ_BIT_KHR | VK_ACCESS_2_VIDEO_ENCODE_WRITE_BIT_KHR;
+	imageBarriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageBarriers[1].newLayout = VK_IMAGE_LAYOUT_VIDEO_ENCODE_DPB_KHR;
+	imageBarriers[1].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarriers[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarriers[1].image = _dpb._image;
+	imageBarriers[1].subresourceRange.layerCount = DPB_SLOTS;
+
+	VkMemoryBarrier2KHR dpbBarrier = {};
+	dpbBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2_KHR;
+	dpbBarrier.srcStageMask = VK_PIPELINE_STAGE_2_VIDEO_ENCODE_BIT_KHR;
+	dpbBarrier.srcAccessMask = VK_ACCESS_2_VIDEO_ENCODE_WRITE_BIT_KHR;
+	dpbBarrier.dstStageMask = VK_PIPELINE_STAGE_2_VIDEO_ENCODE_BIT_KHR;
+	dpbBarrier.dstAccessMask = VK_ACCESS_2_VIDEO_ENCODE_READ_BIT_KHR | VK_ACCESS_2_VIDEO_ENCODE_WRITE_BIT_KHR;
+
+	VkDependencyInfoKHR acquire = {};
+	acquire.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+	acquire.memoryBarrierCount = 1;
+	acquire.pMemoryBarriers = &dpbBarrier;
+	acquire.imageMemoryBarrierCount = _sessionReset ? 1 : 2;
+	acquire.pImageMemoryBarriers = imageBarriers;
+	_vkCmdPipelineBarrier2(cmd, &acquire);
+
+	VkVideoPictureResourceInfoKHR sourcePicture = {};
+	sourcePicture.sType = VK_STRUCTURE_TYPE_VIDEO_PICTURE_RESOURCE_INFO_KHR;
+	sourcePicture.codedExtent = _codedExtent;
+	sourcePicture.imageViewBinding = slot.sourceView;
+
+	VkVideoPictureResourceInfoKHR dpbPictures[DPB_SLOTS] = {};
+	for (uint32_t i = 0; i < DPB_SLOTS; i++)
+	{
+		dpbPictures[i].sType = VK_STRUCTURE_TYPE_VIDEO_PICTURE_RESOURCE_INFO_KHR;
+		dpbPictures[i].codedExtent = _codedExtent;
+		dpbPictures[i].baseArrayLayer = i;
+		dpbPictures[i].imageViewBinding = _dpbView;
+	}
+
+	// what the encoded frame becomes once it is a reference itself
+	StdVideoEncodeH264ReferenceInfo& setupReference = _references[setupSlot];
+	setupReference = {};
+	setupReference.primary_pic_type = idr ? STD_VIDEO_H264_PICTURE_TYPE_IDR : STD_VIDEO_H264_PICTURE_TYPE_P;
+	setupReference.FrameNum = _gopFrame;
+	setupReference.PicOrderCnt = static_cast<int32_t>(_gopFrame * 2);
+
+	VkVideoEncodeH264DpbSlotInfoKHR setupDpbInfo = {};
+	setupDpbInfo.sType = VK_STRUCTURE_TYPE_VIDEO_ENCODE_H264_DPB_SLOT_INFO_KHR;
+	setupDpbInfo.pStdReferenceInfo = &setupReference;
+	VkVideoEncodeH264DpbSlotInfoKHR referenceDpbInfo = setupDpbInfo;
+	referenceDpbInfo.pStdReferenceInfo = &_references[referenceSlot];
+
+	VkVideoReferenceSlotInfoKHR setup = {};
+	setup.sType = VK_STRUCTURE_TYPE_VIDEO_REFERENCE_SLOT_INFO_KHR;
+	setup.pNext = &setupDpbInfo;
+	setup.slotIndex = static_cast<int32_t>(setupSlot);
+	setup.pPictureResource = &dpbPictures[setupSlot];
+	VkVideoReferenceSlotInfoKHR reference = setup;
+	reference.pNext = &referenceDpbInfo;
+	reference.slotIndex = static_cast<int32_t>(referenceSlot);
+	reference.pPictureResource = &dpbPictures[referenceSlot];
+
+	// the setup picture is bound without a slot until the encode activates it; P frames also bind the reference
+	VkVideoReferenceSlotInfoKHR boundSlots[2] = { setup, reference };
+	boundSlots[0].pNext = nullptr;
+	boundSlots[0].slotIndex = -1;
+	boundSlots[1].pNext = nullptr;
+
+	// constant QP needs rate control off; the session's state has to match on every begin after the reset
+	VkVideoEncodeRateControlInfoKHR rateControl = {};
+	rateControl.sType = VK_STRUCTURE_TYPE_VIDEO_ENCODE_RATE_CONTROL_INFO_KHR;
+	rateControl.rateControlMode = _constantQp ? VK_VIDEO_ENCODE_RATE_CONTROL_MODE_DISABLED_BIT_KHR : VK_VIDEO_ENCODE_RATE_CONTROL_MODE_DEFAULT_KHR;
+
+	VkVideoBeginCodingInfoKHR beginCoding = {};
+	beginCoding.sType = VK_STRUCTURE_TYPE_VIDEO_BEGIN_CODING_INFO_KHR;
+	beginCoding.pNext = _sessionReset && _constantQp ? &rateControl : nullptr;
+	beginCoding.videoSession = _session;
+	beginCoding.videoSessionParameters = _sessionParameters;
+	beginCoding.referenceSlotCount = idr ? 1 : 2;
+	beginCoding.pReferenceSlots = boundSlots;
+	_vkCmdBeginVideoCoding(cmd, &beginCoding);
+
+	if (!_sessionReset)
+	{
+		VkVideoCodingControlInfoKHR control = {};
+		control.sType = VK_STRUCTURE_TYPE_VIDEO_CODING_CONTROL_INFO_KHR;
+		control.pNext = _constantQp ? &rateControl : nullptr;
+		control.flags = VK_VIDEO_CODING_CONTROL_RESET_BIT_KHR | (_constantQp ? VK_VIDEO_CODING_CONTROL_ENCODE_RATE_CONTROL_BIT_KHR : 0);
+		_vkCmdControlVideoCoding(cmd, &control);
+		_sessionReset = true;
+	}
+
+	// P frames predict from the DPB slot holding the last frame and nothing else
+	StdVideoEncodeH264ReferenceListsInfo referenceLists = {};
+	std::memset(referenceLists.RefPicList0, STD_VIDEO_H264_NO_REFERENCE_PICTURE, sizeof(referenceLists.RefPicList0));
+	std::memset(referenceLists.RefPicList1, STD_VIDEO_H264_NO_REFERENCE_PICTURE, sizeof(referenceLists.RefPicList1));
+	if (!idr)
+	{
+		referenceLists.RefPicList0[0] = static_cast<uint8_t>(referenceSlot);
+	}
+
+	StdVideoEncodeH264SliceHeader sliceHeader = {};
+	sliceHeader.slice_type = idr ? STD_VIDEO_H264_SLICE_TYPE_I : STD_VIDEO_H264_SLICE_TYPE_P;
+	sliceHeader.cabac_init_idc = STD_VIDEO_H264_CABAC_INIT_IDC_0;
+	VkVideoEncodeH264NaluSliceInfoKHR slice = {};
+	slice.sType = VK_STRUCTURE_TYPE_VIDEO_ENCODE_H264_NALU_SLICE_INFO_KHR;
+	slice.constantQp = _constantQp ? _settings.qp : 0;
+	slice.pStdSliceHeader = &sliceHeader;
+
+	StdVideoEncodeH264PictureInfo pictureInfo = {};
+	pictureInfo.flags.IdrPicFlag = idr ? 1 : 0;
+	pictureInfo.flags.is_reference = 1;
+	pictureInfo.idr_pic_id = _idrPicId;
+	pictureInfo.primary_pic_type = setupReference.primary_pic_type;
+	pictureInfo.frame_num = _gopFrame;
+	pictureInfo.PicOrderCnt = setupReference.PicOrderCnt;
+	pictureInfo.pRefLists = &referenceLists;
+	VkVideoEncodeH264PictureInfoKHR h264Picture = {};
+	h264Picture.sType = VK_STRUCTURE_TYPE_VIDEO_ENCODE_H264_PICTURE_INFO_KHR;
+	h264Picture.naluSliceEntryCount = 1;
+	h264Picture.pNaluSliceEntries = &slice;
+	h264Picture.pStdPictureInfo = &pictureInfo;
+
+	VkVideoEncodeInfoKHR encodeInfo = {};
+	encodeInfo.sType = VK_STRUCTURE_TYPE_VIDEO_ENCODE_INFO_KHR;
+	encodeInfo.pNext = &h264Picture;
+	encodeInfo.dstBuffer = slot.bitstream._buffer;
+	encodeInfo.dstBufferOffset = 0;
+	encodeInfo.dstBufferRange = _bitstreamSize;
+	encodeInfo.srcPictureResource = sourcePicture;
+	encodeInfo.pSetupReferenceSlot = &setup;
+	encodeInfo.referenceSlotCount = idr ? 0 : 1;
+	encodeInfo.pReferenceSlots = idr ? nullptr : &reference;
+	vkCmdBeginQuery(cmd, _feedbackPool, frameIndex, 0);
+	_vkCmdEncodeVideo(cmd, &encodeInfo);
+	vkCmdEndQuery(cmd, _feedbackPool, frameIndex);
+
+	VkVideoEndCodingInfoKHR endCoding = {};
+	endCoding.sType = VK_STRUCTURE_TYPE_VIDEO_END_CODING_INFO_KHR;
+	_vkCmdEndVideoCoding(cmd, &endCoding);
+
+	// the fence alone doesn't make device writes visible to the host
+	VkBufferMemoryBarrier2KHR toHost = {};
+	toHost.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR;
+	toHost.srcStageMask = VK_PIPELINE_STAGE_2_VIDEO_ENCODE_BIT_KHR;
+	toHost.srcAccessMask = VK_ACCESS_2_VIDEO_ENCODE_WRITE_BIT_KHR;
+	toHost.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT_KHR;
+	toHost.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT_KHR;
+	toHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	toHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	toHost.buffer = slot.bitstream._buffer;
+	toHost.offset = 0;
+	toHost.size = VK_WHOLE_SIZE;
+	VkDependencyInfoKHR release = {};
+	release.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+	release.bufferMemoryBarrierCount = 1;
+	release.pBufferMemoryBarriers = &toHost;
+	_vkCmdPipelineBarrier2(cmd, &release);
+	VK_CHECK(vkEndCommandBuffer(cmd));
+
+	_lastDpbSlot = setupSlot;
+	if (idr)
+	{
+		_idrPicId++;
+	}
+	_gopFrame = (_gopFrame + 1) % _settings.gopLength;
+}
+
+void VideoEncoder::submit(uint32_t frameIndex, uint64_t graphicsValue)
+{
+	Slot& slot = _slots[frameIndex];
+	if (slot.frame < 0 || slot.submitted)
+	{
+		return;
+	}
+
+	// the source picture is written by the frame's graphics submit
+	VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+	timelineInfo.waitSemaphoreValueCount = 1;
+	timelineInfo.pWaitSemaphoreValues = &graphicsValue;
+	const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+	VkSubmitInfo submitInfo = vkinit::submit_info(&slot.cmd);
+	submitInfo.pNext = &timelineInfo;
+	submitInfo.waitSemaphoreCount = 1;
+	submitInfo.pWaitSemaphores = &_graphicsTimeline;
+	submitInfo.pWaitDstStageMask = &waitStage;
+	{
+		std::lock_guard<std::mutex> lock(*_queueMutex);
+		VK_CHECK(vkQueueSubmit(_encodeQueue, 1, &submitInfo, slot.fence));
+	}
+	slot.submitted = true;
+}
+
+void VideoEncoder::deliver(uint32_t frameIndex, const Callback& callback)
+{
+	Slot& slot = _slots[frameIndex];
+	if (slot.frame < 0)
+	{
+		return;
+	}
+	const int frameNumber = slot.frame;
+	slot.frame = -1;
+	if (!slot.submitted)
+	{
+		return;
+	}
+	slot.submitted = false;
+	VK_CHECK(vkWaitForFences(_device, 1, &slot.fence, VK_TRUE, UINT64_MAX));
+	VK_CHECK(vkResetFences(_device, 1, &slot.fence));
+
+	// offset, bytes written, then the status, negative on failure
+	uint64_t feedback[3] = {};
+	VkResult result = vkGetQueryPoolResults(_device, _feedbackPool, frameIndex, 1, sizeof(feedback), feedback, sizeof(feedback),
+		VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_STATUS_BIT_KHR);
+	if (result != VK_SUCCESS || static_cast<int64_t>(feedback[2]) <= 0)
+	{
+		LOG_ERROR("Video encode of frame " << frameNumber << " failed");
+		return;
+	}
+	if (!callback)
+	{
+		return;
+	}
+
+	vmaInvalidateAllocation(_allocator, slot.bitstream._allocation, 0, VK_WHOLE_SIZE);
+	const uint8_t* bitstream = static_cast<const uint8_t*>(slot.mapped) + feedback[0];
+	_packet.clear();
+	if (slot.keyFrame)
+	{
+		_packet.insert(_packet.end(), _parameterSets.begin(), _parameterSets.end());
+	}
+	_packet.insert(_packet.end(), bitstream, bitstream + feedback[1]);
+
+	Packet packet;
+	packet.frameNumber = frameNumber;
+	packet.keyFrame = slot.keyFrame;
+	packet.data = _packet.data();
+	packet.size = _packet.size();
+	callback(packet);
+}
+
+#else
+
+// headers without Vulkan Video: nothing encodes
+
+bool VideoEncoder::init(VkInstance, VkPhysicalDevice, VkDevice, VmaAllocator, DescriptorAllocator&, VkShaderModule, VkPipelineCache, uint32_t,
+	VkSemaphore, std::mutex&, uint32_t, const Settings&)
+{
+	return false;
+}
+
+void VideoEncoder::cleanup()
+{
+}
+
+bool VideoEncoder::resize(VkExtent2D, VkFormat)
+{
+	return false;
+}
+
+void VideoEncoder::record(VkCommandBuffer, uint32_t, int, VkImage, VkImageView, VkImageLayout)
+{
+}
+
+void VideoEncoder::submit(uint32_t, uint64_t)
+{
+}
+
+void VideoEncoder::deliver(uint32_t, const Callback&)
+{
+}
+
+#endif
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <vk_types.h>
+#include <DescriptorAllocator.h>
+#include <Nv12Converter.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// Encodes the finished frame to H.264 on the GPU's video encode engine (VK_KHR_video_encode_h264), so
+// streaming renders don't pay for an RGBA readback and a CPU encoder. The graphics queue converts the frame
+// to NV12 and copies it into the slot's encode source picture; the encode queue waits for that on the
+// graphics timeline and writes the bitstream into a host-visible buffer. Only the compressed stream ever
+// reaches host memory. One IDR frame per GOP, every other frame a P frame predicted from the one before.
+class VideoEncoder
+{
+public:
+	struct Settings {
+		uint32_t gopLength{ 60 }; // frames from one IDR to the next, at most 256
+		int32_t qp{ 26 }; // constant QP where rate control can be disabled; otherwise the driver's default rate control
+	};
+
+	// one encoded frame of Annex B stream, valid only while the callback runs; key frames start with the SPS
+	// and PPS, so the stream can be cut at any of them
+	struct Packet {
+		int frameNumber;
+		bool keyFrame;
+		const uint8_t* data;
+		size_t size;
+	};
+	using Callback = std::function<void(const Packet& packet)>;
+
+	// false, with nothing left to clean up, when no queue family of the device encodes H.264. The device
+	// needs VK_KHR_video_queue, VK_KHR_video_encode_queue and VK_KHR_video_encode_h264 with synchronization2
+	// enabled and one queue in every family, like vk-bootstrap creates; graphicsTimeline is the semaphore the
+	// frames' graphics submits signal. queueMutex is held around the encode submits, which other sessions on
+	// the device make to the same queue
+	bool init(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device, VmaAllocator allocator, DescriptorAllocator& descriptors,
+		VkShaderModule nv12Shader, VkPipelineCache cache, uint32_t graphicsQueueFamily, VkSemaphore graphicsTimeline, std::mutex& queueMutex,
+		uint32_t frameOverlap, const Settings& settings);
+	// the GPU must be done with every frame encoded
+	void cleanup();
+
+	// after every swapchain (re)build, with no frame in flight and everything encoded delivered; starts a new
+	// stream with an IDR frame. False if the encoder can't take frames of this size, until the next resize
+	bool resize(VkExtent2D extent, VkFormat imageFormat);
+	bool ready() const { return _ready; }
+	// the next frame recorded is an IDR frame starting a new GOP, so the stream can be cut in front of it
+	void force_key_frame() { _gopFrame = 0; }
+	uint32_t queue_family() const { return _encodeQueueFamily; }
+	// image usage the frames encoded need
+	static VkImageUsageFlags image_usage();
+
+	// like FrameReadback::record: after the frame's last write to image, which must have left it in
+	// TRANSFER_SRC_OPTIMAL readable by transfers; leaves it in finalLayout, where color output and
+	// transfers may read or write it next. The slot's previous encode must have been delivered
+	void record(VkCommandBuffer cmd, uint32_t frameIndex, int frameNumber, VkImage image, VkImageView view, VkImageLayout finalLayout);
+	// right after the graphics submit of the frame record() went into, which signals graphicsValue
+	void submit(uint32_t frameIndex, uint64_t graphicsValue);
+	// after frameIndex's graphics fence: waits for the slot's last encode, normally long done, and hands its
+	// packet to callback. Frames come out in order as long as the slots are delivered in frame order
+	void deliver(uint32_t frameIndex, const Callback& callback);
+
+private:
+	struct Slot {
+		AllocatedBuffer nv12{}; // the converted frame, copied into the source picture
+		AllocatedImage source{};
+		VkImageView sourceView{ VK_NULL_HANDLE };
+		AllocatedBuffer bitstream{};
+		void* mapped{ nullptr };
+		VkCommandBuffer cmd{ VK_NULL_HANDLE };
+		VkFence fence{ VK_NULL_HANDLE };
+		int frame{ -1 }; // recorded and not delivered yet, -1 for none
+		bool submitted{ false };
+		bool keyFrame{ false };
+	};
+
+	void destroy_session();
+	void record_encode(Slot& slot, uint32_t frameIndex);
+
+	VkPhysicalDevice _physicalDevice{ VK_NULL_HANDLE };
+	VkDevice _device{ VK_NULL_HANDLE };
+	VmaAllocator _allocator{ nullptr };
+	VkSemaphore _graphicsTimeline{ VK_NULL_HANDLE };
+	uint32_t _graphicsQueueFamily{ 0 };
+	uint32_t _encodeQueueFamily{ VK_QUEUE_FAMILY_IGNORED };
+	VkQueue _encodeQueue{ VK_NULL_HANDLE };
+	std::mutex* _queueMutex{ nullptr };
+	VkCommandPool _commandPool{ VK_NULL_HANDLE };
+	VkQueryPool _feedbackPool{ VK_NULL_HANDLE }; // bitstream offset, bytes written and status, one query per slot
+	Nv12Converter _nv12; // one set per slot
+	Settings _settings;
+	std::vector<Slot> _slots;
+
+	VkExtent2D _extent{ 0, 0 };
+	VkExtent2D _codedExtent{ 0, 0 }; // _extent rounded up to whole macroblocks; the SPS crops it back
+	VkFormat _imageFormat{ VK_FORMAT_UNDEFINED };
+	VkDeviceSize _bitstreamSize{ 0 };
+	std::vector<uint8_t> _parameterSets; // SPS and PPS as the driver encodes them, put in front of every key frame
+	std::vector<uint8_t> _packet;
+
+	// the stream: the frame encoded last sits in DPB slot _lastDpbSlot and predicts the next one
+	uint32_t _gopFrame{ 0 };
+	uint16_t _idrPicId{ 0 };
+	uint32_t _lastDpbSlot{ 0 };
+	bool _sessionReset{ false };
+	bool _constantQp{ false };
+	bool _cabac{ false };
+	bool _ready{ false }; // a session for the current size exists
+
+#ifdef VK_KHR_video_encode_h264
+	VkVideoSessionKHR _session{ VK_NULL_HANDLE };
+	VkVideoEncodeH264ProfileInfoKHR _h264Profile{};
+	VkVideoProfileInfoKHR _profile{};
+	VkVideoProfileListInfoKHR _profileList{};
+	VkVideoCapabilitiesKHR _capabilities{};
+	VkVideoEncodeCapabilitiesKHR _encodeCapabilities{};
+	VkVideoEncodeH264CapabilitiesKHR _h264Capabilities{};
+	VkFormat _pictureFormat{ VK_FORMAT_UNDEFINED };
+	VkFormat _dpbFormat{ VK_FORMAT_UNDEFINED };
+	VkVideoSessionParametersKHR _sessionParameters{ VK_NULL_HANDLE };
+	std::vector<VmaAllocation> _sessionMemory;
+	AllocatedImage _dpb{}; // both reference pictures, one per layer
+	VkImageView _dpbView{ VK_NULL_HANDLE };
+	StdVideoEncodeH264ReferenceInfo _references[2]{};
+
+	PFN_vkGetPhysicalDeviceVideoCapabilitiesKHR _vkGetPhysicalDeviceVideoCapabilities{ nullptr };
+	PFN_vkGetPhysicalDeviceVideoFormatPropertiesKHR _vkGetPhysicalDeviceVideoFormatProperties{ nullptr };
+	PFN_vkCreateVideoSessionKHR _vkCreateVideoSession{ nullptr };
+	PFN_vkDestroyVideoSessionKHR _vkDestroyVideoSession{ nullptr };
+	PFN_vkGetVideoSessionMemoryRequirementsKHR _vkGetVideoSessionMemoryRequirements{ nullptr };
+	PFN_vkBindVideoSessionMemoryKHR _vkBindVideoSessionMemory{ nullptr };
+	PFN_vkCreateVideoSessionParametersKHR _vkCreateVideoSessionParameters{ nullptr };
+	PFN_vkDestroyVideoSessionParametersKHR _vkDestroyVideoSessionParameters{ nullptr };
+	PFN_vkGetEncodedVideoSessionParametersKHR _vkGetEncodedVideoSessionParameters{ nullptr };
+	PFN_vkCmdBeginVideoCodingKHR _vkCmdBeginVideoCoding{ nullptr };
+	PFN_vkCmdControlVideoCodingKHR _vkCmdControlVideoCoding{ nullptr };
+	PFN_vkCmdEncodeVideoKHR _vkCmdEncodeVideo{ nullptr };
+	PFN_vkCmdEndVideoCodingKHR _vkCmdEndVideoCoding{ nullptr };
+	PFN_vkCmdPipelineBarrier2KHR _vkCmdPipelineBarrier2{ nullptr };
+#endif
+};
@@ -0,0 +1,542 @@
+#include "VirtualTexture.h"
+
+#include "vk_initializers.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace {
+	// pages of the screen a cache holds: the two levels trilinear filtering can pick between, plus pages
+	// straddling the screen's edges
+	constexpr uint32_t CACHE_OVERSUBSCRIPTION = 2;
+	// page table entries store slot coordinates in a byte, and the atlas must stay a valid image size
+	constexpr uint32_t MAX_CACHE_SIDE = std::min(255u, 16384u / VirtualTexture::SLOT_SIZE);
+	constexpr uint32_t MIN_CACHE_SIDE = 4;
+
+	constexpr uint32_t BLOCK_SIZE = 4;
+	static_assert(VirtualTexture::PAGE_SIZE % BLOCK_SIZE == 0 && VirtualTexture::PAGE_BORDER % BLOCK_SIZE == 0,
+		"pages are copied as whole BC blocks");
+
+	bool is_power_of_two(uint32_t value)
+	{
+		return value != 0 && (value & (value - 1)) == 0;
+	}
+
+	// the texture repeats, so the border around a page at its edge comes from the opposite side
+	uint32_t wrap(int64_t value, uint32_t size)
+	{
+		const int64_t wrapped = value % size;
+		return static_cast<uint32_t>(wrapped < 0 ? wrapped + size : wrapped);
+	}
+
+	// rgba8ui texel of the page table: slot coordinates, level of the page in it, and whether there's one
+	uint32_t table_entry(uint32_t slotX, uint32_t slotY, uint32_t level)
+	{
+		return slotX | (slotY << 8) | (level << 16) | (1u << 24);
+	}
+}
+
+uint32_t VirtualTexture::cache_side_for(VkExtent2D extent)
+{
+	// a page can cover as little as one screen pixel per texel; across and down the screen, one more for
+	// the pages cut by its edges
+	const uint32_t across = (extent.width + PAGE_SIZE - 1) / PAGE_SIZE + 1;
+	const uint32_t down = (extent.height + PAGE_SIZE - 1) / PAGE_SIZE + 1;
+	const uint32_t slots = across * down * CACHE_OVERSUBSCRIPTION;
+	const uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(slots))));
+	return std::clamp(side, MIN_CACHE_SIDE, MAX_CACHE_SIDE);
+}
+
+bool VirtualTexture::init(VkDevice device, VmaAllocator allocator, DescriptorAllocator& descriptors, LayoutCache& layouts, const Texture& texture,
+	uint32_t cacheSide, uint32_t frameOverlap, VkSampler sampler)
+{
+	if (!texture.is_block_compressed() || !is_power_of_two(texture._width) || !is_power_of_two(texture._height)
+		|| texture._levels.empty() || texture._pixels.empty())
+	{
+		return false;
+	}
+
+	// page table levels halve like any pow2 mip chain, down to the level whose single page is pinned
+	_pageLevels.clear();
+	_pageCount = 0;
+	for (uint32_t level = 0; level < texture._levels.size() && level < MAX_LEVELS; level++)
+	{
+		const TextureLevel& source = texture._levels[level];
+		PageLevel pageLevel = { std::max(1u, source.width / PAGE_SIZE), std::max(1u, source.height / PAGE_SIZE), _pageCount };
+		_pageLevels.push_back(pageLevel);
+		_pageCount += pageLevel.pagesX * pageLevel.pagesY;
+		if (pageLevel.pagesX == 1 && pageLevel.pagesY == 1)
+		{
+			break;
+		}
+	}
+	if (_pageLevels.back().pagesX != 1 || _pageLevels.back().pagesY != 1)
+	{
+		return false;
+	}
+
+	_device = device;
+	_allocator = allocator;
+	_texture = &texture;
+	_blockBytes = texture._format == VK_FORMAT_BC1_RGB_SRGB_BLOCK ? 8 : 16;
+	const uint32_t slotBlocks = SLOT_SIZE / BLOCK_SIZE;
+	_slotBytes = VkDeviceSize(slotBlocks) * slotBlocks * _blockBytes;
+	_cacheSide = std::clamp(cacheSide, MIN_CACHE_SIDE, MAX_CACHE_SIDE);
+	const uint32_t tableLevels = static_cast<uint32_t>(_pageLevels.size());
+
+	VmaAllocationCreateInfo gpuAlloc = {};
+	gpuAlloc.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+	gpuAlloc.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	VmaAllocationInfo allocationInfo = {};
+
+	// no mips: the page table picks the level, and the atlas is sampled at the one it holds
+	VkExtent3D atlasExtent = { _cacheSide * SLOT_SIZE, _cacheSide * SLOT_SIZE, 1 };
+	VkImageCreateInfo atlasInfo = vkinit::image_create_info(texture._format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, atlasExtent);
+	VK_CHECK(vmaCreateImage(_allocator, &atlasInfo, &gpuAlloc, &_atlas._image, &_atlas._allocation, &allocationInfo));
+	_memoryBytes = allocationInfo.size;
+
+	VkImageViewCreateInfo atlasViewInfo = vkinit::imageview_create_info(texture._format, _atlas._image, VK_IMAGE_ASPECT_COLOR_BIT);
+	VK_CHECK(vkCreateImageView(_device, &atlasViewInfo, nullptr, &_atlasView));
+
+	VkExtent3D tableExtent = { _pageLevels[0].pagesX, _pageLevels[0].pagesY, 1 };
+	VkImageCreateInfo tableInfo = vkinit::image_create_info(VK_FORMAT_R8G8B8A8_UINT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, tableExtent);
+	tableInfo.mipLevels = tableLevels;
+	VK_CHECK(vmaCreateImage(_allocator, &tableInfo, &gpuAlloc, &_pageTable._image, &_pageTable._allocation, &allocationInfo));
+	_memoryBytes += allocationInfo.size;
+
+	VkImageViewCreateInfo tableViewInfo = vkinit::imageview_create_info(VK_FORMAT_R8G8B8A8_UINT, _pageTable._image, VK_IMAGE_ASPECT_COLOR_BIT);
+	tableViewInfo.subresourceRange.levelCount = tableLevels;
+	VK_CHECK(vkCreateImageView(_device, &tableViewInfo, nullptr, &_pageTableView));
+
+	// filled by the transfer queue, read by the graphics queue's copies into the atlas
+	VkBufferCreateInfo stagingInfo = {};
+	stagingInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	stagingInfo.pNext = nullptr;
+	stagingInfo.size = _slotBytes * STAGING_SLOTS;
+	stagingInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	VK_CHECK(vmaCreateBuffer(_allocator, &stagingInfo, &gpuAlloc, &_staging._buffer, &_staging._allocation, nullptr));
+	_freeStaging.clear();
+	for (uint32_t i = STAGING_SLOTS; i > 0; i--)
+	{
+		_freeStaging.push_back(i - 1);
+	}
+
+	VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	_tableSampler = layouts.sampler(samplerInfo);
+
+	VkDescriptorSetLayoutBinding bindings[] = {
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0), // page table
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1), // atlas
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 2), // feedback
+	};
+
+	VkDescriptorSetLayoutCreateInfo setInfo = {};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setInfo.pNext = nullptr;
+	setInfo.bindingCount = 3;
+	setInfo.pBindings = bindings;
+	VK_CHECK(vkCreateDescriptorSetLayout(_device, &setInfo, nullptr, &_setLayout));
+
+	// read back on the CPU, one word per page
+	// both are touched by the CPU every frame, so they stay mapped
+	VmaAllocationCreateInfo readbackAlloc = {};
+	readbackAlloc.usage = VMA_MEMORY_USAGE_GPU_TO_CPU;
+	readbackAlloc.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+	VmaAllocationCreateInfo uploadAlloc = {};
+	uploadAlloc.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+	uploadAlloc.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+	VkBufferCreateInfo pageBufferInfo = {};
+	pageBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	pageBufferInfo.pNext = nullptr;
+	pageBufferInfo.size = VkDeviceSize(_pageCount) * sizeof(uint32_t);
+
+	_frames.assign(frameOverlap, Frame{});
+	for (Frame& frame : _frames)
+	{
+		pageBufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		VmaAllocationInfo allocationInfo = {};
+		VK_CHECK(vmaCreateBuffer(_allocator, &pageBufferInfo, &readbackAlloc, &frame.feedback._buffer, &frame.feedback._allocation, &allocationInfo));
+		frame.feedback._mapped = allocationInfo.pMappedData;
+		pageBufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		VK_CHECK(vmaCreateBuffer(_allocator, &pageBufferInfo, &uploadAlloc, &frame.table._buffer, &frame.table._allocation, &allocationInfo));
+		frame.table._mapped = allocationInfo.pMappedData;
+
+		descriptors.allocate(&frame.set, _setLayout);
+
+		VkDescriptorImageInfo tableImage = {};
+		tableImage.sampler = _tableSampler;
+		tableImage.imageView = _pageTableView;
+		tableImage.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		VkDescriptorImageInfo atlasImage = {};
+		atlasImage.sampler = sampler;
+		atlasImage.imageView = _atlasView;
+		atlasImage.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		VkDescriptorBufferInfo feedbackInfo = {};
+		feedbackInfo.buffer = frame.feedback._buffer;
+		feedbackInfo.offset = 0;
+		feedbackInfo.range = VK_WHOLE_SIZE;
+
+		VkWriteDescriptorSet writes[] = {
+			vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, frame.set, &tableImage, 0),
+			vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, frame.set, &atlasImage, 1),
+			vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.set, &feedbackInfo, 2),
+		};
+		vkUpdateDescriptorSets(_device, 3, writes, 0, nullptr);
+	}
+
+	_slots.assign(size_t(_cacheSide) * _cacheSide, Slot{});
+	_pageSlot.assign(_pageCount, NO_SLOT);
+	_requested.assign(_pageCount, false);
+	_wanted.clear();
+	_uploads.clear();
+	_cachedPages = 0;
+	_feedbackCount = 0;
+	_imagesReady = false;
+	_tableDirty = true;
+
+	// the last level is always there to fall back on, so it goes first
+	const uint32_t lastPage = _pageLevels.back().firstPage;
+	_requested[lastPage] = true;
+	_wanted.push_back(lastPage);
+	return true;
+}
+
+void VirtualTexture::cleanup()
+{
+	if (_texture == nullptr)
+	{
+		return;
+	}
+
+	// the sets go with the descriptor allocator's pools, the table sampler with the layout cache
+	for (Frame& frame : _frames)
+	{
+		vmaDestroyBuffer(_allocator, frame.feedback._buffer, frame.feedback._allocation);
+		vmaDestroyBuffer(_allocator, frame.table._buffer, frame.table._allocation);
+	}
+	_frames.clear();
+	vkDestroyDescriptorSetLayout(_device, _setLayout, nullptr);
+	vmaDestroyBuffer(_allocator, _staging._buffer, _staging._allocation);
+	vkDestroyImageView(_device, _pageTableView, nullptr);
+	vmaDestroyImage(_allocator, _pageTable._image, _pageTable._allocation);
+	vkDestroyImageView(_device, _atlasView, nullptr);
+	vmaDestroyImage(_allocator, _atlas._image, _atlas._allocation);
+	_texture = nullptr;
+}
+
+void VirtualTexture::read_feedback(uint32_t frameIndex)
+{
+	Frame& frame = _frames[frameIndex];
+	if (!frame.feedbackValid)
+	{
+		return;
+	}
+	_feedbackCount++;
+
+	// only what this feedback asks for is worth fetching; pages already staged stay requested
+	for (uint32_t page : _wanted)
+	{
+		_requested[page] = false;
+	}
+	_wanted.clear();
+
+	vmaInvalidateAllocation(_allocator, frame.feedback._allocation, 0, VK_WHOLE_SIZE);
+	const uint32_t* requested = static_cast<const uint32_t*>(frame.feedback._mapped);
+	const uint32_t levelCount = static_cast<uint32_t>(_pageLevels.size());
+	for (uint32_t level = 0; level < levelCount; level++)
+	{
+		const PageLevel& pageLevel = _pageLevels[level];
+		for (uint32_t i = 0; i < pageLevel.pagesX * pageLevel.pagesY; i++)
+		{
+			if (requested[pageLevel.firstPage + i] == 0)
+			{
+				continue;
+			}
+
+			// the page, and every ancestor its lookups fall back on until it arrives
+			uint32_t x = i % pageLevel.pagesX;
+			uint32_t y = i / pageLevel.pagesX;
+			for (uint32_t ancestor = level; ancestor < levelCount; ancestor++)
+			{
+				const PageLevel& ancestorLevel = _pageLevels[ancestor];
+				const uint32_t page = ancestorLevel.firstPage + y * ancestorLevel.pagesX + x;
+				if (_pageSlot[page] != NO_SLOT)
+				{
+					_slots[_pageSlot[page]].lastWanted = _feedbackCount;
+				}
+				else if (!_requested[page])
+				{
+					_requested[page] = true;
+					_wanted.push_back(page);
+				}
+				x >>= 1;
+				y >>= 1;
+			}
+		}
+	}
+}
+
+bool VirtualTexture::request_pages(UploadManager& uploads)
+{
+	if (_wanted.empty())
+	{
+		return false;
+	}
+
+	// coarse levels come later in page order; each is the fallback of everything finer under it
+	std::sort(_wanted.begin(), _wanted.end(), [](uint32_t a, uint32_t b) { return a > b; });
+
+	size_t staged = 0;
+	while (staged < _wanted.size() && staged < MAX_PAGE_UPLOADS && !_freeStaging.empty())
+	{
+		const uint32_t slot = allocate_slot();
+		if (slot == NO_SLOT)
+		{
+			break;
+		}
+
+		const uint32_t page = _wanted[staged];
+		const uint32_t staging = _freeStaging.back();
+		_freeStaging.pop_back();
+		uploads.upload_buffer(_staging._buffer, staging * _slotBytes, _slotBytes,
+			[this, page](void* data) { write_page(page, static_cast<uint8_t*>(data)); },
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+
+		Slot& entry = _slots[slot];
+		entry.page = page;
+		entry.lastWanted = _feedbackCount;
+		entry.pinned = page == _pageLevels.back().firstPage;
+		entry.pending = true;
+		_uploads.push_back({ page, slot, staging, 0 });
+		staged++;
+	}
+
+	// the rest stay requested and wait for the next frame
+	_wanted.erase(_wanted.begin(), _wanted.begin() + staged);
+	return staged > 0;
+}
+
+void VirtualTexture::set_upload_value(uint64_t value)
+{
+	for (PageUpload& upload : _uploads)
+	{
+		if (upload.uploadValue == 0)
+		{
+			upload.uploadValue = value;
+		}
+	}
+}
+
+void VirtualTexture::record(VkCommandBuffer cmd, uint32_t frameIndex, uint64_t acquiredValue, DeletionQueue& retired)
+{
+	Frame& frame = _frames[frameIndex];
+
+	std::vector<VkBufferImageCopy> copies;
+	for (size_t i = 0; i < _uploads.size();)
+	{
+		const PageUpload upload = _uploads[i];
+		if (upload.uploadValue == 0 || upload.uploadValue > acquiredValue)
+		{
+			i++;
+			continue;
+		}
+
+		VkBufferImageCopy copy = {};
+		copy.bufferOffset = upload.staging * _slotBytes;
+		copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copy.imageSubresource.mipLevel = 0;
+		copy.imageSubresource.baseArrayLayer = 0;
+		copy.imageSubresource.layerCount = 1;
+		copy.imageOffset = { static_cast<int32_t>(upload.slot % _cacheSide * SLOT_SIZE), static_cast<int32_t>(upload.slot / _cacheSide * SLOT_SIZE), 0 };
+		copy.imageExtent = { SLOT_SIZE, SLOT_SIZE, 1 };
+		copies.push_back(copy);
+
+		_slots[upload.slot].pending = false;
+		_pageSlot[upload.page] = upload.slot;
+		_requested[upload.page] = false;
+		_cachedPages++;
+		_tableDirty = true;
+
+		// the ring slot is free again once this frame's copy has run
+		const uint32_t staging = upload.staging;
+		retired.push_function([this, staging]() {
+			_freeStaging.push_back(staging);
+		});
+
+		_uploads[i] = _uploads.back();
+		_uploads.pop_back();
+	}
+
+	// earlier frames may still sample the slots being overwritten; they were replaced in the table before
+	// anyone could ask for them again, so only their reads have to finish first
+	const VkImageLayout currentLayout = _imagesReady ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+	if (!copies.empty() || !_imagesReady)
+	{
+		VkImageMemoryBarrier toCopy = vkinit::image_barrier(_atlas._image, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+			currentLayout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toCopy);
+
+		if (!copies.empty())
+		{
+			vkCmdCopyBufferToImage(cmd, _staging._buffer, _atlas._image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				static_cast<uint32_t>(copies.size()), copies.data());
+		}
+
+		VkImageMemoryBarrier toSample = vkinit::image_barrier(_atlas._image, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toSample);
+	}
+
+	if (_tableDirty || !_imagesReady)
+	{
+		// this frame's copy source was last read by the frame that used the slot before, which has finished
+		write_table(static_cast<uint32_t*>(frame.table._mapped));
+		vmaFlushAllocation(_allocator, frame.table._allocation, 0, VK_WHOLE_SIZE);
+
+		const uint32_t tableLevels = static_cast<uint32_t>(_pageLevels.size());
+		std::vector<VkBufferImageCopy> levels(tableLevels);
+		for (uint32_t level = 0; level < tableLevels; level++)
+		{
+			VkBufferImageCopy& copy = levels[level];
+			copy = {};
+			copy.bufferOffset = VkDeviceSize(_pageLevels[level].firstPage) * sizeof(uint32_t);
+			copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			copy.imageSubresource.mipLevel = level;
+			copy.imageSubresource.baseArrayLayer = 0;
+			copy.imageSubresource.layerCount = 1;
+			copy.imageExtent = { _pageLevels[level].pagesX, _pageLevels[level].pagesY, 1 };
+		}
+
+		// rewritten whole, so the old contents can go
+		VkImageMemoryBarrier toCopy = vkinit::image_barrier(_pageTable._image, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+		toCopy.subresourceRange.levelCount = tableLevels;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toCopy);
+
+		vkCmdCopyBufferToImage(cmd, frame.table._buffer, _pageTable._image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			tableLevels, levels.data());
+
+		VkImageMemoryBarrier toSample = vkinit::image_barrier(_pageTable._image, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+		toSample.subresourceRange.levelCount = tableLevels;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toSample);
+		_tableDirty = false;
+	}
+	_imagesReady = true;
+
+	// read back by read_feedback() before this frame slot came around again
+	vkCmdFillBuffer(cmd, frame.feedback._buffer, 0, VK_WHOLE_SIZE, 0);
+	VkBufferMemoryBarrier cleared = vkinit::buffer_barrier(frame.feedback._buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 1, &cleared, 0, nullptr);
+	frame.feedbackValid = true;
+}
+
+void VirtualTexture::finish_frame(VkCommandBuffer cmd, uint32_t frameIndex) const
+{
+	// the fence alone doesn't make device writes visible to the host
+	VkBufferMemoryBarrier toHost = vkinit::buffer_barrier(_frames[frameIndex].feedback._buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &toHost, 0, nullptr);
+}
+
+uint32_t VirtualTexture::level_of(uint32_t page) const
+{
+	uint32_t level = 0;
+	while (level + 1 < _pageLevels.size() && page >= _pageLevels[level + 1].firstPage)
+	{
+		level++;
+	}
+	return level;
+}
+
+uint32_t VirtualTexture::allocate_slot()
+{
+	// an empty slot, or else the one wanted longest ago; never one the latest feedback still asked for
+	uint32_t victim = NO_SLOT;
+	for (uint32_t i = 0; i < _slots.size(); i++)
+	{
+		const Slot& slot = _slots[i];
+		if (slot.pending || slot.pinned)
+		{
+			continue;
+		}
+		if (slot.page == NO_SLOT)
+		{
+			return i;
+		}
+		if (slot.lastWanted < _feedbackCount && (victim == NO_SLOT || slot.lastWanted < _slots[victim].lastWanted))
+		{
+			victim = i;
+		}
+	}
+
+	if (victim != NO_SLOT)
+	{
+		// the table stops pointing at it in the next record(), before the new page is copied over it
+		_pageSlot[_slots[victim].page] = NO_SLOT;
+		_slots[victim].page = NO_SLOT;
+		_cachedPages--;
+		_tableDirty = true;
+	}
+	return victim;
+}
+
+void VirtualTexture::write_page(uint32_t page, uint8_t* data) const
+{
+	const uint32_t level = level_of(page);
+	const PageLevel& pageLevel = _pageLevels[level];
+	const uint32_t local = page - pageLevel.firstPage;
+	const TextureLevel& source = _texture->_levels[level];
+	const uint8_t* pixels = _texture->_pixels.data() + source.offset;
+
+	// levels smaller than a page just repeat across the slot; the shader never reads past their size
+	const uint32_t blocksX = std::max(1u, (source.width + BLOCK_SIZE - 1) / BLOCK_SIZE);
+	const uint32_t blocksY = std::max(1u, (source.height + BLOCK_SIZE - 1) / BLOCK_SIZE);
+	const uint32_t slotBlocks = SLOT_SIZE / BLOCK_SIZE;
+	const int64_t firstX = int64_t(local % pageLevel.pagesX) * (PAGE_SIZE / BLOCK_SIZE) - PAGE_BORDER / BLOCK_SIZE;
+	const int64_t firstY = int64_t(local / pageLevel.pagesX) * (PAGE_SIZE / BLOCK_SIZE) - PAGE_BORDER / BLOCK_SIZE;
+	for (uint32_t y = 0; y < slotBlocks; y++)
+	{
+		const uint8_t* row = pixels + size_t(wrap(firstY + y, blocksY)) * blocksX * _blockBytes;
+		for (uint32_t x = 0; x < slotBlocks; x++)
+		{
+			memcpy(data + (size_t(y) * slotBlocks + x) * _blockBytes, row + size_t(wrap(firstX + x, blocksX)) * _blockBytes, _blockBytes);
+		}
+	}
+}
+
+void VirtualTexture::write_table(uint32_t* entries) const
+{
+	// coarsest first, so every page missing from the cache can take its parent's entry
+	for (uint32_t level = static_cast<uint32_t>(_pageLevels.size()); level > 0; level--)
+	{
+		const PageLevel& pageLevel = _pageLevels[level - 1];
+		for (uint32_t y = 0; y < pageLevel.pagesY; y++)
+		{
+			for (uint32_t x = 0; x < pageLevel.pagesX; x++)
+			{
+				const uint32_t page = pageLevel.firstPage + y * pageLevel.pagesX + x;
+				const uint32_t slot = _pageSlot[page];
+				if (slot != NO_SLOT)
+				{
+					entries[page] = table_entry(slot % _cacheSide, slot / _cacheSide, level - 1);
+				}
+				else if (level < _pageLevels.size())
+				{
+					const PageLevel& parent = _pageLevels[level];
+					entries[page] = entries[parent.firstPage + (y >> 1) * parent.pagesX + (x >> 1)];
+				}
+				else
+				{
+					// nothing to show until the last level arrives
+					entries[page] = 0;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <vk_types.h>
+#include <DeletionQueue.h>
+#include <DescriptorAllocator.h>
+#include <LayoutCache.h>
+#include <Texture.h>
+#include <UploadManager.h>
+
+#include <cstdint>
+#include <vector>
+
+// Virtual texturing for textures too large to keep resident even as a mip tail. Every level is cut into
+// PAGE_SIZE pages; a physical cache atlas holds the pages in use, a page table texture (one texel per page
+// of every level) maps each virtual page to the cached page standing in for it, itself or its nearest
+// cached ancestor, and a feedback buffer the fragment shaders write (see shaders/virtualTexture.glsl)
+// says which pages they wanted. The cache is sized from the screen, not from the texture.
+// Page data comes from the texture's stored chain and crosses the bus on the transfer queue into a
+// staging ring; the graphics queue copies it into the atlas in record(), so the atlas and the page table
+// never change queue owner and the frames still in flight are kept apart from the writes by barriers.
+class VirtualTexture
+{
+public:
+	static constexpr uint32_t PAGE_SIZE = 128;
+	// one BC block of the neighbouring pages around each page, so filtering at its edges reads the right texels
+	static constexpr uint32_t PAGE_BORDER = 4;
+	static constexpr uint32_t SLOT_SIZE = PAGE_SIZE + 2 * PAGE_BORDER;
+	// pages fetched per frame at most; the staging ring holds a few frames' worth
+	static constexpr uint32_t MAX_PAGE_UPLOADS = 16;
+	static constexpr uint32_t STAGING_SLOTS = MAX_PAGE_UPLOADS * 4;
+	// page table levels, enough for a 2^22 texel wide texture. The table ends at the first level of a single
+	// page; coarser stored levels are left out, so the texture must not be minified further than that
+	static constexpr uint32_t MAX_LEVELS = 16;
+
+	// slots per side of a cache that covers a screen of this size a few times over
+	static uint32_t cache_side_for(VkExtent2D extent);
+
+	// false, with nothing created, unless texture is block-compressed with power of two sides and its chain
+	// in _pixels down to a single page; texture must then keep _pixels until cleanup(). sampler is for the atlas
+	bool init(VkDevice device, VmaAllocator allocator, DescriptorAllocator& descriptors, LayoutCache& layouts, const Texture& texture,
+		uint32_t cacheSide, uint32_t frameOverlap, VkSampler sampler);
+	// the GPU must be done with every frame that used it
+	void cleanup();
+
+	// after frameIndex's fence: takes in what its fragment shaders asked for
+	void read_feedback(uint32_t frameIndex);
+	// before the upload flush: stages up to MAX_PAGE_UPLOADS requested pages, coarsest first, evicting the
+	// least recently wanted ones for them. True if any page was staged
+	bool request_pages(UploadManager& uploads);
+	// the pages staged since the last call travel with the batch that signals value
+	void set_upload_value(uint64_t value);
+
+	// graphics queue, outside a render pass, after the frame's acquires: copies the acquired pages into the
+	// atlas, rewrites the page table if anything moved and clears frameIndex's feedback. Staging slots go
+	// back to the ring once retired is flushed
+	void record(VkCommandBuffer cmd, uint32_t frameIndex, uint64_t acquiredValue, DeletionQueue& retired);
+	// after the frame's draws: makes the feedback they wrote visible to read_feedback()
+	void finish_frame(VkCommandBuffer cmd, uint32_t frameIndex) const;
+
+	// page table, atlas and the frame's feedback buffer, for the fragment stage
+	VkDescriptorSetLayout set_layout() const { return _setLayout; }
+	VkDescriptorSet descriptor(uint32_t frameIndex) const { return _frames[frameIndex].set; }
+
+	uint32_t cached_pages() const { return _cachedPages; }
+	uint32_t page_count() const { return _pageCount; }
+	// device-local memory of the atlas and page table
+	VkDeviceSize memory_bytes() const { return _memoryBytes; }
+
+private:
+	static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+	struct PageLevel {
+		uint32_t pagesX;
+		uint32_t pagesY;
+		uint32_t firstPage;
+	};
+
+	struct Slot {
+		uint32_t page{ NO_SLOT };
+		uint64_t lastWanted{ 0 };
+		// the last level's single page is never evicted, so every lookup ends at a cached page
+		bool pinned{ false };
+		// staged, not yet copied into the atlas
+		bool pending{ false };
+	};
+
+	struct PageUpload {
+		uint32_t page;
+		uint32_t slot;
+		uint32_t staging;
+		uint64_t uploadValue;
+	};
+
+	struct Frame {
+		AllocatedBuffer feedback{};
+		// host-visible copy source of the page table, rewritten when this frame updates it
+		AllocatedBuffer table{};
+		VkDescriptorSet set{ VK_NULL_HANDLE };
+		// false until record() first cleared the feedback
+		bool feedbackValid{ false };
+	};
+
+	uint32_t level_of(uint32_t page) const;
+	uint32_t allocate_slot();
+	void write_page(uint32_t page, uint8_t* data) const;
+	void write_table(uint32_t* entries) const;
+
+	VkDevice _device{ VK_NULL_HANDLE };
+	VmaAllocator _allocator{ nullptr };
+	const Texture* _texture{ nullptr };
+	uint32_t _blockBytes{ 0 };
+	VkDeviceSize _slotBytes{ 0 };
+
+	std::vector<PageLevel> _pageLevels;
+	uint32_t _pageCount{ 0 };
+	uint32_t _cacheSide{ 0 };
+
+	AllocatedImage _atlas{};
+	VkImageView _atlasView{ VK_NULL_HANDLE };
+	AllocatedImage _pageTable{};
+	VkImageView _pageTableView{ VK_NULL_HANDLE };
+	// both start UNDEFINED; the first record() moves them to SHADER_READ_ONLY_OPTIMAL
+	bool _imagesReady{ false };
+	bool _tableDirty{ true };
+	VkDeviceSize _memoryBytes{ 0 };
+
+	AllocatedBuffer _staging{};
+	std::vector<uint32_t> _freeStaging;
+
+	VkDescriptorSetLayout _setLayout{ VK_NULL_HANDLE };
+	// the page table is only ever texelFetched
+	VkSampler _tableSampler{ VK_NULL_HANDLE };
+	std::vector<Frame> _frames;
+
+	std::vector<Slot> _slots;
+	// per virtual page: its slot once the atlas holds it
+	std::vector<uint32_t> _pageSlot;
+	// per virtual page: staged or waiting in _wanted
+	std::vector<bool> _requested;
+	std::vector<uint32_t> _wanted;
+	std::vector<PageUpload> _uploads;
+	uint32_t _cachedPages{ 0 };
+	uint64_t _feedbackCount{ 0 };
+};
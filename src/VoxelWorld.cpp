@@ -0,0 +1,354 @@
+#include "VoxelWorld.h"
+
+#include "JobSystem.h"
+#include "Texture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/geometric.hpp>
+
+namespace {
+	constexpr int32_t CHUNK_BLOCKS = VOXEL_CHUNK_SIZE * VOXEL_CHUNK_SIZE * VOXEL_CHUNK_SIZE;
+
+	int32_t floor_div(int32_t value, int32_t divisor)
+	{
+		return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+	}
+
+	glm::ivec3 chunk_of(const glm::ivec3& position)
+	{
+		return { floor_div(position.x, VOXEL_CHUNK_SIZE), floor_div(position.y, VOXEL_CHUNK_SIZE), floor_div(position.z, VOXEL_CHUNK_SIZE) };
+	}
+
+	int32_t block_index(const glm::ivec3& local)
+	{
+		return local.x + VOXEL_CHUNK_SIZE * (local.y + VOXEL_CHUNK_SIZE * local.z);
+	}
+
+	float srgb_to_linear(uint8_t value)
+	{
+		return std::pow(value / 255.f, 2.2f);
+	}
+}
+
+VoxelBlock VoxelWorld::add_block_type(const glm::vec3& color)
+{
+	_palette.push_back(color);
+	return static_cast<VoxelBlock>(_palette.size() - 1);
+}
+
+uint64_t VoxelWorld::chunk_key(const glm::ivec3& coord)
+{
+	// 21 bits a coordinate, a million chunks each way
+	const uint64_t mask = (1ull << 21) - 1;
+	return (uint64_t(coord.x) & mask) | ((uint64_t(coord.y) & mask) << 21) | ((uint64_t(coord.z) & mask) << 42);
+}
+
+const VoxelChunk* VoxelWorld::find_chunk(const glm::ivec3& coord) const
+{
+	auto found = _chunkIndex.find(chunk_key(coord));
+	return found != _chunkIndex.end() ? &_chunks[found->second] : nullptr;
+}
+
+VoxelBlock VoxelWorld::get(const glm::ivec3& position) const
+{
+	const glm::ivec3 coord = chunk_of(position);
+	const VoxelChunk* chunk = find_chunk(coord);
+	return chunk != nullptr ? chunk->blocks[block_index(position - chunk->origin())] : VOXEL_AIR;
+}
+
+void VoxelWorld::set(const glm::ivec3& position, VoxelBlock block)
+{
+	const glm::ivec3 coord = chunk_of(position);
+	auto found = _chunkIndex.find(chunk_key(coord));
+	if (found == _chunkIndex.end())
+	{
+		if (block == VOXEL_AIR)
+		{
+			return;
+		}
+		found = _chunkIndex.emplace(chunk_key(coord), static_cast<uint32_t>(_chunks.size())).first;
+		VoxelChunk chunk;
+		chunk.coord = coord;
+		chunk.blocks.assign(CHUNK_BLOCKS, VOXEL_AIR);
+		chunk.dirty = false;
+		_chunks.push_back(std::move(chunk));
+	}
+
+	VoxelChunk& chunk = _chunks[found->second];
+	const glm::ivec3 local = position - chunk.origin();
+	VoxelBlock& stored = chunk.blocks[block_index(local)];
+	if (stored == block)
+	{
+		return;
+	}
+	chunk.solidCount += (block != VOXEL_AIR) - (stored != VOXEL_AIR);
+	stored = block;
+
+	// a block on the border shows or hides the face of its neighbour in the next chunk over
+	mark_dirty(coord);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		glm::ivec3 step(0);
+		step[axis] = 1;
+		if (local[axis] == 0)
+		{
+			mark_dirty(coord - step);
+		}
+		else if (local[axis] == VOXEL_CHUNK_SIZE - 1)
+		{
+			mark_dirty(coord + step);
+		}
+	}
+}
+
+void VoxelWorld::mark_dirty(const glm::ivec3& coord)
+{
+	auto found = _chunkIndex.find(chunk_key(coord));
+	if (found != _chunkIndex.end() && !_chunks[found->second].dirty)
+	{
+		_chunks[found->second].dirty = true;
+		_dirtyCount++;
+	}
+}
+
+uint32_t VoxelWorld::voxelize(const Mesh& mesh, VoxelBlock block)
+{
+	const MeshLod level = mesh.get_lod(0);
+	uint32_t used = 0;
+	for (uint32_t i = 0; i + 2 < level.indexCount; i += 3)
+	{
+		const glm::vec3& a = mesh._vertices[mesh._indices[level.firstIndex + i]].position;
+		const glm::vec3& b = mesh._vertices[mesh._indices[level.firstIndex + i + 1]].position;
+		const glm::vec3& c = mesh._vertices[mesh._indices[level.firstIndex + i + 2]].position;
+		const glm::vec3 normal = glm::cross(b - a, c - a);
+		const float length = glm::length(normal);
+		if (length <= 0.f)
+		{
+			continue;
+		}
+
+		int axis = 0;
+		for (int k = 1; k < 3; k++)
+		{
+			if (std::abs(normal[k]) > std::abs(normal[axis]))
+			{
+				axis = k;
+			}
+		}
+		if (std::abs(normal[axis]) < 0.99f * length)
+		{
+			continue;
+		}
+
+		// the face is on the block's surface, so half a block behind its center is inside the block
+		glm::vec3 inside = (a + b + c) / 3.f;
+		inside[axis] -= normal[axis] > 0.f ? 0.5f : -0.5f;
+		set(glm::ivec3(glm::floor(inside)), block);
+		used++;
+	}
+	return used;
+}
+
+bool VoxelWorld::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, glm::ivec3& hit, glm::ivec3& previous) const
+{
+	// Amanatides-Woo: step to whichever block boundary along the ray comes first
+	const glm::vec3 dir = glm::normalize(direction);
+	glm::ivec3 block(glm::floor(origin));
+	glm::ivec3 step;
+	glm::vec3 next;
+	glm::vec3 delta;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		step[axis] = dir[axis] > 0.f ? 1 : -1;
+		delta[axis] = dir[axis] != 0.f ? std::abs(1.f / dir[axis]) : INFINITY;
+		const float boundary = dir[axis] > 0.f ? block[axis] + 1.f - origin[axis] : origin[axis] - block[axis];
+		next[axis] = dir[axis] != 0.f ? boundary * delta[axis] : INFINITY;
+	}
+
+	previous = block;
+	float distance = 0.f;
+	while (distance <= maxDistance)
+	{
+		if (get(block) != VOXEL_AIR)
+		{
+			hit = block;
+			return true;
+		}
+		previous = block;
+		const int axis = next.x < next.y ? (next.x < next.z ? 0 : 2) : (next.y < next.z ? 1 : 2);
+		distance = next[axis];
+		next[axis] += delta[axis];
+		block[axis] += step[axis];
+	}
+	return false;
+}
+
+std::vector<uint32_t> VoxelWorld::remesh_dirty()
+{
+	std::vector<uint32_t> dirty;
+	for (uint32_t i = 0; i < _chunks.size(); i++)
+	{
+		if (_chunks[i].dirty)
+		{
+			dirty.push_back(i);
+		}
+	}
+	// chunks only read their neighbours' blocks, so every one meshes on its own worker
+	parallel_for(dirty.size(), [&](size_t i) {
+		mesh_chunk(_chunks[dirty[i]]);
+	});
+	for (uint32_t index : dirty)
+	{
+		_chunks[index].dirty = false;
+	}
+	_dirtyCount = 0;
+	return dirty;
+}
+
+void VoxelWorld::mesh_chunk(VoxelChunk& chunk) const
+{
+	Mesh mesh;
+	if (chunk.solidCount > 0)
+	{
+		const glm::ivec3 origin = chunk.origin();
+		auto block_at = [&](const glm::ivec3& local) {
+			const bool inside = local.x >= 0 && local.y >= 0 && local.z >= 0
+				&& local.x < VOXEL_CHUNK_SIZE && local.y < VOXEL_CHUNK_SIZE && local.z < VOXEL_CHUNK_SIZE;
+			return inside ? chunk.blocks[block_index(local)] : get(origin + local);
+		};
+
+		VoxelBlock mask[VOXEL_CHUNK_SIZE * VOXEL_CHUNK_SIZE];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			// u x v is the axis, so corners in u, then v order wind counter-clockwise seen from the + side
+			const int u = (axis + 1) % 3;
+			const int v = (axis + 2) % 3;
+			for (int side = 1; side >= -1; side -= 2)
+			{
+				glm::vec3 normal(0.f);
+				normal[axis] = static_cast<float>(side);
+				for (int slice = 0; slice < VOXEL_CHUNK_SIZE; slice++)
+				{
+					// the faces of this slice that look into air
+					for (int j = 0; j < VOXEL_CHUNK_SIZE; j++)
+					{
+						for (int i = 0; i < VOXEL_CHUNK_SIZE; i++)
+						{
+							glm::ivec3 local;
+							local[axis] = slice;
+							local[u] = i;
+							local[v] = j;
+							const VoxelBlock block = chunk.blocks[block_index(local)];
+							glm::ivec3 neighbour = local;
+							neighbour[axis] += side;
+							mask[i + j * VOXEL_CHUNK_SIZE] = block != VOXEL_AIR && block_at(neighbour) == VOXEL_AIR ? block : VOXEL_AIR;
+						}
+					}
+
+					// each unclaimed face grows along u, then along v while whole rows match
+					for (int j = 0; j < VOXEL_CHUNK_SIZE; j++)
+					{
+						for (int i = 0; i < VOXEL_CHUNK_SIZE;)
+						{
+							const VoxelBlock block = mask[i + j * VOXEL_CHUNK_SIZE];
+							if (block == VOXEL_AIR)
+							{
+								i++;
+								continue;
+							}
+							int width = 1;
+							while (i + width < VOXEL_CHUNK_SIZE && mask[i + width + j * VOXEL_CHUNK_SIZE] == block)
+							{
+								width++;
+							}
+							int height = 1;
+							for (; j + height < VOXEL_CHUNK_SIZE; height++)
+							{
+								bool rowMatches = true;
+								for (int k = 0; k < width && rowMatches; k++)
+								{
+									rowMatches = mask[i + k + (j + height) * VOXEL_CHUNK_SIZE] == block;
+								}
+								if (!rowMatches)
+								{
+									break;
+								}
+							}
+							for (int h = 0; h < height; h++)
+							{
+								std::fill_n(mask + i + (j + h) * VOXEL_CHUNK_SIZE, width, VOXEL_AIR);
+							}
+
+							glm::vec3 corner(0.f);
+							corner[axis] = static_cast<float>(slice + (side > 0 ? 1 : 0));
+							corner[u] = static_cast<float>(i);
+							corner[v] = static_cast<float>(j);
+							glm::vec3 du(0.f);
+							du[u] = static_cast<float>(width);
+							glm::vec3 dv(0.f);
+							dv[v] = static_cast<float>(height);
+
+							const uint32_t first = static_cast<uint32_t>(mesh._vertices.size());
+							const glm::vec3 corners[4] = { corner, corner + du, corner + du + dv, corner + dv };
+							for (const glm::vec3& position : corners)
+							{
+								Vertex vertex;
+								vertex.position = position;
+								vertex.normal = normal;
+								vertex.color = _palette[block];
+								mesh._vertices.push_back(vertex);
+							}
+							// the - side winds the other way round
+							if (side > 0)
+							{
+								mesh._indices.insert(mesh._indices.end(), { first, first + 1, first + 2, first, first + 2, first + 3 });
+							}
+							else
+							{
+								mesh._indices.insert(mesh._indices.end(), { first, first + 2, first + 1, first, first + 3, first + 2 });
+							}
+							i += width;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	if (!mesh._indices.empty())
+	{
+		mesh.update_index_type();
+		mesh.compute_bounds();
+		mesh.set_vertex_format(VertexFormat::Voxel);
+	}
+	chunk.mesh = std::move(mesh);
+}
+
+VoxelBlock add_block_type_for(VoxelWorld& world, const Mesh& part, const Texture* diffuse)
+{
+	const bool sampled = diffuse != nullptr && !diffuse->is_block_compressed() && !diffuse->_levels.empty()
+		&& part._texcoords.size() == part._vertices.size();
+	if (!sampled)
+	{
+		return world.add_block_type(glm::vec3(part._material.baseColor));
+	}
+
+	const TextureLevel& level = diffuse->_levels[0];
+	const MeshLod lod = part.get_lod(0);
+	glm::vec3 sum(0.f);
+	uint32_t samples = 0;
+	for (uint32_t i = 0; i + 2 < lod.indexCount; i += 3)
+	{
+		const uint32_t* triangle = part._indices.data() + lod.firstIndex + i;
+		glm::vec2 uv = (part._texcoords[triangle[0]] + part._texcoords[triangle[1]] + part._texcoords[triangle[2]]) / 3.f;
+		uv -= glm::floor(uv);
+		const uint32_t x = std::min(static_cast<uint32_t>(uv.x * level.width), level.width - 1);
+		const uint32_t y = std::min(static_cast<uint32_t>((1.f - uv.y) * level.height), level.height - 1);
+		const uint8_t* texel = diffuse->_pixels.data() + level.offset + (size_t(y) * level.width + x) * 4;
+		sum += glm::vec3(srgb_to_linear(texel[0]), srgb_to_linear(texel[1]), srgb_to_linear(texel[2]));
+		samples++;
+	}
+	const glm::vec3 color = samples > 0 ? sum / float(samples) : glm::vec3(1.f);
+	return world.add_block_type(color * glm::vec3(part._material.baseColor));
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <Mesh.h>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <glm/vec3.hpp>
+
+struct Texture;
+
+// blocks along each axis of a chunk; chunk-local corners run 0..32, which a byte holds
+constexpr int32_t VOXEL_CHUNK_SIZE = 32;
+
+// a palette index; 0 is air, which is never meshed
+using VoxelBlock = uint16_t;
+constexpr VoxelBlock VOXEL_AIR = 0;
+
+struct VoxelChunk {
+	glm::ivec3 coord; // in chunks; the first block is coord * VOXEL_CHUNK_SIZE
+	std::vector<VoxelBlock> blocks; // x fastest, then y, then z
+	uint32_t solidCount{ 0 };
+	bool dirty{ true };
+	// the greedy mesh of the last remesh in chunk-local block units, VertexFormat::Voxel; empty when every
+	// face is hidden. The engine moves it out to upload it
+	Mesh mesh;
+
+	glm::ivec3 origin() const { return coord * VOXEL_CHUNK_SIZE; }
+};
+
+// A block world in chunks of VOXEL_CHUNK_SIZE^3, meshed per chunk into greedy quads: the visible faces of each
+// slice merged into the largest rectangles of one block type, so a flat wall costs a quad instead of two
+// triangles per block. Edits only mark the chunks they touch (and the neighbours sharing a changed border)
+// dirty, and remesh_dirty rebuilds just those, a job each. Not thread-safe: edits and remeshing alternate.
+class VoxelWorld
+{
+public:
+	// a new block type drawn in color (linear); UINT16_MAX types at most
+	VoxelBlock add_block_type(const glm::vec3& color);
+	const glm::vec3& block_color(VoxelBlock block) const { return _palette[block]; }
+
+	// air outside every chunk
+	VoxelBlock get(const glm::ivec3& position) const;
+	void set(const glm::ivec3& position, VoxelBlock block);
+
+	// fills the block behind every axis-aligned triangle of mesh's level 0 with block, for geometry exported
+	// from a block world as triangles; the rest (plants, slopes) is left out. Returns the triangles used
+	uint32_t voxelize(const Mesh& mesh, VoxelBlock block);
+
+	// first solid block along the ray within maxDistance blocks, with the position of the air block in
+	// front of it in previous; false when none
+	bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, glm::ivec3& hit, glm::ivec3& previous) const;
+
+	bool has_dirty() const { return _dirtyCount > 0; }
+	// greedy meshes of every dirty chunk on the shared job system; returns the indices of the chunks
+	// remeshed, whose mesh is fresh
+	std::vector<uint32_t> remesh_dirty();
+
+	uint32_t chunk_count() const { return static_cast<uint32_t>(_chunks.size()); }
+	VoxelChunk& chunk(uint32_t index) { return _chunks[index]; }
+	const VoxelChunk& chunk(uint32_t index) const { return _chunks[index]; }
+
+private:
+	static uint64_t chunk_key(const glm::ivec3& coord);
+	const VoxelChunk* find_chunk(const glm::ivec3& coord) const;
+	void mark_dirty(const glm::ivec3& coord);
+	void mesh_chunk(VoxelChunk& chunk) const;
+
+	std::vector<glm::vec3> _palette{ glm::vec3(0.f) };
+	std::vector<VoxelChunk> _chunks;
+	std::unordered_map<uint64_t, uint32_t> _chunkIndex;
+	uint32_t _dirtyCount{ 0 };
+};
+
+// average of diffuse at the centers of part's triangles, by their UVs (v up, as OBJ writes them); the part's
+// base color without a texture or UVs. For picking a block type's color from the faces it was made of
+VoxelBlock add_block_type_for(VoxelWorld& world, const Mesh& part, const Texture* diffuse);
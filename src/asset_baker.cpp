@@ -0,0 +1,60 @@
+// Offline asset baking for deployment: imports every OBJ and image of the assets folder into the caches the
+// engine loads, on all cores, then packs them with the compiled shaders into the archive the engine maps at
+// startup. A machine that runs the engine from that archive never opens an OBJ or decodes a PNG; sources
+// whose caches are already up to date are only checked, so running it after every asset change is cheap.
+// Pipeline caches are left to the engine: they belong to one driver and device, not to the asset set.
+#include <AssetBaker.h>
+#include <Log.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace {
+	struct BakerSettings {
+		AssetBakeSettings bake;
+		std::string outputPath{ "../../assets.qcpak" };
+		bool pack{ true };
+	};
+
+	// --assets DIR, --shaders DIR, --output PATH, --compress-meshes, --no-pack, --pvs LEVEL.obj (any number of
+	// times), --pvs-cell SIZE, --impostors
+	BakerSettings parse_baker_args(int argc, char* argv[])
+	{
+		BakerSettings settings;
+		for (int i = 1; i < argc; i++)
+		{
+			const char* arg = argv[i];
+			const bool hasValue = i + 1 < argc;
+			if (strcmp(arg, "--assets") == 0 && hasValue) settings.bake.assetDir = argv[++i];
+			else if (strcmp(arg, "--shaders") == 0 && hasValue) settings.bake.shaderDir = argv[++i];
+			else if (strcmp(arg, "--output") == 0 && hasValue) settings.outputPath = argv[++i];
+			else if (strcmp(arg, "--compress-meshes") == 0) settings.bake.compressMeshes = true;
+			else if (strcmp(arg, "--no-pack") == 0) settings.pack = false;
+			else if (strcmp(arg, "--pvs") == 0 && hasValue) settings.bake.pvsLevels.push_back(argv[++i]);
+			else if (strcmp(arg, "--pvs-cell") == 0 && hasValue) settings.bake.pvs.cellSize = static_cast<float>(atof(argv[++i]));
+			else if (strcmp(arg, "--impostors") == 0) settings.bake.impostors = true;
+			else LOG_WARN("Unknown argument '" << arg << "' ignored.");
+		}
+		return settings;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const BakerSettings settings = parse_baker_args(argc, argv);
+
+	const AssetBakeStats stats = bake_assets(settings.bake);
+	LOG_INFO("Baked " << stats.assets - stats.failed << " of " << stats.assets << " assets in " << stats.ms << " ms");
+	if (stats.failed > 0)
+	{
+		// an archive missing some caches would send the engine back to the sources it was meant to replace
+		return 1;
+	}
+
+	if (settings.pack && !pack_baked_assets(settings.outputPath.c_str(), settings.bake))
+	{
+		return 1;
+	}
+	return 0;
+}
@@ -1,14 +1,1637 @@
 #include <vk_engine.h>
+#include <AssetBaker.h>
+#include <AssetCache.h>
+#include <GpuDispatcher.h>
+#include <Log.h>
+#include <RenderCluster.h>
 
-int main(int argc, char* argv[])
+#include <SDL.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// --present-mode fifo|fifo_relaxed|mailbox|immediate; the engine falls back if the surface lacks it
+static void parse_present_mode_arg(int argc, char* argv[], VkPresentModeKHR& mode)
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--present-mode") != 0) continue;
+
+		const char* name = argv[i + 1];
+		if (strcmp(name, "fifo") == 0) mode = VK_PRESENT_MODE_FIFO_KHR;
+		else if (strcmp(name, "fifo_relaxed") == 0) mode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+		else if (strcmp(name, "mailbox") == 0) mode = VK_PRESENT_MODE_MAILBOX_KHR;
+		else if (strcmp(name, "immediate") == 0) mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+		else LOG_WARN("Unknown present mode " << name << ", ignoring");
+	}
+}
+
+// --msaa 1|2|4|8; the engine lowers it to what the device supports
+static void parse_msaa_arg(int argc, char* argv[], VkSampleCountFlagBits& samples)
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--msaa") != 0) continue;
+
+		const int count = atoi(argv[i + 1]);
+		if (count == 1) samples = VK_SAMPLE_COUNT_1_BIT;
+		else if (count == 2) samples = VK_SAMPLE_COUNT_2_BIT;
+		else if (count == 4) samples = VK_SAMPLE_COUNT_4_BIT;
+		else if (count == 8) samples = VK_SAMPLE_COUNT_8_BIT;
+		else LOG_WARN("Unsupported MSAA sample count " << argv[i + 1] << ", ignoring");
+	}
+}
+
+// --cpu-trace path [--cpu-trace-frames N]: writes init() and the first N frames (300 by default) to path
+// as a Chrome trace
+static void parse_cpu_trace_args(int argc, char* argv[], std::string& path, uint32_t& frames)
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--cpu-trace") == 0) path = argv[i + 1];
+		else if (strcmp(argv[i], "--cpu-trace-frames") == 0) frames = static_cast<uint32_t>(atoi(argv[i + 1]));
+	}
+}
+
+// --hitch-ms X [--hitch-dir path] [--hitch-frames before after] [--hitch-max N]: writes a Chrome trace of the
+// frames around every frame slower than X ms to path (hitches/ by default), at most N (10) over the run
+static void parse_hitch_args(int argc, char* argv[], HitchRecorder::Settings& settings)
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--hitch-ms") == 0) settings.thresholdMs = std::max(0.0, atof(argv[i + 1]));
+		else if (strcmp(argv[i], "--hitch-dir") == 0) settings.directory = argv[i + 1];
+		else if (strcmp(argv[i], "--hitch-max") == 0) settings.maxTraces = static_cast<uint32_t>(atoi(argv[i + 1]));
+		else if (strcmp(argv[i], "--hitch-frames") == 0 && i + 2 < argc)
+		{
+			settings.framesBefore = static_cast<uint32_t>(std::max(1, atoi(argv[i + 1])));
+			settings.framesAfter = static_cast<uint32_t>(std::max(0, atoi(argv[i + 2])));
+		}
+	}
+}
+
+// --validation on|off: overrides the build's default of requesting the validation layer
+static void parse_validation_arg(int argc, char* argv[], bool& validation)
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--validation") != 0) continue;
+
+		const char* value = argv[i + 1];
+		if (strcmp(value, "on") == 0) validation = true;
+		else if (strcmp(value, "off") == 0) validation = false;
+		else LOG_WARN("Unknown validation setting " << value << ", ignoring");
+	}
+}
+
+// --log-level debug|info|warn|error|off: the least severe lines written, info by default
+static void parse_log_level_arg(int argc, char* argv[])
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--log-level") != 0) continue;
+
+		logging::Level level;
+		if (logging::parse_level(argv[i + 1], level)) logging::set_level(level);
+		else LOG_WARN("Unknown log level " << argv[i + 1] << ", ignoring");
+	}
+}
+
+// --async-compute: culls on a compute queue apart from graphics, where the GPU has one
+static void parse_async_compute_arg(int argc, char* argv[], bool& asyncCompute)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--async-compute") == 0) asyncCompute = true;
+	}
+}
+
+// --present-thread: acquires and presents swapchain images on a thread of their own
+static void parse_present_thread_arg(int argc, char* argv[], bool& presentThread)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--present-thread") == 0) presentThread = true;
+	}
+}
+
+// --display N: presents straight to the Nth display through VK_KHR_display, with no window, compositor or input;
+// --exclusive-fullscreen: a fullscreen window that takes its monitor through VK_EXT_full_screen_exclusive on Windows
+static void parse_display_args(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--exclusive-fullscreen") == 0) engine._useFullScreenExclusive = true;
+		else if (i + 1 >= argc) continue;
+		else if (strcmp(argv[i], "--display") == 0) engine._displayIndex = atoi(argv[i + 1]);
+	}
+}
+
+// --shader-stats: logs the driver's register, spill and instruction counts of every graphics pipeline, and shows them on the HUD
+static void parse_shader_stats_arg(int argc, char* argv[], bool& shaderStats)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--shader-stats") == 0) shaderStats = true;
+	}
+}
+
+// --debug-view lit|overdraw: what the frame shows at startup; F2 cycles it
+static void parse_debug_view_arg(int argc, char* argv[], DebugView& debugView)
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--debug-view") != 0)
+		{
+			continue;
+		}
+		const char* value = argv[i + 1];
+		if (strcmp(value, "lit") == 0) debugView = DebugView::Lit;
+		else if (strcmp(value, "overdraw") == 0) debugView = DebugView::Overdraw;
+		else LOG_WARN("Unknown debug view '" << value << "', showing the lit scene.");
+	}
+}
+
+// --render-path auto|cpu|indirect: how the render list is culled and drawn; auto picks the fastest the device runs
+static void parse_render_path_arg(int argc, char* argv[], RenderPath& renderPath)
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--render-path") != 0)
+		{
+			continue;
+		}
+		const char* value = argv[i + 1];
+		if (strcmp(value, "auto") == 0) renderPath = RenderPath::Auto;
+		else if (strcmp(value, "cpu") == 0) renderPath = RenderPath::Cpu;
+		else if (strcmp(value, "indirect") == 0) renderPath = RenderPath::Indirect;
+		else LOG_WARN("Unknown render path '" << value << "', picking the fastest.");
+	}
+}
+
+// --compress-meshes: mesh caches rebuilt from their OBJs are written compressed; existing caches are loaded either way
+static void parse_compress_meshes_arg(int argc, char* argv[], bool& compressMeshes)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--compress-meshes") == 0) compressMeshes = true;
+	}
+}
+
+// --no-read-ahead: the loader thread reads each asset only when it loads it
+static void parse_read_ahead_arg(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--no-read-ahead") == 0) engine._useReadAhead = false;
+	}
+}
+
+// --no-asset-reload: streamed meshes and textures stay as first loaded when their sources change
+static void parse_asset_reload_arg(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--no-asset-reload") == 0) engine._useAssetReload = false;
+	}
+}
+
+// --cpu-picking: a click is resolved by a ray cast against the objects' bounds rather than by the GPU's pick pass
+static void parse_cpu_picking_arg(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--cpu-picking") == 0) engine._useGpuPicking = false;
+	}
+}
+
+// --asset-cache dir: imports are cached in dir by the contents of their sources rather than next to them
+static void parse_asset_cache_arg(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--asset-cache") == 0) engine._assetCachePath = argv[i + 1];
+	}
+}
+
+// --reverse-z [--finite-far]: the camera maps the near plane to depth 1 and the far plane, at infinity
+// unless --finite-far, to 0, for precision at a distance
+static void parse_reverse_z_args(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--reverse-z") == 0) engine._reverseZ = true;
+		else if (strcmp(argv[i], "--finite-far") == 0) engine._finiteFarPlane = true;
+	}
+}
+
+// --cache-static-draws: the static objects' draws are recorded once into a secondary buffer per frame slot
+// and replayed until something they depend on changes
+static void parse_static_draw_cache_arg(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--cache-static-draws") == 0) engine._cacheStaticDraws = true;
+	}
+}
+
+// --sphere-culling: the CPU path culls against every object's bounding sphere in one SIMD sweep rather than
+// querying the BVH
+static void parse_sphere_culling_arg(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--sphere-culling") == 0) engine._sphereCulling = true;
+	}
+}
+
+// --cull-coherence D: the sphere sweep (implied) runs again only once the camera has moved the frustum planes
+// D world units, and in between reuses its results, testing just the spheres that were near a plane then
+static void parse_cull_coherence_arg(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--cull-coherence") == 0)
+		{
+			engine._cullCoherence = std::max(static_cast<float>(atof(argv[i + 1])), 0.0f);
+			engine._sphereCulling = engine._sphereCulling || engine._cullCoherence > 0.0f;
+		}
+	}
+}
+
+// --conditional-rendering [--predicate-triangles N]: the CPU path's draws of objects with N triangles or more
+// (10000 by default) are skipped on the GPU when their boxes' occlusion queries found them hidden last frame
+static void parse_conditional_rendering_args(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--conditional-rendering") == 0) engine._useConditionalRendering = true;
+		else if (i + 1 >= argc) continue;
+		else if (strcmp(argv[i], "--predicate-triangles") == 0) engine._predicateMinTriangles = static_cast<uint32_t>(atoi(argv[i + 1]));
+	}
+}
+
+// --impostors [--impostor-pixels N]: the CPU path draws streamed meshes past their coarsest level, once they
+// cover N pixels or fewer (64 by default), as billboards cut out of atlases baked from every side of them
+static void parse_impostor_args(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--impostors") == 0) engine._useImpostors = true;
+		else if (i + 1 >= argc) continue;
+		else if (strcmp(argv[i], "--impostor-pixels") == 0) engine._impostorPixels = static_cast<float>(atof(argv[i + 1]));
+	}
+}
+
+// --terrain [path.pgm] [--terrain-size X] [--terrain-height Y] [--terrain-tiles N]: a heightfield under the scene,
+// from a square binary PGM or generated, X world units across (256 by default) and Y high (8), drawn with
+// continuous LOD from N height tiles kept on the GPU (512) however large the heightfield
+static void parse_terrain_args(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--terrain") == 0)
+		{
+			engine._useTerrain = true;
+			if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0)
+			{
+				engine._terrainSettings.path = argv[i + 1];
+			}
+		}
+		else if (i + 1 >= argc) continue;
+		else if (strcmp(argv[i], "--terrain-size") == 0) engine._terrainSettings.size = static_cast<float>(atof(argv[i + 1]));
+		else if (strcmp(argv[i], "--terrain-height") == 0) engine._terrainSettings.height = static_cast<float>(atof(argv[i + 1]));
+		else if (strcmp(argv[i], "--terrain-tiles") == 0) engine._terrainSettings.cacheTiles = static_cast<uint32_t>(atoi(argv[i + 1]));
+	}
+}
+
+// --foliage [--foliage-density path.pgm] [--foliage-spacing X] [--foliage-distance Y]: grass scattered over the
+// terrain by a compute pass, a candidate every X world units (0.5 by default) out to Y (60), thinned by slope,
+// height and a square binary PGM stretched over the whole terrain; needs --terrain
+static void parse_foliage_args(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--foliage") == 0) engine._useFoliage = true;
+		else if (i + 1 >= argc) continue;
+		else if (strcmp(argv[i], "--foliage-density") == 0) engine._foliageSettings.densityPath = argv[i + 1];
+		else if (strcmp(argv[i], "--foliage-spacing") == 0) engine._foliageSettings.spacing = static_cast<float>(atof(argv[i + 1]));
+		else if (strcmp(argv[i], "--foliage-distance") == 0) engine._foliageSettings.distance = static_cast<float>(atof(argv[i + 1]));
+	}
+}
+
+// --stereo [--eye-separation X]: both eyes, X metres apart (0.064 by default), in one multiview pass, shown side
+// by side in the window
+static void parse_stereo_args(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--stereo") == 0) engine._useStereo = true;
+		else if (i + 1 >= argc) continue;
+		else if (strcmp(argv[i], "--eye-separation") == 0) engine._eyeSeparation = static_cast<float>(atof(argv[i + 1]));
+	}
+}
+
+// --views N [--view-height H]: N more cameras (up to 4) rendered every frame into targets H pixels high (216 by
+// default), culled in the main view's GPU dispatch and shown down the window's right edge
+static void parse_scene_view_args(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--views") == 0) engine._sceneViewCount = static_cast<uint32_t>(atoi(argv[i + 1]));
+		else if (strcmp(argv[i], "--view-height") == 0) engine._sceneViewHeight = static_cast<uint32_t>(atoi(argv[i + 1]));
+	}
+}
+
+// --metrics-port N: serves frame, GPU, memory and asset load metrics for Prometheus at http://host:N/metrics
+static void parse_metrics_arg(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--metrics-port") == 0) engine._metricsPort = static_cast<uint16_t>(atoi(argv[i + 1]));
+	}
+}
+
+// --background-fps N: holds frames to N a second while the window hasn't the input focus
+static void parse_background_fps_arg(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--background-fps") == 0) engine._backgroundFps = static_cast<uint32_t>(std::max(0, atoi(argv[i + 1])));
+	}
+}
+
+// --on-demand [--on-demand-poll-ms N]: draws only when something changed, and a frame every N ms (500) otherwise
+static void parse_on_demand_args(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--on-demand") == 0) engine._renderOnDemand = true;
+		else if (i + 1 >= argc) continue;
+		else if (strcmp(argv[i], "--on-demand-poll-ms") == 0) engine._onDemandPollMs = static_cast<uint32_t>(std::max(1, atoi(argv[i + 1])));
+	}
+}
+
+// --record-input PATH: writes the session's input and frame times there on exit, for --benchmark --replay PATH
+static void parse_record_input_arg(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--record-input") == 0) engine._inputRecordPath = argv[i + 1];
+	}
+}
+
+// --software-occlusion [--occluder-size X]: the CPU path also skips objects hidden behind the static meshes at
+// least X units across (8 by default), rasterized into a small depth buffer every frame
+static void parse_software_occlusion_args(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--software-occlusion") == 0) engine._useSoftwareOcclusion = true;
+		else if (i + 1 >= argc) continue;
+		else if (strcmp(argv[i], "--occluder-size") == 0) engine._occluderMinSize = static_cast<float>(atof(argv[i + 1]));
+	}
+}
+
+// --vertex-pulling: the mesh shaders read their vertices from the mesh pool's storage buffers, one pipeline for
+// every vertex format, instead of through the pipelines' vertex input
+static void parse_vertex_pulling_arg(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--vertex-pulling") == 0) engine._useVertexPulling = true;
+	}
+}
+
+// --no-fallback-pipelines: the first frame waits for the specialized mesh pipelines instead of drawing
+// with their generic builds until they've compiled
+static void parse_fallback_pipelines_arg(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--no-fallback-pipelines") == 0) engine._useFallbackPipelines = false;
+	}
+}
+
+// --no-static-batching: every static object keeps its own draw instead of being merged at load
+static void parse_static_batching_arg(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--no-static-batching") == 0) engine._staticBatching = false;
+	}
+}
+
+// --no-half-precision: the shaders with a half-precision build run their full-precision one on every device
+static void parse_half_precision_arg(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--no-half-precision") == 0) engine._useHalfPrecision = false;
+	}
+}
+
+// --no-rebar: per-frame data stays in the memory VMA picks for host writes and the lights are staged, even with a resizable BAR
+static void parse_rebar_arg(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--no-rebar") == 0) engine._useResizableBar = false;
+	}
+}
+
+// --upload-budget MiB: how much streamed data a frame stages for the transfer queue, 0 for no limit;
+// --staging-ring MiB: the persistent staging memory uploads share, 0 for a buffer per upload
+static void parse_upload_budget_args(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		const VkDeviceSize mib = static_cast<VkDeviceSize>(std::max(0, atoi(argv[i + 1])));
+		if (strcmp(argv[i], "--upload-budget") == 0) engine._uploadBytesPerFrame = mib * 1024 * 1024;
+		else if (strcmp(argv[i], "--staging-ring") == 0) engine._stagingRingSize = mib * 1024 * 1024;
+	}
+}
+
+// --frames-in-flight 2|3, --job-threads N (workers, 0 for one per core), --cull-chunk N (spheres per culling job):
+// like --msaa and --upload-budget, they keep their value over the GPU's calibrated one; --no-tuning leaves the
+// calibration out altogether, and --tuning-dir path keeps it somewhere else than tuning/
+static void parse_tuning_args(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--no-tuning") == 0) engine._useTuning = false;
+		else if (i + 1 >= argc) continue;
+		else if (strcmp(argv[i], "--tuning-dir") == 0) engine._tuningDirectory = argv[i + 1];
+		else if (strcmp(argv[i], "--msaa") == 0) engine._pinnedTuning |= TUNE_MSAA;
+		else if (strcmp(argv[i], "--upload-budget") == 0) engine._pinnedTuning |= TUNE_UPLOAD_BUDGET;
+		else if (strcmp(argv[i], "--frames-in-flight") == 0)
+		{
+			engine._frameOverlap = std::clamp(static_cast<uint32_t>(std::max(0, atoi(argv[i + 1]))), 2u, MAX_FRAME_OVERLAP);
+			engine._pinnedTuning |= TUNE_FRAME_OVERLAP;
+		}
+		else if (strcmp(argv[i], "--job-threads") == 0)
+		{
+			engine._jobThreadCount = static_cast<uint32_t>(std::max(0, atoi(argv[i + 1])));
+			engine._pinnedTuning |= TUNE_JOB_THREADS;
+		}
+		else if (strcmp(argv[i], "--cull-chunk") == 0)
+		{
+			engine._cullChunkSize = static_cast<uint32_t>(std::max(1, atoi(argv[i + 1])));
+			engine._pinnedTuning |= TUNE_CULL_CHUNK;
+		}
+	}
+}
+
+// --release-mesh-copies: meshes free their CPU-side vertices and indices once the GPU has them
+static void parse_release_mesh_copies_arg(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--release-mesh-copies") == 0) engine._releaseMeshCopies = true;
+	}
+}
+
+// --object-data push|uniform|storage|auto: how draws get their model matrix and material, push constants, a
+// dynamic uniform buffer offset or an index into a storage buffer; auto (the default) takes the fastest
+// path the draw_data benchmark scene recorded for this GPU, push constants until there is one
+static void parse_object_data_arg(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--object-data") != 0)
+		{
+			continue;
+		}
+		const char* value = argv[i + 1];
+		engine._objectDataAuto = false;
+		if (strcmp(value, "push") == 0) engine._objectDataPath = ObjectDataPath::PushConstants;
+		else if (strcmp(value, "uniform") == 0) engine._objectDataPath = ObjectDataPath::DynamicUniform;
+		else if (strcmp(value, "storage") == 0) engine._objectDataPath = ObjectDataPath::StorageBuffer;
+		else if (strcmp(value, "auto") == 0) engine._objectDataAuto = true;
+		else
+		{
+			LOG_WARN("Unknown object data path '" << value << "', choosing automatically.");
+			engine._objectDataAuto = true;
+		}
+	}
+}
+
+// --particles [--particle-count N]: a GPU-simulated spark fountain of up to N particles (2^20 by default)
+static void parse_particle_args(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--particles") == 0) engine._useParticles = true;
+		else if (i + 1 >= argc) continue;
+		else if (strcmp(argv[i], "--particle-count") == 0) engine._particleCapacity = static_cast<uint32_t>(atoi(argv[i + 1]));
+	}
+}
+
+// --transparent N [--transparency sorted|oit]: N glass monkeys behind the monkey, blended back to front after a
+// radix sort by depth (the default) or through weighted blended order-independent transparency
+static void parse_transparency_args(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--transparent") == 0) engine._transparentCount = static_cast<uint32_t>(atoi(argv[i + 1]));
+		else if (strcmp(argv[i], "--transparency") == 0)
+		{
+			if (strcmp(argv[i + 1], "oit") == 0) engine._transparencyMode = TransparencyMode::WeightedBlended;
+			else if (strcmp(argv[i + 1], "sorted") == 0) engine._transparencyMode = TransparencyMode::Sorted;
+			else LOG_WARN("Unknown transparency mode " << argv[i + 1] << ", ignoring");
+		}
+	}
+}
+
+// --lights [--light-count N]: N point lights (1024 by default, at most 4096) over the floor, shaded in clusters
+static void parse_light_args(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--lights") == 0) engine._useClusteredLights = true;
+		else if (i + 1 >= argc) continue;
+		else if (strcmp(argv[i], "--light-count") == 0) engine._lightCount = static_cast<uint32_t>(atoi(argv[i + 1]));
+	}
+}
+
+// --post [--exposure X] [--vignette X] [--no-bloom] [--no-tonemap] [--no-fxaa]: renders into an HDR target and
+// post-processes it into the swapchain image
+static void parse_post_args(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--post") == 0) engine._usePostProcess = true;
+		else if (strcmp(argv[i], "--no-bloom") == 0) engine._postSettings.bloom = false;
+		else if (strcmp(argv[i], "--no-tonemap") == 0) engine._postSettings.tonemap = false;
+		else if (strcmp(argv[i], "--no-fxaa") == 0) engine._postSettings.fxaa = false;
+		else if (i + 1 >= argc) continue;
+		else if (strcmp(argv[i], "--exposure") == 0) engine._postSettings.exposure = static_cast<float>(atof(argv[i + 1]));
+		else if (strcmp(argv[i], "--vignette") == 0) engine._postSettings.vignette = static_cast<float>(atof(argv[i + 1]));
+	}
+}
+
+// --vrs [--vrs-threshold X]: shades the low-detail materials coarser, and, where the device can attach a rate
+// image, the tiles of the scene whose contrast is below the threshold
+static void parse_vrs_args(int argc, char* argv[], VulkanEngine& engine)
 {
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--vrs") == 0) engine._useShadingRate = true;
+		else if (i + 1 >= argc) continue;
+		else if (strcmp(argv[i], "--vrs-threshold") == 0) engine._shadingRateImage._threshold = static_cast<float>(atof(argv[i + 1]));
+	}
+}
+
+// --taa [--taa-blend X]: starts with dynamic resolution on, upscaled temporally instead of blitted; X is the
+// share of each frame in the accumulated image
+static void parse_taa_args(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--taa") == 0)
+		{
+			engine._useTemporalUpscale = true;
+			engine._dynamicResolution = true;
+		}
+		else if (i + 1 >= argc) continue;
+		else if (strcmp(argv[i], "--taa-blend") == 0) engine._temporalUpscaler._blend = static_cast<float>(atof(argv[i + 1]));
+	}
+}
+
+// --rt-shadows [--rt-ao-rays N] [--rt-ao-radius X] [--rt-build-budget T]: traces the sun's shadows and N ambient
+// occlusion rays a pixel, reaching X world units, where the device has ray queries; T caps the triangles
+// whose acceleration structures are built per frame
+static void parse_ray_shadow_args(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--rt-shadows") == 0) engine._useRayShadows = true;
+		else if (i + 1 >= argc) continue;
+		else if (strcmp(argv[i], "--rt-ao-rays") == 0) engine._rayShadows._aoRays = static_cast<uint32_t>(atoi(argv[i + 1]));
+		else if (strcmp(argv[i], "--rt-ao-radius") == 0) engine._rayShadows._aoRadius = static_cast<float>(atof(argv[i + 1]));
+		else if (strcmp(argv[i], "--rt-build-budget") == 0) engine._accelerationStructures._trianglesPerFrame = static_cast<uint32_t>(atoi(argv[i + 1]));
+	}
+}
+
+// --characters N: N animated characters behind the monkey, skinned by a compute pass every frame
+static void parse_character_arg(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--characters") == 0) engine._characterCount = static_cast<uint32_t>(atoi(argv[i + 1]));
+	}
+}
+
+// --gltf path: adds the default scene of a .gltf or .glb file to the monkey's
+static void parse_gltf_arg(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--gltf") == 0) engine._gltfPath = argv[i + 1];
+	}
+}
+
+// --scene-snapshot path: the level is restored from path when it was written for the same --obj and --gltf
+// files, and written there after being built otherwise
+static void parse_scene_snapshot_arg(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--scene-snapshot") == 0) engine._sceneSnapshotPath = argv[i + 1];
+	}
+}
+
+// --obj path [--no-pvs]: streams an OBJ scene in at the origin, a mesh and a material per material of its .mtl.
+// The potentially visible sets asset_baker --pvs baked for it are used unless --no-pvs
+static void parse_obj_arg(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--no-pvs") == 0) engine._usePvs = false;
+		else if (i + 1 >= argc) continue;
+		else if (strcmp(argv[i], "--obj") == 0) engine._objScenePath = argv[i + 1];
+	}
+}
+
+// --voxel path: voxelizes an OBJ exported from a block world (lost_empire) into greedy-meshed chunks; V digs
+static void parse_voxel_arg(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--voxel") == 0) engine._voxelScenePath = argv[i + 1];
+	}
+}
+
+// --debug-draw bounds,bvh,cascades,lights: draws the named helpers as lines over the scene, any of them in any
+// order; ignored in builds without ENABLE_DEBUG_DRAW
+static void parse_debug_draw_arg(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--debug-draw") != 0) continue;
+		const char* names = argv[i + 1];
+		if (strstr(names, "bounds")) engine._debugDrawFlags |= VulkanEngine::DEBUG_DRAW_BOUNDS;
+		if (strstr(names, "bvh")) engine._debugDrawFlags |= VulkanEngine::DEBUG_DRAW_BVH;
+		if (strstr(names, "cascades")) engine._debugDrawFlags |= VulkanEngine::DEBUG_DRAW_CASCADES;
+		if (strstr(names, "lights")) engine._debugDrawFlags |= VulkanEngine::DEBUG_DRAW_LIGHTS;
+	}
+#ifndef ENABLE_DEBUG_DRAW
+	engine._debugDrawFlags = 0;
+#endif
+}
+
+// --text stats,labels [--text-font path.ttf] [--label-distance D]: draws the named text over the frame, any of
+// them in any order, from the TTF's distance atlas (baked next to it if it isn't yet) or imgui's built-in font
+static void parse_text_args(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--text") == 0)
+		{
+			const char* names = argv[i + 1];
+			if (strstr(names, "stats")) engine._textFlags |= VulkanEngine::TEXT_STATS;
+			if (strstr(names, "labels")) engine._textFlags |= VulkanEngine::TEXT_LABELS;
+		}
+		else if (strcmp(argv[i], "--text-font") == 0) engine._textFont = argv[i + 1];
+		else if (strcmp(argv[i], "--label-distance") == 0) engine._textLabelDistance = static_cast<float>(atof(argv[i + 1]));
+	}
+}
+
+// --headless [--headless-frames N] [--headless-images N] [--headless-capture path]: renders N frames (300 by
+// default) into a ring of offscreen images without opening a window, then writes the last one to path as a PPM
+static void parse_headless_args(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--headless") == 0) engine._headless = true;
+		else if (i + 1 >= argc) continue;
+		else if (strcmp(argv[i], "--headless-frames") == 0) engine._headlessFrames = static_cast<uint32_t>(atoi(argv[i + 1]));
+		else if (strcmp(argv[i], "--headless-images") == 0) engine._headlessImageCount = static_cast<uint32_t>(atoi(argv[i + 1]));
+		else if (strcmp(argv[i], "--headless-capture") == 0) engine._headlessCapturePath = argv[i + 1];
+	}
+}
+
+// --readback rgba|nv12: copies every frame back to host memory, converted to NV12 on the GPU if asked;
+// headless runs read back rgba unless told otherwise
+static void parse_readback_arg(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--readback") != 0) continue;
+
+		const char* format = argv[i + 1];
+		if (strcmp(format, "rgba") == 0) engine._readbackFormat = ReadbackFormat::Rgba;
+		else if (strcmp(format, "nv12") == 0) engine._readbackFormat = ReadbackFormat::Nv12;
+		else
+		{
+			LOG_WARN("Unknown readback format " << format << ", ignoring");
+			continue;
+		}
+		engine._useReadback = true;
+	}
+}
+
+// --encode path [--encode-gop N] [--encode-qp N]: encodes every frame to H.264 on the GPU and writes the
+// stream to path, an IDR frame every N frames (60 by default); needs a device with Vulkan Video encode
+static void parse_encode_args(int argc, char* argv[], VulkanEngine& engine)
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--encode") == 0)
+		{
+			engine._encodePath = argv[i + 1];
+			engine._useVideoEncode = true;
+		}
+		else if (strcmp(argv[i], "--encode-gop") == 0) engine._encodeSettings.gopLength = static_cast<uint32_t>(atoi(argv[i + 1]));
+		else if (strcmp(argv[i], "--encode-qp") == 0) engine._encodeSettings.qp = atoi(argv[i + 1]);
+	}
+}
+
+// --gpu N | --gpu-uuid HEX | --prefer-gpu discrete|integrated: which device the engine renders on, by its
+// index in the loader's order, its UUID, or its type; vk-bootstrap's pick otherwise
+static void parse_gpu_args(int argc, char* argv[], GpuSelection& selection)
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--gpu") == 0) selection.index = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--gpu-uuid") == 0) selection.uuid = argv[i + 1];
+		else if (strcmp(argv[i], "--prefer-gpu") == 0)
+		{
+			const char* type = argv[i + 1];
+			if (strcmp(type, "discrete") == 0) selection.preference = GpuPreference::Discrete;
+			else if (strcmp(type, "integrated") == 0) selection.preference = GpuPreference::Integrated;
+			else LOG_WARN("Unknown GPU type " << type << ", ignoring");
+		}
+	}
+}
+
+// --gpus 0,1,...|all [--render-jobs N]: renders N headless jobs (8 by default) of --headless-frames frames
+// each, spread over one engine per listed GPU; a GPU listed twice runs two sessions on one device
+static bool parse_dispatch_args(int argc, char* argv[], std::vector<GpuSelection>& gpus, uint32_t& jobs)
+{
+	bool dispatch = false;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--render-jobs") == 0) jobs = static_cast<uint32_t>(atoi(argv[i + 1]));
+		else if (strcmp(argv[i], "--gpus") == 0)
+		{
+			dispatch = true;
+			const std::string list = argv[i + 1];
+			if (list == "all")
+			{
+				const uint32_t count = GpuDispatcher::physical_device_count();
+				for (uint32_t gpu = 0; gpu < count; gpu++)
+				{
+					GpuSelection selection;
+					selection.index = static_cast<int>(gpu);
+					gpus.push_back(selection);
+				}
+				continue;
+			}
+			size_t start = 0;
+			while (start < list.size())
+			{
+				size_t end = list.find(',', start);
+				if (end == std::string::npos) end = list.size();
+				GpuSelection selection;
+				selection.index = atoi(list.substr(start, end - start).c_str());
+				gpus.push_back(selection);
+				start = end + 1;
+			}
+		}
+	}
+	return dispatch;
+}
+
+// --tiled-render W H path [--tile-size N]: renders one W x H still headless, as tiles of at most N pixels a
+// side (4096 by default), into path as a binary PPM; with --gpus, the rows of tiles are spread over the GPUs
+struct TiledRenderArgs {
+	uint32_t width{ 0 };
+	uint32_t height{ 0 };
+	std::string path;
+	uint32_t tileSize{ 4096 };
+};
+
+static bool parse_tiled_render_args(int argc, char* argv[], TiledRenderArgs& args)
+{
+	bool tiled = false;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--tile-size") == 0) args.tileSize = static_cast<uint32_t>(std::max(atoi(argv[i + 1]), 1));
+		else if (strcmp(argv[i], "--tiled-render") == 0 && i + 3 < argc)
+		{
+			args.width = static_cast<uint32_t>(std::max(atoi(argv[i + 1]), 1));
+			args.height = static_cast<uint32_t>(std::max(atoi(argv[i + 2]), 1));
+			args.path = argv[i + 3];
+			tiled = true;
+		}
+	}
+	return tiled;
+}
+
+// --render-frames N path [--frame-size W H]: renders the first N frames of the --camera path headless at W x H
+// (1920 x 1080 by default) and writes them to path as one H.264 stream; needs a device with Vulkan Video encode
+struct FrameRenderArgs {
+	uint32_t frames{ 0 };
+	std::string path;
+	uint32_t width{ 1920 };
+	uint32_t height{ 1080 };
+};
+
+static bool parse_frame_render_args(int argc, char* argv[], FrameRenderArgs& args)
+{
+	bool frames = false;
+	for (int i = 1; i + 2 < argc; i++)
+	{
+		if (strcmp(argv[i], "--render-frames") == 0)
+		{
+			args.frames = static_cast<uint32_t>(std::max(atoi(argv[i + 1]), 1));
+			args.path = argv[i + 2];
+			frames = true;
+		}
+		else if (strcmp(argv[i], "--frame-size") == 0)
+		{
+			args.width = static_cast<uint32_t>(std::max(atoi(argv[i + 1]), 16));
+			args.height = static_cast<uint32_t>(std::max(atoi(argv[i + 2]), 16));
+		}
+	}
+	return frames;
+}
+
+// --render-nodes host:port,... [--frames-per-job N] [--stop-nodes]: --tiled-render and --render-frames ship their
+// batch to render nodes (--render-node) on other machines instead of rendering here, a row of tiles or N frames
+// (60 by default) a job. Only the --scene-snapshot path, the --camera path and what to render of it go out, so
+// every node needs the snapshot's sources at the same paths; --stop-nodes has the nodes exit once done
+struct ClusterArgs {
+	std::vector<std::string> nodes;
+	uint32_t framesPerJob{ 60 };
+	bool stopNodes{ false };
+};
+
+static bool parse_render_nodes_args(int argc, char* argv[], ClusterArgs& args)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--stop-nodes") == 0) args.stopNodes = true;
+		else if (i + 1 >= argc) continue;
+		else if (strcmp(argv[i], "--frames-per-job") == 0) args.framesPerJob = static_cast<uint32_t>(std::max(atoi(argv[i + 1]), 1));
+		else if (strcmp(argv[i], "--render-nodes") == 0)
+		{
+			const std::string list = argv[i + 1];
+			size_t start = 0;
+			while (start < list.size())
+			{
+				size_t end = list.find(',', start);
+				if (end == std::string::npos) end = list.size();
+				if (end > start) args.nodes.push_back(list.substr(start, end - start));
+				start = end + 1;
+			}
+		}
+	}
+	return !args.nodes.empty();
+}
+
+// --render-node PORT: renders the jobs of coordinators (--render-nodes) connecting on PORT, one after another,
+// until one of them stops the node; the engine is headless and configured by the rest of this command line
+static bool parse_render_node_arg(int argc, char* argv[], uint16_t& port)
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--render-node") == 0)
+		{
+			port = static_cast<uint16_t>(atoi(argv[i + 1]));
+			return true;
+		}
+	}
+	return false;
+}
+
+static int dispatch_render_jobs(int argc, char* argv[], const std::vector<GpuSelection>& gpus, uint32_t jobs)
+{
+	if (gpus.empty())
+	{
+		LOG_WARN("No GPUs to dispatch render jobs to");
+		return 1;
+	}
+
+	GpuDispatcher dispatcher;
+	dispatcher.start(gpus, [argc, argv](VulkanEngine& engine, uint32_t) {
+		// the same settings for every engine; the dispatcher already chose its GPU
+		parse_msaa_arg(argc, argv, engine._msaaSamples);
+		parse_validation_arg(argc, argv, engine._useValidationLayers);
+		parse_headless_args(argc, argv, engine);
+		parse_readback_arg(argc, argv, engine);
+	});
+
+	// each job renders as many frames as a plain headless run would
+	uint32_t frames = 300;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--headless-frames") == 0) frames = static_cast<uint32_t>(atoi(argv[i + 1]));
+	}
+
+	for (uint32_t job = 0; job < jobs; job++)
+	{
+		dispatcher.submit([job, frames](VulkanEngine& engine, uint32_t gpu) {
+			const auto start = std::chrono::steady_clock::now();
+			engine.run_frames(frames);
+			const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			LOG_INFO("Render job " << job << " on GPU " << gpu << ": " << ms << " ms");
+		});
+	}
+	dispatcher.finish();
+	return 0;
+}
+
+// --pack-assets path: writes path as an archive of the compiled shaders and the asset caches and images
+// a previous run left next to the sources, then exits without starting the engine
+static bool parse_pack_assets_arg(int argc, char* argv[], std::string& archivePath)
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--pack-assets") == 0)
+		{
+			archivePath = argv[i + 1];
+			return true;
+		}
+	}
+	return false;
+}
+
+static int pack_assets(const std::string& archivePath)
+{
+	return pack_baked_assets(archivePath.c_str(), AssetBakeSettings()) ? 0 : 1;
+}
+
+// --bake-assets dir [--compress-meshes]: imports every OBJ and image of the assets folder into the asset cache
+// at dir, then exits without starting the engine; sources whose contents and dependencies haven't changed
+// since the last bake are skipped. Shaders are left to the build, which already recompiles only what changed
+static bool parse_bake_assets_arg(int argc, char* argv[], std::string& cachePath)
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--bake-assets") == 0)
+		{
+			cachePath = argv[i + 1];
+			return true;
+		}
+	}
+	return false;
+}
+
+static int bake_assets(const std::string& cachePath, bool compressMeshes)
+{
+	AssetCache cache;
+	if (!cache.open(cachePath))
+	{
+		return 1;
+	}
+
+	AssetBakeSettings settings;
+	settings.compressMeshes = compressMeshes;
+	settings.cache = &cache;
+	const AssetBakeStats stats = bake_assets(settings);
+	LOG_INFO("Baked " << stats.assets - stats.failed << " assets in " << stats.ms << " ms: " << cache.hits() << " up to date, "
+		<< cache.misses() << " imported");
+	cache.close();
+	return stats.failed == 0 ? 0 : 1;
+}
+
+// every setting the command line gives a full engine, applied before init(); run again for the engine that
+// replaces one whose device was lost
+static void configure_engine(int argc, char* argv[], VulkanEngine& engine)
+{
+	engine._benchmark = parse_benchmark_args(argc, argv);
+	parse_present_mode_arg(argc, argv, engine._presentMode);
+	parse_present_thread_arg(argc, argv, engine._usePresentThread);
+	parse_display_args(argc, argv, engine);
+	parse_shader_stats_arg(argc, argv, engine._captureShaderStatistics);
+	parse_debug_view_arg(argc, argv, engine._debugView);
+	parse_render_path_arg(argc, argv, engine._renderPath);
+	parse_msaa_arg(argc, argv, engine._msaaSamples);
+	parse_cpu_trace_args(argc, argv, engine._cpuTracePath, engine._cpuTraceFrames);
+	parse_hitch_args(argc, argv, engine._hitchSettings);
+	parse_validation_arg(argc, argv, engine._useValidationLayers);
+	parse_headless_args(argc, argv, engine);
+	parse_readback_arg(argc, argv, engine);
+	parse_encode_args(argc, argv, engine);
+	parse_gpu_args(argc, argv, engine._gpuSelection);
+	parse_async_compute_arg(argc, argv, engine._useAsyncCompute);
+	parse_compress_meshes_arg(argc, argv, engine._compressMeshCaches);
+	parse_asset_cache_arg(argc, argv, engine);
+	parse_read_ahead_arg(argc, argv, engine);
+	parse_asset_reload_arg(argc, argv, engine);
+	parse_cpu_picking_arg(argc, argv, engine);
+	parse_release_mesh_copies_arg(argc, argv, engine);
+	parse_static_batching_arg(argc, argv, engine);
+	parse_half_precision_arg(argc, argv, engine);
+	parse_rebar_arg(argc, argv, engine);
+	parse_upload_budget_args(argc, argv, engine);
+	parse_tuning_args(argc, argv, engine);
+	parse_vertex_pulling_arg(argc, argv, engine);
+	parse_fallback_pipelines_arg(argc, argv, engine);
+	parse_reverse_z_args(argc, argv, engine);
+	parse_static_draw_cache_arg(argc, argv, engine);
+	parse_sphere_culling_arg(argc, argv, engine);
+	parse_cull_coherence_arg(argc, argv, engine);
+	parse_software_occlusion_args(argc, argv, engine);
+	parse_conditional_rendering_args(argc, argv, engine);
+	parse_impostor_args(argc, argv, engine);
+	parse_terrain_args(argc, argv, engine);
+	parse_foliage_args(argc, argv, engine);
+	parse_stereo_args(argc, argv, engine);
+	parse_scene_view_args(argc, argv, engine);
+	parse_metrics_arg(argc, argv, engine);
+	parse_background_fps_arg(argc, argv, engine);
+	parse_on_demand_args(argc, argv, engine);
+	parse_record_input_arg(argc, argv, engine);
+	parse_object_data_arg(argc, argv, engine);
+	parse_particle_args(argc, argv, engine);
+	parse_transparency_args(argc, argv, engine);
+	parse_light_args(argc, argv, engine);
+	parse_post_args(argc, argv, engine);
+	parse_vrs_args(argc, argv, engine);
+	parse_taa_args(argc, argv, engine);
+	parse_ray_shadow_args(argc, argv, engine);
+	parse_character_arg(argc, argv, engine);
+	parse_gltf_arg(argc, argv, engine);
+	parse_scene_snapshot_arg(argc, argv, engine);
+	parse_obj_arg(argc, argv, engine);
+	parse_voxel_arg(argc, argv, engine);
+	parse_debug_draw_arg(argc, argv, engine);
+	parse_text_args(argc, argv, engine);
+}
+
+static int render_tiled(int argc, char* argv[], const TiledRenderArgs& args, const std::vector<GpuSelection>& gpus)
+{
+	const TileGrid grid = TileGrid::cover(args.width, args.height, args.tileSize);
+	TiledImageWriter writer;
+	if (!writer.open(args.path, grid))
+	{
+		LOG_ERROR("Could not create " << args.path);
+		return 1;
+	}
+	LOG_INFO("Rendering " << args.width << "x" << args.height << " as " << grid.columns << " by " << grid.rows << " tiles of "
+		<< grid.tileWidth << "x" << grid.tileHeight);
+	const auto start = std::chrono::steady_clock::now();
+
+	// every engine gets the whole command line, so they all build the same scene and view
+	if (gpus.empty())
+	{
+		VulkanEngine engine;
+		configure_engine(argc, argv, engine);
+		engine._tileGrid = grid;
+		if (!engine.init())
+		{
+			return 1;
+		}
+		engine.render_tiles(writer, 0, grid.count());
+		engine.cleanup();
+	}
+	else
+	{
+		GpuDispatcher dispatcher;
+		dispatcher.start(gpus, [argc, argv, grid](VulkanEngine& engine, uint32_t) {
+			configure_engine(argc, argv, engine);
+			engine._tileGrid = grid;
+		});
+		for (uint32_t row = 0; row < grid.rows; row++)
+		{
+			dispatcher.submit([&writer, grid, row](VulkanEngine& engine, uint32_t gpu) {
+				engine.render_tiles(writer, row * grid.columns, grid.columns);
+				LOG_INFO("Tile row " << row << " rendered on GPU " << gpu);
+			});
+		}
+		dispatcher.finish();
+	}
+
+	const bool complete = writer.close();
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (complete)
+	{
+		LOG_INFO("Wrote " << args.path << " in " << seconds << " s");
+	}
+	return complete ? 0 : 1;
+}
+
+// the snapshot the render nodes load, by its path on them
+static std::string scene_snapshot_path(int argc, char* argv[])
+{
+	std::string path;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--scene-snapshot") == 0) path = argv[i + 1];
+	}
+	return path;
+}
+
+static int render_tiled_on_nodes(int argc, char* argv[], const TiledRenderArgs& args, const ClusterArgs& cluster)
+{
+	const TileGrid grid = TileGrid::cover(args.width, args.height, args.tileSize);
+	RenderCoordinator coordinator;
+	if (!coordinator.connect(cluster.nodes))
+	{
+		LOG_ERROR("No render node answered");
+		return 1;
+	}
+	TiledImageWriter writer;
+	if (!writer.open(args.path, grid))
+	{
+		LOG_ERROR("Could not create " << args.path);
+		return 1;
+	}
+	LOG_INFO("Rendering " << args.width << "x" << args.height << " as " << grid.columns << " by " << grid.rows << " tiles of "
+		<< grid.tileWidth << "x" << grid.tileHeight << " on " << coordinator.node_count() << " nodes");
+	const auto start = std::chrono::steady_clock::now();
+
+	RenderJob job;
+	job.kind = RenderJobKind::Tiles;
+	job.scene = scene_snapshot_path(argc, argv);
+	job.camera = parse_benchmark_args(argc, argv).cameraPath;
+	job.width = args.width;
+	job.height = args.height;
+	job.tileSize = args.tileSize;
+	job.count = grid.columns;
+	for (uint32_t row = 0; row < grid.rows; row++)
+	{
+		job.id = row;
+		job.first = row * grid.columns;
+		coordinator.submit(job);
+	}
+	coordinator.run([&writer, grid](const RenderJob& job, RenderJobResult& result) {
+		for (const RenderPart& part : result.parts)
+		{
+			FrameReadback::Result readback = {};
+			readback.format = ReadbackFormat::Rgba;
+			readback.imageFormat = static_cast<VkFormat>(part.imageFormat);
+			readback.extent = { part.width, part.height };
+			readback.data = part.data.data();
+			readback.size = part.data.size();
+			if (part.data.size() != static_cast<size_t>(part.width) * part.height * 4
+				|| !writer.write_tile(readback, part.index % grid.columns, part.index / grid.columns))
+			{
+				result.ok = false;
+				result.error = "tile " + std::to_string(part.index) + " doesn't fit the grid";
+				return;
+			}
+		}
+		LOG_INFO("Tile row " << job.id << " rendered");
+	});
+	if (cluster.stopNodes)
+	{
+		coordinator.stop_nodes();
+	}
+	coordinator.close();
+
+	const bool complete = writer.close();
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (complete)
+	{
+		LOG_INFO("Wrote " << args.path << " in " << seconds << " s");
+	}
+	return complete ? 0 : 1;
+}
+
+static int render_frames(int argc, char* argv[], const FrameRenderArgs& args)
+{
+	std::ofstream file(args.path, std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		LOG_ERROR("Could not create " << args.path);
+		return 1;
+	}
 	VulkanEngine engine;
+	configure_engine(argc, argv, engine);
+	engine._headless = true;
+	engine._windowExtent = { args.width, args.height };
+	engine._useVideoEncode = true;
+	engine._encodePath.clear();
+	if (!engine.init())
+	{
+		return 1;
+	}
+	const auto start = std::chrono::steady_clock::now();
+	const bool rendered = engine.render_frames(0, args.frames, [&file](const VideoEncoder::Packet& packet) {
+		file.write(reinterpret_cast<const char*>(packet.data), static_cast<std::streamsize>(packet.size));
+	});
+	engine.cleanup();
+	if (!rendered)
+	{
+		LOG_ERROR("No H.264 encoder to render frames with");
+		return 1;
+	}
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	LOG_INFO("Wrote " << args.frames << " frames to " << args.path << " in " << seconds << " s");
+	return file.good() ? 0 : 1;
+}
+
+static int render_frames_on_nodes(int argc, char* argv[], const FrameRenderArgs& args, const ClusterArgs& cluster)
+{
+	RenderCoordinator coordinator;
+	if (!coordinator.connect(cluster.nodes))
+	{
+		LOG_ERROR("No render node answered");
+		return 1;
+	}
+	std::ofstream file(args.path, std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		LOG_ERROR("Could not create " << args.path);
+		return 1;
+	}
+	LOG_INFO("Rendering " << args.frames << " frames of " << args.width << "x" << args.height << " on " << coordinator.node_count()
+		<< " nodes, " << cluster.framesPerJob << " a job");
+	const auto start = std::chrono::steady_clock::now();
+
+	RenderJob job;
+	job.kind = RenderJobKind::Frames;
+	job.scene = scene_snapshot_path(argc, argv);
+	job.camera = parse_benchmark_args(argc, argv).cameraPath;
+	job.width = args.width;
+	job.height = args.height;
+	for (uint32_t first = 0; first < args.frames; first += cluster.framesPerJob)
+	{
+		job.id = first / cluster.framesPerJob;
+		job.tick = first;
+		job.count = std::min(cluster.framesPerJob, args.frames - first);
+		coordinator.submit(job);
+	}
+
+	// every job's stream starts with a key frame, so they join end to end; the ones that finish early wait
+	// here for the ones before them
+	std::mutex fileMutex;
+	std::map<uint32_t, std::vector<RenderPart>> finished;
+	uint32_t nextJob = 0;
+	coordinator.run([&](const RenderJob& job, RenderJobResult& result) {
+		if (result.parts.size() != job.count || !result.parts[0].keyFrame)
+		{
+			result.ok = false;
+			result.error = "not a stream of the job's frames";
+			return;
+		}
+		std::lock_guard<std::mutex> lock(fileMutex);
+		finished[job.id] = std::move(result.parts);
+		for (auto next = finished.find(nextJob); next != finished.end(); next = finished.find(++nextJob))
+		{
+			for (const RenderPart& part : next->second)
+			{
+				file.write(reinterpret_cast<const char*>(part.data.data()), static_cast<std::streamsize>(part.data.size()));
+			}
+			finished.erase(next);
+		}
+	});
+	if (cluster.stopNodes)
+	{
+		coordinator.stop_nodes();
+	}
+	coordinator.close();
+
+	const uint32_t jobs = (args.frames + cluster.framesPerJob - 1) / cluster.framesPerJob;
+	const bool complete = nextJob == jobs && file.good();
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (complete)
+	{
+		LOG_INFO("Wrote " << args.frames << " frames to " << args.path << " in " << seconds << " s");
+	}
+	else
+	{
+		LOG_ERROR(args.path << ": " << nextJob << " of " << jobs << " jobs written");
+	}
+	return complete ? 0 : 1;
+}
+
+// a node's engine is kept from job to job of one scene and size, and started again for a job of another
+static bool same_render_setup(const RenderJob& job, const RenderJob& previous)
+{
+	return job.kind == previous.kind && job.scene == previous.scene && job.width == previous.width && job.height == previous.height
+		&& job.tileSize == previous.tileSize;
+}
+
+static int serve_render_node(int argc, char* argv[], uint16_t port)
+{
+	RenderNode node;
+	if (!node.listen(port))
+	{
+		return 1;
+	}
 
-	engine.init();	
-	
-	engine.run();	
+	std::unique_ptr<VulkanEngine> engine;
+	RenderJob setup;
+	node.serve([&](const RenderJob& job) {
+		RenderJobResult result;
+		if (engine && !same_render_setup(job, setup))
+		{
+			engine->cleanup();
+			engine.reset();
+		}
+		if (!engine)
+		{
+			engine = std::make_unique<VulkanEngine>();
+			configure_engine(argc, argv, *engine);
+			engine->_headless = true;
+			engine->_headlessCapturePath.clear();
+			engine->_encodePath.clear();
+			engine->_sceneSnapshotPath = job.scene;
+			if (job.kind == RenderJobKind::Tiles)
+			{
+				engine->_tileGrid = TileGrid::cover(job.width, job.height, job.tileSize);
+			}
+			else
+			{
+				engine->_windowExtent = { job.width, job.height };
+				engine->_useVideoEncode = true;
+			}
+			if (!engine->init())
+			{
+				engine.reset();
+				result.error = "the engine didn't start";
+				return result;
+			}
+			setup = job;
+		}
 
-	engine.cleanup();	
+		engine->_benchmark.cameraPath = job.camera;
+		engine->seek_simulation(job.tick);
+		uint32_t expected = job.count;
+		if (job.kind == RenderJobKind::Tiles)
+		{
+			const uint32_t tiles = engine->_tileGrid.count();
+			expected = job.first < tiles ? std::min(job.count, tiles - job.first) : 0;
+			engine->render_tiles(job.first, job.count, [&result](const FrameReadback::Result& readback, uint32_t tile) {
+				RenderPart part;
+				part.index = tile;
+				part.imageFormat = static_cast<uint32_t>(readback.imageFormat);
+				part.width = readback.extent.width;
+				part.height = readback.extent.height;
+				part.data.assign(readback.data, readback.data + readback.size);
+				result.parts.push_back(std::move(part));
+			});
+		}
+		else if (!engine->render_frames(job.tick, job.count, [&result](const VideoEncoder::Packet& packet) {
+				RenderPart part;
+				part.index = static_cast<uint32_t>(result.parts.size());
+				part.keyFrame = packet.keyFrame;
+				part.data.assign(packet.data, packet.data + packet.size);
+				result.parts.push_back(std::move(part));
+			}) && !engine->device_lost())
+		{
+			result.error = "no H.264 encoder on this node";
+			return result;
+		}
 
+		if (engine->device_lost())
+		{
+			// the next job starts a new engine, on a new device
+			engine->cleanup();
+			engine.reset();
+			result.error = "device lost";
+			return result;
+		}
+		result.ok = result.parts.size() == expected;
+		if (!result.ok)
+		{
+			result.error = std::to_string(result.parts.size()) + " of " + std::to_string(expected) + " parts rendered";
+		}
+		return result;
+	});
+	if (engine)
+	{
+		engine->cleanup();
+	}
+	node.close();
 	return 0;
 }
+
+// engines started after device losses before main gives up
+constexpr uint32_t MAX_DEVICE_RECOVERIES = 3;
+
+// --calibrate measures the GPU's tuned settings again before the session, --no-calibrate never measures them.
+// Otherwise an interactive session on a GPU without a tuning is calibrated first
+static void parse_calibrate_args(int argc, char* argv[], bool& force, bool& never)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--calibrate") == 0) force = true;
+		else if (strcmp(argv[i], "--no-calibrate") == 0) never = true;
+	}
+}
+
+// measured frames of a calibration run, after the warmup; short, since every candidate is a run of its own
+constexpr uint32_t CALIBRATION_FRAMES = 240;
+constexpr uint32_t CALIBRATION_WARMUP_FRAMES = 30;
+
+// the refresh interval of the display the session shows on, which MSAA has to fit in
+static double frame_budget_ms(const VulkanEngine& engine, SDL_Window* window)
+{
+	SDL_DisplayMode mode;
+	if (window != nullptr && SDL_GetWindowDisplayMode(window, &mode) == 0 && mode.refresh_rate > 0)
+	{
+		return 1000.0 / mode.refresh_rate;
+	}
+	if (engine._directDisplay.refresh_millihertz() > 0)
+	{
+		return 1000.0 * 1000.0 / engine._directDisplay.refresh_millihertz();
+	}
+	return 1000.0 / 60.0;
+}
+
+// one candidate of a calibration: the session the command line asks for, as a short benchmark of settings that
+// writes nothing out; false when the engine doesn't start
+static bool measure_settings(int argc, char* argv[], const TunedSettings& settings, SDL_Window*& window, BenchmarkResult& result)
+{
+	VulkanEngine engine;
+	configure_engine(argc, argv, engine);
+	engine._window = window;
+	engine._benchmark = BenchmarkSettings{};
+	engine._benchmark.enabled = true;
+	engine._benchmark.frameCount = CALIBRATION_FRAMES;
+	engine._benchmark.warmupFrames = CALIBRATION_WARMUP_FRAMES;
+	engine._benchmark.outputPath.clear();
+	engine._cpuTracePath.clear();
+	engine._hitchSettings.thresholdMs = 0.0;
+	engine._inputRecordPath.clear();
+	engine._metricsPort = 0;
+	engine._useVideoEncode = false;
+
+	engine._useTuning = false;
+	engine._frameOverlap = settings.frameOverlap;
+	engine._jobThreadCount = settings.jobThreads;
+	engine._cullChunkSize = settings.cullChunkSize;
+	engine._uploadBytesPerFrame = settings.uploadBytesPerFrame;
+	engine._msaaSamples = settings.msaaSamples;
+	if (!engine.init())
+	{
+		// which took the window with it
+		window = nullptr;
+		return false;
+	}
+	engine.run_benchmark();
+	result = engine._benchmarkResult;
+	window = engine.release_window();
+	engine.cleanup();
+	return true;
+}
+
+// measures the candidates an AutoTuner picks one after the other, in engine's window, and writes the best to the
+// tuning file of engine's GPU; engine has just started, and is cleaned up first. False when a run didn't finish
+static bool calibrate(int argc, char* argv[], VulkanEngine& engine, SDL_Window*& window)
+{
+	const VkSampleCountFlags msaaCounts = engine._gpuProperties.limits.framebufferColorSampleCounts & engine._gpuProperties.limits.framebufferDepthSampleCounts;
+	const std::string deviceName = engine._gpuProperties.deviceName;
+	const std::string path = engine._tuningPath;
+	const uint32_t pinned = engine._pinnedTuning;
+	const double budgetMs = frame_budget_ms(engine, engine._window);
+
+	// the defaults, not a tuning being redone, but what the command line gave stays
+	TunedSettings start;
+	if (pinned & TUNE_FRAME_OVERLAP) start.frameOverlap = engine._frameOverlap;
+	if (pinned & TUNE_JOB_THREADS) start.jobThreads = engine._jobThreadCount;
+	if (pinned & TUNE_CULL_CHUNK) start.cullChunkSize = engine._cullChunkSize;
+	if (pinned & TUNE_UPLOAD_BUDGET) start.uploadBytesPerFrame = engine._uploadBytesPerFrame;
+	if (pinned & TUNE_MSAA) start.msaaSamples = engine._msaaSamples;
+	window = engine.release_window();
+	engine.cleanup();
+
+	LOG_INFO("Calibrating for " << deviceName << " with short benchmark runs, against a " << budgetMs << " ms frame");
+	AutoTuner tuner(start, pinned, msaaCounts, budgetMs);
+	TunedSettings candidate;
+	while (tuner.next(candidate))
+	{
+		LOG_INFO("Calibration run " << tuner.runs() + 1 << ": " << tuning::describe(candidate));
+		BenchmarkResult result;
+		if (!measure_settings(argc, argv, candidate, window, result))
+		{
+			return false;
+		}
+		tuner.report(result);
+	}
+	if (!tuner.finished())
+	{
+		LOG_ERROR("Calibration cut short after " << tuner.runs() << " runs, nothing written");
+		return false;
+	}
+	if (tuning::save(path, tuner.best(), deviceName))
+	{
+		LOG_INFO("Calibrated in " << tuner.runs() << " runs: " << tuning::describe(tuner.best()) << ", written to " << path);
+	}
+	return true;
+}
+
+static int run(int argc, char* argv[])
+{
+	std::string archivePath;
+	if (parse_pack_assets_arg(argc, argv, archivePath))
+	{
+		return pack_assets(archivePath);
+	}
+	std::string cachePath;
+	if (parse_bake_assets_arg(argc, argv, cachePath))
+	{
+		bool compressMeshes = false;
+		parse_compress_meshes_arg(argc, argv, compressMeshes);
+		return bake_assets(cachePath, compressMeshes);
+	}
+
+	std::vector<GpuSelection> gpus;
+	uint32_t renderJobs = 8;
+	const bool dispatch = parse_dispatch_args(argc, argv, gpus, renderJobs);
+	uint16_t nodePort = 0;
+	if (parse_render_node_arg(argc, argv, nodePort))
+	{
+		return serve_render_node(argc, argv, nodePort);
+	}
+	ClusterArgs cluster;
+	const bool distributed = parse_render_nodes_args(argc, argv, cluster);
+	TiledRenderArgs tiledRender;
+	if (parse_tiled_render_args(argc, argv, tiledRender))
+	{
+		return distributed ? render_tiled_on_nodes(argc, argv, tiledRender, cluster) : render_tiled(argc, argv, tiledRender, gpus);
+	}
+	FrameRenderArgs frameRender;
+	if (parse_frame_render_args(argc, argv, frameRender))
+	{
+		return distributed ? render_frames_on_nodes(argc, argv, frameRender, cluster) : render_frames(argc, argv, frameRender);
+	}
+	if (dispatch)
+	{
+		return dispatch_render_jobs(argc, argv, gpus, renderJobs);
+	}
+
+	bool forceCalibration = false;
+	bool neverCalibrate = false;
+	parse_calibrate_args(argc, argv, forceCalibration, neverCalibrate);
+
+	// a lost device takes every device object with it, so the engine is cleaned up and a new one started on a
+	// new device, in the same window; it reloads the scene from the asset caches the first one wrote
+	struct SDL_Window* window = nullptr;
+	bool calibrated = false;
+	for (uint32_t recoveries = 0;;)
+	{
+		VulkanEngine engine;
+		configure_engine(argc, argv, engine);
+		engine._window = window;
+
+		if (!engine.init())
+		{
+			return 1;
+		}
+
+		// only the started engine knows the GPU, and whether it has been calibrated; the session starts over on
+		// the settings calibration found. Headless and benchmark runs calibrate only when asked, so they stay
+		// reproducible
+		const bool tunable = engine._useTuning && (engine._pinnedTuning & TUNE_ALL) != TUNE_ALL;
+		const bool interactive = !engine._headless && !engine._benchmark.enabled;
+		if (!calibrated && tunable && (forceCalibration || (!neverCalibrate && interactive && !engine._tuningLoaded)))
+		{
+			calibrated = true;
+			if (!calibrate(argc, argv, engine, window))
+			{
+				return 1;
+			}
+			continue;
+		}
+
+		if (engine._benchmark.enabled)
+		{
+			engine.run_benchmark();
+		}
+		else
+		{
+			engine.run();
+		}
+
+		// a benchmark's numbers don't survive a restart, and a device that keeps getting lost won't get better
+		const bool lost = engine.device_lost();
+		const bool recover = lost && !engine._benchmark.enabled && recoveries + 1 < MAX_DEVICE_RECOVERIES;
+		window = recover ? engine.release_window() : nullptr;
+		engine.cleanup();
+		if (!recover)
+		{
+			if (lost)
+			{
+				LOG_ERROR("Device lost, giving up");
+			}
+			return lost ? 1 : 0;
+		}
+		LOG_WARN("Device lost, starting over on a new device (" << recoveries + 1 << " of " << MAX_DEVICE_RECOVERIES << ")");
+		recoveries++;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	parse_log_level_arg(argc, argv);
+	// a thread of its own writes the log from here on, so nothing waits on stdout
+	logging::start();
+	const int result = run(argc, argv);
+	logging::stop();
+	return result;
+}
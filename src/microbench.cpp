@@ -0,0 +1,852 @@
+// Microbenchmarks of the engine's CPU hot paths, for catching regressions without rendering a frame.
+// Each benchmark times one operation repeated until a sample lasts long enough to measure, over a number of
+// samples; the report gives microseconds per operation. --output writes it as CSV, and --baseline compares
+// the medians against such a file and fails when one got slower than the tolerance allows.
+// Pipeline builds and the GPU compute primitives need a Vulkan device; without one they are skipped and
+// everything else still runs.
+#include <vk_engine.h>
+#include <vk_initializers.h>
+#include <ObjLoader.h>
+#include <ComputePrimitives.h>
+#include <Log.h>
+
+#include "VkBootstrap.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+	struct MicrobenchSettings {
+		std::string filter; // runs only the benchmarks whose name contains it
+		uint32_t samples{ 10 };
+		double minSampleMs{ 20.0 }; // operations are repeated until a sample takes at least this long
+		std::string assetDir{ "../../assets" };
+		std::string shaderDir{ "../../shaders" };
+		std::string outputPath; // CSV, nothing when empty
+		std::string baselinePath; // CSV from an earlier --output
+		double tolerance{ 0.15 }; // how much slower than the baseline's median counts as a regression
+	};
+
+	// --filter TEXT, --samples N, --min-sample-ms X, --assets DIR, --shaders DIR, --output PATH,
+	// --baseline PATH, --tolerance X
+	MicrobenchSettings parse_microbench_args(int argc, char* argv[])
+	{
+		MicrobenchSettings settings;
+		for (int i = 1; i + 1 < argc; i++)
+		{
+			const char* arg = argv[i];
+			if (strcmp(arg, "--filter") == 0) settings.filter = argv[++i];
+			else if (strcmp(arg, "--samples") == 0) settings.samples = static_cast<uint32_t>(std::max(1, atoi(argv[++i])));
+			else if (strcmp(arg, "--min-sample-ms") == 0) settings.minSampleMs = std::max(0.1, atof(argv[++i]));
+			else if (strcmp(arg, "--assets") == 0) settings.assetDir = argv[++i];
+			else if (strcmp(arg, "--shaders") == 0) settings.shaderDir = argv[++i];
+			else if (strcmp(arg, "--output") == 0) settings.outputPath = argv[++i];
+			else if (strcmp(arg, "--baseline") == 0) settings.baselinePath = argv[++i];
+			else if (strcmp(arg, "--tolerance") == 0) settings.tolerance = atof(argv[++i]);
+			else std::cout << "Unknown argument '" << arg << "' ignored." << std::endl;
+		}
+		return settings;
+	}
+
+	struct MicrobenchResult {
+		std::string name;
+		uint64_t iterations; // operations per sample
+		BenchmarkReport::Summary summary; // microseconds per operation, over the samples
+	};
+
+	double elapsed_us(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// the mesh functions log every load; that would swamp the report and the time spent printing it
+	class QuietScope
+	{
+	public:
+		QuietScope() : _previous(logging::level()) { logging::set_level(logging::Level::Off); }
+		~QuietScope() { logging::set_level(_previous); }
+
+	private:
+		logging::Level _previous;
+	};
+
+	class Microbench
+	{
+	public:
+		explicit Microbench(const MicrobenchSettings& settings) : _settings(settings) {}
+
+		// op is one operation; whatever it sets up for itself is part of the time
+		void run(const std::string& name, const std::function<void()>& op)
+		{
+			if (!_settings.filter.empty() && name.find(_settings.filter) == std::string::npos)
+			{
+				return;
+			}
+
+			// the first call warms caches and allocators up and gives the repeat count
+			double firstUs;
+			{
+				QuietScope quiet;
+				auto start = std::chrono::steady_clock::now();
+				op();
+				firstUs = elapsed_us(start);
+			}
+			const uint64_t iterations = std::max<uint64_t>(1, static_cast<uint64_t>(_settings.minSampleMs * 1000.0 / std::max(firstUs, 0.001)));
+
+			std::vector<double> perOperationUs;
+			perOperationUs.reserve(_settings.samples);
+			{
+				QuietScope quiet;
+				for (uint32_t sample = 0; sample < _settings.samples; sample++)
+				{
+					auto start = std::chrono::steady_clock::now();
+					for (uint64_t i = 0; i < iterations; i++)
+					{
+						op();
+					}
+					perOperationUs.push_back(elapsed_us(start) / iterations);
+				}
+			}
+
+			MicrobenchResult result = { name, iterations, BenchmarkReport::summarize(perOperationUs) };
+			std::cout << std::left << std::setw(32) << name << std::right << std::setw(10) << iterations
+				<< std::fixed << std::setprecision(3) << std::setw(14) << result.summary.mean << std::setw(14) << result.summary.p50
+				<< std::setw(14) << result.summary.p95 << std::endl;
+			_results.push_back(result);
+		}
+
+		void print_header() const
+		{
+			std::cout << std::left << std::setw(32) << "benchmark" << std::right << std::setw(10) << "iters"
+				<< std::setw(14) << "mean us" << std::setw(14) << "p50 us" << std::setw(14) << "p95 us" << std::endl;
+		}
+
+		bool write(const std::string& path) const
+		{
+			std::ofstream file(path);
+			if (!file)
+			{
+				return false;
+			}
+			file << "name,iterations,mean_us,p50_us,p95_us,p99_us\n";
+			for (const MicrobenchResult& result : _results)
+			{
+				file << result.name << ',' << result.iterations << ',' << result.summary.mean << ',' << result.summary.p50
+					<< ',' << result.summary.p95 << ',' << result.summary.p99 << '\n';
+			}
+			return true;
+		}
+
+		// false when a benchmark's median is over tolerance slower than the baseline's; benchmarks missing
+		// from either side are not compared
+		bool compare(const std::string& path, double tolerance) const
+		{
+			std::ifstream file(path);
+			if (!file)
+			{
+				std::cout << "Couldn't read baseline " << path << std::endl;
+				return false;
+			}
+
+			std::unordered_map<std::string, double> baseline;
+			std::string line;
+			std::getline(file, line);
+			while (std::getline(file, line))
+			{
+				std::stringstream fields(line);
+				std::string name, iterations, mean, p50;
+				if (std::getline(fields, name, ',') && std::getline(fields, iterations, ',') && std::getline(fields, mean, ',')
+					&& std::getline(fields, p50, ','))
+				{
+					baseline[name] = atof(p50.c_str());
+				}
+			}
+
+			bool passed = true;
+			for (const MicrobenchResult& result : _results)
+			{
+				auto found = baseline.find(result.name);
+				if (found == baseline.end() || found->second <= 0.0)
+				{
+					continue;
+				}
+				const double ratio = result.summary.p50 / found->second;
+				if (ratio > 1.0 + tolerance)
+				{
+					std::cout << "REGRESSION " << result.name << ": p50 " << result.summary.p50 << " us, baseline "
+						<< found->second << " us (" << std::setprecision(1) << (ratio - 1.0) * 100.0 << "% slower)" << std::endl;
+					passed = false;
+				}
+			}
+			return passed;
+		}
+
+	private:
+		const MicrobenchSettings& _settings;
+		std::vector<MicrobenchResult> _results;
+	};
+
+	// just enough Vulkan to build pipelines and run compute work: any GPU, no surface
+	struct BenchDevice {
+		vkb::Instance instance;
+		vkb::Device device;
+
+		bool init()
+		{
+			vkb::InstanceBuilder builder;
+			auto instanceResult = builder.set_app_name("QC Engine microbench").require_api_version(1, 1, 0).set_headless().build();
+			if (!instanceResult)
+			{
+				return false;
+			}
+			instance = instanceResult.value();
+
+			vkb::PhysicalDeviceSelector selector{ instance };
+			auto physicalResult = selector.set_minimum_version(1, 1).require_present(false).select();
+			if (!physicalResult)
+			{
+				vkb::destroy_instance(instance);
+				return false;
+			}
+			auto deviceResult = vkb::DeviceBuilder{ physicalResult.value() }.build();
+			if (!deviceResult)
+			{
+				vkb::destroy_instance(instance);
+				return false;
+			}
+			device = deviceResult.value();
+			return true;
+		}
+
+		void cleanup()
+		{
+			vkb::destroy_device(device);
+			vkb::destroy_instance(instance);
+		}
+	};
+
+	bool load_shader(VkDevice device, const std::string& path, VkShaderModule* module)
+	{
+		std::ifstream file(path, std::ios::ate | std::ios::binary);
+		if (!file.is_open())
+		{
+			return false;
+		}
+		const size_t size = static_cast<size_t>(file.tellg());
+		std::vector<uint32_t> code(size / sizeof(uint32_t));
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(code.data()), code.size() * sizeof(uint32_t));
+
+		VkShaderModuleCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		info.codeSize = code.size() * sizeof(uint32_t);
+		info.pCode = code.data();
+		return vkCreateShaderModule(device, &info, nullptr, module) == VK_SUCCESS;
+	}
+
+	void mesh_benchmarks(Microbench& bench, const MicrobenchSettings& settings)
+	{
+		for (const char* name : { "monkey_smooth", "lost_empire" })
+		{
+			const std::string objPath = settings.assetDir + "/" + name + ".obj";
+			ObjData obj;
+			if (!load_obj(objPath.c_str(), obj))
+			{
+				std::cout << "Couldn't load " << objPath << ", skipping its benchmarks." << std::endl;
+				continue;
+			}
+
+			// parsing, deduplication, optimization, clusters and LODs: what a cache miss costs
+			bench.run(std::string("load_from_obj/") + name, [&]() {
+				Mesh mesh;
+				mesh.load_from_obj(objPath.c_str());
+			});
+
+			bench.run(std::string("obj_parse/") + name, [&]() {
+				ObjData parsed;
+				load_obj(objPath.c_str(), parsed);
+			});
+
+			// the single-threaded part load_from_obj runs on a worker per shape
+			std::vector<Vertex> vertices;
+			std::vector<uint32_t> indices;
+			bench.run(std::string("vertex_dedup/") + name, [&]() {
+				for (const ObjShape& shape : obj.shapes)
+				{
+					Mesh::build_obj_shape(obj, shape, vertices, indices);
+				}
+			});
+
+			// both cache flavours, written once from a full import
+			Mesh source;
+			{
+				QuietScope quiet;
+				source.load_from_obj(objPath.c_str());
+			}
+			for (bool compressed : { false, true })
+			{
+				const std::string cachePath = std::string("microbench_") + name + (compressed ? ".compressed.mesh" : ".mesh");
+				if (!source.save_to_cache(cachePath.c_str(), objPath.c_str(), compressed))
+				{
+					continue;
+				}
+				bench.run(std::string(compressed ? "cache_load_compressed/" : "cache_load/") + name, [&]() {
+					Mesh mesh;
+					mesh.load_from_cache(cachePath.c_str(), objPath.c_str());
+				});
+				remove(cachePath.c_str());
+			}
+		}
+	}
+
+	void deletion_queue_benchmarks(Microbench& bench, VkDevice device)
+	{
+		// a frame's worth of retired objects; the handles are null, which destroying ignores, so this is the
+		// queue's own overhead
+		constexpr int COUNT = 1024;
+		DeletionQueue queue;
+		int calls = 0;
+		bench.run("deletion_queue/functions", [&]() {
+			for (int i = 0; i < COUNT; i++)
+			{
+				queue.push_function([&calls]() { calls++; });
+			}
+			queue.flush(device, nullptr);
+		});
+
+		if (device != VK_NULL_HANDLE)
+		{
+			bench.run("deletion_queue/handles", [&]() {
+				for (int i = 0; i < COUNT; i++)
+				{
+					queue.push_pipeline(VK_NULL_HANDLE);
+					queue.push_image_view(VK_NULL_HANDLE);
+					queue.push_framebuffer(VK_NULL_HANDLE);
+				}
+				queue.flush(device, nullptr);
+			});
+		}
+	}
+
+	void transform_benchmarks(Microbench& bench)
+	{
+		// 100 roots with 99 children each, like a scene of small hierarchies
+		constexpr uint32_t ROOTS = 100;
+		constexpr uint32_t CHILDREN = 99;
+		TransformStore transforms;
+		for (uint32_t root = 0; root < ROOTS; root++)
+		{
+			const uint32_t parent = transforms.add(glm::vec3(float(root), 0.0f, 0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f));
+			for (uint32_t child = 0; child < CHILDREN; child++)
+			{
+				transforms.add(glm::vec3(0.0f, float(child), 0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(0.5f), parent);
+			}
+		}
+		transforms.update();
+
+		const uint32_t count = static_cast<uint32_t>(transforms.size());
+		float t = 0.0f;
+		bench.run("transforms/update_all", [&]() {
+			t += 0.01f;
+			for (uint32_t i = 0; i < count; i++)
+			{
+				transforms.set(i, glm::vec3(t, float(i), 0.0f), glm::angleAxis(t, glm::vec3(0.0f, 1.0f, 0.0f)), glm::vec3(1.0f));
+			}
+			transforms.update();
+		});
+
+		// one hierarchy in a hundred moves, so most of the store is skipped
+		bench.run("transforms/update_one_root", [&]() {
+			t += 0.01f;
+			transforms.set(count / 2 / (CHILDREN + 1) * (CHILDREN + 1), glm::vec3(t, 0.0f, 0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f));
+			transforms.update();
+		});
+	}
+
+	void frustum_cull_benchmarks(Microbench& bench)
+	{
+		// a million small objects scattered through a 2 km cube, seen from its middle
+		constexpr uint32_t OBJECTS = 1000000;
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+		std::uniform_real_distribution<float> size(0.5f, 4.0f);
+		SphereCuller spheres;
+		spheres.resize(OBJECTS);
+		Bvh bvh;
+		for (uint32_t i = 0; i < OBJECTS; i++)
+		{
+			const glm::vec3 center(position(random), position(random), position(random));
+			const float radius = size(random);
+			spheres.set(i, center, radius);
+			bvh.insert({ center - glm::vec3(radius), center + glm::vec3(radius) }, i);
+		}
+
+		Camera camera;
+		camera.update(glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f)), glm::radians(70.0f), 16.0f / 9.0f,
+			0.1f, 1500.0f);
+
+		std::vector<uint32_t> visible(OBJECTS);
+		bench.run("frustum_cull/spheres_1M", [&]() {
+			spheres.cull(camera.frustum_planes(), visible.data());
+		});
+
+		// the camera holds still, so after the first sweeps only the spheres near the planes are tested
+		SphereCuller coherentSpheres = spheres;
+		coherentSpheres.set_coherence(1.0f);
+		bench.run("frustum_cull/spheres_1M_coherent", [&]() {
+			coherentSpheres.cull_coherent(camera.frustum_planes(), visible.data());
+		});
+
+		// the default CPU path: the tree query, then its hits back in list order
+		bench.run("frustum_cull/bvh_1M", [&]() {
+			uint32_t count = 0;
+			bvh.query_frustum(camera.frustum_planes(), [&](uint32_t index) {
+				visible[count++] = index;
+			});
+			std::sort(visible.begin(), visible.begin() + count);
+		});
+	}
+
+	void draw_sort_benchmarks(Microbench& bench)
+	{
+		// the render list of a busy scene: a few pipelines, more materials, many meshes in both index types.
+		// Only the pointers and handles are compared, so none of them is real
+		constexpr int PIPELINES = 4;
+		constexpr int MATERIALS = 32;
+		constexpr int MESHES = 256;
+		constexpr int OBJECTS = 10000;
+		std::vector<Material> materials(MATERIALS);
+		for (int i = 0; i < MATERIALS; i++)
+		{
+			materials[i].pipeline = (VkPipeline)(uintptr_t)(i % PIPELINES + 1);
+		}
+		std::vector<Mesh> meshes(MESHES);
+		for (int i = 0; i < MESHES; i++)
+		{
+			meshes[i]._indexType = i % 3 == 0 ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16;
+		}
+
+		std::mt19937 random(1234);
+		std::vector<RenderObject> shuffled(OBJECTS);
+		for (RenderObject& object : shuffled)
+		{
+			object.material = &materials[random() % MATERIALS];
+			object.mesh = &meshes[random() % MESHES];
+		}
+
+		// includes copying the list back to its unsorted state, which is small next to the sort
+		std::vector<RenderObject> renderables;
+		bench.run("draw_sort/shuffled", [&]() {
+			renderables = shuffled;
+			std::sort(renderables.begin(), renderables.end(), draws_before);
+		});
+
+		// adding a handful of objects to a sorted list, which is what sort_renderables usually sees
+		std::vector<RenderObject> sorted = shuffled;
+		std::sort(sorted.begin(), sorted.end(), draws_before);
+		std::copy(shuffled.begin(), shuffled.begin() + 16, sorted.end() - 16);
+		bench.run("draw_sort/nearly_sorted", [&]() {
+			renderables = sorted;
+			std::sort(renderables.begin(), renderables.end(), draws_before);
+		});
+	}
+
+	void pipeline_benchmarks(Microbench& bench, const MicrobenchSettings& settings, VkDevice device)
+	{
+		VkShaderModule vertexShader = VK_NULL_HANDLE;
+		VkShaderModule fragmentShader = VK_NULL_HANDLE;
+		if (!load_shader(device, settings.shaderDir + "/debugLine.vert.spv", &vertexShader)
+			|| !load_shader(device, settings.shaderDir + "/debugLine.frag.spv", &fragmentShader))
+		{
+			std::cout << "Couldn't load the debug line shaders from " << settings.shaderDir << ", skipping pipeline benchmarks." << std::endl;
+			vkDestroyShaderModule(device, vertexShader, nullptr);
+			return;
+		}
+
+		// the main pass's attachments, single-sampled
+		VkAttachmentDescription attachments[2] = {};
+		attachments[0].format = VK_FORMAT_B8G8R8A8_UNORM;
+		attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		attachments[1] = attachments[0];
+		attachments[1].format = VK_FORMAT_D32_SFLOAT;
+		attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		VkAttachmentReference colorRef = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		VkAttachmentReference depthRef = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colorRef;
+		subpass.pDepthStencilAttachment = &depthRef;
+		VkRenderPassCreateInfo passInfo = {};
+		passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		passInfo.attachmentCount = 2;
+		passInfo.pAttachments = attachments;
+		passInfo.subpassCount = 1;
+		passInfo.pSubpasses = &subpass;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		VK_CHECK(vkCreateRenderPass(device, &passInfo, nullptr, &renderPass));
+
+		// the camera buffer the debug line shader reads
+		VkDescriptorSetLayoutBinding cameraBinding = vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT, 0);
+		VkDescriptorSetLayoutCreateInfo setInfo = {};
+		setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		setInfo.bindingCount = 1;
+		setInfo.pBindings = &cameraBinding;
+		VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+		VK_CHECK(vkCreateDescriptorSetLayout(device, &setInfo, nullptr, &setLayout));
+		VkPipelineLayoutCreateInfo layoutInfo = vkinit::pipeline_layout_create_info();
+		layoutInfo.setLayoutCount = 1;
+		layoutInfo.pSetLayouts = &setLayout;
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+		VK_CHECK(vkCreatePipelineLayout(device, &layoutInfo, nullptr, &layout));
+
+		PipelineBuilder builder;
+		builder._shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, vertexShader));
+		builder._shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShader));
+		builder._vertexInputInfo = vkinit::vertex_input_state_create_info();
+		DEBUG_VERTEX_LAYOUT.apply(builder._vertexInputInfo);
+		builder._inputAssembly = vkinit::input_assembly_create_info(VK_PRIMITIVE_TOPOLOGY_LINE_LIST);
+		builder._viewport = { 0.0f, 0.0f, 1920.0f, 1080.0f, 0.0f, 1.0f };
+		builder._scissor = { { 0, 0 }, { 1920, 1080 } };
+		builder._rasterizer = vkinit::rasterization_state_create_info(VK_POLYGON_MODE_FILL);
+		builder._multisampling = vkinit::multisampling_state_create_info();
+		builder._colorBlendAttachment = vkinit::color_blend_attachment_state();
+		builder._depthStencil = vkinit::depth_stencil_create_info(true, false, VK_COMPARE_OP_LESS_OR_EQUAL);
+		builder._pipelineLayout = layout;
+
+		// without a cache every build compiles the shaders again, unless the driver keeps a cache of its
+		// own (Mesa's can be turned off with MESA_SHADER_CACHE_DISABLE=true)
+		bench.run("build_pipeline/no_cache", [&]() {
+			vkDestroyPipeline(device, builder.build_pipeline(device, renderPass), nullptr);
+		});
+
+		// the first build fills the cache, every timed one hits it
+		VkPipelineCacheCreateInfo cacheInfo = {};
+		cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		VkPipelineCache cache = VK_NULL_HANDLE;
+		VK_CHECK(vkCreatePipelineCache(device, &cacheInfo, nullptr, &cache));
+		bench.run("build_pipeline/cached", [&]() {
+			vkDestroyPipeline(device, builder.build_pipeline(device, renderPass, cache), nullptr);
+		});
+
+		vkDestroyPipelineCache(device, cache, nullptr);
+		vkDestroyPipelineLayout(device, layout, nullptr);
+		vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+		vkDestroyRenderPass(device, renderPass, nullptr);
+		vkDestroyShaderModule(device, fragmentShader, nullptr);
+		vkDestroyShaderModule(device, vertexShader, nullptr);
+	}
+
+	// GPU time of the compute primitives on a million elements, submit and wait included, each checked once
+	// against the CPU before it's timed
+	void compute_primitive_benchmarks(Microbench& bench, const MicrobenchSettings& settings, BenchDevice& device)
+	{
+		const VkDevice vkDevice = device.device.device;
+		const VkPhysicalDevice gpu = device.device.physical_device.physical_device;
+		auto queueResult = device.device.get_queue(vkb::QueueType::compute);
+		auto familyResult = device.device.get_queue_index(vkb::QueueType::compute);
+		if (!ComputePrimitives::supported(gpu) || !queueResult || !familyResult)
+		{
+			std::cout << "No compute queue with subgroup arithmetic and ballots, skipping compute primitive benchmarks." << std::endl;
+			return;
+		}
+
+		ComputePrimitives::Shaders shaders;
+		const bool loaded = load_shader(vkDevice, settings.shaderDir + "/primScan.comp.spv", &shaders.scan)
+			&& load_shader(vkDevice, settings.shaderDir + "/primScanAdd.comp.spv", &shaders.scanAdd)
+			&& load_shader(vkDevice, settings.shaderDir + "/primCompact.comp.spv", &shaders.compact)
+			&& load_shader(vkDevice, settings.shaderDir + "/primRadixHistogram.comp.spv", &shaders.radixHistogram)
+			&& load_shader(vkDevice, settings.shaderDir + "/primRadixScatter.comp.spv", &shaders.radixScatter);
+		auto destroy_shaders = [&]() {
+			for (VkShaderModule module : { shaders.scan, shaders.scanAdd, shaders.compact, shaders.radixHistogram, shaders.radixScatter })
+			{
+				vkDestroyShaderModule(vkDevice, module, nullptr);
+			}
+		};
+		if (!loaded)
+		{
+			std::cout << "Couldn't load the compute primitive shaders from " << settings.shaderDir << ", skipping their benchmarks." << std::endl;
+			destroy_shaders();
+			return;
+		}
+
+		VmaAllocatorCreateInfo allocatorInfo = {};
+		allocatorInfo.physicalDevice = gpu;
+		allocatorInfo.device = vkDevice;
+		allocatorInfo.instance = device.instance.instance;
+		allocatorInfo.vulkanApiVersion = VK_API_VERSION_1_1;
+		VmaAllocator allocator = nullptr;
+		VK_CHECK(vmaCreateAllocator(&allocatorInfo, &allocator));
+
+		constexpr uint32_t COUNT = 1 << 20;
+		LayoutCache layouts;
+		layouts.init(vkDevice);
+		DescriptorSetCache descriptorSets;
+		descriptorSets.init(vkDevice, 1);
+		ComputePrimitives primitives;
+		primitives.init(vkDevice, allocator, layouts, descriptorSets, shaders, VK_NULL_HANDLE, COUNT, 1);
+
+		auto create = [&](uint32_t words, VmaMemoryUsage memoryUsage, void** mapped) {
+			VkBufferCreateInfo bufferInfo = {};
+			bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferInfo.size = VkDeviceSize(words) * sizeof(uint32_t);
+			bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+			VmaAllocationCreateInfo allocInfo = {};
+			allocInfo.usage = memoryUsage;
+			AllocatedBuffer buffer;
+			VK_CHECK(vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &buffer._buffer, &buffer._allocation, nullptr));
+			if (mapped)
+			{
+				VK_CHECK(vmaMapMemory(allocator, buffer._allocation, mapped));
+			}
+			return buffer;
+		};
+
+		// the inputs, as keys (64-bit pairs, or their first COUNT words as 32-bit ones), values and flags
+		void* sourceData;
+		void* readbackData;
+		AllocatedBuffer source = create(4 * COUNT, VMA_MEMORY_USAGE_CPU_TO_GPU, &sourceData);
+		AllocatedBuffer readback = create(3 * COUNT + 1, VMA_MEMORY_USAGE_GPU_TO_CPU, &readbackData);
+		AllocatedBuffer keys = create(2 * COUNT, VMA_MEMORY_USAGE_GPU_ONLY, nullptr);
+		AllocatedBuffer values = create(COUNT, VMA_MEMORY_USAGE_GPU_ONLY, nullptr);
+		AllocatedBuffer flags = create(COUNT, VMA_MEMORY_USAGE_GPU_ONLY, nullptr);
+		AllocatedBuffer output = create(COUNT + 1, VMA_MEMORY_USAGE_GPU_ONLY, nullptr);
+		AllocatedBuffer count = create(1, VMA_MEMORY_USAGE_GPU_ONLY, nullptr);
+
+		uint32_t* sourceWords = static_cast<uint32_t*>(sourceData);
+		const uint32_t* results = static_cast<const uint32_t*>(readbackData);
+		std::mt19937 random(1234);
+		for (uint32_t i = 0; i < 2 * COUNT; i++)
+		{
+			sourceWords[i] = random();
+		}
+		for (uint32_t i = 0; i < COUNT; i++)
+		{
+			sourceWords[2 * COUNT + i] = i;
+			sourceWords[3 * COUNT + i] = random() % 4 == 0;
+		}
+		const uint32_t* sourceKeys = sourceWords;
+		const uint32_t* sourceFlags = sourceWords + 3 * COUNT;
+
+		VkQueue queue = queueResult.value();
+		VkCommandPool pool = VK_NULL_HANDLE;
+		VkCommandPoolCreateInfo poolInfo = vkinit::command_pool_create_info(familyResult.value());
+		VK_CHECK(vkCreateCommandPool(vkDevice, &poolInfo, nullptr, &pool));
+		VkCommandBuffer commands[2];
+		VkCommandBufferAllocateInfo commandInfo = vkinit::command_buffer_allocate_info(pool, 2);
+		VK_CHECK(vkAllocateCommandBuffers(vkDevice, &commandInfo, commands));
+		VkFenceCreateInfo fenceInfo = vkinit::fence_create_info();
+		VkFence fence = VK_NULL_HANDLE;
+		VK_CHECK(vkCreateFence(vkDevice, &fenceInfo, nullptr, &fence));
+
+		auto submit = [&](VkCommandBuffer cmd) {
+			VkSubmitInfo submitInfo = vkinit::submit_info(&cmd);
+			VK_CHECK(vkQueueSubmit(queue, 1, &submitInfo, fence));
+			VK_CHECK(vkWaitForFences(vkDevice, 1, &fence, VK_TRUE, UINT64_MAX));
+			VK_CHECK(vkResetFences(vkDevice, 1, &fence));
+		};
+		auto copy = [](VkCommandBuffer cmd, const AllocatedBuffer& from, VkDeviceSize fromWord, const AllocatedBuffer& to, VkDeviceSize toWord, VkDeviceSize words) {
+			VkBufferCopy region = { fromWord * sizeof(uint32_t), toWord * sizeof(uint32_t), words * sizeof(uint32_t) };
+			vkCmdCopyBuffer(cmd, from._buffer, to._buffer, 1, &region);
+		};
+		auto barrier = [](VkCommandBuffer cmd, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess) {
+			VkMemoryBarrier memoryBarrier = {};
+			memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			memoryBarrier.srcAccessMask = srcAccess;
+			memoryBarrier.dstAccessMask = dstAccess;
+			vkCmdPipelineBarrier(cmd, srcStages, dstStages, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		};
+		// work into the first command buffer followed by the copy of its results to the readback buffer, and
+		// alone into the second; the first runs once to check them, the second is what gets timed
+		auto record = [&](const std::function<void(VkCommandBuffer)>& work, const std::function<void(VkCommandBuffer)>& readResults) {
+			VK_CHECK(vkResetCommandPool(vkDevice, pool, 0));
+			for (VkCommandBuffer cmd : commands)
+			{
+				VkCommandBufferBeginInfo beginInfo = vkinit::command_buffer_begin_info(0);
+				VK_CHECK(vkBeginCommandBuffer(cmd, &beginInfo));
+				work(cmd);
+				if (cmd == commands[0])
+				{
+					barrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+					readResults(cmd);
+					barrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+				}
+				VK_CHECK(vkEndCommandBuffer(cmd));
+			}
+			submit(commands[0]);
+		};
+		auto report = [](const char* name, bool correct) {
+			if (!correct)
+			{
+				std::cout << "WARN: " << name << " disagrees with the CPU" << std::endl;
+			}
+		};
+
+		// the flags, values and, for the sorts, keys as the source has them
+		auto restore = [&](VkCommandBuffer cmd, bool withKeys) {
+			copy(cmd, source, 2 * COUNT, values, 0, COUNT);
+			copy(cmd, source, 3 * COUNT, flags, 0, COUNT);
+			if (withKeys)
+			{
+				copy(cmd, source, 0, keys, 0, 2 * COUNT);
+			}
+			barrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+		};
+		{
+			VK_CHECK(vkResetCommandPool(vkDevice, pool, 0));
+			VkCommandBufferBeginInfo beginInfo = vkinit::command_buffer_begin_info(0);
+			VK_CHECK(vkBeginCommandBuffer(commands[0], &beginInfo));
+			restore(commands[0], false);
+			VK_CHECK(vkEndCommandBuffer(commands[0]));
+			submit(commands[0]);
+		}
+
+		const StorageRange keyRange = { keys._buffer, 0, VK_WHOLE_SIZE };
+		const StorageRange valueRange = { values._buffer, 0, VK_WHOLE_SIZE };
+		const StorageRange flagRange = { flags._buffer, 0, VK_WHOLE_SIZE };
+		const StorageRange outputRange = { output._buffer, 0, VK_WHOLE_SIZE };
+		const StorageRange countRange = { count._buffer, 0, VK_WHOLE_SIZE };
+
+		record([&](VkCommandBuffer cmd) { primitives.exclusive_scan(cmd, 0, flagRange, outputRange, COUNT); },
+			[&](VkCommandBuffer cmd) { copy(cmd, output, 0, readback, 0, COUNT + 1); });
+		{
+			uint32_t sum = 0;
+			bool correct = true;
+			for (uint32_t i = 0; i <= COUNT; i++)
+			{
+				correct &= results[i] == sum;
+				sum += i < COUNT ? sourceFlags[i] : 0;
+			}
+			report("exclusive_scan", correct);
+		}
+		bench.run("gpu_exclusive_scan/1M", [&]() { submit(commands[1]); });
+
+		record([&](VkCommandBuffer cmd) { primitives.compact(cmd, 0, valueRange, flagRange, outputRange, countRange, COUNT); },
+			[&](VkCommandBuffer cmd) {
+				copy(cmd, output, 0, readback, 0, COUNT);
+				copy(cmd, count, 0, readback, COUNT, 1);
+			});
+		{
+			uint32_t kept = 0;
+			bool correct = true;
+			for (uint32_t i = 0; i < COUNT; i++)
+			{
+				if (sourceFlags[i])
+				{
+					correct &= results[kept++] == i;
+				}
+			}
+			report("compact", correct && results[COUNT] == kept);
+		}
+		bench.run("gpu_compact/1M", [&]() { submit(commands[1]); });
+
+		// includes restoring the unsorted keys and values, a copy small next to the sort
+		for (uint32_t keyBits : { 32u, 64u })
+		{
+			const uint32_t keyWords = keyBits / 32;
+			record([&](VkCommandBuffer cmd) {
+					restore(cmd, true);
+					primitives.sort(cmd, 0, keyRange, valueRange, COUNT, keyBits);
+				},
+				[&](VkCommandBuffer cmd) {
+					copy(cmd, keys, 0, readback, 0, keyWords * COUNT);
+					copy(cmd, values, 0, readback, 2 * COUNT, COUNT);
+				});
+
+			auto key_of = [&](uint32_t i) {
+				return keyWords == 2 ? uint64_t(sourceKeys[2 * i + 1]) << 32 | sourceKeys[2 * i] : uint64_t(sourceKeys[i]);
+			};
+			std::vector<uint32_t> order(COUNT);
+			std::iota(order.begin(), order.end(), 0u);
+			std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return key_of(a) < key_of(b); });
+			bool correct = true;
+			for (uint32_t i = 0; i < COUNT && correct; i++)
+			{
+				const uint64_t key = keyWords == 2 ? uint64_t(results[2 * i + 1]) << 32 | results[2 * i] : uint64_t(results[i]);
+				correct = key == key_of(order[i]) && results[2 * COUNT + i] == order[i];
+			}
+			const std::string name = "gpu_radix_sort/" + std::to_string(keyBits) + "bit_1M";
+			report(name.c_str(), correct);
+			bench.run(name, [&]() { submit(commands[1]); });
+		}
+
+		vkDestroyFence(vkDevice, fence, nullptr);
+		vkDestroyCommandPool(vkDevice, pool, nullptr);
+		vmaUnmapMemory(allocator, source._allocation);
+		vmaUnmapMemory(allocator, readback._allocation);
+		for (AllocatedBuffer* buffer : { &source, &readback, &keys, &values, &flags, &output, &count })
+		{
+			vmaDestroyBuffer(allocator, buffer->_buffer, buffer->_allocation);
+		}
+		primitives.cleanup();
+		descriptorSets.cleanup();
+		layouts.cleanup();
+		vmaDestroyAllocator(allocator);
+		destroy_shaders();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const MicrobenchSettings settings = parse_microbench_args(argc, argv);
+
+	// the same workers the engine runs its parallel loops on
+	JobSystem jobSystem;
+	jobSystem.init();
+	JobSystem::set_shared(&jobSystem);
+
+	BenchDevice device;
+	const bool hasDevice = device.init();
+	if (!hasDevice)
+	{
+		std::cout << "No Vulkan device, skipping the benchmarks that need one." << std::endl;
+	}
+	const VkDevice vkDevice = hasDevice ? device.device.device : VK_NULL_HANDLE;
+
+	Microbench bench(settings);
+	bench.print_header();
+	mesh_benchmarks(bench, settings);
+	deletion_queue_benchmarks(bench, vkDevice);
+	transform_benchmarks(bench);
+	frustum_cull_benchmarks(bench);
+	draw_sort_benchmarks(bench);
+	if (hasDevice)
+	{
+		pipeline_benchmarks(bench, settings, vkDevice);
+		compute_primitive_benchmarks(bench, settings, device);
+		device.cleanup();
+	}
+
+	JobSystem::set_shared(nullptr);
+	jobSystem.cleanup();
+
+	if (!settings.outputPath.empty() && !bench.write(settings.outputPath))
+	{
+		std::cout << "Couldn't write " << settings.outputPath << std::endl;
+	}
+	if (!settings.baselinePath.empty() && !bench.compare(settings.baselinePath, settings.tolerance))
+	{
+		return 1;
+	}
+	return 0;
+}
@@ -1,26 +1,29 @@
-﻿// immediately log error and abort if there's a vulkan error
-#define VK_CHECK(x)												\
-	do															\
-	{															\
-		VkResult err = x;										\
-		if (err)												\
-		{														\
-			std::cout << "Vulkan error: " << err << std::endl;	\
-		}														\
-	}	while (0)												\
-
-#include <iostream>
-#include <vector>
+﻿#include <vector>
+#include <filesystem>
 #include <fstream>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <cctype>
+#include <cstring>
+#include <cstdio>
+#include <limits>
+#include <sstream>
 
 #include <glm/gtx/transform.hpp>
 
 #include "vk_engine.h"
 #include "PipelineBuilder.h"
+#include "JobSystem.h"
+#include "BlockPack.h"
+#include "MipStreaming.h"
 
 #include <SDL.h>
 #include <SDL_vulkan.h>
 
+#include <Log.h>
 #include <vk_types.h>
 #include <vk_initializers.h>
 
@@ -29,34 +32,179 @@
 #define VMA_IMPLEMENTATION
 #include <vk_mem_alloc.h>
 
+namespace {
+	const char* present_mode_name(VkPresentModeKHR mode)
+	{
+		switch (mode)
+		{
+		case VK_PRESENT_MODE_IMMEDIATE_KHR: return "IMMEDIATE";
+		case VK_PRESENT_MODE_MAILBOX_KHR: return "MAILBOX";
+		case VK_PRESENT_MODE_FIFO_KHR: return "FIFO";
+		case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "FIFO_RELAXED";
+		default: return "UNKNOWN";
+		}
+	}
+
+	// about what upload_mesh stages for a streamed mesh's parts; the upload budget needs no more than that
+	VkDeviceSize staged_bytes(const AssetStreamer::LoadedMesh& loaded)
+	{
+		VkDeviceSize bytes = 0;
+		for (const Mesh& part : loaded.parts)
+		{
+			bytes += part._vertices.size() * sizeof(Vertex) + std::max(part._indices.size(), part._packedIndices.size()) * sizeof(uint32_t);
+		}
+		return bytes;
+	}
+}
+
+const char* object_data_path_name(ObjectDataPath path)
+{
+	switch (path)
+	{
+	case ObjectDataPath::PushConstants: return "push";
+	case ObjectDataPath::DynamicUniform: return "uniform";
+	case ObjectDataPath::StorageBuffer: return "storage";
+	default: return "unknown";
+	}
+}
+
+const char* debug_view_name(DebugView view)
+{
+	switch (view)
+	{
+	case DebugView::Lit: return "lit";
+	case DebugView::Overdraw: return "overdraw";
+	default: return "unknown";
+	}
+}
+
 // next : https://vkguide.dev/docs/chapter-3/scene_management/
-void VulkanEngine::init()
+bool VulkanEngine::init()
 {
-	// We initialize SDL and create a window with it. 
-	SDL_Init(SDL_INIT_VIDEO);
+	cpu_profiler::set_thread_name("main");
+	if (!_cpuTracePath.empty())
+	{
+		cpu_profiler::begin_capture();
+	}
+	_hitches.init(_hitchSettings);
+	CPU_PROFILE_SCOPE("init");
+	_startupStart = std::chrono::steady_clock::now();
+	_startupMark = _startupStart;
 
-	SDL_WindowFlags window_flags = (SDL_WindowFlags)(SDL_WINDOW_VULKAN);
-	
-	_window = SDL_CreateWindow(
-		"QCEngine",
-		SDL_WINDOWPOS_UNDEFINED,
-		SDL_WINDOWPOS_UNDEFINED,
-		_windowExtent.width,
-		_windowExtent.height,
-		window_flags
-	);
+	// a tiled still only ever leaves through the readback, a tile at a time
+	if (_tileGrid.count() > 0)
+	{
+		_headless = true;
+		_windowExtent = _tileGrid.tile_extent();
+		_readbackFormat = ReadbackFormat::Rgba;
+	}
+	// a device created without surface extensions can't present for anyone
+	if (_deviceContext && _deviceContext->headless && !_headless)
+	{
+		LOG_INFO("The shared device is headless, so is this session");
+		_headless = true;
+	}
+	// the shared device was picked for the first session's window, and may not drive the display at all
+	if (_deviceContext && _displayIndex >= 0)
+	{
+		LOG_WARN("A shared device can't present straight to a display, using a window");
+		_displayIndex = -1;
+	}
+
+	// We initialize SDL and create a window with it, unless there's nothing to show; straight to a display
+	// SDL stays out of it, or its KMS backend would take the display first
+	if (!_headless && _displayIndex < 0)
+	{
+		SDL_Init(SDL_INIT_VIDEO);
+	}
+	// without a window, the readback is the only way frames get out
+	_useReadback = _useReadback || _headless;
+
+	// worker threads for every subsystem; the free parallel_for runs on these from here on
+	_jobSystem.init(_jobThreadCount);
+	JobSystem::set_shared(&_jobSystem);
+	_simulation.init(SIMULATION_STEP_SECONDS);
+	_camera.set_reverse_z(_reverseZ, !_finiteFarPlane);
+
+	// mapped once for the whole run; shaders and the streamer read straight from it
+	if (_assetArchive.open(_assetArchivePath))
+	{
+		LOG_INFO("Loading assets from " << _assetArchivePath << " (" << _assetArchive.names().size() << " entries)");
+	}
+
+	// a window handed over by a previous engine is kept, at whatever size it has now
+	if (!_headless && _displayIndex < 0 && _window == nullptr)
+	{
+		// exclusivity is only granted to a window covering its monitor
+		SDL_WindowFlags window_flags = (SDL_WindowFlags)(SDL_WINDOW_VULKAN
+			| (_useFullScreenExclusive ? SDL_WINDOW_FULLSCREEN : SDL_WINDOW_RESIZABLE));
+
+		_window = SDL_CreateWindow(
+			"QCEngine",
+			SDL_WINDOWPOS_UNDEFINED,
+			SDL_WINDOWPOS_UNDEFINED,
+			_windowExtent.width,
+			_windowExtent.height,
+			window_flags
+		);
+	}
+	mark_startup("window");
 
 	// load core Vulkan structures & command queue
-	init_vulkan();
+	if (!init_vulkan())
+	{
+		cleanup_failed_init();
+		return false;
+	}
+	mark_startup("vulkan");
+
+	// benchmarks measure the renderer, not the display refresh
+	if (_benchmark.enabled && _benchmark.disableVsync)
+	{
+		_presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+	}
 
 	// create swapchain
-	init_swapchain();
+	if (!init_swapchain())
+	{
+		cleanup_failed_init();
+		return false;
+	}
+
+	// with post-processing the scene renders with more range and precision than the swapchain holds
+	_sceneColorFormat = _usePostProcess ? PostProcess::HDR_FORMAT : _swapchainImageFormat;
 
 	// init renderpass
 	init_default_renderpass();
+	mark_startup("swapchain");
 
-	// init framebuffers
-	init_framebuffers();
+	// the frame's passes are declared on the first draw(), once the features they depend on are known
+	_frameGraph.init(_device, _allocator);
+	if (_useDynamicRendering)
+	{
+		_frameGraph.set_dynamic_rendering(_vkCmdBeginRendering, _vkCmdEndRendering);
+	}
+	if (_synchronization2Supported)
+	{
+		_frameGraph.set_synchronization2(_vkCmdPipelineBarrier2);
+	}
+	_frameGraph.set_pass_hooks(
+		[this](VkCommandBuffer cmd, const char* name) {
+			_breadcrumbs.begin_pass(cmd, name);
+			_debugUtils.begin_label(cmd, name);
+			return _gpuProfiler.begin_scope(cmd, name);
+		},
+		[this](VkCommandBuffer cmd, uint32_t scope) {
+			_gpuProfiler.end_scope(cmd, scope);
+			_debugUtils.end_label(cmd);
+			_breadcrumbs.end_pass(cmd);
+		});
+	_frameGraph.set_object_namer([this](VkObjectType type, uint64_t handle, const char* name) {
+		_debugUtils.name(type, handle, name);
+	});
+	_mainDeletionQueue.push_function([=]() {
+		_frameGraph.cleanup();
+	});
 
 	// init command buffers
 	init_commands();
@@ -64,716 +212,10700 @@ void VulkanEngine::init()
 	// init structures to sync frame rendering with CPU
 	init_sync_structures();
 
-	// load shaders
+	// per-frame instance transforms, and the per-draw data of the path the pipelines get built for
+	choose_object_data_path();
+	init_instance_buffers();
+
+	// descriptor pools, the global set and the camera ring buffer
+	init_descriptors();
+	// texture array and material buffer shared by every draw
+	init_bindless();
+	// cascaded shadow map of the directional light
+	init_shadows();
+
+	// GPU timing queries, one set per frame in flight
+	_gpuProfiler.init(_device, _gpuProperties, _graphicsQueueTimestampBits, _frameOverlap,
+		_enablePipelineStatistics && _enabledFeatures.pipelineStatisticsQuery);
+	_mainDeletionQueue.push_function([=]() {
+		_gpuProfiler.cleanup();
+	});
+	// one predicate per scene slot, since those don't move when the render list is sorted
+	if (_useConditionalRendering && _conditionalRenderingSupported)
+	{
+		_occlusionPredicates.init(_device, _allocator, MAX_INSTANCES, _frameOverlap);
+		_mainDeletionQueue.push_function([=]() {
+			_occlusionPredicates.cleanup();
+		});
+	}
+	// markers around every pass, read back only if the device is lost
+	_breadcrumbs.init(_allocator, _frameOverlap, _bufferMarkerSupported ? _vkCmdWriteBufferMarker : nullptr);
+	_mainDeletionQueue.push_function([=]() {
+		_breadcrumbs.cleanup();
+	});
+	// picks come back through buffers of their own; the pipelines drawing them are built in init_pipelines
+	_objectPicker.init(_allocator, _frameOverlap);
+	_mainDeletionQueue.push_function([=]() {
+		_objectPicker.cleanup();
+	});
+	// the overlay draws into a window's swapchain; headless runs have nobody to show it to, and a display
+	// nothing to drive it with. Its pipeline is built with the others in init_pipelines
+	if (!_headless && _window != nullptr)
+	{
+		init_hud();
+	}
+	mark_startup("commands, sync and descriptors");
+
+	// load shaders; the graphics pipelines keep compiling on the workers until finish_pipelines()
 	init_pipelines();
+	init_cull_pipelines();
+	init_unpack_pipeline();
+	init_lights();
+	init_post_process();
+	init_shading_rate();
+	init_overdraw_view();
+	init_temporal_upscale();
+	init_scene_views();
+	init_readback();
+	init_video_encode();
+	// their modules belong to the registry; nothing looks them up by path after this
+	_preloadedShaders.clear();
+	mark_startup("shaders and compute pipelines");
+
+	// one set of geometry buffers for every mesh
+	// host-visible when meshes are written directly instead of staged; with ray shadows the acceleration
+	// structures are built straight from them
+	VkBufferUsageFlags meshPoolUsage = 0;
+#ifdef VK_KHR_ray_query
+	if (_useRayShadows)
+	{
+		meshPoolUsage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
+	}
+#endif
+	_meshPool.init(_allocator, _uploadMeshesToDeviceLocal ? VMA_MEMORY_USAGE_GPU_ONLY : VMA_MEMORY_USAGE_CPU_TO_GPU,
+		{ { sizeof(Vertex) }, { sizeof(PackedVertex) }, { sizeof(glm::vec3), sizeof(VertexAttributes) }, { sizeof(VoxelVertex) } }, MESH_POOL_VERTICES, MESH_POOL_INDICES_16, MESH_POOL_INDICES_32,
+		_gpuMemory.pool(MemoryPoolType::Mesh), meshPoolUsage);
+	_mainDeletionQueue.push_function([=]() {
+		_meshPool.cleanup();
+	});
+	init_meshlets();
+	init_vertex_pulling();
+	init_ray_shadows();
 
-	// load meshes into buffers
+	// load meshes into buffers; only the built-in ones are waited for, files stream in on the loader thread
 	load_meshes();
+	init_skinning();
+	load_textures();
+	mark_startup("mesh pool and asset requests");
+
+	// render objects point at the materials, which need the pipelines
+	finish_pipelines();
+	mark_startup("graphics pipelines");
+
+	// build the render-object list
+	init_scene();
+	mark_startup("scene");
+
+	// loading uploaded far more than any frame will; the first frame starts from zero
+	frame_stats::collect();
+
+	const double totalMs = std::chrono::duration<double, std::milli>(_startupMark - _startupStart).count();
+	{
+		logging::Line line(logging::Level::Info);
+		line.stream() << "Startup took " << totalMs << " ms:";
+		for (const auto& stage : _startupStages)
+		{
+			line.stream() << " " << stage.first << " " << stage.second << " ms" << (&stage != &_startupStages.back() ? "," : "");
+		}
+	}
+
+	if (_usePresentThread && !_headless)
+	{
+		_presentThread.init(_device, _graphicsQueue, _deviceContext->queueMutex, _frameOverlap);
+		_presentThread.start(_swapchain);
+	}
+
+	// scraped on a thread of its own from the first frame on
+	if (_metricsPort != 0)
+	{
+		_metrics.start(_metricsPort);
+	}
 	
 	// everything went fine
 	_isInitialized = true;
+	return true;
+}
+
+void VulkanEngine::cleanup_failed_init()
+{
+	LOG_ERROR("Engine startup failed");
+	// only init_vulkan and init_swapchain can fail, so this is all there is yet
+	if (_deviceContext)
+	{
+		_swapchainDeletionQueue.flush(_device, _allocator);
+		_mainDeletionQueue.flush(_device, _allocator);
+		_gpuMemory.cleanup();
+		if (_surface != VK_NULL_HANDLE)
+		{
+			vkDestroySurfaceKHR(_instance, _surface, nullptr);
+		}
+		release_device_context();
+	}
+	_jobSystem.cleanup();
+	_assetArchive.close();
+	if (_window != nullptr)
+	{
+		SDL_DestroyWindow(_window);
+		_window = nullptr;
+	}
+}
+
+SDL_Window* VulkanEngine::release_window()
+{
+	SDL_Window* window = _window;
+	_window = nullptr;
+	return window;
+}
+
+void VulkanEngine::mark_startup(const char* stage)
+{
+	const auto now = std::chrono::steady_clock::now();
+	_startupStages.push_back({ stage, std::chrono::duration<double, std::milli>(now - _startupMark).count() });
+	_startupMark = now;
+}
+
+static std::string device_uuid(VkPhysicalDevice device)
+{
+	VkPhysicalDeviceIDProperties idProperties = {};
+	idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+	VkPhysicalDeviceProperties2 properties2 = {};
+	properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties2.pNext = &idProperties;
+	vkGetPhysicalDeviceProperties2(device, &properties2);
+
+	static const char digits[] = "0123456789abcdef";
+	std::string uuid;
+	for (uint32_t i = 0; i < VK_UUID_SIZE; i++)
+	{
+		uuid += digits[idProperties.deviceUUID[i] >> 4];
+		uuid += digits[idProperties.deviceUUID[i] & 0xf];
+	}
+	return uuid;
+}
+
+static vkb::Result<vkb::PhysicalDevice> select_physical_device(VkInstance instance, const vkb::PhysicalDeviceSelector& selector, const GpuSelection& selection)
+{
+	// the first fully suitable device, else the last partially suitable one
+	if (selection.preference == GpuPreference::Default && selection.index < 0 && selection.uuid.empty())
+	{
+		return selector.select();
+	}
+
+	auto candidatesResult = selector.select_devices();
+	if (!candidatesResult)
+	{
+		return { candidatesResult.error(), candidatesResult.vk_result() };
+	}
+	const std::vector<vkb::PhysicalDevice> candidates = candidatesResult.value();
+	uint32_t deviceCount = 0;
+	vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+	std::vector<VkPhysicalDevice> devices(deviceCount);
+	vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
+
+	std::string wantedUuid;
+	for (char c : selection.uuid)
+	{
+		if (c != '-')
+		{
+			wantedUuid += static_cast<char>(tolower(static_cast<unsigned char>(c)));
+		}
+	}
+	const VkPhysicalDeviceType wantedType = selection.preference == GpuPreference::Discrete ? VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU
+		: VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU;
+
+	const vkb::PhysicalDevice* byUuid = nullptr;
+	const vkb::PhysicalDevice* byIndex = nullptr;
+	const vkb::PhysicalDevice* byType = nullptr;
+	for (const vkb::PhysicalDevice& candidate : candidates)
+	{
+		const size_t index = std::find(devices.begin(), devices.end(), candidate.physical_device) - devices.begin();
+		const std::string uuid = device_uuid(candidate.physical_device);
+		LOG_INFO("GPU " << index << ": " << candidate.properties.deviceName << ", UUID " << uuid);
+
+		if (!wantedUuid.empty() && uuid == wantedUuid && byUuid == nullptr)
+		{
+			byUuid = &candidate;
+		}
+		if (selection.index >= 0 && index == static_cast<size_t>(selection.index))
+		{
+			byIndex = &candidate;
+		}
+		if (selection.preference != GpuPreference::Default && candidate.properties.deviceType == wantedType && byType == nullptr)
+		{
+			byType = &candidate;
+		}
+	}
+
+	if (byUuid != nullptr) return *byUuid;
+	if (byIndex != nullptr) return *byIndex;
+	if (!wantedUuid.empty() || selection.index >= 0)
+	{
+		LOG_WARN("No suitable GPU matches the one asked for, choosing another");
+	}
+	if (byType != nullptr) return *byType;
+	return selector.select();
+}
+
+bool VulkanEngine::init_vulkan()
+{
+	CPU_PROFILE_SCOPE("init_vulkan");
+	if (_deviceContext)
+	{
+		attach_device_context();
+	}
+	else if (!create_device_context())
+	{
+		return false;
+	}
+
+	vkGetPhysicalDeviceProperties(_chosenGPU, &_gpuProperties);
+	// before anything sized by the frames in flight or MSAA
+	apply_tuning();
+
+	// the depth pyramid is built by sampling the depth buffer, which D32_SFLOAT isn't required to allow
+	VkFormatProperties depthFormatProperties;
+	vkGetPhysicalDeviceFormatProperties(_chosenGPU, VK_FORMAT_D32_SFLOAT, &depthFormatProperties);
+	_occlusionCullingSupported = (depthFormatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+
+	// the highest count up to the requested one that color and depth attachments both allow
+	const VkSampleCountFlags msaaCounts = _gpuProperties.limits.framebufferColorSampleCounts & _gpuProperties.limits.framebufferDepthSampleCounts;
+	while (_msaaSamples > VK_SAMPLE_COUNT_1_BIT && (msaaCounts & _msaaSamples) == 0)
+	{
+		_msaaSamples = static_cast<VkSampleCountFlagBits>(_msaaSamples >> 1);
+	}
+	// the pyramid is reduced from single-sampled depth, and resolving depth isn't worth it for culling
+	_occlusionCullingSupported = _occlusionCullingSupported && _msaaSamples == VK_SAMPLE_COUNT_1_BIT;
+	LOG_INFO("MSAA: " << _msaaSamples << "x");
+
+	// the graphics submit waits for the culling on a timeline value
+	if (_useAsyncCompute && !(_asyncComputeSupported && _timelineSemaphoresSupported))
+	{
+		LOG_WARN("Async compute needs a compute queue family without graphics and timeline semaphores, culling stays on the graphics queue");
+		_useAsyncCompute = false;
+	}
+	else if (_useAsyncCompute)
+	{
+		LOG_INFO("Culling on compute queue family " << _computeQueueFamily);
+	}
+
+	// the mesh pool's memory type depends on how meshes are uploaded
+	_gpuMemory.init(_allocator, _uploadMeshesToDeviceLocal ? VMA_MEMORY_USAGE_GPU_ONLY : VMA_MEMORY_USAGE_CPU_TO_GPU);
+	if (_pageableMemorySupported)
+	{
+		_gpuMemory.enable_priorities(_device);
+	}
+	_useResizableBar = _useResizableBar && _gpuMemory.resizable_bar();
+	LOG_INFO("Memory budget " << (_memoryBudgetSupported ? "from VK_EXT_memory_budget" : "estimated by VMA")
+		<< (_gpuMemory.priorities_enabled() ? ", residency priorities through VK_EXT_pageable_device_local_memory" : "")
+		<< ", " << _gpuMemory.bar_size() / (1024 * 1024) << " MiB of host-visible device-local memory"
+		<< (_useResizableBar ? ", per-frame data written there directly" : ", per-frame data staged"));
+	return true;
+}
+
+// validation messages through the log; not rate limited, as the one call site would hide distinct messages behind
+// a repeating one
+static VKAPI_ATTR VkBool32 VKAPI_CALL log_validation_message(VkDebugUtilsMessageSeverityFlagBitsEXT severity,
+	VkDebugUtilsMessageTypeFlagsEXT, const VkDebugUtilsMessengerCallbackDataEXT* data, void*)
+{
+	const logging::Level level = severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT ? logging::Level::Error
+		: severity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT ? logging::Level::Warn : logging::Level::Debug;
+	LOG_AT(level, "Validation: " << data->pMessage);
+	return VK_FALSE;
 }
 
-void VulkanEngine::init_vulkan()
+bool VulkanEngine::create_device_context()
 {
 	// tool from the VkBootstrap library, simplifies the creation of a VkInstance
 	vkb::InstanceBuilder builder;
 
 	// make Vulkan instance with basic debug features
-	auto inst_ret = builder.set_app_name("QC Engine")
-		.request_validation_layers(true)
+	builder.set_app_name("QC Engine")
+		.request_validation_layers(_useValidationLayers)
 		.require_api_version(1, 1, 0)
-		.use_default_debug_messenger()
-		.build();
+		.set_headless(_headless);
+	if (_useValidationLayers)
+	{
+		builder.set_debug_callback(log_validation_message);
+	}
+	// names and labels for capture tools, which expose the extension whether validation is on or not;
+	// the debug messenger enables it by itself
+	auto systemInfo = vkb::SystemInfo::get_system_info();
+	_debugUtilsSupported = systemInfo && systemInfo.value().debug_utils_available;
+	if (_debugUtilsSupported && !_useValidationLayers)
+	{
+		builder.enable_extension(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+	}
+	if (_displayIndex >= 0)
+	{
+		if (!systemInfo || !systemInfo.value().is_extension_available(VK_KHR_DISPLAY_EXTENSION_NAME))
+		{
+			LOG_ERROR("The Vulkan loader has no " << VK_KHR_DISPLAY_EXTENSION_NAME << ", so there is no presenting straight to a display");
+			return false;
+		}
+		builder.enable_extension(VK_KHR_DISPLAY_EXTENSION_NAME);
+	}
+	// what VK_EXT_full_screen_exclusive's surface queries are made through
+	if (_useFullScreenExclusive && !(FullScreenExclusive::compiled() && systemInfo
+		&& systemInfo.value().is_extension_available(FullScreenExclusive::instance_extension())))
+	{
+		LOG_WARN("Exclusive fullscreen needs a Windows build and VK_KHR_get_surface_capabilities2, using a plain fullscreen window");
+		_useFullScreenExclusive = false;
+	}
+	else if (_useFullScreenExclusive)
+	{
+		builder.enable_extension(FullScreenExclusive::instance_extension());
+	}
+	auto inst_ret = builder.build();
+	if (!inst_ret)
+	{
+		LOG_ERROR("Failed to create a Vulkan instance: " << inst_ret.error().message());
+		return false;
+	}
+
+	vkb::Instance vkb_inst = inst_ret.value();
+
+	// store these so we can release them at program exit
+	_instance = vkb_inst.instance;
+	_debug_messenger = vkb_inst.debug_messenger;
+
+	// everything up to here goes again when a later step fails, so a caller can retry or give up cleanly
+	auto abandon = [this](const char* what, const std::string& reason) {
+		LOG_ERROR(what << ": " << reason);
+		if (_surface != VK_NULL_HANDLE)
+		{
+			vkDestroySurfaceKHR(_instance, _surface, nullptr);
+			_surface = VK_NULL_HANDLE;
+		}
+		vkb::destroy_debug_utils_messenger(_instance, _debug_messenger);
+		vkDestroyInstance(_instance, nullptr);
+		_instance = VK_NULL_HANDLE;
+		return false;
+	};
+
+	// get the surface of the window we opened with SDL in init(), or of the display
+	if (_displayIndex >= 0)
+	{
+		if (!_directDisplay.create_surface(_instance, static_cast<uint32_t>(_displayIndex), &_surface))
+		{
+			return abandon("Failed to create a display surface", "display " + std::to_string(_displayIndex));
+		}
+	}
+	else if (!_headless && !SDL_Vulkan_CreateSurface(_window, _instance, &_surface))
+	{
+		return abandon("Failed to create a window surface", SDL_GetError());
+	}
+
+	// use vkbootstrap to select a GPU compatible with our SDL surface and Vulkan version; headless, any
+	// GPU that can render will do
+	vkb::PhysicalDeviceSelector selector{ vkb_inst };
+	selector.set_minimum_version(1, 1);
+	if (_headless)
+	{
+		selector.require_present(false);
+	}
+	else
+	{
+		selector.set_surface(_surface);
+	}
+	selector
+		.add_desired_extension(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)
+		.add_desired_extension(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)
+		.add_desired_extension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)
+		.add_desired_extension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+#ifdef VK_EXT_pageable_device_local_memory
+	selector
+		.add_desired_extension(VK_EXT_MEMORY_PRIORITY_EXTENSION_NAME)
+		.add_desired_extension(VK_EXT_PAGEABLE_DEVICE_LOCAL_MEMORY_EXTENSION_NAME);
+#endif
+#ifdef VK_KHR_synchronization2
+	selector.add_desired_extension(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+#endif
+#ifdef VK_AMD_buffer_marker
+	selector.add_desired_extension(VK_AMD_BUFFER_MARKER_EXTENSION_NAME);
+#endif
+	if (_useFullScreenExclusive)
+	{
+		selector.add_desired_extension(FullScreenExclusive::device_extension());
+	}
+#ifdef VK_KHR_present_wait
+	if (!_headless)
+	{
+		selector
+			.add_desired_extension(VK_KHR_PRESENT_ID_EXTENSION_NAME)
+			.add_desired_extension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+	}
+#endif
+	if (!_headless)
+	{
+		selector.add_desired_extension(DisplayTiming::device_extension());
+	}
+#ifdef VK_KHR_dynamic_rendering
+	// core in 1.3; on 1.1 it also needs depth/stencil resolve, which needs render pass 2
+	selector
+		.add_desired_extension(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME)
+		.add_desired_extension(VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME)
+		.add_desired_extension(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
+#endif
+#ifdef VK_EXT_mesh_shader
+	// mesh shaders are SPIR-V 1.4, which needs float controls on a 1.1 device
+	selector
+		.add_desired_extension(VK_EXT_MESH_SHADER_EXTENSION_NAME)
+		.add_desired_extension(VK_KHR_SPIRV_1_4_EXTENSION_NAME)
+		.add_desired_extension(VK_KHR_SHADER_FLOAT_CONTROLS_EXTENSION_NAME);
+#endif
+#ifdef VK_EXT_extended_dynamic_state
+	selector.add_desired_extension(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+#endif
+#ifdef VK_EXT_graphics_pipeline_library
+	selector
+		.add_desired_extension(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME)
+		.add_desired_extension(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+#endif
+#ifdef VK_KHR_fragment_shading_rate
+	// on 1.1 it needs render pass 2 as well, which dynamic rendering asks for above
+	if (_useShadingRate)
+	{
+		selector.add_desired_extension(VK_KHR_FRAGMENT_SHADING_RATE_EXTENSION_NAME);
+	}
+#endif
+#ifdef VK_KHR_ray_query
+	// on 1.1 acceleration structures need deferred host operations and buffer device addresses, and ray
+	// queries SPIR-V 1.4, which needs float controls; descriptor indexing is asked for above
+	if (_useRayShadows)
+	{
+		selector
+			.add_desired_extension(VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME)
+			.add_desired_extension(VK_KHR_RAY_QUERY_EXTENSION_NAME)
+			.add_desired_extension(VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME)
+			.add_desired_extension(VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME)
+			.add_desired_extension(VK_KHR_SPIRV_1_4_EXTENSION_NAME)
+			.add_desired_extension(VK_KHR_SHADER_FLOAT_CONTROLS_EXTENSION_NAME);
+	}
+#endif
+#ifdef VK_EXT_conditional_rendering
+	if (_useConditionalRendering)
+	{
+		selector.add_desired_extension(VK_EXT_CONDITIONAL_RENDERING_EXTENSION_NAME);
+	}
+#endif
+#ifdef VK_KHR_video_encode_h264
+	if (_useVideoEncode)
+	{
+		selector
+			.add_desired_extension(VK_KHR_VIDEO_QUEUE_EXTENSION_NAME)
+			.add_desired_extension(VK_KHR_VIDEO_ENCODE_QUEUE_EXTENSION_NAME)
+			.add_desired_extension(VK_KHR_VIDEO_ENCODE_H264_EXTENSION_NAME);
+	}
+#endif
+	// half-precision arithmetic for the shaders with a .half.spv build
+	if (_useHalfPrecision)
+	{
+		selector.add_desired_extension(VK_KHR_SHADER_FLOAT16_INT8_EXTENSION_NAME);
+	}
+#ifdef VK_KHR_pipeline_executable_properties
+	// drivers may compile slower with the feature on, so only when asked for
+	if (_captureShaderStatistics)
+	{
+		selector.add_desired_extension(VK_KHR_PIPELINE_EXECUTABLE_PROPERTIES_EXTENSION_NAME);
+	}
+#endif
+	auto physicalResult = select_physical_device(_instance, selector, _gpuSelection);
+	if (!physicalResult)
+	{
+		return abandon("No suitable GPU", physicalResult.error().message());
+	}
+	vkb::PhysicalDevice physicalDevice = physicalResult.value();
+
+	// vk-bootstrap enables desired extensions silently, so check for ourselves which ones made it
+	bool descriptorIndexingSupported = false;
+	uint32_t meshShadingExtensions = 0;
+	uint32_t dynamicRenderingExtensions = 0;
+	uint32_t presentWaitExtensions = 0;
+	uint32_t pageableMemoryExtensions = 0;
+	uint32_t pipelineLibraryExtensions = 0;
+	uint32_t shadingRateExtensions = 0;
+	uint32_t videoEncodeExtensions = 0;
+	uint32_t rayQueryExtensions = 0;
+	bool conditionalRenderingExtension = false;
+	bool float16Extension = false;
+	bool fullScreenExclusiveExtension = false;
+	bool displayTimingExtension = false;
+	uint32_t extensionCount = 0;
+	vkEnumerateDeviceExtensionProperties(physicalDevice.physical_device, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> extensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(physicalDevice.physical_device, nullptr, &extensionCount, extensions.data());
+	for (const VkExtensionProperties& extension : extensions)
+	{
+		if (strcmp(extension.extensionName, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0)
+		{
+			_drawIndirectCountSupported = true;
+		}
+		if (strcmp(extension.extensionName, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) == 0)
+		{
+			_timelineSemaphoresSupported = true;
+		}
+		if (strcmp(extension.extensionName, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0)
+		{
+			descriptorIndexingSupported = true;
+		}
+		if (strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0)
+		{
+			_memoryBudgetSupported = true;
+		}
+		if (strcmp(extension.extensionName, VK_KHR_SHADER_FLOAT16_INT8_EXTENSION_NAME) == 0)
+		{
+			float16Extension = true;
+		}
+		if (_useFullScreenExclusive && strcmp(extension.extensionName, FullScreenExclusive::device_extension()) == 0)
+		{
+			fullScreenExclusiveExtension = true;
+		}
+		if (strcmp(extension.extensionName, DisplayTiming::device_extension()) == 0)
+		{
+			displayTimingExtension = true;
+		}
+#ifdef VK_KHR_synchronization2
+		if (strcmp(extension.extensionName, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME) == 0)
+		{
+			_synchronization2Supported = true;
+		}
+#endif
+#ifdef VK_AMD_buffer_marker
+		if (strcmp(extension.extensionName, VK_AMD_BUFFER_MARKER_EXTENSION_NAME) == 0)
+		{
+			_bufferMarkerSupported = true;
+		}
+#endif
+#ifdef VK_EXT_pageable_device_local_memory
+		if (strcmp(extension.extensionName, VK_EXT_MEMORY_PRIORITY_EXTENSION_NAME) == 0
+			|| strcmp(extension.extensionName, VK_EXT_PAGEABLE_DEVICE_LOCAL_MEMORY_EXTENSION_NAME) == 0)
+		{
+			pageableMemoryExtensions++;
+		}
+#endif
+#ifdef VK_KHR_present_wait
+		if (strcmp(extension.extensionName, VK_KHR_PRESENT_ID_EXTENSION_NAME) == 0
+			|| strcmp(extension.extensionName, VK_KHR_PRESENT_WAIT_EXTENSION_NAME) == 0)
+		{
+			presentWaitExtensions++;
+		}
+#endif
+#ifdef VK_KHR_dynamic_rendering
+		if (strcmp(extension.extensionName, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) == 0
+			|| strcmp(extension.extensionName, VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME) == 0
+			|| strcmp(extension.extensionName, VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME) == 0)
+		{
+			dynamicRenderingExtensions++;
+		}
+#endif
+#ifdef VK_EXT_mesh_shader
+		if (strcmp(extension.extensionName, VK_EXT_MESH_SHADER_EXTENSION_NAME) == 0
+			|| strcmp(extension.extensionName, VK_KHR_SPIRV_1_4_EXTENSION_NAME) == 0
+			|| strcmp(extension.extensionName, VK_KHR_SHADER_FLOAT_CONTROLS_EXTENSION_NAME) == 0)
+		{
+			meshShadingExtensions++;
+		}
+#endif
+#ifdef VK_EXT_extended_dynamic_state
+		if (strcmp(extension.extensionName, VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME) == 0)
+		{
+			_extendedDynamicStateSupported = true;
+		}
+#endif
+#ifdef VK_EXT_graphics_pipeline_library
+		if (strcmp(extension.extensionName, VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) == 0
+			|| strcmp(extension.extensionName, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME) == 0)
+		{
+			pipelineLibraryExtensions++;
+		}
+#endif
+#ifdef VK_KHR_fragment_shading_rate
+		if (strcmp(extension.extensionName, VK_KHR_FRAGMENT_SHADING_RATE_EXTENSION_NAME) == 0
+			|| strcmp(extension.extensionName, VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME) == 0)
+		{
+			shadingRateExtensions++;
+		}
+#endif
+#ifdef VK_KHR_video_encode_h264
+		if (strcmp(extension.extensionName, VK_KHR_VIDEO_QUEUE_EXTENSION_NAME) == 0
+			|| strcmp(extension.extensionName, VK_KHR_VIDEO_ENCODE_QUEUE_EXTENSION_NAME) == 0
+			|| strcmp(extension.extensionName, VK_KHR_VIDEO_ENCODE_H264_EXTENSION_NAME) == 0)
+		{
+			videoEncodeExtensions++;
+		}
+#endif
+#ifdef VK_EXT_conditional_rendering
+		if (strcmp(extension.extensionName, VK_EXT_CONDITIONAL_RENDERING_EXTENSION_NAME) == 0)
+		{
+			conditionalRenderingExtension = true;
+		}
+#endif
+#ifdef VK_KHR_ray_query
+		if (strcmp(extension.extensionName, VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME) == 0
+			|| strcmp(extension.extensionName, VK_KHR_RAY_QUERY_EXTENSION_NAME) == 0
+			|| strcmp(extension.extensionName, VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME) == 0
+			|| strcmp(extension.extensionName, VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME) == 0
+			|| strcmp(extension.extensionName, VK_KHR_SPIRV_1_4_EXTENSION_NAME) == 0
+			|| strcmp(extension.extensionName, VK_KHR_SHADER_FLOAT_CONTROLS_EXTENSION_NAME) == 0)
+		{
+			rayQueryExtensions++;
+		}
+#endif
+#ifdef VK_KHR_pipeline_executable_properties
+		if (strcmp(extension.extensionName, VK_KHR_PIPELINE_EXECUTABLE_PROPERTIES_EXTENSION_NAME) == 0)
+		{
+			_executablePropertiesSupported = true;
+		}
+#endif
+	}
+
+	// the extensions alone aren't enough, their features have to be enabled too
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT supportedIndexing = {};
+	supportedIndexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+#ifdef VK_EXT_mesh_shader
+	VkPhysicalDeviceMeshShaderFeaturesEXT supportedMeshShading = {};
+	supportedMeshShading.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+	supportedIndexing.pNext = &supportedMeshShading;
+#endif
+#ifdef VK_KHR_dynamic_rendering
+	VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures = {};
+	dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+	dynamicRenderingFeatures.pNext = supportedIndexing.pNext;
+	supportedIndexing.pNext = &dynamicRenderingFeatures;
+#endif
+#ifdef VK_KHR_synchronization2
+	VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features = {};
+	synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+	synchronization2Features.pNext = supportedIndexing.pNext;
+	supportedIndexing.pNext = &synchronization2Features;
+#endif
+#ifdef VK_KHR_present_wait
+	VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {};
+	presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+	VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {};
+	presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+	presentWaitFeatures.pNext = supportedIndexing.pNext;
+	presentIdFeatures.pNext = &presentWaitFeatures;
+	supportedIndexing.pNext = &presentIdFeatures;
+#endif
+#ifdef VK_EXT_pageable_device_local_memory
+	VkPhysicalDeviceMemoryPriorityFeaturesEXT memoryPriorityFeatures = {};
+	memoryPriorityFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PRIORITY_FEATURES_EXT;
+	VkPhysicalDevicePageableDeviceLocalMemoryFeaturesEXT pageableMemoryFeatures = {};
+	pageableMemoryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PAGEABLE_DEVICE_LOCAL_MEMORY_FEATURES_EXT;
+	pageableMemoryFeatures.pNext = supportedIndexing.pNext;
+	memoryPriorityFeatures.pNext = &pageableMemoryFeatures;
+	supportedIndexing.pNext = &memoryPriorityFeatures;
+#endif
+#ifdef VK_EXT_extended_dynamic_state
+	VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures = {};
+	extendedDynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+	extendedDynamicStateFeatures.pNext = supportedIndexing.pNext;
+	supportedIndexing.pNext = &extendedDynamicStateFeatures;
+#endif
+#ifdef VK_EXT_graphics_pipeline_library
+	VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipelineLibraryFeatures = {};
+	pipelineLibraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+	pipelineLibraryFeatures.pNext = supportedIndexing.pNext;
+	supportedIndexing.pNext = &pipelineLibraryFeatures;
+#endif
+#ifdef VK_KHR_fragment_shading_rate
+	VkPhysicalDeviceFragmentShadingRateFeaturesKHR shadingRateFeatures = {};
+	shadingRateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FRAGMENT_SHADING_RATE_FEATURES_KHR;
+	shadingRateFeatures.pNext = supportedIndexing.pNext;
+	supportedIndexing.pNext = &shadingRateFeatures;
+#endif
+#ifdef VK_KHR_ray_query
+	VkPhysicalDeviceBufferDeviceAddressFeaturesKHR bufferAddressFeatures = {};
+	bufferAddressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES_KHR;
+	VkPhysicalDeviceAccelerationStructureFeaturesKHR accelerationStructureFeatures = {};
+	accelerationStructureFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR;
+	VkPhysicalDeviceRayQueryFeaturesKHR rayQueryFeatures = {};
+	rayQueryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_QUERY_FEATURES_KHR;
+	rayQueryFeatures.pNext = supportedIndexing.pNext;
+	accelerationStructureFeatures.pNext = &rayQueryFeatures;
+	bufferAddressFeatures.pNext = &accelerationStructureFeatures;
+	supportedIndexing.pNext = &bufferAddressFeatures;
+#endif
+#ifdef VK_EXT_conditional_rendering
+	VkPhysicalDeviceConditionalRenderingFeaturesEXT conditionalRenderingFeatures = {};
+	conditionalRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_CONDITIONAL_RENDERING_FEATURES_EXT;
+	conditionalRenderingFeatures.pNext = supportedIndexing.pNext;
+	supportedIndexing.pNext = &conditionalRenderingFeatures;
+#endif
+#ifdef VK_KHR_pipeline_executable_properties
+	VkPhysicalDevicePipelineExecutablePropertiesFeaturesKHR executablePropertiesFeatures = {};
+	executablePropertiesFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_EXECUTABLE_PROPERTIES_FEATURES_KHR;
+	executablePropertiesFeatures.pNext = supportedIndexing.pNext;
+	supportedIndexing.pNext = &executablePropertiesFeatures;
+#endif
+	// VK_KHR_multiview is core in 1.1, so only the feature is asked for
+	VkPhysicalDeviceMultiviewFeatures multiviewFeatures = {};
+	multiviewFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES;
+	multiviewFeatures.pNext = supportedIndexing.pNext;
+	supportedIndexing.pNext = &multiviewFeatures;
+	// VK_KHR_16bit_storage is core in 1.1 as well
+	VkPhysicalDevice16BitStorageFeatures storage16Features = {};
+	storage16Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_16BIT_STORAGE_FEATURES;
+	storage16Features.pNext = supportedIndexing.pNext;
+	supportedIndexing.pNext = &storage16Features;
+	VkPhysicalDeviceShaderFloat16Int8FeaturesKHR float16Features = {};
+	float16Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_FLOAT16_INT8_FEATURES_KHR;
+	float16Features.pNext = supportedIndexing.pNext;
+	supportedIndexing.pNext = &float16Features;
+	{
+		timelineFeatures.pNext = &supportedIndexing;
+		VkPhysicalDeviceFeatures2 features2 = {};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &timelineFeatures;
+		vkGetPhysicalDeviceFeatures2(physicalDevice.physical_device, &features2);
+		timelineFeatures.pNext = nullptr;
+		supportedIndexing.pNext = nullptr;
+		_timelineSemaphoresSupported = _timelineSemaphoresSupported && timelineFeatures.timelineSemaphore == VK_TRUE;
+	}
+#ifdef VK_KHR_dynamic_rendering
+	dynamicRenderingFeatures.pNext = nullptr;
+	_dynamicRenderingSupported = dynamicRenderingExtensions == 3 && dynamicRenderingFeatures.dynamicRendering == VK_TRUE;
+#endif
+#ifdef VK_KHR_synchronization2
+	synchronization2Features.pNext = nullptr;
+	_synchronization2Supported = _synchronization2Supported && synchronization2Features.synchronization2 == VK_TRUE;
+#endif
+#ifdef VK_KHR_present_wait
+	presentIdFeatures.pNext = nullptr;
+	presentWaitFeatures.pNext = nullptr;
+	_presentWaitSupported = !_headless && presentWaitExtensions == 2 && presentIdFeatures.presentId == VK_TRUE
+		&& presentWaitFeatures.presentWait == VK_TRUE;
+#endif
+	_displayTimingSupported = !_headless && displayTimingExtension;
+#ifdef VK_EXT_pageable_device_local_memory
+	memoryPriorityFeatures.pNext = nullptr;
+	pageableMemoryFeatures.pNext = nullptr;
+	_pageableMemorySupported = pageableMemoryExtensions == 2 && memoryPriorityFeatures.memoryPriority == VK_TRUE
+		&& pageableMemoryFeatures.pageableDeviceLocalMemory == VK_TRUE;
+#endif
+#ifdef VK_EXT_extended_dynamic_state
+	extendedDynamicStateFeatures.pNext = nullptr;
+	_extendedDynamicStateSupported = _extendedDynamicStateSupported && extendedDynamicStateFeatures.extendedDynamicState == VK_TRUE;
+#endif
+#ifdef VK_EXT_graphics_pipeline_library
+	pipelineLibraryFeatures.pNext = nullptr;
+	_pipelineLibrariesSupported = pipelineLibraryExtensions == 2 && pipelineLibraryFeatures.graphicsPipelineLibrary == VK_TRUE;
+	if (_pipelineLibrariesSupported)
+	{
+		// without fast linking a link costs about as much as a compile, and the libraries only add work
+		VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT pipelineLibraryProperties = {};
+		pipelineLibraryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT;
+		VkPhysicalDeviceProperties2 properties2 = {};
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties2.pNext = &pipelineLibraryProperties;
+		vkGetPhysicalDeviceProperties2(physicalDevice.physical_device, &properties2);
+		_pipelineLibrariesSupported = pipelineLibraryProperties.graphicsPipelineLibraryFastLinking == VK_TRUE;
+	}
+#endif
+#ifdef VK_KHR_fragment_shading_rate
+	// per-draw rates and the attachment; per-primitive rates would need the shaders to write them
+	shadingRateFeatures.pNext = nullptr;
+	shadingRateFeatures.primitiveFragmentShadingRate = VK_FALSE;
+	_shadingRateSupported = shadingRateExtensions == 2 && shadingRateFeatures.pipelineFragmentShadingRate == VK_TRUE;
+	_shadingRateAttachmentSupported = _shadingRateSupported && shadingRateFeatures.attachmentFragmentShadingRate == VK_TRUE;
+#endif
+#ifdef VK_KHR_video_encode_h264
+	// which queue family encodes, and at what sizes, the encoder finds out for itself
+	_videoEncodeSupported = videoEncodeExtensions == 3;
+#endif
+#ifdef VK_KHR_ray_query
+	// device builds and shader queries only: no capture and replay, indirect or host builds
+	bufferAddressFeatures.pNext = nullptr;
+	accelerationStructureFeatures.pNext = nullptr;
+	rayQueryFeatures.pNext = nullptr;
+	bufferAddressFeatures.bufferDeviceAddressCaptureReplay = VK_FALSE;
+	bufferAddressFeatures.bufferDeviceAddressMultiDevice = VK_FALSE;
+	accelerationStructureFeatures.accelerationStructureCaptureReplay = VK_FALSE;
+	accelerationStructureFeatures.accelerationStructureIndirectBuild = VK_FALSE;
+	accelerationStructureFeatures.accelerationStructureHostCommands = VK_FALSE;
+	accelerationStructureFeatures.descriptorBindingAccelerationStructureUpdateAfterBind = VK_FALSE;
+	_rayQuerySupported = rayQueryExtensions == 6 && descriptorIndexingSupported && bufferAddressFeatures.bufferDeviceAddress == VK_TRUE
+		&& accelerationStructureFeatures.accelerationStructure == VK_TRUE && rayQueryFeatures.rayQuery == VK_TRUE;
+#endif
+#ifdef VK_EXT_conditional_rendering
+	// predicates begin and end inside the secondaries that draw, so none is ever inherited
+	conditionalRenderingFeatures.pNext = nullptr;
+	conditionalRenderingFeatures.inheritedConditionalRendering = VK_FALSE;
+	_conditionalRenderingSupported = conditionalRenderingExtension && conditionalRenderingFeatures.conditionalRendering == VK_TRUE;
+#endif
+#ifdef VK_KHR_pipeline_executable_properties
+	executablePropertiesFeatures.pNext = nullptr;
+	_executablePropertiesSupported = _executablePropertiesSupported && executablePropertiesFeatures.pipelineExecutableInfo == VK_TRUE;
+#endif
+	// views in the raster passes only; no geometry or tessellation stages draw into them
+	multiviewFeatures.pNext = nullptr;
+	multiviewFeatures.multiviewGeometryShader = VK_FALSE;
+	multiviewFeatures.multiviewTessellationShader = VK_FALSE;
+	_multiviewSupported = multiviewFeatures.multiview == VK_TRUE;
+	// 16-bit members of storage and uniform buffers; push constants and stage interfaces stay 32-bit
+	storage16Features.pNext = nullptr;
+	storage16Features.storagePushConstant16 = VK_FALSE;
+	storage16Features.storageInputOutput16 = VK_FALSE;
+	const bool storage16Supported = storage16Features.storageBuffer16BitAccess == VK_TRUE
+		&& storage16Features.uniformAndStorageBuffer16BitAccess == VK_TRUE;
+	// float16_t arithmetic; the int8 half of the extension isn't used
+	float16Features.pNext = nullptr;
+	float16Features.shaderInt8 = VK_FALSE;
+	const bool float16Supported = float16Extension && float16Features.shaderFloat16 == VK_TRUE;
+	_halfPrecisionSupported = float16Supported && _useHalfPrecision;
+
+	// bindless needs a partially bound, runtime-sized texture array that can be updated after binding
+	// and indexed non-uniformly; only those bits get enabled
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	indexingFeatures.shaderSampledImageArrayNonUniformIndexing = supportedIndexing.shaderSampledImageArrayNonUniformIndexing;
+	indexingFeatures.runtimeDescriptorArray = supportedIndexing.runtimeDescriptorArray;
+	indexingFeatures.descriptorBindingPartiallyBound = supportedIndexing.descriptorBindingPartiallyBound;
+	indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = supportedIndexing.descriptorBindingSampledImageUpdateAfterBind;
+	_useBindless = _useBindless && descriptorIndexingSupported
+		&& indexingFeatures.shaderSampledImageArrayNonUniformIndexing && indexingFeatures.runtimeDescriptorArray
+		&& indexingFeatures.descriptorBindingPartiallyBound && indexingFeatures.descriptorBindingSampledImageUpdateAfterBind;
+
+	// the meshlet pipeline needs task and mesh shaders and nothing else from the extension; it shares
+	// the bindless fragment shader, so it's only used together with bindless
+#ifdef VK_EXT_mesh_shader
+	VkPhysicalDeviceMeshShaderFeaturesEXT meshShadingFeatures = {};
+	meshShadingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+	meshShadingFeatures.taskShader = supportedMeshShading.taskShader;
+	meshShadingFeatures.meshShader = supportedMeshShading.meshShader;
+	_meshShadingSupported = meshShadingExtensions == 3 && _useBindless
+		&& meshShadingFeatures.taskShader && meshShadingFeatures.meshShader;
+#endif
+
+	// optional features: turn on whatever the chosen GPU supports
+	// vk-bootstrap enables exactly the features stored in physicalDevice.features
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(physicalDevice.physical_device, &supportedFeatures);
+	physicalDevice.features.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+	// indirect draws: several records per call, and a non-zero firstInstance to find each object's transform
+	physicalDevice.features.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+	physicalDevice.features.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+	// BC1/BC3 textures from the texture cache; without it textures are uploaded as rgba8
+	physicalDevice.features.textureCompressionBC = supportedFeatures.textureCompressionBC;
+	// secondary command buffers executed while the pipeline statistics query is active
+	physicalDevice.features.inheritedQueries = supportedFeatures.inheritedQueries;
+	// virtual texture feedback is written from fragment shaders
+	physicalDevice.features.fragmentStoresAndAtomics = supportedFeatures.fragmentStoresAndAtomics;
+	_enabledFeatures = physicalDevice.features;
+
+	// what the device could run, whatever the settings turn on; picks the render path in load_device_functions
+	VkPhysicalDeviceSubgroupProperties subgroupProperties = {};
+	subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+	VkPhysicalDeviceProperties2 properties2 = {};
+	properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties2.pNext = &subgroupProperties;
+	vkGetPhysicalDeviceProperties2(physicalDevice.physical_device, &properties2);
+	_capabilities = {};
+	_capabilities.multiDrawIndirect = supportedFeatures.multiDrawIndirect == VK_TRUE;
+	_capabilities.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance == VK_TRUE;
+	_capabilities.drawIndirectCount = _drawIndirectCountSupported;
+	_capabilities.bindless = descriptorIndexingSupported
+		&& indexingFeatures.shaderSampledImageArrayNonUniformIndexing && indexingFeatures.runtimeDescriptorArray
+		&& indexingFeatures.descriptorBindingPartiallyBound && indexingFeatures.descriptorBindingSampledImageUpdateAfterBind;
+#ifdef VK_EXT_mesh_shader
+	_capabilities.meshShading = meshShadingExtensions == 3 && supportedMeshShading.taskShader && supportedMeshShading.meshShader;
+#endif
+	_capabilities.dynamicRendering = _dynamicRenderingSupported;
+	_capabilities.timelineSemaphores = _timelineSemaphoresSupported;
+	_capabilities.storage16Bit = storage16Supported;
+	_capabilities.float16 = float16Supported;
+	_capabilities.subgroupSize = subgroupProperties.subgroupSize;
+	_capabilities.subgroupOperations = subgroupProperties.supportedOperations;
+	_capabilities.subgroupStages = subgroupProperties.supportedStages;
+
+	// create Vulkan device
+	vkb::DeviceBuilder deviceBuilder{ physicalDevice };
+	if (_timelineSemaphoresSupported)
+	{
+		deviceBuilder.add_pNext(&timelineFeatures);
+	}
+	if (_useBindless)
+	{
+		deviceBuilder.add_pNext(&indexingFeatures);
+	}
+#ifdef VK_EXT_mesh_shader
+	if (_meshShadingSupported)
+	{
+		deviceBuilder.add_pNext(&meshShadingFeatures);
+	}
+#endif
+#ifdef VK_KHR_dynamic_rendering
+	if (_dynamicRenderingSupported && _useDynamicRendering)
+	{
+		deviceBuilder.add_pNext(&dynamicRenderingFeatures);
+	}
+#endif
+#ifdef VK_KHR_synchronization2
+	if (_synchronization2Supported)
+	{
+		deviceBuilder.add_pNext(&synchronization2Features);
+	}
+#endif
+#ifdef VK_EXT_pageable_device_local_memory
+	if (_pageableMemorySupported)
+	{
+		deviceBuilder.add_pNext(&memoryPriorityFeatures);
+		deviceBuilder.add_pNext(&pageableMemoryFeatures);
+	}
+#endif
+#ifdef VK_KHR_present_wait
+	if (_presentWaitSupported)
+	{
+		deviceBuilder.add_pNext(&presentIdFeatures);
+		deviceBuilder.add_pNext(&presentWaitFeatures);
+	}
+#endif
+#ifdef VK_EXT_extended_dynamic_state
+	if (_extendedDynamicStateSupported && _useExtendedDynamicState)
+	{
+		deviceBuilder.add_pNext(&extendedDynamicStateFeatures);
+	}
+#endif
+#ifdef VK_EXT_graphics_pipeline_library
+	if (_pipelineLibrariesSupported && _usePipelineLibraries)
+	{
+		deviceBuilder.add_pNext(&pipelineLibraryFeatures);
+	}
+#endif
+#ifdef VK_KHR_fragment_shading_rate
+	if (_shadingRateSupported && _useShadingRate)
+	{
+		shadingRateFeatures.attachmentFragmentShadingRate = _shadingRateAttachmentSupported ? VK_TRUE : VK_FALSE;
+		deviceBuilder.add_pNext(&shadingRateFeatures);
+	}
+#endif
+#ifdef VK_KHR_ray_query
+	if (_rayQuerySupported && _useRayShadows)
+	{
+		deviceBuilder.add_pNext(&bufferAddressFeatures);
+		deviceBuilder.add_pNext(&accelerationStructureFeatures);
+		deviceBuilder.add_pNext(&rayQueryFeatures);
+	}
+#endif
+#ifdef VK_EXT_conditional_rendering
+	if (_conditionalRenderingSupported && _useConditionalRendering)
+	{
+		deviceBuilder.add_pNext(&conditionalRenderingFeatures);
+	}
+#endif
+#ifdef VK_KHR_pipeline_executable_properties
+	if (_executablePropertiesSupported && _captureShaderStatistics)
+	{
+		deviceBuilder.add_pNext(&executablePropertiesFeatures);
+	}
+#endif
+	// every 1.1 device has it, and the main pass's vertex shaders read gl_ViewIndex whether or not they draw
+	// into a multiview pass, which needs it enabled
+	if (_multiviewSupported)
+	{
+		deviceBuilder.add_pNext(&multiviewFeatures);
+	}
+	if (storage16Supported)
+	{
+		deviceBuilder.add_pNext(&storage16Features);
+	}
+	if (_halfPrecisionSupported)
+	{
+		deviceBuilder.add_pNext(&float16Features);
+	}
+	auto deviceResult = deviceBuilder.build();
+	if (!deviceResult)
+	{
+		return abandon("Failed to create the device", deviceResult.error().message());
+	}
+	vkb::Device vkbDevice = deviceResult.value();
+
+	// use vkbootstrap to get a graphics queue
+	auto graphicsQueue = vkbDevice.get_queue(vkb::QueueType::graphics);
+	auto graphicsFamily = vkbDevice.get_queue_index(vkb::QueueType::graphics);
+	if (!graphicsQueue || !graphicsFamily)
+	{
+		vkb::destroy_device(vkbDevice);
+		return abandon("The device has no graphics queue", (graphicsQueue ? graphicsFamily.error() : graphicsQueue.error()).message());
+	}
+
+	// get the VkDevice handle used in the rest of the Vulkan application
+	_device = vkbDevice.device;
+	_chosenGPU = physicalDevice.physical_device;
+	_graphicsQueue = graphicsQueue.value();
+	_graphicsQueueFamily = graphicsFamily.value();
+	_graphicsQueueTimestampBits = physicalDevice.get_queue_families()[_graphicsQueueFamily].timestampValidBits;
+
+	// uploads prefer a transfer-only family (the copy engines on discrete GPUs), then any family
+	// without graphics; vk-bootstrap creates one queue in every family. Otherwise they share the graphics queue
+	_transferQueue = _graphicsQueue;
+	_transferQueueFamily = _graphicsQueueFamily;
+	auto dedicatedFamily = vkbDevice.get_dedicated_queue_index(vkb::QueueType::transfer);
+	auto separateFamily = vkbDevice.get_queue_index(vkb::QueueType::transfer);
+	if (dedicatedFamily.has_value())
+	{
+		_transferQueue = vkbDevice.get_dedicated_queue(vkb::QueueType::transfer).value();
+		_transferQueueFamily = dedicatedFamily.value();
+	}
+	else if (separateFamily.has_value())
+	{
+		_transferQueue = vkbDevice.get_queue(vkb::QueueType::transfer).value();
+		_transferQueueFamily = separateFamily.value();
+	}
+	// async compute needs a family without graphics; vk-bootstrap prefers one without transfer as well
+	auto computeFamily = vkbDevice.get_queue_index(vkb::QueueType::compute);
+	if (computeFamily.has_value())
+	{
+		_computeQueue = vkbDevice.get_queue(vkb::QueueType::compute).value();
+		_computeQueueFamily = computeFamily.value();
+		_asyncComputeSupported = true;
+	}
+	LOG_INFO("Uploads on queue family " << _transferQueueFamily
+		<< (_transferQueueFamily == _graphicsQueueFamily ? " (shared with graphics)" : "")
+		<< (_timelineSemaphoresSupported ? ", timeline semaphores" : ", blocking"));
+
+	// initialize memory allocator 
+	VmaAllocatorCreateInfo allocatorInfo = {};
+	allocatorInfo.physicalDevice = _chosenGPU;
+	allocatorInfo.device = _device;
+	allocatorInfo.instance = _instance;
+	// the budget extension needs vkGetPhysicalDeviceMemoryProperties2, core since 1.1
+	allocatorInfo.vulkanApiVersion = VK_API_VERSION_1_1;
+	if (_memoryBudgetSupported)
+	{
+		allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+	}
+	// acceleration structure builds take their inputs and scratch by address
+	if (_rayQuerySupported && _useRayShadows)
+	{
+		allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+	}
+	const VkResult allocatorResult = vmaCreateAllocator(&allocatorInfo, &_allocator);
+	if (allocatorResult != VK_SUCCESS)
+	{
+		vkb::destroy_device(vkbDevice);
+		return abandon("Failed to create the memory allocator", "VkResult " + std::to_string(allocatorResult));
+	}
+
+	load_device_functions();
+	if (_useFullScreenExclusive && !(fullScreenExclusiveExtension && _fullScreenExclusive.init(_device, _window)))
+	{
+		LOG_WARN("The device can't take the monitor for itself, presenting through the compositor");
+	}
+
+	// for the sessions that attach to this device later
+	_deviceContext = std::make_shared<DeviceContext>();
+	DeviceContext& context = *_deviceContext;
+	context.instance = _instance;
+	context.debugMessenger = _debug_messenger;
+	context.physicalDevice = _chosenGPU;
+	context.device = _device;
+	context.allocator = _allocator;
+	context.headless = _headless;
+	context.graphicsQueue = _graphicsQueue;
+	context.graphicsQueueFamily = _graphicsQueueFamily;
+	context.graphicsQueueTimestampBits = _graphicsQueueTimestampBits;
+	context.transferQueue = _transferQueue;
+	context.transferQueueFamily = _transferQueueFamily;
+	context.computeQueue = _computeQueue;
+	context.computeQueueFamily = _computeQueueFamily;
+	context.enabledFeatures = _enabledFeatures;
+	context.drawIndirectCount = _drawIndirectCountSupported;
+	context.timelineSemaphores = _timelineSemaphoresSupported;
+	context.memoryBudget = _memoryBudgetSupported;
+	context.pageableMemory = _pageableMemorySupported;
+	context.bindless = _useBindless;
+	context.meshShading = _meshShadingSupported;
+	context.dynamicRendering = _useDynamicRendering;
+	context.synchronization2 = _synchronization2Supported;
+	context.presentWait = _presentWaitSupported;
+	context.displayTiming = _displayTimingSupported;
+	context.bufferMarker = _bufferMarkerSupported;
+	context.debugUtils = _debugUtilsSupported;
+	context.extendedDynamicState = _useExtendedDynamicState;
+	context.pipelineLibraries = _usePipelineLibraries;
+	context.videoEncode = _useVideoEncode;
+	context.shadingRate = _useShadingRate;
+	context.shadingRateAttachment = _useShadingRate && _shadingRateAttachmentSupported;
+	context.rayQuery = _useRayShadows && _rayQuerySupported;
+	context.executableProperties = _captureShaderStatistics && _executablePropertiesSupported;
+	context.halfPrecision = _halfPrecisionSupported;
+	context.capabilities = _capabilities;
+	context.sessions = 1;
+	return true;
+}
+
+void VulkanEngine::attach_device_context()
+{
+	DeviceContext& context = *_deviceContext;
+	{
+		std::lock_guard<std::mutex> lock(context.lifetimeMutex);
+		context.sessions++;
+		LOG_INFO("Sharing a device with " << context.sessions - 1 << " other session" << (context.sessions > 2 ? "s" : ""));
+	}
+
+	_instance = context.instance;
+	_debug_messenger = context.debugMessenger;
+	_chosenGPU = context.physicalDevice;
+	_device = context.device;
+	_allocator = context.allocator;
+	_graphicsQueue = context.graphicsQueue;
+	_graphicsQueueFamily = context.graphicsQueueFamily;
+	_graphicsQueueTimestampBits = context.graphicsQueueTimestampBits;
+	_transferQueue = context.transferQueue;
+	_transferQueueFamily = context.transferQueueFamily;
+	_computeQueue = context.computeQueue;
+	_computeQueueFamily = context.computeQueueFamily;
+	_asyncComputeSupported = _computeQueue != VK_NULL_HANDLE;
+
+	// the device's features, whatever this session asked for
+	_enabledFeatures = context.enabledFeatures;
+	_drawIndirectCountSupported = context.drawIndirectCount;
+	_timelineSemaphoresSupported = context.timelineSemaphores;
+	_memoryBudgetSupported = context.memoryBudget;
+	_pageableMemorySupported = context.pageableMemory;
+	_useBindless = context.bindless;
+	_meshShadingSupported = context.meshShading;
+	_dynamicRenderingSupported = context.dynamicRendering;
+	_useDynamicRendering = context.dynamicRendering;
+	_synchronization2Supported = context.synchronization2;
+	_presentWaitSupported = context.presentWait && !_headless;
+	_displayTimingSupported = context.displayTiming && !_headless;
+	_bufferMarkerSupported = context.bufferMarker;
+	_debugUtilsSupported = context.debugUtils;
+	_extendedDynamicStateSupported = context.extendedDynamicState;
+	_useExtendedDynamicState = context.extendedDynamicState;
+	_pipelineLibrariesSupported = context.pipelineLibraries;
+	_usePipelineLibraries = context.pipelineLibraries;
+	_videoEncodeSupported = context.videoEncode;
+	_shadingRateSupported = context.shadingRate;
+	_useShadingRate = context.shadingRate;
+	_shadingRateAttachmentSupported = context.shadingRateAttachment;
+	_rayQuerySupported = context.rayQuery;
+	_executablePropertiesSupported = context.executableProperties;
+	_captureShaderStatistics = _captureShaderStatistics && context.executableProperties;
+	_halfPrecisionSupported = context.halfPrecision;
+	_capabilities = context.capabilities;
+
+	// the device was picked for the first session's surface; a window on the same display presents from
+	// the same queue family
+	if (!_headless && _window != nullptr)
+	{
+		SDL_Vulkan_CreateSurface(_window, _instance, &_surface);
+	}
+
+	load_device_functions();
+}
+
+void VulkanEngine::load_device_functions()
+{
+	if (_drawIndirectCountSupported)
+	{
+		_vkCmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(_device, "vkCmdDrawIndexedIndirectCountKHR");
+		_drawIndirectCountSupported = _vkCmdDrawIndexedIndirectCount != nullptr;
+	}
+	if (_meshShadingSupported)
+	{
+		_vkCmdDrawMeshTasks = vkGetDeviceProcAddr(_device, "vkCmdDrawMeshTasksEXT");
+		_meshShadingSupported = _vkCmdDrawMeshTasks != nullptr;
+	}
+#ifdef VK_EXT_mesh_shader
+	if (_meshShadingSupported)
+	{
+		_vertexReadStages |= VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT;
+		_vertexReadAccess |= VK_ACCESS_SHADER_READ_BIT;
+	}
+#endif
+	LOG_INFO("Mesh shading " << (_meshShadingSupported ? "through VK_EXT_mesh_shader" : "unavailable, meshlets draw through the vertex pipeline"));
+	if (_dynamicRenderingSupported && _useDynamicRendering)
+	{
+		_vkCmdBeginRendering = vkGetDeviceProcAddr(_device, "vkCmdBeginRenderingKHR");
+		_vkCmdEndRendering = vkGetDeviceProcAddr(_device, "vkCmdEndRenderingKHR");
+		_dynamicRenderingSupported = _vkCmdBeginRendering != nullptr && _vkCmdEndRendering != nullptr;
+	}
+	_useDynamicRendering = _useDynamicRendering && _dynamicRenderingSupported;
+	if (_extendedDynamicStateSupported && _useExtendedDynamicState)
+	{
+		_vkCmdSetCullMode = vkGetDeviceProcAddr(_device, "vkCmdSetCullModeEXT");
+		_vkCmdSetFrontFace = vkGetDeviceProcAddr(_device, "vkCmdSetFrontFaceEXT");
+		_vkCmdSetPrimitiveTopology = vkGetDeviceProcAddr(_device, "vkCmdSetPrimitiveTopologyEXT");
+		_vkCmdSetDepthTestEnable = vkGetDeviceProcAddr(_device, "vkCmdSetDepthTestEnableEXT");
+		_vkCmdSetDepthWriteEnable = vkGetDeviceProcAddr(_device, "vkCmdSetDepthWriteEnableEXT");
+		_vkCmdSetDepthCompareOp = vkGetDeviceProcAddr(_device, "vkCmdSetDepthCompareOpEXT");
+		_extendedDynamicStateSupported = _vkCmdSetCullMode != nullptr && _vkCmdSetFrontFace != nullptr && _vkCmdSetPrimitiveTopology != nullptr
+			&& _vkCmdSetDepthTestEnable != nullptr && _vkCmdSetDepthWriteEnable != nullptr && _vkCmdSetDepthCompareOp != nullptr;
+	}
+	_useExtendedDynamicState = _useExtendedDynamicState && _extendedDynamicStateSupported;
+	if (_captureShaderStatistics && _executablePropertiesSupported)
+	{
+		_vkGetPipelineExecutableProperties = vkGetDeviceProcAddr(_device, "vkGetPipelineExecutablePropertiesKHR");
+		_vkGetPipelineExecutableStatistics = vkGetDeviceProcAddr(_device, "vkGetPipelineExecutableStatisticsKHR");
+		_executablePropertiesSupported = _vkGetPipelineExecutableProperties != nullptr && _vkGetPipelineExecutableStatistics != nullptr;
+	}
+	if (_captureShaderStatistics && !_executablePropertiesSupported)
+	{
+		LOG_WARN("Shader statistics need VK_KHR_pipeline_executable_properties, not captured");
+		_captureShaderStatistics = false;
+	}
+	// a pipeline linked from libraries would only report what the fast link made of them
+	_usePipelineLibraries = _usePipelineLibraries && _pipelineLibrariesSupported && !_captureShaderStatistics;
+	if (_timelineSemaphoresSupported)
+	{
+		_vkGetSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(_device, "vkGetSemaphoreCounterValueKHR");
+		_vkWaitSemaphores = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(_device, "vkWaitSemaphoresKHR");
+		_timelineSemaphoresSupported = _vkGetSemaphoreCounterValue != nullptr && _vkWaitSemaphores != nullptr;
+	}
+	if (_synchronization2Supported)
+	{
+		_vkQueueSubmit2 = vkGetDeviceProcAddr(_device, "vkQueueSubmit2KHR");
+		_vkCmdPipelineBarrier2 = vkGetDeviceProcAddr(_device, "vkCmdPipelineBarrier2KHR");
+		_synchronization2Supported = _vkQueueSubmit2 != nullptr && _vkCmdPipelineBarrier2 != nullptr;
+	}
+	if (_presentWaitSupported)
+	{
+		_vkWaitForPresent = vkGetDeviceProcAddr(_device, "vkWaitForPresentKHR");
+		_presentWaitSupported = _vkWaitForPresent != nullptr;
+	}
+	// the present thread acquires from the swapchain whenever it likes, and the timing queries must not overlap that
+	if (_displayTimingSupported && !_usePresentThread && !_displayTiming.init(_device))
+	{
+		_displayTimingSupported = false;
+	}
+	if (_debugUtilsSupported)
+	{
+		_debugUtils.init(_instance, _device);
+		_debugUtils.name(VK_OBJECT_TYPE_QUEUE, _graphicsQueue, "graphics");
+		_debugUtils.name(VK_OBJECT_TYPE_QUEUE, _transferQueue, "transfer");
+		_debugUtils.name(VK_OBJECT_TYPE_QUEUE, _computeQueue, "compute");
+	}
+	if (_bufferMarkerSupported)
+	{
+		_vkCmdWriteBufferMarker = vkGetDeviceProcAddr(_device, "vkCmdWriteBufferMarkerAMD");
+		_bufferMarkerSupported = _vkCmdWriteBufferMarker != nullptr;
+	}
+	if (_shadingRateSupported && _useShadingRate)
+	{
+		_vkCmdSetFragmentShadingRate = vkGetDeviceProcAddr(_device, "vkCmdSetFragmentShadingRateKHR");
+		_shadingRateSupported = _vkCmdSetFragmentShadingRate != nullptr;
+	}
+	_useShadingRate = _useShadingRate && _shadingRateSupported;
+	// the attachment needs dynamic rendering, since render pass objects would have to be render pass 2 ones
+	// to take it, and a format the rate shader can write
+	_useShadingRateImage = false;
+#ifdef VK_KHR_fragment_shading_rate
+	if (_useShadingRate && _shadingRateAttachmentSupported && _useDynamicRendering)
+	{
+		VkPhysicalDeviceFragmentShadingRatePropertiesKHR shadingRateProperties = {};
+		shadingRateProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FRAGMENT_SHADING_RATE_PROPERTIES_KHR;
+		VkPhysicalDeviceProperties2 properties2 = {};
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties2.pNext = &shadingRateProperties;
+		vkGetPhysicalDeviceProperties2(_chosenGPU, &properties2);
+		// 16x16 pixel tiles where the device allows them: small enough to follow edges, large enough that the rate
+		// image costs next to nothing to write
+		_shadingRateTexelSize.width = std::clamp(16u, shadingRateProperties.minFragmentShadingRateAttachmentTexelSize.width,
+			shadingRateProperties.maxFragmentShadingRateAttachmentTexelSize.width);
+		_shadingRateTexelSize.height = std::clamp(16u, shadingRateProperties.minFragmentShadingRateAttachmentTexelSize.height,
+			shadingRateProperties.maxFragmentShadingRateAttachmentTexelSize.height);
+		_shadingRateMaxCombiner = shadingRateProperties.fragmentShadingRateNonTrivialCombinerOps == VK_TRUE;
+
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(_chosenGPU, ShadingRateImage::FORMAT, &formatProperties);
+		const VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_FRAGMENT_SHADING_RATE_ATTACHMENT_BIT_KHR | VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT;
+		_useShadingRateImage = (formatProperties.optimalTilingFeatures & needed) == needed;
+	}
+#endif
+	// the encoder's barriers are synchronization2 ones, and its submits wait for the frames' graphics timeline values
+	if (_useVideoEncode && !(_videoEncodeSupported && _synchronization2Supported && _timelineSemaphoresSupported))
+	{
+		LOG_WARN("Video encode needs VK_KHR_video_encode_h264, synchronization2 and timeline semaphores, disabled");
+		_useVideoEncode = false;
+	}
+	if (_useRayShadows && !_rayQuerySupported)
+	{
+		LOG_WARN("Ray-traced shadows need VK_KHR_acceleration_structure, VK_KHR_ray_query and buffer device addresses, "
+			"the shadow cascades stay");
+		_useRayShadows = false;
+	}
+	if (_useRayShadows)
+	{
+		LOG_INFO("Shadows and ambient occlusion through VK_KHR_ray_query");
+	}
+	if (_useStereo && !_multiviewSupported)
+	{
+		LOG_WARN("Stereo needs VK_KHR_multiview, rendering a single view");
+		_useStereo = false;
+	}
+	if (_useStereo)
+	{
+		// the passes after the scene's would need a dispatch per layer, the trace and rate passes a view of the
+		// depth and color each; mesh shaders take multiviewMeshShader, occlusion queries a query per view, and
+		// the weighted blended composite samples its targets as single images. The software occlusion buffer
+		// is rasterized from between the eyes and would hide what only one of them sees
+		_usePostProcess = false;
+		_useTemporalUpscale = false;
+		_useRayShadows = false;
+		_useShadingRateImage = false;
+		_meshShadingSupported = false;
+		_useConditionalRendering = false;
+		_useSoftwareOcclusion = false;
+		_transparencyMode = TransparencyMode::Sorted;
+		LOG_INFO("Single-pass stereo through VK_KHR_multiview, " << _eyeSeparation * 1000.f << "mm between the eyes");
+	}
+	log_capabilities(_capabilities);
+	RenderPath renderPath = _renderPath == RenderPath::Auto ? fastest_render_path(_capabilities) : _renderPath;
+	if (renderPath == RenderPath::Indirect && !_enabledFeatures.drawIndirectFirstInstance)
+	{
+		LOG_WARN("Indirect draws need drawIndirectFirstInstance, culling and drawing on the CPU");
+		renderPath = RenderPath::Cpu;
+	}
+	_useIndirectDraws = renderPath == RenderPath::Indirect;
+	LOG_INFO("Device tier " << device_tier_name(device_tier(_capabilities)) << ", render path " << render_path_name(renderPath)
+		<< (_renderPath == RenderPath::Auto ? " (fastest for the tier)" : " (forced)")
+		<< (!_useIndirectDraws ? "" : _drawIndirectCountSupported ? ", draws compacted through draw indirect count" : ", culled draws left as zero instances"));
+	// the views come out of the GPU cull, whose draws index the instances through firstInstance
+	if (_sceneViewCount > 0 && (_useStereo || !_useIndirectDraws || !_enabledFeatures.drawIndirectFirstInstance))
+	{
+		LOG_WARN("Extra views need indirect draws and no stereo, rendering the main view only");
+		_sceneViewCount = 0;
+	}
+	_sceneViewCount = std::min(_sceneViewCount, MAX_SCENE_VIEWS);
+	LOG_INFO("Raster passes " << (_useDynamicRendering ? "through VK_KHR_dynamic_rendering" : "through render pass objects")
+		<< (_useExtendedDynamicState ? ", cull and depth state through VK_EXT_extended_dynamic_state" : "")
+		<< (_usePipelineLibraries ? ", pipelines linked from VK_EXT_graphics_pipeline_library parts" : ""));
+	LOG_INFO("Frame pacing through " << (_timelineSemaphoresSupported ? "a graphics timeline semaphore" : "per-frame fences")
+		<< (_synchronization2Supported ? ", barriers and submits through VK_KHR_synchronization2" : "")
+		<< (_presentWaitSupported ? ", low-latency mode waits for presents" : "")
+		<< (_displayTiming.enabled() ? ", present times through VK_GOOGLE_display_timing" : ""));
+	if (_halfPrecisionSupported)
+	{
+		LOG_INFO("Mesh lighting and the post-processing blur and composite in float16_t through VK_KHR_shader_float16_int8");
+	}
+	LOG_INFO("GPU breadcrumbs through " << (_bufferMarkerSupported ? "VK_AMD_buffer_marker" : "vkCmdFillBuffer")
+		<< (_debugUtils.is_enabled() ? ", objects named and passes labeled through VK_EXT_debug_utils" : ""));
+	if (_captureShaderStatistics)
+	{
+		LOG_INFO("Shader statistics through VK_KHR_pipeline_executable_properties, pipelines compiled without libraries");
+	}
+	if (_useShadingRate)
+	{
+		logging::Line line(logging::Level::Info);
+		line.stream() << "Variable rate shading through VK_KHR_fragment_shading_rate, per material";
+		if (_useShadingRateImage)
+		{
+			line.stream() << " and from a " << _shadingRateTexelSize.width << "x" << _shadingRateTexelSize.height << " pixel tile rate image"
+				<< (_shadingRateMaxCombiner ? "" : " that overrides them");
+		}
+	}
+}
+
+VkPresentModeKHR VulkanEngine::choose_present_mode(VkPresentModeKHR desired)
+{
+	uint32_t modeCount = 0;
+	vkGetPhysicalDeviceSurfacePresentModesKHR(_chosenGPU, _surface, &modeCount, nullptr);
+	std::vector<VkPresentModeKHR> supportedModes(modeCount);
+	vkGetPhysicalDeviceSurfacePresentModesKHR(_chosenGPU, _surface, &modeCount, supportedModes.data());
+
+	// closest alternatives first; FIFO is the only mode every implementation must support
+	std::vector<VkPresentModeKHR> candidates;
+	switch (desired)
+	{
+	case VK_PRESENT_MODE_IMMEDIATE_KHR:
+		candidates = { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR };
+		break;
+	case VK_PRESENT_MODE_MAILBOX_KHR:
+		candidates = { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_FIFO_KHR };
+		break;
+	case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+		candidates = { VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_FIFO_KHR };
+		break;
+	default:
+		candidates = { VK_PRESENT_MODE_FIFO_KHR };
+		break;
+	}
+
+	for (VkPresentModeKHR candidate : candidates)
+	{
+		if (std::find(supportedModes.begin(), supportedModes.end(), candidate) != supportedModes.end())
+		{
+			if (candidate != desired)
+			{
+				LOG_WARN(present_mode_name(desired) << " present mode unsupported, using "
+					<< present_mode_name(candidate));
+			}
+			return candidate;
+		}
+	}
+	return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+bool VulkanEngine::init_swapchain()
+{
+	CPU_PROFILE_SCOPE("init_swapchain");
+	// dynamic resolution blits into the swapchain images
+	bool blitTarget = true;
+	if (_headless)
+	{
+		// the ring stands in for the swapchain at the size asked for, and every draw path renders into it alike
+		_offscreen.init(_device, _allocator, VK_FORMAT_B8G8R8A8_SRGB, _windowExtent, std::max(_headlessImageCount, _frameOverlap),
+			FrameReadback::image_usage(_readbackFormat) | (_useVideoEncode ? VideoEncoder::image_usage() : 0));
+		_swapchainImages = _offscreen.images();
+		_swapchainImageViews = _offscreen.views();
+		_swapchainImageFormat = _offscreen.format();
+		// never rebuilt: without a window nothing resizes it
+		_mainDeletionQueue.push_function([=]() {
+			_offscreen.cleanup();
+		});
+	}
+	else
+	{
+		vkb::SwapchainBuilder swapchainBuilder(_chosenGPU, _device, _surface);
+
+		VkSurfaceCapabilitiesKHR surfaceCapabilities;
+		VK_CHECK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(_chosenGPU, _surface, &surfaceCapabilities));
+		blitTarget = (surfaceCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) != 0;
+		if (blitTarget)
+		{
+			swapchainBuilder.add_image_usage_flags(VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+		}
+		if (_useReadback)
+		{
+			const VkImageUsageFlags readbackUsage = FrameReadback::image_usage(_readbackFormat);
+			if ((surfaceCapabilities.supportedUsageFlags & readbackUsage) == readbackUsage)
+			{
+				swapchainBuilder.add_image_usage_flags(readbackUsage);
+			}
+			else
+			{
+				LOG_WARN("Swapchain images can't be read back, frame readback disabled");
+				_useReadback = false;
+			}
+		}
+		if (_useVideoEncode)
+		{
+			if ((surfaceCapabilities.supportedUsageFlags & VideoEncoder::image_usage()) == VideoEncoder::image_usage())
+			{
+				swapchainBuilder.add_image_usage_flags(VideoEncoder::image_usage());
+			}
+			else
+			{
+				LOG_WARN("Swapchain images can't be sampled, video encode disabled");
+				_useVideoEncode = false;
+			}
+		}
+
+		_presentMode = choose_present_mode(_presentMode);
+
+		// size to the window's current drawable area, which differs from _windowExtent after a resize or on high-DPI displays;
+		// a display's surface is the size of the mode it was made with
+		int drawableWidth = static_cast<int>(surfaceCapabilities.currentExtent.width);
+		int drawableHeight = static_cast<int>(surfaceCapabilities.currentExtent.height);
+		if (_window != nullptr)
+		{
+			SDL_Vulkan_GetDrawableSize(_window, &drawableWidth, &drawableHeight);
+		}
+		_fullScreenExclusive.request(swapchainBuilder);
+
+		// handing over the previous swapchain lets the driver reuse its resources and keep presenting during the switch
+		VkSwapchainKHR oldSwapchain = _swapchain;
+
+		auto swapchainResult = swapchainBuilder
+			.use_default_format_selection()
+			.set_desired_present_mode(_presentMode) // FIFO (hard VSYNC) unless asked otherwise
+			.set_desired_extent(static_cast<uint32_t>(drawableWidth), static_cast<uint32_t>(drawableHeight))
+			.set_old_swapchain(oldSwapchain)
+			.build();
+		if (!swapchainResult)
+		{
+			LOG_ERROR("Failed to create the swapchain: " << swapchainResult.error().message());
+			// retired by the attempt all the same, and no good as the next one's oldSwapchain
+			if (oldSwapchain != VK_NULL_HANDLE)
+			{
+				vkDestroySwapchainKHR(_device, oldSwapchain, nullptr);
+				_swapchain = VK_NULL_HANDLE;
+			}
+			return false;
+		}
+		vkb::Swapchain vkbSwapchain = swapchainResult.value();
+
+		// store swapchain & images
+		_swapchain = vkbSwapchain.swapchain;
+		if (oldSwapchain != VK_NULL_HANDLE)
+		{
+			// retired by the create call above; the caller already waited for the device to go idle
+			vkDestroySwapchainKHR(_device, oldSwapchain, nullptr);
+		}
+		_fullScreenExclusive.acquire(_swapchain);
+		if (_displayTiming.enabled())
+		{
+			_displayTiming.reset(_swapchain);
+			if (!_isInitialized)
+			{
+				LOG_INFO("Display refreshes every " << _displayTiming.refresh_ns() / 1e6 << " ms");
+			}
+		}
+		if (!_isInitialized)
+		{
+			// only init()'s swapchain registers for cleanup; the lambda reads whichever one is current at shutdown
+			_mainDeletionQueue.push_function([=]() {
+				_fullScreenExclusive.release(_swapchain);
+				vkDestroySwapchainKHR(_device, _swapchain, nullptr);
+			});
+		}
+		auto images = vkbSwapchain.get_images();
+		auto imageViews = vkbSwapchain.get_image_views();
+		if (!images || !imageViews)
+		{
+			LOG_ERROR("Failed to get the swapchain's images");
+			return false;
+		}
+		_swapchainImages = images.value();
+		_swapchainImageViews = imageViews.value();
+
+		_swapchainImageFormat = vkbSwapchain.image_format;
+		for (VkImageView view : _swapchainImageViews)
+		{
+			_swapchainDeletionQueue.push_image_view(view);
+		}
+		for (size_t i = 0; i < _swapchainImages.size(); i++)
+		{
+			_debugUtils.name(VK_OBJECT_TYPE_IMAGE, _swapchainImages[i], ("swapchain " + std::to_string(i)).c_str());
+		}
+		// the surface decides the final extent; everything sized to the swapchain follows it
+		_windowExtent = vkbSwapchain.extent;
+	}
+
+	// the scene target has the swapchain's format, so both ends of the blit can be checked at once
+	VkFormatProperties swapchainFormatProperties;
+	vkGetPhysicalDeviceFormatProperties(_chosenGPU, _swapchainImageFormat, &swapchainFormatProperties);
+	const VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	_dynamicResolutionSupported = blitTarget && (swapchainFormatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures;
+	// the post chain's result reaches the swapchain through the same blit
+	if (_usePostProcess && !_dynamicResolutionSupported)
+	{
+		LOG_WARN("Swapchain images can't be blitted to, post-processing disabled");
+		_usePostProcess = false;
+	}
+	// and so are the eyes, each into its half
+	if (_useStereo && !_dynamicResolutionSupported)
+	{
+		LOG_WARN("Swapchain images can't be blitted to, rendering a single view");
+		_useStereo = false;
+	}
+	_camera.set_stereo(_useStereo ? _eyeSeparation : 0.f);
+
+	// init depth image
+	VkExtent3D depthImageExtent = {
+		_windowExtent.width,
+		_windowExtent.height,
+		1
+	};
+
+	_depthFormat = VK_FORMAT_D32_SFLOAT;
+	// only occlusion culling needs a depth image of its own, which the depth pyramid build samples between
+	// the two phases; otherwise the frame graph creates a transient one
+	if (!_occlusionCullingSupported)
+	{
+		_depthImage = {};
+		_depthImageView = VK_NULL_HANDLE;
+		return true;
+	}
+	VkImageUsageFlags depthUsage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	VkImageCreateInfo dimg_info = vkinit::image_create_info(_depthFormat, depthUsage, depthImageExtent);
+	VmaAllocationCreateInfo dimg_allocinfo = {};
+	// allocate depth image from GPU local memory
+	dimg_allocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+	dimg_allocinfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	// allocate and create the image
+	vmaCreateImage(_allocator, &dimg_info, &dimg_allocinfo, &_depthImage._image, &_depthImage._allocation, nullptr);
+	// build an image-view for depth image to use for rendering
+	VkImageViewCreateInfo dview_info = vkinit::imageview_create_info(_depthFormat, _depthImage._image, VK_IMAGE_ASPECT_DEPTH_BIT);
+	VK_CHECK(vkCreateImageView(_device, &dview_info, nullptr, &_depthImageView));
+	_debugUtils.name(VK_OBJECT_TYPE_IMAGE, _depthImage._image, "depth");
+	_debugUtils.name(VK_OBJECT_TYPE_IMAGE_VIEW, _depthImageView, "depth");
+
+	// add to deletion queues
+	_swapchainDeletionQueue.push_image_view(_depthImageView);
+	_swapchainDeletionQueue.push_image(_depthImage);
+	return true;
+}
+
+void VulkanEngine::recreate_swapchain()
+{
+	// a minimized window has a zero-sized surface; try again once it's restored. A display's never changes
+	int drawableWidth = 1, drawableHeight = 1;
+	if (_window != nullptr)
+	{
+		SDL_Vulkan_GetDrawableSize(_window, &drawableWidth, &drawableHeight);
+	}
+	if (drawableWidth == 0 || drawableHeight == 0)
+	{
+		return;
+	}
+
+	// only swapchain-sized resources are rebuilt; the render pass, pipelines and meshes stay
+	_presentThread.stop();
+	wait_device_idle();
+	_resizeRequested = false;
+	// the buffers are about to be resized
+	deliver_pending_readbacks(_onFrameReadback);
+	deliver_pending_encodes();
+
+	// image views, framebuffers and depth go now; the swapchain itself is handed to init_swapchain as oldSwapchain.
+	// The frame graph recompiles for the new extent on the next draw()
+	_frameGraph.release_framebuffers();
+	_swapchainDeletionQueue.flush(_device, _allocator);
+	_descriptorSetCache.invalidate();
+	_fullScreenExclusive.release(_swapchain);
+
+	if (!init_swapchain())
+	{
+		// nothing to draw into; draw() keeps skipping frames until a rebuild succeeds
+		_resizeRequested = true;
+		return;
+	}
+	if (_useReadback)
+	{
+		_readback.resize(_windowExtent, _swapchainImageFormat, _readbackFormat);
+	}
+	// a new stream at the new size, which players take as a resolution change at its first IDR frame
+	if (_useVideoEncode && !_videoEncoder.resize(_windowExtent, _swapchainImageFormat))
+	{
+		LOG_WARN("Video encoder can't take " << _windowExtent.width << "x" << _windowExtent.height << " frames, video encode disabled");
+		_useVideoEncode = false;
+	}
+
+	// present ids belong to the swapchain they were presented to
+	for (uint32_t i = 0; i < MAX_FRAME_OVERLAP; i++)
+	{
+		_frames[i]._presentId = 0;
+	}
+	if (_usePresentThread)
+	{
+		_presentThread.start(_swapchain);
+	}
+
+	_depthPyramid.resize(_windowExtent, _occlusionCullingSupported ? _depthImageView : VK_NULL_HANDLE);
+	write_cull_pyramid_descriptors();
+	if (_useShadingRateImage)
+	{
+		_shadingRateImage.resize(_windowExtent);
+		_debugUtils.name(VK_OBJECT_TYPE_IMAGE, _shadingRateImage.image(), "shading rate");
+		immediate_submit([=](VkCommandBuffer cmd) {
+			_shadingRateImage.clear(cmd);
+		});
+	}
+	if (_useTemporalUpscale)
+	{
+		resize_temporal_upscale();
+	}
+	resize_ray_shadows();
+}
+
+void VulkanEngine::set_present_mode(VkPresentModeKHR mode)
+{
+	_presentMode = mode;
+	recreate_swapchain();
+	LOG_INFO("Present mode: " << present_mode_name(_presentMode));
+}
+
+void VulkanEngine::init_commands()
+{
+	CPU_PROFILE_SCOPE("init_commands");
+	// everything recorded for a frame comes from its slot's transient pools, one for the main thread and one per
+	// recording thread, reset whole once the slot's fence has signaled
+	auto namer = [this](VkObjectType type, uint64_t handle, const char* name) {
+		_debugUtils.name(type, handle, name);
+	};
+	_frameCommands.init(_device, _graphicsQueueFamily, _frameOverlap, 1 + MAX_RECORD_THREADS);
+	_frameCommands.set_object_namer(namer);
+	_mainDeletionQueue.push_function([=]() {
+		_frameCommands.cleanup();
+	});
+	// the culling submitted ahead of the frame, on its own queue family
+	if (_useAsyncCompute)
+	{
+		_computeCommands.init(_device, _computeQueueFamily, _frameOverlap, 1);
+		_computeCommands.set_object_namer(namer);
+		_mainDeletionQueue.push_function([=]() {
+			_computeCommands.cleanup();
+		});
+	}
+
+	for (uint32_t i = 0; i < _frameOverlap; i++)
+	{
+		// the cached static draws outlive the frame, so their pool is reset only when they're re-recorded
+		VkCommandPoolCreateInfo staticPoolInfo = vkinit::command_pool_create_info(_graphicsQueueFamily);
+		VK_CHECK(vkCreateCommandPool(_device, &staticPoolInfo, nullptr, &_frames[i]._staticDrawPool));
+		VkCommandBufferAllocateInfo staticAllocInfo = vkinit::command_buffer_allocate_info(_frames[i]._staticDrawPool, 1, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+		VK_CHECK(vkAllocateCommandBuffers(_device, &staticAllocInfo, &_frames[i]._staticDrawBuffer));
+		_mainDeletionQueue.push_command_pool(_frames[i]._staticDrawPool);
+	}
+	_recordThreadCount = std::min(_jobSystem.thread_count(), MAX_RECORD_THREADS);
+
+	// separate pool for upload commands; these buffers are short lived and recorded from scratch each time
+	VkCommandPoolCreateInfo uploadCommandPoolInfo = vkinit::command_pool_create_info(_graphicsQueueFamily);
+	VK_CHECK(vkCreateCommandPool(_device, &uploadCommandPoolInfo, nullptr, &_uploadContext._commandPool));
+
+	VkCommandBufferAllocateInfo uploadCmdAllocInfo = vkinit::command_buffer_allocate_info(_uploadContext._commandPool, 1);
+	VK_CHECK(vkAllocateCommandBuffers(_device, &uploadCmdAllocInfo, &_uploadContext._commandBuffer));
+
+	_mainDeletionQueue.push_command_pool(_uploadContext._commandPool);
+
+	// batched staging uploads on the transfer queue
+	_uploadManager.init(_device, _allocator, _transferQueue, _transferQueueFamily, _graphicsQueueFamily, _timelineSemaphoresSupported,
+		_deviceContext->queueMutex, _gpuMemory.pool(MemoryPoolType::Staging), _stagingRingSize);
+	_uploadManager.set_frame_budget(_uploadBytesPerFrame);
+	LOG_INFO("Staging ring " << (_uploadManager.ring_size() >> 20) << " MiB, uploads "
+		<< (_uploadBytesPerFrame > 0 ? std::to_string(_uploadBytesPerFrame >> 20) + " MiB" : std::string("unlimited")) << " a frame");
+	_mainDeletionQueue.push_function([=]() {
+		_uploadManager.cleanup();
+	});
+}
+
+void VulkanEngine::init_default_renderpass()
+{
+	CPU_PROFILE_SCOPE("init_default_renderpass");
+	// pipelines take the attachment formats and the frame graph begins its passes without one
+	if (_useDynamicRendering)
+	{
+		return;
+	}
+
+	// create description for color pass
+	VkAttachmentDescription color_attachment = {};
+	color_attachment.format = _sceneColorFormat; // what the frame graph's main pass renders into
+	color_attachment.samples = _msaaSamples;
+	color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE; // keep attachment when renderpass ends
+	
+	// no stencil
+	color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+	// don't care about starting layout
+	color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	// after renderpass ends, image needs to be ready for display
+	color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+	VkAttachmentReference color_attachment_ref = {};
+	// attachment number is index in pAttachments array in parent renderpass
+	color_attachment_ref.attachment = 0;
+	color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentDescription depth_attachment = {};
+	depth_attachment.flags = 0;
+	depth_attachment.format = _depthFormat;
+	depth_attachment.samples = _msaaSamples;
+	depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depth_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	depth_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference depth_attachment_ref = {};
+	depth_attachment_ref.attachment = 1;
+	depth_attachment_ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	// create 1 subpass (required 1)
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments = &color_attachment_ref;
+	subpass.pDepthStencilAttachment = &depth_attachment_ref;
+
+	// with MSAA the samples resolve into the swapchain image at the end of the subpass; the frame graph's
+	// passes have to match, resolve attachment included, to be compatible
+	VkAttachmentDescription resolve_attachment = color_attachment;
+	resolve_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	resolve_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+
+	VkAttachmentReference resolve_attachment_ref = {};
+	resolve_attachment_ref.attachment = 2;
+	resolve_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	if (_msaaSamples != VK_SAMPLE_COUNT_1_BIT)
+	{
+		subpass.pResolveAttachments = &resolve_attachment_ref;
+	}
+
+	VkAttachmentDescription attachments[3] = { color_attachment, depth_attachment, resolve_attachment };
+
+	// actually create render pass
+	// no dependencies: pipelines only need a compatible pass, and the frame graph creates the ones it
+	// begins, with barriers worked out from what its passes access
+	VkRenderPassCreateInfo render_pass_info = {};
+	render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	// connect color attachment, depth attachment, and subpass to info
+	render_pass_info.attachmentCount = _msaaSamples != VK_SAMPLE_COUNT_1_BIT ? 3 : 2;
+	render_pass_info.pAttachments = &attachments[0];
+	render_pass_info.subpassCount = 1;
+	render_pass_info.pSubpasses = &subpass;
+
+	// the view mask is part of compatibility too, so with stereo it's the frame graph's multiview one
+	const uint32_t viewMask = main_view_mask();
+	VkRenderPassMultiviewCreateInfo multiview_info = {};
+	multiview_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO;
+	multiview_info.subpassCount = 1;
+	multiview_info.pViewMasks = &viewMask;
+	multiview_info.correlationMaskCount = 1;
+	multiview_info.pCorrelationMasks = &viewMask;
+	if (viewMask != 0)
+	{
+		render_pass_info.pNext = &multiview_info;
+	}
+
+	VK_CHECK(vkCreateRenderPass(_device, &render_pass_info, nullptr, &_renderPass));
+
+	// add to deletion queue
+	_mainDeletionQueue.push_render_pass(_renderPass);
+}
+
+void VulkanEngine::init_sync_structures()
+{
+	CPU_PROFILE_SCOPE("init_sync_structures");
+	// create synchronization structures
+	// fences start signaled so the first wait on each frame slot returns immediately; with a timeline,
+	// the slots' value 0 has signaled from the start
+	VkFenceCreateInfo fenceCreateInfo = vkinit::fence_create_info(VK_FENCE_CREATE_SIGNALED_BIT);
+	VkSemaphoreCreateInfo semaphoreCreateInfo = vkinit::semaphore_create_info();
+
+	if (_timelineSemaphoresSupported)
+	{
+		VkSemaphoreTypeCreateInfoKHR typeInfo = {};
+		typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+		typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+		typeInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo timelineInfo = vkinit::semaphore_create_info();
+		timelineInfo.pNext = &typeInfo;
+		VK_CHECK(vkCreateSemaphore(_device, &timelineInfo, nullptr, &_graphicsTimeline));
+		_mainDeletionQueue.push_semaphore(_graphicsTimeline);
+		if (_useAsyncCompute)
+		{
+			VK_CHECK(vkCreateSemaphore(_device, &timelineInfo, nullptr, &_computeTimeline));
+			_mainDeletionQueue.push_semaphore(_computeTimeline);
+		}
+	}
+
+	for (uint32_t i = 0; i < _frameOverlap; i++)
+	{
+		if (!_timelineSemaphoresSupported)
+		{
+			VK_CHECK(vkCreateFence(_device, &fenceCreateInfo, nullptr, &_frames[i]._renderFence));
+
+			// add to deletion queue
+			_mainDeletionQueue.push_fence(_frames[i]._renderFence);
+		}
+
+		VK_CHECK(vkCreateSemaphore(_device, &semaphoreCreateInfo, nullptr, &_frames[i]._presentSemaphore));
+		VK_CHECK(vkCreateSemaphore(_device, &semaphoreCreateInfo, nullptr, &_frames[i]._renderSemaphore));
+
+		// add to deletion queue
+		_mainDeletionQueue.push_semaphore(_frames[i]._presentSemaphore);
+		_mainDeletionQueue.push_semaphore(_frames[i]._renderSemaphore);
+	}
+
+	// upload fence starts unsignaled; immediate_submit waits on it right after each submit
+	if (!_timelineSemaphoresSupported)
+	{
+		VkFenceCreateInfo uploadFenceCreateInfo = vkinit::fence_create_info();
+		VK_CHECK(vkCreateFence(_device, &uploadFenceCreateInfo, nullptr, &_uploadContext._uploadFence));
+
+		_mainDeletionQueue.push_fence(_uploadContext._uploadFence);
+	}
+}
+
+uint64_t VulkanEngine::submit_graphics(VkCommandBuffer cmd, uint32_t waitCount, const VkSemaphore* waitSemaphores, const uint64_t* waitValues,
+	const VkPipelineStageFlags* waitStages, VkSemaphore signalSemaphore, VkFence fence)
+{
+	const uint64_t value = _graphicsTimeline != VK_NULL_HANDLE ? ++_graphicsTimelineValue : 0;
+
+	VkSemaphore signalSemaphores[2];
+	uint64_t signalValues[2];
+	uint32_t signalCount = 0;
+	if (signalSemaphore != VK_NULL_HANDLE)
+	{
+		signalSemaphores[signalCount] = signalSemaphore;
+		signalValues[signalCount++] = 0;
+	}
+	if (value != 0)
+	{
+		signalSemaphores[signalCount] = _graphicsTimeline;
+		signalValues[signalCount++] = value;
+	}
+
+#ifdef VK_KHR_synchronization2
+	if (_synchronization2Supported)
+	{
+		// every wait blocks only its own stages; the signals cover the whole submit, which ends with the
+		// frame graph's transition to present
+		VkSemaphoreSubmitInfoKHR waits[MAX_GRAPHICS_WAITS];
+		for (uint32_t i = 0; i < waitCount; i++)
+		{
+			waits[i] = {};
+			waits[i].sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR;
+			waits[i].semaphore = waitSemaphores[i];
+			waits[i].value = waitValues[i];
+			waits[i].stageMask = waitStages[i];
+		}
+		VkSemaphoreSubmitInfoKHR signals[2];
+		for (uint32_t i = 0; i < signalCount; i++)
+		{
+			signals[i] = {};
+			signals[i].sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR;
+			signals[i].semaphore = signalSemaphores[i];
+			signals[i].value = signalValues[i];
+			signals[i].stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR;
+		}
+		VkCommandBufferSubmitInfoKHR commandBuffer = {};
+		commandBuffer.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO_KHR;
+		commandBuffer.commandBuffer = cmd;
+
+		VkSubmitInfo2KHR submit = {};
+		submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2_KHR;
+		submit.waitSemaphoreInfoCount = waitCount;
+		submit.pWaitSemaphoreInfos = waits;
+		submit.commandBufferInfoCount = 1;
+		submit.pCommandBufferInfos = &commandBuffer;
+		submit.signalSemaphoreInfoCount = signalCount;
+		submit.pSignalSemaphoreInfos = signals;
+		std::lock_guard<std::mutex> lock(_deviceContext->queueMutex);
+		check_device_result(reinterpret_cast<PFN_vkQueueSubmit2KHR>(_vkQueueSubmit2)(_graphicsQueue, 1, &submit, fence), "vkQueueSubmit2KHR");
+		return value;
+	}
+#endif
+
+	VkSubmitInfo submit = vkinit::submit_info(&cmd);
+	submit.waitSemaphoreCount = waitCount;
+	submit.pWaitSemaphores = waitSemaphores;
+	submit.pWaitDstStageMask = waitStages;
+	submit.signalSemaphoreCount = signalCount;
+	submit.pSignalSemaphores = signalSemaphores;
+
+	// binary semaphores ignore their values
+	VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+	if (_timelineSemaphoresSupported)
+	{
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+		timelineInfo.waitSemaphoreValueCount = waitCount;
+		timelineInfo.pWaitSemaphoreValues = waitValues;
+		timelineInfo.signalSemaphoreValueCount = signalCount;
+		timelineInfo.pSignalSemaphoreValues = signalValues;
+		submit.pNext = &timelineInfo;
+	}
+	std::lock_guard<std::mutex> lock(_deviceContext->queueMutex);
+	check_device_result(vkQueueSubmit(_graphicsQueue, 1, &submit, fence), "vkQueueSubmit");
+	return value;
+}
+
+bool VulkanEngine::graphics_complete(uint64_t value)
+{
+	if (value <= _graphicsCompletedValue)
+	{
+		return true;
+	}
+	VK_CHECK(_vkGetSemaphoreCounterValue(_device, _graphicsTimeline, &_graphicsCompletedValue));
+	return value <= _graphicsCompletedValue;
+}
+
+void VulkanEngine::wait_graphics(uint64_t value, uint64_t timeout)
+{
+	if (graphics_complete(value))
+	{
+		return;
+	}
+
+	VkSemaphoreWaitInfoKHR waitInfo = {};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &_graphicsTimeline;
+	waitInfo.pValues = &value;
+	if (check_device_result(_vkWaitSemaphores(_device, &waitInfo, timeout), "vkWaitSemaphoresKHR"))
+	{
+		_graphicsCompletedValue = std::max(_graphicsCompletedValue, value);
+	}
+}
+
+// the whole of a SPIR-V file in one read, sized from the file system; from archive when it has it
+static bool read_spirv(const std::string& path, std::vector<uint32_t>& code, const AssetArchive& archive)
+{
+	const uint8_t* packed;
+	size_t packedSize;
+	if (archive.find(path, packed, packedSize))
+	{
+		if (packedSize == 0 || packedSize % sizeof(uint32_t) != 0)
+		{
+			return false;
+		}
+		// blobs are aligned, and the registry keys modules by their code, so this is the one copy
+		const uint32_t* words = reinterpret_cast<const uint32_t*>(packed);
+		code.assign(words, words + packedSize / sizeof(uint32_t));
+		return true;
+	}
+
+	std::error_code ec;
+	const uintmax_t fileSize = std::filesystem::file_size(path, ec);
+	if (ec || fileSize == 0 || fileSize % sizeof(uint32_t) != 0)
+	{
+		return false;
+	}
+
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+	{
+		return false;
+	}
+	code.resize(static_cast<size_t>(fileSize) / sizeof(uint32_t));
+	return static_cast<bool>(file.read(reinterpret_cast<char*>(code.data()), static_cast<std::streamsize>(fileSize)));
+}
+
+void VulkanEngine::preload_shaders(const std::string& folder)
+{
+	std::vector<std::string> paths;
+	std::error_code ec;
+	for (const auto& entry : std::filesystem::directory_iterator(folder, ec))
+	{
+		if (entry.path().extension() == ".spv")
+		{
+			// spelled the way load_shader_module is called
+			paths.push_back(folder + "/" + entry.path().filename().string());
+		}
+	}
+	// shaders only in the archive, for deploys without the loose files
+	const std::string prefix = folder + "/";
+	for (const std::string& name : _assetArchive.names())
+	{
+		if (name.compare(0, prefix.size(), prefix) == 0 && std::filesystem::path(name).extension() == ".spv"
+			&& std::find(paths.begin(), paths.end(), name) == paths.end())
+		{
+			paths.push_back(name);
+		}
+	}
+
+	struct Preload {
+		PreloadedShader shader;
+		bool loaded;
+		float milliseconds;
+	};
+	std::vector<Preload> preloads(paths.size());
+	auto start = std::chrono::high_resolution_clock::now();
+	parallel_for(paths.size(), [&](size_t i) {
+		auto fileStart = std::chrono::high_resolution_clock::now();
+		Preload& preload = preloads[i];
+		std::vector<uint32_t> code;
+		preload.loaded = read_spirv(paths[i], code, _assetArchive) && _pipelineRegistry.shader_module(code, &preload.shader.module);
+		preload.shader.reflected = preload.loaded && reflect_spirv(code.data(), code.size(), preload.shader.reflection);
+		preload.milliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - fileStart).count();
+	});
+	const float totalMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	LOG_INFO("Preloaded " << paths.size() << " shaders from " << folder << " in " << totalMs << " ms:");
+	for (size_t i = 0; i < paths.size(); i++)
+	{
+		LOG_INFO("  " << paths[i] << ": " << preloads[i].milliseconds << " ms" << (preloads[i].loaded ? "" : ", failed"));
+		if (preloads[i].loaded)
+		{
+			_preloadedShaders[paths[i]] = std::move(preloads[i].shader);
+		}
+	}
+}
+
+std::string VulkanEngine::half_precision_variant(const char* spvPath) const
+{
+	std::string path = spvPath;
+	const std::string suffix = ".spv";
+	if (_halfPrecisionSupported && path.size() > suffix.size() && path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0)
+	{
+		path.insert(path.size() - suffix.size(), ".half");
+	}
+	return path;
+}
+
+bool VulkanEngine::load_shader_module(const char* filePath, VkShaderModule* outShaderModule)
+{
+	VkShaderModule shaderModule;
+	ShaderReflection reflection;
+	bool reflected;
+	auto preloaded = _preloadedShaders.find(filePath);
+	if (preloaded != _preloadedShaders.end())
+	{
+		shaderModule = preloaded->second.module;
+		reflection = preloaded->second.reflection;
+		reflected = preloaded->second.reflected;
+	}
+	else
+	{
+		// load the shader into vulkan, or get the module of the same code loaded before
+		std::vector<uint32_t> buffer;
+		if (!read_spirv(filePath, buffer, _assetArchive) || !_pipelineRegistry.shader_module(buffer, &shaderModule))
+		{
+			return false;
+		}
+		reflected = reflect_spirv(buffer.data(), buffer.size(), reflection);
+	}
+	*outShaderModule = shaderModule;
+	_shaderReload.note_module(shaderModule, filePath);
+
+	if (reflected)
+	{
+		_shaderReflections[shaderModule] = reflection;
+	}
+	else
+	{
+		_shaderReflections.erase(shaderModule);
+		LOG_ERROR("Could not reflect " << filePath << ", its layouts must be given by hand");
+	}
+	return true;
+}
+
+ShaderReflection VulkanEngine::reflect_stages(std::initializer_list<VkShaderModule> shaders) const
+{
+	ShaderReflection merged;
+	for (VkShaderModule shader : shaders)
+	{
+		auto reflection = _shaderReflections.find(shader);
+		if (reflection != _shaderReflections.end())
+		{
+			merged.merge(reflection->second);
+		}
+	}
+	return merged;
+}
+
+VkPipelineLayout VulkanEngine::reflect_pipeline_layout(const ShaderReflection& reflection, std::vector<VkDescriptorSetLayout> setLayouts)
+{
+	setLayouts.resize(reflection.set_count(), VK_NULL_HANDLE);
+	for (uint32_t set = 0; set < setLayouts.size(); set++)
+	{
+		if (setLayouts[set] == VK_NULL_HANDLE)
+		{
+			// every uniform buffer of the engine is bound with a dynamic offset into the frame's data
+			setLayouts[set] = _layoutCache.set_layout(reflection.set_bindings(set, true));
+		}
+	}
+
+	std::vector<VkPushConstantRange> pushConstants;
+	if (reflection.pushConstantSize > 0)
+	{
+		VkPushConstantRange range;
+		range.offset = 0;
+		range.size = reflection.pushConstantSize;
+		range.stageFlags = reflection.pushConstantStages;
+		pushConstants.push_back(range);
+	}
+	return _layoutCache.pipeline_layout(setLayouts, pushConstants);
+}
+
+void VulkanEngine::init_pipeline_cache()
+{
+	// header layout every driver writes at the start of its cache data (VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+	struct PipelineCacheHeader {
+		uint32_t headerSize;
+		uint32_t headerVersion;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+	};
+
+	// every session on the device compiles through the one its first session created
+	if (_deviceContext->pipelineCache != VK_NULL_HANDLE)
+	{
+		_pipelineCache = _deviceContext->pipelineCache;
+		_pipelineCachePath = _deviceContext->pipelineCachePath;
+		return;
+	}
+
+	std::vector<char> cacheData;
+
+	std::ifstream file(_pipelineCachePath, std::ios::ate | std::ios::binary);
+	if (file.is_open())
+	{
+		size_t fileSize = (size_t)file.tellg();
+		cacheData.resize(fileSize);
+		file.seekg(0);
+		file.read(cacheData.data(), fileSize);
+		file.close();
+	}
+
+	// only seed from data written by this exact GPU and driver build; anything else is thrown away
+	bool cacheValid = false;
+	if (cacheData.size() >= sizeof(PipelineCacheHeader))
+	{
+		PipelineCacheHeader header;
+		memcpy(&header, cacheData.data(), sizeof(PipelineCacheHeader));
+
+		cacheValid = header.headerSize >= sizeof(PipelineCacheHeader)
+			&& header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+			&& header.vendorID == _gpuProperties.vendorID
+			&& header.deviceID == _gpuProperties.deviceID
+			&& memcmp(header.pipelineCacheUUID, _gpuProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+	}
+
+	if (!cacheData.empty() && !cacheValid)
+	{
+		LOG_WARN("Pipeline cache " << _pipelineCachePath << " is stale or from another device, rebuilding.");
+	}
+
+	VkPipelineCacheCreateInfo cacheInfo = {};
+	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cacheInfo.pNext = nullptr;
+	cacheInfo.initialDataSize = cacheValid ? cacheData.size() : 0;
+	cacheInfo.pInitialData = cacheValid ? cacheData.data() : nullptr;
+
+	VK_CHECK(vkCreatePipelineCache(_device, &cacheInfo, nullptr, &_pipelineCache));
+
+	if (cacheValid)
+	{
+		LOG_INFO("Loaded pipeline cache (" << cacheData.size() << " bytes).");
+	}
+
+	// saved and destroyed with the device, once the last session is done compiling
+	_deviceContext->pipelineCache = _pipelineCache;
+	_deviceContext->pipelineCachePath = _pipelineCachePath;
+}
+
+void VulkanEngine::init_readback()
+{
+	CPU_PROFILE_SCOPE("init_readback");
+	if (!_useReadback)
+	{
+		return;
+	}
+
+	// without the shader frames come back as they are
+	VkShaderModule nv12Shader = VK_NULL_HANDLE;
+	if (_readbackFormat == ReadbackFormat::Nv12 && !load_shader_module("../../shaders/rgbToNv12.comp.spv", &nv12Shader))
+	{
+		LOG_ERROR("Error building NV12 conversion compute shader.");
+		nv12Shader = VK_NULL_HANDLE;
+	}
+
+	_readback.init(_device, _allocator, _descriptorAllocator, nv12Shader, _pipelineCache, _frameOverlap);
+	_readback.resize(_windowExtent, _swapchainImageFormat, _readbackFormat);
+	_mainDeletionQueue.push_function([=]() {
+		_readback.cleanup();
+	});
+	LOG_INFO("Frames read back as " << (_readback.format() == ReadbackFormat::Nv12 ? "NV12" : "RGBA"));
+}
+
+void VulkanEngine::init_video_encode()
+{
+	CPU_PROFILE_SCOPE("init_video_encode");
+	if (!_useVideoEncode)
+	{
+		return;
+	}
+
+	// the same conversion the NV12 readback uses, feeding the encoder's source pictures
+	VkShaderModule nv12Shader;
+	if (!load_shader_module("../../shaders/rgbToNv12.comp.spv", &nv12Shader))
+	{
+		LOG_ERROR("Error building NV12 conversion compute shader, video encode disabled");
+		_useVideoEncode = false;
+		return;
+	}
+	if (!_videoEncoder.init(_instance, _chosenGPU, _device, _allocator, _descriptorAllocator, nv12Shader, _pipelineCache,
+		_graphicsQueueFamily, _graphicsTimeline, _deviceContext->queueMutex, _frameOverlap, _encodeSettings))
+	{
+		LOG_WARN("No queue family encodes H.264, video encode disabled");
+		_videoEncoder.cleanup();
+		_useVideoEncode = false;
+		return;
+	}
+	_mainDeletionQueue.push_function([=]() {
+		_videoEncoder.cleanup();
+	});
+	if (!_videoEncoder.resize(_windowExtent, _swapchainImageFormat))
+	{
+		LOG_WARN("Video encoder can't take " << _windowExtent.width << "x" << _windowExtent.height << " frames, video encode disabled");
+		_useVideoEncode = false;
+		return;
+	}
+
+	if (!_encodePath.empty())
+	{
+		_encodeFile.open(_encodePath, std::ios::binary);
+		if (!_encodeFile)
+		{
+			LOG_ERROR("Could not open " << _encodePath << " for the encoded stream");
+		}
+	}
+	LOG_INFO("Frames encoded to H.264 on queue family " << _videoEncoder.queue_family()
+		<< (_videoEncoder.queue_family() == _graphicsQueueFamily ? " (shared with graphics)" : "")
+		<< (_encodeFile.is_open() ? ", written to " + _encodePath : std::string()));
+}
+
+void VulkanEngine::output_encoded_frame(const VideoEncoder::Packet& packet)
+{
+	if (_encodeFile.is_open())
+	{
+		_encodeFile.write(reinterpret_cast<const char*>(packet.data), static_cast<std::streamsize>(packet.size));
+	}
+	if (_onEncodedFrame)
+	{
+		_onEncodedFrame(packet);
+	}
+}
+
+void VulkanEngine::init_hud()
+{
+	CPU_PROFILE_SCOPE("init_hud");
+	_hud.init(_device, _allocator, _window);
+
+	immediate_submit([&](VkCommandBuffer cmd) {
+		_hud.upload_fonts(cmd);
+	});
+	_hud.release_font_upload();
+
+	_mainDeletionQueue.push_function([=]() {
+		_hud.cleanup();
+	});
+}
+
+void VulkanEngine::save_pipeline_cache()
+{
+	size_t dataSize = 0;
+	VK_CHECK(vkGetPipelineCacheData(_device, _pipelineCache, &dataSize, nullptr));
+	if (dataSize == 0)
+	{
+		return;
+	}
+
+	std::vector<char> cacheData(dataSize);
+	VK_CHECK(vkGetPipelineCacheData(_device, _pipelineCache, &dataSize, cacheData.data()));
+
+	std::ofstream file(_pipelineCachePath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		LOG_ERROR("Could not write pipeline cache to " << _pipelineCachePath);
+		return;
+	}
+	file.write(cacheData.data(), dataSize);
+}
+
+void VulkanEngine::init_instance_buffers()
+{
+	CPU_PROFILE_SCOPE("init_instance_buffers");
+	// host-visible so the CPU can write transforms straight into the buffer the GPU reads
+	// one per frame slot, so rewriting it never races a frame still in flight
+	for (uint32_t i = 0; i < _frameOverlap; i++)
+	{
+		// the cull pass writes surviving transforms here, so it's also a storage buffer
+		const std::string slot = " " + std::to_string(i);
+		// the extra views each have a stretch of instances and a slice of the draw records after both phases'
+		_frames[i]._instanceBuffer = create_buffer((1 + _sceneViewCount) * MAX_INSTANCES * sizeof(InstanceData), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, true,
+			("instances" + slot).c_str());
+		_frames[i]._instanceObjectBuffer = create_buffer((1 + _sceneViewCount) * MAX_INSTANCES * sizeof(uint32_t), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY, true,
+			("instance objects" + slot).c_str());
+		// at most one batch per object; the second half holds the second occlusion culling phase
+		_frames[i]._indirectBuffer = create_buffer((2 + _sceneViewCount) * MAX_INSTANCES * sizeof(GPUIndirectCommand), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, true,
+			("indirect" + slot).c_str());
+
+		_frames[i]._objectBuffer = create_buffer(MAX_INSTANCES * sizeof(GPUObjectSlot), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, true,
+			("cull objects" + slot).c_str());
+		// only ever touched by the GPU
+		_frames[i]._compactIndirectBuffer = create_buffer((2 + _sceneViewCount) * MAX_INSTANCES * sizeof(GPUIndirectCommand), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY, true,
+			("compact indirect" + slot).c_str());
+		_frames[i]._drawCountBuffer = create_buffer((2 + _sceneViewCount) * MAX_INSTANCES * sizeof(uint32_t), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, true,
+			("draw counts" + slot).c_str());
+
+		AllocatedBuffer instanceBuffer = _frames[i]._instanceBuffer;
+		AllocatedBuffer instanceObjectBuffer = _frames[i]._instanceObjectBuffer;
+		AllocatedBuffer indirectBuffer = _frames[i]._indirectBuffer;
+		AllocatedBuffer objectBuffer = _frames[i]._objectBuffer;
+		AllocatedBuffer compactIndirectBuffer = _frames[i]._compactIndirectBuffer;
+		AllocatedBuffer drawCountBuffer = _frames[i]._drawCountBuffer;
+		_mainDeletionQueue.push_buffer(instanceBuffer);
+		_mainDeletionQueue.push_buffer(instanceObjectBuffer);
+		_mainDeletionQueue.push_buffer(indirectBuffer);
+		_mainDeletionQueue.push_buffer(objectBuffer);
+		_mainDeletionQueue.push_buffer(compactIndirectBuffer);
+		_mainDeletionQueue.push_buffer(drawCountBuffer);
+
+		_frames[i]._arena.init(FRAME_ARENA_SIZE);
+		FrameArena* arena = &_frames[i]._arena;
+		_mainDeletionQueue.push_function([=]() {
+			arena->cleanup();
+		});
+
+		if (_objectDataPath != ObjectDataPath::PushConstants)
+		{
+			// written by the recording threads as they go, straight into its persistent mapping
+			_frames[i]._drawDataBuffer = create_buffer(size_t(MAX_DRAW_DATA) * _drawDataStride,
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, false, ("draw data" + slot).c_str());
+			_frames[i]._drawData = static_cast<uint8_t*>(_frames[i]._drawDataBuffer._mapped);
+			_mainDeletionQueue.push_buffer(_frames[i]._drawDataBuffer);
+		}
+	}
+}
+
+void VulkanEngine::choose_object_data_path()
+{
+	if (_objectDataAuto)
+	{
+		// the last result of every path on this device; lines are vendor,device,path,cpu ms,gpu ms
+		double frameMs[OBJECT_DATA_PATH_COUNT];
+		std::fill(frameMs, frameMs + OBJECT_DATA_PATH_COUNT, -1.0);
+		std::ifstream results(_objectDataResultsPath);
+		std::string line;
+		while (std::getline(results, line))
+		{
+			std::istringstream fields(line);
+			std::string vendor, device, path, cpu, gpu;
+			if (!std::getline(fields, vendor, ',') || !std::getline(fields, device, ',') || !std::getline(fields, path, ',')
+				|| !std::getline(fields, cpu, ',') || !std::getline(fields, gpu, ','))
+			{
+				continue;
+			}
+			if (strtoul(vendor.c_str(), nullptr, 10) != _gpuProperties.vendorID || strtoul(device.c_str(), nullptr, 10) != _gpuProperties.deviceID)
+			{
+				continue;
+			}
+			for (uint32_t p = 0; p < OBJECT_DATA_PATH_COUNT; p++)
+			{
+				if (path == object_data_path_name(static_cast<ObjectDataPath>(p)))
+				{
+					// the frame waits for whichever side is slower
+					frameMs[p] = std::max(atof(cpu.c_str()), atof(gpu.c_str()));
+				}
+			}
+		}
+
+		_objectDataPath = ObjectDataPath::PushConstants;
+		for (uint32_t p = 0; p < OBJECT_DATA_PATH_COUNT; p++)
+		{
+			const double current = frameMs[static_cast<uint32_t>(_objectDataPath)];
+			if (frameMs[p] >= 0.0 && (current < 0.0 || frameMs[p] < current))
+			{
+				_objectDataPath = static_cast<ObjectDataPath>(p);
+			}
+		}
+	}
+	LOG_INFO("Per-draw object data through " << object_data_path_name(_objectDataPath));
+
+	// every slot of the uniform path is bound at its own offset
+	const VkDeviceSize alignment = _gpuProperties.limits.minUniformBufferOffsetAlignment;
+	_drawDataStride = sizeof(GPUDrawData);
+	if (_objectDataPath == ObjectDataPath::DynamicUniform && alignment > 0)
+	{
+		_drawDataStride = static_cast<uint32_t>((sizeof(GPUDrawData) + alignment - 1) / alignment * alignment);
+	}
+	// the storage path indexes an array, whose stride is the struct's
+}
+
+void VulkanEngine::record_object_data_result(double cpuMs, double gpuMs)
+{
+	std::ofstream results(_objectDataResultsPath, std::ios::app);
+	if (!results)
+	{
+		LOG_ERROR("Couldn't write " << _objectDataResultsPath);
+		return;
+	}
+	results << _gpuProperties.vendorID << "," << _gpuProperties.deviceID << "," << object_data_path_name(_objectDataPath)
+		<< "," << cpuMs << "," << gpuMs << "\n";
+	LOG_INFO("draw_data result for " << object_data_path_name(_objectDataPath) << " added to " << _objectDataResultsPath);
+}
+
+void VulkanEngine::apply_tuning()
+{
+	_tuningPath = tuning::path(_tuningDirectory, device_uuid(_chosenGPU));
+	TunedSettings tuned;
+	_tuningLoaded = tuning::load(_tuningPath, tuned);
+	if (_useTuning && _tuningLoaded)
+	{
+		LOG_INFO("Tuned for " << _gpuProperties.deviceName << " by " << _tuningPath << ": " << tuning::describe(tuned));
+		if (!(_pinnedTuning & TUNE_FRAME_OVERLAP)) _frameOverlap = std::clamp(tuned.frameOverlap, 2u, MAX_FRAME_OVERLAP);
+		if (!(_pinnedTuning & TUNE_JOB_THREADS)) _jobThreadCount = tuned.jobThreads;
+		if (!(_pinnedTuning & TUNE_CULL_CHUNK)) _cullChunkSize = tuned.cullChunkSize;
+		if (!(_pinnedTuning & TUNE_UPLOAD_BUDGET)) _uploadBytesPerFrame = tuned.uploadBytesPerFrame;
+		// lowered to what the device supports like a requested count
+		if (!(_pinnedTuning & TUNE_MSAA)) _msaaSamples = tuned.msaaSamples;
+	}
+	_renderSpheres.set_chunk_size(_cullChunkSize);
+	_renderSpheres.set_coherence(_cullCoherence);
+
+	// nothing is queued yet, so the workers can be swapped for the tuned number
+	if (_jobThreadCount != 0 && _jobThreadCount != _jobSystem.worker_count())
+	{
+		_jobSystem.cleanup();
+		_jobSystem.init(_jobThreadCount);
+		JobSystem::set_shared(&_jobSystem);
+	}
+}
+
+void VulkanEngine::init_descriptors()
+{
+	CPU_PROFILE_SCOPE("init_descriptors");
+	_descriptorAllocator.init(_device);
+	_descriptorSetCache.init(_device, _frameOverlap);
+	_layoutCache.init(_device);
+
+	// one buffer for every frame in flight; aligned so any allocation can be bound as a uniform or storage buffer.
+	// The culling reads the camera from it, on the compute queue with async compute
+	VkDeviceSize gpuDataAlignment = std::max(_gpuProperties.limits.minUniformBufferOffsetAlignment, _gpuProperties.limits.minStorageBufferOffsetAlignment);
+	const uint32_t gpuDataFamilies[] = { _graphicsQueueFamily, _computeQueueFamily };
+	_frameGpuData.init(_allocator, FRAME_GPU_DATA_SIZE, _frameOverlap,
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT
+			| VK_BUFFER_USAGE_TRANSFER_SRC_BIT, // stages the material parameter updates
+		gpuDataAlignment, _useAsyncCompute ? 2 : 0, gpuDataFamilies, _useResizableBar);
+	// culled on either queue too
+	_gpuScene.init(_allocator, MAX_INSTANCES, _useAsyncCompute ? 2 : 0, gpuDataFamilies);
+	_debugUtils.name(VK_OBJECT_TYPE_BUFFER, _frameGpuData.buffer(), "frame data");
+	_debugUtils.name(VK_OBJECT_TYPE_BUFFER, _gpuScene.buffer(), "gpu scene");
+
+	// the fragment shaders read the shadow cascades from the camera and sample the shadow map,
+	// which init_shadows writes, the clustered point lights, which init_lights writes, and the ray shadow
+	// mask, which init_ray_shadows writes
+	VkDescriptorSetLayoutBinding globalBindings[] = {
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0), // camera
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1), // shadow map
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 2), // point lights
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 3), // light grid
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 4), // light indices
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 5), // ray shadow mask
+	};
+#ifdef VK_EXT_mesh_shader
+	// the meshlet pipeline culls and transforms against the same camera
+	if (_meshShadingSupported)
+	{
+		globalBindings[0].stageFlags |= VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+	}
+#endif
+
+	VkDescriptorSetLayoutCreateInfo setInfo = {};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setInfo.pNext = nullptr;
+	setInfo.bindingCount = 6;
+	setInfo.pBindings = globalBindings;
+	VK_CHECK(vkCreateDescriptorSetLayout(_device, &setInfo, nullptr, &_globalSetLayout));
+
+	// a single set serves every frame; only the dynamic offset changes
+	_descriptorAllocator.allocate(&_globalDescriptor, _globalSetLayout);
+
+	VkDescriptorBufferInfo cameraInfo = { _frameGpuData.buffer(), 0, sizeof(GPUCameraData) };
+	VkWriteDescriptorSet cameraWrite = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, _globalDescriptor, &cameraInfo, 0);
+	vkUpdateDescriptorSets(_device, 1, &cameraWrite, 0, nullptr);
+
+	_mainDeletionQueue.push_descriptor_set_layout(_globalSetLayout);
+	_mainDeletionQueue.push_function([=]() {
+		_layoutCache.cleanup();
+		_descriptorSetCache.cleanup();
+		_descriptorAllocator.cleanup();
+		_frameGpuData.cleanup();
+		_gpuScene.cleanup();
+	});
+}
+
+void VulkanEngine::init_bindless()
+{
+	CPU_PROFILE_SCOPE("init_bindless");
+	if (!_useBindless)
+	{
+		LOG_WARN("Descriptor indexing unavailable, bindless materials disabled");
+		return;
+	}
+
+	_materialStore.init(_allocator, MAX_MATERIALS);
+
+	// textures are added while frames using the set are in flight, so the array is update-after-bind;
+	// partially bound, so slots nobody has filled yet are never validated
+	VkDescriptorSetLayoutBinding bindings[] = {
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0), // textures
+		vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 1), // materials
+	};
+	bindings[0].descriptorCount = MAX_BINDLESS_TEXTURES;
+
+	VkDescriptorBindingFlagsEXT bindingFlags[] = {
+		VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT,
+		0,
+	};
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flagsInfo = {};
+	flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+	flagsInfo.bindingCount = 2;
+	flagsInfo.pBindingFlags = bindingFlags;
+
+	VkDescriptorSetLayoutCreateInfo setInfo = {};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setInfo.pNext = &flagsInfo;
+	setInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+	setInfo.bindingCount = 2;
+	setInfo.pBindings = bindings;
+	VK_CHECK(vkCreateDescriptorSetLayout(_device, &setInfo, nullptr, &_bindlessSetLayout));
+
+	VkDescriptorPoolSize poolSizes[] = {
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_BINDLESS_TEXTURES },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 },
+	};
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.pNext = nullptr;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = 2;
+	poolInfo.pPoolSizes = poolSizes;
+	VK_CHECK(vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_bindlessPool));
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.pNext = nullptr;
+	allocInfo.descriptorPool = _bindlessPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &_bindlessSetLayout;
+	VK_CHECK(vkAllocateDescriptorSets(_device, &allocInfo, &_bindlessDescriptor));
+
+	VkDescriptorBufferInfo materialInfo = { _materialStore.buffer(), 0, VK_WHOLE_SIZE };
+	VkWriteDescriptorSet materialWrite = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _bindlessDescriptor, &materialInfo, 1);
+	vkUpdateDescriptorSets(_device, 1, &materialWrite, 0, nullptr);
+
+	_mainDeletionQueue.push_descriptor_pool(_bindlessPool);
+	_mainDeletionQueue.push_descriptor_set_layout(_bindlessSetLayout);
+	_mainDeletionQueue.push_function([=]() {
+		_materialStore.cleanup();
+	});
+}
+
+void VulkanEngine::init_shadows()
+{
+	CPU_PROFILE_SCOPE("init_shadows");
+	// D16_UNORM must support sampled depth attachments everywhere; D32_SFLOAT keeps more precision
+	// over the long depth range of the far cascades where it can be sampled
+	VkFormatProperties formatProperties;
+	VkFormat shadowFormat = VK_FORMAT_D32_SFLOAT;
+	vkGetPhysicalDeviceFormatProperties(_chosenGPU, shadowFormat, &formatProperties);
+	if ((formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) == 0)
+	{
+		shadowFormat = VK_FORMAT_D16_UNORM;
+		vkGetPhysicalDeviceFormatProperties(_chosenGPU, shadowFormat, &formatProperties);
+	}
+	const bool linearFilter = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) != 0;
+
+	_shadows.init(_device, _allocator, shadowFormat, _shadowResolution, linearFilter);
+	_mainDeletionQueue.push_function([=]() {
+		_shadows.cleanup();
+	});
+	LOG_INFO("Shadow cascades " << _shadowResolution << "x" << _shadowResolution << ", "
+		<< (shadowFormat == VK_FORMAT_D32_SFLOAT ? "D32_SFLOAT" : "D16_UNORM") << (linearFilter ? ", filtered" : ""));
+
+	// readable from the first frame, including frames that don't render it
+	immediate_submit([&](VkCommandBuffer cmd) {
+		_shadows.clear(cmd);
+	});
+
+	VkDescriptorImageInfo shadowInfo = {};
+	shadowInfo.sampler = _shadows.sampler();
+	shadowInfo.imageView = _shadows.view();
+	shadowInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	VkWriteDescriptorSet shadowWrite = vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _globalDescriptor, &shadowInfo, 1);
+	vkUpdateDescriptorSets(_device, 1, &shadowWrite, 0, nullptr);
+}
+
+uint32_t VulkanEngine::register_bindless_texture(Texture& texture)
+{
+	// slots of retired images come back once no frame in flight can sample them
+	if (_useBindless && !_freeBindlessSlots.empty())
+	{
+		texture._bindlessIndex = _freeBindlessSlots.back();
+		_freeBindlessSlots.pop_back();
+	}
+	else if (!_useBindless || _bindlessTextureCount >= MAX_BINDLESS_TEXTURES)
+	{
+		return INVALID_BINDLESS_INDEX;
+	}
+	else
+	{
+		texture._bindlessIndex = _bindlessTextureCount++;
+	}
+
+	VkDescriptorImageInfo imageInfo = {};
+	imageInfo.sampler = _linearSampler;
+	imageInfo.imageView = texture._imageView;
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	// the slot was never used by a recorded frame, so update-after-bind makes this safe mid-flight
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.pNext = nullptr;
+	write.dstSet = _bindlessDescriptor;
+	write.dstBinding = 0;
+	write.dstArrayElement = texture._bindlessIndex;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	write.pImageInfo = &imageInfo;
+	vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+
+	return texture._bindlessIndex;
+}
+
+PipelineDescription VulkanEngine::describe_main_pass(const PipelineBuilder& builder) const
+{
+	PipelineDescription description = _useDynamicRendering
+		? builder.describe_dynamic(&_sceneColorFormat, _depthFormat)
+		: builder.describe(_renderPass);
+	description.multisampling.rasterizationSamples = _msaaSamples;
+	// with dynamic rendering; render pass objects carry it themselves
+	description.viewMask = _useDynamicRendering ? main_view_mask() : 0;
+	// every pipeline of a pass with a rate image must allow for it, whatever its own rate
+	description.shadingRateAttachment = _useShadingRateImage;
+	return description;
+}
+
+void VulkanEngine::bind_graphics_pipeline(VkCommandBuffer cmd, VkPipeline pipeline) const
+{
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	_pipelineManifest.note_bound(pipeline);
+}
+
+void VulkanEngine::replace_pipeline(VkPipeline previous, VkPipeline pipeline)
+{
+	_staticDrawGeneration++;
+	request_redraw();
+	_pipelineManifest.retrack(previous, pipeline);
+	_shaderStatistics.recapture(previous, pipeline);
+	for (size_t i = 0; i < _pipelineSlots.size(); i++)
+	{
+		if (*_pipelineSlots[i] == previous)
+		{
+			*_pipelineSlots[i] = pipeline;
+			_debugUtils.name(VK_OBJECT_TYPE_PIPELINE, pipeline, _pipelineSlotNames[i]);
+		}
+	}
+	for (auto& material : _materials)
+	{
+		Material& mat = material.second;
+		VkPipeline* pipelines[] = { &mat.pipeline, &mat.instancedPipeline, &mat.depthPipeline, &mat.depthInstancedPipeline };
+		for (VkPipeline* slot : pipelines)
+		{
+			if (*slot == previous)
+			{
+				*slot = pipeline;
+			}
+		}
+	}
+	// materials made from a template later start from the rebuilt pipeline as well
+	for (auto& entry : _materialTemplates)
+	{
+		MaterialTemplate& shading = entry.second;
+		for (uint32_t format = 0; format < VERTEX_FORMAT_COUNT; format++)
+		{
+			VkPipeline* pipelines[] = { &shading.pipeline[format], &shading.instancedPipeline[format], &shading.depthPipeline[format], &shading.depthInstancedPipeline[format] };
+			for (VkPipeline* slot : pipelines)
+			{
+				if (*slot == previous)
+				{
+					*slot = pipeline;
+				}
+			}
+		}
+	}
+}
+
+void VulkanEngine::swap_specialized_pipelines()
+{
+	for (size_t i = 0; i < _specializingPipelines.size();)
+	{
+		SpecializingPipeline& pending = _specializingPipelines[i];
+		if (pending.pipeline.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		{
+			i++;
+			continue;
+		}
+		// the registry owns the fallback as well, so it stays until shutdown rather than being retired
+		const VkPipeline pipeline = pending.pipeline.get();
+		if (pipeline == VK_NULL_HANDLE)
+		{
+			LOG_WARN("A specialized pipeline failed to compile, its generic build keeps drawing.");
+		}
+		else
+		{
+			replace_pipeline(pending.fallback, pipeline);
+		}
+		_specializingPipelines[i] = std::move(_specializingPipelines.back());
+		_specializingPipelines.pop_back();
+	}
+}
+
+void VulkanEngine::init_pipelines()
+{
+	CPU_PROFILE_SCOPE("init_pipelines");
+	heap_stats::Scope heapScope(HeapTag::Pipelines);
+	init_pipeline_cache();
+	_pipelineRegistry.init(_device, _pipelineCache, _usePipelineLibraries);
+	_mainDeletionQueue.push_function([=]() {
+		_pipelineRegistry.cleanup();
+	});
+	if (_pipelineManifest.load(_pipelineManifestPath))
+	{
+		LOG_INFO("Pipeline manifest lists " << _pipelineManifest.size() << " pipelines drawn with before");
+	}
+#ifdef GLSL_VALIDATOR_PATH
+	_shaderReload.init(_device, _pipelineCache, GLSL_VALIDATOR_PATH);
+#else
+	_shaderReload.init(_device, _pipelineCache, "glslangValidator");
+#endif
+	preload_shaders("../../shaders");
+
+	// the pre-pass's EQUAL test needs the color pass to compute positions exactly as the fixed-function
+	// fetch of the depth-only pipelines does, which the shader unpacking of PackedVertex doesn't promise
+	if (_useVertexPulling && _depthPrepass)
+	{
+		LOG_INFO("Vertex pulling draws the mesh materials without a depth pre-pass.");
+		_depthPrepass = false;
+	}
+
+	// the state every mesh material template starts from; each pipeline below changes only what it needs
+	PipelineBuilder pipelineBuilder;
+
+	// vertex input comes with each pipeline's vertex format
+	pipelineBuilder._vertexInputInfo = vkinit::vertex_input_state_create_info();
+
+	// config for what kind of geo to draw (tris/lines/points)
+	pipelineBuilder._inputAssembly = vkinit::input_assembly_create_info(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+
+	// viewport and scissor are dynamic state set in draw(); these are only placeholders
+	pipelineBuilder._viewport.x = 0.0f;
+	pipelineBuilder._viewport.y = 0.0f;
+	pipelineBuilder._viewport.width = (float)_windowExtent.width;
+	pipelineBuilder._viewport.height = (float)_windowExtent.height;
+	pipelineBuilder._viewport.minDepth = 0.0f;
+	pipelineBuilder._viewport.maxDepth = 1.0f;
+
+	pipelineBuilder._scissor.offset = { 0, 0 };
+	pipelineBuilder._scissor.extent = _windowExtent; //note: scissor might want to be larger?
+
+	// draw filled triangles
+	pipelineBuilder._rasterizer = vkinit::rasterization_state_create_info(VK_POLYGON_MODE_FILL);
+
+	// don't use MSAA, just use default
+	pipelineBuilder._multisampling = vkinit::multisampling_state_create_info();
+
+	// single blend attachment with no blending, write to RGBA
+	pipelineBuilder._colorBlendAttachment = vkinit::color_blend_attachment_state();
+
+	pipelineBuilder._depthStencil = vkinit::depth_stencil_create_info(true, true, depth_compare_op());
+
+	// the rasterizer and depth state above then only matter without the extension; draws set their own
+	pipelineBuilder._dynamicDrawState = _useExtendedDynamicState;
+	// and so does the shading rate of the mesh pipelines, with variable rate shading
+	pipelineBuilder._shadingRate = _useShadingRate;
+	pipelineBuilder._captureStatistics = _captureShaderStatistics;
+
+	// snapshot the builder state and start compiling it on a worker
+	// the builder itself is reused for the next pipelines while this one compiles
+	// a description seen before gets the pipeline already compiling for it
+	_pendingPipelines.clear();
+	_pendingPipelineTargets.clear();
+	_pendingPipelineHashes.clear();
+	_pendingPipelineFallbacks.clear();
+	_specializingPipelines.clear();
+	// the mesh materials' fragment constant turns on the clustered lights; without them it has its default
+	// value, and there's nothing a generic build could stand in for
+	const bool meshFallbacks = _useFallbackPipelines && !_usePipelineLibraries && _useClusteredLights;
+	// every pipeline is also handed to the hot reload, which rebuilds it from the same description.
+	// With fallback, the build without fragment constants is started too, for finish_pipelines
+	auto queue_pipeline = [&](const PipelineDescription& description, VkPipeline* target, const char* name, bool fallback = false) {
+		_shaderReload.track(description, target);
+		const uint64_t hash = PipelineManifest::hash(description, name, [this](VkShaderModule module) {
+			return _pipelineRegistry.module_hash(module);
+		});
+		_pendingPipelines.push_back(_pipelineRegistry.pipeline(description, _pipelineManifest.contains(hash)));
+		_pendingPipelineFallbacks.push_back(fallback
+			? _pipelineRegistry.pipeline(description.unspecialized(VK_SHADER_STAGE_FRAGMENT_BIT))
+			: std::shared_future<VkPipeline>());
+		_pendingPipelineTargets.push_back(target);
+		_pendingPipelineHashes.push_back(hash);
+		_pipelineSlots.push_back(target);
+		_pipelineSlotNames.push_back(name);
+	};
+
+	// build the mesh pipeline
+	// the vertex input of every mesh pipeline below comes from the formats' constexpr layouts (Mesh.h);
+	// the instanced ones append INSTANCE_LAYOUT, also at compile time
+	static constexpr auto instancedLayout = concat_vertex_layouts(VERTEX_LAYOUT, INSTANCE_LAYOUT);
+	static constexpr auto packedInstancedLayout = concat_vertex_layouts(PACKED_VERTEX_LAYOUT, INSTANCE_LAYOUT);
+	static constexpr auto splitInstancedLayout = concat_vertex_layouts(SPLIT_VERTEX_LAYOUT, INSTANCE_LAYOUT);
+	static constexpr auto voxelInstancedLayout = concat_vertex_layouts(VOXEL_VERTEX_LAYOUT, INSTANCE_LAYOUT);
+	VERTEX_LAYOUT.apply(pipelineBuilder._vertexInputInfo);
+
+	pipelineBuilder._shaderStages.clear();
+
+	// compile mesh vertex shader
+	VkShaderModule meshVertexShader;
+	if (!load_shader_module("../../shaders/helloTriangleMesh.vert.spv", &meshVertexShader))
+	{
+		LOG_ERROR("Error building triangle mesh vert shader.");
+	}
+	else
+	{
+		LOG_INFO("Triangle mesh vertex shader successfully loaded.");
+	}
+
+	// bindless draws fetch their material from set 1 by index; the rest ignore the index and set 1.
+	// Both shade with the shadow map from set 0
+	VkShaderModule meshFragShader;
+	if (!load_shader_module(half_precision_variant(_useBindless ? "../../shaders/bindlessMesh.frag.spv" : "../../shaders/helloTriangleMesh.frag.spv").c_str(),
+		&meshFragShader))
+	{
+		LOG_ERROR("Error building mesh frag shader.");
+	}
+	else
+	{
+		LOG_INFO("Mesh fragment shader successfully loaded.");
+	}
+
+	pipelineBuilder._shaderStages.push_back(
+		vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, meshVertexShader)
+	);
+
+	pipelineBuilder._shaderStages.push_back(
+		vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, meshFragShader)
+	);
+	// the lit variant adds the clustered point lights; stages pushed in place of these keep the same slots
+	const ShaderSpecialization meshFragSpecialization = ShaderSpecialization().set<VkBool32>(0, _useClusteredLights);
+	// the vertex shaders, the depth pre-pass's included, read the per-draw data where draw_objects puts it;
+	// the other vertex shaders that take this slot don't declare the constant
+	const ShaderSpecialization meshVertexSpecialization = ShaderSpecialization().set<uint32_t>(0, static_cast<uint32_t>(_objectDataPath));
+	pipelineBuilder._specializations = { meshVertexSpecialization, meshFragSpecialization };
+
+	// create mesh pipeline layout: the push constants and sets come from the shaders.
+	// set 0: camera data shared by the whole frame; set 1: bindless textures and materials, which only
+	// the bindless fragment shader declares. Both are shared with other pipelines, so they are our own.
+	// set 2: the per-draw data slots, as bound by the uniform and storage object data paths
+	const ShaderReflection meshReflection = reflect_stages({ meshVertexShader, meshFragShader });
+	if (meshReflection.pushConstantSize != sizeof(MeshPushConstants))
+	{
+		LOG_WARN("Mesh shaders push " << meshReflection.pushConstantSize << " bytes of constants, MeshPushConstants has " << sizeof(MeshPushConstants));
+	}
+	_drawDataSetLayout = _layoutCache.set_layout(meshReflection.set_bindings(2, true));
+
+	// the pulled vertex shaders widen the layout by set 3 and the format constant rather than having one
+	// of their own: every mesh pipeline keeps sharing it, so sets bound for one stay bound for the rest
+	VkShaderModule pulledVertexShader = VK_NULL_HANDLE;
+	VkShaderModule pulledInstancedVertexShader = VK_NULL_HANDLE;
+	if (_useVertexPulling)
+	{
+		const bool loaded = load_shader_module("../../shaders/meshPulled.vert.spv", &pulledVertexShader);
+		const bool instancedLoaded = load_shader_module("../../shaders/instancedMeshPulled.vert.spv", &pulledInstancedVertexShader);
+		if (!loaded || !instancedLoaded)
+		{
+			LOG_ERROR("Error building pulled mesh vert shaders, meshes are fetched by vertex format.");
+			_useVertexPulling = false;
+		}
+		else
+		{
+			LOG_INFO("Pulled mesh vertex shaders successfully loaded.");
+		}
+	}
+	if (_useVertexPulling)
+	{
+		const ShaderReflection pulledReflection = reflect_stages({ pulledVertexShader, meshFragShader });
+		if (pulledReflection.pushConstantSize != MESH_VERTEX_FORMAT_OFFSET + sizeof(uint32_t))
+		{
+			LOG_WARN("Pulled mesh shaders push " << pulledReflection.pushConstantSize << " bytes of constants, expected "
+				<< MESH_VERTEX_FORMAT_OFFSET + sizeof(uint32_t));
+		}
+		_vertexPullSetLayout = _layoutCache.set_layout(pulledReflection.set_bindings(3, false));
+		_meshPipelineLayout = reflect_pipeline_layout(pulledReflection,
+			{ _globalSetLayout, _bindlessSetLayout, _drawDataSetLayout, _vertexPullSetLayout });
+	}
+	else
+	{
+		_meshPipelineLayout = reflect_pipeline_layout(meshReflection, { _globalSetLayout, _bindlessSetLayout, _drawDataSetLayout });
+	}
+	if (_objectDataPath != ObjectDataPath::PushConstants)
+	{
+		for (uint32_t i = 0; i < _frameOverlap; i++)
+		{
+			_descriptorAllocator.allocate(&_frames[i]._drawDataDescriptor, _drawDataSetLayout);
+			// the uniform binding sees one slot, moved by the dynamic offset; the storage one all of them
+			VkDescriptorBufferInfo uniformInfo = { _frames[i]._drawDataBuffer._buffer, 0, sizeof(GPUDrawData) };
+			VkDescriptorBufferInfo storageInfo = { _frames[i]._drawDataBuffer._buffer, 0, VK_WHOLE_SIZE };
+			VkWriteDescriptorSet writes[] = {
+				vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, _frames[i]._drawDataDescriptor, &uniformInfo, 0),
+				vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _frames[i]._drawDataDescriptor, &storageInfo, 1),
+			};
+			vkUpdateDescriptorSets(_device, 2, writes, 0, nullptr);
+		}
+	}
+
+	pipelineBuilder._pipelineLayout = _meshPipelineLayout;
+
+	// with a pre-pass the depth is final before shading starts, so only the front-most fragment passes
+	VkShaderModule depthPrepassShader = VK_NULL_HANDLE;
+	VkShaderModule depthPrepassInstancedShader = VK_NULL_HANDLE;
+	if (_depthPrepass)
+	{
+		const bool loaded = load_shader_module("../../shaders/depthPrepass.vert.spv", &depthPrepassShader);
+		const bool instancedLoaded = load_shader_module("../../shaders/depthPrepassInstanced.vert.spv", &depthPrepassInstancedShader);
+		if (!loaded || !instancedLoaded)
+		{
+			LOG_ERROR("Error building depth pre-pass vert shaders, meshes shade without a pre-pass.");
+			_depthPrepass = false;
+		}
+		else
+		{
+			LOG_INFO("Depth pre-pass vertex shaders successfully loaded.");
+			pipelineBuilder._depthStencil = vkinit::depth_stencil_create_info(true, false, VK_COMPARE_OP_EQUAL);
+		}
+	}
+
+	queue_pipeline(describe_main_pass(pipelineBuilder), &_meshPipeline, "mesh", meshFallbacks);
+
+	// instanced mesh pipeline: same stages and layout, plus the per-instance binding
+	instancedLayout.apply(pipelineBuilder._vertexInputInfo);
+
+	VkShaderModule instancedMeshVertexShader;
+	if (!load_shader_module("../../shaders/instancedMesh.vert.spv", &instancedMeshVertexShader))
+	{
+		LOG_ERROR("Error building instanced mesh vert shader.");
+	}
+	else
+	{
+		LOG_INFO("Instanced mesh vertex shader successfully loaded.");
+	}
+
+	pipelineBuilder._shaderStages[0] = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, instancedMeshVertexShader);
+
+	queue_pipeline(describe_main_pass(pipelineBuilder), &_instancedMeshPipeline, "mesh instanced", meshFallbacks);
+
+	// packed-vertex variants of both mesh pipelines; the shaders are shared, the vertex fetch converts
+	// the unorm/snorm attributes to floats (vNormal then holds the octahedral encoding, which they ignore)
+	PACKED_VERTEX_LAYOUT.apply(pipelineBuilder._vertexInputInfo);
+
+	pipelineBuilder._shaderStages[0] = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, meshVertexShader);
+
+	queue_pipeline(describe_main_pass(pipelineBuilder), &_packedMeshPipeline, "mesh packed", meshFallbacks);
+
+	packedInstancedLayout.apply(pipelineBuilder._vertexInputInfo);
+
+	pipelineBuilder._shaderStages[0] = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, instancedMeshVertexShader);
+
+	queue_pipeline(describe_main_pass(pipelineBuilder), &_packedInstancedMeshPipeline, "mesh packed instanced", meshFallbacks);
+
+	// split-stream variants; the locations match Vertex, so only the vertex input state differs
+	SPLIT_VERTEX_LAYOUT.apply(pipelineBuilder._vertexInputInfo);
+
+	pipelineBuilder._shaderStages[0] = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, meshVertexShader);
+
+	queue_pipeline(describe_main_pass(pipelineBuilder), &_splitMeshPipeline, "mesh split", meshFallbacks);
+
+	splitInstancedLayout.apply(pipelineBuilder._vertexInputInfo);
+
+	pipelineBuilder._shaderStages[0] = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, instancedMeshVertexShader);
+
+	queue_pipeline(describe_main_pass(pipelineBuilder), &_splitInstancedMeshPipeline, "mesh split instanced", meshFallbacks);
+
+	// voxel chunks have shaders of their own, which take the face from the position's w; same layout
+	VkShaderModule voxelVertexShader = VK_NULL_HANDLE;
+	VkShaderModule voxelInstancedVertexShader = VK_NULL_HANDLE;
+	const bool voxelLoaded = load_shader_module("../../shaders/voxel.vert.spv", &voxelVertexShader);
+	const bool voxelInstancedLoaded = load_shader_module("../../shaders/voxelInstanced.vert.spv", &voxelInstancedVertexShader);
+	if (!voxelLoaded || !voxelInstancedLoaded)
+	{
+		LOG_ERROR("Error building voxel vert shaders.");
+	}
+	else
+	{
+		LOG_INFO("Voxel vertex shaders successfully loaded.");
+
+		VOXEL_VERTEX_LAYOUT.apply(pipelineBuilder._vertexInputInfo);
+		pipelineBuilder._shaderStages[0] = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, voxelVertexShader);
+		queue_pipeline(describe_main_pass(pipelineBuilder), &_voxelMeshPipeline, "mesh voxel", meshFallbacks);
+
+		voxelInstancedLayout.apply(pipelineBuilder._vertexInputInfo);
+		pipelineBuilder._shaderStages[0] = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, voxelInstancedVertexShader);
+		queue_pipeline(describe_main_pass(pipelineBuilder), &_voxelInstancedMeshPipeline, "mesh voxel instanced", meshFallbacks);
+	}
+
+	// the pulled pair: no per-vertex input at all, so every vertex format shares them; the instanced one
+	// keeps only the instance binding
+	if (_useVertexPulling)
+	{
+		pipelineBuilder._vertexInputInfo.pVertexAttributeDescriptions = nullptr;
+		pipelineBuilder._vertexInputInfo.vertexAttributeDescriptionCount = 0;
+		pipelineBuilder._vertexInputInfo.pVertexBindingDescriptions = nullptr;
+		pipelineBuilder._vertexInputInfo.vertexBindingDescriptionCount = 0;
+		pipelineBuilder._shaderStages[0] = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, pulledVertexShader);
+		queue_pipeline(describe_main_pass(pipelineBuilder), &_pulledMeshPipeline, "mesh pulled", meshFallbacks);
+
+		INSTANCE_LAYOUT.apply(pipelineBuilder._vertexInputInfo);
+		pipelineBuilder._shaderStages[0] = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, pulledInstancedVertexShader);
+		queue_pipeline(describe_main_pass(pipelineBuilder), &_pulledInstancedMeshPipeline, "mesh pulled instanced", meshFallbacks);
+	}
+
+	// depth-only pipelines: only the vertex attributes their shaders read, the position and the instance
+	// matrix, and no fragment stage or color writes. Interleaved layouts keep their stride; the split one
+	// drops its attribute binding, which is what saves the bandwidth
+	if (_depthPrepass)
+	{
+		const ShaderReflection depthReflection = reflect_stages({ depthPrepassShader });
+		const ShaderReflection depthInstancedReflection = reflect_stages({ depthPrepassInstancedShader });
+		const VertexInputDescription depthDescriptions[] = {
+			depthReflection.consumed_inputs(VERTEX_LAYOUT.description()),
+			depthInstancedReflection.consumed_inputs(instancedLayout.description()),
+			depthReflection.consumed_inputs(PACKED_VERTEX_LAYOUT.description()),
+			depthInstancedReflection.consumed_inputs(packedInstancedLayout.description()),
+			depthReflection.consumed_inputs(SPLIT_VERTEX_LAYOUT.description()),
+			depthInstancedReflection.consumed_inputs(splitInstancedLayout.description()),
+			depthReflection.consumed_inputs(VOXEL_VERTEX_LAYOUT.description()),
+			depthInstancedReflection.consumed_inputs(voxelInstancedLayout.description()),
+		};
+		VkPipeline* depthTargets[] = { &_depthMeshPipeline, &_depthInstancedMeshPipeline, &_depthPackedMeshPipeline, &_depthPackedInstancedMeshPipeline,
+			&_depthSplitMeshPipeline, &_depthSplitInstancedMeshPipeline, &_depthVoxelMeshPipeline, &_depthVoxelInstancedMeshPipeline };
+		const char* depthNames[] = { "depth", "depth instanced", "depth packed", "depth packed instanced", "depth split", "depth split instanced",
+			"depth voxel", "depth voxel instanced" };
+
+		pipelineBuilder._depthStencil = vkinit::depth_stencil_create_info(true, true, depth_compare_op());
+		pipelineBuilder._colorBlendAttachment.colorWriteMask = 0;
+		for (int i = 0; i < 8; i++)
+		{
+			const bool instanced = i % 2 == 1;
+			pipelineBuilder._shaderStages.clear();
+			pipelineBuilder._shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT,
+				instanced ? depthPrepassInstancedShader : depthPrepassShader));
+
+			pipelineBuilder._vertexInputInfo.pVertexAttributeDescriptions = depthDescriptions[i].attributes.data();
+			pipelineBuilder._vertexInputInfo.vertexAttributeDescriptionCount = depthDescriptions[i].attributes.size();
+			pipelineBuilder._vertexInputInfo.pVertexBindingDescriptions = depthDescriptions[i].bindings.data();
+			pipelineBuilder._vertexInputInfo.vertexBindingDescriptionCount = depthDescriptions[i].bindings.size();
+
+			queue_pipeline(describe_main_pass(pipelineBuilder), depthTargets[i], depthNames[i]);
+		}
+
+		// back to the defaults for the pipelines below, which draw without a pre-pass
+		pipelineBuilder._colorBlendAttachment = vkinit::color_blend_attachment_state();
+		pipelineBuilder._depthStencil = vkinit::depth_stencil_create_info(true, true, depth_compare_op());
+	}
+
+	// shadow casters: the same position-only input into the shadow cascades' depth-only pass.
+	// Slope-scaled bias keeps surfaces from shadowing themselves, and both faces cast, so thin
+	// or open meshes still block the light
+	VkShaderModule shadowVertexShader = VK_NULL_HANDLE;
+	if (!load_shader_module("../../shaders/shadow.vert.spv", &shadowVertexShader))
+	{
+		LOG_ERROR("Error building shadow vert shader, shadows disabled.");
+		_useShadows = false;
+	}
+	else
+	{
+		LOG_INFO("Shadow vertex shader successfully loaded.");
+
+		// just the light matrix as push constants
+		const ShaderReflection shadowReflection = reflect_stages({ shadowVertexShader });
+		_shadowPipelineLayout = reflect_pipeline_layout(shadowReflection);
+
+		const VertexInputDescription shadowDescriptions[] = {
+			shadowReflection.consumed_inputs(VERTEX_LAYOUT.description()),
+			shadowReflection.consumed_inputs(PACKED_VERTEX_LAYOUT.description()),
+			shadowReflection.consumed_inputs(SPLIT_VERTEX_LAYOUT.description()),
+			shadowReflection.consumed_inputs(VOXEL_VERTEX_LAYOUT.description()),
+		};
+		VkPipeline* shadowTargets[] = { &_shadowMeshPipeline, &_shadowPackedMeshPipeline, &_shadowSplitMeshPipeline, &_shadowVoxelMeshPipeline };
+		const char* shadowNames[] = { "shadow", "shadow packed", "shadow split", "shadow voxel" };
+
+		pipelineBuilder._shaderStages.clear();
+		pipelineBuilder._shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, shadowVertexShader));
+		pipelineBuilder._pipelineLayout = _shadowPipelineLayout;
+		pipelineBuilder._colorAttachmentCount = 0;
+		pipelineBuilder._rasterizer.cullMode = VK_CULL_MODE_NONE;
+		pipelineBuilder._rasterizer.depthBiasEnable = VK_TRUE;
+		pipelineBuilder._rasterizer.depthBiasConstantFactor = 1.25f;
+		pipelineBuilder._rasterizer.depthBiasSlopeFactor = 1.75f;
+		// the cascades keep the standard depth range whatever the camera uses
+		pipelineBuilder._depthStencil = vkinit::depth_stencil_create_info(true, true, VK_COMPARE_OP_LESS_OR_EQUAL);
+		// the cascades have no color to shade
+		pipelineBuilder._shadingRate = false;
+		for (int i = 0; i < 4; i++)
+		{
+			pipelineBuilder._vertexInputInfo.pVertexAttributeDescriptions = shadowDescriptions[i].attributes.data();
+			pipelineBuilder._vertexInputInfo.vertexAttributeDescriptionCount = shadowDescriptions[i].attributes.size();
+			pipelineBuilder._vertexInputInfo.pVertexBindingDescriptions = shadowDescriptions[i].bindings.data();
+			pipelineBuilder._vertexInputInfo.vertexBindingDescriptionCount = shadowDescriptions[i].bindings.size();
+
+			queue_pipeline(pipelineBuilder.describe(_shadows.render_pass()), shadowTargets[i], shadowNames[i]);
+		}
+
+		pipelineBuilder._colorAttachmentCount = 1;
+		pipelineBuilder._rasterizer = vkinit::rasterization_state_create_info(VK_POLYGON_MODE_FILL);
+		pipelineBuilder._depthStencil = vkinit::depth_stencil_create_info(true, true, depth_compare_op());
+		pipelineBuilder._pipelineLayout = _meshPipelineLayout;
+		pipelineBuilder._shadingRate = _useShadingRate;
+	}
+
+	// particles: compute passes simulate them into an indirect draw of camera-facing quads, which needs no
+	// vertex input and brings its own draw state, since nothing else draws like it
+	if (_useParticles)
+	{
+		VkShaderModule particleArgsShader = VK_NULL_HANDLE;
+		VkShaderModule particleEmitShader = VK_NULL_HANDLE;
+		VkShaderModule particleSimulateShader = VK_NULL_HANDLE;
+		VkShaderModule particleVertexShader = VK_NULL_HANDLE;
+		VkShaderModule particleFragmentShader = VK_NULL_HANDLE;
+		const bool argsLoaded = load_shader_module("../../shaders/particleArgs.comp.spv", &particleArgsShader);
+		const bool emitLoaded = load_shader_module("../../shaders/particleEmit.comp.spv", &particleEmitShader);
+		const bool simulateLoaded = load_shader_module("../../shaders/particleSimulate.comp.spv", &particleSimulateShader);
+		const bool vertexLoaded = load_shader_module("../../shaders/particle.vert.spv", &particleVertexShader);
+		const bool fragmentLoaded = load_shader_module("../../shaders/particle.frag.spv", &particleFragmentShader);
+		if (!argsLoaded || !emitLoaded || !simulateLoaded || !vertexLoaded || !fragmentLoaded)
+		{
+			LOG_ERROR("Error building particle shaders, particles disabled.");
+			_useParticles = false;
+		}
+		else
+		{
+			LOG_INFO("Particle shaders successfully loaded.");
+
+			_particles.init(_device, _allocator, _descriptorAllocator, _particleCapacity, particleArgsShader, particleEmitShader,
+				particleSimulateShader, _pipelineCache);
+			_mainDeletionQueue.push_function([=]() {
+				_particles.cleanup();
+			});
+
+			// set 0 for the camera, set 1 the particle system's own
+			const ShaderReflection particleReflection = reflect_stages({ particleVertexShader, particleFragmentShader });
+			_particlePipelineLayout = reflect_pipeline_layout(particleReflection, { _globalSetLayout, _particles.set_layout() });
+
+			PipelineBuilder particleBuilder = pipelineBuilder;
+			particleBuilder._shaderStages.clear();
+			particleBuilder._specializations.clear();
+			particleBuilder._shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, particleVertexShader));
+			particleBuilder._shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, particleFragmentShader));
+			particleBuilder._vertexInputInfo = vkinit::vertex_input_state_create_info();
+			particleBuilder._pipelineLayout = _particlePipelineLayout;
+			particleBuilder._rasterizer.cullMode = VK_CULL_MODE_NONE;
+			particleBuilder._depthStencil = vkinit::depth_stencil_create_info(true, false, depth_compare_op());
+			// sparks only add light, so they need no sorting
+			particleBuilder._colorBlendAttachment.blendEnable = VK_TRUE;
+			particleBuilder._colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+			particleBuilder._colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+			particleBuilder._colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+			particleBuilder._colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+			particleBuilder._colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+			particleBuilder._colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+			particleBuilder._dynamicDrawState = false;
+			// sparks are small and bright, and always shade at full rate
+			particleBuilder._shadingRate = false;
+			queue_pipeline(describe_main_pass(particleBuilder), &_particlePipeline, "particles");
+		}
+	}
+
+	// impostors: one instanced quad per far object, cut out of its atlas and lit like the mesh materials;
+	// the instance data is the only vertex input, the corners come from the vertex index
+	if (_useImpostors)
+	{
+		VkShaderModule impostorVertexShader = VK_NULL_HANDLE;
+		VkShaderModule impostorFragmentShader = VK_NULL_HANDLE;
+		const bool vertexLoaded = load_shader_module("../../shaders/impostor.vert.spv", &impostorVertexShader);
+		const bool fragmentLoaded = load_shader_module("../../shaders/impostor.frag.spv", &impostorFragmentShader);
+		if (!vertexLoaded || !fragmentLoaded)
+		{
+			LOG_ERROR("Error building impostor shaders, impostors disabled.");
+			_useImpostors = false;
+		}
+		else
+		{
+			LOG_INFO("Impostor shaders successfully loaded.");
+
+			_impostors.init(_device, _allocator, _descriptorAllocator, _impostorLayers, _frameOverlap);
+			_mainDeletionQueue.push_function([=]() {
+				_impostors.cleanup();
+			});
+
+			// set 0 for the camera, set 1 the atlases
+			const ShaderReflection impostorReflection = reflect_stages({ impostorVertexShader, impostorFragmentShader });
+			_impostorPipelineLayout = reflect_pipeline_layout(impostorReflection, { _globalSetLayout, _impostors.set_layout() });
+
+			PipelineBuilder impostorBuilder = pipelineBuilder;
+			impostorBuilder._shaderStages.clear();
+			impostorBuilder._shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, impostorVertexShader));
+			impostorBuilder._shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, impostorFragmentShader));
+			impostorBuilder._specializations = { ShaderSpecialization().set<uint32_t>(0, _impostors.frames()), meshFragSpecialization };
+			IMPOSTOR_INSTANCE_LAYOUT.apply(impostorBuilder._vertexInputInfo);
+			impostorBuilder._pipelineLayout = _impostorPipelineLayout;
+			// a mirrored transform turns the quad around
+			impostorBuilder._rasterizer.cullMode = VK_CULL_MODE_NONE;
+			impostorBuilder._depthStencil = vkinit::depth_stencil_create_info(true, true, depth_compare_op());
+			impostorBuilder._dynamicDrawState = false;
+			queue_pipeline(describe_main_pass(impostorBuilder), &_impostorPipeline, "impostors");
+		}
+	}
+
+	// terrain: one instanced grid per selected node, its heights fetched from the tile cache; the node is the
+	// only vertex input, the grid point comes from the vertex index
+	if (_useTerrain)
+	{
+		VkShaderModule terrainVertexShader = VK_NULL_HANDLE;
+		VkShaderModule terrainFragmentShader = VK_NULL_HANDLE;
+		const bool vertexLoaded = load_shader_module("../../shaders/terrain.vert.spv", &terrainVertexShader);
+		const bool fragmentLoaded = load_shader_module("../../shaders/terrain.frag.spv", &terrainFragmentShader);
+		if (!vertexLoaded || !fragmentLoaded)
+		{
+			LOG_ERROR("Error building terrain shaders, terrain disabled.");
+			_useTerrain = false;
+		}
+		else if (!_terrain.init(_device, _allocator, _descriptorAllocator, _terrainSettings, _frameOverlap))
+		{
+			LOG_ERROR("Couldn't load the terrain's heightfield, terrain disabled.");
+			_useTerrain = false;
+		}
+		else
+		{
+			LOG_INFO("Terrain shaders successfully loaded.");
+			_mainDeletionQueue.push_function([=]() {
+				_terrain.cleanup();
+			});
+
+			// set 0 for the camera, set 1 the tiles
+			const ShaderReflection terrainReflection = reflect_stages({ terrainVertexShader, terrainFragmentShader });
+			_terrainPipelineLayout = reflect_pipeline_layout(terrainReflection, { _globalSetLayout, _terrain.set_layout() });
+
+			PipelineBuilder terrainBuilder = pipelineBuilder;
+			terrainBuilder._shaderStages.clear();
+			terrainBuilder._shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, terrainVertexShader));
+			terrainBuilder._shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, terrainFragmentShader));
+			terrainBuilder._specializations = { ShaderSpecialization(), meshFragSpecialization };
+			TERRAIN_NODE_LAYOUT.apply(terrainBuilder._vertexInputInfo);
+			terrainBuilder._pipelineLayout = _terrainPipelineLayout;
+			// the grid winds counter-clockwise seen from above, like the meshes' front faces
+			terrainBuilder._depthStencil = vkinit::depth_stencil_create_info(true, true, depth_compare_op());
+			terrainBuilder._dynamicDrawState = false;
+			queue_pipeline(describe_main_pass(terrainBuilder), &_terrainPipeline, "terrain");
+		}
+	}
+
+	// foliage: a compute pass scatters the grass over the terrain's nodes into an indirect draw of the tuft per
+	// level; its vertices and the instances the pass wrote are the vertex input, and both faces are drawn
+	if (_useFoliage && !_useTerrain)
+	{
+		LOG_WARN("Foliage grows on the terrain, foliage disabled without it.");
+		_useFoliage = false;
+	}
+	if (_useFoliage)
+	{
+		VkShaderModule foliageScatterShader = VK_NULL_HANDLE;
+		VkShaderModule foliageVertexShader = VK_NULL_HANDLE;
+		VkShaderModule foliageFragmentShader = VK_NULL_HANDLE;
+		const bool scatterLoaded = load_shader_module("../../shaders/foliage.comp.spv", &foliageScatterShader);
+		const bool vertexLoaded = load_shader_module("../../shaders/foliage.vert.spv", &foliageVertexShader);
+		const bool fragmentLoaded = load_shader_module("../../shaders/foliage.frag.spv", &foliageFragmentShader);
+		if (!scatterLoaded || !vertexLoaded || !fragmentLoaded)
+		{
+			LOG_ERROR("Error building foliage shaders, foliage disabled.");
+			_useFoliage = false;
+		}
+		else if (!_foliage.init(_device, _allocator, _descriptorAllocator, _foliageSettings, _terrain, foliageScatterShader, _pipelineCache, _frameOverlap))
+		{
+			LOG_ERROR("Couldn't load the foliage's density map, foliage disabled.");
+			_useFoliage = false;
+		}
+		else
+		{
+			LOG_INFO("Foliage shaders successfully loaded.");
+			_mainDeletionQueue.push_function([=]() {
+				_foliage.cleanup();
+			});
+
+			// the far tufts as quads of an atlas baked from level 0, like any mesh's
+			if (_useImpostors)
+			{
+				ImpostorAtlas atlas;
+				if (atlas.bake(_foliage.mesh()))
+				{
+					_foliage.set_impostor_layer(_impostors.add(atlas));
+				}
+			}
+
+			// set 0 for the camera alone
+			const ShaderReflection foliageReflection = reflect_stages({ foliageVertexShader, foliageFragmentShader });
+			_foliagePipelineLayout = reflect_pipeline_layout(foliageReflection, { _globalSetLayout });
+
+			static constexpr auto foliageLayout = concat_vertex_layouts(VERTEX_LAYOUT, FOLIAGE_INSTANCE_LAYOUT);
+			PipelineBuilder foliageBuilder = pipelineBuilder;
+			foliageBuilder._shaderStages.clear();
+			foliageBuilder._shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, foliageVertexShader));
+			foliageBuilder._shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, foliageFragmentShader));
+			foliageBuilder._specializations = { ShaderSpecialization(), meshFragSpecialization };
+			foliageLayout.apply(foliageBuilder._vertexInputInfo);
+			foliageBuilder._pipelineLayout = _foliagePipelineLayout;
+			// a blade is a single sheet
+			foliageBuilder._rasterizer.cullMode = VK_CULL_MODE_NONE;
+			foliageBuilder._depthStencil = vkinit::depth_stencil_create_info(true, true, depth_compare_op());
+			foliageBuilder._dynamicDrawState = false;
+			queue_pipeline(describe_main_pass(foliageBuilder), &_foliagePipeline, "foliage");
+		}
+	}
+
+	// transparent objects: depth tested against the opaque scene but never written, and both faces shaded,
+	// so the far side shows through the near one. Sorted, each is premultiplied over what's behind it;
+	// weighted blended, they only add into the accumulation targets, so the order doesn't matter
+	if (_transparentCount > 0)
+	{
+		if (_transparencyMode == TransparencyMode::WeightedBlended && _msaaSamples != VK_SAMPLE_COUNT_1_BIT)
+		{
+			LOG_WARN("Weighted blended transparency needs single-sampled targets, transparent objects are sorted with MSAA.");
+			_transparencyMode = TransparencyMode::Sorted;
+		}
+		const bool weightedBlended = _transparencyMode == TransparencyMode::WeightedBlended;
+
+		VkShaderModule transparentVertexShader = VK_NULL_HANDLE;
+		VkShaderModule transparentFragmentShader = VK_NULL_HANDLE;
+		VkShaderModule fullscreenShader = VK_NULL_HANDLE;
+		VkShaderModule compositeShader = VK_NULL_HANDLE;
+		const bool vertexLoaded = load_shader_module("../../shaders/transparent.vert.spv", &transparentVertexShader);
+		const bool fragmentLoaded = load_shader_module(weightedBlended ? "../../shaders/transparentOit.frag.spv" : "../../shaders/transparent.frag.spv",
+			&transparentFragmentShader);
+		const bool compositeLoaded = !weightedBlended || (load_shader_module("../../shaders/fullscreen.vert.spv", &fullscreenShader)
+			&& load_shader_module("../../shaders/oitComposite.frag.spv", &compositeShader));
+		if (!vertexLoaded || !fragmentLoaded || !compositeLoaded)
+		{
+			LOG_ERROR("Error building transparent shaders, transparent objects disabled.");
+			_transparentCount = 0;
+		}
+		else
+		{
+			LOG_INFO("Transparent shaders successfully loaded.");
+
+			// set 0 for the camera and the lights; the push constants are the object's own
+			const ShaderReflection transparentReflection = reflect_stages({ transparentVertexShader, transparentFragmentShader });
+			if (transparentReflection.pushConstantSize != sizeof(TransparentPushConstants))
+			{
+				LOG_WARN("Transparent shaders push " << transparentReflection.pushConstantSize << " bytes of constants, TransparentPushConstants has "
+					<< sizeof(TransparentPushConstants));
+			}
+			_transparentPipelineLayout = reflect_pipeline_layout(transparentReflection, { _globalSetLayout });
+
+			PipelineBuilder transparentBuilder = pipelineBuilder;
+			transparentBuilder._shaderStages.clear();
+			transparentBuilder._shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, transparentVertexShader));
+			transparentBuilder._shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, transparentFragmentShader));
+			transparentBuilder._specializations = { ShaderSpecialization(), meshFragSpecialization };
+			transparentBuilder._pipelineLayout = _transparentPipelineLayout;
+			transparentBuilder._rasterizer.cullMode = VK_CULL_MODE_NONE;
+			transparentBuilder._depthStencil = vkinit::depth_stencil_create_info(true, false, depth_compare_op());
+			transparentBuilder._colorBlendAttachment.blendEnable = VK_TRUE;
+			transparentBuilder._colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+			transparentBuilder._colorBlendAttachment.dstColorBlendFactor = weightedBlended ? VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+			transparentBuilder._colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+			transparentBuilder._colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+			transparentBuilder._colorBlendAttachment.dstAlphaBlendFactor = weightedBlended ? VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+			transparentBuilder._colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+			transparentBuilder._dynamicDrawState = false;
+			transparentBuilder._shadingRate = false;
+
+			// the accumulation pass is a render pass of its own: both targets, cleared, over the scene's depth
+			const VkFormat oitFormats[] = { OIT_ACCUMULATION_FORMAT, OIT_REVEALAGE_FORMAT };
+			if (weightedBlended && !_useDynamicRendering)
+			{
+				VkAttachmentDescription attachments[3] = {};
+				for (uint32_t i = 0; i < 2; i++)
+				{
+					attachments[i].format = oitFormats[i];
+					attachments[i].samples = VK_SAMPLE_COUNT_1_BIT;
+					attachments[i].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+					attachments[i].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+					attachments[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+					attachments[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+					attachments[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+					attachments[i].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+				}
+				attachments[2].format = _depthFormat;
+				attachments[2].samples = VK_SAMPLE_COUNT_1_BIT;
+				attachments[2].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+				attachments[2].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				attachments[2].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+				attachments[2].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				attachments[2].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+				attachments[2].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+				const VkAttachmentReference colorRefs[2] = { { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL }, { 1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL } };
+				const VkAttachmentReference depthRef = { 2, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+				VkSubpassDescription subpass = {};
+				subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+				subpass.colorAttachmentCount = 2;
+				subpass.pColorAttachments = colorRefs;
+				subpass.pDepthStencilAttachment = &depthRef;
+
+				// only for compatibility, like _renderPass; the frame graph begins its own
+				VkRenderPassCreateInfo renderPassInfo = {};
+				renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+				renderPassInfo.attachmentCount = 3;
+				renderPassInfo.pAttachments = attachments;
+				renderPassInfo.subpassCount = 1;
+				renderPassInfo.pSubpasses = &subpass;
+				VK_CHECK(vkCreateRenderPass(_device, &renderPassInfo, nullptr, &_oitRenderPass));
+				_mainDeletionQueue.push_render_pass(_oitRenderPass);
+			}
+			if (weightedBlended)
+			{
+				transparentBuilder._colorAttachmentCount = 2;
+			}
+			auto describe_transparent = [&]() {
+				if (!weightedBlended)
+				{
+					return describe_main_pass(transparentBuilder);
+				}
+				PipelineDescription description = _useDynamicRendering
+					? transparentBuilder.describe_dynamic(oitFormats, _depthFormat)
+					: transparentBuilder.describe(_oitRenderPass);
+				description.shadingRateAttachment = _useShadingRateImage;
+				return description;
+			};
+
+			// the shader only reads the position, which is the same location in every format but the voxels'
+			const VertexInputDescription transparentDescriptions[] = {
+				transparentReflection.consumed_inputs(VERTEX_LAYOUT.description()),
+				transparentReflection.consumed_inputs(PACKED_VERTEX_LAYOUT.description()),
+				transparentReflection.consumed_inputs(SPLIT_VERTEX_LAYOUT.description()),
+			};
+			const char* transparentNames[] = { "transparent", "transparent packed", "transparent split" };
+			for (uint32_t i = 0; i < 3; i++)
+			{
+				transparentBuilder._vertexInputInfo.pVertexAttributeDescriptions = transparentDescriptions[i].attributes.data();
+				transparentBuilder._vertexInputInfo.vertexAttributeDescriptionCount = transparentDescriptions[i].attributes.size();
+				transparentBuilder._vertexInputInfo.pVertexBindingDescriptions = transparentDescriptions[i].bindings.data();
+				transparentBuilder._vertexInputInfo.vertexBindingDescriptionCount = transparentDescriptions[i].bindings.size();
+				queue_pipeline(describe_transparent(), &_transparentPipelines[i], transparentNames[i]);
+			}
+
+			// the composite: a fullscreen triangle over the scene color, which the average of the accumulated
+			// colors covers as much as they hid it. Depth stays attached, untested, so it runs in a pass
+			// compatible with the main one
+			if (weightedBlended)
+			{
+				const ShaderReflection compositeReflection = reflect_stages({ fullscreenShader, compositeShader });
+				_oitCompositeSetLayout = _layoutCache.set_layout(compositeReflection.set_bindings(0, true));
+				_oitCompositePipelineLayout = reflect_pipeline_layout(compositeReflection, { _oitCompositeSetLayout });
+
+				PipelineBuilder compositeBuilder = transparentBuilder;
+				compositeBuilder._shaderStages.clear();
+				compositeBuilder._specializations.clear();
+				compositeBuilder._shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, fullscreenShader));
+				compositeBuilder._shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, compositeShader));
+				compositeBuilder._vertexInputInfo = vkinit::vertex_input_state_create_info();
+				compositeBuilder._pipelineLayout = _oitCompositePipelineLayout;
+				compositeBuilder._colorAttachmentCount = 1;
+				compositeBuilder._depthStencil = vkinit::depth_stencil_create_info(false, false, VK_COMPARE_OP_ALWAYS);
+				compositeBuilder._colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+				compositeBuilder._colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+				compositeBuilder._colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+				compositeBuilder._colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+				queue_pipeline(describe_main_pass(compositeBuilder), &_oitCompositePipeline, "oit composite");
+			}
+		}
+	}
+
+	// the overdraw view counts every fragment of the opaque meshes: the depth pre-pass's instanced fetch,
+	// loaded whether or not there is a pre-pass, and a fragment shader adding a constant, blended ONE, ONE
+	// into a single-sampled target of its own with nothing tested or written to depth
+	{
+		_overdrawFormat = OverdrawView::count_format(_chosenGPU);
+		_overdrawQuadCounts = OverdrawView::quad_counts(_chosenGPU);
+		VkShaderModule overdrawVertexShader = VK_NULL_HANDLE;
+		VkShaderModule overdrawFragmentShader = VK_NULL_HANDLE;
+		const bool vertexLoaded = load_shader_module("../../shaders/depthPrepassInstanced.vert.spv", &overdrawVertexShader);
+		const bool fragmentLoaded = load_shader_module(_overdrawQuadCounts ? "../../shaders/overdrawQuad.frag.spv" : "../../shaders/overdraw.frag.spv",
+			&overdrawFragmentShader);
+		if (!vertexLoaded || !fragmentLoaded)
+		{
+			LOG_ERROR("Error building overdraw shaders, no overdraw view.");
+		}
+		else
+		{
+			LOG_INFO("Overdraw shaders successfully loaded" << (_overdrawQuadCounts ? ", with quad counts." : "."));
+
+			if (!_useDynamicRendering)
+			{
+				VkAttachmentDescription attachment = {};
+				attachment.format = _overdrawFormat;
+				attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+				attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+				attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+				attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+				attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+				const VkAttachmentReference colorRef = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+				VkSubpassDescription subpass = {};
+				subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+				subpass.colorAttachmentCount = 1;
+				subpass.pColorAttachments = &colorRef;
+
+				// only for compatibility, like _renderPass; the frame graph begins its own
+				VkRenderPassCreateInfo renderPassInfo = {};
+				renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+				renderPassInfo.attachmentCount = 1;
+				renderPassInfo.pAttachments = &attachment;
+				renderPassInfo.subpassCount = 1;
+				renderPassInfo.pSubpasses = &subpass;
+				VK_CHECK(vkCreateRenderPass(_device, &renderPassInfo, nullptr, &_overdrawRenderPass));
+				_mainDeletionQueue.push_render_pass(_overdrawRenderPass);
+			}
+
+			PipelineBuilder overdrawBuilder = pipelineBuilder;
+			overdrawBuilder._shaderStages.clear();
+			overdrawBuilder._specializations.clear();
+			overdrawBuilder._shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, overdrawVertexShader));
+			overdrawBuilder._shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, overdrawFragmentShader));
+			overdrawBuilder._pipelineLayout = _meshPipelineLayout;
+			overdrawBuilder._rasterizer = vkinit::rasterization_state_create_info(VK_POLYGON_MODE_FILL);
+			overdrawBuilder._multisampling = vkinit::multisampling_state_create_info();
+			overdrawBuilder._depthStencil = vkinit::depth_stencil_create_info(false, false, VK_COMPARE_OP_ALWAYS);
+			overdrawBuilder._colorBlendAttachment = vkinit::color_blend_attachment_state();
+			overdrawBuilder._colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT;
+			overdrawBuilder._colorBlendAttachment.blendEnable = VK_TRUE;
+			overdrawBuilder._colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+			overdrawBuilder._colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+			overdrawBuilder._colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+			overdrawBuilder._colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+			overdrawBuilder._colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+			overdrawBuilder._colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+			overdrawBuilder._colorAttachmentCount = 1;
+			overdrawBuilder._dynamicDrawState = false;
+			overdrawBuilder._shadingRate = false;
+
+			const ShaderReflection overdrawReflection = reflect_stages({ overdrawVertexShader });
+			const VertexInputDescription overdrawDescriptions[VERTEX_FORMAT_COUNT] = {
+				overdrawReflection.consumed_inputs(instancedLayout.description()),
+				overdrawReflection.consumed_inputs(packedInstancedLayout.description()),
+				overdrawReflection.consumed_inputs(splitInstancedLayout.description()),
+				overdrawReflection.consumed_inputs(voxelInstancedLayout.description()),
+			};
+			const char* overdrawNames[VERTEX_FORMAT_COUNT] = { "overdraw", "overdraw packed", "overdraw split", "overdraw voxel" };
+			for (uint32_t i = 0; i < VERTEX_FORMAT_COUNT; i++)
+			{
+				overdrawBuilder._vertexInputInfo.pVertexAttributeDescriptions = overdrawDescriptions[i].attributes.data();
+				overdrawBuilder._vertexInputInfo.vertexAttributeDescriptionCount = overdrawDescriptions[i].attributes.size();
+				overdrawBuilder._vertexInputInfo.pVertexBindingDescriptions = overdrawDescriptions[i].bindings.data();
+				overdrawBuilder._vertexInputInfo.vertexBindingDescriptionCount = overdrawDescriptions[i].bindings.size();
+				PipelineDescription description = _useDynamicRendering
+					? overdrawBuilder.describe_dynamic(&_overdrawFormat, VK_FORMAT_UNDEFINED)
+					: overdrawBuilder.describe(_overdrawRenderPass);
+				queue_pipeline(description, &_overdrawPipelines[i], overdrawNames[i]);
+			}
+		}
+	}
+
+	// object picking draws the same way with the depth tested and written, into ObjectPicker's target and a
+	// depth buffer of its own, the scene slot the cull pass stored with each instance going to the fragments
+	{
+		VkShaderModule pickVertexShader = VK_NULL_HANDLE;
+		VkShaderModule pickFragmentShader = VK_NULL_HANDLE;
+		const bool vertexLoaded = load_shader_module("../../shaders/pick.vert.spv", &pickVertexShader);
+		const bool fragmentLoaded = load_shader_module("../../shaders/pick.frag.spv", &pickFragmentShader);
+		if (!vertexLoaded || !fragmentLoaded)
+		{
+			LOG_ERROR("Error building pick shaders, picking ray casts on the CPU.");
+		}
+		else
+		{
+			LOG_INFO("Pick shaders successfully loaded.");
+
+			if (!_useDynamicRendering)
+			{
+				VkAttachmentDescription attachments[2] = {};
+				attachments[0].format = ObjectPicker::ID_FORMAT;
+				attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+				attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+				attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+				attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+				attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+				attachments[1] = attachments[0];
+				attachments[1].format = _depthFormat;
+				attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+				const VkAttachmentReference colorRef = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+				const VkAttachmentReference depthRef = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+				VkSubpassDescription subpass = {};
+				subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+				subpass.colorAttachmentCount = 1;
+				subpass.pColorAttachments = &colorRef;
+				subpass.pDepthStencilAttachment = &depthRef;
+
+				// only for compatibility, like _overdrawRenderPass
+				VkRenderPassCreateInfo renderPassInfo = {};
+				renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+				renderPassInfo.attachmentCount = 2;
+				renderPassInfo.pAttachments = attachments;
+				renderPassInfo.subpassCount = 1;
+				renderPassInfo.pSubpasses = &subpass;
+				VK_CHECK(vkCreateRenderPass(_device, &renderPassInfo, nullptr, &_pickRenderPass));
+				_mainDeletionQueue.push_render_pass(_pickRenderPass);
+			}
+
+			PipelineBuilder pickBuilder = pipelineBuilder;
+			pickBuilder._shaderStages.clear();
+			pickBuilder._specializations.clear();
+			pickBuilder._shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, pickVertexShader));
+			pickBuilder._shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, pickFragmentShader));
+			pickBuilder._pipelineLayout = _meshPipelineLayout;
+			pickBuilder._rasterizer = vkinit::rasterization_state_create_info(VK_POLYGON_MODE_FILL);
+			pickBuilder._multisampling = vkinit::multisampling_state_create_info();
+			pickBuilder._depthStencil = vkinit::depth_stencil_create_info(true, true, depth_compare_op());
+			pickBuilder._colorBlendAttachment = vkinit::color_blend_attachment_state();
+			pickBuilder._colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT;
+			pickBuilder._colorBlendAttachment.blendEnable = VK_FALSE;
+			pickBuilder._colorAttachmentCount = 1;
+			pickBuilder._dynamicDrawState = false;
+			pickBuilder._shadingRate = false;
+
+			static constexpr auto pickLayout = concat_vertex_layouts(instancedLayout, INSTANCE_OBJECT_LAYOUT);
+			static constexpr auto packedPickLayout = concat_vertex_layouts(packedInstancedLayout, INSTANCE_OBJECT_LAYOUT);
+			static constexpr auto splitPickLayout = concat_vertex_layouts(splitInstancedLayout, INSTANCE_OBJECT_LAYOUT);
+			static constexpr auto voxelPickLayout = concat_vertex_layouts(voxelInstancedLayout, INSTANCE_OBJECT_LAYOUT);
+			const ShaderReflection pickReflection = reflect_stages({ pickVertexShader });
+			const VertexInputDescription pickDescriptions[VERTEX_FORMAT_COUNT] = {
+				pickReflection.consumed_inputs(pickLayout.description()),
+				pickReflection.consumed_inputs(packedPickLayout.description()),
+				pickReflection.consumed_inputs(splitPickLayout.description()),
+				pickReflection.consumed_inputs(voxelPickLayout.description()),
+			};
+			const char* pickNames[VERTEX_FORMAT_COUNT] = { "pick", "pick packed", "pick split", "pick voxel" };
+			const VkFormat pickFormat = ObjectPicker::ID_FORMAT;
+			for (uint32_t i = 0; i < VERTEX_FORMAT_COUNT; i++)
+			{
+				pickBuilder._vertexInputInfo.pVertexAttributeDescriptions = pickDescriptions[i].attributes.data();
+				pickBuilder._vertexInputInfo.vertexAttributeDescriptionCount = pickDescriptions[i].attributes.size();
+				pickBuilder._vertexInputInfo.pVertexBindingDescriptions = pickDescriptions[i].bindings.data();
+				pickBuilder._vertexInputInfo.vertexBindingDescriptionCount = pickDescriptions[i].bindings.size();
+				PipelineDescription description = _useDynamicRendering
+					? pickBuilder.describe_dynamic(&pickFormat, _depthFormat)
+					: pickBuilder.describe(_pickRenderPass);
+				queue_pipeline(description, &_pickPipelines[i], pickNames[i]);
+			}
+		}
+	}
+
+#ifdef ENABLE_DEBUG_DRAW
+	// debug lines: a line list straight from the frame's ring, depth tested against the scene but never
+	// written, so they show where they are without hiding each other
+	if (_debugDrawFlags != 0)
+	{
+		VkShaderModule debugLineVertexShader = VK_NULL_HANDLE;
+		VkShaderModule debugLineFragmentShader = VK_NULL_HANDLE;
+		const bool vertexLoaded = load_shader_module("../../shaders/debugLine.vert.spv", &debugLineVertexShader);
+		const bool fragmentLoaded = load_shader_module("../../shaders/debugLine.frag.spv", &debugLineFragmentShader);
+		if (!vertexLoaded || !fragmentLoaded)
+		{
+			LOG_ERROR("Error building debug line shaders, debug drawing disabled.");
+			_debugDrawFlags = 0;
+		}
+		else
+		{
+			LOG_INFO("Debug line shaders successfully loaded.");
+
+			const ShaderReflection debugLineReflection = reflect_stages({ debugLineVertexShader, debugLineFragmentShader });
+			_debugLinePipelineLayout = reflect_pipeline_layout(debugLineReflection, { _globalSetLayout });
+
+			PipelineBuilder debugLineBuilder = pipelineBuilder;
+			debugLineBuilder._shaderStages.clear();
+			debugLineBuilder._specializations.clear();
+			debugLineBuilder._shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, debugLineVertexShader));
+			debugLineBuilder._shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, debugLineFragmentShader));
+			debugLineBuilder._inputAssembly = vkinit::input_assembly_create_info(VK_PRIMITIVE_TOPOLOGY_LINE_LIST);
+			debugLineBuilder._vertexInputInfo = vkinit::vertex_input_state_create_info();
+			DEBUG_VERTEX_LAYOUT.apply(debugLineBuilder._vertexInputInfo);
+			debugLineBuilder._pipelineLayout = _debugLinePipelineLayout;
+			debugLineBuilder._rasterizer.cullMode = VK_CULL_MODE_NONE;
+			debugLineBuilder._depthStencil = vkinit::depth_stencil_create_info(true, false, depth_compare_op());
+			debugLineBuilder._dynamicDrawState = false;
+			debugLineBuilder._shadingRate = false;
+			queue_pipeline(describe_main_pass(debugLineBuilder), &_debugLinePipeline, "debug lines");
+		}
+	}
+#endif
+
+	// what the text and HUD pipelines are built against without dynamic rendering: the swapchain image, loaded
+	if (!_useDynamicRendering && (_textFlags != 0 || _hud.ready()))
+	{
+		VkAttachmentDescription attachment = {};
+		attachment.format = _swapchainImageFormat;
+		attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		const VkAttachmentReference colorRef = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colorRef;
+
+		// only for compatibility, like _overdrawRenderPass
+		VkRenderPassCreateInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = 1;
+		renderPassInfo.pAttachments = &attachment;
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+		VK_CHECK(vkCreateRenderPass(_device, &renderPassInfo, nullptr, &_overlayRenderPass));
+		_mainDeletionQueue.push_render_pass(_overlayRenderPass);
+	}
+
+	// text: one instanced quad per glyph out of the font's distance atlas, alpha blended over the swapchain
+	// image with nothing tested; the instances are the only vertex input, the corners come from the vertex index
+	if (_textFlags != 0)
+	{
+		SdfFont font;
+		const std::string fontCache = _textFont.empty() ? std::string("../../assets/") + BUILTIN_FONT_CACHE : _textFont + SDF_FONT_EXTENSION;
+		VkShaderModule textVertexShader = VK_NULL_HANDLE;
+		VkShaderModule textFragmentShader = VK_NULL_HANDLE;
+		const bool vertexLoaded = load_shader_module("../../shaders/text.vert.spv", &textVertexShader);
+		const bool fragmentLoaded = load_shader_module("../../shaders/text.frag.spv", &textFragmentShader);
+		if (!vertexLoaded || !fragmentLoaded)
+		{
+			LOG_ERROR("Error building text shaders, no text.");
+			_textFlags = 0;
+		}
+		else if (!load_sdf_font(font, _textFont.empty() ? nullptr : _textFont.c_str(), fontCache.c_str(), {},
+			_assetArchive.is_open() ? &_assetArchive : nullptr))
+		{
+			_textFlags = 0;
+		}
+		else
+		{
+			LOG_INFO("Text shaders successfully loaded.");
+
+			_text.init(_device, _allocator, _descriptorAllocator, font);
+			_mainDeletionQueue.push_function([=]() {
+				_text.cleanup();
+			});
+
+			// set 0 for the atlas, the projection and window size pushed
+			const ShaderReflection textReflection = reflect_stages({ textVertexShader, textFragmentShader });
+			_textPipelineLayout = reflect_pipeline_layout(textReflection, { _text.set_layout() });
+
+			PipelineBuilder textBuilder = pipelineBuilder;
+			textBuilder._shaderStages.clear();
+			textBuilder._specializations.clear();
+			textBuilder._shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, textVertexShader));
+			textBuilder._shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, textFragmentShader));
+			textBuilder._inputAssembly = vkinit::input_assembly_create_info(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+			textBuilder._vertexInputInfo = vkinit::vertex_input_state_create_info();
+			GLYPH_INSTANCE_LAYOUT.apply(textBuilder._vertexInputInfo);
+			textBuilder._pipelineLayout = _textPipelineLayout;
+			textBuilder._rasterizer = vkinit::rasterization_state_create_info(VK_POLYGON_MODE_FILL);
+			textBuilder._rasterizer.cullMode = VK_CULL_MODE_NONE;
+			textBuilder._multisampling = vkinit::multisampling_state_create_info();
+			textBuilder._depthStencil = vkinit::depth_stencil_create_info(false, false, VK_COMPARE_OP_ALWAYS);
+			textBuilder._colorBlendAttachment = vkinit::color_blend_attachment_state();
+			textBuilder._colorBlendAttachment.blendEnable = VK_TRUE;
+			textBuilder._colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+			textBuilder._colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+			textBuilder._colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+			textBuilder._colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+			textBuilder._colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+			textBuilder._colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+			textBuilder._colorAttachmentCount = 1;
+			textBuilder._dynamicDrawState = false;
+			textBuilder._shadingRate = false;
+			PipelineDescription description = _useDynamicRendering
+				? textBuilder.describe_dynamic(&_swapchainImageFormat, VK_FORMAT_UNDEFINED)
+				: textBuilder.describe(_overlayRenderPass);
+			queue_pipeline(description, &_textPipeline, "text");
+		}
+	}
+
+	// the HUD: imgui's triangles as it writes them, alpha blended over the swapchain image after the text, the
+	// scissor set per imgui command
+	if (_hud.ready())
+	{
+		VkShaderModule hudVertexShader = VK_NULL_HANDLE;
+		VkShaderModule hudFragmentShader = VK_NULL_HANDLE;
+		const bool vertexLoaded = load_shader_module("../../shaders/hud.vert.spv", &hudVertexShader);
+		const bool fragmentLoaded = load_shader_module("../../shaders/hud.frag.spv", &hudFragmentShader);
+		if (!vertexLoaded || !fragmentLoaded)
+		{
+			LOG_ERROR("Error building HUD shaders, no HUD.");
+		}
+		else
+		{
+			LOG_INFO("HUD shaders successfully loaded.");
+
+			// set 0 for the font atlas, the pixels to clip space pushed
+			const ShaderReflection hudReflection = reflect_stages({ hudVertexShader, hudFragmentShader });
+			_hudPipelineLayout = reflect_pipeline_layout(hudReflection, { _hud.set_layout() });
+
+			PipelineBuilder hudBuilder = pipelineBuilder;
+			hudBuilder._shaderStages.clear();
+			hudBuilder._specializations.clear();
+			hudBuilder._shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, hudVertexShader));
+			hudBuilder._shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, hudFragmentShader));
+			hudBuilder._inputAssembly = vkinit::input_assembly_create_info(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+			hudBuilder._vertexInputInfo = vkinit::vertex_input_state_create_info();
+			HUD_VERTEX_LAYOUT.apply(hudBuilder._vertexInputInfo);
+			hudBuilder._pipelineLayout = _hudPipelineLayout;
+			hudBuilder._rasterizer = vkinit::rasterization_state_create_info(VK_POLYGON_MODE_FILL);
+			hudBuilder._rasterizer.cullMode = VK_CULL_MODE_NONE;
+			hudBuilder._multisampling = vkinit::multisampling_state_create_info();
+			hudBuilder._depthStencil = vkinit::depth_stencil_create_info(false, false, VK_COMPARE_OP_ALWAYS);
+			hudBuilder._colorBlendAttachment = vkinit::color_blend_attachment_state();
+			hudBuilder._colorBlendAttachment.blendEnable = VK_TRUE;
+			hudBuilder._colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+			hudBuilder._colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+			hudBuilder._colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+			hudBuilder._colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+			hudBuilder._colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+			hudBuilder._colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+			hudBuilder._colorAttachmentCount = 1;
+			hudBuilder._dynamicDrawState = false;
+			hudBuilder._shadingRate = false;
+			PipelineDescription description = _useDynamicRendering
+				? hudBuilder.describe_dynamic(&_swapchainImageFormat, VK_FORMAT_UNDEFINED)
+				: hudBuilder.describe(_overlayRenderPass);
+			queue_pipeline(description, &_hudPipeline, "hud");
+		}
+	}
+
+	// occlusion query boxes: the corners come from the vertex index and a push constant, and only the depth
+	// test matters, so there is no fragment stage. Both faces are drawn, and the query counts either
+	if (_occlusionPredicates.ready())
+	{
+		VkShaderModule occlusionBoxShader = VK_NULL_HANDLE;
+		if (!load_shader_module("../../shaders/occlusionBox.vert.spv", &occlusionBoxShader))
+		{
+			LOG_ERROR("Error building the occlusion box shader, draws won't be predicated.");
+			_occlusionPredicates.cleanup();
+		}
+		else
+		{
+			const ShaderReflection occlusionBoxReflection = reflect_stages({ occlusionBoxShader });
+			_occlusionBoxPipelineLayout = reflect_pipeline_layout(occlusionBoxReflection, { _globalSetLayout });
+
+			PipelineBuilder occlusionBoxBuilder = pipelineBuilder;
+			occlusionBoxBuilder._shaderStages.clear();
+			occlusionBoxBuilder._specializations.clear();
+			occlusionBoxBuilder._shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, occlusionBoxShader));
+			occlusionBoxBuilder._inputAssembly = vkinit::input_assembly_create_info(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+			occlusionBoxBuilder._vertexInputInfo = vkinit::vertex_input_state_create_info();
+			occlusionBoxBuilder._pipelineLayout = _occlusionBoxPipelineLayout;
+			occlusionBoxBuilder._rasterizer.cullMode = VK_CULL_MODE_NONE;
+			occlusionBoxBuilder._colorBlendAttachment.colorWriteMask = 0;
+			occlusionBoxBuilder._depthStencil = vkinit::depth_stencil_create_info(true, false, depth_compare_op());
+			occlusionBoxBuilder._dynamicDrawState = false;
+			occlusionBoxBuilder._shadingRate = false;
+			queue_pipeline(describe_main_pass(occlusionBoxBuilder), &_occlusionBoxPipeline, "occlusion boxes");
+		}
+	}
+
+	// meshlet pipeline: task and mesh shaders replace the vertex stage and fetch from the pool themselves,
+	// so the vertex input and input assembly state are ignored; the bindless fragment shader is shared
+	VkShaderModule meshletTaskShader = VK_NULL_HANDLE;
+	VkShaderModule meshletMeshShader = VK_NULL_HANDLE;
+#ifdef VK_EXT_mesh_shader
+	if (_meshShadingSupported)
+	{
+		const bool taskLoaded = load_shader_module("../../shaders/meshlet.task.spv", &meshletTaskShader);
+		const bool meshLoaded = load_shader_module("../../shaders/meshlet.mesh.spv", &meshletMeshShader);
+		if (!taskLoaded || !meshLoaded)
+		{
+			LOG_ERROR("Error building meshlet task/mesh shaders, meshlets draw through the vertex pipeline.");
+			_meshShadingSupported = false;
+		}
+		else
+		{
+			LOG_INFO("Meshlet task and mesh shaders successfully loaded.");
+
+			// sets 0 and 1 are the mesh pipelines' own, set 2 the meshlet data: the pool's buffers, as
+			// the task and mesh shaders declare them
+			const ShaderReflection meshletReflection = reflect_stages({ meshletTaskShader, meshletMeshShader, meshFragShader });
+			if (meshletReflection.pushConstantSize != sizeof(MeshletPushConstants))
+			{
+				LOG_WARN("Meshlet shaders push " << meshletReflection.pushConstantSize << " bytes of constants, MeshletPushConstants has " << sizeof(MeshletPushConstants));
+			}
+			_meshletSetLayout = _layoutCache.set_layout(meshletReflection.set_bindings(2, true));
+			_meshletPipelineLayout = reflect_pipeline_layout(meshletReflection, { _globalSetLayout, _bindlessSetLayout, _meshletSetLayout });
+
+			pipelineBuilder._shaderStages.clear();
+			pipelineBuilder._shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_TASK_BIT_EXT, meshletTaskShader));
+			pipelineBuilder._shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_MESH_BIT_EXT, meshletMeshShader));
+			pipelineBuilder._shaderStages.push_back(vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, meshFragShader));
+			pipelineBuilder._specializations = { ShaderSpecialization(), ShaderSpecialization(), meshFragSpecialization };
+			pipelineBuilder._vertexInputInfo = vkinit::vertex_input_state_create_info();
+			pipelineBuilder._pipelineLayout = _meshletPipelineLayout;
+
+			queue_pipeline(describe_main_pass(pipelineBuilder), &_meshletPipeline, "meshlets");
+		}
+	}
+#endif
+}
+
+void VulkanEngine::finish_pipelines()
+{
+	CPU_PROFILE_SCOPE("finish_pipelines");
+	// join every compile before the first frame, but for the specialized ones still compiling: their generic
+	// build draws until swap_specialized_pipelines() has them. A fallback standing in for two pipelines
+	// couldn't be told apart when swapping, so the second one is waited for
+	for (size_t i = 0; i < _pendingPipelines.size(); i++)
+	{
+		VkPipeline& target = *_pendingPipelineTargets[i];
+		const std::shared_future<VkPipeline>& fallback = _pendingPipelineFallbacks[i];
+		const bool compiling = fallback.valid()
+			&& _pendingPipelines[i].wait_for(std::chrono::seconds(0)) != std::future_status::ready
+			&& fallback.get() != VK_NULL_HANDLE;
+		const bool shared = compiling && std::any_of(_specializingPipelines.begin(), _specializingPipelines.end(),
+			[&](const SpecializingPipeline& pending) { return pending.fallback == fallback.get(); });
+		if (compiling && !shared)
+		{
+			target = fallback.get();
+			_specializingPipelines.push_back({ _pendingPipelines[i], target });
+		}
+		else
+		{
+			target = _pendingPipelines[i].get();
+		}
+		// binds of the fallback count for the specialized pipeline, which replace_pipeline moves the entry to
+		_pipelineManifest.track(target, _pendingPipelineHashes[i]);
+	}
+	_pendingPipelines.clear();
+	_pendingPipelineTargets.clear();
+	_pendingPipelineHashes.clear();
+	_pendingPipelineFallbacks.clear();
+	if (!_specializingPipelines.empty())
+	{
+		LOG_INFO(_specializingPipelines.size() << " specialized pipelines are still compiling, their generic builds draw until they're done.");
+	}
+	// pipelines shared by several slots end up with the last slot's name
+	for (size_t i = 0; i < _pipelineSlots.size(); i++)
+	{
+		_debugUtils.name(VK_OBJECT_TYPE_PIPELINE, *_pipelineSlots[i], _pipelineSlotNames[i]);
+	}
+
+	// modules and pipelines stay with the registry, which frees them at shutdown
+	{
+		logging::Line line(logging::Level::Info);
+		line.stream() << "Pipelines: " << _pipelineRegistry.pipeline_requests() << " requested, " << _pipelineRegistry.pipeline_count() << " unique";
+		if (_usePipelineLibraries)
+		{
+			line.stream() << ", linked from " << _pipelineRegistry.library_count() << " libraries";
+		}
+		line.stream() << "; shader modules: " << _pipelineRegistry.module_requests() << " loaded, " << _pipelineRegistry.module_count() << " unique.";
+	}
+	if (_captureShaderStatistics)
+	{
+		_shaderStatistics.init(_device, _vkGetPipelineExecutableProperties, _vkGetPipelineExecutableStatistics);
+		for (size_t i = 0; i < _pipelineSlots.size(); i++)
+		{
+			_shaderStatistics.capture(*_pipelineSlots[i], _pipelineSlotNames[i]);
+		}
+		_shaderStatistics.log();
+	}
+
+	// a failed compile leaves the vertex pipeline drawing every mesh
+	_meshShadingSupported = _meshShadingSupported && _meshletPipeline != VK_NULL_HANDLE;
+
+	// the mesh shading model for every vertex format; the scene's materials are all made from it
+	MaterialTemplate& meshTemplate = _materialTemplates["mesh"];
+	meshTemplate.pipelineLayout = _meshPipelineLayout;
+	const uint32_t full = static_cast<uint32_t>(VertexFormat::Full);
+	meshTemplate.pipeline[full] = _meshPipeline;
+	meshTemplate.instancedPipeline[full] = _instancedMeshPipeline;
+	meshTemplate.depthPipeline[full] = _depthMeshPipeline;
+	meshTemplate.depthInstancedPipeline[full] = _depthInstancedMeshPipeline;
+	const uint32_t packed = static_cast<uint32_t>(VertexFormat::Packed);
+	meshTemplate.pipeline[packed] = _packedMeshPipeline;
+	meshTemplate.instancedPipeline[packed] = _packedInstancedMeshPipeline;
+	meshTemplate.depthPipeline[packed] = _depthPackedMeshPipeline;
+	meshTemplate.depthInstancedPipeline[packed] = _depthPackedInstancedMeshPipeline;
+	const uint32_t split = static_cast<uint32_t>(VertexFormat::Split);
+	meshTemplate.pipeline[split] = _splitMeshPipeline;
+	meshTemplate.instancedPipeline[split] = _splitInstancedMeshPipeline;
+	meshTemplate.depthPipeline[split] = _depthSplitMeshPipeline;
+	meshTemplate.depthInstancedPipeline[split] = _depthSplitInstancedMeshPipeline;
+	const uint32_t voxel = static_cast<uint32_t>(VertexFormat::Voxel);
+	meshTemplate.pipeline[voxel] = _voxelMeshPipeline;
+	meshTemplate.instancedPipeline[voxel] = _voxelInstancedMeshPipeline;
+	meshTemplate.depthPipeline[voxel] = _depthVoxelMeshPipeline;
+	meshTemplate.depthInstancedPipeline[voxel] = _depthVoxelInstancedMeshPipeline;
+	// one pipeline for every format but the voxels' then, so draws sorted by material no longer switch
+	// pipelines with it
+	if (_useVertexPulling)
+	{
+		for (uint32_t format : { full, packed, split })
+		{
+			meshTemplate.pipeline[format] = _pulledMeshPipeline;
+			meshTemplate.instancedPipeline[format] = _pulledInstancedMeshPipeline;
+		}
+	}
+
+	create_material("defaultmesh", "mesh");
+	// the floor's two looks, switched with SPACE; they differ only in their parameters
+	create_material("floor", "mesh");
+	create_material("floor_alt", "mesh", glm::vec4(1.f, 0.6f, 0.3f, 1.f));
+	// flat and smoothly lit over much of the screen, so half rate loses nothing anyone would see
+	for (const char* name : { "floor", "floor_alt" })
+	{
+		for (Material* variant : get_material(name)->variants)
+		{
+			variant->lowDetail = true;
+		}
+	}
+}
+
+void VulkanEngine::init_meshlets()
+{
+	CPU_PROFILE_SCOPE("init_meshlets");
+	if (!_meshShadingSupported)
+	{
+		return;
+	}
+
+	_meshletPool.init(_allocator, MESHLET_POOL_MESHLETS, MESHLET_POOL_DATA);
+	_mainDeletionQueue.push_function([=]() {
+		_meshletPool.cleanup();
+	});
+
+	// every buffer behind the set lives as long as the engine, so one set written once serves every frame
+	_descriptorAllocator.allocate(&_meshletDescriptor, _meshletSetLayout);
+
+	VkDescriptorBufferInfo bufferInfos[] = {
+		{ _meshletPool.meshlet_buffer()._buffer, 0, VK_WHOLE_SIZE },
+		{ _meshletPool.data_buffer()._buffer, 0, VK_WHOLE_SIZE },
+		{ _meshPool.vertex_buffer(static_cast<uint32_t>(VertexFormat::Full))._buffer, 0, VK_WHOLE_SIZE },
+		{ _meshPool.vertex_buffer(static_cast<uint32_t>(VertexFormat::Packed))._buffer, 0, VK_WHOLE_SIZE },
+		{ _meshPool.vertex_buffer(static_cast<uint32_t>(VertexFormat::Split), 0)._buffer, 0, VK_WHOLE_SIZE },
+		{ _meshPool.vertex_buffer(static_cast<uint32_t>(VertexFormat::Split), 1)._buffer, 0, VK_WHOLE_SIZE },
+	};
+	VkWriteDescriptorSet writes[6];
+	for (uint32_t i = 0; i < 6; i++)
+	{
+		writes[i] = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _meshletDescriptor, &bufferInfos[i], i);
+	}
+	vkUpdateDescriptorSets(_device, 6, writes, 0, nullptr);
+}
+
+void VulkanEngine::init_vertex_pulling()
+{
+	if (!_useVertexPulling)
+	{
+		return;
+	}
+
+	// the bindings of vertexPull.glsl, in VertexFormat order
+	_descriptorAllocator.allocate(&_vertexPullDescriptor, _vertexPullSetLayout);
+	VkDescriptorBufferInfo bufferInfos[] = {
+		{ _meshPool.vertex_buffer(static_cast<uint32_t>(VertexFormat::Full))._buffer, 0, VK_WHOLE_SIZE },
+		{ _meshPool.vertex_buffer(static_cast<uint32_t>(VertexFormat::Packed))._buffer, 0, VK_WHOLE_SIZE },
+		{ _meshPool.vertex_buffer(static_cast<uint32_t>(VertexFormat::Split), 0)._buffer, 0, VK_WHOLE_SIZE },
+		{ _meshPool.vertex_buffer(static_cast<uint32_t>(VertexFormat::Split), 1)._buffer, 0, VK_WHOLE_SIZE },
+	};
+	VkWriteDescriptorSet writes[4];
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		writes[i] = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _vertexPullDescriptor, &bufferInfos[i], i);
+	}
+	vkUpdateDescriptorSets(_device, 4, writes, 0, nullptr);
+}
+
+void VulkanEngine::init_cull_pipelines()
+{
+	CPU_PROFILE_SCOPE("init_cull_pipelines");
+	VkShaderModule cullShader;
+	if (!load_shader_module("../../shaders/cull.comp.spv", &cullShader))
+	{
+		LOG_ERROR("Error building cull compute shader.");
+	}
+	else
+	{
+		LOG_INFO("Cull compute shader successfully loaded.");
+	}
+
+	VkShaderModule compactShader;
+	if (!load_shader_module("../../shaders/compact.comp.spv", &compactShader))
+	{
+		LOG_ERROR("Error building compact compute shader.");
+	}
+	else
+	{
+		LOG_INFO("Compact compute shader successfully loaded.");
+	}
+
+	// both compute passes see the same set, the union of what the two shaders declare: object slots, draws,
+	// instances, compacted draws, draw counts, camera, depth pyramid, visibility, the GPU scene, the extra
+	// views and the instances' scene slots, in binding order
+	const ShaderReflection cullReflection = reflect_stages({ cullShader, compactShader });
+	if (cullReflection.pushConstantSize != sizeof(CullPushConstants))
+	{
+		LOG_WARN("Cull shaders push " << cullReflection.pushConstantSize << " bytes of constants, CullPushConstants has " << sizeof(CullPushConstants));
+	}
+	_cullSetLayout = _layoutCache.set_layout(cullReflection.set_bindings(0, true));
+
+	// nothing is known to be visible before the first frame, so it draws everything in the second phase
+	_visibilityBuffer = create_buffer(MAX_INSTANCES * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, false, "visibility");
+	_mainDeletionQueue.push_buffer(_visibilityBuffer);
+	immediate_submit([=](VkCommandBuffer cmd) {
+		vkCmdFillBuffer(cmd, _visibilityBuffer._buffer, 0, VK_WHOLE_SIZE, 0);
+	});
+
+	// one set per frame slot, pointing at that slot's buffers
+	for (uint32_t i = 0; i < _frameOverlap; i++)
+	{
+		_descriptorAllocator.allocate(&_frames[i]._cullDescriptor, _cullSetLayout);
+
+		VkDescriptorBufferInfo bufferInfos[] = {
+			{ _frames[i]._objectBuffer._buffer, 0, VK_WHOLE_SIZE },
+			{ _frames[i]._indirectBuffer._buffer, 0, VK_WHOLE_SIZE },
+			{ _frames[i]._instanceBuffer._buffer, 0, VK_WHOLE_SIZE },
+			{ _frames[i]._compactIndirectBuffer._buffer, 0, VK_WHOLE_SIZE },
+			{ _frames[i]._drawCountBuffer._buffer, 0, VK_WHOLE_SIZE },
+		};
+		VkDescriptorBufferInfo cameraInfo = { _frameGpuData.buffer(), 0, sizeof(GPUCameraData) };
+		VkDescriptorBufferInfo visibilityInfo = { _visibilityBuffer._buffer, 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo sceneInfo = { _gpuScene.buffer(), 0, VK_WHOLE_SIZE };
+		VkDescriptorBufferInfo viewsInfo = { _frameGpuData.buffer(), 0, sizeof(GpuCullViews) };
+		VkDescriptorBufferInfo instanceObjectInfo = { _frames[i]._instanceObjectBuffer._buffer, 0, VK_WHOLE_SIZE };
+
+		// the depth pyramid goes in with write_cull_pyramid_descriptors
+		VkWriteDescriptorSet writes[10];
+		for (uint32_t binding = 0; binding < 5; binding++)
+		{
+			writes[binding] = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _frames[i]._cullDescriptor, &bufferInfos[binding], binding);
+		}
+		writes[5] = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, _frames[i]._cullDescriptor, &cameraInfo, 5);
+		writes[6] = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _frames[i]._cullDescriptor, &visibilityInfo, 7);
+		writes[7] = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _frames[i]._cullDescriptor, &sceneInfo, 8);
+		writes[8] = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, _frames[i]._cullDescriptor, &viewsInfo, 9);
+		writes[9] = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _frames[i]._cullDescriptor, &instanceObjectInfo, 10);
+		vkUpdateDescriptorSets(_device, 10, writes, 0, nullptr);
+	}
+
+	_cullPipelineLayout = reflect_pipeline_layout(cullReflection, { _cullSetLayout });
+
+	VkComputePipelineCreateInfo pipelineInfos[2] = {};
+	for (int i = 0; i < 2; i++)
+	{
+		pipelineInfos[i].sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfos[i].pNext = nullptr;
+		pipelineInfos[i].layout = _cullPipelineLayout;
+	}
+	pipelineInfos[0].stage = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, cullShader);
+	pipelineInfos[1].stage = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, compactShader);
+
+	VkPipeline pipelines[2];
+	VK_CHECK(vkCreateComputePipelines(_device, _pipelineCache, 2, pipelineInfos, nullptr, pipelines));
+	_cullPipeline = pipelines[0];
+	_compactPipeline = pipelines[1];
+	_debugUtils.name(VK_OBJECT_TYPE_PIPELINE, _cullPipeline, "cull");
+	_debugUtils.name(VK_OBJECT_TYPE_PIPELINE, _compactPipeline, "compact");
+
+	_mainDeletionQueue.push_pipeline(_cullPipeline);
+	_mainDeletionQueue.push_pipeline(_compactPipeline);
+	// the layouts belong to _layoutCache, the sets go with the descriptor allocator's pools
+
+	// without the reduction shader the cull pass never gets a second phase
+	VkShaderModule reduceShader = VK_NULL_HANDLE;
+	if (!load_shader_module("../../shaders/depthReduce.comp.spv", &reduceShader))
+	{
+		LOG_ERROR("Error building depth reduce compute shader.");
+		reduceShader = VK_NULL_HANDLE;
+		_occlusionCullingSupported = false;
+	}
+	else
+	{
+		LOG_INFO("Depth reduce compute shader successfully loaded.");
+	}
+
+	// the pyramid exists even without occlusion culling, so the cull sets always point at a valid image
+	_depthPyramid.init(_device, _allocator, _descriptorAllocator, _layoutCache, reduceShader, _pipelineCache, _camera.reverse_z());
+	_depthPyramid.resize(_windowExtent, _occlusionCullingSupported ? _depthImageView : VK_NULL_HANDLE);
+	write_cull_pyramid_descriptors();
+	_mainDeletionQueue.push_function([=]() {
+		_depthPyramid.cleanup();
+	});
+	LOG_INFO("Occlusion culling " << (_occlusionCullingSupported ? "through a depth pyramid" : "unavailable"));
+}
+
+void VulkanEngine::init_unpack_pipeline()
+{
+	CPU_PROFILE_SCOPE("init_unpack_pipeline");
+	VkShaderModule unpackShader = VK_NULL_HANDLE;
+	if (!load_shader_module("../../shaders/blockUnpack.comp.spv", &unpackShader))
+	{
+		LOG_ERROR("Error building block unpack compute shader.");
+		unpackShader = VK_NULL_HANDLE;
+	}
+	else
+	{
+		LOG_INFO("Block unpack compute shader successfully loaded.");
+	}
+
+	// without the shader, streamed meshes are loaded with their indices decoded
+	_blockUnpacker.init(_device, _descriptorAllocator, unpackShader, _pipelineCache);
+	_mainDeletionQueue.push_function([=]() {
+		// uploads that never got published still hold their packed buffers
+		for (StreamingUpload& upload : _streamingUploads)
+		{
+			if (upload.packedIndices._buffer != VK_NULL_HANDLE)
+			{
+				vmaDestroyBuffer(_allocator, upload.packedIndices._buffer, upload.packedIndices._allocation);
+			}
+		}
+		_blockUnpacker.cleanup();
+	});
+	LOG_INFO("Streamed index buffers " << (gpu_index_unpack() ? "expanded on the GPU" : "decoded by the loader"));
+}
+
+void VulkanEngine::init_lights()
+{
+	CPU_PROFILE_SCOPE("init_lights");
+	VkShaderModule clusterShader = VK_NULL_HANDLE;
+	if (_useClusteredLights)
+	{
+		if (!load_shader_module("../../shaders/lightCluster.comp.spv", &clusterShader))
+		{
+			LOG_ERROR("Error building light cluster compute shader, point lights disabled.");
+			clusterShader = VK_NULL_HANDLE;
+		}
+		else
+		{
+			LOG_INFO("Light cluster compute shader successfully loaded.");
+		}
+	}
+
+	// the lit pipelines are already compiling; without the pass their clusters stay empty
+	_clusteredLights.init(_device, _allocator, _descriptorAllocator, clusterShader, _pipelineCache, _frameOverlap, _useResizableBar);
+	_clusteredLights.write_descriptors(_globalDescriptor, 2);
+	_mainDeletionQueue.push_function([=]() {
+		_clusteredLights.cleanup();
+	});
+
+	_lights.resize(_useClusteredLights ? std::min(_lightCount, ClusteredLights::MAX_LIGHTS) : 0);
+	animate_lights(0.0);
+}
+
+void VulkanEngine::init_post_process()
+{
+	CPU_PROFILE_SCOPE("init_post_process");
+	if (!_usePostProcess)
+	{
+		return;
+	}
+
+	PostProcessShaders shaders;
+	const bool downsampleLoaded = load_shader_module("../../shaders/postDownsample.comp.spv", &shaders.downsample);
+	const bool blurLoaded = load_shader_module(half_precision_variant("../../shaders/postBlur.comp.spv").c_str(), &shaders.blur);
+	const bool compositeLoaded = load_shader_module(half_precision_variant("../../shaders/postComposite.comp.spv").c_str(), &shaders.composite);
+	const bool fxaaLoaded = load_shader_module("../../shaders/postFxaa.comp.spv", &shaders.fxaa);
+	if (!compositeLoaded)
+	{
+		LOG_ERROR("Error building post composite compute shader, the HDR target is copied to the swapchain as it is.");
+		shaders.composite = VK_NULL_HANDLE;
+	}
+	else
+	{
+		LOG_INFO("Post-processing compute shaders successfully loaded.");
+	}
+	if (!downsampleLoaded || !blurLoaded)
+	{
+		shaders.downsample = VK_NULL_HANDLE;
+		shaders.blur = VK_NULL_HANDLE;
+	}
+	if (!fxaaLoaded)
+	{
+		shaders.fxaa = VK_NULL_HANDLE;
+	}
+
+	_postProcess.init(_device, _layoutCache, _descriptorSetCache, shaders, _postSettings, _pipelineCache);
+	_mainDeletionQueue.push_function([=]() {
+		_postProcess.cleanup();
+	});
+	const PostProcessSettings& settings = _postProcess.settings();
+	LOG_INFO("Post-processing: bloom " << (settings.bloom ? "on" : "off") << ", tonemapping " << (settings.tonemap ? "on" : "off")
+		<< ", FXAA " << (settings.fxaa ? "on" : "off"));
+}
+
+void VulkanEngine::init_shading_rate()
+{
+	CPU_PROFILE_SCOPE("init_shading_rate");
+	if (!_useShadingRateImage)
+	{
+		return;
+	}
+
+	// the pipelines are built for the attachment whether or not it can be made; only frames that bind it use it
+	VkShaderModule rateShader = VK_NULL_HANDLE;
+	if (!load_shader_module("../../shaders/shadingRate.comp.spv", &rateShader))
+	{
+		LOG_ERROR("Error building shading rate compute shader, rates are only set per material.");
+		rateShader = VK_NULL_HANDLE;
+	}
+	else
+	{
+		LOG_INFO("Shading rate compute shader successfully loaded.");
+	}
+
+	_shadingRateImage.init(_device, _allocator, _descriptorAllocator, _layoutCache, rateShader, _pipelineCache, _shadingRateTexelSize, _frameOverlap);
+	_mainDeletionQueue.push_function([=]() {
+		_shadingRateImage.cleanup();
+	});
+	// full rate everywhere until the first frame has written its rates
+	_shadingRateImage.resize(_windowExtent);
+	_debugUtils.name(VK_OBJECT_TYPE_IMAGE, _shadingRateImage.image(), "shading rate");
+	immediate_submit([=](VkCommandBuffer cmd) {
+		_shadingRateImage.clear(cmd);
+	});
+}
+
+void VulkanEngine::init_overdraw_view()
+{
+	CPU_PROFILE_SCOPE("init_overdraw_view");
+	VkShaderModule heatShader = VK_NULL_HANDLE;
+	if (!load_shader_module("../../shaders/overdraw.comp.spv", &heatShader))
+	{
+		LOG_ERROR("Error building overdraw heat map compute shader, no overdraw view.");
+		heatShader = VK_NULL_HANDLE;
+	}
+	else
+	{
+		LOG_INFO("Overdraw heat map compute shader successfully loaded.");
+	}
+
+	_overdraw.init(_device, _allocator, _descriptorAllocator, _layoutCache, heatShader, _pipelineCache, _frameOverlap, _overdrawQuadCounts);
+	_mainDeletionQueue.push_function([=]() {
+		_overdraw.cleanup();
+	});
+}
+
+void VulkanEngine::init_temporal_upscale()
+{
+	CPU_PROFILE_SCOPE("init_temporal_upscale");
+	if (!_useTemporalUpscale)
+	{
+		return;
+	}
+	// the reprojection reads the depth buffer, and a multisampled one would need resolving first
+	VkFormatProperties depthFormatProperties;
+	vkGetPhysicalDeviceFormatProperties(_chosenGPU, _depthFormat, &depthFormatProperties);
+	if ((depthFormatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) == 0 || _msaaSamples != VK_SAMPLE_COUNT_1_BIT)
+	{
+		LOG_WARN("Temporal upscaling needs a single-sampled depth buffer that can be sampled, dynamic resolution blits instead");
+		_useTemporalUpscale = false;
+		return;
+	}
+
+	VkShaderModule resolveShader = VK_NULL_HANDLE;
+	if (!load_shader_module("../../shaders/taaResolve.comp.spv", &resolveShader))
+	{
+		LOG_ERROR("Error building temporal upscaling compute shader, dynamic resolution blits instead.");
+		resolveShader = VK_NULL_HANDLE;
+	}
+	else
+	{
+		LOG_INFO("Temporal upscaling compute shader successfully loaded.");
+	}
+
+	_temporalUpscaler.init(_device, _allocator, _layoutCache, _descriptorSetCache, resolveShader, _pipelineCache);
+	_mainDeletionQueue.push_function([=]() {
+		_temporalUpscaler.cleanup();
+	});
+	resize_temporal_upscale();
+}
+
+void VulkanEngine::resize_temporal_upscale()
+{
+	_temporalUpscaler.resize(_windowExtent);
+	_debugUtils.name(VK_OBJECT_TYPE_IMAGE, _temporalUpscaler.history_image(), "upscale history");
+	_debugUtils.name(VK_OBJECT_TYPE_IMAGE, _temporalUpscaler.output_image(), "upscale history");
+	immediate_submit([=](VkCommandBuffer cmd) {
+		_temporalUpscaler.clear(cmd);
+	});
+}
+
+void VulkanEngine::init_scene_views()
+{
+	CPU_PROFILE_SCOPE("init_scene_views");
+	if (_sceneViewCount == 0)
+	{
+		return;
+	}
+
+	// the scene's color format, so the mesh pipelines draw into them as they are; a fixed size, whatever the
+	// window does later
+	const uint32_t height = std::max(_sceneViewHeight, 1u);
+	const VkExtent2D extent = { std::max(height * _windowExtent.width / std::max(_windowExtent.height, 1u), 1u), height };
+	_sceneViews.init(_device, _allocator, _sceneViewCount, _sceneColorFormat, extent, 10.f);
+	for (uint32_t v = 0; v < _sceneViews.count(); v++)
+	{
+		_debugUtils.name(VK_OBJECT_TYPE_IMAGE, _sceneViews.image(v), "scene view");
+	}
+	_mainDeletionQueue.push_function([=]() {
+		_sceneViews.cleanup();
+	});
+	LOG_INFO(_sceneViews.count() << " extra views of " << extent.width << "x" << extent.height << ", culled in the main view's dispatch");
+}
+
+void VulkanEngine::init_ray_shadows()
+{
+	CPU_PROFILE_SCOPE("init_ray_shadows");
+	VkShaderModule instanceShader = VK_NULL_HANDLE;
+	VkShaderModule traceShader = VK_NULL_HANDLE;
+	if (_useRayShadows)
+	{
+		// the rays start from a depth buffer the trace pass samples, and a multisampled one would need resolving first
+		VkFormatProperties depthFormatProperties;
+		vkGetPhysicalDeviceFormatProperties(_chosenGPU, _depthFormat, &depthFormatProperties);
+		if ((depthFormatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) == 0 || _msaaSamples != VK_SAMPLE_COUNT_1_BIT)
+		{
+			LOG_WARN("Ray-traced shadows need a single-sampled depth buffer that can be sampled, the shadow cascades stay");
+			_useRayShadows = false;
+		}
+	}
+	if (_useRayShadows)
+	{
+		if (!load_shader_module("../../shaders/tlasInstances.comp.spv", &instanceShader)
+			|| !load_shader_module("../../shaders/rayShadows.comp.spv", &traceShader))
+		{
+			LOG_ERROR("Error building the ray shadow compute shaders, the shadow cascades stay");
+			_useRayShadows = false;
+		}
+		else
+		{
+			LOG_INFO("Ray shadow compute shaders successfully loaded.");
+		}
+	}
+	if (_useRayShadows)
+	{
+		// the positions of each vertex stream, in the order the mesh pool was given them
+		const std::vector<AccelerationStructures::VertexLayout> layouts = {
+			{ VK_FORMAT_R32G32B32_SFLOAT, sizeof(Vertex) },
+			{ VK_FORMAT_R16G16B16A16_UNORM, sizeof(PackedVertex) },
+			{ VK_FORMAT_R32G32B32_SFLOAT, sizeof(glm::vec3) },
+			// voxel chunks are remeshed under edits, and structures aren't rebuilt for a new mesh; they're refused
+			{ VK_FORMAT_UNDEFINED, sizeof(VoxelVertex) },
+		};
+		if (!_accelerationStructures.init(_device, _chosenGPU, _allocator, _descriptorAllocator, _meshPool, layouts, _gpuScene.buffer(), MAX_INSTANCES,
+			instanceShader, _pipelineCache, _frameOverlap))
+		{
+			LOG_ERROR("Could not create the acceleration structures, the shadow cascades stay");
+			_useRayShadows = false;
+		}
+		else
+		{
+			_mainDeletionQueue.push_function([=]() {
+				_accelerationStructures.cleanup();
+			});
+		}
+	}
+
+	// the mask exists either way, since set 0 always points at it
+	_rayShadows.init(_device, _allocator, _layoutCache, _useRayShadows ? traceShader : VK_NULL_HANDLE, _pipelineCache, _frameOverlap);
+	_mainDeletionQueue.push_function([=]() {
+		_rayShadows.cleanup();
+	});
+	resize_ray_shadows();
+}
+
+void VulkanEngine::resize_ray_shadows()
+{
+	_rayShadows.resize(_windowExtent);
+	_debugUtils.name(VK_OBJECT_TYPE_IMAGE, _rayShadows.image(), "ray shadow mask");
+	immediate_submit([=](VkCommandBuffer cmd) {
+		_rayShadows.clear(cmd);
+	});
+
+	VkDescriptorImageInfo maskInfo = {};
+	maskInfo.sampler = _rayShadows.sampler();
+	maskInfo.imageView = _rayShadows.view();
+	maskInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	VkWriteDescriptorSet maskWrite = vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _globalDescriptor, &maskInfo, 5);
+	vkUpdateDescriptorSets(_device, 1, &maskWrite, 0, nullptr);
+}
+
+void VulkanEngine::init_skinning()
+{
+	CPU_PROFILE_SCOPE("init_skinning");
+	if (_characterCount == 0)
+	{
+		return;
+	}
+	VkShaderModule skinShader = VK_NULL_HANDLE;
+	if (!load_shader_module("../../shaders/skinning.comp.spv", &skinShader))
+	{
+		LOG_ERROR("Error building the skinning compute shader, no characters");
+		return;
+	}
+	LOG_INFO("Skinning compute shader successfully loaded.");
+
+	std::vector<SkinnedVertex> bindPose;
+	std::vector<uint32_t> indices;
+	build_character_rig(bindPose, indices);
+	const uint32_t vertexCount = static_cast<uint32_t>(bindPose.size());
+	const uint32_t jointCount = _characterSkeleton.joint_count();
+
+	// every character shares the one set of bind-pose vertices
+	if (!_skinning.init(_device, _allocator, _descriptorAllocator, _meshPool.vertex_buffer(static_cast<uint32_t>(VertexFormat::Full))._buffer, skinShader,
+		_pipelineCache, _frameOverlap, vertexCount, _characterCount * jointCount))
+	{
+		LOG_ERROR("Could not create the skinning buffers, no characters");
+		return;
+	}
+	_mainDeletionQueue.push_function([=]() {
+		_skinning.cleanup();
+	});
+	uint32_t sourceOffset = 0;
+	_skinning.allocate_source(vertexCount, sourceOffset);
+	_uploadManager.upload_buffer(_skinning.source_buffer(), static_cast<VkDeviceSize>(sourceOffset) * sizeof(SkinnedVertex), bindPose.size() * sizeof(SkinnedVertex),
+		[&bindPose](void* data) { memcpy(data, bindPose.data(), bindPose.size() * sizeof(SkinnedVertex)); },
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+	// culling sees one box for the whole clip: every vertex posed at a few dozen points of it, grown a
+	// little for the poses in between
+	constexpr uint32_t BOUNDS_SAMPLES = 48;
+	MeshBounds reach = { glm::vec3(std::numeric_limits<float>::max()), glm::vec3(-std::numeric_limits<float>::max()), glm::vec3(0.f), 0.f };
+	std::vector<glm::mat4> pose(jointCount);
+	for (uint32_t sample = 0; sample < BOUNDS_SAMPLES; sample++)
+	{
+		animation::sample_pose({ &_characterClip, &_characterSkeleton, _characterClip.duration() * sample / BOUNDS_SAMPLES, pose.data() });
+		for (const SkinnedVertex& vertex : bindPose)
+		{
+			glm::vec3 position(0.f);
+			for (uint32_t k = 0; k < 4; k++)
+			{
+				position += vertex.weights[k] / 255.f * glm::vec3(pose[vertex.joints[k]] * glm::vec4(vertex.position, 1.f));
+			}
+			reach.min = glm::min(reach.min, position);
+			reach.max = glm::max(reach.max, position);
+		}
+	}
+	reach.origin = (reach.min + reach.max) * 0.5f;
+	reach.radius = glm::length(reach.max - reach.origin) * 1.05f;
+	reach.min = reach.origin - (reach.origin - reach.min) * 1.05f;
+	reach.max = reach.origin + (reach.max - reach.origin) * 1.05f;
+
+	_characters.reserve(_characterCount);
+	for (uint32_t i = 0; i < _characterCount; i++)
+	{
+		uint32_t firstJoint = 0;
+		_skinning.allocate_joints(jointCount, firstJoint);
+
+		// the mesh holds a copy of the bind pose per frame slot, a drawable range each until the pass overwrites it
+		Mesh& mesh = _meshes["character_" + std::to_string(i)];
+		mesh._skinned = true;
+		mesh._vertices.reserve(static_cast<size_t>(vertexCount) * _frameOverlap);
+		for (uint32_t slot = 0; slot < _frameOverlap; slot++)
+		{
+			for (const SkinnedVertex& source : bindPose)
+			{
+				mesh._vertices.push_back({ source.position, source.normal, source.color });
+			}
+		}
+		mesh._indices = indices;
+		mesh.update_index_type();
+		mesh.compute_bounds();
+		mesh._bounds = reach;
+		mesh._surfaces[0].bounds = reach;
+		upload_mesh(mesh);
+		if (mesh._poolAllocation.vertexCount == 0)
+		{
+			LOG_WARN("Mesh pool full, " << i << " of " << _characterCount << " characters");
+			_meshes.erase("character_" + std::to_string(i));
+			break;
+		}
+		// the pool has them now; every frame draws vertexCount of them
+		mesh._vertices.clear();
+		mesh._vertices.shrink_to_fit();
+
+		SkinnedCharacter character = {};
+		character.mesh = &mesh;
+		character.output = mesh._poolAllocation;
+		character.sourceOffset = sourceOffset;
+		character.firstJoint = firstJoint;
+		character.skeleton = &_characterSkeleton;
+		character.clip = &_characterClip;
+		character.timeOffset = glm::fract(i * 0.618033989) * _characterClip.duration();
+		mesh._poolAllocation.vertexCount = vertexCount;
+		_characters.push_back(character);
+	}
+
+	// like the built-in meshes, small enough to wait for
+	_uploadManager.wait(_uploadManager.flush());
+	for (SkinnedCharacter& character : _characters)
+	{
+		character.mesh->_resident = true;
+	}
+}
+
+void VulkanEngine::build_character_rig(std::vector<SkinnedVertex>& vertices, std::vector<uint32_t>& indices)
+{
+	// a tentacle: a chain of joints up +Y, each bending about two axes out of phase with its parent
+	constexpr uint32_t JOINTS = 8;
+	constexpr uint32_t RINGS_PER_JOINT = 4;
+	constexpr uint32_t SIDES = 12;
+	constexpr uint32_t KEYS = 60;
+	constexpr float SEGMENT = 0.3f;
+
+	_characterSkeleton = {};
+	for (uint32_t joint = 0; joint < JOINTS; joint++)
+	{
+		_characterSkeleton.add(glm::translate(glm::vec3(0.f, joint * SEGMENT, 0.f)), joint == 0 ? Skeleton::NO_PARENT : joint - 1);
+	}
+
+	_characterClip.init(JOINTS, KEYS, 30.f);
+	for (uint32_t key = 0; key < KEYS; key++)
+	{
+		const float phase = key * 6.28318531f / KEYS;
+		for (uint32_t joint = 0; joint < JOINTS; joint++)
+		{
+			const float sway = 0.3f * std::sin(phase + joint * 0.7f);
+			const float nod = 0.15f * std::cos(phase + joint * 0.9f);
+			const glm::quat rotation = glm::angleAxis(sway, glm::vec3(0.f, 0.f, 1.f)) * glm::angleAxis(nod, glm::vec3(1.f, 0.f, 0.f));
+			_characterClip.set_key(key, joint, joint == 0 ? glm::vec3(0.f) : glm::vec3(0.f, SEGMENT, 0.f), rotation, glm::vec3(1.f));
+		}
+	}
+
+	// each ring follows the two joints around its height, the nearer one the more
+	const uint32_t rings = JOINTS * RINGS_PER_JOINT + 1;
+	for (uint32_t ring = 0; ring < rings; ring++)
+	{
+		const float height = ring * SEGMENT / RINGS_PER_JOINT;
+		const float along = std::clamp(height / SEGMENT - 0.5f, 0.f, static_cast<float>(JOINTS - 1));
+		const uint32_t lower = std::min(static_cast<uint32_t>(along), JOINTS - 1);
+		const uint32_t upper = std::min(lower + 1, JOINTS - 1);
+		const uint8_t upperWeight = static_cast<uint8_t>(std::lround((along - lower) * 255.f));
+		const float radius = glm::mix(0.15f, 0.03f, static_cast<float>(ring) / (rings - 1));
+		for (uint32_t side = 0; side < SIDES; side++)
+		{
+			const float angle = side * 6.28318531f / SIDES;
+			SkinnedVertex vertex = {};
+			vertex.normal = glm::vec3(std::cos(angle), 0.f, std::sin(angle));
+			vertex.position = vertex.normal * radius + glm::vec3(0.f, height, 0.f);
+			vertex.color = glm::mix(glm::vec3(0.55f, 0.2f, 0.45f), glm::vec3(0.95f, 0.6f, 0.5f), static_cast<float>(ring) / (rings - 1));
+			vertex.joints[0] = static_cast<uint8_t>(lower);
+			vertex.joints[1] = static_cast<uint8_t>(upper);
+			vertex.weights[0] = static_cast<uint8_t>(255 - upperWeight);
+			vertex.weights[1] = upperWeight;
+			vertices.push_back(vertex);
+		}
+	}
+	// up the tube, then around it: counter-clockwise seen from outside
+	for (uint32_t ring = 0; ring + 1 < rings; ring++)
+	{
+		for (uint32_t side = 0; side < SIDES; side++)
+		{
+			const uint32_t a = ring * SIDES + side;
+			const uint32_t b = ring * SIDES + (side + 1) % SIDES;
+			indices.insert(indices.end(), { a, a + SIDES, b + SIDES, a, b + SIDES, b });
+		}
+	}
+}
+
+void VulkanEngine::animate_characters(uint32_t frame, double time)
+{
+	CPU_PROFILE_SCOPE("animate_characters");
+	_poseRequests.clear();
+	_skinDispatches.clear();
+	glm::mat4* joints = _skinning.joints(frame);
+	for (SkinnedCharacter& character : _characters)
+	{
+		_poseRequests.push_back({ character.clip, character.skeleton, time + character.timeOffset, joints + character.firstJoint });
+
+		// every draw of the frame reads the range from the mesh as it records
+		MeshAllocation& drawn = character.mesh->_poolAllocation;
+		drawn.vertexOffset = character.output.vertexOffset + frame * drawn.vertexCount;
+		_skinDispatches.push_back({ character.sourceOffset, drawn.vertexCount, drawn.vertexOffset, character.firstJoint });
+	}
+	animation::sample_poses(_poseRequests.data(), _poseRequests.size());
+}
+
+void VulkanEngine::animate_lights(double time)
+{
+	// a low-discrepancy sequence spreads them evenly over the floor, each with its own hue, height and drift
+	for (size_t i = 0; i < _lights.size(); i++)
+	{
+		const float a = glm::fract(i * 0.754877666f);
+		const float b = glm::fract(i * 0.569840291f);
+		const float height = glm::fract(i * 0.318309886f);
+		const float hue = glm::fract(i * 0.618033989f);
+		const float phase = glm::fract(i * 0.414213562f) * 6.28318531f;
+		const float t = static_cast<float>(time) * 0.5f + phase;
+
+		const glm::vec3 position = glm::vec3(a * 40.f - 20.f, glm::mix(-0.8f, 1.5f, height), b * 40.f - 20.f)
+			+ glm::vec3(std::cos(t), 0.25f * std::sin(2.f * t), std::sin(t)) * 1.5f;
+		const glm::vec3 color = glm::clamp(glm::abs(glm::fract(glm::vec3(hue) + glm::vec3(0.f, 2.f, 1.f) / 3.f) * 6.f - 3.f) - 1.f, 0.f, 1.f);
+		_lights[i].positionRadius = glm::vec4(position, 2.0f);
+		_lights[i].color = glm::vec4(color * 3.0f, 0.f);
+	}
+}
+
+void VulkanEngine::write_cull_pyramid_descriptors()
+{
+	VkDescriptorImageInfo pyramidInfo = {};
+	pyramidInfo.sampler = _depthPyramid.sampler();
+	pyramidInfo.imageView = _depthPyramid.view();
+	pyramidInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+	for (uint32_t i = 0; i < _frameOverlap; i++)
+	{
+		VkWriteDescriptorSet write = vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _frames[i]._cullDescriptor, &pyramidInfo, 6);
+		vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+	}
+	if (_foliage.ready())
+	{
+		_foliage.set_depth_pyramid(_depthPyramid.view(), _depthPyramid.sampler());
+	}
+}
+
+void VulkanEngine::load_meshes()
+{
+	CPU_PROFILE_SCOPE("load_meshes");
+	// triangle mesh
+	Mesh triangleMesh;
+	triangleMesh._vertices.resize(3);
+
+	triangleMesh._vertices[0].position = { 1.0f, 1.0f, 0.0f };
+	triangleMesh._vertices[1].position = {-1.0f, 1.0f, 0.0f };
+	triangleMesh._vertices[2].position = { 0.0f,-1.0f, 0.0f };
+
+	triangleMesh._vertices[0].color = { 1.0f, 0.0f, 0.0f };
+	triangleMesh._vertices[1].color = { 0.0f, 1.0f, 0.0f };
+	triangleMesh._vertices[2].color = { 0.0f, 0.0f, 1.0f };
+
+	triangleMesh._indices = { 0, 1, 2 };
+	triangleMesh.update_index_type();
+	triangleMesh.compute_bounds();
+
+	// unit cube drawn in place of streamed meshes until they're resident
+	Mesh placeholderMesh;
+	const glm::vec3 axes[3] = { { 1.f, 0.f, 0.f }, { 0.f, 1.f, 0.f }, { 0.f, 0.f, 1.f } };
+	for (int face = 0; face < 6; face++)
+	{
+		// u x v == normal, so the corners below wind counter-clockwise seen from outside
+		glm::vec3 normal = axes[face / 2] * (face % 2 ? -1.f : 1.f);
+		glm::vec3 u = axes[(face / 2 + 1) % 3];
+		glm::vec3 v = glm::cross(normal, u);
+
+		uint32_t first = static_cast<uint32_t>(placeholderMesh._vertices.size());
+		const glm::vec2 corners[4] = { { -1.f, -1.f }, { 1.f, -1.f }, { 1.f, 1.f }, { -1.f, 1.f } };
+		for (const glm::vec2& corner : corners)
+		{
+			Vertex vertex;
+			vertex.position = normal + u * corner.x + v * corner.y;
+			vertex.normal = normal;
+			vertex.color = glm::vec3(0.5f);
+			placeholderMesh._vertices.push_back(vertex);
+		}
+		placeholderMesh._indices.insert(placeholderMesh._indices.end(), { first, first + 1, first + 2, first, first + 2, first + 3 });
+	}
+	placeholderMesh.update_index_type();
+	placeholderMesh.compute_bounds();
+
+	upload_mesh(triangleMesh);
+	upload_mesh(placeholderMesh);
+
+	// the built-in meshes are tiny; waiting for them means the first frame always has its placeholders
+	_uploadManager.wait(_uploadManager.flush());
+	triangleMesh._resident = true;
+	placeholderMesh._resident = true;
+
+	// meshes only hold pool offsets, so moving them into the map is safe
+	_meshes["triangle"] = std::move(triangleMesh);
+	_meshes["placeholder"] = std::move(placeholderMesh);
+
+	// meshes from disk stream in on the loader thread; their map entries exist from the start so render
+	// objects can point at them, and stay empty until update_streaming() fills them
+	if (!_assetCachePath.empty() && _assetCache.open(_assetCachePath))
+	{
+		// pushed first so it runs after the loader thread has stopped using it
+		_mainDeletionQueue.push_function([=]() {
+			_assetCache.close();
+		});
+	}
+	_streamer.start(_assetArchive.is_open() ? &_assetArchive : nullptr, gpu_index_unpack(), _compressMeshCaches,
+		_assetCache.is_open() ? &_assetCache : nullptr, _useReadAhead);
+	_mainDeletionQueue.push_function([=]() {
+		_streamer.stop();
+	});
+
+	if (!_gltfPath.empty())
+	{
+		load_gltf_meshes();
+	}
+
+	// goes through the binary mesh cache; the OBJ is only parsed when the cache is missing or stale
+	const VertexFormat streamedFormat = _usePackedVertices ? VertexFormat::Packed
+		: _useSplitVertexStreams ? VertexFormat::Split : VertexFormat::Full;
+	_meshes["monkey"];
+	_streamer.request_mesh("monkey", "../../assets/monkey_smooth.obj", streamedFormat);
+	_assetWatcher.watch_mesh("monkey", "../../assets/monkey_smooth.obj", streamedFormat);
+	if (!_objScenePath.empty())
+	{
+		_meshes[_objScenePath];
+		_streamer.request_mesh(_objScenePath, _objScenePath, streamedFormat);
+		_assetWatcher.watch_mesh(_objScenePath, _objScenePath, streamedFormat);
+	}
+
+	if (!_voxelScenePath.empty())
+	{
+		load_voxel_world();
+	}
+}
+
+void VulkanEngine::load_voxel_world()
+{
+	CPU_PROFILE_SCOPE("load_voxel_world");
+	const AssetArchive* archive = _assetArchive.is_open() ? &_assetArchive : nullptr;
+	std::vector<Mesh> parts;
+	if (!Mesh::load_parts(_voxelScenePath.c_str(), parts, archive, false, _compressMeshCaches, _assetCache.is_open() ? &_assetCache : nullptr))
+	{
+		LOG_ERROR("Could not load " << _voxelScenePath);
+		return;
+	}
+
+	// a block type per part, colored by its texture; the maps are only read here, never uploaded
+	std::unordered_map<std::string, Texture> diffuseMaps;
+	size_t triangles = 0;
+	size_t voxelized = 0;
+	for (const Mesh& part : parts)
+	{
+		const Texture* diffuse = nullptr;
+		if (!part._material.diffuseTexture.empty())
+		{
+			auto found = diffuseMaps.try_emplace(part._material.diffuseTexture);
+			if (found.second)
+			{
+				found.first->second.load_from_image(part._material.diffuseTexture.c_str(), archive);
+			}
+			diffuse = &found.first->second;
+		}
+		voxelized += _voxelWorld.voxelize(part, add_block_type_for(_voxelWorld, part, diffuse));
+		triangles += part.get_lod(0).indexCount / 3;
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	_voxelWorld.remesh_dirty();
+	const double meshMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::vector<Mesh*> uploaded;
+	size_t quads = 0;
+	for (uint32_t i = 0; i < _voxelWorld.chunk_count(); i++)
+	{
+		Mesh& mesh = _meshes["voxel_chunk_" + std::to_string(i)];
+		mesh = std::move(_voxelWorld.chunk(i).mesh);
+		if (mesh.index_count() > 0)
+		{
+			quads += mesh._vertices.size() / 4;
+			upload_mesh(mesh);
+			uploaded.push_back(&mesh);
+		}
+	}
+	_uploadManager.wait(_uploadManager.flush());
+	// the blocks are the source of the meshes, so their copies can always go
+	for (Mesh* mesh : uploaded)
+	{
+		make_resident(*mesh);
+	}
+
+	LOG_INFO(_voxelScenePath << ": " << voxelized << " of " << triangles << " triangles voxelized into " << _voxelWorld.chunk_count()
+		<< " chunks, " << quads << " greedy quads in " << meshMs << " ms");
+}
+
+void VulkanEngine::load_gltf_meshes()
+{
+	CPU_PROFILE_SCOPE("load_gltf_meshes");
+	GltfLoadTimings timings;
+	if (!_gltfDocument.load(_gltfPath.c_str(), &timings))
+	{
+		LOG_ERROR("Could not load " << _gltfPath);
+		return;
+	}
+
+	// primitives convert on their own workers, the way OBJ shapes do, straight out of the mapped buffers
+	// into the vertices the upload writers read
+	const std::vector<GltfMesh>& meshes = _gltfDocument.meshes();
+	std::vector<std::pair<size_t, size_t>> primitives;
+	for (size_t m = 0; m < meshes.size(); m++)
+	{
+		for (size_t p = 0; p < meshes[m].primitives.size(); p++)
+		{
+			primitives.push_back({ m, p });
+		}
+	}
+	const auto start = std::chrono::steady_clock::now();
+	std::vector<Mesh> converted(primitives.size());
+	std::vector<uint8_t> loaded(primitives.size(), 0);
+	const VertexFormat format = _usePackedVertices ? VertexFormat::Packed : _useSplitVertexStreams ? VertexFormat::Split : VertexFormat::Full;
+	parallel_for(primitives.size(), [&](size_t i) {
+		const std::string name = gltf_mesh_name(primitives[i].first, primitives[i].second);
+		loaded[i] = converted[i].load_from_gltf(meshes[primitives[i].first].primitives[primitives[i].second], name.c_str());
+		if (loaded[i])
+		{
+			converted[i].set_vertex_format(format);
+		}
+	});
+	LOG_INFO(_gltfPath << ": map " << timings.mapMs << " ms, parse " << timings.parseMs << " ms, " << primitives.size()
+		<< " primitives in " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms");
+
+	// meshes only hold pool offsets, so they can be uploaded where the map keeps them
+	std::vector<Mesh*> uploaded;
+	for (size_t i = 0; i < primitives.size(); i++)
+	{
+		if (loaded[i])
+		{
+			Mesh& mesh = _meshes[gltf_mesh_name(primitives[i].first, primitives[i].second)];
+			mesh = std::move(converted[i]);
+			upload_mesh(mesh);
+			uploaded.push_back(&mesh);
+		}
+	}
+	_uploadManager.wait(_uploadManager.flush());
+	for (Mesh* mesh : uploaded)
+	{
+		// batch_static_objects reads the copies before they can go
+		if (_staticBatching && _releaseMeshCopies)
+		{
+			mesh->_resident = true;
+			_deferredMeshReleases.push_back(mesh);
+			continue;
+		}
+		make_resident(*mesh);
+	}
+}
+
+std::string VulkanEngine::gltf_mesh_name(size_t mesh, size_t primitive) const
+{
+	return _gltfPath + "#" + std::to_string(mesh) + "/" + std::to_string(primitive);
+}
+
+void VulkanEngine::load_textures()
+{
+	CPU_PROFILE_SCOPE("load_textures");
+	VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_LINEAR);
+	_linearSampler = _layoutCache.sampler(samplerInfo);
+	_mainDeletionQueue.push_function([=]() {
+		// level changes that never got swapped in
+		for (TextureLevelChange& change : _textureLevelChanges)
+		{
+			vkDestroyImageView(_device, change.imageView, nullptr);
+			vmaDestroyImage(_allocator, change.image._image, change.image._allocation);
+		}
+		for (auto& entry : _virtualTextures)
+		{
+			entry.second.cleanup();
+		}
+	});
+	LOG_INFO("Mip streaming " << (_useMipStreaming ? "on" : "off") << ", streamed textures capped at "
+		<< (_textureMemoryCap >> 20) << " MiB");
+
+	_useVirtualTexturing = _useVirtualTexturing && _enabledFeatures.fragmentStoresAndAtomics;
+
+	// decoded on the loader thread like the meshes; the entry stays non-resident until its mips exist
+	const bool compress = _useCompressedTextures && _enabledFeatures.textureCompressionBC;
+	_textures["empire_diffuse"];
+	_streamer.request_texture("empire_diffuse", "../../assets/lost_empire-RGBA.png", compress);
+	_assetWatcher.watch_texture("empire_diffuse", "../../assets/lost_empire-RGBA.png", compress);
+
+	// replacements still on their way at shutdown were never swapped into an entry that releases them
+	_mainDeletionQueue.push_function([this]() {
+		for (TextureReload& reload : _textureReloads)
+		{
+			vkDestroyImageView(_device, reload.replacement->_imageView, nullptr);
+			vmaDestroyImage(_allocator, reload.replacement->_image._image, reload.replacement->_image._allocation);
+		}
+		_textureReloads.clear();
+		for (MeshReload& reload : _meshReloads)
+		{
+			if (reload.upload.packedIndices._buffer != VK_NULL_HANDLE)
+			{
+				vmaDestroyBuffer(_allocator, reload.upload.packedIndices._buffer, reload.upload.packedIndices._allocation);
+			}
+		}
+		_meshReloads.clear();
+	});
+}
+
+bool VulkanEngine::upload_texture(Texture& texture, bool reload)
+{
+	// block-compressed chains stream: only the levels up to MIP_STREAMING_TAIL_SIZE go up now, the finer
+	// ones once update_texture_residency sees them on screen
+	texture._streamed = _useMipStreaming && texture.is_block_compressed() && texture._levels.size() > 1;
+	texture._firstResidentLevel = texture._streamed ? mipstream::first_level_within(texture._levels, MIP_STREAMING_TAIL_SIZE) : 0;
+
+	// compressed textures bring their whole chain; decoded ones get the rest blitted, which needs
+	// linear filtering support on the format (without it only level 0 is kept)
+	texture._mipLevels = static_cast<uint32_t>(texture._levels.size()) - texture._firstResidentLevel;
+	if (!texture.is_block_compressed())
+	{
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(_chosenGPU, texture._format, &formatProperties);
+		const VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT
+			| VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+		if ((formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures)
+		{
+			texture._mipLevels = texture.full_mip_count();
+		}
+	}
+
+	if (_overMemoryBudget || !create_texture_image(texture, texture._firstResidentLevel, texture._mipLevels, texture._image, texture._imageView))
+	{
+		texture._image = {};
+		return false;
+	}
+
+	// whichever image the texture holds by then; the ones it streamed away from go with their frames
+	if (!reload)
+	{
+		Texture* owner = &texture;
+		_mainDeletionQueue.push_function([this, owner]() {
+			vkDestroyImageView(_device, owner->_imageView, nullptr);
+			vmaDestroyImage(_allocator, owner->_image._image, owner->_image._allocation);
+		});
+	}
+
+	if (!texture._streamed)
+	{
+		// the staging copy is all the GPU needs
+		texture._pixels.clear();
+		texture._pixels.shrink_to_fit();
+	}
+	return true;
+}
+
+bool VulkanEngine::create_virtual_texture(const std::string& name, Texture& texture)
+{
+	if (!_useVirtualTexturing || std::max(texture._width, texture._height) < _virtualTextureMinSize)
+	{
+		return false;
+	}
+
+	// the cache follows the screen; the pages come from the stored chain, which stays in memory for it
+	VirtualTexture& virtualTexture = _virtualTextures[name];
+	if (!virtualTexture.init(_device, _allocator, _descriptorAllocator, _layoutCache, texture, VirtualTexture::cache_side_for(_windowExtent),
+		_frameOverlap, _linearSampler))
+	{
+		_virtualTextures.erase(name);
+		return false;
+	}
+	LOG_INFO("Texture " << name << " is virtual: " << virtualTexture.page_count() << " pages, "
+		<< (virtualTexture.memory_bytes() >> 20) << " MiB of cache");
+	return true;
+}
+
+bool VulkanEngine::create_texture_image(const Texture& texture, uint32_t firstLevel, uint32_t mipLevels, AllocatedImage& image, VkImageView& imageView)
+{
+	const TextureLevel& first = texture._levels[firstLevel];
+	VkExtent3D extent = { first.width, first.height, 1 };
+	VkImageCreateInfo imageInfo = vkinit::image_create_info(texture._format,
+		VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, extent);
+	imageInfo.mipLevels = mipLevels;
+
+	// textures are what we can do without, so they must fit the budget; the failure is expected, not an error
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+	allocInfo.pool = _gpuMemory.pool(MemoryPoolType::Texture);
+	allocInfo.flags = VMA_ALLOCATION_CREATE_WITHIN_BUDGET_BIT;
+	// a priority is the whole block's, so a large texture out of view could only be paged out with its neighbours
+	if (_gpuMemory.priorities_enabled() && mipstream::tail_bytes(texture._levels, firstLevel) >= DEDICATED_TEXTURE_BYTES)
+	{
+		allocInfo.pool = VK_NULL_HANDLE;
+		allocInfo.flags |= VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+	}
+	if (vmaCreateImage(_allocator, &imageInfo, &allocInfo, &image._image, &image._allocation, nullptr) != VK_SUCCESS)
+	{
+		return false;
+	}
+
+	VkImageViewCreateInfo viewInfo = vkinit::imageview_create_info(texture._format, image._image, VK_IMAGE_ASPECT_COLOR_BIT);
+	viewInfo.subresourceRange.levelCount = mipLevels;
+	VK_CHECK(vkCreateImageView(_device, &viewInfo, nullptr, &imageView));
+
+	// one copy per stored level from firstLevel on, straight from the tightly packed data
+	std::vector<VkBufferImageCopy> regions(texture._levels.size() - firstLevel);
+	for (uint32_t i = firstLevel; i < texture._levels.size(); i++)
+	{
+		VkBufferImageCopy& region = regions[i - firstLevel];
+		region = {};
+		region.bufferOffset = texture._levels[i].offset - first.offset;
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = i - firstLevel;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageExtent = { texture._levels[i].width, texture._levels[i].height, 1 };
+	}
+
+	const uint8_t* pixels = texture._pixels.data() + first.offset;
+	const size_t size = texture._pixels.size() - first.offset;
+	auto write = [pixels, size](void* data) { memcpy(data, pixels, size); };
+	if (regions.size() < mipLevels)
+	{
+		// every level stays TRANSFER_DST; the graphics queue blits them once it owns the image
+		_uploadManager.upload_image(image._image, mipLevels, regions, size, write,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+	}
+	else
+	{
+		_uploadManager.upload_image(image._image, mipLevels, regions, size, write,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+	}
+	return true;
+}
+
+bool VulkanEngine::update_texture_residency()
+{
+	if (!_useMipStreaming)
+	{
+		return false;
+	}
+
+	// every resident streamed texture that isn't already changing levels
+	std::vector<mipstream::Demand> demands;
+	std::vector<Texture*> streamed;
+	std::unordered_map<const Texture*, size_t> demandIndex;
+	_streamedTextureBytes = 0;
+	for (auto& entry : _textures)
+	{
+		Texture& texture = entry.second;
+		if (!texture._streamed || !texture._resident)
+		{
+			continue;
+		}
+		_streamedTextureBytes += mipstream::tail_bytes(texture._levels, texture._firstResidentLevel);
+		const uint32_t tail = mipstream::first_level_within(texture._levels, MIP_STREAMING_TAIL_SIZE);
+		demandIndex[&texture] = demands.size();
+		demands.push_back({ &texture._levels, tail, tail, texture._firstResidentLevel });
+		streamed.push_back(&texture);
+	}
+	if (demands.empty())
+	{
+		return false;
+	}
+
+	// feedback: the finest level any object drawing with the texture could show, from the screen size of its
+	// bounding sphere. Textures nothing draws with keep only their tail
+	for (const RenderObject& object : _renderables)
+	{
+		const Texture* texture = object.material->texture;
+		auto found = texture != nullptr ? demandIndex.find(texture) : demandIndex.end();
+		if (found == demandIndex.end())
+		{
+			continue;
+		}
+
+		const glm::mat4& model = _transforms.world(object.transformIndex);
+		const float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+		const glm::vec3 center = glm::vec3(model * glm::vec4(object.mesh->_bounds.origin, 1.f));
+		const float radius = object.mesh->_bounds.radius * scale;
+		const float distance = glm::length(center - _camera.position()) - radius;
+		// from inside the sphere it can fill the screen
+		const float diameter = distance > 0.f ? 2.f * radius * _lodPixelScale / distance : std::numeric_limits<float>::max();
+
+		mipstream::Demand& demand = demands[found->second];
+		const uint32_t level = mipstream::level_for_screen_size(texture->_width, texture->_height, diameter) + _mipStreamingBias;
+		demand.wantedLevel = std::min(demand.wantedLevel, level);
+	}
+
+	// what the largest device-local heap leaves for streamed textures under the pressure limit, counting the
+	// ones resident now as free, capped by _textureMemoryCap
+	VkDeviceSize room = 0;
+	for (uint32_t i = 0; i < _gpuMemory.heap_count(); i++)
+	{
+		const GpuMemory::HeapBudget& heap = _gpuMemory.heap(i);
+		if (!heap.deviceLocal)
+		{
+			continue;
+		}
+		const VkDeviceSize limit = static_cast<VkDeviceSize>(heap.budget * _memoryPressureLimit);
+		const VkDeviceSize others = heap.usage > _streamedTextureBytes ? heap.usage - _streamedTextureBytes : 0;
+		room = std::max(room, limit > others ? limit - others : 0);
+	}
+	room = std::min(room, _textureMemoryCap);
+	const bool overRoom = _streamedTextureBytes > room;
+	mipstream::fit_to_budget(demands, static_cast<size_t>(room));
+
+	// finer levels only while there's room for them, at most _mipStreamingBytesPerFrame of them a frame; coarser
+	// ones when the budget asks for it, or once they're two levels past what's wanted, so a camera hovering at a
+	// level boundary doesn't keep streaming the same level in and out
+	bool queued = false;
+	size_t queuedBytes = 0;
+	for (size_t i = 0; i < demands.size(); i++)
+	{
+		Texture& texture = *streamed[i];
+		const uint32_t level = demands[i].level;
+		const bool streamIn = level < texture._firstResidentLevel && !_overMemoryBudget && queuedBytes < _mipStreamingBytesPerFrame;
+		const bool streamOut = level > texture._firstResidentLevel && (overRoom || level > texture._firstResidentLevel + 1);
+		const bool changing = std::any_of(_textureLevelChanges.begin(), _textureLevelChanges.end(),
+			[&texture](const TextureLevelChange& change) { return change.texture == &texture; });
+		if ((!streamIn && !streamOut) || changing)
+		{
+			continue;
+		}
+		// finer levels are a prefetch; coarser ones give memory back, which can't wait behind one
+		const size_t bytes = mipstream::tail_bytes(texture._levels, level);
+		if (!_uploadManager.admit(bytes, streamIn ? UploadPriority::Prefetch : UploadPriority::Visible))
+		{
+			continue;
+		}
+
+		// the new image replaces the old one once the graphics queue has acquired it; both exist until then
+		TextureLevelChange change = { &texture, {}, VK_NULL_HANDLE, level, 0 };
+		const uint32_t mipLevels = static_cast<uint32_t>(texture._levels.size()) - level;
+		if (!create_texture_image(texture, level, mipLevels, change.image, change.imageView))
+		{
+			continue;
+		}
+		_textureLevelChanges.push_back(change);
+		queuedBytes += bytes;
+		queued = true;
+	}
+	return queued;
+}
+
+void VulkanEngine::update_residency_priorities()
+{
+	if (!_gpuMemory.priorities_enabled() || _frameNumber % RESIDENCY_PRIORITY_INTERVAL != 0)
+	{
+		return;
+	}
+
+	// the textures of the objects whose bounds reach into the frustum; the camera turning brings the rest back
+	// within an interval, from system memory at worst
+	const glm::vec4* planes = _camera.frustum_planes();
+	_visibleTextures.clear();
+	for (const RenderObject& object : _renderables)
+	{
+		const Texture* texture = object.material->texture;
+		if (texture == nullptr)
+		{
+			continue;
+		}
+		const glm::mat4& model = _transforms.world(object.transformIndex);
+		const float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+		const glm::vec3 center = glm::vec3(model * glm::vec4(object.mesh->_bounds.origin, 1.f));
+		const float radius = object.mesh->_bounds.radius * scale;
+		bool visible = true;
+		for (uint32_t i = 0; i < 6 && visible; i++)
+		{
+			visible = glm::dot(glm::vec3(planes[i]), center) + planes[i].w >= -radius;
+		}
+		if (visible)
+		{
+			_visibleTextures.push_back(texture);
+		}
+	}
+	std::sort(_visibleTextures.begin(), _visibleTextures.end());
+	_visibleTextures.erase(std::unique(_visibleTextures.begin(), _visibleTextures.end()), _visibleTextures.end());
+
+	for (VmaAllocation allocation : _frameGraph.transient_allocations())
+	{
+		_gpuMemory.tag(allocation, ResidencyPriority::RenderTarget);
+	}
+	_gpuMemory.tag(_depthImage._allocation, ResidencyPriority::RenderTarget);
+	for (const auto& entry : _textures)
+	{
+		const Texture& texture = entry.second;
+		const bool visible = texture._resident && std::binary_search(_visibleTextures.begin(), _visibleTextures.end(), &texture);
+		_gpuMemory.tag(texture._image._allocation, visible ? ResidencyPriority::Visible : ResidencyPriority::Prefetch);
+	}
+	// finer levels on their way in are a prefetch until they're swapped in
+	for (const TextureLevelChange& change : _textureLevelChanges)
+	{
+		_gpuMemory.tag(change.image._allocation, ResidencyPriority::Prefetch);
+	}
+	_gpuMemory.apply_priorities();
+}
+
+void VulkanEngine::update_texture_materials(const Texture& texture)
+{
+	for (auto& entry : _materials)
+	{
+		if (entry.second.texture == &texture)
+		{
+			write_material_data(entry.second);
+		}
+	}
+}
+
+void VulkanEngine::write_material_data(const Material& material)
+{
+	if (!_useBindless || material.materialIndex >= MAX_MATERIALS)
+	{
+		return;
+	}
+
+	// only what changed is marked, so rewriting a material that didn't costs no upload
+	_materialStore.set_base_color(material.materialIndex, material.baseColor);
+	_materialStore.set_texture_index(material.materialIndex,
+		material.texture != nullptr && material.texture->_resident ? material.texture->_bindlessIndex : INVALID_BINDLESS_INDEX);
+}
+
+void VulkanEngine::update_streaming()
+{
+	CPU_PROFILE_SCOPE("update_streaming");
+	// retired batches hand their ring space back before this frame's uploads ask for it
+	_uploadManager.collect();
+	_uploadManager.begin_frame();
+
+	// what arrived queues behind what the budget held back last frame, so assets still go out in load order
+	bool uploaded = false;
+	for (AssetStreamer::LoadedMesh& loaded : _streamer.take_loaded())
+	{
+		_pendingMeshes.push_back(std::move(loaded));
+	}
+	while (!_pendingMeshes.empty() && _uploadManager.admit(staged_bytes(_pendingMeshes.front()), UploadPriority::Visible))
+	{
+		AssetStreamer::LoadedMesh loaded = std::move(_pendingMeshes.front());
+		_pendingMeshes.pop_front();
+		_metrics.record_asset_load(AssetKind::Mesh, loaded.loadMs);
+		if (_reloadingMeshes.erase(loaded.name) > 0)
+		{
+			if (loaded.loaded && reload_mesh(loaded))
+			{
+				uploaded = true;
+			}
+			else
+			{
+				LOG_WARN("Couldn't reload mesh " << loaded.name << ", keeping the one in use");
+			}
+			continue;
+		}
+		if (!loaded.loaded)
+		{
+			LOG_ERROR("Failed to stream mesh " << loaded.name << ", keeping its placeholder");
+			continue;
+		}
+
+		// the map entry was created with the request and never moves, so render objects already hold this pointer;
+		// the other parts get entries of their own, which objects only point at once the first part is swapped in
+		Mesh* first = nullptr;
+		for (size_t part = 0; part < loaded.parts.size(); part++)
+		{
+			const std::string name = part == 0 ? loaded.name : loaded.name + "#" + std::to_string(part);
+			if (part == 0 && loaded.name == _objScenePath && !_pvs.empty() && _pvs.object_count() != loaded.parts.size())
+			{
+				LOG_WARN(_objScenePath << PVS_EXTENSION << " was baked for " << _pvs.object_count() << " parts, not "
+					<< loaded.parts.size() << "; not using it");
+				_pvs.clear();
+			}
+			Mesh& mesh = _meshes[name];
+			mesh = std::move(loaded.parts[part]);
+			if (!mesh._material.name.empty())
+			{
+				_importedMaterials[&mesh] = create_imported_material(loaded.name, mesh._material);
+			}
+			if (part == 0)
+			{
+				first = &mesh;
+			}
+			else
+			{
+				_meshParts[first].push_back(&mesh);
+			}
+			// the atlas comes later, from the copy: the mesh's own geometry may be released once it's resident
+			if (_useImpostors && !mesh._skinned)
+			{
+				Mesh geometry;
+				geometry._vertices = mesh._vertices;
+				geometry._indices = mesh._indices;
+				geometry._packedIndices = mesh._packedIndices;
+				geometry._lods = mesh._lods;
+				geometry._bounds = mesh._bounds;
+				geometry._material.baseColor = mesh._material.baseColor;
+				_streamer.request_impostor(name, ImpostorAtlas::cache_path(loaded.path, static_cast<uint32_t>(part)), loaded.path, std::move(geometry));
+			}
+
+			// every part goes out with the same batch, so they all turn resident in the same frame
+			StreamingUpload upload = { &mesh, 0 };
+			upload_mesh(mesh, &upload);
+			_streamingUploads.push_back(upload);
+		}
+		uploaded = true;
+	}
+
+	// layers are copied in by the frame's Impostors::begin_frame, ahead of anything drawing them
+	for (AssetStreamer::LoadedImpostor& loaded : _streamer.take_loaded_impostors())
+	{
+		_metrics.record_asset_load(AssetKind::Impostor, loaded.loadMs);
+		auto found = _meshes.find(loaded.name);
+		if (!loaded.loaded || found == _meshes.end())
+		{
+			LOG_WARN("no impostor for " << loaded.name << ", it stays a mesh at every distance");
+			continue;
+		}
+		found->second._impostor = _impostors.add(loaded.atlas);
+		if (found->second._impostor == UINT32_MAX)
+		{
+			LOG_WARN("all " << _impostorLayers << " impostor layers are taken, " << loaded.name << " stays a mesh");
+		}
+	}
+
+	for (AssetStreamer::LoadedTexture& loaded : _streamer.take_loaded_textures())
+	{
+		_pendingTextures.push_back(std::move(loaded));
+	}
+	while (!_pendingTextures.empty() && _uploadManager.admit(_pendingTextures.front().texture._pixels.size(), UploadPriority::Visible))
+	{
+		AssetStreamer::LoadedTexture loaded = std::move(_pendingTextures.front());
+		_pendingTextures.pop_front();
+		_metrics.record_asset_load(AssetKind::Texture, loaded.loadMs);
+		if (_reloadingTextures.erase(loaded.name) > 0)
+		{
+			if (loaded.loaded && reload_texture(loaded))
+			{
+				uploaded = true;
+			}
+			else
+			{
+				LOG_WARN("Couldn't reload texture " << loaded.name << ", keeping the one in use");
+			}
+			continue;
+		}
+		if (!loaded.loaded)
+		{
+			LOG_ERROR("Failed to stream texture " << loaded.name);
+			continue;
+		}
+
+		Texture& texture = _textures[loaded.name];
+		texture = std::move(loaded.texture);
+		if (create_virtual_texture(loaded.name, texture))
+		{
+			continue;
+		}
+		if (!upload_texture(texture))
+		{
+			LOG_WARN("Texture " << loaded.name << " doesn't fit the memory budget, leaving it unloaded");
+			texture._pixels.clear();
+			texture._pixels.shrink_to_fit();
+			continue;
+		}
+		_streamingTextures.push_back({ &texture, 0 });
+		uploaded = true;
+	}
+
+	if (update_texture_residency())
+	{
+		uploaded = true;
+	}
+	update_residency_priorities();
+
+	// the feedback of this frame slot's last frame decides which pages come next
+	for (auto& entry : _virtualTextures)
+	{
+		entry.second.read_feedback(_frameNumber % _frameOverlap);
+		if (entry.second.request_pages(_uploadManager))
+		{
+			uploaded = true;
+		}
+	}
+	// the tiles the last frame's selection found missing
+	if (_useTerrain && _terrain.request_tiles(_uploadManager, static_cast<uint64_t>(_frameNumber), _frameOverlap))
+	{
+		uploaded = true;
+	}
+
+	if (uploaded)
+	{
+		// every asset that arrived this frame shares one transfer submission
+		uint64_t value = _uploadManager.flush();
+		for (StreamingUpload& upload : _streamingUploads)
+		{
+			if (upload.uploadValue == 0)
+			{
+				upload.uploadValue = value;
+			}
+		}
+		for (StreamingTexture& upload : _streamingTextures)
+		{
+			if (upload.uploadValue == 0)
+			{
+				upload.uploadValue = value;
+			}
+		}
+		for (TextureLevelChange& change : _textureLevelChanges)
+		{
+			if (change.uploadValue == 0)
+			{
+				change.uploadValue = value;
+			}
+		}
+		for (MeshReload& reload : _meshReloads)
+		{
+			if (reload.upload.uploadValue == 0)
+			{
+				reload.upload.uploadValue = value;
+			}
+		}
+		for (TextureReload& reload : _textureReloads)
+		{
+			if (reload.uploadValue == 0)
+			{
+				reload.uploadValue = value;
+			}
+		}
+		for (auto& entry : _virtualTextures)
+		{
+			entry.second.set_upload_value(value);
+		}
+		if (_useTerrain)
+		{
+			_terrain.set_upload_value(value);
+		}
+	}
+
+	// decoded assets the ring can't take yet would only pile up in memory; the loader waits for it to drain
+	_streamer.set_throttled(_uploadManager.backlogged() || !_pendingMeshes.empty() || !_pendingTextures.empty());
+}
+
+void VulkanEngine::publish_streamed_assets(VkCommandBuffer cmd)
+{
+	CPU_PROFILE_SCOPE("publish_streamed_assets");
+	// acquired textures: fill in the rest of the chain (if the upload didn't bring it) before anything samples them
+	for (size_t i = 0; i < _streamingTextures.size();)
+	{
+		if (_streamingTextures[i].uploadValue > _uploadManager.acquired_value())
+		{
+			i++;
+			continue;
+		}
+		if (_streamingTextures[i].texture->needs_mip_generation())
+		{
+			_streamingTextures[i].texture->generate_mipmaps(cmd);
+		}
+		_streamingTextures[i].texture->_resident = true;
+		register_bindless_texture(*_streamingTextures[i].texture);
+		update_texture_materials(*_streamingTextures[i].texture);
+		_streamingTextures[i] = _streamingTextures.back();
+		_streamingTextures.pop_back();
+	}
+
+	// streamed levels: swap the new image in; frames still in flight keep sampling the old one through its slot
+	for (size_t i = 0; i < _textureLevelChanges.size();)
+	{
+		TextureLevelChange& change = _textureLevelChanges[i];
+		if (change.uploadValue > _uploadManager.acquired_value())
+		{
+			i++;
+			continue;
+		}
+
+		Texture& texture = *change.texture;
+		DeletionQueue& retired = get_current_frame()._deletionQueue;
+		retired.push_image_view(texture._imageView);
+		retired.push_image(texture._image);
+		const uint32_t previousSlot = texture._bindlessIndex;
+		if (previousSlot != INVALID_BINDLESS_INDEX)
+		{
+			retired.push_function([this, previousSlot]() {
+				_freeBindlessSlots.push_back(previousSlot);
+			});
+		}
+
+		texture._image = change.image;
+		texture._imageView = change.imageView;
+		texture._firstResidentLevel = change.firstLevel;
+		texture._mipLevels = static_cast<uint32_t>(texture._levels.size()) - change.firstLevel;
+		if (previousSlot != INVALID_BINDLESS_INDEX)
+		{
+			register_bindless_texture(texture);
+			update_texture_materials(texture);
+		}
+		const TextureLevel& first = texture._levels[change.firstLevel];
+		LOG_INFO("Texture streamed to " << first.width << "x" << first.height << " (level " << change.firstLevel << ")");
+
+		_textureLevelChanges[i] = _textureLevelChanges.back();
+		_textureLevelChanges.pop_back();
+	}
+
+	// acquired pages go into the atlases, and the page tables follow, before this frame's draws
+	for (auto& entry : _virtualTextures)
+	{
+		entry.second.record(cmd, _frameNumber % _frameOverlap, _uploadManager.acquired_value(), get_current_frame()._deletionQueue);
+	}
+
+	// resident once the frame being recorded has acquired the mesh's upload
+	bool published = false;
+	bool unpacked = false;
+	for (size_t i = 0; i < _streamingUploads.size();)
+	{
+		if (_streamingUploads[i].uploadValue > _uploadManager.acquired_value())
+		{
+			i++;
+			continue;
+		}
+		StreamingUpload& upload = _streamingUploads[i];
+		if (upload.packedIndices._buffer != VK_NULL_HANDLE)
+		{
+			// packed meshes are 32-bit, so the pool offset in indices is the word offset the shader writes at
+			_blockUnpacker.unpack(cmd, upload.packedIndices._buffer, upload.packedBlocks,
+				_meshPool.index_buffer(VK_INDEX_TYPE_UINT32)._buffer, upload.mesh->_poolAllocation.firstIndex);
+			get_current_frame()._deletionQueue.push_buffer(upload.packedIndices);
+			unpacked = true;
+		}
+		make_resident(*_streamingUploads[i].mesh);
+		_streamingUploads[i] = _streamingUploads.back();
+		_streamingUploads.pop_back();
+		published = true;
+	}
+
+	if (!_meshReloads.empty() || !_textureReloads.empty())
+	{
+		publish_asset_reloads(cmd, unpacked);
+	}
+
+	if (unpacked)
+	{
+		// before this frame's draws, and the compaction copies that may move the new meshes right away
+		VkMemoryBarrier toDraw = {};
+		toDraw.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		toDraw.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		toDraw.dstAccessMask = VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 1, &toDraw, 0, nullptr, 0, nullptr);
+	}
+
+	if (!published)
+	{
+		return;
+	}
+
+	// swap the real meshes in; the material follows the mesh's vertex format. Each of the mesh's other
+	// parts becomes an object of its own next to it, added once the walk over the entities is done
+	std::vector<RenderObject> partObjects;
+	_entities.each<RenderObject>([this, &partObjects](RenderObject& object) {
+		if (object.streamingMesh != nullptr && object.streamingMesh->_resident)
+		{
+			object.mesh = object.streamingMesh;
+			object.material = material_for(*object.mesh, imported_material_for(*object.mesh, object.material));
+			object.streamingMesh = nullptr;
+			if (object.isStatic)
+			{
+				// the cached shadows still show the placeholder
+				_shadows.invalidate_static();
+			}
+
+			// the level's parts are numbered for its PVS the way load_parts gave them
+			const bool level = !_pvs.empty() && object.mesh == get_mesh(_objScenePath);
+			if (level)
+			{
+				object.pvsObject = 0;
+			}
+			auto parts = _meshParts.find(object.mesh);
+			if (parts != _meshParts.end())
+			{
+				for (size_t i = 0; i < parts->second.size(); i++)
+				{
+					Mesh* part = parts->second[i];
+					RenderObject partObject;
+					partObject.mesh = part;
+					partObject.material = material_for(*part, imported_material_for(*part, nullptr));
+					partObject.transformIndex = object.transformIndex;
+					partObject.isStatic = object.isStatic;
+					partObject.pvsObject = level ? static_cast<uint32_t>(i + 1) : UINT32_MAX;
+					partObjects.push_back(partObject);
+				}
+			}
+		}
+	});
+	for (const RenderObject& partObject : partObjects)
+	{
+		add_renderable(partObject);
+	}
+	sort_renderables();
+}
+
+void VulkanEngine::update_asset_reload()
+{
+	// requested again only while what the source loaded is resident and no reload of it is on its way, so a
+	// replacement always has something to replace and two never race for the same entry
+	auto ready = [this](const AssetWatcher::Source& source) {
+		if (source.texture)
+		{
+			auto found = _textures.find(source.name);
+			return found != _textures.end() && found->second._resident && _reloadingTextures.count(source.name) == 0
+				&& std::none_of(_textureReloads.begin(), _textureReloads.end(), [&](const TextureReload& reload) {
+					return reload.target == &found->second;
+				});
+		}
+		const Mesh* mesh = get_mesh(source.name);
+		return mesh != nullptr && mesh->_resident && !mesh->_skinned && _reloadingMeshes.count(source.name) == 0
+			&& std::none_of(_meshReloads.begin(), _meshReloads.end(), [&](const MeshReload& reload) {
+				return reload.name == source.name;
+			});
+	};
+
+	// the loader imports them as it did the first time, through caches that are stale now
+	for (const AssetWatcher::Source& source : _assetWatcher.poll(ready))
+	{
+		LOG_INFO(source.path << " changed, reloading " << source.name);
+		request_redraw();
+		if (source.texture)
+		{
+			_reloadingTextures.insert(source.name);
+			_streamer.request_texture(source.name, source.path, source.compress);
+		}
+		else
+		{
+			_reloadingMeshes.insert(source.name);
+			_streamer.request_mesh(source.name, source.path, source.format);
+		}
+	}
+}
+
+bool VulkanEngine::reload_mesh(AssetStreamer::LoadedMesh& loaded)
+{
+	// the parts go into the entries the first load made; another number of them would mean adding or
+	// removing objects, which is left to a restart
+	Mesh* first = get_mesh(loaded.name);
+	auto parts = first != nullptr ? _meshParts.find(first) : _meshParts.end();
+	const size_t partCount = parts != _meshParts.end() ? parts->second.size() + 1 : 1;
+	if (first == nullptr || loaded.parts.size() != partCount)
+	{
+		LOG_WARN(loaded.name << " has " << loaded.parts.size() << " parts now instead of " << partCount << ", it needs a restart");
+		return false;
+	}
+
+	for (size_t part = 0; part < loaded.parts.size(); part++)
+	{
+		MeshReload reload;
+		reload.target = part == 0 ? first : parts->second[part - 1];
+		reload.name = loaded.name;
+		reload.replacement = std::make_unique<Mesh>(std::move(loaded.parts[part]));
+		reload.upload = { reload.replacement.get(), 0 };
+		upload_mesh(*reload.replacement, &reload.upload);
+		if (reload.replacement->_poolAllocation.vertexCount == 0)
+		{
+			LOG_WARN("no room in the mesh pool for the new " << loaded.name << ", part " << part << " stays as it was");
+			continue;
+		}
+		_meshReloads.push_back(std::move(reload));
+	}
+	return true;
+}
+
+bool VulkanEngine::reload_texture(AssetStreamer::LoadedTexture& loaded)
+{
+	auto found = _textures.find(loaded.name);
+	if (found == _textures.end())
+	{
+		return false;
+	}
+	TextureReload reload = { &found->second, std::make_unique<Texture>(std::move(loaded.texture)), 0 };
+	if (!upload_texture(*reload.replacement, true))
+	{
+		LOG_WARN("the new " << loaded.name << " doesn't fit the memory budget");
+		return false;
+	}
+	_textureReloads.push_back(std::move(reload));
+	return true;
+}
+
+void VulkanEngine::publish_asset_reloads(VkCommandBuffer cmd, bool& unpacked)
+{
+	// what a replacement takes the place of is drawn by the frames still in flight; it goes with this one
+	DeletionQueue& retired = get_current_frame()._deletionQueue;
+
+	for (size_t i = 0; i < _textureReloads.size();)
+	{
+		TextureReload& reload = _textureReloads[i];
+		Texture& texture = *reload.target;
+		// a level change made from the old chain swaps its image in first, so it can't land on the new one
+		const bool changing = std::any_of(_textureLevelChanges.begin(), _textureLevelChanges.end(), [&](const TextureLevelChange& change) {
+			return change.texture == &texture;
+		});
+		if (reload.uploadValue > _uploadManager.acquired_value() || changing)
+		{
+			i++;
+			continue;
+		}
+
+		retired.push_image_view(texture._imageView);
+		retired.push_image(texture._image);
+		const uint32_t previousSlot = texture._bindlessIndex;
+		if (previousSlot != INVALID_BINDLESS_INDEX)
+		{
+			retired.push_function([this, previousSlot]() {
+				_freeBindlessSlots.push_back(previousSlot);
+			});
+		}
+
+		texture = std::move(*reload.replacement);
+		if (texture.needs_mip_generation())
+		{
+			texture.generate_mipmaps(cmd);
+		}
+		texture._resident = true;
+		register_bindless_texture(texture);
+		update_texture_materials(texture);
+		LOG_INFO("Texture reloaded at " << texture._width << "x" << texture._height);
+
+		std::swap(_textureReloads[i], _textureReloads.back());
+		_textureReloads.pop_back();
+	}
+
+	bool swapped = false;
+	for (size_t i = 0; i < _meshReloads.size();)
+	{
+		MeshReload& reload = _meshReloads[i];
+		if (reload.upload.uploadValue > _uploadManager.acquired_value())
+		{
+			i++;
+			continue;
+		}
+		if (reload.upload.packedIndices._buffer != VK_NULL_HANDLE)
+		{
+			_blockUnpacker.unpack(cmd, reload.upload.packedIndices._buffer, reload.upload.packedBlocks,
+				_meshPool.index_buffer(VK_INDEX_TYPE_UINT32)._buffer, reload.replacement->_poolAllocation.firstIndex);
+			retired.push_buffer(reload.upload.packedIndices);
+			unpacked = true;
+		}
+
+		Mesh& mesh = *reload.target;
+		const MeshAllocation previousRange = mesh._poolAllocation;
+		const MeshletAllocation previousMeshlets = mesh._meshletAllocation;
+		retired.push_function([=]() {
+			_meshPool.free(previousRange);
+			if (previousMeshlets.meshletCount > 0)
+			{
+				_meshletPool.free(previousMeshlets);
+			}
+		});
+
+		// the impostor stays the old bake until the next run; the acceleration structure is built again with
+		// the object's next update, from the new ranges
+		const uint32_t impostor = mesh._impostor;
+		auto imported = _importedMaterials.find(&mesh);
+		Material* previousMaterial = imported != _importedMaterials.end() ? imported->second : nullptr;
+		_occluderMeshes.erase(&mesh);
+		mesh = std::move(*reload.replacement);
+		mesh._impostor = impostor;
+
+		Material* material = mesh._material.name.empty() ? nullptr : create_imported_material(reload.name, mesh._material);
+		if (material != nullptr && material != previousMaterial)
+		{
+			_importedMaterials[&mesh] = material;
+			if (previousMaterial != nullptr)
+			{
+				// only this mesh's objects: the other parts may still use the old look
+				_entities.each<RenderObject>([&](RenderObject& object) {
+					if (object.mesh == &mesh && object.material == material_for(mesh, previousMaterial))
+					{
+						object.material = material_for(mesh, material);
+					}
+				});
+			}
+		}
+		make_resident(mesh);
+		swapped = true;
+
+		std::swap(_meshReloads[i], _meshReloads.back());
+		_meshReloads.pop_back();
+	}
+
+	if (swapped)
+	{
+		// new bounds, ranges and maybe materials; the cached shadows still show the old geometry
+		_shadows.invalidate_static();
+		sort_renderables();
+	}
+}
+
+bool VulkanEngine::streaming_busy()
+{
+	return _streamer.busy() || !_pendingMeshes.empty() || !_pendingTextures.empty() || !_streamingUploads.empty() || !_streamingTextures.empty()
+		|| !_meshReloads.empty() || !_textureReloads.empty() || (_useTerrain && _terrain.streaming());
+}
+
+void VulkanEngine::init_scene()
+{
+	CPU_PROFILE_SCOPE("init_scene");
+	heap_stats::Scope heapScope(HeapTag::Scene);
+	if (!load_scene_snapshot())
+	{
+		build_level();
+		save_scene_snapshot();
+	}
+
+	// drawn at the identity, where the set was baked
+	const AssetArchive* archive = _assetArchive.is_open() ? &_assetArchive : nullptr;
+	if (!_objScenePath.empty() && _usePvs && _pvs.load((_objScenePath + PVS_EXTENSION).c_str(), _objScenePath.c_str(), archive))
+	{
+		LOG_INFO("Loaded " << _objScenePath << PVS_EXTENSION << ": " << _pvs.cell_count() << " cells over "
+			<< _pvs.object_count() << " parts");
+	}
+
+	// a chunk an object, at the chunk's origin; static, and so left out of static batching by their format
+	if (_voxelWorld.chunk_count() > 0)
+	{
+		create_material("voxel", "mesh");
+		for (uint32_t i = 0; i < _voxelWorld.chunk_count(); i++)
+		{
+			update_voxel_chunk_entity(i);
+		}
+	}
+
+	// the characters in a row behind the monkey
+	for (uint32_t i = 0; i < _characters.size(); i++)
+	{
+		RenderObject character;
+		character.mesh = _characters[i].mesh;
+		character.material = material_for(*character.mesh);
+		const float x = (i - (_characters.size() - 1) * 0.5f) * 1.2f;
+		character.transformIndex = _transforms.add(glm::vec3(x, -1.f, -3.f), glm::quat(1.f, 0.f, 0.f, 0.f), glm::vec3(1.f));
+		add_renderable(character);
+	}
+
+	// glass monkeys in rows going back from the monkey, a hue and an opacity each; the transparent pass
+	// draws them, so they stay out of the render list
+	if (_transparentCount > 0)
+	{
+		const uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(_transparentCount))));
+		for (uint32_t i = 0; i < _transparentCount; i++)
+		{
+			const glm::vec3 position((i % side - (side - 1) * 0.5f) * 1.2f, 0.f, -1.2f * (1 + i / side));
+			const float hue = glm::fract(i * 0.618034f);
+			TransparentObject object;
+			object.mesh = get_mesh("monkey");
+			object.transform = glm::translate(position) * glm::scale(glm::vec3(0.4f));
+			object.color = glm::vec4(0.5f + 0.5f * glm::cos(6.2831853f * (hue + glm::vec3(0.f, 0.33f, 0.67f))), 0.25f + 0.05f * (i % 7));
+			_transparentObjects.push_back(object);
+		}
+	}
+
+	_mainDeletionQueue.push_function([=]() {
+		_entities.cleanup();
+	});
+
+	if (_staticBatching)
+	{
+		batch_static_objects();
+	}
+	sort_renderables();
+}
+
+void VulkanEngine::build_level()
+{
+	CPU_PROFILE_SCOPE("build_level");
+	// the monkey streams in; until then the placeholder cube takes its place
+	RenderObject monkey;
+	monkey.mesh = get_mesh("placeholder");
+	monkey.streamingMesh = get_mesh("monkey");
+	monkey.material = material_for(*monkey.mesh);
+	monkey.transformIndex = _transforms.add(glm::vec3(0.f), glm::quat(1.f, 0.f, 0.f, 0.f), glm::vec3(0.4f));
+
+	add_renderable(monkey);
+
+	if (!_objScenePath.empty())
+	{
+		// static, so the shadows of a whole level are cached rather than drawn every frame
+		RenderObject scene;
+		scene.mesh = get_mesh("placeholder");
+		scene.streamingMesh = get_mesh(_objScenePath);
+		scene.material = material_for(*scene.mesh);
+		scene.transformIndex = _transforms.add(glm::vec3(0.f), glm::quat(1.f, 0.f, 0.f, 0.f), glm::vec3(1.f));
+		scene.isStatic = true;
+		add_renderable(scene);
+	}
+
+	if (!_gltfDocument.nodes().empty())
+	{
+		add_gltf_scene();
+	}
+
+	// a floor of small triangles under the monkey, placed relative to one floor node
+	const uint32_t floor = _transforms.add(glm::vec3(0.f, -1.0f, 0.f), glm::quat(1.f, 0.f, 0.f, 0.f), glm::vec3(1.f));
+	for (int x = -20; x <= 20; x++)
+	{
+		for (int z = -20; z <= 20; z++)
+		{
+			RenderObject tri;
+			tri.mesh = get_mesh("triangle");
+			tri.material = material_for(*tri.mesh, get_material("floor"));
+			tri.transformIndex = _transforms.add(glm::vec3(x, 0.f, z), glm::quat(1.f, 0.f, 0.f, 0.f), glm::vec3(0.2f), floor);
+			tri.isStatic = true;
+
+			add_renderable(tri);
+		}
+	}
+}
+
+std::vector<std::string> VulkanEngine::level_sources() const
+{
+	std::vector<std::string> sources;
+	for (const std::string* path : { &_objScenePath, &_gltfPath })
+	{
+		if (!path->empty())
+		{
+			sources.push_back(*path);
+		}
+	}
+	return sources;
+}
+
+bool VulkanEngine::load_scene_snapshot()
+{
+	if (_sceneSnapshotPath.empty())
+	{
+		return false;
+	}
+	CPU_PROFILE_SCOPE("load_scene_snapshot");
+	const auto start = std::chrono::high_resolution_clock::now();
+	SceneSnapshot snapshot;
+	if (!snapshot.open(_sceneSnapshotPath.c_str(), level_sources()))
+	{
+		return false;
+	}
+
+	// a lookup per name the objects use, not per object
+	std::vector<Mesh*> meshes(snapshot.name_count(), nullptr);
+	std::vector<uint8_t> resolved(snapshot.name_count(), 0);
+	auto mesh_named = [&](uint32_t name) -> Mesh* {
+		if (name >= snapshot.name_count())
+		{
+			return nullptr;
+		}
+		if (!resolved[name])
+		{
+			meshes[name] = get_mesh(snapshot.name(name));
+			resolved[name] = 1;
+		}
+		return meshes[name];
+	};
+	std::vector<Material*> materials(snapshot.material_count(), nullptr);
+	for (uint32_t i = 0; i < snapshot.material_count(); i++)
+	{
+		const SnapshotMaterial& source = snapshot.materials()[i];
+		const char* name = snapshot.name(source.name);
+		if (name == nullptr)
+		{
+			continue;
+		}
+		materials[i] = get_material(name);
+		const char* templateName = snapshot.name(source.templateName);
+		if (materials[i] == nullptr && templateName != nullptr)
+		{
+			materials[i] = create_material(name, templateName,
+				glm::vec4(source.baseColor[0], source.baseColor[1], source.baseColor[2], source.baseColor[3]));
+		}
+	}
+
+	snapshot.restore(_transforms);
+	uint32_t missing = 0;
+	for (uint32_t i = 0; i < snapshot.object_count(); i++)
+	{
+		const SnapshotObject& source = snapshot.objects()[i];
+		RenderObject object;
+		object.mesh = mesh_named(source.mesh);
+		if (object.mesh == nullptr || source.transform >= snapshot.node_count())
+		{
+			missing++;
+			continue;
+		}
+		object.streamingMesh = source.streamingMesh == SceneSnapshot::NO_NAME ? nullptr : mesh_named(source.streamingMesh);
+		object.material = material_for(*object.mesh, source.material < materials.size() ? materials[source.material] : nullptr);
+		object.transformIndex = source.transform;
+		object.isStatic = (source.flags & SNAPSHOT_STATIC) != 0;
+		object.pvsObject = source.pvsObject;
+		add_renderable(object);
+	}
+	// its nodes and materials came from the snapshot; the meshes were all it was needed for
+	_gltfDocument.close();
+
+	const float ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	LOG_INFO("Restored the scene from " << _sceneSnapshotPath << " in " << ms << " ms: " << snapshot.object_count() - missing
+		<< " objects, " << snapshot.node_count() << " nodes, " << snapshot.material_count() << " materials");
+	if (missing > 0)
+	{
+		LOG_WARN(missing << " objects of " << _sceneSnapshotPath << " refer to meshes that weren't loaded, leaving them out");
+	}
+	return true;
+}
+
+void VulkanEngine::save_scene_snapshot()
+{
+	if (_sceneSnapshotPath.empty())
+	{
+		return;
+	}
+	CPU_PROFILE_SCOPE("save_scene_snapshot");
+	std::unordered_map<const Mesh*, const std::string*> meshNames;
+	for (const auto& entry : _meshes)
+	{
+		meshNames[&entry.second] = &entry.first;
+	}
+	std::unordered_map<const Material*, const std::string*> materialNames;
+	for (const auto& entry : _materials)
+	{
+		materialNames[&entry.second] = &entry.first;
+	}
+
+	SceneSnapshot::Contents contents;
+	std::unordered_map<std::string, uint32_t> nameIndices;
+	auto intern = [&](const std::string& name) {
+		auto found = nameIndices.emplace(name, static_cast<uint32_t>(contents.names.size()));
+		if (found.second)
+		{
+			contents.names.push_back(name);
+		}
+		return found.first->second;
+	};
+	std::unordered_map<const Material*, uint32_t> materialIndices;
+	bool complete = true;
+	_entities.each<RenderObject>([&](const RenderObject& object) {
+		auto mesh = meshNames.find(object.mesh);
+		// templated materials are kept by their base; the restored object picks its variant again
+		const Material* base = object.material->variants[0] != nullptr ? object.material->variants[0] : object.material;
+		auto material = materialNames.find(base);
+		if (mesh == meshNames.end() || material == materialNames.end())
+		{
+			complete = false;
+			return;
+		}
+		auto found = materialIndices.emplace(base, static_cast<uint32_t>(contents.materials.size()));
+		if (found.second)
+		{
+			SnapshotMaterial record = {};
+			record.name = intern(*material->second);
+			record.templateName = base->templateName.empty() ? SceneSnapshot::NO_NAME : intern(base->templateName);
+			for (int c = 0; c < 4; c++)
+			{
+				record.baseColor[c] = base->baseColor[c];
+			}
+			contents.materials.push_back(record);
+		}
+
+		SnapshotObject record = {};
+		record.mesh = intern(*mesh->second);
+		auto streaming = object.streamingMesh != nullptr ? meshNames.find(object.streamingMesh) : meshNames.end();
+		record.streamingMesh = streaming != meshNames.end() ? intern(*streaming->second) : SceneSnapshot::NO_NAME;
+		record.material = found.first->second;
+		record.transform = object.transformIndex;
+		record.pvsObject = object.pvsObject;
+		record.flags = object.isStatic ? SNAPSHOT_STATIC : 0;
+		contents.objects.push_back(record);
+	});
+
+	if (!complete || !SceneSnapshot::save(_sceneSnapshotPath.c_str(), level_sources(), contents, _transforms))
+	{
+		LOG_WARN("Could not write the scene snapshot " << _sceneSnapshotPath);
+		return;
+	}
+	LOG_INFO("Wrote the scene snapshot " << _sceneSnapshotPath << ": " << contents.objects.size() << " objects, "
+		<< _transforms.size() << " nodes");
+}
+
+void VulkanEngine::batch_static_objects()
+{
+	CPU_PROFILE_SCOPE("batch_static_objects");
+	_transforms.update();
+
+	// streamed objects still draw their placeholder, so only what is resident now takes part
+	std::vector<StaticBatchSource> sources;
+	std::vector<Entity> entities;
+	std::vector<Material*> materials;
+	_entities.each<RenderObject>([&](const RenderObject& object) {
+		if (!object.isStatic || object.streamingMesh != nullptr)
+		{
+			return;
+		}
+		auto material = std::find(materials.begin(), materials.end(), object.material);
+		if (material == materials.end())
+		{
+			material = materials.insert(materials.end(), object.material);
+		}
+		sources.push_back({ object.mesh, _transforms.world(object.transformIndex), static_cast<uint32_t>(material - materials.begin()) });
+		entities.push_back(object.entity);
+	});
+
+	std::vector<StaticBatch> batches = build_static_batches(sources, _staticBatchSettings);
+	std::vector<Mesh*> uploaded;
+	for (size_t i = 0; i < batches.size(); i++)
+	{
+		Mesh& mesh = _meshes["static_batch_" + std::to_string(i)];
+		mesh = std::move(batches[i].mesh);
+		upload_mesh(mesh);
+		uploaded.push_back(&mesh);
+	}
+	_uploadManager.wait(_uploadManager.flush());
+
+	// the batches are already in world space
+	const uint32_t root = _transforms.add(glm::vec3(0.f), glm::quat(1.f, 0.f, 0.f, 0.f), glm::vec3(1.f));
+	size_t replaced = 0;
+	for (size_t i = 0; i < batches.size(); i++)
+	{
+		make_resident(*uploaded[i]);
+		RenderObject object;
+		object.mesh = uploaded[i];
+		object.material = materials[batches[i].key];
+		object.transformIndex = root;
+		object.isStatic = true;
+		add_renderable(object);
+		for (uint32_t source : batches[i].sources)
+		{
+			_entities.destroy(entities[source]);
+		}
+		replaced += batches[i].sources.size();
+	}
+
+	for (Mesh* mesh : _deferredMeshReleases)
+	{
+		make_resident(*mesh);
+	}
+	_deferredMeshReleases.clear();
+
+	if (!batches.empty())
+	{
+		LOG_INFO("Static batching: " << replaced << " of " << sources.size() << " static objects merged into "
+			<< batches.size() << " batches");
+	}
+}
+
+void VulkanEngine::update_voxel_world()
+{
+	if (!_voxelWorld.has_dirty())
+	{
+		return;
+	}
+	CPU_PROFILE_SCOPE("update_voxel_world");
+	const std::vector<uint32_t> remeshed = _voxelWorld.remesh_dirty();
+
+	std::vector<Mesh*> uploaded;
+	for (uint32_t chunk : remeshed)
+	{
+		Mesh& mesh = _meshes["voxel_chunk_" + std::to_string(chunk)];
+		if (mesh._poolAllocation.vertexCount > 0)
+		{
+			// frames still in flight draw the old mesh; its ranges are free once this frame has finished too
+			const MeshAllocation retired = mesh._poolAllocation;
+			get_current_frame()._deletionQueue.push_function([=]() {
+				_meshPool.free(retired);
+			});
+		}
+		mesh = std::move(_voxelWorld.chunk(chunk).mesh);
+		if (mesh.index_count() > 0)
+		{
+			upload_mesh(mesh);
+			uploaded.push_back(&mesh);
+		}
+	}
+	// an edit is a few chunks of a few thousand quads at most, so this frame waits for them
+	_uploadManager.wait(_uploadManager.flush());
+	for (Mesh* mesh : uploaded)
+	{
+		make_resident(*mesh);
+	}
+
+	for (uint32_t chunk : remeshed)
+	{
+		update_voxel_chunk_entity(chunk);
+	}
+	// the chunks cast with the static casters
+	_shadows.invalidate_static();
+	sort_renderables();
+}
+
+void VulkanEngine::update_voxel_chunk_entity(uint32_t chunk)
+{
+	if (_voxelChunkEntities.size() < _voxelWorld.chunk_count())
+	{
+		_voxelChunkEntities.resize(_voxelWorld.chunk_count());
+		_voxelChunkTransforms.resize(_voxelWorld.chunk_count(), UINT32_MAX);
+	}
+
+	Mesh* mesh = get_mesh("voxel_chunk_" + std::to_string(chunk));
+	const bool drawn = mesh != nullptr && mesh->_resident && mesh->index_count() > 0;
+	Entity& entity = _voxelChunkEntities[chunk];
+	const bool shown = _entities.alive(entity);
+	if (drawn && !shown)
+	{
+		if (_voxelChunkTransforms[chunk] == UINT32_MAX)
+		{
+			_voxelChunkTransforms[chunk] = _transforms.add(glm::vec3(_voxelWorld.chunk(chunk).origin()), glm::quat(1.f, 0.f, 0.f, 0.f), glm::vec3(1.f));
+		}
+		RenderObject object;
+		object.mesh = mesh;
+		object.material = material_for(*mesh, get_material("voxel"));
+		object.transformIndex = _voxelChunkTransforms[chunk];
+		object.isStatic = true;
+		entity = add_renderable(object);
+	}
+	else if (!drawn && shown)
+	{
+		// the tree forgets it here; its _gpuScene slot is left to no one, as slots are never given back
+		const RenderObject* object = _entities.get<RenderObject>(entity);
+		if (object->bvhProxy != Bvh::NULL_NODE)
+		{
+			_renderBvh.remove(object->bvhProxy);
+		}
+		_entities.destroy(entity);
+		entity = Entity();
+	}
+}
+
+void VulkanEngine::add_gltf_scene()
+{
+	std::vector<Material*> materials;
+	for (size_t i = 0; i < _gltfDocument.materials().size(); i++)
+	{
+		materials.push_back(create_material("gltf_material_" + std::to_string(i), "mesh", _gltfDocument.materials()[i].baseColor));
+	}
+
+	// the document's units and axes are the engine's, so its scene sits at the origin as it was authored.
+	// Nothing in it moves, so its shadows are cached
+	const uint32_t root = _transforms.add(glm::vec3(0.f), glm::quat(1.f, 0.f, 0.f, 0.f), glm::vec3(1.f));
+	const std::vector<GltfNode>& nodes = _gltfDocument.nodes();
+	std::vector<uint32_t> transforms(nodes.size());
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		const GltfNode& node = nodes[i];
+		transforms[i] = _transforms.add(node.translation, node.rotation, node.scale, node.parent < 0 ? root : transforms[node.parent]);
+		if (node.mesh < 0)
+		{
+			continue;
+		}
+		const std::vector<GltfPrimitive>& primitives = _gltfDocument.meshes()[node.mesh].primitives;
+		for (size_t p = 0; p < primitives.size(); p++)
+		{
+			// primitives that failed to convert have no mesh
+			Mesh* mesh = get_mesh(gltf_mesh_name(node.mesh, p));
+			if (mesh == nullptr)
+			{
+				continue;
+			}
+			RenderObject object;
+			object.mesh = mesh;
+			object.material = material_for(*mesh, primitives[p].material >= 0 ? materials[primitives[p].material] : nullptr);
+			object.transformIndex = transforms[i];
+			object.isStatic = true;
+			add_renderable(object);
+		}
+	}
+	LOG_INFO(_gltfPath << ": " << nodes.size() << " nodes, " << materials.size() << " materials");
+	_gltfDocument.close();
+}
+
+Entity VulkanEngine::add_renderable(const RenderObject& object)
+{
+	const Entity entity = _entities.create(object, WorldBounds{});
+	_entities.get<RenderObject>(entity)->entity = entity;
+	return entity;
+}
+
+void VulkanEngine::sort_renderables()
+{
+	_renderables.clear();
+	_entities.each<RenderObject>([this](const RenderObject& object) {
+		_renderables.push_back(object);
+	});
+	std::sort(_renderables.begin(), _renderables.end(), draws_before);
+	refit_render_bounds();
+	if (_useSoftwareOcclusion)
+	{
+		rebuild_occluders();
+	}
+	// the static set, or its meshes and materials, may have changed
+	_staticDrawGeneration++;
+}
+
+void VulkanEngine::refit_render_bounds()
+{
+	_transforms.update();
+	// the per-object math goes over the packed components on every thread; the tree and the scene
+	// buffer below take one object at a time
+	_entities.par_each<RenderObject, WorldBounds>([this](const RenderObject& object, WorldBounds& bounds) {
+		const Aabb meshBounds = { object.mesh->_bounds.min, object.mesh->_bounds.max };
+		bounds.box = Aabb::transformed(meshBounds, _transforms.world(object.transformIndex));
+	});
+
+	_renderSpheres.resize(static_cast<uint32_t>(_renderables.size()));
+	for (uint32_t i = 0; i < _renderables.size(); i++)
+	{
+		RenderObject& object = _renderables[i];
+		const Aabb worldBounds = _entities.get<WorldBounds>(object.entity)->box;
+		_renderSpheres.set(i, (worldBounds.min + worldBounds.max) * 0.5f, glm::length(worldBounds.max - worldBounds.min) * 0.5f);
+
+		update_scene_object(object);
+
+		if (object.bvhProxy == Bvh::NULL_NODE)
+		{
+			object.bvhProxy = _renderBvh.insert(worldBounds, i);
+		}
+		else
+		{
+			// only objects that moved out of their fat box (or changed mesh) touch the tree
+			_renderBvh.move(object.bvhProxy, worldBounds);
+			_renderBvh.set_user_data(object.bvhProxy, i);
+		}
+
+		// the handles stay with the entity, which the list is rebuilt from
+		RenderObject* component = _entities.get<RenderObject>(object.entity);
+		component->bvhProxy = object.bvhProxy;
+		component->sceneIndex = object.sceneIndex;
+	}
+}
+
+void VulkanEngine::rebuild_occluders()
+{
+	// static objects only, so the world triangles stay valid until the list changes again
+	_softwareOcclusion.clear_occluders();
+	uint32_t occluders = 0;
+	for (const RenderObject& object : _renderables)
+	{
+		auto found = _occluderMeshes.find(object.mesh);
+		if (object.isStatic && found != _occluderMeshes.end())
+		{
+			_softwareOcclusion.add_occluder(found->second, _transforms.world(object.transformIndex));
+			occluders++;
+		}
+	}
+	if (occluders > 0)
+	{
+		LOG_INFO("Software occlusion: " << occluders << " occluders, " << _softwareOcclusion.occluder_triangle_count() << " triangles");
+	}
+}
+
+void VulkanEngine::update_scene_object(RenderObject& object)
+{
+	if (object.sceneIndex == UINT32_MAX)
+	{
+		object.sceneIndex = _gpuScene.add();
+	}
+
+	// the sphere is in the space of the stored positions, so the cull shader can apply the same matrix
+	GpuSceneObject sceneObject = {};
+	sceneObject.model = _transforms.world(object.transformIndex) * object.mesh->_dequantize;
+	sceneObject.sphereBounds = object.mesh->vertex_space_sphere();
+	sceneObject.materialIndex = object.material->materialIndex;
+	sceneObject.meshIndex = object.mesh->_poolAllocation.firstIndex;
+	_gpuScene.set(object.sceneIndex, sceneObject);
+	if (_sceneEntities.size() <= object.sceneIndex)
+	{
+		_sceneEntities.resize(object.sceneIndex + 1);
+	}
+	_sceneEntities[object.sceneIndex] = object.entity;
+
+	// the slot's instance follows the mesh; the structure is queued the first time any object shows the mesh
+	if (_useRayShadows && !object.mesh->_skinned)
+	{
+		Mesh* mesh = object.mesh;
+		if (mesh->_accelerationStructure == UINT32_MAX)
+		{
+			mesh->_accelerationStructure = _accelerationStructures.add(&mesh->_poolAllocation, mesh->get_lod(0).indexCount);
+		}
+		_accelerationStructures.set_instance(object.sceneIndex, mesh->_accelerationStructure);
+	}
+}
+
+Material* VulkanEngine::create_material(VkPipeline pipeline, VkPipelineLayout layout, const std::string& name)
+{
+	Material mat;
+	mat.pipeline = pipeline;
+	mat.pipelineLayout = layout;
+
+	// re-creating a material keeps its slot, texture, parameters and variants
+	auto existing = _materials.find(name);
+	if (existing != _materials.end())
+	{
+		mat.materialIndex = existing->second.materialIndex;
+		mat.texture = existing->second.texture;
+		mat.baseColor = existing->second.baseColor;
+		mat.lowDetail = existing->second.lowDetail;
+		memcpy(mat.variants, existing->second.variants, sizeof(mat.variants));
+		mat.templateName = existing->second.templateName;
+	}
+	else
+	{
+		mat.materialIndex = _materialCount++;
+	}
+	write_material_data(mat);
+
+	_materials[name] = mat;
+	return &_materials[name];
+}
+
+Material* VulkanEngine::create_material(const std::string& name, const std::string& templateName, const glm::vec4& baseColor)
+{
+	auto found = _materialTemplates.find(templateName);
+	if (found == _materialTemplates.end())
+	{
+		return nullptr;
+	}
+	const MaterialTemplate& shading = found->second;
+
+	static const char* suffixes[VERTEX_FORMAT_COUNT] = { "", "_packed", "_split", "_voxel" };
+	Material* variants[VERTEX_FORMAT_COUNT];
+	for (uint32_t format = 0; format < VERTEX_FORMAT_COUNT; format++)
+	{
+		Material* material = create_material(shading.pipeline[format], shading.pipelineLayout, name + suffixes[format]);
+		material->instancedPipeline = shading.instancedPipeline[format];
+		material->depthPipeline = shading.depthPipeline[format];
+		material->depthInstancedPipeline = shading.depthInstancedPipeline[format];
+		material->baseColor = baseColor;
+		material->templateName = templateName;
+		write_material_data(*material);
+		variants[format] = material;
+	}
+	// the map is node-based, so the variants can point at each other
+	for (Material* material : variants)
+	{
+		memcpy(material->variants, variants, sizeof(variants));
+	}
+	return variants[0];
+}
+
+Material* VulkanEngine::material_for(const Mesh& mesh, Material* material)
+{
+	if (material == nullptr)
+	{
+		material = get_material("defaultmesh");
+	}
+	// materials registered without a template draw every format with their one pipeline
+	Material* variant = material->variants[static_cast<uint32_t>(mesh._vertexFormat)];
+	return variant != nullptr ? variant : material;
+}
+
+Material* VulkanEngine::create_imported_material(const std::string& meshName, const MeshMaterial& source)
+{
+	const glm::vec4& color = source.baseColor;
+	const std::string look = meshName + "|" + source.diffuseTexture + "|" + std::to_string(color.r) + "," + std::to_string(color.g) + ","
+		+ std::to_string(color.b) + "," + std::to_string(color.a);
+	auto same = _importedLooks.find(look);
+	if (same != _importedLooks.end())
+	{
+		return same->second;
+	}
+	Material* material = create_material(meshName + "/" + source.name, "mesh", source.baseColor);
+	if (material != nullptr)
+	{
+		_importedLooks[look] = material;
+	}
+	if (material == nullptr || source.diffuseTexture.empty())
+	{
+		return material;
+	}
+
+	// keyed by path, so materials sharing an atlas share the texture and its residency
+	auto found = _textures.try_emplace(source.diffuseTexture);
+	if (found.second)
+	{
+		const bool compress = _useCompressedTextures && _enabledFeatures.textureCompressionBC;
+		_streamer.request_texture(source.diffuseTexture, source.diffuseTexture, compress);
+		_assetWatcher.watch_texture(source.diffuseTexture, source.diffuseTexture, compress);
+	}
+	for (Material* variant : material->variants)
+	{
+		variant->texture = &found.first->second;
+		write_material_data(*variant);
+	}
+	return material;
+}
+
+Material* VulkanEngine::imported_material_for(const Mesh& mesh, Material* current)
+{
+	auto imported = _importedMaterials.find(&mesh);
+	if (imported == _importedMaterials.end())
+	{
+		return current;
+	}
+	const Material* defaultMaterial = get_material("defaultmesh");
+	if (current == nullptr || current == defaultMaterial || current->variants[0] == defaultMaterial)
+	{
+		return imported->second;
+	}
+	return current;
+}
+
+void VulkanEngine::swap_material(Material* from, Material* to)
+{
+	_entities.each<RenderObject>([from, to](RenderObject& object) {
+		for (uint32_t format = 0; format < VERTEX_FORMAT_COUNT; format++)
+		{
+			if (from->variants[format] != nullptr && object.material == from->variants[format])
+			{
+				object.material = to->variants[format];
+			}
+		}
+	});
+	sort_renderables();
+}
+
+Material* VulkanEngine::get_material(const std::string& name)
+{
+	auto it = _materials.find(name);
+	if (it == _materials.end())
+	{
+		return nullptr;
+	}
+	return &(*it).second;
+}
+
+Mesh* VulkanEngine::get_mesh(const std::string& name)
+{
+	auto it = _meshes.find(name);
+	if (it == _meshes.end())
+	{
+		return nullptr;
+	}
+	return &(*it).second;
+}
+
+void VulkanEngine::defragment_mesh_pool(VkCommandBuffer cmd)
+{
+	CPU_PROFILE_SCOPE("defragment_mesh_pool");
+	if (!_defragmentMeshPool || _meshPool.fragmentation() < MESH_POOL_DEFRAG_THRESHOLD)
+	{
+		return;
+	}
+
+	const auto deadline = std::chrono::high_resolution_clock::now() + std::chrono::duration<double, std::milli>(_defragTimeBudgetMs);
+	VkDeviceSize copiedBytes = 0;
+	bool recorded = false;
+
+	for (auto& entry : _meshes)
+	{
+		if (copiedBytes >= _defragBytesPerFrame || std::chrono::high_resolution_clock::now() > deadline)
+		{
+			break;
+		}
+
+		// meshes still uploading have their ranges owned by the transfer queue; skinned ones hold a range per
+		// frame slot that _poolAllocation only points into
+		Mesh& mesh = entry.second;
+		if (!mesh._resident || mesh._skinned)
+		{
+			continue;
+		}
+
+		MeshAllocation retired;
+		MeshPoolCopy copies[MeshPool::MAX_RELOCATION_COPIES];
+		uint32_t copyCount = _meshPool.relocate(mesh._poolAllocation, retired, copies);
+		if (copyCount == 0)
+		{
+			continue;
+		}
+
+		if (!recorded)
+		{
+			// a source range may have been written by last frame's compaction
+			VkMemoryBarrier toCopy = {};
+			toCopy.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			toCopy.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			toCopy.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &toCopy, 0, nullptr, 0, nullptr);
+			recorded = true;
+		}
+
+		for (uint32_t i = 0; i < copyCount; i++)
+		{
+			vkCmdCopyBuffer(cmd, copies[i].buffer, copies[i].buffer, 1, &copies[i].region);
+			copiedBytes += copies[i].region.size;
+		}
+
+		// frames still in flight draw from the old ranges; they're free once this frame has finished too
+		get_current_frame()._deletionQueue.push_function([=]() {
+			_meshPool.free(retired);
+		});
+	}
+
+	if (recorded)
+	{
+		// this frame's draws already use the new ranges
+		VkMemoryBarrier toDraw = {};
+		toDraw.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		toDraw.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		toDraw.dstAccessMask = _vertexReadAccess | VK_ACCESS_INDEX_READ_BIT;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, _vertexReadStages, 0, 1, &toDraw, 0, nullptr, 0, nullptr);
+
+		// the moved meshes start somewhere else now; only their objects differ, so only they upload
+		for (RenderObject& object : _renderables)
+		{
+			update_scene_object(object);
+		}
+		_staticDrawGeneration++;
+	}
+}
+
+void VulkanEngine::upload_mesh(Mesh& mesh, StreamingUpload* streaming)
+{
+	if (mesh.cpu_geometry_released())
+	{
+		LOG_WARN("mesh geometry was released after its upload, it can't be uploaded again");
+		return;
+	}
+	const size_t indexBufferSize = mesh.index_buffer_size();
+
+	// the format doubles as the pool's vertex stream index
+	if (!_meshPool.allocate(static_cast<uint32_t>(mesh._vertexFormat), static_cast<uint32_t>(mesh._vertices.size()), mesh.index_count(),
+		mesh._indexType, mesh._poolAllocation))
+	{
+		return;
+	}
+
+	const uint32_t bindingCount = _meshPool.binding_count(mesh._poolAllocation.vertexStream);
+	const AllocatedBuffer& poolIndexBuffer = _meshPool.index_buffer(mesh._indexType);
+	const VkDeviceSize indexOffset = _meshPool.index_byte_offset(mesh._poolAllocation);
+
+	if (!_uploadMeshesToDeviceLocal)
+	{
+		// the pool was created host-visible, so write straight into its slices
+		// every vertex fetch goes over the bus on discrete GPUs, so this is only kept for comparison
+		for (uint32_t binding = 0; binding < bindingCount; binding++)
+		{
+			const AllocatedBuffer& poolVertexBuffer = _meshPool.vertex_buffer(mesh._poolAllocation.vertexStream, binding);
+			const VkDeviceSize vertexOffset = _meshPool.vertex_byte_offset(mesh._poolAllocation, binding);
+			// packs or splits the vertices when the mesh asks for it
+			mesh.write_vertices(static_cast<char*>(poolVertexBuffer._mapped) + vertexOffset, binding);
+			vmaFlushAllocation(_allocator, poolVertexBuffer._allocation, vertexOffset, mesh.vertex_buffer_size(binding));
+		}
+
+		mesh.write_indices(static_cast<char*>(poolIndexBuffer._mapped) + indexOffset); // narrows to 16 bits when the mesh allows it
+		vmaFlushAllocation(_allocator, poolIndexBuffer._allocation, indexOffset, mesh.index_buffer_size());
+	}
+	else
+	{
+		// staged on the transfer queue; the copies go out with the next flush and the first frame
+		// after that acquires the ranges before drawing. The writers run right away, so capturing mesh is safe
+		for (uint32_t binding = 0; binding < bindingCount; binding++)
+		{
+			_uploadManager.upload_buffer(_meshPool.vertex_buffer(mesh._poolAllocation.vertexStream, binding)._buffer,
+				_meshPool.vertex_byte_offset(mesh._poolAllocation, binding), mesh.vertex_buffer_size(binding),
+				[&mesh, binding](void* data) { mesh.write_vertices(data, binding); },
+				_vertexReadStages, _vertexReadAccess);
+		}
+		if (streaming != nullptr && !mesh._packedIndices.empty() && gpu_index_unpack())
+		{
+			// staged as stored, into a buffer of its own; publish_streamed_assets expands it into the pool
+			const size_t packedSize = mesh._packedIndices.size() * sizeof(uint32_t);
+			streaming->packedIndices = create_buffer(packedSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+			streaming->packedBlocks = blockpack::block_count(mesh.index_count());
+			_uploadManager.upload_buffer(streaming->packedIndices._buffer, 0, packedSize,
+				[&mesh, packedSize](void* data) { memcpy(data, mesh._packedIndices.data(), packedSize); },
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		}
+		else
+		{
+			_uploadManager.upload_buffer(poolIndexBuffer._buffer, indexOffset, indexBufferSize,
+				[&mesh](void* data) { mesh.write_indices(data); },
+				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+		}
+	}
+
+	// the mesh shader path draws level 0 from meshlets cut out of the clusters; when the meshlet pool is
+	// full the allocation stays empty and the vertex pipeline draws the mesh instead
+	if (_meshShadingSupported && !mesh._clusters.empty())
+	{
+		mesh.build_meshlets();
+		_meshletPool.add(mesh, mesh._meshletAllocation);
+	}
+
+	// the pool owns the memory; it's released with the pool
+}
+
+void VulkanEngine::make_resident(Mesh& mesh)
+{
+	mesh._resident = true;
+	if (_useSoftwareOcclusion && !mesh._skinned && glm::length(mesh._bounds.max - mesh._bounds.min) >= _occluderMinSize)
+	{
+		OccluderMesh occluder;
+		if (make_occluder_mesh(mesh, occluder))
+		{
+			_occluderMeshes[&mesh] = std::move(occluder);
+		}
+	}
+	// skinned meshes freed their bind pose copies already; the few hand-built ones aren't worth it
+	if (!_releaseMeshCopies || mesh._skinned || mesh._poolAllocation.vertexCount == 0)
+	{
+		return;
+	}
+	_releasedMeshBytes += mesh._vertices.capacity() * sizeof(Vertex) + mesh._texcoords.capacity() * sizeof(glm::vec2)
+		+ mesh._tangents.capacity() * sizeof(glm::vec4) + (mesh._indices.capacity() + mesh._packedIndices.capacity()) * sizeof(uint32_t)
+		+ mesh._meshlets.capacity() * sizeof(Meshlet) + mesh._meshletData.capacity() * sizeof(uint32_t);
+	mesh.release_cpu_geometry();
+}
+
+AllocatedBuffer VulkanEngine::create_buffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, bool sharedWithCompute, const char* name)
+{
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.pNext = nullptr;
+
+	// total size, in bytes, of buffer we're allocating
+	bufferInfo.size = allocSize;
+	bufferInfo.usage = usage;
+
+	// rewritten every frame on one queue and read on the other, where ownership transfers would cost
+	// two barriers each time
+	const uint32_t families[] = { _graphicsQueueFamily, _computeQueueFamily };
+	if (sharedWithCompute && _useAsyncCompute)
+	{
+		bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		bufferInfo.queueFamilyIndexCount = 2;
+		bufferInfo.pQueueFamilyIndices = families;
+	}
+
+	VmaAllocationCreateInfo vmaAllocInfo = {};
+	vmaAllocInfo.usage = memoryUsage;
+	// whatever the CPU touches is mapped once for its lifetime, so writing it costs no driver call
+	const bool hostVisible = memoryUsage == VMA_MEMORY_USAGE_CPU_ONLY || memoryUsage == VMA_MEMORY_USAGE_CPU_TO_GPU
+		|| memoryUsage == VMA_MEMORY_USAGE_GPU_TO_CPU;
+	if (hostVisible)
+	{
+		vmaAllocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+	}
+
+	AllocatedBuffer newBuffer;
+	VmaAllocationInfo allocationInfo = {};
+
+	// actually allocate buffer
+	VK_CHECK(vmaCreateBuffer(
+		_allocator, &bufferInfo, &vmaAllocInfo,
+		&newBuffer._buffer,
+		&newBuffer._allocation,
+		&allocationInfo
+	));
+	newBuffer._mapped = hostVisible ? allocationInfo.pMappedData : nullptr;
+	if (name != nullptr)
+	{
+		_debugUtils.name(VK_OBJECT_TYPE_BUFFER, newBuffer._buffer, name);
+	}
+
+	return newBuffer;
+}
+
+void VulkanEngine::immediate_submit(std::function<void(VkCommandBuffer cmd)>&& function)
+{
+	VkCommandBuffer cmd = _uploadContext._commandBuffer;
+
+	// buffer is used exactly once before the pool is reset below
+	VkCommandBufferBeginInfo cmdBeginInfo = vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
+
+	function(cmd);
+
+	VK_CHECK(vkEndCommandBuffer(cmd));
+
+	// submit and block on its timeline value, or on the upload fence, which is never shared with rendering
+	const uint64_t value = submit_graphics(cmd, 0, nullptr, nullptr, nullptr, VK_NULL_HANDLE, _uploadContext._uploadFence);
+	if (value != 0)
+	{
+		wait_graphics(value, 9999999999);
+	}
+	else
+	{
+		vkWaitForFences(_device, 1, &_uploadContext._uploadFence, true, 9999999999);
+		vkResetFences(_device, 1, &_uploadContext._uploadFence);
+	}
+
+	// resetting the pool frees the command buffer's memory for the next upload
+	vkResetCommandPool(_device, _uploadContext._commandPool, 0);
+}
+
+void VulkanEngine::cleanup()
+{	
+	// a run shorter than the capture still gets its trace
+	if (!_cpuTracePath.empty() && cpu_profiler::is_capturing())
+	{
+		const bool written = cpu_profiler::end_capture(_cpuTracePath);
+		LOG_INFO((written ? "Wrote CPU trace to " : "Could not write CPU trace to ") << _cpuTracePath);
+	}
+	_metrics.stop();
+
+	if (_isInitialized)
+	{
+		// the frames handed to the present thread go out first
+		_presentThread.stop();
+		// make sure GPU is done with every frame in flight
+		wait_device_idle();
+
+		// the frames still in flight at exit; the last one is the capture. A lost device finished none of them
+		if (!_deviceLost)
+		{
+			deliver_pending_readbacks([this](const FrameReadback::Result& result) {
+				if (_onFrameReadback)
+				{
+					_onFrameReadback(result);
+				}
+				if (_headless && !_headlessCapturePath.empty() && result.frameNumber == _frameNumber - 1)
+				{
+					const bool written = FrameReadback::write_ppm(result, _headlessCapturePath);
+					LOG_INFO((written ? "Wrote last frame to " : "Could not write last frame to ") << _headlessCapturePath);
+				}
+			});
+			deliver_pending_encodes();
+		}
+		if (_encodeFile.is_open())
+		{
+			_encodeFile.close();
+			LOG_INFO("Wrote encoded stream to " << _encodePath);
+		}
+		if (_releaseMeshCopies)
+		{
+			LOG_INFO("Released " << (_releasedMeshBytes >> 10) << " KiB of CPU-side mesh geometry after upload");
+		}
+		// like the pipeline cache, left as it was after a device loss
+		if (!_deviceLost && !_pipelineManifest.save(_pipelineManifestPath))
+		{
+			LOG_WARN("Could not write the pipeline manifest to " << _pipelineManifestPath);
+		}
+
+		// then destroy all the stuff we created
+		// MUST destroy these in the opposite order they're created
+		// pipelines the hot reload swapped in first, while the cache they were built with is alive
+		_shaderReload.cleanup();
+		_presentThread.cleanup();
+		// per-frame retirees first, then swapchain-sized resources, which reference the render pass
+		for (uint32_t i = 0; i < _frameOverlap; i++)
+		{
+			_frames[i]._deletionQueue.flush(_device, _allocator);
+		}
+		_frameGraph.release_framebuffers();
+		_swapchainDeletionQueue.flush(_device, _allocator);
+		_mainDeletionQueue.flush(_device, _allocator);
+		// the pools must be empty by now, so they go last
+		_gpuMemory.cleanup();
+		// the streamer has been stopped with the main queue, so nothing can queue jobs anymore
+		_jobSystem.cleanup();
+		_assetArchive.close();
+
+		// VkPhysicalDevice doesn't need to be destroyed- it's just a pointer to a driver
+		vkDestroySurfaceKHR(_instance, _surface, nullptr);
+
+		release_device_context();
+
+		if (_window != nullptr)
+		{
+			SDL_DestroyWindow(_window);
+		}
+	}
+}
+
+void VulkanEngine::release_device_context()
+{
+	{
+		std::lock_guard<std::mutex> lock(_deviceContext->lifetimeMutex);
+		if (--_deviceContext->sessions > 0)
+		{
+			_deviceContext.reset();
+			return;
+		}
+	}
+
+	// write back whatever any session compiled before the cache goes away; after a device loss the file
+	// is left as it was, the loss may have come from a pipeline compiled since
+	if (_pipelineCache != VK_NULL_HANDLE)
+	{
+		if (!_deviceLost)
+		{
+			save_pipeline_cache();
+		}
+		vkDestroyPipelineCache(_device, _pipelineCache, nullptr);
+	}
+	vmaDestroyAllocator(_allocator);
+	vkDestroyDevice(_device, nullptr);
+	vkb::destroy_debug_utils_messenger(_instance, _debug_messenger);
+	vkDestroyInstance(_instance, nullptr);
+	_deviceContext.reset();
+}
+
+void VulkanEngine::wait_device_idle()
+{
+	std::lock_guard<std::mutex> lock(_deviceContext->queueMutex);
+	check_device_result(vkDeviceWaitIdle(_device), "vkDeviceWaitIdle");
+}
+
+bool VulkanEngine::check_device_result(VkResult result, const char* call)
+{
+	if (result == VK_SUCCESS)
+	{
+		return true;
+	}
+	LOG_ERROR("Vulkan error " << result << " from " << call);
+	// sticky: every later submit and wait on the device fails the same way
+	if (result == VK_ERROR_DEVICE_LOST && !_deviceLost)
+	{
+		LOG_ERROR("Device lost on frame " << _frameNumber);
+		LOG_ERROR(_breadcrumbs.report());
+		// on stdout before whatever the lost device brings down next
+		logging::flush();
+		_deviceLost = true;
+	}
+	return false;
+}
+
+void VulkanEngine::draw()
+{
+	// nothing reaches a lost device; the owner starts another engine (see device_lost())
+	if (_deviceLost)
+	{
+		return;
+	}
+
+	// don't draw when window minimized
+	if (_window != nullptr && (SDL_GetWindowFlags(_window) & SDL_WINDOW_MINIMIZED)) {
+		return;
+	}
+
+	if (_resizeRequested)
+	{
+		recreate_swapchain();
+		if (_resizeRequested) return; // still zero-sized
+	}
+
+	CPU_PROFILE_SCOPE("draw");
+	FrameData& frame = get_current_frame();
+	const heap_stats::Snapshot heapAtStart = heap_stats::snapshot();
+
+	// wait until GPU has finished rendering the last frame that used this slot
+	// with _frameOverlap slots, the GPU can still be working on the other frames meanwhile
+	{
+		CPU_PROFILE_SCOPE("wait for frame");
+		if (_graphicsTimeline != VK_NULL_HANDLE)
+		{
+			wait_graphics(frame._timelineValue, 1000000000);
+		}
+		else
+		{
+			check_device_result(vkWaitForFences(_device, 1, &frame._renderFence, true, 1000000000), "vkWaitForFences");
+		}
+	}
+	// where a lost device shows up at the latest; nothing more goes to it, and run() returns for the owner
+	// to start over
+	if (_deviceLost)
+	{
+		return;
+	}
+	// the GPU is done with everything this slot retired last time around
+	frame._deletionQueue.flush(_device, _allocator);
+	if (frame._acquireSemaphore != VK_NULL_HANDLE)
+	{
+		_presentThread.release(frame._acquireSemaphore);
+		frame._acquireSemaphore = VK_NULL_HANDLE;
+	}
+	// the present thread's presents since the last frame fail the way an inline one would
+	if (_presentThread.running())
+	{
+		const VkResult presentResult = _presentThread.take_present_result();
+		if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR
+			|| presentResult == VK_ERROR_FULL_SCREEN_EXCLUSIVE_MODE_LOST_EXT)
+		{
+			_resizeRequested = true;
+		}
+		else
+		{
+			check_device_result(presentResult, "vkQueuePresentKHR");
+		}
+	}
+	if (_useReadback)
+	{
+		_readback.deliver(_frameNumber % _frameOverlap, _onFrameReadback);
+	}
+	_overdraw.deliver(_frameNumber % _frameOverlap);
+	_objectPicker.deliver(_frameNumber % _frameOverlap, [this](const ObjectPicker::Result& result) {
+		report_gpu_pick(result);
+	});
+	// the slot's encode was submitted right after its frame and has usually finished with it
+	if (_useVideoEncode)
+	{
+		_videoEncoder.deliver(_frameNumber % _frameOverlap, [this](const VideoEncoder::Packet& packet) {
+			output_encoded_frame(packet);
+		});
+	}
+
+	// between frames, so nothing is recording with the pipelines being replaced
+	auto replaced = [this](VkPipeline previous, VkPipeline pipeline) {
+		replace_pipeline(previous, pipeline);
+	};
+	_pipelineRegistry.update(frame._deletionQueue, replaced);
+	_shaderReload.update(frame._deletionQueue, replaced);
+	swap_specialized_pipelines();
+	frame._arena.reset();
+	_frameGpuData.begin_frame(_frameNumber % _frameOverlap);
+	_descriptorSetCache.begin_frame(_frameNumber % _frameOverlap);
+
+	_gpuMemory.update(static_cast<uint32_t>(_frameNumber));
+	const bool overBudget = _gpuMemory.device_local_pressure() > _memoryPressureLimit;
+	if (overBudget != _overMemoryBudget)
+	{
+		LOG_INFO((overBudget ? "Device-local memory near its budget, pausing texture uploads" : "Device-local memory back under budget"));
+		_overMemoryBudget = overBudget;
+	}
+
+	// acquire image index from swapchain
+	// wait for up to [timeout] amt of time for an image- this is FPS lock
+	uint32_t swapchainImageIndex;
+	VkSemaphore acquireSemaphore = frame._presentSemaphore;
+	auto acquireStart = std::chrono::high_resolution_clock::now();
+	VkResult acquireResult;
+	if (_headless)
+	{
+		// the ring is at least _frameOverlap deep, so the fence above also retired this image's last frame
+		swapchainImageIndex = _offscreen.image_for(_frameNumber);
+		acquireResult = VK_SUCCESS;
+	}
+	else if (_presentThread.running())
+	{
+		// usually acquired while the last frame's simulation and culling ran
+		CPU_PROFILE_SCOPE("acquire");
+		const PresentThread::Acquired acquired = _presentThread.acquire(1000000000);
+		acquireResult = acquired.result;
+		swapchainImageIndex = acquired.imageIndex;
+		acquireSemaphore = acquired.semaphore;
+		frame._acquireSemaphore = acquired.semaphore;
+	}
+	else
+	{
+		CPU_PROFILE_SCOPE("acquire");
+		acquireResult = vkAcquireNextImageKHR(_device, _swapchain, 1000000000, frame._presentSemaphore, nullptr, &swapchainImageIndex);
+	}
+	auto acquireEnd = std::chrono::high_resolution_clock::now();
+	if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR || acquireResult == VK_ERROR_FULL_SCREEN_EXCLUSIVE_MODE_LOST_EXT)
+	{
+		// nothing was acquired, so skip the frame; the fence stays signaled for the next attempt. A rebuilt
+		// swapchain asks for exclusive fullscreen again
+		_resizeRequested = true;
+		return;
+	}
+	else if (acquireResult == VK_SUBOPTIMAL_KHR)
+	{
+		// the image is still presentable; finish this frame and rebuild before the next
+		_resizeRequested = true;
+	}
+	else if (!check_device_result(acquireResult, "vkAcquireNextImageKHR"))
+	{
+		// the fence wasn't reset, so skipping the frame leaves the slot as it was
+		return;
+	}
+
+	// only reset once we know this frame will be submitted, or the next wait on it would never return
+	if (frame._renderFence != VK_NULL_HANDLE)
+	{
+		VK_CHECK(vkResetFences(_device, 1, &frame._renderFence));
+	}
+
+	// hand assets the loader thread finished to the transfer queue
+	if (_useAssetReload)
+	{
+		update_asset_reload();
+	}
+	update_streaming();
+	update_voxel_world();
+
+	// now that we're confident the previous cmds finished executing, the slot's pools start over
+	_frameCommands.begin_frame(_frameNumber % _frameOverlap);
+	frame._mainCommandBuffer = _frameCommands.allocate(MAIN_COMMAND_THREAD, VK_COMMAND_BUFFER_LEVEL_PRIMARY, "frame");
+
+	// begin command buffer recording 
+	VkCommandBuffer cmd = frame._mainCommandBuffer;
+	VkCommandBufferBeginInfo cmdBeginInfo = {};
+	cmdBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	cmdBeginInfo.pNext = nullptr;
+	cmdBeginInfo.pInheritanceInfo = nullptr;
+	// we're using this cmd buff exactly once, so let Vulkan know- helps with optimization, esp since we're using every frame
+	cmdBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
+
+	// take ownership of whatever the transfer queue finished uploading; the submit below waits for it
+	_uploadManager.collect();
+	_uploadManager.record_acquires(cmd);
+	publish_streamed_assets(cmd);
+	defragment_mesh_pool(cmd);
+	// after publishing, which may have given materials their textures
+	if (_useBindless)
+	{
+		_materialStore.record_updates(cmd, _frameGpuData);
+	}
+
+	// reads back what this frame slot measured last time, then resets its queries
+	_gpuProfiler.begin_frame(cmd, _frameNumber % _frameOverlap, _frameNumber);
+	_occlusionPredicates.begin_frame(cmd, _frameNumber % _frameOverlap, _frameNumber);
+	// the atlases that arrived, before culling fills the slot's quads
+	if (_useImpostors)
+	{
+		_impostors.begin_frame(cmd, _frameNumber % _frameOverlap, frame._deletionQueue);
+	}
+	// the font's atlas, the first frame
+	if (_textFlags != 0)
+	{
+		_text.begin_frame(cmd, frame._deletionQueue);
+	}
+	// scope 0 spans all GPU work of the frame; benchmarks report it as GPU time
+	uint32_t frameScope = _gpuProfiler.begin_scope(cmd, "frame");
+	// the slot's last frame finished with the fence wait above, so its markers can be reused
+	_breadcrumbs.begin_frame(_frameNumber % _frameOverlap, _frameNumber);
+	_breadcrumbs.begin_pass(cmd, "frame");
+	_debugUtils.begin_label(cmd, "frame");
+
+	// everything up to here overlapped the update job; the rest of the frame animates from its snapshot
+	const SimulationState& simulation = wait_for_update();
+	_transforms.update();
+	animate_characters(_frameNumber % _frameOverlap, simulation.time);
+
+	const uint32_t instanceCount = std::min(_instanceCount, MAX_INSTANCES);
+	update_render_scale();
+
+	// instances are laid out on a square grid in the XY plane, one unit apart
+	const uint32_t gridSide = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(instanceCount))));
+	const float gridHalfExtent = (gridSide - 1) * 0.5f;
+
+	// create view matrix
+	// back the camera off far enough to see the whole grid
+	float cameraDistance = 2.f + gridHalfExtent * 1.5f;
+	glm::vec3 camPos = { 0.f,0.f,-cameraDistance };
+	glm::mat4 view = glm::translate(glm::mat4(1.f), camPos);
+	if (_benchmark.cameraPath == CameraPath::Orbit)
+	{
+		// driven by the simulation, which benchmarks step in lockstep with frames
+		float angle = glm::radians(simulation.cameraOrbitAngle);
+		glm::vec3 eye = glm::vec3{ sin(angle), 0.25f, cos(angle) } * cameraDistance;
+		view = glm::lookAt(eye, glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
+	}
+	//camera projection
+	const float fovY = glm::radians(70.f);
+	// each eye has half the window
+	const VkExtent2D sceneExtent = scene_extent();
+	const float aspect = (float)sceneExtent.width / (float)sceneExtent.height;
+	const float nearPlane = 0.1f;
+	// each frame's samples land elsewhere inside their pixels, for the upscaler to put together
+	const bool temporalUpscale = _useTemporalUpscale && _temporalUpscaler.ready() && _dynamicResolution && _dynamicResolutionSupported;
+	const glm::vec2 jitter = temporalUpscale ? TemporalUpscaler::jitter(_frameNumber) : glm::vec2(0.f);
+	_camera.set_jitter(2.f * jitter / glm::vec2(_renderExtent.width, _renderExtent.height));
+	_camera.update(view, fovY, aspect, nearPlane, std::max(200.0f, cameraDistance * 2.f));
+	_sceneViews.update(_camera);
+	// the nodes whose tiles were acquired above
+	if (_useTerrain)
+	{
+		_terrain.select(_camera.position(), _camera.frustum_planes(), _frameNumber % _frameOverlap, static_cast<uint64_t>(_frameNumber),
+			_uploadManager.acquired_value());
+	}
+
+	// LOD selection input; pixels covered by one world unit seen from unit distance
+	_lodPixelScale = 0.5f * _renderExtent.height * std::abs(_camera.projection()[1][1]);
+
+	// camera matrices go to the GPU once per frame, into this frame slot's region of the linear allocator
+	GPUCameraData camera;
+	camera.view = _camera.view();
+	camera.proj = _camera.projection();
+	camera.viewproj = _camera.view_projection();
+	camera.eyeViewProj[0] = _camera.eye_view_projection(0);
+	camera.eyeViewProj[1] = _camera.eye_view_projection(1);
+	for (int i = 0; i < 6; i++)
+	{
+		camera.frustumPlanes[i] = _camera.frustum_planes()[i];
+	}
+	camera.position = glm::vec4(_camera.position(), 1.f);
+
+	// the render list goes through the GPU cull pass, which has to be recorded outside the render pass
+	const bool indirectDraws = instanceCount <= 1 && _useIndirectDraws && _enabledFeatures.drawIndirectFirstInstance;
+	// traced from the depth of a pre-pass that only the indirect path draws on its own; in place of the cascades
+	const bool rayShadows = _useRayShadows && _rayShadows.ready() && indirectDraws && _depthPrepass;
+	// the crowd isn't in the render list the casters come from, so it draws unshadowed
+	const bool shadows = _useShadows && _shadowPipelineLayout != VK_NULL_HANDLE && instanceCount <= 1 && !rayShadows;
+	if (shadows)
+	{
+		// the cascades cover the whole view, so every tile of a tiled render shades with the same ones
+		_shadows.update(view, fovY, _camera.aspect(), nearPlane, _shadowDistance, glm::normalize(_lightDirection));
+	}
+	for (uint32_t i = 0; i < ShadowCascades::CASCADE_COUNT; i++)
+	{
+		camera.shadowViewProj[i] = _shadows.view_projection(i);
+	}
+	camera.shadowSplits = _shadows.split_distances();
+	camera.lightDirection = glm::vec4(glm::normalize(_lightDirection), rayShadows ? 2.f : (shadows ? 1.f : 0.f));
+	camera.clusterDepth = glm::vec4(ClusteredLights::slice_params(_camera), _renderExtent.width, _renderExtent.height);
+	camera.clusterGrid = glm::uvec4(ClusteredLights::GRID_X, ClusteredLights::GRID_Y, ClusteredLights::GRID_Z, 0);
+
+	// the camera is the first allocation of the frame, so this can't run out
+	GpuAllocation cameraAllocation;
+	_frameGpuData.push(camera, &cameraAllocation);
+	const uint32_t cameraOffset = static_cast<uint32_t>(cameraAllocation.offset);
+
+	// the cull binds the extra views' frusta whether there are any or not. Each view's camera block is the main
+	// one's seen from its camera; the ray mask only covers the main view's pixels, so the views go unshadowed then
+	GpuAllocation cullViewsAllocation;
+	_frameGpuData.push(_sceneViews.cull_views(MAX_INSTANCES), &cullViewsAllocation);
+	_graphInputs.cullViewsOffset = static_cast<uint32_t>(cullViewsAllocation.offset);
+	for (uint32_t v = 0; indirectDraws && v < _sceneViews.count(); v++)
+	{
+		const Camera& viewCamera = _sceneViews.camera(v);
+		GPUCameraData viewData = camera;
+		viewData.view = viewCamera.view();
+		viewData.proj = viewCamera.projection();
+		viewData.viewproj = viewCamera.view_projection();
+		viewData.eyeViewProj[0] = viewCamera.view_projection();
+		viewData.eyeViewProj[1] = viewCamera.view_projection();
+		for (int i = 0; i < 6; i++)
+		{
+			viewData.frustumPlanes[i] = viewCamera.frustum_planes()[i];
+		}
+		viewData.position = glm::vec4(viewCamera.position(), 1.f);
+		if (rayShadows)
+		{
+			viewData.lightDirection.w = 0.f;
+		}
+		viewData.clusterDepth.z = static_cast<float>(_sceneViews.extent().width);
+		viewData.clusterDepth.w = static_cast<float>(_sceneViews.extent().height);
+		GpuAllocation viewAllocation;
+		_frameGpuData.push(viewData, &viewAllocation);
+		_graphInputs.viewCameraOffsets[v] = static_cast<uint32_t>(viewAllocation.offset);
+	}
+
+	// the CPU path only draws what the BVH finds inside the frustum
+	uint32_t visibleCount = 0;
+	RenderObject* visible = nullptr;
+	const bool cacheStaticDraws = instanceCount <= 1 && !indirectDraws && static_draw_cache_active();
+	if (instanceCount <= 1 && !indirectDraws)
+	{
+		visible = cull_renderables(frame, visibleCount, cacheStaticDraws);
+	}
+	const bool parallelRecording = instanceCount <= 1 && !indirectDraws && should_record_in_parallel(visibleCount);
+
+	// the passes only change with these; everything else reaches them through _graphInputs
+	// the depth pyramid covers the whole depth buffer, which dynamic resolution only partly renders
+	const bool dynamicResolution = _dynamicResolution && _dynamicResolutionSupported && !_useStereo;
+	// the trace pass needs the whole frame's depth before the main pass, which the two-phase cull only has after it
+	const bool occlusion = indirectDraws && occlusion_culling() && !dynamicResolution && !rayShadows;
+	// the rates come from a scene target the rate pass can sample, which the swapchain image isn't
+	const bool shadingRate = _useShadingRateImage && _shadingRateImage.ready() && (_usePostProcess || dynamicResolution);
+	const bool transparent = !_transparentObjects.empty() && _transparentPipelineLayout != VK_NULL_HANDLE;
+	// the GPU path culls against its depth pyramid instead
+	const bool occlusionQueries = instanceCount <= 1 && !indirectDraws && _occlusionPredicates.ready() && _occlusionBoxPipeline != VK_NULL_HANDLE;
+	// the counts are drawn from the cull's runs, and their heat map blitted to the swapchain
+	const bool overdraw = _debugView == DebugView::Overdraw && indirectDraws && !_useStereo && _dynamicResolutionSupported && _overdraw.ready()
+		&& _overdrawPipelines[static_cast<uint32_t>(VertexFormat::Full)] != VK_NULL_HANDLE;
+	// instances carry their scene slots only out of the cull pass
+	const bool picking = _useGpuPicking && indirectDraws && !_useStereo && _pickPipelines[static_cast<uint32_t>(VertexFormat::Full)] != VK_NULL_HANDLE;
+	const FrameGraphKey graphKey = { shadows, indirectDraws, occlusion, dynamicResolution, indirectDraws && _useAsyncCompute && !occlusion,
+		_useParticles && _particles.ready(), _useClusteredLights, _usePostProcess, _debugDrawFlags != 0 && _debugLinePipeline != VK_NULL_HANDLE,
+		shadingRate, temporalUpscale, rayShadows, transparent, transparent && _transparencyMode == TransparencyMode::WeightedBlended, occlusionQueries,
+		overdraw, picking, _textFlags != 0 && _textPipeline != VK_NULL_HANDLE, _hud.visible() && _hudPipeline != VK_NULL_HANDLE,
+		_useFoliage && _foliage.ready(), _windowExtent };
+	if (!_frameGraph.compiled() || graphKey != _frameGraphKey)
+	{
+		// whatever the history holds is from before the upscaler was last turned off
+		if (graphKey.temporalUpscale && !_frameGraphKey.temporalUpscale)
+		{
+			_temporalUpscaler.reset();
+		}
+		build_frame_graph(graphKey, frame._deletionQueue);
+	}
+
+	_graphInputs.frame = &frame;
+	_graphInputs.cameraOffset = cameraOffset;
+	_graphInputs.visible = visible;
+	_graphInputs.visibleCount = visibleCount;
+	_graphInputs.parallelRecording = parallelRecording;
+	_graphInputs.cacheStaticDraws = cacheStaticDraws;
+	_graphInputs.instanceCount = instanceCount;
+	_graphInputs.modelAngle = simulation.modelAngle;
+	// simulated rather than real time, so benchmarks see the same particles on the same frame
+	_graphInputs.particleDeltaTime = _particleTime < 0.0 ? 0.0f : static_cast<float>(std::min(simulation.time - _particleTime, 0.1));
+	_particleTime = simulation.time;
+	if (graphKey.shadingRate)
+	{
+		// the turn as pixels at the center of the screen; moving along the view leaves most of it in place
+		const glm::mat4& view = _camera.view();
+		const glm::vec3 forward = -glm::vec3(view[0][2], view[1][2], view[2][2]);
+		// nothing to compare against on the first frame
+		const float turned = _shadingRateForward == glm::vec3(0.f) ? 0.f : std::acos(std::clamp(glm::dot(forward, _shadingRateForward), -1.f, 1.f));
+		_graphInputs.cameraMotion = turned / _camera.fov_y() * static_cast<float>(_renderExtent.height);
+		_shadingRateForward = forward;
+	}
+	if (graphKey.temporalUpscale)
+	{
+		_graphInputs.jitter = jitter;
+		_graphInputs.reprojection = _upscalePreviousViewProjection * glm::inverse(_camera.unjittered_view_projection());
+		_upscalePreviousViewProjection = _camera.unjittered_view_projection();
+	}
+	if (graphKey.clusteredLights)
+	{
+		animate_lights(simulation.time);
+	}
+	if (graphKey.foliage)
+	{
+		// on the nodes the terrain just selected; with occlusion culling the pass runs on this frame's pyramid
+		_foliage.prepare(_terrain, _camera, _frameNumber % _frameOverlap, graphKey.occlusion, _windowExtent);
+	}
+	if (graphKey.postProcess)
+	{
+		_postProcess.set_settings(_postSettings);
+	}
+	if (graphKey.debugDraw)
+	{
+		collect_debug_draw();
+		_frameGraph.set_render_area(_graphDebugPass, _renderExtent);
+	}
+	if (graphKey.text)
+	{
+		collect_text();
+	}
+	// built before the graph records, so the pass only copies and draws; samples frame times while hidden too
+	PerformanceHud::Stats hudStats = {};
+	hudStats.presentMode = present_mode_name(_presentMode);
+	hudStats.gpu = &_gpuProfiler.latest();
+	hudStats.memory = &_gpuMemory;
+	hudStats.commands = &_lastFrameStats;
+	hudStats.objects = indirectDraws ? static_cast<uint32_t>(_renderables.size()) : visibleCount;
+	hudStats.gpuCulled = indirectDraws;
+	hudStats.instances = instanceCount;
+	hudStats.renderExtent = _renderExtent;
+	hudStats.jobBusyNs = _jobSystem.busy_ns();
+	hudStats.jobThreads = _jobSystem.thread_count();
+	hudStats.shaders = _captureShaderStatistics ? &_shaderStatistics.pipelines() : nullptr;
+	hudStats.overdraw = graphKey.overdraw ? &_overdraw.latest() : nullptr;
+	hudStats.heap = &_lastFrameHeap;
+	if (!_headless)
+	{
+		_hud.prepare(hudStats);
+	}
+	if (graphKey.transparent)
+	{
+		_frameGraph.set_render_area(_graphTransparentPass, _renderExtent);
+	}
+	if (graphKey.occlusionQueries)
+	{
+		_frameGraph.set_render_area(_graphOcclusionQueryPass, _renderExtent);
+	}
+	if (graphKey.weightedBlended)
+	{
+		_frameGraph.set_render_area(_graphOitCompositePass, _renderExtent);
+	}
+	if (graphKey.overdraw)
+	{
+		_frameGraph.set_render_area(_graphOverdrawPass, _renderExtent);
+	}
+	// a frame without a pick only clears a pixel of the target
+	_objectPicker.begin_frame();
+	if (graphKey.picking)
+	{
+		_frameGraph.set_render_area(_graphPickPass, _objectPicker.active() ? _objectPicker.extent() : VkExtent2D{ 1, 1 });
+	}
+
+	_frameGraph.bind_image(_graphSwapchain, _swapchainImages[swapchainImageIndex], _swapchainImageViews[swapchainImageIndex]);
+	for (uint32_t v = 0; graphKey.indirect && v < _sceneViews.count(); v++)
+	{
+		_frameGraph.bind_image(_graphViewColor[v], _sceneViews.image(v), _sceneViews.image_view(v));
+	}
+	if (graphKey.occlusion)
+	{
+		_frameGraph.bind_image(_graphDepth, _depthImage._image, _depthImageView);
+	}
+	if (graphKey.shadingRate)
+	{
+		_frameGraph.bind_image(_graphShadingRate, _shadingRateImage.image(), _shadingRateImage.view());
+	}
+	if (graphKey.temporalUpscale)
+	{
+		_frameGraph.bind_image(_graphUpscaleHistory, _temporalUpscaler.history_image(), _temporalUpscaler.history_view());
+		_frameGraph.bind_image(_graphUpscaleOutput, _temporalUpscaler.output_image(), _temporalUpscaler.output_view());
+	}
+	if (graphKey.rayShadows)
+	{
+		_frameGraph.bind_image(_graphRayShadows, _rayShadows.image(), _rayShadows.view());
+		_frameGraph.set_render_area(_graphDepthPrepass, _renderExtent);
+	}
+	_frameGraph.set_secondary_contents(_graphMainPass, parallelRecording || cacheStaticDraws);
+	_frameGraph.set_render_area(_graphMainPass, _renderExtent);
+
+	// animate the clear color with simulated time
+	VkClearValue clearValue;
+	float flash = simulation.clearFlash;
+	clearValue.color = { {0.0f, 0.0f, flash, 1.0f} };
+	// with ray shadows the pre-pass clears and the main pass loads what it left
+	_frameGraph.set_clear_value(graphKey.rayShadows ? _graphDepthPrepass : _graphMainPass, 0, clearValue);
+
+	// off to the compute queue before the graphics work is even recorded, so it overlaps the frames in flight
+	const uint64_t cullValue = graphKey.asyncCulling ? submit_async_culling(frame, cameraOffset) : 0;
+
+	// a query can't span render passes from inside one, so the statistics cover the whole graph
+	_gpuProfiler.begin_statistics(cmd);
+	{
+		CPU_PROFILE_SCOPE("record passes");
+		_frameGraph.execute(cmd);
+	}
+	_gpuProfiler.end_statistics(cmd);
+	if (graphKey.temporalUpscale)
+	{
+		_temporalUpscaler.advance();
+	}
+	for (const auto& entry : _virtualTextures)
+	{
+		entry.second.finish_frame(cmd, _frameNumber % _frameOverlap);
+	}
+
+	// the frame graph left the image to be copied; the encoder converts it first and hands it on to the
+	// readback, and the last of them to presenting. The text and HUD are in it, so captures show them too
+	if (_useVideoEncode)
+	{
+		const uint32_t encodeScope = _gpuProfiler.begin_scope(cmd, "video encode");
+		const VkImageLayout afterEncode = _useReadback || _headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		_videoEncoder.record(cmd, _frameNumber % _frameOverlap, _frameNumber, _swapchainImages[swapchainImageIndex],
+			_swapchainImageViews[swapchainImageIndex], afterEncode);
+		_gpuProfiler.end_scope(cmd, encodeScope);
+	}
+	if (_useReadback)
+	{
+		const uint32_t readbackScope = _gpuProfiler.begin_scope(cmd, "readback");
+		_readback.record(cmd, _frameNumber % _frameOverlap, _frameNumber, _swapchainImages[swapchainImageIndex],
+			_swapchainImageViews[swapchainImageIndex], _headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+		_gpuProfiler.end_scope(cmd, readbackScope);
+	}
+	_gpuProfiler.end_scope(cmd, frameScope);
+	_debugUtils.end_label(cmd);
+	_breadcrumbs.end_pass(cmd);
+	VK_CHECK(vkEndCommandBuffer(cmd));
+
+	// prepare submission to the queue
+	// wait on the acquire semaphore, which is signaled when the swapchain is ready
+	// then signal _renderSemaphore, which indicates that rendering has finished
+
+	// headless frames acquired nothing, so they have nothing to wait for or signal but their uploads
+	VkSemaphore waitSemaphores[3] = { acquireSemaphore, VK_NULL_HANDLE, VK_NULL_HANDLE };
+	VkPipelineStageFlags waitStages[3] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0 };
+	uint64_t waitValues[3] = { 0, 0, 0 }; // the binary present semaphore ignores its value
+	uint32_t waitCount = _headless ? 0 : 1;
+
+	// the culled draws and the instances they read
+	if (cullValue != 0)
+	{
+		waitSemaphores[waitCount] = _computeTimeline;
+		waitValues[waitCount] = cullValue;
+		waitStages[waitCount] = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+		// the top-level instances are written from the scene buffer the cull submit updated
+		if (graphKey.rayShadows)
+		{
+			waitStages[waitCount] |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		}
+		waitCount++;
+	}
+
+	// uploads acquired above must have landed before their first use
+	if (_uploadManager.graphics_wait(waitSemaphores[waitCount], waitValues[waitCount], waitStages[waitCount]))
+	{
+		waitCount++;
+	}
+
+	// everything streamed through the linear allocator this frame must be visible before the GPU reads it
+	_frameGpuData.flush();
+	// and so must the draw data the recording threads wrote
+	if (frame._drawData != nullptr)
+	{
+		vmaFlushAllocation(_allocator, frame._drawDataBuffer._allocation, 0, VK_WHOLE_SIZE);
+	}
+
+	// submit command buffer to queue and execute it 
+	// this frame's timeline value (or _renderFence) now marks when the graphic commands finish execution (see beginning of frame)
+	{
+		CPU_PROFILE_SCOPE("submit");
+		frame._timelineValue = submit_graphics(cmd, waitCount, waitSemaphores, waitValues, waitStages,
+			_headless ? VK_NULL_HANDLE : frame._renderSemaphore, frame._renderFence);
+	}
+	// the encode queue picks the frame up once the graphics timeline reaches it
+	if (_useVideoEncode)
+	{
+		_videoEncoder.submit(_frameNumber % _frameOverlap, frame._timelineValue);
+	}
+
+	if (_frameNumber == 0)
+	{
+		// the streamed assets are usually still on their way; the placeholders stand in for them
+		LOG_INFO("First frame submitted " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _startupStart).count()
+			<< " ms after startup");
+	}
+
+	// headless, nothing is presented; the readback comes out once this slot's fence is next waited for
+	auto presentStart = std::chrono::high_resolution_clock::now();
+	if (_presentThread.running())
+	{
+		uint64_t presentId = 0;
+		if (_presentWaitSupported)
+		{
+			frame._presentId = ++_presentId;
+			presentId = frame._presentId;
+		}
+		_presentThread.present(swapchainImageIndex, frame._renderSemaphore, presentId);
+	}
+	else if (!_headless)
+	{
+		// display image we just rendered in the visible window!!
+		// wait for _renderSemaphore, ensuring that drawing commands finish before displaying image
+		VkPresentInfoKHR presentInfo = {};
+		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+		presentInfo.pNext = nullptr;
+	
+		presentInfo.pSwapchains = &_swapchain;
+		presentInfo.swapchainCount = 1;
+
+		presentInfo.pWaitSemaphores = &frame._renderSemaphore;
+		presentInfo.waitSemaphoreCount = 1;
+
+		presentInfo.pImageIndices = &swapchainImageIndex;
+
+#ifdef VK_KHR_present_wait
+		// lets pace_frame() wait until this frame is on screen
+		VkPresentIdKHR presentId = {};
+		if (_presentWaitSupported)
+		{
+			frame._presentId = ++_presentId;
+			presentId.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+			presentId.swapchainCount = 1;
+			presentId.pPresentIds = &frame._presentId;
+			presentInfo.pNext = &presentId;
+		}
+#endif
+		// when it's shown comes back through poll(); the frame number, which the benchmark matches it by, is its id
+		VkPresentTimesInfoGOOGLE presentTimes = {};
+		VkPresentTimeGOOGLE presentTime = {};
+		if (_displayTiming.enabled())
+		{
+			presentTime.presentID = static_cast<uint32_t>(_frameNumber + 1);
+			presentTime.desiredPresentTime = _displayTiming.desired_time(presentTime.presentID, _lowLatency);
+			DisplayTiming::chain(presentInfo, presentTimes, presentTime);
+		}
+
+		VkResult presentResult;
+		{
+			CPU_PROFILE_SCOPE("present");
+			std::lock_guard<std::mutex> lock(_deviceContext->queueMutex);
+			presentResult = vkQueuePresentKHR(_graphicsQueue, &presentInfo);
+		}
+		if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR
+			|| presentResult == VK_ERROR_FULL_SCREEN_EXCLUSIVE_MODE_LOST_EXT)
+		{
+			_resizeRequested = true;
+		}
+		else
+		{
+			check_device_result(presentResult, "vkQueuePresentKHR");
+		}
+		if (_displayTiming.enabled())
+		{
+			_displayTiming.poll();
+		}
+	}
+	auto presentEnd = std::chrono::high_resolution_clock::now();
+
+	_lastPresentMs = std::chrono::duration<double, std::milli>(acquireEnd - acquireStart).count()
+		+ std::chrono::duration<double, std::milli>(presentEnd - presentStart).count();
+
+	// taken before the timing log, which builds strings
+	_lastFrameHeap = heap_stats::snapshot() - heapAtStart;
+	_lastFrameHeapAllocations = _lastFrameHeap.total().allocations;
+	_lastFrameStats = frame_stats::collect();
+	if (_metrics.running())
+	{
+		FrameMetrics metrics;
+		metrics.presentMs = _lastPresentMs;
+		// latest() stays the same frame's until the slot comes round again
+		const GpuProfiler::FrameTimings& gpu = _gpuProfiler.latest();
+		if (gpu.frameNumber > _metricsGpuFrame && !gpu.scopes.empty())
+		{
+			metrics.gpuMs = gpu.scopes[0].milliseconds;
+			_metricsGpuFrame = gpu.frameNumber;
+		}
+		metrics.commands = _lastFrameStats;
+		metrics.objects = hudStats.objects;
+		for (uint32_t heap = 0; heap < _gpuMemory.heap_count(); heap++)
+		{
+			if (_gpuMemory.heap(heap).deviceLocal)
+			{
+				metrics.deviceLocalUsage += _gpuMemory.heap(heap).usage;
+				metrics.deviceLocalBudget += _gpuMemory.heap(heap).budget;
+			}
+		}
+		metrics.heapAllocations = _lastFrameHeapAllocations;
+		metrics.heap = _lastFrameHeap;
+		_metrics.record_frame(metrics);
+	}
+
+	if (_logGpuTimings && _gpuProfiler.latest().frameNumber >= 0)
+	{
+		LOG_INFO(_gpuProfiler.format_latest());
+	}
+	if (_logMemoryBudget)
+	{
+		LOG_INFO(_gpuMemory.format());
+	}
+	
+	// for our clear color animation
+	_frameNumber++;
+}
+
+void VulkanEngine::build_frame_graph(const FrameGraphKey& key, DeletionQueue& retired)
+{
+	CPU_PROFILE_SCOPE("build_frame_graph");
+	_frameGraph.reset();
+	_frameGraphKey = key;
+	// the old graph's views are retired with the slot; no set may outlive them
+	_descriptorSetCache.invalidate();
+	// the render passes and formats cached secondaries continue may be different ones now
+	_staticDrawGeneration++;
+
+	// with stereo the scene's targets have a layer per eye, each half the window wide
+	const VkExtent2D sceneExtent = scene_extent();
+	const uint32_t sceneLayers = _useStereo ? 2 : 1;
+	const uint32_t viewMask = main_view_mask();
+
+	// the acquire semaphore is waited on at color output, so that's what the first transition waits for.
+	// Images read back or encoded end up copied into their readback buffer or encoder first
+	_graphSwapchain = _frameGraph.import_image("swapchain", _swapchainImageFormat, _windowExtent, VK_IMAGE_ASPECT_COLOR_BIT,
+		{ VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0 },
+		_useReadback || _useVideoEncode ? RenderGraphAccess::TransferSrc : RenderGraphAccess::Present);
+	// only the depth pyramid reads depth outside the render passes, and it needs an image that outlives the
+	// graph, since its descriptors point at it. Without it depth is the graph's own: cleared, never stored,
+	// and on tile-based GPUs never backed by memory at all
+	if (key.occlusion)
+	{
+		// cleared every frame, once the last frame's depth tests and pyramid build are done with it
+		_graphDepth = _frameGraph.import_image("depth", _depthFormat, _windowExtent, VK_IMAGE_ASPECT_DEPTH_BIT,
+			{ VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT }, RenderGraphAccess::Undefined);
+	}
+	else
+	{
+		_graphDepth = _frameGraph.create_image("depth", { _depthFormat, sceneExtent, VK_IMAGE_ASPECT_DEPTH_BIT, 0, _msaaSamples, sceneLayers });
+	}
+	// the last frame's rates, rewritten once this frame's scene is done with them
+	if (key.shadingRate)
+	{
+		_graphShadingRate = _frameGraph.import_image("shading_rate", ShadingRateImage::FORMAT, _shadingRateImage.extent(), VK_IMAGE_ASPECT_COLOR_BIT,
+			RenderGraphState::of(RenderGraphAccess::StorageCompute), RenderGraphAccess::StorageCompute);
+	}
+	// with dynamic resolution the meshes render into part of a target of their own, blitted to the swapchain
+	// at the end, and with post-processing into the HDR target the chain starts from. With MSAA they render
+	// into samples that are resolved into that target inside the pass, so they are never stored either
+	_graphSceneColor = _graphSwapchain;
+	if (key.postProcess)
+	{
+		_graphSceneColor = _frameGraph.create_image("hdr_color", { _sceneColorFormat, _windowExtent, VK_IMAGE_ASPECT_COLOR_BIT });
+	}
+	else if (key.dynamicResolution)
+	{
+		_graphSceneColor = _frameGraph.create_image("scene_color", { _sceneColorFormat, _windowExtent, VK_IMAGE_ASPECT_COLOR_BIT });
+	}
+	else if (_useStereo)
+	{
+		_graphSceneColor = _frameGraph.create_image("eye_color", { _sceneColorFormat, sceneExtent, VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_SAMPLE_COUNT_1_BIT, sceneLayers });
+	}
+	RenderGraphResource color = _graphSceneColor;
+	if (_msaaSamples != VK_SAMPLE_COUNT_1_BIT)
+	{
+		color = _frameGraph.create_image("color_msaa", { _sceneColorFormat, sceneExtent, VK_IMAGE_ASPECT_COLOR_BIT, 0, _msaaSamples, sceneLayers });
+	}
+
+	// poses the characters before any pass draws them, culling included, since the indirect commands
+	// carry their vertex offsets. It synchronizes its own buffers like the passes below
+	if (!_characters.empty())
+	{
+		uint32_t skinning = _frameGraph.add_pass("skinning", [this](const RenderGraph::PassContext& context) {
+			_skinning.record(context.cmd, _frameNumber % _frameOverlap, _skinDispatches.data(), static_cast<uint32_t>(_skinDispatches.size()),
+				_vertexReadStages, _vertexReadAccess);
+		});
+		_frameGraph.keep(skinning);
+	}
+
+	// the cull dispatches and the shadow cascades synchronize their own buffers and images, so these
+	// passes declare nothing and are simply kept
+	if (key.indirect && !key.asyncCulling)
+	{
+		uint32_t culling = _frameGraph.add_pass("culling", [this](const RenderGraph::PassContext& context) {
+			prepare_indirect_draws(context.cmd, *_graphInputs.frame, _graphInputs.cameraOffset, _renderables.data(),
+				static_cast<int>(_renderables.size()));
+			_lastCullOnCompute = false;
+		});
+		_frameGraph.keep(culling);
+	}
+
+	// synchronizes its own buffers too
+	if (key.particles)
+	{
+		uint32_t particles = _frameGraph.add_pass("particles", [this](const RenderGraph::PassContext& context) {
+			_particles.update(context.cmd, _particleEmitter, _graphInputs.particleDeltaTime);
+		});
+		_frameGraph.keep(particles);
+	}
+
+	// the light lists follow the camera, so they are rebuilt before anything shades with them
+	if (key.clusteredLights)
+	{
+		uint32_t lights = _frameGraph.add_pass("lights", [this](const RenderGraph::PassContext& context) {
+			_clusteredLights.record(context.cmd, _frameNumber % _frameOverlap, _frameGpuData, _lights.data(), static_cast<uint32_t>(_lights.size()), _camera);
+		});
+		_frameGraph.keep(lights);
+	}
+
+	// static cascades only when they moved, then this frame's dynamic casters over them
+	if (key.shadows)
+	{
+		uint32_t shadows = _frameGraph.add_pass("shadows", [this](const RenderGraph::PassContext& context) {
+			_shadows.record(context.cmd, [this](VkCommandBuffer cmd, uint32_t cascade, bool staticCasters) {
+				draw_shadow_casters(cmd, cascade, staticCasters);
+			});
+		});
+		_frameGraph.keep(shadows);
+	}
+
+	// the color clear is set every frame
+	VkClearValue colorClear = {};
+	VkClearValue depthClear = {};
+	depthClear.depthStencil.depth = _camera.far_depth();
+
+	// the pre-pass the main pass would draw first becomes a pass of its own, so the rays can start from
+	// its depth before anything is shaded
+	if (key.rayShadows)
+	{
+		// this frame's new meshes and the scene as the cull pass uploaded it; synchronizes its own buffers
+		uint32_t structures = _frameGraph.add_pass("acceleration_structures", [this](const RenderGraph::PassContext& context) {
+			const uint32_t frame = _frameNumber % _frameOverlap;
+			_accelerationStructures.record_builds(context.cmd, frame);
+			_accelerationStructures.record_tlas(context.cmd, frame, _gpuScene.size(), _gpuScene.last_upload_bytes() != 0);
+		});
+		_frameGraph.keep(structures);
+
+		_graphDepthPrepass = _frameGraph.add_pass("depth_prepass", [this](const RenderGraph::PassContext& context) {
+			bind_mesh_state(context.cmd, _graphInputs.cameraOffset);
+			draw_objects_indirect(context.cmd, *_graphInputs.frame, 0, true);
+		});
+		_frameGraph.set_view_mask(_graphDepthPrepass, viewMask);
+		_frameGraph.color_attachment(_graphDepthPrepass, color, VK_ATTACHMENT_LOAD_OP_CLEAR, colorClear);
+		_frameGraph.depth_attachment(_graphDepthPrepass, _graphDepth, VK_ATTACHMENT_LOAD_OP_CLEAR, depthClear);
+		if (key.shadingRate)
+		{
+			_frameGraph.shading_rate_attachment(_graphDepthPrepass, _graphShadingRate, _shadingRateImage.texel_size());
+		}
+
+		// read by the last frame's meshes until this frame's trace overwrites it
+		_graphRayShadows = _frameGraph.import_image("ray_shadow_mask", RayShadows::FORMAT, _rayShadows.extent(), VK_IMAGE_ASPECT_COLOR_BIT,
+			RenderGraphState::of(RenderGraphAccess::SampledFragment), RenderGraphAccess::SampledFragment);
+		uint32_t trace = _frameGraph.add_pass("ray_shadows", [this](const RenderGraph::PassContext& context) {
+			// the projection the depth was rendered with, jitter and all
+			_rayShadows.record(context.cmd, _frameNumber % _frameOverlap, _accelerationStructures, _frameGraph.view(_graphDepth), _renderExtent,
+				glm::inverse(_camera.view_projection()), glm::normalize(_lightDirection), _camera.far_depth());
+		});
+		_frameGraph.read(trace, _graphDepth, RenderGraphAccess::SampledCompute);
+		_frameGraph.write(trace, _graphRayShadows, RenderGraphAccess::StorageCompute);
+	}
+
+	// the grass's draws, from the terrain nodes this frame selected; synchronizes its own buffers. With occlusion
+	// culling it waits for the pyramid instead and is drawn with the late meshes
+	if (key.foliage && !key.occlusion)
+	{
+		uint32_t foliage = _frameGraph.add_pass("foliage", [this](const RenderGraph::PassContext& context) {
+			_foliage.record(context.cmd);
+		});
+		_frameGraph.keep(foliage);
+	}
+
+	// both eyes at once with stereo: one cull, one recording, the GPU repeating each draw per view
+	_graphMainPass = _frameGraph.add_pass("meshes", [this](const RenderGraph::PassContext& context) {
+		draw_main_pass(context);
+	});
+	_frameGraph.set_view_mask(_graphMainPass, viewMask);
+	const VkAttachmentLoadOp mainLoadOp = key.rayShadows ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+	_frameGraph.color_attachment(_graphMainPass, color, mainLoadOp, colorClear);
+	_frameGraph.depth_attachment(_graphMainPass, _graphDepth, mainLoadOp, depthClear);
+	if (key.rayShadows)
+	{
+		_frameGraph.read(_graphMainPass, _graphRayShadows, RenderGraphAccess::SampledFragment);
+	}
+	if (color != _graphSceneColor)
+	{
+		_frameGraph.resolve_attachment(_graphMainPass, color, _graphSceneColor);
+	}
+	if (key.shadingRate)
+	{
+		_frameGraph.shading_rate_attachment(_graphMainPass, _graphShadingRate, _shadingRateImage.texel_size());
+	}
+
+	// the boxes against the opaque depth, which nothing after changes, and their results copied out after
+	// the pass for the next frame's draws
+	if (key.occlusionQueries)
+	{
+		_graphOcclusionQueryPass = _frameGraph.add_pass("occlusion_queries", [this](const RenderGraph::PassContext& context) {
+			draw_occlusion_queries(context.cmd, _graphInputs.cameraOffset);
+		});
+		_frameGraph.color_attachment(_graphOcclusionQueryPass, color, VK_ATTACHMENT_LOAD_OP_LOAD);
+		_frameGraph.depth_attachment(_graphOcclusionQueryPass, _graphDepth, VK_ATTACHMENT_LOAD_OP_LOAD, {}, true);
+		if (color != _graphSceneColor)
+		{
+			_frameGraph.resolve_attachment(_graphOcclusionQueryPass, color, _graphSceneColor);
+		}
+		if (key.shadingRate)
+		{
+			_frameGraph.shading_rate_attachment(_graphOcclusionQueryPass, _graphShadingRate, _shadingRateImage.texel_size());
+		}
+		// writes nothing anything reads, but the queries are its point
+		_frameGraph.keep(_graphOcclusionQueryPass);
+
+		// synchronizes its own buffer
+		uint32_t predicates = _frameGraph.add_pass("occlusion_predicates", [this](const RenderGraph::PassContext& context) {
+			_occlusionPredicates.resolve(context.cmd);
+		});
+		_frameGraph.keep(predicates);
+	}
+
+	if (key.occlusion)
+	{
+		// the first phase's depth is final; the pyramid is rebuilt from it every time, so it isn't a graph resource
+		uint32_t pyramid = _frameGraph.add_pass("depth_pyramid", [this](const RenderGraph::PassContext& context) {
+			_depthPyramid.build(context.cmd);
+		});
+		_frameGraph.read(pyramid, _graphDepth, RenderGraphAccess::SampledCompute);
+		_frameGraph.keep(pyramid);
+
+		// HiZ tested against the first phase's depth, the terrain's included
+		if (key.foliage)
+		{
+			uint32_t foliage = _frameGraph.add_pass("foliage", [this](const RenderGraph::PassContext& context) {
+				_foliage.record(context.cmd);
+			});
+			_frameGraph.keep(foliage);
+		}
+
+		uint32_t occlusionCull = _frameGraph.add_pass("occlusion_culling", [this](const RenderGraph::PassContext& context) {
+			FrameData& frame = *_graphInputs.frame;
+			// the second phase reads the first one's instance counts; the pyramid build already ordered it
+			// after the first phase's visibility reads
+			VkBufferMemoryBarrier countBarrier = vkinit::buffer_barrier(frame._indirectBuffer._buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+			vkCmdPipelineBarrier(context.cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &countBarrier, 0, nullptr);
+
+			dispatch_cull(context.cmd, frame, _graphInputs.cameraOffset, 1);
+		});
+		_frameGraph.keep(occlusionCull);
+
+		// draws the newly visible objects on top of the first phase
+		uint32_t lateMeshes = _frameGraph.add_pass("late_meshes", [this](const RenderGraph::PassContext& context) {
+			bind_mesh_state(context.cmd, _graphInputs.cameraOffset);
+			if (_depthPrepass)
+			{
+				draw_objects_indirect(context.cmd, *_graphInputs.frame, 1, true);
+			}
+			draw_objects_indirect(context.cmd, *_graphInputs.frame, 1);
+			draw_foliage(context.cmd, _graphInputs.cameraOffset);
+			// after every mesh, so the late ones don't cover sparks in front of them
+			if (_frameGraphKey.particles)
+			{
+				draw_particles(context.cmd, _graphInputs.cameraOffset);
+			}
+		});
+		_frameGraph.color_attachment(lateMeshes, color, VK_ATTACHMENT_LOAD_OP_LOAD);
+		_frameGraph.depth_attachment(lateMeshes, _graphDepth, VK_ATTACHMENT_LOAD_OP_LOAD);
+		if (color != _graphSceneColor)
+		{
+			_frameGraph.resolve_attachment(lateMeshes, color, _graphSceneColor);
+		}
+		if (key.shadingRate)
+		{
+			_frameGraph.shading_rate_attachment(lateMeshes, _graphShadingRate, _shadingRateImage.texel_size());
+		}
+	}
+
+	// over every opaque pass, the late meshes included, and under the debug lines, which stay readable through
+	// the glass. Depth is tested, never written; sorted, the objects are blended straight onto the scene, and
+	// weighted blended into targets of their own that a second pass composites onto it
+	if (key.transparent)
+	{
+		const bool weightedBlended = key.weightedBlended;
+		_graphTransparentPass = _frameGraph.add_pass("transparent", [this, weightedBlended](const RenderGraph::PassContext& context) {
+			draw_transparent(context.cmd, _graphInputs.cameraOffset, weightedBlended);
+		});
+		_frameGraph.set_view_mask(_graphTransparentPass, viewMask);
+		if (weightedBlended)
+		{
+			// sums start from nothing: no color, and -log(1) for nothing hidden
+			const VkClearValue zero = {};
+			_graphOitAccumulation = _frameGraph.create_image("oit_accumulation", { OIT_ACCUMULATION_FORMAT, _windowExtent, VK_IMAGE_ASPECT_COLOR_BIT });
+			_graphOitRevealage = _frameGraph.create_image("oit_revealage", { OIT_REVEALAGE_FORMAT, _windowExtent, VK_IMAGE_ASPECT_COLOR_BIT });
+			_frameGraph.color_attachment(_graphTransparentPass, _graphOitAccumulation, VK_ATTACHMENT_LOAD_OP_CLEAR, zero);
+			_frameGraph.color_attachment(_graphTransparentPass, _graphOitRevealage, VK_ATTACHMENT_LOAD_OP_CLEAR, zero);
+			_frameGraph.depth_attachment(_graphTransparentPass, _graphDepth, VK_ATTACHMENT_LOAD_OP_LOAD, {}, true);
+			if (key.shadingRate)
+			{
+				_frameGraph.shading_rate_attachment(_graphTransparentPass, _graphShadingRate, _shadingRateImage.texel_size());
+			}
+
+			// single-sampled, so color is the scene color itself
+			_graphOitCompositePass = _frameGraph.add_pass("oit_composite", [this](const RenderGraph::PassContext& context) {
+				draw_oit_composite(context.cmd);
+			});
+			_frameGraph.read(_graphOitCompositePass, _graphOitAccumulation, RenderGraphAccess::SampledFragment);
+			_frameGraph.read(_graphOitCompositePass, _graphOitRevealage, RenderGraphAccess::SampledFragment);
+			_frameGraph.color_attachment(_graphOitCompositePass, color, VK_ATTACHMENT_LOAD_OP_LOAD);
+			_frameGraph.depth_attachment(_graphOitCompositePass, _graphDepth, VK_ATTACHMENT_LOAD_OP_LOAD, {}, true);
+			if (key.shadingRate)
+			{
+				_frameGraph.shading_rate_attachment(_graphOitCompositePass, _graphShadingRate, _shadingRateImage.texel_size());
+			}
+		}
+		else
+		{
+			_frameGraph.color_attachment(_graphTransparentPass, color, VK_ATTACHMENT_LOAD_OP_LOAD);
+			_frameGraph.depth_attachment(_graphTransparentPass, _graphDepth, VK_ATTACHMENT_LOAD_OP_LOAD, {}, true);
+			if (color != _graphSceneColor)
+			{
+				_frameGraph.resolve_attachment(_graphTransparentPass, color, _graphSceneColor);
+			}
+			if (key.shadingRate)
+			{
+				_frameGraph.shading_rate_attachment(_graphTransparentPass, _graphShadingRate, _shadingRateImage.texel_size());
+			}
+		}
+	}
+
+	// over everything the scene drew and before post-processing, so the lines get its exposure like the scene
+	if (key.debugDraw)
+	{
+		_graphDebugPass = _frameGraph.add_pass("debug_lines", [this](const RenderGraph::PassContext& context) {
+			draw_debug_lines(context.cmd, _graphInputs.cameraOffset);
+		});
+		_frameGraph.set_view_mask(_graphDebugPass, viewMask);
+		_frameGraph.color_attachment(_graphDebugPass, color, VK_ATTACHMENT_LOAD_OP_LOAD);
+		_frameGraph.depth_attachment(_graphDebugPass, _graphDepth, VK_ATTACHMENT_LOAD_OP_LOAD);
+		if (color != _graphSceneColor)
+		{
+			_frameGraph.resolve_attachment(_graphDebugPass, color, _graphSceneColor);
+		}
+		if (key.shadingRate)
+		{
+			_frameGraph.shading_rate_attachment(_graphDebugPass, _graphShadingRate, _shadingRateImage.texel_size());
+		}
+	}
+
+	// next frame's rates from the scene as it rendered, before post-processing adds bloom and noise of its own
+	if (key.shadingRate)
+	{
+		uint32_t rates = _frameGraph.add_pass("shading_rate", [this](const RenderGraph::PassContext& context) {
+			_shadingRateImage.record(context.cmd, _frameNumber % _frameOverlap, _frameGraph.view(_graphSceneColor), _renderExtent,
+				_graphInputs.cameraMotion);
+		});
+		_frameGraph.read(rates, _graphSceneColor, RenderGraphAccess::SampledCompute);
+		_frameGraph.write(rates, _graphShadingRate, RenderGraphAccess::StorageCompute);
+	}
+
+	// the render-sized scene accumulated into the window-sized history, ahead of the post chain so that
+	// tonemapping and FXAA see the full resolution image. The image written last frame is read, and the
+	// other one only needs to wait for that frame's reads before this one overwrites it
+	RenderGraphResource scene = _graphSceneColor;
+	if (key.temporalUpscale)
+	{
+		_graphUpscaleHistory = _frameGraph.import_image("upscale_history", TemporalUpscaler::FORMAT, _windowExtent, VK_IMAGE_ASPECT_COLOR_BIT,
+			RenderGraphState::of(RenderGraphAccess::SampledCompute), RenderGraphAccess::SampledCompute);
+		_graphUpscaleOutput = _frameGraph.import_image("upscale_output", TemporalUpscaler::FORMAT, _windowExtent, VK_IMAGE_ASPECT_COLOR_BIT,
+			{ VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0 }, RenderGraphAccess::SampledCompute);
+
+		uint32_t upscale = _frameGraph.add_pass("temporal_upscale", [this](const RenderGraph::PassContext& context) {
+			_temporalUpscaler.record(context.cmd, _frameNumber % _frameOverlap, _frameGraph.view(_graphSceneColor), _frameGraph.view(_graphDepth),
+				_renderExtent, _graphInputs.jitter, _graphInputs.reprojection);
+		});
+		_frameGraph.read(upscale, _graphSceneColor, RenderGraphAccess::SampledCompute);
+		_frameGraph.read(upscale, _graphDepth, RenderGraphAccess::SampledCompute);
+		_frameGraph.read(upscale, _graphUpscaleHistory, RenderGraphAccess::SampledCompute);
+		_frameGraph.write(upscale, _graphUpscaleOutput, RenderGraphAccess::StorageCompute);
+		scene = _graphUpscaleOutput;
+	}
+
+	// the extra views, each from its slice of the cull into its own target, which stays sampleable after the frame
+	const uint32_t sceneViews = key.indirect ? _sceneViews.count() : 0;
+	for (uint32_t v = 0; v < sceneViews; v++)
+	{
+		const VkExtent2D viewExtent = _sceneViews.extent();
+		_graphViewColor[v] = _frameGraph.import_image("view_color", _sceneViews.format(), viewExtent, VK_IMAGE_ASPECT_COLOR_BIT,
+			{ VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0 }, RenderGraphAccess::SampledFragment);
+		RenderGraphResource viewColor = _graphViewColor[v];
+		if (_msaaSamples != VK_SAMPLE_COUNT_1_BIT)
+		{
+			viewColor = _frameGraph.create_image("view_color_msaa", { _sceneColorFormat, viewExtent, VK_IMAGE_ASPECT_COLOR_BIT, 0, _msaaSamples });
+		}
+		RenderGraphResource viewDepth = _frameGraph.create_image("view_depth", { _depthFormat, viewExtent, VK_IMAGE_ASPECT_DEPTH_BIT, 0, _msaaSamples });
+
+		uint32_t viewPass = _frameGraph.add_pass("scene_view", [this, v](const RenderGraph::PassContext& context) {
+			draw_scene_view(context.cmd, v);
+		});
+		_frameGraph.color_attachment(viewPass, viewColor, VK_ATTACHMENT_LOAD_OP_CLEAR, colorClear);
+		_frameGraph.depth_attachment(viewPass, viewDepth, VK_ATTACHMENT_LOAD_OP_CLEAR, depthClear);
+		if (viewColor != _graphViewColor[v])
+		{
+			_frameGraph.resolve_attachment(viewPass, viewColor, _graphViewColor[v]);
+		}
+	}
+
+	// the overdraw view: the opaque meshes of both cull phases counted over a cleared target, after everything
+	// else drew, and a heat map of the counts presented in place of the scene
+	if (key.overdraw)
+	{
+		_graphOverdrawCounts = _frameGraph.create_image("overdraw_counts", { _overdrawFormat, _windowExtent, VK_IMAGE_ASPECT_COLOR_BIT });
+		_graphOverdrawHeat = _frameGraph.create_image("overdraw_heat", { OverdrawView::HEAT_FORMAT, _windowExtent, VK_IMAGE_ASPECT_COLOR_BIT });
+
+		_graphOverdrawPass = _frameGraph.add_pass("overdraw", [this](const RenderGraph::PassContext& context) {
+			bind_mesh_state(context.cmd, _graphInputs.cameraOffset);
+			draw_objects_indirect(context.cmd, *_graphInputs.frame, 0, true, _overdrawPipelines);
+			if (_frameGraphKey.occlusion)
+			{
+				draw_objects_indirect(context.cmd, *_graphInputs.frame, 1, true, _overdrawPipelines);
+			}
+		});
+		_frameGraph.color_attachment(_graphOverdrawPass, _graphOverdrawCounts, VK_ATTACHMENT_LOAD_OP_CLEAR);
+
+		uint32_t heat = _frameGraph.add_pass("overdraw_heat", [this](const RenderGraph::PassContext& context) {
+			_overdraw.record(context.cmd, _frameNumber % _frameOverlap, _frameNumber, _frameGraph.view(_graphOverdrawCounts),
+				_frameGraph.view(_graphOverdrawHeat), _renderExtent);
+		});
+		_frameGraph.read(heat, _graphOverdrawCounts, RenderGraphAccess::SampledCompute);
+		_frameGraph.write(heat, _graphOverdrawHeat, RenderGraphAccess::StorageCompute);
+	}
+
+	// object picking: the opaque meshes of both cull phases over the picked rectangle, nearest first, and the
+	// rectangle copied out for ObjectPicker; both record nothing in frames without a pick
+	if (key.picking)
+	{
+		const VkExtent2D region = { ObjectPicker::REGION, ObjectPicker::REGION };
+		_graphPickIds = _frameGraph.create_image("pick_ids", { ObjectPicker::ID_FORMAT, region, VK_IMAGE_ASPECT_COLOR_BIT });
+		RenderGraphResource pickDepth = _frameGraph.create_image("pick_depth", { _depthFormat, region, VK_IMAGE_ASPECT_DEPTH_BIT });
+
+		_graphPickPass = _frameGraph.add_pass("pick", [this](const RenderGraph::PassContext& context) {
+			if (!_objectPicker.active())
+			{
+				return;
+			}
+			bind_mesh_state(context.cmd, _graphInputs.cameraOffset, _objectPicker.extent());
+			const VkViewport viewport = _objectPicker.viewport();
+			vkCmdSetViewport(context.cmd, 0, 1, &viewport);
+			const VkDeviceSize offset = 0;
+			vkCmdBindVertexBuffers(context.cmd, 3, 1, &_graphInputs.frame->_instanceObjectBuffer._buffer, &offset);
+			draw_objects_indirect(context.cmd, *_graphInputs.frame, 0, true, _pickPipelines);
+			if (_frameGraphKey.occlusion)
+			{
+				draw_objects_indirect(context.cmd, *_graphInputs.frame, 1, true, _pickPipelines);
+			}
+		});
+		_frameGraph.color_attachment(_graphPickPass, _graphPickIds, VK_ATTACHMENT_LOAD_OP_CLEAR);
+		_frameGraph.depth_attachment(_graphPickPass, pickDepth, VK_ATTACHMENT_LOAD_OP_CLEAR, depthClear);
+
+		uint32_t pickCopy = _frameGraph.add_pass("pick_readback", [this](const RenderGraph::PassContext& context) {
+			if (_objectPicker.active())
+			{
+				_objectPicker.record(context.cmd, _frameNumber % _frameOverlap, _frameNumber, _frameGraph.image(_graphPickIds));
+			}
+		});
+		_frameGraph.read(pickCopy, _graphPickIds, RenderGraphAccess::TransferSrc);
+		_frameGraph.keep(pickCopy);
+	}
+
+	// what ends up in the swapchain image: the scene, what the post chain made of it, or the overdraw heat map
+	RenderGraphResource presented = scene;
+	if (key.overdraw)
+	{
+		presented = _graphOverdrawHeat;
+	}
+	else if (key.postProcess && _postProcess.ready())
+	{
+		presented = add_post_passes(scene, key.temporalUpscale);
+	}
+
+	if (_useStereo)
+	{
+		// the eyes side by side, for want of a headset to hand them to; a layer each, at the same size
+		uint32_t eyes = _frameGraph.add_pass("stereo_present", [this, presented, sceneExtent](const RenderGraph::PassContext& context) {
+			VkImageBlit blits[2] = {};
+			for (uint32_t eye = 0; eye < 2; eye++)
+			{
+				const int32_t left = static_cast<int32_t>(eye * sceneExtent.width);
+				blits[eye].srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, eye, 1 };
+				blits[eye].srcOffsets[1] = { static_cast<int32_t>(sceneExtent.width), static_cast<int32_t>(sceneExtent.height), 1 };
+				blits[eye].dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+				blits[eye].dstOffsets[0] = { left, 0, 0 };
+				blits[eye].dstOffsets[1] = { left + static_cast<int32_t>(sceneExtent.width), static_cast<int32_t>(sceneExtent.height), 1 };
+			}
+			vkCmdBlitImage(context.cmd, _frameGraph.image(presented), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				_frameGraph.image(_graphSwapchain), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 2, blits, VK_FILTER_NEAREST);
+		});
+		_frameGraph.read(eyes, presented, RenderGraphAccess::TransferSrc);
+		_frameGraph.write(eyes, _graphSwapchain, RenderGraphAccess::TransferDst);
+	}
+	else if (presented != _graphSwapchain)
+	{
+		// bilinear, from the part the meshes rendered to all of the swapchain image; converts HDR to its format too.
+		// The upscaler's output already covers all of it; the heat map is only ever render-sized
+		const bool upscaled = key.temporalUpscale && !key.overdraw;
+		uint32_t upscale = _frameGraph.add_pass(key.dynamicResolution && !upscaled ? "upscale" : "present_copy", [this, presented, upscaled](const RenderGraph::PassContext& context) {
+			const VkExtent2D source = upscaled ? _windowExtent : _renderExtent;
+			VkImageBlit blit = {};
+			blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			blit.srcOffsets[1] = { static_cast<int32_t>(source.width), static_cast<int32_t>(source.height), 1 };
+			blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			blit.dstOffsets[1] = { static_cast<int32_t>(_windowExtent.width), static_cast<int32_t>(_windowExtent.height), 1 };
+			vkCmdBlitImage(context.cmd, _frameGraph.image(presented), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				_frameGraph.image(_graphSwapchain), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+		});
+		_frameGraph.read(upscale, presented, RenderGraphAccess::TransferSrc);
+		_frameGraph.write(upscale, _graphSwapchain, RenderGraphAccess::TransferDst);
+	}
+
+	// over the finished frame, down its right edge; only where the swapchain takes blits
+	if (sceneViews > 0 && _dynamicResolutionSupported)
+	{
+		uint32_t composite = _frameGraph.add_pass("scene_views", [this, sceneViews](const RenderGraph::PassContext& context) {
+			const VkExtent2D viewExtent = _sceneViews.extent();
+			for (uint32_t v = 0; v < sceneViews; v++)
+			{
+				const VkRect2D rect = _sceneViews.window_rect(v, _windowExtent);
+				VkImageBlit blit = {};
+				blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+				blit.srcOffsets[1] = { static_cast<int32_t>(viewExtent.width), static_cast<int32_t>(viewExtent.height), 1 };
+				blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+				blit.dstOffsets[0] = { rect.offset.x, rect.offset.y, 0 };
+				blit.dstOffsets[1] = { rect.offset.x + static_cast<int32_t>(rect.extent.width), rect.offset.y + static_cast<int32_t>(rect.extent.height), 1 };
+				vkCmdBlitImage(context.cmd, _frameGraph.image(_graphViewColor[v]), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					_frameGraph.image(_graphSwapchain), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+			}
+		});
+		for (uint32_t v = 0; v < sceneViews; v++)
+		{
+			_frameGraph.read(composite, _graphViewColor[v], RenderGraphAccess::TransferSrc);
+		}
+		_frameGraph.write(composite, _graphSwapchain, RenderGraphAccess::TransferDst);
+	}
+
+	// over the finished frame, views and all, at the window's resolution; the HUD draws over it last
+	if (key.text)
+	{
+		_graphTextPass = _frameGraph.add_pass("text", [this](const RenderGraph::PassContext& context) {
+			draw_text(context.cmd, context.extent);
+		});
+		_frameGraph.color_attachment(_graphTextPass, _graphSwapchain, VK_ATTACHMENT_LOAD_OP_LOAD);
+	}
+	if (key.hud)
+	{
+		const uint32_t hudPass = _frameGraph.add_pass("hud", [this](const RenderGraph::PassContext& context) {
+			bind_graphics_pipeline(context.cmd, _hudPipeline);
+			_hud.draw(context.cmd, _hudPipelineLayout, _frameGpuData, context.extent);
+		});
+		_frameGraph.color_attachment(hudPass, _graphSwapchain, VK_ATTACHMENT_LOAD_OP_LOAD);
+	}
+
+	_frameGraph.compile(retired);
+}
+
+RenderGraphResource VulkanEngine::add_post_passes(RenderGraphResource scene, bool upscaled)
+{
+	const PostProcessSettings& settings = _postProcess.settings();
+	const VkExtent2D bloomExtent = PostProcess::bloom_extent(_windowExtent);
+
+	// each kernel covers the part of its images the scene rendered to, which dynamic resolution changes
+	// every frame unless the scene was upscaled, and rewrites its set of the frame slot being recorded
+	auto add_kernel = [this, upscaled](const char* name, PostProcess::Kernel kernel, RenderGraphResource source, VkExtent2D sourceExtent,
+		RenderGraphResource secondary, VkExtent2D secondaryExtent, RenderGraphResource output, bool halfSize) {
+		uint32_t pass = _frameGraph.add_pass(name, [=](const RenderGraph::PassContext& context) {
+			const VkExtent2D sceneRegion = upscaled ? _windowExtent : _renderExtent;
+			const VkExtent2D region = halfSize ? PostProcess::bloom_extent(sceneRegion) : sceneRegion;
+			const VkImageView secondaryView = secondary != INVALID_GRAPH_RESOURCE ? _frameGraph.view(secondary) : VK_NULL_HANDLE;
+			_postProcess.record(context.cmd, kernel, _frameNumber % _frameOverlap, _frameGraph.view(source), sourceExtent,
+				secondaryView, secondaryExtent, _frameGraph.view(output), region);
+		});
+		_frameGraph.read(pass, source, RenderGraphAccess::SampledCompute);
+		if (secondary != INVALID_GRAPH_RESOURCE)
+		{
+			_frameGraph.read(pass, secondary, RenderGraphAccess::SampledCompute);
+		}
+		_frameGraph.write(pass, output, RenderGraphAccess::StorageCompute);
+	};
+
+	// the blur goes out to the second image and back
+	RenderGraphResource bloom = INVALID_GRAPH_RESOURCE;
+	if (settings.bloom)
+	{
+		bloom = _frameGraph.create_image("bloom", { PostProcess::HDR_FORMAT, bloomExtent, VK_IMAGE_ASPECT_COLOR_BIT });
+		RenderGraphResource bloomBlur = _frameGraph.create_image("bloom_blur", { PostProcess::HDR_FORMAT, bloomExtent, VK_IMAGE_ASPECT_COLOR_BIT });
+		add_kernel("bloom_downsample", PostProcess::BloomDownsample, scene, _windowExtent, INVALID_GRAPH_RESOURCE, {}, bloom, true);
+		add_kernel("bloom_blur_x", PostProcess::BloomBlurX, bloom, bloomExtent, INVALID_GRAPH_RESOURCE, {}, bloomBlur, true);
+		add_kernel("bloom_blur_y", PostProcess::BloomBlurY, bloomBlur, bloomExtent, INVALID_GRAPH_RESOURCE, {}, bloom, true);
+	}
+
+	RenderGraphResource composite = _frameGraph.create_image("post_color", { PostProcess::HDR_FORMAT, _windowExtent, VK_IMAGE_ASPECT_COLOR_BIT });
+	add_kernel("post_composite", PostProcess::Composite, scene, _windowExtent, bloom, bloomExtent, composite, false);
+	if (!settings.fxaa)
+	{
+		return composite;
+	}
+
+	RenderGraphResource antialiased = _frameGraph.create_image("post_fxaa", { PostProcess::HDR_FORMAT, _windowExtent, VK_IMAGE_ASPECT_COLOR_BIT });
+	add_kernel("fxaa", PostProcess::Fxaa, composite, _windowExtent, INVALID_GRAPH_RESOURCE, {}, antialiased, false);
+	return antialiased;
+}
+
+void VulkanEngine::draw_main_pass(const RenderGraph::PassContext& context)
+{
+	VkCommandBuffer cmd = context.cmd;
+	FrameData& frame = *_graphInputs.frame;
+	const uint32_t cameraOffset = _graphInputs.cameraOffset;
+	RenderObject* visible = _graphInputs.visible;
+	const uint32_t visibleCount = _graphInputs.visibleCount;
+
+	// a subpass recorded through secondaries can't contain anything else; the static objects go first, the
+	// rest follows in one buffer per recording thread, the particles last
+	if (_graphInputs.cacheStaticDraws)
+	{
+		VkCommandBuffer buffers[MAX_RECORD_THREADS + 1];
+		buffers[0] = static_draws(frame, context, cameraOffset);
+		uint32_t secondaryCount = record_draws_parallel(frame, context, cameraOffset, visible, visibleCount,
+			_graphInputs.parallelRecording ? MAX_RECORD_THREADS : 1);
+		for (uint32_t t = 0; t < secondaryCount; t++)
+		{
+			buffers[1 + t] = frame._secondaryBuffers[t];
+		}
+		vkCmdExecuteCommands(cmd, 1 + secondaryCount, buffers);
+		return;
+	}
+	if (_graphInputs.parallelRecording)
+	{
+		uint32_t secondaryCount = record_draws_parallel(frame, context, cameraOffset, visible, visibleCount);
+		vkCmdExecuteCommands(cmd, secondaryCount, frame._secondaryBuffers);
+		return;
+	}
+
+	bind_mesh_state(cmd, cameraOffset);
+	if (_graphInputs.instanceCount > 1)
+	{
+		draw_crowd(cmd, frame, _graphInputs.instanceCount, _graphInputs.modelAngle);
+	}
+	else if (_frameGraphKey.indirect)
+	{
+		// with ray shadows the depth_prepass pass drew it already
+		if (_depthPrepass && !_frameGraphKey.rayShadows)
+		{
+			draw_objects_indirect(cmd, frame, 0, true);
+		}
+		draw_objects_indirect(cmd, frame, 0);
+	}
+	else
+	{
+		if (_depthPrepass)
+		{
+			draw_objects(cmd, visible, static_cast<int>(visibleCount), true);
+		}
+		draw_objects(cmd, visible, static_cast<int>(visibleCount));
+		draw_meshlets(cmd, cameraOffset, visible, static_cast<int>(visibleCount));
+		draw_impostors(cmd, cameraOffset);
+	}
+	draw_terrain(cmd, cameraOffset);
+	// with occlusion culling it's scattered after this pass, and the late meshes draw it
+	if (!_frameGraphKey.occlusion)
+	{
+		draw_foliage(cmd, cameraOffset);
+	}
+
+	// with occlusion culling the late meshes still follow, and the particles go after them
+	if (_frameGraphKey.particles && !_frameGraphKey.occlusion)
+	{
+		draw_particles(cmd, cameraOffset);
+	}
+}
+
+void VulkanEngine::draw_scene_view(VkCommandBuffer cmd, uint32_t view)
+{
+	FrameData& frame = *_graphInputs.frame;
+	bind_mesh_state(cmd, _graphInputs.viewCameraOffsets[view], _sceneViews.extent());
+	if (_depthPrepass)
+	{
+		draw_objects_indirect(cmd, frame, 2 + view, true);
+	}
+	draw_objects_indirect(cmd, frame, 2 + view);
+}
+
+void VulkanEngine::draw_crowd(VkCommandBuffer cmd, FrameData& frame, uint32_t instanceCount, float modelAngle)
+{
+	// instances are laid out on a square grid in the XY plane, one unit apart
+	const uint32_t gridSide = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(instanceCount))));
+	const float gridHalfExtent = (gridSide - 1) * 0.5f;
+
+	Mesh* monkey = get_mesh("monkey");
+	if (!monkey->_resident)
+	{
+		monkey = get_mesh("placeholder");
+	}
+	Material* monkeyMaterial = material_for(*monkey);
+
+	//model rotation
+	glm::mat4 model = glm::rotate(glm::mat4{ 1.0f }, glm::radians(modelAngle), glm::vec3(0, 1, 0));
+	model = glm::scale(model, glm::vec3(0.4, 0.4, 0.4));
+	// model has no translation, so the dequantize offset ends up alone in the last column
+	model = model * monkey->_dequantize;
+	const glm::vec3 meshOffset = glm::vec3(model[3]);
+
+	// every instance shares the rotation and differs only in translation, so just the last column is rewritten
+	InstanceData* instances = static_cast<InstanceData*>(frame._instanceBuffer._mapped);
+	for (uint32_t i = 0; i < instanceCount; i++)
+	{
+		glm::mat4 instanceModel = model;
+		instanceModel[3] = glm::vec4(meshOffset + glm::vec3((i % gridSide) - gridHalfExtent, (i / gridSide) - gridHalfExtent, 0.f), 1.f);
+		instances[i].model = instanceModel;
+	}
+	vmaFlushAllocation(_allocator, frame._instanceBuffer._allocation, 0, VkDeviceSize(instanceCount) * sizeof(InstanceData));
+
+	// the mesh pool stream from binding 0, binding 2 the per-instance transforms
+	FrameStats& stats = frame_stats::local();
+	bind_vertex_stream(cmd, monkey->_poolAllocation.vertexStream, _useVertexPulling);
+	VkDeviceSize instanceOffset = 0;
+	vkCmdBindVertexBuffers(cmd, 2, 1, &frame._instanceBuffer._buffer, &instanceOffset);
+	vkCmdBindIndexBuffer(cmd, _meshPool.index_buffer(monkey->_indexType)._buffer, 0, monkey->_indexType);
+	stats.vertexBufferBinds++;
+
+	// the model matrix comes from the instance buffer and the camera from set 0, so only the material is pushed
+	vkCmdPushConstants(cmd, _meshPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, MESH_MATERIAL_INDEX_OFFSET, sizeof(uint32_t), &monkeyMaterial->materialIndex);
+	stats.pushConstantUploads++;
+
+	// the crowd is an instancing stress test, so it always draws full detail
+	const MeshAllocation& geometry = monkey->_poolAllocation;
+	const MeshLod lod = monkey->get_lod(0);
+	const uint64_t triangles = static_cast<uint64_t>(lod.indexCount / 3) * instanceCount;
+	if (monkeyMaterial->depthInstancedPipeline != VK_NULL_HANDLE)
+	{
+		set_draw_state(cmd, true);
+		bind_graphics_pipeline(cmd, monkeyMaterial->depthInstancedPipeline);
+		vkCmdDrawIndexed(cmd, lod.indexCount, instanceCount, geometry.firstIndex + lod.firstIndex, static_cast<int32_t>(geometry.vertexOffset), 0);
+		stats.pipelineBinds++;
+		stats.drawCalls++;
+		stats.trianglesSubmitted += triangles;
+	}
+	set_draw_state(cmd, !_depthPrepass);
+	bind_graphics_pipeline(cmd, monkeyMaterial->instancedPipeline);
+	vkCmdDrawIndexed(cmd, lod.indexCount, instanceCount, geometry.firstIndex + lod.firstIndex, static_cast<int32_t>(geometry.vertexOffset), 0);
+	stats.pipelineBinds++;
+	stats.drawCalls++;
+	stats.trianglesSubmitted += triangles;
+}
+
+VkExtent2D VulkanEngine::scene_extent() const
+{
+	return _useStereo ? VkExtent2D{ std::max(1u, _windowExtent.width / 2), _windowExtent.height } : _windowExtent;
+}
+
+void VulkanEngine::update_render_scale()
+{
+	// the eyes are blitted into their halves at full size
+	if (!_dynamicResolution || !_dynamicResolutionSupported || _useStereo)
+	{
+		_renderScale = 1.0f;
+		_renderExtent = scene_extent();
+		return;
+	}
+
+	// GPU time goes roughly with the pixel count, so with the square of the scale. Timings arrive a few
+	// frames late, so each one only closes part of the gap, and small deviations are left alone
+	const GpuProfiler::FrameTimings& timings = _gpuProfiler.latest();
+	if (timings.frameNumber > _lastScaledGpuFrame && !timings.scopes.empty())
+	{
+		_lastScaledGpuFrame = timings.frameNumber;
+		const double gpuMs = timings.scopes[0].milliseconds;
+		if (gpuMs > 0.0 && std::abs(gpuMs - _gpuFrameBudgetMs) > 0.05 * _gpuFrameBudgetMs)
+		{
+			const float target = _renderScale * static_cast<float>(std::sqrt(_gpuFrameBudgetMs / gpuMs));
+			_renderScale = std::clamp(_renderScale + 0.25f * (target - _renderScale), _minRenderScale, 1.0f);
+		}
+	}
+
+	_renderExtent.width = std::max(1u, static_cast<uint32_t>(_windowExtent.width * _renderScale));
+	_renderExtent.height = std::max(1u, static_cast<uint32_t>(_windowExtent.height * _renderScale));
+}
+
+void VulkanEngine::bind_mesh_state(VkCommandBuffer cmd, uint32_t cameraOffset, VkExtent2D extent)
+{
+	// viewport and scissor are dynamic state, so the pipelines don't depend on the swapchain size
+	VkViewport viewport = {};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = (float)extent.width;
+	viewport.height = (float)extent.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(cmd, 0, 1, &viewport);
+
+	VkRect2D scissor = {};
+	scissor.offset = { 0, 0 };
+	scissor.extent = extent;
+	vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+	// every mesh pipeline shares _meshPipelineLayout, so set 0 stays bound across pipeline changes
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _meshPipelineLayout, 0, 1, &_globalDescriptor, 1, &cameraOffset);
+	if (_useBindless)
+	{
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _meshPipelineLayout, 1, 1, &_bindlessDescriptor, 0, nullptr);
+	}
+}
+
+void VulkanEngine::set_draw_state(VkCommandBuffer cmd, bool writeDepth, VkCullModeFlags cullMode, bool cameraDepth)
+{
+	// low-detail materials coarsen it again as they come up
+	set_shading_rate(cmd, false);
+#ifdef VK_EXT_extended_dynamic_state
+	if (!_useExtendedDynamicState)
+	{
+		return;
+	}
+	reinterpret_cast<PFN_vkCmdSetCullModeEXT>(_vkCmdSetCullMode)(cmd, cullMode);
+	reinterpret_cast<PFN_vkCmdSetFrontFaceEXT>(_vkCmdSetFrontFace)(cmd, VK_FRONT_FACE_COUNTER_CLOCKWISE);
+	reinterpret_cast<PFN_vkCmdSetPrimitiveTopologyEXT>(_vkCmdSetPrimitiveTopology)(cmd, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+	reinterpret_cast<PFN_vkCmdSetDepthTestEnableEXT>(_vkCmdSetDepthTestEnable)(cmd, VK_TRUE);
+	reinterpret_cast<PFN_vkCmdSetDepthWriteEnableEXT>(_vkCmdSetDepthWriteEnable)(cmd, writeDepth ? VK_TRUE : VK_FALSE);
+	const VkCompareOp writeOp = cameraDepth ? depth_compare_op() : VK_COMPARE_OP_LESS_OR_EQUAL;
+	reinterpret_cast<PFN_vkCmdSetDepthCompareOpEXT>(_vkCmdSetDepthCompareOp)(cmd, writeDepth ? writeOp : VK_COMPARE_OP_EQUAL);
+#endif
+}
+
+void VulkanEngine::set_shading_rate(VkCommandBuffer cmd, bool coarse)
+{
+#ifdef VK_KHR_fragment_shading_rate
+	if (!_useShadingRate)
+	{
+		return;
+	}
+	// 2x2 is a rate every device with the feature has. There are no per-primitive rates, and the image, in
+	// passes that have it, only ever coarsens the draw's rate, or replaces it without MAX combiners
+	const VkExtent2D size = coarse ? VkExtent2D{ 2, 2 } : VkExtent2D{ 1, 1 };
+	VkFragmentShadingRateCombinerOpKHR combiners[2] = { VK_FRAGMENT_SHADING_RATE_COMBINER_OP_KEEP_KHR, VK_FRAGMENT_SHADING_RATE_COMBINER_OP_KEEP_KHR };
+	if (_frameGraphKey.shadingRate)
+	{
+		combiners[1] = _shadingRateMaxCombiner ? VK_FRAGMENT_SHADING_RATE_COMBINER_OP_MAX_KHR : VK_FRAGMENT_SHADING_RATE_COMBINER_OP_REPLACE_KHR;
+	}
+	reinterpret_cast<PFN_vkCmdSetFragmentShadingRateKHR>(_vkCmdSetFragmentShadingRate)(cmd, &size, combiners);
+#endif
+}
+
+VkCompareOp VulkanEngine::depth_compare_op() const
+{
+	return _camera.reverse_z() ? VK_COMPARE_OP_GREATER_OR_EQUAL : VK_COMPARE_OP_LESS_OR_EQUAL;
+}
+
+void VulkanEngine::bind_vertex_stream(VkCommandBuffer cmd, uint32_t vertexStream, bool pulled)
+{
+	// voxel chunks keep their own fetching pipelines, which vertexPull.glsl has no layout for
+	if (pulled && vertexStream != static_cast<uint32_t>(VertexFormat::Voxel))
+	{
+		// the stream index is the format; the set is rebound with it, which keeps secondaries self-contained
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _meshPipelineLayout, 3, 1, &_vertexPullDescriptor, 0, nullptr);
+		vkCmdPushConstants(cmd, _meshPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, MESH_VERTEX_FORMAT_OFFSET, sizeof(uint32_t), &vertexStream);
+		frame_stats::local().pushConstantUploads++;
+		return;
+	}
+
+	VkBuffer buffers[MeshPool::MAX_STREAM_BINDINGS];
+	VkDeviceSize offsets[MeshPool::MAX_STREAM_BINDINGS] = {};
+	const uint32_t bindingCount = _meshPool.binding_count(vertexStream);
+	for (uint32_t binding = 0; binding < bindingCount; binding++)
+	{
+		buffers[binding] = _meshPool.vertex_buffer(vertexStream, binding)._buffer;
+	}
+	vkCmdBindVertexBuffers(cmd, 0, bindingCount, buffers, offsets);
+	frame_stats::local().vertexBufferBinds++;
+}
+
+bool VulkanEngine::should_record_in_parallel(uint32_t objectCount) const
+{
+	// secondaries can only run under the active statistics query if they inherit it
+	const bool queriesAllowed = _gpuProfiler.statistics_flags() == 0 || _enabledFeatures.inheritedQueries;
+	return _multithreadedRecording && queriesAllowed && _recordThreadCount > 1
+		&& objectCount >= 2 * MIN_OBJECTS_PER_RECORD_THREAD;
+}
+
+void VulkanEngine::begin_secondary(VkCommandBuffer cmd, const RenderGraph::PassContext& context, VkFramebuffer framebuffer, VkCommandBufferUsageFlags usage)
+{
+	VkCommandBufferInheritanceInfo inheritance = {};
+	inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritance.pNext = nullptr;
+	inheritance.renderPass = context.renderPass;
+	inheritance.subpass = 0;
+	inheritance.framebuffer = framebuffer;
+	inheritance.pipelineStatistics = _gpuProfiler.statistics_flags();
+#ifdef VK_KHR_dynamic_rendering
+	// without a render pass to continue, the secondaries are told the attachment formats
+	VkCommandBufferInheritanceRenderingInfoKHR renderingInheritance = {};
+	renderingInheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR;
+	renderingInheritance.pNext = nullptr;
+	renderingInheritance.colorAttachmentCount = context.colorFormatCount;
+	renderingInheritance.pColorAttachmentFormats = context.colorFormats;
+	renderingInheritance.depthAttachmentFormat = context.depthFormat;
+	renderingInheritance.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+	renderingInheritance.rasterizationSamples = context.samples;
+	renderingInheritance.viewMask = context.viewMask;
+	if (context.renderPass == VK_NULL_HANDLE)
+	{
+		inheritance.pNext = &renderingInheritance;
+	}
+#endif
+
+	VkCommandBufferBeginInfo beginInfo = vkinit::command_buffer_begin_info(usage | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT);
+	beginInfo.pInheritanceInfo = &inheritance;
+	VK_CHECK(vkBeginCommandBuffer(cmd, &beginInfo));
+}
+
+uint32_t VulkanEngine::record_draws_parallel(FrameData& frame, const RenderGraph::PassContext& context, uint32_t cameraOffset, RenderObject* objects, uint32_t objectCount,
+	uint32_t maxThreads)
+{
+	const uint32_t threadCount = std::max(1u, std::min({ _recordThreadCount, maxThreads, objectCount / MIN_OBJECTS_PER_RECORD_THREAD }));
+	const uint32_t chunkSize = (objectCount + threadCount - 1) / threadCount;
+
+	// chunks follow the sorted order, so each buffer still only rebinds at state changes;
+	// buffers execute in chunk order, which keeps the draw order of a single-threaded recording
+	parallel_for(threadCount, [&](size_t t) {
+		// a buffer of its own every time, as the main pass may record through here more than once a frame
+		VkCommandBuffer cmd = _frameCommands.allocate(1 + static_cast<uint32_t>(t), VK_COMMAND_BUFFER_LEVEL_SECONDARY, "draws");
+		frame._secondaryBuffers[t] = cmd;
+		begin_secondary(cmd, context, context.framebuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+		// nothing is inherited from the primary but the render pass, so every buffer starts from scratch
+		bind_mesh_state(cmd, cameraOffset);
+		const uint32_t first = static_cast<uint32_t>(t) * chunkSize;
+		const uint32_t count = std::min(chunkSize, objectCount - first);
+		// the pre-pass only covers the chunk, so later chunks can still overdraw earlier ones; the
+		// picture is the same, just with less of the saving
+		if (_depthPrepass)
+		{
+			draw_objects(cmd, objects + first, static_cast<int>(count), true, false, first);
+		}
+		draw_objects(cmd, objects + first, static_cast<int>(count), false, false, first);
+		draw_meshlets(cmd, cameraOffset, objects + first, static_cast<int>(count));
+		// the last buffer executes last
+		if (t == threadCount - 1)
+		{
+			draw_impostors(cmd, cameraOffset);
+			draw_terrain(cmd, cameraOffset);
+			draw_foliage(cmd, cameraOffset);
+			if (_frameGraphKey.particles)
+			{
+				draw_particles(cmd, cameraOffset);
+			}
+		}
+
+		VK_CHECK(vkEndCommandBuffer(cmd));
+	}, threadCount);
+
+	return threadCount;
+}
+
+bool VulkanEngine::static_draw_cache_active() const
+{
+	// the secondaries could only run under the active statistics query by inheriting it
+	const bool queriesAllowed = _gpuProfiler.statistics_flags() == 0 || _enabledFeatures.inheritedQueries;
+	// the buffer paths write their slots every frame, which a replayed buffer wouldn't
+	return _cacheStaticDraws && queriesAllowed && !(_useMeshShading && _meshShadingSupported) && _objectDataPath == ObjectDataPath::PushConstants;
+}
+
+VkCommandBuffer VulkanEngine::static_draws(FrameData& frame, const RenderGraph::PassContext& context, uint32_t cameraOffset)
+{
+	// the levels are all that follows the camera; the rest only changes with settings and the scene
+	uint64_t lodHash = 14695981039346656037ull;
+	for (const RenderObject& object : _renderables)
+	{
+		if (object.isStatic)
+		{
+			lodHash = (lodHash ^ select_lod(object)) * 1099511628211ull;
+		}
+	}
+
+	StaticDrawKey key;
+	key.generation = _staticDrawGeneration;
+	key.lodHash = lodHash;
+	key.cameraOffset = cameraOffset;
+	key.extent = _renderExtent;
+	key.statistics = _gpuProfiler.statistics_flags();
+	key.depthPrepass = _depthPrepass;
+	key.reverseZ = _camera.reverse_z();
+	if (key == frame._staticDrawKey)
+	{
+		return frame._staticDrawBuffer;
+	}
+
+	CPU_PROFILE_SCOPE("record_static_draws");
+	// the frame's fence has signaled, so the last replay is done
+	VK_CHECK(vkResetCommandPool(_device, frame._staticDrawPool, 0));
+	std::vector<RenderObject> statics;
+	for (const RenderObject& object : _renderables)
+	{
+		if (object.isStatic)
+		{
+			statics.push_back(object);
+		}
+	}
+
+	// replayed into whichever framebuffer the pass has that frame
+	VkCommandBuffer cmd = frame._staticDrawBuffer;
+	begin_secondary(cmd, context, VK_NULL_HANDLE, 0);
+	bind_mesh_state(cmd, cameraOffset);
+	if (_depthPrepass)
+	{
+		draw_objects(cmd, statics.data(), static_cast<int>(statics.size()), true, true);
+	}
+	draw_objects(cmd, statics.data(), static_cast<int>(statics.size()), false, true);
+	VK_CHECK(vkEndCommandBuffer(cmd));
+
+	frame._staticDrawKey = key;
+	return cmd;
+}
+
+void VulkanEngine::draw_objects(VkCommandBuffer cmd, RenderObject* first, int count, bool depthPass, bool cached, uint32_t firstSlot)
+{
+	// _renderables is sorted, so these only change at the boundaries between runs of equal state
+	VkPipeline lastPipeline = VK_NULL_HANDLE;
+	VkIndexType lastIndexType = VK_INDEX_TYPE_MAX_ENUM;
+	uint32_t lastVertexStream = UINT32_MAX;
+	set_draw_state(cmd, depthPass || !_depthPrepass);
+	bool lowDetail = false;
+	// per recording thread, so the secondaries of a parallel recording count without contention
+	FrameStats& stats = frame_stats::local();
+	FrameData& frame = get_current_frame();
+	if (_objectDataPath != ObjectDataPath::PushConstants)
+	{
+		count = static_cast<int>(std::min<int64_t>(count, int64_t(MAX_DRAW_DATA) - firstSlot));
+	}
+	// once for all of these draws, here rather than in bind_mesh_state since the meshlet pipelines use set 2
+	// for their own buffers; the uniform path rebinds at each draw's offset instead
+	if (_objectDataPath == ObjectDataPath::StorageBuffer)
+	{
+		const uint32_t zeroOffset = 0;
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _meshPipelineLayout, 2, 1, &frame._drawDataDescriptor, 1, &zeroOffset);
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		RenderObject& object = first[i];
+		if (uses_meshlets(object))
+		{
+			continue;
+		}
+
+		// materials without a pre-pass have no depth pipeline and wait for the color pass
+		const VkPipeline pipeline = depthPass ? object.material->depthPipeline : object.material->pipeline;
+		if (pipeline == VK_NULL_HANDLE)
+		{
+			continue;
+		}
+
+		// different materials may share a pipeline; only a new pipeline needs a bind
+		if (pipeline != lastPipeline)
+		{
+			bind_graphics_pipeline(cmd, pipeline);
+			lastPipeline = pipeline;
+			stats.pipelineBinds++;
+		}
+		// depth-only draws shade nothing
+		if (!depthPass && object.material->lowDetail != lowDetail)
+		{
+			lowDetail = object.material->lowDetail;
+			set_shading_rate(cmd, lowDetail);
+		}
+
+		// projection and view are applied in the shader from the camera buffer
+		MeshPushConstants constants;
+		constants.model = _transforms.world(object.transformIndex) * object.mesh->_dequantize;
+		constants.materialIndex = object.material->materialIndex;
+		const uint32_t firstInstance = bind_draw_data(cmd, frame, object.material->pipelineLayout, constants, firstSlot + i);
+
+		// meshes of the same vertex format share one pool vertex buffer
+		const MeshAllocation& geometry = object.mesh->_poolAllocation;
+		if (geometry.vertexStream != lastVertexStream)
+		{
+			bind_vertex_stream(cmd, geometry.vertexStream, _useVertexPulling);
+			lastVertexStream = geometry.vertexStream;
+		}
+
+		// the pool has one index buffer per index type
+		if (object.mesh->_indexType != lastIndexType)
+		{
+			vkCmdBindIndexBuffer(cmd, _meshPool.index_buffer(object.mesh->_indexType)._buffer, 0, object.mesh->_indexType);
+			lastIndexType = object.mesh->_indexType;
+		}
+
+		// cached buffers replay long after the frame whose queries they would have gone by
+		const bool predicated = !cached && uses_predicates(*object.mesh) && _occlusionPredicates.predicated(object.sceneIndex);
+		if (predicated)
+		{
+			_occlusionPredicates.begin_conditional(cmd, object.sceneIndex);
+		}
+
+		const uint32_t level = select_lod(object);
+		if (level == 0 && _clusterCulling && !cached && object.mesh->_clusters.size() > 1)
+		{
+			draw_clusters(cmd, object, firstInstance);
+		}
+		else
+		{
+			const MeshLod lod = object.mesh->get_lod(level);
+			vkCmdDrawIndexed(cmd, lod.indexCount, 1, geometry.firstIndex + lod.firstIndex, static_cast<int32_t>(geometry.vertexOffset), firstInstance);
+			stats.drawCalls++;
+			stats.trianglesSubmitted += lod.indexCount / 3;
+		}
+
+		if (predicated)
+		{
+			_occlusionPredicates.end_conditional(cmd);
+		}
+	}
+}
+
+uint32_t VulkanEngine::bind_draw_data(VkCommandBuffer cmd, FrameData& frame, VkPipelineLayout layout, const MeshPushConstants& constants, uint32_t slot)
+{
+	FrameStats& stats = frame_stats::local();
+	if (_objectDataPath == ObjectDataPath::PushConstants)
+	{
+		vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(MeshPushConstants), &constants);
+		stats.pushConstantUploads++;
+		return 0;
+	}
+
+	// straight into mapped memory the GPU reads once the frame is submitted
+	GPUDrawData* data = reinterpret_cast<GPUDrawData*>(frame._drawData + size_t(slot) * _drawDataStride);
+	data->model = constants.model;
+	data->materialIndex = constants.materialIndex;
+	if (_objectDataPath == ObjectDataPath::DynamicUniform)
+	{
+		const uint32_t offset = slot * _drawDataStride;
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 2, 1, &frame._drawDataDescriptor, 1, &offset);
+		return 0;
+	}
+	return slot;
+}
+
+void VulkanEngine::draw_clusters(VkCommandBuffer cmd, const RenderObject& object, uint32_t firstInstance)
+{
+	const Mesh& mesh = *object.mesh;
+	const MeshAllocation& geometry = mesh._poolAllocation;
+
+	// the camera and planes move into mesh space, so the cluster data is used as stored
+	// planes transform by the transpose and are renormalized, which keeps sphere tests exact under any scale
+	const glm::mat4& world = _transforms.world(object.transformIndex);
+	const glm::vec3 viewPoint = glm::vec3(glm::inverse(world) * glm::vec4(_camera.position(), 1.f));
+	const glm::mat4 planeTransform = glm::transpose(world);
+	glm::vec4 planes[6];
+	for (int i = 0; i < 6; i++)
+	{
+		planes[i] = planeTransform * _camera.frustum_planes()[i];
+		// an infinite far plane stays (0, 0, 0, 1)
+		const float length = glm::length(glm::vec3(planes[i]));
+		planes[i] /= length > 0.f ? length : 1.f;
+	}
+
+	// clusters follow each other in the index buffer, so neighbours that both pass share one draw
+	FrameStats& stats = frame_stats::local();
+	uint32_t runFirst = 0;
+	uint32_t runCount = 0;
+	for (const MeshCluster& cluster : mesh._clusters)
+	{
+		bool visible = !cluster.faces_away_from(viewPoint);
+		for (int i = 0; i < 6 && visible; i++)
+		{
+			visible = glm::dot(glm::vec3(planes[i]), cluster.bounds.origin) + planes[i].w >= -cluster.bounds.radius;
+		}
+
+		if (visible && runCount > 0 && runFirst + runCount == cluster.firstIndex)
+		{
+			runCount += cluster.indexCount;
+			continue;
+		}
+		if (runCount > 0)
+		{
+			vkCmdDrawIndexed(cmd, runCount, 1, geometry.firstIndex + runFirst, static_cast<int32_t>(geometry.vertexOffset), firstInstance);
+			stats.drawCalls++;
+			stats.trianglesSubmitted += runCount / 3;
+			runCount = 0;
+		}
+		if (visible)
+		{
+			runFirst = cluster.firstIndex;
+			runCount = cluster.indexCount;
+		}
+	}
+	if (runCount > 0)
+	{
+		vkCmdDrawIndexed(cmd, runCount, 1, geometry.firstIndex + runFirst, static_cast<int32_t>(geometry.vertexOffset), firstInstance);
+		stats.drawCalls++;
+		stats.trianglesSubmitted += runCount / 3;
+	}
+}
+
+bool VulkanEngine::uses_meshlets(const RenderObject& object) const
+{
+	return _useMeshShading && _meshShadingSupported && object.mesh->_meshletAllocation.meshletCount > 0 && select_lod(object) == 0;
+}
+
+void VulkanEngine::draw_meshlets(VkCommandBuffer cmd, uint32_t cameraOffset, RenderObject* first, int count)
+{
+#ifdef VK_EXT_mesh_shader
+	if (!_useMeshShading || !_meshShadingSupported)
+	{
+		return;
+	}
+
+	const PFN_vkCmdDrawMeshTasksEXT drawMeshTasks = reinterpret_cast<PFN_vkCmdDrawMeshTasksEXT>(_vkCmdDrawMeshTasks);
+	FrameStats& stats = frame_stats::local();
+	bool bound = false;
+	for (int i = 0; i < count; i++)
+	{
+		const RenderObject& object = first[i];
+		if (!uses_meshlets(object))
+		{
+			continue;
+		}
+
+		// the push constant ranges differ from the mesh pipelines', so their sets don't carry over
+		// meshlets aren't in the pre-pass, so they write their own depth
+		if (!bound)
+		{
+			set_draw_state(cmd, true);
+			bind_graphics_pipeline(cmd, _meshletPipeline);
+			VkDescriptorSet sets[] = { _globalDescriptor, _bindlessDescriptor, _meshletDescriptor };
+			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _meshletPipelineLayout, 0, 3, sets, 1, &cameraOffset);
+			bound = true;
+			stats.pipelineBinds++;
+		}
+
+		// the task shader culls in mesh space like draw_clusters; _dequantize is a uniform scale and offset
+		const Mesh& mesh = *object.mesh;
+		const glm::mat4& world = _transforms.world(object.transformIndex);
+		MeshletPushConstants constants;
+		constants.world = world;
+		constants.dequantize = glm::vec4(glm::vec3(mesh._dequantize[3]), mesh._dequantize[0][0]);
+		constants.viewPoint = glm::inverse(world) * glm::vec4(_camera.position(), 1.f);
+		constants.materialIndex = object.material->materialIndex;
+		constants.firstMeshlet = mesh._meshletAllocation.firstMeshlet;
+		constants.meshletCount = mesh._meshletAllocation.meshletCount;
+		constants.vertexOffset = mesh._poolAllocation.vertexOffset;
+		constants.vertexFormat = static_cast<uint32_t>(mesh._vertexFormat);
+		vkCmdPushConstants(cmd, _meshletPipelineLayout, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT, 0, sizeof(MeshletPushConstants), &constants);
+
+		drawMeshTasks(cmd, (constants.meshletCount + MESHLET_TASK_GROUP_SIZE - 1) / MESHLET_TASK_GROUP_SIZE, 1, 1);
+		// the task shader may cull any of them, like the cull shader does for indirect draws
+		stats.pushConstantUploads++;
+		stats.drawCalls++;
+		stats.trianglesSubmitted += mesh.get_lod(0).indexCount / 3;
+	}
+#endif
+}
+
+void VulkanEngine::compact_draws(RenderObject* first, int count, ArenaVector<IndirectBatch>& batches)
+{
+	batches.clear();
+	for (int i = 0; i < count; i++)
+	{
+		bool sameAsLast = !batches.empty()
+			&& batches.back().mesh == first[i].mesh
+			&& batches.back().material == first[i].material;
+
+		if (sameAsLast)
+		{
+			batches.back().count++;
+		}
+		else
+		{
+			IndirectBatch batch;
+			batch.mesh = first[i].mesh;
+			batch.material = first[i].material;
+			batch.first = static_cast<uint32_t>(i);
+			batch.count = 1;
+			batch.lod = 0;
+			batches.push_back(batch);
+		}
+	}
+}
+
+void VulkanEngine::prepare_indirect_draws(VkCommandBuffer cmd, FrameData& frame, uint32_t cameraOffset, RenderObject* first, int count,
+	bool computeQueue)
+{
+	count = std::min(count, static_cast<int>(MAX_INSTANCES));
+
+	// transient, so it lives in the frame arena; the members below keep their capacity between frames
+	ArenaVector<IndirectBatch> meshBatches{ ArenaAllocator<IndirectBatch>(frame._arena) };
+	compact_draws(first, count, meshBatches);
+
+	// each object picks its LOD here, then every batch is split by level so one command draws one
+	// index range; _indirectOrder maps the regrouped slots back to render objects
+	_indirectBatches.clear();
+	_indirectOrder.resize(count);
+	_objectLods.resize(count);
+	for (const IndirectBatch& batch : meshBatches)
+	{
+		uint32_t levelCounts[MAX_MESH_LODS] = {};
+		for (uint32_t i = batch.first; i < batch.first + batch.count; i++)
+		{
+			_objectLods[i] = select_lod(first[i]);
+			levelCounts[_objectLods[i]]++;
+		}
+
+		uint32_t levelCursors[MAX_MESH_LODS];
+		uint32_t next = batch.first;
+		for (uint32_t level = 0; level < MAX_MESH_LODS; level++)
+		{
+			levelCursors[level] = next;
+			if (levelCounts[level] > 0)
+			{
+				IndirectBatch lodBatch = batch;
+				lodBatch.first = next;
+				lodBatch.count = levelCounts[level];
+				lodBatch.lod = level;
+				_indirectBatches.push_back(lodBatch);
+			}
+			next += levelCounts[level];
+		}
+
+		for (uint32_t i = batch.first; i < batch.first + batch.count; i++)
+		{
+			_indirectOrder[levelCursors[_objectLods[i]]++] = i;
+		}
+	}
+
+	// group batches that can share one draw call: same pipeline, same index and vertex buffers
+	_indirectRuns.clear();
+	for (uint32_t i = 0; i < _indirectBatches.size(); i++)
+	{
+		const IndirectBatch& batch = _indirectBatches[i];
+		bool sameAsLast = !_indirectRuns.empty()
+			&& _indirectRuns.back().material->instancedPipeline == batch.material->instancedPipeline
+			&& _indirectRuns.back().mesh->_indexType == batch.mesh->_indexType
+			&& _indirectRuns.back().mesh->_poolAllocation.vertexStream == batch.mesh->_poolAllocation.vertexStream;
+
+		if (sameAsLast)
+		{
+			_indirectRuns.back().count++;
+		}
+		else
+		{
+			IndirectRun run;
+			run.material = batch.material;
+			run.mesh = batch.mesh;
+			run.first = i;
+			run.count = 1;
+			_indirectRuns.push_back(run);
+		}
+	}
+
+	// the objects that changed since, before the dispatch that reads them
+	_gpuScene.record_updates(cmd, _frameGpuData);
+
+	// objects are sorted, so each batch owns the instance slots [first, first + count);
+	// the cull pass appends each survivor to its batch's slots. The slots change with the levels of detail
+	// and the sort, so they are written every frame, but they only point into the GPU scene
+	GPUObjectSlot* objects = static_cast<GPUObjectSlot*>(frame._objectBuffer._mapped);
+	for (uint32_t b = 0; b < _indirectBatches.size(); b++)
+	{
+		const IndirectBatch& batch = _indirectBatches[b];
+		for (uint32_t slot = batch.first; slot < batch.first + batch.count; slot++)
+		{
+			objects[slot].sceneIndex = first[_indirectOrder[slot]].sceneIndex;
+			objects[slot].batchIndex = b;
+			objects[slot].renderIndex = _indirectOrder[slot];
+		}
+	}
+	vmaFlushAllocation(_allocator, frame._objectBuffer._allocation, 0, VkDeviceSize(count) * sizeof(GPUObjectSlot));
+
+	// instance counts start at zero and are filled in by the cull pass
+	GPUIndirectCommand* commands = static_cast<GPUIndirectCommand*>(frame._indirectBuffer._mapped);
+	for (uint32_t r = 0; r < _indirectRuns.size(); r++)
+	{
+		const IndirectRun& run = _indirectRuns[r];
+		for (uint32_t b = run.first; b < run.first + run.count; b++)
+		{
+			const IndirectBatch& batch = _indirectBatches[b];
+			const MeshAllocation& geometry = batch.mesh->_poolAllocation;
+			const MeshLod lod = batch.mesh->get_lod(batch.lod);
+			commands[b].command.indexCount = lod.indexCount;
+			commands[b].command.instanceCount = 0;
+			commands[b].command.firstIndex = geometry.firstIndex + lod.firstIndex;
+			commands[b].command.vertexOffset = static_cast<int32_t>(geometry.vertexOffset);
+			commands[b].command.firstInstance = batch.first;
+			commands[b].runIndex = r;
+			commands[b].runFirst = run.first;
+		}
+	}
+	// the second occlusion phase starts from the same records in the buffer's second half
+	const bool occlusion = occlusion_culling();
+	const size_t batchCount = _indirectBatches.size();
+	if (occlusion)
+	{
+		std::copy(commands, commands + batchCount, commands + batchCount);
+	}
+	// and so does every extra view, in the slices after both phases'
+	const uint32_t views = _sceneViews.count();
+	for (uint32_t v = 0; v < views; v++)
+	{
+		std::copy(commands, commands + batchCount, commands + (2 + v) * batchCount);
+	}
+	const size_t slices = views > 0 ? 2 + views : (occlusion ? 2 : 1);
+	vmaFlushAllocation(_allocator, frame._indirectBuffer._allocation, 0, VkDeviceSize(slices) * batchCount * sizeof(GPUIndirectCommand));
+
+	// zero the per-run counters compact.comp increments, for both phases
+	vkCmdFillBuffer(cmd, frame._drawCountBuffer._buffer, 0, VK_WHOLE_SIZE, 0);
+	VkBufferMemoryBarrier clearBarrier = vkinit::buffer_barrier(frame._drawCountBuffer._buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &clearBarrier, 0, nullptr);
+
+	if (occlusion)
+	{
+		// the previous frame's second phase wrote the visibility this phase reads; it may still be running
+		VkBufferMemoryBarrier visibilityBarrier = vkinit::buffer_barrier(_visibilityBuffer._buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &visibilityBarrier, 0, nullptr);
+	}
+
+	_cullConstants = {};
+	for (int i = 0; i < 6; i++)
+	{
+		_cullConstants.frustumPlanes[i] = _camera.frustum_planes()[i];
+	}
+	_cullConstants.objectCount = static_cast<uint32_t>(count);
+	_cullConstants.batchCount = static_cast<uint32_t>(_indirectBatches.size());
+	_cullConstants.cullFlags = (_gpuCulling ? CULL_FRUSTUM : 0) | (occlusion ? CULL_OCCLUSION : 0) | (_camera.reverse_z() ? CULL_REVERSE_Z : 0);
+	_cullConstants.runCount = static_cast<uint32_t>(_indirectRuns.size());
+	_cullConstants.depthWidth = _windowExtent.width;
+	_cullConstants.depthHeight = _windowExtent.height;
+	_cullConstants.znear = _camera.near_plane();
+
+	dispatch_cull(cmd, frame, cameraOffset, 0, computeQueue);
+}
+
+void VulkanEngine::dispatch_cull(VkCommandBuffer cmd, FrameData& frame, uint32_t cameraOffset, uint32_t phase, bool computeQueue)
+{
+	_cullConstants.phase = phase;
+
+	// rebound every phase, since the pyramid build in between uses its own layout
+	const uint32_t dynamicOffsets[] = { cameraOffset, _graphInputs.cullViewsOffset };
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _cullPipelineLayout, 0, 1, &frame._cullDescriptor, 2, dynamicOffsets);
+	vkCmdPushConstants(cmd, _cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants), &_cullConstants);
+
+	// both shaders run 256 invocations per group, and a row of groups per view; the extra views only
+	// come along in phase 0
+	const uint32_t viewRows = phase == 0 ? 1 + _sceneViews.count() : 1;
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _cullPipeline);
+	vkCmdDispatch(cmd, (_cullConstants.objectCount + 255) / 256, viewRows, 1);
+
+	if (_drawIndirectCountSupported)
+	{
+		// instance counts must be final before compaction reads them
+		VkBufferMemoryBarrier cullBarrier = vkinit::buffer_barrier(frame._indirectBuffer._buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &cullBarrier, 0, nullptr);
+
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _compactPipeline);
+		vkCmdDispatch(cmd, (_cullConstants.batchCount + 255) / 256, viewRows, 1);
+	}
+
+	// the compute queue can't name the draw stages; the timeline value the graphics submit waits on
+	// makes the writes visible to them instead
+	if (computeQueue)
+	{
+		return;
+	}
+
+	// hand everything the compute passes wrote to the draw
+	VkBufferMemoryBarrier drawBarriers[] = {
+		vkinit::buffer_barrier(frame._indirectBuffer._buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT),
+		vkinit::buffer_barrier(frame._compactIndirectBuffer._buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT),
+		vkinit::buffer_barrier(frame._drawCountBuffer._buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT),
+		vkinit::buffer_barrier(frame._instanceBuffer._buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT),
+		vkinit::buffer_barrier(frame._instanceObjectBuffer._buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT),
+	};
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+		0, 0, nullptr, 5, drawBarriers, 0, nullptr);
+}
+
+uint64_t VulkanEngine::submit_async_culling(FrameData& frame, uint32_t cameraOffset)
+{
+	CPU_PROFILE_SCOPE("async culling");
+	// the slot's last cull finished before the graphics work that waited for it, which the slot waited for
+	_computeCommands.begin_frame(_frameNumber % _frameOverlap);
+	VkCommandBuffer cmd = _computeCommands.allocate(0, VK_COMMAND_BUFFER_LEVEL_PRIMARY, "cull");
+	frame._computeCommandBuffer = cmd;
+	VkCommandBufferBeginInfo beginInfo = vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	VK_CHECK(vkBeginCommandBuffer(cmd, &beginInfo));
+	prepare_indirect_draws(cmd, frame, cameraOffset, _renderables.data(), static_cast<int>(_renderables.size()), true);
+	VK_CHECK(vkEndCommandBuffer(cmd));
+
+	// the camera was pushed before this; the rest of the frame's data is flushed before the graphics submit
+	_frameGpuData.flush();
+
+	const uint64_t value = ++_computeTimelineValue;
+	VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+	timelineInfo.signalSemaphoreValueCount = 1;
+	timelineInfo.pSignalSemaphoreValues = &value;
+
+	VkSubmitInfo submit = vkinit::submit_info(&cmd);
+	submit.pNext = &timelineInfo;
+	// the last frame culled on the graphics queue, whose cull may still read the GPU scene this overwrites;
+	// only happens when occlusion culling was just turned off
+	const VkPipelineStageFlags sceneWaitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	if (!_lastCullOnCompute && _graphicsTimelineValue > 0)
+	{
+		timelineInfo.waitSemaphoreValueCount = 1;
+		timelineInfo.pWaitSemaphoreValues = &_graphicsTimelineValue;
+		submit.waitSemaphoreCount = 1;
+		submit.pWaitSemaphores = &_graphicsTimeline;
+		submit.pWaitDstStageMask = &sceneWaitStage;
+	}
+	_lastCullOnCompute = true;
+	submit.signalSemaphoreCount = 1;
+	submit.pSignalSemaphores = &_computeTimeline;
+	std::lock_guard<std::mutex> lock(_deviceContext->queueMutex);
+	check_device_result(vkQueueSubmit(_computeQueue, 1, &submit, VK_NULL_HANDLE), "vkQueueSubmit");
+	return value;
+}
+
+void VulkanEngine::draw_objects_indirect(VkCommandBuffer cmd, FrameData& frame, uint32_t phase, bool depthPass, const VkPipeline* formatPipelines)
+{
+	VkPipeline lastPipeline = VK_NULL_HANDLE;
+	Material* lastMaterial = nullptr;
+	VkIndexType lastIndexType = VK_INDEX_TYPE_MAX_ENUM;
+	uint32_t lastVertexStream = UINT32_MAX;
+
+	const VkDeviceSize stride = sizeof(GPUIndirectCommand);
+	// the second occlusion phase has its own half of the draw and count buffers
+	const uint32_t drawOffset = phase * static_cast<uint32_t>(_indirectBatches.size());
+	const uint32_t countOffset = phase * static_cast<uint32_t>(_indirectRuns.size());
+
+	// binding 2 holds the culled per-object transforms for every run; each extra view's from its own stretch
+	VkDeviceSize instanceOffset = phase >= 2 ? VkDeviceSize(phase - 1) * MAX_INSTANCES * sizeof(InstanceData) : 0;
+	vkCmdBindVertexBuffers(cmd, 2, 1, &frame._instanceBuffer._buffer, &instanceOffset);
+	set_draw_state(cmd, depthPass || !_depthPrepass);
+	FrameStats& stats = frame_stats::local();
+	stats.vertexBufferBinds++;
+
+	for (uint32_t r = 0; r < _indirectRuns.size(); r++)
+	{
+		const IndirectRun& run = _indirectRuns[r];
+		VkPipeline pipeline = depthPass ? run.material->depthInstancedPipeline : run.material->instancedPipeline;
+		if (formatPipelines != nullptr)
+		{
+			pipeline = formatPipelines[static_cast<uint32_t>(run.mesh->_vertexFormat)];
+		}
+		if (pipeline == VK_NULL_HANDLE)
+		{
+			continue;
+		}
+
+		if (pipeline != lastPipeline)
+		{
+			bind_graphics_pipeline(cmd, pipeline);
+			lastPipeline = pipeline;
+			stats.pipelineBinds++;
+		}
+
+		// the model matrix comes from the instance buffer and the camera from set 0, so only the material is pushed
+		if (run.material != lastMaterial)
+		{
+			vkCmdPushConstants(cmd, run.material->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, MESH_MATERIAL_INDEX_OFFSET, sizeof(uint32_t), &run.material->materialIndex);
+			if (!depthPass && (lastMaterial != nullptr ? lastMaterial->lowDetail : false) != run.material->lowDetail)
+			{
+				set_shading_rate(cmd, run.material->lowDetail);
+			}
+			lastMaterial = run.material;
+			stats.pushConstantUploads++;
+		}
+
+		if (run.mesh->_indexType != lastIndexType)
+		{
+			vkCmdBindIndexBuffer(cmd, _meshPool.index_buffer(run.mesh->_indexType)._buffer, 0, run.mesh->_indexType);
+			lastIndexType = run.mesh->_indexType;
+		}
+
+		// the pool buffers of the run's vertex format, from binding 0
+		uint32_t vertexStream = run.mesh->_poolAllocation.vertexStream;
+		if (vertexStream != lastVertexStream)
+		{
+			// the overdraw and pick pipelines fetch like the depth-only ones, whatever the materials pull
+			bind_vertex_stream(cmd, vertexStream, _useVertexPulling && formatPipelines == nullptr);
+			lastVertexStream = vertexStream;
+		}
+
+		if (_drawIndirectCountSupported)
+		{
+			// the GPU decides how many of the run's compacted draws actually execute
+			_vkCmdDrawIndexedIndirectCount(cmd, frame._compactIndirectBuffer._buffer, (drawOffset + run.first) * stride,
+				frame._drawCountBuffer._buffer, (countOffset + r) * sizeof(uint32_t), run.count, static_cast<uint32_t>(stride));
+			stats.drawCalls++;
+		}
+		else if (_enabledFeatures.multiDrawIndirect)
+		{
+			// fully culled batches stay in as zero-instance draws
+			vkCmdDrawIndexedIndirect(cmd, frame._indirectBuffer._buffer, (drawOffset + run.first) * stride, run.count, static_cast<uint32_t>(stride));
+			stats.drawCalls++;
+		}
+		else
+		{
+			// without multiDrawIndirect every call is limited to a single record
+			for (uint32_t i = 0; i < run.count; i++)
+			{
+				vkCmdDrawIndexedIndirect(cmd, frame._indirectBuffer._buffer, (drawOffset + run.first + i) * stride, 1, static_cast<uint32_t>(stride));
+			}
+			stats.drawCalls += run.count;
+		}
+
+		// every object of the run's batches, whatever the cull shader leaves of them
+		for (uint32_t b = run.first; b < run.first + run.count; b++)
+		{
+			const IndirectBatch& batch = _indirectBatches[b];
+			stats.trianglesSubmitted += static_cast<uint64_t>(batch.mesh->get_lod(batch.lod).indexCount / 3) * batch.count;
+		}
+	}
+}
+
+RenderObject* VulkanEngine::cull_renderables(FrameData& frame, uint32_t& count, bool skipStatic)
+{
+	CPU_PROFILE_SCOPE("cull_renderables");
+	// outside the level's grid every part counts as visible
+	const uint32_t pvsCell = _usePvs ? _pvs.find_cell(_camera.position()) : UINT32_MAX;
+	const bool impostors = _useImpostors && _impostorPipeline != VK_NULL_HANDLE;
+	if (!_cpuCulling && !skipStatic && pvsCell == UINT32_MAX && !impostors)
+	{
+		count = static_cast<uint32_t>(_renderables.size());
+		return _renderables.data();
+	}
+
+	uint32_t* indices = static_cast<uint32_t*>(frame._arena.allocate(_renderables.size() * sizeof(uint32_t), alignof(uint32_t)));
+	uint32_t visibleCount = 0;
+	if (_cpuCulling && _sphereCulling)
+	{
+		// already in list order; a camera that hasn't moved much tests only the spheres near the planes
+		visibleCount = _renderSpheres.cull_coherent(_camera.frustum_planes(), indices);
+	}
+	else if (_cpuCulling)
+	{
+		// the query visits whole subtrees at once; sorting the hits restores the pipeline and mesh order
+		_renderBvh.query_frustum(_camera.frustum_planes(), [&](uint32_t index) {
+			indices[visibleCount++] = index;
+		});
+		std::sort(indices, indices + visibleCount);
+	}
+	else
+	{
+		for (uint32_t i = 0; i < _renderables.size(); i++)
+		{
+			indices[visibleCount++] = i;
+		}
+	}
+	// the level's parts the camera's cell can't see; a bit each, so ahead of the occlusion test. The frustum
+	// passes above walk their own structures over every object, and which of the two goes first doesn't
+	// change what's left
+	if (pvsCell != UINT32_MAX)
+	{
+		uint32_t kept = 0;
+		for (uint32_t i = 0; i < visibleCount; i++)
+		{
+			if (_pvs.visible(pvsCell, _renderables[indices[i]].pvsObject))
+			{
+				indices[kept++] = indices[i];
+			}
+		}
+		visibleCount = kept;
+	}
+	// what survived the frustum, against the occluders as this frame's camera sees them
+	if (_cpuCulling && _useSoftwareOcclusion && _softwareOcclusion.occluder_triangle_count() > 0)
+	{
+		CPU_PROFILE_SCOPE("software_occlusion");
+		_softwareOcclusion.render(_camera);
+		visibleCount = _softwareOcclusion.remove_occluded(indices, visibleCount, [this](uint32_t index) {
+			return _entities.get<WorldBounds>(_renderables[index].entity)->box;
+		});
+	}
+
+	RenderObject* visible = static_cast<RenderObject*>(frame._arena.allocate(visibleCount * sizeof(RenderObject), alignof(RenderObject)));
+	count = 0;
+	for (uint32_t i = 0; i < visibleCount; i++)
+	{
+		const RenderObject& object = _renderables[indices[i]];
+		if (skipStatic && object.isStatic)
+		{
+			continue;
+		}
+		// far objects leave the list for the frame's quads; the slot only runs out with thousands of them
+		const Mesh& mesh = *object.mesh;
+		if (impostors && mesh._impostor != UINT32_MAX && draws_as_impostor(object)
+			&& _impostors.push(_transforms.world(object.transformIndex), glm::vec4(mesh._bounds.origin, mesh._bounds.radius), mesh._impostor))
+		{
+			continue;
+		}
+		visible[count++] = object;
+	}
+	return visible;
+}
+
+void VulkanEngine::report_gpu_pick(const ObjectPicker::Result& result)
+{
+	// the slot may have gone to another object since, which a click a frame or two old doesn't care about
+	const uint32_t slot = result.nearest_to_center();
+	if (slot < _sceneEntities.size() && _entities.alive(_sceneEntities[slot]))
+	{
+		LOG_INFO("Picked entity " << _sceneEntities[slot].index << " (scene slot " << slot << ") in frame " << result.frameNumber);
+	}
+	else
+	{
+		LOG_INFO("Nothing under the cursor");
+	}
+}
+
+bool VulkanEngine::pick(const glm::vec3& origin, const glm::vec3& direction, uint32_t& renderIndex, float& distance) const
+{
+	// the fat proxy box is only a first test; the object's own world box decides
+	auto hit = [&](uint32_t index, float) {
+		const RenderObject& object = _renderables[index];
+		const Aabb meshBounds = { object.mesh->_bounds.min, object.mesh->_bounds.max };
+		const Aabb box = Aabb::transformed(meshBounds, _transforms.world(object.transformIndex));
+
+		const glm::vec3 t1 = (box.min - origin) / direction;
+		const glm::vec3 t2 = (box.max - origin) / direction;
+		const glm::vec3 tNear = glm::min(t1, t2);
+		const glm::vec3 tFar = glm::max(t1, t2);
+		const float entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+		const float exit = std::min(std::min(tFar.x, tFar.y), tFar.z);
+		return entry <= exit ? entry : -1.0f;
+	};
+	return _renderBvh.raycast(origin, direction, std::numeric_limits<float>::max(), hit, renderIndex, distance);
+}
+
+void VulkanEngine::collect_debug_draw()
+{
+	if (_debugDrawFlags & (DEBUG_DRAW_BOUNDS | DEBUG_DRAW_BVH))
+	{
+		// deeper nodes shade from yellow towards red
+		_renderBvh.visit_nodes([this](const Aabb& bounds, int32_t depth, bool isLeaf) {
+			if (isLeaf && (_debugDrawFlags & DEBUG_DRAW_BOUNDS))
+			{
+				_debugDraw.box(bounds.min, bounds.max, DebugDraw::rgba(64, 255, 64));
+			}
+			else if (!isLeaf && (_debugDrawFlags & DEBUG_DRAW_BVH))
+			{
+				const uint8_t green = static_cast<uint8_t>(255 - std::min(depth, 12) * 20);
+				_debugDraw.box(bounds.min, bounds.max, DebugDraw::rgba(255, green, 32));
+			}
+		});
+	}
+
+	if (_debugDrawFlags & DEBUG_DRAW_CASCADES)
+	{
+		const uint32_t colors[] = { DebugDraw::rgba(255, 64, 64), DebugDraw::rgba(64, 255, 255),
+			DebugDraw::rgba(64, 64, 255), DebugDraw::rgba(255, 64, 255) };
+		for (uint32_t cascade = 0; cascade < ShadowCascades::CASCADE_COUNT; cascade++)
+		{
+			_debugDraw.frustum(glm::inverse(_shadows.view_projection(cascade)), 0.0f, 1.0f, colors[cascade % 4]);
+		}
+	}
+
+	if (_debugDrawFlags & DEBUG_DRAW_LIGHTS)
+	{
+		for (const GpuLight& light : _lights)
+		{
+			const glm::vec3 color = glm::clamp(glm::vec3(light.color), glm::vec3(0.0f), glm::vec3(1.0f)) * 255.0f;
+			_debugDraw.sphere(glm::vec3(light.positionRadius), light.positionRadius.w,
+				DebugDraw::rgba(static_cast<uint8_t>(color.r), static_cast<uint8_t>(color.g), static_cast<uint8_t>(color.b)));
+		}
+	}
+}
+
+void VulkanEngine::draw_debug_lines(VkCommandBuffer cmd, uint32_t cameraOffset)
+{
+	GpuAllocation vertices;
+	const uint32_t vertexCount = _debugDraw.upload(_frameGpuData, &vertices);
+	if (vertexCount == 0)
+	{
+		return;
+	}
+
+	VkViewport viewport = {};
+	viewport.width = (float)_renderExtent.width;
+	viewport.height = (float)_renderExtent.height;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(cmd, 0, 1, &viewport);
+	VkRect2D scissor = {};
+	scissor.extent = _renderExtent;
+	vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+	bind_graphics_pipeline(cmd, _debugLinePipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _debugLinePipelineLayout, 0, 1, &_globalDescriptor, 1, &cameraOffset);
+	vkCmdBindVertexBuffers(cmd, 0, 1, &vertices.buffer, &vertices.offset);
+	vkCmdDraw(cmd, vertexCount, 1, 0, 0);
+}
+
+void VulkanEngine::collect_text()
+{
+	char line[256];
+	if (_textFlags & TEXT_STATS)
+	{
+		const FrameStats& stats = _lastFrameStats;
+		snprintf(line, sizeof(line), "frame %d\n%u draws, %u pipelines, %llu triangles\n%zu objects, %u glyphs dropped",
+			_frameNumber, stats.drawCalls, stats.pipelineBinds, static_cast<unsigned long long>(stats.trianglesSubmitted), _renderables.size(),
+			_text.dropped_glyphs());
+		_text.text(glm::vec2(12.0f, 12.0f), line, 18.0f, DebugDraw::rgba(255, 255, 255));
+	}
+
+	if (_textFlags & TEXT_LABELS)
+	{
+		// just over the top of each box, so the label doesn't sit inside the object
+		const glm::vec3 eye = _camera.position();
+		const float maxDistance2 = _textLabelDistance * _textLabelDistance;
+		_renderBvh.query_frustum(_camera.frustum_planes(), [&](uint32_t index) {
+			const RenderObject& object = _renderables[index];
+			const Aabb& box = _entities.get<WorldBounds>(object.entity)->box;
+			const glm::vec3 anchor((box.min.x + box.max.x) * 0.5f, box.max.y, (box.min.z + box.max.z) * 0.5f);
+			const glm::vec3 offset = anchor - eye;
+			if (glm::dot(offset, offset) <= maxDistance2)
+			{
+				snprintf(line, sizeof(line), "entity %u", object.entity.index);
+				_text.label(anchor, line, 14.0f, DebugDraw::rgba(255, 230, 128));
+			}
+		});
+	}
+}
+
+void VulkanEngine::draw_text(VkCommandBuffer cmd, VkExtent2D extent)
+{
+	GpuAllocation instances;
+	const uint32_t glyphCount = _text.upload(_frameGpuData, &instances);
+	if (glyphCount == 0)
+	{
+		return;
+	}
+
+	VkViewport viewport = {};
+	viewport.width = (float)extent.width;
+	viewport.height = (float)extent.height;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(cmd, 0, 1, &viewport);
+	VkRect2D scissor = {};
+	scissor.extent = extent;
+	vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+	// unjittered, so labels don't shake with the upscaler's sample pattern
+	TextPushConstants constants;
+	constants.viewProjection = _camera.unjittered_view_projection();
+	constants.screen = glm::vec4(2.0f / extent.width, 2.0f / extent.height, extent.width, extent.height);
+
+	bind_graphics_pipeline(cmd, _textPipeline);
+	const VkDescriptorSet atlas = _text.set();
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _textPipelineLayout, 0, 1, &atlas, 0, nullptr);
+	vkCmdPushConstants(cmd, _textPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(TextPushConstants), &constants);
+	vkCmdBindVertexBuffers(cmd, 0, 1, &instances.buffer, &instances.offset);
+	vkCmdDraw(cmd, 6, glyphCount, 0, 0);
+}
+
+bool VulkanEngine::uses_predicates(const Mesh& mesh) const
+{
+	return _occlusionPredicates.ready() && mesh.get_lod(0).indexCount / 3 >= _predicateMinTriangles;
+}
+
+void VulkanEngine::draw_occlusion_queries(VkCommandBuffer cmd, uint32_t cameraOffset)
+{
+	VkViewport viewport = {};
+	viewport.width = (float)_renderExtent.width;
+	viewport.height = (float)_renderExtent.height;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(cmd, 0, 1, &viewport);
+	VkRect2D scissor = {};
+	scissor.extent = _renderExtent;
+	vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+	bind_graphics_pipeline(cmd, _occlusionBoxPipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _occlusionBoxPipelineLayout, 0, 1, &_globalDescriptor, 1, &cameraOffset);
+
+	// the near plane would cut the faces of a box around the camera away, and with them every sample, so
+	// boxes that close stay unqueried and their next draw unpredicated
+	const glm::vec3 eye = _camera.position();
+	const glm::vec3 margin(_camera.near_plane() * 2.0f);
+	for (uint32_t i = 0; i < _graphInputs.visibleCount; i++)
+	{
+		const RenderObject& object = _graphInputs.visible[i];
+		if (!uses_predicates(*object.mesh))
+		{
+			continue;
+		}
+		const Aabb& box = _entities.get<WorldBounds>(object.entity)->box;
+		if (glm::all(glm::greaterThan(eye, box.min - margin)) && glm::all(glm::lessThan(eye, box.max + margin)))
+		{
+			continue;
+		}
+		if (!_occlusionPredicates.begin_query(cmd, object.sceneIndex))
+		{
+			break;
+		}
+		const glm::vec4 corners[2] = { glm::vec4(box.min, 0.0f), glm::vec4(box.max, 0.0f) };
+		vkCmdPushConstants(cmd, _occlusionBoxPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(corners), corners);
+		vkCmdDraw(cmd, 36, 1, 0, 0);
+		_occlusionPredicates.end_query(cmd);
+	}
+}
 
-	vkb::Instance vkb_inst = inst_ret.value();
+void VulkanEngine::draw_particles(VkCommandBuffer cmd, uint32_t cameraOffset)
+{
+	// its layout differs from the mesh pipelines' in the push constants, so set 0 goes in again
+	bind_graphics_pipeline(cmd, _particlePipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _particlePipelineLayout, 0, 1, &_globalDescriptor, 1, &cameraOffset);
+	_particles.draw(cmd, _particlePipelineLayout, _particleEmitter.size);
+}
 
-	// store these so we can release them at program exit
-	_instance = vkb_inst.instance;
-	_debug_messenger = vkb_inst.debug_messenger;
+bool VulkanEngine::draws_as_impostor(const RenderObject& object) const
+{
+	// beyond the last level only: until then the LODs still cut the cost at full quality
+	const Mesh& mesh = *object.mesh;
+	if (_useLods && select_lod(object) + 1 < mesh.lod_count())
+	{
+		return false;
+	}
 
-	// get the surface of the window we opened with SDL in init()
-	SDL_Vulkan_CreateSurface(_window, _instance, &_surface);
+	const glm::mat4& model = _transforms.world(object.transformIndex);
+	const float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+	const glm::vec3 center = glm::vec3(model * glm::vec4(mesh._bounds.origin, 1.f));
+	const float radius = mesh._bounds.radius * scale;
+	const float distance = glm::length(center - _camera.position());
+	// the atlas's frames have the sphere's diameter across, so past this they'd be magnified
+	return distance > radius && 2.0f * radius * _lodPixelScale <= _impostorPixels * distance;
+}
 
-	// use vkbootstrap to select a GPU compatible with our SDL surface and Vulkan version
-	vkb::PhysicalDeviceSelector selector{ vkb_inst };
-	vkb::PhysicalDevice physicalDevice = selector
-		.set_minimum_version(1, 1)
-		.set_surface(_surface)
-		.select()
-		.value();
+void VulkanEngine::draw_impostors(VkCommandBuffer cmd, uint32_t cameraOffset)
+{
+	if (_impostors.instance_count() == 0)
+	{
+		return;
+	}
+	bind_graphics_pipeline(cmd, _impostorPipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _impostorPipelineLayout, 0, 1, &_globalDescriptor, 1, &cameraOffset);
+	_impostors.draw(cmd, _impostorPipelineLayout);
+}
 
-	// create Vulkan device
-	vkb::DeviceBuilder deviceBuilder{ physicalDevice };
-	vkb::Device vkbDevice = deviceBuilder.build().value();
+void VulkanEngine::draw_terrain(VkCommandBuffer cmd, uint32_t cameraOffset)
+{
+	if (!_useTerrain || _terrainPipeline == VK_NULL_HANDLE || _terrain.node_count() == 0)
+	{
+		return;
+	}
+	bind_graphics_pipeline(cmd, _terrainPipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _terrainPipelineLayout, 0, 1, &_globalDescriptor, 1, &cameraOffset);
+	_terrain.draw(cmd, _terrainPipelineLayout);
+
+	FrameStats& stats = frame_stats::local();
+	stats.drawCalls++;
+	stats.pipelineBinds++;
+	stats.trianglesSubmitted += _terrain.triangle_count();
+}
 
-	// get the VkDevice handle used in the rest of the Vulkan application
-	_device = vkbDevice.device;
-	_chosenGPU = physicalDevice.physical_device;
+void VulkanEngine::draw_foliage(VkCommandBuffer cmd, uint32_t cameraOffset)
+{
+	if (!_frameGraphKey.foliage || _foliagePipeline == VK_NULL_HANDLE || _foliage.patch_count() == 0)
+	{
+		return;
+	}
+	bind_graphics_pipeline(cmd, _foliagePipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _foliagePipelineLayout, 0, 1, &_globalDescriptor, 1, &cameraOffset);
+	_foliage.draw(cmd);
 
-	// use vkbootstrap to get a graphics queue
-	_graphicsQueue = vkbDevice.get_queue(vkb::QueueType::graphics).value();
-	_graphicsQueueFamily = vkbDevice.get_queue_index(vkb::QueueType::graphics).value();
+	FrameStats& stats = frame_stats::local();
+	stats.drawCalls += Foliage::LOD_COUNT;
+	stats.pipelineBinds++;
 
-	// initialize memory allocator 
-	VmaAllocatorCreateInfo allocatorInfo = {};
-	allocatorInfo.physicalDevice = _chosenGPU;
-	allocatorInfo.device = _device;
-	allocatorInfo.instance = _instance;
-	vmaCreateAllocator(&allocatorInfo, &_allocator);
+	// the atlas is the impostors' set 1 like any mesh's; the quads come from the foliage pass
+	if (_foliage.has_impostors() && _impostorPipeline != VK_NULL_HANDLE)
+	{
+		const VkDescriptorSet atlas = _impostors.set();
+		bind_graphics_pipeline(cmd, _impostorPipeline);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _impostorPipelineLayout, 0, 1, &_globalDescriptor, 1, &cameraOffset);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _impostorPipelineLayout, 1, 1, &atlas, 0, nullptr);
+		_foliage.draw_impostors(cmd);
+		stats.drawCalls++;
+		stats.pipelineBinds++;
+	}
 }
 
-void VulkanEngine::init_swapchain()
+void VulkanEngine::draw_transparent(VkCommandBuffer cmd, uint32_t cameraOffset, bool weightedBlended)
 {
-	vkb::SwapchainBuilder swapchainBuilder(_chosenGPU, _device, _surface);
-
-	vkb::Swapchain vkbSwapchain = swapchainBuilder
-		.use_default_format_selection()
-		.set_desired_present_mode(VK_PRESENT_MODE_FIFO_KHR) // hard VSYNC
-		.set_desired_extent(_windowExtent.width, _windowExtent.height)
-		.build()
-		.value();
+	VkViewport viewport = {};
+	viewport.width = (float)_renderExtent.width;
+	viewport.height = (float)_renderExtent.height;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(cmd, 0, 1, &viewport);
+	VkRect2D scissor = {};
+	scissor.extent = _renderExtent;
+	vkCmdSetScissor(cmd, 0, 1, &scissor);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _transparentPipelineLayout, 0, 1, &_globalDescriptor, 1, &cameraOffset);
+
+	// streaming meshes draw as the placeholder until they are in, like the crowd
+	Mesh* placeholder = get_mesh("placeholder");
+	auto drawn_mesh = [placeholder](const TransparentObject& object) -> const Mesh& {
+		return object.mesh->_resident ? *object.mesh : *placeholder;
+	};
 
-	// store swapchain & images
-	_swapchain = vkbSwapchain.swapchain;
-	_swapchainImages = vkbSwapchain.get_images().value();
-	_swapchainImageViews = vkbSwapchain.get_image_views().value();
+	// sorted by the view depth of each bounding sphere's center, farthest first; objects that pass through
+	// each other still blend in one order, which only splitting them would fix. The weighted sums come out
+	// the same in any order, so they go as they are
+	const uint32_t count = static_cast<uint32_t>(_transparentObjects.size());
+	const uint32_t* order = nullptr;
+	if (!weightedBlended)
+	{
+		const glm::mat4& view = _camera.view();
+		_transparentDepths.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const TransparentObject& object = _transparentObjects[i];
+			const glm::vec4 center = object.transform * glm::vec4(drawn_mesh(object)._bounds.origin, 1.f);
+			_transparentDepths[i] = -(view * center).z;
+		}
+		order = _transparentSorter.sort_back_to_front(_transparentDepths.data(), count).data();
+	}
 
-	_swapchainImageFormat = vkbSwapchain.image_format;
+	VkPipeline lastPipeline = VK_NULL_HANDLE;
+	VkIndexType lastIndexType = VK_INDEX_TYPE_MAX_ENUM;
+	uint32_t lastVertexStream = UINT32_MAX;
+	FrameStats& stats = frame_stats::local();
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const TransparentObject& object = _transparentObjects[order ? order[i] : i];
+		const Mesh& mesh = drawn_mesh(object);
+		const VkPipeline pipeline = _transparentPipelines[static_cast<uint32_t>(mesh._vertexFormat)];
+		if (pipeline == VK_NULL_HANDLE)
+		{
+			continue;
+		}
+		if (pipeline != lastPipeline)
+		{
+			bind_graphics_pipeline(cmd, pipeline);
+			lastPipeline = pipeline;
+			stats.pipelineBinds++;
+		}
 
-	// add to deletion queue
-	_mainDeletionQueue.push_function([=]() {
-		vkDestroySwapchainKHR(_device, _swapchain, nullptr);
-	});
+		const MeshAllocation& geometry = mesh._poolAllocation;
+		if (geometry.vertexStream != lastVertexStream)
+		{
+			bind_vertex_stream(cmd, geometry.vertexStream);
+			lastVertexStream = geometry.vertexStream;
+		}
+		if (mesh._indexType != lastIndexType)
+		{
+			vkCmdBindIndexBuffer(cmd, _meshPool.index_buffer(mesh._indexType)._buffer, 0, mesh._indexType);
+			lastIndexType = mesh._indexType;
+		}
 
-	// init depth image
-	VkExtent3D depthImageExtent = {
-		_windowExtent.width,
-		_windowExtent.height,
-		1
-	};
+		const TransparentPushConstants constants = { object.transform * mesh._dequantize, object.color };
+		vkCmdPushConstants(cmd, _transparentPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(constants), &constants);
 
-	_depthFormat = VK_FORMAT_D32_SFLOAT;
-	VkImageCreateInfo dimg_info = vkinit::image_create_info(_depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, depthImageExtent);
-	VmaAllocationCreateInfo dimg_allocinfo = {};
-	// allocate depth image from GPU local memory
-	dimg_allocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-	dimg_allocinfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		const MeshLod lod = mesh.get_lod(0);
+		vkCmdDrawIndexed(cmd, lod.indexCount, 1, geometry.firstIndex + lod.firstIndex, static_cast<int32_t>(geometry.vertexOffset), 0);
+		stats.pushConstantUploads++;
+		stats.drawCalls++;
+		stats.trianglesSubmitted += lod.indexCount / 3;
+	}
+}
 
-	// allocate and create the image
-	vmaCreateImage(_allocator, &dimg_info, &dimg_allocinfo, &_depthImage._image, &_depthImage._allocation, nullptr);
-	// build an image-view for depth image to use for rendering
-	VkImageViewCreateInfo dview_info = vkinit::imageview_create_info(_depthFormat, _depthImage._image, VK_IMAGE_ASPECT_DEPTH_BIT);
-	VK_CHECK(vkCreateImageView(_device, &dview_info, nullptr, &_depthImageView));
+void VulkanEngine::draw_oit_composite(VkCommandBuffer cmd)
+{
+	VkViewport viewport = {};
+	viewport.width = (float)_renderExtent.width;
+	viewport.height = (float)_renderExtent.height;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(cmd, 0, 1, &viewport);
+	VkRect2D scissor = {};
+	scissor.extent = _renderExtent;
+	vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+	// texel fetches, so the sampler only has to be there
+	const DescriptorWrite writes[] = {
+		DescriptorWrite::image_write(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _linearSampler, _frameGraph.view(_graphOitAccumulation),
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+		DescriptorWrite::image_write(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _linearSampler, _frameGraph.view(_graphOitRevealage),
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+	};
+	const VkDescriptorSet set = _descriptorSetCache.get(_frameNumber % _frameOverlap, _oitCompositeSetLayout, writes, 2);
 
-	// add to deletion queues
-	_mainDeletionQueue.push_function([=]() {
-		vkDestroyImageView(_device, _depthImageView, nullptr);
-		vmaDestroyImage(_allocator, _depthImage._image, _depthImage._allocation);
-	});
+	bind_graphics_pipeline(cmd, _oitCompositePipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _oitCompositePipelineLayout, 0, 1, &set, 0, nullptr);
+	vkCmdDraw(cmd, 3, 1, 0, 0);
 }
 
-void VulkanEngine::init_commands()
+void VulkanEngine::draw_shadow_casters(VkCommandBuffer cmd, uint32_t cascade, bool staticCasters)
 {
-	// create a command pool for cmds submitted to the graphics queue
-	// VkCommandPoolCreateInfo is a structure to specify params for a newly created cmd pool
-	VkCommandPoolCreateInfo cmdPoolInfo = vkinit::command_pool_create_info(_graphicsQueueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+	const glm::mat4& viewProjection = _shadows.view_projection(cascade);
+	glm::vec4 planes[6];
+	Camera::extract_frustum_planes(viewProjection, planes);
+
+	// casters arrive in tree order; with one pipeline per vertex format, rebinding stays cheap
+	// both faces cast, as the shadow pipelines are built
+	VkPipeline lastPipeline = VK_NULL_HANDLE;
+	VkIndexType lastIndexType = VK_INDEX_TYPE_MAX_ENUM;
+	uint32_t lastVertexStream = UINT32_MAX;
+	set_draw_state(cmd, true, VK_CULL_MODE_NONE, false);
+	FrameStats& stats = frame_stats::local();
+	_renderBvh.query_frustum(planes, [&](uint32_t index) {
+		const RenderObject& object = _renderables[index];
+		if (object.isStatic != staticCasters)
+		{
+			return;
+		}
 
-	VK_CHECK(vkCreateCommandPool(_device, &cmdPoolInfo, nullptr, &_commandPool)); // note _commandPool gets overwritten here
+		VkPipeline pipeline;
+		switch (object.mesh->_vertexFormat)
+		{
+		case VertexFormat::Packed:
+			pipeline = _shadowPackedMeshPipeline;
+			break;
+		case VertexFormat::Split:
+			pipeline = _shadowSplitMeshPipeline;
+			break;
+		case VertexFormat::Voxel:
+			pipeline = _shadowVoxelMeshPipeline;
+			break;
+		default:
+			pipeline = _shadowMeshPipeline;
+			break;
+		}
+		if (pipeline != lastPipeline)
+		{
+			bind_graphics_pipeline(cmd, pipeline);
+			lastPipeline = pipeline;
+			stats.pipelineBinds++;
+		}
 
-	// allocate the default cmd buff for rendering
-	VkCommandBufferAllocateInfo cmdAllocInfo = vkinit::command_buffer_allocate_info(_commandPool, 1);
+		const MeshAllocation& geometry = object.mesh->_poolAllocation;
+		if (geometry.vertexStream != lastVertexStream)
+		{
+			bind_vertex_stream(cmd, geometry.vertexStream);
+			lastVertexStream = geometry.vertexStream;
+		}
+		if (object.mesh->_indexType != lastIndexType)
+		{
+			vkCmdBindIndexBuffer(cmd, _meshPool.index_buffer(object.mesh->_indexType)._buffer, 0, object.mesh->_indexType);
+			lastIndexType = object.mesh->_indexType;
+		}
 
-	VK_CHECK(vkAllocateCommandBuffers(_device, &cmdAllocInfo, &_mainCommandBuffer));
+		const glm::mat4 lightMvp = viewProjection * _transforms.world(object.transformIndex) * object.mesh->_dequantize;
+		vkCmdPushConstants(cmd, _shadowPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &lightMvp);
 
-	// add to deletion queue
-	_mainDeletionQueue.push_function([=]() {
-		vkDestroyCommandPool(_device, _commandPool, nullptr);
+		const MeshLod lod = object.mesh->get_lod(staticCasters ? 0 : select_lod(object));
+		vkCmdDrawIndexed(cmd, lod.indexCount, 1, geometry.firstIndex + lod.firstIndex, static_cast<int32_t>(geometry.vertexOffset), 0);
+		stats.pushConstantUploads++;
+		stats.drawCalls++;
+		stats.trianglesSubmitted += lod.indexCount / 3;
 	});
 }
 
-void VulkanEngine::init_default_renderpass()
+uint32_t VulkanEngine::select_lod(const RenderObject& object) const
 {
-	// create description for color pass
-	VkAttachmentDescription color_attachment = {};
-	color_attachment.format = _swapchainImageFormat; // needs to be compatible with the swapchain format
-	color_attachment.samples = VK_SAMPLE_COUNT_1_BIT; // 1 sample; no MSAA
-	color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE; // keep attachment when renderpass ends
-	
-	// no stencil
-	color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	const Mesh& mesh = *object.mesh;
+	if (!_useLods || mesh.lod_count() < 2)
+	{
+		return 0;
+	}
 
-	// don't care about starting layout
-	color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	// same conservative world-space sphere as the cull shader
+	const glm::mat4& model = _transforms.world(object.transformIndex);
+	float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+	glm::vec3 center = glm::vec3(model * glm::vec4(mesh._bounds.origin, 1.f));
+	float distance = glm::length(center - _camera.position()) - mesh._bounds.radius * scale;
+	if (distance <= 0.f || scale <= 0.f)
+	{
+		return 0;
+	}
 
-	// after renderpass ends, image needs to be ready for display
-	color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	// largest mesh-space error still projecting below _lodPixelError pixels at the nearest point of the sphere
+	float maxError = _lodPixelError * distance / (_lodPixelScale * scale);
+	return mesh.select_lod(maxError);
+}
 
-	VkAttachmentReference color_attachment_ref = {};
-	// attachment number is index in pAttachments array in parent renderpass
-	color_attachment_ref.attachment = 0;
-	color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+FrameData& VulkanEngine::get_current_frame()
+{
+	return _frames[_frameNumber % _frameOverlap];
+}
 
-	VkAttachmentDescription depth_attachment = {};
-	depth_attachment.flags = 0;
-	depth_attachment.format = _depthFormat;
-	depth_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
-	depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-	depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	depth_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	depth_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+void VulkanEngine::begin_update(double elapsedSeconds)
+{
+	// draw() may have returned early without consuming the last update
+	_jobSystem.wait(_simulationJob);
+	_jobSystem.run([this, elapsedSeconds]() { _simulation.advance(elapsedSeconds); }, &_simulationJob);
+}
 
-	VkAttachmentReference depth_attachment_ref = {};
-	depth_attachment_ref.attachment = 1;
-	depth_attachment_ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+const SimulationState& VulkanEngine::wait_for_update()
+{
+	CPU_PROFILE_SCOPE("wait_for_update");
+	_jobSystem.wait(_simulationJob);
+	return _simulation.snapshot();
+}
 
-	// create 1 subpass (required 1)
-	VkSubpassDescription subpass = {};
-	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpass.colorAttachmentCount = 1;
-	subpass.pColorAttachments = &color_attachment_ref;
-	subpass.pDepthStencilAttachment = &depth_attachment_ref;
+void VulkanEngine::run()
+{
+	SDL_Event e;
+	bool bQuit = false;
+	auto lastUpdate = std::chrono::steady_clock::now();
+	if (!_inputRecordPath.empty())
+	{
+		_inputRecording.start();
+	}
+	if (_renderOnDemand)
+	{
+		request_redraw();
+	}
 
-	VkAttachmentDescription attachments[2] = { color_attachment, depth_attachment };
+	// main loop; a lost device ends it like a quit, with device_lost() telling the two apart
+	while (!bQuit && !_deviceLost)
+	{
+		// a headless run has no events, only a frame budget
+		if (_headless && _frameNumber >= static_cast<int>(_headlessFrames))
+		{
+			break;
+		}
 
-	// 1 dependency
-	VkSubpassDependency dependency = {};
-	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-	dependency.dstSubpass = 0;
-	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.srcAccessMask = 0;
-	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		idle_frame();
+		const bool undamaged = wait_for_damage();
+		// just in time: the input below goes into a frame that starts rendering right away
+		pace_frame();
+		get_current_frame()._inputTime = std::chrono::steady_clock::now();
 
-	// makes this subpass dependent on previous render pass
-	VkSubpassDependency depth_dependency = {};
-	depth_dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-	depth_dependency.dstSubpass = 0;
-	depth_dependency.srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-	depth_dependency.srcAccessMask = 0;
-	depth_dependency.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-	depth_dependency.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		// Handle events on queue
+		while (_window != nullptr && SDL_PollEvent(&e) != 0)
+		{
+			_inputRecording.add_event(e);
+			handle_event(e, bQuit);
+			request_redraw();
+		}
 
-	VkSubpassDependency dependencies[2] = { dependency, depth_dependency };
+		// real time since the last update, consumed in fixed steps so animation speed doesn't follow the frame rate;
+		// none passes while on demand waited, so the clock starts again from the input that woke it
+		auto now = std::chrono::steady_clock::now();
+		const double elapsed = undamaged ? 0.0 : std::chrono::duration<double>(now - lastUpdate).count();
+		_inputRecording.end_frame(elapsed);
+		begin_update(elapsed);
+		lastUpdate = now;
 
-	// actually create render pass
-	VkRenderPassCreateInfo render_pass_info = {};
-	render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	// connect color attachment, depth attachment, and subpass to info
-	render_pass_info.attachmentCount = 2;
-	render_pass_info.pAttachments = &attachments[0];
-	render_pass_info.subpassCount = 1;
-	render_pass_info.pSubpasses = &subpass;
-	render_pass_info.dependencyCount = 2;
-	render_pass_info.pDependencies = &dependencies[0];
+		draw();
+		end_cpu_frame();
 
-	VK_CHECK(vkCreateRenderPass(_device, &render_pass_info, nullptr, &_renderPass));
+		if (_renderOnDemand)
+		{
+			_lastDrawn = std::chrono::steady_clock::now();
+			_redrawFrames -= std::min(_redrawFrames, 1u);
+			if (_camera.unjittered_view_projection() != _drawnViewProjection)
+			{
+				_drawnViewProjection = _camera.unjittered_view_projection();
+				request_redraw();
+			}
+		}
+	}
 
-	// add to deletion queue
-	_mainDeletionQueue.push_function([=]() {
-		vkDestroyRenderPass(_device, _renderPass, nullptr);
-	});
+	if (_inputRecording.recording())
+	{
+		const bool written = _inputRecording.save(_inputRecordPath.c_str());
+		LOG_INFO((written ? "Wrote " : "Could not write ") << _inputRecording.frame_count() << " frames of input to " << _inputRecordPath);
+	}
 }
 
-void VulkanEngine::init_framebuffers()
+void VulkanEngine::handle_event(const SDL_Event& e, bool& quit)
 {
-	// create framebuffers for swapchain images
-	// connect renderpass to the images for rendering
-	VkFramebufferCreateInfo fb_info = {};
-	fb_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-	fb_info.pNext = nullptr;
-
-	fb_info.renderPass = _renderPass;
-	fb_info.attachmentCount = 1;
-	fb_info.width = _windowExtent.width;
-	fb_info.height = _windowExtent.height;
-	fb_info.layers = 1;
-
-	// read # of images in swapchain
-	const uint32_t swapchain_image_count = _swapchainImages.size();
-
-	// create framebuffers for each swapchain image view
-	_framebuffers = std::vector<VkFramebuffer>(swapchain_image_count);
-	for (uint32_t i = 0; i < swapchain_image_count; i++)
+	// clicks and keys meant for the overlay's windows go no further
+	if (_hud.process_event(e))
 	{
-		VkImageView attachments[2];
-		attachments[0] = _swapchainImageViews[i];
-		attachments[1] = _depthImageView;
-
-		fb_info.pAttachments = attachments;
-		fb_info.attachmentCount = 2;
-		VK_CHECK(vkCreateFramebuffer(_device, &fb_info, nullptr, &_framebuffers[i]));
+		return;
+	}
 
-		// add to deletion queue
-		_mainDeletionQueue.push_function([=]() {
-			vkDestroyFramebuffer(_device, _framebuffers[i], nullptr);
-			vkDestroyImageView(_device, _swapchainImageViews[i], nullptr);
-		});
+	// close the window when user alt-f4s or clicks the X button			
+	if (e.type == SDL_QUIT)
+	{
+		quit = true;
+	}
+	else if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
+	{
+		// the swapchain is rebuilt at the start of the next draw
+		_resizeRequested = true;
+	}
+	else if (e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_LEFT && _frameGraphKey.picking)
+	{
+		// a few pixels around the cursor, so thin objects don't need to be hit exactly; the answer comes
+		// with the frame slot's fence
+		_objectPicker.request(e.button.x, e.button.y, 5, _windowExtent);
+	}
+	else if (e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_LEFT)
+	{
+		// unproject the cursor at two depths to get the ray through it, the nearer one first; halfway
+		// rather than at the far plane, which may be at infinity
+		const glm::mat4 inverseViewProjection = glm::inverse(_camera.view_projection());
+		const float x = 2.0f * e.button.x / _windowExtent.width - 1.0f;
+		const float y = 2.0f * e.button.y / _windowExtent.height - 1.0f;
+		glm::vec4 nearPoint = inverseViewProjection * glm::vec4(x, y, _camera.reverse_z() ? 1.0f : 0.0f, 1.0f);
+		glm::vec4 farPoint = inverseViewProjection * glm::vec4(x, y, 0.5f, 1.0f);
+		const glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+		const glm::vec3 direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
+
+		uint32_t picked;
+		float distance;
+		if (pick(origin, direction, picked, distance))
+		{
+			LOG_INFO("Picked render object " << picked << " at distance " << distance);
+		}
+		else
+		{
+			LOG_INFO("Nothing under the cursor");
+		}
+	}
+	else if (e.type == SDL_KEYDOWN)
+	{
+		switch (e.key.keysym.sym)
+		{
+		case SDLK_F1:
+			_hud.set_visible(!_hud.visible());
+			break;
+		case SDLK_F2:
+			_debugView = static_cast<DebugView>((static_cast<uint32_t>(_debugView) + 1) % DEBUG_VIEW_COUNT);
+			LOG_INFO("Debug view: " << debug_view_name(_debugView));
+			break;
+		case SDLK_SPACE:
+			_altFloorMaterial = !_altFloorMaterial;
+			swap_material(get_material(_altFloorMaterial ? "floor" : "floor_alt"), get_material(_altFloorMaterial ? "floor_alt" : "floor"));
+			break;
+		case SDLK_p:
+		{
+			// cycle FIFO -> MAILBOX -> IMMEDIATE -> FIFO_RELAXED; unsupported modes fall back
+			static const VkPresentModeKHR modes[] = {
+				VK_PRESENT_MODE_FIFO_KHR,
+				VK_PRESENT_MODE_MAILBOX_KHR,
+				VK_PRESENT_MODE_IMMEDIATE_KHR,
+				VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+			};
+			_presentModeCycleIndex = (_presentModeCycleIndex + 1) % 4;
+			set_present_mode(modes[_presentModeCycleIndex]);
+			break;
+		}
+		case SDLK_c:
+			_gpuCulling = !_gpuCulling;
+			_cpuCulling = _gpuCulling;
+			LOG_INFO("Frustum culling: " << (_gpuCulling ? "on" : "off"));
+			break;
+		case SDLK_o:
+			_occlusionCulling = !_occlusionCulling;
+			LOG_INFO("Occlusion culling: " << (_occlusionCulling && _occlusionCullingSupported ? "on" : (_occlusionCullingSupported ? "off" : "not supported")));
+			break;
+		case SDLK_l:
+			_useLods = !_useLods;
+			LOG_INFO("LODs: " << (_useLods ? "on" : "off"));
+			break;
+		case SDLK_k:
+			_clusterCulling = !_clusterCulling;
+			LOG_INFO("Cluster culling: " << (_clusterCulling ? "on" : "off"));
+			break;
+		case SDLK_t:
+			_useMeshShading = !_useMeshShading;
+			LOG_INFO("Mesh shading: " << (_useMeshShading && _meshShadingSupported ? "on" : (_meshShadingSupported ? "off" : "not supported")));
+			break;
+		case SDLK_m:
+			_useIndirectDraws = !_useIndirectDraws;
+			LOG_INFO("Indirect draws: " << (_useIndirectDraws ? "on" : "off"));
+			break;
+		case SDLK_h:
+			_useShadows = !_useShadows;
+			LOG_INFO("Shadows: " << (_useShadows ? "on" : "off"));
+			break;
+		case SDLK_j:
+			_lowLatency = !_lowLatency;
+			_latencyTotalMs = 0.0;
+			_latencySamples = 0;
+			_latencyReportStart = std::chrono::steady_clock::now();
+			_displayTiming.take_totals();
+			LOG_INFO("Low-latency pacing: " << (_lowLatency ? (_presentWaitSupported ? "on, waiting for presents" : "on, waiting for the GPU") : "off")
+				<< (_lowLatency && _displayTiming.enabled() ? ", presents scheduled on the display's cadence" : ""));
+			break;
+		case SDLK_r:
+			_dynamicResolution = !_dynamicResolution;
+			LOG_INFO("Dynamic resolution: " << (_dynamicResolution && _dynamicResolutionSupported ? "on" : (_dynamicResolutionSupported ? "off" : "not supported")));
+			break;
+		case SDLK_v:
+		{
+			// digs out the block at the center of the view; the chunks it touches remesh next frame
+			const glm::mat4& view = _camera.view();
+			const glm::vec3 forward = -glm::vec3(view[0][2], view[1][2], view[2][2]);
+			glm::ivec3 hit;
+			glm::ivec3 previous;
+			if (_voxelWorld.raycast(_camera.position(), forward, 64.f, hit, previous))
+			{
+				_voxelWorld.set(hit, VOXEL_AIR);
+			}
+			break;
+		}
+		case SDLK_i:
+			// 1 -> 1000 -> MAX_INSTANCES -> 1
+			_instanceCount = _instanceCount == 1 ? 1000 : (_instanceCount == 1000 ? MAX_INSTANCES : 1);
+			LOG_INFO("Instances: " << _instanceCount);
+			break;
+		}
 	}
 }
 
-void VulkanEngine::init_sync_structures()
+void VulkanEngine::run_frames(uint32_t frames)
 {
-	// create synchronization structures
-	VkFenceCreateInfo fenceCreateInfo = vkinit::fence_create_info(VK_FENCE_CREATE_SIGNALED_BIT);
-
-	VK_CHECK(vkCreateFence(_device, &fenceCreateInfo, nullptr, &_renderFence));
+	_headlessFrames = static_cast<uint32_t>(_frameNumber) + frames;
+	run();
+}
 
-	// add to deletion queue
-	_mainDeletionQueue.push_function([=]() {
-		vkDestroyFence(_device, _renderFence, nullptr);
+void VulkanEngine::render_tiles(TiledImageWriter& writer, uint32_t first, uint32_t count)
+{
+	render_tiles(first, count, [&](const FrameReadback::Result& result, uint32_t tile) {
+		if (!writer.write_tile(result, tile % _tileGrid.columns, tile / _tileGrid.columns))
+		{
+			LOG_ERROR("Could not write tile " << tile << " of the tiled render");
+		}
 	});
+}
 
-	VkSemaphoreCreateInfo semaphoreCreateInfo = vkinit::semaphore_create_info();
+void VulkanEngine::render_tiles(uint32_t first, uint32_t count, const TileCallback& callback)
+{
+	CPU_PROFILE_SCOPE("render_tiles");
+	// the last frame of every tile still to be delivered, with the tile
+	std::vector<std::pair<int, uint32_t>> pending;
+	_onFrameReadback = [&](const FrameReadback::Result& result) {
+		auto found = std::find_if(pending.begin(), pending.end(), [&](const std::pair<int, uint32_t>& entry) {
+			return entry.first == result.frameNumber;
+		});
+		if (found == pending.end())
+		{
+			return;
+		}
+		callback(result, found->second);
+		pending.erase(found);
+	};
 
-	VK_CHECK(vkCreateSemaphore(_device, &semaphoreCreateInfo, nullptr, &_presentSemaphore));
-	VK_CHECK(vkCreateSemaphore(_device, &semaphoreCreateInfo, nullptr, &_renderSemaphore));
+	// every tile sees the scene at one instant, the simulation stepping by nothing
+	while (!_deviceLost && streaming_busy())
+	{
+		begin_update(0.0);
+		draw();
+	}
+	// as after a redraw request: the depth pyramid and the upscaler's history are the previous tile's until then
+	const uint32_t settle = _useTemporalUpscale ? TemporalUpscaler::JITTER_PHASES : _frameOverlap + 1;
+	for (uint32_t tile = first; tile < first + count && tile < _tileGrid.count() && !_deviceLost; tile++)
+	{
+		_camera.set_tile(tile % _tileGrid.columns, tile / _tileGrid.columns, _tileGrid.columns, _tileGrid.rows);
+		for (uint32_t frame = 0; frame < settle && !_deviceLost; frame++)
+		{
+			begin_update(0.0);
+			draw();
+		}
+		pending.push_back({ _frameNumber - 1, tile });
+	}
 
-	// add to deletion queue
-	_mainDeletionQueue.push_function([=]() {
-		vkDestroySemaphore(_device, _presentSemaphore, nullptr);
-		vkDestroySemaphore(_device, _renderSemaphore, nullptr);
-	});
+	// the last tiles are still in flight
+	wait_device_idle();
+	if (!_deviceLost)
+	{
+		deliver_pending_readbacks(_onFrameReadback);
+	}
+	_onFrameReadback = nullptr;
+	_camera.set_tile(0, 0, 1, 1);
 }
 
-bool VulkanEngine::load_shader_module(const char* filePath, VkShaderModule* outShaderModule)
+bool VulkanEngine::render_frames(uint64_t first, uint32_t count, const VideoEncoder::Callback& callback)
 {
-	std::ifstream file(filePath, std::ios::ate | std::ios::binary);
-
-	if (!file.is_open())
+	CPU_PROFILE_SCOPE("render_frames");
+	if (!_useVideoEncode || !_videoEncoder.ready())
 	{
 		return false;
 	}
+	// as many frames ahead as render_tiles() settles for, so the first one handed out looks like it would in
+	// the middle of a run
+	const uint32_t settle = _useTemporalUpscale ? TemporalUpscaler::JITTER_PHASES : _frameOverlap + 1;
+	const uint64_t start = first > settle ? first - settle : 0;
+	seek_simulation(start);
+
+	// the frame number the first frame handed out gets, once known
+	int firstFrame = std::numeric_limits<int>::max();
+	_onEncodedFrame = [&](const VideoEncoder::Packet& packet) {
+		if (packet.frameNumber >= firstFrame && static_cast<uint32_t>(packet.frameNumber - firstFrame) < count)
+		{
+			callback(packet);
+		}
+	};
 
-	// load the file onto buffer
-	size_t fileSize = (size_t)file.tellg();
-	std::vector<uint32_t> buffer(fileSize / sizeof(uint32_t));
-	file.seekg(0);
-	file.read((char*)buffer.data(), fileSize);
-	file.close();
-
-	// load the shader into vulkan
-	VkShaderModuleCreateInfo createInfo = {};
-	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	createInfo.pNext = nullptr;
-
-	createInfo.codeSize = buffer.size() * sizeof(uint32_t);
-	createInfo.pCode = buffer.data();
+	// streaming holds the path at its start
+	while (!_deviceLost && streaming_busy())
+	{
+		begin_update(0.0);
+		draw();
+	}
+	for (uint64_t tick = start; tick < first + count && !_deviceLost; tick++)
+	{
+		if (tick == first)
+		{
+			firstFrame = _frameNumber;
+			_videoEncoder.force_key_frame();
+		}
+		// a step a frame; the frame shows the step it starts from, so frame tick shows step tick, as in a benchmark
+		begin_update(_simulation.step_seconds());
+		draw();
+	}
 
-	VkShaderModule shaderModule;
-	if (vkCreateShaderModule(_device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
+	wait_device_idle();
+	if (!_deviceLost)
 	{
-		return false;
+		deliver_pending_encodes();
 	}
-	*outShaderModule = shaderModule;
-	return true;
+	_onEncodedFrame = nullptr;
+	return !_deviceLost;
+}
+
+void VulkanEngine::seek_simulation(uint64_t tick)
+{
+	// no update may be running while it jumps
+	wait_for_update();
+	_simulation.seek(tick);
 }
 
-void VulkanEngine::init_pipelines()
+void VulkanEngine::end_cpu_frame()
 {
-	VkShaderModule helloTriangleFragShader;
-	if (!load_shader_module("../../shaders/helloTriangle.frag.spv", &helloTriangleFragShader))
+	// draw() has moved on to the next frame number by now
+	cpu_profiler::end_frame(static_cast<int64_t>(_frameNumber) - 1);
+	if (_logCpuTimings)
 	{
-		std::cout << "Error building triangle frag shader." << std::endl;
+		LOG_INFO(cpu_profiler::format_latest());
 	}
-	else
+	// a frame run() slept before is slow on purpose
+	if (!_frameIdled)
 	{
-		std::cout << "Hello triangle frag shader successfully loaded." << std::endl;
+		_hitches.end_frame(static_cast<int64_t>(_frameNumber) - 1, cpu_profiler::latest().milliseconds, _lastFrameHeapAllocations, _gpuProfiler.latest());
 	}
 
-	VkShaderModule helloTriangleVertexShader;
-	if (!load_shader_module("../../shaders/helloTriangle.vert.spv", &helloTriangleVertexShader))
+	if (!_cpuTracePath.empty() && _frameNumber >= static_cast<int>(_cpuTraceFrames) && cpu_profiler::is_capturing())
 	{
-		std::cout << "Error building triangle vert shader." << std::endl;
+		const bool written = cpu_profiler::end_capture(_cpuTracePath);
+		LOG_INFO((written ? "Wrote CPU trace to " : "Could not write CPU trace to ") << _cpuTracePath);
 	}
-	else
+}
+
+void VulkanEngine::idle_frame()
+{
+	// long enough to cost nothing, short enough that asset streaming and the simulation keep ticking
+	constexpr uint32_t HIDDEN_WAIT_MS = 250;
+	// sleeps overshoot by up to a scheduler tick, so they stop this short of the deadline and yield the rest
+	constexpr auto SPIN_MARGIN = std::chrono::microseconds(1500);
+
+	_frameIdled = false;
+	if (_window == nullptr)
 	{
-		std::cout << "Hello triangle vert shader successfully loaded." << std::endl;
+		return;
 	}
 
-	VkShaderModule altHelloFragShader;
-	if (!load_shader_module("../../shaders/helloTriangleV2.frag.spv", &altHelloFragShader))
+	const uint32_t flags = SDL_GetWindowFlags(_window);
+	if (flags & (SDL_WINDOW_MINIMIZED | SDL_WINDOW_HIDDEN))
 	{
-		std::cout << "Error building triangle 2 frag shader." << std::endl;
+		// a null event leaves whatever woke the wait in the queue for run()
+		SDL_WaitEventTimeout(nullptr, HIDDEN_WAIT_MS);
+		_frameIdled = true;
+		return;
 	}
-	else
+
+	const auto now = std::chrono::steady_clock::now();
+	if (_backgroundFps == 0 || (flags & SDL_WINDOW_INPUT_FOCUS))
 	{
-		std::cout << "Hello triangle frag 2 shader successfully loaded." << std::endl;
+		_backgroundFrameDeadline = now;
+		return;
 	}
 
-	VkShaderModule altHelloVertexShader;
-	if (!load_shader_module("../../shaders/helloTriangleV2.vert.spv", &altHelloVertexShader))
+	const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / _backgroundFps));
+	// a frame that ran long starts the cadence over rather than hurrying the next ones
+	const auto deadline = std::max(_backgroundFrameDeadline + period, now);
+	if (deadline - now > SPIN_MARGIN)
 	{
-		std::cout << "Error building triangle 2 vert shader." << std::endl;
+		std::this_thread::sleep_for(deadline - now - SPIN_MARGIN);
 	}
-	else
+	while (std::chrono::steady_clock::now() < deadline)
 	{
-		std::cout << "Hello triangle vert 2 shader successfully loaded." << std::endl;
+		std::this_thread::yield();
 	}
+	_backgroundFrameDeadline = deadline;
+	_frameIdled = true;
+}
 
-	// build the pipeline layout that controls inputs/outputs of the shader
-	// just build empty default for now
-	VkPipelineLayoutCreateInfo pipeline_layout_info = vkinit::pipeline_layout_create_info();
-	VK_CHECK(vkCreatePipelineLayout(_device, &pipeline_layout_info, nullptr, &_trianglePipelineLayout));
-
-	// build the stage-create-info for both vertex and frag stages
-	// defines shader modules per stage
-	PipelineBuilder pipelineBuilder;
-
-	pipelineBuilder._shaderStages.push_back(
-		vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, helloTriangleVertexShader)
-	);
-
-	pipelineBuilder._shaderStages.push_back(
-		vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, helloTriangleFragShader)
-	);
-
-	// controls vertex buffer attributes - not using yet
-	pipelineBuilder._vertexInputInfo = vkinit::vertex_input_state_create_info();
-
-	// config for what kind of geo to draw (tris/lines/points)
-	pipelineBuilder._inputAssembly = vkinit::input_assembly_create_info(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
-
-	// build viewport and scissor from swapchain dimensions
-	pipelineBuilder._viewport.x = 0.0f;
-	pipelineBuilder._viewport.y = 0.0f;
-	pipelineBuilder._viewport.width = (float)_windowExtent.width;
-	pipelineBuilder._viewport.height = (float)_windowExtent.height;
-	pipelineBuilder._viewport.minDepth = 0.0f;
-	pipelineBuilder._viewport.maxDepth = 1.0f;
-
-	pipelineBuilder._scissor.offset = { 0, 0 };
-	pipelineBuilder._scissor.extent = _windowExtent; //note: scissor might want to be larger?
-
-	// draw filled triangles
-	pipelineBuilder._rasterizer = vkinit::rasterization_state_create_info(VK_POLYGON_MODE_FILL);
-
-	// don't use MSAA, just use default
-	pipelineBuilder._multisampling = vkinit::multisampling_state_create_info();
-
-	// single blend attachment with no blending, write to RGBA
-	pipelineBuilder._colorBlendAttachment = vkinit::color_blend_attachment_state();
-
-	pipelineBuilder._pipelineLayout = _trianglePipelineLayout;
-
-	pipelineBuilder._depthStencil = vkinit::depth_stencil_create_info(true, true, VK_COMPARE_OP_LESS_OR_EQUAL);
-
-	// build pipeline
-	_trianglePipeline = pipelineBuilder.build_pipeline(_device, _renderPass);
-
-	// use same builder to build second pipeline, but for the other triangle shader
-	pipelineBuilder._shaderStages.clear();
-
-	pipelineBuilder._shaderStages.push_back(
-		vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, altHelloVertexShader)
-	);
-
-	pipelineBuilder._shaderStages.push_back(
-		vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, altHelloFragShader)
-	);
-
-	_altTrianglePipeline = pipelineBuilder.build_pipeline(_device, _renderPass);
-
-	// build the mesh pipeline
-	VertexInputDescription vertexDescription = Vertex::get_vertex_description();
-
-	// connect the pipeline builder vertex input info to the one we built from Vertex
-	pipelineBuilder._vertexInputInfo.pVertexAttributeDescriptions = vertexDescription.attributes.data();
-	pipelineBuilder._vertexInputInfo.vertexAttributeDescriptionCount = vertexDescription.attributes.size();
-	pipelineBuilder._vertexInputInfo.pVertexBindingDescriptions = vertexDescription.bindings.data();
-	pipelineBuilder._vertexInputInfo.vertexBindingDescriptionCount = vertexDescription.bindings.size();
-
-	pipelineBuilder._shaderStages.clear();
-
-	// compile mesh vertex shader
-	VkShaderModule meshVertexShader;
-	if (!load_shader_module("../../shaders/helloTriangleMesh.vert.spv", &meshVertexShader))
+bool VulkanEngine::wait_for_damage()
+{
+	if (!_renderOnDemand || _window == nullptr || _redrawFrames > 0 || _resizeRequested || streaming_busy() || animating())
 	{
-		std::cout << "Error building triangle mesh vert shader." << std::endl;
+		return false;
 	}
-	else
+	const auto next = _lastDrawn + std::chrono::milliseconds(_onDemandPollMs);
+	const auto now = std::chrono::steady_clock::now();
+	if (next > now)
 	{
-		std::cout << "Triangle mesh vertex shader successfully loaded." << std::endl;
+		// a null event leaves whatever woke the wait in the queue for run()
+		const auto waitMs = std::chrono::duration_cast<std::chrono::milliseconds>(next - now).count() + 1;
+		SDL_WaitEventTimeout(nullptr, static_cast<int>(waitMs));
 	}
-
-	pipelineBuilder._shaderStages.push_back(
-		vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, meshVertexShader)
-	);
-
-	pipelineBuilder._shaderStages.push_back(
-		vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, altHelloFragShader)
-	);
-
-	// create mesh pipeline layout
-	VkPipelineLayoutCreateInfo mesh_pipeline_layout_info = vkinit::pipeline_layout_create_info();
-
-	// setup push constants for mesh layout
-	VkPushConstantRange push_constant;
-	push_constant.offset = 0;
-	push_constant.size = sizeof(MeshPushConstants);
-	// this push constant range is accessible only in the vertex shader
-	push_constant.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-
-	mesh_pipeline_layout_info.pPushConstantRanges = &push_constant;
-	mesh_pipeline_layout_info.pushConstantRangeCount = 1;
-
-	VK_CHECK(vkCreatePipelineLayout(_device, &mesh_pipeline_layout_info, nullptr, &_meshPipelineLayout));
-
-	pipelineBuilder._pipelineLayout = _meshPipelineLayout;
-	_meshPipeline = pipelineBuilder.build_pipeline(_device, _renderPass);
-
-	// we can destroy shader modules after creating a pipeline with them
-	vkDestroyShaderModule(_device, helloTriangleVertexShader, nullptr);
-	vkDestroyShaderModule(_device, helloTriangleFragShader, nullptr);
-	vkDestroyShaderModule(_device, altHelloVertexShader, nullptr);
-	vkDestroyShaderModule(_device, altHelloFragShader, nullptr);
-	vkDestroyShaderModule(_device, meshVertexShader, nullptr);
-
-	_mainDeletionQueue.push_function([=]() {
-		vkDestroyPipeline(_device, _altTrianglePipeline, nullptr);
-		vkDestroyPipeline(_device, _trianglePipeline, nullptr);
-		vkDestroyPipeline(_device, _meshPipeline, nullptr);
-
-		vkDestroyPipelineLayout(_device, _trianglePipelineLayout, nullptr);
-		vkDestroyPipelineLayout(_device, _meshPipelineLayout, nullptr);
-	});
+	_frameIdled = true;
+	return true;
 }
 
-void VulkanEngine::load_meshes()
+void VulkanEngine::request_redraw()
 {
-	// triangle mesh
-	_triangleMesh._vertices.resize(3);
-
-	_triangleMesh._vertices[0].position = { 1.0f, 1.0f, 0.0f };
-	_triangleMesh._vertices[1].position = {-1.0f, 1.0f, 0.0f };
-	_triangleMesh._vertices[2].position = { 0.0f,-1.0f, 0.0f };
-
-	_triangleMesh._vertices[0].color = { 1.0f, 0.0f, 0.0f };
-	_triangleMesh._vertices[1].color = { 0.0f, 1.0f, 0.0f };
-	_triangleMesh._vertices[2].color = { 0.0f, 0.0f, 1.0f };
-
-	// monkey mesh
-	_monkeyMesh.load_from_obj("../../assets/monkey_smooth.obj");
-
-	upload_mesh(_triangleMesh);
-	upload_mesh(_monkeyMesh);
+	// the one-frame-old depth pyramid and readbacks catch up after a frame per slot; the upscaler's history after
+	// a whole jitter sequence
+	const uint32_t settle = _useTemporalUpscale ? TemporalUpscaler::JITTER_PHASES : _frameOverlap + 1;
+	_redrawFrames = std::max(_redrawFrames, settle);
 }
 
-void VulkanEngine::upload_mesh(Mesh& mesh)
+bool VulkanEngine::animating() const
 {
-	VkBufferCreateInfo bufferInfo = {};
-	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	// total size, in bytes, of buffer we're allocating
-	bufferInfo.size = mesh._vertices.size() * sizeof(Vertex);
-	// specify this buffer is a Vertex buffer
-	bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-
-	// needs to be writable by CPU, readable by GPU
-	VmaAllocationCreateInfo vmaAllocInfo = {};
-	vmaAllocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
-
-	// actually allocate buffer
-	VK_CHECK(vmaCreateBuffer(
-		_allocator, &bufferInfo, &vmaAllocInfo,
-		&mesh._vertexBuffer._buffer,
-		&mesh._vertexBuffer._allocation,
-		nullptr
-	));
-
-	// add triangle mesh buffer to the deletion queue
-	_mainDeletionQueue.push_function([=]() {
-		vmaDestroyBuffer(_allocator, mesh._vertexBuffer._buffer, mesh._vertexBuffer._allocation);
-	});
-
-	// copy vertex data in to GPU-readable data
-	void* data;
-	// map memory, which gives us a pointer which we can use to write to
-	vmaMapMemory(_allocator, mesh._vertexBuffer._allocation, &data);
-	memcpy(data, mesh._vertices.data(), mesh._vertices.size() * sizeof(Vertex)); // dest, src, size
-	// unmap to let the driver know the write is finished
-	vmaUnmapMemory(_allocator, mesh._vertexBuffer._allocation);
+	return !_characters.empty() || _useParticles || (_useClusteredLights && !_lights.empty()) || _instanceCount > 1
+		|| _benchmark.cameraPath == CameraPath::Orbit;
 }
 
-void VulkanEngine::cleanup()
-{	
-	if (_isInitialized)
+void VulkanEngine::pace_frame()
+{
+	if (!_lowLatency || _frameNumber == 0)
 	{
-		// make sure GPU is done
-		vkWaitForFences(_device, 1, &_renderFence, true, 1000000000);
-
-		// then destroy all the stuff we created
-		// MUST destroy these in the opposite order they're created
-		_mainDeletionQueue.flush();
+		return;
+	}
 
-		vmaDestroyAllocator(_allocator);
-		
-		// VkPhysicalDevice doesn't need to be destroyed- it's just a pointer to a driver
-		vkDestroySurfaceKHR(_instance, _surface, nullptr);
+	// the frame recorded last; everything before it has finished since
+	FrameData& previous = _frames[(_frameNumber + _frameOverlap - 1) % _frameOverlap];
+	bool presented = false;
+#ifdef VK_KHR_present_wait
+	if (_presentWaitSupported && previous._presentId != 0)
+	{
+		// a timeout or a swapchain gone out of date just ends the wait; the GPU wait below still holds
+		const VkResult result = reinterpret_cast<PFN_vkWaitForPresentKHR>(_vkWaitForPresent)(_device, _swapchain, previous._presentId, 1000000000);
+		presented = result == VK_SUCCESS;
+	}
+#endif
+	if (_graphicsTimeline != VK_NULL_HANDLE)
+	{
+		wait_graphics(previous._timelineValue, 1000000000);
+	}
+	else
+	{
+		check_device_result(vkWaitForFences(_device, 1, &previous._renderFence, true, 1000000000), "vkWaitForFences");
+	}
 
-		vkDestroyDevice(_device, nullptr);
-		vkb::destroy_debug_utils_messenger(_instance, _debug_messenger);
-		vkDestroyInstance(_instance, nullptr);
+	const auto now = std::chrono::steady_clock::now();
+	_latencyTotalMs += std::chrono::duration<double, std::milli>(now - previous._inputTime).count();
+	_latencySamples++;
+	if (now - _latencyReportStart >= std::chrono::seconds(1))
+	{
+		std::ostringstream display;
+		if (_displayTiming.enabled())
+		{
+			const DisplayTiming::Totals totals = _displayTiming.take_totals();
+			display << "; " << totals.presents << " presents every " << _displayTiming.cadence() << " refresh cycles, "
+				<< totals.missedVblanks << " missed vblanks, " << (totals.jitterSamples > 0 ? totals.jitterMs / totals.jitterSamples : 0.0)
+				<< " ms jitter, frames started " << std::chrono::duration<double, std::milli>(_displayTiming.frame_start_delay()).count() << " ms late";
+		}
+		LOG_INFO("Latency: " << _latencyTotalMs / _latencySamples << " ms from input to "
+			<< (presented ? "present" : "GPU done") << ", " << _latencySamples << " frames" << display.str());
+		_latencyTotalMs = 0.0;
+		_latencySamples = 0;
+		_latencyReportStart = now;
+	}
 
-		SDL_DestroyWindow(_window);
+	// the presents are scheduled on the display's cadence, so a frame that starts later still makes its vblank,
+	// with fresher input
+	if (_displayTiming.enabled() && _displayTiming.frame_start_delay().count() > 0)
+	{
+		CPU_PROFILE_SCOPE("frame_start_delay");
+		std::this_thread::sleep_for(_displayTiming.frame_start_delay());
 	}
 }
 
-void VulkanEngine::draw()
+void VulkanEngine::deliver_pending_readbacks(const FrameReadback::Callback& callback)
 {
-	// don't draw when window minimized
-	if (SDL_GetWindowFlags(_window) & SDL_WINDOW_MINIMIZED) {
+	if (!_useReadback)
+	{
 		return;
 	}
+	// the slot the next frame would take holds the oldest
+	for (uint32_t i = 0; i < _frameOverlap; i++)
+	{
+		_readback.deliver((_frameNumber + i) % _frameOverlap, callback);
+	}
+}
 
-	// wait until GPU has finished rendering last frame 
-	VK_CHECK(vkWaitForFences(_device, 1, &_renderFence, true, 1000000000));
-	VK_CHECK(vkResetFences(_device, 1, &_renderFence)); // reset fence after waiting- must be reset between uses
-
-	// acquire image index from swapchain
-	// wait for up to [timeout] amt of time for an image- this is FPS lock
-	uint32_t swapchainImageIndex;
-	VK_CHECK(vkAcquireNextImageKHR(_device, _swapchain, 1000000000, _presentSemaphore, nullptr, &swapchainImageIndex));
-
-	// now that we're confident the previous cmds finished executing, reset cmd buff to start recording again
-	VK_CHECK(vkResetCommandBuffer(_mainCommandBuffer, 0));
-
-	// begin command buffer recording 
-	VkCommandBuffer cmd = _mainCommandBuffer;
-	VkCommandBufferBeginInfo cmdBeginInfo = {};
-	cmdBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	cmdBeginInfo.pNext = nullptr;
-	cmdBeginInfo.pInheritanceInfo = nullptr;
-	// we're using this cmd buff exactly once, so let Vulkan know- helps with optimization, esp since we're using every frame
-	cmdBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-	VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
-
-	// make a frame clear color from frame #, to animate it 
-	VkClearValue clearValue;
-	float flash = abs(sin(_frameNumber / 120.0f));
-	clearValue.color = { {0.0f, 0.0f, flash, 1.0f} };
-
-	// clear depth at 1
-	VkClearValue depthClear;
-	depthClear.depthStencil.depth = 1.0f;
-
-	// start main renderpass
-	VkRenderPassBeginInfo rpInfo = vkinit::renderpass_begin_info(_renderPass, _windowExtent, _framebuffers[swapchainImageIndex]);
-
-	rpInfo.clearValueCount = 2;
-	VkClearValue clearValues[] = { clearValue, depthClear };
-	rpInfo.pClearValues = &clearValues[0];
-
-	vkCmdBeginRenderPass(cmd, &rpInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-	// RENDER COMMANDS ------------------------------------- v
-
-	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _meshPipeline);
-
-	// bind mesh vertex buffer with offset 0
-	VkDeviceSize offset = 0;
-	vkCmdBindVertexBuffers(cmd, 0, 1, &_monkeyMesh._vertexBuffer._buffer, &offset);
-	
-	// create MV matrix for rendering object
-	glm::vec3 camPos = { 0.f,0.f,-2.f };
-	glm::mat4 view = glm::translate(glm::mat4(1.f), camPos);
-	//camera projection
-	glm::mat4 projection = glm::perspective(glm::radians(70.f), 1700.f / 900.f, 0.1f, 200.0f);
-	projection[1][1] *= -1;
-	//model rotation
-	glm::mat4 model = glm::rotate(glm::mat4{ 1.0f }, glm::radians(_frameNumber * 0.4f), glm::vec3(0, 1, 0));
-	model = glm::scale(model, glm::vec3(0.4, 0.4, 0.4));
-	glm::mat4 mesh_matrix = projection * view * model;
-
-	// use push constants to pass matrix to shader 
-	MeshPushConstants constants;
-	constants.render_matrix = mesh_matrix;
-	vkCmdPushConstants(cmd, _meshPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(MeshPushConstants), &constants);
-
-	vkCmdDraw(cmd, _monkeyMesh._vertices.size(), 1, 0, 0);
-
-	// RENDER COMMANDS ------------------------------------- ^
-
-	// finalize renderpass
-	vkCmdEndRenderPass(cmd);
-	VK_CHECK(vkEndCommandBuffer(cmd));
-
-	// prepare submission to the queue
-	// wait on the _presentSemaphore, which is signaled when the swapchain is ready
-	// then signal _renderSemaphore, which indicates that rendering has finished
-
-	VkSubmitInfo submit = {};
-	submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submit.pNext = nullptr;
-
-	VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	submit.pWaitDstStageMask = &waitStage;
-
-	submit.waitSemaphoreCount = 1;
-	submit.pWaitSemaphores = &_presentSemaphore;
-
-	submit.signalSemaphoreCount = 1;
-	submit.pSignalSemaphores = &_renderSemaphore;
-
-	submit.commandBufferCount = 1;
-	submit.pCommandBuffers = &cmd;
-
-	// submit command buffer to queue and execute it 
-	// _renderFence will now block until the graphic commands finish execution (see beginning of frame)
-	VK_CHECK(vkQueueSubmit(_graphicsQueue, 1, &submit, _renderFence));
-
-	// display image we just rendered in the visible window!!
-	// wait for _renderSemaphore, ensuring that drawing commands finish before displaying image
-	VkPresentInfoKHR presentInfo = {};
-	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-	presentInfo.pNext = nullptr;
-	
-	presentInfo.pSwapchains = &_swapchain;
-	presentInfo.swapchainCount = 1;
-
-	presentInfo.pWaitSemaphores = &_renderSemaphore;
-	presentInfo.waitSemaphoreCount = 1;
-
-	presentInfo.pImageIndices = &swapchainImageIndex;
-
-	VK_CHECK(vkQueuePresentKHR(_graphicsQueue, &presentInfo));
-	
-	// for our clear color animation
-	_frameNumber++;
+void VulkanEngine::deliver_pending_encodes()
+{
+	if (!_useVideoEncode)
+	{
+		return;
+	}
+	for (uint32_t i = 0; i < _frameOverlap; i++)
+	{
+		_videoEncoder.deliver((_frameNumber + i) % _frameOverlap, [this](const VideoEncoder::Packet& packet) {
+			output_encoded_frame(packet);
+		});
+	}
 }
 
-void VulkanEngine::run()
+void VulkanEngine::run_benchmark()
 {
+	_benchmarkResult = {};
+	if (_benchmark.scene == "crowd")
+	{
+		// one instanced draw of MAX_INSTANCES monkeys
+		_instanceCount = MAX_INSTANCES;
+	}
+	else if (_benchmark.scene == "draw_data")
+	{
+		// the scene's objects drawn one by one, so each draw gets the per-draw data through the chosen path
+		_useIndirectDraws = false;
+		_cacheStaticDraws = false;
+	}
+	else if (_benchmark.scene != "monkey")
+	{
+		LOG_WARN("Unknown benchmark scene '" << _benchmark.scene << "', rendering monkey.");
+		_benchmark.scene = "monkey";
+	}
+
+	// a replay's frames take the place of the camera path's: every one drawn, the first warmupFrames unmeasured
+	InputRecording replay;
+	const bool replaying = !_benchmark.replayPath.empty();
+	if (replaying)
+	{
+		if (!replay.load(_benchmark.replayPath.c_str()) || replay.frame_count() == 0)
+		{
+			LOG_ERROR("Could not read an input recording from " << _benchmark.replayPath << ", benchmark aborted");
+			return;
+		}
+		if (replay.frame_count() <= _benchmark.warmupFrames)
+		{
+			LOG_WARN(_benchmark.replayPath << " has only " << replay.frame_count() << " frames, measuring all of them");
+			_benchmark.warmupFrames = 0;
+		}
+		_benchmark.frameCount = static_cast<uint32_t>(replay.frame_count()) - _benchmark.warmupFrames;
+		LOG_INFO("Replaying " << replay.frame_count() << " frames and " << replay.event_count() << " events of " << _benchmark.replayPath);
+	}
+
+	// measure the finished scene: keep presenting until every streamed mesh is resident. A replay's simulation
+	// stands still meanwhile, so it starts from where the recorded session did
 	SDL_Event e;
 	bool bQuit = false;
+	std::vector<double> streamingFrameMs;
+	const auto streamingStart = std::chrono::high_resolution_clock::now();
+	while (!bQuit && !_deviceLost && streaming_busy())
+	{
+		while (_window != nullptr && SDL_PollEvent(&e) != 0)
+		{
+			bQuit = bQuit || e.type == SDL_QUIT;
+		}
+		begin_update(replaying ? 0.0 : _simulation.step_seconds());
+		auto start = std::chrono::high_resolution_clock::now();
+		draw();
+		streamingFrameMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+	}
+	_benchmarkResult.streaming = BenchmarkReport::summarize(std::move(streamingFrameMs));
+	_benchmarkResult.streamingMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - streamingStart).count();
+
+	BenchmarkReport report;
+	report.reserve(_benchmark.frameCount);
 
-	// main loop
-	while (!bQuit)
+	const int firstMeasuredFrame = _frameNumber + static_cast<int>(_benchmark.warmupFrames);
+	int lastGpuFrame = -1;
+	uint64_t measuredHeapAllocations = 0;
+	size_t replayFrame = 0;
+
+	while (!bQuit && !_deviceLost && (replaying ? replayFrame < replay.frame_count() : _frameNumber < firstMeasuredFrame + static_cast<int>(_benchmark.frameCount)))
 	{
-		// Handle events on queue
-		while (SDL_PollEvent(&e) != 0)
+		// keep the window responsive, but ignore input so runs stay reproducible
+		while (_window != nullptr && SDL_PollEvent(&e) != 0)
 		{
-			// close the window when user alt-f4s or clicks the X button			
 			if (e.type == SDL_QUIT)
 			{
 				bQuit = true;
 			}
-			else if (e.type == SDL_KEYDOWN)
+			else if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
 			{
-				switch (e.key.keysym.sym)
-				{
-				case SDLK_SPACE:
-					_selectedShader += 1;
-					if (_selectedShader > 1) _selectedShader = 0;
-				}
+				// the swapchain is rebuilt at the start of the next draw
+				_resizeRequested = true;
+			}
+		}
+
+		// the recorded input and update, whatever this build's frame times are; the frame's update is used up even
+		// when draw() skips it, so the simulation stays on the recording
+		double elapsed = _simulation.step_seconds();
+		if (replaying)
+		{
+			const InputRecording::Frame& recorded = replay.frame(replayFrame++);
+			for (uint32_t i = 0; i < recorded.eventCount; i++)
+			{
+				handle_event(replay.event(recorded.firstEvent + i).event, bQuit);
 			}
+			elapsed = recorded.elapsedSeconds;
 		}
 
+		const int frameNumber = _frameNumber;
+		begin_update(elapsed);
+		auto start = std::chrono::high_resolution_clock::now();
 		draw();
+		auto end = std::chrono::high_resolution_clock::now();
+		end_cpu_frame();
+
+		// draw() skips minimized frames without advancing _frameNumber
+		if (_frameNumber == frameNumber)
+		{
+			continue;
+		}
+
+		if (frameNumber >= firstMeasuredFrame)
+		{
+			report.add_frame(frameNumber, std::chrono::duration<double, std::milli>(end - start).count(), _lastPresentMs, _lastFrameStats);
+			measuredHeapAllocations += _lastFrameHeapAllocations;
+		}
+
+		// GPU results for older frames arrive as their frame slots get reused
+		const GpuProfiler::FrameTimings& gpu = _gpuProfiler.latest();
+		if (gpu.frameNumber != lastGpuFrame && gpu.frameNumber >= firstMeasuredFrame && !gpu.scopes.empty())
+		{
+			report.add_gpu_time(gpu.frameNumber, gpu.scopes[0].milliseconds,
+				gpu.hasStatistics ? static_cast<int64_t>(gpu.statistics.inputAssemblyPrimitives) : -1);
+			lastGpuFrame = gpu.frameNumber;
+		}
+		// and the display's, later still; ids are frame numbers plus one
+		for (const DisplayTiming::Present& present : _displayTiming.presents())
+		{
+			const int presentFrame = static_cast<int>(present.id) - 1;
+			if (presentFrame >= firstMeasuredFrame)
+			{
+				report.add_display_timing(presentFrame, present.intervalMs, present.missedVblanks, present.jitterMs);
+			}
+		}
+	}
+
+	wait_device_idle();
+	// frames around the loss measured a dying device; no report beats a misleading one
+	if (_deviceLost)
+	{
+		LOG_ERROR("Device lost after " << report.cpu_summary().count << " measured frames, benchmark aborted");
+		return;
+	}
+
+	report.print_summary();
+	_benchmarkResult.completed = !bQuit;
+	_benchmarkResult.cpu = report.cpu_summary();
+	_benchmarkResult.gpu = report.gpu_summary();
+#ifndef NDEBUG
+	const std::string heapAllocationsPerFrame = std::to_string(static_cast<double>(measuredHeapAllocations) / _benchmark.frameCount);
+	LOG_INFO("heap allocations per frame: " << heapAllocationsPerFrame);
+#else
+	// operator new is only counted in debug builds
+	const std::string heapAllocationsPerFrame = "n/a";
+#endif
+	if (!_benchmark.outputPath.empty())
+	{
+		report.write(_benchmark.outputPath, {
+			{ "device", _gpuProperties.deviceName },
+			{ "present_mode", present_mode_name(_presentMode) },
+			{ "display_refresh_ms", _displayTiming.enabled() ? std::to_string(_displayTiming.refresh_ns() / 1e6) : "unknown" },
+			{ "scene", _benchmark.scene },
+			{ "replay", _benchmark.replayPath.empty() ? "none" : _benchmark.replayPath },
+			{ "frames", std::to_string(_benchmark.frameCount) },
+			{ "warmup_frames", std::to_string(_benchmark.warmupFrames) },
+			{ "frames_in_flight", std::to_string(_frameOverlap) },
+			{ "heap_allocations_per_frame", heapAllocationsPerFrame },
+			{ "vendor", std::to_string(_gpuProperties.vendorID) },
+			{ "object_data", object_data_path_name(_objectDataPath) },
+		});
 	}
-}
 
+	// for choose_object_data_path on the next start
+	if (_benchmark.scene == "draw_data")
+	{
+		record_object_data_result(report.cpu_summary().mean, report.gpu_summary().mean);
+	}
+}
@@ -5,95 +5,1463 @@
 
 #include <vk_types.h>
 #include <Mesh.h>
+#include <MeshletPool.h>
+#include <Texture.h>
+#include <GpuProfiler.h>
+#include <GpuBreadcrumbs.h>
+#include <DebugUtils.h>
+#include <Benchmark.h>
+#include <AutoTune.h>
+#include <CpuProfiler.h>
+#include <FrameStats.h>
+#include <UploadManager.h>
+#include <AssetStreamer.h>
+#include <AssetWatcher.h>
+#include <AssetArchive.h>
+#include <AssetCache.h>
+#include <GltfLoader.h>
+#include <DescriptorAllocator.h>
+#include <DescriptorSetCache.h>
+#include <DeletionQueue.h>
+#include <CommandAllocator.h>
+#include <FrameArena.h>
+#include <HeapStats.h>
+#include <GpuLinearAllocator.h>
+#include <GpuMemory.h>
+#include <JobSystem.h>
+#include <Simulation.h>
+#include <TransformStore.h>
+#include <Bvh.h>
+#include <SphereCuller.h>
+#include <SoftwareOcclusion.h>
+#include <PotentiallyVisibleSet.h>
+#include <OcclusionPredicates.h>
+#include <Impostors.h>
+#include <Terrain.h>
+#include <Foliage.h>
+#include <SceneViews.h>
+#include <DepthPyramid.h>
+#include <BlockUnpacker.h>
+#include <VirtualTexture.h>
+#include <SceneSnapshot.h>
+#include <ShadowCascades.h>
+#include <Camera.h>
+#include <ParticleSystem.h>
+#include <Transparency.h>
+#include <ClusteredLights.h>
+#include <PostProcess.h>
+#include <ShadingRateImage.h>
+#include <TemporalUpscaler.h>
+#include <AccelerationStructures.h>
+#include <RayShadows.h>
+#include <Animation.h>
+#include <Skinning.h>
+#include <StaticBatcher.h>
+#include <VoxelWorld.h>
+#include <DebugDraw.h>
+#include <TextRenderer.h>
+#include <GpuScene.h>
+#include <EntityStore.h>
+#include <RenderGraph.h>
+#include <ShaderHotReload.h>
+#include <ShaderReflection.h>
+#include <LayoutCache.h>
+#include <MaterialStore.h>
+#include <PipelineRegistry.h>
+#include <PipelineManifest.h>
+#include <ShaderStatistics.h>
+#include <OverdrawView.h>
+#include <PerformanceHud.h>
+#include <Metrics.h>
+#include <HitchRecorder.h>
+#include <InputRecording.h>
+#include <PresentThread.h>
+#include <DisplayOutput.h>
+#include <DisplayTiming.h>
+#include <OffscreenTargets.h>
+#include <FrameReadback.h>
+#include <TiledRender.h>
+#include <ObjectPicker.h>
+#include <VideoEncoder.h>
+#include <DeviceCapabilities.h>
+#include <DeviceContext.h>
 #include <glm/glm.hpp>
 
-// allows us to delete Vulkan objects in the order we created them
-struct DeletionQueue
-{
-	std::deque<std::function<void()>> deletors;
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+// upper bound on frames the CPU may record ahead of the GPU
+// the number actually used is VulkanEngine::_frameOverlap (2 or 3)
+constexpr uint32_t MAX_FRAME_OVERLAP = 3;
+
+// semaphores a graphics submit waits on: the swapchain image and the uploads' timeline, with room to spare
+constexpr uint32_t MAX_GRAPHICS_WAITS = 4;
+
+// capacity of each frame's instance buffer
+constexpr uint32_t MAX_INSTANCES = 100000;
+
+// render list recording across threads: at most this many secondary command buffers per frame,
+// and at least this many objects per buffer, below which one thread records faster
+constexpr uint32_t MAX_RECORD_THREADS = 8;
+constexpr uint32_t MIN_OBJECTS_PER_RECORD_THREAD = 2048;
+// the thread index of draw()'s own command buffers in VulkanEngine::_frameCommands; recording thread t is 1 + t
+constexpr uint32_t MAIN_COMMAND_THREAD = 0;
+
+// initial size of each frame's FrameArena; it grows if a frame ever overflows it
+constexpr size_t FRAME_ARENA_SIZE = 256 * 1024;
+
+// per-frame region of the GPU linear allocator streaming uniforms and other transient GPU data
+constexpr VkDeviceSize FRAME_GPU_DATA_SIZE = 1024 * 1024;
+
+// bindless set capacities; textures and materials index into these arrays
+constexpr uint32_t MAX_BINDLESS_TEXTURES = 1024;
+constexpr uint32_t MAX_MATERIALS = 256;
+constexpr uint32_t INVALID_BINDLESS_INDEX = UINT32_MAX;
+
+// shared mesh geometry capacity, in elements
+constexpr uint32_t MESH_POOL_VERTICES = 1 << 20;
+constexpr uint32_t MESH_POOL_INDICES_16 = 1 << 21;
+constexpr uint32_t MESH_POOL_INDICES_32 = 1 << 22;
+// MeshPool::fragmentation() above which meshes get compacted toward the front of the pool
+constexpr float MESH_POOL_DEFRAG_THRESHOLD = 0.2f;
+
+// meshlet pool capacity for the mesh shader path: descriptors, and uints of vertex and triangle tables
+constexpr uint32_t MESHLET_POOL_MESHLETS = 1 << 17;
+constexpr uint32_t MESHLET_POOL_DATA = 1 << 22;
+// meshlets culled per task shader workgroup; local_size_x of meshlet.task
+constexpr uint32_t MESHLET_TASK_GROUP_SIZE = 32;
+
+// fixed simulation rate; rendering runs at whatever rate it can and interpolates between steps
+constexpr double SIMULATION_STEP_SECONDS = 1.0 / 60.0;
 
-	void push_function(std::function<void()>&& fn)
+class PipelineBuilder;
+struct PipelineDescription;
+
+// everything one in-flight frame needs, so frame N+1 can be recorded while the GPU runs frame N
+// what a cached static draw buffer baked in; the buffer is re-recorded when any of it changes
+struct StaticDrawKey {
+	uint64_t generation{ 0 }; // VulkanEngine::_staticDrawGeneration, 0 before the first recording
+	uint64_t lodHash{ 0 }; // levels the static objects draw at
+	uint32_t cameraOffset{ 0 };
+	VkExtent2D extent{ 0, 0 };
+	VkQueryPipelineStatisticFlags statistics{ 0 };
+	bool depthPrepass{ false };
+	bool reverseZ{ false };
+
+	bool operator==(const StaticDrawKey& other) const
 	{
-		deletors.push_back(fn);
+		return generation == other.generation && lodHash == other.lodHash && cameraOffset == other.cameraOffset
+			&& extent.width == other.extent.width && extent.height == other.extent.height && statistics == other.statistics
+			&& depthPrepass == other.depthPrepass && reverseZ == other.reverseZ;
 	}
+};
+
+struct FrameData {
+	VkSemaphore _presentSemaphore, _renderSemaphore;
+	// without timeline semaphores; otherwise the slot waits for _timelineValue on the graphics timeline
+	VkFence _renderFence{ VK_NULL_HANDLE };
+	uint64_t _timelineValue{ 0 }; // of the slot's last submit, 0 before the first one
+	// of the slot's last present, 0 if it wasn't given one or the swapchain has been rebuilt since
+	uint64_t _presentId{ 0 };
+	// with _usePresentThread, the semaphore the slot's last submit waited on, released at its next fence wait
+	VkSemaphore _acquireSemaphore{ VK_NULL_HANDLE };
+	// when run() sampled the input the slot's last frame was recorded from
+	std::chrono::steady_clock::time_point _inputTime{};
+
+	// the slot's buffers of the frame being recorded, from VulkanEngine::_frameCommands and _computeCommands
+	VkCommandBuffer _mainCommandBuffer{ VK_NULL_HANDLE };
+	// with _useAsyncCompute: the slot's culling, submitted to the compute queue ahead of the main buffer
+	VkCommandBuffer _computeCommandBuffer{ VK_NULL_HANDLE };
+	// the last parallel recording's, one per recording thread
+	VkCommandBuffer _secondaryBuffers[MAX_RECORD_THREADS];
+	// with _cacheStaticDraws: the static objects' main pass draws, recorded once and replayed for as long
+	// as _staticDrawKey still describes what they were recorded against
+	VkCommandPool _staticDrawPool{ VK_NULL_HANDLE };
+	VkCommandBuffer _staticDrawBuffer{ VK_NULL_HANDLE };
+	StaticDrawKey _staticDrawKey{};
+
+	// host-visible InstanceData array for instanced draws, rewritten each time this slot is recorded
+	AllocatedBuffer _instanceBuffer;
+	// the GPU scene slot of every instance the cull pass writes, at the same index; read by the pick pass only
+	AllocatedBuffer _instanceObjectBuffer;
+	// GPUIndirectCommand records for indirect draws, one per IndirectBatch and cull phase
+	AllocatedBuffer _indirectBuffer;
+
+	// GPU culling inputs and outputs
+	AllocatedBuffer _objectBuffer; // GPUObjectSlot per instance slot, written by the CPU
+	AllocatedBuffer _compactIndirectBuffer; // non-empty draws packed to the front of each run
+	AllocatedBuffer _drawCountBuffer; // surviving draws per run and phase, for vkCmdDrawIndexedIndirectCount
+	VkDescriptorSet _cullDescriptor;
+
+	// the uniform and storage object data paths: GPUDrawData slots every CPU-recorded draw writes its own of,
+	// kept mapped; set 2 of the mesh pipelines
+	AllocatedBuffer _drawDataBuffer{};
+	uint8_t* _drawData{ nullptr };
+	VkDescriptorSet _drawDataDescriptor{ VK_NULL_HANDLE };
+
+	// objects retired while recording this frame; flushed once its fence has signaled
+	DeletionQueue _deletionQueue;
+	// scratch for the draw path, reset at the same point
+	FrameArena _arena;
+};
+
+// resources for one-off transfer submissions, kept apart from the per-frame render sync
+struct UploadContext {
+	VkFence _uploadFence{ VK_NULL_HANDLE }; // without timeline semaphores
+	VkCommandPool _commandPool;
+	VkCommandBuffer _commandBuffer;
+};
+
+// one shading model's pipelines for every VertexFormat, built from one PipelineBuilder setup; the materials
+// made from it share them and differ only in their parameters, so they sort and batch next to each other
+struct MaterialTemplate {
+	VkPipelineLayout pipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline pipeline[VERTEX_FORMAT_COUNT]{};
+	VkPipeline instancedPipeline[VERTEX_FORMAT_COUNT]{};
+	VkPipeline depthPipeline[VERTEX_FORMAT_COUNT]{};
+	VkPipeline depthInstancedPipeline[VERTEX_FORMAT_COUNT]{};
+};
 
-	void flush()
+// pipeline state and parameters shared by every object drawn with it
+struct Material {
+	VkPipeline pipeline;
+	VkPipelineLayout pipelineLayout;
+	// same shading with the model matrix read from the instance binding; needed for indirect draws
+	VkPipeline instancedPipeline{ VK_NULL_HANDLE };
+	// depth-only versions of both, drawn before any color; a material that has them must shade with
+	// an EQUAL depth test and no depth writes. Left null, the material draws in the color pass only
+	VkPipeline depthPipeline{ VK_NULL_HANDLE };
+	VkPipeline depthInstancedPipeline{ VK_NULL_HANDLE };
+	// slot in the bindless material buffer, pushed with every draw
+	uint32_t materialIndex{ 0 };
+	// sampled through the material's textureIndex; the screen size of the objects drawing with the material
+	// decides which of a streamed texture's levels are resident. Only OBJ materials with a diffuse map have
+	// one so far, and no vertex format carries the UVs to sample it with yet
+	Texture* texture{ nullptr };
+	// the parameter block, kept in the material's slot of _materialStore
+	glm::vec4 baseColor{ 1.f };
+	// shaded at 2x2 pixels per invocation with variable rate shading, for surfaces whose detail nobody
+	// looks for; full rate without it
+	bool lowDetail{ false };
+	// for a material made from a template: the same material for each VertexFormat, itself included, which
+	// objects move between as their mesh's format changes (see material_for); null otherwise
+	Material* variants[VERTEX_FORMAT_COUNT]{};
+	// the MaterialTemplate it was made from, empty for none; scene snapshots make it again from this
+	std::string templateName;
+};
+
+// one entry of the flat scene list, and the component every drawn entity of VulkanEngine::_entities has;
+// mesh and material are owned by the engine's maps
+// streamingMesh is what the object actually wants to draw while mesh is a placeholder;
+// the engine swaps it in once it's resident
+struct RenderObject {
+	Mesh* mesh;
+	Material* material;
+	uint32_t transformIndex; // scene graph node in VulkanEngine::_transforms
+	Entity entity; // the entity the list entry was copied from
+	Mesh* streamingMesh{ nullptr };
+	int32_t bvhProxy{ Bvh::NULL_NODE }; // world bounds in VulkanEngine::_renderBvh
+	uint32_t sceneIndex{ UINT32_MAX }; // slot in VulkanEngine::_gpuScene, kept however the list is sorted
+	// never moves; its shadow is cached with the other static casters instead of drawn every frame
+	bool isStatic{ false };
+	// which part of the level it is in VulkanEngine::_pvs; objects that aren't one are never dropped by it
+	uint32_t pvsObject{ UINT32_MAX };
+};
+
+// one animated instance: its own Mesh, whose vertices the skinning pass writes, posed by a clip of a
+// skeleton the engine owns. output holds a range of vertices per frame slot, the mesh's _poolAllocation
+// one of them at a time
+struct SkinnedCharacter {
+	Mesh* mesh;
+	MeshAllocation output;
+	uint32_t sourceOffset; // its bind-pose vertices in Skinning's source buffer
+	uint32_t firstJoint; // its matrices in every frame slot's joint buffer
+	const Skeleton* skeleton;
+	const AnimationClip* clip;
+	double timeOffset; // seconds into the clip at simulated time 0, so the characters don't move in lockstep
+};
+
+// component next to RenderObject: the mesh's box under the world transform, as of the last refit
+struct WorldBounds {
+	Aabb box;
+};
+
+// the order sort_renderables keeps: pipeline changes are the most expensive bind, and grouping by material
+// and then mesh keeps indirect batches large
+inline bool draws_before(const RenderObject& a, const RenderObject& b)
+{
+	if (a.material->pipeline != b.material->pipeline)
+	{
+		return a.material->pipeline < b.material->pipeline;
+	}
+	if (a.material != b.material)
+	{
+		return a.material < b.material;
+	}
+	if (a.mesh->_indexType != b.mesh->_indexType)
 	{
-		for (auto it = deletors.rbegin(); it != deletors.rend(); it++)
-		{
-			(*it)();
-		}
-		deletors.clear();
+		return a.mesh->_indexType < b.mesh->_indexType;
 	}
+	return a.mesh < b.mesh;
+}
+
+// which GPU init() picks among the ones that can run the engine. A UUID wins over an index, and either
+// over the type preference; one that matches nothing falls back to vk-bootstrap's own pick
+enum class GpuPreference { Default, Discrete, Integrated };
+struct GpuSelection {
+	GpuPreference preference{ GpuPreference::Default };
+	int index{ -1 }; // in the loader's enumeration order, as vulkaninfo lists them
+	std::string uuid; // VkPhysicalDeviceIDProperties::deviceUUID as 32 hex digits, dashes ignored
 };
 
-// for pushing constant data to shaders
+// what the frame graph's passes depend on; a change rebuilds the graph
+struct FrameGraphKey {
+	bool shadows;
+	bool indirect;
+	bool occlusion;
+	bool dynamicResolution;
+	bool asyncCulling; // the first cull phase runs on the compute queue, outside the graph
+	bool particles;
+	bool clusteredLights;
+	bool postProcess; // the scene goes through the HDR target and the post chain
+	bool debugDraw; // a pass draws the frame's debug lines over the meshes
+	bool shadingRate; // the raster passes read a shading rate image, rewritten from the scene after them
+	bool temporalUpscale; // the scene is accumulated at the window's resolution instead of blitted up
+	bool rayShadows; // a depth-only pass, then shadows and occlusion traced from its depth, in place of the cascades
+	bool transparent; // a pass blends the transparent objects over the opaque scene
+	bool weightedBlended; // ... into accumulation targets and a composite pass, instead of sorted over the scene
+	bool occlusionQueries; // a pass queries the heavy objects' boxes for the next frame's predicates
+	bool overdraw; // the opaque meshes are counted into the overdraw view's target, whose heat map is presented
+	bool picking; // a pass draws the opaque meshes' scene slots for ObjectPicker, in frames with a request
+	bool text; // a pass draws the frame's text over the finished swapchain image
+	bool hud; // a pass draws the performance HUD over that, while it's shown
+	bool foliage; // a compute pass scatters the grass over the terrain before it's drawn
+	VkExtent2D extent;
+
+	bool operator!=(const FrameGraphKey& other) const
+	{
+		return shadows != other.shadows || indirect != other.indirect || occlusion != other.occlusion
+			|| dynamicResolution != other.dynamicResolution || asyncCulling != other.asyncCulling || particles != other.particles
+			|| clusteredLights != other.clusteredLights || postProcess != other.postProcess || debugDraw != other.debugDraw
+			|| shadingRate != other.shadingRate || temporalUpscale != other.temporalUpscale || rayShadows != other.rayShadows
+			|| transparent != other.transparent || weightedBlended != other.weightedBlended || occlusionQueries != other.occlusionQueries
+			|| overdraw != other.overdraw || picking != other.picking || text != other.text || hud != other.hud || foliage != other.foliage
+			|| extent.width != other.extent.width || extent.height != other.extent.height;
+	}
+};
+
+// per-frame values the frame graph's passes read while it executes; refreshed by draw() every frame
+struct FrameGraphInputs {
+	FrameData* frame;
+	uint32_t cameraOffset;
+	// CPU path: the objects that passed frustum culling
+	RenderObject* visible;
+	uint32_t visibleCount;
+	bool parallelRecording;
+	// CPU path: the static objects replay from the frame's cached buffer, and visible holds just the others
+	bool cacheStaticDraws;
+	uint32_t instanceCount;
+	float modelAngle;
+	float particleDeltaTime; // simulated seconds since the particles last moved
+	float cameraMotion; // pixels the view direction moved since the last frame, for the shading rates
+	glm::vec2 jitter; // render pixels the projection is offset by this frame
+	glm::mat4 reprojection; // this frame's unjittered clip space to the last frame's, for the upscaler
+	// GPU path: the GpuCullViews the cull dispatch reads, and each extra view's camera block
+	uint32_t cullViewsOffset;
+	uint32_t viewCameraOffsets[MAX_SCENE_VIEWS];
+};
+
+// streamed mesh waiting for its transfer batch to be acquired by a frame
+// a shader read, created and reflected by preload_shaders, for load_shader_module to pick up
+struct PreloadedShader {
+	VkShaderModule module{ VK_NULL_HANDLE };
+	bool reflected{ false };
+	ShaderReflection reflection;
+};
+
+struct StreamingUpload {
+	Mesh* mesh;
+	uint64_t uploadValue;
+	// indices uploaded block-packed, which the acquiring frame expands into the pool; empty otherwise
+	AllocatedBuffer packedIndices{};
+	uint32_t packedBlocks{ 0 };
+};
+
+// a streamed mesh or texture loaded again after its source changed: replacement uploads alongside the one
+// in use and takes its place, in the same map entry, once the frame being recorded has acquired it
+struct MeshReload {
+	Mesh* target;
+	std::string name; // what the file was requested as, which its imported materials are named after
+	std::unique_ptr<Mesh> replacement;
+	StreamingUpload upload; // of replacement
+};
+
+struct TextureReload {
+	Texture* target;
+	std::unique_ptr<Texture> replacement;
+	uint64_t uploadValue;
+};
+
+// streamed texture whose upload is on its way; the acquiring frame generates any levels it didn't bring
+struct StreamingTexture {
+	Texture* texture;
+	uint64_t uploadValue;
+};
+
+// streamed texture moving its first resident level: image holds the levels from firstLevel on and replaces
+// the texture's image once the frame being recorded has acquired it
+struct TextureLevelChange {
+	Texture* texture;
+	AllocatedImage image;
+	VkImageView imageView;
+	uint32_t firstLevel;
+	uint64_t uploadValue;
+};
+
+// streamed textures always keep the levels from the first one this small (on its larger side) down to 1x1
+constexpr uint32_t MIP_STREAMING_TAIL_SIZE = 256;
+
+// run of consecutive render objects with the same mesh and material, drawn as one indirect command
+// first is both the index into the render list and the firstInstance of the command
+// prepare_indirect_draws splits these further by LOD; first then indexes VulkanEngine::_indirectOrder
+struct IndirectBatch {
+	Mesh* mesh;
+	Material* material;
+	uint32_t first;
+	uint32_t count;
+	uint32_t lod;
+};
+
+// consecutive batches that share pipeline and buffers, drawn by one indirect call
+struct IndirectRun {
+	Material* material;
+	Mesh* mesh;
+	uint32_t first; // first batch, also the run's first slot in the compacted command buffer
+	uint32_t count;
+};
+
+// one instance slot of an indirect batch as the cull shader sees it: which object may fill it, whose
+// transform and bounds it reads from the GPU scene; matches ObjectSlot in cull.comp
+struct GPUObjectSlot {
+	uint32_t sceneIndex;
+	uint32_t batchIndex;
+	uint32_t renderIndex; // index in the render list, which keys the occlusion visibility buffer
+	uint32_t pad;
+};
+
+// indirect command plus the run bookkeeping compact.comp needs; matches DrawCommand in the shaders
+// the draw calls use sizeof(GPUIndirectCommand) as stride, so the driver only reads the first 20 bytes
+struct GPUIndirectCommand {
+	VkDrawIndexedIndirectCommand command;
+	uint32_t runIndex;
+	uint32_t runFirst;
+	uint32_t pad;
+};
+
+// CullPushConstants::cullFlags
+constexpr uint32_t CULL_FRUSTUM = 1;
+constexpr uint32_t CULL_OCCLUSION = 2; // two phases against the depth pyramid, see cull.comp
+constexpr uint32_t CULL_REVERSE_Z = 4; // the camera's depth runs from 1 at the near plane to 0
+
+// shared by cull.comp and compact.comp
+struct CullPushConstants {
+	glm::vec4 frustumPlanes[6];
+	uint32_t objectCount;
+	uint32_t batchCount;
+	uint32_t cullFlags;
+	uint32_t phase; // 1 reads and writes the second half of the draw and count buffers
+	uint32_t runCount;
+	uint32_t depthWidth; // depth buffer size the pyramid was built from
+	uint32_t depthHeight;
+	float znear; // the camera's near plane distance, for the sphere projection
+};
+static_assert(sizeof(CullPushConstants) <= 128, "CullPushConstants must fit the guaranteed push constant size");
+
+// per-draw data; camera matrices come from GPUCameraData
+// the instanced and indirect paths only push materialIndex, at MESH_MATERIAL_INDEX_OFFSET
 struct MeshPushConstants {
-	glm::vec4 data;
-	glm::mat4 render_matrix;
+	glm::mat4 model; // includes the mesh's dequantize transform
+	uint32_t materialIndex;
+};
+constexpr uint32_t MESH_MATERIAL_INDEX_OFFSET = offsetof(MeshPushConstants, materialIndex);
+// the pulled mesh pipelines take the VertexFormat of the pool stream they read right after the constants
+constexpr uint32_t MESH_VERTEX_FORMAT_OFFSET = MESH_MATERIAL_INDEX_OFFSET + sizeof(uint32_t);
+
+// how draw_objects hands each draw's MeshPushConstants to the mesh vertex shaders, which are specialized
+// for one of them; see OBJECT_DATA_PATH in helloTriangleMesh.vert
+enum class ObjectDataPath : uint32_t {
+	PushConstants, // vkCmdPushConstants per draw
+	DynamicUniform, // a slot of the frame's draw data buffer per draw, bound as a uniform buffer at its offset
+	StorageBuffer, // the same slots bound once as a storage buffer, indexed by gl_InstanceIndex via firstInstance
+};
+constexpr uint32_t OBJECT_DATA_PATH_COUNT = 3;
+const char* object_data_path_name(ObjectDataPath path);
+
+// what the frame shows in place of the lit scene, cycled with F2
+enum class DebugView : uint32_t {
+	Lit, // the scene itself
+	Overdraw, // how many fragments each pixel rasterized, as a heat map (see OverdrawView.h)
+};
+constexpr uint32_t DEBUG_VIEW_COUNT = 2;
+const char* debug_view_name(DebugView view);
+
+// one slot of FrameData::_drawDataBuffer; matches DrawData in helloTriangleMesh.vert under std140 and std430
+struct GPUDrawData {
+	glm::mat4 model;
+	uint32_t materialIndex;
+	uint32_t pad[3];
+};
+// draws a frame the uniform and storage paths have slots for; the ones beyond are skipped
+constexpr uint32_t MAX_DRAW_DATA = 32768;
+
+// set 0, binding 0 of the mesh pipelines; written once per frame into that frame's slot of the
+// camera ring buffer and bound with a dynamic offset
+struct GPUCameraData {
+	glm::mat4 view;
+	glm::mat4 proj;
+	glm::mat4 viewproj;
+	// read by the meshlet task shader; shaders that don't cull declare only the matrices
+	glm::vec4 frustumPlanes[6];
+	glm::vec4 position;
+	// the rest is for the fragment shaders, see shaders/shadow.glsl
+	glm::mat4 shadowViewProj[ShadowCascades::CASCADE_COUNT];
+	glm::vec4 shadowSplits; // view-space depth where each cascade ends
+	glm::vec4 lightDirection; // xyz the direction the light travels, w 1 while the shadow map is rendered, 2 with the ray shadow mask
+	// where shaders/lights.glsl finds the fragment's cluster: x, y slice from log view depth, zw the render extent
+	glm::vec4 clusterDepth;
+	glm::uvec4 clusterGrid; // xyz clusters along each axis
+	// what the vertex shaders of the main pass draw with, picked by gl_ViewIndex: the eyes of a stereo camera,
+	// viewproj twice otherwise. Declared at its offset, past the part they leave out
+	glm::mat4 eyeViewProj[2];
+};
+static_assert(offsetof(GPUCameraData, eyeViewProj) == 624, "the vertex shaders declare eyeViewProj at offset 624");
+
+// per-object data of the mesh shader path; matches the push constants of meshlet.task/meshlet.mesh
+struct MeshletPushConstants {
+	glm::mat4 world; // without the dequantize transform, which the cluster bounds don't include
+	glm::vec4 dequantize; // xyz offset, w uniform scale from uploaded positions to mesh space
+	glm::vec4 viewPoint; // camera in mesh space, for the normal cones
+	uint32_t materialIndex;
+	uint32_t firstMeshlet;
+	uint32_t meshletCount;
+	uint32_t vertexOffset;
+	uint32_t vertexFormat;
 };
 
 class VulkanEngine {
 public:
 	// Vulkan environment
+	// set before init() to another engine's device_context() to render on its device, as one more session;
+	// otherwise init() creates the instance and device and a context for them
+	std::shared_ptr<DeviceContext> _deviceContext;
 	VkInstance _instance; // vulkan library
-	VkDebugUtilsMessengerEXT _debug_messenger; // Vulkan debug output handle
+	VkDebugUtilsMessengerEXT _debug_messenger{ VK_NULL_HANDLE }; // Vulkan debug output handle, null without validation
+	// the Khronos validation layer costs whole seconds of startup and much of every frame, so only debug
+	// builds, or builds with ENABLE_VALIDATION_LAYERS, ask for it unless --validation says otherwise
+#if defined(ENABLE_VALIDATION_LAYERS) || !defined(NDEBUG)
+	bool _useValidationLayers{ true };
+#else
+	bool _useValidationLayers{ false };
+#endif
 	VkPhysicalDevice _chosenGPU; // GPU chosen as default device
+	GpuSelection _gpuSelection; // set before init()
+	VkPhysicalDeviceProperties _gpuProperties; // limits, vendor/device IDs and pipeline cache UUID of _chosenGPU
+	VkPhysicalDeviceFeatures _enabledFeatures; // core features actually enabled on _device
 	VkDevice _device; // handle to drivers for commands
-	VkSurfaceKHR _surface; // Vulkan window surface
+	VkSurfaceKHR _surface{ VK_NULL_HANDLE }; // Vulkan window surface, null when headless
 
 	// swapchain
-	VkSwapchainKHR _swapchain; // Vulkan swapchain - images able to display to screen
+	VkSwapchainKHR _swapchain{ VK_NULL_HANDLE }; // Vulkan swapchain - images able to display to screen
 	VkFormat _swapchainImageFormat; // img format expected by window system
+	// what the main pass renders color into: the swapchain's, or the HDR target's with post-processing
+	VkFormat _sceneColorFormat;
+	VkPresentModeKHR _presentMode{ VK_PRESENT_MODE_FIFO_KHR }; // requested before init, actual mode after
+	// samples of the main pass's color and depth, resolved into the swapchain image inside the pass; requested
+	// before init, lowered to what the device supports for both. Every main pass pipeline is built for it
+	VkSampleCountFlagBits _msaaSamples{ VK_SAMPLE_COUNT_1_BIT };
+
+	// dynamic resolution, toggled with R: the main pass renders into the top-left _renderExtent of a
+	// window-sized target that is blitted up to the swapchain, and _renderScale follows the GPU frame time
+	// towards _gpuFrameBudgetMs. The targets keep their size, so a new scale costs no reallocation
+	bool _dynamicResolution{ false };
+	bool _dynamicResolutionSupported{ false }; // the swapchain can be a linear blit's destination
+	float _renderScale{ 1.0f }; // of each side
+	float _minRenderScale{ 0.5f };
+	float _gpuFrameBudgetMs{ 14.0f };
+	int _lastScaledGpuFrame{ -1 };
+	VkExtent2D _renderExtent{ 0, 0 }; // what the meshes render at this frame; _windowExtent without dynamic resolution
+	// single-pass stereo, asked for with --stereo: the raster passes over the scene are multiview passes that
+	// draw both eyes of the camera at once, each into its layer of a two-layer target half the window wide, from
+	// one cull against the union of their frusta and one recording. Without a headset the eyes are shown side by
+	// side. Decided at init, since the main pass pipelines are built for the view mask; needs the multiview feature
+	// and a swapchain that can be blitted to. What can't render into layers is left out (see init_vulkan)
+	bool _useStereo{ false };
+	bool _multiviewSupported{ false };
+	float _eyeSeparation{ 0.064f };
+	static constexpr uint32_t STEREO_VIEW_MASK = 0x3;
+	// what the graph's raster passes over the scene draw; the view mask their pipelines are built for
+	uint32_t main_view_mask() const { return _useStereo ? STEREO_VIEW_MASK : 0; }
+	// temporal upscaling in place of dynamic resolution's blit, asked for with --taa: the projection jitters
+	// and a compute pass accumulates the frames at the window's resolution (see TemporalUpscaler.h). Needs a
+	// depth buffer that can be sampled, and no MSAA, whose job it takes over
+	bool _useTemporalUpscale{ false };
+	TemporalUpscaler _temporalUpscaler;
+	glm::mat4 _upscalePreviousViewProjection{ 1.f }; // unjittered, of the last frame the upscaler ran in
+	RenderGraphResource _graphSceneColor{ INVALID_GRAPH_RESOURCE };
+	int _presentModeCycleIndex{ 0 }; // position in the P-key cycle
+	bool _resizeRequested{ false }; // set on window resize or OUT_OF_DATE/SUBOPTIMAL; draw() rebuilds the swapchain
 	std::vector<VkImage> _swapchainImages; // images in swapchain
 	std::vector<VkImageView> _swapchainImageViews; // image-views from swapchain
 
 	// command buffers
 	VkQueue _graphicsQueue; // queue we will submit commands to
 	uint32_t _graphicsQueueFamily; // queue family type
-	VkCommandPool _commandPool;
-	VkCommandBuffer _mainCommandBuffer;
+	uint32_t _graphicsQueueTimestampBits; // 0 if the graphics queue can't write timestamps
 
-	// render pass and frame buffers
-	VkRenderPass _renderPass;
-	std::vector<VkFramebuffer> _framebuffers;
+	// uploads; the graphics queue itself when the GPU has no separate transfer-capable family
+	VkQueue _transferQueue;
+	uint32_t _transferQueueFamily;
 
-	// synchronization
-	VkSemaphore _presentSemaphore, _renderSemaphore;
-	VkFence _renderFence;
+	// async compute: a family with compute and without graphics, the transfer one if the GPU has no other
+	VkQueue _computeQueue{ VK_NULL_HANDLE };
+	uint32_t _computeQueueFamily{ VK_QUEUE_FAMILY_IGNORED };
+	bool _asyncComputeSupported{ false };
+	// culling runs on it, overlapping the graphics work of the frames still in flight, and hands its output
+	// to the draws through _computeTimeline. Decided at init, since the buffers it shares with the graphics
+	// queue are created for both families; frames with occlusion culling cull on the graphics queue, since
+	// their first phase reads what the previous frame's second phase wrote there
+	bool _useAsyncCompute{ false };
+	VkSemaphore _computeTimeline{ VK_NULL_HANDLE };
+	uint64_t _computeTimelineValue{ 0 }; // last value submitted
+	// where the last frame culled; writes to the GPU scene on the compute queue wait for graphics
+	// submits that may still read it
+	bool _lastCullOnCompute{ false };
+	bool _timelineSemaphoresSupported{ false }; // VK_KHR_timeline_semaphore, lets uploads run without blocking
+	bool _memoryBudgetSupported{ false }; // VK_EXT_memory_budget, real heap budgets instead of VMA's estimates
+	// VK_EXT_memory_priority and VK_EXT_pageable_device_local_memory: residency priorities the driver pages by
+	bool _pageableMemorySupported{ false };
+	bool _meshShadingSupported{ false }; // VK_EXT_mesh_shader with task shaders, plus bindless for the materials
+	bool _occlusionCullingSupported{ false }; // the depth format can be sampled, which the depth pyramid needs
+	bool _dynamicRenderingSupported{ false }; // VK_KHR_dynamic_rendering and the extensions it needs on 1.1
+	bool _synchronization2Supported{ false }; // VK_KHR_synchronization2: per-barrier stage masks and vkQueueSubmit2
+	bool _presentWaitSupported{ false }; // VK_KHR_present_id and VK_KHR_present_wait
+	bool _displayTimingSupported{ false }; // VK_GOOGLE_display_timing: when presents reached the screen
+	bool _bufferMarkerSupported{ false }; // VK_AMD_buffer_marker: breadcrumbs written at the top and bottom of the pipe
+	bool _debugUtilsSupported{ false }; // VK_EXT_debug_utils on the instance: object names and pass labels in captures
+	bool _extendedDynamicStateSupported{ false }; // VK_EXT_extended_dynamic_state: cull, depth and topology set per command buffer
+	bool _pipelineLibrariesSupported{ false }; // VK_EXT_graphics_pipeline_library with fast linking
+	bool _videoEncodeSupported{ false }; // VK_KHR_video_queue, VK_KHR_video_encode_queue and VK_KHR_video_encode_h264
+	bool _shadingRateSupported{ false }; // VK_KHR_fragment_shading_rate with per-draw rates
+	bool _shadingRateAttachmentSupported{ false }; // and with shading rate attachments
+	bool _rayQuerySupported{ false }; // VK_KHR_acceleration_structure, VK_KHR_ray_query and buffer device addresses
+	bool _conditionalRenderingSupported{ false }; // VK_EXT_conditional_rendering: draws skipped on a value in a buffer
+	bool _executablePropertiesSupported{ false }; // VK_KHR_pipeline_executable_properties: the driver's shader statistics
+	bool _halfPrecisionSupported{ false }; // VK_KHR_shader_float16_int8 with shaderFloat16, enabled for _useHalfPrecision
 
-	// pipelines
-	VkPipelineLayout _trianglePipelineLayout;
-	VkPipeline _trianglePipeline;
-	
-	VkPipeline _altTrianglePipeline;
-	int _selectedShader{ 0 };
+	// per-frame command pools, command buffers and sync objects, indexed by _frameNumber % _frameOverlap
+	FrameData _frames[MAX_FRAME_OVERLAP];
+	uint32_t _frameOverlap{ 2 };
+
+	// with timeline semaphores, every graphics submit signals the next value of this one, and frame slots
+	// and immediate_submit wait for their value instead of a fence; uploads have their own on the transfer queue
+	VkSemaphore _graphicsTimeline{ VK_NULL_HANDLE };
+	uint64_t _graphicsTimelineValue{ 0 }; // last value submitted
+	uint64_t _graphicsCompletedValue{ 0 }; // last value seen signaled
+	PFN_vkGetSemaphoreCounterValueKHR _vkGetSemaphoreCounterValue{ nullptr };
+	PFN_vkWaitSemaphoresKHR _vkWaitSemaphores{ nullptr };
+	PFN_vkVoidFunction _vkQueueSubmit2{ nullptr };
+	PFN_vkVoidFunction _vkCmdPipelineBarrier2{ nullptr };
+	PFN_vkVoidFunction _vkWaitForPresent{ nullptr };
+	PFN_vkVoidFunction _vkCmdWriteBufferMarker{ nullptr };
+	uint64_t _presentId{ 0 }; // last id handed to vkQueuePresentKHR
+
+	// latency-optimized pacing, toggled with J: run() waits for the previous frame right before sampling
+	// input, until it is on screen with present wait and until the GPU is done with it otherwise, so
+	// there is never more than one frame queued behind the one being recorded
+	bool _lowLatency{ false };
+	// input-to-present (or input-to-GPU-done) latency of the paced frames, printed about once a second
+	double _latencyTotalMs{ 0.0 };
+	uint32_t _latencySamples{ 0 };
+	std::chrono::steady_clock::time_point _latencyReportStart{};
+	// with VK_GOOGLE_display_timing, and without the present thread: every present's actual time, polled after
+	// each present for the latency report and benchmarks. Low-latency pacing also schedules the presents on a
+	// steady cadence of refresh cycles and starts frames as late as the reported margins allow
+	DisplayTiming _displayTiming;
+
+	// power saving: while the window is minimized or hidden run() sleeps in SDL_WaitEventTimeout instead of
+	// spinning through frames draw() skips, and while it hasn't the input focus frames are held to
+	// _backgroundFps (0, the default, leaves them alone)
+	uint32_t _backgroundFps{ 0 };
+
+	// acquire and present on a thread of their own, so draw() returns right after its submit; windowed only
+	bool _usePresentThread{ false };
+	PresentThread _presentThread;
+	std::chrono::steady_clock::time_point _backgroundFrameDeadline{};
+	bool _frameIdled{ false }; // run() slept before this frame, so its time isn't the frame's own
+
+	// render on demand, for mostly static screens: run() draws while something changes (input, the camera, a
+	// streamed or reloaded asset, a replaced pipeline, anything animating by itself) and a few frames after, for
+	// the temporal passes and the one-frame-old occlusion depth to settle. Otherwise the last image stays on
+	// screen and run() waits for input, drawing one frame every _onDemandPollMs so the reload pollers in draw()
+	// still see files change; the simulation clock holds meanwhile
+	bool _renderOnDemand{ false };
+	uint32_t _onDemandPollMs{ 500 };
+	uint32_t _redrawFrames{ 0 }; // still to draw before run() waits again
+	std::chrono::steady_clock::time_point _lastDrawn{};
+	glm::mat4 _drawnViewProjection{ 0.f }; // the camera of the last frame drawn, to see it move
+
+	// raster passes begin with vkCmdBeginRenderingKHR, without render pass or framebuffer objects;
+	// ignored unless _dynamicRenderingSupported. Decided at init, since every pipeline depends on it
+	bool _useDynamicRendering{ true };
+	PFN_vkVoidFunction _vkCmdBeginRendering{ nullptr };
+	PFN_vkVoidFunction _vkCmdEndRendering{ nullptr };
+
+	// variable rate shading, asked for with --vrs: lowDetail materials shade once per 2x2 pixels, and with
+	// dynamic rendering the raster passes also take a rate image that coarsens the flat parts of the last
+	// frame (see ShadingRateImage.h). Ignored unless _shadingRateSupported. Decided at init, since the
+	// main pass pipelines depend on it
+	bool _useShadingRate{ false };
+	// the image can be used: the device takes the attachment with dynamic rendering, in a format the rate
+	// shader can write. It only runs in frames whose scene renders into a target it can sample
+	bool _useShadingRateImage{ false };
+	// fragmentShadingRateNonTrivialCombinerOps: the coarser of a draw's and the image's rates wins; without
+	// it the image's replaces the draw's
+	bool _shadingRateMaxCombiner{ false };
+	VkExtent2D _shadingRateTexelSize{ 16, 16 };
+	PFN_vkVoidFunction _vkCmdSetFragmentShadingRate{ nullptr };
+	ShadingRateImage _shadingRateImage;
+	// where the camera looked when the rates were last written, for how far it turned since
+	glm::vec3 _shadingRateForward{ 0.f };
+
+	// ray-traced sun shadows and ambient occlusion, asked for with --rt-shadows: every mesh gets a bottom-level
+	// acceleration structure as it lands in the pool, the GPU scene a top-level one over them, and a compute
+	// pass traces both from a depth-only pass's depth into a mask the fragment shaders read (see RayShadows.h).
+	// Ignored unless _rayQuerySupported. Decided at init, since the mesh pool's buffers depend on it. Frames
+	// that draw without GPU culling or a depth pre-pass keep the shadow cascades, and MSAA turns it off
+	bool _useRayShadows{ false };
+	AccelerationStructures _accelerationStructures;
+	RayShadows _rayShadows;
+
+	// --characters adds that many animated characters next to the monkey: a clip is sampled into joint
+	// matrices on the job system every frame, and a compute pass poses the vertices from them before
+	// anything draws (see Animation.h and Skinning.h). None without the skinning shader
+	uint32_t _characterCount{ 0 };
+	Skinning _skinning;
+	Skeleton _characterSkeleton;
+	AnimationClip _characterClip;
+	std::vector<SkinnedCharacter> _characters;
+	// rebuilt every frame; kept so steady state doesn't allocate
+	std::vector<PoseRequest> _poseRequests;
+	std::vector<Skinning::Dispatch> _skinDispatches;
+
+	// mesh pipelines leave cull mode, front face, topology and depth test state to set_draw_state, so the
+	// pre-pass, the shading after it and the shadow casters differ only in shaders and targets;
+	// ignored unless _extendedDynamicStateSupported. Decided at init, since every pipeline depends on it
+	bool _useExtendedDynamicState{ true };
+	PFN_vkVoidFunction _vkCmdSetCullMode{ nullptr };
+	PFN_vkVoidFunction _vkCmdSetFrontFace{ nullptr };
+	PFN_vkVoidFunction _vkCmdSetPrimitiveTopology{ nullptr };
+	PFN_vkVoidFunction _vkCmdSetDepthTestEnable{ nullptr };
+	PFN_vkVoidFunction _vkCmdSetDepthWriteEnable{ nullptr };
+	PFN_vkVoidFunction _vkCmdSetDepthCompareOp{ nullptr };
+
+	// every pipeline is built against this pass; the frame graph's render passes are compatible with it.
+	// Null with dynamic rendering, where pipelines take the attachment formats instead
+	VkRenderPass _renderPass{ VK_NULL_HANDLE };
+
+	// the frame's passes, from the cull dispatches to the late meshes; rebuilt when _frameGraphKey changes
+	RenderGraph _frameGraph;
+	FrameGraphKey _frameGraphKey{};
+	FrameGraphInputs _graphInputs{};
+	RenderGraphResource _graphSwapchain{ INVALID_GRAPH_RESOURCE };
+	RenderGraphResource _graphDepth{ INVALID_GRAPH_RESOURCE };
+	RenderGraphResource _graphShadingRate{ INVALID_GRAPH_RESOURCE }; // only with _frameGraphKey.shadingRate
+	// only with _frameGraphKey.temporalUpscale; the upscaler's two images, bound the other way round every frame
+	RenderGraphResource _graphUpscaleHistory{ INVALID_GRAPH_RESOURCE };
+	RenderGraphResource _graphUpscaleOutput{ INVALID_GRAPH_RESOURCE };
+	uint32_t _graphMainPass{ 0 };
+	uint32_t _graphDebugPass{ 0 }; // only with _frameGraphKey.debugDraw
+	uint32_t _graphTextPass{ 0 }; // only with _frameGraphKey.text
+	uint32_t _graphOcclusionQueryPass{ 0 }; // only with _frameGraphKey.occlusionQueries
+	uint32_t _graphTransparentPass{ 0 }; // only with _frameGraphKey.transparent
+	uint32_t _graphOitCompositePass{ 0 }; // only with _frameGraphKey.weightedBlended
+	// only with _frameGraphKey.weightedBlended: what the transparent pass accumulates into
+	RenderGraphResource _graphOitAccumulation{ INVALID_GRAPH_RESOURCE };
+	RenderGraphResource _graphOitRevealage{ INVALID_GRAPH_RESOURCE };
+	// only with _frameGraphKey.rayShadows: the mask, and the depth-only pass it is traced from, which clears color
+	RenderGraphResource _graphRayShadows{ INVALID_GRAPH_RESOURCE };
+	uint32_t _graphDepthPrepass{ 0 };
+	// only with _frameGraphKey.overdraw: the counts and the pass drawing them, and the heat map made of them
+	RenderGraphResource _graphOverdrawCounts{ INVALID_GRAPH_RESOURCE };
+	RenderGraphResource _graphOverdrawHeat{ INVALID_GRAPH_RESOURCE };
+	uint32_t _graphOverdrawPass{ 0 };
+	// only with _frameGraphKey.picking: the scene slots ObjectPicker reads back, and the pass drawing them
+	RenderGraphResource _graphPickIds{ INVALID_GRAPH_RESOURCE };
+	uint32_t _graphPickPass{ 0 };
+
+	// which of the floor's two materials it draws with, toggled with SPACE
+	bool _altFloorMaterial{ false };
+
+	// shared by every pipeline build, seeded from and written back to _pipelineCachePath
+	VkPipelineCache _pipelineCache{ VK_NULL_HANDLE };
+	std::string _pipelineCachePath{ "pipeline_cache.bin" };
+	// rebuilds the graphics pipelines when their GLSL is edited while running
+	ShaderHotReload _shaderReload;
+	// owns every shader module and graphics pipeline, one per distinct SPIR-V and description
+	PipelineRegistry _pipelineRegistry;
+	// new pipelines are linked from shared libraries and replaced by their optimized compile once it's
+	// done; ignored unless _pipelineLibrariesSupported
+	bool _usePipelineLibraries{ true };
+	// every variable init_pipelines filled from the registry, for replace_pipeline
+	std::vector<VkPipeline*> _pipelineSlots;
+	std::vector<const char*> _pipelineSlotNames; // for the debug names, by slot
+	// compiles init_pipelines started, and where each goes; finish_pipelines joins them once the asset
+	// loads have been started, so the workers compile while the loader thread decodes
+	std::vector<std::shared_future<VkPipeline>> _pendingPipelines;
+	std::vector<VkPipeline*> _pendingPipelineTargets;
+	std::vector<uint64_t> _pendingPipelineHashes; // PipelineManifest::hash() of each
+	// the generic build of each that has one, invalid otherwise; finish_pipelines puts it in place of a
+	// specialized compile that isn't done, so the first frame doesn't wait for that
+	std::vector<std::shared_future<VkPipeline>> _pendingPipelineFallbacks;
+	// specialized compiles with their fallback standing in, swapped in between frames once they're done
+	struct SpecializingPipeline {
+		std::shared_future<VkPipeline> pipeline;
+		VkPipeline fallback;
+	};
+	std::vector<SpecializingPipeline> _specializingPipelines;
+	// the mesh materials draw with their unspecialized pipelines until the specialized ones have compiled;
+	// not with pipeline libraries, whose linked pipelines are quick to make anyway
+	bool _useFallbackPipelines{ true };
+	// the pipelines earlier sessions bound, whose optimized compiles start at init; this session's binds are
+	// added and it's written back to _pipelineManifestPath at shutdown
+	PipelineManifest _pipelineManifest;
+	std::string _pipelineManifestPath{ "pipeline_manifest.txt" };
+	// with --shader-stats, every graphics pipeline keeps its compile's statistics, logged once they're built and
+	// again for each hot reload, and shown on the HUD. Needs _executablePropertiesSupported; pipelines are
+	// compiled whole then, so the numbers are of what draws
+	bool _captureShaderStatistics{ false };
+	PFN_vkVoidFunction _vkGetPipelineExecutableProperties{ nullptr };
+	PFN_vkVoidFunction _vkGetPipelineExecutableStatistics{ nullptr };
+	ShaderStatistics _shaderStatistics;
+	// by path as load_shader_module is given it; only during init, while the pipelines are built
+	std::unordered_map<std::string, PreloadedShader> _preloadedShaders;
+	// owns every pipeline layout, and the set layouts derived from shaders
+	LayoutCache _layoutCache;
+	// what each loaded module declares
+	std::unordered_map<VkShaderModule, ShaderReflection> _shaderReflections;
 
 	VmaAllocator _allocator;
 	VkPipelineLayout _meshPipelineLayout;
+	// chosen before the pipelines are built, which are specialized for it. With _objectDataAuto, the path with
+	// the fastest draw_data benchmark recorded in _objectDataResultsPath for this device, push constants until
+	// there is one
+	ObjectDataPath _objectDataPath{ ObjectDataPath::PushConstants };
+	bool _objectDataAuto{ true };
+	std::string _objectDataResultsPath{ "object_data_paths.csv" };
+	// bytes between two draws' slots: the uniform path aligns them for the dynamic offsets
+	uint32_t _drawDataStride{ sizeof(GPUDrawData) };
+	VkDescriptorSetLayout _drawDataSetLayout{ VK_NULL_HANDLE };
 	VkPipeline _meshPipeline;
-	Mesh _triangleMesh;
+	// mesh pipeline plus a per-instance model matrix binding; shares _meshPipelineLayout
+	VkPipeline _instancedMeshPipeline;
+	// both mesh pipelines again, reading PackedVertex
+	VkPipeline _packedMeshPipeline;
+	VkPipeline _packedInstancedMeshPipeline;
+	// and once more over the two bindings of VertexFormat::Split
+	VkPipeline _splitMeshPipeline;
+	VkPipeline _splitInstancedMeshPipeline;
+	// VoxelVertex chunks through voxel.vert, which shades by the face instead of reading a normal
+	VkPipeline _voxelMeshPipeline{ VK_NULL_HANDLE };
+	VkPipeline _voxelInstancedMeshPipeline{ VK_NULL_HANDLE };
+	// with vertex pulling, one pipeline and its instanced twin draw every vertex format: the vertex shaders
+	// read the pool streams from set 3 by gl_VertexIndex (see vertexPull.glsl), and the format comes as a
+	// push constant at MESH_VERTEX_FORMAT_OFFSET. _meshPipelineLayout then covers that set and constant too
+	bool _useVertexPulling{ false };
+	VkPipeline _pulledMeshPipeline{ VK_NULL_HANDLE };
+	VkPipeline _pulledInstancedMeshPipeline{ VK_NULL_HANDLE };
+	VkDescriptorSetLayout _vertexPullSetLayout{ VK_NULL_HANDLE };
+	// written once, like _meshletDescriptor: the pool's buffers live as long as the engine
+	VkDescriptorSet _vertexPullDescriptor{ VK_NULL_HANDLE };
+	// lays down depth for the mesh materials before they shade, so each pixel runs the fragment
+	// shader about once; read when the pipelines are built
+	bool _depthPrepass{ true };
+	// position-only, fragment-less counterparts of the mesh pipelines; only the split ones read
+	// less than a whole vertex
+	VkPipeline _depthMeshPipeline{ VK_NULL_HANDLE };
+	VkPipeline _depthInstancedMeshPipeline{ VK_NULL_HANDLE };
+	VkPipeline _depthPackedMeshPipeline{ VK_NULL_HANDLE };
+	VkPipeline _depthPackedInstancedMeshPipeline{ VK_NULL_HANDLE };
+	VkPipeline _depthSplitMeshPipeline{ VK_NULL_HANDLE };
+	VkPipeline _depthSplitInstancedMeshPipeline{ VK_NULL_HANDLE };
+	VkPipeline _depthVoxelMeshPipeline{ VK_NULL_HANDLE };
+	VkPipeline _depthVoxelInstancedMeshPipeline{ VK_NULL_HANDLE };
+
+	// cascaded shadows of the directional light, sampled by the mesh fragment shaders through set 0,
+	// binding 1. The map is D32_SFLOAT where that can be sampled, D16_UNORM otherwise
+	bool _useShadows{ true };
+	ShadowCascades _shadows;
+	glm::vec3 _lightDirection{ -0.4f, -1.f, -0.3f }; // the direction the light travels; needn't be normalized
+	float _shadowDistance{ 40.f }; // view-space depth where the last cascade ends
+	uint32_t _shadowResolution{ 2048 };
+	// position-only caster pipelines, one per vertex format; they push just the light's model-view-projection
+	VkPipelineLayout _shadowPipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline _shadowMeshPipeline{ VK_NULL_HANDLE };
+	VkPipeline _shadowPackedMeshPipeline{ VK_NULL_HANDLE };
+	VkPipeline _shadowSplitMeshPipeline{ VK_NULL_HANDLE };
+	VkPipeline _shadowVoxelMeshPipeline{ VK_NULL_HANDLE };
+
+	// a fountain of GPU-simulated sparks (see ParticleSystem.h), drawn after the meshes with additive blending
+	// and a depth test but no depth writes. Capacity is fixed at init
+	bool _useParticles{ false };
+	uint32_t _particleCapacity{ 1u << 20 };
+	ParticleEmitter _particleEmitter;
+	ParticleSystem _particles;
+	VkPipelineLayout _particlePipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline _particlePipeline{ VK_NULL_HANDLE };
+	double _particleTime{ -1.0 }; // simulated time the particles were last advanced to; negative before the first frame
+
+	// monkeys of glass in a grid over the floor (see Transparency.h), blended after every opaque pass and
+	// before the debug lines, in _transparencyMode. Weighted blended OIT needs single-sampled targets, so
+	// with MSAA they sort instead. Both requested before init
+	uint32_t _transparentCount{ 0 };
+	TransparencyMode _transparencyMode{ TransparencyMode::Sorted };
+	std::vector<TransparentObject> _transparentObjects;
+	DepthSorter _transparentSorter;
+	std::vector<float> _transparentDepths; // the sort's input, kept between frames
+	VkPipelineLayout _transparentPipelineLayout{ VK_NULL_HANDLE };
+	// by vertex format, in _transparencyMode's variant; voxel chunks are never transparent, so their slot stays null
+	VkPipeline _transparentPipelines[VERTEX_FORMAT_COUNT]{};
+	// the weighted blended pass's: its targets are RGBA16F weighted color and R16F -log revealage, against
+	// _oitRenderPass without dynamic rendering, and the composite over the scene color after it
+	static constexpr VkFormat OIT_ACCUMULATION_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+	static constexpr VkFormat OIT_REVEALAGE_FORMAT = VK_FORMAT_R16_SFLOAT;
+	VkRenderPass _oitRenderPass{ VK_NULL_HANDLE };
+	VkDescriptorSetLayout _oitCompositeSetLayout{ VK_NULL_HANDLE };
+	VkPipelineLayout _oitCompositePipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline _oitCompositePipeline{ VK_NULL_HANDLE };
+
+	// point lights drifting over the floor, shaded through clustered light lists (see ClusteredLights.h); the
+	// mesh pipelines are built as their lit variant. The lists are rebuilt every frame for the moving camera
+	bool _useClusteredLights{ false };
+	uint32_t _lightCount{ 1024 };
+	ClusteredLights _clusteredLights;
+	std::vector<GpuLight> _lights;
+
+	// load the .half.spv build of the shaders that have one (see shaders/half.glsl) where the device does
+	// float16_t arithmetic: the post-processing blur and composite and the mesh lighting
+	bool _useHalfPrecision{ true };
+	// the .half.spv next to spvPath with _halfPrecisionSupported, spvPath otherwise
+	std::string half_precision_variant(const char* spvPath) const;
+
+	// the scene renders into an HDR target that bloom, tonemapping and FXAA compute passes (see PostProcess.h)
+	// turn into the swapchain image; requested before init, which fixes the steps
+	bool _usePostProcess{ false };
+	PostProcessSettings _postSettings;
+	PostProcess _postProcess;
+
+	// what collect_debug_draw() adds to _debugDraw each frame, any of these; 0 draws no debug lines at all
+	enum DebugDrawFlags : uint32_t {
+		DEBUG_DRAW_BOUNDS = 1, // the fattened box of every object in _renderBvh
+		DEBUG_DRAW_BVH = 2, // the BVH's internal nodes, colored by depth
+		DEBUG_DRAW_CASCADES = 4, // each shadow cascade's light frustum
+		DEBUG_DRAW_LIGHTS = 8, // the reach of every clustered point light
+	};
+	uint32_t _debugDrawFlags{ 0 };
+	// anything may add lines to it during the frame; they draw over the meshes without writing depth
+	DebugDraw _debugDraw;
+	VkPipelineLayout _debugLinePipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline _debugLinePipeline{ VK_NULL_HANDLE };
+
+	// what collect_text() writes each frame, any of these; 0 builds no text pipeline or pass at all
+	enum TextFlags : uint32_t {
+		TEXT_STATS = 1, // the last frame's command counts in the top left corner
+		TEXT_LABELS = 2, // every object in view within _textLabelDistance, labelled with its entity
+	};
+	uint32_t _textFlags{ 0 };
+	// a TTF baked next to itself, or empty for imgui's built-in font baked into the assets folder
+	std::string _textFont;
+	float _textLabelDistance{ 60.0f };
+	// anything may add text to it during the frame; it draws over the presented image in one instanced call
+	TextRenderer _text;
+	// the text and HUD pipelines', only for compatibility, without dynamic rendering
+	VkRenderPass _overlayRenderPass{ VK_NULL_HANDLE };
+	VkPipelineLayout _textPipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline _textPipeline{ VK_NULL_HANDLE };
+	// the HUD's imgui triangles, their vertices and indices copied into the frame ring by the hud pass
+	VkPipelineLayout _hudPipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline _hudPipeline{ VK_NULL_HANDLE };
+	// bounding boxes drawn into occlusion queries: depth tested, nothing written
+	VkPipelineLayout _occlusionBoxPipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline _occlusionBoxPipeline{ VK_NULL_HANDLE };
+
+	// the debug view, --debug-view or F2. Overdraw only shows in frames drawn through GPU culling, without
+	// stereo and where the swapchain takes blits; the others stay lit
+	DebugView _debugView{ DebugView::Lit };
+	OverdrawView _overdraw;
+	// OverdrawView::count_format, and whether overdrawQuad.frag runs instead of overdraw.frag
+	VkFormat _overdrawFormat{ VK_FORMAT_UNDEFINED };
+	bool _overdrawQuadCounts{ false };
+	// without dynamic rendering the counting pipelines are built against it, for compatibility only
+	VkRenderPass _overdrawRenderPass{ VK_NULL_HANDLE };
+	// by vertex format: the depth pre-pass's instanced vertex fetch and a constant added per fragment
+	VkPipeline _overdrawPipelines[VERTEX_FORMAT_COUNT]{};
+
+	// a left click picks through _objectPicker in frames drawn through GPU culling, and by ray casting the
+	// render list's bounds otherwise or with --cpu-picking
+	bool _useGpuPicking{ true };
+	ObjectPicker _objectPicker;
+	// as for the overdraw view, with the scene slot stored next to each instance fetched too
+	VkRenderPass _pickRenderPass{ VK_NULL_HANDLE };
+	VkPipeline _pickPipelines[VERTEX_FORMAT_COUNT]{};
+	// the entity of every GPU scene slot, which is what a pick comes back as
+	std::vector<Entity> _sceneEntities;
+
+	// scene
+	// every scene object, as RenderObject and WorldBounds components; what systems iterate and edit
+	EntityStore _entities;
+	// sorted copy of the entities' render objects, by pipeline, then mesh, so draw_objects only rebinds when
+	// the state actually changes; rebuilt by sort_renderables
+	std::vector<RenderObject> _renderables;
+	// node-based maps, so the Material* and Mesh* held by _renderables stay valid as more are added
+	std::unordered_map<std::string, Material> _materials;
+	// what materials are made from, by shading model; "mesh" is the only one so far
+	std::unordered_map<std::string, MaterialTemplate> _materialTemplates;
+	std::unordered_map<std::string, Mesh> _meshes;
+	std::unordered_map<std::string, Texture> _textures;
+	// a glTF scene to add next to the monkey, asked for with --gltf: its primitives become meshes of their
+	// own while loading, its materials and node hierarchy objects once the pipelines exist. The document
+	// stays mapped in between
+	std::string _gltfPath;
+	GltfDocument _gltfDocument;
+	// an OBJ scene streamed in like the monkey, asked for with --obj, drawn at the origin
+	std::string _objScenePath;
+	// --scene-snapshot: build_level's objects, nodes and materials are restored from this file when it's of
+	// the same --obj and --gltf files, and written to it after building them otherwise. A snapshot is of the
+	// sources, not of build_level, which a change to means deleting it
+	std::string _sceneSnapshotPath;
+	// streamed OBJs are a mesh per material (see Mesh::load_obj_parts): the material each part brought,
+	// and the parts after the first by the first, which the objects showing it draw alongside
+	std::unordered_map<const Mesh*, Material*> _importedMaterials;
+	// imported materials by their look (mesh, diffuse map, base color), so parts whose maps went into one
+	// atlas draw, batch and merge as one material
+	std::unordered_map<std::string, Material*> _importedLooks;
+	std::unordered_map<const Mesh*, std::vector<Mesh*>> _meshParts;
+
+	// trilinear, repeating; shared by every texture
+	VkSampler _linearSampler;
+
+	// descriptor sets
+	DescriptorAllocator _descriptorAllocator;
+	// the sets of the passes that take whatever views the frame graph hands them, per frame slot by contents
+	DescriptorSetCache _descriptorSetCache;
+	// set 0 of the mesh pipelines: per-frame camera data
+	VkDescriptorSetLayout _globalSetLayout;
+	VkDescriptorSet _globalDescriptor;
+	// transient GPU data for the frames in flight; set 0 points into its buffer and the camera is
+	// allocated from it each frame, bound with the allocation's offset as the dynamic offset
+	GpuLinearAllocator _frameGpuData;
+
+	// bindless: set 1 of the mesh pipelines holds every texture and the material buffer, so draws only
+	// push an index. Requested before init; after init, true only if descriptor indexing is available
+	bool _useBindless{ true };
+	VkDescriptorSetLayout _bindlessSetLayout{ VK_NULL_HANDLE };
+	// update-after-bind sets need a pool created for them, apart from _descriptorAllocator's
+	VkDescriptorPool _bindlessPool{ VK_NULL_HANDLE };
+	VkDescriptorSet _bindlessDescriptor{ VK_NULL_HANDLE };
+	// every material's parameters, device local; set 1, binding 1
+	MaterialStore _materialStore;
+	uint32_t _materialCount{ 0 };
+	uint32_t _bindlessTextureCount{ 0 };
+	// texture slots below _bindlessTextureCount whose images were retired, reused before new ones
+	std::vector<uint32_t> _freeBindlessSlots;
+
+	// copy mesh data through a staging buffer into DEVICE_LOCAL memory
+	// when false, meshes stay in host-visible memory (useful for comparing on integrated GPUs)
+	bool _uploadMeshesToDeviceLocal{ true };
+	// with a resizable BAR (see GpuMemory::resizable_bar), the frame data ring and the point lights live in
+	// host-visible device-local memory and are written there, the lights without a staging copy. Requested
+	// before init; after it, true only if the device has one
+	bool _useResizableBar{ true };
+
+	// mesh caches written from OBJ imports store their vertices and indices compressed (see MeshCodec.h):
+	// several times smaller on disk and in archives, decoded by the loader thread as they're read
+	bool _compressMeshCaches{ false };
+	// the loader thread reads the files of queued requests ahead of loading them (see AsyncFileReader)
+	bool _useReadAhead{ true };
+
+	// the CPU copies of a mesh's vertices and indices are freed once its upload is resident (see
+	// Mesh::release_cpu_geometry), for running many sessions on little RAM; only the pool holds them then
+	bool _releaseMeshCopies{ false };
+	// bytes freed that way so far, logged at cleanup
+	size_t _releasedMeshBytes{ 0 };
+	// glTF meshes whose copies static batching still reads in init_scene; released once it's done
+	std::vector<Mesh*> _deferredMeshReleases;
+
+	// static objects sharing a material are merged at load into world-space meshes per grid cell (see
+	// StaticBatcher.h), each drawn once with a cluster per object it replaced
+	bool _staticBatching{ true };
+	StaticBatchSettings _staticBatchSettings;
+
+	// an OBJ exported from a block world (lost_empire), voxelized into _voxelWorld instead of loaded as a mesh,
+	// when set. Its chunks are greedy meshed on the job system, and edits (V digs the block at the view center)
+	// remesh only the chunks they touch
+	std::string _voxelScenePath;
+	VoxelWorld _voxelWorld;
+	// the entity drawing each chunk, by chunk index, a null entity while its mesh is empty; and the chunk's
+	// transform at its origin, UINT32_MAX until it first has one
+	std::vector<Entity> _voxelChunkEntities;
+	std::vector<uint32_t> _voxelChunkTransforms;
+
+	// incremental mesh pool compaction: while the pool is fragmented, a few meshes a frame are copied into
+	// lower free ranges, bounded by bytes copied and CPU time spent choosing them
+	bool _defragmentMeshPool{ true };
+	VkDeviceSize _defragBytesPerFrame{ 8 * 1024 * 1024 };
+	double _defragTimeBudgetMs{ 0.25 };
+
+	// upload loaded models as 16-byte PackedVertex instead of the 36-byte Vertex
+	bool _usePackedVertices{ true };
+	// otherwise upload them as VertexFormat::Split, so depth-only passes fetch 12 bytes a vertex instead of 36
+	bool _useSplitVertexStreams{ true };
+
+	// load textures from the BC1/BC3 texture cache (a quarter to an eighth of rgba8) when the GPU supports it
+	bool _useCompressedTextures{ true };
+	// mip streaming of block-compressed textures: they start with their tail (see MIP_STREAMING_TAIL_SIZE)
+	// and finer levels come and go by screen size, within what the device-local budget leaves them
+	bool _useMipStreaming{ true };
+	VkDeviceSize _textureMemoryCap{ 256ull * 1024 * 1024 }; // streamed levels never take more than this
+	size_t _mipStreamingBytesPerFrame{ 16 * 1024 * 1024 }; // finer levels queued per frame, at least one texture
+	uint32_t _mipStreamingBias{ 0 }; // levels coarser than the screen size asks for
+	VkDeviceSize _streamedTextureBytes{ 0 }; // resident levels of streamed textures, as of the last update
+	std::vector<TextureLevelChange> _textureLevelChanges;
+	// with residency priorities, every RESIDENCY_PRIORITY_INTERVAL frames: the frame graph's targets and the
+	// depth image go first, then the textures something in the frustum draws with, the rest last. Textures of
+	// at least DEDICATED_TEXTURE_BYTES get memory of their own, so theirs doesn't follow whatever shares a block
+	static constexpr uint32_t RESIDENCY_PRIORITY_INTERVAL = 8;
+	static constexpr size_t DEDICATED_TEXTURE_BYTES = 4 * 1024 * 1024;
+	std::vector<const Texture*> _visibleTextures; // sorted, as of the last update
+	// textures at least _virtualTextureMinSize on a side are paged through a VirtualTexture instead, whose
+	// cache is sized from the window at load time. Requested before init; needs fragment shader stores
+	// for the feedback. They never become resident as regular textures, so they take no bindless slot
+	bool _useVirtualTexturing{ true };
+	uint32_t _virtualTextureMinSize{ 8192 };
+	std::unordered_map<std::string, VirtualTexture> _virtualTextures;
+	// stream cached 32-bit index buffers still block-packed and expand them with a compute pass, so the
+	// loader neither decodes nor copies them at full size; see gpu_index_unpack() for when it applies
+	bool _useGpuIndexUnpack{ true };
+	BlockUnpacker _blockUnpacker;
+
+	// monkeys drawn per frame; above 1, one instanced draw replaces the single push-constant draw
+	uint32_t _instanceCount{ 1 };
+
+	// draw the render list through vkCmdDrawIndexedIndirect; ignored without drawIndirectFirstInstance.
+	// Set from _renderPath when the device functions load
+	bool _useIndirectDraws{ true };
+	RenderPath _renderPath{ RenderPath::Auto };
+	DeviceCapabilities _capabilities; // the device's, probed in create_device_context
+
+	// record large non-indirect render lists on several threads into secondary command buffers
+	bool _multithreadedRecording{ true };
+	uint32_t _recordThreadCount{ 1 }; // cores available for recording, capped at MAX_RECORD_THREADS
+	// per-frame command buffers, from pools reset whole each frame: MAIN_COMMAND_THREAD's for the primary, one
+	// thread index above it per recording thread; the async culling has its own on the compute family
+	CommandAllocator _frameCommands;
+	CommandAllocator _computeCommands;
+	// non-indirect path: record the static objects' draws once per frame slot into a secondary buffer and
+	// replay it until the static set, a pipeline, the frame graph or the view setup changes; static objects
+	// then skip CPU frustum culling. Off with mesh shading, whose draws depend on the view
+	bool _cacheStaticDraws{ false };
+	// bumped by whatever invalidates every cached static buffer
+	uint64_t _staticDrawGeneration{ 1 };
 
-	// meshes
-	Mesh _monkeyMesh;
+	// frustum culling on the GPU for the indirect path; when off, the cull pass keeps every object
+	bool _gpuCulling{ true };
+	// cameras rendered next to the main one, asked for with --views, each into a target of its own (see
+	// SceneViews.h) shown down the window's right edge. Only the GPU path draws them, culled in the main view's
+	// dispatch; decided at init, since the indirect, count and instance buffers get a slice per view. Off with
+	// stereo, whose pipelines are built for its view mask
+	uint32_t _sceneViewCount{ 0 };
+	uint32_t _sceneViewHeight{ 216 }; // of each target, in pixels; the width follows the window's aspect
+	SceneViews _sceneViews;
+	RenderGraphResource _graphViewColor[MAX_SCENE_VIEWS]{};
+	// two-phase occlusion culling against a depth pyramid; ignored unless _occlusionCullingSupported
+	bool _occlusionCulling{ true };
+	DepthPyramid _depthPyramid;
+	// one uint per render object, written by the second cull phase and read by the next frame's first;
+	// shared by every frame slot, since frames run one after another on the queue
+	AllocatedBuffer _visibilityBuffer;
+	VkDescriptorSetLayout _cullSetLayout;
+	VkPipelineLayout _cullPipelineLayout;
+	VkPipeline _cullPipeline;
+	VkPipeline _compactPipeline;
 
-	// depth buffers
-	VkImageView _depthImageView;
-	AllocatedImage _depthImage;
+	// VK_KHR_draw_indirect_count lets the GPU decide how many compacted draws each run issues
+	bool _drawIndirectCountSupported{ false };
+	PFN_vkCmdDrawIndexedIndirectCountKHR _vkCmdDrawIndexedIndirectCount{ nullptr };
+
+	// built by prepare_indirect_draws, consumed by draw_objects_indirect in the same frame
+	std::vector<IndirectBatch> _indirectBatches;
+	std::vector<IndirectRun> _indirectRuns;
+	std::vector<uint32_t> _indirectOrder; // render object index per instance slot, grouped by batch and LOD
+	std::vector<uint32_t> _objectLods; // scratch, LOD per render object
+	CullPushConstants _cullConstants{}; // of the first phase; the second only changes phase
+
+	// distance-based LOD: each object draws the coarsest level whose error projects below _lodPixelError pixels
+	bool _useLods{ true };
+	float _lodPixelError{ 1.0f };
+	float _lodPixelScale{ 1.f }; // screen pixels per world unit at distance 1, updated by draw()
+
+	// immediate-submit uploads
+	UploadContext _uploadContext;
+	// batched transfer-queue uploads, picked up by the next frame
+	UploadManager _uploadManager;
+	// the persistent staging ring every upload goes through when it fits, and how much of it streaming may
+	// fill a frame (0 for no limit); loaded assets over the budget wait in _pendingMeshes and _pendingTextures
+	VkDeviceSize _stagingRingSize{ 64ull * 1024 * 1024 };
+	VkDeviceSize _uploadBytesPerFrame{ 32ull * 1024 * 1024 };
+
+	// meshes from disk load on a background thread, so the first frame doesn't wait for the scene
+	AssetStreamer _streamer;
+	// shaders and asset caches packed by --pack-assets; when the file exists everything is looked up in
+	// it first and loose files are only the fallback
+	AssetArchive _assetArchive;
+	const char* _assetArchivePath{ "../../assets.qcpak" };
+	// --asset-cache: imported meshes and textures are kept in this directory under keys of their sources'
+	// contents instead of next to the sources; empty keeps the per-source caches the archive packs
+	std::string _assetCachePath;
+	AssetCache _assetCache;
+	std::deque<AssetStreamer::LoadedMesh> _pendingMeshes;
+	std::deque<AssetStreamer::LoadedTexture> _pendingTextures;
+	std::vector<StreamingUpload> _streamingUploads;
+	std::vector<StreamingTexture> _streamingTextures;
+	// --no-asset-reload: streamed meshes and textures are reloaded when their sources change on disk,
+	// without waiting for the device; requested names are in _reloadingMeshes/_reloadingTextures until they arrive
+	bool _useAssetReload{ true };
+	AssetWatcher _assetWatcher;
+	std::unordered_set<std::string> _reloadingMeshes;
+	std::unordered_set<std::string> _reloadingTextures;
+	std::vector<MeshReload> _meshReloads;
+	std::vector<TextureReload> _textureReloads;
+
+	// every mesh's vertices and indices, bound once per frame
+	MeshPool _meshPool;
+
+	// depth buffer for occlusion culling, which samples it; null without support, the frame graph's own depth is used then
+	VkImageView _depthImageView{ VK_NULL_HANDLE };
+	AllocatedImage _depthImage{};
 	VkFormat _depthFormat;
 
+	// GPU timestamps and pipeline statistics, read back a few frames late
+	GpuProfiler _gpuProfiler;
+	bool _enablePipelineStatistics{ true };
+	bool _logGpuTimings{ false }; // print one line of GPU timings per frame
+	// the passes each frame in flight started and finished, printed when the device is lost
+	GpuBreadcrumbs _breadcrumbs;
+	// names the engine's objects and labels every pass for RenderDoc and Nsight; no-op without the extension
+	DebugUtils _debugUtils;
+
+	// CPU_PROFILE_SCOPE totals are collected after every draw(); with a path, init() and the first
+	// _cpuTraceFrames frames are written there as a Chrome trace
+	bool _logCpuTimings{ false }; // print one line of CPU timings per frame
+	std::string _cpuTracePath;
+	uint32_t _cpuTraceFrames{ 300 };
+	// frames slower than the threshold are written with the frames around them as Chrome traces; off by default
+	HitchRecorder::Settings _hitchSettings;
+	HitchRecorder _hitches;
+	// with a path, run() records its input there for --replay, written when it returns
+	std::string _inputRecordPath;
+	InputRecording _inputRecording;
+
+	// wall time of each part of init(), printed once it returns; the first present adds its own line
+	std::chrono::steady_clock::time_point _startupStart;
+	std::chrono::steady_clock::time_point _startupMark;
+	std::vector<std::pair<const char*, double>> _startupStages;
+
+	// imgui overlay of the numbers above, toggled with F1; drawn over the finished frame
+	PerformanceHud _hud;
+	// the same numbers as histograms and counters on a Prometheus endpoint, for monitoring a fleet of instances;
+	// served once _metricsPort is set
+	MetricsExporter _metrics;
+	uint16_t _metricsPort{ 0 };
+	int _metricsGpuFrame{ -1 }; // the GPU profiler's last frame counted
+
+	// custom VMA pools and per-heap budget, refreshed every frame
+	GpuMemory _gpuMemory;
+	bool _logMemoryBudget{ false }; // print one line of heap and pool usage per frame
+	// device-local usage / budget above which texture uploads are refused instead of pushing the driver to page
+	float _memoryPressureLimit{ 0.9f };
+	bool _overMemoryBudget{ false };
+
+	// shared worker threads; owns the threads behind parallel_for. _jobThreadCount workers, 0 for one per core
+	// but the main thread's
+	JobSystem _jobSystem;
+	uint32_t _jobThreadCount{ 0 };
+
+	// scene graph behind _entities; draw() brings dirty subtrees up to date before recording
+	TransformStore _transforms;
+	// world bounds of _renderables; proxies carry the object's index in the list
+	Bvh _renderBvh;
+	// the same objects' bounding spheres by list index, for the linear cull; refitted along with _renderBvh
+	SphereCuller _renderSpheres;
+	uint32_t _cullChunkSize{ SphereCuller::DEFAULT_CHUNK_SIZE }; // spheres per culling job
+	// world units the frustum planes may move before the sweep runs again rather than reusing the last one's
+	// results; 0 sweeps every frame
+	float _cullCoherence{ 0.0f };
+	// what the cull shader knows of every render object, uploaded only where it changed; refitted along with
+	// _renderBvh
+	GpuScene _gpuScene;
+	// full-detail meshes on the non-indirect path go through task and mesh shaders, which cull each meshlet
+	// on the GPU; ignored unless _meshShadingSupported, in which case the vertex pipeline draws everything
+	bool _useMeshShading{ true };
+	MeshletPool _meshletPool;
+	VkDescriptorSetLayout _meshletSetLayout{ VK_NULL_HANDLE };
+	// set 2 of the meshlet pipeline: meshlets, their tables and both mesh pool vertex streams
+	VkDescriptorSet _meshletDescriptor{ VK_NULL_HANDLE };
+	VkPipelineLayout _meshletPipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline _meshletPipeline{ VK_NULL_HANDLE };
+	PFN_vkVoidFunction _vkCmdDrawMeshTasks{ nullptr };
+	// where mesh pool vertices are read: vertex input, plus storage reads in the mesh shader when it's available
+	VkPipelineStageFlags _vertexReadStages{ VK_PIPELINE_STAGE_VERTEX_INPUT_BIT };
+	VkAccessFlags _vertexReadAccess{ VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT };
+
+	// frustum culling through _renderBvh for the non-indirect path
+	bool _cpuCulling{ true };
+	// ...or through a SIMD sweep over _renderSpheres, which skips the tree walk and the sort of its hits
+	bool _sphereCulling{ false };
+	// the CPU path also drops what the large static objects hide, rasterized into _softwareOcclusion
+	bool _useSoftwareOcclusion{ false };
+	SoftwareOcclusion _softwareOcclusion;
+	// meshes whose bounds have a diagonal this long (in mesh units) or more occlude for the objects using them
+	float _occluderMinSize{ 8.0f };
+	// what make_resident kept of every such mesh before its CPU copy could go
+	std::unordered_map<const Mesh*, OccluderMesh> _occluderMeshes;
+	// the --obj level's baked visibility when asset_baker --pvs left one next to it: before anything else the
+	// CPU path drops the level's parts the camera's cell doesn't see
+	bool _usePvs{ true };
+	PotentiallyVisibleSet _pvs;
+	// the CPU path's draws of objects with at least _predicateMinTriangles at full detail are predicated on
+	// occlusion queries of their boxes from the frame before (VK_EXT_conditional_rendering). Decided at init,
+	// since the device needs the extension; ignored unless _conditionalRenderingSupported
+	bool _useConditionalRendering{ false };
+	uint32_t _predicateMinTriangles{ 10000 };
+	OcclusionPredicates _occlusionPredicates;
+	// the CPU path draws objects at their coarsest level whose bounding sphere covers _impostorPixels or fewer
+	// as quads cut out of an octahedral atlas of their mesh (see Impostors.h), all in one instanced draw. Atlases
+	// come from the caches asset_baker --impostors leaves next to the sources, or are baked on the loader thread
+	// as the meshes stream in; the layers, 1MB each at the default bake, are fixed at init
+	bool _useImpostors{ false };
+	float _impostorPixels{ 64.0f };
+	uint32_t _impostorLayers{ 32 };
+	Impostors _impostors;
+	VkPipelineLayout _impostorPipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline _impostorPipeline{ VK_NULL_HANDLE };
+	// a heightfield under the scene drawn as a CDLOD quadtree (see Terrain.h), one instanced draw of the nodes
+	// the camera's distance picks; their height tiles stream into a cache of _terrainSettings.cacheTiles slots
+	bool _useTerrain{ false };
+	TerrainSettings _terrainSettings;
+	Terrain _terrain;
+	VkPipelineLayout _terrainPipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline _terrainPipeline{ VK_NULL_HANDLE };
+	// grass scattered over the terrain's drawn nodes by a compute pass and drawn from its indirect draws (see
+	// Foliage.h), the farthest as impostors when they're on; needs the terrain
+	bool _useFoliage{ false };
+	FoliageSettings _foliageSettings;
+	Foliage _foliage;
+	VkPipelineLayout _foliagePipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline _foliagePipeline{ VK_NULL_HANDLE };
+	// full-detail meshes on the non-indirect path draw only clusters inside the frustum and facing the camera
+	bool _clusterCulling{ true };
+	// camera of the frame being recorded, updated by draw() before anything is culled or a LOD picked;
+	// between frames it's the last recorded one, which is what picking unprojects through
+	Camera _camera;
+	// reverse-Z depth for the camera (see Camera.h); fixed at init, since the pipelines bake the depth test.
+	// With it the far plane is at infinity unless _finiteFarPlane
+	bool _reverseZ{ false };
+	bool _finiteFarPlane{ false };
+
+	// stepped on a job between frames; draw() only reads the snapshot it publishes
+	Simulation _simulation;
+	JobCounter _simulationJob;
+
+	// fixed-length benchmark runs, configured from the command line, and what the last one measured
+	BenchmarkSettings _benchmark;
+	BenchmarkResult _benchmarkResult;
+
+	// the settings calibrated for this GPU (see AutoTune.h), read from _tuningDirectory once init_vulkan picked
+	// the GPU, unless _useTuning is off; the TunedParameter bits of _pinnedTuning came from the command line and
+	// keep their values
+	bool _useTuning{ true };
+	std::string _tuningDirectory{ "tuning" };
+	uint32_t _pinnedTuning{ 0 };
+	std::string _tuningPath;
+	bool _tuningLoaded{ false }; // whether the GPU had been calibrated
+	double _lastPresentMs{ 0.0 }; // time the last draw() spent blocked in acquire + present
+	uint64_t _lastFrameHeapAllocations{ 0 }; // operator new calls during the last draw(); debug builds only
+	heap_stats::Snapshot _lastFrameHeap; // the same by tag, with TaggedAllocator's in release builds
+	FrameStats _lastFrameStats; // command counts of the last draw()
+
 	// deletion
 	DeletionQueue _mainDeletionQueue;
+	// swapchain, its image views, framebuffers and depth target; flushed on every swapchain rebuild
+	DeletionQueue _swapchainDeletionQueue;
 
 	bool _isInitialized{ false };
+	bool _deviceLost{ false };
 	int _frameNumber {0};
 
 	VkExtent2D _windowExtent{ 1700 , 900 };
 
+	// null when headless; a window set before init() is used instead of a new one, see release_window()
 	struct SDL_Window* _window{ nullptr };
 
-	//initializes everything in the engine
-	void init();
+	// presents straight to this display through VK_KHR_display instead of to an SDL window, for kiosks with no
+	// compositor running; there is then no window and no input. -1 for the window. Set before init()
+	int _displayIndex{ -1 };
+	DirectDisplay _directDisplay;
+	// a fullscreen window whose swapchain asks for the monitor to itself through VK_EXT_full_screen_exclusive,
+	// on Windows builds whose device has it; elsewhere just a fullscreen window. Set before init()
+	bool _useFullScreenExclusive{ false };
+	FullScreenExclusive _fullScreenExclusive;
+
+	// no window, surface or swapchain: frames render through the same graph into a ring of offscreen images
+	// (_swapchainImages point at them) and are read back to host memory. Set before init()
+	bool _headless{ false };
+	uint32_t _headlessImageCount{ 3 }; // raised to _frameOverlap if lower
+	uint32_t _headlessFrames{ 300 }; // frames run() renders before returning
+	std::string _headlessCapturePath; // PPM of the last frame, written at cleanup when set and read back as Rgba
+	OffscreenTargets _offscreen;
+	// the still render_tiles() draws a part of; headless, at the grid's tile extent and read back as Rgba. Set
+	// before init() on every engine rendering tiles of one image, so they all build the same view
+	TileGrid _tileGrid;
+
+	// every frame copied to host memory and handed to _onFrameReadback, in frame order, once draw() has waited
+	// for the frame slot anyway; always on when headless. The frame graph then leaves the swapchain image to
+	// the copy, which returns it for the overlay and presenting, so the copy has no overlay. Set before init()
+	bool _useReadback{ false };
+	ReadbackFormat _readbackFormat{ ReadbackFormat::Rgba };
+	FrameReadback _readback;
+	FrameReadback::Callback _onFrameReadback; // runs on the render thread; copy out what's needed and return
+
+	// every frame encoded to H.264 by the GPU's video encoder, handed to _onEncodedFrame and appended to
+	// _encodePath when set, in frame order. Needs Vulkan Video and timeline semaphores, and like the readback
+	// leaves out the overlay. Set before init()
+	bool _useVideoEncode{ false };
+	VideoEncoder::Settings _encodeSettings;
+	std::string _encodePath; // raw Annex B stream, which players and muxers take as .h264
+	VideoEncoder _videoEncoder;
+	VideoEncoder::Callback _onEncodedFrame; // runs on the render thread, like _onFrameReadback
+	std::ofstream _encodeFile;
+
+	//initializes everything in the engine; false when there is no instance, GPU, device or swapchain to
+	//render with, in which case cleanup() has nothing to do
+	bool init();
 
 	//shuts down the engine
 	void cleanup();
@@ -103,18 +1471,430 @@ public:
 
 	//run main loop
 	void run();
+	// headless: renders the next frames frames, for running one render job after another on one engine
+	void run_frames(uint32_t frames);
+	// headless, with _tileGrid: renders count of its tiles from first, in row order, and hands each one's readback
+	// to writer. The scene streams in first and holds still through every tile; a tile's readback arrives while
+	// the next ones render, and the last ones' before this returns
+	void render_tiles(TiledImageWriter& writer, uint32_t first, uint32_t count);
+	// the same, handing each readback to callback with its tile, on the render thread
+	using TileCallback = std::function<void(const FrameReadback::Result& result, uint32_t tile)>;
+	void render_tiles(uint32_t first, uint32_t count, const TileCallback& callback);
+	// headless, with _useVideoEncode: renders count frames of the camera path from simulation step first, one
+	// step a frame, and hands their packets to callback in order, the first of them a key frame, so streams
+	// rendered apart can be joined end to end. The frames before first that the depth pyramid and upscaler
+	// history need are rendered too, and not handed out; false when the encoder isn't ready
+	bool render_frames(uint64_t first, uint32_t count, const VideoEncoder::Callback& callback);
+	// between frames: the simulation, and with it the camera path, jumps to step tick
+	void seek_simulation(uint64_t tick);
+
+	// after init(), for the engines that are to share this one's device
+	const std::shared_ptr<DeviceContext>& device_context() const { return _deviceContext; }
+
+	// the device reported VK_ERROR_DEVICE_LOST: run() and run_benchmark() return, draw() no longer submits,
+	// and every device object is gone for good. The owner recovers by cleaning this engine up and starting
+	// another one, which creates a new device and reloads the scene from the asset caches (see main.cpp)
+	bool device_lost() const { return _deviceLost; }
+	// hands the window over for the next engine, which then opens on it; cleanup() leaves it alone
+	struct SDL_Window* release_window();
+
+	// with _lowLatency, blocks until the previous frame is displayed (or rendered), then with display timing for as
+	// long as the next one can start late, and records its latency; called right before the input of the next
+	// frame is sampled
+	void pace_frame();
+	// before pace_frame(): sleeps while nothing is shown, and to the next background frame without focus
+	void idle_frame();
+	// with _renderOnDemand, after idle_frame(): waits for input while nothing changed, to the next poll frame at
+	// the most; true when it waited
+	bool wait_for_damage();
+	// with _renderOnDemand, the next frames are drawn whatever else changed
+	void request_redraw();
+
+	// hands every readback not delivered yet to callback, oldest first; the GPU must be idle
+	void deliver_pending_readbacks(const FrameReadback::Callback& callback);
+	// the same for the encoded frames, which go to _encodePath and _onEncodedFrame
+	void deliver_pending_encodes();
+
+	// switches presentation mode at runtime by rebuilding the swapchain (falls back if unsupported)
+	// must be called between frames
+	void set_present_mode(VkPresentModeKHR mode);
+
+	// renders _benchmark.warmupFrames + _benchmark.frameCount frames, then writes the report
+	// the simulation advances exactly one step per frame, so every run sees the same views; replaying a
+	// recording, it advances by the recorded frames' times and the recorded input is handled on its frames
+	void run_benchmark();
+
+	// after each draw(): gathers the frame's CPU timings and finishes the trace capture once it's long enough
+	void end_cpu_frame();
+	// an input event of run(), or of a replay; sets quit on SDL_QUIT
+	void handle_event(const SDL_Event& e, bool& quit);
+
+	// queues the simulation update for elapsedSeconds of real time; it runs while draw() waits on the GPU
+	void begin_update(double elapsedSeconds);
+	// blocks until the queued update is done and returns its snapshot
+	const SimulationState& wait_for_update();
+
+	// records commands with function and blocks until the GPU has executed them
+	void immediate_submit(std::function<void(VkCommandBuffer cmd)>&& function);
+
+	// sharedWithCompute: used by the compute queue as well with _useAsyncCompute, so shared concurrently
+	// named for capture tools when name is given
+	AllocatedBuffer create_buffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, bool sharedWithCompute = false, const char* name = nullptr);
+
+	// frame slot used by the frame currently being recorded
+	FrameData& get_current_frame();
+
+	// registers a material under name; returns nullptr from get_material/get_mesh when name is unknown
+	Material* create_material(VkPipeline pipeline, VkPipelineLayout layout, const std::string& name);
+	// a material for every vertex format from templateName's pipelines, all with baseColor; returns the one for
+	// VertexFormat::Full, registered as name, the others go by name + "_packed", "_split" and "_voxel".
+	// nullptr if there's no such template
+	Material* create_material(const std::string& name, const std::string& templateName, const glm::vec4& baseColor = glm::vec4(1.f));
+	Material* get_material(const std::string& name);
+	Mesh* get_mesh(const std::string& name);
+	// material's variant for mesh's vertex format; the default mesh material's without one
+	Material* material_for(const Mesh& mesh, Material* material = nullptr);
+	// a "mesh" material named after the streamed mesh and its source material, diffuse map and all; the
+	// map is requested the first time any material names it, and shared by all that do
+	Material* create_imported_material(const std::string& meshName, const MeshMaterial& source);
+	// what an object switching to mesh should draw with: the material the mesh brought when the object
+	// was left with the default one, current otherwise
+	Material* imported_material_for(const Mesh& mesh, Material* current);
+	// moves every object drawing from's variants onto to's and re-sorts
+	void swap_material(Material* from, Material* to);
+	// what moves with nothing changing: skinned characters, particles, the animated lights, the spinning crowd and
+	// the orbit camera; the clear color's flash doesn't count
+	bool animating() const;
+
+	// draws count objects starting at first, binding pipelines and buffers only when they differ from the previous object
+	// expects the global descriptor set to be bound. depthPass draws just the materials with a depth
+	// pipeline, through it; the color pass after it must cover the same objects. cached recordings are
+	// replayed over many frames, so they draw whole levels rather than the clusters facing this view
+	// slots of the draw data buffer start at firstSlot, which callers recording in parallel keep apart
+	void draw_objects(VkCommandBuffer cmd, RenderObject* first, int count, bool depthPass = false, bool cached = false, uint32_t firstSlot = 0);
+	// hands constants to the shaders along _objectDataPath, through slot on the buffer paths; returns the
+	// draw's firstInstance. The storage path expects frame's draw data set bound, the others bind their own
+	uint32_t bind_draw_data(VkCommandBuffer cmd, FrameData& frame, VkPipelineLayout layout, const MeshPushConstants& constants, uint32_t slot);
+	// viewport, scissor and the mesh descriptor sets; needed at the start of every (secondary) buffer drawing meshes
+	void bind_mesh_state(VkCommandBuffer cmd, uint32_t cameraOffset) { bind_mesh_state(cmd, cameraOffset, _renderExtent); }
+	void bind_mesh_state(VkCommandBuffer cmd, uint32_t cameraOffset, VkExtent2D extent);
+	// with extended dynamic state, the draw state the following triangle lists use: depth tested with
+	// depth_compare_op() and written when writeDepth, tested EQUAL against the pre-pass otherwise. Does nothing
+	// without it, the pipelines having the same state built in. The shadow cascades aren't the camera's depth
+	// and pass cameraDepth false, which keeps LESS_OR_EQUAL whatever the camera does. Resets the shading rate
+	void set_draw_state(VkCommandBuffer cmd, bool writeDepth, VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT, bool cameraDepth = true);
+	// with variable rate shading, the rate of the following draws: 2x2 when coarse, 1x1 otherwise, either one
+	// coarsened by the rate image where it is bound. Does nothing without it
+	void set_shading_rate(VkCommandBuffer cmd, bool coarse);
+	// the depth test of draws into the camera's depth buffer: LESS_OR_EQUAL, GREATER_OR_EQUAL with reverse Z
+	VkCompareOp depth_compare_op() const;
+	// what the scene's targets cover: the window, or one eye's half of it with stereo
+	VkExtent2D scene_extent() const;
+	// moves _renderScale towards the GPU frame budget once a new frame's timings are in and sets _renderExtent
+	void update_render_scale();
+	// every binding of a mesh pool vertex stream, from binding 0 up; pulled is for the pulled mesh pipelines,
+	// which get the stream's format and the pool's set instead
+	void bind_vertex_stream(VkCommandBuffer cmd, uint32_t vertexStream, bool pulled = false);
+	// submits cmd to the graphics queue after waitCount (at most MAX_GRAPHICS_WAITS) semaphores (values ignored for binary ones), signaling
+	// signalSemaphore if not null, fence if not null and the next graphics timeline value, which is returned
+	// (0 without timeline semaphores). Goes through vkQueueSubmit2 with synchronization2
+	uint64_t submit_graphics(VkCommandBuffer cmd, uint32_t waitCount, const VkSemaphore* waitSemaphores, const uint64_t* waitValues,
+		const VkPipelineStageFlags* waitStages, VkSemaphore signalSemaphore, VkFence fence);
+	// whether the graphics submit that signaled value is done; polls the counter, so it's cheap to call every frame
+	bool graphics_complete(uint64_t value);
+	void wait_graphics(uint64_t value, uint64_t timeout);
+
+	// whether draw() records objectCount objects through record_draws_parallel this frame
+	bool should_record_in_parallel(uint32_t objectCount) const;
+	// splits count objects from first into per-thread chunks recorded into frame's secondary buffers, on at most
+	// maxThreads threads; returns how many were recorded
+	// the buffers continue the render pass, or the dynamic rendering, of context
+	uint32_t record_draws_parallel(FrameData& frame, const RenderGraph::PassContext& context, uint32_t cameraOffset, RenderObject* first, uint32_t count,
+		uint32_t maxThreads = MAX_RECORD_THREADS);
+	// begins the secondary cmd continuing context's render pass, or its dynamic rendering. framebuffer may be
+	// VK_NULL_HANDLE for a buffer replayed into several
+	void begin_secondary(VkCommandBuffer cmd, const RenderGraph::PassContext& context, VkFramebuffer framebuffer, VkCommandBufferUsageFlags usage);
+	// whether the non-indirect path replays the static objects from a cached buffer
+	bool static_draw_cache_active() const;
+	// frame's cached buffer of the static objects' main pass draws, re-recorded first if what it baked in changed
+	VkCommandBuffer static_draws(FrameData& frame, const RenderGraph::PassContext& context, uint32_t cameraOffset);
+	// the main pass's pipeline state for builder: against _renderPass, or its attachment formats with dynamic rendering
+	PipelineDescription describe_main_pass(const PipelineBuilder& builder) const;
+	// points every pipeline slot and material still using previous at pipeline
+	void replace_pipeline(VkPipeline previous, VkPipeline pipeline);
+	// between frames: replaces the fallback of every specialized compile done by now
+	void swap_specialized_pipelines();
+	// vkCmdBindPipeline, noting the pipeline as drawn with for the manifest; any recording thread
+	void bind_graphics_pipeline(VkCommandBuffer cmd, VkPipeline pipeline) const;
+
+	// objects of _renderables at least partly inside the frustum, in render list order, leaving out the static
+	// ones when skipStatic; copied into frame's arena unless that leaves all of _renderables
+	RenderObject* cull_renderables(FrameData& frame, uint32_t& count, bool skipStatic = false);
+	// issues object's level 0 as one draw per run of consecutive visible clusters
+	void draw_clusters(VkCommandBuffer cmd, const RenderObject& object, uint32_t firstInstance = 0);
+	// whether object is drawn by draw_meshlets instead of draw_objects
+	bool uses_meshlets(const RenderObject& object) const;
+	// one task shader dispatch per object that uses_meshlets; binds its own pipeline and sets, so call
+	// it after draw_objects on the same objects
+	void draw_meshlets(VkCommandBuffer cmd, uint32_t cameraOffset, RenderObject* first, int count);
+	// what came back of a pick of _objectPicker, logged like pick's
+	void report_gpu_pick(const ObjectPicker::Result& result);
+	// nearest render object whose world bounds the ray hits; false if there is none
+	bool pick(const glm::vec3& origin, const glm::vec3& direction, uint32_t& renderIndex, float& distance) const;
+
+	// outside the render pass: writes this frame's object and draw records, then records the cull
+	// and compaction dispatches that fill the instance buffer and the per-run draw counts. computeQueue:
+	// cmd goes to the compute queue, whose submit hands the output to the draws instead of a barrier
+	void prepare_indirect_draws(VkCommandBuffer cmd, FrameData& frame, uint32_t cameraOffset, RenderObject* first, int count,
+		bool computeQueue = false);
+	// the cull and compaction dispatches of one phase, with the barriers handing their output to the draws
+	void dispatch_cull(VkCommandBuffer cmd, FrameData& frame, uint32_t cameraOffset, uint32_t phase, bool computeQueue = false);
+	// records the first cull phase into the slot's compute command buffer and submits it; returns the
+	// _computeTimeline value the graphics submit has to wait on
+	uint64_t submit_async_culling(FrameData& frame, uint32_t cameraOffset);
+	// inside the render pass: one indirect call per run, reading what the cull pass of phase produced, or
+	// with phase 2 + v what it culled for extra view v; depthPass as for draw_objects. With formatPipelines
+	// (the overdraw or pick ones), every run draws with the one for its vertex format instead of its
+	// material's, as a depth pass would
+	void draw_objects_indirect(VkCommandBuffer cmd, FrameData& frame, uint32_t phase, bool depthPass = false,
+		const VkPipeline* formatPipelines = nullptr);
+	// whether this frame's indirect draws run the second, occlusion-tested phase; not with stereo, since the
+	// depth pyramid is built from a single view's depth
+	bool occlusion_culling() const { return _occlusionCullingSupported && _occlusionCulling && _gpuCulling && !_useStereo; }
+	// whether streamed meshes keep their indices packed for the GPU: only staged uploads can be expanded into
+	// the pool, and the mesh shader path cuts meshlets from the indices on the CPU anyway
+	bool gpu_index_unpack() const { return _useGpuIndexUnpack && _blockUnpacker.ready() && _uploadMeshesToDeviceLocal && !_meshShadingSupported; }
+	// the frame graph's main raster pass: the crowd, or the render list through whichever path this frame uses
+	void draw_main_pass(const RenderGraph::PassContext& context);
+	// extra view's raster pass: the indirect draws its cull slice kept, with its camera
+	void draw_scene_view(VkCommandBuffer cmd, uint32_t view);
+	// instanceCount monkeys on a grid in one instanced draw, with the transforms written into frame's instance buffer
+	void draw_crowd(VkCommandBuffer cmd, FrameData& frame, uint32_t instanceCount, float modelAngle);
+
+	// groups consecutive objects with the same mesh and material into batches; expects the sorted render list
+	static void compact_draws(RenderObject* first, int count, ArenaVector<IndirectBatch>& batches);
+
+	// level of object's mesh to draw from the current camera
+	uint32_t select_lod(const RenderObject& object) const;
+
+	// inside a ShadowCascades pass: the render objects in cascade's light frustum whose isStatic
+	// matches staticCasters. The static cache outlives the camera, so it always draws level 0
+	void draw_shadow_casters(VkCommandBuffer cmd, uint32_t cascade, bool staticCasters);
+	// inside the pass the meshes draw in, after them; binds its own pipeline and sets
+	void draw_particles(VkCommandBuffer cmd, uint32_t cameraOffset);
+	// whether object is far enough to draw as its mesh's impostor, which it must have
+	bool draws_as_impostor(const RenderObject& object) const;
+	// inside the pass the meshes draw in: the quads cull_renderables pushed this frame, in one draw
+	void draw_impostors(VkCommandBuffer cmd, uint32_t cameraOffset);
+	// inside the pass the meshes draw in: the terrain nodes selected this frame, in one draw
+	void draw_terrain(VkCommandBuffer cmd, uint32_t cameraOffset);
+	// ... and after it: the grass the foliage pass scattered this frame, its far impostors included
+	void draw_foliage(VkCommandBuffer cmd, uint32_t cameraOffset);
+	// inside the transparent pass: every transparent object, back to front unless weightedBlended, where
+	// they accumulate in any order
+	void draw_transparent(VkCommandBuffer cmd, uint32_t cameraOffset, bool weightedBlended);
+	// inside the composite pass over the scene color: the accumulation targets resolved onto it
+	void draw_oit_composite(VkCommandBuffer cmd);
+	// the post chain's passes after whatever rendered scene, which they read; returns the image holding the result.
+	// upscaled scenes cover the whole of their image, the others the top-left _renderExtent
+	RenderGraphResource add_post_passes(RenderGraphResource scene, bool upscaled);
+	// moves the point lights to where they are at simulated time
+	void animate_lights(double time);
+	// samples every character's pose at simulated time into the frame slot's joint matrices, points its
+	// mesh at the slot's vertices and queues its dispatch for the skinning pass
+	void animate_characters(uint32_t frame, double time);
+	// adds what _debugDrawFlags asks for to this frame's debug lines
+	void collect_debug_draw();
+	// inside a pass over the scene's color and depth: uploads the frame's debug lines and draws them in one go
+	void draw_debug_lines(VkCommandBuffer cmd, uint32_t cameraOffset);
+	// adds what _textFlags asks for to this frame's text
+	void collect_text();
+	// inside a pass over the swapchain image: uploads the frame's glyphs and draws them in one go
+	void draw_text(VkCommandBuffer cmd, VkExtent2D extent);
+	// whether the CPU path queries and predicates the draws of objects using mesh
+	bool uses_predicates(const Mesh& mesh) const;
+	// inside a pass over the scene's finished depth: the boxes of this frame's visible heavy objects, each in
+	// an occlusion query of _occlusionPredicates
+	void draw_occlusion_queries(VkCommandBuffer cmd, uint32_t cameraOffset);
 
 private:
-	void init_vulkan();
-	void init_swapchain();
+	bool init_vulkan();
+	// undoes what a failed init() had created, window included
+	void cleanup_failed_init();
+	// the instance, surface, device, queues and allocator, published in a new _deviceContext; false, with
+	// the reason logged, when any of them can't be had
+	bool create_device_context();
+	// takes the device and everything it was created with over from _deviceContext, plus a surface of our own
+	void attach_device_context();
+	// extension entry points of _device; drops the features whose functions are missing
+	void load_device_functions();
+	// the last session out saves the pipeline cache and destroys the device and instance
+	void release_device_context();
+	// vkDeviceWaitIdle, with the other sessions' submits held off
+	void wait_device_idle();
+	// false when the swapchain couldn't be created; recreate_swapchain() then tries again next frame
+	bool init_swapchain();
+	void recreate_swapchain();
+	// logs result like VK_CHECK; false on any error, and a lost device marks the engine for recovery
+	bool check_device_result(VkResult result, const char* call);
+	// best supported mode for desired; falls back through the closest alternatives to FIFO
+	VkPresentModeKHR choose_present_mode(VkPresentModeKHR desired);
 	void init_commands();
 	void init_default_renderpass();
-	void init_framebuffers();
+	// declares and compiles the frame's passes for key; the old graph's objects are retired into retired
+	void build_frame_graph(const FrameGraphKey& key, DeletionQueue& retired);
 	void init_sync_structures();
+	void init_instance_buffers();
+	// settles _objectDataPath and _drawDataStride for the selected device
+	void choose_object_data_path();
+	// the GPU's calibrated settings over the defaults, where the command line left them; restarts the job
+	// system when its worker count changes
+	void apply_tuning();
+	// appends the draw_data benchmark's result for the current path to _objectDataResultsPath
+	void record_object_data_result(double cpuMs, double gpuMs);
+	void init_descriptors();
+	void init_bindless();
+	// shadow map and its descriptor in the global set; before init_pipelines, which builds the casters for its pass
+	void init_shadows();
+	// puts a resident texture into the bindless array and returns its index
+	uint32_t register_bindless_texture(Texture& texture);
+	// queues every graphics pipeline on the registry's workers; finish_pipelines() waits for them and
+	// creates the materials
 	void init_pipelines();
+	void finish_pipelines();
+	// closes the startup stage that began at the previous mark
+	void mark_startup(const char* stage);
+	void init_cull_pipelines();
+	void init_unpack_pipeline();
+	// light buffers and set 0's bindings to them, needed by the mesh shaders lit or not; the cluster
+	// pipeline only with _useClusteredLights
+	void init_lights();
+	// the post kernels; without their shaders the HDR target is copied to the swapchain as it is
+	void init_post_process();
+	void init_shading_rate();
+	// the heat map kernel; the counting pipelines come with the others in init_pipelines
+	void init_overdraw_view();
+	void init_temporal_upscale();
+	// the targets of the extra views, once the scene color format is known
+	void init_scene_views();
+	// the upscaler's images at the window's size, ready to be the history of a first frame
+	void resize_temporal_upscale();
+	// the acceleration structures and the trace pipeline; after the mesh pool and before any mesh is added to it.
+	// Writes set 0's mask binding whether or not rays are traced
+	void init_ray_shadows();
+	// the mask at the window's size, or one texel without ray tracing, and set 0 pointed at it
+	void resize_ray_shadows();
+	// the skinning pipeline and _characterCount characters' meshes; after the mesh pool, before init_scene
+	void init_skinning();
+	// the character's skeleton and looping clip, and a segmented tube weighted to them; stands in for
+	// imported skinned content, which no loader reads yet
+	void build_character_rig(std::vector<SkinnedVertex>& vertices, std::vector<uint32_t>& indices);
+	// points every frame's cull set at the depth pyramid; again whenever the swapchain is rebuilt
+	void write_cull_pyramid_descriptors();
+	// meshlet pool and its descriptor set; after the mesh pool, whose vertex buffers the set points at
+	void init_meshlets();
+	// the pulled mesh pipelines' set 3, over the same pool buffers
+	void init_vertex_pulling();
+	void init_pipeline_cache();
+	void save_pipeline_cache();
+	// imgui context, font atlas and the overlay's render pass; after init_pipelines, which creates the pipeline cache
+	void init_hud();
+	// readback buffers and the NV12 conversion; after the swapchain, does nothing without _useReadback
+	void init_readback();
+	// encode session for the swapchain's size; after the swapchain, does nothing without _useVideoEncode
+	void init_video_encode();
+	// writes packet to _encodePath and hands it to _onEncodedFrame
+	void output_encoded_frame(const VideoEncoder::Packet& packet);
 	
 	void load_meshes();
-	void upload_mesh(Mesh& mesh);
+	// every primitive of _gltfPath, converted on the job system and uploaded like the built-in meshes
+	void load_gltf_meshes();
+	// name of the mesh a primitive of the document became
+	std::string gltf_mesh_name(size_t mesh, size_t primitive) const;
+	void load_textures();
+	void init_scene();
+	// what a scene snapshot holds: the monkey, the OBJ scene's object, the glTF scene and the floor
+	void build_level();
+	// the files build_level reads
+	std::vector<std::string> level_sources() const;
+	// before anything else is in _transforms; false when there's no snapshot of the level's sources
+	bool load_scene_snapshot();
+	// right after build_level
+	void save_scene_snapshot();
+	// a material per glTF material, then the default scene's nodes under one root, an object per primitive
+	void add_gltf_scene();
+	// replaces the static objects of the scene with the batches build_static_batches makes of them; before
+	// sort_renderables
+	void batch_static_objects();
+	// voxelizes _voxelScenePath into _voxelWorld, a block type per part, and uploads the first chunk meshes
+	void load_voxel_world();
+	// remeshes and reuploads the chunks edits left dirty, the old meshes freed once the frames drawing them
+	// are done, and adds or removes the chunks' entities; once a frame
+	void update_voxel_world();
+	// gives the chunk an entity while its mesh has triangles and takes it away once it has none; the render
+	// list follows with the next sort_renderables
+	void update_voxel_chunk_entity(uint32_t chunk);
+	// a scene entity drawing object; shows up in _renderables with the next sort_renderables
+	Entity add_renderable(const RenderObject& object);
+	// rebuilds _renderables from the entities, ordered by pipeline, then mesh, and refits their bounds; call
+	// after editing a RenderObject component
+	void sort_renderables();
+	// inserts or refits every object's _renderBvh proxy and _gpuScene slot from its mesh and world transform
+	void refit_render_bounds();
+	// refills _softwareOcclusion from the static objects whose meshes are in _occluderMeshes
+	void rebuild_occluders();
+	// gives the object a _gpuScene slot if it has none and writes what the cull shader reads of it there
+	void update_scene_object(RenderObject& object);
+	// streaming, if given, receives the packed index buffer when the indices are left for the GPU to expand
+	void upload_mesh(Mesh& mesh, StreamingUpload* streaming = nullptr);
+	// once its upload has reached the graphics queue: the mesh is drawn from then on, and with
+	// _releaseMeshCopies its CPU-side geometry is freed
+	void make_resident(Mesh& mesh);
+	// creates the GPU_ONLY image and queues the stored levels on the transfer queue; any missing levels wait
+	// for generate_mipmaps
+	// false when the texture doesn't fit in the memory budget; it then stays non-resident
+	// a reload's image is moved into an entry whose release is queued already, so it queues none of its own
+	bool upload_texture(Texture& texture, bool reload = false);
+	// image and view for texture's stored levels from firstLevel on, with their upload queued; the image has
+	// mipLevels levels, any past the stored ones left for generate_mipmaps. false if it doesn't fit the budget
+	bool create_texture_image(const Texture& texture, uint32_t firstLevel, uint32_t mipLevels, AllocatedImage& image, VkImageView& imageView);
+	// picks the resident levels of every streamed texture and queues the images of those that change;
+	// true if anything was queued for the next flush
+	bool update_texture_residency();
+	// tags what the frame needs with its residency priority and applies them, with priorities enabled
+	void update_residency_priorities();
+	// pages texture through a new entry of _virtualTextures when it's large enough and suitable;
+	// false leaves it to upload_texture
+	bool create_virtual_texture(const std::string& name, Texture& texture);
+	// the material's parameters into _materialStore, with its texture's current bindless slot; uploaded with the next frame
+	void write_material_data(const Material& material);
+	// after texture got a new slot
+	void update_texture_materials(const Texture& texture);
+
+	// once per frame before recording: uploads meshes and textures the loader finished
+	void update_streaming();
+	// requests the streamed assets whose sources changed again
+	void update_asset_reload();
+	// loaded as replacements of the resident assets of the same name; false leaves them as they are
+	bool reload_mesh(AssetStreamer::LoadedMesh& loaded);
+	bool reload_texture(AssetStreamer::LoadedTexture& loaded);
+	// after the frame's acquires: swaps acquired reloads in and retires what they replace with the frame
+	void publish_asset_reloads(VkCommandBuffer cmd, bool& unpacked);
+	// after the frame's acquires: generates mips of acquired textures, marks uploaded assets resident
+	// and swaps meshes into the render list
+	void publish_streamed_assets(VkCommandBuffer cmd);
+	// outside a render pass, before anything reads the pool this frame: one budgeted compaction step
+	void defragment_mesh_pool(VkCommandBuffer cmd);
+	// streamed assets still loading or uploading
+	bool streaming_busy();
 
 	bool load_shader_module(const char* filePath, VkShaderModule* outShaderModule);
+	// reads every .spv in folder, and creates and reflects its module, on the job system's workers;
+	// load_shader_module then only looks them up. Prints how long each took
+	void preload_shaders(const std::string& folder);
+	// the stages of one pipeline merged; modules loaded without reflection are left out
+	ShaderReflection reflect_stages(std::initializer_list<VkShaderModule> shaders) const;
+	// layout with the sets and push constants the stages declare. setLayouts[i] is used for set i where
+	// given and not null, the rest are derived from the shaders with dynamic uniform buffers
+	VkPipelineLayout reflect_pipeline_layout(const ShaderReflection& reflection, std::vector<VkDescriptorSetLayout> setLayouts = {});
 };
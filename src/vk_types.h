@@ -7,12 +7,30 @@
 #include <deque>
 #include <functional>
 
+#include <Log.h>
+
 #include <vulkan/vulkan.h>
 #include <vk_mem_alloc.h>
 
+// log any Vulkan error, with the call and where it was made, and carry on; the calls whose failure the
+// engine acts on (device loss, startup) check their results themselves
+#define VK_CHECK(x)												\
+	do															\
+	{															\
+		VkResult err = x;										\
+		if (err)												\
+		{														\
+			LOG_ERROR("Vulkan error " << err << " from " #x		\
+				<< " at " __FILE__ ":" << __LINE__);				\
+		}														\
+	}	while (0)												\
+
 struct AllocatedBuffer {
 	VkBuffer _buffer;
 	VmaAllocation _allocation;
+	// host-visible buffers stay mapped from creation to destruction; writes still need a vmaFlushAllocation,
+	// which does nothing on coherent memory. Null for device-local ones
+	void* _mapped{ nullptr };
 };
 
 struct AllocatedImage {
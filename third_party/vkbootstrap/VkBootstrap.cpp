@@ -1130,6 +1130,38 @@ detail::Result<PhysicalDevice> PhysicalDeviceSelector::select () const {
 	if (selected_device.phys_device == VK_NULL_HANDLE) {
 		return detail::Result<PhysicalDevice>{ PhysicalDeviceError::no_suitable_device };
 	}
+	return make_physical_device (selected_device);
+}
+
+detail::Result<std::vector<PhysicalDevice>> PhysicalDeviceSelector::select_devices () const {
+	if (!system_info.headless && !criteria.defer_surface_initialization) {
+		if (system_info.surface == nullptr)
+			return detail::Result<std::vector<PhysicalDevice>>{ PhysicalDeviceError::no_surface_provided };
+	}
+
+	std::vector<VkPhysicalDevice> physical_devices;
+
+	auto physical_devices_ret = detail::get_vector<VkPhysicalDevice> (
+	    physical_devices, detail::vulkan_functions ().fp_vkEnumeratePhysicalDevices, system_info.instance);
+	if (physical_devices_ret != VK_SUCCESS) {
+		return detail::Result<std::vector<PhysicalDevice>>{ PhysicalDeviceError::failed_enumerate_physical_devices,
+			physical_devices_ret };
+	}
+
+	std::vector<PhysicalDevice> suitable_devices;
+	for (auto& phys_device : physical_devices) {
+		auto desc = populate_device_details (phys_device);
+		if (criteria.use_first_gpu_unconditionally || is_device_suitable (desc) != Suitable::no) {
+			suitable_devices.push_back (make_physical_device (desc));
+		}
+	}
+	if (suitable_devices.size () == 0) {
+		return detail::Result<std::vector<PhysicalDevice>>{ PhysicalDeviceError::no_suitable_device };
+	}
+	return suitable_devices;
+}
+
+PhysicalDevice PhysicalDeviceSelector::make_physical_device (PhysicalDeviceDesc const& selected_device) const {
 	PhysicalDevice out_device{};
 	out_device.physical_device = selected_device.phys_device;
 	out_device.surface = system_info.surface;
@@ -368,6 +368,8 @@ class PhysicalDeviceSelector {
 	explicit PhysicalDeviceSelector (Instance const& instance);
 
 	detail::Result<PhysicalDevice> select () const;
+	// Every device that is fully or partially suitable, in the order the loader enumerates them.
+	detail::Result<std::vector<PhysicalDevice>> select_devices () const;
 
 	// Set the surface in which the physical device should render to.
 	PhysicalDeviceSelector& set_surface (VkSurfaceKHR surface);
@@ -436,6 +438,7 @@ class PhysicalDeviceSelector {
 		VkPhysicalDeviceMemoryProperties mem_properties{};
 	};
 	PhysicalDeviceDesc populate_device_details (VkPhysicalDevice phys_device) const;
+	PhysicalDevice make_physical_device (PhysicalDeviceDesc const& desc) const;
 
 	struct SelectionCriteria {
 		PreferredDeviceType preferred_type = PreferredDeviceType::discrete;